@@ -0,0 +1,604 @@
+#!/usr/bin/env python
+#
+# arch/arm/crypto/aesbs-gen.py
+#
+# Generates aesbs-core.S_shipped, the NEON bit sliced AES core used by
+# aesbs-glue.c:
+#
+#	python aesbs-gen.py > aesbs-core.S_shipped
+#
+# Eight blocks are processed at once.  After loading, q<b> holds bit b of
+# every byte of the eight blocks (byte j of q<b> has one bit per block for
+# state byte j), so SubBytes is a boolean circuit on eight registers,
+# ShiftRows is a vtbl on each of them and MixColumns works on the 32 bit
+# lanes, which are the AES columns.
+#
+# The S-box is the 128 gate circuit of Boyar and Peralta, "A depth-16
+# circuit for the AES S-box" (2011).  The inverse S-box reuses its
+# non-linear middle, with the linear layers around it derived here.  The
+# 0x63 of the affine transform is left out of both circuits and folded
+# into the round keys by aesbs_convert_key().
+#
+# Straight line code this size does not fit in 16 q registers, so every
+# round is scheduled and register allocated here, spilling to the stack.
+# The schedule search is seeded, the output is the same on every run.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+
+import random
+import sys
+
+# ---------------------------------------------------------------- the S-box
+
+def xtime(a):
+    a <<= 1
+    return a ^ 0x11b if a & 0x100 else a
+
+def gmul(a, b):
+    r = 0
+    while b:
+        if b & 1:
+            r ^= a
+        a = xtime(a)
+        b >>= 1
+    return r
+
+def ginv(a):
+    for b in range(1, 256):
+        if gmul(a, b) == 1:
+            return b
+    return 0
+
+SBOX = []
+for _x in range(256):
+    _b = ginv(_x)
+    _s = _b
+    for _i in range(1, 5):
+        _s ^= ((_b << _i) | (_b >> (8 - _i))) & 0xff
+    SBOX.append(_s ^ 0x63)
+INV_SBOX = [0] * 256
+for _i, _s in enumerate(SBOX):
+    INV_SBOX[_s] = _i
+
+# U0 and S0 are the most significant bits; + is xor, x is and, # is xnor
+BP = """
+T1 = U0 + U3	T2 = U0 + U5	T3 = U0 + U6	T4 = U3 + U5
+T5 = U4 + U6	T6 = T1 + T5	T7 = U1 + U2	T8 = U7 + T6
+T9 = U7 + T7	T10 = T6 + T7	T11 = U1 + U5	T12 = U2 + U5
+T13 = T3 + T4	T14 = T6 + T11	T15 = T5 + T11	T16 = T5 + T12
+T17 = T9 + T16	T18 = U3 + U7	T19 = T7 + T18	T20 = T1 + T19
+T21 = U6 + U7	T22 = T7 + T21	T23 = T2 + T22	T24 = T2 + T10
+T25 = T20 + T17	T26 = T3 + T16	T27 = T1 + T12
+M1 = T13 x T6	M2 = T23 x T8	M3 = T14 + M1	M4 = T19 x U7
+M5 = M4 + M1	M6 = T3 x T16	M7 = T22 x T9	M8 = T26 + M6
+M9 = T20 x T17	M10 = M9 + M6	M11 = T1 x T15	M12 = T4 x T27
+M13 = M12 + M11	M14 = T2 x T10	M15 = M14 + M11	M16 = M3 + M2
+M17 = M5 + T24	M18 = M8 + M7	M19 = M10 + M15	M20 = M16 + M13
+M21 = M17 + M15	M22 = M18 + M13	M23 = M19 + T25	M24 = M22 + M23
+M25 = M22 x M20	M26 = M21 + M25	M27 = M20 + M21	M28 = M23 + M25
+M29 = M28 x M27	M30 = M26 x M24	M31 = M20 x M23	M32 = M27 x M31
+M33 = M27 + M25	M34 = M21 x M22	M35 = M24 x M34	M36 = M24 + M25
+M37 = M21 + M29	M38 = M32 + M33	M39 = M23 + M30	M40 = M35 + M36
+M41 = M38 + M40	M42 = M37 + M39	M43 = M37 + M38	M44 = M39 + M40
+M45 = M42 + M41	M46 = M44 x T6	M47 = M40 x T8	M48 = M39 x U7
+M49 = M43 x T16	M50 = M38 x T9	M51 = M37 x T17	M52 = M42 x T15
+M53 = M45 x T27	M54 = M41 x T10	M55 = M44 x T13	M56 = M40 x T23
+M57 = M39 x T19	M58 = M43 x T3	M59 = M38 x T22	M60 = M37 x T20
+M61 = M42 x T1	M62 = M45 x T4	M63 = M41 x T2
+L0 = M61 + M62	L1 = M50 + M56	L2 = M46 + M48	L3 = M47 + M55
+L4 = M54 + M58	L5 = M49 + M61	L6 = M62 + L5	L7 = M46 + L3
+L8 = M51 + M59	L9 = M52 + M53	L10 = M53 + L4	L11 = M60 + L2
+L12 = M48 + M51	L13 = M50 + L0	L14 = M52 + M61	L15 = M55 + L1
+L16 = M56 + L0	L17 = M57 + L1	L18 = M58 + L8	L19 = M63 + L4
+L20 = L0 + L1	L21 = L1 + L7	L22 = L3 + L12	L23 = L18 + L2
+L24 = L15 + L9	L25 = L6 + L10	L26 = L7 + L9	L27 = L8 + L10
+L28 = L11 + L14	L29 = L11 + L17
+S0 = L6 + L24	S1 = L16 # L26	S2 = L19 # L28	S3 = L6 + L21
+S4 = L20 + L22	S5 = L25 + L29	S6 = L13 # L27	S7 = L6 # L23
+"""
+
+def parse_bp():
+    prog = []
+    for gate in BP.replace('\n', '\t').split('\t'):
+        if not gate.strip():
+            continue
+        d, e = gate.split(' = ')
+        a, op, b = e.split()
+        prog.append((d, a, op, b))
+    return prog
+
+def run_circuit(prog, env):
+    env = dict(env)
+    for d, a, op, b in prog:
+        x, y = env[a], env[b]
+        env[d] = {'+': x ^ y, 'x': x & y, '#': 1 ^ x ^ y}[op]
+    return env
+
+def matinv(rows):
+    """inverse of an 8x8 matrix over GF(2), row i as a bit mask"""
+    a = list(rows)
+    b = [1 << i for i in range(8)]
+    for c in range(8):
+        p = [r for r in range(c, 8) if a[r] >> c & 1][0]
+        a[c], a[p] = a[p], a[c]
+        b[c], b[p] = b[p], b[c]
+        for r in range(8):
+            if r != c and a[r] >> c & 1:
+                a[r] ^= a[c]
+                b[r] ^= b[c]
+    return b
+
+def paar(targets, nvars):
+    """xor network for the linear forms in targets (name -> mask over
+    nvars inputs), greedily sharing the most common pair; returns the
+    gates as (new, a, b) and where each target ended up"""
+    targets = dict(targets)
+    gates = []
+    n = nvars
+    while True:
+        vals = [t for t in targets.values() if bin(t).count('1') > 1]
+        if not vals:
+            break
+        best, bestc = None, 0
+        for i in range(n):
+            for j in range(i + 1, n):
+                m = (1 << i) | (1 << j)
+                c = sum(1 for t in vals if t & m == m)
+                if c > bestc:
+                    best, bestc = (i, j), c
+        i, j = best
+        m = (1 << i) | (1 << j)
+        gates.append((n, i, j))
+        for k, t in targets.items():
+            if t & m == m:
+                targets[k] = (t & ~m) | (1 << n)
+        n += 1
+    return gates, dict((k, t.bit_length() - 1) for k, t in targets.items())
+
+def forward_sbox():
+    """BP without the xnors: S(x) ^ 0x63"""
+    prog = [(d, a, '+' if op == '#' else op, b) for d, a, op, b in parse_bp()]
+    return prog, ['U%d' % i for i in range(8)], ['S%d' % i for i in range(8)]
+
+def inverse_sbox():
+    """inv(A^-1 * y) where y is the input with 0x63 already added"""
+    bp = parse_bp()
+    middle = [g for g in bp if g[0][0] == 'M']
+    bottom = [g for g in bp if g[0][0] in 'LS']
+    # affine matrix A of the S-box, column j is A * (1 << j)
+    A = [0] * 8
+    for j in range(8):
+        col = SBOX[ginv(1 << j)] ^ 0x63
+        for i in range(8):
+            if col >> i & 1:
+                A[i] |= 1 << j
+    Ai = matinv(A)
+    # top: the middle's inputs as linear forms in x, then in y = A * x
+    L = dict(('U%d' % i, 1 << (7 - i)) for i in range(8))
+    for d, a, op, b in bp:
+        if d[0] == 'T':
+            L[d] = L[a] ^ L[b]
+    need = set(s for g in middle for s in (g[1], g[3]) if s[0] in 'TU')
+    tg = {}
+    for s in need:
+        acc = 0
+        for j in range(8):
+            if L[s] >> j & 1:
+                acc ^= Ai[j]
+        tg[s] = sum(1 << (7 - j) for j in range(8) if acc >> j & 1)
+    gates, where = paar(tg, 8)
+    name = dict((k, 'Y%d' % k) for k in range(8))
+    prog = []
+    for n, i, j in gates:
+        name[n] = 'P%d' % n
+        prog.append((name[n], name[i], '+', name[j]))
+    alias = dict((s, name[v]) for s, v in where.items())
+    for d, a, op, b in middle:
+        prog.append((d, alias.get(a, a), op, alias.get(b, b)))
+    # bottom: inv = A^-1 * (S ^ 0x63), S linear in M46..M63
+    ms = ['M%d' % i for i in range(46, 64)]
+    Lm = dict((m, 1 << k) for k, m in enumerate(ms))
+    for d, a, op, b in bottom:
+        Lm[d] = Lm[a] ^ Lm[b]
+    sbit = dict((7 - i, Lm['S%d' % i]) for i in range(8))
+    tg = {}
+    for i in range(8):
+        acc = 0
+        for j in range(8):
+            if Ai[i] >> j & 1:
+                acc ^= sbit[j]
+        tg['Z%d' % (7 - i)] = acc
+    gates, where = paar(tg, len(ms))
+    name = dict(enumerate(ms))
+    for n, i, j in gates:
+        name[n] = 'Q%d' % n
+        prog.append((name[n], name[i], '+', name[j]))
+    return (prog, ['Y%d' % i for i in range(8)],
+            [name[where['Z%d' % i]] for i in range(8)])
+
+def check_sboxes():
+    prog, ins, outs = forward_sbox()
+    prog2, ins2, outs2 = inverse_sbox()
+    for v in range(256):
+        e = run_circuit(prog, dict((ins[i], v >> (7 - i) & 1)
+                                   for i in range(8)))
+        s = sum(e[outs[i]] << (7 - i) for i in range(8))
+        assert s ^ 0x63 == SBOX[v]
+        y = v ^ 0x63
+        e = run_circuit(prog2, dict((ins2[i], y >> (7 - i) & 1)
+                                    for i in range(8)))
+        s = sum(e[outs2[i]] << (7 - i) for i in range(8))
+        assert s == INV_SBOX[v]
+
+# --------------------------------------------------------------- the rounds
+
+class Op(object):
+    def __init__(self, kind, dst, srcs, arg=None):
+        self.kind, self.dst, self.srcs, self.arg = kind, dst, srcs, arg
+
+def sbox_ops(circuit, planes, p):
+    prog, ins, outs = circuit
+    ren = dict((ins[i], planes[7 - i]) for i in range(8))
+    name = lambda s: ren.get(s, p + s)
+    ops = [Op({'+': 'xor', 'x': 'and'}[op], name(d), [name(a), name(b)])
+           for d, a, op, b in prog]
+    return ops, [name(outs[7 - b]) for b in range(8)]
+
+def xtime_planes(t):
+    """the planes of 2 * t"""
+    return [[t[7]], [t[0], t[7]], [t[1]], [t[2], t[7]], [t[3], t[7]],
+            [t[4]], [t[5]], [t[6]]]
+
+def mixcolumns_ops(x, p):
+    """2 * (a0 ^ a1) ^ a1 ^ a2 ^ a3 per column, with r = a1 a2 a3 a0 and
+    t = x ^ r this is o = 2 * t ^ r ^ rot2(t)"""
+    ops = []
+    r = [p + 'r%d' % b for b in range(8)]
+    t = [p + 't%d' % b for b in range(8)]
+    for b in range(8):
+        ops.append(Op('rot1', r[b], [x[b]]))
+        ops.append(Op('xor', t[b], [x[b], r[b]]))
+    cur = list(r)
+    for b, terms in enumerate(xtime_planes(t)):
+        for k, s in enumerate(terms):
+            ops.append(Op('xor', p + 'c%d_%d' % (b, k), [cur[b], s]))
+            cur[b] = p + 'c%d_%d' % (b, k)
+    o = []
+    for b in range(8):
+        ops.append(Op('rot2', p + 'w%d' % b, [t[b]]))
+        ops.append(Op('xor', p + 'o%d' % b, [cur[b], p + 'w%d' % b]))
+        o.append(p + 'o%d' % b)
+    return ops, o
+
+def inv_mixcolumns_pre_ops(x, p):
+    """x ^ 4 * (x ^ rot2(x)), after which MixColumns is InvMixColumns"""
+    ops = []
+    u = []
+    for b in range(8):
+        ops.append(Op('rot2', p + 'v%d' % b, [x[b]]))
+        ops.append(Op('xor', p + 'u%d' % b, [x[b], p + 'v%d' % b]))
+        u.append(p + 'u%d' % b)
+    twice = xtime_planes(list(range(8)))
+    y = []
+    for b in range(8):
+        terms = set()
+        for j in twice[b]:
+            terms ^= set(twice[j])
+        cur = x[b]
+        for k, j in enumerate(sorted(terms)):
+            ops.append(Op('xor', p + 'e%d_%d' % (b, k), [cur, u[j]]))
+            cur = p + 'e%d_%d' % (b, k)
+        y.append(cur)
+    return ops, y
+
+def round_ops(dec, final):
+    x = ['X%d' % b for b in range(8)]
+    ops = [Op('ldc', 'IDX', [], 'r12')]
+    a = ['A%d' % b for b in range(8)]
+    for b in range(8):
+        ops.append(Op('tbl', a[b], [x[b], 'IDX']))
+    so, y = sbox_ops(inverse_sbox() if dec else forward_sbox(), a, 's_')
+    ops += so
+    if not final:
+        if dec:
+            po, y = inv_mixcolumns_pre_ops(y, 'i_')
+            ops += po
+        mo, y = mixcolumns_ops(y, 'm_')
+        ops += mo
+    z = []
+    for b in range(8):
+        ops.append(Op('ldk', 'k_k%d' % b, []))
+        ops.append(Op('xor', 'k_z%d' % b, [y[b], 'k_k%d' % b]))
+        z.append('k_z%d' % b)
+    return ops, dict((x[b], b) for b in range(8)), [(z[b], b) for b in range(8)]
+
+def schedule(ops, rng, temp):
+    """list scheduling that prefers ops ending more live ranges than they
+    start; rng and temp add noise for the search in best_round()"""
+    prod = set(op.dst for op in ops)
+    left = {}
+    for op in ops:
+        for s in op.srcs:
+            left[s] = left.get(s, 0) + 1
+    avail = set(s for op in ops for s in op.srcs if s not in prod)
+    done = [False] * len(ops)
+    ldk = [i for i, op in enumerate(ops) if op.kind == 'ldk']
+    order = []
+    while len(order) < len(ops):
+        best, bkey = None, None
+        for i, op in enumerate(ops):
+            if done[i] or any(s not in avail for s in op.srcs):
+                continue
+            if op.kind == 'ldk' and ldk[0] != i:
+                continue
+            score = 1 - sum(1 for s in set(op.srcs) if left[s] == 1)
+            if rng:
+                key = (score + rng.random() * temp,
+                       i if rng.random() > temp else rng.random() * len(ops))
+            else:
+                key = (score, i)
+            if bkey is None or key < bkey:
+                best, bkey = i, key
+        op = ops[best]
+        done[best] = True
+        order.append(op)
+        if op.kind == 'ldk':
+            ldk.pop(0)
+        for s in op.srcs:
+            left[s] -= 1
+        avail.add(op.dst)
+    return order
+
+def allocate(ops, inputs, outputs, key='r2'):
+    """Belady allocation of ops onto q0-q15, values live in inputs at the
+    start and must be in outputs at the end; returns (lines, slots)"""
+    out = []
+    uses = {}
+    for i, op in enumerate(ops):
+        for s in op.srcs:
+            uses.setdefault(s, []).append(i)
+    end = len(ops) + 1
+    for v, r in outputs:
+        uses.setdefault(v, []).append(end)
+
+    def nextuse(v, i):
+        for u in uses.get(v, []):
+            if u >= i:
+                return u
+        return None
+
+    reg = dict(inputs)
+    owner = dict((r, v) for v, r in reg.items())
+    free = [r for r in range(16) if r not in owner]
+    slot = {}
+    remat = {}
+    want = dict(outputs)
+    emit = lambda s: out.append('\t\t' + s)
+    q = lambda r: 'q%d' % r
+    dlo = lambda r: 'd%d' % (2 * r)
+    dhi = lambda r: 'd%d' % (2 * r + 1)
+
+    def getreg(i, keep):
+        if free:
+            return free.pop(0)
+        best, bu = None, -1
+        for v in reg:
+            if v in keep:
+                continue
+            u = nextuse(v, i)
+            u = 1 << 30 if u is None else u
+            if u > bu:
+                best, bu = v, u
+        r = reg.pop(best)
+        del owner[r]
+        if best not in slot and best not in remat:
+            slot[best] = 16 * len(slot)
+            emit('vstr\t%s, [sp, #%d]' % (dlo(r), slot[best]))
+            emit('vstr\t%s, [sp, #%d]' % (dhi(r), slot[best] + 8))
+        return r
+
+    def gen(op, d, s):
+        k = op.kind
+        if k in ('xor', 'and'):
+            emit('%s\t%s, %s, %s' % ({'xor': 'veor', 'and': 'vand'}[k],
+                                     q(d), q(s[0]), q(s[1])))
+        elif k == 'rot2':
+            emit('vrev32.16\t%s, %s' % (q(d), q(s[0])))
+        elif k == 'rot1':
+            emit('vshr.u32\t%s, %s, #8' % (q(d), q(s[0])))
+            emit('vsli.32\t%s, %s, #24' % (q(d), q(s[0])))
+        elif k == 'tbl':
+            for half in (dlo, dhi):
+                emit('vtbl.8\t%s, {%s-%s}, %s' % (half(d), dlo(s[0]),
+                                                  dhi(s[0]), half(s[1])))
+        elif k == 'ldk':
+            emit('vld1.8\t{%s-%s}, [%s :128]!' % (dlo(d), dhi(d), key))
+        elif k == 'ldc':
+            emit('vld1.8\t{%s-%s}, [%s :128]' % (dlo(d), dhi(d), op.arg))
+
+    def ensure(v, i, keep):
+        if v in reg:
+            return reg[v]
+        r = getreg(i, keep)
+        if v in remat:
+            gen(remat[v], r, [])
+        else:
+            emit('vldr\t%s, [sp, #%d]' % (dlo(r), slot[v]))
+            emit('vldr\t%s, [sp, #%d]' % (dhi(r), slot[v] + 8))
+        reg[v] = r
+        owner[r] = v
+        return r
+
+    def release(vs):
+        for v in vs:
+            r = reg.pop(v)
+            del owner[r]
+            free.insert(0, r)
+
+    for i, op in enumerate(ops):
+        keep = set(op.srcs)
+        srcr = [ensure(v, i, keep) for v in op.srcs]
+        if op.kind == 'ldc':
+            remat[op.dst] = op
+        dying = sorted(set(v for v in op.srcs if nextuse(v, i + 1) is None))
+        if op.kind in ('tbl', 'rot1'):
+            # the destination must not overlap the source
+            d = getreg(i, keep)
+            release(dying)
+        else:
+            release(dying)
+            if want.get(op.dst) in free:
+                d = want[op.dst]
+                free.remove(d)
+            else:
+                d = getreg(i, keep)
+        gen(op, d, srcr)
+        reg[op.dst] = d
+        owner[d] = op.dst
+
+    # put the outputs where the next round expects them
+    for v, r in outputs:
+        ensure(v, end, want)
+    while True:
+        pend = [(v, reg[v], want[v]) for v in want if reg[v] != want[v]]
+        if not pend:
+            break
+        for v, src, dst in pend:
+            if dst not in owner or owner[dst] not in want:
+                if dst in owner:
+                    del reg[owner[dst]]
+                emit('vmov\t%s, %s' % (q(dst), q(src)))
+                del owner[src]
+                reg[v] = dst
+                owner[dst] = v
+                break
+        else:
+            v, src, dst = pend[0]
+            w = owner[dst]
+            emit('vswp\t%s, %s' % (q(src), q(dst)))
+            reg[v], reg[w] = dst, src
+            owner[dst], owner[src] = v, w
+    return out, len(slot)
+
+def best_round(dec, final, trials=1000, seed=1):
+    ops, ins, outs = round_ops(dec, final)
+    rng = random.Random(seed)
+    best = None
+    for t in range(trials):
+        temp = rng.choice([0.3, 0.6, 1.0, 1.5]) if t else 0
+        code, slots = allocate(schedule(ops, rng if t else None, temp),
+                               ins, outs)
+        if best is None or len(code) < len(best[0]):
+            best = (code, slots)
+    return best
+
+# ------------------------------------------------------------------ output
+
+SR = [j % 4 + 4 * ((j // 4 + j % 4) % 4) for j in range(16)]
+ISR = [j % 4 + 4 * ((j // 4 - j % 4) % 4) for j in range(16)]
+
+def swapmoves(out, pairs, n):
+    """for each (a, b): t = (b >> n ^ a) & mask; a ^= t; b ^= t << n"""
+    seqs = []
+    for (a, b), t in zip(pairs, (9, 10)):
+        seqs.append(['vshr.u64\tq%d, q%d, #%d' % (t, b, n),
+                     'veor\tq%d, q%d, q%d' % (t, t, a),
+                     'vand\tq%d, q%d, q8' % (t, t),
+                     'veor\tq%d, q%d, q%d' % (a, a, t),
+                     'vshl.i64\tq%d, q%d, #%d' % (t, t, n),
+                     'veor\tq%d, q%d, q%d' % (b, b, t)])
+    for group in zip(*seqs):
+        out.extend('\t\t' + s for s in group)
+
+def bitslice(out, rev=False):
+    """transpose bit b of the bytes of block k into bit k of plane b"""
+    stages = [(1, 0x55, [(1, 0), (3, 2), (5, 4), (7, 6)]),
+              (2, 0x33, [(2, 0), (3, 1), (6, 4), (7, 5)]),
+              (4, 0x0f, [(4, 0), (5, 1), (6, 2), (7, 3)])]
+    for n, mask, pairs in (stages[::-1] if rev else stages):
+        out.append('\t\tvmov.i8\tq8, #0x%02x' % mask)
+        swapmoves(out, pairs[:2], n)
+        swapmoves(out, pairs[2:], n)
+
+def function(name, dec, table, full, final, spill):
+    out = ['', '\t\t.align\t5', 'ENTRY(%s)' % name,
+           '\t\tvpush\t{d8-d15}',
+           '\t\tsub\tsp, sp, #%d' % spill,
+           '\t\tadr\tr12, %s' % table]
+    for lo in range(0, 16, 4):
+        out.append('\t\tvld1.8\t{d%d-d%d}, [r1]%s' %
+                   (lo, lo + 3, '!' if lo < 12 else ''))
+    bitslice(out)
+    for b in range(0, 8, 2):
+        out.append('\t\tvld1.8\t{d16-d19}, [r2 :128]!')
+        out.append('\t\tveor\tq%d, q%d, q8' % (b, b))
+        out.append('\t\tveor\tq%d, q%d, q9' % (b + 1, b + 1))
+    out.append('\t\tsub\tr3, r3, #1')
+    out.append('1:')
+    out += full
+    out.append('\t\tsubs\tr3, r3, #1')
+    out.append('\t\tbne\t1b')
+    out.append('')
+    out += final
+    bitslice(out, True)
+    for lo in range(0, 16, 4):
+        out.append('\t\tvst1.8\t{d%d-d%d}, [r0]%s' %
+                   (lo, lo + 3, '!' if lo < 12 else ''))
+    out += ['\t\tadd\tsp, sp, #%d' % spill,
+            '\t\tvpop\t{d8-d15}',
+            '\t\tmov\tpc, lr',
+            'ENDPROC(%s)' % name]
+    return out
+
+HEADER = """/*
+ *  linux/arch/arm/crypto/aesbs-core.S
+ *
+ *  NEON bit sliced AES on eight blocks at a time.  Generated by
+ *  aesbs-gen.py, which explains the layout; edit that instead.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/linkage.h>
+#include <asm/assembler.h>
+
+		.text
+		.fpu	neon
+
+/*
+ * void aesbs_encrypt8(u8 out[128], const u8 in[128], const u8 *bskey,
+ *		       int rounds)
+ * void aesbs_decrypt8(u8 out[128], const u8 in[128], const u8 *bskey,
+ *		       int rounds)
+ *
+ * bskey is 16 byte aligned and laid out by aesbs_convert_key().  in and
+ * out may be the same buffer.  Call between kernel_neon_begin() and
+ * kernel_neon_end() only.
+ */"""
+
+def table(label, idx):
+    return ['', '\t\t.align\t4', '%s:' % label,
+            '\t\t.byte\t' + ', '.join('%d' % i for i in idx[:8]),
+            '\t\t.byte\t' + ', '.join('%d' % i for i in idx[8:])]
+
+def main():
+    check_sboxes()
+    rounds = {}
+    for dec in (0, 1):
+        for final in (0, 1):
+            rounds[dec, final] = best_round(dec, final)
+    spill = 16 * max(s for c, s in rounds.values())
+    out = HEADER.split('\n')
+    out += table('.Lsr', SR)
+    out += function('aesbs_encrypt8', 0, '.Lsr', rounds[0, 0][0],
+                    rounds[0, 1][0], spill)
+    out += table('.Lisr', ISR)
+    out += function('aesbs_decrypt8', 1, '.Lisr', rounds[1, 0][0],
+                    rounds[1, 1][0], spill)
+    sys.stdout.write('\n'.join(out) + '\n')
+
+if __name__ == '__main__':
+    main()
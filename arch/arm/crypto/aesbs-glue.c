@@ -0,0 +1,474 @@
+/*
+ * Glue Code for the NEON bit sliced AES in aesbs-core.S
+ *
+ * The core only does eight blocks at a time and nothing but ECB, so the
+ * modes are done here around it: CBC decryption, CTR and XTS, which all
+ * have eight independent blocks to hand.  CBC encryption is serial and
+ * that, the tails and anything in interrupt context, where the NEON unit
+ * is off limits, go to the scalar code in aes-armv4.S.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/hardirq.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/b128ops.h>
+#include <crypto/gf128mul.h>
+#include <asm/aes.h>
+#include <asm/neon.h>
+
+#define AESBS_BLOCKS		8
+#define AESBS_BYTES		(AESBS_BLOCKS * AES_BLOCK_SIZE)
+
+/* eight planes of 16 bytes per round key, see aesbs_convert_key() */
+#define AESBS_KEY_BYTES		((14 + 1) * 8 * AES_BLOCK_SIZE)
+
+asmlinkage void aesbs_encrypt8(u8 out[], const u8 in[], const u8 *bskey,
+			       int rounds);
+asmlinkage void aesbs_decrypt8(u8 out[], const u8 in[], const u8 *bskey,
+			       int rounds);
+
+struct aesbs_ctx {
+	u8 bskey_enc[AESBS_KEY_BYTES] __aligned(16);
+	u8 bskey_dec[AESBS_KEY_BYTES] __aligned(16);
+	struct crypto_aes_ctx key;
+	int rounds;
+};
+
+struct aesbs_xts_ctx {
+	struct aesbs_ctx data;
+	struct crypto_aes_ctx tweak;
+};
+
+/*
+ * Byte j of plane b of a round key is 0xff where bit b of key byte j is
+ * set, so it can be xored straight into the bit sliced state.  The S-box
+ * circuits leave out the 0x63 of the affine transform; it goes into the
+ * key of every round that follows a SubBytes when encrypting and of every
+ * round that precedes one when decrypting.
+ */
+static void aesbs_convert_key(u8 *bskey, const u32 *rk, int rounds, bool dec)
+{
+	int r, j, b;
+
+	for (r = 0; r <= rounds; r++) {
+		for (j = 0; j < AES_BLOCK_SIZE; j++) {
+			u8 k = rk[4 * r + j / 4] >> (8 * (j % 4));
+
+			if (dec ? r < rounds : r > 0)
+				k ^= 0x63;
+			for (b = 0; b < 8; b++)
+				bskey[(8 * r + b) * AES_BLOCK_SIZE + j] =
+					(k >> b) & 1 ? 0xff : 0;
+		}
+	}
+}
+
+static int aesbs_expand_key(struct aesbs_ctx *ctx, const u8 *in_key,
+			    unsigned int key_len)
+{
+	int err;
+
+	err = crypto_aes_expand_key(&ctx->key, in_key, key_len);
+	if (err)
+		return err;
+
+	ctx->rounds = 6 + key_len / 4;
+	aesbs_convert_key(ctx->bskey_enc, ctx->key.key_enc, ctx->rounds, false);
+	aesbs_convert_key(ctx->bskey_dec, ctx->key.key_dec, ctx->rounds, true);
+	return 0;
+}
+
+static int aesbs_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			 unsigned int key_len)
+{
+	if (!aesbs_expand_key(crypto_tfm_ctx(tfm), in_key, key_len))
+		return 0;
+
+	tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+	return -EINVAL;
+}
+
+static int aesbs_xts_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	/* Key1 for the data and Key2 for the tweak, of equal size */
+	if (key_len % 2 ||
+	    aesbs_expand_key(&ctx->data, in_key, key_len / 2) ||
+	    crypto_aes_expand_key(&ctx->tweak, in_key + key_len / 2,
+				  key_len / 2)) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* worth saving the user's NEON registers for, and allowed to */
+static inline bool aesbs_use_neon(unsigned int nbytes)
+{
+	return nbytes >= AESBS_BYTES && !in_interrupt();
+}
+
+static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *wsrc = walk.src.virt.addr;
+		u8 *wdst = walk.dst.virt.addr;
+
+		do {
+			crypto_xor(walk.iv, wsrc, AES_BLOCK_SIZE);
+			crypto_aes_encrypt_arm(&ctx->key, walk.iv, walk.iv);
+			memcpy(wdst, walk.iv, AES_BLOCK_SIZE);
+			wsrc += AES_BLOCK_SIZE;
+			wdst += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+/* the next iv is only copied out after the last read of src */
+static void aesbs_cbc_decrypt8(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			       u8 *iv)
+{
+	u8 buf[AESBS_BYTES] __aligned(16);
+	int i;
+
+	aesbs_decrypt8(buf, src, ctx->bskey_dec, ctx->rounds);
+	crypto_xor(buf, iv, AES_BLOCK_SIZE);
+	for (i = 1; i < AESBS_BLOCKS; i++)
+		crypto_xor(buf + i * AES_BLOCK_SIZE,
+			   src + (i - 1) * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	memcpy(iv, src + AESBS_BYTES - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	memcpy(dst, buf, AESBS_BYTES);
+}
+
+static void aesbs_cbc_decrypt1(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			       u8 *iv)
+{
+	u8 buf[AES_BLOCK_SIZE] __aligned(4);
+
+	crypto_aes_decrypt_arm(&ctx->key, buf, src);
+	crypto_xor(buf, iv, AES_BLOCK_SIZE);
+	memcpy(iv, src, AES_BLOCK_SIZE);
+	memcpy(dst, buf, AES_BLOCK_SIZE);
+}
+
+static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *wsrc = walk.src.virt.addr;
+		u8 *wdst = walk.dst.virt.addr;
+
+		if (aesbs_use_neon(nbytes)) {
+			kernel_neon_begin();
+			do {
+				aesbs_cbc_decrypt8(ctx, wdst, wsrc, walk.iv);
+				wsrc += AESBS_BYTES;
+				wdst += AESBS_BYTES;
+			} while ((nbytes -= AESBS_BYTES) >= AESBS_BYTES);
+			kernel_neon_end();
+		}
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			aesbs_cbc_decrypt1(ctx, wdst, wsrc, walk.iv);
+			wsrc += AES_BLOCK_SIZE;
+			wdst += AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static void aesbs_ctr_crypt8(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			     u8 *ctrblk)
+{
+	u8 buf[AESBS_BYTES] __aligned(16);
+	int i;
+
+	for (i = 0; i < AESBS_BLOCKS; i++) {
+		memcpy(buf + i * AES_BLOCK_SIZE, ctrblk, AES_BLOCK_SIZE);
+		crypto_inc(ctrblk, AES_BLOCK_SIZE);
+	}
+	aesbs_encrypt8(buf, buf, ctx->bskey_enc, ctx->rounds);
+	crypto_xor(buf, src, AESBS_BYTES);
+	memcpy(dst, buf, AESBS_BYTES);
+}
+
+/* n is less than a block for the end of the request only */
+static void aesbs_ctr_crypt1(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			     u8 *ctrblk, unsigned int n)
+{
+	u8 keystream[AES_BLOCK_SIZE] __aligned(4);
+
+	crypto_aes_encrypt_arm(&ctx->key, keystream, ctrblk);
+	crypto_xor(keystream, src, n);
+	memcpy(dst, keystream, n);
+	crypto_inc(ctrblk, AES_BLOCK_SIZE);
+}
+
+static int aesbs_ctr_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *wsrc = walk.src.virt.addr;
+		u8 *wdst = walk.dst.virt.addr;
+
+		if (aesbs_use_neon(nbytes)) {
+			kernel_neon_begin();
+			do {
+				aesbs_ctr_crypt8(ctx, wdst, wsrc, walk.iv);
+				wsrc += AESBS_BYTES;
+				wdst += AESBS_BYTES;
+			} while ((nbytes -= AESBS_BYTES) >= AESBS_BYTES);
+			kernel_neon_end();
+		}
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			aesbs_ctr_crypt1(ctx, wdst, wsrc, walk.iv,
+					 AES_BLOCK_SIZE);
+			wsrc += AES_BLOCK_SIZE;
+			wdst += AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	if (walk.nbytes) {
+		aesbs_ctr_crypt1(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+				 walk.iv, walk.nbytes);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+
+	return err;
+}
+
+/* C = E(P ^ T) ^ T, with T multiplied by x in GF(2^128) for every block */
+static void aesbs_xts_crypt8(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			     be128 *t, bool enc)
+{
+	u8 buf[AESBS_BYTES] __aligned(16);
+	be128 tw[AESBS_BLOCKS];
+	int i;
+
+	for (i = 0; i < AESBS_BLOCKS; i++) {
+		tw[i] = *t;
+		gf128mul_x_ble(t, t);
+	}
+	memcpy(buf, src, AESBS_BYTES);
+	crypto_xor(buf, (u8 *)tw, AESBS_BYTES);
+	if (enc)
+		aesbs_encrypt8(buf, buf, ctx->bskey_enc, ctx->rounds);
+	else
+		aesbs_decrypt8(buf, buf, ctx->bskey_dec, ctx->rounds);
+	crypto_xor(buf, (u8 *)tw, AESBS_BYTES);
+	memcpy(dst, buf, AESBS_BYTES);
+}
+
+static void aesbs_xts_crypt1(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			     be128 *t, bool enc)
+{
+	u8 buf[AES_BLOCK_SIZE] __aligned(4);
+
+	memcpy(buf, src, AES_BLOCK_SIZE);
+	crypto_xor(buf, (u8 *)t, AES_BLOCK_SIZE);
+	if (enc)
+		crypto_aes_encrypt_arm(&ctx->key, buf, buf);
+	else
+		crypto_aes_decrypt_arm(&ctx->key, buf, buf);
+	crypto_xor(buf, (u8 *)t, AES_BLOCK_SIZE);
+	memcpy(dst, buf, AES_BLOCK_SIZE);
+	gf128mul_x_ble(t, t);
+}
+
+static int aesbs_xts_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, bool enc)
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	be128 t;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+	if (!walk.nbytes)
+		return err;
+
+	/* first value of T */
+	crypto_aes_encrypt_arm(&ctx->tweak, (u8 *)&t, walk.iv);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *wsrc = walk.src.virt.addr;
+		u8 *wdst = walk.dst.virt.addr;
+
+		if (aesbs_use_neon(nbytes)) {
+			kernel_neon_begin();
+			do {
+				aesbs_xts_crypt8(&ctx->data, wdst, wsrc, &t,
+						 enc);
+				wsrc += AESBS_BYTES;
+				wdst += AESBS_BYTES;
+			} while ((nbytes -= AESBS_BYTES) >= AESBS_BYTES);
+			kernel_neon_end();
+		}
+		for (; nbytes >= AES_BLOCK_SIZE; nbytes -= AES_BLOCK_SIZE) {
+			aesbs_xts_crypt1(&ctx->data, wdst, wsrc, &t, enc);
+			wsrc += AES_BLOCK_SIZE;
+			wdst += AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, true);
+}
+
+static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, false);
+}
+
+static struct crypto_alg aesbs_algs[] = { {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[0].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_cbc_encrypt,
+			.decrypt	= aesbs_cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[1].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_ctr_crypt,
+			.decrypt	= aesbs_ctr_crypt,
+		},
+	},
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_xts_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[2].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_set_key,
+			.encrypt	= aesbs_xts_encrypt,
+			.decrypt	= aesbs_xts_decrypt,
+		},
+	},
+} };
+
+static int __init aesbs_init(void)
+{
+	int i, err;
+
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	for (i = 0; i < ARRAY_SIZE(aesbs_algs); i++) {
+		err = crypto_register_alg(&aesbs_algs[i]);
+		if (err)
+			goto unregister;
+	}
+	return 0;
+
+unregister:
+	while (--i >= 0)
+		crypto_unregister_alg(&aesbs_algs[i]);
+	return err;
+}
+
+static void __exit aesbs_fini(void)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(aesbs_algs) - 1; i >= 0; i--)
+		crypto_unregister_alg(&aesbs_algs[i]);
+}
+
+module_init(aesbs_init);
+module_exit(aesbs_fini);
+
+MODULE_DESCRIPTION("AES in CBC, CTR and XTS modes, NEON bit sliced");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("cbc(aes)");
+MODULE_ALIAS("ctr(aes)");
+MODULE_ALIAS("xts(aes)");
@@ -0,0 +1,290 @@
+/*
+ * Glue Code for the NEON version of the CRC32c algorithm
+ *
+ * The NEON code does eight independent 64 byte lanes of each 512 byte
+ * block.  Their crcs are folded into the running one here, with a table
+ * that advances a crc over 64 zero bytes: crc(c, A | B) = crc(c, A)
+ * advanced over |B| bytes ^ crc(0, B).  Whatever does not fill a block
+ * goes to __crc32c_le().
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/crc32.h>
+#include <linux/hardirq.h>
+#include <linux/hrtimer.h>
+#include <linux/slab.h>
+#include <asm/byteorder.h>
+#include <asm/neon.h>
+
+#define CHKSUM_BLOCK_SIZE	1
+#define CHKSUM_DIGEST_SIZE	4
+
+#define CRC32C_LANE_SIZE	64
+#define CRC32C_NEON_BLOCK	(8 * CRC32C_LANE_SIZE)
+/* blocks per kernel_neon_begin(), which holds off preemption */
+#define CRC32C_NEON_BLOCKS	8
+
+/* the load time benchmark: runs of loops over bytes, the best run counts */
+#define CRC32C_BENCH_BYTES	4096
+#define CRC32C_BENCH_LOOPS	16
+#define CRC32C_BENCH_RUNS	3
+
+asmlinkage void crc32c_neon_lanes(__le32 *crcs, const u8 *data,
+				  unsigned int blocks, const u8 *tables);
+
+struct chksum_ctx {
+	u32 key;
+};
+
+struct chksum_desc_ctx {
+	u32 crc;
+};
+
+/* the nibble tables in byte planes, as crc32c_neon_lanes() wants them */
+static u8 crc32c_neon_tables[128] __read_mostly;
+/* crc32c_neon_shift_table[k][i]: i << 8 * k advanced over a lane */
+static u32 crc32c_neon_shift_table[4][256] __read_mostly;
+
+static inline u32 crc32c_neon_shift(u32 crc)
+{
+	return crc32c_neon_shift_table[0][crc & 0xff] ^
+	       crc32c_neon_shift_table[1][(crc >> 8) & 0xff] ^
+	       crc32c_neon_shift_table[2][(crc >> 16) & 0xff] ^
+	       crc32c_neon_shift_table[3][crc >> 24];
+}
+
+static u32 crc32c_neon(u32 crc, const u8 *data, unsigned int len)
+{
+	__le32 crcs[CRC32C_NEON_BLOCKS * 8];
+	unsigned int blocks, i;
+
+	while (len >= CRC32C_NEON_BLOCK) {
+		blocks = min_t(unsigned int, len / CRC32C_NEON_BLOCK,
+			       CRC32C_NEON_BLOCKS);
+		kernel_neon_begin();
+		crc32c_neon_lanes(crcs, data, blocks, crc32c_neon_tables);
+		kernel_neon_end();
+		for (i = 0; i < blocks * 8; i++)
+			crc = crc32c_neon_shift(crc) ^ le32_to_cpu(crcs[i]);
+		data += blocks * CRC32C_NEON_BLOCK;
+		len -= blocks * CRC32C_NEON_BLOCK;
+	}
+	return __crc32c_le(crc, data, len);
+}
+
+/* worth saving the user's NEON registers for, and allowed to */
+static u32 crc32c_arm(u32 crc, const u8 *data, unsigned int len)
+{
+	if (len >= CRC32C_NEON_BLOCK && !in_interrupt())
+		return crc32c_neon(crc, data, len);
+	return __crc32c_le(crc, data, len);
+}
+
+static int chksum_init(struct shash_desc *desc)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = mctx->key;
+
+	return 0;
+}
+
+static int chksum_setkey(struct crypto_shash *tfm, const u8 *key,
+			 unsigned int keylen)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(tfm);
+
+	if (keylen != sizeof(mctx->key)) {
+		crypto_shash_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	mctx->key = le32_to_cpu(*(__le32 *)key);
+	return 0;
+}
+
+static int chksum_update(struct shash_desc *desc, const u8 *data,
+			 unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = crc32c_arm(ctx->crc, data, length);
+	return 0;
+}
+
+static int chksum_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__le32 *)out = ~cpu_to_le32p(&ctx->crc);
+	return 0;
+}
+
+static int __chksum_finup(u32 *crcp, const u8 *data, unsigned int len, u8 *out)
+{
+	*(__le32 *)out = ~cpu_to_le32(crc32c_arm(*crcp, data, len));
+	return 0;
+}
+
+static int chksum_finup(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	return __chksum_finup(&ctx->crc, data, len, out);
+}
+
+static int chksum_digest(struct shash_desc *desc, const u8 *data,
+			 unsigned int length, u8 *out)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+
+	return __chksum_finup(&mctx->key, data, length, out);
+}
+
+static int crc32c_cra_init(struct crypto_tfm *tfm)
+{
+	struct chksum_ctx *mctx = crypto_tfm_ctx(tfm);
+
+	mctx->key = ~0;
+	return 0;
+}
+
+static struct shash_alg alg = {
+	.digestsize		=	CHKSUM_DIGEST_SIZE,
+	.setkey			=	chksum_setkey,
+	.init			=	chksum_init,
+	.update			=	chksum_update,
+	.final			=	chksum_final,
+	.finup			=	chksum_finup,
+	.digest			=	chksum_digest,
+	.descsize		=	sizeof(struct chksum_desc_ctx),
+	.base			=	{
+		.cra_name		=	"crc32c",
+		.cra_driver_name	=	"crc32c-neon",
+		.cra_priority		=	200,
+		.cra_blocksize		=	CHKSUM_BLOCK_SIZE,
+		.cra_alignmask		=	3,
+		.cra_ctxsize		=	sizeof(struct chksum_ctx),
+		.cra_module		=	THIS_MODULE,
+		.cra_init		=	crc32c_cra_init,
+	}
+};
+
+static void __init crc32c_neon_init_tables(void)
+{
+	static const u8 zeroes[CRC32C_LANE_SIZE] __initconst;
+	u32 lo, hi;
+	u8 x;
+	int i, k;
+
+	/* T[x] is the crc of the byte x from a zero seed */
+	for (i = 0; i < 16; i++) {
+		x = i;
+		lo = __crc32c_le(0, &x, 1);
+		x = i << 4;
+		hi = __crc32c_le(0, &x, 1);
+		for (k = 0; k < 4; k++) {
+			crc32c_neon_tables[16 * k + i] = lo >> (8 * k);
+			crc32c_neon_tables[64 + 16 * k + i] = hi >> (8 * k);
+		}
+	}
+
+	for (k = 0; k < 4; k++)
+		for (i = 0; i < 256; i++)
+			crc32c_neon_shift_table[k][i] =
+				__crc32c_le(i << (8 * k), zeroes,
+					    CRC32C_LANE_SIZE);
+}
+
+/* the best of CRC32C_BENCH_RUNS, in ns, with the crc of the last one */
+static s64 __init crc32c_neon_bench(u32 (*fn)(u32, const u8 *, unsigned int),
+				    const u8 *buf, u32 *crcp)
+{
+	s64 best = KTIME_MAX, t;
+	ktime_t start;
+	u32 crc;
+	int run, i;
+
+	for (run = 0; run < CRC32C_BENCH_RUNS; run++) {
+		crc = ~0;
+		start = ktime_get();
+		for (i = 0; i < CRC32C_BENCH_LOOPS; i++)
+			crc = fn(crc, buf, CRC32C_BENCH_BYTES);
+		t = ktime_to_ns(ktime_sub(ktime_get(), start));
+		best = min(best, t);
+	}
+	*crcp = crc;
+	return best;
+}
+
+static u32 __init crc32c_generic(u32 crc, const u8 *data, unsigned int len)
+{
+	return __crc32c_le(crc, data, len);
+}
+
+/*
+ * Time the NEON code against the slice by 8 one, which is what the user
+ * gets without us, and get out of the way if it does not win.
+ */
+static int __init crc32c_neon_select(void)
+{
+	s64 t_neon, t_generic;
+	u32 crc_neon, crc_generic;
+	u8 *buf;
+	int i;
+
+	buf = kmalloc(CRC32C_BENCH_BYTES, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < CRC32C_BENCH_BYTES; i++)
+		buf[i] = i * 13 + (i >> 8);
+
+	t_generic = crc32c_neon_bench(crc32c_generic, buf, &crc_generic);
+	t_neon = crc32c_neon_bench(crc32c_neon, buf, &crc_neon);
+	kfree(buf);
+
+	if (crc_neon != crc_generic) {
+		pr_err("crc32c-neon: self test failed\n");
+		return -ENODEV;
+	}
+	pr_info("crc32c-neon: %lld ns for %d bytes, generic %lld ns\n",
+		t_neon, CRC32C_BENCH_BYTES * CRC32C_BENCH_LOOPS, t_generic);
+	if (t_neon >= t_generic)
+		return -ENODEV;
+	return 0;
+}
+
+static int __init crc32c_neon_mod_init(void)
+{
+	int err;
+
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	crc32c_neon_init_tables();
+	err = crc32c_neon_select();
+	if (err)
+		return err;
+
+	return crypto_register_shash(&alg);
+}
+
+static void __exit crc32c_neon_mod_fini(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(crc32c_neon_mod_init);
+module_exit(crc32c_neon_mod_fini);
+
+MODULE_DESCRIPTION("CRC32c (Castagnoli) calculations, NEON table driven");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("crc32c");
@@ -0,0 +1,57 @@
+/*
+ * arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+/* memcpy() sizes from which NEON pays for saving the user's registers */
+#define NEON_COPY_MIN		1024
+
+/* csum_partial() sizes from which the NEON loop is used */
+#define NEON_CSUM_MIN		512
+
+#ifndef __ASSEMBLY__
+
+#include <linux/types.h>
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * Kernel code may only touch the NEON registers between these two, which
+ * disable preemption. They must not be used in interrupt context.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#ifdef CONFIG_ARM_NEON_COPY
+/* set once the VFP support code is up and found NEON */
+extern bool arm_neon_copy_ready;
+
+void *__memcpy_arm(void *to, const void *from, size_t n);
+void __memcpy_neon(void *to, const void *from, size_t n);
+void __copy_page_arm(void *to, const void *from);
+void __copy_page_neon(void *to, const void *from);
+void __clear_page_neon(void *page);
+#endif
+
+#ifdef CONFIG_ARM_NEON_CSUM
+/* set once the VFP support code is up and found NEON */
+extern bool arm_neon_csum_ready;
+
+__wsum __csum_partial_arm(const void *buff, int len, __wsum sum);
+__wsum __csum_partial_copy_arm(const void *src, void *dst, int len,
+			       __wsum sum);
+/* len is a non-zero multiple of 64 */
+__wsum __csum_partial_neon(const void *buff, int len, __wsum sum);
+__wsum __csum_partial_copy_neon(const void *src, void *dst, int len,
+				__wsum sum);
+#endif
+
+#endif /* __ASSEMBLY__ */
+
+#endif
@@ -12,6 +12,7 @@
  */
 #define pr_fmt(fmt) "hw perfevents: " fmt
 
+#include <linux/cpu.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
@@ -20,6 +21,7 @@
 #include <linux/spinlock.h>
 #include <linux/uaccess.h>
 
+#include <asm/cpu_pm.h>
 #include <asm/cputype.h>
 #include <asm/irq.h>
 #include <asm/irq_regs.h>
@@ -625,6 +627,107 @@ static struct pmu pmu = {
 #include "perf_event_v6.c"
 #include "perf_event_v7.c"
 
+/*
+ * The PMU loses its state whenever the cpu is power gated: in LP2, across
+ * a cluster switch and over hot unplug. Fold the counts of the running
+ * events into the perf event before that happens and program them again
+ * afterwards. A counter that overflowed with interrupts off is accounted
+ * for here; only its sample is lost.
+ */
+static void
+armpmu_save_events(struct cpu_hw_events *cpuc)
+{
+	int idx;
+
+	armpmu->stop();
+
+	for (idx = 0; idx <= armpmu->num_events; ++idx) {
+		struct perf_event *event = cpuc->events[idx];
+		struct hw_perf_event *hwc;
+		u64 prev;
+
+		if (!event || !test_bit(idx, cpuc->active_mask))
+			continue;
+
+		hwc = &event->hw;
+		if (hwc->state & PERF_HES_STOPPED)
+			continue;
+
+		armpmu->disable(hwc, idx);
+		prev = local64_read(&hwc->prev_count) & armpmu->max_period;
+		armpmu_event_update(event, hwc, idx,
+				    armpmu->read_counter(idx) < prev);
+	}
+}
+
+static void
+armpmu_restore_events(struct cpu_hw_events *cpuc)
+{
+	int idx, enabled = 0;
+
+	armpmu->reset(NULL);
+
+	for (idx = 0; idx <= armpmu->num_events; ++idx) {
+		struct perf_event *event = cpuc->events[idx];
+
+		if (!event || !test_bit(idx, cpuc->active_mask))
+			continue;
+		if (event->hw.state & PERF_HES_STOPPED)
+			continue;
+
+		armpmu_event_set_period(event, &event->hw, idx);
+		armpmu->enable(&event->hw, idx);
+		enabled = 1;
+	}
+
+	if (enabled)
+		armpmu->start();
+}
+
+static int
+armpmu_cpu_pm_notify(struct notifier_block *nb, unsigned long action,
+		     void *v)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+
+	if (!armpmu || !armpmu->reset || !atomic_read(&active_events))
+		return NOTIFY_OK;
+
+	switch (action) {
+	case CPU_PM_ENTER:
+		armpmu_save_events(cpuc);
+		break;
+	case CPU_PM_ENTER_FAILED:
+	case CPU_PM_EXIT:
+		armpmu_restore_events(cpuc);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block armpmu_cpu_pm_notifier = {
+	.notifier_call = armpmu_cpu_pm_notify,
+};
+
+/*
+ * A cpu coming online has a PMU in an unknown state, which may well have
+ * counters and overflow interrupts enabled. Reset it before anything is
+ * scheduled there.
+ */
+static int __cpuinit
+armpmu_cpu_notify(struct notifier_block *nb, unsigned long action,
+		  void *hcpu)
+{
+	if ((action & ~CPU_TASKS_FROZEN) != CPU_STARTING)
+		return NOTIFY_DONE;
+
+	if (armpmu && armpmu->reset)
+		armpmu->reset(NULL);
+
+	return NOTIFY_OK;
+}
+
 /*
  * Ensure the PMU has sane values out of reset.
  * This requires SMP to be available, so exists as a separate initcall.
@@ -691,6 +794,11 @@ init_hw_perf_events(void)
 
 	perf_pmu_register(&pmu, "cpu", PERF_TYPE_RAW);
 
+	if (armpmu) {
+		cpu_pm_register_notifier(&armpmu_cpu_pm_notifier);
+		perf_cpu_notifier(armpmu_cpu_notify);
+	}
+
 	return 0;
 }
 early_initcall(init_hw_perf_events);
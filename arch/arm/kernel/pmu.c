@@ -12,6 +12,7 @@
 
 #define pr_fmt(fmt) "PMU: " fmt
 
+#include <linux/cpu.h>
 #include <linux/cpumask.h>
 #include <linux/err.h>
 #include <linux/interrupt.h>
@@ -172,7 +173,13 @@ init_cpu_pmu(void)
 	if (irqs == 1 && !irq_can_set_affinity(platform_get_irq(pdev, 0)))
 		return 0;
 
+	/*
+	 * Offline cpus cannot take an affinity; their interrupt is routed
+	 * when they come up, see pmu_cpu_notify().
+	 */
 	for (i = 0; i < irqs; ++i) {
+		if (irqs > 1 && !cpu_online(i))
+			continue;
 		err = set_irq_affinity(platform_get_irq(pdev, i), i);
 		if (err)
 			break;
@@ -181,6 +188,38 @@ init_cpu_pmu(void)
 	return err;
 }
 
+/*
+ * A per-cpu PMU interrupt is moved off its cpu on hot unplug. Send it back
+ * when the cpu returns while the PMU is in use, or overflows of that cpu's
+ * counters are taken on another core and the samples go missing.
+ */
+static int __cpuinit
+pmu_cpu_notify(struct notifier_block *nb, unsigned long action, void *hcpu)
+{
+	struct platform_device *pdev = pmu_devices[ARM_PMU_DEVICE_CPU];
+	unsigned int cpu = (unsigned long)hcpu;
+
+	if ((action & ~CPU_TASKS_FROZEN) != CPU_ONLINE)
+		return NOTIFY_OK;
+
+	if (pdev && test_bit(ARM_PMU_DEVICE_CPU, &pmu_lock) &&
+	    pdev->num_resources > 1 && cpu < pdev->num_resources)
+		set_irq_affinity(platform_get_irq(pdev, cpu), cpu);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __cpuinitdata pmu_cpu_notifier = {
+	.notifier_call = pmu_cpu_notify,
+};
+
+static int __init register_pmu_cpu_notifier(void)
+{
+	register_cpu_notifier(&pmu_cpu_notifier);
+	return 0;
+}
+core_initcall(register_pmu_cpu_notifier);
+
 int
 init_pmu(enum arm_pmu_type type)
 {
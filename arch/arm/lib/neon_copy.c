@@ -0,0 +1,71 @@
+/*
+ *  linux/arch/arm/lib/neon_copy.c
+ *
+ *  Large memcpy(), copy_page() and clear_page() through NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/hardirq.h>
+#include <asm/page.h>
+#include <asm/neon.h>
+
+bool arm_neon_copy_ready;
+
+/*
+ * The NEON registers are only ours outside of interrupts: an interrupt
+ * could arrive in the middle of another kernel NEON user.
+ */
+static inline bool neon_copy_usable(void)
+{
+	return arm_neon_copy_ready && !in_interrupt();
+}
+
+/* memcpy() branches here for NEON_COPY_MIN bytes and more */
+void *memcpy_large(void *to, const void *from, size_t n)
+{
+	if (!neon_copy_usable())
+		return __memcpy_arm(to, from, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(to, from, n);
+	kernel_neon_end();
+	return to;
+}
+
+void copy_page(void *to, const void *from)
+{
+	if (!neon_copy_usable()) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__copy_page_neon(to, from);
+	kernel_neon_end();
+}
+
+void clear_page(void *page)
+{
+	if (!neon_copy_usable()) {
+		memset(page, 0, PAGE_SIZE);
+		return;
+	}
+
+	kernel_neon_begin();
+	__clear_page_neon(page);
+	kernel_neon_end();
+}
+EXPORT_SYMBOL(clear_page);
+
+/* for the self-test */
+EXPORT_SYMBOL_GPL(__memcpy_arm);
+EXPORT_SYMBOL_GPL(__memcpy_neon);
+EXPORT_SYMBOL_GPL(__copy_page_arm);
+EXPORT_SYMBOL_GPL(__copy_page_neon);
+EXPORT_SYMBOL_GPL(__clear_page_neon);
@@ -0,0 +1,185 @@
+/*
+ *  linux/arch/arm/lib/neon_copy_test.c
+ *
+ *  Checks the NEON copy routines against the integer ones and prints how
+ *  much faster they are, then refuses to stay loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <asm/page.h>
+#include <asm/neon.h>
+
+#define BUF_SIZE	(512 * 1024)
+#define BENCH_BYTES	(64 * 1024 * 1024)	/* moved per measurement */
+
+static u8 *src, *dst, *ref;
+
+static void neon_memcpy(void *to, const void *from, size_t n)
+{
+	kernel_neon_begin();
+	__memcpy_neon(to, from, n);
+	kernel_neon_end();
+}
+
+static void arm_memcpy(void *to, const void *from, size_t n)
+{
+	__memcpy_arm(to, from, n);
+}
+
+static void neon_copy_page(void *to, const void *from, size_t n)
+{
+	kernel_neon_begin();
+	__copy_page_neon(to, from);
+	kernel_neon_end();
+}
+
+static void arm_copy_page(void *to, const void *from, size_t n)
+{
+	__copy_page_arm(to, from);
+}
+
+static void neon_clear_page(void *to, const void *from, size_t n)
+{
+	kernel_neon_begin();
+	__clear_page_neon(to);
+	kernel_neon_end();
+}
+
+static void arm_clear_page(void *to, const void *from, size_t n)
+{
+	memset(to, 0, PAGE_SIZE);
+}
+
+/* every length and misalignment the tail and head code can see */
+static int __init check_memcpy(void)
+{
+	unsigned int so, dof;
+	size_t n;
+
+	for (n = 64; n < 64 + 3 * 64; n++) {
+		for (so = 0; so < 8; so++) {
+			for (dof = 0; dof < 8; dof++) {
+				memset(dst, 0x5a, n + 16);
+				memset(ref, 0x5a, n + 16);
+				arm_memcpy(ref + dof, src + so, n);
+				neon_memcpy(dst + dof, src + so, n);
+				if (memcmp(dst, ref, n + 16)) {
+					pr_err("neon_copy_test: memcpy of %zu "
+					       "from +%u to +%u differs\n",
+					       n, so, dof);
+					return -EINVAL;
+				}
+			}
+		}
+	}
+
+	neon_memcpy(dst, src, BUF_SIZE);
+	if (memcmp(dst, src, BUF_SIZE)) {
+		pr_err("neon_copy_test: memcpy of %u differs\n", BUF_SIZE);
+		return -EINVAL;
+	}
+
+	neon_copy_page(dst, src, PAGE_SIZE);
+	if (memcmp(dst, src, PAGE_SIZE)) {
+		pr_err("neon_copy_test: copy_page differs\n");
+		return -EINVAL;
+	}
+
+	memset(ref, 0, PAGE_SIZE);
+	neon_clear_page(dst, NULL, PAGE_SIZE);
+	if (memcmp(dst, ref, PAGE_SIZE)) {
+		pr_err("neon_copy_test: clear_page left data\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* MB/s of fn moving BENCH_BYTES in pieces of n, walking the buffers */
+static unsigned long __init bench(void (*fn)(void *, const void *, size_t),
+				  size_t n)
+{
+	unsigned long done = 0, off = 0;
+	ktime_t start;
+	s64 us;
+
+	start = ktime_get();
+	while (done < BENCH_BYTES) {
+		fn(dst + off, src + off, n);
+		done += n;
+		off += n;
+		if (off + n > BUF_SIZE)
+			off = 0;
+		cond_resched();
+	}
+	us = ktime_us_delta(ktime_get(), start);
+
+	return us > 0 ? BENCH_BYTES / (unsigned long)us : 0;
+}
+
+static void __init report(const char *what, size_t n,
+			  void (*arm)(void *, const void *, size_t),
+			  void (*neon)(void *, const void *, size_t))
+{
+	unsigned long a = bench(arm, n);
+	unsigned long b = bench(neon, n);
+
+	pr_info("neon_copy_test: %-10s %7zu: arm %5lu MB/s, neon %5lu MB/s, "
+		"x%lu.%02lu\n", what, n, a, b,
+		a ? b / a : 0, a ? (b * 100 / a) % 100 : 0);
+}
+
+static int __init neon_copy_test_init(void)
+{
+	static const size_t sizes[] __initconst = {
+		256, 1024, 4096, 16384, 65536, 262144,
+	};
+	unsigned int i;
+	int ret;
+
+	if (!arm_neon_copy_ready) {
+		pr_info("neon_copy_test: no NEON\n");
+		return -ENODEV;
+	}
+
+	src = vmalloc(BUF_SIZE);
+	dst = vmalloc(BUF_SIZE + 64);
+	ref = vmalloc(BUF_SIZE + 64);
+	ret = -ENOMEM;
+	if (!src || !dst || !ref)
+		goto out;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		src[i] = i * 7 + (i >> 9);
+
+	ret = check_memcpy();
+	if (ret)
+		goto out;
+	pr_info("neon_copy_test: results match\n");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		report("memcpy", sizes[i], arm_memcpy, neon_memcpy);
+	report("copy_page", PAGE_SIZE, arm_copy_page, neon_copy_page);
+	report("clear_page", PAGE_SIZE, arm_clear_page, neon_clear_page);
+
+	/* nothing to keep around */
+	ret = -EAGAIN;
+out:
+	vfree(src);
+	vfree(dst);
+	vfree(ref);
+	return ret;
+}
+module_init(neon_copy_test_init);
+
+MODULE_DESCRIPTION("NEON memcpy/copy_page/clear_page self-test");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,70 @@
+/*
+ *  linux/arch/arm/lib/neon_csum.c
+ *
+ *  csum_partial() and csum_partial_copy_nocheck() of large buffers
+ *  through NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/hardirq.h>
+#include <net/checksum.h>
+#include <asm/neon.h>
+
+bool arm_neon_csum_ready;
+
+/*
+ * Most receive checksums are done in softirq context and stay on the
+ * integer code; the NEON loop helps the ones done when the data is
+ * copied to the reader, and the transmit side.
+ */
+static inline bool neon_csum_usable(void)
+{
+	return arm_neon_csum_ready && !in_interrupt();
+}
+
+/*
+ * The NEON loop does the multiple of 64 bytes. The tail starts at an
+ * even offset, so the integer routine can simply carry on from its sum.
+ */
+
+/* csum_partial() branches here for NEON_CSUM_MIN bytes and more */
+__wsum csum_partial_large(const void *buff, int len, __wsum sum)
+{
+	int bulk = len & ~63;
+
+	if (!neon_csum_usable())
+		return __csum_partial_arm(buff, len, sum);
+
+	kernel_neon_begin();
+	sum = __csum_partial_neon(buff, bulk, sum);
+	kernel_neon_end();
+
+	return __csum_partial_arm(buff + bulk, len - bulk, sum);
+}
+
+/* and csum_partial_copy_nocheck() here */
+__wsum csum_partial_copy_large(const void *src, void *dst, int len,
+			       __wsum sum)
+{
+	int bulk = len & ~63;
+
+	if (!neon_csum_usable())
+		return __csum_partial_copy_arm(src, dst, len, sum);
+
+	kernel_neon_begin();
+	sum = __csum_partial_copy_neon(src, dst, bulk, sum);
+	kernel_neon_end();
+
+	return __csum_partial_copy_arm(src + bulk, dst + bulk, len - bulk, sum);
+}
+
+/* for the self-test */
+EXPORT_SYMBOL_GPL(__csum_partial_arm);
+EXPORT_SYMBOL_GPL(__csum_partial_copy_arm);
+EXPORT_SYMBOL_GPL(__csum_partial_neon);
+EXPORT_SYMBOL_GPL(__csum_partial_copy_neon);
@@ -0,0 +1,201 @@
+/*
+ *  linux/arch/arm/lib/neon_csum_test.c
+ *
+ *  Checks the NEON checksum routines against the integer ones and prints
+ *  how much faster they are, then refuses to stay loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <net/checksum.h>
+#include <asm/neon.h>
+
+#define BUF_SIZE	(256 * 1024)
+#define BENCH_BYTES	(64 * 1024 * 1024)	/* summed per measurement */
+
+static u8 *src, *dst, *ref;
+
+/* what csum_partial_large() does, without the size and context checks */
+static __wsum neon_csum(const void *from, void *to, int len, __wsum sum)
+{
+	int bulk = len & ~63;
+
+	if (bulk) {
+		kernel_neon_begin();
+		sum = __csum_partial_neon(from, bulk, sum);
+		kernel_neon_end();
+	}
+	return __csum_partial_arm(from + bulk, len - bulk, sum);
+}
+
+static __wsum arm_csum(const void *from, void *to, int len, __wsum sum)
+{
+	return __csum_partial_arm(from, len, sum);
+}
+
+static __wsum neon_csum_copy(const void *from, void *to, int len,
+			     __wsum sum)
+{
+	int bulk = len & ~63;
+
+	if (bulk) {
+		kernel_neon_begin();
+		sum = __csum_partial_copy_neon(from, to, bulk, sum);
+		kernel_neon_end();
+	}
+	return __csum_partial_copy_arm(from + bulk, to + bulk, len - bulk,
+				       sum);
+}
+
+static __wsum arm_csum_copy(const void *from, void *to, int len, __wsum sum)
+{
+	return __csum_partial_copy_arm(from, to, len, sum);
+}
+
+/* the routines may return different, but congruent, 32 bit sums */
+static bool __init csum_same(__wsum a, __wsum b)
+{
+	return (__force u32)a % 0xffff == (__force u32)b % 0xffff;
+}
+
+/* every length, misalignment and seed the tail and fold code can see */
+static int __init check_csum(void)
+{
+	static const u32 seeds[] __initconst = {
+		0, 1, 0xffff, 0x8000ffff, 0xffffffff,
+	};
+	unsigned int so, dof, i;
+	__wsum a, b;
+	int n;
+
+	for (n = 0; n < 64 + 3 * 64; n++) {
+		for (so = 0; so < 8; so++) {
+			for (dof = 0; dof < 4; dof++) {
+				for (i = 0; i < ARRAY_SIZE(seeds); i++) {
+					__wsum seed = (__force __wsum)seeds[i];
+
+					a = arm_csum(src + so, NULL, n, seed);
+					b = neon_csum(src + so, NULL, n, seed);
+					if (!csum_same(a, b)) {
+						pr_err("neon_csum_test: csum of "
+						       "%d at +%u differs\n",
+						       n, so);
+						return -EINVAL;
+					}
+
+					memset(dst, 0x5a, n + 16);
+					b = neon_csum_copy(src + so, dst + dof,
+							   n, seed);
+					if (!csum_same(a, b) ||
+					    memcmp(dst + dof, src + so, n)) {
+						pr_err("neon_csum_test: copy of "
+						       "%d from +%u to +%u "
+						       "differs\n", n, so, dof);
+						return -EINVAL;
+					}
+				}
+			}
+		}
+	}
+
+	/* enough all-ones data to carry out of a 32 bit accumulator */
+	memset(ref, 0xff, BUF_SIZE);
+	a = arm_csum(ref, NULL, BUF_SIZE, 0);
+	b = neon_csum(ref, NULL, BUF_SIZE, 0);
+	if (!csum_same(a, b)) {
+		pr_err("neon_csum_test: csum of %u ones differs\n", BUF_SIZE);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* MB/s of fn summing BENCH_BYTES in pieces of n, walking the buffers */
+static unsigned long __init bench(__wsum (*fn)(const void *, void *, int,
+					       __wsum), int n)
+{
+	unsigned long done = 0, off = 0;
+	__wsum sum = 0;
+	ktime_t start;
+	s64 us;
+
+	start = ktime_get();
+	while (done < BENCH_BYTES) {
+		sum = fn(src + off, dst + off, n, sum);
+		done += n;
+		off += n;
+		if (off + n > BUF_SIZE)
+			off = 0;
+		cond_resched();
+	}
+	us = ktime_us_delta(ktime_get(), start);
+
+	return us > 0 ? BENCH_BYTES / (unsigned long)us : 0;
+}
+
+static void __init report(const char *what, int n,
+			  __wsum (*arm)(const void *, void *, int, __wsum),
+			  __wsum (*neon)(const void *, void *, int, __wsum))
+{
+	unsigned long a = bench(arm, n);
+	unsigned long b = bench(neon, n);
+
+	pr_info("neon_csum_test: %-9s %5d: arm %5lu MB/s, neon %5lu MB/s, "
+		"x%lu.%02lu\n", what, n, a, b,
+		a ? b / a : 0, a ? (b * 100 / a) % 100 : 0);
+}
+
+static int __init neon_csum_test_init(void)
+{
+	/* around the cut over, standard and jumbo frames */
+	static const int sizes[] __initconst = {
+		256, NEON_CSUM_MIN, 576, 1460, 1500, 4096, 9000,
+	};
+	unsigned int i;
+	int ret;
+
+	if (!arm_neon_csum_ready) {
+		pr_info("neon_csum_test: no NEON\n");
+		return -ENODEV;
+	}
+
+	src = vmalloc(BUF_SIZE + 64);
+	dst = vmalloc(BUF_SIZE + 64);
+	ref = vmalloc(BUF_SIZE);
+	ret = -ENOMEM;
+	if (!src || !dst || !ref)
+		goto out;
+
+	for (i = 0; i < BUF_SIZE + 64; i++)
+		src[i] = i * 7 + (i >> 9);
+
+	ret = check_csum();
+	if (ret)
+		goto out;
+	pr_info("neon_csum_test: results match\n");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		report("csum", sizes[i], arm_csum, neon_csum);
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		report("csum_copy", sizes[i], arm_csum_copy, neon_csum_copy);
+
+	/* nothing to keep around */
+	ret = -EAGAIN;
+out:
+	vfree(src);
+	vfree(dst);
+	vfree(ref);
+	return ret;
+}
+module_init(neon_csum_test_init);
+
+MODULE_DESCRIPTION("NEON csum_partial/csum_partial_copy self-test");
+MODULE_LICENSE("GPL");
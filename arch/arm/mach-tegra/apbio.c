@@ -22,6 +22,7 @@
 #include <linux/completion.h>
 #include <linux/sched.h>
 #include <linux/mutex.h>
+#include <linux/string.h>
 
 #include <mach/dma.h>
 #include <mach/iomap.h>
@@ -32,6 +33,8 @@ static DEFINE_MUTEX(tegra_apb_dma_lock);
 
 #if defined(CONFIG_TEGRA_SYSTEM_DMA) && defined(CONFIG_ARCH_TEGRA_2x_SOC)
 static struct tegra_dma_channel *tegra_apb_dma;
+#define APB_BB_WORDS	(PAGE_SIZE / sizeof(u32))
+
 static u32 *tegra_apb_bb;
 static dma_addr_t tegra_apb_bb_phys;
 static DECLARE_COMPLETION(tegra_apb_wait);
@@ -49,95 +52,144 @@ static void cancel_dma(struct tegra_dma_channel *dma_chan,
 			req->complete(req);
 }
 
-static inline u32 apb_readl(unsigned long offset)
+/*
+ * Move up to one bounce buffer worth of words between the APB address
+ * and the bounce buffer in a single descriptor. With fixed set the APB
+ * side does not increment, which is what register FIFOs want; otherwise
+ * a contiguous register range is covered. Called with the lock held.
+ */
+static int apb_dma_xfer(unsigned long offset, unsigned int words,
+		bool to_memory, bool fixed)
 {
 	struct tegra_dma_req req;
 	int ret;
 
-	if (!tegra_apb_dma)
-		return readl(IO_TO_VIRT(offset));
-
-	mutex_lock(&tegra_apb_dma_lock);
+	memset(&req, 0, sizeof(req));
 	req.complete = apb_dma_complete;
-	req.to_memory = 1;
-	req.dest_addr = tegra_apb_bb_phys;
-	req.dest_bus_width = 32;
-	req.dest_wrap = 1;
-	req.source_addr = offset;
+	req.to_memory = to_memory;
+	if (to_memory) {
+		req.source_addr = offset;
+		req.source_wrap = fixed ? 4 : 0;
+		req.dest_addr = tegra_apb_bb_phys;
+		req.dest_wrap = 0;
+	} else {
+		req.source_addr = tegra_apb_bb_phys;
+		req.source_wrap = 0;
+		req.dest_addr = offset;
+		req.dest_wrap = fixed ? 4 : 0;
+	}
 	req.source_bus_width = 32;
-	req.source_wrap = 4;
+	req.dest_bus_width = 32;
 	req.req_sel = 0;
-	req.size = 4;
-	dma_sync_single_for_device(NULL, tegra_apb_bb_phys,
-			sizeof(u32), DMA_FROM_DEVICE);
+	req.size = words * sizeof(u32);
 
 	INIT_COMPLETION(tegra_apb_wait);
 
+	dma_sync_single_for_device(NULL, tegra_apb_bb_phys, req.size,
+			to_memory ? DMA_FROM_DEVICE : DMA_TO_DEVICE);
 	tegra_dma_enqueue_req(tegra_apb_dma, &req);
 
 	ret = wait_for_completion_timeout(&tegra_apb_wait,
 		msecs_to_jiffies(400));
 
-	if (WARN(ret == 0, "apb read dma timed out")) {
+	if (WARN(ret == 0, "apb %s dma timed out",
+		 to_memory ? "read" : "write")) {
 		cancel_dma(tegra_apb_dma, &req);
-		*(u32 *)tegra_apb_bb = 0;
+		if (to_memory)
+			memset(tegra_apb_bb, 0, req.size);
+		ret = -ETIMEDOUT;
+	} else {
+		ret = 0;
 	}
 
-	dma_sync_single_for_cpu(NULL, tegra_apb_bb_phys,
-			sizeof(u32), DMA_FROM_DEVICE);
-	mutex_unlock(&tegra_apb_dma_lock);
-	return *((u32 *)tegra_apb_bb);
+	if (to_memory)
+		dma_sync_single_for_cpu(NULL, tegra_apb_bb_phys, req.size,
+				DMA_FROM_DEVICE);
+	return ret;
 }
 
-
-static inline void apb_writel(u32 value, unsigned long offset)
+static void apb_read(unsigned long offset, u32 *buf, unsigned int count,
+		bool fixed)
 {
-	struct tegra_dma_req req;
-	int ret;
+	unsigned int words;
+	unsigned int i;
 
 	if (!tegra_apb_dma) {
-		writel(value, IO_TO_VIRT(offset));
+		for (i = 0; i < count; i++)
+			buf[i] = readl(IO_TO_VIRT(offset + (fixed ? 0 : i * 4)));
 		return;
 	}
 
 	mutex_lock(&tegra_apb_dma_lock);
-	dma_sync_single_for_cpu(NULL, tegra_apb_bb_phys,
-			sizeof(u32), DMA_TO_DEVICE);
-	*((u32 *)tegra_apb_bb) = value;
-	req.complete = apb_dma_complete;
-	req.to_memory = 0;
-	req.dest_addr = offset;
-	req.dest_wrap = 4;
-	req.dest_bus_width = 32;
-	req.source_addr = tegra_apb_bb_phys;
-	req.source_bus_width = 32;
-	req.source_wrap = 1;
-	req.req_sel = 0;
-	req.size = 4;
-
-	INIT_COMPLETION(tegra_apb_wait);
-
-	dma_sync_single_for_device(NULL, tegra_apb_bb_phys,
-			sizeof(u32), DMA_TO_DEVICE);
-	tegra_dma_enqueue_req(tegra_apb_dma, &req);
+	while (count) {
+		words = min_t(unsigned int, count, APB_BB_WORDS);
+		apb_dma_xfer(offset, words, true, fixed);
+		memcpy(buf, tegra_apb_bb, words * sizeof(u32));
+		if (!fixed)
+			offset += words * sizeof(u32);
+		buf += words;
+		count -= words;
+	}
+	mutex_unlock(&tegra_apb_dma_lock);
+}
 
-	ret = wait_for_completion_timeout(&tegra_apb_wait,
-		msecs_to_jiffies(400));
+static void apb_write(unsigned long offset, const u32 *buf,
+		unsigned int count)
+{
+	unsigned int words;
+	unsigned int i;
 
-	if (WARN(ret == 0, "apb write dma timed out"))
-		cancel_dma(tegra_apb_dma, &req);
+	if (!tegra_apb_dma) {
+		for (i = 0; i < count; i++)
+			writel(buf[i], IO_TO_VIRT(offset + i * 4));
+		return;
+	}
 
+	mutex_lock(&tegra_apb_dma_lock);
+	while (count) {
+		words = min_t(unsigned int, count, APB_BB_WORDS);
+		dma_sync_single_for_cpu(NULL, tegra_apb_bb_phys,
+				words * sizeof(u32), DMA_TO_DEVICE);
+		memcpy(tegra_apb_bb, buf, words * sizeof(u32));
+		apb_dma_xfer(offset, words, false, false);
+		offset += words * sizeof(u32);
+		buf += words;
+		count -= words;
+	}
 	mutex_unlock(&tegra_apb_dma_lock);
 }
 
 u32 tegra_apb_readl(unsigned long offset)
 {
-	return apb_readl(offset);
+	u32 value;
+
+	apb_read(offset, &value, 1, true);
+	return value;
 }
 
 void tegra_apb_writel(u32 value, unsigned long offset)
 {
-	apb_writel(value, offset);
+	apb_write(offset, &value, 1);
+}
+
+/*
+ * Bulk accessors: one DMA descriptor per bounce buffer worth of words
+ * instead of a full transaction per register.
+ */
+void tegra_apb_read_range(unsigned long offset, u32 *buf, unsigned int count)
+{
+	apb_read(offset, buf, count, false);
+}
+
+void tegra_apb_write_range(unsigned long offset, const u32 *buf,
+		unsigned int count)
+{
+	apb_write(offset, buf, count);
+}
+
+void tegra_apb_readsl(unsigned long offset, u32 *buf, unsigned int count)
+{
+	apb_read(offset, buf, count, true);
 }
 #endif
 
@@ -151,7 +203,7 @@ static int tegra_init_apb_dma(void)
 		return -ENODEV;
 	}
 
-	tegra_apb_bb = dma_alloc_coherent(NULL, sizeof(u32),
+	tegra_apb_bb = dma_alloc_coherent(NULL, PAGE_SIZE,
 		&tegra_apb_bb_phys, GFP_KERNEL);
 	if (!tegra_apb_bb) {
 		pr_err("%s: can not allocate bounce buffer\n", __func__);
@@ -18,6 +18,10 @@
 #if defined(CONFIG_TEGRA_SYSTEM_DMA) && defined(CONFIG_ARCH_TEGRA_2x_SOC)
 u32 tegra_apb_readl(unsigned long offset);
 void tegra_apb_writel(u32 value, unsigned long offset);
+void tegra_apb_read_range(unsigned long offset, u32 *buf, unsigned int count);
+void tegra_apb_write_range(unsigned long offset, const u32 *buf,
+		unsigned int count);
+void tegra_apb_readsl(unsigned long offset, u32 *buf, unsigned int count);
 #else
 static inline u32 tegra_apb_readl(unsigned long offset)
 {
@@ -28,4 +32,29 @@ static inline void tegra_apb_writel(u32 value, unsigned long offset)
 {
 	writel(value, IO_TO_VIRT(offset));
 }
+
+static inline void tegra_apb_read_range(unsigned long offset, u32 *buf,
+		unsigned int count)
+{
+	while (count--) {
+		*buf++ = readl(IO_TO_VIRT(offset));
+		offset += 4;
+	}
+}
+
+static inline void tegra_apb_write_range(unsigned long offset,
+		const u32 *buf, unsigned int count)
+{
+	while (count--) {
+		writel(*buf++, IO_TO_VIRT(offset));
+		offset += 4;
+	}
+}
+
+static inline void tegra_apb_readsl(unsigned long offset, u32 *buf,
+		unsigned int count)
+{
+	while (count--)
+		*buf++ = readl(IO_TO_VIRT(offset));
+}
 #endif
@@ -32,6 +32,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/suspend.h>
 #include <linux/pm_qos_params.h>
+#include <linux/lat_hist.h>
 #include <mach/usb_phy.h>
 #include <linux/regulator/consumer.h>
 #include "board.h"
@@ -80,6 +81,7 @@ static struct gpio tegra_baseband_gpios[] = {
 static enum baseband_xmm_powerstate_t baseband_xmm_powerstate;
 static enum ipc_ap_wake_state_t ipc_ap_wake_state;
 static struct workqueue_struct *workqueue;
+static struct workqueue_struct *l2_resume_wq;
 static struct work_struct init2_work;
 static struct work_struct l2_resume_work;
 static struct work_struct autopm_resume_work;
@@ -102,6 +104,12 @@ static struct pm_qos_request_list boost_cpu_freq_req;
 static struct delayed_work pm_qos_work;
 #define BOOST_CPU_FREQ_MIN	1500000
 
+/* L2->L0 start, and whether the CP asked for it, for the histograms below */
+static ktime_t l2tol0_start;
+static bool l2tol0_cp;
+DEFINE_LAT_HIST(xmm_cp_wake_hist, "xmm_cp_wake_to_l0");
+DEFINE_LAT_HIST(xmm_ap_wake_hist, "xmm_ap_wake_to_l0");
+
 /* driver specific data - same structure is used for flashless
  * & flashed modem drivers i.e. baseband-xmm-power2.c
  */
@@ -496,7 +504,7 @@ retry:
 		pr_debug("Get gpio host wakeup low <-\n");
 	} else {
 		cp_initiated_l2tol0 = false;
-		queue_work(workqueue, &l2_resume_work);
+		queue_work(l2_resume_wq, &l2_resume_work);
 		spin_unlock_irqrestore(&xmm_lock, flags);
 		pr_info("CP L2->L0\n");
 	}
@@ -519,6 +527,9 @@ void baseband_xmm_set_power_status(unsigned int status)
 	spin_lock_irqsave(&xmm_lock, flags);
 	switch (status) {
 	case BBXMM_PS_L0:
+		if (baseband_xmm_powerstate == BBXMM_PS_L2TOL0)
+			lat_hist_add_since(l2tol0_cp ? &xmm_cp_wake_hist :
+					   &xmm_ap_wake_hist, l2tol0_start);
 		baseband_xmm_powerstate = status;
 		if (!wake_lock_active(&wakelock))
 			wake_lock_timeout(&wakelock, HZ*2);
@@ -565,6 +576,8 @@ void baseband_xmm_set_power_status(unsigned int status)
 		wakeup_pending = false;
 		/* do this only from L2 state */
 		if (baseband_xmm_powerstate == BBXMM_PS_L2) {
+			l2tol0_start = lat_hist_start();
+			l2tol0_cp = cp_initiated_l2tol0;
 			baseband_xmm_powerstate = status;
 			spin_unlock_irqrestore(&xmm_lock, flags);
 			xmm_power_l2_resume();
@@ -985,6 +998,17 @@ static int xmm_power_driver_probe(struct platform_device *device)
 		return -ENOMEM;
 	}
 
+	/*
+	 * CP initiated L2->L0 gets its own high priority queue so the
+	 * resume never waits behind enumeration or autopm work.
+	 */
+	l2_resume_wq = alloc_workqueue("xmm_l2_resume_wq", WQ_HIGHPRI, 1);
+	if (!l2_resume_wq) {
+		pr_err("cannot create l2 resume workqueue\n");
+		destroy_workqueue(workqueue);
+		return -ENOMEM;
+	}
+
 	INIT_WORK(&xmm_power_drv_data.work, xmm_power_work_func);
 	xmm_power_drv_data.state = BBXMM_WORK_INIT;
 	queue_work(workqueue, &xmm_power_drv_data.work);
@@ -1006,6 +1030,9 @@ static int xmm_power_driver_probe(struct platform_device *device)
 	usb_register_notify(&usb_xmm_nb);
 	register_pm_notifier(&xmm_power_pm_notifier);
 
+	lat_hist_register(&xmm_cp_wake_hist);
+	lat_hist_register(&xmm_ap_wake_hist);
+
 	pr_debug("%s }\n", __func__);
 	return 0;
 }
@@ -1022,6 +1049,8 @@ static int xmm_power_driver_remove(struct platform_device *device)
 	if (!pdata)
 		return 0;
 
+	lat_hist_unregister(&xmm_cp_wake_hist);
+	lat_hist_unregister(&xmm_ap_wake_hist);
 	unregister_pm_notifier(&xmm_power_pm_notifier);
 	usb_unregister_notify(&usb_xmm_nb);
 
@@ -1029,6 +1058,8 @@ static int xmm_power_driver_remove(struct platform_device *device)
 	if (modem_flash && modem_pm)
 		free_irq(gpio_to_irq(pdata->modem.xmm.ipc_ap_wake), NULL);
 
+	destroy_workqueue(l2_resume_wq);
+
 	/* free baseband gpio(s) */
 	gpio_free_array(tegra_baseband_gpios,
 		ARRAY_SIZE(tegra_baseband_gpios));
@@ -158,6 +158,100 @@ static struct platform_device colibri_t30_backlight_device = {
 	},
 };
 
+static struct tegra_dc_sd_settings colibri_t30_sd_settings = {
+	.enable = 1, /* enabled by default. */
+	.use_auto_pwm = false,
+	.hw_update_delay = 0,
+	.bin_width = -1,
+	.aggressiveness = 1,
+	.phase_in_adjustments = true,
+	/* Filter dimming changes over a few frames instead of 1 step/8 frames */
+	.smoothing = 2,
+	.use_vid_luma = false,
+	/* Default video coefficients */
+	.coeff = {5, 9, 2},
+	.fc = {0, 0},
+	/* Immediate backlight changes */
+	.blp = {1024, 255},
+	/* Gammas: R: 2.2 G: 2.2 B: 2.2 */
+	/* Default BL TF */
+	.bltf = {
+			{
+				{57, 65, 74, 83},
+				{93, 103, 114, 126},
+				{138, 151, 165, 179},
+				{194, 209, 225, 242},
+			},
+			{
+				{58, 66, 75, 84},
+				{94, 105, 116, 127},
+				{140, 153, 166, 181},
+				{196, 211, 227, 244},
+			},
+			{
+				{60, 68, 77, 87},
+				{97, 107, 119, 130},
+				{143, 156, 170, 184},
+				{199, 215, 231, 248},
+			},
+			{
+				{64, 73, 82, 91},
+				{102, 113, 124, 137},
+				{149, 163, 177, 192},
+				{207, 223, 240, 255},
+			},
+		},
+	/* Default LUT */
+	.lut = {
+			{
+				{250, 250, 250},
+				{194, 194, 194},
+				{149, 149, 149},
+				{113, 113, 113},
+				{82, 82, 82},
+				{56, 56, 56},
+				{34, 34, 34},
+				{15, 15, 15},
+				{0, 0, 0},
+			},
+			{
+				{246, 246, 246},
+				{191, 191, 191},
+				{147, 147, 147},
+				{111, 111, 111},
+				{80, 80, 80},
+				{55, 55, 55},
+				{33, 33, 33},
+				{14, 14, 14},
+				{0, 0, 0},
+			},
+			{
+				{239, 239, 239},
+				{185, 185, 185},
+				{142, 142, 142},
+				{107, 107, 107},
+				{77, 77, 77},
+				{52, 52, 52},
+				{30, 30, 30},
+				{12, 12, 12},
+				{0, 0, 0},
+			},
+			{
+				{224, 224, 224},
+				{173, 173, 173},
+				{133, 133, 133},
+				{99, 99, 99},
+				{70, 70, 70},
+				{46, 46, 46},
+				{25, 25, 25},
+				{7, 7, 7},
+				{0, 0, 0},
+			},
+		},
+	.sd_brightness = &sd_brightness,
+	.bl_device = &colibri_t30_backlight_device,
+};
+
 static int colibri_t30_panel_prepoweroff(void)
 {
 	gpio_set_value(colibri_t30_lvds_shutdown, 0);
@@ -176,6 +270,10 @@ static int colibri_t30_panel_postpoweron(void)
 			regulator_enable(colibri_t30_lvds_reg);
 	}
 
+	/* panel left powered and out of shutdown by the bootloader */
+	if (gpio_get_value(colibri_t30_lvds_shutdown))
+		return 0;
+
 	mdelay(200);
 
 	gpio_set_value(colibri_t30_lvds_shutdown, 1);
@@ -320,6 +418,7 @@ static struct tegra_fb_data colibri_t30_fb_data = {
 	.xres			= 1366,
 	.yres			= 768,
 	.bits_per_pixel	= 32,
+	.flags			= TEGRA_FB_FLIP_ON_PROBE,
 };
 
 static struct tegra_fb_data colibri_t30_hdmi_fb_data = {
@@ -367,6 +466,8 @@ static struct tegra_dc_out colibri_t30_disp1_out = {
 
 	.height		= 132,
 	.width			= 235,
+
+	.sd_settings	= &colibri_t30_sd_settings,
 };
 
 static struct tegra_dc_out colibri_t30_disp2_out = {
@@ -394,7 +495,7 @@ static struct tegra_dc_out colibri_t30_disp2_out = {
 };
 
 static struct tegra_dc_platform_data colibri_t30_disp1_pdata = {
-	.flags		= TEGRA_DC_FLAG_ENABLED,
+	.flags		= TEGRA_DC_FLAG_ENABLED | TEGRA_DC_FLAG_BOOT_HANDOFF,
 	.default_out	= &colibri_t30_disp1_out,
 	.emc_clk_rate	= 300000000,
 	.fb		= &colibri_t30_fb_data,
@@ -575,6 +676,7 @@ int __init colibri_t30_panel_init(void)
 #ifdef CONFIG_TEGRA_NVMAP
 	colibri_t30_carveouts[1].base = tegra_carveout_start;
 	colibri_t30_carveouts[1].size = tegra_carveout_size;
+	colibri_t30_carveouts[1].movable = tegra_carveout_movable;
 #endif /* CONFIG_TEGRA_NVMAP */
 
 #ifdef CONFIG_ION_TEGRA
@@ -603,12 +705,19 @@ int __init colibri_t30_panel_init(void)
 	res->end = tegra_fb2_start + tegra_fb2_size - 1;
 #endif /* CONFIG_TEGRA_GRHOST & CONFIG_TEGRA_DC */
 
-	/* Make sure LVDS framebuffer is cleared. */
-	to_io = ioremap(tegra_fb_start, tegra_fb_size);
-	if (to_io) {
-		memset(to_io, 0, tegra_fb_size);
-		iounmap(to_io);
-	} else pr_err("%s: Failed to map LVDS framebuffer\n", __func__);
+	/* Keep the splash the bootloader left on the LVDS panel, so the
+	   display can be handed over without going blank. */
+	if (tegra_bootloader_fb_start) {
+		tegra_move_framebuffer(tegra_fb_start, tegra_bootloader_fb_start,
+				min(tegra_fb_size, tegra_bootloader_fb_size));
+	} else {
+		/* Make sure LVDS framebuffer is cleared. */
+		to_io = ioremap(tegra_fb_start, tegra_fb_size);
+		if (to_io) {
+			memset(to_io, 0, tegra_fb_size);
+			iounmap(to_io);
+		} else pr_err("%s: Failed to map LVDS framebuffer\n", __func__);
+	}
 
 	/* Make sure HDMI framebuffer is cleared.
 	   Note: this seems to fix a tegradc.1 initialisation race in case of
@@ -10,6 +10,7 @@
 #include <asm/mach/arch.h>
 #include <asm/mach-types.h>
 
+#include <linux/async.h>
 #include <linux/can/platform/mcp251x.h>
 #include <linux/can/platform/sja1000.h>
 #include <linux/clk.h>
@@ -20,15 +21,18 @@
 #include <linux/input.h>
 #include <linux/input/fusion_F0710A.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/leds_pwm.h>
 #include <linux/lm95245.h>
 #include <linux/mfd/stmpe.h>
+#include <linux/moduleparam.h>
 #include <linux/platform_data/tegra_usb.h>
 #include <linux/platform_device.h>
 #include <linux/serial_8250.h>
 #include <linux/spi-tegra.h>
 #include <linux/spi/spi.h>
 #include <linux/tegra_uart.h>
+#include <linux/workqueue.h>
 
 #include <mach/io_dpd.h>
 #include <mach/sdhci.h>
@@ -313,10 +317,6 @@ static void __init colibri_t30_register_spidev(void)
 #define colibri_t30_register_spidev() do {} while (0)
 #endif 
 */
-static struct platform_device *colibri_t30_spi_devices[] __initdata = {
-	&tegra_spi_device1,
-};
-
 static struct spi_clk_parent spi_parent_clk[] = {
 	[0] = {.name = "pll_p"},
 #ifndef CONFIG_TEGRA_PLLM_RESTRICTED
@@ -351,9 +351,8 @@ static void __init colibri_t30_spi_init(void)
 	}
 	colibri_t30_spi_pdata.parent_clk_list = spi_parent_clk;
 	colibri_t30_spi_pdata.parent_clk_count = ARRAY_SIZE(spi_parent_clk);
+	/* registered with the deferred devices */
 	tegra_spi_device1.dev.platform_data = &colibri_t30_spi_pdata;
-	platform_add_devices(colibri_t30_spi_devices,
-				ARRAY_SIZE(colibri_t30_spi_devices));
 }
 
 
@@ -749,6 +748,14 @@ static struct platform_device *colibri_t30_devices[] __initdata = {
 #if defined(CONFIG_CRYPTO_DEV_TEGRA_AES)
 	&tegra_aes_device,
 #endif
+};
+
+/*
+ * Not needed to reach the root filesystem: registered once userspace is
+ * running, each from its own async thread so that slow probes overlap.
+ * Must not be __initdata.
+ */
+static struct platform_device *colibri_t30_deferred_devices[] = {
 	&tegra_ahub_device,
 	&tegra_dam_device0,
 	&tegra_dam_device1,
@@ -766,8 +773,54 @@ static struct platform_device *colibri_t30_devices[] __initdata = {
 #ifdef CONFIG_W1_MASTER_TEGRA
 	&tegra_w1_device,
 #endif
+	&tegra_spi_device1,
 };
 
+static bool defer_devices = true;
+module_param(defer_devices, bool, 0444);
+
+static void colibri_t30_register_timed(void *data, async_cookie_t cookie)
+{
+	struct platform_device *pdev = data;
+	ktime_t start = ktime_get();
+	int err;
+
+	/* drivers are registered by now, so this includes the probe */
+	err = platform_device_register(pdev);
+	pr_info("colibri_t30: %s.%d: %lld us%s\n", pdev->name, pdev->id,
+		ktime_to_us(ktime_sub(ktime_get(), start)),
+		err ? " (failed)" : "");
+}
+
+static void colibri_t30_deferred_init(struct work_struct *work);
+static DECLARE_DELAYED_WORK(colibri_t30_deferred_work,
+			    colibri_t30_deferred_init);
+
+static void colibri_t30_deferred_init(struct work_struct *work)
+{
+	int i;
+
+	/* SYSTEM_RUNNING is set once the root fs is mounted */
+	if (system_state != SYSTEM_RUNNING) {
+		schedule_delayed_work(&colibri_t30_deferred_work,
+				      msecs_to_jiffies(50));
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(colibri_t30_deferred_devices); i++)
+		async_schedule(colibri_t30_register_timed,
+			       colibri_t30_deferred_devices[i]);
+}
+
+static void __init colibri_t30_deferred_devices_init(void)
+{
+	if (defer_devices)
+		schedule_delayed_work(&colibri_t30_deferred_work, 0);
+	else
+		platform_add_devices(colibri_t30_deferred_devices,
+				     ARRAY_SIZE(colibri_t30_deferred_devices));
+}
+
 static void __init colibri_t30_init(void)
 {
 	
@@ -786,6 +839,7 @@ static void __init colibri_t30_init(void)
 #endif
 	platform_add_devices(colibri_t30_devices, ARRAY_SIZE(colibri_t30_devices));
 	tegra_ram_console_debug_init();
+	tegra_perflog_init();
 
 	//tegra_io_dpd_init();
 
@@ -796,8 +850,7 @@ static void __init colibri_t30_init(void)
 //	colibri_t30_sensors_init();
 	colibri_t30_emc_init();
 //	colibri_t30_register_spidev();
-
-
+	colibri_t30_deferred_devices_init();
 
 	tegra_release_bootloader_fb();
 #ifdef CONFIG_TEGRA_WDT_RECOVERY
@@ -816,6 +869,7 @@ static void __init colibri_t30_reserve(void)
 	tegra_reserve(SZ_128M, SZ_8M, SZ_8M);
 #endif
 	tegra_ram_console_debug_reserve(SZ_1M);
+	tegra_perflog_reserve(SZ_64K);
 }
 
 static const char *colibri_t30_dt_board_compat[] = {
@@ -97,6 +97,13 @@ static inline void tegra_init_cache(bool init) {}
 #endif
 void __init tegra_ram_console_debug_reserve(unsigned long ram_console_size);
 void __init tegra_ram_console_debug_init(void);
+#ifdef CONFIG_PERFLOG
+void __init tegra_perflog_reserve(unsigned long perflog_size);
+void __init tegra_perflog_init(void);
+#else
+static inline void tegra_perflog_reserve(unsigned long perflog_size) {}
+static inline void tegra_perflog_init(void) {}
+#endif
 void __init tegra_release_bootloader_fb(void);
 void __init tegra_protected_aperture_init(unsigned long aperture);
 int  __init tegra_init_board_info(void);
@@ -117,6 +124,7 @@ extern unsigned long tegra_fb2_start;
 extern unsigned long tegra_fb2_size;
 extern unsigned long tegra_carveout_start;
 extern unsigned long tegra_carveout_size;
+extern bool tegra_carveout_movable;
 extern unsigned long tegra_vpr_start;
 extern unsigned long tegra_vpr_size;
 extern unsigned long tegra_lp0_vec_start;
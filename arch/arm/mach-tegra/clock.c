@@ -102,18 +102,55 @@ struct clk *tegra_get_clock_by_name(const char *name)
 }
 EXPORT_SYMBOL(tegra_get_clock_by_name);
 
+static void clk_rate_hist_add(struct clk_rate_hist *h, cputime64_t delta)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_rates; i++) {
+		if (h->bins[i].rate >= h->cur_rate)
+			break;
+	}
+
+	if ((i == h->num_rates) || (h->bins[i].rate != h->cur_rate)) {
+		if (h->num_rates == CLK_RATE_HIST_SIZE)
+			return;
+		memmove(&h->bins[i + 1], &h->bins[i],
+			(h->num_rates - i) * sizeof(h->bins[0]));
+		h->bins[i].rate = h->cur_rate;
+		h->bins[i].time = 0;
+		h->num_rates++;
+	}
+	h->bins[i].time = cputime64_add(h->bins[i].time, delta);
+}
+
 static void clk_stats_update(struct clk *c)
 {
 	u64 cur_jiffies = get_jiffies_64();
 
 	if (c->refcnt) {
-		c->stats.time_on = cputime64_add(c->stats.time_on,
-			cputime64_sub(cur_jiffies, c->stats.last_update));
+		cputime64_t delta =
+			cputime64_sub(cur_jiffies, c->stats.last_update);
+
+		c->stats.time_on = cputime64_add(c->stats.time_on, delta);
+		if (c->stats.rate_hist)
+			clk_rate_hist_add(c->stats.rate_hist, delta);
 	}
 
 	c->stats.last_update = cur_jiffies;
 }
 
+/* Must be called with clk_lock(c) held, after the rate has changed */
+static inline void clk_stats_rate_change(struct clk *c, unsigned long rate)
+{
+	struct clk_rate_hist *h = c->stats.rate_hist;
+
+	if (h && (h->cur_rate != rate)) {
+		clk_stats_update(c);
+		h->cur_rate = rate;
+		h->rate_changes++;
+	}
+}
+
 /* Must be called with clk_lock(c) held */
 static unsigned long clk_predict_rate_from_parent(struct clk *c, struct clk *p)
 {
@@ -378,6 +415,9 @@ int clk_set_parent_locked(struct clk *c, struct clk *parent)
 	if (ret)
 		goto out;
 
+	trace_clock_set_parent(c->name, parent->name);
+	clk_stats_rate_change(c, new_rate);
+
 	if (clk_is_auto_dvfs(c) && c->refcnt > 0 &&
 			new_rate < old_rate)
 		ret = tegra_dvfs_set_rate(c, new_rate);
@@ -461,6 +501,8 @@ int clk_set_rate_locked(struct clk *c, unsigned long rate)
 	if (ret)
 		goto out;
 
+	clk_stats_rate_change(c, rate);
+
 	if (clk_is_auto_dvfs(c) && rate < old_rate && c->refcnt > 0)
 		ret = tegra_dvfs_set_rate(c, rate);
 
@@ -1246,6 +1288,103 @@ static int time_on_get(void *data, u64 *val)
 }
 DEFINE_SIMPLE_ATTRIBUTE(time_on_fops, time_on_get, NULL, "%llu\n");
 
+/* clocks profiled with rate_hist */
+static const char *rate_hist_clocks[] = {
+	"cpu_g", "cpu_lp", "emc", "3d", "host1x", "vde", "sbus", "cbus",
+};
+
+static int rate_hist_show(struct seq_file *s, void *data)
+{
+	unsigned int i;
+	unsigned long flags;
+	struct clk *c = s->private;
+	struct clk_rate_hist *h = c->stats.rate_hist;
+	struct clk_rate_hist *snap;
+
+	snap = kmalloc(sizeof(*snap), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	clk_lock_save(c, &flags);
+	clk_stats_update(c);
+	*snap = *h;
+	clk_unlock_restore(c, &flags);
+
+	seq_printf(s, "%-10s %-10s\n", "rate kHz", "time");
+	for (i = 0; i < snap->num_rates; i++)
+		seq_printf(s, "%-10lu %-10llu\n", snap->bins[i].rate / 1000,
+			   cputime64_to_clock_t(snap->bins[i].time));
+	seq_printf(s, "rate changes: %u\n", snap->rate_changes);
+
+	kfree(snap);
+	return 0;
+}
+
+static int rate_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rate_hist_show, inode->i_private);
+}
+
+/* any write resets the histogram */
+static ssize_t rate_hist_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+	struct seq_file *s = file->private_data;
+	struct clk *c = s->private;
+	struct clk_rate_hist *h = c->stats.rate_hist;
+
+	clk_lock_save(c, &flags);
+	clk_stats_update(c);
+	h->num_rates = 0;
+	h->rate_changes = 0;
+	clk_unlock_restore(c, &flags);
+
+	return count;
+}
+
+static const struct file_operations rate_hist_fops = {
+	.open		= rate_hist_open,
+	.read		= seq_read,
+	.write		= rate_hist_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int clk_debugfs_rate_hist_init(struct clk *c)
+{
+	int i;
+	unsigned long flags;
+	struct dentry *d;
+	struct clk_rate_hist *h;
+
+	for (i = 0; i < ARRAY_SIZE(rate_hist_clocks); i++) {
+		if (!strcmp(c->name, rate_hist_clocks[i]))
+			break;
+	}
+	if (i == ARRAY_SIZE(rate_hist_clocks))
+		return 0;
+
+	h = kzalloc(sizeof(*h), GFP_KERNEL);
+	if (!h)
+		return -ENOMEM;
+
+	d = debugfs_create_file("rate_hist", S_IRUGO | S_IWUSR, c->dent,
+		c, &rate_hist_fops);
+	if (!d) {
+		kfree(h);
+		return -ENOMEM;
+	}
+
+	clk_lock_save(c, &flags);
+	clk_stats_update(c);
+	h->cur_rate = clk_get_rate_locked(c);
+	c->stats.rate_hist = h;
+	clk_unlock_restore(c, &flags);
+
+	return 0;
+}
+
 static int possible_rates_show(struct seq_file *s, void *data)
 {
 	struct clk *c = s->private;
@@ -1276,6 +1415,53 @@ static const struct file_operations possible_rates_fops = {
 	.release	= single_release,
 };
 
+static int shared_users_show(struct seq_file *s, void *data)
+{
+	static const char * const modes[] = {
+		[SHARED_FLOOR] = "floor",
+		[SHARED_BW] = "bw",
+		[SHARED_CEILING] = "ceiling",
+		[SHARED_AUTO] = "auto",
+	};
+	unsigned long flags;
+	struct clk *bus = s->private;
+	struct clk *c;
+	u64 cur_jiffies;
+
+	seq_printf(s, "%-16s %-8s %-3s %-10s %-10s\n",
+		   "user", "mode", "on", "rate kHz", "time top");
+
+	clk_lock_save(bus, &flags);
+	cur_jiffies = get_jiffies_64();
+	list_for_each_entry(c, &bus->shared_bus_list, u.shared_bus_user.node) {
+		cputime64_t t = c->u.shared_bus_user.time_top;
+
+		if (c == bus->shared_bus_top)
+			t = cputime64_add(t, cputime64_sub(cur_jiffies,
+						bus->shared_bus_top_since));
+		seq_printf(s, "%-16s %-8s %-3d %-10lu %-10llu\n", c->name,
+			   modes[c->u.shared_bus_user.mode],
+			   c->u.shared_bus_user.enabled,
+			   c->u.shared_bus_user.rate / 1000,
+			   cputime64_to_clock_t(t));
+	}
+	clk_unlock_restore(bus, &flags);
+
+	return 0;
+}
+
+static int shared_users_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, shared_users_show, inode->i_private);
+}
+
+static const struct file_operations shared_users_fops = {
+	.open		= shared_users_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int clk_debugfs_register_one(struct clk *c)
 {
 	struct dentry *d;
@@ -1335,6 +1521,16 @@ static int clk_debugfs_register_one(struct clk *c)
 			goto err_out;
 	}
 
+	if (!list_empty(&c->shared_bus_list)) {
+		d = debugfs_create_file("shared_users", S_IRUGO, c->dent,
+			c, &shared_users_fops);
+		if (!d)
+			goto err_out;
+	}
+
+	if (clk_debugfs_rate_hist_init(c))
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -109,9 +109,23 @@ struct clk_ops {
 	int		(*shared_bus_update)(struct clk *);
 };
 
+#define CLK_RATE_HIST_SIZE	32
+
+/* time spent enabled at each rate, kept only for clocks being profiled */
+struct clk_rate_hist {
+	unsigned long	cur_rate;
+	unsigned int	num_rates;
+	u32		rate_changes;
+	struct {
+		unsigned long	rate;
+		cputime64_t	time;
+	} bins[CLK_RATE_HIST_SIZE];
+};
+
 struct clk_stats {
 	cputime64_t 	time_on;
 	u64 		last_update;
+	struct clk_rate_hist	*rate_hist;
 };
 
 enum cpu_mode {
@@ -165,6 +179,8 @@ struct clk {
 
 	struct list_head		shared_bus_list;
 	struct clk_backup		shared_bus_backup;
+	struct clk			*shared_bus_top; /* user setting rate */
+	u64				shared_bus_top_since;
 
 	union {
 		struct {
@@ -212,6 +228,7 @@ struct clk {
 			struct clk			*client;
 			u32				client_div;
 			enum shared_bus_users_mode	mode;
+			cputime64_t			time_top;
 		} shared_bus_user;
 	} u;
 
@@ -30,10 +30,12 @@
 #include <linux/sched.h>
 #include <linux/cpufreq.h>
 #include <linux/of.h>
+#include <linux/perflog.h>
 
 #include <asm/hardware/cache-l2x0.h>
 #include <asm/system.h>
 
+#include <mach/clk.h>
 #include <mach/gpio.h>
 #include <mach/iomap.h>
 #include <mach/pinmux.h>
@@ -93,6 +95,7 @@ unsigned long tegra_fb2_start;
 unsigned long tegra_fb2_size;
 unsigned long tegra_carveout_start;
 unsigned long tegra_carveout_size;
+bool tegra_carveout_movable;
 unsigned long tegra_vpr_start;
 unsigned long tegra_vpr_size;
 unsigned long tegra_lp0_vec_start;
@@ -918,12 +921,53 @@ void tegra_clear_framebuffer(unsigned long to, unsigned long size)
 	iounmap(to_io);
 }
 
+/*
+ * With CONFIG_NVMAP_CARVEOUT_CMA a carveout which lies in highmem and is
+ * made of whole pageblocks stays in the memory map as reserved memory, so
+ * that nvmap can lend it to the page allocator once that is up.  Whatever
+ * is reserved below it must then be carved out beneath it.
+ */
+static bool __init tegra_carveout_can_move(unsigned long start,
+					   unsigned long size)
+{
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	unsigned long align = PAGE_SIZE << pageblock_order;
+
+	return start >= memblock.current_limit &&
+		!(start & (align - 1)) && !(size & (align - 1));
+#else
+	return false;
+#endif
+}
+
+/* the top of the memory still left below any movable carveout */
+static phys_addr_t __init tegra_reserve_top(void)
+{
+	struct memblock_region *reg;
+	phys_addr_t top = 0;
+
+	if (!tegra_carveout_movable)
+		return memblock_end_of_DRAM();
+
+	for_each_memblock(memory, reg)
+		if (reg->base < tegra_carveout_start)
+			top = min_t(phys_addr_t, reg->base + reg->size,
+				    tegra_carveout_start);
+	return top;
+}
+
 void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 	unsigned long fb2_size)
 {
 	if (carveout_size) {
 		tegra_carveout_start = memblock_end_of_DRAM() - carveout_size;
-		if (memblock_remove(tegra_carveout_start, carveout_size)) {
+		if (tegra_carveout_can_move(tegra_carveout_start,
+					    carveout_size) &&
+		    !memblock_reserve(tegra_carveout_start, carveout_size)) {
+			tegra_carveout_movable = true;
+			tegra_carveout_size = carveout_size;
+		} else if (memblock_remove(tegra_carveout_start,
+					   carveout_size)) {
 			pr_err("Failed to remove carveout %08lx@%08lx "
 				"from memory map\n",
 				carveout_size, tegra_carveout_start);
@@ -937,7 +981,7 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 	}
 
 	if (fb2_size) {
-		tegra_fb2_start = memblock_end_of_DRAM() - fb2_size;
+		tegra_fb2_start = tegra_reserve_top() - fb2_size;
 		if (memblock_remove(tegra_fb2_start, fb2_size)) {
 			pr_err("Failed to remove second framebuffer "
 				"%08lx@%08lx from memory map\n",
@@ -954,7 +998,7 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 	}
 
 	if (fb_size) {
-		tegra_fb_start = memblock_end_of_DRAM() - fb_size;
+		tegra_fb_start = tegra_reserve_top() - fb_size;
 		if (memblock_remove(tegra_fb_start, fb_size)) {
 			pr_err("Failed to remove framebuffer %08lx@%08lx "
 				"from memory map\n",
@@ -1067,7 +1111,7 @@ void __init tegra_ram_console_debug_reserve(unsigned long ram_console_size)
 	res = platform_get_resource(&ram_console_device, IORESOURCE_MEM, 0);
 	if (!res)
 		goto fail;
-	res->start = memblock_end_of_DRAM() - ram_console_size;
+	res->start = tegra_reserve_top() - ram_console_size;
 	res->end = res->start + ram_console_size - 1;
 	ret = memblock_remove(res->start, ram_console_size);
 	if (ret)
@@ -1091,6 +1135,85 @@ void __init tegra_ram_console_debug_init(void)
 	}
 }
 
+#ifdef CONFIG_PERFLOG
+static struct resource perflog_resources[] = {
+	{
+		.flags = IORESOURCE_MEM,
+	},
+};
+
+static struct platform_device perflog_device = {
+	.name		= "perflog",
+	.id		= -1,
+	.num_resources	= ARRAY_SIZE(perflog_resources),
+	.resource	= perflog_resources,
+};
+
+void __init tegra_perflog_reserve(unsigned long perflog_size)
+{
+	struct resource *res;
+
+	res = platform_get_resource(&perflog_device, IORESOURCE_MEM, 0);
+	if (!res)
+		goto fail;
+	res->start = tegra_reserve_top() - perflog_size;
+	res->end = res->start + perflog_size - 1;
+	if (memblock_remove(res->start, perflog_size))
+		goto fail;
+
+	return;
+
+fail:
+	perflog_device.resource = NULL;
+	perflog_device.num_resources = 0;
+	pr_err("Failed to reserve memory block for perflog\n");
+}
+
+static int perflog_emc_notify(struct notifier_block *nb,
+			      unsigned long rate, void *data)
+{
+	perflog_record(PERFLOG_EMC_RATE, rate / 1000, 0);
+	return NOTIFY_OK;
+}
+
+static int perflog_cbus_notify(struct notifier_block *nb,
+			       unsigned long rate, void *data)
+{
+	perflog_record(PERFLOG_CBUS_RATE, rate / 1000, 0);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block perflog_emc_nb = {
+	.notifier_call = perflog_emc_notify,
+};
+
+static struct notifier_block perflog_cbus_nb = {
+	.notifier_call = perflog_cbus_notify,
+};
+
+void __init tegra_perflog_init(void)
+{
+	struct clk *c;
+	int err;
+
+	if (!perflog_device.num_resources)
+		return;
+
+	err = platform_device_register(&perflog_device);
+	if (err) {
+		pr_err("%s: perflog registration failed (%d)\n", __func__, err);
+		return;
+	}
+
+	c = tegra_get_clock_by_name("emc");
+	if (c)
+		tegra_register_clk_rate_notifier(c, &perflog_emc_nb);
+	c = tegra_get_clock_by_name("cbus");
+	if (c)
+		tegra_register_clk_rate_notifier(c, &perflog_cbus_nb);
+}
+#endif
+
 void __init tegra_release_bootloader_fb(void)
 {
 	/* Since bootloader fb is reserved in common.c, it is freed here. */
@@ -33,6 +33,8 @@
 #include <linux/suspend.h>
 #include <linux/debugfs.h>
 #include <linux/cpu.h>
+#include <linux/slab.h>
+#include <linux/lat_hist.h>
 
 #include <asm/system.h>
 
@@ -53,6 +55,7 @@ static struct clk *emc_clk;
 static unsigned long policy_max_speed[CONFIG_NR_CPUS];
 static unsigned long target_cpu_speed[CONFIG_NR_CPUS];
 static DEFINE_MUTEX(tegra_cpu_lock);
+DEFINE_LAT_HIST(cpufreq_hist, "cpufreq_transition");
 static bool is_suspended;
 static int suspend_index;
 
@@ -145,6 +148,62 @@ static unsigned int user_cap_speed(unsigned int requested_speed)
 	return requested_speed;
 }
 
+/*
+ * Ceiling applied while the only runnable load comes from background task
+ * groups, so that background work alone does not leave the LP cluster.
+ * 0 selects the LP cluster's top rate.
+ */
+static unsigned int cpu_bg_cap;
+module_param(cpu_bg_cap, uint, 0644);
+
+/* below a quarter of a foreground thread the cpu counts as idle */
+#define BG_CAP_FG_IDLE		(FIXED_1 / 4)
+
+static unsigned int bg_cap_speed(unsigned int requested_speed)
+{
+	static unsigned int lp_top_speed;
+	unsigned int cap = cpu_bg_cap;
+
+	if (!avg_nr_background() || avg_nr_running_fg() >= BG_CAP_FG_IDLE)
+		return requested_speed;
+
+	if (!cap) {
+		if (!lp_top_speed) {
+			struct clk *lp = tegra_get_clock_by_name("cpu_lp");
+			if (lp)
+				lp_top_speed = clk_get_max_rate(lp) / 1000;
+		}
+		cap = lp_top_speed;
+	}
+
+	return cap ? min(requested_speed, cap) : requested_speed;
+}
+
+/*
+ * Transient floor requested by boost clients (e.g. input events). It is
+ * applied before throttle, EDP and user caps, so those limits always win.
+ */
+static unsigned int cpu_boost_floor;
+
+void tegra_cpu_boost_floor_set(unsigned int speed_khz)
+{
+	mutex_lock(&tegra_cpu_lock);
+
+	if (cpu_boost_floor != speed_khz) {
+		cpu_boost_floor = speed_khz;
+		tegra_cpu_set_speed_cap(NULL);
+	}
+
+	mutex_unlock(&tegra_cpu_lock);
+}
+
+static unsigned int boost_floor_speed(unsigned int requested_speed)
+{
+	if (requested_speed < cpu_boost_floor)
+		return cpu_boost_floor;
+	return requested_speed;
+}
+
 #ifdef CONFIG_TEGRA_THERMAL_THROTTLE
 
 static ssize_t show_throttle(struct cpufreq_policy *policy, char *buf)
@@ -167,32 +226,45 @@ static int edp_thermal_index;
 static cpumask_t edp_cpumask;
 static unsigned int edp_limit;
 
+/*
+ * Both limit tables and the frequency table are fixed once cpufreq starts,
+ * so the rounded limit for every thermal zone, system alarm state and
+ * online cpu count is solved at init; hotplug and thermal updates then
+ * index it instead of walking the frequency table under tegra_cpu_lock.
+ */
+#define EDP_MAX_CPUS	ARRAY_SIZE(((struct tegra_edp_limits *)0)->freq_limits)
+static unsigned int (*edp_solved)[2][EDP_MAX_CPUS];
+static int edp_solved_size;
+
 unsigned int tegra_get_edp_limit(void)
 {
 	return edp_limit;
 }
 
-static unsigned int edp_predict_limit(unsigned int cpus)
+static unsigned int edp_calc_limit(int index, bool alarm, unsigned int cpus)
 {
 	unsigned int limit = 0;
 
 	BUG_ON(cpus == 0);
 	if (cpu_edp_limits) {
-		BUG_ON(edp_thermal_index >= cpu_edp_limits_size);
-		limit = cpu_edp_limits[edp_thermal_index].freq_limits[cpus - 1];
+		BUG_ON(index >= cpu_edp_limits_size);
+		limit = cpu_edp_limits[index].freq_limits[cpus - 1];
 	}
-	if (system_edp_limits && system_edp_alarm)
+	if (system_edp_limits && alarm)
 		limit = min(limit, system_edp_limits[cpus - 1]);
 
 	return limit;
 }
 
-static void edp_update_limit(void)
+static unsigned int edp_predict_limit(unsigned int cpus)
 {
-	unsigned int limit = edp_predict_limit(cpumask_weight(&edp_cpumask));
+	return edp_calc_limit(edp_thermal_index, system_edp_alarm, cpus);
+}
 
+static unsigned int edp_round_limit(unsigned int limit)
+{
 #ifdef CONFIG_TEGRA_EDP_EXACT_FREQ
-	edp_limit = limit;
+	return limit;
 #else
 	unsigned int i;
 	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++) {
@@ -201,10 +273,44 @@ static void edp_update_limit(void)
 		}
 	}
 	BUG_ON(i == 0);	/* min freq above the limit or table empty */
-	edp_limit = freq_table[i-1].frequency;
+	return freq_table[i-1].frequency;
 #endif
 }
 
+static void edp_solve_limits(void)
+{
+	int size = cpu_edp_limits ? cpu_edp_limits_size : 1;
+	int index, alarm, n;
+
+	edp_solved = kmalloc(size * sizeof(*edp_solved), GFP_KERNEL);
+	if (!edp_solved) {
+		pr_warn("cpu-tegra: EDP limits not cached\n");
+		return;
+	}
+
+	for (index = 0; index < size; index++)
+		for (alarm = 0; alarm < 2; alarm++)
+			for (n = 1; n <= EDP_MAX_CPUS; n++)
+				edp_solved[index][alarm][n - 1] = edp_round_limit(
+					edp_calc_limit(index, alarm, n));
+	edp_solved_size = size;
+}
+
+static void edp_update_limit(void)
+{
+	unsigned int cpus = cpumask_weight(&edp_cpumask);
+
+	if (edp_solved) {
+		BUG_ON(cpus == 0 || cpus > EDP_MAX_CPUS);
+		BUG_ON(edp_thermal_index >= edp_solved_size);
+		edp_limit = edp_solved[edp_thermal_index]
+			[system_edp_alarm][cpus - 1];
+		return;
+	}
+
+	edp_limit = edp_round_limit(edp_predict_limit(cpus));
+}
+
 static unsigned int edp_governor_speed(unsigned int requested_speed)
 {
 	if ((!edp_limit) || (requested_speed <= edp_limit))
@@ -372,6 +478,9 @@ static void tegra_cpu_edp_init(bool resume)
 	 * Boot frequency allowed SoC to get here, should work till sensor is
 	 * initialized.
 	 */
+	if (!resume)
+		edp_solve_limits();
+
 	edp_cpumask = *cpu_online_mask;
 	edp_update_limit();
 
@@ -387,6 +496,8 @@ static void tegra_cpu_edp_exit(void)
 		return;
 
 	unregister_hotcpu_notifier(&tegra_cpu_edp_notifier);
+	kfree(edp_solved);
+	edp_solved = NULL;
 }
 
 #ifdef CONFIG_DEBUG_FS
@@ -474,6 +585,7 @@ int tegra_update_cpu_speed(unsigned long rate)
 {
 	int ret = 0;
 	struct cpufreq_freqs freqs;
+	ktime_t start;
 
 	freqs.old = tegra_getspeed(0);
 	freqs.new = rate;
@@ -485,6 +597,8 @@ int tegra_update_cpu_speed(unsigned long rate)
 	if (freqs.old == freqs.new)
 		return ret;
 
+	start = lat_hist_start();
+
 	/*
 	 * Vote on memory bus frequency based on cpu frequency
 	 * This sets the minimum frequency, display or avp may request higher
@@ -527,6 +641,7 @@ int tegra_update_cpu_speed(unsigned long rate)
 		tegra_update_mselect_rate(freqs.new);
 	}
 
+	lat_hist_add_since(&cpufreq_hist, start);
 	return 0;
 }
 
@@ -585,6 +700,8 @@ int tegra_cpu_set_speed_cap(unsigned int *speed_cap)
 	if (is_suspended)
 		return -EBUSY;
 
+	new_speed = bg_cap_speed(new_speed);
+	new_speed = boost_floor_speed(new_speed);
 	new_speed = tegra_throttle_governor_speed(new_speed);
 	new_speed = edp_governor_speed(new_speed);
 	new_speed = user_cap_speed(new_speed);
@@ -697,6 +814,7 @@ static int tegra_cpu_init(struct cpufreq_policy *policy)
 
 	if (policy->cpu == 0) {
 		register_pm_notifier(&tegra_cpu_pm_notifier);
+		lat_hist_register(&cpufreq_hist);
 	}
 
 	return 0;
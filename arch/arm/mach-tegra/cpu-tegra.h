@@ -36,6 +36,9 @@ bool tegra_is_throttling(void);
 unsigned int tegra_throttle_governor_speed(unsigned int requested_speed);
 int tegra_throttle_debug_init(struct dentry *cpu_tegra_debugfs_root);
 void tegra_throttling_enable(bool enable);
+void tegra_throttle_pid_init(int (*get_temp)(long *tj_temp));
+long tegra_throttle_pid_start_temp(long throttle_tj);
+void tegra_throttle_pid_alert(long tj_temp, long throttle_tj);
 #else
 static inline int tegra_throttle_init(struct mutex *cpu_lock)
 { return 0; }
@@ -51,6 +54,12 @@ static inline int tegra_throttle_debug_init(
 { return 0; }
 static inline void tegra_throttling_enable(bool enable)
 {}
+static inline void tegra_throttle_pid_init(int (*get_temp)(long *tj_temp))
+{}
+static inline long tegra_throttle_pid_start_temp(long throttle_tj)
+{ return throttle_tj; }
+static inline void tegra_throttle_pid_alert(long tj_temp, long throttle_tj)
+{}
 #endif /* CONFIG_TEGRA_THERMAL_THROTTLE */
 
 #if defined(CONFIG_TEGRA_AUTO_HOTPLUG) && !defined(CONFIG_ARCH_TEGRA_2x_SOC)
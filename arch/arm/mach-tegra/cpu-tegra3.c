@@ -33,6 +33,7 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/pm_qos_params.h>
+#include <linux/suspend.h>
 
 #include "pm.h"
 #include "cpu-tegra.h"
@@ -47,10 +48,15 @@ static struct mutex *tegra3_cpu_lock;
 
 static struct workqueue_struct *hotplug_wq;
 static struct delayed_work hotplug_work;
+static struct work_struct prewarm_work;
 
 static bool no_lp;
 module_param(no_lp, bool, 0644);
 
+/* pre-warm G rail and PLLX as soon as LP=>G switch is pending */
+static bool async_switch;
+module_param(async_switch, bool, 0644);
+
 static unsigned long up2gn_delay;
 static unsigned long up2g0_delay;
 static unsigned long down_delay;
@@ -73,6 +79,42 @@ static struct clk *cpu_clk;
 static struct clk *cpu_g_clk;
 static struct clk *cpu_lp_clk;
 
+/*
+ * LP and G cores are both Cortex-A9, so the companion core capacity is just
+ * its maximum rate relative to G. The scheduler weights runnable averages
+ * with it; the governor compares that demand against the LP capacity:
+ * above demand_up_pct of it LP is too slow, below demand_down_pct on a
+ * single G core the load would fit on LP. 0 disables either check.
+ */
+static unsigned long lp_capacity = SCHED_POWER_SCALE;
+static unsigned int demand_up_pct = 150;
+static unsigned int demand_down_pct = 70;
+module_param(demand_up_pct, uint, 0644);
+module_param(demand_down_pct, uint, 0644);
+
+unsigned long arch_scale_cpu_capacity(int cpu)
+{
+	return is_lp_cluster() ? lp_capacity : SCHED_POWER_SCALE;
+}
+
+static unsigned long lp_demand_level(unsigned int pct)
+{
+	return ((FIXED_1 * lp_capacity) >> SCHED_POWER_SHIFT) * pct / 100;
+}
+
+static bool demand_above_lp(void)
+{
+	return is_lp_cluster() && demand_up_pct &&
+		avg_nr_running_capacity() > lp_demand_level(demand_up_pct);
+}
+
+static bool demand_fits_lp(void)
+{
+	if (is_lp_cluster() || !demand_down_pct || num_online_cpus() > 1)
+		return true;
+	return avg_nr_running_capacity() <= lp_demand_level(demand_down_pct);
+}
+
 static unsigned long last_change_time;
 
 static struct {
@@ -152,7 +194,9 @@ static int hp_state_set(const char *arg, const struct kernel_param *kp)
 		    (old_state != TEGRA_HP_DISABLED)) {
 			mutex_unlock(tegra3_cpu_lock);
 			cancel_delayed_work_sync(&hotplug_work);
+			cancel_work_sync(&prewarm_work);
 			mutex_lock(tegra3_cpu_lock);
+			tegra_cluster_switch_prewarm(false);
 			pr_info("Tegra auto-hotplug disabled\n");
 		} else if (hp_state != TEGRA_HP_DISABLED) {
 			if (old_state == TEGRA_HP_DISABLED) {
@@ -232,7 +276,8 @@ static noinline int tegra_cpu_speed_balance(void)
 	unsigned int nr_cpus = num_online_cpus();
 	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
 	unsigned int min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
-	unsigned int avg_nr_run = avg_nr_running();
+	/* background task groups do not bring cores on-line */
+	unsigned int avg_nr_run = avg_nr_running_fg();
 	unsigned int nr_run;
 
 	/* Evaluate:
@@ -356,6 +401,29 @@ static void tegra_auto_hotplug_work_func(struct work_struct *work)
 	}
 }
 
+static void tegra_cluster_prewarm_work_func(struct work_struct *work)
+{
+	mutex_lock(tegra3_cpu_lock);
+
+	if (async_switch && !no_lp && is_lp_cluster() &&
+	    (hp_state == TEGRA_HP_UP))
+		tegra_cluster_switch_prewarm(true);
+	else
+		tegra_cluster_switch_prewarm(false);
+
+	mutex_unlock(tegra3_cpu_lock);
+}
+
+/* Keep G cluster pre-warmed only while LP=>G switch is pending */
+static void tegra_cluster_prewarm_update(void)
+{
+	bool pending = async_switch && !no_lp && is_lp_cluster() &&
+		(hp_state == TEGRA_HP_UP);
+
+	if (pending != tegra_cluster_switch_prewarmed())
+		queue_work(hotplug_wq, &prewarm_work);
+}
+
 static int min_cpus_notify(struct notifier_block *nb, unsigned long n, void *p)
 {
 	mutex_lock(tegra3_cpu_lock);
@@ -385,6 +453,7 @@ static struct notifier_block min_cpus_notifier = {
 void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 {
 	unsigned long up_delay, top_freq, bottom_freq;
+	bool over, under;
 
 	if (!is_g_cluster_present())
 		return;
@@ -394,6 +463,7 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 
 	if (suspend) {
 		hp_state = TEGRA_HP_IDLE;
+		tegra_cluster_switch_prewarm(false);
 
 		/* Switch to G-mode if suspend rate is high enough */
 		if (is_lp_cluster() && (cpu_freq >= idle_bottom_freq)) {
@@ -421,36 +491,40 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 			queue_delayed_work(
 				hotplug_wq, &hotplug_work, up_delay);
 		}
+		tegra_cluster_prewarm_update();
 		return;
 	}
 
+	over = (cpu_freq > top_freq) || demand_above_lp();
+	under = (cpu_freq <= bottom_freq) && demand_fits_lp();
+
 	switch (hp_state) {
 	case TEGRA_HP_IDLE:
-		if (cpu_freq > top_freq) {
+		if (over) {
 			hp_state = TEGRA_HP_UP;
 			queue_delayed_work(
 				hotplug_wq, &hotplug_work, up_delay);
-		} else if (cpu_freq <= bottom_freq) {
+		} else if (under) {
 			hp_state = TEGRA_HP_DOWN;
 			queue_delayed_work(
 				hotplug_wq, &hotplug_work, up_delay);
 		}
 		break;
 	case TEGRA_HP_DOWN:
-		if (cpu_freq > top_freq) {
+		if (over) {
 			hp_state = TEGRA_HP_UP;
 			queue_delayed_work(
 				hotplug_wq, &hotplug_work, up_delay);
-		} else if (cpu_freq > bottom_freq) {
+		} else if (!under) {
 			hp_state = TEGRA_HP_IDLE;
 		}
 		break;
 	case TEGRA_HP_UP:
-		if (cpu_freq <= bottom_freq) {
+		if (under) {
 			hp_state = TEGRA_HP_DOWN;
 			queue_delayed_work(
 				hotplug_wq, &hotplug_work, up_delay);
-		} else if (cpu_freq <= top_freq) {
+		} else if (!over) {
 			hp_state = TEGRA_HP_IDLE;
 		}
 		break;
@@ -459,8 +533,68 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 		       __func__, hp_state);
 		BUG();
 	}
+
+	tegra_cluster_prewarm_update();
+}
+
+/*
+ * Async device suspend callbacks run on whatever cpus are online, which
+ * is often a single G core when suspend starts. Bring up to suspend_cpus
+ * G cores online for it; disable_nonboot_cpus() takes them down once the
+ * devices are suspended. The cores return on resume, which then runs on
+ * all of them, and are unplugged again when resume is complete.
+ */
+static unsigned int suspend_cpus = CONFIG_NR_CPUS;
+module_param(suspend_cpus, uint, 0644);
+
+static struct cpumask suspend_cpus_up;
+
+static int tegra_auto_hotplug_pm_notify(struct notifier_block *nb,
+					unsigned long event, void *data)
+{
+	unsigned int cpu, max_cpus;
+
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		cpumask_clear(&suspend_cpus_up);
+		/* suspend rate may have left us on LP, which is one core */
+		if (hp_state == TEGRA_HP_DISABLED || is_lp_cluster())
+			break;
+
+		max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
+		max_cpus = min(max_cpus, suspend_cpus);
+		for_each_present_cpu(cpu) {
+			if (num_online_cpus() >= max_cpus)
+				break;
+			if (cpu_online(cpu) || cpu_up(cpu))
+				continue;
+			cpumask_set_cpu(cpu, &suspend_cpus_up);
+			mutex_lock(tegra3_cpu_lock);
+			hp_stats_update(cpu, true);
+			mutex_unlock(tegra3_cpu_lock);
+		}
+		break;
+	case PM_POST_SUSPEND:
+		for_each_cpu(cpu, &suspend_cpus_up) {
+			if (!cpu_online(cpu) || cpu_down(cpu))
+				continue;
+			mutex_lock(tegra3_cpu_lock);
+			hp_stats_update(cpu, false);
+			mutex_unlock(tegra3_cpu_lock);
+		}
+		cpumask_clear(&suspend_cpus_up);
+		break;
+	}
+
+	return NOTIFY_OK;
 }
 
+/* after cpufreq has set the suspend rate and parked the governor */
+static struct notifier_block tegra_auto_hotplug_pm_nb = {
+	.notifier_call = tegra_auto_hotplug_pm_notify,
+	.priority = -1,
+};
+
 int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 {
 	/*
@@ -472,6 +606,7 @@ int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 	if (!hotplug_wq)
 		return -ENOMEM;
 	INIT_DELAYED_WORK(&hotplug_work, tegra_auto_hotplug_work_func);
+	INIT_WORK(&prewarm_work, tegra_cluster_prewarm_work_func);
 
 	cpu_clk = clk_get_sys(NULL, "cpu");
 	cpu_g_clk = clk_get_sys(NULL, "cpu_g");
@@ -481,6 +616,8 @@ int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 
 	idle_top_freq = clk_get_max_rate(cpu_lp_clk) / 1000;
 	idle_bottom_freq = clk_get_min_rate(cpu_g_clk) / 1000;
+	lp_capacity = div_u64((u64)clk_get_max_rate(cpu_lp_clk) *
+			      SCHED_POWER_SCALE, clk_get_max_rate(cpu_g_clk));
 
 	up2g0_delay = msecs_to_jiffies(UP2G0_DELAY_MS);
 	up2gn_delay = msecs_to_jiffies(UP2Gn_DELAY_MS);
@@ -496,6 +633,8 @@ int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 		pr_err("%s: Failed to register min cpus PM QoS notifier\n",
 			__func__);
 
+	register_pm_notifier(&tegra_auto_hotplug_pm_nb);
+
 	return 0;
 }
 
@@ -539,6 +678,13 @@ static int hp_stats_show(struct seq_file *s, void *data)
 	}
 	seq_printf(s, "\n");
 
+	seq_printf(s, "%-15s %lu/%lu\n", "demand/lp cap:",
+		   avg_nr_running_capacity() * SCHED_POWER_SCALE / FIXED_1,
+		   lp_capacity);
+
+	seq_printf(s, "%-15s %lu\n", "background:",
+		   avg_nr_background() * SCHED_POWER_SCALE / FIXED_1);
+
 	seq_printf(s, "%-15s %llu\n", "time-stamp:",
 		   cputime64_to_clock_t(cur_jiffies));
 
@@ -644,6 +790,7 @@ late_initcall(tegra_auto_hotplug_debug_init);
 
 void tegra_auto_hotplug_exit(void)
 {
+	unregister_pm_notifier(&tegra_auto_hotplug_pm_nb);
 	destroy_workqueue(hotplug_wq);
 #ifdef CONFIG_DEBUG_FS
 	debugfs_remove_recursive(hp_debugfs_root);
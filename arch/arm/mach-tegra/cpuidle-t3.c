@@ -75,6 +75,9 @@ module_param(lp2_0_in_idle, bool, 0644);
 static bool lp2_n_in_idle = true;
 module_param(lp2_n_in_idle, bool, 0644);
 
+static bool lp2_predict = true;
+module_param(lp2_predict, bool, 0644);
+
 static struct clk *cpu_clk_for_dvfs;
 static struct clk *twd_clk;
 
@@ -93,6 +96,30 @@ static struct {
 	unsigned int last_lp2_int_count[NR_IRQS];
 } idle_stats;
 
+/*
+ * LP2 residency predictor: a short per-CPU history of idle durations and of
+ * whether each idle was cut short by an interrupt. When most recent idles
+ * ended early, the next one is expected to end as early, and LP2 is skipped
+ * if that predicted residency is below the LP2 break-even (target residency,
+ * which tracks the measured exit latency).
+ */
+#define LP2_PREDICT_DEPTH		8
+
+static struct lp2_predictor {
+	u32 idle_us[LP2_PREDICT_DEPTH];
+	bool irq_wake[LP2_PREDICT_DEPTH];
+	unsigned int pos;
+	s64 request;
+	s64 predicted;
+	unsigned int break_even;
+	bool pending;
+	bool skipped;
+	unsigned int predictions;
+	unsigned int skips;
+	unsigned int hits;
+	unsigned int misses;
+} lp2_predictors[5];
+
 static inline unsigned int time_to_bin(unsigned int time)
 {
 	return fls(time);
@@ -109,6 +136,61 @@ static inline unsigned int cpu_number(unsigned int n)
 	return is_lp_cluster() ? 4 : n;
 }
 
+static bool tegra3_lp2_predict(unsigned int cpu, s64 request,
+				unsigned int break_even)
+{
+	struct lp2_predictor *p = &lp2_predictors[cpu_number(cpu)];
+	unsigned int i, n_irq = 0;
+	u64 sum = 0;
+
+	p->predicted = request;
+	for (i = 0; i < LP2_PREDICT_DEPTH; i++) {
+		if (p->irq_wake[i]) {
+			n_irq++;
+			sum += p->idle_us[i];
+		}
+	}
+	if (n_irq * 2 > LP2_PREDICT_DEPTH) {
+		do_div(sum, n_irq);
+		p->predicted = min_t(s64, request, sum);
+	}
+
+	p->request = request;
+	p->break_even = break_even;
+	p->skipped = p->predicted < break_even;
+	p->pending = true;
+	p->predictions++;
+	if (p->skipped)
+		p->skips++;
+
+	return !p->skipped;
+}
+
+static void tegra3_lp2_predictor_update(unsigned int cpu, s64 us)
+{
+	struct lp2_predictor *p = &lp2_predictors[cpu_number(cpu)];
+
+	if (!p->pending)
+		return;
+	p->pending = false;
+
+	/* prediction was right if the skip/enter decision matched the
+	   residency actually seen */
+	if (p->skipped == (us < p->break_even))
+		p->hits++;
+	else
+		p->misses++;
+
+	p->idle_us[p->pos] = (u32)min_t(s64, us, UINT_MAX);
+	p->irq_wake[p->pos] = us < (p->request - (p->request >> 3));
+	p->pos = (p->pos + 1) % LP2_PREDICT_DEPTH;
+}
+
+void tegra3_cpu_idle_stats_lp2_fallback(unsigned int cpu, s64 us)
+{
+	tegra3_lp2_predictor_update(cpu, us);
+}
+
 void tegra3_cpu_idle_stats_lp2_ready(unsigned int cpu)
 {
 	idle_stats.cpu_ready_count[cpu_number(cpu)]++;
@@ -117,6 +199,7 @@ void tegra3_cpu_idle_stats_lp2_ready(unsigned int cpu)
 void tegra3_cpu_idle_stats_lp2_time(unsigned int cpu, s64 us)
 {
 	idle_stats.cpu_wants_lp2_time[cpu_number(cpu)] += us;
+	tegra3_lp2_predictor_update(cpu, us);
 }
 
 /* Allow rail off only if all secondary CPUs are power gated, and no
@@ -174,6 +257,12 @@ bool tegra3_lp2_is_allowed(struct cpuidle_device *dev,
 		return false;
 	}
 
+	if (lp2_predict &&
+	    !tegra3_lp2_predict(dev->cpu, request, state->target_residency)) {
+		/* Recent idles suggest this one will be cut short */
+		return false;
+	}
+
 	return true;
 }
 
@@ -444,6 +533,7 @@ int tegra3_cpudile_init_soc(void)
 #ifdef CONFIG_DEBUG_FS
 int tegra3_lp2_debug_show(struct seq_file *s, void *data)
 {
+	struct timer_coalesce_stats tc;
 	int bin;
 	int i;
 	seq_printf(s, "                                    cpu0     cpu1     cpu2     cpu3     cpulp\n");
@@ -499,6 +589,48 @@ int tegra3_lp2_debug_show(struct seq_file *s, void *data)
 			idle_stats.cpu_wants_lp2_time[4]) : 0));
 	seq_printf(s, "\n");
 
+	seq_printf(s, "lp2 predictions:                %8u %8u %8u %8u %8u\n",
+		lp2_predictors[0].predictions,
+		lp2_predictors[1].predictions,
+		lp2_predictors[2].predictions,
+		lp2_predictors[3].predictions,
+		lp2_predictors[4].predictions);
+	seq_printf(s, "lp2 predicted skips:            %8u %8u %8u %8u %8u\n",
+		lp2_predictors[0].skips,
+		lp2_predictors[1].skips,
+		lp2_predictors[2].skips,
+		lp2_predictors[3].skips,
+		lp2_predictors[4].skips);
+	seq_printf(s, "lp2 prediction hits:            %8u %8u %8u %8u %8u\n",
+		lp2_predictors[0].hits,
+		lp2_predictors[1].hits,
+		lp2_predictors[2].hits,
+		lp2_predictors[3].hits,
+		lp2_predictors[4].hits);
+	seq_printf(s, "lp2 prediction misses:          %8u %8u %8u %8u %8u\n",
+		lp2_predictors[0].misses,
+		lp2_predictors[1].misses,
+		lp2_predictors[2].misses,
+		lp2_predictors[3].misses,
+		lp2_predictors[4].misses);
+	seq_printf(s, "lp2 last predicted:             %8lld %8lld %8lld %8lld %8lld us\n",
+		lp2_predictors[0].predicted,
+		lp2_predictors[1].predicted,
+		lp2_predictors[2].predicted,
+		lp2_predictors[3].predicted,
+		lp2_predictors[4].predicted);
+	seq_printf(s, "\n");
+
+	timer_coalesce_get_stats(&tc);
+	seq_printf(s, "timer coalescing:               %8lu us\n",
+		timer_coalesce_granularity() / NSEC_PER_USEC);
+	seq_printf(s, "hrtimers aligned:               %8lu\n",
+		tc.hrtimer_aligned);
+	seq_printf(s, "timers aligned:                 %8lu\n",
+		tc.timer_aligned);
+	seq_printf(s, "wakeups avoided (est.):         %8lu\n", tc.shared);
+	seq_printf(s, "\n");
+
 	seq_printf(s, "%19s %8s %8s %8s\n", "", "lp2", "comp", "%");
 	seq_printf(s, "-------------------------------------------------\n");
 	for (bin = 0; bin < 32; bin++) {
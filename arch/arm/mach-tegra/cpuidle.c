@@ -87,12 +87,39 @@ static bool lp2_in_idle __read_mostly = false;
 static bool lp2_in_idle_modifiable __read_mostly = true;
 static bool lp2_disabled_by_suspend;
 
+/* Granularity task timers are coalesced to while LP2 is usable, 0 = off */
+static unsigned int timer_coalesce_us = 8000;
+
+static void tegra_timer_coalesce_update(void)
+{
+	timer_coalesce_set(lp2_in_idle ?
+			   timer_coalesce_us * NSEC_PER_USEC : 0);
+}
+
+static int timer_coalesce_us_set(const char *arg,
+				 const struct kernel_param *kp)
+{
+	int ret = param_set_uint(arg, kp);
+
+	if (!ret)
+		tegra_timer_coalesce_update();
+	return ret;
+}
+
+static struct kernel_param_ops timer_coalesce_us_ops = {
+	.set = timer_coalesce_us_set,
+	.get = param_get_uint,
+};
+module_param_cb(timer_coalesce_us, &timer_coalesce_us_ops,
+		&timer_coalesce_us, 0644);
+
 void tegra_lp2_in_idle(bool enable)
 {
 	/* If LP2 in idle is permanently disabled it can't be re-enabled. */
 	if (lp2_in_idle_modifiable) {
 		lp2_in_idle = enable;
 		lp2_in_idle_modifiable = enable;
+		tegra_timer_coalesce_update();
 		if (!enable)
 			pr_warn("LP2 in idle disabled\n");
 	}
@@ -114,8 +141,12 @@ static int tegra_idle_enter_lp2(struct cpuidle_device *dev,
 
 	if (!lp2_in_idle || lp2_disabled_by_suspend ||
 	    !tegra_lp2_is_allowed(dev, state)) {
+		int lp3_us;
+
 		dev->last_state = &dev->states[0];
-		return tegra_idle_enter_lp3(dev, state);
+		lp3_us = tegra_idle_enter_lp3(dev, state);
+		tegra_cpu_idle_stats_lp2_fallback(dev->cpu, lp3_us);
+		return lp3_us;
 	}
 
 	trace_printk("LP2 entry at %lu us\n",
@@ -249,6 +280,8 @@ static int __init tegra_cpuidle_init(void)
 	ret = tegra_cpudile_init_soc();
 	if (ret)
 		return ret;
+
+	tegra_timer_coalesce_update();
 #endif
 
 	for_each_possible_cpu(cpu) {
@@ -277,6 +310,8 @@ static int lp2_in_idle_set(const char *arg, const struct kernel_param *kp)
 	/* If LP2 in idle is permanently disabled it can't be re-enabled. */
 	if (lp2_in_idle_modifiable) {
 		ret = param_set_bool(arg, kp);
+		if (!ret)
+			tegra_timer_coalesce_update();
 		return ret;
 	}
 #endif
@@ -39,6 +39,7 @@ int tegra2_lp2_debug_show(struct seq_file *s, void *data);
 void tegra3_idle_lp2(struct cpuidle_device *dev, struct cpuidle_state *state);
 void tegra3_cpu_idle_stats_lp2_ready(unsigned int cpu);
 void tegra3_cpu_idle_stats_lp2_time(unsigned int cpu, s64 us);
+void tegra3_cpu_idle_stats_lp2_fallback(unsigned int cpu, s64 us);
 bool tegra3_lp2_is_allowed(struct cpuidle_device *dev,
 			   struct cpuidle_state *state);
 int tegra3_cpudile_init_soc(void);
@@ -76,6 +77,14 @@ static inline void tegra_cpu_idle_stats_lp2_time(unsigned int cpu, s64 us)
 #endif
 }
 
+/* LP2 was selected, but LP3 was entered instead of calling tegra_idle_lp2 */
+static inline void tegra_cpu_idle_stats_lp2_fallback(unsigned int cpu, s64 us)
+{
+#ifdef CONFIG_ARCH_TEGRA_3x_SOC
+	tegra3_cpu_idle_stats_lp2_fallback(cpu, us);
+#endif
+}
+
 static inline void tegra_idle_lp2(struct cpuidle_device *dev,
 			struct cpuidle_state *state)
 {
@@ -45,11 +45,13 @@ static struct mutex *tegra3_cpu_lock;
 static struct workqueue_struct *cpuquiet_wq;
 static struct delayed_work cpuquiet_work;
 static struct work_struct minmax_work;
+static struct work_struct prewarm_work;
 
 static struct kobject *tegra_auto_sysfs_kobject;
 
 static bool no_lp;
 static bool enable;
+static bool async_switch;
 static unsigned long up_delay;
 static unsigned long down_delay;
 static int mp_overhead = 10;
@@ -178,6 +180,29 @@ static void tegra_cpuquiet_work_func(struct work_struct *work)
 	}
 }
 
+static void tegra_cluster_prewarm_work_func(struct work_struct *work)
+{
+	mutex_lock(tegra3_cpu_lock);
+
+	if (async_switch && is_lp_cluster() &&
+	    cpq_state == TEGRA_CPQ_SWITCH_TO_G)
+		tegra_cluster_switch_prewarm(true);
+	else
+		tegra_cluster_switch_prewarm(false);
+
+	mutex_unlock(tegra3_cpu_lock);
+}
+
+/* Keep G cluster pre-warmed only while LP=>G switch is pending */
+static void tegra_cluster_prewarm_update(void)
+{
+	bool pending = async_switch && is_lp_cluster() &&
+		(cpq_state == TEGRA_CPQ_SWITCH_TO_G);
+
+	if (pending != tegra_cluster_switch_prewarmed())
+		queue_work(cpuquiet_wq, &prewarm_work);
+}
+
 static void min_max_constraints_workfunc(struct work_struct *work)
 {
 	int count = -1;
@@ -270,6 +295,7 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 
 	if (suspend) {
 		cpq_state = TEGRA_CPQ_IDLE;
+		tegra_cluster_switch_prewarm(false);
 
 		/* Switch to G-mode if suspend rate is high enough */
 		if (is_lp_cluster() && (cpu_freq >= idle_bottom_freq)) {
@@ -286,6 +312,7 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 			queue_delayed_work(
 				cpuquiet_wq, &cpuquiet_work, up_delay);
 		}
+		tegra_cluster_prewarm_update();
 		return;
 	}
 
@@ -299,6 +326,8 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 	} else {
 		cpq_state = TEGRA_CPQ_IDLE;
 	}
+
+	tegra_cluster_prewarm_update();
 }
 
 static struct notifier_block min_cpus_notifier = {
@@ -327,6 +356,8 @@ static void enable_callback(struct cpuquiet_attribute *attr)
 		cpq_state = TEGRA_CPQ_DISABLED;
 		mutex_unlock(tegra3_cpu_lock);
 		cancel_delayed_work_sync(&cpuquiet_work);
+		cancel_work_sync(&prewarm_work);
+		tegra_cluster_switch_prewarm(false);
 		pr_info("Tegra cpuquiet clusterswitch disabled\n");
 		cpuquiet_device_busy();
 		mutex_lock(tegra3_cpu_lock);
@@ -347,6 +378,7 @@ CPQ_BASIC_ATTRIBUTE(mp_overhead, 0644, int);
 CPQ_ATTRIBUTE(up_delay, 0644, ulong, delay_callback);
 CPQ_ATTRIBUTE(down_delay, 0644, ulong, delay_callback);
 CPQ_ATTRIBUTE(enable, 0644, bool, enable_callback);
+CPQ_BASIC_ATTRIBUTE(async_switch, 0644, bool);
 
 static struct attribute *tegra_auto_attributes[] = {
 	&no_lp_attr.attr,
@@ -356,6 +388,7 @@ static struct attribute *tegra_auto_attributes[] = {
 	&idle_bottom_freq_attr.attr,
 	&mp_overhead_attr.attr,
 	&enable_attr.attr,
+	&async_switch_attr.attr,
 	NULL,
 };
 
@@ -411,6 +444,7 @@ int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 
 	INIT_DELAYED_WORK(&cpuquiet_work, tegra_cpuquiet_work_func);
 	INIT_WORK(&minmax_work, min_max_constraints_workfunc);
+	INIT_WORK(&prewarm_work, tegra_cluster_prewarm_work_func);
 
 	idle_top_freq = clk_get_max_rate(cpu_lp_clk) / 1000;
 	idle_bottom_freq = clk_get_min_rate(cpu_g_clk) / 1000;
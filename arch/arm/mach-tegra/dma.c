@@ -29,6 +29,12 @@
 #include <linux/delay.h>
 #include <linux/clk.h>
 #include <linux/syscore_ops.h>
+#include <linux/ratelimit.h>
+#include <linux/platform_device.h>
+#include <linux/dma-mapping.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <mach/dma.h>
 #include <mach/irqs.h>
 #include <mach/iomap.h>
@@ -109,6 +115,17 @@
 /* Maximum dma transfer size */
 #define TEGRA_DMA_MAX_TRANSFER_SIZE		0x10000
 
+/* Preallocated requests per channel, see tegra_dma_alloc_req() */
+#define TEGRA_DMA_REQ_POOL_SIZE			8
+
+/*
+ * A one shot request is only pre-programmed behind the running one if it
+ * lasts long enough for the ISR of the running one to mark it the last:
+ * otherwise the hardware would run it a second time.
+ */
+static unsigned int chain_min_bytes = 2048;
+module_param(chain_min_bytes, uint, 0644);
+
 static struct clk *dma_clk;
 
 static const unsigned int ahb_addr_wrap_table[8] = {
@@ -139,6 +156,25 @@ struct tegra_dma_channel {
 	dma_callback		callback;
 	struct tegra_dma_req	*cb_req;
 	dma_isr_handler		isr_handler;
+	unsigned int		cyclic_pos;	/* ring offset of running pair */
+	unsigned int		cyclic_next;	/* ring offset of next pair */
+
+	/* one shot req pre-programmed to follow the running one */
+	struct tegra_dma_req	*chain_req;
+	ktime_t			isr_entry;
+
+	struct tegra_dma_req	*req_pool;
+	struct list_head	free_reqs;
+
+	struct {
+		u32		reqs;		/* one shot reqs completed */
+		u32		chained;	/* started by the hardware */
+		u32		restarts;	/* started from the ISR */
+		u32		late;		/* chain missed, req repeated */
+		u32		pool_misses;
+		u64		idle_ns;	/* ISR entry to restart */
+		u32		idle_max_ns;
+	} stats;
 };
 
 #define  NV_DMA_MAX_CHANNELS  32
@@ -154,9 +190,15 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *req);
 static bool tegra_dma_update_hw_partial(struct tegra_dma_channel *ch,
 	struct tegra_dma_req *req);
+static bool tegra_dma_can_chain(struct tegra_dma_req *req,
+	struct tegra_dma_req *next);
+static bool tegra_dma_chain_req(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req);
+static void tegra_dma_unchain_req(struct tegra_dma_channel *ch);
 static void handle_oneshot_dma(struct tegra_dma_channel *ch);
 static void handle_continuous_dbl_dma(struct tegra_dma_channel *ch);
 static void handle_continuous_sngl_dma(struct tegra_dma_channel *ch);
+static void handle_cyclic_dma(struct tegra_dma_channel *ch);
 static void handle_dma_isr_locked(struct tegra_dma_channel *ch);
 
 void tegra_dma_flush(struct tegra_dma_channel *ch)
@@ -199,15 +241,28 @@ static void start_head_req(struct tegra_dma_channel *ch)
 {
 	struct tegra_dma_req *head_req;
 	struct tegra_dma_req *next_req;
+	u32 idle;
+
+	ch->chain_req = NULL;
 	if (!list_empty(&ch->list)) {
 		head_req = list_entry(ch->list.next, typeof(*head_req), node);
 		tegra_dma_update_hw(ch, head_req);
 
-		/* Set next request to idle. */
+		/* The channel was idle at least since the ISR was entered */
+		idle = ktime_to_ns(ktime_sub(ktime_get(), ch->isr_entry));
+		ch->stats.restarts++;
+		ch->stats.idle_ns += idle;
+		if (idle > ch->stats.idle_max_ns)
+			ch->stats.idle_max_ns = idle;
+
+		/* Set next request to idle, or have it follow the head */
 		if (!list_is_last(&head_req->node, &ch->list)) {
 			next_req = list_entry(head_req->node.next,
 					typeof(*head_req), node);
 			next_req->status = TEGRA_DMA_REQ_PENDING;
+			if ((ch->mode & TEGRA_DMA_MODE_ONESHOT) &&
+			    tegra_dma_can_chain(head_req, next_req))
+				tegra_dma_chain_req(ch, next_req);
 		}
 	}
 }
@@ -225,7 +280,9 @@ static void configure_next_req(struct tegra_dma_channel *ch,
 static inline unsigned int get_req_xfer_word_count(
 	struct tegra_dma_channel *ch, struct tegra_dma_req *req)
 {
-	if (ch->mode & TEGRA_DMA_MODE_CONTINUOUS_DOUBLE)
+	if (ch->mode & TEGRA_DMA_MODE_CYCLIC)
+		return req->period_size >> 2;
+	else if (ch->mode & TEGRA_DMA_MODE_CONTINUOUS_DOUBLE)
 		return req->size >> 3;
 	else
 		return req->size >> 2;
@@ -375,11 +432,18 @@ int tegra_dma_dequeue_req(struct tegra_dma_channel *ch,
 		return -ENOENT;
 	}
 
-	if (!stop)
+	if (!stop) {
+		if (req == ch->chain_req)
+			tegra_dma_unchain_req(ch);
 		goto skip_status;
+	}
 
 	status = get_channel_status(ch, req, true);
+	ch->chain_req = NULL;
 	req->bytes_transferred = dma_active_count(ch, req, status);
+	if (ch->mode & TEGRA_DMA_MODE_CYCLIC)
+		req->bytes_transferred = (ch->cyclic_pos +
+			req->bytes_transferred) % req->size;
 
 	if (!list_empty(&ch->list)) {
 		/* if the list is not empty, queue the next request */
@@ -427,8 +491,11 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch)
 
 	/* Pause dma before checking the queue status */
 	pause_dma(true);
+	ch->isr_entry = ktime_get();
 	status = readl(ch->addr + APB_DMA_CHAN_STA);
-	if (status & STA_ISE_EOC) {
+	/* a cyclic req is not completed by its interrupts, and its handler
+	 * pauses the dma itself */
+	if ((status & STA_ISE_EOC) && !(ch->mode & TEGRA_DMA_MODE_CYCLIC)) {
 		handle_dma_isr_locked(ch);
 		cb_req = ch->cb_req;
 		callback = ch->callback;
@@ -448,6 +515,7 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch)
 		/* copy the list into new list. */
 		list_replace_init(&ch->list, &new_list);
 	}
+	ch->chain_req = NULL;
 
 	resume_dma();
 
@@ -527,6 +595,9 @@ int tegra_dma_get_transfer_count(struct tegra_dma_channel *ch,
 
 	status = get_channel_status(ch, req, false);
 	bytes_transferred = dma_active_count(ch, req, status);
+	if (ch->mode & TEGRA_DMA_MODE_CYCLIC)
+		bytes_transferred = (ch->cyclic_pos + bytes_transferred) %
+			req->size;
 	spin_unlock_irqrestore(&ch->lock, irq_flags);
 	return bytes_transferred;
 }
@@ -540,12 +611,24 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 	int start_dma = 0;
 	struct tegra_dma_req *hreq, *hnreq;
 
-	if (req->size > TEGRA_DMA_MAX_TRANSFER_SIZE ||
+	if ((!(ch->mode & TEGRA_DMA_MODE_CYCLIC) &&
+		req->size > TEGRA_DMA_MAX_TRANSFER_SIZE) ||
 		req->source_addr & 0x3 || req->dest_addr & 0x3) {
 		pr_err("Invalid DMA request for channel %d\n", ch->id);
 		return -EINVAL;
 	}
 
+	if ((ch->mode & TEGRA_DMA_MODE_CYCLIC) &&
+	    (!req->period_size || (req->period_size & 0x3) ||
+	     req->period_size * 2 > TEGRA_DMA_MAX_TRANSFER_SIZE ||
+	     req->size % (req->period_size * 2) ||
+	     req->start_offset % (req->period_size * 2) ||
+	     req->start_offset >= req->size)) {
+		pr_err("Invalid cyclic DMA ring 0x%08x/0x%08x for channel %d\n",
+				req->size, req->period_size, ch->id);
+		return -EINVAL;
+	}
+
 	if ((req->size & 0x3) ||
 	   ((ch->mode & TEGRA_DMA_MODE_CONTINUOUS_DOUBLE) && (req->size & 0x7)))
 	{
@@ -563,7 +646,14 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 		}
 	}
 
+	/* the ring never completes, nothing could follow it */
+	if ((ch->mode & TEGRA_DMA_MODE_CYCLIC) && !list_empty(&ch->list)) {
+		spin_unlock_irqrestore(&ch->lock, irq_flags);
+		return -EBUSY;
+	}
+
 	req->bytes_transferred = 0;
+	req->overruns = 0;
 	req->status = TEGRA_DMA_REQ_PENDING;
 	/* STATUS_EMPTY just means the DMA hasn't processed the buf yet. */
 	req->buffer_status = TEGRA_DMA_REQ_BUF_STATUS_EMPTY;
@@ -579,14 +669,19 @@ int tegra_dma_enqueue_req(struct tegra_dma_channel *ch,
 		 * Check to see if this request needs to be configured
 		 * immediately in continuous mode.
 		 */
-		if (ch->mode & TEGRA_DMA_MODE_ONESHOT)
-			goto end;
-
 		hreq = list_entry(ch->list.next, typeof(*hreq), node);
 		hnreq = list_entry(hreq->node.next, typeof(*hnreq), node);
 		if (hnreq != req)
 			goto end;
 
+		/* Let the hardware go on to it without a gap */
+		if (ch->mode & TEGRA_DMA_MODE_ONESHOT) {
+			if (hreq->status == TEGRA_DMA_REQ_INFLIGHT &&
+			    tegra_dma_can_chain(hreq, req))
+				tegra_dma_chain_req(ch, req);
+			goto end;
+		}
+
 		if ((ch->mode & TEGRA_DMA_MODE_CONTINUOUS_DOUBLE) &&
 		    (req->buffer_status != TEGRA_DMA_REQ_BUF_STATUS_HALF_FULL))
 			goto end;
@@ -601,21 +696,77 @@ end:
 }
 EXPORT_SYMBOL(tegra_dma_enqueue_req);
 
+static u32 tegra_dma_idle_avg_us(struct tegra_dma_channel *ch)
+{
+	u64 idle = ch->stats.idle_ns;
+
+	if (!ch->stats.restarts)
+		return 0;
+	do_div(idle, NSEC_PER_USEC);
+	do_div(idle, ch->stats.restarts);
+	return idle;
+}
+
 static void tegra_dma_dump_channel_usage(void)
 {
 	int i;
 	pr_info("DMA channel allocation dump:\n");
 	for (i = TEGRA_SYSTEM_DMA_CH_MIN; i <= TEGRA_SYSTEM_DMA_CH_MAX; i++) {
 		struct tegra_dma_channel *ch = &dma_channels[i];
-		pr_warn("dma %d used by %s\n", i, ch->client_name);
+		pr_warn("dma %d used by %s: %u reqs, %u chained, %u restarts "
+			"idle avg %u us max %u us, %u late\n", i,
+			ch->client_name, ch->stats.reqs, ch->stats.chained,
+			ch->stats.restarts, tegra_dma_idle_avg_us(ch),
+			(u32)(ch->stats.idle_max_ns / NSEC_PER_USEC),
+			ch->stats.late);
 	}
 	return;
 }
 
+struct tegra_dma_req *tegra_dma_alloc_req(struct tegra_dma_channel *ch)
+{
+	struct tegra_dma_req *req = NULL;
+	unsigned long irq_flags;
+
+	spin_lock_irqsave(&ch->lock, irq_flags);
+	if (!list_empty(&ch->free_reqs)) {
+		req = list_first_entry(&ch->free_reqs, typeof(*req), node);
+		list_del(&req->node);
+	} else {
+		ch->stats.pool_misses++;
+	}
+	spin_unlock_irqrestore(&ch->lock, irq_flags);
+
+	if (req)
+		memset(req, 0, sizeof(*req));
+	else
+		req = kzalloc(sizeof(*req), GFP_ATOMIC);
+	return req;
+}
+EXPORT_SYMBOL(tegra_dma_alloc_req);
+
+void tegra_dma_free_req(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req)
+{
+	unsigned long irq_flags;
+
+	if (!ch->req_pool || req < ch->req_pool ||
+	    req >= ch->req_pool + TEGRA_DMA_REQ_POOL_SIZE) {
+		kfree(req);
+		return;
+	}
+
+	spin_lock_irqsave(&ch->lock, irq_flags);
+	list_add(&req->node, &ch->free_reqs);
+	spin_unlock_irqrestore(&ch->lock, irq_flags);
+}
+EXPORT_SYMBOL(tegra_dma_free_req);
+
 struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 		const char namefmt[], ...)
 {
 	int channel;
+	int i;
 	struct tegra_dma_channel *ch = NULL;
 	va_list args;
 	dma_isr_handler isr_handler = NULL;
@@ -637,7 +788,10 @@ struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 		}
 	}
 
-	if (mode & TEGRA_DMA_MODE_ONESHOT)
+	if (mode & TEGRA_DMA_MODE_CYCLIC) {
+		mode |= TEGRA_DMA_MODE_CONTINUOUS_DOUBLE;
+		isr_handler = handle_cyclic_dma;
+	} else if (mode & TEGRA_DMA_MODE_ONESHOT)
 		isr_handler = handle_oneshot_dma;
 	else if (mode & TEGRA_DMA_MODE_CONTINUOUS_DOUBLE)
 		isr_handler = handle_continuous_dbl_dma;
@@ -653,6 +807,16 @@ struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 	ch = &dma_channels[channel];
 	ch->mode = mode;
 	ch->isr_handler = isr_handler;
+
+	/* The shared channel has no single owner to give a pool to */
+	if (!(mode & TEGRA_DMA_SHARED)) {
+		memset(&ch->stats, 0, sizeof(ch->stats));
+		INIT_LIST_HEAD(&ch->free_reqs);
+		ch->req_pool = kcalloc(TEGRA_DMA_REQ_POOL_SIZE,
+			sizeof(*ch->req_pool), GFP_KERNEL);
+		for (i = 0; ch->req_pool && i < TEGRA_DMA_REQ_POOL_SIZE; i++)
+			list_add_tail(&ch->req_pool[i].node, &ch->free_reqs);
+	}
 	va_start(args, namefmt);
 	vsnprintf(ch->client_name, sizeof(ch->client_name),
 		namefmt, args);
@@ -675,6 +839,10 @@ void tegra_dma_free_channel(struct tegra_dma_channel *ch)
 	ch->isr_handler = NULL;
 	ch->callback = NULL;
 	ch->cb_req = NULL;
+	ch->chain_req = NULL;
+	INIT_LIST_HEAD(&ch->free_reqs);
+	kfree(ch->req_pool);
+	ch->req_pool = NULL;
 	mutex_unlock(&tegra_dma_lock);
 }
 EXPORT_SYMBOL(tegra_dma_free_channel);
@@ -742,28 +910,17 @@ exit_config:
 	return configure;
 }
 
-static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
-	struct tegra_dma_req *req)
+/*
+ * One shot chaining: the hardware reloads the pointers and the word count
+ * for the next transfer when the current one ends, like in continuous
+ * single buffer mode, and only stops at the end of a transfer if CSR_ONCE
+ * is set. So with the next req pre-programmed and CSR_ONCE clear the
+ * channel goes on to it without waiting for the ISR, which then either
+ * pre-programs the one after or sets CSR_ONCE to stop after the running
+ * one.
+ */
+static u32 get_ahb_burst(struct tegra_dma_req *req)
 {
-	int ahb_addr_wrap;
-	int apb_addr_wrap;
-	int ahb_bus_width;
-	int apb_bus_width;
-	int index;
-	unsigned int req_transfer_count;
-
-	u32 ahb_seq;
-	u32 apb_seq;
-	u32 ahb_ptr;
-	u32 apb_ptr;
-	u32 csr;
-
-	csr = CSR_FLOW;
-	if (req->complete || req->threshold)
-		csr |= CSR_IE_EOC;
-
-	ahb_seq = AHB_SEQ_INTR_ENB;
-
 	switch (req->req_sel) {
 	case TEGRA_DMA_REQ_SEL_SL2B1:
 	case TEGRA_DMA_REQ_SEL_SL2B2:
@@ -779,22 +936,19 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 #endif
 	case TEGRA_DMA_REQ_SEL_SPI:
 		/* dtv interface has fixed burst size of 4 */
-		if (req->fixed_burst_size) {
-			ahb_seq |= AHB_SEQ_BURST_4;
-			break;
-		}
+		if (req->fixed_burst_size)
+			return AHB_SEQ_BURST_4;
 		/* For spi/slink the burst size based on transfer size
 		 * i.e. if multiple of 32 bytes then busrt is 8
 		 * word(8x32bits) else if multiple of 16 bytes then
 		 * burst is 4 word(4x32bits) else burst size is 1
 		 * word(1x32bits) */
 		if (req->size & 0xF)
-			ahb_seq |= AHB_SEQ_BURST_1;
+			return AHB_SEQ_BURST_1;
 		else if ((req->size >> 4) & 0x1)
-			ahb_seq |= AHB_SEQ_BURST_4;
+			return AHB_SEQ_BURST_4;
 		else
-			ahb_seq |= AHB_SEQ_BURST_8;
-		break;
+			return AHB_SEQ_BURST_8;
 #if defined(CONFIG_ARCH_TEGRA_2x_SOC)
 	case TEGRA_DMA_REQ_SEL_I2S_2:
 	case TEGRA_DMA_REQ_SEL_I2S_1:
@@ -803,14 +957,160 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 	case TEGRA_DMA_REQ_SEL_I2S2_2:
 	case TEGRA_DMA_REQ_SEL_I2S2_1:
 		/* For ARCH_2x i2s/spdif burst size is 4 word */
-		ahb_seq |= AHB_SEQ_BURST_4;
-		break;
+		return AHB_SEQ_BURST_4;
 #endif
-
 	default:
-		ahb_seq |= AHB_SEQ_BURST_1;
-		break;
+		return AHB_SEQ_BURST_1;
+	}
+}
+
+/* Only the pointers and the word count are reloaded, the rest must match */
+static bool tegra_dma_can_chain(struct tegra_dma_req *req,
+	struct tegra_dma_req *next)
+{
+	return req->complete && next->complete &&
+		next->size >= chain_min_bytes &&
+		req->to_memory == next->to_memory &&
+		req->req_sel == next->req_sel &&
+		req->source_wrap == next->source_wrap &&
+		req->dest_wrap == next->dest_wrap &&
+		req->source_bus_width == next->source_bus_width &&
+		req->dest_bus_width == next->dest_bus_width &&
+		get_ahb_burst(req) == get_ahb_burst(next);
+}
+
+/*
+ * Pre-program req behind the running transfer. Fails if that one ended
+ * already: from the enqueue path the ISR will start req, from the ISR it
+ * means the running req has been restarted and is being repeated.
+ */
+static bool tegra_dma_chain_req(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req)
+{
+	u32 csr;
+	unsigned long status;
+
+	pause_dma(false);
+	status = readl(ch->addr + APB_DMA_CHAN_STA);
+	if (status & STA_ISE_EOC) {
+		resume_dma();
+		return false;
+	}
+
+	if (req->to_memory) {
+		writel(req->source_addr, ch->addr + APB_DMA_CHAN_APB_PTR);
+		writel(req->dest_addr, ch->addr + APB_DMA_CHAN_AHB_PTR);
+	} else {
+		writel(req->dest_addr, ch->addr + APB_DMA_CHAN_APB_PTR);
+		writel(req->source_addr, ch->addr + APB_DMA_CHAN_AHB_PTR);
 	}
+	csr = readl(ch->addr + APB_DMA_CHAN_CSR);
+	csr &= ~(CSR_WCOUNT_MASK | CSR_ONCE);
+	csr |= (get_req_xfer_word_count(ch, req) - 1) << CSR_WCOUNT_SHIFT;
+	writel(csr, ch->addr + APB_DMA_CHAN_CSR);
+	resume_dma();
+
+	req->status = TEGRA_DMA_REQ_INFLIGHT;
+	ch->chain_req = req;
+	return true;
+}
+
+/* Stop after the running transfer. Fails if it ended already. */
+static bool tegra_dma_chain_end(struct tegra_dma_channel *ch)
+{
+	u32 csr;
+	unsigned long status;
+	bool ok = false;
+
+	pause_dma(false);
+	status = readl(ch->addr + APB_DMA_CHAN_STA);
+	if (!(status & STA_ISE_EOC)) {
+		csr = readl(ch->addr + APB_DMA_CHAN_CSR);
+		writel(csr | CSR_ONCE, ch->addr + APB_DMA_CHAN_CSR);
+		ok = true;
+	}
+	resume_dma();
+	return ok;
+}
+
+/* The pre-programmed req was dequeued before the hardware got to it */
+static void tegra_dma_unchain_req(struct tegra_dma_channel *ch)
+{
+	struct tegra_dma_req *req = ch->chain_req;
+	u32 csr;
+
+	ch->chain_req = NULL;
+	req->status = TEGRA_DMA_REQ_PENDING;
+	if (tegra_dma_chain_end(ch))
+		return;
+
+	/*
+	 * The hardware is on it already. Still have it stop at its end, the
+	 * pending ISR restarts from whatever is left on the list.
+	 */
+	pause_dma(false);
+	csr = readl(ch->addr + APB_DMA_CHAN_CSR);
+	writel(csr | CSR_ONCE, ch->addr + APB_DMA_CHAN_CSR);
+	resume_dma();
+	pr_warn_ratelimited("dma %d: dequeued req already started\n", ch->id);
+}
+
+/*
+ * Called from the ISR of the req before running: keep the one after it
+ * pre-programmed, or mark running the last. If running ended already it
+ * has been started over, so stop the channel and let its pending ISR
+ * restart from the list.
+ */
+static void tegra_dma_chain_next(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *running)
+{
+	struct tegra_dma_req *next = NULL;
+	bool ok;
+	u32 csr;
+
+	if (!list_is_last(&running->node, &ch->list))
+		next = list_entry(running->node.next, typeof(*next), node);
+
+	if (next && tegra_dma_can_chain(running, next))
+		ok = tegra_dma_chain_req(ch, next);
+	else
+		ok = tegra_dma_chain_end(ch);
+	if (ok)
+		return;
+
+	csr = readl(ch->addr + APB_DMA_CHAN_CSR);
+	writel(csr & ~CSR_ENB, ch->addr + APB_DMA_CHAN_CSR);
+	ch->stats.late++;
+	pr_warn_ratelimited("dma %d: chained req repeated, "
+		"raise chain_min_bytes\n", ch->id);
+}
+
+static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req)
+{
+	int ahb_addr_wrap;
+	int apb_addr_wrap;
+	int ahb_bus_width;
+	int apb_bus_width;
+	int index;
+	unsigned int req_transfer_count;
+
+	u32 ahb_seq;
+	u32 apb_seq;
+	u32 ahb_ptr;
+	u32 apb_ptr;
+	u32 csr;
+
+	csr = CSR_FLOW;
+	if (req->complete || req->threshold)
+		csr |= CSR_IE_EOC;
+	/* more than one pair in the ring needs the ISR to move along it */
+	if ((ch->mode & TEGRA_DMA_MODE_CYCLIC) &&
+	    req->size > req->period_size * 2)
+		csr |= CSR_IE_EOC;
+
+	ahb_seq = AHB_SEQ_INTR_ENB;
+	ahb_seq |= get_ahb_burst(req);
 
 	apb_seq = 0;
 
@@ -849,6 +1149,12 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 		ahb_bus_width = req->source_bus_width;
 	}
 
+	if (ch->mode & TEGRA_DMA_MODE_CYCLIC) {
+		ahb_ptr += req->start_offset;
+		ch->cyclic_pos = req->start_offset;
+		ch->cyclic_next = req->start_offset;
+	}
+
 	apb_addr_wrap >>= 2;
 	ahb_addr_wrap >>= 2;
 
@@ -901,15 +1207,27 @@ static void tegra_dma_update_hw(struct tegra_dma_channel *ch,
 static void handle_oneshot_dma(struct tegra_dma_channel *ch)
 {
 	struct tegra_dma_req *req;
+	struct tegra_dma_req *next;
 
 	req = list_entry(ch->list.next, typeof(*req), node);
 	list_del(&req->node);
 	req->bytes_transferred += req->size;
 	req->status = TEGRA_DMA_REQ_SUCCESS;
+	ch->stats.reqs++;
 
 	ch->callback = req->complete;
 	ch->cb_req = req;
 
+	/* The hardware went on to the pre-programmed req by itself */
+	next = ch->chain_req;
+	ch->chain_req = NULL;
+	if (next && !list_empty(&ch->list) &&
+	    list_entry(ch->list.next, typeof(*next), node) == next) {
+		ch->stats.chained++;
+		tegra_dma_chain_next(ch, next);
+		return;
+	}
+
 	start_head_req(ch);
 	return;
 }
@@ -1006,6 +1324,55 @@ static void handle_continuous_sngl_dma(struct tegra_dma_channel *ch)
 	return;
 }
 
+static void handle_cyclic_dma(struct tegra_dma_channel *ch)
+{
+	struct tegra_dma_req *req;
+	unsigned long ring;
+	unsigned long status;
+
+	req = list_entry(ch->list.next, typeof(*req), node);
+	req->bytes_transferred += req->period_size;
+	req->status = TEGRA_DMA_REQ_INFLIGHT;
+
+	if (req->buffer_status == TEGRA_DMA_REQ_BUF_STATUS_EMPTY) {
+		/*
+		 * The first period of the pair is done and the second one is
+		 * in flight. Point the hardware at the next pair, it picks
+		 * that up when the current one completes.
+		 */
+		req->buffer_status = TEGRA_DMA_REQ_BUF_STATUS_HALF_FULL;
+		ch->cyclic_next = ch->cyclic_pos + req->period_size * 2;
+		if (ch->cyclic_next >= req->size)
+			ch->cyclic_next = 0;
+
+		if (ch->cyclic_next != ch->cyclic_pos) {
+			ring = req->to_memory ? req->dest_addr :
+				req->source_addr;
+			pause_dma(false);
+			status = readl(ch->addr + APB_DMA_CHAN_STA);
+			if (!(status & STA_ISE_EOC))
+				writel(ring + ch->cyclic_next,
+					ch->addr + APB_DMA_CHAN_AHB_PTR);
+			resume_dma();
+
+			/* too late, the hardware reloaded the running pair */
+			if (status & STA_ISE_EOC) {
+				pr_warn_ratelimited("dma %d: cyclic pair "
+					"repeated\n", ch->id);
+				ch->cyclic_next = ch->cyclic_pos;
+				req->overruns++;
+			}
+		}
+	} else {
+		/* The hardware moved on to the next pair by itself */
+		req->buffer_status = TEGRA_DMA_REQ_BUF_STATUS_EMPTY;
+		ch->cyclic_pos = ch->cyclic_next;
+	}
+
+	ch->callback = req->complete;
+	ch->cb_req = req;
+}
+
 static void handle_dma_isr_locked(struct tegra_dma_channel *ch)
 {
 	/* There should be proper isr handler */
@@ -1041,6 +1408,7 @@ static irqreturn_t dma_isr(int irq, void *data)
 			__func__, ch->id);
 	BUG_ON(ch->callback || ch->cb_req);
 
+	ch->isr_entry = ktime_get();
 	status = readl(ch->addr + APB_DMA_CHAN_STA);
 	if (status & STA_ISE_EOC) {
 		/* Clear dma int status */
@@ -1109,6 +1477,7 @@ int __init tegra_dma_init(void)
 
 		spin_lock_init(&ch->lock);
 		INIT_LIST_HEAD(&ch->list);
+		INIT_LIST_HEAD(&ch->free_reqs);
 
 #ifndef CONFIG_ARCH_TEGRA_2x_SOC
 		if (i >= 16)
@@ -1143,6 +1512,28 @@ fail:
 }
 postcore_initcall(tegra_dma_init);
 
+#ifdef CONFIG_TEGRA_APB_DMA
+static u64 tegra_apb_dma_mask = DMA_BIT_MASK(32);
+
+/* the dmaengine provider on top of the channels above */
+static struct platform_device tegra_apb_dma_device = {
+	.name	= "tegra-apb-dma",
+	.id	= -1,
+	.dev	= {
+		.coherent_dma_mask	= DMA_BIT_MASK(32),
+		.dma_mask		= &tegra_apb_dma_mask,
+	},
+};
+
+static int __init tegra_apb_dma_device_init(void)
+{
+	if (!tegra_dma_initialized)
+		return -ENODEV;
+	return platform_device_register(&tegra_apb_dma_device);
+}
+arch_initcall(tegra_apb_dma_device_init);
+#endif
+
 #ifdef CONFIG_PM_SLEEP
 
 static u32 apb_dma[5*TEGRA_SYSTEM_DMA_CH_NR + 3];
@@ -1248,7 +1639,14 @@ static int dbg_dma_show(struct seq_file *s, void *unused)
 	for (i = TEGRA_SYSTEM_DMA_CH_MIN; i <= TEGRA_SYSTEM_DMA_CH_MAX; i++) {
 		struct tegra_dma_channel *ch = &dma_channels[i];
 		if (strlen(ch->client_name) > 0)
-			seq_printf(s, "dma %d -> %s\n", i, ch->client_name);
+			seq_printf(s, "dma %d -> %s: %u reqs, %u chained, "
+				"%u restarts idle avg %u us max %u us, "
+				"%u late, %u pool misses\n", i,
+				ch->client_name, ch->stats.reqs,
+				ch->stats.chained, ch->stats.restarts,
+				tegra_dma_idle_avg_us(ch),
+				(u32)(ch->stats.idle_max_ns / NSEC_PER_USEC),
+				ch->stats.late, ch->stats.pool_misses);
 	}
 	return 0;
 }
@@ -51,6 +51,18 @@ static DEFINE_MUTEX(rail_disable_lock);
 
 static int dvfs_rail_update(struct dvfs_rail *rail);
 
+/* Nesting depth of open DVFS batches, protected by dvfs_lock */
+static int dvfs_batch_depth;
+
+static struct {
+	u32 batches;
+	u32 rates;		/* dvfs rate changes inside batches */
+	u32 cur_rates;
+	u32 max_rates;
+	u32 deferred;		/* rail decreases deferred to batch end */
+	u32 issued;		/* rail updates issued at batch end */
+} dvfs_batch_stats;
+
 void tegra_dvfs_add_relationships(struct dvfs_relationship *rels, int n)
 {
 	int i;
@@ -271,9 +283,12 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 	if (rail->resolving_to)
 		return 0;
 
-	/* Find the maximum voltage requested by any clock */
-	list_for_each_entry(d, &rail->dvfs, reg_node)
+	/* Find the maximum voltage requested by any clock, including
+	   levels prepared for the open batch */
+	list_for_each_entry(d, &rail->dvfs, reg_node) {
 		millivolts = max(d->cur_millivolts, millivolts);
+		millivolts = max(d->batch_millivolts, millivolts);
+	}
 
 	/* retry update if limited by from-relationship to account for
 	   circular dependencies */
@@ -288,6 +303,16 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 		if (rail->new_millivolts == rail->millivolts)
 			break;
 
+		/* inside a batch only raise the rail; staying high is always
+		   safe, the decrease is solved once at batch end */
+		if (dvfs_batch_depth &&
+		    (rail->new_millivolts < rail->millivolts)) {
+			rail->new_millivolts = rail->millivolts;
+			rail->batch_deferred = true;
+			dvfs_batch_stats.deferred++;
+			break;
+		}
+
 		ret = dvfs_rail_set_voltage(rail, rail->new_millivolts);
 	}
 
@@ -340,6 +365,11 @@ __tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
 	int ret;
 	unsigned long *freqs = dvfs_get_freqs(d);
 
+	if (dvfs_batch_depth) {
+		dvfs_batch_stats.rates++;
+		dvfs_batch_stats.cur_rates++;
+	}
+
 	if (freqs == NULL || d->millivolts == NULL)
 		return -ENODEV;
 
@@ -433,6 +463,100 @@ int tegra_dvfs_set_rate(struct clk *c, unsigned long rate)
 }
 EXPORT_SYMBOL(tegra_dvfs_set_rate);
 
+/*
+ * DVFS batches: rate changes of several clocks made between
+ * tegra_dvfs_batch_begin() and tegra_dvfs_batch_end() share rail updates.
+ * Inside a batch rails are only raised, and every decrease is deferred and
+ * solved once per rail at batch end. tegra_dvfs_batch_prepare() announces
+ * the rate a clock is about to get, so that the first raise in the batch
+ * already covers it and later rate changes need no regulator access.
+ * Batches nest; only the outermost end solves the rails.
+ */
+void tegra_dvfs_batch_begin(void)
+{
+	mutex_lock(&dvfs_lock);
+	if (!dvfs_batch_depth++)
+		dvfs_batch_stats.batches++;
+	mutex_unlock(&dvfs_lock);
+}
+EXPORT_SYMBOL(tegra_dvfs_batch_begin);
+
+int tegra_dvfs_batch_prepare(struct clk *c, unsigned long rate)
+{
+	int i = 0;
+	int ret = 0;
+	struct dvfs *d;
+	unsigned long *freqs;
+
+	/* shared bus users are scaled through their bus */
+	while (c && !c->dvfs)
+		c = c->parent;
+	if (!c)
+		return -EINVAL;
+
+	mutex_lock(&dvfs_lock);
+
+	d = c->dvfs;
+	freqs = dvfs_get_freqs(d);
+	if (!dvfs_batch_depth) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (!rate || !d->millivolts)
+		goto out;
+
+	while (i < d->num_freqs && rate > freqs[i])
+		i++;
+	if (i == d->num_freqs) {
+		ret = -EINVAL;
+		goto out;
+	}
+	d->batch_millivolts = max(d->batch_millivolts, d->millivolts[i]);
+
+out:
+	mutex_unlock(&dvfs_lock);
+	return ret;
+}
+EXPORT_SYMBOL(tegra_dvfs_batch_prepare);
+
+void tegra_dvfs_batch_end(void)
+{
+	int mv;
+	struct dvfs *d;
+	struct dvfs_rail *rail;
+
+	mutex_lock(&dvfs_lock);
+
+	if (WARN_ON(!dvfs_batch_depth) || --dvfs_batch_depth)
+		goto out;
+
+	list_for_each_entry(rail, &dvfs_rail_list, node) {
+		list_for_each_entry(d, &rail->dvfs, reg_node) {
+			if (d->batch_millivolts) {
+				d->batch_millivolts = 0;
+				rail->batch_deferred = true;
+			}
+		}
+	}
+
+	list_for_each_entry(rail, &dvfs_rail_list, node) {
+		if (!rail->batch_deferred)
+			continue;
+		rail->batch_deferred = false;
+		mv = rail->millivolts;
+		dvfs_rail_update(rail);
+		if (rail->millivolts != mv)
+			dvfs_batch_stats.issued++;
+	}
+
+	dvfs_batch_stats.max_rates = max(dvfs_batch_stats.max_rates,
+					 dvfs_batch_stats.cur_rates);
+	dvfs_batch_stats.cur_rates = 0;
+out:
+	mutex_unlock(&dvfs_lock);
+}
+EXPORT_SYMBOL(tegra_dvfs_batch_end);
+
 /* May only be called during clock init, does not take any locks on clock c. */
 int __init tegra_enable_dvfs_on_clk(struct clk *c, struct dvfs *d)
 {
@@ -763,6 +887,14 @@ static int dvfs_tree_show(struct seq_file *s, void *data)
 		}
 	}
 
+	seq_printf(s, "\nbatches: %u  rates: %u  max rates: %u\n",
+		dvfs_batch_stats.batches, dvfs_batch_stats.rates,
+		dvfs_batch_stats.max_rates);
+	seq_printf(s, "deferred updates: %u  issued: %u  saved: %u\n",
+		dvfs_batch_stats.deferred, dvfs_batch_stats.issued,
+		dvfs_batch_stats.deferred > dvfs_batch_stats.issued ?
+		dvfs_batch_stats.deferred - dvfs_batch_stats.issued : 0);
+
 	mutex_unlock(&dvfs_lock);
 
 	return 0;
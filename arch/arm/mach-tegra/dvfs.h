@@ -70,6 +70,7 @@ struct dvfs_rail {
 	int millivolts;
 	int new_millivolts;
 	bool suspended;
+	bool batch_deferred;
 	struct rail_stats stats;
 };
 
@@ -92,6 +93,7 @@ struct dvfs {
 	int num_freqs;
 
 	int cur_millivolts;
+	int batch_millivolts;
 	unsigned long cur_rate;
 	struct list_head node;
 	struct list_head debug_node;
@@ -28,6 +28,7 @@ int tegra_sku_id(void);
 void tegra_init_fuse(void);
 u32 tegra_fuse_readl(unsigned long offset);
 void tegra_fuse_writel(u32 value, unsigned long offset);
+void tegra_fuse_read_range(unsigned long offset, u32 *buf, unsigned int count);
 const char *tegra_get_revision_name(void);
 
 #ifdef CONFIG_TEGRA_SILICON_PLATFORM
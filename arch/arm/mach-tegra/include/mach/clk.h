@@ -40,9 +40,18 @@ void tegra_periph_reset_assert(struct clk *c);
 
 #ifdef CONFIG_TEGRA_SILICON_PLATFORM
 int tegra_dvfs_set_rate(struct clk *c, unsigned long rate);
+void tegra_dvfs_batch_begin(void);
+int tegra_dvfs_batch_prepare(struct clk *c, unsigned long rate);
+void tegra_dvfs_batch_end(void);
 #else
 static inline int tegra_dvfs_set_rate(struct clk *c, unsigned long rate)
 { return 0; }
+static inline void tegra_dvfs_batch_begin(void)
+{ }
+static inline int tegra_dvfs_batch_prepare(struct clk *c, unsigned long rate)
+{ return 0; }
+static inline void tegra_dvfs_batch_end(void)
+{ }
 #endif
 unsigned long clk_get_rate_all_locked(struct clk *c);
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
@@ -77,5 +86,32 @@ void tegra_unregister_clk_rate_notifier(
 int tegra_is_clk_enabled(struct clk *clk);
 
 void tegra_cpu_user_cap_set(unsigned int speed_khz);
+void tegra_cpu_boost_floor_set(unsigned int speed_khz);
+
+/* Memory clients that announce their EMC demand ahead of ACTMON */
+enum tegra_emc_bw_client {
+	TEGRA_EMC_BW_DISP1,
+	TEGRA_EMC_BW_DISP2,
+	TEGRA_EMC_BW_GR3D,
+	TEGRA_EMC_BW_AVP,
+	TEGRA_EMC_BW_MC_ISO,	/* measured display traffic, tegra3_mc */
+	TEGRA_EMC_BW_NUM_CLIENTS,
+};
+
+/**
+ * tegra_emc_bw_hint - announce expected EMC demand of a memory client
+ * @client: hinting client
+ * @rate: EMC rate in Hz the client expects to need, 0 to drop the hint
+ *
+ * Hints are combined with ACTMON EMC activity by the EMC governor; they
+ * do not replace the client's own EMC clock request.
+ */
+#ifdef CONFIG_ARCH_TEGRA_3x_SOC
+void tegra_emc_bw_hint(enum tegra_emc_bw_client client, unsigned long rate);
+#else
+static inline void tegra_emc_bw_hint(enum tegra_emc_bw_client client,
+				     unsigned long rate)
+{ }
+#endif
 
 #endif
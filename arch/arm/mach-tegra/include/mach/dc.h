@@ -288,6 +288,8 @@ struct tegra_dc_sd_settings {
 	short bin_width;
 	u8 phase_in_settings;
 	u8 phase_in_adjustments;
+	/* phase_in_adjustments filter, 1/2^smoothing per frame; 0: off */
+	u8 smoothing;
 	u8 cmd;
 	u8 final_agg;
 	u16 cur_agg_step;
@@ -522,6 +524,8 @@ struct tegra_dc_platform_data {
 };
 
 #define TEGRA_DC_FLAG_ENABLED		(1 << 0)
+/* adopt the mode of a controller left running by the bootloader */
+#define TEGRA_DC_FLAG_BOOT_HANDOFF	(1 << 1)
 
 int tegra_dc_get_stride(struct tegra_dc *dc, unsigned win);
 struct tegra_dc *tegra_dc_get_dc(unsigned idx);
@@ -532,6 +536,25 @@ bool tegra_dc_hpd(struct tegra_dc *dc);
 
 void tegra_dc_get_fbvblank(struct tegra_dc *dc, struct fb_vblank *vblank);
 int tegra_dc_wait_for_vsync(struct tegra_dc *dc);
+int tegra_dc_wait_for_frame_end(struct tegra_dc *dc, u32 timeout_ms,
+				s64 *timestamp_ns);
+
+/* one record of the per-frame statistics ring, see tegra_dc_ext.h */
+struct tegra_dc_frame_stat {
+	s64			timestamp_ns;
+	u32			frame;
+	u32			flips;
+	u32			underflow_mask;
+	u32			latency_us;
+};
+
+int tegra_dc_get_frame_stats(struct tegra_dc *dc, u32 *start,
+			     struct tegra_dc_frame_stat *stats, int max,
+			     u32 *next);
+
+int tegra_dc_set_cursor_image(struct tegra_dc *dc, dma_addr_t phys_addr,
+			      bool size_64, u32 foreground, u32 background);
+int tegra_dc_set_cursor(struct tegra_dc *dc, int x, int y, bool visible);
 void tegra_dc_blank(struct tegra_dc *dc);
 
 void tegra_dc_enable(struct tegra_dc *dc);
@@ -555,6 +578,7 @@ bool tegra_dc_does_vsync_separate(struct tegra_dc *dc, s64 new_ts, s64 old_ts);
 int tegra_dc_var_to_dc_mode(struct tegra_dc *dc, struct fb_var_screeninfo *var,
 		struct tegra_dc_mode *mode);
 int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode);
+int tegra_dc_update_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode);
 struct fb_videomode;
 int tegra_dc_set_fb_mode(struct tegra_dc *dc, const struct fb_videomode *fbmode,
 	bool stereo_mode);
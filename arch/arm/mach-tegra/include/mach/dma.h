@@ -70,6 +70,9 @@ enum tegra_dma_mode {
 	TEGRA_DMA_MODE_CONTINUOUS_DOUBLE = TEGRA_DMA_MODE_CONTINUOUS,
 	TEGRA_DMA_MODE_CONTINUOUS_SINGLE = 4,
 	TEGRA_DMA_MODE_ONESHOT = 8,
+	/* One req that the hardware keeps looping over as a ring, see
+	 * period_size. Implies TEGRA_DMA_MODE_CONTINUOUS_DOUBLE. */
+	TEGRA_DMA_MODE_CYCLIC = 16,
 };
 
 /*
@@ -163,6 +166,27 @@ struct tegra_dma_req {
 
 	int fixed_burst_size; /* only for dtv */
 
+	/* Cyclic mode only. The buffer of size bytes is a ring transferred
+	 * in pairs of periods of period_size bytes, one double buffered
+	 * transfer per pair. The ISR points the hardware at the next pair
+	 * while the second period of the current one is in flight, so with
+	 * two periods the hardware loops on its own, and with more there is
+	 * a whole period of interrupt latency to spare. complete is called
+	 * on every period boundary and the req stays queued until it is
+	 * dequeued or the channel is cancelled.
+	 *
+	 * size and start_offset, the ring offset to start at, must be
+	 * multiples of 2 * period_size. tegra_dma_get_transfer_count()
+	 * returns the current ring offset instead of a byte count, and so
+	 * does bytes_transferred once the req has been dequeued.
+	 *
+	 * overruns counts the pairs the hardware went over a second time
+	 * because the ISR was too late to point it at the next one.
+	 */
+	unsigned int period_size;
+	unsigned int start_offset;
+	unsigned int overruns;
+
 	/* Updated by the DMA driver on the conpletion of the request. */
 	int bytes_transferred;
 	int status;
@@ -191,6 +215,15 @@ struct tegra_dma_channel *tegra_dma_allocate_channel(int mode,
 void tegra_dma_free_channel(struct tegra_dma_channel *ch);
 
 int tegra_dma_get_channel_id(struct tegra_dma_channel *ch);
+
+/*
+ * Requests from the preallocated pool of the channel, or from kzalloc()
+ * once that is empty. Safe from atomic context. Give them all back before
+ * tegra_dma_free_channel().
+ */
+struct tegra_dma_req *tegra_dma_alloc_req(struct tegra_dma_channel *ch);
+void tegra_dma_free_req(struct tegra_dma_channel *ch,
+	struct tegra_dma_req *req);
 /*
  * tegra_dma_cancel: Stop the dma and remove all request from pending request
  * queue for transfer.
@@ -203,6 +236,19 @@ int tegra_dma_cancel(struct tegra_dma_channel *ch);
 
 int __init tegra_dma_init(void);
 
+/*
+ * For clients of the dmaengine provider, drivers/dma/tegra-apb-dma.c:
+ * pass one of these as the filter parameter of dma_request_channel().
+ */
+struct dma_chan;
+
+struct tegra_dma_slave {
+	unsigned long req_sel;	/* TEGRA_DMA_REQ_SEL_* of the device */
+	bool cyclic;		/* channel only used with prep_dma_cyclic */
+};
+
+bool tegra_dma_filter(struct dma_chan *chan, void *param);
+
 #else /* !defined(CONFIG_TEGRA_SYSTEM_DMA) */
 static inline int tegra_dma_init(void)
 {
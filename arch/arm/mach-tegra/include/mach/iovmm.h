@@ -59,6 +59,14 @@ struct tegra_iovmm_domain {
 	struct rb_root		all_blocks;  /* ordered by address */
 	struct rb_root		free_blocks; /* ordered by size */
 	struct tegra_iovmm_device *dev;
+	spinlock_t		defer_lock;  /* for the deferred-free batch */
+	struct list_head	deferred;    /* unmapped, awaiting a flush */
+	unsigned int		nr_deferred;
+	tegra_iovmm_addr_t	defer_start; /* span of the deferred batch */
+	tegra_iovmm_addr_t	defer_end;
+	unsigned long		mag_hits;    /* allocations from magazines */
+	unsigned long		mag_misses;
+	unsigned long		batch_flushes;
 };
 
 /*
@@ -67,6 +75,7 @@ struct tegra_iovmm_domain {
  */
 
 struct iovmm_share_group;
+struct iovmm_magazine;
 
 #if !defined(CONFIG_IOMMU_API)
 
@@ -77,6 +86,7 @@ struct tegra_iovmm_client {
 	struct tegra_iovmm_domain	*domain;
 	struct miscdevice		*misc_dev;
 	struct list_head		list;
+	struct iovmm_magazine		*mag;	/* recently freed areas */
 };
 
 /*
@@ -119,9 +129,32 @@ struct tegra_iovmm_device_ops {
 	 * space (potentially freeing PDEs when decommit is true.) */
 	void (*unmap)(struct tegra_iovmm_domain *domain,
 		struct tegra_iovmm_area *io_vma, bool decommit);
+	/*
+	 * optional: as unmap, but leaves the device's translation caches to
+	 * a later flush of the range, so that the invalidations for a batch
+	 * of freed areas can be issued at once
+	 */
+	void (*unmap_noflush)(struct tegra_iovmm_domain *domain,
+		struct tegra_iovmm_area *io_vma, bool decommit);
+	void (*flush)(struct tegra_iovmm_domain *domain,
+		tegra_iovmm_addr_t start, size_t size);
 	void (*map_pfn)(struct tegra_iovmm_domain *domain,
 		struct tegra_iovmm_area *io_vma,
 		unsigned long offs, unsigned long pfn);
+	/*
+	 * optional: maps count physically contiguous pages starting at pfn,
+	 * using larger mappings where the device supports them
+	 */
+	void (*map_pfn_range)(struct tegra_iovmm_domain *domain,
+		struct tegra_iovmm_area *io_vma,
+		unsigned long offs, unsigned long pfn, unsigned long count);
+	/*
+	 * optional: maps count pages, writing all the entries first and
+	 * invalidating the device's translation caches once at the end
+	 */
+	void (*map_pages)(struct tegra_iovmm_domain *domain,
+		struct tegra_iovmm_area *io_vma,
+		unsigned long offs, struct page **pages, unsigned long count);
 	/*
 	 * ensures that a domain is resident in the hardware's mapping region
 	 * so that it may be used by a client
@@ -223,6 +256,20 @@ size_t tegra_iovmm_get_max_free(struct tegra_iovmm_client *client);
 void tegra_iovmm_vm_insert_pfn(struct tegra_iovmm_area *area,
 	tegra_iovmm_addr_t vaddr, unsigned long pfn);
 
+/*
+ * same as tegra_iovmm_vm_insert_pfn, for count physically contiguous pages
+ * starting at pfn. the device may map the range with large pages.
+ */
+void tegra_iovmm_vm_insert_pfn_range(struct tegra_iovmm_area *area,
+	tegra_iovmm_addr_t vaddr, unsigned long pfn, unsigned long count);
+
+/*
+ * maps count pages at vaddr with a single batch of translation cache
+ * flushes, instead of one per page as with tegra_iovmm_vm_insert_pfn.
+ */
+void tegra_iovmm_vm_map_pages(struct tegra_iovmm_area *area,
+	tegra_iovmm_addr_t vaddr, struct page **pages, unsigned long count);
+
 /*
  * called by clients to return the iovmm_area containing addr, or NULL if
  * addr has not been allocated. caller should call tegra_iovmm_area_put when
@@ -306,6 +353,17 @@ static inline void tegra_iovmm_vm_insert_pfn(struct tegra_iovmm_area *area,
 {
 }
 
+static inline void tegra_iovmm_vm_insert_pfn_range(
+	struct tegra_iovmm_area *area, tegra_iovmm_addr_t vaddr,
+	unsigned long pfn, unsigned long count)
+{
+}
+
+static inline void tegra_iovmm_vm_map_pages(struct tegra_iovmm_area *area,
+	tegra_iovmm_addr_t vaddr, struct page **pages, unsigned long count)
+{
+}
+
 static inline struct tegra_iovmm_area *tegra_iovmm_find_area_get(
 	struct tegra_iovmm_client *client, tegra_iovmm_addr_t addr)
 {
@@ -369,6 +427,17 @@ static inline void tegra_iovmm_resume(void)
 
 #define tegra_iovmm_vm_insert_pfn(a, v, n)				\
 	dma_map_page_at((a)->dev, pfn_to_page(n), v, 0, PAGE_SIZE, DMA_NONE);
+#define tegra_iovmm_vm_insert_pfn_range(a, v, n, c)			\
+	dma_map_page_at((a)->dev, pfn_to_page(n), v, 0,			\
+			(c) << PAGE_SHIFT, DMA_NONE);
+#define tegra_iovmm_vm_map_pages(a, v, p, c)				\
+	do {								\
+		unsigned long _i;					\
+		for (_i = 0; _i < (c); _i++)				\
+			dma_map_page_at((a)->dev, (p)[_i],		\
+					(v) + (_i << PAGE_SHIFT), 0,	\
+					PAGE_SIZE, DMA_NONE);		\
+	} while (0)
 
 struct tegra_iovmm_area *tegra_iommu_create_vm(struct device *dev,
 		       dma_addr_t req, size_t size, pgprot_t prot);
@@ -113,6 +113,17 @@ static inline void tegra_latency_allowance_update_tick_length(
 {
 	return;
 }
+
+static inline void tegra_latency_allowance_update_emc_rate(
+						unsigned long emc_rate)
+{
+	return;
+}
+
+static inline void tegra_latency_allowance_underflow(enum tegra_la_id id)
+{
+	return;
+}
 #else
 int tegra_set_latency_allowance(enum tegra_la_id id,
 				unsigned int bandwidth_in_mbps);
@@ -124,6 +135,8 @@ int tegra_enable_latency_scaling(enum tegra_la_id id,
 
 void tegra_disable_latency_scaling(enum tegra_la_id id);
 void tegra_latency_allowance_update_tick_length(unsigned int new_ns_per_tick);
+void tegra_latency_allowance_update_emc_rate(unsigned long emc_rate);
+void tegra_latency_allowance_underflow(enum tegra_la_id id);
 #endif
 
 #endif /* _MACH_TEGRA_LATENCY_ALLOWANCE_H_ */
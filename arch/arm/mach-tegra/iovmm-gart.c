@@ -70,6 +70,10 @@ static inline void gart_set_pte(struct gart_device *gart,
 }
 
 static int gart_map(struct tegra_iovmm_domain *, struct tegra_iovmm_area *);
+static void gart_unmap_noflush(struct tegra_iovmm_domain *,
+	struct tegra_iovmm_area *, bool);
+static void gart_flush(struct tegra_iovmm_domain *,
+	tegra_iovmm_addr_t, size_t);
 static void gart_unmap(struct tegra_iovmm_domain *,
 	struct tegra_iovmm_area *, bool);
 static void gart_map_pfn(struct tegra_iovmm_domain *,
@@ -86,6 +90,8 @@ static void gart_resume(struct tegra_iovmm_device *dev);
 static struct tegra_iovmm_device_ops tegra_iovmm_gart_ops = {
 	.map		= gart_map,
 	.unmap		= gart_unmap,
+	.unmap_noflush	= gart_unmap_noflush,
+	.flush		= gart_flush,
 	.map_pfn	= gart_map_pfn,
 	.alloc_domain	= gart_alloc_domain,
 	.suspend	= gart_suspend,
@@ -306,18 +312,15 @@ fail:
 	return -ENOMEM;
 }
 
-static void gart_unmap(struct tegra_iovmm_domain *domain,
-	struct tegra_iovmm_area *iovma, bool decommit)
+static void __gart_unmap(struct gart_device *gart,
+	struct tegra_iovmm_area *iovma)
 {
-	struct gart_device *gart =
-		container_of(domain, struct gart_device, domain);
 	unsigned long gart_page, count;
 	unsigned int i;
 
 	count = iovma->iovm_length >> GART_PAGE_SHIFT;
 	gart_page = iovma->iovm_start;
 
-	spin_lock(&gart->pte_lock);
 	for (i = 0; i < count; i++) {
 		if (iovma->ops && iovma->ops->release)
 			iovma->ops->release(iovma, i << PAGE_SHIFT);
@@ -325,6 +328,38 @@ static void gart_unmap(struct tegra_iovmm_domain *domain,
 		gart_set_pte(gart, gart_page, 0);
 		gart_page += GART_PAGE_SIZE;
 	}
+}
+
+static void gart_unmap(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, bool decommit)
+{
+	struct gart_device *gart =
+		container_of(domain, struct gart_device, domain);
+
+	spin_lock(&gart->pte_lock);
+	__gart_unmap(gart, iovma);
+	FLUSH_GART_REGS(gart);
+	spin_unlock(&gart->pte_lock);
+}
+
+static void gart_unmap_noflush(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, bool decommit)
+{
+	struct gart_device *gart =
+		container_of(domain, struct gart_device, domain);
+
+	spin_lock(&gart->pte_lock);
+	__gart_unmap(gart, iovma);
+	spin_unlock(&gart->pte_lock);
+}
+
+static void gart_flush(struct tegra_iovmm_domain *domain,
+	tegra_iovmm_addr_t start, size_t size)
+{
+	struct gart_device *gart =
+		container_of(domain, struct gart_device, domain);
+
+	spin_lock(&gart->pte_lock);
 	FLUSH_GART_REGS(gart);
 	spin_unlock(&gart->pte_lock);
 }
@@ -182,6 +182,15 @@
 		pfn_to_page((unsigned long)(pde) & SMMU_PFN_MASK)
 #define SMMU_PFN_TO_PTE(pfn, attr)	(unsigned long)((pfn) | (attr))
 
+/*
+ * A PDE without _PDE_NEXT maps a 4MB section directly. The vacant PDE is
+ * an identity section, so pte-table PDEs are recognized by _PDE_NEXT.
+ */
+#define SMMU_SECTION_SIZE	(SMMU_PAGE_SIZE * SMMU_PTBL_COUNT)
+#define SMMU_PDE_HAS_PTBL(pde)	((pde) & _PDE_NEXT)
+#define SMMU_PFN_TO_SECTION(pfn, attr)	\
+	(unsigned long)(((pfn) & ~(SMMU_PTBL_COUNT - 1)) | (attr))
+
 #define SMMU_ASID_ENABLE(asid)	((asid) | (1 << 31))
 #define SMMU_ASID_DISABLE	0
 #define SMMU_ASID_ASID(n)	((n) & ~SMMU_ASID_ENABLE(0))
@@ -319,6 +328,12 @@ struct smmu_device {
 	unsigned long translation_enable_2_0;	/* Secure reg */
 	unsigned long asid_security_0;	/* Secure reg */
 
+	/* mapping statistics, only approximate across address spaces */
+	unsigned long section_maps;	/* 4MB sections mapped */
+	unsigned long pte_maps;		/* 4KB pages mapped */
+	unsigned long nr_sections;	/* sections currently live */
+	unsigned long range_flushes;	/* batched PTC/TLB flushes */
+
 	unsigned long lowest_asid;	/* Variables for hardware testing */
 	unsigned long debug_asid;
 	unsigned long signature_pid;	/* For debugging aid */
@@ -455,6 +470,42 @@ static void flush_ptc_and_tlb(struct smmu_device *smmu,
 	FLUSH_SMMU_REGS(smmu);
 }
 
+/*
+ * Flushes the PTC, and the TLB entries of as for [iova, iova + size), once
+ * for a whole batch of PDE/PTE updates. A range of a few sections is
+ * flushed by section, anything larger with one ASID-wide TLB flush.
+ * Caller must lock as
+ */
+#define SMMU_FLUSH_SECTIONS_MAX	4
+
+static void flush_ptc_and_tlb_range(struct smmu_as *as,
+		unsigned long iova, size_t size)
+{
+	struct smmu_device *smmu = as->smmu;
+	unsigned long asid = MC_SMMU_TLB_FLUSH_0_TLB_FLUSH_ASID_MATCH__ENABLE |
+		(as->asid << MC_SMMU_TLB_FLUSH_0_TLB_FLUSH_ASID_SHIFT);
+	unsigned long end = iova + size;
+
+	if (!size)
+		return;
+
+	writel(MC_SMMU_PTC_FLUSH_0_PTC_FLUSH_TYPE_ALL,
+		smmu->regs + MC_SMMU_PTC_FLUSH_0);
+	FLUSH_SMMU_REGS(smmu);
+
+	iova = round_down(iova, SMMU_SECTION_SIZE);
+	if (end - iova <= SMMU_FLUSH_SECTIONS_MAX * SMMU_SECTION_SIZE) {
+		for (; iova < end; iova += SMMU_SECTION_SIZE)
+			writel(MC_SMMU_TLB_FLUSH_0_TLB_FLUSH_VA(iova, SECTION) |
+				asid, smmu->regs + MC_SMMU_TLB_FLUSH_0);
+	} else {
+		writel(MC_SMMU_TLB_FLUSH_0_TLB_FLUSH_VA_MATCH_ALL | asid,
+			smmu->regs + MC_SMMU_TLB_FLUSH_0);
+	}
+	FLUSH_SMMU_REGS(smmu);
+	smmu->range_flushes++;
+}
+
 static void free_ptbl(struct smmu_as *as, unsigned long iova)
 {
 	unsigned long pdn = SMMU_ADDR_TO_PDN(iova);
@@ -463,8 +514,13 @@ static void free_ptbl(struct smmu_as *as, unsigned long iova)
 	if (pdir[pdn] != _PDE_VACANT(pdn)) {
 		pr_debug("%s:%d pdn=%lx\n", __func__, __LINE__, pdn);
 
-		ClearPageReserved(SMMU_EX_PTBL_PAGE(pdir[pdn]));
-		__free_page(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+		if (SMMU_PDE_HAS_PTBL(pdir[pdn])) {
+			ClearPageReserved(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+			__free_page(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+		} else {
+			as->smmu->nr_sections--;
+		}
+		as->pte_count[pdn] = 0;
 		pdir[pdn] = _PDE_VACANT(pdn);
 		FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
 		flush_ptc_and_tlb(as->smmu, as, iova, &pdir[pdn],
@@ -538,7 +594,7 @@ static unsigned long *locate_pte(struct smmu_as *as,
 	unsigned long *pdir = kmap(as->pdir_page);
 	unsigned long *ptbl;
 
-	if (pdir[pdn] != _PDE_VACANT(pdn)) {
+	if (SMMU_PDE_HAS_PTBL(pdir[pdn])) {
 		/* Mapped entry table already exists */
 		*ptbl_page_p = SMMU_EX_PTBL_PAGE(pdir[pdn]);
 		ptbl = kmap(*ptbl_page_p);
@@ -546,8 +602,15 @@ static unsigned long *locate_pte(struct smmu_as *as,
 		kunmap(as->pdir_page);
 		return NULL;
 	} else {
-		/* Vacant - allocate a new page table */
+		/*
+		 * Vacant, or a section that is being remapped with pages -
+		 * allocate a new page table
+		 */
 		pr_debug("%s:%d new PTBL pdn=%lx\n", __func__, __LINE__, pdn);
+		if (pdir[pdn] != _PDE_VACANT(pdn)) {
+			as->smmu->nr_sections--;
+			as->pte_count[pdn] = 0;
+		}
 
 		*ptbl_page_p = alloc_page(GFP_KERNEL | __GFP_DMA);
 		if (!*ptbl_page_p) {
@@ -579,6 +642,18 @@ static unsigned long *locate_pte(struct smmu_as *as,
 	return &ptbl[ptn % SMMU_PTBL_COUNT];
 }
 
+static bool smmu_is_section(struct smmu_as *as, unsigned long iova)
+{
+	unsigned long pdn = SMMU_ADDR_TO_PDN(iova);
+	unsigned long *pdir = kmap(as->pdir_page);
+	bool section;
+
+	section = !SMMU_PDE_HAS_PTBL(pdir[pdn]) &&
+		pdir[pdn] != _PDE_VACANT(pdn);
+	kunmap(as->pdir_page);
+	return section;
+}
+
 static void put_signature(struct smmu_as *as,
 			unsigned long addr, unsigned long pfn)
 {
@@ -630,12 +705,16 @@ static int smmu_map(struct tegra_iovmm_domain *domain,
 		if (unlikely((*pte == _PTE_VACANT(addr))))
 			(*pte_counter)--;
 		FLUSH_CPU_DCACHE(pte, ptpage, sizeof *pte);
-		flush_ptc_and_tlb(as->smmu, as, addr, pte, ptpage, 0);
 		kunmap(ptpage);
 		mutex_unlock(&as->lock);
 		put_signature(as, addr, pfn);
 		addr += SMMU_PAGE_SIZE;
 	}
+
+	/* one flush for the whole area once all PTEs are written */
+	mutex_lock(&as->lock);
+	flush_ptc_and_tlb_range(as, iovma->iovm_start, iovma->iovm_length);
+	mutex_unlock(&as->lock);
 	return 0;
 
 fail:
@@ -654,8 +733,6 @@ fail2:
 			if (*pte != _PTE_VACANT(addr)) {
 				*pte = _PTE_VACANT(addr);
 				FLUSH_CPU_DCACHE(pte, page, sizeof *pte);
-				flush_ptc_and_tlb(as->smmu, as, addr, pte,
-						page, 0);
 				kunmap(page);
 				if (!--(*pte_counter))
 					free_ptbl(as, addr);
@@ -664,43 +741,92 @@ fail2:
 			}
 		}
 	}
+	flush_ptc_and_tlb_range(as, iovma->iovm_start, iovma->iovm_length);
 	mutex_unlock(&as->lock);
 	return -ENOMEM;
 }
 
-static void smmu_unmap(struct tegra_iovmm_domain *domain,
+/*
+ * Clears the PTEs of iovma, without flushing the PTC/TLB for them.
+ * Caller must lock as and flush the range afterwards
+ */
+static void __smmu_unmap(struct smmu_as *as,
 	struct tegra_iovmm_area *iovma, bool decommit)
 {
-	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
 	unsigned long addr = iovma->iovm_start;
 	unsigned int pcount = iovma->iovm_length >> SMMU_PAGE_SHIFT;
-	unsigned int i, *pte_counter;
+	unsigned int i, j, n, *pte_counter;
 
 	pr_debug("%s:%d iova=%lx asid=%d\n", __func__, __LINE__,
 		 addr, as - as->smmu->as);
 
-	mutex_lock(&as->lock);
-	for (i = 0; i < pcount; i++) {
+	for (i = 0; i < pcount; i += n, addr += n << SMMU_PAGE_SHIFT) {
 		unsigned long *pte;
 		struct page *page;
 
+		/* handle the PTEs up to the end of this page table at once */
+		n = min_t(unsigned int, pcount - i,
+			  SMMU_PTBL_COUNT - SMMU_ADDR_TO_PFN(addr) %
+			  SMMU_PTBL_COUNT);
+
 		if (iovma->ops && iovma->ops->release)
-			iovma->ops->release(iovma, i << PAGE_SHIFT);
+			for (j = 0; j < n; j++)
+				iovma->ops->release(iovma,
+						    (i + j) << PAGE_SHIFT);
+
+		/* sections lie entirely inside the area they were mapped for */
+		if (n == SMMU_PTBL_COUNT && smmu_is_section(as, addr)) {
+			free_ptbl(as, addr);
+			continue;
+		}
 
 		pte = locate_pte(as, addr, false, &page, &pte_counter);
-		if (pte) {
-			if (*pte != _PTE_VACANT(addr)) {
-				*pte = _PTE_VACANT(addr);
-				FLUSH_CPU_DCACHE(pte, page, sizeof *pte);
-				flush_ptc_and_tlb(as->smmu, as, addr, pte,
-						page, 0);
-				kunmap(page);
-				if (!--(*pte_counter) && decommit)
-					free_ptbl(as, addr);
+		if (!pte)
+			continue;
+
+		for (j = 0; j < n; j++) {
+			unsigned long va = addr + (j << SMMU_PAGE_SHIFT);
+
+			if (pte[j] != _PTE_VACANT(va)) {
+				pte[j] = _PTE_VACANT(va);
+				(*pte_counter)--;
 			}
 		}
-		addr += SMMU_PAGE_SIZE;
+		FLUSH_CPU_DCACHE(pte, page, n * sizeof *pte);
+		kunmap(page);
+		if (!*pte_counter && decommit)
+			free_ptbl(as, addr);
 	}
+}
+
+static void smmu_unmap(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, bool decommit)
+{
+	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
+
+	mutex_lock(&as->lock);
+	__smmu_unmap(as, iovma, decommit);
+	flush_ptc_and_tlb_range(as, iovma->iovm_start, iovma->iovm_length);
+	mutex_unlock(&as->lock);
+}
+
+static void smmu_unmap_noflush(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, bool decommit)
+{
+	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
+
+	mutex_lock(&as->lock);
+	__smmu_unmap(as, iovma, decommit);
+	mutex_unlock(&as->lock);
+}
+
+static void smmu_flush(struct tegra_iovmm_domain *domain,
+	tegra_iovmm_addr_t start, size_t size)
+{
+	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
+
+	mutex_lock(&as->lock);
+	flush_ptc_and_tlb_range(as, start, size);
 	mutex_unlock(&as->lock);
 }
 
@@ -730,7 +856,147 @@ static void smmu_map_pfn(struct tegra_iovmm_domain *domain,
 		flush_ptc_and_tlb(smmu, as, addr, pte, ptpage, 0);
 		kunmap(ptpage);
 		put_signature(as, addr, pfn);
+		smmu->pte_maps++;
+	}
+	mutex_unlock(&as->lock);
+}
+
+/*
+ * Maps a 4MB-aligned iova to a 4MB-aligned, physically contiguous range
+ * with a single PDE, dropping any page table that covered it before.
+ * Caller must lock as and flush the PTC/TLB
+ */
+static void __smmu_map_section(struct smmu_as *as, unsigned long addr,
+	unsigned long pfn)
+{
+	struct smmu_device *smmu = as->smmu;
+	unsigned long pdn = SMMU_ADDR_TO_PDN(addr);
+	unsigned long *pdir;
+
+	pdir = kmap(as->pdir_page);
+	if (SMMU_PDE_HAS_PTBL(pdir[pdn])) {
+		ClearPageReserved(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+		__free_page(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+	} else if (pdir[pdn] != _PDE_VACANT(pdn)) {
+		smmu->nr_sections--;
+	}
+	as->pte_count[pdn] = 0;
+	pdir[pdn] = SMMU_PFN_TO_SECTION(pfn, as->pde_attr);
+	FLUSH_CPU_DCACHE(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
+	kunmap(as->pdir_page);
+	smmu->section_maps++;
+	smmu->nr_sections++;
+}
+
+#define BATCH_PFN(pages, pfn, i)	\
+	((pages) ? page_to_pfn((pages)[i]) : (pfn) + (i))
+
+/* a section can be used if the next 4MB are contiguous and aligned */
+static bool smmu_can_map_section(unsigned long addr, struct page **pages,
+	unsigned long pfn, unsigned long count)
+{
+	unsigned long i;
+
+	if (count < SMMU_PTBL_COUNT || !IS_ALIGNED(addr, SMMU_SECTION_SIZE))
+		return false;
+
+	pfn = BATCH_PFN(pages, pfn, 0);
+	if (!IS_ALIGNED(pfn, SMMU_PTBL_COUNT))
+		return false;
+
+	for (i = 1; pages && i < SMMU_PTBL_COUNT; i++)
+		if (page_to_pfn(pages[i]) != pfn + i)
+			return false;
+
+	return true;
+}
+
+/*
+ * Writes the PDEs/PTEs for count pages at addr, without flushing the
+ * PTC/TLB. The pfn of page i is page_to_pfn(pages[i]), or pfn + i if
+ * pages is NULL. Section-aligned contiguous 4MB chunks are mapped as
+ * sections, which saves the page table and lets a single TLB entry
+ * cover them; the rest is mapped with 4KB PTEs.
+ * Caller must lock as and flush the range afterwards
+ */
+static void __smmu_map_batch(struct smmu_as *as, unsigned long addr,
+	struct page **pages, unsigned long pfn, unsigned long count)
+{
+	unsigned long i = 0;
+
+	while (i < count) {
+		unsigned long *pte;
+		unsigned int *pte_counter;
+		struct page *ptpage;
+		unsigned long j, n;
+
+		if (smmu_can_map_section(addr, pages ? pages + i : NULL,
+					 pfn + i, count - i)) {
+			unsigned long spfn = BATCH_PFN(pages, pfn, i);
+
+			BUG_ON(!pfn_valid(spfn));
+			__smmu_map_section(as, addr, spfn);
+			put_signature(as, addr, spfn);
+			i += SMMU_PTBL_COUNT;
+			addr += SMMU_SECTION_SIZE;
+			continue;
+		}
+
+		/* the PTEs up to the end of this page table */
+		n = min(count - i, SMMU_PTBL_COUNT -
+			SMMU_ADDR_TO_PFN(addr) % SMMU_PTBL_COUNT);
+
+		pte = locate_pte(as, addr, true, &ptpage, &pte_counter);
+		if (!pte)
+			return;
+
+		for (j = 0; j < n; j++) {
+			unsigned long va = addr + (j << SMMU_PAGE_SHIFT);
+			unsigned long p = BATCH_PFN(pages, pfn, i + j);
+
+			BUG_ON(!pfn_valid(p));
+			if (pte[j] == _PTE_VACANT(va))
+				(*pte_counter)++;
+			pte[j] = SMMU_PFN_TO_PTE(p, as->pte_attr);
+			if (unlikely(pte[j] == _PTE_VACANT(va)))
+				(*pte_counter)--;
+			put_signature(as, va, p);
+		}
+		FLUSH_CPU_DCACHE(pte, ptpage, n * sizeof *pte);
+		kunmap(ptpage);
+		as->smmu->pte_maps += n;
+		i += n;
+		addr += n << SMMU_PAGE_SHIFT;
 	}
+}
+
+static void smmu_map_pfn_range(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, unsigned long addr,
+	unsigned long pfn, unsigned long count)
+{
+	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
+
+	pr_debug("%s:%d iova=%lx pfn=%lx count=%lu asid=%d\n", __func__,
+		 __LINE__, addr, pfn, count, as - as->smmu->as);
+
+	mutex_lock(&as->lock);
+	__smmu_map_batch(as, addr, NULL, pfn, count);
+	flush_ptc_and_tlb_range(as, addr, count << SMMU_PAGE_SHIFT);
+	mutex_unlock(&as->lock);
+}
+
+static void smmu_map_pages(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, unsigned long addr,
+	struct page **pages, unsigned long count)
+{
+	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
+
+	pr_debug("%s:%d iova=%lx count=%lu asid=%d\n", __func__, __LINE__,
+		 addr, count, as - as->smmu->as);
+
+	mutex_lock(&as->lock);
+	__smmu_map_batch(as, addr, pages, 0, count);
+	flush_ptc_and_tlb_range(as, addr, count << SMMU_PAGE_SHIFT);
 	mutex_unlock(&as->lock);
 }
 
@@ -924,7 +1190,11 @@ static void smmu_free_domain(
 static struct tegra_iovmm_device_ops tegra_iovmm_smmu_ops = {
 	.map = smmu_map,
 	.unmap = smmu_unmap,
+	.unmap_noflush = smmu_unmap_noflush,
+	.flush = smmu_flush,
 	.map_pfn = smmu_map_pfn,
+	.map_pfn_range = smmu_map_pfn_range,
+	.map_pages = smmu_map_pages,
 	.alloc_domain = smmu_alloc_domain,
 	.free_domain = smmu_free_domain,
 	.suspend = smmu_suspend,
@@ -1202,6 +1472,10 @@ static ssize_t _sysfs_show_smmu(struct device *d,
 	rv += sprintf(buf + rv , "        as: %p\n", smmu->as);
 	rv += sprintf(buf + rv , "    enable: %s\n",
 			smmu->enable ? "yes" : "no");
+	rv += sprintf(buf + rv , "  sections: %lu\n", smmu->nr_sections);
+	rv += sprintf(buf + rv , "sect_maps: %lu\n", smmu->section_maps);
+	rv += sprintf(buf + rv , "  pte_maps: %lu\n", smmu->pte_maps);
+	rv += sprintf(buf + rv , "   flushes: %lu\n", smmu->range_flushes);
 	return rv;
 }
 
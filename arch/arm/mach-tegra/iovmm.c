@@ -47,6 +47,7 @@
 /* flags for the block */
 #define BK_FREE		0 /* indicates free mappings */
 #define BK_MAP_DIRTY	1 /* used by demand-loaded mappings */
+#define BK_CACHED	2 /* freed, held in its client's magazine */
 
 /* flags for the client */
 #define CL_LOCKED	0
@@ -63,6 +64,29 @@ struct tegra_iovmm_block {
 	unsigned long		poison;
 	struct rb_node		free_node;
 	struct rb_node		all_node;
+	struct list_head	defer_node;
+	struct tegra_iovmm_client *owner;
+};
+
+/*
+ * Freed areas are kept in a small per-client magazine, by log2 of their
+ * size in pages, and handed back out to the same client for an area of
+ * exactly the same size without going through the domain's block trees.
+ * Areas reach the magazine (or the free tree) only once the device's
+ * translation caches have been flushed for them: on devices that can
+ * defer that flush, freed areas are unmapped and queued on the domain,
+ * and the queue is flushed with one invalidation per IOVMM_DEFER_BATCH
+ * areas.
+ */
+#define IOVMM_MAG_CLASSES	8	/* areas of 1 to 255 pages */
+#define IOVMM_MAG_DEPTH		4
+#define IOVMM_DEFER_BATCH	16
+
+struct iovmm_magazine {
+	spinlock_t			lock;
+	unsigned int			nr[IOVMM_MAG_CLASSES];
+	struct tegra_iovmm_block	*blocks[IOVMM_MAG_CLASSES]
+						[IOVMM_MAG_DEPTH];
 };
 
 struct iovmm_share_group {
@@ -159,6 +183,11 @@ static int tegra_iovmm_read_proc(char *page, char **start, off_t off,
 				"\t\tsize: %uKiB free: %uKiB "
 				"largest: %uKiB (%u free / %u total blocks)\n",
 				total, total_free, max_free, num_free, num);
+			len += snprintf(page + len, count - len,
+				"\t\tmagazine hits: %lu misses: %lu "
+				"batched flushes: %lu\n",
+				grp->domain->mag_hits, grp->domain->mag_misses,
+				grp->domain->batch_flushes);
 		}
 	}
 	mutex_unlock(&iovmm_group_list_lock);
@@ -443,6 +472,169 @@ fail:
 	return best;
 }
 
+static int iovmm_mag_class(struct tegra_iovmm_domain *domain, size_t size)
+{
+	size_t pages = size >> domain->dev->pgsize_bits;
+
+	if (!pages || ilog2(pages) >= IOVMM_MAG_CLASSES)
+		return -1;
+	return ilog2(pages);
+}
+
+static struct tegra_iovmm_block *iovmm_mag_get(
+	struct tegra_iovmm_client *client, size_t size, size_t align)
+{
+	struct tegra_iovmm_domain *domain = client->domain;
+	struct iovmm_magazine *mag = client->mag;
+	struct tegra_iovmm_block *b = NULL;
+	unsigned long page_size = 1 << domain->dev->pgsize_bits;
+	int class, i;
+
+	size = round_up(size, page_size);
+	class = iovmm_mag_class(domain, size);
+	if (class < 0)
+		return NULL;
+
+	spin_lock(&mag->lock);
+	for (i = mag->nr[class] - 1; i >= 0; i--) {
+		b = mag->blocks[class][i];
+		if (iovmm_length(b) == size &&
+		    !(align && iovmm_start(b) % align))
+			break;
+	}
+	if (i >= 0) {
+		mag->blocks[class][i] = mag->blocks[class][--mag->nr[class]];
+		clear_bit(BK_CACHED, &b->flags);
+		domain->mag_hits++;
+	} else {
+		b = NULL;
+		domain->mag_misses++;
+	}
+	spin_unlock(&mag->lock);
+	return b;
+}
+
+static bool iovmm_mag_put(struct tegra_iovmm_client *client,
+	struct tegra_iovmm_block *b)
+{
+	struct iovmm_magazine *mag = client->mag;
+	int class = iovmm_mag_class(client->domain, iovmm_length(b));
+	bool cached = false;
+
+	if (class < 0)
+		return false;
+
+	spin_lock(&mag->lock);
+	if (mag->nr[class] < IOVMM_MAG_DEPTH) {
+		set_bit(BK_CACHED, &b->flags);
+		mag->blocks[class][mag->nr[class]++] = b;
+		cached = true;
+	}
+	spin_unlock(&mag->lock);
+	return cached;
+}
+
+/* returns the areas held in client's magazine to the domain */
+static bool iovmm_mag_drain(struct tegra_iovmm_client *client)
+{
+	struct iovmm_magazine *mag = client->mag;
+	struct tegra_iovmm_block *b;
+	bool drained = false;
+	int class;
+
+	for (class = 0; class < IOVMM_MAG_CLASSES; class++) {
+		for (;;) {
+			spin_lock(&mag->lock);
+			if (!mag->nr[class]) {
+				spin_unlock(&mag->lock);
+				break;
+			}
+			b = mag->blocks[class][--mag->nr[class]];
+			clear_bit(BK_CACHED, &b->flags);
+			spin_unlock(&mag->lock);
+
+			iovmm_free_block(client->domain, b);
+			drained = true;
+		}
+	}
+	return drained;
+}
+
+/* called once the translations for b are gone from the device */
+static void iovmm_release_block(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_block *b)
+{
+	if (!b->owner || !iovmm_mag_put(b->owner, b))
+		iovmm_free_block(domain, b);
+}
+
+static void iovmm_flush_batch(struct tegra_iovmm_domain *domain,
+	struct list_head *batch, tegra_iovmm_addr_t start,
+	tegra_iovmm_addr_t end)
+{
+	struct tegra_iovmm_block *b, *tmp;
+
+	domain->dev->ops->flush(domain, start, end - start);
+	domain->batch_flushes++;
+
+	list_for_each_entry_safe(b, tmp, batch, defer_node) {
+		list_del(&b->defer_node);
+		iovmm_release_block(domain, b);
+	}
+}
+
+/*
+ * queues b, already unmapped without a flush, on the domain's deferred
+ * batch, flushing the batch once it is full or if force is set
+ */
+static bool iovmm_defer_block(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_block *b, bool force)
+{
+	LIST_HEAD(batch);
+	tegra_iovmm_addr_t start, end;
+
+	spin_lock(&domain->defer_lock);
+	if (b) {
+		list_add_tail(&b->defer_node, &domain->deferred);
+		if (!domain->nr_deferred++) {
+			domain->defer_start = iovmm_start(b);
+			domain->defer_end = iovmm_end(b);
+		} else {
+			domain->defer_start = min(domain->defer_start,
+						  iovmm_start(b));
+			domain->defer_end = max(domain->defer_end,
+						iovmm_end(b));
+		}
+	}
+	if (domain->nr_deferred &&
+	    (force || domain->nr_deferred >= IOVMM_DEFER_BATCH)) {
+		list_splice_init(&domain->deferred, &batch);
+		start = domain->defer_start;
+		end = domain->defer_end;
+		domain->nr_deferred = 0;
+	}
+	spin_unlock(&domain->defer_lock);
+
+	if (list_empty(&batch))
+		return false;
+	iovmm_flush_batch(domain, &batch, start, end);
+	return true;
+}
+
+/*
+ * releases the areas held back in the deferred batch and in client's
+ * magazine, for an allocation which failed without them
+ */
+static bool iovmm_reclaim(struct tegra_iovmm_client *client)
+{
+	bool released;
+
+	released = iovmm_defer_block(client->domain, NULL, true);
+	if (iovmm_mag_drain(client))
+		released = true;
+	return released;
+}
+
 int tegra_iovmm_domain_init(struct tegra_iovmm_domain *domain,
 	struct tegra_iovmm_device *dev, tegra_iovmm_addr_t start,
 	tegra_iovmm_addr_t end)
@@ -460,6 +652,8 @@ int tegra_iovmm_domain_init(struct tegra_iovmm_domain *domain,
 	atomic_set(&domain->locks, 0);
 	atomic_set(&b->ref, 1);
 	spin_lock_init(&domain->block_lock);
+	spin_lock_init(&domain->defer_lock);
+	INIT_LIST_HEAD(&domain->deferred);
 	init_rwsem(&domain->map_lock);
 	init_waitqueue_head(&domain->delay_lock);
 
@@ -491,13 +685,21 @@ struct tegra_iovmm_area *tegra_iovmm_create_vm(
 
 	domain = client->domain;
 
-	if (iovm_start)
+	if (iovm_start) {
 		b = iovmm_allocate_vm(domain, size, align, iovm_start);
-	else
-		b = iovmm_alloc_block(domain, size, align);
+		if (!b && iovmm_reclaim(client))
+			b = iovmm_allocate_vm(domain, size, align, iovm_start);
+	} else {
+		b = iovmm_mag_get(client, size, align);
+		if (!b)
+			b = iovmm_alloc_block(domain, size, align);
+		if (!b && iovmm_reclaim(client))
+			b = iovmm_alloc_block(domain, size, align);
+	}
 	if (!b)
 		return NULL;
 
+	b->owner = client;
 	b->vm_area.domain = domain;
 	b->vm_area.pgprot = pgprot;
 	b->vm_area.ops = ops;
@@ -528,6 +730,48 @@ void tegra_iovmm_vm_insert_pfn(struct tegra_iovmm_area *vm,
 	domain->dev->ops->map_pfn(domain, vm, vaddr, pfn);
 }
 
+void tegra_iovmm_vm_insert_pfn_range(struct tegra_iovmm_area *vm,
+	tegra_iovmm_addr_t vaddr, unsigned long pfn, unsigned long count)
+{
+	struct tegra_iovmm_domain *domain = vm->domain;
+
+	BUG_ON(vaddr & ((1 << domain->dev->pgsize_bits) - 1));
+	BUG_ON(vaddr < vm->iovm_start);
+	BUG_ON(vaddr + (count << PAGE_SHIFT) >
+	       vm->iovm_start + vm->iovm_length);
+	BUG_ON(vm->ops);
+
+	if (domain->dev->ops->map_pfn_range) {
+		domain->dev->ops->map_pfn_range(domain, vm, vaddr, pfn, count);
+		return;
+	}
+
+	for (; count; count--, pfn++, vaddr += PAGE_SIZE)
+		domain->dev->ops->map_pfn(domain, vm, vaddr, pfn);
+}
+
+void tegra_iovmm_vm_map_pages(struct tegra_iovmm_area *vm,
+	tegra_iovmm_addr_t vaddr, struct page **pages, unsigned long count)
+{
+	struct tegra_iovmm_domain *domain = vm->domain;
+	unsigned long i;
+
+	BUG_ON(vaddr & ((1 << domain->dev->pgsize_bits) - 1));
+	BUG_ON(vaddr < vm->iovm_start);
+	BUG_ON(vaddr + (count << PAGE_SHIFT) >
+	       vm->iovm_start + vm->iovm_length);
+	BUG_ON(vm->ops);
+
+	if (domain->dev->ops->map_pages) {
+		domain->dev->ops->map_pages(domain, vm, vaddr, pages, count);
+		return;
+	}
+
+	for (i = 0; i < count; i++, vaddr += PAGE_SIZE)
+		domain->dev->ops->map_pfn(domain, vm, vaddr,
+					  page_to_pfn(pages[i]));
+}
+
 void tegra_iovmm_zap_vm(struct tegra_iovmm_area *vm)
 {
 	struct tegra_iovmm_block *b;
@@ -578,9 +822,16 @@ void tegra_iovmm_free_vm(struct tegra_iovmm_area *vm)
 	b = container_of(vm, struct tegra_iovmm_block, vm_area);
 	domain = vm->domain;
 	down_read(&domain->map_lock);
-	if (!test_and_clear_bit(BK_MAP_DIRTY, &b->flags))
+	if (test_and_clear_bit(BK_MAP_DIRTY, &b->flags)) {
+		/* never mapped, nothing to flush */
+		iovmm_release_block(domain, b);
+	} else if (domain->dev->ops->unmap_noflush) {
+		domain->dev->ops->unmap_noflush(domain, vm, true);
+		iovmm_defer_block(domain, b, false);
+	} else {
 		domain->dev->ops->unmap(domain, vm, true);
-	iovmm_free_block(domain, b);
+		iovmm_release_block(domain, b);
+	}
 	up_read(&domain->map_lock);
 }
 
@@ -618,7 +869,8 @@ struct tegra_iovmm_area *tegra_iovmm_find_area_get(
 	while (n) {
 		b = rb_entry(n, struct tegra_iovmm_block, all_node);
 		if (iovmm_start(b) <= addr && addr <= iovmm_end(b)) {
-			if (test_bit(BK_FREE, &b->flags))
+			if (test_bit(BK_FREE, &b->flags) ||
+			    test_bit(BK_CACHED, &b->flags))
 				b = NULL;
 			break;
 		}
@@ -769,6 +1021,8 @@ void tegra_iovmm_free_client(struct tegra_iovmm_client *client)
 {
 	struct tegra_iovmm_device *dev;
 	struct tegra_iovmm_domain *domain;
+	struct tegra_iovmm_block *b;
+	struct rb_node *n;
 
 	if (!client)
 		return;
@@ -778,6 +1032,17 @@ void tegra_iovmm_free_client(struct tegra_iovmm_client *client)
 	domain = client->domain;
 	dev = domain->dev;
 
+	/* nothing may be handed back to the client once it is gone */
+	iovmm_defer_block(domain, NULL, true);
+	iovmm_mag_drain(client);
+	spin_lock(&domain->block_lock);
+	for (n = rb_first(&domain->all_blocks); n; n = rb_next(n)) {
+		b = rb_entry(n, struct tegra_iovmm_block, all_node);
+		if (b->owner == client)
+			b->owner = NULL;
+	}
+	spin_unlock(&domain->block_lock);
+
 	if (test_and_clear_bit(CL_LOCKED, &client->flags)) {
 		pr_err("freeing locked client %s\n", client->name);
 		if (!atomic_dec_return(&domain->locks)) {
@@ -798,6 +1063,7 @@ void tegra_iovmm_free_client(struct tegra_iovmm_client *client)
 		kfree(client->group->name);
 		kfree(client->group);
 	}
+	kfree(client->mag);
 	kfree(client->name);
 	kfree(client);
 	mutex_unlock(&iovmm_group_list_lock);
@@ -815,6 +1081,10 @@ struct tegra_iovmm_client *__tegra_iovmm_alloc_client(const char *name,
 	c->name = kstrdup(name, GFP_KERNEL);
 	if (!c->name)
 		goto fail;
+	c->mag = kzalloc(sizeof(*c->mag), GFP_KERNEL);
+	if (!c->mag)
+		goto fail;
+	spin_lock_init(&c->mag->lock);
 	c->misc_dev = misc_dev;
 
 	mutex_lock(&iovmm_group_list_lock);
@@ -865,8 +1135,10 @@ struct tegra_iovmm_client *__tegra_iovmm_alloc_client(const char *name,
 fail_lock:
 	mutex_unlock(&iovmm_group_list_lock);
 fail:
-	if (c)
+	if (c) {
+		kfree(c->mag);
 		kfree(c->name);
+	}
 	kfree(c);
 	return NULL;
 }
@@ -69,9 +69,8 @@ static int wait_for_done(void)
  */
 int tegra_kfuse_read(void *dest, size_t len)
 {
+	u32 keys[KFUSE_DATA_SZ / 4];
 	int err;
-	u32 v;
-	unsigned cnt;
 
 	if (len > KFUSE_DATA_SZ)
 		return -EINVAL;
@@ -103,10 +102,10 @@ int tegra_kfuse_read(void *dest, size_t len)
 		return -EIO;
 	}
 
-	for (cnt = 0; cnt < len; cnt += 4) {
-		v = tegra_kfuse_readl(KFUSE_KEYS);
-		memcpy(dest + cnt, &v, sizeof v);
-	}
+	/* KFUSE_KEYS autoincrements: drain it in one go */
+	tegra_apb_readsl(TEGRA_KFUSE_BASE + KFUSE_KEYS, keys,
+			 DIV_ROUND_UP(len, 4));
+	memcpy(dest, keys, len);
 
 	clk_disable(kfuse_clk);
 
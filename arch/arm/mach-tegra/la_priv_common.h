@@ -53,6 +53,10 @@ struct la_scaling_info {
 	int scaling_ref_count;
 	int actual_la_to_set;
 	int la_set;
+	unsigned int bw_in_mbps;	/* last requested bandwidth */
+	unsigned int updates;		/* allowance register writes */
+	atomic_t underflows;		/* reported by the client driver */
+	int qos_saved;			/* allowance to restore after boost */
 };
 
 struct la_scaling_reg_info {
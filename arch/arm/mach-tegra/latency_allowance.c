@@ -23,6 +23,10 @@
 #include <linux/spinlock_types.h>
 #include <linux/spinlock.h>
 #include <linux/stringify.h>
+#include <linux/atomic.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+#include <linux/uaccess.h>
 #include <asm/bug.h>
 #include <asm/io.h>
 #include <asm/string.h>
@@ -31,6 +35,8 @@
 #include <mach/latency_allowance.h>
 #include "la_priv_common.h"
 #include "tegra3_la_priv.h"
+#include "tegra3_emc.h"
+#include "tegra3_mc.h"
 
 #define ENABLE_LA_DEBUG		0
 #define TEST_LA_CODE		0
@@ -49,6 +55,55 @@ static unsigned short id_to_index[ID(MAX_ID) + 1];
 static struct la_scaling_info scaling_info[TEGRA_LA_MAX_ID];
 static int la_scaling_enable_count;
 
+/*
+ * Isochronous clients (display, camera, video decode) keep their requested
+ * bandwidth, and their allowances are recomputed whenever the EMC rate or
+ * any isochronous bandwidth changes: the allowance is the time the client
+ * FIFO can cover at its bandwidth, less the time needed to refill it from
+ * whatever EMC bandwidth the other isochronous clients leave over.
+ */
+static unsigned long la_emc_rate;		/* Hz, 0 if unknown */
+static unsigned int la_iso_bw_in_mbps;		/* sum of isochronous bw */
+static u32 la_emc_updates;
+/* EMC clock is twice the DDR clock on a 32-bit bus */
+#define EMC_RATE_TO_MBPS(rate)	((rate) / 250000)
+
+/*
+ * Memory QoS: static allowances do not protect display and AVP when 3D
+ * saturates the EMC.  When one of them underflows, or the MC statistics
+ * show the EMC near saturation while display is fetching, drop their
+ * allowances to 0 (top arbiter priority), push 3D and CPU writes to the
+ * maximum allowance and throttle ring1 in the arbiter.  The boost is held
+ * for hold_ms after the last trigger.
+ */
+enum {
+	LA_QOS_NONE = 0,
+	LA_QOS_PRIO,
+	LA_QOS_BEST_EFFORT,
+};
+
+static struct {
+	bool enabled;
+	bool boosted;
+	unsigned int period_ms;
+	unsigned int hold_ms;
+	unsigned int util_pct;		/* EMC utilisation trigger */
+	unsigned long boost_until;
+	unsigned long boost_start;
+	u32 boosts;
+	u64 boost_jiffies;
+	unsigned long last_update;
+	unsigned int last_underflows;
+	u64 last_bytes;
+	u64 last_disp_bytes;
+	struct delayed_work work;
+} la_qos = {
+	.enabled = true,
+	.period_ms = 16,
+	.hold_ms = 200,
+	.util_pct = 90,
+};
+
 #define VALIDATE_ID(id) \
 	do { \
 		if (id >= TEGRA_LA_MAX_ID || id_to_index[id] == 0xFFFF) { \
@@ -128,61 +183,186 @@ static void set_vi_latency_thresholds(enum tegra_la_id id)
 	set_thresholds(&vi_info[id - ID(VI_WSB)], id);
 }
 
-/* Sets latency allowance based on clients memory bandwitdh requirement.
- * Bandwidth passed is in mega bytes per second.
- */
-int tegra_set_latency_allowance(enum tegra_la_id id,
-				unsigned int bandwidth_in_mbps)
+static inline bool la_is_iso(enum tegra_la_id id)
+{
+	return (id >= ID(DISPLAY_0A) && id <= ID(DISPLAY_HCB)) ||
+		(id >= ID(VDE_BSEVR) && id <= ID(VDE_TPMW)) ||
+		(id >= ID(VI_RUV) && id <= ID(VI_WY));
+}
+
+/* Must be called with safety_lock held */
+static int la_compute(int idx, unsigned int bandwidth_in_mbps)
 {
 	int ideal_la;
 	int la_to_set;
-	unsigned long reg_read;
-	unsigned long reg_write;
 	unsigned int fifo_size_in_atoms;
+	unsigned int fifo_bytes;
+	unsigned int avail;
 	int bytes_per_atom = normal_atom_size;
 	const int fifo_scale = 4;		/* 25% of the FIFO */
-	struct la_client_info *ci;
-	int idx = id_to_index[id];
-
-	VALIDATE_ID(id);
-	VALIDATE_BW(bandwidth_in_mbps);
+	struct la_client_info *ci = &la_info_array[idx];
 
-	ci = &la_info_array[idx];
 	fifo_size_in_atoms = ci->fifo_size_in_atoms;
 
 #if HACK_LA_FIFO
 	/* pretend that our FIFO is only as deep as the lowest fullness
 	 * we expect to see */
-	if (id >= ID(DISPLAY_0A) && id <= ID(DISPLAY_HCB))
+	if (ci->id >= ID(DISPLAY_0A) && ci->id <= ID(DISPLAY_HCB))
 		fifo_size_in_atoms /= fifo_scale;
 #endif
 
-	if (bandwidth_in_mbps == 0) {
-		la_to_set = MC_LA_MAX_VALUE;
-	} else {
-		ideal_la = (fifo_size_in_atoms * bytes_per_atom * 1000) /
-			   (bandwidth_in_mbps * ns_per_tick);
-		la_to_set = ideal_la - (ci->expiration_in_ns/ns_per_tick) - 1;
+	if (bandwidth_in_mbps == 0)
+		return MC_LA_MAX_VALUE;
+
+	fifo_bytes = fifo_size_in_atoms * bytes_per_atom;
+	ideal_la = (fifo_bytes * 1000) / (bandwidth_in_mbps * ns_per_tick);
+	la_to_set = ideal_la - (ci->expiration_in_ns/ns_per_tick) - 1;
+
+	if (la_emc_rate && la_is_iso(ci->id)) {
+		/* EMC bandwidth left for this client after other iso users */
+		avail = EMC_RATE_TO_MBPS(la_emc_rate) *
+			tegra_emc_bw_efficiency / 100;
+		avail -= min(avail, la_iso_bw_in_mbps - bandwidth_in_mbps);
+		if (avail <= bandwidth_in_mbps)
+			la_to_set = 0;
+		else
+			la_to_set -= (fifo_bytes * 1000) /
+				     (avail * ns_per_tick);
 	}
 
-	la_debug("\n%s:id=%d,idx=%d, bw=%dmbps, la_to_set=%d",
-		__func__, id, idx, bandwidth_in_mbps, la_to_set);
 	la_to_set = (la_to_set < 0) ? 0 : la_to_set;
 	la_to_set = (la_to_set > MC_LA_MAX_VALUE) ? MC_LA_MAX_VALUE : la_to_set;
+	return la_to_set;
+}
+
+static inline int la_qos_class(enum tegra_la_id id)
+{
+	if ((id >= ID(DISPLAY_0A) && id <= ID(DISPLAY_HCB)) ||
+	    id == ID(AVPC_ARM7R) || id == ID(AVPC_ARM7W))
+		return LA_QOS_PRIO;
+	if ((id >= ID(FDCDRD) && id <= ID(FDCDWR2)) ||
+	    id == ID(MPCOREW) || id == ID(MPCORE_LPW))
+		return LA_QOS_BEST_EFFORT;
+	return LA_QOS_NONE;
+}
+
+static inline bool la_qos_overridden(int idx)
+{
+	return la_qos.boosted && la_qos_class(la_info_array[idx].id);
+}
+
+/* Must be called with safety_lock held */
+static void la_write(int idx, int la)
+{
+	unsigned long reg;
+	struct la_client_info *ci = &la_info_array[idx];
+
+	reg = readl(ci->reg_addr);
+	reg = (reg & ~ci->mask) | (la << ci->shift);
+	writel(reg, ci->reg_addr);
+}
+
+static inline int la_read(int idx)
+{
+	struct la_client_info *ci = &la_info_array[idx];
+
+	return (readl(ci->reg_addr) & ci->mask) >> ci->shift;
+}
+
+/* Must be called with safety_lock held */
+static void la_program(int idx, int la_to_set)
+{
+	unsigned long reg_read;
+	unsigned long reg_write;
+	struct la_client_info *ci = &la_info_array[idx];
+
 	scaling_info[idx].actual_la_to_set = la_to_set;
+	if (la_qos_overridden(idx)) {
+		/* applied when the boost ends */
+		scaling_info[idx].qos_saved = la_to_set;
+		return;
+	}
+	if (scaling_info[idx].la_set == la_to_set &&
+	    scaling_info[idx].updates)
+		return;
 
-	spin_lock(&safety_lock);
 	reg_read = readl(ci->reg_addr);
 	reg_write = (reg_read & ~ci->mask) |
 			(la_to_set << ci->shift);
 	writel(reg_write, ci->reg_addr);
 	scaling_info[idx].la_set = la_to_set;
+	scaling_info[idx].updates++;
 	la_debug("reg_addr=0x%x, read=0x%x, write=0x%x",
 		(u32)ci->reg_addr, (u32)reg_read, (u32)reg_write);
-	spin_unlock(&safety_lock);
+}
+
+/* Must be called with safety_lock held */
+static void la_recompute_iso(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
+		if (!la_is_iso(la_info_array[i].id) ||
+		    !scaling_info[i].bw_in_mbps)
+			continue;
+		la_program(i, la_compute(i, scaling_info[i].bw_in_mbps));
+	}
+}
+
+/* Sets latency allowance based on clients memory bandwitdh requirement.
+ * Bandwidth passed is in mega bytes per second.
+ */
+int tegra_set_latency_allowance(enum tegra_la_id id,
+				unsigned int bandwidth_in_mbps)
+{
+	int la_to_set;
+	int idx = id_to_index[id];
+	unsigned long flags;
+
+	VALIDATE_ID(id);
+	VALIDATE_BW(bandwidth_in_mbps);
+
+	spin_lock_irqsave(&safety_lock, flags);
+	if (la_is_iso(id)) {
+		la_iso_bw_in_mbps -= scaling_info[idx].bw_in_mbps;
+		la_iso_bw_in_mbps += bandwidth_in_mbps;
+	}
+	scaling_info[idx].bw_in_mbps = bandwidth_in_mbps;
+
+	la_to_set = la_compute(idx, bandwidth_in_mbps);
+	la_debug("\n%s:id=%d,idx=%d, bw=%dmbps, la_to_set=%d",
+		__func__, id, idx, bandwidth_in_mbps, la_to_set);
+	la_program(idx, la_to_set);
+
+	/* other isochronous clients see a different EMC share now */
+	if (la_is_iso(id))
+		la_recompute_iso();
+	spin_unlock_irqrestore(&safety_lock, flags);
 	return 0;
 }
 
+/* Called by the EMC driver before lowering and after raising the rate,
+ * so that the allowances are never too relaxed for the current rate. */
+void tegra_latency_allowance_update_emc_rate(unsigned long emc_rate)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&safety_lock, flags);
+	if (la_emc_rate != emc_rate) {
+		la_emc_rate = emc_rate;
+		la_emc_updates++;
+		la_recompute_iso();
+	}
+	spin_unlock_irqrestore(&safety_lock, flags);
+}
+
+void tegra_latency_allowance_underflow(enum tegra_la_id id)
+{
+	if (id >= TEGRA_LA_MAX_ID || id_to_index[id] == 0xFFFF)
+		return;
+	atomic_inc(&scaling_info[id_to_index[id]].underflows);
+}
+
 /* Thresholds for scaling are specified in % of fifo freeness.
  * If threshold_low is specified as 20%, it means when the fifo free
  * between 0 to 20%, use la as programmed_la.
@@ -199,6 +379,7 @@ int tegra_enable_latency_scaling(enum tegra_la_id id,
 {
 	unsigned long reg;
 	unsigned long scaling_enable_reg = MC_RA(ARB_OVERRIDE);
+	unsigned long flags;
 	int idx = id_to_index[id];
 
 	VALIDATE_ID(id);
@@ -207,7 +388,7 @@ int tegra_enable_latency_scaling(enum tegra_la_id id,
 	if (la_info_array[idx].scaling_supported == false)
 		goto exit;
 
-	spin_lock(&safety_lock);
+	spin_lock_irqsave(&safety_lock, flags);
 
 	la_debug("\n%s: id=%d, tl=%d, tm=%d, th=%d", __func__,
 		id, threshold_low, threshold_mid, threshold_high);
@@ -226,7 +407,7 @@ int tegra_enable_latency_scaling(enum tegra_la_id id,
 		writel(reg,  scaling_enable_reg);
 		la_debug("enabled scaling.");
 	}
-	spin_unlock(&safety_lock);
+	spin_unlock_irqrestore(&safety_lock, flags);
 exit:
 	return 0;
 }
@@ -235,6 +416,7 @@ void tegra_disable_latency_scaling(enum tegra_la_id id)
 {
 	unsigned long reg;
 	unsigned long scaling_enable_reg = MC_RA(ARB_OVERRIDE);
+	unsigned long flags;
 	int idx;
 
 	BUG_ON(id >= TEGRA_LA_MAX_ID);
@@ -243,7 +425,7 @@ void tegra_disable_latency_scaling(enum tegra_la_id id)
 
 	if (la_info_array[idx].scaling_supported == false)
 		return;
-	spin_lock(&safety_lock);
+	spin_lock_irqsave(&safety_lock, flags);
 	la_debug("\n%s: id=%d", __func__, id);
 	scaling_info[idx].scaling_ref_count--;
 	BUG_ON(scaling_info[idx].scaling_ref_count < 0);
@@ -254,7 +436,7 @@ void tegra_disable_latency_scaling(enum tegra_la_id id)
 		writel(reg, scaling_enable_reg);
 		la_debug("disabled scaling.");
 	}
-	spin_unlock(&safety_lock);
+	spin_unlock_irqrestore(&safety_lock, flags);
 }
 
 void tegra_latency_allowance_update_tick_length(unsigned int new_ns_per_tick)
@@ -262,30 +444,138 @@ void tegra_latency_allowance_update_tick_length(unsigned int new_ns_per_tick)
 	int i = 0;
 	int la;
 	unsigned long reg_read;
-	unsigned long reg_write;
+	unsigned long flags;
 	unsigned long scale_factor = new_ns_per_tick / ns_per_tick;
 
 	if (scale_factor > 1) {
-		spin_lock(&safety_lock);
+		spin_lock_irqsave(&safety_lock, flags);
 		ns_per_tick = new_ns_per_tick;
 		for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
-			reg_read = readl(la_info_array[i].reg_addr);
-			la = ((reg_read & la_info_array[i].mask) >>
-				la_info_array[i].shift) / scale_factor;
-
-			reg_write = (reg_read & ~la_info_array[i].mask) |
-					(la << la_info_array[i].shift);
-			writel(reg_write, la_info_array[i].reg_addr);
-			scaling_info[i].la_set = la;
+			/* clients with a known bandwidth are recomputed,
+			   the rest keep their allowance in time */
+			if (scaling_info[i].bw_in_mbps) {
+				la = la_compute(i, scaling_info[i].bw_in_mbps);
+			} else if (la_qos_overridden(i)) {
+				la = scaling_info[i].qos_saved / scale_factor;
+			} else {
+				reg_read = readl(la_info_array[i].reg_addr);
+				la = ((reg_read & la_info_array[i].mask) >>
+					la_info_array[i].shift) / scale_factor;
+			}
+			la_program(i, la);
 		}
-		spin_unlock(&safety_lock);
+		spin_unlock_irqrestore(&safety_lock, flags);
+	}
+}
+
+/* Must be called with safety_lock held */
+static void la_qos_set(bool boost)
+{
+	int i;
+	int class;
+
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
+		class = la_qos_class(la_info_array[i].id);
+		if (!class)
+			continue;
+
+		if (boost) {
+			scaling_info[i].qos_saved = la_read(i);
+			la_write(i, class == LA_QOS_PRIO ? 0 : MC_LA_MAX_VALUE);
+		} else {
+			la_write(i, scaling_info[i].qos_saved);
+			scaling_info[i].la_set = scaling_info[i].qos_saved;
+		}
+	}
+
+	if (boost) {
+		la_qos.boosts++;
+		la_qos.boost_start = jiffies;
+	} else {
+		la_qos.boost_jiffies += jiffies - la_qos.boost_start;
+	}
+	la_qos.boosted = boost;
+}
+
+static void la_qos_work(struct work_struct *work)
+{
+	int i;
+	unsigned int underflows = 0;
+	unsigned long flags;
+	unsigned long now = jiffies;
+	unsigned int elapsed_us;
+	unsigned long avail;
+	u64 bytes = 0;
+	u64 disp_bytes;
+	bool trigger;
+	bool changed = false;
+
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
+		if (la_qos_class(la_info_array[i].id) == LA_QOS_PRIO)
+			underflows += atomic_read(&scaling_info[i].underflows);
+	}
+	trigger = underflows != la_qos.last_underflows;
 
-		/* Re-scale G2PR, G2SR, G2DR, G2DW with updated ns_per_tick */
-		tegra_set_latency_allowance(TEGRA_LA_G2PR, 20);
-		tegra_set_latency_allowance(TEGRA_LA_G2SR, 20);
-		tegra_set_latency_allowance(TEGRA_LA_G2DR, 20);
-		tegra_set_latency_allowance(TEGRA_LA_G2DW, 20);
+	/* counters only advance while MC statistics are enabled */
+	for (i = 0; i < TEGRA3_MC_NUM_UNITS; i++)
+		bytes += tegra3_mc_unit_bytes(i);
+	disp_bytes = tegra3_mc_unit_bytes(TEGRA3_MC_DISPLAY);
+
+	elapsed_us = jiffies_to_usecs(now - la_qos.last_update);
+	avail = EMC_RATE_TO_MBPS(la_emc_rate) * tegra_emc_bw_efficiency / 100;
+	if (elapsed_us && avail && (disp_bytes != la_qos.last_disp_bytes)) {
+		/* bytes per us is MBps */
+		u64 mbps = div_u64(bytes - la_qos.last_bytes, elapsed_us);
+
+		if (mbps * 100 >= (u64)avail * la_qos.util_pct)
+			trigger = true;
+	}
+
+	la_qos.last_update = now;
+	la_qos.last_underflows = underflows;
+	la_qos.last_bytes = bytes;
+	la_qos.last_disp_bytes = disp_bytes;
+
+	spin_lock_irqsave(&safety_lock, flags);
+	if (trigger)
+		la_qos.boost_until = now + msecs_to_jiffies(la_qos.hold_ms);
+	if (trigger && !la_qos.boosted) {
+		la_qos_set(true);
+		changed = true;
+	} else if (la_qos.boosted && time_after(now, la_qos.boost_until)) {
+		la_qos_set(false);
+		changed = true;
 	}
+	spin_unlock_irqrestore(&safety_lock, flags);
+
+	if (changed)
+		tegra_emc_set_ring1_throttle(la_qos.boosted ?
+					     MC_EMEM_ARB_RING1_THROTTLE_MAX : 0);
+
+	schedule_delayed_work(&la_qos.work,
+			      msecs_to_jiffies(la_qos.period_ms));
+}
+
+static void la_qos_enable(bool enable)
+{
+	unsigned long flags;
+
+	if (enable == la_qos.enabled)
+		return;
+	la_qos.enabled = enable;
+
+	if (enable) {
+		la_qos.last_update = jiffies;
+		schedule_delayed_work(&la_qos.work, 0);
+		return;
+	}
+
+	cancel_delayed_work_sync(&la_qos.work);
+	spin_lock_irqsave(&safety_lock, flags);
+	if (la_qos.boosted)
+		la_qos_set(false);
+	spin_unlock_irqrestore(&safety_lock, flags);
+	tegra_emc_set_ring1_throttle(0);
 }
 
 static int la_regs_show(struct seq_file *s, void *unused)
@@ -315,6 +605,105 @@ static const struct file_operations regs_fops = {
 	.release        = single_release,
 };
 
+static int la_clients_show(struct seq_file *s, void *unused)
+{
+	unsigned i;
+	unsigned long flags;
+
+	spin_lock_irqsave(&safety_lock, flags);
+	seq_printf(s, "emc rate: %lu kHz (%u updates), iso bw: %u MBps, "
+		   "tick: %d ns\n", la_emc_rate / 1000, la_emc_updates,
+		   la_iso_bw_in_mbps, ns_per_tick);
+	seq_printf(s, "%-16s %4s %8s %4s %8s %10s\n", "client", "iso",
+		   "bw(MBps)", "la", "updates", "underflows");
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++) {
+		if (!scaling_info[i].bw_in_mbps &&
+		    !atomic_read(&scaling_info[i].underflows))
+			continue;
+		seq_printf(s, "%-16s %4s %8u %4d %8u %10u\n",
+			   la_info_array[i].name,
+			   la_is_iso(la_info_array[i].id) ? "yes" : "no",
+			   scaling_info[i].bw_in_mbps, scaling_info[i].la_set,
+			   scaling_info[i].updates,
+			   atomic_read(&scaling_info[i].underflows));
+	}
+	spin_unlock_irqrestore(&safety_lock, flags);
+
+	return 0;
+}
+
+static int dbg_la_clients_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, la_clients_show, inode->i_private);
+}
+
+static ssize_t dbg_la_clients_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(la_info_array) - 1; i++)
+		atomic_set(&scaling_info[i].underflows, 0);
+
+	return count;
+}
+
+static const struct file_operations clients_fops = {
+	.open           = dbg_la_clients_open,
+	.read           = seq_read,
+	.write          = dbg_la_clients_write,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
+static int la_qos_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	u64 boost_jiffies;
+
+	spin_lock_irqsave(&safety_lock, flags);
+	boost_jiffies = la_qos.boost_jiffies;
+	if (la_qos.boosted)
+		boost_jiffies += jiffies - la_qos.boost_start;
+	seq_printf(s, "enabled: %d\nboosted: %d\nboosts: %u\n"
+		   "boost time: %u ms\n", la_qos.enabled, la_qos.boosted,
+		   la_qos.boosts, jiffies_to_msecs(boost_jiffies));
+	spin_unlock_irqrestore(&safety_lock, flags);
+
+	return 0;
+}
+
+static int dbg_la_qos_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, la_qos_show, inode->i_private);
+}
+
+static ssize_t dbg_la_qos_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	char buf[4];
+
+	if (count < 1 || count > sizeof(buf) - 1)
+		return -EINVAL;
+	if (copy_from_user(buf, userbuf, count))
+		return -EFAULT;
+	buf[count] = 0;
+
+	if (buf[0] != '0' && buf[0] != '1')
+		return -EINVAL;
+	la_qos_enable(buf[0] == '1');
+
+	return count;
+}
+
+static const struct file_operations qos_fops = {
+	.open           = dbg_la_qos_open,
+	.read           = seq_read,
+	.write          = dbg_la_qos_write,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static int __init tegra_latency_allowance_debugfs_init(void)
 {
 	if (latency_debug_dir)
@@ -324,12 +713,33 @@ static int __init tegra_latency_allowance_debugfs_init(void)
 
 	debugfs_create_file("la_info", S_IRUGO, latency_debug_dir, NULL,
 		&regs_fops);
+	debugfs_create_file("la_clients", S_IRUGO | S_IWUSR,
+		latency_debug_dir, NULL, &clients_fops);
+	debugfs_create_file("qos", S_IRUGO | S_IWUSR,
+		latency_debug_dir, NULL, &qos_fops);
+	debugfs_create_u32("qos_hold_ms", S_IRUGO | S_IWUSR,
+		latency_debug_dir, &la_qos.hold_ms);
+	debugfs_create_u32("qos_util_pct", S_IRUGO | S_IWUSR,
+		latency_debug_dir, &la_qos.util_pct);
 
 	return 0;
 }
 
 late_initcall(tegra_latency_allowance_debugfs_init);
 
+static int __init tegra_latency_allowance_qos_init(void)
+{
+	INIT_DELAYED_WORK_DEFERRABLE(&la_qos.work, la_qos_work);
+	if (la_qos.enabled) {
+		la_qos.last_update = jiffies;
+		schedule_delayed_work(&la_qos.work,
+				      msecs_to_jiffies(la_qos.period_ms));
+	}
+	return 0;
+}
+
+late_initcall(tegra_latency_allowance_qos_init);
+
 static int __init tegra_latency_allowance_init(void)
 {
 	unsigned int i;
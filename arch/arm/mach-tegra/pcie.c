@@ -38,6 +38,12 @@
 #include <linux/regulator/consumer.h>
 #include <linux/workqueue.h>
 #include <linux/gpio.h>
+#include <linux/pci-aspm.h>
+#include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/cpumask.h>
 
 #include <asm/sizes.h>
 #include <asm/mach/pci.h>
@@ -201,6 +207,11 @@
 #define NV_PCIE2_RP_VEND_XP1					0x00000F04
 #define NV_PCIE2_RP_VEND_XP1_LINK_PVT_CTL_L1_ASPM_SUPPORT_ENABLE	1 << 21
 
+/* free running link power state entry counters */
+#define NV_PCIE2_RP_PRIV_XP_RX_L0S_ENTRY_COUNT			0x00000F8C
+#define NV_PCIE2_RP_PRIV_XP_TX_L0S_ENTRY_COUNT			0x00000F90
+#define NV_PCIE2_RP_PRIV_XP_TX_L1_ENTRY_COUNT			0x00000F94
+
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
 /*
  * Tegra2 defines 1GB in the AXI address map for PCIe.
@@ -339,6 +350,19 @@ static bool msi_enable;
 /* when dock is not connected while system boot */
 static bool is_dock_conn_at_boot = true;
 
+/*
+ * ASPM exit latency policy: links whose worst case L0s/L1 exit latency
+ * exceeds these limits keep that state disabled, whatever the endpoint
+ * would accept.  0 leaves the decision to the PCIe core.
+ */
+static unsigned int aspm_l0s_max_ns;
+module_param(aspm_l0s_max_ns, uint, S_IRUGO);
+MODULE_PARM_DESC(aspm_l0s_max_ns, "Disable L0s on links exiting slower (ns)");
+
+static unsigned int aspm_l1_max_us;
+module_param(aspm_l1_max_us, uint, S_IRUGO);
+MODULE_PARM_DESC(aspm_l1_max_us, "Disable L1 on links exiting slower (us)");
+
 void __iomem *tegra_pcie_io_base;
 EXPORT_SYMBOL(tegra_pcie_io_base);
 
@@ -1285,6 +1309,56 @@ static void tegra_pcie_add_port(int index, u32 offset, u32 reset_reg)
 	memset(pp->res, 0, sizeof(pp->res));
 }
 
+/* Upper bounds of the LNKCAP exit latency encodings */
+static unsigned int tegra_pcie_l0s_exit_ns(u32 lnkcap)
+{
+	return 64 << ((lnkcap & PCI_EXP_LNKCAP_L0SEL) >> 12);
+}
+
+static unsigned int tegra_pcie_l1_exit_us(u32 lnkcap)
+{
+	return 1 << ((lnkcap & PCI_EXP_LNKCAP_L1EL) >> 15);
+}
+
+static void tegra_pcie_apply_aspm_policy(void)
+{
+	struct pci_dev *dev = NULL;
+	u32 up_cap, dn_cap;
+	int state;
+
+	if (!aspm_l0s_max_ns && !aspm_l1_max_us)
+		return;
+
+	for_each_pci_dev(dev) {
+		struct pci_dev *up = dev->bus->self;
+
+		if (!up || !pci_is_pcie(dev) || !pci_is_pcie(up))
+			continue;
+
+		pci_read_config_dword(up, pci_pcie_cap(up) + PCI_EXP_LNKCAP,
+				      &up_cap);
+		pci_read_config_dword(dev, pci_pcie_cap(dev) + PCI_EXP_LNKCAP,
+				      &dn_cap);
+
+		state = 0;
+		if (aspm_l0s_max_ns &&
+		    max(tegra_pcie_l0s_exit_ns(up_cap),
+			tegra_pcie_l0s_exit_ns(dn_cap)) > aspm_l0s_max_ns)
+			state |= PCIE_LINK_STATE_L0S;
+		if (aspm_l1_max_us &&
+		    max(tegra_pcie_l1_exit_us(up_cap),
+			tegra_pcie_l1_exit_us(dn_cap)) > aspm_l1_max_us)
+			state |= PCIE_LINK_STATE_L1;
+
+		if (state) {
+			dev_info(&dev->dev, "ASPM: %s%sdisabled by exit latency\n",
+				 state & PCIE_LINK_STATE_L0S ? "L0s " : "",
+				 state & PCIE_LINK_STATE_L1 ? "L1 " : "");
+			pci_disable_link_state(dev, state);
+		}
+	}
+}
+
 static int tegra_pcie_init(void)
 {
 	int err = 0;
@@ -1338,9 +1412,10 @@ static int tegra_pcie_init(void)
 		}
 	}
 
-	if (tegra_pcie.num_ports)
+	if (tegra_pcie.num_ports) {
 		pci_common_init(&tegra_pcie_hw);
-	else {
+		tegra_pcie_apply_aspm_policy();
+	} else {
 		/* no dock is connected, hotplug will occur after boot */
 		err = tegra_pcie_power_off();
 		is_dock_conn_at_boot = false;
@@ -1454,6 +1529,7 @@ static int tegra_pcie_resume(struct device *dev)
 		pci_enable_bridges(bus);
 		pci_bus_add_devices(bus);
 	}
+	tegra_pcie_apply_aspm_policy();
 exit:
 	return 0;
 }
@@ -1496,14 +1572,6 @@ static void __exit tegra_pcie_exit_driver(void)
 module_init(tegra_pcie_init_driver);
 module_exit(tegra_pcie_exit_driver);
 
-static struct irq_chip tegra_irq_chip_msi_pcie = {
-	.name = "PCIe-MSI",
-	.irq_mask = mask_msi_irq,
-	.irq_unmask = unmask_msi_irq,
-	.irq_enable = unmask_msi_irq,
-	.irq_disable = mask_msi_irq,
-};
-
 /* 1:1 matching of these to the MSI vectors, 1 per bit */
 /* and each mapping matches one of the available interrupts */
 /*   irq should equal INT_PCI_MSI_BASE + index */
@@ -1511,6 +1579,16 @@ struct msi_map_entry {
 	bool used;
 	u8 index;
 	int irq;
+	/*
+	 * All vectors arrive on the one AFI interrupt; a vector with an
+	 * affinity elsewhere is handed to its cpu with an IPI.
+	 */
+	int cpu;			/* -1: handle where it arrives */
+	unsigned long pending;
+	unsigned long forwarded;
+#ifdef CONFIG_SMP
+	struct call_single_data csd;
+#endif
 };
 
 /* hardware supports 256 max*/
@@ -1521,6 +1599,52 @@ struct msi_map_entry {
 #define MSI_MAP_SIZE  (INT_PCI_MSI_NR)
 static struct msi_map_entry msi_map[MSI_MAP_SIZE];
 
+#ifdef CONFIG_SMP
+static void tegra_pcie_msi_remote(void *info)
+{
+	struct msi_map_entry *entry = info;
+
+	/* a vector raised again from here on needs another IPI */
+	clear_bit(0, &entry->pending);
+	generic_handle_irq(entry->irq);
+}
+
+/*
+ * Vectors allowed on several cpus are spread over them by vector number,
+ * so the default all-cpu affinity already balances the vectors.
+ */
+static int tegra_pcie_msi_set_affinity(struct irq_data *d,
+				       const struct cpumask *mask, bool force)
+{
+	struct msi_map_entry *entry = msi_map + (d->irq - INT_PCI_MSI_BASE);
+	unsigned int weight = 0, n, cpu;
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask)
+		weight++;
+	if (!weight)
+		return -EINVAL;
+
+	n = entry->index % weight;
+	for_each_cpu_and(cpu, mask, cpu_online_mask)
+		if (!n--)
+			break;
+	entry->cpu = cpu;
+
+	return IRQ_SET_MASK_OK;
+}
+#endif
+
+static struct irq_chip tegra_irq_chip_msi_pcie = {
+	.name = "PCIe-MSI",
+	.irq_mask = mask_msi_irq,
+	.irq_unmask = unmask_msi_irq,
+	.irq_enable = unmask_msi_irq,
+	.irq_disable = mask_msi_irq,
+#ifdef CONFIG_SMP
+	.irq_set_affinity = tegra_pcie_msi_set_affinity,
+#endif
+};
+
 static void msi_map_init(void)
 {
 	int i;
@@ -1529,6 +1653,12 @@ static void msi_map_init(void)
 		msi_map[i].used = false;
 		msi_map[i].index = i;
 		msi_map[i].irq = 0;
+		msi_map[i].cpu = -1;
+		msi_map[i].pending = 0;
+#ifdef CONFIG_SMP
+		msi_map[i].csd.func = tegra_pcie_msi_remote;
+		msi_map[i].csd.info = msi_map + i;
+#endif
 	}
 }
 
@@ -1542,6 +1672,8 @@ static struct msi_map_entry *msi_map_get(void)
 		if (!msi_map[i].used) {
 			retval = msi_map + i;
 			retval->irq = INT_PCI_MSI_BASE + i;
+			retval->cpu = -1;
+			retval->forwarded = 0;
 			retval->used = true;
 			break;
 		}
@@ -1558,6 +1690,23 @@ void msi_map_release(struct msi_map_entry *entry)
 	}
 }
 
+static void tegra_pcie_msi_dispatch(struct msi_map_entry *entry)
+{
+#ifdef CONFIG_SMP
+	int cpu = entry->cpu;
+
+	if (cpu >= 0 && cpu != smp_processor_id() && cpu_online(cpu)) {
+		/* already on its way, that handler run covers this one too */
+		if (!test_and_set_bit(0, &entry->pending)) {
+			entry->forwarded++;
+			__smp_call_function_single(cpu, &entry->csd, 0);
+		}
+		return;
+	}
+#endif
+	generic_handle_irq(entry->irq);
+}
+
 static irqreturn_t tegra_pcie_msi_isr(int irq, void *arg)
 {
 	int i;
@@ -1574,7 +1723,7 @@ static irqreturn_t tegra_pcie_msi_isr(int irq, void *arg)
 			afi_writel(1ul << index, AFI_MSI_VEC0_0 + i * 4);
 			if (index < MSI_MAP_SIZE) {
 				if (msi_map[index].used)
-					generic_handle_irq(msi_map[index].irq);
+					tegra_pcie_msi_dispatch(msi_map + index);
 				else
 					printk(KERN_INFO "unexpected MSI (1)\n");
 			} else {
@@ -1706,3 +1855,102 @@ void arch_teardown_msi_irq(unsigned int irq)
 		}
 	}
 }
+
+#ifdef CONFIG_DEBUG_FS
+static u32 aspm_last[MAX_PCIE_SUPPORTED_PORTS][3];
+
+static int tegra_pcie_aspm_show(struct seq_file *s, void *data)
+{
+	static const unsigned long regs[3] = {
+		NV_PCIE2_RP_PRIV_XP_RX_L0S_ENTRY_COUNT,
+		NV_PCIE2_RP_PRIV_XP_TX_L0S_ENTRY_COUNT,
+		NV_PCIE2_RP_PRIV_XP_TX_L1_ENTRY_COUNT,
+	};
+	static const char * const aspm_names[4] = {
+		"off", "l0s", "l1", "l0sl1",
+	};
+	int i, j;
+
+	seq_printf(s, "port  aspm   rx_l0s      tx_l0s      tx_l1"
+		   "       (since last read)\n");
+	for (i = 0; i < tegra_pcie.num_ports; i++) {
+		struct tegra_pcie_port *pp = tegra_pcie.port + i;
+		u32 ctl, cnt[3];
+
+		if (!pp->base || is_pcie_noirq_op)
+			continue;
+
+		ctl = rp_readl(RP_LINK_CONTROL_STATUS, pp->index);
+		seq_printf(s, "%-4d  %-5s", pp->index,
+			   aspm_names[ctl & PCI_EXP_LNKCTL_ASPMC]);
+		for (j = 0; j < 3; j++) {
+			cnt[j] = rp_readl(regs[j], pp->index);
+			seq_printf(s, "  %-10u", cnt[j] - aspm_last[i][j]);
+			aspm_last[i][j] = cnt[j];
+		}
+		seq_printf(s, "\n");
+	}
+
+	return 0;
+}
+
+static int tegra_pcie_aspm_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_pcie_aspm_show, inode->i_private);
+}
+
+static const struct file_operations tegra_pcie_aspm_fops = {
+	.open		= tegra_pcie_aspm_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int tegra_pcie_msi_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	seq_printf(s, "irq   vector  cpu  forwarded\n");
+	for (i = 0; i < MSI_MAP_SIZE; i++) {
+		if (!msi_map[i].used)
+			continue;
+		seq_printf(s, "%-4d  %-6d  %-3d  %lu\n", msi_map[i].irq,
+			   msi_map[i].index, msi_map[i].cpu,
+			   msi_map[i].forwarded);
+	}
+
+	return 0;
+}
+
+static int tegra_pcie_msi_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_pcie_msi_show, inode->i_private);
+}
+
+static const struct file_operations tegra_pcie_msi_fops = {
+	.open		= tegra_pcie_msi_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_pcie_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("tegra_pcie", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("aspm", S_IRUGO, dir, NULL,
+				 &tegra_pcie_aspm_fops) ||
+	    !debugfs_create_file("msi", S_IRUGO, dir, NULL,
+				 &tegra_pcie_msi_fops)) {
+		debugfs_remove_recursive(dir);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+late_initcall(tegra_pcie_debugfs_init);
+#endif
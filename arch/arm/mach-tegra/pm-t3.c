@@ -27,6 +27,7 @@
 #include <linux/device.h>
 #include <linux/module.h>
 #include <linux/clockchips.h>
+#include <linux/lat_hist.h>
 
 #include <mach/gpio.h>
 #include <mach/iomap.h>
@@ -58,6 +59,8 @@
 #define CAR_SUPER_CCLKG_DIVIDER \
 	(IO_ADDRESS(TEGRA_CLK_RESET_BASE) + 0x36C)
 
+DEFINE_LAT_HIST(cluster_switch_hist, "cluster_switch");
+
 #define CAR_CCLKLP_BURST_POLICY \
 	(IO_ADDRESS(TEGRA_CLK_RESET_BASE) + 0x370)
 #define PLLX_DIV2_BYPASS_LP	(1<<16)
@@ -351,6 +354,8 @@ int tegra_cluster_control(unsigned int us, unsigned int flags)
 					? TEGRA_POWER_CLUSTER_LP
 					: TEGRA_POWER_CLUSTER_G;
 	unsigned long irq_flags;
+	ktime_t start = ktime_set(0, 0);
+	bool timed;
 
 	if ((target_cluster == TEGRA_POWER_CLUSTER_MASK) || !target_cluster)
 		return -EINVAL;
@@ -381,6 +386,11 @@ int tegra_cluster_control(unsigned int us, unsigned int flags)
 
 	local_irq_save(irq_flags);
 
+	/* a wake timer makes the switch a sleep, not worth timing */
+	timed = !us && !timekeeping_suspended;
+	if (timed)
+		start = lat_hist_start();
+
 	if (current_cluster != target_cluster && !timekeeping_suspended) {
 		ktime_t now = ktime_get();
 		if (target_cluster == TEGRA_POWER_CLUSTER_G) {
@@ -422,12 +432,21 @@ int tegra_cluster_control(unsigned int us, unsigned int flags)
 		cpu_pm_exit();
 		tegra_clear_cpu_in_lp2(0);
 	}
+	if (timed)
+		lat_hist_add_since(&cluster_switch_hist, start);
 	local_irq_restore(irq_flags);
 
 	DEBUG_CLUSTER(("%s: %s\r\n", __func__, is_lp_cluster() ? "LP" : "G"));
 
 	return 0;
 }
+
+static int __init tegra_cluster_hist_init(void)
+{
+	lat_hist_register(&cluster_switch_hist);
+	return 0;
+}
+late_initcall(tegra_cluster_hist_init);
 #endif
 
 #ifdef CONFIG_PM_SLEEP
@@ -43,6 +43,7 @@
 #include <linux/memblock.h>
 #include <linux/console.h>
 #include <linux/pm_qos_params.h>
+#include <linux/perflog.h>
 #include <linux/tegra_audio.h>
 
 #include <trace/events/power.h>
@@ -214,6 +215,124 @@ static unsigned long
 #define tegra_cluster_switch_time(flags, id) do {} while(0)
 #endif
 
+/*
+ * Resume latency breakdown. Phases are stamped with the free running us
+ * timer, which restarts when the chip comes out of LP0, so the wake stamp
+ * after LP0 is the time spent in the boot ROM and warmboot code. Device
+ * callback times come from the device_pm_report_time tracepoint.
+ */
+enum tegra_resume_phase {
+	TEGRA_RESUME_PHASE_WAKE = 0,	/* first kernel code after sleep */
+	TEGRA_RESUME_PHASE_CPU,		/* cpu complex and MC restored */
+	TEGRA_RESUME_PHASE_PLATFORM,	/* board resume callbacks */
+	TEGRA_RESUME_PHASE_SYSCORE,	/* syscore, irqs, non-boot cpus */
+	TEGRA_RESUME_PHASE_NOIRQ,	/* noirq device callbacks */
+	TEGRA_RESUME_PHASE_DEVICES,	/* device callbacks, thaw */
+	TEGRA_RESUME_PHASE_LATE_RESUME,	/* early suspend handlers */
+	TEGRA_RESUME_PHASE_MAX
+};
+
+/*
+ * Suspend latency breakdown, the mirror image of the above: each phase is
+ * stamped when it ends, counting from the PM_SUSPEND_PREPARE notifier.
+ */
+enum tegra_suspend_phase {
+	TEGRA_SUSPEND_PHASE_START = 0,	/* PM_SUSPEND_PREPARE */
+	TEGRA_SUSPEND_PHASE_FREEZE,	/* pm notifiers, task freezing */
+	TEGRA_SUSPEND_PHASE_DEVICES,	/* device callbacks */
+	TEGRA_SUSPEND_PHASE_NOIRQ,	/* noirq device callbacks */
+	TEGRA_SUSPEND_PHASE_SYSCORE,	/* non-boot cpus, syscore */
+	TEGRA_SUSPEND_PHASE_CPU,	/* cpu complex and MC saved */
+	TEGRA_SUSPEND_PHASE_MAX
+};
+
+#if defined(CONFIG_PM_SLEEP) && defined(CONFIG_DEBUG_FS)
+#define TEGRA_RESUME_DEV_MAX	16
+
+struct tegra_resume_dev_time {
+	char name[32];
+	const char *pm_ops;
+	u32 usecs;
+	u32 end;
+};
+
+static struct {
+	bool active;		/* between suspend entry and thaw */
+	bool valid;
+	enum tegra_suspend_mode mode;
+	u32 stamp[TEGRA_RESUME_PHASE_MAX];
+	unsigned long stamped;	/* bitmask of stamped phases */
+	ktime_t boottime;	/* boot clock at thaw */
+	u32 num_devs;
+	u64 dev_total_us;
+	u32 num_slow;
+	struct tegra_resume_dev_time slow[TEGRA_RESUME_DEV_MAX];
+} tegra_resume_time;
+static DEFINE_SPINLOCK(tegra_resume_time_lock);
+
+static struct {
+	bool active;		/* between PM_SUSPEND_PREPARE and sleep */
+	bool valid;
+	bool aborted;
+	u32 stamp[TEGRA_SUSPEND_PHASE_MAX];
+	unsigned long stamped;	/* bitmask of stamped phases */
+	u32 num_devs;
+	u64 dev_total_us;
+	u32 num_slow;
+	struct tegra_resume_dev_time slow[TEGRA_RESUME_DEV_MAX];
+} tegra_suspend_time;
+
+static void tegra_suspend_time_stamp(enum tegra_suspend_phase phase)
+{
+	void __iomem *timer_us = IO_ADDRESS(TEGRA_TMRUS_BASE);
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	if (tegra_suspend_time.active) {
+		tegra_suspend_time.stamp[phase] = readl(timer_us);
+		tegra_suspend_time.stamped |= 1 << phase;
+		if (phase == TEGRA_SUSPEND_PHASE_CPU) {
+			tegra_suspend_time.active = false;
+			tegra_suspend_time.valid = true;
+		}
+	}
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+}
+
+static void tegra_resume_time_stamp(enum tegra_resume_phase phase)
+{
+	void __iomem *timer_us = IO_ADDRESS(TEGRA_TMRUS_BASE);
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	if (tegra_resume_time.active ||
+	    (tegra_resume_time.valid && (phase > TEGRA_RESUME_PHASE_DEVICES) &&
+	     !(tegra_resume_time.stamped & (1 << phase)))) {
+		tegra_resume_time.stamp[phase] = readl(timer_us);
+		tegra_resume_time.stamped |= 1 << phase;
+	}
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+}
+
+static void tegra_resume_time_start(enum tegra_suspend_mode mode)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	memset(&tegra_resume_time, 0, sizeof(tegra_resume_time));
+	tegra_resume_time.mode = mode;
+	tegra_resume_time.active = true;
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+}
+#else
+static inline void tegra_suspend_time_stamp(enum tegra_suspend_phase phase)
+{}
+static inline void tegra_resume_time_stamp(enum tegra_resume_phase phase)
+{}
+static inline void tegra_resume_time_start(enum tegra_suspend_mode mode)
+{}
+#endif
+
 #ifdef CONFIG_PM_SLEEP
 static const char *tegra_suspend_name[TEGRA_MAX_SUSPEND_MODE] = {
 	[TEGRA_SUSPEND_NONE]	= "none",
@@ -668,6 +787,7 @@ unsigned int tegra_idle_lp2_last(unsigned int sleep_time, unsigned int flags)
 	if (flags & TEGRA_POWER_CLUSTER_MASK) {
 		tegra_cluster_switch_epilog(flags);
 		trace_cpu_cluster(POWER_CPU_CLUSTER_DONE);
+		perflog_record(PERFLOG_CLUSTER_SWITCH, is_lp_cluster(), flags);
 	}
 	tegra_cluster_switch_time(flags, tegra_cluster_switch_time_id_epilog);
 
@@ -730,6 +850,7 @@ static void tegra_common_resume(void)
 
 static int tegra_suspend_prepare_late(void)
 {
+	tegra_suspend_time_stamp(TEGRA_SUSPEND_PHASE_NOIRQ);
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
 	disable_irq(INT_SYS_STATS_MON);
 #endif
@@ -738,6 +859,7 @@ static int tegra_suspend_prepare_late(void)
 
 static void tegra_suspend_wake(void)
 {
+	tegra_resume_time_stamp(TEGRA_RESUME_PHASE_SYSCORE);
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
 	enable_irq(INT_SYS_STATS_MON);
 #endif
@@ -816,16 +938,20 @@ static int tegra_suspend_enter(suspend_state_t state)
 	ktime_t delta;
 	struct timespec ts_entry, ts_exit;
 
+	tegra_suspend_time_stamp(TEGRA_SUSPEND_PHASE_SYSCORE);
+
 	if (pdata && pdata->board_suspend)
 		pdata->board_suspend(current_suspend_mode, TEGRA_SUSPEND_BEFORE_PERIPHERAL);
 
 	read_persistent_clock(&ts_entry);
 
+	tegra_resume_time_start(current_suspend_mode);
 	ret = tegra_suspend_dram(current_suspend_mode, 0);
 	if (ret) {
 		pr_info("Aborting suspend, tegra_suspend_dram error=%d\n", ret);
 		goto abort_suspend;
 	}
+	tegra_resume_time_stamp(TEGRA_RESUME_PHASE_CPU);
 
 	read_persistent_clock(&ts_exit);
 
@@ -842,6 +968,7 @@ static int tegra_suspend_enter(suspend_state_t state)
 abort_suspend:
 	if (pdata && pdata->board_resume)
 		pdata->board_resume(current_suspend_mode, TEGRA_RESUME_AFTER_PERIPHERAL);
+	tegra_resume_time_stamp(TEGRA_RESUME_PHASE_PLATFORM);
 
 	return ret;
 }
@@ -934,6 +1061,8 @@ int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 
 	suspend_cpu_complex(flags);
 
+	tegra_suspend_time_stamp(TEGRA_SUSPEND_PHASE_CPU);
+
 	flush_cache_all();
 	outer_flush_all();
 	outer_disable();
@@ -943,6 +1072,8 @@ int tegra_suspend_dram(enum tegra_suspend_mode mode, unsigned int flags)
 	else
 		tegra_sleep_core(mode, PLAT_PHYS_OFFSET - PAGE_OFFSET);
 
+	tegra_resume_time_stamp(TEGRA_RESUME_PHASE_WAKE);
+
 	tegra_init_cache(true);
 
 	if (mode == TEGRA_SUSPEND_LP0) {
@@ -992,8 +1123,16 @@ fail:
 void (*tegra_deep_sleep)(int);
 EXPORT_SYMBOL(tegra_deep_sleep);
 
+static int tegra_suspend_begin(suspend_state_t state)
+{
+	tegra_suspend_time_stamp(TEGRA_SUSPEND_PHASE_FREEZE);
+	return 0;
+}
+
 static int tegra_suspend_prepare(void)
 {
+	tegra_suspend_time_stamp(TEGRA_SUSPEND_PHASE_DEVICES);
+
 	if ((current_suspend_mode == TEGRA_SUSPEND_LP0) && tegra_deep_sleep)
 		tegra_deep_sleep(1);
 	return 0;
@@ -1001,6 +1140,8 @@ static int tegra_suspend_prepare(void)
 
 static void tegra_suspend_finish(void)
 {
+	tegra_resume_time_stamp(TEGRA_RESUME_PHASE_NOIRQ);
+
 	if (pdata && pdata->cpu_resume_boost) {
 		int ret = tegra_suspended_target(pdata->cpu_resume_boost);
 		pr_info("Tegra: resume CPU boost to %u KHz: %s (%d)\n",
@@ -1013,6 +1154,7 @@ static void tegra_suspend_finish(void)
 
 static const struct platform_suspend_ops tegra_suspend_ops = {
 	.valid		= suspend_valid_only_mem,
+	.begin		= tegra_suspend_begin,
 	.prepare	= tegra_suspend_prepare,
 	.finish		= tegra_suspend_finish,
 	.prepare_late	= tegra_suspend_prepare_late,
@@ -1097,6 +1239,263 @@ static __init int tegra_pm_enter_syscore_init(void)
 	return 0;
 }
 subsys_initcall(tegra_pm_enter_syscore_init);
+
+#ifdef CONFIG_DEBUG_FS
+static const char *tegra_resume_phase_name[TEGRA_RESUME_PHASE_MAX] = {
+	[TEGRA_RESUME_PHASE_WAKE]	 = "bootrom/warmboot",
+	[TEGRA_RESUME_PHASE_CPU]	 = "cpu complex",
+	[TEGRA_RESUME_PHASE_PLATFORM]	 = "platform",
+	[TEGRA_RESUME_PHASE_SYSCORE]	 = "syscore/cpus",
+	[TEGRA_RESUME_PHASE_NOIRQ]	 = "noirq devices",
+	[TEGRA_RESUME_PHASE_DEVICES]	 = "devices/thaw",
+	[TEGRA_RESUME_PHASE_LATE_RESUME] = "late resume",
+};
+
+/* keep the slowest callbacks, sorted by duration */
+static void tegra_pm_time_add_slow(struct tegra_resume_dev_time *slow,
+	u32 *num_slow, struct device *dev, const char *pm_ops, s64 ops_time)
+{
+	void __iomem *timer_us = IO_ADDRESS(TEGRA_TMRUS_BASE);
+	u32 n = *num_slow, i;
+
+	if ((n == TEGRA_RESUME_DEV_MAX) && (ops_time <= slow[n - 1].usecs))
+		return;
+	if (n < TEGRA_RESUME_DEV_MAX)
+		n++;
+	for (i = n - 1; (i > 0) && (slow[i - 1].usecs < ops_time); i--)
+		slow[i] = slow[i - 1];
+
+	strlcpy(slow[i].name, dev_name(dev), sizeof(slow[i].name));
+	slow[i].pm_ops = pm_ops;
+	slow[i].usecs = ops_time;
+	slow[i].end = readl(timer_us);
+	*num_slow = n;
+}
+
+static void tegra_resume_time_dev_probe(void *ignore, struct device *dev,
+	const char *pm_ops, s64 ops_time, int event, int error)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	if ((event == PM_EVENT_RESUME) && tegra_resume_time.active) {
+		tegra_resume_time.num_devs++;
+		tegra_resume_time.dev_total_us += ops_time;
+		tegra_pm_time_add_slow(tegra_resume_time.slow,
+			&tegra_resume_time.num_slow, dev, pm_ops, ops_time);
+	} else if ((event == PM_EVENT_SUSPEND) && tegra_suspend_time.active) {
+		tegra_suspend_time.num_devs++;
+		tegra_suspend_time.dev_total_us += ops_time;
+		tegra_pm_time_add_slow(tegra_suspend_time.slow,
+			&tegra_suspend_time.num_slow, dev, pm_ops, ops_time);
+	}
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+}
+
+static int tegra_resume_time_pm_notify(struct notifier_block *nb,
+	unsigned long event, void *data)
+{
+	unsigned long flags;
+
+	if (event == PM_SUSPEND_PREPARE) {
+		spin_lock_irqsave(&tegra_resume_time_lock, flags);
+		memset(&tegra_suspend_time, 0, sizeof(tegra_suspend_time));
+		tegra_suspend_time.active = true;
+		spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+		tegra_suspend_time_stamp(TEGRA_SUSPEND_PHASE_START);
+		return NOTIFY_OK;
+	}
+
+	if (event != PM_POST_SUSPEND)
+		return NOTIFY_OK;
+
+	/* still active: suspend was aborted before the cpu went down */
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	if (tegra_suspend_time.active) {
+		tegra_suspend_time.active = false;
+		tegra_suspend_time.valid = true;
+		tegra_suspend_time.aborted = true;
+	}
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+
+	tegra_resume_time_stamp(TEGRA_RESUME_PHASE_DEVICES);
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	if (tegra_resume_time.active) {
+		tegra_resume_time.active = false;
+		tegra_resume_time.valid = true;
+		tegra_resume_time.boottime = ktime_get_boottime();
+	}
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block tegra_resume_time_nb = {
+	.notifier_call = tegra_resume_time_pm_notify,
+	.priority = INT_MAX,	/* stamp suspend before other notifiers */
+};
+
+static int tegra_resume_time_show(struct seq_file *s, void *data)
+{
+	struct tegra_resume_dev_time slow[TEGRA_RESUME_DEV_MAX];
+	u32 stamp[TEGRA_RESUME_PHASE_MAX];
+	unsigned long flags, stamped;
+	enum tegra_suspend_mode mode;
+	u32 num_devs, num_slow, base, prev;
+	u64 dev_total_us;
+	struct timespec ts;
+	int i;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	if (!tegra_resume_time.valid) {
+		spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+		seq_printf(s, "no completed resume\n");
+		return 0;
+	}
+	mode = tegra_resume_time.mode;
+	stamped = tegra_resume_time.stamped;
+	memcpy(stamp, tegra_resume_time.stamp, sizeof(stamp));
+	num_devs = tegra_resume_time.num_devs;
+	dev_total_us = tegra_resume_time.dev_total_us;
+	num_slow = tegra_resume_time.num_slow;
+	memcpy(slow, tegra_resume_time.slow, sizeof(slow));
+	ts = ktime_to_timespec(tegra_resume_time.boottime);
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+
+	/* the us timer restarts on LP0 wake, otherwise count from wake */
+	base = (mode == TEGRA_SUSPEND_LP0) ? 0 : stamp[TEGRA_RESUME_PHASE_WAKE];
+
+	seq_printf(s, "mode: %s, resumed at boottime %lu.%06lu\n",
+		   tegra_suspend_name[mode], ts.tv_sec, ts.tv_nsec / 1000);
+	seq_printf(s, "%-20s %10s %10s\n", "phase", "at(us)", "delta(us)");
+	prev = base;
+	for (i = 0; i < TEGRA_RESUME_PHASE_MAX; i++) {
+		if (!(stamped & (1 << i)))
+			continue;
+		seq_printf(s, "%-20s %10u %10u\n", tegra_resume_phase_name[i],
+			   stamp[i] - base, stamp[i] - prev);
+		prev = stamp[i];
+	}
+
+	seq_printf(s, "\n%u device callbacks, %llu us total\n",
+		   num_devs, dev_total_us);
+	seq_printf(s, "%-32s %-14s %10s %10s\n",
+		   "device", "ops", "time(us)", "end(us)");
+	for (i = 0; i < num_slow; i++)
+		seq_printf(s, "%-32s %-14s %10u %10u\n", slow[i].name,
+			   slow[i].pm_ops, slow[i].usecs, slow[i].end - base);
+
+	return 0;
+}
+
+static int tegra_resume_time_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_resume_time_show, inode->i_private);
+}
+
+static const struct file_operations tegra_resume_time_fops = {
+	.open		= tegra_resume_time_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const char *tegra_suspend_phase_name[TEGRA_SUSPEND_PHASE_MAX] = {
+	[TEGRA_SUSPEND_PHASE_START]	= "start",
+	[TEGRA_SUSPEND_PHASE_FREEZE]	= "notifiers/freeze",
+	[TEGRA_SUSPEND_PHASE_DEVICES]	= "devices",
+	[TEGRA_SUSPEND_PHASE_NOIRQ]	= "noirq devices",
+	[TEGRA_SUSPEND_PHASE_SYSCORE]	= "cpus/syscore",
+	[TEGRA_SUSPEND_PHASE_CPU]	= "cpu complex",
+};
+
+static int tegra_suspend_time_show(struct seq_file *s, void *data)
+{
+	struct tegra_resume_dev_time slow[TEGRA_RESUME_DEV_MAX];
+	u32 stamp[TEGRA_SUSPEND_PHASE_MAX];
+	unsigned long flags, stamped;
+	u32 num_devs, num_slow, base, prev;
+	u64 dev_total_us;
+	bool aborted;
+	int i;
+
+	spin_lock_irqsave(&tegra_resume_time_lock, flags);
+	if (!tegra_suspend_time.valid) {
+		spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+		seq_printf(s, "no completed suspend\n");
+		return 0;
+	}
+	aborted = tegra_suspend_time.aborted;
+	stamped = tegra_suspend_time.stamped;
+	memcpy(stamp, tegra_suspend_time.stamp, sizeof(stamp));
+	num_devs = tegra_suspend_time.num_devs;
+	dev_total_us = tegra_suspend_time.dev_total_us;
+	num_slow = tegra_suspend_time.num_slow;
+	memcpy(slow, tegra_suspend_time.slow, sizeof(slow));
+	spin_unlock_irqrestore(&tegra_resume_time_lock, flags);
+
+	base = stamp[TEGRA_SUSPEND_PHASE_START];
+
+	seq_printf(s, "mode: %s%s, online cpus: %u\n",
+		   tegra_suspend_name[current_suspend_mode],
+		   aborted ? " (aborted)" : "", num_online_cpus());
+	seq_printf(s, "%-20s %10s %10s\n", "phase", "at(us)", "delta(us)");
+	prev = base;
+	for (i = 0; i < TEGRA_SUSPEND_PHASE_MAX; i++) {
+		if (!(stamped & (1 << i)))
+			continue;
+		seq_printf(s, "%-20s %10u %10u\n", tegra_suspend_phase_name[i],
+			   stamp[i] - base, stamp[i] - prev);
+		prev = stamp[i];
+	}
+
+	seq_printf(s, "\n%u device callbacks, %llu us total\n",
+		   num_devs, dev_total_us);
+	seq_printf(s, "%-32s %-14s %10s %10s\n",
+		   "device", "ops", "time(us)", "end(us)");
+	for (i = 0; i < num_slow; i++)
+		seq_printf(s, "%-32s %-14s %10u %10u\n", slow[i].name,
+			   slow[i].pm_ops, slow[i].usecs, slow[i].end - base);
+
+	return 0;
+}
+
+static int tegra_suspend_time_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_suspend_time_show, inode->i_private);
+}
+
+static const struct file_operations tegra_suspend_time_fops = {
+	.open		= tegra_suspend_time_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_resume_time_debug_init(void)
+{
+	int ret;
+
+	ret = register_trace_device_pm_report_time(
+		tegra_resume_time_dev_probe, NULL);
+	if (ret)
+		pr_warn("%s: no device suspend/resume times (%d)\n",
+			__func__, ret);
+
+	register_pm_notifier(&tegra_resume_time_nb);
+
+	if (!debugfs_create_file("tegra_resume_latency", S_IRUGO, NULL, NULL,
+				 &tegra_resume_time_fops))
+		return -ENOMEM;
+	if (!debugfs_create_file("tegra_suspend_latency", S_IRUGO, NULL, NULL,
+				 &tegra_suspend_time_fops))
+		return -ENOMEM;
+
+	return 0;
+}
+late_initcall(tegra_resume_time_debug_init);
+#endif
 #endif
 
 void __init tegra_init_suspend(struct tegra_suspend_platform_data *plat)
@@ -1387,6 +1786,7 @@ static void pm_late_resume(struct early_suspend *h)
 	if (clk_wake)
 		clk_enable(clk_wake);
 	pm_qos_update_request(&awake_cpu_freq_req, (s32)pdata->cpu_wake_freq);
+	tegra_resume_time_stamp(TEGRA_RESUME_PHASE_LATE_RESUME);
 }
 
 static struct early_suspend pm_early_suspender = {
@@ -150,6 +150,8 @@ static inline unsigned int is_lp_cluster(void)
 int tegra_cluster_control(unsigned int us, unsigned int flags);
 void tegra_cluster_switch_prolog(unsigned int flags);
 void tegra_cluster_switch_epilog(unsigned int flags);
+int tegra_cluster_switch_prewarm(bool on);
+bool tegra_cluster_switch_prewarmed(void);
 #else
 #define INSTRUMENT_CLUSTER_SWITCH 0	/* Must be zero for ARCH_TEGRA_2x_SOC */
 #define DEBUG_CLUSTER_SWITCH 0		/* Must be zero for ARCH_TEGRA_2x_SOC */
@@ -163,6 +165,8 @@ static inline int tegra_cluster_control(unsigned int us, unsigned int flags)
 }
 static inline void tegra_cluster_switch_prolog(unsigned int flags) {}
 static inline void tegra_cluster_switch_epilog(unsigned int flags) {}
+static inline int tegra_cluster_switch_prewarm(bool on) { return -EPERM; }
+static inline bool tegra_cluster_switch_prewarmed(void) { return false; }
 #endif
 
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
@@ -25,6 +25,7 @@
 #include <linux/delay.h>
 #include <linux/err.h>
 #include <linux/init.h>
+#include <linux/hrtimer.h>
 #include <linux/io.h>
 #include <linux/seq_file.h>
 #include <linux/spinlock.h>
@@ -166,6 +167,16 @@ static struct powergate_partition powergate_partition_info[TEGRA_NUM_POWERGATE]
 #endif
 };
 
+/* Per-partition residency and ramp counts, kept under tegra_powergate_lock */
+struct powergate_stats {
+	ktime_t last_change;	/* zero until the first toggle */
+	u64 on_us;
+	u64 off_us;
+	u32 ungates;		/* full power ramps */
+};
+
+static struct powergate_stats powergate_stats[TEGRA_NUM_POWERGATE];
+
 static void __iomem *pmc = IO_ADDRESS(TEGRA_PMC_BASE);
 
 static u32 pmc_read(unsigned long reg)
@@ -416,6 +427,24 @@ static void mc_flush(int id) {}
 static void mc_flush_done(int id) {}
 #endif
 
+static void powergate_account_locked(int id, bool powered)
+{
+	struct powergate_stats *st = &powergate_stats[id];
+	ktime_t now = ktime_get();
+
+	if (st->last_change.tv64) {
+		u64 us = ktime_us_delta(now, st->last_change);
+
+		if (powered)
+			st->off_us += us;
+		else
+			st->on_us += us;
+	}
+	st->last_change = now;
+	if (powered)
+		st->ungates++;
+}
+
 static int tegra_powergate_set(int id, bool new_state)
 {
 	bool status;
@@ -455,6 +484,9 @@ static int tegra_powergate_set(int id, bool new_state)
 		contention_timeout--;
 	} while ((status != new_state) && (contention_timeout > 0));
 
+	if (status == new_state)
+		powergate_account_locked(id, new_state);
+
 	spin_unlock_irqrestore(&tegra_powergate_lock, flags);
 
 	if (status != new_state) {
@@ -843,12 +875,35 @@ static int powergate_show(struct seq_file *s, void *data)
 {
 	int i;
 
-	seq_printf(s, " powergate powered\n");
-	seq_printf(s, "------------------\n");
+	seq_printf(s, " powergate powered       on_ms      off_ms  ungates\n");
+	seq_printf(s, "---------------------------------------------------\n");
+
+	for (i = 0; i < TEGRA_NUM_POWERGATE; i++) {
+		struct powergate_stats st;
+		unsigned long flags;
+		bool powered;
+
+		spin_lock_irqsave(&tegra_powergate_lock, flags);
+		st = powergate_stats[i];
+		powered = tegra_powergate_is_powered(i);
+		spin_unlock_irqrestore(&tegra_powergate_lock, flags);
 
-	for (i = 0; i < TEGRA_NUM_POWERGATE; i++)
-		seq_printf(s, " %9s %7s\n", powergate_partition_info[i].name,
-			tegra_powergate_is_powered(i) ? "yes" : "no");
+		/* fold in the time spent in the current state */
+		if (st.last_change.tv64) {
+			u64 us = ktime_us_delta(ktime_get(), st.last_change);
+
+			if (powered)
+				st.on_us += us;
+			else
+				st.off_us += us;
+		}
+
+		seq_printf(s, " %9s %7s %11llu %11llu %8u\n",
+			powergate_partition_info[i].name,
+			powered ? "yes" : "no",
+			div_u64(st.on_us, 1000), div_u64(st.off_us, 1000),
+			st.ungates);
+	}
 	return 0;
 }
 
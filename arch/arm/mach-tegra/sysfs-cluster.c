@@ -63,6 +63,13 @@
  *			      next non-timer interrupt (whichever comes first)
  *		read: returns the current wake_ms value
  *
+ * async: perform the switch asynchronously
+ *		write:	'0' = switch synchronously in the write to active (default)
+ *			'1' = queue the switch and return at once; for LP=>G
+ *			      the G rail and PLLX are pre-warmed before the
+ *			      switch is made
+ *		read: returns the current status of the async flag
+ *
  * Writing the force, immediate and wake_ms attributes simply updates the
  * state of internal variables that will be used for the next switch request.
  * Writing to the active attribute initates a switch request using the
@@ -85,6 +92,7 @@
 #include <linux/smp.h>
 #include <linux/io.h>
 #include <linux/clk.h>
+#include <linux/workqueue.h>
 
 #include <mach/iomap.h>
 #include "clock.h"
@@ -111,6 +119,9 @@ static struct kobject *cluster_kobj;
 static spinlock_t cluster_lock;
 static unsigned int flags = 0;
 static unsigned int wake_ms = 0;
+static unsigned int async = 0;
+static struct clk *async_parent;
+static struct work_struct async_switch_work;
 
 static ssize_t sysfscluster_show(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf);
@@ -134,6 +145,10 @@ static struct kobj_attribute cluster_force_attr =
 static struct kobj_attribute cluster_wake_ms_attr =
 		__ATTR(wake_ms, 0640, sysfscluster_show, sysfscluster_store);
 
+/* Asynchronous switch: 0, 1 */
+static struct kobj_attribute cluster_async_attr =
+		__ATTR(async, 0640, sysfscluster_show, sysfscluster_store);
+
 #if defined(CONFIG_PM_SLEEP) && SYSFS_CLUSTER_POWER_MODE
 /* LPx power mode to use when switching CPUs: 1=LP1, 2=LP2 */
 static unsigned int power_mode = 2;
@@ -154,6 +169,7 @@ typedef enum
 	ClusterAttr_Immediate,
 	ClusterAttr_Force,
 	ClusterAttr_WakeMs,
+	ClusterAttr_Async,
 #if defined(CONFIG_PM_SLEEP) && SYSFS_CLUSTER_POWER_MODE
 	ClusterAttr_PowerMode,
 #endif
@@ -172,6 +188,8 @@ static ClusterAttr GetClusterAttr(const char *name)
 		return ClusterAttr_Force;
 	if (!strcmp(name, "wake_ms"))
 		return ClusterAttr_WakeMs;
+	if (!strcmp(name, "async"))
+		return ClusterAttr_Async;
 #if defined(CONFIG_PM_SLEEP) && SYSFS_CLUSTER_POWER_MODE
 	if (!strcmp(name, "power_mode"))
 		return ClusterAttr_PowerMode;
@@ -212,6 +230,10 @@ static ssize_t sysfscluster_show(struct kobject *kobj,
 		len = sprintf(buf, "%d\n", wake_ms);
 		break;
 
+	case ClusterAttr_Async:
+		len = sprintf(buf, "%d\n", async);
+		break;
+
 #if defined(CONFIG_PM_SLEEP) && SYSFS_CLUSTER_POWER_MODE
 	case ClusterAttr_PowerMode:
 		len = sprintf(buf, "%d\n", power_mode);
@@ -342,6 +364,20 @@ static ssize_t sysfscluster_store(struct kobject *kobj,
 		PRINT_CLUSTER(("cluster/wake_ms -> %d\n", wake_ms));
 		break;
 
+	case ClusterAttr_Async:
+		if ((count == 1) && (*buf == '0'))
+			async = 0;
+		else if ((count == 1) && (*buf == '1'))
+			async = 1;
+		else {
+			PRINT_CLUSTER(("cluster/async: '%*.*s' invalid, "
+				"must be 0 or 1\n", count, count, buf));
+			ret = -EINVAL;
+			break;
+		}
+		PRINT_CLUSTER(("cluster/async -> %d\n", async));
+		break;
+
 #if defined(CONFIG_PM_SLEEP) && SYSFS_CLUSTER_POWER_MODE
 	case ClusterAttr_PowerMode:
 		if ((count == 1) && (*buf == '2'))
@@ -379,6 +415,12 @@ static ssize_t sysfscluster_store(struct kobject *kobj,
 		break;
 	}
 
+	if (new_parent && async) {
+		async_parent = new_parent;
+		new_parent = NULL;
+		schedule_work(&async_switch_work);
+	}
+
 	spin_unlock(&cluster_lock);
 
 	if (new_parent) {
@@ -394,6 +436,32 @@ fail:
 	return ret;
 }
 
+static void sysfscluster_async_switch(struct work_struct *work)
+{
+	struct clk *cpu_clk = tegra_get_clock_by_name("cpu");
+	struct clk *cpu_g_clk = tegra_get_clock_by_name("cpu_g");
+	struct clk *new_parent;
+	int e;
+
+	spin_lock(&cluster_lock);
+	new_parent = async_parent;
+	async_parent = NULL;
+	spin_unlock(&cluster_lock);
+
+	if (!new_parent)
+		return;
+
+	if ((new_parent == cpu_g_clk) && is_lp_cluster())
+		tegra_cluster_switch_prewarm(true);
+
+	e = clk_set_parent(cpu_clk, new_parent);
+	if (e) {
+		tegra_cluster_switch_prewarm(false);
+		PRINT_CLUSTER(("cluster/active: async request failed (%d)\n",
+			       e));
+	}
+}
+
 #define CREATE_FILE(x) \
 	do { \
 		e = sysfs_create_file(cluster_kobj, &cluster_##x##_attr.attr); \
@@ -411,12 +479,14 @@ static int __init sysfscluster_init(void)
 	TRACE_CLUSTER(("+sysfscluster_init\n"));
 
 	spin_lock_init(&cluster_lock);
+	INIT_WORK(&async_switch_work, sysfscluster_async_switch);
 	cluster_kobj = kobject_create_and_add("cluster", kernel_kobj);
 
 	CREATE_FILE(active);
 	CREATE_FILE(immediate);
 	CREATE_FILE(force);
 	CREATE_FILE(wake_ms);
+	CREATE_FILE(async);
 #if defined(CONFIG_PM_SLEEP) && SYSFS_CLUSTER_POWER_MODE
 	CREATE_FILE(powermode);
 #endif
@@ -448,6 +518,7 @@ static void __exit sysfscluster_exit(void)
 #if defined(CONFIG_PM_SLEEP) && SYSFS_CLUSTER_POWER_MODE
 	REMOVE_FILE(powermode);
 #endif
+	REMOVE_FILE(async);
 	REMOVE_FILE(wake_ms);
 	REMOVE_FILE(force);
 	REMOVE_FILE(immediate);
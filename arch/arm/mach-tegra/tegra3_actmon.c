@@ -25,12 +25,20 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/perf_event.h>
 
 #include <mach/iomap.h>
 #include <mach/irqs.h>
 #include <mach/clk.h>
 
 #include "clock.h"
+#include "tegra3_mc.h"
 
 #define ACTMON_GLB_STATUS			0x00
 #define ACTMON_GLB_PERIOD_CTRL			0x04
@@ -214,6 +222,9 @@ static unsigned long actmon_dev_avg_freq_get(struct actmon_dev *dev)
 	return (u32)val;
 }
 
+static struct actmon_dev actmon_dev_emc;
+static void emc_gov_apply(void);
+
 /* Activity monitor sampling operations */
 irqreturn_t actmon_dev_isr(int irq, void *dev_id)
 {
@@ -287,7 +298,10 @@ irqreturn_t actmon_dev_fn(int irq, void *dev_id)
 	pr_debug("%s.%s(kHz): avg: %lu, target: %lu current: %lu\n",
 			dev->dev_id, dev->con_id, dev->avg_actv_freq,
 			dev->target_freq, dev->cur_freq);
-	clk_set_rate(dev->clk, freq * 1000);
+	if (dev == &actmon_dev_emc)
+		emc_gov_apply();
+	else
+		clk_set_rate(dev->clk, freq * 1000);
 
 	return IRQ_HANDLED;
 }
@@ -553,6 +567,186 @@ static struct actmon_dev *actmon_devices[] = {
 	&actmon_dev_avp,
 };
 
+/* EMC governor:
+ * ACTMON sees EMC traffic only after it has started, so a new load (first
+ * frames of a video, display reconfiguration) runs at a low EMC rate until
+ * the average catches up. Memory clients that know their demand up front
+ * report it with tegra_emc_bw_hint(). The governor requests the lowest EMC
+ * table rate that covers both the ACTMON target and the sum of the hints;
+ * the two are not added, since ACTMON measures hinted traffic once it flows.
+ * Rate increases are applied at once. A decrease is applied only after the
+ * combined target has stayed at or below down_margin % of the current rate
+ * for down_hold_ms, so EMC does not bounce between neighbouring entries.
+ */
+#define EMC_GOV_MAX_STATES		16
+
+static const char * const emc_gov_client_names[] = {
+	[TEGRA_EMC_BW_DISP1]	= "disp1",
+	[TEGRA_EMC_BW_DISP2]	= "disp2",
+	[TEGRA_EMC_BW_GR3D]	= "3d",
+	[TEGRA_EMC_BW_AVP]	= "avp",
+	[TEGRA_EMC_BW_MC_ISO]	= "mc_iso",
+};
+
+static struct {
+	unsigned long	hint[TEGRA_EMC_BW_NUM_CLIENTS];	/* kHz */
+	unsigned long	rate;				/* kHz */
+	unsigned long	down_start;
+	bool		down_pending;
+
+	u32		down_margin;
+	u32		down_hold_ms;
+
+	u32		transitions;
+	u64		stats_start;
+	u64		state_start;
+	unsigned int	num_states;
+	struct {
+		unsigned long	rate;
+		u64		time;			/* jiffies */
+	} state[EMC_GOV_MAX_STATES];
+} emc_gov = {
+	.down_margin	= 80,
+	.down_hold_ms	= 100,
+};
+
+static DEFINE_MUTEX(emc_gov_lock);
+static DEFINE_SPINLOCK(emc_gov_hint_lock);
+
+static void emc_gov_work_func(struct work_struct *work)
+{
+	emc_gov_apply();
+}
+static DECLARE_DELAYED_WORK(emc_gov_work, emc_gov_work_func);
+
+/* account time spent at current rate; must be called with emc_gov_lock */
+static void emc_gov_stats_update(unsigned long new_rate)
+{
+	unsigned int i;
+	u64 now = get_jiffies_64();
+
+	for (i = 0; i < emc_gov.num_states; i++) {
+		if (emc_gov.state[i].rate >= emc_gov.rate)
+			break;
+	}
+	if ((i == emc_gov.num_states) ||
+	    (emc_gov.state[i].rate != emc_gov.rate)) {
+		if (emc_gov.num_states == EMC_GOV_MAX_STATES)
+			goto out;
+		memmove(&emc_gov.state[i + 1], &emc_gov.state[i],
+			(emc_gov.num_states - i) * sizeof(emc_gov.state[0]));
+		emc_gov.state[i].rate = emc_gov.rate;
+		emc_gov.state[i].time = 0;
+		emc_gov.num_states++;
+	}
+	emc_gov.state[i].time += now - emc_gov.state_start;
+out:
+	emc_gov.state_start = now;
+	if (new_rate != emc_gov.rate)
+		emc_gov.transitions++;
+}
+
+static void emc_gov_apply(void)
+{
+	int i;
+	long rounded;
+	unsigned long flags, hold, target, rate;
+	unsigned long hints = 0;
+	struct actmon_dev *dev = &actmon_dev_emc;
+
+	mutex_lock(&emc_gov_lock);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->state != ACTMON_ON) {
+		spin_unlock_irqrestore(&dev->lock, flags);
+		mutex_unlock(&emc_gov_lock);
+		return;
+	}
+	target = dev->target_freq;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	spin_lock_irqsave(&emc_gov_hint_lock, flags);
+	for (i = 0; i < TEGRA_EMC_BW_NUM_CLIENTS; i++)
+		hints += emc_gov.hint[i];
+	spin_unlock_irqrestore(&emc_gov_hint_lock, flags);
+
+	target = min(max(target, hints), dev->max_freq);
+	rounded = clk_round_rate(dev->clk, target * 1000);
+	rate = (rounded > 0) ? rounded / 1000 : target;
+
+	if (rate < emc_gov.rate) {
+		hold = msecs_to_jiffies(emc_gov.down_hold_ms);
+		if (target > do_percent(emc_gov.rate, emc_gov.down_margin)) {
+			emc_gov.down_pending = false;
+			rate = emc_gov.rate;
+		} else if (!emc_gov.down_pending) {
+			emc_gov.down_pending = true;
+			emc_gov.down_start = jiffies;
+			schedule_delayed_work(&emc_gov_work, hold);
+			rate = emc_gov.rate;
+		} else if (time_before(jiffies, emc_gov.down_start + hold)) {
+			schedule_delayed_work(&emc_gov_work,
+				emc_gov.down_start + hold - jiffies);
+			rate = emc_gov.rate;
+		}
+	}
+
+	if (rate != emc_gov.rate) {
+		pr_debug("%s: actmon: %lu, hints: %lu, rate: %lu => %lu\n",
+			 __func__, dev->target_freq, hints, emc_gov.rate, rate);
+		emc_gov_stats_update(rate);
+		emc_gov.rate = rate;
+		clk_set_rate(dev->clk, rate * 1000);
+	}
+	if (rate >= emc_gov.rate)
+		emc_gov.down_pending = false;
+
+	mutex_unlock(&emc_gov_lock);
+}
+
+void tegra_emc_bw_hint(enum tegra_emc_bw_client client, unsigned long rate)
+{
+	bool changed;
+	unsigned long flags;
+
+	if (client >= TEGRA_EMC_BW_NUM_CLIENTS)
+		return;
+
+	rate /= 1000;
+	spin_lock_irqsave(&emc_gov_hint_lock, flags);
+	changed = emc_gov.hint[client] != rate;
+	emc_gov.hint[client] = rate;
+	spin_unlock_irqrestore(&emc_gov_hint_lock, flags);
+
+	/* re-evaluate now, not at the end of a pending down hold */
+	if (changed) {
+		cancel_delayed_work(&emc_gov_work);
+		schedule_delayed_work(&emc_gov_work, 0);
+	}
+}
+EXPORT_SYMBOL(tegra_emc_bw_hint);
+
+static void emc_gov_init(void)
+{
+	mutex_lock(&emc_gov_lock);
+	emc_gov.rate = clk_get_rate(actmon_dev_emc.clk) / 1000;
+	emc_gov.stats_start = get_jiffies_64();
+	emc_gov.state_start = emc_gov.stats_start;
+	mutex_unlock(&emc_gov_lock);
+}
+
+static void emc_gov_suspend(void)
+{
+	cancel_delayed_work_sync(&emc_gov_work);
+
+	/* actmon_dev_suspend() has moved mon.emc to its suspend floor */
+	mutex_lock(&emc_gov_lock);
+	emc_gov_stats_update(actmon_dev_emc.suspend_freq);
+	emc_gov.rate = actmon_dev_emc.suspend_freq;
+	emc_gov.down_pending = false;
+	mutex_unlock(&emc_gov_lock);
+}
+
 /* Activity monitor suspend/resume */
 static int actmon_pm_notify(struct notifier_block *nb,
 			    unsigned long event, void *data)
@@ -563,6 +757,8 @@ static int actmon_pm_notify(struct notifier_block *nb,
 	case PM_SUSPEND_PREPARE:
 		for (i = 0; i < ARRAY_SIZE(actmon_devices); i++)
 			actmon_dev_suspend(actmon_devices[i]);
+		if (actmon_dev_emc.state != ACTMON_UNINITIALIZED)
+			emc_gov_suspend();
 		break;
 	case PM_POST_SUSPEND:
 		actmon_writel(actmon_sampling_period - 1,
@@ -579,6 +775,190 @@ static struct notifier_block actmon_pm_nb = {
 	.notifier_call = actmon_pm_notify,
 };
 
+#ifdef CONFIG_PERF_EVENTS
+/* EMC uncore PMU:
+ * counting-only perf events for memory traffic, so that profiles of a hot
+ * path can be put next to the DRAM bandwidth it costs. Busy clocks come
+ * from the EMC activity counter: ACTMON_DEV_COUNT holds the busy EMC
+ * clocks of the last sample period, integrated here at that rate by a
+ * timer running while events are active. Bytes are busy clocks times the
+ * DDR bus width. The counts are system wide; open events on cpu 0 only
+ * (e.g. perf stat -a -C 0 -e tegra_emc/config=N/).
+ */
+#define EMC_PMU_CYCLES			0	/* EMC clocks elapsed */
+#define EMC_PMU_BUSY_CYCLES		1	/* EMC clocks moving data */
+#define EMC_PMU_BYTES			2	/* estimated bytes moved */
+#define EMC_PMU_NR_EVENTS		3
+/* EMC_PMU_UNIT_BYTES + unit: bytes of one tegra3_mc unit, sampled by the
+ * MC statistics driver while it is enabled */
+#define EMC_PMU_UNIT_BYTES		EMC_PMU_NR_EVENTS
+#define EMC_PMU_NR_CONFIGS		(EMC_PMU_UNIT_BYTES + TEGRA3_MC_NUM_UNITS)
+
+#define EMC_BYTES_PER_CLOCK		8	/* 32-bit DDR */
+
+static struct {
+	struct pmu		pmu;
+	struct hrtimer		timer;
+	spinlock_t		lock;
+	ktime_t			last;
+	u64			count[EMC_PMU_NR_EVENTS];
+	int			active;
+} emc_pmu;
+
+static inline ktime_t emc_pmu_period(void)
+{
+	return ktime_set(0, actmon_sampling_period * NSEC_PER_MSEC);
+}
+
+static void emc_pmu_update(void)
+{
+	struct actmon_dev *dev = &actmon_dev_emc;
+	unsigned long flags;
+	ktime_t now;
+	u64 ns, busy;
+
+	spin_lock_irqsave(&emc_pmu.lock, flags);
+
+	now = ktime_get();
+	ns = ktime_to_ns(ktime_sub(now, emc_pmu.last));
+	emc_pmu.last = now;
+
+	/* kHz * ns / 10^6 */
+	emc_pmu.count[EMC_PMU_CYCLES] +=
+		div_u64((u64)dev->cur_freq * ns, NSEC_PER_MSEC);
+
+	if (dev->state == ACTMON_ON) {
+		busy = (u64)actmon_readl(offs(ACTMON_DEV_COUNT)) * ns;
+		busy = div_u64(busy, actmon_sampling_period * NSEC_PER_MSEC);
+		emc_pmu.count[EMC_PMU_BUSY_CYCLES] += busy;
+		emc_pmu.count[EMC_PMU_BYTES] += busy * EMC_BYTES_PER_CLOCK;
+	}
+
+	spin_unlock_irqrestore(&emc_pmu.lock, flags);
+}
+
+static enum hrtimer_restart emc_pmu_timer_fn(struct hrtimer *timer)
+{
+	emc_pmu_update();
+	hrtimer_forward_now(timer, emc_pmu_period());
+	return HRTIMER_RESTART;
+}
+
+static u64 emc_pmu_count(u64 config)
+{
+	if (config >= EMC_PMU_UNIT_BYTES)
+		return tegra3_mc_unit_bytes(config - EMC_PMU_UNIT_BYTES);
+	return emc_pmu.count[config];
+}
+
+static void emc_pmu_event_update(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now;
+
+	emc_pmu_update();
+	do {
+		prev = local64_read(&hwc->prev_count);
+		now = emc_pmu_count(event->attr.config);
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	local64_add(now - prev, &event->count);
+}
+
+static void emc_pmu_start(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (!emc_pmu.active++) {
+		emc_pmu.last = ktime_get();
+		hrtimer_start(&emc_pmu.timer, emc_pmu_period(),
+			      HRTIMER_MODE_REL_PINNED);
+	}
+
+	emc_pmu_update();
+	local64_set(&hwc->prev_count, emc_pmu_count(event->attr.config));
+	hwc->state = 0;
+}
+
+static void emc_pmu_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	emc_pmu_event_update(event);
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (!--emc_pmu.active)
+		hrtimer_cancel(&emc_pmu.timer);
+}
+
+static int emc_pmu_add(struct perf_event *event, int flags)
+{
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (flags & PERF_EF_START)
+		emc_pmu_start(event, flags);
+	return 0;
+}
+
+static void emc_pmu_del(struct perf_event *event, int flags)
+{
+	emc_pmu_stop(event, PERF_EF_UPDATE);
+}
+
+static void emc_pmu_read(struct perf_event *event)
+{
+	if (!(event->hw.state & PERF_HES_STOPPED))
+		emc_pmu_event_update(event);
+}
+
+static int emc_pmu_event_init(struct perf_event *event)
+{
+	if (event->attr.type != emc_pmu.pmu.type)
+		return -ENOENT;
+
+	if (event->attr.config >= EMC_PMU_NR_CONFIGS)
+		return -EINVAL;
+
+	/* No overflow interrupt to sample on */
+	if (is_sampling_event(event))
+		return -EOPNOTSUPP;
+	if (event->attr.exclude_user || event->attr.exclude_kernel ||
+	    event->attr.exclude_hv || event->attr.exclude_idle)
+		return -EOPNOTSUPP;
+
+	/* One system wide counter; cpu 0 is never unplugged */
+	if (event->cpu != 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void __init emc_pmu_init(void)
+{
+	int ret;
+
+	spin_lock_init(&emc_pmu.lock);
+	hrtimer_init(&emc_pmu.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	emc_pmu.timer.function = emc_pmu_timer_fn;
+
+	emc_pmu.pmu.task_ctx_nr = perf_invalid_context;
+	emc_pmu.pmu.event_init = emc_pmu_event_init;
+	emc_pmu.pmu.add = emc_pmu_add;
+	emc_pmu.pmu.del = emc_pmu_del;
+	emc_pmu.pmu.start = emc_pmu_start;
+	emc_pmu.pmu.stop = emc_pmu_stop;
+	emc_pmu.pmu.read = emc_pmu_read;
+
+	ret = perf_pmu_register(&emc_pmu.pmu, "tegra_emc", -1);
+	if (ret)
+		pr_err("%s: Failed to register EMC PMU (%d)\n", __func__, ret);
+}
+#else
+static inline void emc_pmu_init(void) {}
+#endif
+
 #ifdef CONFIG_DEBUG_FS
 
 #define RW_MODE (S_IWUSR | S_IRUGO)
@@ -743,6 +1123,96 @@ static int period_set(void *data, u64 val)
 }
 DEFINE_SIMPLE_ATTRIBUTE(period_fops, period_get, period_set, "%llu\n");
 
+static inline u32 emc_gov_jiffies_to_ms(u64 j)
+{
+	j *= MSEC_PER_SEC;
+	do_div(j, HZ);
+	return (u32)j;
+}
+
+static int emc_gov_show(struct seq_file *s, void *data)
+{
+	int i;
+	u32 elapsed, rate_x100;
+	unsigned long flags;
+	unsigned long hints[TEGRA_EMC_BW_NUM_CLIENTS];
+
+	spin_lock_irqsave(&emc_gov_hint_lock, flags);
+	memcpy(hints, emc_gov.hint, sizeof(hints));
+	spin_unlock_irqrestore(&emc_gov_hint_lock, flags);
+
+	mutex_lock(&emc_gov_lock);
+	emc_gov_stats_update(emc_gov.rate);
+
+	seq_printf(s, "rate:        %lu kHz\n", emc_gov.rate);
+	seq_printf(s, "actmon:      %lu kHz\n", actmon_dev_emc.target_freq);
+	for (i = 0; i < TEGRA_EMC_BW_NUM_CLIENTS; i++)
+		seq_printf(s, "hint %-6s  %lu kHz\n",
+			   emc_gov_client_names[i], hints[i]);
+
+	elapsed = emc_gov_jiffies_to_ms(get_jiffies_64() - emc_gov.stats_start);
+	rate_x100 = elapsed ?
+		(u32)div_u64((u64)emc_gov.transitions * 100000, elapsed) : 0;
+	seq_printf(s, "transitions: %u (%u.%02u/s)\n", emc_gov.transitions,
+		   rate_x100 / 100, rate_x100 % 100);
+
+	seq_printf(s, "\n%-10s %10s\n", "rate(kHz)", "time(ms)");
+	for (i = 0; i < emc_gov.num_states; i++)
+		seq_printf(s, "%-10lu %10u\n", emc_gov.state[i].rate,
+			   emc_gov_jiffies_to_ms(emc_gov.state[i].time));
+
+	mutex_unlock(&emc_gov_lock);
+	return 0;
+}
+
+static int emc_gov_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, emc_gov_show, inode->i_private);
+}
+
+/* any write resets governor statistics */
+static ssize_t emc_gov_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	mutex_lock(&emc_gov_lock);
+	emc_gov.transitions = 0;
+	emc_gov.num_states = 0;
+	emc_gov.stats_start = get_jiffies_64();
+	emc_gov.state_start = emc_gov.stats_start;
+	mutex_unlock(&emc_gov_lock);
+	return count;
+}
+
+static const struct file_operations emc_gov_fops = {
+	.open		= emc_gov_open,
+	.read		= seq_read,
+	.write		= emc_gov_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int emc_gov_debugfs_init(struct dentry *dir)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file(
+		"governor", RW_MODE, dir, NULL, &emc_gov_fops);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_u32(
+		"gov_down_margin", RW_MODE, dir, &emc_gov.down_margin);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_u32(
+		"gov_down_hold_ms", RW_MODE, dir, &emc_gov.down_hold_ms);
+	if (!d)
+		return -ENOMEM;
+
+	return 0;
+}
+
 
 static int actmon_debugfs_create_dev(struct actmon_dev *dev)
 {
@@ -795,6 +1265,9 @@ static int actmon_debugfs_create_dev(struct actmon_dev *dev)
 	if (!d)
 		return -ENOMEM;
 
+	if (dev == &actmon_dev_emc)
+		return emc_gov_debugfs_init(dir);
+
 	return 0;
 }
 
@@ -851,6 +1324,10 @@ static int __init tegra_actmon_init(void)
 			actmon_devices[i]->dev_id, actmon_devices[i]->con_id,
 			ret ? "Failed" : "Completed", ret);
 	}
+	if (actmon_dev_emc.state != ACTMON_UNINITIALIZED) {
+		emc_gov_init();
+		emc_pmu_init();
+	}
 	register_pm_notifier(&actmon_pm_nb);
 
 #ifdef CONFIG_DEBUG_FS
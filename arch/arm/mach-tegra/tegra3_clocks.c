@@ -28,6 +28,11 @@
 #include <linux/clk.h>
 #include <linux/cpufreq.h>
 #include <linux/syscore_ops.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/time.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/clkdev.h>
 
@@ -959,6 +964,59 @@ void tegra_cluster_switch_set_parameters(unsigned int us, unsigned int flags)
 }
 #endif
 
+/* cluster switch latency accounting, split into switch phases */
+enum {
+	CLUSTER_PHASE_PREWARM_PLL = 0,
+	CLUSTER_PHASE_PREWARM_RAIL,
+	CLUSTER_PHASE_PLL_LOCK,
+	CLUSTER_PHASE_RAIL_UP,
+	CLUSTER_PHASE_MIGRATE,
+	CLUSTER_PHASE_NUM,
+};
+
+#define CLUSTER_SWITCH_HIST_SIZE	16	/* log2 buckets: 1us ... 32ms */
+
+static struct cluster_switch_phase {
+	const char *name;
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+	u32 hist[CLUSTER_SWITCH_HIST_SIZE];
+} cluster_switch_phases[CLUSTER_PHASE_NUM] = {
+	[CLUSTER_PHASE_PREWARM_PLL]	= { .name = "prewarm_pll" },
+	[CLUSTER_PHASE_PREWARM_RAIL]	= { .name = "prewarm_rail" },
+	[CLUSTER_PHASE_PLL_LOCK]	= { .name = "pll_lock" },
+	[CLUSTER_PHASE_RAIL_UP]		= { .name = "rail_up" },
+	[CLUSTER_PHASE_MIGRATE]		= { .name = "migrate" },
+};
+
+static struct {
+	u32 to_g;
+	u32 to_lp;
+	u32 prewarmed;
+	u32 prewarm_cancelled;
+} cluster_switch_stats;
+
+/* G cluster clock held by tegra_cluster_switch_prewarm(), if any */
+static struct clk *cluster_prewarm_clk;
+
+static void cluster_switch_account(int phase, ktime_t start, ktime_t end)
+{
+	struct cluster_switch_phase *ph = &cluster_switch_phases[phase];
+	s64 us = ktime_us_delta(end, start);
+	int bucket;
+
+	if (us < 0)
+		us = 0;
+
+	bucket = min(fls((u32)us), CLUSTER_SWITCH_HIST_SIZE - 1);
+	ph->hist[bucket]++;
+	ph->count++;
+	ph->total_us += us;
+	if (us > ph->max_us)
+		ph->max_us = us;
+}
+
 static int tegra3_cpu_cmplx_clk_enable(struct clk *c)
 {
 	return 0;
@@ -1002,6 +1060,9 @@ static int tegra3_cpu_cmplx_clk_set_parent(struct clk *c, struct clk *p)
 	unsigned int flags, delay;
 	const struct clk_mux_sel *sel;
 	unsigned long rate = clk_get_rate(c->parent);
+	ktime_t t_pll = ktime_set(0, 0), t_rail = ktime_set(0, 0);
+	ktime_t t_migrate = ktime_set(0, 0), t_done;
+	bool account = !timekeeping_suspended;
 
 	pr_debug("%s: %s %s\n", __func__, c->name, p->name);
 	BUG_ON(c->parent->u.cpu.mode != (is_lp_cluster() ? MODE_LP : MODE_G));
@@ -1056,6 +1117,9 @@ static int tegra3_cpu_cmplx_clk_set_parent(struct clk *c, struct clk *p)
 
 	clk_enable(cpu_mode_sclk);	/* set SCLK floor for cluster switch */
 
+	if (account)
+		t_pll = ktime_get();
+
 	/* Since in both LP and G mode CPU main and backup sources are the
 	   same, set rate on the new parent just synchronizes super-clock
 	   muxes before mode switch with no PLL re-locking */
@@ -1067,11 +1131,17 @@ static int tegra3_cpu_cmplx_clk_set_parent(struct clk *c, struct clk *p)
 		return ret;
 	}
 
+	if (account)
+		t_rail = ktime_get();
+
 	/* Enabling new parent scales new mode voltage rail in advanvce
 	   before the switch happens*/
 	if (c->refcnt)
 		clk_enable(p);
 
+	if (account)
+		t_migrate = ktime_get();
+
 	/* switch CPU mode */
 	ret = tegra_cluster_control(delay, flags);
 	if (ret) {
@@ -1083,10 +1153,33 @@ static int tegra3_cpu_cmplx_clk_set_parent(struct clk *c, struct clk *p)
 		return ret;
 	}
 
+	if (account && !timekeeping_suspended) {
+		t_done = ktime_get();
+		if (p->u.cpu.mode == MODE_G) {
+			cluster_switch_account(
+				CLUSTER_PHASE_PLL_LOCK, t_pll, t_rail);
+			cluster_switch_account(
+				CLUSTER_PHASE_RAIL_UP, t_rail, t_migrate);
+			cluster_switch_account(
+				CLUSTER_PHASE_MIGRATE, t_migrate, t_done);
+		}
+	}
+	if (p->u.cpu.mode == MODE_G)
+		cluster_switch_stats.to_g++;
+	else
+		cluster_switch_stats.to_lp++;
+
 	/* Disabling old parent scales old mode voltage rail */
 	if (c->refcnt && c->parent)
 		clk_disable(c->parent);
 
+	/* Pre-warm reference is consumed by the switch */
+	if (cluster_prewarm_clk == p) {
+		clk_disable(p);
+		cluster_prewarm_clk = NULL;
+		cluster_switch_stats.prewarmed++;
+	}
+
 	clk_reparent(c, p);
 	clk_disable(cpu_mode_sclk);
 	return 0;
@@ -3076,13 +3169,33 @@ static noinline int shared_bus_set_rate(struct clk *bus, unsigned long rate,
 	return 0;
 }
 
+/* Charge the time since the last update to the user that set the bus rate */
+static void shared_bus_top_update(struct clk *bus, struct clk *top)
+{
+	u64 cur_jiffies = get_jiffies_64();
+
+	if (bus->shared_bus_top)
+		bus->shared_bus_top->u.shared_bus_user.time_top =
+			cputime64_add(
+				bus->shared_bus_top->u.shared_bus_user.time_top,
+				cputime64_sub(cur_jiffies,
+					      bus->shared_bus_top_since));
+
+	bus->shared_bus_top = top;
+	bus->shared_bus_top_since = cur_jiffies;
+}
+
 static int tegra3_clk_shared_bus_update(struct clk *bus)
 {
 	struct clk *c;
 	unsigned long old_rate;
 	unsigned long rate = bus->min_rate;
 	unsigned long bw = 0;
+	unsigned long bw_max = 0;
 	unsigned long ceiling = bus->max_rate;
+	struct clk *top_floor = NULL;
+	struct clk *top_bw = NULL;
+	struct clk *top_ceiling = NULL;
 	u8 emc_bw_efficiency = tegra_emc_bw_efficiency_boost;
 
 	if (detach_shared_bus)
@@ -3104,15 +3217,24 @@ static int tegra3_clk_shared_bus_update(struct clk *bus)
 			case SHARED_BW:
 				if (bw < bus->max_rate)
 					bw += c->u.shared_bus_user.rate;
+				if (c->u.shared_bus_user.rate > bw_max) {
+					bw_max = c->u.shared_bus_user.rate;
+					top_bw = c;
+				}
 				break;
 			case SHARED_CEILING:
-				ceiling = min(c->u.shared_bus_user.rate,
-					       ceiling);
+				if (c->u.shared_bus_user.rate < ceiling) {
+					ceiling = c->u.shared_bus_user.rate;
+					top_ceiling = c;
+				}
 				break;
 			case SHARED_AUTO:
 			case SHARED_FLOOR:
 			default:
-				rate = max(c->u.shared_bus_user.rate, rate);
+				if (c->u.shared_bus_user.rate > rate) {
+					rate = c->u.shared_bus_user.rate;
+					top_floor = c;
+				}
 			}
 		}
 	}
@@ -3126,7 +3248,17 @@ static int tegra3_clk_shared_bus_update(struct clk *bus)
 		}
 		bw = clk_round_rate_locked(bus, bw);
 	}
-	rate = min(max(rate, bw), ceiling);
+
+	/* the bandwidth sum is charged to its largest contributor */
+	if (bw > rate)
+		top_floor = top_bw;
+	rate = max(rate, bw);
+	if (ceiling < rate)
+		top_floor = top_ceiling;
+	rate = min(rate, ceiling);
+
+	if (top_floor != bus->shared_bus_top)
+		shared_bus_top_update(bus, top_floor);
 
 	old_rate = clk_get_rate_locked(bus);
 	if (rate == old_rate)
@@ -4037,6 +4169,68 @@ static struct clk tegra_clk_cpu_cmplx = {
 	.max_rate  = 1700000000,
 };
 
+/*
+ * Pre-warm the G cluster for an upcoming LP=>G switch while still running on
+ * LP: synchronize the G super-clock mux (locking PLLX if it is not already
+ * running at the target rate) and scale the cpu rail for G. The held G clock
+ * reference is dropped by the switch itself or by calling this with on=false.
+ */
+int tegra_cluster_switch_prewarm(bool on)
+{
+	struct clk *c = &tegra_clk_cpu_cmplx;
+	struct clk *p = &tegra_clk_virtual_cpu_g;
+	unsigned long flags, rate;
+	ktime_t t_pll, t_rail;
+	int ret = 0;
+
+	clk_lock_save(c, &flags);
+
+	if (!on) {
+		if (cluster_prewarm_clk) {
+			clk_disable(cluster_prewarm_clk);
+			cluster_prewarm_clk = NULL;
+			cluster_switch_stats.prewarm_cancelled++;
+		}
+		goto out;
+	}
+
+	if (cluster_prewarm_clk)
+		goto out;
+
+	if ((c->parent == p) || !is_g_cluster_present()) {
+		ret = -EEXIST;
+		goto out;
+	}
+
+	rate = clk_get_rate(c->parent);
+	if (rate > p->max_rate) {
+		ret = -ECANCELED;
+		goto out;
+	}
+
+	t_pll = ktime_get();
+	ret = clk_set_rate(p, rate);
+	if (ret)
+		goto out;
+
+	t_rail = ktime_get();
+	ret = clk_enable(p);
+	if (ret)
+		goto out;
+
+	cluster_switch_account(CLUSTER_PHASE_PREWARM_PLL, t_pll, t_rail);
+	cluster_switch_account(CLUSTER_PHASE_PREWARM_RAIL, t_rail, ktime_get());
+	cluster_prewarm_clk = p;
+out:
+	clk_unlock_restore(c, &flags);
+	return ret;
+}
+
+bool tegra_cluster_switch_prewarmed(void)
+{
+	return cluster_prewarm_clk != NULL;
+}
+
 static struct clk tegra_clk_cop = {
 	.name      = "cop",
 	.parent    = &tegra_clk_sclk,
@@ -4444,6 +4638,7 @@ struct clk tegra_list_clks[] = {
 	SHARED_CLK("camera.emc", "tegra_camera",	"emc",	&tegra_clk_emc, NULL, 0, SHARED_BW),
 	SHARED_CLK("sdmmc4.emc", "sdhci-tegra.3",	"emc",	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("floor.emc",	"floor.emc",		NULL,	&tegra_clk_emc, NULL, 0, 0),
+	SHARED_CLK("boost.emc",	"tegra_input_boost",	"emc",	&tegra_clk_emc, NULL, 0, 0),
 
 	SHARED_CLK("host1x.cbus", "tegra_host1x",	"host1x", &tegra_clk_cbus, "host1x", 2, SHARED_AUTO),
 	SHARED_CLK("3d.cbus",	"tegra_gr3d",		"gr3d",	&tegra_clk_cbus, "3d",  0, 0),
@@ -5447,6 +5642,85 @@ static int __init tegra_soc_preinit_clocks(void)
 }
 #endif /* CONFIG_TEGRA_PREINIT_CLOCKS */
 
+#ifdef CONFIG_DEBUG_FS
+static int cluster_switch_show(struct seq_file *s, void *data)
+{
+	int i, j;
+
+	seq_printf(s, "switches to G: %u, to LP: %u\n",
+		   cluster_switch_stats.to_g, cluster_switch_stats.to_lp);
+	seq_printf(s, "prewarmed: %u, prewarm cancelled: %u\n",
+		   cluster_switch_stats.prewarmed,
+		   cluster_switch_stats.prewarm_cancelled);
+	seq_printf(s, "\n%-14s %8s %10s %10s\n",
+		   "phase(LP=>G)", "count", "avg(us)", "max(us)");
+	for (i = 0; i < CLUSTER_PHASE_NUM; i++) {
+		struct cluster_switch_phase *ph = &cluster_switch_phases[i];
+		u64 avg = ph->total_us;
+
+		if (ph->count)
+			do_div(avg, ph->count);
+		seq_printf(s, "%-14s %8u %10llu %10u\n",
+			   ph->name, ph->count, avg, ph->max_us);
+	}
+
+	seq_printf(s, "\n%-10s", "<us");
+	for (i = 0; i < CLUSTER_PHASE_NUM; i++)
+		seq_printf(s, " %12s", cluster_switch_phases[i].name);
+	seq_printf(s, "\n");
+	for (j = 0; j < CLUSTER_SWITCH_HIST_SIZE; j++) {
+		if (j == CLUSTER_SWITCH_HIST_SIZE - 1)
+			seq_printf(s, "%-10s", "inf");
+		else
+			seq_printf(s, "%-10u", 1U << j);
+		for (i = 0; i < CLUSTER_PHASE_NUM; i++)
+			seq_printf(s, " %12u", cluster_switch_phases[i].hist[j]);
+		seq_printf(s, "\n");
+	}
+	return 0;
+}
+
+static int cluster_switch_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cluster_switch_show, inode->i_private);
+}
+
+/* any write resets the statistics */
+static ssize_t cluster_switch_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	int i;
+
+	for (i = 0; i < CLUSTER_PHASE_NUM; i++) {
+		struct cluster_switch_phase *ph = &cluster_switch_phases[i];
+
+		ph->count = 0;
+		ph->max_us = 0;
+		ph->total_us = 0;
+		memset(ph->hist, 0, sizeof(ph->hist));
+	}
+	memset(&cluster_switch_stats, 0, sizeof(cluster_switch_stats));
+	return count;
+}
+
+static const struct file_operations cluster_switch_fops = {
+	.open		= cluster_switch_open,
+	.read		= seq_read,
+	.write		= cluster_switch_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_cluster_switch_debug_init(void)
+{
+	if (!debugfs_create_file("cluster_switch", S_IRUGO | S_IWUSR, NULL,
+				 NULL, &cluster_switch_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(tegra_cluster_switch_debug_init);
+#endif
+
 void __init tegra_soc_init_clocks(void)
 {
 	int i;
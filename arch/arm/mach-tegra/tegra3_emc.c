@@ -28,6 +28,9 @@
 #include <linux/suspend.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/bitmap.h>
+#include <linux/ktime.h>
+#include <linux/lat_hist.h>
 
 #include <asm/cputime.h>
 #include <asm/cacheflush.h>
@@ -46,6 +49,11 @@ static bool emc_enable;
 #endif
 module_param(emc_enable, bool, 0644);
 
+/* Fill large gaps in the DFS table with entries derived from the next
+   higher validated timing; takes effect at boot only */
+static bool emc_synth_rates;
+module_param(emc_synth_rates, bool, 0444);
+
 u8 tegra_emc_bw_efficiency = 35;
 u8 tegra_emc_bw_efficiency_boost = 45;
 
@@ -191,6 +199,20 @@ enum {
 
 static int emc_num_burst_regs;
 
+/* Burst registers that differ between each pair of table entries, built
+   once at init so that a rate switch only programs what actually changes */
+static DECLARE_BITMAP(emc_burst_diff[TEGRA_EMC_TABLE_MAX_SIZE]
+		      [TEGRA_EMC_TABLE_MAX_SIZE], TEGRA_EMC_NUM_REGS);
+
+/* Burst registers also written outside of the burst sequence, so the shadow
+   copy may not match the last table entry; always re-program them */
+static const int emc_burst_volatile[] = {
+	EMC_MRS_WAIT_CNT_INDEX,
+	EMC_ZCAL_WAIT_CNT_INDEX,
+	MC_EMEM_ARB_OUTSTANDING_REQ_INDEX,
+	MC_EMEM_ARB_RING1_THROTTLE_INDEX,
+};
+
 struct emc_sel {
 	struct clk	*input;
 	u32		value;
@@ -199,8 +221,10 @@ struct emc_sel {
 
 static struct emc_sel tegra_emc_clk_sel[TEGRA_EMC_TABLE_MAX_SIZE];
 static struct tegra_emc_table start_timing;
+static struct tegra_emc_table emc_synth_table[TEGRA_EMC_TABLE_MAX_SIZE];
 static const struct tegra_emc_table *emc_timing;
 static unsigned long dram_over_temp_state = DRAM_OVER_TEMP_NONE;
+static u32 emc_ring1_throttle;		/* 0: use DFS table setting */
 
 static const u32 *dram_to_soc_bit_map;
 static const struct tegra_emc_table *tegra_emc_table;
@@ -218,9 +242,15 @@ static struct {
 	int last_sel;
 	u64 last_update;
 	u64 clkchange_count;
+	u64 switch_time_total;
+	u32 switch_time_last;
+	u32 switch_time_max;
+	u64 switch_regs_total;
 	spinlock_t spinlock;
 } emc_stats;
 
+DEFINE_LAT_HIST(emc_switch_hist, "emc_switch");
+
 static DEFINE_SPINLOCK(emc_access_lock);
 
 static void __iomem *emc_base = IO_ADDRESS(TEGRA_EMC_BASE);
@@ -267,6 +297,22 @@ static void emc_last_stats_update(int last_sel)
 	spin_unlock_irqrestore(&emc_stats.spinlock, flags);
 }
 
+static void emc_switch_stats_update(s64 switch_ns, int regs)
+{
+	unsigned long flags;
+	u32 switch_us = div_s64(switch_ns, NSEC_PER_USEC);
+
+	spin_lock_irqsave(&emc_stats.spinlock, flags);
+	emc_stats.switch_time_last = switch_us;
+	emc_stats.switch_time_total += switch_us;
+	if (switch_us > emc_stats.switch_time_max)
+		emc_stats.switch_time_max = switch_us;
+	emc_stats.switch_regs_total += regs;
+	spin_unlock_irqrestore(&emc_stats.spinlock, flags);
+
+	lat_hist_add(&emc_switch_hist, switch_us);
+}
+
 static int wait_for_update(u32 status_reg, u32 bit_mask, bool updated_state)
 {
 	int i;
@@ -515,11 +561,62 @@ static inline void do_clock_change(u32 clk_setting)
 	}
 }
 
-static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
-				   const struct tegra_emc_table *last_timing,
-				   u32 clk_setting)
+static void emc_init_burst_diff(void)
+{
+	int i, j, k;
+
+	for (i = 0; i < tegra_emc_table_size; i++) {
+		for (j = 0; j < tegra_emc_table_size; j++) {
+			unsigned long *diff = emc_burst_diff[i][j];
+
+			bitmap_zero(diff, TEGRA_EMC_NUM_REGS);
+			for (k = 0; k < emc_num_burst_regs; k++) {
+				if (burst_reg_addr[k] &&
+				    (tegra_emc_table[i].burst_regs[k] !=
+				     tegra_emc_table[j].burst_regs[k]))
+					__set_bit(k, diff);
+			}
+			for (k = 0; k < ARRAY_SIZE(emc_burst_volatile); k++)
+				__set_bit(emc_burst_volatile[k], diff);
+		}
+	}
+}
+
+/* Program burst shadow registers, returns the number of registers written */
+static inline int emc_write_burst_regs(
+	const struct tegra_emc_table *next_timing,
+	const struct tegra_emc_table *last_timing)
 {
-	int i, dll_change, pre_wait;
+	int i, n = 0;
+	const unsigned long *diff;
+
+	/* start_timing is read back from h/w, and is not in the table */
+	if ((last_timing < tegra_emc_table) ||
+	    (last_timing >= tegra_emc_table + tegra_emc_table_size)) {
+		for (i = 0; i < emc_num_burst_regs; i++) {
+			if (!burst_reg_addr[i])
+				continue;
+			__raw_writel(next_timing->burst_regs[i],
+				     burst_reg_addr[i]);
+			n++;
+		}
+		return n;
+	}
+
+	diff = emc_burst_diff[last_timing - tegra_emc_table]
+			     [next_timing - tegra_emc_table];
+	for_each_set_bit(i, diff, emc_num_burst_regs) {
+		__raw_writel(next_timing->burst_regs[i], burst_reg_addr[i]);
+		n++;
+	}
+	return n;
+}
+
+static noinline int emc_set_clock(const struct tegra_emc_table *next_timing,
+				  const struct tegra_emc_table *last_timing,
+				  u32 clk_setting)
+{
+	int regs, dll_change, pre_wait;
 	bool dyn_sref_enabled, vref_cal_toggle, qrst_used, zcal_long;
 
 	u32 mc_override = mc_readl(MC_EMEM_ARB_OVERRIDE);
@@ -569,15 +666,14 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 	if (vref_cal_toggle)
 		auto_cal_disable();
 
-	/* 4. program burst shadow registers */
-	for (i = 0; i < emc_num_burst_regs; i++) {
-		if (!burst_reg_addr[i])
-			continue;
-		__raw_writel(next_timing->burst_regs[i], burst_reg_addr[i]);
-	}
+	/* 4. program burst shadow registers that differ from last timing */
+	regs = emc_write_burst_regs(next_timing, last_timing);
 	if ((dram_type == DRAM_TYPE_LPDDR2) &&
 	    (dram_over_temp_state != DRAM_OVER_TEMP_NONE))
 		set_over_temp_timing(next_timing, dram_over_temp_state);
+	if (emc_ring1_throttle)
+		__raw_writel(emc_ring1_throttle,
+			     burst_reg_addr[MC_EMEM_ARB_RING1_THROTTLE_INDEX]);
 	wmb();
 	barrier();
 
@@ -674,6 +770,8 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 
 	/* 18.a restore early ACK */
 	mc_writel(mc_override, MC_EMEM_ARB_OVERRIDE);
+
+	return regs;
 }
 
 static inline void emc_get_timing(struct tegra_emc_table *timing)
@@ -721,10 +819,11 @@ static inline void emc_cfg_power_restore(void)
  * multiple frequency changes */
 static int emc_set_rate(unsigned long rate, bool use_backup)
 {
-	int i;
+	int i, regs;
 	u32 clk_setting;
 	const struct tegra_emc_table *last_timing;
 	unsigned long flags;
+	ktime_t start;
 
 	if (!tegra_emc_table)
 		return -EINVAL;
@@ -755,13 +854,24 @@ static int emc_set_rate(unsigned long rate, bool use_backup)
 	clk_setting = use_backup ? emc->shared_bus_backup.value :
 		tegra_emc_clk_sel[i].value;
 
+	/* tighten latency allowances before the rate drops, relax them
+	   only after it has gone up */
+	if (rate < last_timing->rate)
+		tegra_latency_allowance_update_emc_rate(rate * 1000);
+
 	spin_lock_irqsave(&emc_access_lock, flags);
-	emc_set_clock(&tegra_emc_table[i], last_timing, clk_setting);
+	start = ktime_get();
+	regs = emc_set_clock(&tegra_emc_table[i], last_timing, clk_setting);
 	if (!emc_timing)
 		emc_cfg_power_restore();
 	emc_timing = &tegra_emc_table[i];
+	emc_switch_stats_update(ktime_to_ns(ktime_sub(ktime_get(), start)),
+				regs);
 	spin_unlock_irqrestore(&emc_access_lock, flags);
 
+	if (rate >= last_timing->rate)
+		tegra_latency_allowance_update_emc_rate(rate * 1000);
+
 	emc_last_stats_update(i);
 
 	pr_debug("%s: rate %lu setting 0x%x\n", __func__, rate, clk_setting);
@@ -1044,6 +1154,116 @@ static int tegra_emc_get_table_ns_per_tick(unsigned int emc_rate,
 	return ns_per_tick;
 }
 
+/* Closest rate to the gap middle that a fixed PLL divides down to exactly */
+static unsigned long emc_synth_find_rate(unsigned long lo, unsigned long hi)
+{
+	int i, k;
+	unsigned long best = 0;
+	unsigned long target = (lo + hi) / 2;
+	struct clk *inputs[] = { emc->parent, tegra_get_clock_by_name("pll_p") };
+
+	for (i = 0; i < ARRAY_SIZE(inputs); i++) {
+		unsigned long input_rate;
+
+		if (!inputs[i])
+			continue;
+		input_rate = clk_get_rate(inputs[i]) / 1000;
+
+		for (k = 1; input_rate / k > lo; k++) {
+			unsigned long r = input_rate / k;
+
+			if ((clk_get_rate(inputs[i]) % (r * 1000)) ||
+			    (r * 4 < lo * 5) || (r * 5 > hi * 4))
+				continue;
+			if (abs((long)r - (long)target) <
+			    abs((long)best - (long)target))
+				best = r;
+		}
+	}
+	return best;
+}
+
+/*
+ * Derive a timing for rate from the next higher entry.  Timings given in
+ * clocks are only relaxed by running slower, except for the refresh
+ * intervals and the MC arbiter tick, which are scaled down to keep their
+ * absolute length.  Mode registers (CL/CWL, DLL state) must be identical
+ * on both sides of the gap, since those are not safe to reuse.
+ */
+static bool emc_synth_timing(struct tegra_emc_table *t,
+			     const struct tegra_emc_table *lo,
+			     const struct tegra_emc_table *hi,
+			     unsigned long rate)
+{
+#define REFRESH_SCALE(idx)						      \
+	do {								      \
+		u32 val = t->burst_regs[idx];				      \
+		t->burst_regs[idx] = (val & 0xFFFF0000) |		      \
+			((val & 0xFFFF) * rate / hi->rate);		      \
+	} while (0)
+
+	u32 cfg, cycles;
+
+	if ((lo->emc_mode_reset != hi->emc_mode_reset) ||
+	    (lo->emc_mode_1 != hi->emc_mode_1) ||
+	    (lo->emc_mode_2 != hi->emc_mode_2) ||
+	    ((lo->burst_regs[MC_EMEM_ARB_MISC0_INDEX] ^
+	      hi->burst_regs[MC_EMEM_ARB_MISC0_INDEX]) &
+	     MC_EMEM_ARB_MISC0_EMC_SAME_FREQ))
+		return false;
+
+	*t = *hi;
+	t->rate = rate;
+
+	REFRESH_SCALE(EMC_REFRESH_INDEX);
+	REFRESH_SCALE(EMC_PRE_REFRESH_REQ_CNT_INDEX);
+	REFRESH_SCALE(EMC_DYN_SELF_REF_CONTROL_INDEX);
+	REFRESH_SCALE(EMC_TREFBW_INDEX);
+
+	cfg = t->burst_regs[MC_EMEM_ARB_CFG_INDEX];
+	cycles = DIV_ROUND_CLOSEST((cfg & MC_EMEM_ARB_CFG_CYCLE_MASK) * rate,
+				   hi->rate);
+	t->burst_regs[MC_EMEM_ARB_CFG_INDEX] =
+		(cfg & ~MC_EMEM_ARB_CFG_CYCLE_MASK) | cycles;
+
+	return tegra_emc_get_table_ns_per_tick(rate,
+			t->burst_regs[MC_EMEM_ARB_CFG_INDEX]) ==
+		tegra_emc_get_table_ns_per_tick(hi->rate,
+			hi->burst_regs[MC_EMEM_ARB_CFG_INDEX]);
+#undef REFRESH_SCALE
+}
+
+static const struct tegra_emc_table *emc_synth_intermediate(
+	const struct tegra_emc_table *table, int *table_size)
+{
+	int i, n = 0;
+
+	for (i = 0; i < *table_size; i++) {
+		const struct tegra_emc_table *lo = &table[i];
+		const struct tegra_emc_table *hi = &table[i + 1];
+		unsigned long rate;
+
+		emc_synth_table[n++] = *lo;
+
+		/* only fill gaps of 1.5x or more, leaving room for the
+		   remaining source entries */
+		if ((i == *table_size - 1) || !lo->rate || !hi->rate ||
+		    (hi->rate * 2 < lo->rate * 3) ||
+		    (n + *table_size - i - 1 >= TEGRA_EMC_TABLE_MAX_SIZE))
+			continue;
+
+		rate = emc_synth_find_rate(lo->rate, hi->rate);
+		if (rate && emc_synth_timing(&emc_synth_table[n], lo, hi, rate)) {
+			pr_info("tegra: EMC DFS table: added %lu kHz entry\n",
+				rate);
+			n++;
+		}
+	}
+
+	*table_size = n;
+	return emc_synth_table;
+}
+
 void tegra_init_emc(const struct tegra_emc_table *table, int table_size)
 {
 	int i, mv;
@@ -1058,6 +1278,7 @@ void tegra_init_emc(const struct tegra_emc_table *table, int table_size)
 	spin_lock_init(&emc_stats.spinlock);
 	emc_stats.last_update = get_jiffies_64();
 	emc_stats.last_sel = TEGRA_EMC_TABLE_MAX_SIZE;
+	lat_hist_register(&emc_switch_hist);
 
 	boot_rate = clk_get_rate(emc) / 1000;
 	max_rate = clk_get_max_rate(emc) / 1000;
@@ -1094,6 +1315,9 @@ void tegra_init_emc(const struct tegra_emc_table *table, int table_size)
 		return;
 	}
 
+	if (emc_synth_rates)
+		table = emc_synth_intermediate(table, &tegra_emc_table_size);
+
 	/* Match EMC source/divider settings with table entries */
 	for (i = 0; i < tegra_emc_table_size; i++) {
 		bool mc_same_freq = MC_EMEM_ARB_MISC0_EMC_SAME_FREQ &
@@ -1156,6 +1380,8 @@ void tegra_init_emc(const struct tegra_emc_table *table, int table_size)
 	}
 	pr_info("tegra: validated EMC DFS table\n");
 
+	emc_init_burst_diff();
+
 	/* Configure clock change mode according to dram type */
 	reg = emc_readl(EMC_CFG_2) & (~EMC_CFG_2_MODE_MASK);
 	reg |= ((dram_type == DRAM_TYPE_LPDDR2) ? EMC_CFG_2_PD_MODE :
@@ -1282,6 +1508,26 @@ int tegra_emc_set_over_temp_state(unsigned long state)
 	return 0;
 }
 
+/* Override the ring1 (non-isochronous) arbiter throttle set by the DFS
+   table; 0 restores the table setting. Kept across rate changes. */
+int tegra_emc_set_ring1_throttle(u32 throttle)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&emc_access_lock, flags);
+	if (emc_ring1_throttle != throttle) {
+		emc_ring1_throttle = throttle;
+		if (emc_timing) {
+			mc_writel(throttle ? : emc_timing->burst_regs[
+					MC_EMEM_ARB_RING1_THROTTLE_INDEX],
+				  MC_EMEM_ARB_RING1_THROTTLE);
+			mc_writel(0x1, MC_TIMING_CONTROL);
+		}
+	}
+	spin_unlock_irqrestore(&emc_access_lock, flags);
+	return 0;
+}
+
 /* non-zero state value will reduce eack_disable_refcnt */
 static int tegra_emc_set_eack_state(unsigned long state)
 {
@@ -1347,6 +1593,18 @@ static int emc_stats_show(struct seq_file *s, void *data)
 	}
 	seq_printf(s, "%-15s %llu\n", "transitions:",
 		   emc_stats.clkchange_count);
+	if (emc_stats.clkchange_count) {
+		seq_printf(s, "%-15s %u us\n", "switch-last:",
+			   emc_stats.switch_time_last);
+		seq_printf(s, "%-15s %llu us\n", "switch-avg:",
+			   div64_u64(emc_stats.switch_time_total,
+				     emc_stats.clkchange_count));
+		seq_printf(s, "%-15s %u us\n", "switch-max:",
+			   emc_stats.switch_time_max);
+		seq_printf(s, "%-15s %llu\n", "switch-regs:",
+			   div64_u64(emc_stats.switch_regs_total,
+				     emc_stats.clkchange_count));
+	}
 	seq_printf(s, "%-15s %llu\n", "time-stamp:",
 		   cputime64_to_clock_t(emc_stats.last_update));
 
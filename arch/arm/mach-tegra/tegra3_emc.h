@@ -62,6 +62,7 @@ void tegra_emc_dram_type_init(struct clk *c);
 int tegra_emc_get_dram_type(void);
 int tegra_emc_get_dram_temperature(void);
 int tegra_emc_set_over_temp_state(unsigned long state);
+int tegra_emc_set_ring1_throttle(u32 throttle);
 
 #ifdef CONFIG_PM_SLEEP
 void tegra_mc_timing_restore(void);
@@ -295,6 +296,7 @@ enum {
 #define MC_EMEM_ARB_MISC0_EMC_SAME_FREQ		(0x1 << 27)
 #define MC_EMEM_ARB_MISC1			0xdc
 #define MC_EMEM_ARB_RING1_THROTTLE		0xe0
+#define MC_EMEM_ARB_RING1_THROTTLE_MAX		0x001f001f
 #define MC_EMEM_ARB_RING3_THROTTLE		0xe4
 #define MC_EMEM_ARB_OVERRIDE			0xe8
 #define MC_EMEM_ARB_OVERRIDE_EACK_MASK		(0x3 << 0)
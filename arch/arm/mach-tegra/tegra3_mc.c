@@ -0,0 +1,414 @@
+/*
+ * arch/arm/mach-tegra/tegra3_mc.c
+ *
+ * Tegra3 memory controller per-client bandwidth statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/spinlock.h>
+#include <linux/sysdev.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/init.h>
+
+#include <mach/iomap.h>
+#include <mach/clk.h>
+
+#include "tegra3_mc.h"
+
+/*
+ * Unlike tegra2_mc, which logs raw samples of one client at a time for
+ * user space to post-process, this keeps a rolling table per unit: each
+ * window the two counter sets count the requests of two units, and the
+ * next window moves on to the next two.  Totals are extrapolated by the
+ * number of windows a unit waits for its turn.
+ */
+
+#define MC_STAT_WINDOW_DEFAULT	20	/* ms */
+#define MC_STAT_WINDOW_MAX	1000
+
+/* display traffic is isochronous; keep EMC at twice what it measured */
+#define MC_STAT_ISO_MARGIN	2
+#define EMC_BYTES_PER_CLOCK	8
+
+static const char * const mc_unit_names[TEGRA3_MC_NUM_UNITS] = {
+	[TEGRA3_MC_DISPLAY]	= "display",
+	[TEGRA3_MC_GR3D]	= "3d",
+	[TEGRA3_MC_GR2D]	= "2d",
+	[TEGRA3_MC_AVP]		= "avp",
+	[TEGRA3_MC_CPU]		= "cpu",
+	[TEGRA3_MC_AHB]		= "ahb",
+	[TEGRA3_MC_VDE]		= "vde",
+	[TEGRA3_MC_MPE]		= "mpe",
+	[TEGRA3_MC_VI]		= "vi",
+	[TEGRA3_MC_HOST1X]	= "host1x",
+	[TEGRA3_MC_OTHER]	= "other",
+};
+
+/* owning unit of each MC client id */
+static const u8 mc_client_unit[] = {
+	[0]  = TEGRA3_MC_OTHER,		/* ptcr */
+	[1]  = TEGRA3_MC_DISPLAY,	/* display0a */
+	[2]  = TEGRA3_MC_DISPLAY,	/* display0ab */
+	[3]  = TEGRA3_MC_DISPLAY,	/* display0b */
+	[4]  = TEGRA3_MC_DISPLAY,	/* display0bb */
+	[5]  = TEGRA3_MC_DISPLAY,	/* display0c */
+	[6]  = TEGRA3_MC_DISPLAY,	/* display0cb */
+	[7]  = TEGRA3_MC_DISPLAY,	/* display1b */
+	[8]  = TEGRA3_MC_DISPLAY,	/* display1bb */
+	[9]  = TEGRA3_MC_OTHER,		/* eppup */
+	[10] = TEGRA3_MC_GR2D,		/* g2pr */
+	[11] = TEGRA3_MC_GR2D,		/* g2sr */
+	[12] = TEGRA3_MC_MPE,		/* mpeunifbr */
+	[13] = TEGRA3_MC_VI,		/* viruv */
+	[14] = TEGRA3_MC_OTHER,		/* afir */
+	[15] = TEGRA3_MC_AVP,		/* avpcarm7r */
+	[16] = TEGRA3_MC_DISPLAY,	/* displayhc */
+	[17] = TEGRA3_MC_DISPLAY,	/* displayhcb */
+	[18] = TEGRA3_MC_GR3D,		/* fdcdrd */
+	[19] = TEGRA3_MC_GR3D,		/* fdcdrd2 */
+	[20] = TEGRA3_MC_GR2D,		/* g2dr */
+	[21] = TEGRA3_MC_OTHER,		/* hdar */
+	[22] = TEGRA3_MC_HOST1X,	/* host1xdmar */
+	[23] = TEGRA3_MC_HOST1X,	/* host1xr */
+	[24] = TEGRA3_MC_GR3D,		/* idxsrd */
+	[25] = TEGRA3_MC_GR3D,		/* idxsrd2 */
+	[26] = TEGRA3_MC_MPE,		/* mpe_ipred */
+	[27] = TEGRA3_MC_MPE,		/* mpeamemrd */
+	[28] = TEGRA3_MC_MPE,		/* mpecsrd */
+	[29] = TEGRA3_MC_AHB,		/* ppcsahbdmar */
+	[30] = TEGRA3_MC_AHB,		/* ppcsahbslvr */
+	[31] = TEGRA3_MC_OTHER,		/* satar */
+	[32] = TEGRA3_MC_GR3D,		/* texsrd */
+	[33] = TEGRA3_MC_GR3D,		/* texsrd2 */
+	[34] = TEGRA3_MC_VDE,		/* vdebsevr */
+	[35] = TEGRA3_MC_VDE,		/* vdember */
+	[36] = TEGRA3_MC_VDE,		/* vdemcer */
+	[37] = TEGRA3_MC_VDE,		/* vdetper */
+	[38] = TEGRA3_MC_CPU,		/* mpcorelpr */
+	[39] = TEGRA3_MC_CPU,		/* mpcorer */
+	[40] = TEGRA3_MC_OTHER,		/* eppu */
+	[41] = TEGRA3_MC_OTHER,		/* eppv */
+	[42] = TEGRA3_MC_OTHER,		/* eppy */
+	[43] = TEGRA3_MC_MPE,		/* mpeunifbw */
+	[44] = TEGRA3_MC_VI,		/* viwsb */
+	[45] = TEGRA3_MC_VI,		/* viwu */
+	[46] = TEGRA3_MC_VI,		/* viwv */
+	[47] = TEGRA3_MC_VI,		/* viwy */
+	[48] = TEGRA3_MC_GR2D,		/* g2dw */
+	[49] = TEGRA3_MC_OTHER,		/* afiw */
+	[50] = TEGRA3_MC_AVP,		/* avpcarm7w */
+	[51] = TEGRA3_MC_GR3D,		/* fdcdwr */
+	[52] = TEGRA3_MC_GR3D,		/* fdcdwr2 */
+	[53] = TEGRA3_MC_OTHER,		/* hdaw */
+	[54] = TEGRA3_MC_HOST1X,	/* host1xw */
+	[55] = TEGRA3_MC_VI,		/* ispw */
+	[56] = TEGRA3_MC_CPU,		/* mpcorelpw */
+	[57] = TEGRA3_MC_CPU,		/* mpcorew */
+	[58] = TEGRA3_MC_MPE,		/* mpecswr */
+	[59] = TEGRA3_MC_AHB,		/* ppcsahbdmaw */
+	[60] = TEGRA3_MC_AHB,		/* ppcsahbslvw */
+	[61] = TEGRA3_MC_OTHER,		/* sataw */
+	[62] = TEGRA3_MC_VDE,		/* vdebsevw */
+	[63] = TEGRA3_MC_VDE,		/* vdedbgw */
+	[64] = TEGRA3_MC_VDE,		/* vdembew */
+	[65] = TEGRA3_MC_VDE,		/* vdetpmw */
+};
+
+struct mc_unit_stat {
+	u32		mask[MC_STAT_CLIENT_WORDS];
+	u64		requests;	/* extrapolated totals */
+	u64		bytes;
+	unsigned long	bw;		/* KB/s, last window counted */
+	unsigned long	bw_avg;		/* KB/s, rolling */
+	unsigned long	bw_peak;	/* KB/s */
+};
+
+static struct mc_unit_stat mc_units[TEGRA3_MC_NUM_UNITS];
+static int mc_set_unit[MC_STAT_NUM_SETS];
+
+static void __iomem *mc_base = IO_ADDRESS(TEGRA_MC_BASE);
+static struct hrtimer mc_stat_timer;
+static ktime_t mc_stat_start_time;
+static DEFINE_SPINLOCK(mc_stat_lock);
+
+static bool mc_stat_enable;
+static u32 mc_stat_window = MC_STAT_WINDOW_DEFAULT;
+
+static inline ktime_t mc_stat_period(void)
+{
+	return ktime_set(0, mc_stat_window * NSEC_PER_MSEC);
+}
+
+static inline u32 mc_readl(u32 offs)
+{
+	return readl(mc_base + offs);
+}
+
+static inline void mc_writel(u32 val, u32 offs)
+{
+	writel(val, mc_base + offs);
+}
+
+static void mc_stat_gather(u32 op)
+{
+	mc_writel(op << MC_STAT_CONTROL_EMC_GATHER_SHIFT, MC_STAT_CONTROL);
+}
+
+/* point the counter sets at the next units and restart counting */
+static void mc_stat_program(void)
+{
+	int s, n;
+
+	mc_stat_gather(MC_STAT_CONTROL_GATHER_DISABLE);
+
+	for (s = 0; s < MC_STAT_NUM_SETS; s++) {
+		struct mc_unit_stat *u;
+
+		mc_set_unit[s] = (mc_set_unit[s] + MC_STAT_NUM_SETS) %
+			TEGRA3_MC_NUM_UNITS;
+		u = &mc_units[mc_set_unit[s]];
+
+		mc_writel(0, MC_STAT_EMC_FILTER_ADR_LIMIT_LO(s));
+		mc_writel(0xffffffff, MC_STAT_EMC_FILTER_ADR_LIMIT_HI(s));
+		mc_writel(0, MC_STAT_EMC_FILTER_MISC(s));
+		for (n = 0; n < MC_STAT_CLIENT_WORDS; n++)
+			mc_writel(u->mask[n], MC_STAT_EMC_FILTER_CLIENT(s, n));
+	}
+
+	mc_writel(0xffffffff, MC_STAT_EMC_CLOCK_LIMIT);
+	mc_writel(0xff, MC_STAT_EMC_CLOCK_LIMIT_MSBS);
+
+	mc_stat_gather(MC_STAT_CONTROL_GATHER_CLEAR);
+	mc_stat_gather(MC_STAT_CONTROL_GATHER_ENABLE);
+	mc_stat_start_time = ktime_get();
+}
+
+static void mc_stat_update_hint(void)
+{
+	unsigned long bw = mc_units[TEGRA3_MC_DISPLAY].bw_avg;
+
+	/* KB/s -> EMC Hz */
+	tegra_emc_bw_hint(TEGRA_EMC_BW_MC_ISO,
+		bw * (1000 / EMC_BYTES_PER_CLOCK) * MC_STAT_ISO_MARGIN);
+}
+
+/* fold the counts of the window that just ended into the table */
+static void mc_stat_collect(void)
+{
+	u64 ns, count, est;
+	int s;
+
+	mc_stat_gather(MC_STAT_CONTROL_GATHER_DISABLE);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), mc_stat_start_time));
+	if (!ns)
+		return;
+
+	spin_lock(&mc_stat_lock);
+	for (s = 0; s < MC_STAT_NUM_SETS; s++) {
+		struct mc_unit_stat *u = &mc_units[mc_set_unit[s]];
+
+		count = ((u64)mc_readl(MC_STAT_EMC_COUNT_MSBS(s)) << 32) |
+			mc_readl(MC_STAT_EMC_COUNT(s));
+
+		/* a unit is counted in MC_STAT_NUM_SETS of every
+		 * TEGRA3_MC_NUM_UNITS windows */
+		est = div_u64(count * TEGRA3_MC_NUM_UNITS, MC_STAT_NUM_SETS);
+		u->requests += est;
+		u->bytes += est * MC_STAT_BYTES_PER_REQUEST;
+
+		/* bytes/ns * 10^6 = KB/s */
+		u->bw = div64_u64(count * MC_STAT_BYTES_PER_REQUEST * 1000000,
+				  ns);
+		u->bw_avg = u->bw_avg ? (u->bw + u->bw_avg * 3) / 4 : u->bw;
+		u->bw_peak = max(u->bw_peak, u->bw);
+	}
+	spin_unlock(&mc_stat_lock);
+
+	if (mc_set_unit[0] == TEGRA3_MC_DISPLAY ||
+	    mc_set_unit[1] == TEGRA3_MC_DISPLAY)
+		mc_stat_update_hint();
+}
+
+static enum hrtimer_restart mc_stat_timer_fn(struct hrtimer *timer)
+{
+	mc_stat_collect();
+	mc_stat_program();
+	hrtimer_forward_now(timer, mc_stat_period());
+	return HRTIMER_RESTART;
+}
+
+static void mc_stat_set_enable(bool enable)
+{
+	if (enable == mc_stat_enable)
+		return;
+
+	mc_stat_enable = enable;
+	if (enable) {
+		mc_set_unit[0] = TEGRA3_MC_NUM_UNITS - MC_STAT_NUM_SETS;
+		mc_set_unit[1] = TEGRA3_MC_NUM_UNITS - 1;
+		mc_stat_program();
+		hrtimer_start(&mc_stat_timer, mc_stat_period(),
+			      HRTIMER_MODE_REL);
+	} else {
+		hrtimer_cancel(&mc_stat_timer);
+		mc_stat_gather(MC_STAT_CONTROL_GATHER_DISABLE);
+		tegra_emc_bw_hint(TEGRA_EMC_BW_MC_ISO, 0);
+	}
+}
+
+/**
+ * tegra3_mc_unit_bytes - estimated bytes a unit moved since boot
+ * @unit: memory client unit
+ *
+ * Only advances while statistics are enabled.
+ */
+u64 tegra3_mc_unit_bytes(enum tegra3_mc_unit unit)
+{
+	unsigned long flags;
+	u64 bytes;
+
+	if (unit >= TEGRA3_MC_NUM_UNITS)
+		return 0;
+
+	spin_lock_irqsave(&mc_stat_lock, flags);
+	bytes = mc_units[unit].bytes;
+	spin_unlock_irqrestore(&mc_stat_lock, flags);
+	return bytes;
+}
+
+/* /sys/devices/system/tegra_mc */
+static struct sysdev_class tegra_mc_sysclass = {
+	.name = "tegra_mc",
+};
+
+static ssize_t tegra_mc_enable_show(struct sysdev_class *class,
+	struct sysdev_class_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", mc_stat_enable);
+}
+
+static ssize_t tegra_mc_enable_store(struct sysdev_class *class,
+	struct sysdev_class_attribute *attr,
+	const char *buf, size_t count)
+{
+	int value;
+
+	if (sscanf(buf, "%d", &value) != 1 || (value != 0 && value != 1))
+		return -EINVAL;
+
+	mc_stat_set_enable(value);
+	return count;
+}
+
+static ssize_t tegra_mc_quantum_show(struct sysdev_class *class,
+	struct sysdev_class_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", mc_stat_window);
+}
+
+static ssize_t tegra_mc_quantum_store(struct sysdev_class *class,
+	struct sysdev_class_attribute *attr,
+	const char *buf, size_t count)
+{
+	unsigned int value;
+
+	if (mc_stat_enable)
+		return -EBUSY;
+
+	if (sscanf(buf, "%u", &value) != 1 ||
+	    !value || value > MC_STAT_WINDOW_MAX)
+		return -EINVAL;
+
+	mc_stat_window = value;
+	return count;
+}
+
+static ssize_t tegra_mc_bandwidth_show(struct sysdev_class *class,
+	struct sysdev_class_attribute *attr, char *buf)
+{
+	struct mc_unit_stat snap[TEGRA3_MC_NUM_UNITS];
+	ssize_t len;
+	int i;
+
+	spin_lock_irq(&mc_stat_lock);
+	memcpy(snap, mc_units, sizeof(snap));
+	spin_unlock_irq(&mc_stat_lock);
+
+	len = sprintf(buf, "%-8s %10s %10s %10s %14s %12s\n", "unit",
+		      "last_KBps", "avg_KBps", "peak_KBps", "requests", "MB");
+	for (i = 0; i < TEGRA3_MC_NUM_UNITS; i++)
+		len += sprintf(buf + len, "%-8s %10lu %10lu %10lu %14llu %12llu\n",
+			       mc_unit_names[i], snap[i].bw, snap[i].bw_avg,
+			       snap[i].bw_peak, snap[i].requests,
+			       snap[i].bytes >> 20);
+	return len;
+}
+
+static ssize_t tegra_mc_bandwidth_store(struct sysdev_class *class,
+	struct sysdev_class_attribute *attr,
+	const char *buf, size_t count)
+{
+	int i;
+
+	/* any write resets the peaks */
+	spin_lock_irq(&mc_stat_lock);
+	for (i = 0; i < TEGRA3_MC_NUM_UNITS; i++)
+		mc_units[i].bw_peak = 0;
+	spin_unlock_irq(&mc_stat_lock);
+	return count;
+}
+
+static SYSDEV_CLASS_ATTR(enable, 0644, tegra_mc_enable_show,
+			 tegra_mc_enable_store);
+static SYSDEV_CLASS_ATTR(quantum, 0644, tegra_mc_quantum_show,
+			 tegra_mc_quantum_store);
+static SYSDEV_CLASS_ATTR(bandwidth, 0644, tegra_mc_bandwidth_show,
+			 tegra_mc_bandwidth_store);
+
+static struct sysdev_class_attribute *tegra_mc_attrs[] = {
+	&attr_enable,
+	&attr_quantum,
+	&attr_bandwidth,
+	NULL
+};
+
+static int __init tegra3_mc_init(void)
+{
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(mc_client_unit); i++)
+		mc_units[mc_client_unit[i]].mask[i / 32] |= 1 << (i % 32);
+
+	hrtimer_init(&mc_stat_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	mc_stat_timer.function = mc_stat_timer_fn;
+
+	ret = sysdev_class_register(&tegra_mc_sysclass);
+	if (ret)
+		return ret;
+
+	for (i = 0; tegra_mc_attrs[i]; i++) {
+		ret = sysdev_class_create_file(&tegra_mc_sysclass,
+					       tegra_mc_attrs[i]);
+		if (ret) {
+			pr_err("%s: failed to create %s\n", __func__,
+			       tegra_mc_attrs[i]->attr.name);
+			return ret;
+		}
+	}
+	return 0;
+}
+late_initcall(tegra3_mc_init);
@@ -0,0 +1,74 @@
+/*
+ * arch/arm/mach-tegra/tegra3_mc.h
+ *
+ * Tegra3 memory controller per-client bandwidth statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef _INCLUDE_TEGRA3_MC_H_
+#define _INCLUDE_TEGRA3_MC_H_
+
+#include <linux/types.h>
+
+/* MC statistics block, two filter/counter sets */
+#define MC_STAT_CONTROL				0x100
+#define MC_STAT_CONTROL_EMC_GATHER_SHIFT	8
+#define MC_STAT_CONTROL_GATHER_CLEAR		1
+#define MC_STAT_CONTROL_GATHER_DISABLE		2
+#define MC_STAT_CONTROL_GATHER_ENABLE		3
+#define MC_STAT_EMC_CLOCK_LIMIT			0x108
+#define MC_STAT_EMC_CLOCK_LIMIT_MSBS		0x10c
+#define MC_STAT_EMC_CLOCKS			0x110
+#define MC_STAT_EMC_CLOCKS_MSBS			0x114
+
+#define MC_STAT_SET_STRIDE			0x40
+#define MC_STAT_EMC_FILTER_ADR_LIMIT_LO(s)	(0x118 + (s) * MC_STAT_SET_STRIDE)
+#define MC_STAT_EMC_FILTER_ADR_LIMIT_HI(s)	(0x11c + (s) * MC_STAT_SET_STRIDE)
+#define MC_STAT_EMC_FILTER_MISC(s)		(0x124 + (s) * MC_STAT_SET_STRIDE)
+#define MC_STAT_EMC_FILTER_CLIENT(s, n)		(0x128 + (s) * MC_STAT_SET_STRIDE \
+						 + (n) * 4)
+#define MC_STAT_EMC_COUNT(s)			(0x138 + (s) * MC_STAT_SET_STRIDE)
+#define MC_STAT_EMC_COUNT_MSBS(s)		(0x13c + (s) * MC_STAT_SET_STRIDE)
+
+#define MC_STAT_NUM_SETS			2
+#define MC_STAT_CLIENT_WORDS			3	/* 96 client ids */
+#define MC_STAT_BYTES_PER_REQUEST		32	/* one MC atom */
+
+/*
+ * Memory clients grouped by the unit that owns them.  The counter sets
+ * are rotated over the units, two per sampling window.
+ */
+enum tegra3_mc_unit {
+	TEGRA3_MC_DISPLAY,
+	TEGRA3_MC_GR3D,
+	TEGRA3_MC_GR2D,
+	TEGRA3_MC_AVP,
+	TEGRA3_MC_CPU,
+	TEGRA3_MC_AHB,		/* USB, SDMMC, NAND and other AHB masters */
+	TEGRA3_MC_VDE,
+	TEGRA3_MC_MPE,
+	TEGRA3_MC_VI,
+	TEGRA3_MC_HOST1X,
+	TEGRA3_MC_OTHER,	/* PTC, EPP, AFI, HDA, SATA */
+	TEGRA3_MC_NUM_UNITS,
+};
+
+#ifdef CONFIG_TEGRA_MC_PROFILE
+u64 tegra3_mc_unit_bytes(enum tegra3_mc_unit unit);
+#else
+static inline u64 tegra3_mc_unit_bytes(enum tegra3_mc_unit unit)
+{
+	return 0;
+}
+#endif
+
+#endif
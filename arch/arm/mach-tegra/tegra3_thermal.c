@@ -208,6 +208,9 @@ static void tegra_thermal_alert_unlocked(void *data)
 	long lo_limit_edp_tj = 0, hi_limit_edp_tj = 0;
 	long temp_low_dev, temp_low_tj;
 	int lo_limit_tj = 0, hi_limit_tj = 0;
+#ifdef CONFIG_TEGRA_THERMAL_THROTTLE
+	long throttle_tj, pid_start_tj;
+#endif
 #ifdef CONFIG_TEGRA_EDP_LIMITS
 	const struct tegra_edp_limits *z;
 	int zones_sz;
@@ -232,12 +235,23 @@ static void tegra_thermal_alert_unlocked(void *data)
 	hi_limit_throttle_tj = dev2tj(device, therm->temp_shutdown);
 
 #ifdef CONFIG_TEGRA_THERMAL_THROTTLE
-	hi_limit_throttle_tj = dev2tj(device, therm->temp_throttle);
+	throttle_tj = dev2tj(device, therm->temp_throttle);
+	pid_start_tj = tegra_throttle_pid_start_temp(throttle_tj);
+	hi_limit_throttle_tj = pid_start_tj;
+
+	/* below the trip, alert again when the controller may stop or
+	   the table backstop must take over */
+	if (temp_tj > pid_start_tj) {
+		lo_limit_throttle_tj = pid_start_tj;
+		hi_limit_throttle_tj = throttle_tj;
+	}
 
-	if (temp_tj > dev2tj(device, therm->temp_throttle)) {
-		lo_limit_throttle_tj = dev2tj(device, therm->temp_throttle);
+	if (temp_tj > throttle_tj) {
+		lo_limit_throttle_tj = throttle_tj;
 		hi_limit_throttle_tj = dev2tj(device, therm->temp_shutdown);
 	}
+
+	tegra_throttle_pid_alert(temp_tj, throttle_tj);
 #endif
 
 #ifdef CONFIG_TEGRA_EDP_LIMITS
@@ -296,6 +310,21 @@ static void tegra_thermal_alert(void *data)
 	tegra_thermal_alert_unlocked(data);
 	mutex_unlock(&tegra_therm_mutex);
 }
+
+/* Tj sampling for the closed-loop throttle controller */
+static int tegra_thermal_pid_get_temp(long *tj_temp)
+{
+	int ret;
+
+	if (tegra_thermal_suspend)
+		return -EBUSY;
+
+	mutex_lock(&tegra_therm_mutex);
+	ret = tegra_thermal_get_temp_unlocked(tj_temp, true);
+	mutex_unlock(&tegra_therm_mutex);
+
+	return ret;
+}
 #endif
 
 #ifdef CONFIG_TEGRA_SKIN_THROTTLE
@@ -429,6 +458,7 @@ int tegra_thermal_device_register(struct tegra_thermal_device *device)
 #ifdef CONFIG_TEGRA_THERMAL_THROTTLE
 	if (device->id == therm->throttle_edp_device_id) {
 		device->set_alert(device->data, tegra_thermal_alert, device);
+		tegra_throttle_pid_init(tegra_thermal_pid_get_temp);
 
 		/* initialize limits */
 		tegra_thermal_alert(device);
@@ -27,7 +27,11 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/thermal.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/perflog.h>
 #include <mach/thermal.h>
+#include <mach/edp.h>
 
 #include "clock.h"
 #include "cpu-tegra.h"
@@ -36,6 +40,56 @@
 static struct mutex *cpu_throttle_lock;
 static DEFINE_MUTEX(bthrot_list_lock);
 static LIST_HEAD(bthrot_list);
+static bool core_capped;
+
+/*
+ * Closed-loop throttling: rather than stepping through throttle table
+ * entries at the trip point, a PID controller computes a continuous
+ * throttle output (0 - 1000 per mille) from the Tj error against a set
+ * point just below the trip. The output is mapped onto the Tj balanced
+ * throttle table, interpolating cpu frequency and core cap between
+ * neighbouring entries, and between the lightest entry and the current
+ * EDP limit. The table trip stays in place as a backstop.
+ */
+#define PID_OUTPUT_MAX		1000
+
+static struct {
+	u32 enable;
+	u32 kp;			/* per mille per C */
+	u32 ki;			/* per mille per C per second */
+	u32 kd;			/* per mille per C/s */
+	u32 period_ms;
+	u32 setpoint_offset;	/* mC below throttle trip */
+	u32 band;		/* mC below set point to start sampling */
+
+	int (*get_temp)(long *tj_temp);
+	bool running;
+	long temp;
+	long setpoint;
+	long error;
+	long integral;
+	long derivative;
+	int output;
+	unsigned int cpu_cap;	/* kHz, 0 if not capping */
+	int core_cap;		/* mV, 0 if not capping */
+	ktime_t last_sample;
+
+	u32 activations;
+	u64 throttled_us;
+	u64 full_us;
+} pid = {
+	.enable			= 1,
+	.kp			= 100,
+	.ki			= 20,
+	.kd			= 50,
+	.period_ms		= 250,
+	.setpoint_offset	= 2000,
+	.band			= 3000,
+};
+static DEFINE_MUTEX(pid_lock);
+
+static void pid_work_func(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pid_work, pid_work_func);
 
 static unsigned int clip_to_table(unsigned int cpu_freq)
 {
@@ -57,6 +111,52 @@ static unsigned int clip_to_table(unsigned int cpu_freq)
 	return cpu_freq_table[i].frequency;
 }
 
+static unsigned int table_highest_speed(void)
+{
+	int i;
+	struct cpufreq_frequency_table *cpu_freq_table;
+	struct tegra_cpufreq_table_data *table_data =
+		tegra_cpufreq_table_get();
+
+	if (IS_ERR_OR_NULL(table_data))
+		return 0;
+
+	cpu_freq_table = table_data->freq_table;
+	for (i = 0; cpu_freq_table[i + 1].frequency != CPUFREQ_TABLE_END; i++)
+		;
+	return cpu_freq_table[i].frequency;
+}
+
+/* Must be called with cpu_throttle_lock held */
+static void throttle_core_cap_update(void)
+{
+	struct balanced_throttle *bthrot;
+	int level = INT_MAX;
+	bool cap = false;
+
+	mutex_lock(&bthrot_list_lock);
+	list_for_each_entry(bthrot, &bthrot_list, node) {
+		if (bthrot->is_throttling) {
+			level = min(level, bthrot->throt_tab[
+				bthrot->throttle_index].core_cap_level);
+			cap = true;
+		}
+	}
+	mutex_unlock(&bthrot_list_lock);
+
+	if (pid.core_cap) {
+		level = min(level, pid.core_cap);
+		cap = true;
+	}
+
+	if (cap != core_capped) {
+		tegra_dvfs_core_cap_enable(cap);
+		core_capped = cap;
+	}
+	if (cap)
+		tegra_dvfs_core_cap_level_set(level);
+}
+
 unsigned int tegra_throttle_governor_speed(unsigned int requested_speed)
 {
 	struct balanced_throttle *bthrot;
@@ -92,6 +192,9 @@ unsigned int tegra_throttle_governor_speed(unsigned int requested_speed)
 	}
 	mutex_unlock(&bthrot_list_lock);
 
+	if (pid.cpu_cap)
+		throttle_speed = min(throttle_speed, pid.cpu_cap);
+
 	return throttle_speed;
 }
 
@@ -109,7 +212,191 @@ bool tegra_is_throttling(void)
 	}
 	mutex_unlock(&bthrot_list_lock);
 
-	return is_throttling;
+	return is_throttling || (pid.output > 0);
+}
+
+static inline unsigned int pid_table_freq(unsigned int freq,
+					  unsigned int lowest_speed)
+{
+	return freq ? : lowest_speed;
+}
+
+/* Map controller output onto the Tj throttle table */
+static void pid_output_to_caps(int output, unsigned int *cpu_cap,
+			       int *core_cap)
+{
+	struct balanced_throttle *bthrot;
+	struct throttle_table *deep, *light;
+	struct tegra_cpufreq_table_data *table_data =
+		tegra_cpufreq_table_get();
+	unsigned int lowest_speed, ceiling, edp;
+	unsigned int pos, i, frac, size;
+	long f_deep, f_light;
+
+	*cpu_cap = 0;
+	*core_cap = 0;
+	if (!output || IS_ERR_OR_NULL(table_data))
+		return;
+
+	lowest_speed = table_data->freq_table[
+		table_data->throttle_lowest_index].frequency;
+	ceiling = table_highest_speed();
+	edp = tegra_get_edp_limit();
+	if (edp && (edp < ceiling))
+		ceiling = edp;
+
+	mutex_lock(&bthrot_list_lock);
+	list_for_each_entry(bthrot, &bthrot_list, node) {
+		if ((bthrot->id == BALANCED_THROTTLE_ID_TJ) &&
+		    bthrot->throt_tab_size)
+			break;
+	}
+	if (&bthrot->node == &bthrot_list) {
+		mutex_unlock(&bthrot_list_lock);
+		*cpu_cap = lowest_speed + (ceiling - lowest_speed) / 1000 *
+			(PID_OUTPUT_MAX - output);
+		*cpu_cap = clip_to_table(*cpu_cap);
+		return;
+	}
+
+	/* entry 0 is the deepest throttle step, and the point past the
+	   lightest entry is the EDP limited ceiling without core cap */
+	size = bthrot->throt_tab_size;
+	pos = size * (PID_OUTPUT_MAX - output);
+	i = pos / PID_OUTPUT_MAX;
+	frac = pos % PID_OUTPUT_MAX;
+
+	deep = &bthrot->throt_tab[min(i, size - 1)];
+	f_deep = pid_table_freq(deep->cpu_freq, lowest_speed);
+	if (i + 1 < size) {
+		light = &bthrot->throt_tab[i + 1];
+		f_light = pid_table_freq(light->cpu_freq, lowest_speed);
+		*core_cap = deep->core_cap_level +
+			(light->core_cap_level - deep->core_cap_level) *
+			(int)frac / PID_OUTPUT_MAX;
+		*core_cap = (*core_cap / 50) * 50;
+	} else {
+		f_light = ceiling;
+		*core_cap = (i < size) ? deep->core_cap_level : 0;
+	}
+	mutex_unlock(&bthrot_list_lock);
+
+	*cpu_cap = clip_to_table(f_deep + (f_light - f_deep) * (long)frac /
+				 PID_OUTPUT_MAX);
+}
+
+/* Must be called with pid_lock held */
+static void pid_apply(int output)
+{
+	unsigned int cpu_cap;
+	int core_cap;
+
+	pid_output_to_caps(output, &cpu_cap, &core_cap);
+
+	mutex_lock(cpu_throttle_lock);
+	pid.output = output;
+	pid.cpu_cap = cpu_cap;
+	pid.core_cap = core_cap;
+	perflog_record(PERFLOG_THROTTLE_PID, cpu_cap, core_cap);
+	throttle_core_cap_update();
+	tegra_cpu_set_speed_cap(NULL);
+	mutex_unlock(cpu_throttle_lock);
+}
+
+/* Must be called with pid_lock held */
+static void pid_stats_update(ktime_t now)
+{
+	s64 delta = ktime_us_delta(now, pid.last_sample);
+
+	if (pid.output > 0)
+		pid.throttled_us += delta;
+	if (pid.output == PID_OUTPUT_MAX)
+		pid.full_us += delta;
+	pid.last_sample = now;
+}
+
+static void pid_work_func(struct work_struct *work)
+{
+	long temp, error, dt_ms, output;
+	ktime_t now;
+	int ret;
+
+	/* sample outside pid_lock: the sensor read takes the thermal
+	   mutex, which is held around tegra_throttle_pid_alert() */
+	ret = pid.get_temp ? pid.get_temp(&temp) : -ENODEV;
+
+	mutex_lock(&pid_lock);
+
+	if (!pid.running) {
+		mutex_unlock(&pid_lock);
+		return;
+	}
+
+	now = ktime_get();
+	dt_ms = max_t(long, ktime_to_ms(ktime_sub(now, pid.last_sample)), 1);
+	pid_stats_update(now);
+
+	if (ret || !pid.enable) {
+		pid.running = false;
+		pid.integral = 0;
+		pid_apply(0);
+		mutex_unlock(&pid_lock);
+		return;
+	}
+
+	error = temp - pid.setpoint;
+	pid.integral += (long)pid.ki * error / 1000 * dt_ms / 1000;
+	pid.integral = clamp(pid.integral, 0L, (long)PID_OUTPUT_MAX);
+	pid.derivative = (long)pid.kd * (error - pid.error) / dt_ms;
+	output = (long)pid.kp * error / 1000 + pid.integral + pid.derivative;
+	output = clamp(output, 0L, (long)PID_OUTPUT_MAX);
+
+	pid.temp = temp;
+	pid.error = error;
+	if (output != pid.output)
+		pid_apply(output);
+
+	if (!output && (temp < pid.setpoint - (long)pid.band))
+		pid.running = false;
+	else
+		queue_delayed_work(system_freezable_wq, &pid_work,
+				   msecs_to_jiffies(pid.period_ms));
+
+	mutex_unlock(&pid_lock);
+}
+
+void tegra_throttle_pid_init(int (*get_temp)(long *tj_temp))
+{
+	mutex_lock(&pid_lock);
+	pid.get_temp = get_temp;
+	mutex_unlock(&pid_lock);
+}
+
+/* Temperature at which the sensor should alert to start the controller */
+long tegra_throttle_pid_start_temp(long throttle_tj)
+{
+	if (!pid.enable || !pid.get_temp)
+		return throttle_tj;
+	return throttle_tj - (long)pid.setpoint_offset - (long)pid.band;
+}
+
+void tegra_throttle_pid_alert(long tj_temp, long throttle_tj)
+{
+	mutex_lock(&pid_lock);
+
+	pid.setpoint = throttle_tj - (long)pid.setpoint_offset;
+	if (pid.enable && pid.get_temp && !pid.running &&
+	    (tj_temp >= pid.setpoint - (long)pid.band)) {
+		pid.running = true;
+		pid.activations++;
+		pid.temp = tj_temp;
+		pid.error = tj_temp - pid.setpoint;
+		pid.integral = 0;
+		pid.last_sample = ktime_get();
+		queue_delayed_work(system_freezable_wq, &pid_work, 0);
+	}
+
+	mutex_unlock(&pid_lock);
 }
 
 static int
@@ -143,31 +430,20 @@ tegra_throttle_set_cur_state(struct thermal_cooling_device *cdev,
 				unsigned long cur_state)
 {
 	struct balanced_throttle *bthrot = cdev->devdata;
-	int core_level;
-	int index;
 
 	mutex_lock(cpu_throttle_lock);
 	if (cur_state == 0) {
 		/* restore speed requested by governor */
-		if (bthrot->is_throttling) {
-			tegra_dvfs_core_cap_enable(false);
-			bthrot->is_throttling = false;
-		}
-
-		tegra_cpu_set_speed_cap(NULL);
+		bthrot->is_throttling = false;
 	} else {
-		if (!bthrot->is_throttling) {
-			tegra_dvfs_core_cap_enable(true);
-			bthrot->is_throttling = true;
-		}
-
+		bthrot->is_throttling = true;
 		bthrot->throttle_index = bthrot->throt_tab_size - cur_state;
-		index = bthrot->throttle_index;
-		core_level = bthrot->throt_tab[index].core_cap_level;
-		tegra_dvfs_core_cap_level_set(core_level);
-
-		tegra_cpu_set_speed_cap(NULL);
 	}
+	perflog_record(PERFLOG_THROTTLE, cur_state, bthrot->throt_tab_size);
+
+	/* core cap is shared with other throttles and the PID controller */
+	throttle_core_cap_update();
+	tegra_cpu_set_speed_cap(NULL);
 
 	mutex_unlock(cpu_throttle_lock);
 
@@ -241,7 +517,60 @@ static const struct file_operations table_fops = {
 	.release	= single_release,
 };
 
+static int pid_show(struct seq_file *s, void *data)
+{
+	mutex_lock(&pid_lock);
+	if (pid.running)
+		pid_stats_update(ktime_get());
+
+	seq_printf(s, "running:      %d\n", pid.running);
+	seq_printf(s, "temp:         %ld mC\n", pid.temp);
+	seq_printf(s, "setpoint:     %ld mC\n", pid.setpoint);
+	seq_printf(s, "error:        %ld mC\n", pid.error);
+	seq_printf(s, "integral:     %ld\n", pid.integral);
+	seq_printf(s, "derivative:   %ld\n", pid.derivative);
+	seq_printf(s, "output:       %d / %d\n", pid.output, PID_OUTPUT_MAX);
+	seq_printf(s, "cpu_cap:      %u kHz\n", pid.cpu_cap);
+	seq_printf(s, "core_cap:     %d mV\n", pid.core_cap);
+	seq_printf(s, "activations:  %u\n", pid.activations);
+	seq_printf(s, "throttled_ms: %llu\n", pid.throttled_us / 1000);
+	seq_printf(s, "full_ms:      %llu\n", pid.full_us / 1000);
+	mutex_unlock(&pid_lock);
+
+	return 0;
+}
+
+static int pid_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pid_show, inode->i_private);
+}
+
+static const struct file_operations pid_fops = {
+	.open		= pid_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct dentry *throttle_debugfs_root;
+
+static void pid_debugfs_init(void)
+{
+	struct dentry *d = throttle_debugfs_root;
+
+	if (!d)
+		return;
+
+	debugfs_create_file("pid", 0444, d, NULL, &pid_fops);
+	debugfs_create_u32("pid_enable", 0644, d, &pid.enable);
+	debugfs_create_u32("pid_kp", 0644, d, &pid.kp);
+	debugfs_create_u32("pid_ki", 0644, d, &pid.ki);
+	debugfs_create_u32("pid_kd", 0644, d, &pid.kd);
+	debugfs_create_u32("pid_period_ms", 0644, d, &pid.period_ms);
+	debugfs_create_u32("pid_setpoint_offset", 0644, d,
+			   &pid.setpoint_offset);
+	debugfs_create_u32("pid_band", 0644, d, &pid.band);
+}
 #endif /* CONFIG_DEBUG_FS */
 
 
@@ -288,12 +617,18 @@ int __init tegra_throttle_init(struct mutex *cpu_lock)
 	cpu_throttle_lock = cpu_lock;
 #ifdef CONFIG_DEBUG_FS
 	throttle_debugfs_root = debugfs_create_dir("tegra_throttle", 0);
+	pid_debugfs_init();
 #endif
 	return 0;
 }
 
 void tegra_throttle_exit(void)
 {
+	mutex_lock(&pid_lock);
+	pid.running = false;
+	mutex_unlock(&pid_lock);
+	cancel_delayed_work_sync(&pid_work);
+
 #ifdef CONFIG_DEBUG_FS
 	debugfs_remove_recursive(throttle_debugfs_root);
 #endif
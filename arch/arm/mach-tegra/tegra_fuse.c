@@ -106,6 +106,11 @@ void tegra_fuse_writel(u32 value, unsigned long offset)
 	tegra_apb_writel(value, TEGRA_FUSE_BASE + offset);
 }
 
+void tegra_fuse_read_range(unsigned long offset, u32 *buf, unsigned int count)
+{
+	tegra_apb_read_range(TEGRA_FUSE_BASE + offset, buf, count);
+}
+
 static inline bool get_spare_fuse(int bit)
 {
 	return tegra_fuse_readl(FUSE_SPARE_BIT + bit * 4);
@@ -168,7 +173,7 @@ EXPORT_SYMBOL(tegra_fuse_get_tsensor_calibration_data);
 
 int tegra_fuse_get_tsensor_spare_bits(u32 *spare_bits)
 {
-	u32 value;
+	u32 value[NUM_TSENSOR_SPARE_BITS];
 	int i;
 
 	BUG_ON(NUM_TSENSOR_SPARE_BITS > (sizeof(u32) * 8));
@@ -176,10 +181,10 @@ int tegra_fuse_get_tsensor_spare_bits(u32 *spare_bits)
 		return -ENOMEM;
 	*spare_bits = 0;
 	/* spare bits 0-27 */
+	tegra_fuse_read_range(FUSE_SPARE_BIT_0_0, value,
+			      NUM_TSENSOR_SPARE_BITS);
 	for (i = 0; i < NUM_TSENSOR_SPARE_BITS; i++) {
-		value = tegra_fuse_readl(FUSE_SPARE_BIT_0_0 +
-			(i << 2));
-		if (value)
+		if (value[i])
 			*spare_bits |= BIT(i);
 	}
 	return 0;
@@ -219,13 +224,14 @@ int tegra_get_age(void)
 unsigned long long tegra_chip_uid(void)
 {
 #if defined(CONFIG_ARCH_TEGRA_2x_SOC)
-	unsigned long long lo, hi;
+	u32 uid[2];
 
-	lo = tegra_fuse_readl(FUSE_UID_LOW);
-	hi = tegra_fuse_readl(FUSE_UID_HIGH);
-	return (hi << 32ull) | lo;
+	/* FUSE_UID_LOW and FUSE_UID_HIGH are adjacent */
+	tegra_fuse_read_range(FUSE_UID_LOW, uid, 2);
+	return ((unsigned long long)uid[1] << 32ull) | uid[0];
 #else
 	u64 uid = 0ull;
+	u32 ids[(FUSE_Y_COORDINATE - FUSE_VENDOR_CODE) / 4 + 1];
 	u32 reg;
 	u32 cid;
 	u32 vendor;
@@ -276,13 +282,17 @@ unsigned long long tegra_chip_uid(void)
 		break;
 	}
 
-	vendor = tegra_fuse_readl(FUSE_VENDOR_CODE) & FUSE_VENDOR_CODE_MASK;
-	fab = tegra_fuse_readl(FUSE_FAB_CODE) & FUSE_FAB_CODE_MASK;
+	/* FUSE_VENDOR_CODE through FUSE_Y_COORDINATE are adjacent */
+	tegra_fuse_read_range(FUSE_VENDOR_CODE, ids, ARRAY_SIZE(ids));
+#define FUSE_ID(reg)	ids[((reg) - FUSE_VENDOR_CODE) / 4]
+
+	vendor = FUSE_ID(FUSE_VENDOR_CODE) & FUSE_VENDOR_CODE_MASK;
+	fab = FUSE_ID(FUSE_FAB_CODE) & FUSE_FAB_CODE_MASK;
 
 	/* Lot code must be re-encoded from a 5 digit base-36 'BCD' number
 	   to a binary number. */
 	lot = 0;
-	reg = tegra_fuse_readl(FUSE_LOT_CODE_0) << 2;
+	reg = FUSE_ID(FUSE_LOT_CODE_0) << 2;
 
 	for (i = 0; i < 5; ++i) {
 		u32 digit = (reg & 0xFC000000) >> 26;
@@ -292,9 +302,10 @@ unsigned long long tegra_chip_uid(void)
 		reg <<= 6;
 	}
 
-	wafer = tegra_fuse_readl(FUSE_WAFER_ID) & FUSE_WAFER_ID_MASK;
-	x = tegra_fuse_readl(FUSE_X_COORDINATE) & FUSE_X_COORDINATE_MASK;
-	y = tegra_fuse_readl(FUSE_Y_COORDINATE) & FUSE_Y_COORDINATE_MASK;
+	wafer = FUSE_ID(FUSE_WAFER_ID) & FUSE_WAFER_ID_MASK;
+	x = FUSE_ID(FUSE_X_COORDINATE) & FUSE_X_COORDINATE_MASK;
+	y = FUSE_ID(FUSE_Y_COORDINATE) & FUSE_Y_COORDINATE_MASK;
+#undef FUSE_ID
 
 	uid = ((unsigned long long)cid  << 60ull)
 	    | ((unsigned long long)vendor << 56ull)
@@ -0,0 +1,318 @@
+/*
+ * arch/arm/mach-tegra/tegra_input_boost.c
+ *
+ * Time-limited CPU, EMC and 3D clock floors on user input
+ *
+ * Copyright (c) 2012, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/err.h>
+#include <linux/clk.h>
+#include <linux/input.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/nvhost.h>
+
+#include <mach/clk.h>
+
+/*
+ * The first frame after a touch or key press is rendered while cpu, emc and
+ * 3d clocks are still at idle rates. This handler watches input events and
+ * applies a floor on all three for boost_duration ms. Events arriving while a
+ * boost is active only re-arm the timeout once half of it has elapsed, so the
+ * input path itself stays cheap.
+ */
+
+static bool enable = true;
+module_param(enable, bool, 0644);
+
+static unsigned int boost_cpu_freq = 760000;	/* kHz */
+module_param(boost_cpu_freq, uint, 0644);
+
+static unsigned long boost_emc_rate = 437000000; /* Hz */
+module_param(boost_emc_rate, ulong, 0644);
+
+static bool boost_3d = true;
+module_param(boost_3d, bool, 0644);
+
+static unsigned int boost_duration = 100;	/* msec */
+module_param(boost_duration, uint, 0644);
+
+static struct clk *emc_clk;
+static struct workqueue_struct *boost_wq;
+static struct work_struct boost_on_work;
+static struct delayed_work boost_off_work;
+static DEFINE_MUTEX(boost_lock);
+static DEFINE_SPINLOCK(boost_event_lock);
+
+static bool boost_active;		/* protected by boost_event_lock */
+static unsigned long boost_armed_at;	/* protected by boost_event_lock */
+static bool boost_floors_applied;	/* protected by boost_lock */
+static ktime_t boost_start;
+
+static struct {
+	u32 events;
+	u32 boosts;
+	u32 rearms;
+	u32 filtered;
+	u64 boosted_us;
+} boost_stats;
+
+static void boost_on_work_func(struct work_struct *work)
+{
+	unsigned int duration = boost_duration;
+
+	mutex_lock(&boost_lock);
+	tegra_dvfs_batch_begin();
+
+	if (!boost_floors_applied) {
+		tegra_cpu_boost_floor_set(boost_cpu_freq);
+		if (emc_clk && boost_emc_rate) {
+			tegra_dvfs_batch_prepare(emc_clk, boost_emc_rate);
+			clk_set_rate(emc_clk, boost_emc_rate);
+			clk_enable(emc_clk);
+		}
+		boost_floors_applied = true;
+		boost_start = ktime_get();
+		boost_stats.boosts++;
+	} else {
+		boost_stats.rearms++;
+	}
+
+	if (boost_3d)
+		nvhost_scale3d_boost(duration);
+
+	tegra_dvfs_batch_end();
+
+	cancel_delayed_work(&boost_off_work);
+	queue_delayed_work(boost_wq, &boost_off_work,
+			   msecs_to_jiffies(duration));
+
+	mutex_unlock(&boost_lock);
+}
+
+static void boost_off_work_func(struct work_struct *work)
+{
+	unsigned long flags;
+
+	mutex_lock(&boost_lock);
+
+	if (boost_floors_applied) {
+		tegra_dvfs_batch_begin();
+		tegra_cpu_boost_floor_set(0);
+		if (emc_clk && boost_emc_rate)
+			clk_disable(emc_clk);
+		tegra_dvfs_batch_end();
+		boost_floors_applied = false;
+		boost_stats.boosted_us +=
+			ktime_us_delta(ktime_get(), boost_start);
+	}
+
+	spin_lock_irqsave(&boost_event_lock, flags);
+	boost_active = false;
+	spin_unlock_irqrestore(&boost_event_lock, flags);
+
+	mutex_unlock(&boost_lock);
+}
+
+static void boost_input_event(struct input_handle *handle, unsigned int type,
+			      unsigned int code, int value)
+{
+	unsigned long flags;
+	unsigned long now = jiffies;
+	bool arm = false;
+
+	if (!enable || type == EV_SYN)
+		return;
+
+	spin_lock_irqsave(&boost_event_lock, flags);
+
+	boost_stats.events++;
+	if (!boost_active || time_after_eq(now, boost_armed_at +
+				msecs_to_jiffies(boost_duration) / 2)) {
+		boost_active = true;
+		boost_armed_at = now;
+		arm = true;
+	} else {
+		boost_stats.filtered++;
+	}
+
+	spin_unlock_irqrestore(&boost_event_lock, flags);
+
+	if (arm)
+		queue_work(boost_wq, &boost_on_work);
+}
+
+static int boost_input_connect(struct input_handler *handler,
+			       struct input_dev *dev,
+			       const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "tegra-input-boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void boost_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id boost_input_ids[] = {
+	/* multi-touch touchscreens and touchpads */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	/* single-touch touchscreens */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] = BIT_MASK(ABS_X) },
+	},
+	/* keyboards, including the Touch/Type Cover */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+		.keybit = { [BIT_WORD(KEY_A)] = BIT_MASK(KEY_A) },
+	},
+	{ },
+};
+
+static struct input_handler boost_input_handler = {
+	.event		= boost_input_event,
+	.connect	= boost_input_connect,
+	.disconnect	= boost_input_disconnect,
+	.name		= "tegra-input-boost",
+	.id_table	= boost_input_ids,
+};
+
+#ifdef CONFIG_DEBUG_FS
+
+static int boost_stats_show(struct seq_file *s, void *data)
+{
+	seq_printf(s, "events:     %u\n", boost_stats.events);
+	seq_printf(s, "boosts:     %u\n", boost_stats.boosts);
+	seq_printf(s, "rearms:     %u\n", boost_stats.rearms);
+	seq_printf(s, "filtered:   %u\n", boost_stats.filtered);
+	seq_printf(s, "boosted_ms: %llu\n", boost_stats.boosted_us / 1000);
+	seq_printf(s, "active:     %d\n", boost_floors_applied);
+	return 0;
+}
+
+static int boost_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boost_stats_show, inode->i_private);
+}
+
+static const struct file_operations boost_stats_fops = {
+	.open		= boost_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_input_boost_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("input_boost", S_IRUGO, NULL, NULL,
+				&boost_stats_fops);
+	if (!d)
+		return -ENOMEM;
+
+	return 0;
+}
+#else
+static inline int tegra_input_boost_debug_init(void)
+{ return 0; }
+#endif
+
+static int __init tegra_input_boost_init(void)
+{
+	int ret;
+
+	emc_clk = clk_get_sys("tegra_input_boost", "emc");
+	if (IS_ERR(emc_clk)) {
+		pr_warn("%s: no emc boost clock, boosting cpu/3d only\n",
+			__func__);
+		emc_clk = NULL;
+	}
+
+	boost_wq = alloc_workqueue("input_boost", WQ_HIGHPRI | WQ_UNBOUND, 1);
+	if (!boost_wq) {
+		ret = -ENOMEM;
+		goto err_clk;
+	}
+
+	INIT_WORK(&boost_on_work, boost_on_work_func);
+	INIT_DELAYED_WORK(&boost_off_work, boost_off_work_func);
+
+	ret = input_register_handler(&boost_input_handler);
+	if (ret) {
+		pr_err("%s: failed to register input handler\n", __func__);
+		goto err_wq;
+	}
+
+	tegra_input_boost_debug_init();
+	return 0;
+
+err_wq:
+	destroy_workqueue(boost_wq);
+err_clk:
+	if (emc_clk)
+		clk_put(emc_clk);
+	return ret;
+}
+late_initcall(tegra_input_boost_init);
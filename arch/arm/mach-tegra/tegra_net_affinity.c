@@ -0,0 +1,356 @@
+/*
+ * arch/arm/mach-tegra/tegra_net_affinity.c
+ *
+ * Network IRQ and RPS placement across the online Tegra3 cores
+ *
+ * Copyright (c) 2012, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqnr.h>
+#include <linux/kernel_stat.h>
+#include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "pm.h"
+
+/*
+ * Left alone, every SDIO, EHCI and USB ethernet interrupt on Tegra3 is
+ * taken by CPU0, and so is the NET_RX softirq it raises. This policy hands
+ * the matching IRQs out round robin over the online G cores, starting after
+ * CPU0 which already takes the timer and most other interrupts, and points
+ * RPS of the matching devices at all online cores so RFS can follow the
+ * consuming threads. It is rerun whenever cpuquiet or auto-hotplug brings a
+ * core up or down. On the LP cluster only CPU0 is online: everything goes
+ * back to CPU0 and RPS is turned off, so no IPIs are spent and no G core is
+ * woken on behalf of the network.
+ *
+ * RFS itself still needs net.core.rps_sock_flow_entries and the per queue
+ * rps_flow_cnt set from user space; this only keeps the RPS maps right.
+ */
+
+#define MAX_NET_IRQS		16
+#define NAME_TOKEN_LEN		32
+#define REBALANCE_DELAY_MS	20
+
+static bool enable = true;
+static char irq_names[128] = "ehci,wlan,mmc1,eth";
+static char dev_names[64] = "wlan,eth,usb,rndis";
+
+static DEFINE_MUTEX(net_affinity_lock);
+static void net_affinity_rebalance(struct work_struct *work);
+static DECLARE_DELAYED_WORK(rebalance_work, net_affinity_rebalance);
+
+/* protected by net_affinity_lock */
+static unsigned int net_irqs[MAX_NET_IRQS];
+static int net_irq_cpu[MAX_NET_IRQS];
+static int nr_net_irqs;
+static struct {
+	u32 rebalances;
+	u32 irq_moves;
+	u32 irq_errors;
+	u32 rps_updates;
+	u32 lp_rebalances;
+} stats;
+
+static void net_affinity_kick(void)
+{
+	schedule_delayed_work(&rebalance_work,
+			      msecs_to_jiffies(REBALANCE_DELAY_MS));
+}
+
+static int param_set_enable(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (!ret)
+		net_affinity_kick();
+	return ret;
+}
+
+static struct kernel_param_ops enable_ops = {
+	.set = param_set_enable,
+	.get = param_get_bool,
+};
+module_param_cb(enable, &enable_ops, &enable, 0644);
+
+static int param_set_names(const char *val, const struct kernel_param *kp)
+{
+	int ret;
+
+	mutex_lock(&net_affinity_lock);
+	ret = param_set_copystring(val, kp);
+	mutex_unlock(&net_affinity_lock);
+	if (!ret)
+		net_affinity_kick();
+	return ret;
+}
+
+static struct kernel_param_ops names_ops = {
+	.set = param_set_names,
+	.get = param_get_string,
+};
+
+static struct kparam_string irq_names_kps = {
+	.maxlen = sizeof(irq_names),
+	.string = irq_names,
+};
+module_param_cb(irq_names, &names_ops, &irq_names_kps, 0644);
+
+static struct kparam_string dev_names_kps = {
+	.maxlen = sizeof(dev_names),
+	.string = dev_names,
+};
+module_param_cb(dev_names, &names_ops, &dev_names_kps, 0644);
+
+/* Does name contain any of the comma separated tokens of list? */
+static bool name_match(const char *name, const char *list)
+{
+	char tok[NAME_TOKEN_LEN];
+	const char *end;
+	size_t len;
+
+	while (*list) {
+		end = strchr(list, ',');
+		if (!end)
+			end = list + strlen(list);
+		len = min_t(size_t, end - list, sizeof(tok) - 1);
+		memcpy(tok, list, len);
+		tok[len] = '\0';
+		if (len && strstr(name, tok))
+			return true;
+		list = *end ? end + 1 : end;
+	}
+	return false;
+}
+
+static bool irq_is_network(unsigned int irq, struct irq_desc *desc)
+{
+	struct irqaction *action;
+	unsigned long flags;
+	bool match = false;
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	for (action = desc->action; action && !match; action = action->next)
+		match = action->name && name_match(action->name, irq_names);
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+	return match;
+}
+
+static void net_affinity_place_irqs(const struct cpumask *cpus)
+{
+	struct irq_desc *desc;
+	unsigned int irq;
+	int cpu, first, n = 0;
+
+	/* Start after CPU0 when there is another core to go to */
+	first = cpumask_next(0, cpus);
+	if (first >= nr_cpu_ids)
+		first = cpumask_first(cpus);
+	cpu = first;
+
+	for_each_irq_desc(irq, desc) {
+		if (n >= MAX_NET_IRQS)
+			break;
+		if (!irq_is_network(irq, desc))
+			continue;
+
+		if (irq_set_affinity(irq, cpumask_of(cpu))) {
+			stats.irq_errors++;
+			continue;
+		}
+		if (n >= nr_net_irqs || net_irqs[n] != irq ||
+		    net_irq_cpu[n] != cpu)
+			stats.irq_moves++;
+		net_irqs[n] = irq;
+		net_irq_cpu[n] = cpu;
+		n++;
+
+		cpu = cpumask_next(cpu, cpus);
+		if (cpu >= nr_cpu_ids)
+			cpu = first;
+	}
+	nr_net_irqs = n;
+}
+
+static void net_affinity_place_rps(const struct cpumask *cpus)
+{
+	struct net_device *dev;
+
+	rtnl_lock();
+	for_each_netdev(&init_net, dev) {
+		if (!name_match(dev->name, dev_names))
+			continue;
+		/* An empty mask turns RPS off */
+		if (!netif_set_rps_cpus(dev, cpus))
+			stats.rps_updates++;
+	}
+	rtnl_unlock();
+}
+
+static void net_affinity_rebalance(struct work_struct *work)
+{
+	cpumask_var_t cpus, rps;
+
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+		return;
+	if (!zalloc_cpumask_var(&rps, GFP_KERNEL)) {
+		free_cpumask_var(cpus);
+		return;
+	}
+
+	get_online_cpus();
+	mutex_lock(&net_affinity_lock);
+
+	/* The LP core is CPU0: nothing to spread, nothing to steer */
+	if (is_lp_cluster() || !enable) {
+		cpumask_set_cpu(0, cpus);
+		if (is_lp_cluster())
+			stats.lp_rebalances++;
+	} else {
+		cpumask_copy(cpus, cpu_online_mask);
+		if (cpumask_weight(cpus) > 1)
+			cpumask_copy(rps, cpus);
+	}
+
+	net_affinity_place_irqs(cpus);
+	net_affinity_place_rps(rps);
+	stats.rebalances++;
+
+	mutex_unlock(&net_affinity_lock);
+	put_online_cpus();
+
+	free_cpumask_var(rps);
+	free_cpumask_var(cpus);
+}
+
+static int net_affinity_cpu_notify(struct notifier_block *nb,
+				   unsigned long action, void *hcpu)
+{
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DEAD:
+		net_affinity_kick();
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block net_affinity_cpu_nb = {
+	.notifier_call = net_affinity_cpu_notify,
+};
+
+static int net_affinity_netdev_notify(struct notifier_block *nb,
+				      unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+
+	/* Devices come with their IRQs, both usually after boot */
+	if ((event == NETDEV_REGISTER || event == NETDEV_UP) &&
+	    name_match(dev->name, dev_names))
+		net_affinity_kick();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block net_affinity_netdev_nb = {
+	.notifier_call = net_affinity_netdev_notify,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int net_affinity_show(struct seq_file *s, void *data)
+{
+	struct softnet_data *sd;
+	cputime64_t softirq;
+	int cpu, i;
+
+	mutex_lock(&net_affinity_lock);
+	seq_printf(s, "enable: %d  cluster: %s\n", enable,
+		   is_lp_cluster() ? "LP" : "G");
+	seq_printf(s, "rebalances: %u  lp: %u  irq moves: %u  irq errors: %u"
+		   "  rps updates: %u\n", stats.rebalances, stats.lp_rebalances,
+		   stats.irq_moves, stats.irq_errors, stats.rps_updates);
+
+	seq_printf(s, "\n%-5s %-6s", "irq", "cpu");
+	for_each_possible_cpu(cpu)
+		seq_printf(s, " %10s%d", "count", cpu);
+	seq_printf(s, "  name\n");
+	for (i = 0; i < nr_net_irqs; i++) {
+		struct irq_desc *desc = irq_to_desc(net_irqs[i]);
+
+		seq_printf(s, "%-5u %-6d", net_irqs[i], net_irq_cpu[i]);
+		for_each_possible_cpu(cpu)
+			seq_printf(s, " %11u", kstat_irqs_cpu(net_irqs[i], cpu));
+		seq_printf(s, "  %s\n", desc && desc->action &&
+			   desc->action->name ? desc->action->name : "-");
+	}
+	mutex_unlock(&net_affinity_lock);
+
+	seq_printf(s, "\n%-4s %-6s %12s %10s %10s %10s %10s %8s %8s\n",
+		   "cpu", "online", "softirq_ms", "net_rx", "net_tx",
+		   "processed", "rps_rcvd", "squeeze", "dropped");
+	for_each_possible_cpu(cpu) {
+		sd = &per_cpu(softnet_data, cpu);
+		softirq = kstat_cpu(cpu).cpustat.softirq;
+		seq_printf(s, "%-4d %-6d %12llu %10u %10u %10u %10u %8u %8u\n",
+			   cpu, cpu_online(cpu),
+			   (unsigned long long)cputime64_to_clock_t(softirq) *
+			   MSEC_PER_SEC / USER_HZ,
+			   kstat_softirqs_cpu(NET_RX_SOFTIRQ, cpu),
+			   kstat_softirqs_cpu(NET_TX_SOFTIRQ, cpu),
+			   sd->processed, sd->received_rps, sd->time_squeeze,
+			   sd->dropped);
+	}
+	return 0;
+}
+
+static int net_affinity_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, net_affinity_show, inode->i_private);
+}
+
+static const struct file_operations net_affinity_fops = {
+	.open		= net_affinity_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+static int __init tegra_net_affinity_init(void)
+{
+	register_hotcpu_notifier(&net_affinity_cpu_nb);
+	register_netdevice_notifier(&net_affinity_netdev_nb);
+
+#ifdef CONFIG_DEBUG_FS
+	if (!debugfs_create_file("net_affinity", S_IRUGO, NULL, NULL,
+				 &net_affinity_fops))
+		pr_warn("%s: failed to create debugfs entry\n", __func__);
+#endif
+
+	net_affinity_kick();
+	return 0;
+}
+late_initcall(tegra_net_affinity_init);
@@ -32,6 +32,7 @@
 #include <linux/slab.h>
 #include <linux/wakelock.h>
 #include <linux/pm_qos_params.h>
+#include <linux/lat_hist.h>
 #include <mach/tegra_usb_modem_power.h>
 
 #define BOOST_CPU_FREQ_MIN	1200000
@@ -51,6 +52,8 @@ struct tegra_usb_modem {
 	unsigned int pid;	/* modem product id */
 	struct usb_device *udev;	/* modem usb device */
 	struct usb_device *parent;	/* parent device */
+	spinlock_t parent_lock;		/* protects parent for the wake irq */
+	ktime_t wake_start;		/* time of the last remote wakeup */
 	struct usb_interface *intf;	/* first modem usb interface */
 	struct workqueue_struct *wq;	/* modem workqueue */
 	struct delayed_work recovery_work;	/* modem recovery work */
@@ -71,6 +74,9 @@ static struct mutex hc_lock;
 static const struct platform_device *hc_device;
 static const struct tegra_usb_platform_data *hc_pdata;
 
+/* remote wakeup irq to modem interface resumed */
+DEFINE_LAT_HIST(modem_wake_hist, "usb_modem_remote_wake");
+
 /* supported modems */
 static const struct usb_device_id modem_list[] = {
 	{USB_DEVICE(0x1983, 0x0310),	/* Icera 450 rev1 */
@@ -104,6 +110,26 @@ static void cpu_freq_boost(struct work_struct *ws)
 			      msecs_to_jiffies(BOOST_CPU_FREQ_TIMEOUT));
 }
 
+static irqreturn_t tegra_usb_modem_wake_irq(int irq, void *data)
+{
+	struct tegra_usb_modem *modem = (struct tegra_usb_modem *)data;
+	unsigned long flags;
+
+	modem->wake_start = lat_hist_start();
+
+	/*
+	 * Start bringing the host controller, PHY and root hub out of
+	 * suspend right away, in parallel with the irq thread waking up
+	 * and resuming the modem itself.
+	 */
+	spin_lock_irqsave(&modem->parent_lock, flags);
+	if (modem->parent && !modem->system_suspend)
+		pm_request_resume(&modem->parent->dev);
+	spin_unlock_irqrestore(&modem->parent_lock, flags);
+
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t tegra_usb_modem_wake_thread(int irq, void *data)
 {
 	struct tegra_usb_modem *modem = (struct tegra_usb_modem *)data;
@@ -117,8 +143,11 @@ static irqreturn_t tegra_usb_modem_wake_thread(int irq, void *data)
 					  WAKELOCK_TIMEOUT_FOR_REMOTE_WAKE);
 
 			usb_lock_device(modem->udev);
-			if (usb_autopm_get_interface(modem->intf) == 0)
+			if (usb_autopm_get_interface(modem->intf) == 0) {
+				lat_hist_add_since(&modem_wake_hist,
+						   modem->wake_start);
 				usb_autopm_put_interface_async(modem->intf);
+			}
 			usb_unlock_device(modem->udev);
 		}
 #ifdef CONFIG_PM
@@ -181,6 +210,8 @@ static void device_add_handler(struct tegra_usb_modem *modem,
 	const struct usb_device_id *id = usb_match_id(intf, modem_list);
 
 	if (id) {
+		unsigned long flags;
+
 		/* hold wakelock to ensure ril has enough time to restart */
 		wake_lock_timeout(&modem->wake_lock,
 				  WAKELOCK_TIMEOUT_FOR_USB_ENUM);
@@ -190,7 +221,9 @@ static void device_add_handler(struct tegra_usb_modem *modem,
 
 		mutex_lock(&modem->lock);
 		modem->udev = udev;
-		modem->parent = udev->parent;
+		spin_lock_irqsave(&modem->parent_lock, flags);
+		modem->parent = usb_get_dev(udev->parent);
+		spin_unlock_irqrestore(&modem->parent_lock, flags);
 		modem->intf = intf;
 		modem->vid = desc->idVendor;
 		modem->pid = desc->idProduct;
@@ -219,6 +252,9 @@ static void device_remove_handler(struct tegra_usb_modem *modem,
 	const struct usb_device_descriptor *desc = &udev->descriptor;
 
 	if (desc->idVendor == modem->vid && desc->idProduct == modem->pid) {
+		struct usb_device *parent;
+		unsigned long flags;
+
 		pr_info("Remove device %d <%s %s>\n", udev->devnum,
 			udev->manufacturer, udev->product);
 
@@ -226,8 +262,14 @@ static void device_remove_handler(struct tegra_usb_modem *modem,
 		modem->udev = NULL;
 		modem->intf = NULL;
 		modem->vid = 0;
+		spin_lock_irqsave(&modem->parent_lock, flags);
+		parent = modem->parent;
+		modem->parent = NULL;
+		spin_unlock_irqrestore(&modem->parent_lock, flags);
 		mutex_unlock(&modem->lock);
 
+		usb_put_dev(parent);
+
 		if (modem->capability & TEGRA_MODEM_RECOVERY)
 			queue_delayed_work(modem->wq,
 					   &modem->recovery_work, HZ * 10);
@@ -296,6 +338,7 @@ static int mdm_pm_notifier(struct notifier_block *notifier,
 }
 
 static int mdm_request_wakeable_irq(struct tegra_usb_modem *modem,
+				    irq_handler_t handler,
 				    irq_handler_t thread_fn,
 				    unsigned int irq_gpio,
 				    unsigned long irq_flags,
@@ -311,7 +354,7 @@ static int mdm_request_wakeable_irq(struct tegra_usb_modem *modem,
 	*irq = gpio_to_irq(irq_gpio);
 
 	/* request threaded irq for GPIO */
-	ret = request_threaded_irq(*irq, NULL, thread_fn, irq_flags, label,
+	ret = request_threaded_irq(*irq, handler, thread_fn, irq_flags, label,
 				   modem);
 	if (ret)
 		return ret;
@@ -438,6 +481,7 @@ static int mdm_init(struct tegra_usb_modem *modem, struct platform_device *pdev)
 	modem->sysfs_file_created = 1;
 
 	mutex_init(&(modem->lock));
+	spin_lock_init(&modem->parent_lock);
 	wake_lock_init(&modem->wake_lock, WAKE_LOCK_SUSPEND, "mdm_lock");
 
 	/* create work queue platform_driver_registe */
@@ -452,6 +496,7 @@ static int mdm_init(struct tegra_usb_modem *modem, struct platform_device *pdev)
 
 	/* request remote wakeup irq from platform data */
 	ret = mdm_request_wakeable_irq(modem,
+				       tegra_usb_modem_wake_irq,
 				       tegra_usb_modem_wake_thread,
 				       pdata->wake_gpio,
 				       pdata->wake_irq_flags,
@@ -462,7 +507,7 @@ static int mdm_init(struct tegra_usb_modem *modem, struct platform_device *pdev)
 	}
 
 	/* request boot irq from platform data */
-	ret = mdm_request_wakeable_irq(modem,
+	ret = mdm_request_wakeable_irq(modem, NULL,
 				       tegra_usb_modem_boot_thread,
 				       pdata->boot_gpio,
 				       pdata->boot_irq_flags,
@@ -478,6 +523,8 @@ static int mdm_init(struct tegra_usb_modem *modem, struct platform_device *pdev)
 	usb_register_notify(&modem->usb_notifier);
 	register_pm_notifier(&modem->pm_notifier);
 
+	lat_hist_register(&modem_wake_hist);
+
 	return ret;
 error:
 	if (modem->sysfs_file_created)
@@ -529,6 +576,7 @@ static int __exit tegra_usb_modem_remove(struct platform_device *pdev)
 {
 	struct tegra_usb_modem *modem = platform_get_drvdata(pdev);
 
+	lat_hist_unregister(&modem_wake_hist);
 	unregister_pm_notifier(&modem->pm_notifier);
 	usb_unregister_notify(&modem->usb_notifier);
 
@@ -19,6 +19,9 @@
 #include <linux/init.h>
 #include <linux/spinlock.h>
 #include <linux/io.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched.h>
 
 #include <asm/cacheflush.h>
 #include <asm/hardware/cache-l2x0.h>
@@ -33,6 +36,58 @@ static u32 l2x0_cache_id;
 static unsigned int l2x0_sets;
 static unsigned int l2x0_ways;
 
+/*
+ * Ranges this large are cleaned or flushed by way instead of by line.
+ * That takes about the same time whatever the range, so it only pays off
+ * once walking the lines would take longer.
+ */
+static uint32_t l2x0_range_threshold;
+
+/* What the maintenance operations cost, see l2x0_stats_show() */
+struct l2x0_op_stats {
+	u32 calls;		/* by line */
+	u32 full;		/* by way, for ranges over the threshold */
+	u64 bytes;		/* in the by line ranges */
+	u64 ns;			/* spent in both kinds */
+	u32 max_hold_ns;	/* longest the lock was held at a time */
+};
+
+enum { L2X0_INV, L2X0_CLEAN, L2X0_FLUSH, L2X0_NR_OPS };
+static struct l2x0_op_stats l2x0_stats[L2X0_NR_OPS];
+
+static inline u64 l2x0_op_lock(unsigned long *flags)
+{
+	spin_lock_irqsave(&l2x0_lock, *flags);
+	return local_clock();
+}
+
+/* drops the lock taken at time start, accounting the hold to op */
+static inline void l2x0_op_unlock(unsigned long *flags, u64 start, int op)
+{
+	u32 held = local_clock() - start;
+
+	if (held > l2x0_stats[op].max_hold_ns)
+		l2x0_stats[op].max_hold_ns = held;
+	spin_unlock_irqrestore(&l2x0_lock, *flags);
+}
+
+/*
+ * One op of len bytes, or by way if !len, that began at time start is
+ * done. Called with l2x0_lock held.
+ */
+static inline void l2x0_account(int op, unsigned long len, u64 start)
+{
+	struct l2x0_op_stats *st = &l2x0_stats[op];
+
+	if (len) {
+		st->calls++;
+		st->bytes += len;
+	} else {
+		st->full++;
+	}
+	st->ns += local_clock() - start;
+}
+
 static inline bool is_pl310_rev(int rev)
 {
 	return (l2x0_cache_id &
@@ -132,22 +187,49 @@ static void l2x0_cache_sync(void)
 }
 
 #ifdef CONFIG_PL310_ERRATA_727915
-static void l2x0_for_each_set_way(void __iomem *reg)
+static void l2x0_for_each_set_way(void __iomem *reg, int op, u64 start)
 {
 	int set;
 	int way;
 	unsigned long flags;
+	u64 t;
 
 	for (way = 0; way < l2x0_ways; way++) {
-		spin_lock_irqsave(&l2x0_lock, flags);
+		t = l2x0_op_lock(&flags);
 		for (set = 0; set < l2x0_sets; set++)
 			writel_relaxed((way << 28) | (set << 5), reg);
 		cache_sync();
-		spin_unlock_irqrestore(&l2x0_lock, flags);
+		if (way == l2x0_ways - 1)
+			l2x0_account(op, 0, start);
+		l2x0_op_unlock(&flags, t, op);
 	}
 }
 #endif
 
+/*
+ * Clean or flush the ways one at a time, dropping the lock in between, so
+ * that line operations of the other CPUs wait for one way only instead
+ * of the whole cache.
+ */
+static void l2x0_for_each_way(void __iomem *reg, int op, u64 start)
+{
+	int way;
+	unsigned long flags;
+	u64 t;
+
+	for (way = 0; way < l2x0_ways; way++) {
+		t = l2x0_op_lock(&flags);
+		debug_writel(0x03);
+		writel_relaxed(1 << way, reg);
+		cache_wait_way(reg, 1 << way);
+		cache_sync();
+		debug_writel(0x00);
+		if (way == l2x0_ways - 1)
+			l2x0_account(op, 0, start);
+		l2x0_op_unlock(&flags, t, op);
+	}
+}
+
 static void __l2x0_flush_all(void)
 {
 	debug_writel(0x03);
@@ -159,40 +241,34 @@ static void __l2x0_flush_all(void)
 
 static void l2x0_flush_all(void)
 {
-	unsigned long flags;
+	u64 start = local_clock();
 
 #ifdef CONFIG_PL310_ERRATA_727915
 	if (is_pl310_rev(REV_PL310_R2P0) || is_pl310_rev(REV_PL310_R3P1_50)) {
-		l2x0_for_each_set_way(l2x0_base + L2X0_CLEAN_INV_LINE_IDX);
+		l2x0_for_each_set_way(l2x0_base + L2X0_CLEAN_INV_LINE_IDX,
+				      L2X0_FLUSH, start);
 		return;
 	}
 #endif
 
-	/* clean all ways */
-	spin_lock_irqsave(&l2x0_lock, flags);
-	__l2x0_flush_all();
-	spin_unlock_irqrestore(&l2x0_lock, flags);
+	/* clean and invalidate all ways */
+	l2x0_for_each_way(l2x0_base + L2X0_CLEAN_INV_WAY, L2X0_FLUSH, start);
 }
 
 static void l2x0_clean_all(void)
 {
-	unsigned long flags;
+	u64 start = local_clock();
 
 #ifdef CONFIG_PL310_ERRATA_727915
 	if (is_pl310_rev(REV_PL310_R2P0) || is_pl310_rev(REV_PL310_R3P1_50)) {
-		l2x0_for_each_set_way(l2x0_base + L2X0_CLEAN_LINE_IDX);
+		l2x0_for_each_set_way(l2x0_base + L2X0_CLEAN_LINE_IDX,
+				      L2X0_CLEAN, start);
 		return;
 	}
 #endif
 
 	/* clean all ways */
-	spin_lock_irqsave(&l2x0_lock, flags);
-	debug_writel(0x03);
-	writel_relaxed(l2x0_way_mask, l2x0_base + L2X0_CLEAN_WAY);
-	cache_wait_way(l2x0_base + L2X0_CLEAN_WAY, l2x0_way_mask);
-	cache_sync();
-	debug_writel(0x00);
-	spin_unlock_irqrestore(&l2x0_lock, flags);
+	l2x0_for_each_way(l2x0_base + L2X0_CLEAN_WAY, L2X0_CLEAN, start);
 }
 
 static void l2x0_inv_all(void)
@@ -209,12 +285,19 @@ static void l2x0_inv_all(void)
 	spin_unlock_irqrestore(&l2x0_lock, flags);
 }
 
+/*
+ * The range operations work in blocks of 4kB, dropping the lock after
+ * each. Invalidation has no by way variant that would leave the rest of
+ * the cache alone, so it always goes by line.
+ */
 static void l2x0_inv_range(unsigned long start, unsigned long end)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
+	unsigned long len = end - start;
+	u64 t0, t;
 
-	spin_lock_irqsave(&l2x0_lock, flags);
+	t0 = t = l2x0_op_lock(&flags);
 	if (start & (CACHE_LINE_SIZE - 1)) {
 		start &= ~(CACHE_LINE_SIZE - 1);
 		debug_writel(0x03);
@@ -239,26 +322,29 @@ static void l2x0_inv_range(unsigned long start, unsigned long end)
 		}
 
 		if (blk_end < end) {
-			spin_unlock_irqrestore(&l2x0_lock, flags);
-			spin_lock_irqsave(&l2x0_lock, flags);
+			l2x0_op_unlock(&flags, t, L2X0_INV);
+			t = l2x0_op_lock(&flags);
 		}
 	}
 	cache_wait(base + L2X0_INV_LINE_PA, 1);
 	cache_sync();
-	spin_unlock_irqrestore(&l2x0_lock, flags);
+	l2x0_account(L2X0_INV, len, t0);
+	l2x0_op_unlock(&flags, t, L2X0_INV);
 }
 
 static void l2x0_clean_range(unsigned long start, unsigned long end)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
+	unsigned long len = end - start;
+	u64 t0, t;
 
-	if ((end - start) >= l2x0_size) {
+	if (len >= l2x0_range_threshold) {
 		l2x0_clean_all();
 		return;
 	}
 
-	spin_lock_irqsave(&l2x0_lock, flags);
+	t0 = t = l2x0_op_lock(&flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
 		unsigned long blk_end = start + min(end - start, 4096UL);
@@ -269,26 +355,29 @@ static void l2x0_clean_range(unsigned long start, unsigned long end)
 		}
 
 		if (blk_end < end) {
-			spin_unlock_irqrestore(&l2x0_lock, flags);
-			spin_lock_irqsave(&l2x0_lock, flags);
+			l2x0_op_unlock(&flags, t, L2X0_CLEAN);
+			t = l2x0_op_lock(&flags);
 		}
 	}
 	cache_wait(base + L2X0_CLEAN_LINE_PA, 1);
 	cache_sync();
-	spin_unlock_irqrestore(&l2x0_lock, flags);
+	l2x0_account(L2X0_CLEAN, len, t0);
+	l2x0_op_unlock(&flags, t, L2X0_CLEAN);
 }
 
 static void l2x0_flush_range(unsigned long start, unsigned long end)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
+	unsigned long len = end - start;
+	u64 t0, t;
 
-	if ((end - start) >= l2x0_size) {
+	if (len >= l2x0_range_threshold) {
 		l2x0_flush_all();
 		return;
 	}
 
-	spin_lock_irqsave(&l2x0_lock, flags);
+	t0 = t = l2x0_op_lock(&flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
 		unsigned long blk_end = start + min(end - start, 4096UL);
@@ -301,13 +390,14 @@ static void l2x0_flush_range(unsigned long start, unsigned long end)
 		debug_writel(0x00);
 
 		if (blk_end < end) {
-			spin_unlock_irqrestore(&l2x0_lock, flags);
-			spin_lock_irqsave(&l2x0_lock, flags);
+			l2x0_op_unlock(&flags, t, L2X0_FLUSH);
+			t = l2x0_op_lock(&flags);
 		}
 	}
 	cache_wait(base + L2X0_CLEAN_INV_LINE_PA, 1);
 	cache_sync();
-	spin_unlock_irqrestore(&l2x0_lock, flags);
+	l2x0_account(L2X0_FLUSH, len, t0);
+	l2x0_op_unlock(&flags, t, L2X0_FLUSH);
 }
 
 /* enables l2x0 after l2x0_disable, does not invalidate */
@@ -395,6 +485,7 @@ void l2x0_init(void __iomem *base, __u32 aux_val, __u32 aux_mask)
 	way_size = SZ_1K << (way_size + 3);
 	l2x0_size = l2x0_ways * way_size;
 	l2x0_sets = way_size / CACHE_LINE_SIZE;
+	l2x0_range_threshold = l2x0_size;
 
 	/*
 	 * Check if l2x0 controller is already enabled.
@@ -428,3 +519,75 @@ void l2x0_init(void __iomem *base, __u32 aux_val, __u32 aux_mask)
 	pr_info_once("l2x0: %d ways, CACHE_ID 0x%08x, AUX_CTRL 0x%08x, Cache size: %d B\n",
 			l2x0_ways, l2x0_cache_id, aux, l2x0_size);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int l2x0_stats_show(struct seq_file *s, void *data)
+{
+	static const char * const names[L2X0_NR_OPS] = {
+		[L2X0_INV]	= "inv",
+		[L2X0_CLEAN]	= "clean",
+		[L2X0_FLUSH]	= "flush",
+	};
+	struct l2x0_op_stats st;
+	unsigned long flags;
+	int op;
+
+	seq_printf(s, "%-6s %10s %10s %14s %14s %12s\n", "op", "by_line",
+		   "by_way", "line_bytes", "total_ns", "max_hold_ns");
+	for (op = 0; op < L2X0_NR_OPS; op++) {
+		spin_lock_irqsave(&l2x0_lock, flags);
+		st = l2x0_stats[op];
+		spin_unlock_irqrestore(&l2x0_lock, flags);
+
+		seq_printf(s, "%-6s %10u %10u %14llu %14llu %12u\n",
+			   names[op], st.calls, st.full, st.bytes, st.ns,
+			   st.max_hold_ns);
+	}
+	return 0;
+}
+
+static int l2x0_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, l2x0_stats_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t l2x0_stats_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&l2x0_lock, flags);
+	memset(l2x0_stats, 0, sizeof(l2x0_stats));
+	spin_unlock_irqrestore(&l2x0_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations l2x0_stats_fops = {
+	.open		= l2x0_stats_open,
+	.read		= seq_read,
+	.write		= l2x0_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init l2x0_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	if (!l2x0_base)
+		return 0;
+
+	dir = debugfs_create_dir("l2x0", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, dir, NULL,
+			    &l2x0_stats_fops);
+	debugfs_create_u32("range_threshold", S_IRUGO | S_IWUSR, dir,
+			   &l2x0_range_threshold);
+	return 0;
+}
+late_initcall(l2x0_debugfs_init);
+#endif
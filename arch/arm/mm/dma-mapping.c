@@ -18,6 +18,11 @@
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 #include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/bitmap.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/memory.h>
 #include <asm/highmem.h>
@@ -296,10 +301,208 @@ static void __dma_free_remap(void *cpu_addr, size_t size)
 	arm_vmregion_free(&consistent_head, c);
 }
 
+/*
+ * Remapping needs a vmregion and page table updates, which is slow from
+ * interrupt context and fails once lowmem is fragmented.  Allocations
+ * that cannot sleep are served from a buffer that is remapped once at
+ * boot instead, handed out in pages by a bitmap.
+ */
+#define DEFAULT_DMA_COHERENT_POOL_SIZE	SZ_256K
+
+struct dma_atomic_pool {
+	size_t size;
+	spinlock_t lock;
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+	void *vaddr;
+	struct page *page;
+
+	/* see atomic_pool_stats_show() */
+	unsigned long used;
+	unsigned long peak;
+	unsigned long allocs;
+	unsigned long fails;
+};
+
+static struct dma_atomic_pool atomic_pool = {
+	.size	= DEFAULT_DMA_COHERENT_POOL_SIZE,
+	.lock	= __SPIN_LOCK_UNLOCKED(atomic_pool.lock),
+};
+
+static int __init early_coherent_pool(char *p)
+{
+	atomic_pool.size = PAGE_ALIGN(memparse(p, &p));
+	return 0;
+}
+early_param("coherent_pool", early_coherent_pool);
+
+/* After consistent_init(), so the remap has page tables to go in */
+static int __init atomic_pool_init(void)
+{
+	struct dma_atomic_pool *pool = &atomic_pool;
+	unsigned long nr_pages = pool->size >> PAGE_SHIFT;
+	unsigned long *bitmap;
+	struct page *page;
+	void *ptr;
+
+	if (!nr_pages || arch_is_coherent())
+		return 0;
+
+	bitmap = kzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long), GFP_KERNEL);
+	if (!bitmap)
+		goto no_bitmap;
+
+	page = __dma_alloc_buffer(NULL, pool->size, GFP_KERNEL);
+	if (!page)
+		goto no_pages;
+
+	ptr = __dma_alloc_remap(page, pool->size, GFP_KERNEL,
+				pgprot_dmacoherent(pgprot_kernel));
+	if (!ptr)
+		goto no_remap;
+
+	pool->bitmap = bitmap;
+	pool->nr_pages = nr_pages;
+	pool->page = page;
+	pool->vaddr = ptr;
+	pr_info("DMA: preallocated %zu KiB pool for atomic coherent "
+		"allocations\n", pool->size / 1024);
+	return 0;
+
+no_remap:
+	__dma_free_buffer(page, pool->size);
+no_pages:
+	kfree(bitmap);
+no_bitmap:
+	pr_err("DMA: failed to allocate %zu KiB pool for atomic coherent "
+	       "allocations\n", pool->size / 1024);
+	return -ENOMEM;
+}
+postcore_initcall(atomic_pool_init);
+
+static bool __in_atomic_pool(void *start, size_t size)
+{
+	struct dma_atomic_pool *pool = &atomic_pool;
+	void *end = start + size;
+	void *pool_start = pool->vaddr;
+	void *pool_end = pool->vaddr + pool->size;
+
+	if (!pool->vaddr || start < pool_start || start >= pool_end)
+		return false;
+
+	if (end <= pool_end)
+		return true;
+
+	WARN(1, "Wrong coherent size(%p-%p) from atomic pool(%p-%p)\n",
+	     start, end - 1, pool_start, pool_end - 1);
+	return false;
+}
+
+/* size is page aligned; NULL when the pool is missing or full */
+static void *__alloc_from_pool(size_t size, struct page **ret_page)
+{
+	struct dma_atomic_pool *pool = &atomic_pool;
+	unsigned int count = size >> PAGE_SHIFT;
+	unsigned int align_mask;
+	unsigned long flags;
+	unsigned long pageno;
+	void *ptr = NULL;
+
+	if (!pool->vaddr)
+		return NULL;
+
+	/* same natural alignment as the remapped allocations, up to 1M */
+	align_mask = (1 << min(get_order(size), SECTION_SHIFT - PAGE_SHIFT)) - 1;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	pageno = bitmap_find_next_zero_area(pool->bitmap, pool->nr_pages,
+					    0, count, align_mask);
+	if (pageno < pool->nr_pages) {
+		bitmap_set(pool->bitmap, pageno, count);
+		ptr = pool->vaddr + PAGE_SIZE * pageno;
+		*ret_page = pool->page + pageno;
+		pool->allocs++;
+		pool->used += count;
+		if (pool->used > pool->peak)
+			pool->peak = pool->used;
+	} else {
+		pool->fails++;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	/* the buffer may be handed out again, so clear it like a fresh one */
+	if (ptr)
+		memset(ptr, 0, size);
+
+	return ptr;
+}
+
+static void __free_from_pool(void *start, size_t size)
+{
+	struct dma_atomic_pool *pool = &atomic_pool;
+	unsigned long pageno, count;
+	unsigned long flags;
+
+	pageno = (start - pool->vaddr) >> PAGE_SHIFT;
+	count = size >> PAGE_SHIFT;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	bitmap_clear(pool->bitmap, pageno, count);
+	pool->used -= count;
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int atomic_pool_stats_show(struct seq_file *s, void *data)
+{
+	struct dma_atomic_pool *pool = &atomic_pool;
+	struct dma_atomic_pool st;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	st = *pool;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	seq_printf(s, "size_kb:   %zu\n", st.size / 1024);
+	seq_printf(s, "used_kb:   %lu\n", st.used << (PAGE_SHIFT - 10));
+	seq_printf(s, "peak_kb:   %lu\n", st.peak << (PAGE_SHIFT - 10));
+	seq_printf(s, "allocs:    %lu\n", st.allocs);
+	/* atomic requests the pool was too full for */
+	seq_printf(s, "fails:     %lu\n", st.fails);
+	return 0;
+}
+
+static int atomic_pool_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, atomic_pool_stats_show, inode->i_private);
+}
+
+static const struct file_operations atomic_pool_stats_fops = {
+	.open		= atomic_pool_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init atomic_pool_debugfs_init(void)
+{
+	if (!atomic_pool.vaddr)
+		return 0;
+
+	debugfs_create_file("dma_atomic_pool", S_IRUGO, NULL, NULL,
+			    &atomic_pool_stats_fops);
+	return 0;
+}
+late_initcall(atomic_pool_debugfs_init);
+#endif
+
 #else	/* !CONFIG_MMU */
 
 #define __dma_alloc_remap(page, size, gfp, prot)	page_address(page)
 #define __dma_free_remap(addr, size)			do { } while (0)
+#define __in_atomic_pool(addr, size)			false
+#define __alloc_from_pool(size, ret_page)		NULL
+#define __free_from_pool(addr, size)			do { } while (0)
 
 #endif	/* CONFIG_MMU */
 
@@ -320,6 +523,20 @@ __dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
 	*handle = ~0;
 	size = PAGE_ALIGN(size);
 
+	/*
+	 * Callers that cannot sleep take pre-mapped memory if there is any
+	 * left, and go the slow way below otherwise.  The pool is not in
+	 * ZONE_DMA, so devices with a narrower mask always go the slow way.
+	 */
+	if (!(gfp & __GFP_WAIT) && !arch_is_coherent() &&
+	    get_coherent_dma_mask(dev) >= 0xffffffffULL) {
+		addr = __alloc_from_pool(size, &page);
+		if (addr) {
+			*handle = pfn_to_dma(dev, page_to_pfn(page));
+			return addr;
+		}
+	}
+
 	page = __dma_alloc_buffer(dev, size, gfp);
 	if (!page)
 		return NULL;
@@ -376,6 +593,19 @@ static int dma_mmap(struct device *dev, struct vm_area_struct *vma,
 
 	user_size = (vma->vm_end - vma->vm_start) >> PAGE_SHIFT;
 
+	if (__in_atomic_pool(cpu_addr, PAGE_SIZE)) {
+		unsigned long off = vma->vm_pgoff;
+		unsigned long pfn = page_to_pfn(atomic_pool.page) +
+			((cpu_addr - atomic_pool.vaddr) >> PAGE_SHIFT);
+
+		kern_size = PAGE_ALIGN(size) >> PAGE_SHIFT;
+		if (off < kern_size && user_size <= (kern_size - off))
+			ret = remap_pfn_range(vma, vma->vm_start, pfn + off,
+					      user_size << PAGE_SHIFT,
+					      vma->vm_page_prot);
+		return ret;
+	}
+
 	c = arm_vmregion_find(&consistent_head, (unsigned long)cpu_addr);
 	if (c) {
 		unsigned long off = vma->vm_pgoff;
@@ -413,16 +643,24 @@ EXPORT_SYMBOL(dma_mmap_writecombine);
 
 /*
  * free a page as defined by the above mapping.
- * Must not be called with IRQs disabled.
+ * Must not be called with IRQs disabled, unless it came from the atomic
+ * pool.
  */
 void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr_t handle)
 {
+	size_t asize = PAGE_ALIGN(size);
+
+	if (__in_atomic_pool(cpu_addr, asize)) {
+		__free_from_pool(cpu_addr, asize);
+		return;
+	}
+
 	WARN_ON(irqs_disabled());
 
 	if (dma_release_from_coherent(dev, get_order(size), cpu_addr))
 		return;
 
-	size = PAGE_ALIGN(size);
+	size = asize;
 
 	if (!arch_is_coherent())
 		__dma_free_remap(cpu_addr, size);
@@ -425,6 +425,7 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 		kmem_cache_free(blk_requestq_cachep, q);
 		return NULL;
 	}
+	q->backing_dev_info.ra_adapt.enabled = 1;
 
 	if (blk_throtl_init(q)) {
 		kmem_cache_free(blk_requestq_cachep, q);
@@ -1806,6 +1807,10 @@ static void blk_account_io_done(struct request *req)
 
 		hd_struct_put(part);
 		part_stat_unlock();
+
+		if (rw == READ)
+			bdi_ra_update_latency(&req->q->backing_dev_info,
+					      jiffies_to_usecs(duration));
 	}
 }
 
@@ -100,6 +100,87 @@ queue_ra_store(struct request_queue *q, const char *page, size_t count)
 	return ret;
 }
 
+static ssize_t queue_ra_adaptive_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->backing_dev_info.ra_adapt.enabled, page);
+}
+
+static ssize_t
+queue_ra_adaptive_store(struct request_queue *q, const char *page, size_t count)
+{
+	unsigned long val;
+	ssize_t ret = queue_var_store(&val, page, count);
+
+	q->backing_dev_info.ra_adapt.enabled = !!val;
+	return ret;
+}
+
+static ssize_t queue_ra_min_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->backing_dev_info.ra_adapt.min_pages <<
+			      (PAGE_CACHE_SHIFT - 10), page);
+}
+
+static ssize_t
+queue_ra_min_store(struct request_queue *q, const char *page, size_t count)
+{
+	struct bdi_ra_adapt *ra = &q->backing_dev_info.ra_adapt;
+	unsigned long ra_kb;
+	ssize_t ret = queue_var_store(&ra_kb, page, count);
+
+	spin_lock(&ra->lock);
+	ra->min_pages = max(ra_kb >> (PAGE_CACHE_SHIFT - 10), 1UL);
+	ra->max_pages = max(ra->max_pages, ra->min_pages);
+	spin_unlock(&ra->lock);
+	return ret;
+}
+
+static ssize_t queue_ra_max_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->backing_dev_info.ra_adapt.max_pages <<
+			      (PAGE_CACHE_SHIFT - 10), page);
+}
+
+static ssize_t
+queue_ra_max_store(struct request_queue *q, const char *page, size_t count)
+{
+	struct bdi_ra_adapt *ra = &q->backing_dev_info.ra_adapt;
+	unsigned long ra_kb;
+	ssize_t ret = queue_var_store(&ra_kb, page, count);
+
+	spin_lock(&ra->lock);
+	ra->max_pages = max(ra_kb >> (PAGE_CACHE_SHIFT - 10), 1UL);
+	ra->min_pages = min(ra->min_pages, ra->max_pages);
+	spin_unlock(&ra->lock);
+	return ret;
+}
+
+static ssize_t queue_ra_lat_target_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->backing_dev_info.ra_adapt.lat_target_us, page);
+}
+
+static ssize_t
+queue_ra_lat_target_store(struct request_queue *q, const char *page,
+			  size_t count)
+{
+	unsigned long val;
+	ssize_t ret = queue_var_store(&val, page, count);
+
+	q->backing_dev_info.ra_adapt.lat_target_us = val;
+	return ret;
+}
+
+static ssize_t queue_ra_stats_show(struct request_queue *q, char *page)
+{
+	struct backing_dev_info *bdi = &q->backing_dev_info;
+	struct bdi_ra_adapt *ra = &bdi->ra_adapt;
+
+	return sprintf(page, "%lu %u %lu %lu %lu\n",
+		       bdi->ra_pages << (PAGE_CACHE_SHIFT - 10), ra->ratio,
+		       ra->lat_us, ra->grow, ra->shrink);
+}
+
 static ssize_t queue_max_sectors_show(struct request_queue *q, char *page)
 {
 	int max_sectors_kb = queue_max_sectors(q) >> 1;
@@ -285,6 +366,36 @@ static struct queue_sysfs_entry queue_ra_entry = {
 	.store = queue_ra_store,
 };
 
+static struct queue_sysfs_entry queue_ra_adaptive_entry = {
+	.attr = {.name = "read_ahead_adaptive", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_ra_adaptive_show,
+	.store = queue_ra_adaptive_store,
+};
+
+static struct queue_sysfs_entry queue_ra_min_entry = {
+	.attr = {.name = "read_ahead_min_kb", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_ra_min_show,
+	.store = queue_ra_min_store,
+};
+
+static struct queue_sysfs_entry queue_ra_max_entry = {
+	.attr = {.name = "read_ahead_max_kb", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_ra_max_show,
+	.store = queue_ra_max_store,
+};
+
+static struct queue_sysfs_entry queue_ra_lat_target_entry = {
+	.attr = {.name = "read_ahead_latency_target_us",
+		 .mode = S_IRUGO | S_IWUSR },
+	.show = queue_ra_lat_target_show,
+	.store = queue_ra_lat_target_store,
+};
+
+static struct queue_sysfs_entry queue_ra_stats_entry = {
+	.attr = {.name = "read_ahead_stats", .mode = S_IRUGO },
+	.show = queue_ra_stats_show,
+};
+
 static struct queue_sysfs_entry queue_max_sectors_entry = {
 	.attr = {.name = "max_sectors_kb", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_max_sectors_show,
@@ -390,6 +501,11 @@ static struct queue_sysfs_entry queue_random_entry = {
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
+	&queue_ra_adaptive_entry.attr,
+	&queue_ra_min_entry.attr,
+	&queue_ra_max_entry.attr,
+	&queue_ra_lat_target_entry.attr,
+	&queue_ra_stats_entry.attr,
 	&queue_max_hw_sectors_entry.attr,
 	&queue_max_sectors_entry.attr,
 	&queue_max_segments_entry.attr,
@@ -0,0 +1,464 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int sync_write_expire = HZ / 4;	/* max time a sync write waits */
+static const int async_write_expire = 2 * HZ;	/* ditto for writeback */
+static const int writes_starved = 4;	/* max reads dispatched ahead of a write */
+static const int async_starved = 2;	/* max sync writes ahead of writeback */
+
+enum flash_class {
+	FLASH_READ = 0,
+	FLASH_SYNC_WRITE,
+	FLASH_ASYNC_WRITE,
+	FLASH_CLASSES,
+};
+
+/* the class and the time a request was queued, in usecs */
+#define rq_flash_class(rq)	((unsigned long) (rq)->elevator_private[0])
+#define rq_set_flash_class(rq, c)	((rq)->elevator_private[0] = (void *) (c))
+#define rq_flash_time(rq)	((unsigned long) (rq)->elevator_private[1])
+#define rq_set_flash_time(rq, t)	((rq)->elevator_private[1] = (void *) (t))
+
+struct flash_latency {
+	unsigned long count;
+	u64 total_us;
+	unsigned long max_us;
+};
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on both sort_list (by direction, for front
+	 * merges) and fifo_list (by class, for dispatch)
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[FLASH_CLASSES];
+
+	unsigned int starved;		/* times reads have starved writes */
+	unsigned int async_starved;	/* times sync writes starved async */
+
+	struct flash_latency latency[FLASH_CLASSES];
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[FLASH_CLASSES];
+	int writes_starved;
+	int async_starved_max;
+	int front_merges;
+};
+
+static inline unsigned long flash_now_us(void)
+{
+	return (unsigned long) ktime_to_us(ktime_get());
+}
+
+static inline enum flash_class flash_rq_class(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return FLASH_READ;
+
+	return rq_is_sync(rq) ? FLASH_SYNC_WRITE : FLASH_ASYNC_WRITE;
+}
+
+static inline enum flash_class flash_bio_class(struct bio *bio)
+{
+	if (bio_data_dir(bio) == READ)
+		return FLASH_READ;
+
+	return bio->bi_rw & REQ_SYNC ? FLASH_SYNC_WRITE : FLASH_ASYNC_WRITE;
+}
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const enum flash_class class = flash_rq_class(rq);
+
+	elv_rb_add(flash_rb_root(fd, rq), rq);
+
+	rq_set_flash_class(rq, class);
+	rq_set_flash_time(rq, flash_now_us());
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[class]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[class]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+/*
+ * keep sync and async writes apart, so that a sync write doesn't wait in
+ * the writeback fifo
+ */
+static int flash_allow_merge(struct request_queue *q, struct request *rq,
+			     struct bio *bio)
+{
+	return flash_rq_class(rq) == flash_bio_class(bio);
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		elv_rb_add(flash_rb_root(fd, req), req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next is of a more urgent class or expires before rq, rq takes
+	 * over its class, expire time and position (next will be deleted)
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (rq_flash_class(next) < rq_flash_class(req) ||
+		    (rq_flash_class(next) == rq_flash_class(req) &&
+		     time_before(rq_fifo_time(next), rq_fifo_time(req)))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_flash_class(req, rq_flash_class(next));
+			rq_set_flash_time(req, rq_flash_time(next));
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from the fifo to the dispatch queue, accounting the time it
+ * has been held back for
+ */
+static void flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct flash_latency *lat = &fd->latency[rq_flash_class(rq)];
+	unsigned long us = flash_now_us() - rq_flash_time(rq);
+
+	lat->count++;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+
+	flash_remove_request(rq->q, rq);
+	elv_dispatch_add_tail(rq->q, rq);
+}
+
+/*
+ * flash_expired returns 1 if the oldest request of the class has expired.
+ * Requires !list_empty(&fd->fifo_list[class])
+ */
+static inline int flash_expired(struct flash_data *fd, int class)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[class].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+static int flash_choose_write(struct flash_data *fd)
+{
+	const int sync = !list_empty(&fd->fifo_list[FLASH_SYNC_WRITE]);
+	const int async = !list_empty(&fd->fifo_list[FLASH_ASYNC_WRITE]);
+
+	if (async && (!sync || fd->async_starved >= fd->async_starved_max ||
+		      flash_expired(fd, FLASH_ASYNC_WRITE))) {
+		fd->async_starved = 0;
+		return FLASH_ASYNC_WRITE;
+	}
+
+	if (async)
+		fd->async_starved++;
+	return FLASH_SYNC_WRITE;
+}
+
+/*
+ * Reads go first, a write gets its turn once writes_starved reads went
+ * ahead of it or it has expired. Among the writes, sync ones go ahead of
+ * writeback the same way. There is no seeking on flash, so each class is
+ * served in fifo order, and no idling either: whatever is queued goes.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = !list_empty(&fd->fifo_list[FLASH_READ]);
+	const int sync = !list_empty(&fd->fifo_list[FLASH_SYNC_WRITE]);
+	const int async = !list_empty(&fd->fifo_list[FLASH_ASYNC_WRITE]);
+	int class;
+
+	if (!reads && !sync && !async)
+		return 0;
+
+	if (reads && !(sync || async))
+		class = FLASH_READ;
+	else if (!reads || fd->starved >= fd->writes_starved ||
+		 (sync && flash_expired(fd, FLASH_SYNC_WRITE)) ||
+		 (async && flash_expired(fd, FLASH_ASYNC_WRITE)))
+		class = flash_choose_write(fd);
+	else
+		class = FLASH_READ;
+
+	if (class == FLASH_READ) {
+		if (sync || async)
+			fd->starved++;
+	} else {
+		fd->starved = 0;
+	}
+
+	flash_move_to_dispatch(fd, rq_entry_fifo(fd->fifo_list[class].next));
+
+	return 1;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+	int i;
+
+	for (i = 0; i < FLASH_CLASSES; i++)
+		BUG_ON(!list_empty(&fd->fifo_list[i]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int i;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	for (i = 0; i < FLASH_CLASSES; i++)
+		INIT_LIST_HEAD(&fd->fifo_list[i]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->fifo_expire[FLASH_READ] = 0;
+	fd->fifo_expire[FLASH_SYNC_WRITE] = sync_write_expire;
+	fd->fifo_expire[FLASH_ASYNC_WRITE] = async_write_expire;
+	fd->writes_starved = writes_starved;
+	fd->async_starved_max = async_starved;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_sync_write_expire_show,
+	      fd->fifo_expire[FLASH_SYNC_WRITE], 1);
+SHOW_FUNCTION(flash_async_write_expire_show,
+	      fd->fifo_expire[FLASH_ASYNC_WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_async_starved_show, fd->async_starved_max, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page,	\
+		      size_t count)					\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_sync_write_expire_store,
+	       &fd->fifo_expire[FLASH_SYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_write_expire_store,
+	       &fd->fifo_expire[FLASH_ASYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_async_starved_store, &fd->async_starved_max,
+	       0, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+/*
+ * time from queueing to dispatch for each class, writing anything resets it
+ */
+#define LATENCY_FUNCTION(__NAME, __CLASS)				\
+static ssize_t flash_##__NAME##_latency_show(struct elevator_queue *e,	\
+					     char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	struct flash_latency *lat = &fd->latency[__CLASS];		\
+	u64 avg = lat->total_us;					\
+	if (lat->count)							\
+		do_div(avg, lat->count);				\
+	return sprintf(page, "%lu requests, avg %llu us, max %lu us\n",	\
+		       lat->count, avg, lat->max_us);			\
+}									\
+static ssize_t flash_##__NAME##_latency_store(struct elevator_queue *e,	\
+					      const char *page,		\
+					      size_t count)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	memset(&fd->latency[__CLASS], 0, sizeof(struct flash_latency));	\
+	return count;							\
+}
+LATENCY_FUNCTION(read, FLASH_READ);
+LATENCY_FUNCTION(sync_write, FLASH_SYNC_WRITE);
+LATENCY_FUNCTION(async_write, FLASH_ASYNC_WRITE);
+#undef LATENCY_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(sync_write_expire),
+	FD_ATTR(async_write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(async_starved),
+	FD_ATTR(front_merges),
+	FD_ATTR(read_latency),
+	FD_ATTR(sync_write_latency),
+	FD_ATTR(async_write_latency),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_allow_merge_fn =	flash_allow_merge,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -28,6 +28,7 @@
 #include <linux/async.h>
 #include <linux/suspend.h>
 #include <linux/timer.h>
+#include <trace/events/power.h>
 
 #include "../base.h"
 #include "power.h"
@@ -428,6 +429,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 static int device_resume_noirq(struct device *dev, pm_message_t state)
 {
 	int error = 0;
+	ktime_t calltime = ktime_get();
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
@@ -446,6 +448,10 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 		error = pm_noirq_op(dev, dev->bus->pm, state);
 	}
 
+	trace_device_pm_report_time(dev, "noirq_resume",
+		ktime_to_us(ktime_sub(ktime_get(), calltime)),
+		state.event, error);
+
 	TRACE_RESUME(error);
 	return error;
 }
@@ -513,6 +519,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	int error = 0;
 	bool put = false;
+	ktime_t calltime;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
@@ -531,6 +538,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
 	pm_runtime_enable(dev);
 	put = true;
+	calltime = ktime_get();
 
 	if (dev->pm_domain) {
 		pm_dev_dbg(dev, state, "power domain ");
@@ -568,6 +576,9 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
  End:
 	dev->power.is_suspended = false;
+	trace_device_pm_report_time(dev, async ? "async_resume" : "resume",
+		ktime_to_us(ktime_sub(ktime_get(), calltime)),
+		state.event, error);
 
  Unlock:
 	device_unlock(dev);
@@ -781,31 +792,28 @@ static pm_message_t resume_event(pm_message_t sleep_state)
  */
 static int device_suspend_noirq(struct device *dev, pm_message_t state)
 {
-	int error;
+	int error = 0;
+	ktime_t calltime = ktime_get();
 
 	if (dev->pm_domain) {
 		pm_dev_dbg(dev, state, "LATE power domain ");
 		error = pm_noirq_op(dev, &dev->pm_domain->ops, state);
-		if (error)
-			return error;
 	} else if (dev->type && dev->type->pm) {
 		pm_dev_dbg(dev, state, "LATE type ");
 		error = pm_noirq_op(dev, dev->type->pm, state);
-		if (error)
-			return error;
 	} else if (dev->class && dev->class->pm) {
 		pm_dev_dbg(dev, state, "LATE class ");
 		error = pm_noirq_op(dev, dev->class->pm, state);
-		if (error)
-			return error;
 	} else if (dev->bus && dev->bus->pm) {
 		pm_dev_dbg(dev, state, "LATE ");
 		error = pm_noirq_op(dev, dev->bus->pm, state);
-		if (error)
-			return error;
 	}
 
-	return 0;
+	trace_device_pm_report_time(dev, "noirq_suspend",
+		ktime_to_us(ktime_sub(ktime_get(), calltime)),
+		state.event, error);
+
+	return error;
 }
 
 /**
@@ -882,17 +890,10 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	int error = 0;
 	struct timer_list timer;
 	struct dpm_drv_wd_data data;
+	ktime_t calltime;
 
 	dpm_wait_for_children(dev, async);
 
-	data.dev = dev;
-	data.tsk = get_current();
-	init_timer_on_stack(&timer);
-	timer.expires = jiffies + HZ * 12;
-	timer.function = dpm_drv_timeout;
-	timer.data = (unsigned long)&data;
-	add_timer(&timer);
-
 	if (async_error)
 		return 0;
 
@@ -906,7 +907,17 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 		return 0;
 	}
 
+	/* armed only once nothing returns early, it lives on the stack */
+	data.dev = dev;
+	data.tsk = get_current();
+	init_timer_on_stack(&timer);
+	timer.expires = jiffies + HZ * 12;
+	timer.function = dpm_drv_timeout;
+	timer.data = (unsigned long)&data;
+	add_timer(&timer);
+
 	device_lock(dev);
+	calltime = ktime_get();
 
 	if (dev->pm_domain) {
 		pm_dev_dbg(dev, state, "power domain ");
@@ -944,6 +955,9 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 
  End:
 	dev->power.is_suspended = !error;
+	trace_device_pm_report_time(dev, async ? "async_suspend" : "suspend",
+		ktime_to_us(ktime_sub(ktime_get(), calltime)),
+		state.event, error);
 
 	device_unlock(dev);
 
@@ -76,6 +76,7 @@
 #include <linux/splice.h>
 #include <linux/sysfs.h>
 #include <linux/miscdevice.h>
+#include <linux/vmalloc.h>
 #include <asm/uaccess.h>
 
 static DEFINE_IDR(loop_index_idr);
@@ -498,6 +499,162 @@ out:
 	return ret;
 }
 
+/*
+ * Direct I/O: with LO_FLAGS_DIRECT_IO set, bios are remapped onto the
+ * blocks backing the file and resubmitted to the block device underneath,
+ * bypassing both the loop thread and the page cache of the backing file,
+ * so the data isn't cached twice. The block map is taken once, when the
+ * mode is switched on, and the file is marked S_SWAPFILE for as long so
+ * that it can't be truncated or have its blocks moved meanwhile.
+ */
+struct loop_extent {
+	sector_t	start;		/* on the loop device */
+	sector_t	sector;		/* on lo_direct_bdev */
+	sector_t	nr_sects;
+};
+
+/* bios split across extents complete their parent once all are done */
+struct loop_split {
+	struct bio	*parent;
+	atomic_t	pending;
+	int		error;
+};
+
+static struct bio_set *loop_bio_set;
+
+static struct loop_extent *loop_find_extent(struct loop_device *lo,
+					    sector_t sector)
+{
+	unsigned int lo_idx = 0, hi_idx = lo->lo_nr_extents;
+	struct loop_extent *ext;
+
+	while (lo_idx < hi_idx) {
+		unsigned int mid = (lo_idx + hi_idx) / 2;
+
+		ext = &lo->lo_extents[mid];
+		if (sector < ext->start)
+			hi_idx = mid;
+		else if (sector >= ext->start + ext->nr_sects)
+			lo_idx = mid + 1;
+		else
+			return ext;
+	}
+	return NULL;
+}
+
+static void loop_split_put(struct loop_split *split)
+{
+	if (atomic_dec_and_test(&split->pending)) {
+		bio_endio(split->parent, split->error);
+		kfree(split);
+	}
+}
+
+static void loop_split_endio(struct bio *bio, int error)
+{
+	struct loop_split *split = bio->bi_private;
+
+	if (error)
+		split->error = error;
+	bio_put(bio);
+	loop_split_put(split);
+}
+
+static void loop_split_submit(struct loop_split *split, struct bio *bio)
+{
+	atomic_inc(&split->pending);
+	generic_make_request(bio);
+}
+
+static void loop_direct_split(struct loop_device *lo, struct bio *bio,
+			      struct loop_extent *ext)
+{
+	struct loop_extent *last = lo->lo_extents + lo->lo_nr_extents;
+	sector_t sector = bio->bi_sector;
+	struct loop_split *split;
+	struct bio *child = NULL;
+	struct bio_vec *bvec;
+	unsigned int off, len;
+	int i;
+
+	split = kmalloc(sizeof(*split), GFP_NOIO);
+	if (!split) {
+		bio_endio(bio, -ENOMEM);
+		return;
+	}
+	split->parent = bio;
+	split->error = 0;
+	/* held until the last child has been submitted */
+	atomic_set(&split->pending, 1);
+
+	bio_for_each_segment(bvec, bio, i) {
+		for (off = 0; off < bvec->bv_len; off += len) {
+			if (sector >= ext->start + ext->nr_sects) {
+				loop_split_submit(split, child);
+				child = NULL;
+				if (++ext == last ||
+				    ext->start != sector) {
+					split->error = -EIO;
+					goto out;
+				}
+			}
+			len = min_t(sector_t, bvec->bv_len - off,
+				    (ext->start + ext->nr_sects - sector) << 9);
+
+			if (!child) {
+				child = bio_alloc_bioset(GFP_NOIO,
+							 bio->bi_vcnt - i,
+							 loop_bio_set);
+				child->bi_sector = ext->sector +
+						   (sector - ext->start);
+				child->bi_bdev = lo->lo_direct_bdev;
+				child->bi_rw = bio->bi_rw;
+				child->bi_end_io = loop_split_endio;
+				child->bi_private = split;
+			}
+			child->bi_io_vec[child->bi_vcnt].bv_page =
+				bvec->bv_page;
+			child->bi_io_vec[child->bi_vcnt].bv_offset =
+				bvec->bv_offset + off;
+			child->bi_io_vec[child->bi_vcnt].bv_len = len;
+			child->bi_vcnt++;
+			child->bi_size += len;
+			sector += len >> 9;
+		}
+	}
+out:
+	if (child)
+		loop_split_submit(split, child);
+	loop_split_put(split);
+}
+
+static void loop_direct_bio(struct loop_device *lo, struct bio *bio)
+{
+	struct loop_extent *ext;
+
+	/* an empty flush only has to reach the device underneath */
+	if (!bio->bi_size) {
+		bio->bi_bdev = lo->lo_direct_bdev;
+		generic_make_request(bio);
+		return;
+	}
+
+	ext = loop_find_extent(lo, bio->bi_sector);
+	if (!ext) {
+		bio_io_error(bio);
+		return;
+	}
+
+	if (bio->bi_sector + bio_sectors(bio) > ext->start + ext->nr_sects) {
+		loop_direct_split(lo, bio, ext);
+		return;
+	}
+
+	bio->bi_sector = ext->sector + (bio->bi_sector - ext->start);
+	bio->bi_bdev = lo->lo_direct_bdev;
+	generic_make_request(bio);
+}
+
 /*
  * Add bio to back of pending list
  */
@@ -529,6 +686,11 @@ static int loop_make_request(struct request_queue *q, struct bio *old_bio)
 		goto out;
 	if (unlikely(rw == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY)))
 		goto out;
+	if (lo->lo_flags & LO_FLAGS_DIRECT_IO) {
+		spin_unlock_irq(&lo->lo_lock);
+		loop_direct_bio(lo, old_bio);
+		return 0;
+	}
 	loop_add_bio(lo, old_bio);
 	wake_up(&lo->lo_event);
 	spin_unlock_irq(&lo->lo_lock);
@@ -677,6 +839,10 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 	if (!(lo->lo_flags & LO_FLAGS_READ_ONLY))
 		goto out;
 
+	error = -EBUSY;
+	if (lo->lo_flags & LO_FLAGS_DIRECT_IO)
+		goto out;
+
 	error = -EBADF;
 	file = fget(arg);
 	if (!file)
@@ -777,16 +943,25 @@ static ssize_t loop_attr_autoclear_show(struct loop_device *lo, char *buf)
 	return sprintf(buf, "%s\n", autoclear ? "1" : "0");
 }
 
+static ssize_t loop_attr_dio_show(struct loop_device *lo, char *buf)
+{
+	int dio = (lo->lo_flags & LO_FLAGS_DIRECT_IO);
+
+	return sprintf(buf, "%s\n", dio ? "1" : "0");
+}
+
 LOOP_ATTR_RO(backing_file);
 LOOP_ATTR_RO(offset);
 LOOP_ATTR_RO(sizelimit);
 LOOP_ATTR_RO(autoclear);
+LOOP_ATTR_RO(dio);
 
 static struct attribute *loop_attrs[] = {
 	&loop_attr_backing_file.attr,
 	&loop_attr_offset.attr,
 	&loop_attr_sizelimit.attr,
 	&loop_attr_autoclear.attr,
+	&loop_attr_dio.attr,
 	NULL,
 };
 
@@ -980,6 +1155,8 @@ loop_init_xfer(struct loop_device *lo, struct loop_func_table *xfer,
 	return err;
 }
 
+static void loop_direct_io_off(struct loop_device *lo);
+
 static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 {
 	struct file *filp = lo->lo_backing_file;
@@ -999,6 +1176,7 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 	spin_unlock_irq(&lo->lo_lock);
 
 	kthread_stop(lo->lo_thread);
+	loop_direct_io_off(lo);
 
 	spin_lock_irq(&lo->lo_lock);
 	lo->lo_backing_file = NULL;
@@ -1058,6 +1236,12 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 		return -ENXIO;
 	if ((unsigned int) info->lo_encrypt_key_size > LO_KEY_SIZE)
 		return -EINVAL;
+	/* the direct I/O block map covers the old geometry, untransformed */
+	if ((lo->lo_flags & LO_FLAGS_DIRECT_IO) &&
+	    (info->lo_encrypt_type ||
+	     lo->lo_offset != info->lo_offset ||
+	     lo->lo_sizelimit != info->lo_sizelimit))
+		return -EBUSY;
 
 	err = loop_release_xfer(lo);
 	if (err)
@@ -1277,6 +1461,287 @@ static int loop_set_capacity(struct loop_device *lo, struct block_device *bdev)
 	return err;
 }
 
+static int loop_add_extent(struct loop_device *lo, unsigned int *max,
+			   sector_t start, sector_t sector, sector_t nr_sects)
+{
+	struct loop_extent *ext;
+
+	if (lo->lo_nr_extents) {
+		ext = &lo->lo_extents[lo->lo_nr_extents - 1];
+		if (ext->start + ext->nr_sects == start &&
+		    ext->sector + ext->nr_sects == sector) {
+			ext->nr_sects += nr_sects;
+			return 0;
+		}
+	}
+
+	if (lo->lo_nr_extents == *max) {
+		ext = vmalloc(2 * *max * sizeof(*ext));
+		if (!ext)
+			return -ENOMEM;
+		memcpy(ext, lo->lo_extents, *max * sizeof(*ext));
+		vfree(lo->lo_extents);
+		lo->lo_extents = ext;
+		*max *= 2;
+	}
+
+	ext = &lo->lo_extents[lo->lo_nr_extents++];
+	ext->start = start;
+	ext->sector = sector;
+	ext->nr_sects = nr_sects;
+	return 0;
+}
+
+#define LOOP_FIEMAP_EXTENTS	32
+
+/* anything but plain written data at a known place on the device */
+#define LOOP_FIEMAP_UNMAPPABLE	(FIEMAP_EXTENT_UNKNOWN |		\
+				 FIEMAP_EXTENT_DELALLOC |		\
+				 FIEMAP_EXTENT_ENCODED |		\
+				 FIEMAP_EXTENT_DATA_ENCRYPTED |		\
+				 FIEMAP_EXTENT_NOT_ALIGNED |		\
+				 FIEMAP_EXTENT_DATA_INLINE |		\
+				 FIEMAP_EXTENT_DATA_TAIL |		\
+				 FIEMAP_EXTENT_UNWRITTEN)
+
+/*
+ * Map [pos, end) of the backing file through ->fiemap, which unlike bmap
+ * tells preallocated, not yet written extents apart: reads of those have to
+ * return zeroes, which only the filesystem knows to do.
+ */
+static int loop_map_fiemap(struct loop_device *lo, struct inode *inode,
+			   loff_t pos, loff_t end, unsigned int *max)
+{
+	struct fiemap_extent_info fieinfo;
+	struct fiemap_extent *fe;
+	mm_segment_t old_fs;
+	loff_t start, len;
+	int i, err = 0;
+
+	fe = kmalloc(LOOP_FIEMAP_EXTENTS * sizeof(*fe), GFP_KERNEL);
+	if (!fe)
+		return -ENOMEM;
+
+	while (pos < end) {
+		memset(&fieinfo, 0, sizeof(fieinfo));
+		fieinfo.fi_extents_max = LOOP_FIEMAP_EXTENTS;
+		fieinfo.fi_extents_start = (struct fiemap_extent __user *)fe;
+
+		old_fs = get_fs();
+		set_fs(KERNEL_DS);
+		err = inode->i_op->fiemap(inode, &fieinfo, pos, end - pos);
+		set_fs(old_fs);
+		if (err)
+			break;
+
+		start = pos;
+		for (i = 0; i < fieinfo.fi_extents_mapped; i++) {
+			if (fe[i].fe_logical + fe[i].fe_length <= pos)
+				continue;
+			/* a hole, or data fiemap can't place */
+			err = -EINVAL;
+			if (fe[i].fe_logical > pos ||
+			    (fe[i].fe_flags & LOOP_FIEMAP_UNMAPPABLE))
+				goto out;
+
+			len = min_t(loff_t, fe[i].fe_logical +
+				    fe[i].fe_length, end) - pos;
+			err = loop_add_extent(lo, max,
+				(pos - lo->lo_offset) >> 9,
+				(fe[i].fe_physical + (pos - fe[i].fe_logical))
+					>> 9,
+				len >> 9);
+			if (err)
+				goto out;
+			pos += len;
+		}
+		/* nothing mapped: a hole up to the end */
+		err = -EINVAL;
+		if (pos == start)
+			break;
+		err = 0;
+	}
+out:
+	kfree(fe);
+	return err;
+}
+
+static int loop_map_bmap(struct loop_device *lo, struct inode *inode,
+			 loff_t pos, loff_t end, unsigned int *max)
+{
+	unsigned int blkbits = inode->i_blkbits;
+	sector_t block, phys;
+	loff_t next;
+	int err;
+
+	for (; pos < end; pos = next) {
+		block = pos >> blkbits;
+		next = min_t(loff_t, (loff_t)(block + 1) << blkbits, end);
+		phys = bmap(inode, block);
+		if (!phys)
+			return -EINVAL;
+
+		err = loop_add_extent(lo, max, (pos - lo->lo_offset) >> 9,
+			(phys << (blkbits - 9)) +
+			((pos & ((1 << blkbits) - 1)) >> 9),
+			(next - pos) >> 9);
+		if (err)
+			return err;
+		cond_resched();
+	}
+	return 0;
+}
+
+static int loop_map_file(struct loop_device *lo, struct inode *inode)
+{
+	loff_t pos = lo->lo_offset;
+	loff_t end = pos + ((loff_t)get_capacity(lo->lo_disk) << 9);
+	unsigned int max = 16;
+	int err;
+
+	lo->lo_extents = vmalloc(max * sizeof(struct loop_extent));
+	if (!lo->lo_extents)
+		return -ENOMEM;
+	lo->lo_nr_extents = 0;
+
+	if (S_ISBLK(inode->i_mode))
+		err = loop_add_extent(lo, &max, 0, pos >> 9, (end - pos) >> 9);
+	else if (inode->i_op->fiemap)
+		err = loop_map_fiemap(lo, inode, pos, end, &max);
+	else
+		err = loop_map_bmap(lo, inode, pos, end, &max);
+
+	if (err) {
+		vfree(lo->lo_extents);
+		lo->lo_extents = NULL;
+		lo->lo_nr_extents = 0;
+	}
+	return err;
+}
+
+/* with nothing in flight, see loop_set_direct_io() */
+static void loop_direct_io_off(struct loop_device *lo)
+{
+	struct inode *inode = lo->lo_backing_file->f_mapping->host;
+
+	if (!(lo->lo_flags & LO_FLAGS_DIRECT_IO))
+		return;
+
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+	spin_unlock_irq(&lo->lo_lock);
+
+	if (S_ISREG(inode->i_mode)) {
+		mutex_lock(&inode->i_mutex);
+		inode->i_flags &= ~S_SWAPFILE;
+		mutex_unlock(&inode->i_mutex);
+	}
+
+	vfree(lo->lo_extents);
+	lo->lo_extents = NULL;
+	lo->lo_nr_extents = 0;
+	lo->lo_direct_bdev = NULL;
+}
+
+/*
+ * Switch direct I/O on or off. Only whoever issues the ioctl may have the
+ * device open: with nobody else around, syncing the loop device and
+ * flushing the thread leaves nothing in flight on either path, which keeps
+ * the backing page cache from going stale behind direct writes. Only
+ * filesystems that place file blocks 1:1 on their device, which are the
+ * ones implementing ->bmap that swap files need too, can be bypassed.
+ */
+static int loop_set_direct_io(struct loop_device *lo,
+			      struct block_device *bdev, unsigned long arg)
+{
+	struct file *file = lo->lo_backing_file;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct block_device *lower;
+	struct request_queue *q;
+	int err;
+
+	if (lo->lo_state != Lo_bound)
+		return -ENXIO;
+	if (!arg == !(lo->lo_flags & LO_FLAGS_DIRECT_IO))
+		return 0;
+	if (lo->lo_refcnt > 1)
+		return -EBUSY;
+
+	sync_blockdev(bdev);
+
+	if (!arg) {
+		loop_direct_io_off(lo);
+		return 0;
+	}
+
+	/* a transfer function has to see the data on its way */
+	if (lo->transfer != transfer_none)
+		return -EINVAL;
+
+	if (S_ISBLK(inode->i_mode)) {
+		lower = I_BDEV(inode);
+	} else {
+		if (!mapping->a_ops->bmap || !inode->i_sb->s_bdev)
+			return -EINVAL;
+		lower = inode->i_sb->s_bdev;
+	}
+	if (lo->lo_offset & (bdev_logical_block_size(lower) - 1))
+		return -EINVAL;
+
+	if (S_ISREG(inode->i_mode)) {
+		mutex_lock(&inode->i_mutex);
+		/* a swap file, or already bypassed by another loop device */
+		err = IS_SWAPFILE(inode) ? -EBUSY : 0;
+		inode->i_flags |= S_SWAPFILE;
+		mutex_unlock(&inode->i_mutex);
+		if (err)
+			return err;
+	}
+
+	err = filemap_write_and_wait(mapping);
+	if (err)
+		goto err_swapfile;
+
+	err = loop_map_file(lo, inode);
+	if (err)
+		goto err_swapfile;
+
+	/* the thread is idle once it has got here */
+	err = loop_flush(lo);
+	if (!err)
+		err = filemap_write_and_wait(mapping);
+	if (err)
+		goto err_extents;
+	invalidate_mapping_pages(mapping, 0, -1);
+
+	/* remapped bios have to be acceptable as they are below */
+	q = bdev_get_queue(lower);
+	blk_queue_stack_limits(lo->lo_queue, q);
+	if (q->merge_bvec_fn) {
+		blk_queue_max_segments(lo->lo_queue, 1);
+		blk_queue_segment_boundary(lo->lo_queue, PAGE_CACHE_SIZE - 1);
+	}
+
+	lo->lo_direct_bdev = lower;
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_flags |= LO_FLAGS_DIRECT_IO;
+	spin_unlock_irq(&lo->lo_lock);
+	return 0;
+
+err_extents:
+	vfree(lo->lo_extents);
+	lo->lo_extents = NULL;
+	lo->lo_nr_extents = 0;
+err_swapfile:
+	if (S_ISREG(inode->i_mode)) {
+		mutex_lock(&inode->i_mutex);
+		inode->i_flags &= ~S_SWAPFILE;
+		mutex_unlock(&inode->i_mutex);
+	}
+	return err;
+}
+
 static int lo_ioctl(struct block_device *bdev, fmode_t mode,
 	unsigned int cmd, unsigned long arg)
 {
@@ -1314,6 +1779,11 @@ static int lo_ioctl(struct block_device *bdev, fmode_t mode,
 		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
 			err = loop_set_capacity(lo, bdev);
 		break;
+	case LOOP_SET_DIRECT_IO:
+		err = -EPERM;
+		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
+			err = loop_set_direct_io(lo, bdev, arg);
+		break;
 	default:
 		err = lo->ioctl ? lo->ioctl(lo, cmd, arg) : -EINVAL;
 	}
@@ -1462,6 +1932,7 @@ static int lo_compat_ioctl(struct block_device *bdev, fmode_t mode,
 		mutex_unlock(&lo->lo_ctl_mutex);
 		break;
 	case LOOP_SET_CAPACITY:
+	case LOOP_SET_DIRECT_IO:
 	case LOOP_CLR_FD:
 	case LOOP_GET_STATUS64:
 	case LOOP_SET_STATUS64:
@@ -1795,9 +2266,13 @@ static int __init loop_init(void)
 	struct loop_device *lo;
 	int err;
 
+	loop_bio_set = bioset_create(BIO_POOL_SIZE, 0);
+	if (!loop_bio_set)
+		return -ENOMEM;
+
 	err = misc_register(&loop_misc);
 	if (err < 0)
-		return err;
+		goto err_bioset;
 
 	part_shift = 0;
 	if (max_part > 0) {
@@ -1814,11 +2289,12 @@ static int __init loop_init(void)
 		max_part = (1UL << part_shift) - 1;
 	}
 
+	err = -EINVAL;
 	if ((1UL << part_shift) > DISK_MAX_PARTS)
-		return -EINVAL;
+		goto err_misc;
 
 	if (max_loop > 1UL << (MINORBITS - part_shift))
-		return -EINVAL;
+		goto err_misc;
 
 	/*
 	 * If max_loop is specified, create that many devices upfront.
@@ -1836,8 +2312,9 @@ static int __init loop_init(void)
 		range = 1UL << MINORBITS;
 	}
 
+	err = -EIO;
 	if (register_blkdev(LOOP_MAJOR, "loop"))
-		return -EIO;
+		goto err_misc;
 
 	blk_register_region(MKDEV(LOOP_MAJOR, 0), range,
 				  THIS_MODULE, loop_probe, NULL, NULL);
@@ -1850,6 +2327,12 @@ static int __init loop_init(void)
 
 	printk(KERN_INFO "loop: module loaded\n");
 	return 0;
+
+err_misc:
+	misc_deregister(&loop_misc);
+err_bioset:
+	bioset_free(loop_bio_set);
+	return err;
 }
 
 static int loop_exit_cb(int id, void *ptr, void *data)
@@ -1874,6 +2357,7 @@ static void __exit loop_exit(void)
 	unregister_blkdev(LOOP_MAJOR, "loop");
 
 	misc_deregister(&loop_misc);
+	bioset_free(loop_bio_set);
 }
 
 module_init(loop_init);
@@ -40,6 +40,10 @@
 #include <linux/signal.h>
 #include <linux/ioctl.h>
 #include <linux/skbuff.h>
+#ifdef CONFIG_BT_HCIUART_TEGRA_DIRECT
+#include <linux/serial_core.h>
+#include <linux/tegra_uart.h>
+#endif
 
 #include <net/bluetooth/bluetooth.h>
 #include <net/bluetooth/hci_core.h>
@@ -50,6 +54,10 @@
 
 static int reset = 0;
 
+#ifdef CONFIG_BT_HCIUART_TEGRA_DIRECT
+static int rx_direct = 1;
+#endif
+
 static struct hci_uart_proto *hup[HCI_UART_MAX_PROTO];
 
 int hci_uart_register_proto(struct hci_uart_proto *p)
@@ -306,6 +314,13 @@ static void hci_uart_tty_close(struct tty_struct *tty)
 	if (hu) {
 		struct hci_dev *hdev = hu->hdev;
 
+#ifdef CONFIG_BT_HCIUART_TEGRA_DIRECT
+		if (test_and_clear_bit(HCI_UART_RX_DIRECT, &hu->flags)) {
+			tegra_uart_set_rx_handler(tty, NULL, NULL);
+			tasklet_kill(&hu->tx_tasklet);
+		}
+#endif
+
 		if (hdev)
 			hci_uart_close(hdev);
 
@@ -360,6 +375,7 @@ static void hci_uart_tty_wakeup(struct tty_struct *tty)
 static void hci_uart_tty_receive(struct tty_struct *tty, const u8 *data, char *flags, int count)
 {
 	struct hci_uart *hu = (void *)tty->disc_data;
+	unsigned long irqflags;
 
 	if (!hu || tty != hu->tty)
 		return;
@@ -367,14 +383,68 @@ static void hci_uart_tty_receive(struct tty_struct *tty, const u8 *data, char *f
 	if (!test_bit(HCI_UART_PROTO_SET, &hu->flags))
 		return;
 
-	spin_lock(&hu->rx_lock);
+	spin_lock_irqsave(&hu->rx_lock, irqflags);
 	hu->proto->recv(hu, (void *) data, count);
 	hu->hdev->stat.byte_rx += count;
-	spin_unlock(&hu->rx_lock);
+	spin_unlock_irqrestore(&hu->rx_lock, irqflags);
 
 	tty_unthrottle(tty);
 }
 
+#ifdef CONFIG_BT_HCIUART_TEGRA_DIRECT
+static void hci_uart_tx_tasklet(unsigned long data)
+{
+	hci_uart_tx_wakeup((struct hci_uart *) data);
+}
+
+/* hci_uart_direct_receive()
+ *
+ *     Called by the Tegra high speed UART driver, from its interrupt
+ *     handlers with the port lock held, for data straight out of its
+ *     DMA ring or FIFO. This skips the flip buffers and the tty
+ *     receive work.
+ *
+ *     Replies the protocol sends from recv (LL wake up acks, BCSP acks)
+ *     cannot be written to the port from here: holding HCI_UART_SENDING
+ *     makes hci_uart_tx_wakeup() only note them, they go out from the
+ *     tx tasklet.
+ */
+static void hci_uart_direct_receive(void *data, const unsigned char *buf,
+								int count)
+{
+	struct hci_uart *hu = data;
+	unsigned long irqflags;
+	int sending;
+
+	sending = test_and_set_bit(HCI_UART_SENDING, &hu->tx_state);
+
+	spin_lock_irqsave(&hu->rx_lock, irqflags);
+	hu->proto->recv(hu, (void *) buf, count);
+	hu->hdev->stat.byte_rx += count;
+	spin_unlock_irqrestore(&hu->rx_lock, irqflags);
+
+	/* Otherwise whoever is sending picks up the wakeup */
+	if (!sending) {
+		clear_bit(HCI_UART_SENDING, &hu->tx_state);
+		if (test_bit(HCI_UART_TX_WAKEUP, &hu->tx_state))
+			tasklet_schedule(&hu->tx_tasklet);
+	}
+}
+
+static void hci_uart_set_direct(struct hci_uart *hu)
+{
+	if (!rx_direct)
+		return;
+
+	tasklet_init(&hu->tx_tasklet, hci_uart_tx_tasklet, (unsigned long) hu);
+	if (tegra_uart_set_rx_handler(hu->tty, hci_uart_direct_receive, hu))
+		return;
+
+	set_bit(HCI_UART_RX_DIRECT, &hu->flags);
+	BT_INFO("%s receiving directly from the UART", hu->hdev->name);
+}
+#endif
+
 static int hci_uart_register_dev(struct hci_uart *hu)
 {
 	struct hci_dev *hdev;
@@ -438,6 +508,10 @@ static int hci_uart_set_proto(struct hci_uart *hu, int id)
 		return err;
 	}
 
+#ifdef CONFIG_BT_HCIUART_TEGRA_DIRECT
+	hci_uart_set_direct(hu);
+#endif
+
 	return 0;
 }
 
@@ -597,6 +671,11 @@ module_exit(hci_uart_exit);
 module_param(reset, bool, 0644);
 MODULE_PARM_DESC(reset, "Send HCI reset command on initialization");
 
+#ifdef CONFIG_BT_HCIUART_TEGRA_DIRECT
+module_param(rx_direct, bool, 0644);
+MODULE_PARM_DESC(rx_direct, "Receive straight from the Tegra UART DMA ring");
+#endif
+
 MODULE_AUTHOR("Marcel Holtmann <marcel@holtmann.org>");
 MODULE_DESCRIPTION("Bluetooth HCI UART driver ver " VERSION);
 MODULE_VERSION(VERSION);
@@ -70,10 +70,16 @@ struct hci_uart {
 	struct sk_buff		*tx_skb;
 	unsigned long		tx_state;
 	spinlock_t		rx_lock;
+
+#ifdef CONFIG_BT_HCIUART_TEGRA_DIRECT
+	/* sends what the protocol replied from direct rx */
+	struct tasklet_struct	tx_tasklet;
+#endif
 };
 
 /* HCI_UART proto flag bits */
 #define HCI_UART_PROTO_SET	0
+#define HCI_UART_RX_DIRECT	1
 
 /* TX states  */
 #define HCI_UART_SENDING	1
@@ -40,12 +40,16 @@
 #include <linux/init.h>
 #include <linux/miscdevice.h>
 #include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
 #include <asm/uaccess.h>
 
 
 #define RNG_MODULE_NAME		"hw_random"
 #define PFX			RNG_MODULE_NAME ": "
 #define RNG_MISCDEV_MINOR	183 /* official */
+/* what the fill thread asks the RNG for at a time */
+#define RNG_FILLBUF_SIZE	512
 
 
 static struct hwrng *current_rng;
@@ -55,11 +59,35 @@ static int data_avail;
 static u8 rng_buffer[SMP_CACHE_BYTES < 32 ? 32 : SMP_CACHE_BYTES]
 	__cacheline_aligned;
 
+/* the fill thread's own buffer, which it feeds from without rng_mutex */
+static struct task_struct *hwrng_fill;
+static u8 rng_fillbuf[RNG_FILLBUF_SIZE] __cacheline_aligned;
+static unsigned short current_quality;
+static unsigned short default_quality; /* = 0; default to "off" */
+
+module_param(current_quality, ushort, 0644);
+MODULE_PARM_DESC(current_quality,
+		 "current hwrng entropy estimation per mill");
+module_param(default_quality, ushort, 0644);
+MODULE_PARM_DESC(default_quality,
+		 "default entropy content of hwrng per mill");
+
+static void start_khwrngd(void);
+
 static inline int hwrng_init(struct hwrng *rng)
 {
-	if (!rng->init)
-		return 0;
-	return rng->init(rng);
+	int err;
+
+	if (rng->init) {
+		err = rng->init(rng);
+		if (err)
+			return err;
+	}
+	current_quality = min_t(unsigned short,
+				rng->quality ? : default_quality, 1000);
+	if (current_quality && !hwrng_fill)
+		start_khwrngd();
+	return 0;
 }
 
 static inline void hwrng_cleanup(struct hwrng *rng)
@@ -165,6 +193,48 @@ out_unlock:
 }
 
 
+/*
+ * Feed the entropy pool from the current RNG, crediting current_quality
+ * per mill of what it returns.  add_hwgenerator_randomness() sleeps while
+ * the pool is full enough, which is what sets the pace.
+ */
+static int hwrng_fillfn(void *unused)
+{
+	long rc;
+	size_t entropy;
+
+	while (!kthread_should_stop()) {
+		mutex_lock(&rng_mutex);
+		if (!current_rng || !current_quality) {
+			mutex_unlock(&rng_mutex);
+			schedule_timeout_interruptible(HZ);
+			continue;
+		}
+		rc = rng_get_data(current_rng, rng_fillbuf,
+				  sizeof(rng_fillbuf), 1);
+		entropy = rc > 0 ? rc * 8 * current_quality / 1000 : 0;
+		mutex_unlock(&rng_mutex);
+
+		if (rc <= 0) {
+			printk(KERN_WARNING PFX "no data available\n");
+			schedule_timeout_interruptible(10 * HZ);
+			continue;
+		}
+		add_hwgenerator_randomness((void *)rng_fillbuf, rc, entropy);
+	}
+	return 0;
+}
+
+/* called with rng_mutex held */
+static void start_khwrngd(void)
+{
+	hwrng_fill = kthread_run(hwrng_fillfn, NULL, "hwrng");
+	if (IS_ERR(hwrng_fill)) {
+		printk(KERN_ERR PFX "hwrng_fill thread creation failed\n");
+		hwrng_fill = NULL;
+	}
+}
+
 static const struct file_operations rng_chrdev_ops = {
 	.owner		= THIS_MODULE,
 	.open		= rng_dev_open,
@@ -344,6 +414,7 @@ EXPORT_SYMBOL_GPL(hwrng_register);
 
 void hwrng_unregister(struct hwrng *rng)
 {
+	struct task_struct *fill = NULL;
 	int err;
 
 	mutex_lock(&rng_mutex);
@@ -360,10 +431,17 @@ void hwrng_unregister(struct hwrng *rng)
 				current_rng = NULL;
 		}
 	}
-	if (list_empty(&rng_list))
+	if (list_empty(&rng_list)) {
 		unregister_miscdev();
+		fill = hwrng_fill;
+		hwrng_fill = NULL;
+	}
 
 	mutex_unlock(&rng_mutex);
+
+	/* it takes rng_mutex, so it can only be stopped without it */
+	if (fill)
+		kthread_stop(fill);
 }
 EXPORT_SYMBOL_GPL(hwrng_unregister);
 
@@ -248,6 +248,7 @@
 #include <linux/percpu.h>
 #include <linux/cryptohash.h>
 #include <linux/fips.h>
+#include <linux/kthread.h>
 
 #ifdef CONFIG_GENERIC_HARDIRQS
 # include <linux/irq.h>
@@ -722,6 +723,25 @@ void add_disk_randomness(struct gendisk *disk)
 }
 #endif
 
+/*
+ * Used by the hw_random core's fill thread to mix in @count bytes of
+ * output from the current hardware RNG and credit @entropy bits for
+ * them.  Sleeps until the input pool drops below the write wakeup
+ * threshold, the same point at which writers to /dev/random are woken,
+ * so a fast RNG only tops the pool up instead of spinning.
+ */
+void add_hwgenerator_randomness(const char *buffer, size_t count,
+				size_t entropy)
+{
+	struct entropy_store *poolp = &input_pool;
+
+	wait_event_interruptible(random_write_wait, kthread_should_stop() ||
+			poolp->entropy_count < random_write_wakeup_thresh);
+	mix_pool_bytes(poolp, buffer, count);
+	credit_entropy_bits(poolp, entropy);
+}
+EXPORT_SYMBOL_GPL(add_hwgenerator_randomness);
+
 /*********************************************************************
  *
  * Entropy extraction routines
@@ -119,6 +119,14 @@ static unsigned long midrange_freq;
 static unsigned long midrange_go_maxspeed_load;
 static unsigned long midrange_max_boost;
 
+#ifdef CONFIG_CPU_FREQ_SCHED
+/* Raise speed from scheduler enqueue events, not only from the timer */
+static unsigned long sched_util;
+
+/* Floor for tasks under input boost, in kHz; if 0 - policy max */
+static unsigned long input_boost_freq;
+#endif
+
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event);
 
@@ -510,6 +518,83 @@ static int cpufreq_interactive_up_task(void *data)
 	return 0;
 }
 
+#ifdef CONFIG_CPU_FREQ_SCHED
+/*
+ * Runs under the runqueue lock of @cpu. Only ever raises the speed; going
+ * down is still left to the timer and min_sample_time.
+ */
+static bool cpufreq_interactive_sched_update(int cpu, unsigned long util,
+					     unsigned int flags)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	struct cpufreq_policy *policy;
+	unsigned int new_freq;
+	unsigned int index;
+	unsigned int j;
+
+	if (!sched_util || !(flags & SCHED_FREQ_ENQUEUE))
+		return false;
+
+	smp_rmb();
+
+	if (!pcpu->governor_enabled)
+		return false;
+
+	policy = pcpu->policy;
+
+	/*
+	 * The cores share one clock, so the busiest of them sets the pace;
+	 * averaging would leave a single loaded core starved.
+	 */
+	for_each_cpu(j, policy->cpus) {
+		if (j != cpu)
+			util = max(util, sched_cpu_util(j));
+	}
+
+	new_freq = cpufreq_interactive_get_target(
+		util * 100 / SCHED_POWER_SCALE, 0, policy);
+
+	if (flags & SCHED_FREQ_BOOST) {
+		if (!input_boost_freq)
+			new_freq = policy->max;
+		else
+			new_freq = max(new_freq, min_t(unsigned int,
+					input_boost_freq, policy->max));
+	} else if (max_normal_freq && new_freq > max_normal_freq) {
+		new_freq = max_normal_freq;
+	}
+
+	if (new_freq <= pcpu->target_freq)
+		return false;
+
+	if (cpufreq_frequency_table_target(policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_H,
+					   &index))
+		return false;
+
+	new_freq = pcpu->freq_table[index].frequency;
+	if (new_freq <= pcpu->target_freq)
+		return false;
+
+	pcpu->target_freq = new_freq;
+	spin_lock(&up_cpumask_lock);
+	cpumask_set_cpu(cpu, &up_cpumask);
+	spin_unlock(&up_cpumask_lock);
+
+	return true;
+}
+
+static void cpufreq_interactive_sched_kick(void)
+{
+	wake_up_process(up_task);
+}
+
+static struct sched_freq_ops cpufreq_interactive_sched_ops = {
+	.update = cpufreq_interactive_sched_update,
+	.kick = cpufreq_interactive_sched_kick,
+};
+#endif
+
 static void cpufreq_interactive_freq_down(struct work_struct *work)
 {
 	unsigned int cpu;
@@ -589,9 +674,38 @@ DECL_CPUFREQ_INTERACTIVE_ATTR(min_sample_time)
 DECL_CPUFREQ_INTERACTIVE_ATTR(timer_rate)
 DECL_CPUFREQ_INTERACTIVE_ATTR(high_freq_min_delay)
 DECL_CPUFREQ_INTERACTIVE_ATTR(max_normal_freq)
+#ifdef CONFIG_CPU_FREQ_SCHED
+DECL_CPUFREQ_INTERACTIVE_ATTR(sched_util)
+DECL_CPUFREQ_INTERACTIVE_ATTR(input_boost_freq)
+#endif
 
 #undef DECL_CPUFREQ_INTERACTIVE_ATTR
 
+#ifdef CONFIG_CPU_FREQ_SCHED
+/* The boost window is kept by the scheduler, which marks the tasks */
+static ssize_t show_input_boost_ms(struct kobject *kobj,
+	struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sched_freq_boost_ms);
+}
+
+static ssize_t store_input_boost_ms(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	sched_freq_boost_ms = val;
+	return count;
+}
+
+static struct global_attr input_boost_ms_attr = __ATTR(input_boost_ms, 0644,
+		show_input_boost_ms, store_input_boost_ms);
+#endif
+
 static struct attribute *interactive_attributes[] = {
 	&go_maxspeed_load_attr.attr,
 	&midrange_freq_attr.attr,
@@ -605,6 +719,11 @@ static struct attribute *interactive_attributes[] = {
 	&timer_rate_attr.attr,
 	&high_freq_min_delay_attr.attr,
 	&max_normal_freq_attr.attr,
+#ifdef CONFIG_CPU_FREQ_SCHED
+	&sched_util_attr.attr,
+	&input_boost_freq_attr.attr,
+	&input_boost_ms_attr.attr,
+#endif
 	NULL,
 };
 
@@ -669,6 +788,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 				mutex_unlock(&gov_state_lock);
 				return rc;
 			}
+#ifdef CONFIG_CPU_FREQ_SCHED
+			sched_freq_register(&cpufreq_interactive_sched_ops);
+#endif
 		}
 		mutex_unlock(&gov_state_lock);
 
@@ -696,6 +818,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		active_count--;
 
 		if (active_count == 0) {
+#ifdef CONFIG_CPU_FREQ_SCHED
+			sched_freq_unregister(&cpufreq_interactive_sched_ops);
+#endif
 			sysfs_remove_group(cpufreq_global_kobject,
 					&interactive_attr_group);
 			kobject_uevent(interactive_kobj, KOBJ_REMOVE);
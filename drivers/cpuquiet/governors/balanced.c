@@ -184,7 +184,7 @@ static CPU_SPEED_BALANCE balanced_speed_balance(void)
 	unsigned long skewed_speed = balanced_speed / 2;
 	unsigned int nr_cpus = num_online_cpus();
 	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
-	unsigned int avg_nr_run = avg_nr_running();
+	unsigned int avg_nr_run = avg_nr_running_fg();
 	unsigned int nr_run;
 
 	/* balanced: freq targets for all CPUs are above 50% of highest speed
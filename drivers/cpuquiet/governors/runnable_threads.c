@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2012 NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuquiet.h>
+#include <linux/cpumask.h>
+#include <linux/module.h>
+#include <linux/pm_qos_params.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/sched.h>
+
+/*
+ * Runqueue-depth governor: cores are brought on-line as soon as the decayed
+ * average of runnable threads exceeds what the current on-line set can
+ * serve, independently of the cpufreq ramp. Cores are taken off-line only
+ * after the demand has stayed low for down_delay.
+ */
+
+typedef enum {
+	DISABLED,
+	IDLE,
+	RUNNING,
+} RUNNABLES_STATE;
+
+static struct delayed_work runnables_work;
+static struct workqueue_struct *runnables_wq;
+static struct kobject *runnables_kobject;
+static RUNNABLES_STATE runnables_state;
+static DEFINE_MUTEX(runnables_lock);
+
+/* configurable parameters */
+static unsigned int sample_rate = 20;		/* msec */
+static unsigned long down_delay;
+static unsigned long last_change_time;
+
+#define NR_FSHIFT_EXP	3
+#define NR_FSHIFT	(1 << NR_FSHIFT_EXP)
+/* avg run threads * 8 (e.g., 11 = 1.375 threads) */
+static unsigned int nr_run_thresholds[] = {
+/*	1,  2,  3,  4 - on-line cpus target */
+	9, 17, 25, UINT_MAX
+};
+static unsigned int nr_run_hysteresis = 4;	/* 0.5 thread */
+static unsigned int nr_run_last;
+
+static unsigned int get_lightest_loaded_cpu_n(void)
+{
+	unsigned long min_avg_runnables = ULONG_MAX;
+	unsigned int cpu = nr_cpu_ids;
+	int i;
+
+	for_each_online_cpu(i) {
+		unsigned long nr_runnables = avg_cpu_nr_running(i);
+
+		if ((i > 0) && (min_avg_runnables > nr_runnables)) {
+			cpu = i;
+			min_avg_runnables = nr_runnables;
+		}
+	}
+
+	return cpu;
+}
+
+static unsigned int runnables_target_cpus(void)
+{
+	unsigned long avg_nr_run = 0;
+	unsigned int nr_run;
+	int i;
+
+	/* load of background task groups does not bring cores on-line */
+	for_each_online_cpu(i)
+		avg_nr_run += avg_cpu_nr_running_fg(i);
+
+	for (nr_run = 1; nr_run < ARRAY_SIZE(nr_run_thresholds); nr_run++) {
+		unsigned int nr_threshold = nr_run_thresholds[nr_run - 1];
+		if (nr_run_last <= nr_run)
+			nr_threshold += nr_run_hysteresis;
+		if (avg_nr_run <= (nr_threshold << (FSHIFT - NR_FSHIFT_EXP)))
+			break;
+	}
+	nr_run_last = nr_run;
+
+	return nr_run;
+}
+
+static void runnables_work_func(struct work_struct *work)
+{
+	bool up = false;
+	unsigned int cpu = nr_cpu_ids;
+	unsigned long now = jiffies;
+	unsigned int nr_cpus = num_online_cpus();
+	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
+	unsigned int min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
+	unsigned int target;
+
+	mutex_lock(&runnables_lock);
+
+	if (runnables_state != RUNNING) {
+		mutex_unlock(&runnables_lock);
+		return;
+	}
+
+	target = runnables_target_cpus();
+	target = clamp(target, max(min_cpus, 1U), max_cpus);
+
+	if (target > nr_cpus) {
+		cpu = cpumask_next_zero(0, cpu_online_mask);
+		up = true;
+	} else if (target < nr_cpus &&
+		   (now - last_change_time) >= down_delay) {
+		cpu = get_lightest_loaded_cpu_n();
+	}
+
+	queue_delayed_work(runnables_wq, &runnables_work,
+			   msecs_to_jiffies(sample_rate));
+
+	mutex_unlock(&runnables_lock);
+
+	if (cpu < nr_cpu_ids) {
+		last_change_time = now;
+		if (up)
+			cpuquiet_wake_cpu(cpu);
+		else
+			cpuquiet_quiesence_cpu(cpu);
+	}
+}
+
+static void runnables_device_busy(void)
+{
+	mutex_lock(&runnables_lock);
+	if (runnables_state == RUNNING) {
+		runnables_state = IDLE;
+		cancel_delayed_work(&runnables_work);
+	}
+	mutex_unlock(&runnables_lock);
+}
+
+static void runnables_device_free(void)
+{
+	mutex_lock(&runnables_lock);
+	if (runnables_state == IDLE) {
+		runnables_state = RUNNING;
+		/* sample right away so pending demand is served at once */
+		queue_delayed_work(runnables_wq, &runnables_work, 0);
+	}
+	mutex_unlock(&runnables_lock);
+}
+
+static void delay_callback(struct cpuquiet_attribute *attr)
+{
+	unsigned long val;
+
+	if (attr) {
+		val = (*((unsigned long *)(attr->param)));
+		(*((unsigned long *)(attr->param))) = msecs_to_jiffies(val);
+	}
+}
+
+#define NR_RUN_THRESHOLD_ATTRIBUTE(_n)					\
+	static struct cpuquiet_attribute nr_run_threshold_##_n##_attr = { \
+		.attr = {.name = "nr_run_threshold_" __stringify(_n),	\
+			 .mode = 0644 },				\
+		.show = show_uint_attribute,				\
+		.store = store_uint_attribute,				\
+		.param = &nr_run_thresholds[(_n) - 1],			\
+	}
+
+CPQ_BASIC_ATTRIBUTE(sample_rate, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(nr_run_hysteresis, 0644, uint);
+CPQ_ATTRIBUTE(down_delay, 0644, ulong, delay_callback);
+NR_RUN_THRESHOLD_ATTRIBUTE(1);
+NR_RUN_THRESHOLD_ATTRIBUTE(2);
+NR_RUN_THRESHOLD_ATTRIBUTE(3);
+
+static struct attribute *runnables_attributes[] = {
+	&sample_rate_attr.attr,
+	&nr_run_hysteresis_attr.attr,
+	&down_delay_attr.attr,
+	&nr_run_threshold_1_attr.attr,
+	&nr_run_threshold_2_attr.attr,
+	&nr_run_threshold_3_attr.attr,
+	NULL,
+};
+
+static const struct sysfs_ops runnables_sysfs_ops = {
+	.show = cpuquiet_auto_sysfs_show,
+	.store = cpuquiet_auto_sysfs_store,
+};
+
+static struct kobj_type ktype_runnables = {
+	.sysfs_ops = &runnables_sysfs_ops,
+	.default_attrs = runnables_attributes,
+};
+
+static int runnables_sysfs(void)
+{
+	int err;
+
+	runnables_kobject = kzalloc(sizeof(*runnables_kobject),
+				GFP_KERNEL);
+
+	if (!runnables_kobject)
+		return -ENOMEM;
+
+	err = cpuquiet_kobject_init(runnables_kobject, &ktype_runnables,
+				"runnable_threads");
+
+	if (err)
+		kfree(runnables_kobject);
+
+	return err;
+}
+
+static void runnables_stop(void)
+{
+	mutex_lock(&runnables_lock);
+	runnables_state = DISABLED;
+	mutex_unlock(&runnables_lock);
+
+	cancel_delayed_work_sync(&runnables_work);
+	destroy_workqueue(runnables_wq);
+
+	kobject_put(runnables_kobject);
+}
+
+static int runnables_start(void)
+{
+	int err;
+
+	err = runnables_sysfs();
+	if (err)
+		return err;
+
+	runnables_wq = alloc_workqueue("cpuquiet-runnables",
+			WQ_UNBOUND | WQ_RESCUER | WQ_FREEZABLE, 1);
+	if (!runnables_wq) {
+		kobject_put(runnables_kobject);
+		return -ENOMEM;
+	}
+
+	INIT_DELAYED_WORK(&runnables_work, runnables_work_func);
+
+	down_delay = msecs_to_jiffies(500);
+	last_change_time = jiffies;
+	nr_run_last = num_online_cpus();
+
+	mutex_lock(&runnables_lock);
+	runnables_state = RUNNING;
+	queue_delayed_work(runnables_wq, &runnables_work,
+			   msecs_to_jiffies(sample_rate));
+	mutex_unlock(&runnables_lock);
+
+	return 0;
+}
+
+struct cpuquiet_governor runnables_governor = {
+	.name				= "runnable",
+	.start				= runnables_start,
+	.stop				= runnables_stop,
+	.device_free_notification	= runnables_device_free,
+	.device_busy_notification	= runnables_device_busy,
+	.owner				= THIS_MODULE,
+};
+
+static int __init init_runnables(void)
+{
+	return cpuquiet_register_governor(&runnables_governor);
+}
+
+static void __exit exit_runnables(void)
+{
+	cpuquiet_unregister_governor(&runnables_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_runnables);
+module_exit(exit_runnables);
@@ -37,10 +37,19 @@
 #include <crypto/scatterwalk.h>
 #include <crypto/algapi.h>
 #include <crypto/aes.h>
+#include <crypto/aead.h>
+#include <crypto/authenc.h>
 #include <crypto/internal/rng.h>
 #include <crypto/internal/hash.h>
 #include <crypto/sha.h>
 #include <linux/pm_runtime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+#include <linux/hw_random.h>
+#include <linux/random.h>
+#include <linux/rtnetlink.h>
+#include <linux/slab.h>
 
 #include "tegra-se.h"
 
@@ -74,6 +83,18 @@ struct tegra_se_req_context {
 	bool encrypt;	/* Operation type */
 };
 
+/* Security Engine random number generator context */
+struct tegra_se_rng_context {
+	struct tegra_se_dev *se_dev;	/* Security Engine device */
+	struct tegra_se_slot *slot;	/* Security Engine key slot */
+	u32 *dt_buf;	/* Destination buffer pointer */
+	dma_addr_t dt_buf_adr;	/* Destination buffer dma address */
+	u32 *rng_buf;	/* RNG buffer pointer */
+	dma_addr_t rng_buf_adr;	/* RNG buffer dma address */
+	bool use_org_iv;	/* Tells whether original IV is be used
+				or not. If it is false updated IV is used*/
+};
+
 struct tegra_se_dev {
 	struct device *dev;
 	void __iomem *io_reg;	/* se device memory/io */
@@ -94,6 +115,20 @@ struct tegra_se_dev {
 	dma_addr_t ctx_save_buf_adr;	/* LP context buffer dma address*/
 	struct completion complete;	/* Tells the task completion */
 	bool work_q_busy;	/* Work queue busy status */
+	u32 key_slot_hits;	/* AES requests that found their key loaded */
+	u32 key_slot_misses;	/* AES requests that had to load their key */
+	u32 key_slot_evictions;	/* misses that displaced another key */
+	struct dentry *debugfs_root;	/* debugfs directory */
+	struct hwrng hwrng;	/* hw_random view of the RNG */
+	struct tegra_se_rng_context hwrng_ctx;	/* the hwrng's RNG context */
+	u8 *hwrng_buf;	/* RNG output not yet read by the hwrng core */
+	u32 hwrng_avail;	/* bytes left in hwrng_buf */
+	u8 *aead_buf;	/* header of the inner HMAC hash */
+	dma_addr_t aead_buf_adr;	/* aead_buf dma address */
+	u32 aead_hw_reqs;	/* authenc requests run on the engine */
+	u32 aead_hw_batches;	/* times the engine was taken for them */
+	u32 aead_sw_reqs;	/* authenc requests left to the fallback */
+	u32 aead_bad_icv;	/* decryptions that failed the ICV check */
 };
 
 static struct tegra_se_dev *sg_tegra_se_dev;
@@ -101,29 +136,69 @@ static struct tegra_se_dev *sg_tegra_se_dev;
 /* Security Engine AES context */
 struct tegra_se_aes_context {
 	struct tegra_se_dev *se_dev;	/* Security Engine device */
-	struct tegra_se_slot *slot;	/* Security Engine key slot */
+	struct tegra_se_slot *slot;	/* Key slot the key was last loaded in */
 	u32 keylen;	/* key length in bits */
 	u32 op_mode;	/* AES operation mode */
-};
-
-/* Security Engine random number generator context */
-struct tegra_se_rng_context {
-	struct tegra_se_dev *se_dev;	/* Security Engine device */
-	struct tegra_se_slot *slot;	/* Security Engine key slot */
-	u32 *dt_buf;	/* Destination buffer pointer */
-	dma_addr_t dt_buf_adr;	/* Destination buffer dma address */
-	u32 *rng_buf;	/* RNG buffer pointer */
-	dma_addr_t rng_buf_adr;	/* RNG buffer dma address */
-	bool use_org_iv;	/* Tells whether original IV is be used
-				or not. If it is false updated IV is used*/
+	u8 key[TEGRA_SE_KEY_256_SIZE];	/* Key, loaded on demand */
+	u32 key_gen;	/* Key generation, 0 for the SSK */
 };
 
 /* Security Engine SHA context */
 struct tegra_se_sha_context {
 	struct tegra_se_dev	*se_dev;	/* Security Engine device */
 	u32 op_mode;	/* SHA operation mode */
+	struct crypto_shash *fallback;	/* CPU hash for small requests */
+};
+
+/*
+ * Setting up the engine costs more than hashing a few kB on the CPU, so
+ * digests below this many bytes, and all init/update/final sequences,
+ * which the engine cannot do piecewise, go to the fallback shash.
+ */
+static unsigned int sha_hw_min_bytes = 4096;
+module_param(sha_hw_min_bytes, uint, 0644);
+MODULE_PARM_DESC(sha_hw_min_bytes,
+		 "Smallest digest() request hashed by the engine (bytes)");
+
+/*
+ * The RNG is an X9.31 generator, so what it adds to the pool is only as
+ * good as its seed; the credit is a policy knob.  0 registers the hwrng
+ * for /dev/hwrng without feeding the pool from the kernel.
+ */
+static unsigned short hwrng_quality = 128;
+module_param(hwrng_quality, ushort, 0444);
+MODULE_PARM_DESC(hwrng_quality,
+		 "Entropy credited for hwrng output (bits per 1000 bits)");
+
+/* Security Engine AES-CBC + HMAC-SHA (authenc) context */
+struct tegra_se_aead_context {
+	struct tegra_se_aes_context aes;	/* cipher key, kept in key slots */
+	u32 op_mode;	/* SHA mode of the inner hash */
+	struct crypto_shash *hash;	/* CPU hash for the key and outer hash */
+	struct crypto_cipher *iv_gen;	/* encrypts the generated IVs */
+	struct crypto_aead *fallback;	/* software authenc */
+	u8 ipad[SHA256_BLOCK_SIZE];	/* HMAC key ^ ipad */
+	u8 *opad_state;	/* hash state after HMAC key ^ opad */
+	u8 salt[TEGRA_SE_AES_IV_SIZE];	/* of the generated IVs */
 };
 
+/* Security Engine authenc request context */
+struct tegra_se_aead_req_context {
+	bool encrypt;	/* Operation type */
+	u8 *iv;	/* IV, the generated one for givencrypt */
+	struct aead_request fallback_req;	/* last, its context follows */
+};
+
+/*
+ * Two engine operations, the interrupts and the work switch cost more than
+ * AES and SHA of a small packet on the CPU; authenc requests with less
+ * data than this go to the software fallback.
+ */
+static unsigned int aead_hw_min_bytes = 256;
+module_param(aead_hw_min_bytes, uint, 0644);
+MODULE_PARM_DESC(aead_hw_min_bytes,
+		 "Smallest authenc request run on the engine (bytes)");
+
 /* Security Engine AES CMAC context */
 struct tegra_se_aes_cmac_context {
 	struct tegra_se_dev *se_dev;	/* Security Engine device */
@@ -141,6 +216,7 @@ struct tegra_se_slot {
 	struct list_head node;
 	u8 slot_num;	/* Key slot number */
 	bool available; /* Tells whether key slot is free to use */
+	u32 key_gen;	/* Generation of the AES key cached here, 0 if none */
 };
 
 static struct tegra_se_slot ssk_slot = {
@@ -159,8 +235,14 @@ struct tegra_se_ll {
 	u32 data_len; /* Data length in DMA buffer */
 };
 
+/*
+ * Slots not held by an RNG or CMAC context cache ablkcipher keys.  The
+ * list is kept in LRU order; every setkey() gets a new generation so a
+ * slot caches one key of one tfm.
+ */
 static LIST_HEAD(key_slot);
 static DEFINE_SPINLOCK(key_slot_lock);
+static u32 key_slot_gen;
 static DEFINE_MUTEX(se_hw_lock);
 
 /* create a work for handling the async transfers */
@@ -209,25 +291,40 @@ static void tegra_se_free_key_slot(struct tegra_se_slot *slot)
 	if (slot) {
 		spin_lock(&key_slot_lock);
 		slot->available = true;
+		slot->key_gen = 0;
 		spin_unlock(&key_slot_lock);
 	}
 }
 
+/* the first empty slot, else the least recently used cached one */
+static struct tegra_se_slot *tegra_se_find_key_slot(void)
+{
+	struct tegra_se_slot *slot, *lru = NULL;
+
+	list_for_each_entry(slot, &key_slot, node) {
+		if (!slot->available)
+			continue;
+		if (!slot->key_gen)
+			return slot;
+		if (!lru)
+			lru = slot;
+	}
+
+	return lru;
+}
+
 static struct tegra_se_slot *tegra_se_alloc_key_slot(void)
 {
-	struct tegra_se_slot *slot = NULL;
-	bool found = false;
+	struct tegra_se_slot *slot;
 
 	spin_lock(&key_slot_lock);
-	list_for_each_entry(slot, &key_slot, node) {
-		if (slot->available) {
-			slot->available = false;
-			found = true;
-			break;
-		}
+	slot = tegra_se_find_key_slot();
+	if (slot) {
+		slot->available = false;
+		slot->key_gen = 0;
 	}
 	spin_unlock(&key_slot_lock);
-	return found ? slot : NULL;
+	return slot;
 }
 
 static int tegra_init_key_slot(struct tegra_se_dev *se_dev)
@@ -683,33 +780,18 @@ static void tegra_se_free_ll_buf(struct tegra_se_dev *se_dev)
 	}
 }
 
-static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev,
-	struct ablkcipher_request *req)
+/*
+ * Map the first @total bytes of @src_sg and @dst_sg and append them to the
+ * linked lists at *src_ll and *dst_ll, leaving both pointers past the last
+ * entry written.
+ */
+static int tegra_se_map_sgs(struct tegra_se_dev *se_dev,
+	struct scatterlist *src_sg, struct scatterlist *dst_sg, u32 total,
+	struct tegra_se_ll **psrc_ll, struct tegra_se_ll **pdst_ll)
 {
-	struct scatterlist *src_sg, *dst_sg;
-	struct tegra_se_ll *src_ll, *dst_ll;
-	u32 total, num_src_sgs, num_dst_sgs;
+	struct tegra_se_ll *src_ll = *psrc_ll, *dst_ll = *pdst_ll;
 	int ret = 0;
 
-	num_src_sgs = tegra_se_count_sgs(req->src, req->nbytes);
-	num_dst_sgs = tegra_se_count_sgs(req->dst, req->nbytes);
-
-	if ((num_src_sgs > SE_MAX_SRC_SG_COUNT) ||
-		(num_dst_sgs > SE_MAX_DST_SG_COUNT)) {
-			dev_err(se_dev->dev, "num of SG buffers are more\n");
-			return -EINVAL;
-	}
-
-	*se_dev->src_ll_buf = num_src_sgs-1;
-	*se_dev->dst_ll_buf = num_dst_sgs-1;
-
-	src_ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
-	dst_ll = (struct tegra_se_ll *)(se_dev->dst_ll_buf + 1);
-
-	src_sg = req->src;
-	dst_sg = req->dst;
-	total = req->nbytes;
-
 	while (total) {
 		ret = dma_map_sg(se_dev->dev, src_sg, 1, DMA_TO_DEVICE);
 		if (!ret) {
@@ -737,62 +819,376 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev,
 		src_ll++;
 		WARN_ON(((total != 0) && (!src_sg || !dst_sg)));
 	}
-	return ret;
+
+	*psrc_ll = src_ll;
+	*pdst_ll = dst_ll;
+	return 0;
+}
+
+static void tegra_se_unmap_sgs(struct tegra_se_dev *se_dev,
+	struct scatterlist *src_sg, struct scatterlist *dst_sg, u32 total)
+{
+	while (total) {
+		dma_unmap_sg(se_dev->dev, dst_sg, 1, DMA_FROM_DEVICE);
+		dma_unmap_sg(se_dev->dev, src_sg, 1, DMA_TO_DEVICE);
+		total -= min(src_sg->length, total);
+		src_sg = sg_next(src_sg);
+		dst_sg = sg_next(dst_sg);
+	}
+}
+
+/* Append the buffers of @req to the linked lists at *src_ll and *dst_ll */
+static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev,
+	struct ablkcipher_request *req, struct tegra_se_ll **psrc_ll,
+	struct tegra_se_ll **pdst_ll)
+{
+	return tegra_se_map_sgs(se_dev, req->src, req->dst, req->nbytes,
+		psrc_ll, pdst_ll);
 }
 
 static void tegra_se_dequeue_complete_req(struct tegra_se_dev *se_dev,
 	struct ablkcipher_request *req)
 {
-	struct scatterlist *src_sg, *dst_sg;
-	u32 total;
+	if (req)
+		tegra_se_unmap_sgs(se_dev, req->src, req->dst, req->nbytes);
+}
 
-	if (req) {
-		src_sg = req->src;
-		dst_sg = req->dst;
-		total = req->nbytes;
-		while (total) {
-			dma_unmap_sg(se_dev->dev, dst_sg, 1, DMA_FROM_DEVICE);
-			dma_unmap_sg(se_dev->dev, src_sg, 1, DMA_TO_DEVICE);
-			total -= min(src_sg->length, total);
-			src_sg = sg_next(src_sg);
-			dst_sg = sg_next(dst_sg);
-		}
+/*
+ * Find the slot holding the key of @ctx, loading it into the least
+ * recently used one if it is not resident.  Called with se_hw_lock held,
+ * so no other operation can be using a slot we evict.
+ */
+static struct tegra_se_slot *tegra_se_get_aes_key_slot(
+	struct tegra_se_dev *se_dev, struct tegra_se_aes_context *ctx)
+{
+	struct tegra_se_slot *slot = ctx->slot;
+
+	if (slot == &ssk_slot)
+		return slot;
+
+	if (!ctx->key_gen) {
+		dev_err(se_dev->dev, "no key set\n");
+		return NULL;
+	}
+
+	spin_lock(&key_slot_lock);
+	if (slot && (slot->key_gen == ctx->key_gen)) {
+		list_move_tail(&slot->node, &key_slot);
+		se_dev->key_slot_hits++;
+		spin_unlock(&key_slot_lock);
+		return slot;
 	}
+
+	slot = tegra_se_find_key_slot();
+	if (!slot) {
+		spin_unlock(&key_slot_lock);
+		dev_err(se_dev->dev, "no free key slot\n");
+		return NULL;
+	}
+	if (slot->key_gen)
+		se_dev->key_slot_evictions++;
+	se_dev->key_slot_misses++;
+	slot->key_gen = ctx->key_gen;
+	list_move_tail(&slot->node, &key_slot);
+	ctx->slot = slot;
+	spin_unlock(&key_slot_lock);
+
+	tegra_se_write_key_table(ctx->key, ctx->keylen, slot->slot_num,
+		SE_KEY_TABLE_TYPE_KEY);
+
+	return slot;
+}
+
+/* forget the key of @ctx, leaving its slot free for the next miss */
+static void tegra_se_put_aes_key_slot(struct tegra_se_aes_context *ctx)
+{
+	spin_lock(&key_slot_lock);
+	if (ctx->slot && (ctx->slot != &ssk_slot) &&
+		(ctx->slot->key_gen == ctx->key_gen))
+		ctx->slot->key_gen = 0;
+	ctx->slot = NULL;
+	spin_unlock(&key_slot_lock);
 }
 
-static void tegra_se_process_new_req(struct crypto_async_request *async_req)
+/*
+ * Run @count requests, which tegra_se_can_batch() found to form one
+ * continuous stream, as a single operation over the preallocated linked
+ * lists.
+ */
+static void tegra_se_process_new_req(struct ablkcipher_request **reqs,
+	int count)
 {
 	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
-	struct ablkcipher_request *req = ablkcipher_request_cast(async_req);
+	struct ablkcipher_request *req = reqs[0];
 	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
 	struct tegra_se_aes_context *aes_ctx =
 			crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
-	int ret = 0;
+	struct tegra_se_ll *src_ll, *dst_ll;
+	struct tegra_se_slot *slot;
+	u32 nbytes = 0;
+	int i, mapped = 0, ret = 0;
 
 	/* take access to the hw */
 	mutex_lock(&se_hw_lock);
 
+	slot = tegra_se_get_aes_key_slot(se_dev, aes_ctx);
+	if (!slot) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	/* write IV */
 	if (req->info) {
 		if (req_ctx->op_mode == SE_AES_OP_MODE_CTR) {
 			tegra_se_write_seed(se_dev, (u32 *)req->info);
 		} else {
 			tegra_se_write_key_table(req->info,
-				TEGRA_SE_AES_IV_SIZE,
-				aes_ctx->slot->slot_num,
+				TEGRA_SE_AES_IV_SIZE, slot->slot_num,
 				SE_KEY_TABLE_TYPE_ORGIV);
 		}
 	}
-	tegra_se_setup_ablk_req(se_dev, req);
-	tegra_se_config_algo(se_dev, req_ctx->op_mode, req_ctx->encrypt,
-		aes_ctx->keylen);
-	tegra_se_config_crypto(se_dev, req_ctx->op_mode, req_ctx->encrypt,
-			aes_ctx->slot->slot_num, req->info ? true : false);
-	ret = tegra_se_start_operation(se_dev, req->nbytes, false);
-	tegra_se_dequeue_complete_req(se_dev, req);
+
+	src_ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
+	dst_ll = (struct tegra_se_ll *)(se_dev->dst_ll_buf + 1);
+	for (mapped = 0; mapped < count; mapped++) {
+		ret = tegra_se_setup_ablk_req(se_dev, reqs[mapped],
+			&src_ll, &dst_ll);
+		if (ret)
+			break;
+		nbytes += reqs[mapped]->nbytes;
+	}
+	*se_dev->src_ll_buf = src_ll -
+		(struct tegra_se_ll *)(se_dev->src_ll_buf + 1) - 1;
+	*se_dev->dst_ll_buf = dst_ll -
+		(struct tegra_se_ll *)(se_dev->dst_ll_buf + 1) - 1;
+
+	if (!ret) {
+		tegra_se_config_algo(se_dev, req_ctx->op_mode,
+			req_ctx->encrypt, aes_ctx->keylen);
+		tegra_se_config_crypto(se_dev, req_ctx->op_mode,
+			req_ctx->encrypt, slot->slot_num,
+			req->info ? true : false);
+		ret = tegra_se_start_operation(se_dev, nbytes, false);
+	}
+out:
+	for (i = 0; i < mapped; i++)
+		tegra_se_dequeue_complete_req(se_dev, reqs[i]);
 
 	mutex_unlock(&se_hw_lock);
-	req->base.complete(&req->base, ret);
+	for (i = 0; i < count; i++)
+		reqs[i]->base.complete(&reqs[i]->base, ret);
+}
+
+/* does the counter block @next follow @prev after @nblocks blocks? */
+static bool tegra_se_ctr_follows(const u8 *prev, u32 nblocks, const u8 *next)
+{
+	u8 ctr[TEGRA_SE_AES_IV_SIZE];
+	int i;
+
+	memcpy(ctr, prev, TEGRA_SE_AES_IV_SIZE);
+	for (i = TEGRA_SE_AES_IV_SIZE - 1; i >= 0 && nblocks; i--) {
+		nblocks += ctr[i];
+		ctr[i] = nblocks & 0xff;
+		nblocks >>= 8;
+	}
+
+	return !memcmp(ctr, next, TEGRA_SE_AES_IV_SIZE);
+}
+
+/*
+ * Can @next run in the same operation as @prev, which ends the batch so
+ * far?  The engine takes one key, one mode and one IV per operation,
+ * so the two must share the first two and @next must carry on where @prev
+ * leaves the IV: always true for ECB, true for CTR when the counters are
+ * consecutive, and never for the chained modes, whose every request
+ * restarts from its own IV.
+ */
+static bool tegra_se_can_batch(struct ablkcipher_request *prev,
+	struct ablkcipher_request *next)
+{
+	struct tegra_se_req_context *prev_ctx = ablkcipher_request_ctx(prev);
+	struct tegra_se_req_context *next_ctx = ablkcipher_request_ctx(next);
+	struct tegra_se_aes_context *prev_aes =
+			crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(prev));
+	struct tegra_se_aes_context *next_aes =
+			crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(next));
+
+	if ((prev_aes->key_gen != next_aes->key_gen) ||
+		(prev_aes->keylen != next_aes->keylen) ||
+		(prev_ctx->op_mode != next_ctx->op_mode) ||
+		(prev_ctx->encrypt != next_ctx->encrypt))
+		return false;
+
+	switch (prev_ctx->op_mode) {
+	case SE_AES_OP_MODE_ECB:
+		return true;
+	case SE_AES_OP_MODE_CTR:
+		if (!prev->info || !next->info ||
+			(prev->nbytes % TEGRA_SE_AES_BLOCK_SIZE))
+			return false;
+		return tegra_se_ctr_follows(prev->info,
+			prev->nbytes / TEGRA_SE_AES_BLOCK_SIZE, next->info);
+	default:
+		return false;
+	}
+}
+
+static bool tegra_se_is_aead(struct crypto_async_request *req)
+{
+	return (crypto_tfm_alg_type(req->tfm) == CRYPTO_ALG_TYPE_AEAD);
+}
+
+/*
+ * Hash @hdrlen bytes of aead_buf followed by the @n buffers on the source
+ * linked list.  The header goes in as the first entry for the operation
+ * and the list is left as it was found.
+ */
+static int tegra_se_aead_hash(struct tegra_se_dev *se_dev, u32 op_mode,
+	u32 hdrlen, int n, u32 nbytes, u8 *digest, u32 digestsize)
+{
+	struct tegra_se_ll *ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
+	int ret;
+
+	memmove(ll + 1, ll, n * sizeof(*ll));
+	ll->addr = se_dev->aead_buf_adr;
+	ll->data_len = hdrlen;
+	*se_dev->src_ll_buf = n;
+
+	tegra_se_config_algo(se_dev, op_mode, false, 0);
+	tegra_se_config_sha(se_dev, hdrlen + nbytes);
+	ret = tegra_se_start_operation(se_dev, 0, false);
+	if (!ret)
+		tegra_se_read_hash_result(se_dev, digest, digestsize, true);
+
+	memmove(ll, ll + 1, n * sizeof(*ll));
+	*se_dev->src_ll_buf = n - 1;
+	return ret;
+}
+
+/*
+ * Run one authenc request as two operations over one mapping: AES-CBC,
+ * and SHA over (key ^ ipad) || assoc || IV || ciphertext, the inner HMAC
+ * hash.  The engine cannot resume a hash from a saved state, so the ipad
+ * block goes in front of the message in aead_buf with the assoc data and
+ * the IV.  Only the outer hash, over one block and the inner digest, is
+ * done on the CPU.  Called with se_hw_lock held.
+ */
+static int tegra_se_aead_hw(struct tegra_se_dev *se_dev,
+	struct aead_request *req)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct tegra_se_aead_context *ctx = crypto_aead_ctx(tfm);
+	struct tegra_se_aead_req_context *req_ctx = aead_request_ctx(req);
+	u32 bs = crypto_shash_blocksize(ctx->hash);
+	u32 ds = crypto_shash_digestsize(ctx->hash);
+	u32 ivsize = crypto_aead_ivsize(tfm);
+	u32 authsize = crypto_aead_authsize(tfm);
+	u32 hdrlen = bs + req->assoclen + ivsize;
+	u32 cryptlen = req->cryptlen;
+	struct tegra_se_ll *src_ll, *dst_ll, *ll;
+	struct tegra_se_slot *slot;
+	u8 digest[SHA256_DIGEST_SIZE];
+	u8 icv[SHA256_DIGEST_SIZE];
+	struct {
+		struct shash_desc shash;
+		char ctx[crypto_shash_descsize(ctx->hash)];
+	} desc;
+	int n, ret;
+
+	if (!req_ctx->encrypt)
+		cryptlen -= authsize;
+
+	slot = tegra_se_get_aes_key_slot(se_dev, &ctx->aes);
+	if (!slot)
+		return -ENOMEM;
+
+	memcpy(se_dev->aead_buf, ctx->ipad, bs);
+	scatterwalk_map_and_copy(se_dev->aead_buf + bs, req->assoc, 0,
+		req->assoclen, 0);
+	memcpy(se_dev->aead_buf + bs + req->assoclen, req_ctx->iv, ivsize);
+
+	ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
+	src_ll = ll;
+	dst_ll = (struct tegra_se_ll *)(se_dev->dst_ll_buf + 1);
+	ret = tegra_se_map_sgs(se_dev, req->src, req->dst, cryptlen,
+		&src_ll, &dst_ll);
+	if (ret)
+		return ret;
+	n = src_ll - ll;
+	*se_dev->src_ll_buf = n - 1;
+	*se_dev->dst_ll_buf = n - 1;
+
+	tegra_se_write_key_table(req_ctx->iv, TEGRA_SE_AES_IV_SIZE,
+		slot->slot_num, SE_KEY_TABLE_TYPE_ORGIV);
+
+	/* decryption checks the ciphertext it was given */
+	if (!req_ctx->encrypt) {
+		ret = tegra_se_aead_hash(se_dev, ctx->op_mode, hdrlen, n,
+			cryptlen, digest, ds);
+		if (ret)
+			goto out;
+	}
+
+	tegra_se_config_algo(se_dev, SE_AES_OP_MODE_CBC, req_ctx->encrypt,
+		ctx->aes.keylen);
+	tegra_se_config_crypto(se_dev, SE_AES_OP_MODE_CBC, req_ctx->encrypt,
+		slot->slot_num, true);
+	ret = tegra_se_start_operation(se_dev, cryptlen, false);
+	if (ret)
+		goto out;
+
+	/* encryption hashes what the engine just wrote */
+	if (req_ctx->encrypt) {
+		memcpy(ll, dst_ll - n, n * sizeof(*ll));
+		ret = tegra_se_aead_hash(se_dev, ctx->op_mode, hdrlen, n,
+			cryptlen, digest, ds);
+	}
+out:
+	tegra_se_unmap_sgs(se_dev, req->src, req->dst, cryptlen);
+	if (ret)
+		return ret;
+
+	desc.shash.tfm = ctx->hash;
+	desc.shash.flags = 0;
+	ret = crypto_shash_import(&desc.shash, ctx->opad_state) ?:
+		crypto_shash_finup(&desc.shash, digest, ds, digest);
+	if (ret)
+		return ret;
+
+	if (req_ctx->encrypt) {
+		scatterwalk_map_and_copy(digest, req->dst, cryptlen, authsize,
+			1);
+	} else {
+		scatterwalk_map_and_copy(icv, req->src, cryptlen, authsize, 0);
+		if (memcmp(icv, digest, authsize)) {
+			se_dev->aead_bad_icv++;
+			ret = -EBADMSG;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Run @count authenc requests with the engine taken once.  Each request
+ * still needs operations of its own, as every one has its own IV, but the
+ * key stays in its slot from one packet of a flow to the next.
+ */
+static void tegra_se_process_aead_reqs(struct aead_request **reqs,
+	int count)
+{
+	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
+	int i, ret[SE_MAX_BATCH_REQS];
+
+	mutex_lock(&se_hw_lock);
+	for (i = 0; i < count; i++)
+		ret[i] = tegra_se_aead_hw(se_dev, reqs[i]);
+	se_dev->aead_hw_reqs += count;
+	se_dev->aead_hw_batches++;
+	mutex_unlock(&se_hw_lock);
+
+	for (i = 0; i < count; i++)
+		reqs[i]->base.complete(&reqs[i]->base, ret[i]);
 }
 
 static irqreturn_t tegra_se_irq(int irq, void *dev)
@@ -816,44 +1212,88 @@ static void tegra_se_work_handler(struct work_struct *work)
 {
 	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
 	struct crypto_async_request *async_req = NULL;
-	struct crypto_async_request *backlog = NULL;
+	struct crypto_async_request *backlog[SE_MAX_BATCH_REQS];
+	struct ablkcipher_request *reqs[SE_MAX_BATCH_REQS];
+	struct aead_request *aead_reqs[SE_MAX_BATCH_REQS];
+	struct ablkcipher_request *next;
+	u32 num_src_sgs, num_dst_sgs;
+	int i, count, nbacklog;
+	bool aead;
 
 	pm_runtime_get_sync(se_dev->dev);
 
 	do {
+		count = 0;
+		nbacklog = 0;
+		num_src_sgs = 0;
+		num_dst_sgs = 0;
+
 		spin_lock_irq(&se_dev->lock);
-		backlog = crypto_get_backlog(&se_dev->queue);
-		async_req = crypto_dequeue_request(&se_dev->queue);
-		if (!async_req)
+		do {
+			backlog[nbacklog] = crypto_get_backlog(&se_dev->queue);
+			async_req = crypto_dequeue_request(&se_dev->queue);
+			if (!async_req)
+				break;
+			if (backlog[nbacklog])
+				nbacklog++;
+			aead = tegra_se_is_aead(async_req);
+			if (aead) {
+				aead_reqs[count++] = container_of(async_req,
+					struct aead_request, base);
+			} else {
+				reqs[count] = ablkcipher_request_cast(async_req);
+				num_src_sgs += tegra_se_count_sgs(
+					reqs[count]->src, reqs[count]->nbytes);
+				num_dst_sgs += tegra_se_count_sgs(
+					reqs[count]->dst, reqs[count]->nbytes);
+				count++;
+			}
+
+			/* peek at the next request, and stop if it won't fit */
+			if ((count == SE_MAX_BATCH_REQS) ||
+				list_empty(&se_dev->queue.list))
+				break;
+			async_req = list_first_entry(&se_dev->queue.list,
+				struct crypto_async_request, list);
+			/* authenc requests go together, whatever their tfm */
+			if (tegra_se_is_aead(async_req) != aead)
+				break;
+			if (aead)
+				continue;
+			next = ablkcipher_request_cast(async_req);
+			if (!tegra_se_can_batch(reqs[count - 1], next) ||
+				(num_src_sgs + tegra_se_count_sgs(next->src,
+					next->nbytes) > SE_MAX_SRC_SG_COUNT) ||
+				(num_dst_sgs + tegra_se_count_sgs(next->dst,
+					next->nbytes) > SE_MAX_DST_SG_COUNT))
+				break;
+		} while (1);
+		if (!count)
 			se_dev->work_q_busy = false;
 
 		spin_unlock_irq(&se_dev->lock);
 
-		if (backlog) {
-			backlog->complete(backlog, -EINPROGRESS);
-			backlog = NULL;
-		}
+		for (i = 0; i < nbacklog; i++)
+			backlog[i]->complete(backlog[i], -EINPROGRESS);
 
-		if (async_req) {
-			tegra_se_process_new_req(async_req);
-			async_req = NULL;
-		}
+		if (count && aead)
+			tegra_se_process_aead_reqs(aead_reqs, count);
+		else if (count)
+			tegra_se_process_new_req(reqs, count);
 	} while (se_dev->work_q_busy);
 	pm_runtime_put(se_dev->dev);
 }
 
-static int tegra_se_aes_queue_req(struct ablkcipher_request *req)
+/* queue @req for the work handler, and kick it if it is idle */
+static int tegra_se_enqueue_req(struct tegra_se_dev *se_dev,
+	struct crypto_async_request *req)
 {
-	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
 	unsigned long flags;
 	bool idle = true;
 	int err = 0;
 
-	if (!tegra_se_count_sgs(req->src, req->nbytes))
-		return -EINVAL;
-
 	spin_lock_irqsave(&se_dev->lock, flags);
-	err = ablkcipher_enqueue_request(&se_dev->queue, req);
+	err = crypto_enqueue_request(&se_dev->queue, req);
 	if (se_dev->work_q_busy)
 		idle = false;
 	spin_unlock_irqrestore(&se_dev->lock, flags);
@@ -868,6 +1308,25 @@ static int tegra_se_aes_queue_req(struct ablkcipher_request *req)
 	return err;
 }
 
+static int tegra_se_aes_queue_req(struct ablkcipher_request *req)
+{
+	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
+	u32 num_src_sgs, num_dst_sgs;
+
+	num_src_sgs = tegra_se_count_sgs(req->src, req->nbytes);
+	num_dst_sgs = tegra_se_count_sgs(req->dst, req->nbytes);
+	if (!num_src_sgs)
+		return -EINVAL;
+
+	if ((num_src_sgs > SE_MAX_SRC_SG_COUNT) ||
+		(num_dst_sgs > SE_MAX_DST_SG_COUNT)) {
+			dev_err(se_dev->dev, "num of SG buffers are more\n");
+			return -EINVAL;
+	}
+
+	return tegra_se_enqueue_req(se_dev, &req->base);
+}
+
 static int tegra_se_aes_cbc_encrypt(struct ablkcipher_request *req)
 {
 	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
@@ -948,18 +1407,10 @@ static int tegra_se_aes_ofb_decrypt(struct ablkcipher_request *req)
 	return tegra_se_aes_queue_req(req);
 }
 
-static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
+static int tegra_se_aes_ctx_setkey(struct tegra_se_aes_context *ctx,
 	const u8 *key, u32 keylen)
 {
-	struct tegra_se_aes_context *ctx = crypto_ablkcipher_ctx(tfm);
 	struct tegra_se_dev *se_dev = ctx->se_dev;
-	struct tegra_se_slot *pslot;
-	u8 *pdata = (u8 *)key;
-
-	if (!ctx) {
-		dev_err(se_dev->dev, "invalid context");
-		return -EINVAL;
-	}
 
 	if ((keylen != TEGRA_SE_KEY_128_SIZE) &&
 		(keylen != TEGRA_SE_KEY_192_SIZE) &&
@@ -968,35 +1419,36 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 		return -EINVAL;
 	}
 
+	/* the key goes to a slot when a request first needs it */
+	tegra_se_put_aes_key_slot(ctx);
 	if (key) {
-		if (!ctx->slot || (ctx->slot &&
-		    ctx->slot->slot_num == ssk_slot.slot_num)) {
-			pslot = tegra_se_alloc_key_slot();
-			if (!pslot) {
-				dev_err(se_dev->dev, "no free key slot\n");
-				return -ENOMEM;
-			}
-			ctx->slot = pslot;
-		}
+		memcpy(ctx->key, key, keylen);
 		ctx->keylen = keylen;
+		spin_lock(&key_slot_lock);
+		if (!++key_slot_gen)
+			++key_slot_gen;
+		ctx->key_gen = key_slot_gen;
+		spin_unlock(&key_slot_lock);
 	} else {
-		tegra_se_free_key_slot(ctx->slot);
 		ctx->slot = &ssk_slot;
 		ctx->keylen = AES_KEYSIZE_128;
+		ctx->key_gen = 0;
 	}
 
-	/* take access to the hw */
-	mutex_lock(&se_hw_lock);
-	pm_runtime_get_sync(se_dev->dev);
+	return 0;
+}
 
-	/* load the key */
-	tegra_se_write_key_table(pdata, keylen, ctx->slot->slot_num,
-		SE_KEY_TABLE_TYPE_KEY);
+static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
+	const u8 *key, u32 keylen)
+{
+	struct tegra_se_aes_context *ctx = crypto_ablkcipher_ctx(tfm);
 
-	pm_runtime_put(se_dev->dev);
-	mutex_unlock(&se_hw_lock);
+	if (!ctx) {
+		pr_err(PFX "invalid context");
+		return -EINVAL;
+	}
 
-	return 0;
+	return tegra_se_aes_ctx_setkey(ctx, key, keylen);
 }
 
 static int tegra_se_aes_cra_init(struct crypto_tfm *tfm)
@@ -1013,28 +1465,264 @@ static void tegra_se_aes_cra_exit(struct crypto_tfm *tfm)
 {
 	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(tfm);
 
-	tegra_se_free_key_slot(ctx->slot);
-	ctx->slot = NULL;
+	tegra_se_put_aes_key_slot(ctx);
+	memset(ctx->key, 0, sizeof(ctx->key));
 }
 
-static int tegra_se_rng_init(struct crypto_tfm *tfm)
+static int tegra_se_aead_fallback(struct aead_request *req, u8 *iv,
+	bool encrypt)
 {
-	struct tegra_se_rng_context *rng_ctx = crypto_tfm_ctx(tfm);
-	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
+	struct tegra_se_aead_context *ctx =
+			crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct tegra_se_aead_req_context *req_ctx = aead_request_ctx(req);
+	struct aead_request *subreq = &req_ctx->fallback_req;
+
+	aead_request_set_tfm(subreq, ctx->fallback);
+	aead_request_set_callback(subreq, req->base.flags,
+		req->base.complete, req->base.data);
+	aead_request_set_crypt(subreq, req->src, req->dst, req->cryptlen, iv);
+	aead_request_set_assoc(subreq, req->assoc, req->assoclen);
+	sg_tegra_se_dev->aead_sw_reqs++;
+
+	return encrypt ? crypto_aead_encrypt(subreq) :
+		crypto_aead_decrypt(subreq);
+}
+
+static int tegra_se_aead_queue_req(struct aead_request *req, u8 *iv,
+	bool encrypt)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(req);
+	struct tegra_se_aead_req_context *req_ctx = aead_request_ctx(req);
+	u32 cryptlen = req->cryptlen;
+	int num_src_sgs, num_dst_sgs;
+
+	if (!encrypt) {
+		if (cryptlen < crypto_aead_authsize(tfm))
+			return -EINVAL;
+		cryptlen -= crypto_aead_authsize(tfm);
+	}
+
+	num_src_sgs = tegra_se_count_sgs(req->src, cryptlen);
+	num_dst_sgs = tegra_se_count_sgs(req->dst, cryptlen);
+	if (!cryptlen || (cryptlen < aead_hw_min_bytes) ||
+		(cryptlen % TEGRA_SE_AES_BLOCK_SIZE) ||
+		(req->assoclen > SE_AEAD_MAX_ASSOC_SIZE) ||
+		!num_src_sgs || !num_dst_sgs ||
+		(num_src_sgs + 1 > SE_MAX_SRC_SG_COUNT) ||
+		(num_dst_sgs > SE_MAX_DST_SG_COUNT))
+		return tegra_se_aead_fallback(req, iv, encrypt);
+
+	req_ctx->encrypt = encrypt;
+	req_ctx->iv = iv;
+
+	return tegra_se_enqueue_req(sg_tegra_se_dev, &req->base);
+}
+
+static int tegra_se_aead_encrypt(struct aead_request *req)
+{
+	return tegra_se_aead_queue_req(req, req->iv, true);
+}
+
+static int tegra_se_aead_decrypt(struct aead_request *req)
+{
+	return tegra_se_aead_queue_req(req, req->iv, false);
+}
+
+static int tegra_se_aead_givencrypt(struct aead_givcrypt_request *req)
+{
+	struct aead_request *areq = &req->areq;
+	struct tegra_se_aead_context *ctx =
+			crypto_aead_ctx(crypto_aead_reqtfm(areq));
+	u8 iv[TEGRA_SE_AES_IV_SIZE];
+
+	/* E(salt ^ seq): unique per packet and not predictable for CBC */
+	memcpy(iv, ctx->salt, TEGRA_SE_AES_IV_SIZE);
+	*(__be64 *)(iv + TEGRA_SE_AES_IV_SIZE - 8) ^= cpu_to_be64(req->seq);
+	crypto_cipher_encrypt_one(ctx->iv_gen, req->giv, iv);
+
+	return tegra_se_aead_queue_req(areq, req->giv, true);
+}
+
+/* precompute the ipad block and the hash state after the opad block */
+static int tegra_se_aead_hmac_setkey(struct tegra_se_aead_context *ctx,
+	const u8 *key, unsigned int keylen)
+{
+	u32 bs = crypto_shash_blocksize(ctx->hash);
+	u32 ds = crypto_shash_digestsize(ctx->hash);
+	u8 opad[SHA256_BLOCK_SIZE];
+	struct {
+		struct shash_desc shash;
+		char ctx[crypto_shash_descsize(ctx->hash)];
+	} desc;
+	int i, err;
+
+	desc.shash.tfm = ctx->hash;
+	desc.shash.flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (keylen > bs) {
+		err = crypto_shash_digest(&desc.shash, key, keylen, ctx->ipad);
+		if (err)
+			return err;
+		keylen = ds;
+	} else {
+		memcpy(ctx->ipad, key, keylen);
+	}
+	memset(ctx->ipad + keylen, 0, bs - keylen);
+	memcpy(opad, ctx->ipad, bs);
+
+	for (i = 0; i < bs; i++) {
+		ctx->ipad[i] ^= 0x36;
+		opad[i] ^= 0x5c;
+	}
+
+	err = crypto_shash_init(&desc.shash) ?:
+		crypto_shash_update(&desc.shash, opad, bs) ?:
+		crypto_shash_export(&desc.shash, ctx->opad_state);
+	memset(opad, 0, sizeof(opad));
+
+	return err;
+}
+
+static int tegra_se_aead_setkey(struct crypto_aead *tfm, const u8 *key,
+	unsigned int keylen)
+{
+	struct tegra_se_aead_context *ctx = crypto_aead_ctx(tfm);
+	struct rtattr *rta = (void *)key;
+	struct crypto_authenc_key_param *param;
+	unsigned int enckeylen, authkeylen;
+	int err;
+
+	crypto_aead_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_aead_set_flags(ctx->fallback,
+		crypto_aead_get_flags(tfm) & CRYPTO_TFM_REQ_MASK);
+	err = crypto_aead_setkey(ctx->fallback, key, keylen);
+	crypto_aead_set_flags(tfm,
+		crypto_aead_get_flags(ctx->fallback) & CRYPTO_TFM_RES_MASK);
+	if (err)
+		return err;
+
+	if (!RTA_OK(rta, keylen) ||
+		(rta->rta_type != CRYPTO_AUTHENC_KEYA_PARAM) ||
+		(RTA_PAYLOAD(rta) < sizeof(*param)))
+		goto badkey;
+
+	param = RTA_DATA(rta);
+	enckeylen = be32_to_cpu(param->enckeylen);
+	key += RTA_ALIGN(rta->rta_len);
+	keylen -= RTA_ALIGN(rta->rta_len);
+	if (keylen < enckeylen)
+		goto badkey;
+	authkeylen = keylen - enckeylen;
+
+	/* the HMAC key comes first, then the AES key */
+	if (tegra_se_aes_ctx_setkey(&ctx->aes, key + authkeylen, enckeylen) ||
+		crypto_cipher_setkey(ctx->iv_gen, key + authkeylen, enckeylen))
+		goto badkey;
+
+	return tegra_se_aead_hmac_setkey(ctx, key, authkeylen);
+
+badkey:
+	crypto_aead_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+	return -EINVAL;
+}
+
+static int tegra_se_aead_setauthsize(struct crypto_aead *tfm,
+	unsigned int authsize)
+{
+	struct tegra_se_aead_context *ctx = crypto_aead_ctx(tfm);
+
+	return crypto_aead_setauthsize(ctx->fallback, authsize);
+}
+
+static int tegra_se_aead_cra_init(struct crypto_tfm *tfm, const char *hash,
+	u32 op_mode)
+{
+	struct tegra_se_aead_context *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	ctx->aes.se_dev = sg_tegra_se_dev;
+	ctx->op_mode = op_mode;
 
+	ctx->hash = crypto_alloc_shash(hash, 0, 0);
+	if (IS_ERR(ctx->hash))
+		return PTR_ERR(ctx->hash);
+
+	ctx->iv_gen = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(ctx->iv_gen)) {
+		err = PTR_ERR(ctx->iv_gen);
+		goto free_hash;
+	}
+
+	ctx->fallback = crypto_alloc_aead(crypto_tfm_alg_name(tfm), 0,
+		CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		pr_err(PFX "no fallback for %s\n", crypto_tfm_alg_name(tfm));
+		err = PTR_ERR(ctx->fallback);
+		goto free_iv_gen;
+	}
+
+	ctx->opad_state = kmalloc(crypto_shash_statesize(ctx->hash),
+		GFP_KERNEL);
+	if (!ctx->opad_state) {
+		err = -ENOMEM;
+		goto free_fallback;
+	}
+
+	get_random_bytes(ctx->salt, sizeof(ctx->salt));
+	tfm->crt_aead.reqsize = sizeof(struct tegra_se_aead_req_context) +
+		crypto_aead_reqsize(ctx->fallback);
+
+	return 0;
+
+free_fallback:
+	crypto_free_aead(ctx->fallback);
+free_iv_gen:
+	crypto_free_cipher(ctx->iv_gen);
+free_hash:
+	crypto_free_shash(ctx->hash);
+	return err;
+}
+
+static int tegra_se_aead_sha1_cra_init(struct crypto_tfm *tfm)
+{
+	return tegra_se_aead_cra_init(tfm, "sha1", SE_AES_OP_MODE_SHA1);
+}
+
+static int tegra_se_aead_sha256_cra_init(struct crypto_tfm *tfm)
+{
+	return tegra_se_aead_cra_init(tfm, "sha256", SE_AES_OP_MODE_SHA256);
+}
+
+static void tegra_se_aead_cra_exit(struct crypto_tfm *tfm)
+{
+	struct tegra_se_aead_context *ctx = crypto_tfm_ctx(tfm);
+
+	tegra_se_put_aes_key_slot(&ctx->aes);
+	memset(ctx->aes.key, 0, sizeof(ctx->aes.key));
+	memset(ctx->ipad, 0, sizeof(ctx->ipad));
+	kzfree(ctx->opad_state);
+	crypto_free_aead(ctx->fallback);
+	crypto_free_cipher(ctx->iv_gen);
+	crypto_free_shash(ctx->hash);
+}
+
+/* DMA buffers and a key slot for one RNG context, for a tfm or the hwrng */
+static int tegra_se_rng_ctx_init(struct tegra_se_dev *se_dev,
+	struct tegra_se_rng_context *rng_ctx)
+{
 	rng_ctx->se_dev = se_dev;
-	rng_ctx->dt_buf = dma_alloc_coherent(se_dev->dev, TEGRA_SE_RNG_DT_SIZE,
-		&rng_ctx->dt_buf_adr, GFP_KERNEL);
+	rng_ctx->dt_buf = dma_alloc_coherent(se_dev->dev,
+		TEGRA_SE_RNG_BATCH_SIZE, &rng_ctx->dt_buf_adr, GFP_KERNEL);
 	if (!rng_ctx->dt_buf) {
 		dev_err(se_dev->dev, "can not allocate rng dma buffer");
 		return -ENOMEM;
 	}
 
 	rng_ctx->rng_buf = dma_alloc_coherent(rng_ctx->se_dev->dev,
-		TEGRA_SE_RNG_DT_SIZE, &rng_ctx->rng_buf_adr, GFP_KERNEL);
+		TEGRA_SE_RNG_BATCH_SIZE, &rng_ctx->rng_buf_adr, GFP_KERNEL);
 	if (!rng_ctx->rng_buf) {
 		dev_err(se_dev->dev, "can not allocate rng dma buffer");
-		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_DT_SIZE,
+		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_BATCH_SIZE,
 					rng_ctx->dt_buf, rng_ctx->dt_buf_adr);
 		return -ENOMEM;
 	}
@@ -1043,9 +1731,9 @@ static int tegra_se_rng_init(struct crypto_tfm *tfm)
 
 	if (!rng_ctx->slot) {
 		dev_err(rng_ctx->se_dev->dev, "no free slot\n");
-		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_DT_SIZE,
+		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_BATCH_SIZE,
 					rng_ctx->dt_buf, rng_ctx->dt_buf_adr);
-		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_DT_SIZE,
+		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_BATCH_SIZE,
 					rng_ctx->rng_buf, rng_ctx->rng_buf_adr);
 		return -ENOMEM;
 	}
@@ -1053,17 +1741,15 @@ static int tegra_se_rng_init(struct crypto_tfm *tfm)
 	return 0;
 }
 
-static void tegra_se_rng_exit(struct crypto_tfm *tfm)
+static void tegra_se_rng_ctx_exit(struct tegra_se_rng_context *rng_ctx)
 {
-	struct tegra_se_rng_context *rng_ctx = crypto_tfm_ctx(tfm);
-
 	if (rng_ctx->dt_buf) {
-		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_DT_SIZE,
+		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_BATCH_SIZE,
 			rng_ctx->dt_buf, rng_ctx->dt_buf_adr);
 	}
 
 	if (rng_ctx->rng_buf) {
-		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_DT_SIZE,
+		dma_free_coherent(rng_ctx->se_dev->dev, TEGRA_SE_RNG_BATCH_SIZE,
 			rng_ctx->rng_buf, rng_ctx->rng_buf_adr);
 	}
 
@@ -1072,20 +1758,49 @@ static void tegra_se_rng_exit(struct crypto_tfm *tfm)
 	rng_ctx->se_dev = NULL;
 }
 
-static int tegra_se_rng_get_random(struct crypto_rng *tfm, u8 *rdata, u32 dlen)
+static int tegra_se_rng_init(struct crypto_tfm *tfm)
 {
-	struct tegra_se_rng_context *rng_ctx = crypto_rng_ctx(tfm);
-	struct tegra_se_dev *se_dev = rng_ctx->se_dev;
-	struct tegra_se_ll *src_ll, *dst_ll;
-	unsigned char *dt_buf = (unsigned char *)rng_ctx->dt_buf;
-	u8 *rdata_addr;
-	int ret = 0, i, j, num_blocks, data_len = 0;
+	struct tegra_se_rng_context *rng_ctx = crypto_tfm_ctx(tfm);
+
+	return tegra_se_rng_ctx_init(sg_tegra_se_dev, rng_ctx);
+}
+
+static void tegra_se_rng_exit(struct crypto_tfm *tfm)
+{
+	struct tegra_se_rng_context *rng_ctx = crypto_tfm_ctx(tfm);
 
-	num_blocks = (dlen / TEGRA_SE_RNG_DT_SIZE);
+	tegra_se_rng_ctx_exit(rng_ctx);
+}
+
+/* DT is a 128 bit big endian counter */
+static void tegra_se_rng_next_dt(u8 *next, const u8 *dt)
+{
+	int i;
 
-	data_len = (dlen % TEGRA_SE_RNG_DT_SIZE);
-	if (data_len == 0)
-		num_blocks = num_blocks - 1;
+	memcpy(next, dt, TEGRA_SE_RNG_DT_SIZE);
+	for (i = TEGRA_SE_RNG_DT_SIZE - 1; i >= 0; i--) {
+		next[i] += 1;
+		if (next[i] != 0)
+			break;
+	}
+}
+
+/*
+ * dlen bytes of X9.31 output.  Each operation takes up to
+ * TEGRA_SE_RNG_BATCH_BLOCKS consecutive DT vectors from dt_buf, so a
+ * large read costs one engine setup per TEGRA_SE_RNG_BATCH_SIZE bytes
+ * instead of one per block; the engine carries V from one block to the
+ * next within an operation as it does across operations through the
+ * updated IV.  The first block of dt_buf always holds the next DT.
+ */
+static int tegra_se_rng_generate(struct tegra_se_rng_context *rng_ctx,
+	u8 *rdata, u32 dlen)
+{
+	struct tegra_se_dev *se_dev = rng_ctx->se_dev;
+	struct tegra_se_ll *src_ll, *dst_ll;
+	u8 *dt_buf = (u8 *)rng_ctx->dt_buf;
+	u32 done = 0, nbytes, nblocks, i;
+	int ret = 0;
 
 	/* take access to the hw */
 	mutex_lock(&se_hw_lock);
@@ -1096,37 +1811,33 @@ static int tegra_se_rng_get_random(struct crypto_rng *tfm, u8 *rdata, u32 dlen)
 	src_ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
 	dst_ll = (struct tegra_se_ll *)(se_dev->dst_ll_buf + 1);
 	src_ll->addr = rng_ctx->dt_buf_adr;
-	src_ll->data_len = TEGRA_SE_RNG_DT_SIZE;
 	dst_ll->addr = rng_ctx->rng_buf_adr;
-	dst_ll->data_len = TEGRA_SE_RNG_DT_SIZE;
 
 	tegra_se_config_algo(se_dev, SE_AES_OP_MODE_RNG_X931, true,
 		TEGRA_SE_KEY_128_SIZE);
 	tegra_se_config_crypto(se_dev, SE_AES_OP_MODE_RNG_X931, true,
 				rng_ctx->slot->slot_num, rng_ctx->use_org_iv);
-	for (j = 0; j <= num_blocks; j++) {
+	while (done < dlen) {
+		nbytes = min_t(u32, dlen - done, TEGRA_SE_RNG_BATCH_SIZE);
+		nblocks = DIV_ROUND_UP(nbytes, TEGRA_SE_RNG_DT_SIZE);
+		for (i = 1; i < nblocks; i++)
+			tegra_se_rng_next_dt(dt_buf + i * TEGRA_SE_RNG_DT_SIZE,
+				dt_buf + (i - 1) * TEGRA_SE_RNG_DT_SIZE);
+		src_ll->data_len = nblocks * TEGRA_SE_RNG_DT_SIZE;
+		dst_ll->data_len = nblocks * TEGRA_SE_RNG_DT_SIZE;
+
 		ret = tegra_se_start_operation(se_dev,
-				TEGRA_SE_RNG_DT_SIZE, false);
+				nblocks * TEGRA_SE_RNG_DT_SIZE, false);
+		if (ret)
+			break;
 
-		if (!ret) {
-			rdata_addr = (rdata + (j * TEGRA_SE_RNG_DT_SIZE));
+		memcpy(rdata + done, rng_ctx->rng_buf, nbytes);
+		done += nbytes;
 
-			if (data_len && num_blocks == j) {
-				memcpy(rdata_addr, rng_ctx->rng_buf, data_len);
-			} else {
-				memcpy(rdata_addr,
-					rng_ctx->rng_buf, TEGRA_SE_RNG_DT_SIZE);
-			}
+		/* update DT vector */
+		tegra_se_rng_next_dt(dt_buf,
+			dt_buf + (nblocks - 1) * TEGRA_SE_RNG_DT_SIZE);
 
-			/* update DT vector */
-			for (i = TEGRA_SE_RNG_DT_SIZE - 1; i >= 0; i--) {
-				dt_buf[i] += 1;
-				if (dt_buf[i] != 0)
-					break;
-			}
-		} else {
-			dlen = 0;
-		}
 		if (rng_ctx->use_org_iv) {
 			rng_ctx->use_org_iv = false;
 			tegra_se_config_crypto(se_dev,
@@ -1134,16 +1845,24 @@ static int tegra_se_rng_get_random(struct crypto_rng *tfm, u8 *rdata, u32 dlen)
 				rng_ctx->slot->slot_num, rng_ctx->use_org_iv);
 		}
 	}
+	memset(rng_ctx->rng_buf, 0, TEGRA_SE_RNG_BATCH_SIZE);
 
 	pm_runtime_put(se_dev->dev);
 	mutex_unlock(&se_hw_lock);
 
-	return dlen;
+	return ret ? 0 : dlen;
 }
 
-static int tegra_se_rng_reset(struct crypto_rng *tfm, u8 *seed, u32 slen)
+static int tegra_se_rng_get_random(struct crypto_rng *tfm, u8 *rdata, u32 dlen)
 {
 	struct tegra_se_rng_context *rng_ctx = crypto_rng_ctx(tfm);
+
+	return tegra_se_rng_generate(rng_ctx, rdata, dlen);
+}
+
+static void tegra_se_rng_seed(struct tegra_se_rng_context *rng_ctx,
+	u8 *seed, u32 slen)
+{
 	struct tegra_se_dev *se_dev = rng_ctx->se_dev;
 	u8 *iv = seed;
 	u8 *key = (u8 *)(seed + TEGRA_SE_RNG_IV_SIZE);
@@ -1180,26 +1899,118 @@ static int tegra_se_rng_reset(struct crypto_rng *tfm, u8 *seed, u32 slen)
 	}
 
 	rng_ctx->use_org_iv = true;
+}
+
+static int tegra_se_rng_reset(struct crypto_rng *tfm, u8 *seed, u32 slen)
+{
+	struct tegra_se_rng_context *rng_ctx = crypto_rng_ctx(tfm);
+
+	tegra_se_rng_seed(rng_ctx, seed, slen);
 
 	return 0;
 }
 
-int tegra_se_sha_init(struct ahash_request *req)
+/*
+ * The hwrng is a context of its own, keyed from the entropy pool and with
+ * DT from the time and the chip's unique id, that the hw_random core reads
+ * from to feed the pool when hwrng_quality is not 0.  Reads are served
+ * from hwrng_buf, refilled TEGRA_SE_RNG_BATCH_SIZE bytes at a time.  The
+ * core serializes the callbacks.
+ */
+static int tegra_se_hwrng_init(struct hwrng *rng)
 {
+	struct tegra_se_dev *se_dev = (struct tegra_se_dev *)rng->priv;
+	u8 seed[TEGRA_SE_RNG_IV_SIZE + TEGRA_SE_RNG_KEY_SIZE];
+	int err;
+
+	se_dev->hwrng_buf = kmalloc(TEGRA_SE_RNG_BATCH_SIZE, GFP_KERNEL);
+	if (!se_dev->hwrng_buf)
+		return -ENOMEM;
+
+	err = tegra_se_rng_ctx_init(se_dev, &se_dev->hwrng_ctx);
+	if (err) {
+		kfree(se_dev->hwrng_buf);
+		se_dev->hwrng_buf = NULL;
+		return err;
+	}
+
+	get_random_bytes(seed, sizeof(seed));
+	tegra_se_rng_seed(&se_dev->hwrng_ctx, seed, sizeof(seed));
+	memset(seed, 0, sizeof(seed));
+	se_dev->hwrng_avail = 0;
+
 	return 0;
 }
 
+static void tegra_se_hwrng_cleanup(struct hwrng *rng)
+{
+	struct tegra_se_dev *se_dev = (struct tegra_se_dev *)rng->priv;
+
+	tegra_se_rng_ctx_exit(&se_dev->hwrng_ctx);
+	if (se_dev->hwrng_buf) {
+		memset(se_dev->hwrng_buf, 0, TEGRA_SE_RNG_BATCH_SIZE);
+		kfree(se_dev->hwrng_buf);
+		se_dev->hwrng_buf = NULL;
+	}
+	se_dev->hwrng_avail = 0;
+}
+
+static int tegra_se_hwrng_read(struct hwrng *rng, void *data, size_t max,
+	bool wait)
+{
+	struct tegra_se_dev *se_dev = (struct tegra_se_dev *)rng->priv;
+	u8 *p;
+	size_t len;
+
+	if (!se_dev->hwrng_avail) {
+		if (!tegra_se_rng_generate(&se_dev->hwrng_ctx,
+				se_dev->hwrng_buf, TEGRA_SE_RNG_BATCH_SIZE))
+			return -EIO;
+		se_dev->hwrng_avail = TEGRA_SE_RNG_BATCH_SIZE;
+	}
+
+	/* hand out the tail of the buffer and wipe it */
+	len = min_t(size_t, max, se_dev->hwrng_avail);
+	se_dev->hwrng_avail -= len;
+	p = se_dev->hwrng_buf + se_dev->hwrng_avail;
+	memcpy(data, p, len);
+	memset(p, 0, len);
+
+	return len;
+}
+
+static struct shash_desc *tegra_se_sha_desc(struct ahash_request *req)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct tegra_se_sha_context *sha_ctx = crypto_ahash_ctx(tfm);
+	struct shash_desc *desc = ahash_request_ctx(req);
+
+	desc->tfm = sha_ctx->fallback;
+	desc->flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+	return desc;
+}
+
+int tegra_se_sha_init(struct ahash_request *req)
+{
+	return crypto_shash_init(tegra_se_sha_desc(req));
+}
+
 int tegra_se_sha_update(struct ahash_request *req)
 {
-	return 0;
+	return shash_ahash_update(req, ahash_request_ctx(req));
 }
 
 int tegra_se_sha_finup(struct ahash_request *req)
 {
-	return 0;
+	return shash_ahash_finup(req, ahash_request_ctx(req));
 }
 
 int tegra_se_sha_final(struct ahash_request *req)
+{
+	return crypto_shash_final(ahash_request_ctx(req), req->result);
+}
+
+static int tegra_se_sha_hw_digest(struct ahash_request *req)
 {
 	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
 	struct tegra_se_sha_context *sha_ctx = crypto_ahash_ctx(tfm);
@@ -1294,19 +2105,36 @@ int tegra_se_sha_final(struct ahash_request *req)
 
 static int tegra_se_sha_digest(struct ahash_request *req)
 {
-	return tegra_se_sha_init(req) ?: tegra_se_sha_final(req);
+	if (req->nbytes < sha_hw_min_bytes)
+		return shash_ahash_digest(req, tegra_se_sha_desc(req));
+
+	return tegra_se_sha_hw_digest(req);
 }
 
 int tegra_se_sha_cra_init(struct crypto_tfm *tfm)
 {
+	struct tegra_se_sha_context *sha_ctx = crypto_tfm_ctx(tfm);
+	struct crypto_shash *fallback;
+
+	fallback = crypto_alloc_shash(crypto_tfm_alg_name(tfm), 0, 0);
+	if (IS_ERR(fallback)) {
+		pr_err("tegra-se: no fallback for %s\n",
+		       crypto_tfm_alg_name(tfm));
+		return PTR_ERR(fallback);
+	}
+	sha_ctx->fallback = fallback;
+
 	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
-				 sizeof(struct tegra_se_sha_context));
+				 sizeof(struct shash_desc) +
+				 crypto_shash_descsize(fallback));
 	return 0;
 }
 
 void tegra_se_sha_cra_exit(struct crypto_tfm *tfm)
 {
-	/* do nothing */
+	struct tegra_se_sha_context *sha_ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_shash(sha_ctx->fallback);
 }
 
 int tegra_se_aes_cmac_init(struct ahash_request *req)
@@ -1731,6 +2559,56 @@ static struct crypto_alg aes_algs[] = {
 	}
 };
 
+static struct crypto_alg aead_algs[] = {
+	{
+		.cra_name = "authenc(hmac(sha1),cbc(aes))",
+		.cra_driver_name = "authenc-hmac-sha1-cbc-aes-tegra",
+		.cra_priority = TEGRA_SE_COMPOSITE_PRIORITY,
+		.cra_flags = CRYPTO_ALG_TYPE_AEAD | CRYPTO_ALG_ASYNC |
+			CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize = TEGRA_SE_AES_BLOCK_SIZE,
+		.cra_ctxsize = sizeof(struct tegra_se_aead_context),
+		.cra_alignmask = 0,
+		.cra_type = &crypto_aead_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = tegra_se_aead_sha1_cra_init,
+		.cra_exit = tegra_se_aead_cra_exit,
+		.cra_aead = {
+			.setkey = tegra_se_aead_setkey,
+			.setauthsize = tegra_se_aead_setauthsize,
+			.encrypt = tegra_se_aead_encrypt,
+			.decrypt = tegra_se_aead_decrypt,
+			.givencrypt = tegra_se_aead_givencrypt,
+			.geniv = "<built-in>",
+			.ivsize = TEGRA_SE_AES_IV_SIZE,
+			.maxauthsize = SHA1_DIGEST_SIZE,
+		}
+	}, {
+		.cra_name = "authenc(hmac(sha256),cbc(aes))",
+		.cra_driver_name = "authenc-hmac-sha256-cbc-aes-tegra",
+		.cra_priority = TEGRA_SE_COMPOSITE_PRIORITY,
+		.cra_flags = CRYPTO_ALG_TYPE_AEAD | CRYPTO_ALG_ASYNC |
+			CRYPTO_ALG_NEED_FALLBACK,
+		.cra_blocksize = TEGRA_SE_AES_BLOCK_SIZE,
+		.cra_ctxsize = sizeof(struct tegra_se_aead_context),
+		.cra_alignmask = 0,
+		.cra_type = &crypto_aead_type,
+		.cra_module = THIS_MODULE,
+		.cra_init = tegra_se_aead_sha256_cra_init,
+		.cra_exit = tegra_se_aead_cra_exit,
+		.cra_aead = {
+			.setkey = tegra_se_aead_setkey,
+			.setauthsize = tegra_se_aead_setauthsize,
+			.encrypt = tegra_se_aead_encrypt,
+			.decrypt = tegra_se_aead_decrypt,
+			.givencrypt = tegra_se_aead_givencrypt,
+			.geniv = "<built-in>",
+			.ivsize = TEGRA_SE_AES_IV_SIZE,
+			.maxauthsize = SHA256_DIGEST_SIZE,
+		}
+	}
+};
+
 static struct ahash_alg hash_algs[] = {
 	{
 		.init = tegra_se_aes_cmac_init,
@@ -1762,7 +2640,7 @@ static struct ahash_alg hash_algs[] = {
 		.halg.base = {
 			.cra_name = "sha1",
 			.cra_driver_name = "tegra-se-sha1",
-			.cra_priority = 100,
+			.cra_priority = 300,
 			.cra_flags = CRYPTO_ALG_TYPE_AHASH,
 			.cra_blocksize = SHA1_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct tegra_se_sha_context),
@@ -1781,7 +2659,7 @@ static struct ahash_alg hash_algs[] = {
 		.halg.base = {
 			.cra_name = "sha224",
 			.cra_driver_name = "tegra-se-sha224",
-			.cra_priority = 100,
+			.cra_priority = 300,
 			.cra_flags = CRYPTO_ALG_TYPE_AHASH,
 			.cra_blocksize = SHA224_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct tegra_se_sha_context),
@@ -1800,7 +2678,7 @@ static struct ahash_alg hash_algs[] = {
 		.halg.base = {
 			.cra_name = "sha256",
 			.cra_driver_name = "tegra-se-sha256",
-			.cra_priority = 100,
+			.cra_priority = 300,
 			.cra_flags = CRYPTO_ALG_TYPE_AHASH,
 			.cra_blocksize = SHA256_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct tegra_se_sha_context),
@@ -1819,7 +2697,7 @@ static struct ahash_alg hash_algs[] = {
 		.halg.base = {
 			.cra_name = "sha384",
 			.cra_driver_name = "tegra-se-sha384",
-			.cra_priority = 100,
+			.cra_priority = 300,
 			.cra_flags = CRYPTO_ALG_TYPE_AHASH,
 			.cra_blocksize = SHA384_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct tegra_se_sha_context),
@@ -1838,7 +2716,7 @@ static struct ahash_alg hash_algs[] = {
 		.halg.base = {
 			.cra_name = "sha512",
 			.cra_driver_name = "tegra-se-sha512",
-			.cra_priority = 100,
+			.cra_priority = 300,
 			.cra_flags = CRYPTO_ALG_TYPE_AHASH,
 			.cra_blocksize = SHA512_BLOCK_SIZE,
 			.cra_ctxsize = sizeof(struct tegra_se_sha_context),
@@ -1850,11 +2728,102 @@ static struct ahash_alg hash_algs[] = {
 	}
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int tegra_se_key_slots_show(struct seq_file *s, void *data)
+{
+	struct tegra_se_dev *se_dev = s->private;
+	struct tegra_se_slot *slot;
+	u32 lookups;
+
+	spin_lock(&key_slot_lock);
+	lookups = se_dev->key_slot_hits + se_dev->key_slot_misses;
+	seq_printf(s, "hits:      %u\n", se_dev->key_slot_hits);
+	seq_printf(s, "misses:    %u\n", se_dev->key_slot_misses);
+	seq_printf(s, "evictions: %u\n", se_dev->key_slot_evictions);
+	if (lookups)
+		seq_printf(s, "hit rate:  %u%%\n",
+			(u32)div_u64((u64)se_dev->key_slot_hits * 100,
+				lookups));
+
+	/* least recently used first */
+	seq_printf(s, "\nslot state\n");
+	list_for_each_entry(slot, &key_slot, node)
+		seq_printf(s, "%4u %s\n", slot->slot_num,
+			!slot->available ? "held" :
+			slot->key_gen ? "cached" : "free");
+	spin_unlock(&key_slot_lock);
+
+	return 0;
+}
+
+static int tegra_se_key_slots_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_key_slots_show, inode->i_private);
+}
+
+static const struct file_operations tegra_se_key_slots_fops = {
+	.open		= tegra_se_key_slots_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int tegra_se_aead_show(struct seq_file *s, void *data)
+{
+	struct tegra_se_dev *se_dev = s->private;
+
+	seq_printf(s, "engine:   %u\n", se_dev->aead_hw_reqs);
+	seq_printf(s, "batches:  %u\n", se_dev->aead_hw_batches);
+	seq_printf(s, "fallback: %u\n", se_dev->aead_sw_reqs);
+	seq_printf(s, "bad icv:  %u\n", se_dev->aead_bad_icv);
+
+	return 0;
+}
+
+static int tegra_se_aead_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_aead_show, inode->i_private);
+}
+
+static const struct file_operations tegra_se_aead_fops = {
+	.open		= tegra_se_aead_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_se_debugfs_init(struct tegra_se_dev *se_dev)
+{
+	se_dev->debugfs_root = debugfs_create_dir("tegra-se", NULL);
+	if (!se_dev->debugfs_root)
+		return;
+
+	debugfs_create_file("key_slots", S_IRUGO, se_dev->debugfs_root,
+		se_dev, &tegra_se_key_slots_fops);
+	debugfs_create_file("aead", S_IRUGO, se_dev->debugfs_root,
+		se_dev, &tegra_se_aead_fops);
+}
+
+static void tegra_se_debugfs_exit(struct tegra_se_dev *se_dev)
+{
+	debugfs_remove_recursive(se_dev->debugfs_root);
+	se_dev->debugfs_root = NULL;
+}
+#else
+static void tegra_se_debugfs_init(struct tegra_se_dev *se_dev)
+{
+}
+
+static void tegra_se_debugfs_exit(struct tegra_se_dev *se_dev)
+{
+}
+#endif
+
 static int tegra_se_probe(struct platform_device *pdev)
 {
 	struct tegra_se_dev *se_dev = NULL;
 	struct resource *res = NULL;
-	int err = 0, i = 0, j = 0, k = 0;
+	int err = 0, i = 0, j = 0, k = 0, l = 0;
 
 	se_dev = kzalloc(sizeof(struct tegra_se_dev), GFP_KERNEL);
 	if (!se_dev) {
@@ -1949,6 +2918,14 @@ static int tegra_se_probe(struct platform_device *pdev)
 		goto clean;
 	}
 
+	se_dev->aead_buf = dma_alloc_coherent(se_dev->dev, SE_AEAD_BUF_SIZE,
+		&se_dev->aead_buf_adr, GFP_KERNEL);
+	if (!se_dev->aead_buf) {
+		dev_err(se_dev->dev, "can not allocate aead buffer\n");
+		err = -ENOMEM;
+		goto clean;
+	}
+
 	for (i = 0; i < ARRAY_SIZE(aes_algs); i++) {
 		INIT_LIST_HEAD(&aes_algs[i].cra_list);
 		err = crypto_register_alg(&aes_algs[i]);
@@ -1968,6 +2945,16 @@ static int tegra_se_probe(struct platform_device *pdev)
 		}
 	}
 
+	for (l = 0; l < ARRAY_SIZE(aead_algs); l++) {
+		INIT_LIST_HEAD(&aead_algs[l].cra_list);
+		err = crypto_register_alg(&aead_algs[l]);
+		if (err) {
+			dev_err(se_dev->dev,
+				"crypto_register_aead failed index[%d]\n", l);
+			goto clean;
+		}
+	}
+
 #if defined(CONFIG_PM)
 	se_dev->ctx_save_buf = dma_alloc_coherent(se_dev->dev,
 		SE_CONTEXT_BUFER_SIZE, &se_dev->ctx_save_buf_adr, GFP_KERNEL);
@@ -1977,6 +2964,21 @@ static int tegra_se_probe(struct platform_device *pdev)
 	}
 #endif
 
+	tegra_se_debugfs_init(se_dev);
+
+	se_dev->hwrng.name = "tegra-se";
+	se_dev->hwrng.init = tegra_se_hwrng_init;
+	se_dev->hwrng.cleanup = tegra_se_hwrng_cleanup;
+	se_dev->hwrng.read = tegra_se_hwrng_read;
+	se_dev->hwrng.priv = (unsigned long)se_dev;
+	se_dev->hwrng.quality = hwrng_quality;
+	err = hwrng_register(&se_dev->hwrng);
+	if (err) {
+		/* the crypto algorithms are still of use */
+		dev_warn(se_dev->dev, "hwrng_register failed (%d)\n", err);
+		se_dev->hwrng.name = NULL;
+	}
+
 	dev_info(se_dev->dev, "%s: complete", __func__);
 	return 0;
 
@@ -1988,6 +2990,12 @@ clean:
 	for (k = 0; k < j; k++)
 		crypto_unregister_ahash(&hash_algs[j]);
 
+	for (k = 0; k < l; k++)
+		crypto_unregister_alg(&aead_algs[k]);
+
+	if (se_dev->aead_buf)
+		dma_free_coherent(se_dev->dev, SE_AEAD_BUF_SIZE,
+			se_dev->aead_buf, se_dev->aead_buf_adr);
 	tegra_se_free_ll_buf(se_dev);
 
 	if (se_work_q)
@@ -2019,7 +3027,10 @@ static int __devexit tegra_se_remove(struct platform_device *pdev)
 	if (!se_dev)
 		return -ENODEV;
 
+	if (se_dev->hwrng.name)
+		hwrng_unregister(&se_dev->hwrng);
 	pm_runtime_disable(se_dev->dev);
+	tegra_se_debugfs_exit(se_dev);
 
 	cancel_work_sync(&se_work);
 	if (se_work_q)
@@ -2029,8 +3040,12 @@ static int __devexit tegra_se_remove(struct platform_device *pdev)
 		crypto_unregister_alg(&aes_algs[i]);
 	for (i = 0; i < ARRAY_SIZE(hash_algs); i++)
 		crypto_unregister_ahash(&hash_algs[i]);
+	for (i = 0; i < ARRAY_SIZE(aead_algs); i++)
+		crypto_unregister_alg(&aead_algs[i]);
 	if (se_dev->pclk)
 		clk_put(se_dev->pclk);
+	dma_free_coherent(se_dev->dev, SE_AEAD_BUF_SIZE, se_dev->aead_buf,
+		se_dev->aead_buf_adr);
 	tegra_se_free_ll_buf(se_dev);
 	if (se_dev->ctx_save_buf) {
 		dma_free_coherent(se_dev->dev, SE_CONTEXT_BUFER_SIZE,
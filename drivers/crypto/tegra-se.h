@@ -31,6 +31,11 @@
 #define TEGRA_SE_CRYPTO_QUEUE_LENGTH 50
 #define SE_MAX_SRC_SG_COUNT		50
 #define SE_MAX_DST_SG_COUNT		50
+#define SE_MAX_BATCH_REQS		16
+#define SE_AEAD_MAX_ASSOC_SIZE		64
+#define SE_AEAD_BUF_SIZE		(SHA256_BLOCK_SIZE + \
+					SE_AEAD_MAX_ASSOC_SIZE + \
+					TEGRA_SE_AES_IV_SIZE)
 
 #define TEGRA_SE_KEYSLOT_COUNT		16
 
@@ -205,6 +210,10 @@
 #define TEGRA_SE_RNG_SEED_SIZE		(TEGRA_SE_RNG_IV_SIZE + \
 						TEGRA_SE_RNG_KEY_SIZE + \
 						TEGRA_SE_RNG_DT_SIZE)
+/* RNG blocks generated by a single engine operation */
+#define TEGRA_SE_RNG_BATCH_BLOCKS	64
+#define TEGRA_SE_RNG_BATCH_SIZE		(TEGRA_SE_RNG_BATCH_BLOCKS * \
+						TEGRA_SE_RNG_DT_SIZE)
 #define TEGRA_SE_AES_CMAC_DIGEST_SIZE	16
 
 #define SE_KEY_TABLE_ACCESS_REG_OFFSET	0x284
@@ -0,0 +1,650 @@
+/*
+ * drivers/dma/tegra-apb-dma.c
+ *
+ * dmaengine provider for the NVIDIA Tegra APB DMA controller
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The channels themselves are still owned by arch/arm/mach-tegra/dma.c.
+ * Each dmaengine channel takes one of them on alloc_chan_resources, and
+ * every descriptor becomes a chain of tegra_dma_req segments, one per
+ * contiguous piece of at most 64KB. All the segments of the issued
+ * descriptors are queued on the channel at once, so the channel keeps the
+ * next one pre-programmed and goes on to it without waiting for the ISR,
+ * across descriptor boundaries. Descriptors and segments come from
+ * per-channel pools allocated up front, so prep never allocates.
+ *
+ * Clients pick a channel with tegra_dma_filter() and a struct
+ * tegra_dma_slave giving the request selector, and whether the channel
+ * is for cyclic transfers: the mode of the underlying channel is fixed
+ * when it is allocated.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
+#include <linux/platform_device.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include <mach/dma.h>
+
+#include "dmaengine.h"
+
+#define DRV_NAME			"tegra-apb-dma"
+
+#define TEGRA_APB_DMA_CHANNELS		8
+#define TEGRA_APB_DMA_DESCS		16
+#define TEGRA_APB_DMA_SEGS		64
+#define TEGRA_APB_DMA_MAX_SEG		SZ_64K
+
+struct tegra_apb_dma_desc;
+
+struct tegra_apb_dma_seg {
+	struct tegra_dma_req		req;
+	struct list_head		node;
+	struct tegra_apb_dma_desc	*desc;
+};
+
+struct tegra_apb_dma_desc {
+	struct dma_async_tx_descriptor	txd;
+	struct list_head		node;
+	struct list_head		segs;
+	unsigned int			segs_left;
+	size_t				len;
+	size_t				done;
+	bool				cyclic;
+};
+
+struct tegra_apb_dma_chan {
+	struct dma_chan			chan;
+	struct tegra_dma_channel	*hw;
+	struct tegra_dma_slave		slave;
+	struct dma_slave_config		cfg;
+
+	/* Lock for the lists and the pools */
+	spinlock_t			lock;
+	struct list_head		free_descs;
+	struct list_head		free_segs;
+	struct list_head		queued;
+	struct list_head		active;
+	struct list_head		completed;
+	unsigned int			periods;
+	struct tasklet_struct		tasklet;
+
+	struct tegra_apb_dma_desc	*descs;
+	struct tegra_apb_dma_seg	*segs;
+};
+
+struct tegra_apb_dma {
+	struct dma_device		dma;
+	struct tegra_apb_dma_chan	channels[TEGRA_APB_DMA_CHANNELS];
+};
+
+static struct platform_driver tegra_apb_dma_driver;
+
+static inline struct tegra_apb_dma_chan *to_tdc(struct dma_chan *chan)
+{
+	return container_of(chan, struct tegra_apb_dma_chan, chan);
+}
+
+static inline struct device *chan2dev(struct dma_chan *chan)
+{
+	return &chan->dev->device;
+}
+
+static inline struct tegra_apb_dma_desc *to_desc(
+	struct dma_async_tx_descriptor *txd)
+{
+	return container_of(txd, struct tegra_apb_dma_desc, txd);
+}
+
+/* should be called with the channel lock held */
+static struct tegra_apb_dma_desc *tegra_apb_dma_get_desc(
+	struct tegra_apb_dma_chan *tdc)
+{
+	struct tegra_apb_dma_desc *desc;
+
+	if (list_empty(&tdc->free_descs))
+		return NULL;
+
+	desc = list_first_entry(&tdc->free_descs, typeof(*desc), node);
+	list_del(&desc->node);
+	INIT_LIST_HEAD(&desc->segs);
+	desc->segs_left = 0;
+	desc->len = 0;
+	desc->done = 0;
+	desc->cyclic = false;
+	return desc;
+}
+
+/* should be called with the channel lock held */
+static void tegra_apb_dma_put_desc(struct tegra_apb_dma_chan *tdc,
+	struct tegra_apb_dma_desc *desc)
+{
+	struct tegra_apb_dma_seg *seg;
+
+	/* a late completion of a cancelled segment must not find it */
+	list_for_each_entry(seg, &desc->segs, node)
+		seg->desc = NULL;
+	list_splice_tail_init(&desc->segs, &tdc->free_segs);
+	list_add(&desc->node, &tdc->free_descs);
+}
+
+static void tegra_apb_dma_seg_complete(struct tegra_dma_req *req)
+{
+	struct tegra_apb_dma_seg *seg =
+		container_of(req, struct tegra_apb_dma_seg, req);
+	struct tegra_apb_dma_chan *tdc = req->dev;
+	struct tegra_apb_dma_desc *desc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	desc = seg->desc;
+	if (!desc || (req->status != TEGRA_DMA_REQ_SUCCESS &&
+		!desc->cyclic)) {
+		spin_unlock_irqrestore(&tdc->lock, flags);
+		return;
+	}
+
+	if (desc->cyclic) {
+		tdc->periods++;
+	} else {
+		desc->done += req->size;
+		if (!--desc->segs_left)
+			list_move_tail(&desc->node, &tdc->completed);
+	}
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	tasklet_schedule(&tdc->tasklet);
+}
+
+static void tegra_apb_dma_tasklet(unsigned long data)
+{
+	struct tegra_apb_dma_chan *tdc = (struct tegra_apb_dma_chan *)data;
+	struct tegra_apb_dma_desc *desc, *tmp;
+	dma_async_tx_callback callback = NULL;
+	void *param = NULL;
+	unsigned int periods;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_splice_tail_init(&tdc->completed, &list);
+	list_for_each_entry(desc, &list, node)
+		dma_cookie_complete(&desc->txd);
+
+	periods = tdc->periods;
+	tdc->periods = 0;
+	if (periods && !list_empty(&tdc->active)) {
+		desc = list_first_entry(&tdc->active, typeof(*desc), node);
+		callback = desc->txd.callback;
+		param = desc->txd.callback_param;
+	}
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	/* one call per period, as the callers of prep_dma_cyclic expect */
+	while (callback && periods--)
+		callback(param);
+
+	list_for_each_entry(desc, &list, node) {
+		if (desc->txd.callback)
+			desc->txd.callback(desc->txd.callback_param);
+		dma_run_dependencies(&desc->txd);
+	}
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_for_each_entry_safe(desc, tmp, &list, node)
+		tegra_apb_dma_put_desc(tdc, desc);
+	spin_unlock_irqrestore(&tdc->lock, flags);
+}
+
+static dma_cookie_t tegra_apb_dma_tx_submit(struct dma_async_tx_descriptor *txd)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(txd->chan);
+	struct tegra_apb_dma_desc *desc = to_desc(txd);
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	cookie = dma_cookie_assign(txd);
+	list_add_tail(&desc->node, &tdc->queued);
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	return cookie;
+}
+
+static void tegra_apb_dma_fill_req(struct tegra_apb_dma_chan *tdc,
+	struct tegra_dma_req *req, enum dma_transfer_direction direction,
+	dma_addr_t addr, unsigned int len)
+{
+	memset(req, 0, sizeof(*req));
+	req->complete = tegra_apb_dma_seg_complete;
+	req->dev = tdc;
+	req->req_sel = tdc->slave.req_sel;
+	req->size = len;
+
+	if (direction == DMA_DEV_TO_MEM) {
+		req->to_memory = 1;
+		req->source_addr = tdc->cfg.src_addr;
+		req->source_wrap = 4;
+		req->source_bus_width = tdc->cfg.src_addr_width * 8;
+		req->dest_addr = addr;
+		req->dest_wrap = 0;
+		req->dest_bus_width = 32;
+	} else {
+		req->to_memory = 0;
+		req->dest_addr = tdc->cfg.dst_addr;
+		req->dest_wrap = 4;
+		req->dest_bus_width = tdc->cfg.dst_addr_width * 8;
+		req->source_addr = addr;
+		req->source_wrap = 0;
+		req->source_bus_width = 32;
+	}
+}
+
+static struct dma_async_tx_descriptor *tegra_apb_dma_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned int sg_len,
+	enum dma_transfer_direction direction, unsigned long flags,
+	void *context)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(chan);
+	struct tegra_apb_dma_desc *desc;
+	struct tegra_apb_dma_seg *seg;
+	struct scatterlist *sg;
+	unsigned long irq_flags;
+	dma_addr_t addr;
+	unsigned int len, n;
+	int i;
+
+	if (tdc->slave.cyclic ||
+		(direction != DMA_DEV_TO_MEM && direction != DMA_MEM_TO_DEV))
+		return NULL;
+
+	spin_lock_irqsave(&tdc->lock, irq_flags);
+	desc = tegra_apb_dma_get_desc(tdc);
+	if (!desc)
+		goto out_busy;
+
+	for_each_sg(sgl, sg, sg_len, i) {
+		addr = sg_dma_address(sg);
+		len = sg_dma_len(sg);
+		if ((addr | len) & 0x3) {
+			dev_err(chan2dev(chan), "unaligned sg entry %d\n", i);
+			goto out_put;
+		}
+
+		while (len) {
+			if (list_empty(&tdc->free_segs))
+				goto out_put_busy;
+			seg = list_first_entry(&tdc->free_segs, typeof(*seg),
+				node);
+			list_move_tail(&seg->node, &desc->segs);
+
+			n = min_t(unsigned int, len, TEGRA_APB_DMA_MAX_SEG);
+			tegra_apb_dma_fill_req(tdc, &seg->req, direction, addr,
+				n);
+			seg->desc = desc;
+			desc->segs_left++;
+			desc->len += n;
+			addr += n;
+			len -= n;
+		}
+	}
+	desc->txd.flags = flags;
+	spin_unlock_irqrestore(&tdc->lock, irq_flags);
+
+	return &desc->txd;
+
+out_put_busy:
+	tegra_apb_dma_put_desc(tdc, desc);
+out_busy:
+	spin_unlock_irqrestore(&tdc->lock, irq_flags);
+	dev_dbg(chan2dev(chan), "out of descriptors\n");
+	return NULL;
+
+out_put:
+	tegra_apb_dma_put_desc(tdc, desc);
+	spin_unlock_irqrestore(&tdc->lock, irq_flags);
+	return NULL;
+}
+
+static struct dma_async_tx_descriptor *tegra_apb_dma_prep_dma_cyclic(
+	struct dma_chan *chan, dma_addr_t buf_addr, size_t buf_len,
+	size_t period_len, enum dma_transfer_direction direction,
+	void *context)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(chan);
+	struct tegra_apb_dma_desc *desc;
+	struct tegra_apb_dma_seg *seg;
+	unsigned long flags;
+
+	if (!tdc->slave.cyclic ||
+		(direction != DMA_DEV_TO_MEM && direction != DMA_MEM_TO_DEV))
+		return NULL;
+
+	/* the hardware goes over the ring a pair of periods at a time */
+	if (!period_len || ((buf_addr | period_len) & 0x3) ||
+		(period_len * 2 > TEGRA_APB_DMA_MAX_SEG) ||
+		(buf_len % (period_len * 2))) {
+		dev_err(chan2dev(chan), "bad cyclic ring %zu/%zu\n",
+			buf_len, period_len);
+		return NULL;
+	}
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	desc = tegra_apb_dma_get_desc(tdc);
+	if (!desc || list_empty(&tdc->free_segs)) {
+		if (desc)
+			tegra_apb_dma_put_desc(tdc, desc);
+		spin_unlock_irqrestore(&tdc->lock, flags);
+		return NULL;
+	}
+
+	seg = list_first_entry(&tdc->free_segs, typeof(*seg), node);
+	list_move_tail(&seg->node, &desc->segs);
+	tegra_apb_dma_fill_req(tdc, &seg->req, direction, buf_addr, buf_len);
+	seg->req.period_size = period_len;
+	seg->desc = desc;
+	desc->segs_left = 1;
+	desc->len = buf_len;
+	desc->cyclic = true;
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	return &desc->txd;
+}
+
+static void tegra_apb_dma_issue_pending(struct dma_chan *chan)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(chan);
+	struct tegra_apb_dma_desc *desc, *tmp;
+	struct tegra_apb_dma_seg *seg;
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_for_each_entry_safe(desc, tmp, &tdc->queued, node) {
+		/* a ring never completes, nothing can go after it */
+		if (desc->cyclic && !list_empty(&tdc->active))
+			break;
+
+		list_move_tail(&desc->node, &tdc->active);
+		list_for_each_entry(seg, &desc->segs, node) {
+			err = tegra_dma_enqueue_req(tdc->hw, &seg->req);
+			if (err)
+				dev_err(chan2dev(chan),
+					"enqueue failed %d\n", err);
+		}
+	}
+	spin_unlock_irqrestore(&tdc->lock, flags);
+}
+
+static int tegra_apb_dma_terminate_all(struct tegra_apb_dma_chan *tdc)
+{
+	struct tegra_apb_dma_desc *desc, *tmp;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	/*
+	 * Aborted segments are not called back. One that completed just
+	 * before may be, so the lock is only taken once the channel stopped.
+	 */
+	tegra_dma_cancel(tdc->hw);
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_splice_tail_init(&tdc->active, &list);
+	list_splice_tail_init(&tdc->queued, &list);
+	list_splice_tail_init(&tdc->completed, &list);
+	list_for_each_entry_safe(desc, tmp, &list, node)
+		tegra_apb_dma_put_desc(tdc, desc);
+	tdc->periods = 0;
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	return 0;
+}
+
+static int tegra_apb_dma_slave_config(struct tegra_apb_dma_chan *tdc,
+	struct dma_slave_config *cfg)
+{
+	enum dma_slave_buswidth width;
+
+	width = cfg->direction == DMA_DEV_TO_MEM ? cfg->src_addr_width :
+		cfg->dst_addr_width;
+	if (width == DMA_SLAVE_BUSWIDTH_UNDEFINED)
+		width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	if (width > DMA_SLAVE_BUSWIDTH_4_BYTES)
+		return -EINVAL;
+
+	tdc->cfg = *cfg;
+	tdc->cfg.src_addr_width = width;
+	tdc->cfg.dst_addr_width = width;
+	return 0;
+}
+
+static int tegra_apb_dma_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+	unsigned long arg)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(chan);
+
+	switch (cmd) {
+	case DMA_TERMINATE_ALL:
+		return tegra_apb_dma_terminate_all(tdc);
+	case DMA_SLAVE_CONFIG:
+		return tegra_apb_dma_slave_config(tdc,
+			(struct dma_slave_config *)arg);
+	default:
+		return -ENXIO;
+	}
+}
+
+static enum dma_status tegra_apb_dma_tx_status(struct dma_chan *chan,
+	dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(chan);
+	struct tegra_apb_dma_desc *desc;
+	struct tegra_apb_dma_seg *seg;
+	enum dma_status ret;
+	unsigned long flags;
+	u32 residue = 0;
+
+	ret = dma_cookie_status(chan, cookie, txstate);
+	if (ret == DMA_SUCCESS || !txstate)
+		return ret;
+
+	spin_lock_irqsave(&tdc->lock, flags);
+	list_for_each_entry(desc, &tdc->active, node) {
+		if (desc->txd.cookie != cookie)
+			continue;
+		residue = desc->len - desc->done;
+		list_for_each_entry(seg, &desc->segs, node) {
+			if (seg->req.status != TEGRA_DMA_REQ_INFLIGHT)
+				continue;
+			/* the ring offset for a cyclic transfer */
+			residue -= tegra_dma_get_transfer_count(tdc->hw,
+				&seg->req);
+			break;
+		}
+		break;
+	}
+	spin_unlock_irqrestore(&tdc->lock, flags);
+
+	dma_set_residue(txstate, residue);
+	return ret;
+}
+
+static int tegra_apb_dma_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(chan);
+	struct tegra_dma_slave *slave = chan->private;
+	int i;
+
+	/* the request selector comes from tegra_dma_filter() */
+	if (!slave)
+		return -EINVAL;
+	tdc->slave = *slave;
+
+	tdc->descs = kcalloc(TEGRA_APB_DMA_DESCS, sizeof(*tdc->descs),
+		GFP_KERNEL);
+	tdc->segs = kcalloc(TEGRA_APB_DMA_SEGS, sizeof(*tdc->segs),
+		GFP_KERNEL);
+	if (!tdc->descs || !tdc->segs)
+		goto fail;
+
+	tdc->hw = tegra_dma_allocate_channel(slave->cyclic ?
+		TEGRA_DMA_MODE_CYCLIC : TEGRA_DMA_MODE_ONESHOT,
+		"dmaengine%d", chan->chan_id);
+	if (!tdc->hw)
+		goto fail;
+
+	for (i = 0; i < TEGRA_APB_DMA_DESCS; i++) {
+		dma_async_tx_descriptor_init(&tdc->descs[i].txd, chan);
+		tdc->descs[i].txd.tx_submit = tegra_apb_dma_tx_submit;
+		list_add_tail(&tdc->descs[i].node, &tdc->free_descs);
+	}
+	for (i = 0; i < TEGRA_APB_DMA_SEGS; i++)
+		list_add_tail(&tdc->segs[i].node, &tdc->free_segs);
+
+	tdc->cfg.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	tdc->cfg.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	dma_cookie_init(chan);
+
+	return TEGRA_APB_DMA_DESCS;
+
+fail:
+	kfree(tdc->segs);
+	kfree(tdc->descs);
+	tdc->segs = NULL;
+	tdc->descs = NULL;
+	return -ENOMEM;
+}
+
+static void tegra_apb_dma_free_chan_resources(struct dma_chan *chan)
+{
+	struct tegra_apb_dma_chan *tdc = to_tdc(chan);
+
+	tegra_apb_dma_terminate_all(tdc);
+	tasklet_kill(&tdc->tasklet);
+	tegra_dma_free_channel(tdc->hw);
+	tdc->hw = NULL;
+
+	INIT_LIST_HEAD(&tdc->free_descs);
+	INIT_LIST_HEAD(&tdc->free_segs);
+	kfree(tdc->segs);
+	kfree(tdc->descs);
+	tdc->segs = NULL;
+	tdc->descs = NULL;
+}
+
+bool tegra_dma_filter(struct dma_chan *chan, void *param)
+{
+	if (chan->device->dev->driver != &tegra_apb_dma_driver.driver)
+		return false;
+
+	chan->private = param;
+	return true;
+}
+EXPORT_SYMBOL(tegra_dma_filter);
+
+static int __devinit tegra_apb_dma_probe(struct platform_device *pdev)
+{
+	struct tegra_apb_dma *tdma;
+	struct dma_device *dma;
+	int i, err;
+
+	tdma = kzalloc(sizeof(*tdma), GFP_KERNEL);
+	if (!tdma)
+		return -ENOMEM;
+
+	dma = &tdma->dma;
+	dma->dev = &pdev->dev;
+	INIT_LIST_HEAD(&dma->channels);
+	dma_cap_set(DMA_SLAVE, dma->cap_mask);
+	dma_cap_set(DMA_CYCLIC, dma->cap_mask);
+	dma->device_alloc_chan_resources = tegra_apb_dma_alloc_chan_resources;
+	dma->device_free_chan_resources = tegra_apb_dma_free_chan_resources;
+	dma->device_prep_slave_sg = tegra_apb_dma_prep_slave_sg;
+	dma->device_prep_dma_cyclic = tegra_apb_dma_prep_dma_cyclic;
+	dma->device_control = tegra_apb_dma_control;
+	dma->device_tx_status = tegra_apb_dma_tx_status;
+	dma->device_issue_pending = tegra_apb_dma_issue_pending;
+
+	for (i = 0; i < TEGRA_APB_DMA_CHANNELS; i++) {
+		struct tegra_apb_dma_chan *tdc = &tdma->channels[i];
+
+		tdc->chan.device = dma;
+		dma_cookie_init(&tdc->chan);
+		spin_lock_init(&tdc->lock);
+		INIT_LIST_HEAD(&tdc->free_descs);
+		INIT_LIST_HEAD(&tdc->free_segs);
+		INIT_LIST_HEAD(&tdc->queued);
+		INIT_LIST_HEAD(&tdc->active);
+		INIT_LIST_HEAD(&tdc->completed);
+		tasklet_init(&tdc->tasklet, tegra_apb_dma_tasklet,
+			(unsigned long)tdc);
+		list_add_tail(&tdc->chan.device_node, &dma->channels);
+	}
+
+	err = dma_async_device_register(dma);
+	if (err) {
+		dev_err(&pdev->dev, "dma_async_device_register failed %d\n",
+			err);
+		kfree(tdma);
+		return err;
+	}
+
+	platform_set_drvdata(pdev, tdma);
+	dev_info(&pdev->dev, "%d channels\n", TEGRA_APB_DMA_CHANNELS);
+	return 0;
+}
+
+static int __devexit tegra_apb_dma_remove(struct platform_device *pdev)
+{
+	struct tegra_apb_dma *tdma = platform_get_drvdata(pdev);
+
+	dma_async_device_unregister(&tdma->dma);
+	kfree(tdma);
+	return 0;
+}
+
+static struct platform_driver tegra_apb_dma_driver = {
+	.probe		= tegra_apb_dma_probe,
+	.remove		= __devexit_p(tegra_apb_dma_remove),
+	.driver		= {
+		.name	= DRV_NAME,
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int __init tegra_apb_dma_init(void)
+{
+	return platform_driver_register(&tegra_apb_dma_driver);
+}
+subsys_initcall(tegra_apb_dma_init);
+
+static void __exit tegra_apb_dma_exit(void)
+{
+	platform_driver_unregister(&tegra_apb_dma_driver);
+}
+module_exit(tegra_apb_dma_exit);
+
+MODULE_DESCRIPTION("NVIDIA Tegra APB DMA dmaengine driver");
+MODULE_LICENSE("GPL");
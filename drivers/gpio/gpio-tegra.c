@@ -23,6 +23,8 @@
 #include <linux/irq.h>
 #include <linux/interrupt.h>
 #include <linux/delay.h>
+#include <linux/module.h>
+#include <linux/sched.h>
 
 #include <linux/io.h>
 #include <linux/gpio.h>
@@ -81,10 +83,28 @@
 #define GPIO_INT_LVL_LEVEL_HIGH		0x000001
 #define GPIO_INT_LVL_LEVEL_LOW		0x000000
 
+/*
+ * Passes over a bank before the chained handler gives up and lets the
+ * parent interrupt fire again. Interrupts raised while the first pass
+ * was dispatching are picked up without another exit and entry.
+ */
+#define GPIO_IRQ_MAX_PASSES		4
+
+struct tegra_gpio_irq_stats {
+	u32 entries;
+	u32 dispatched;
+	u32 spurious;
+	u32 rescans;
+	u32 max_batch;
+	u64 total_ns;
+	u32 max_ns;
+};
+
 struct tegra_gpio_bank {
 	int bank;
 	int irq;
 	spinlock_t lvl_lock[4];
+	struct tegra_gpio_irq_stats stats;
 #ifdef CONFIG_PM_SLEEP
 	u32 cnf[4];
 	u32 out[4];
@@ -257,6 +277,22 @@ static void tegra_gpio_irq_ack(struct irq_data *d)
 #endif
 }
 
+/*
+ * Used by handle_level_irq(), which is what level triggered and oneshot
+ * threaded consumers run through: mask and clear in one chip call.
+ */
+static void tegra_gpio_irq_mask_ack(struct irq_data *d)
+{
+	int gpio = d->irq - INT_GPIO_BASE;
+
+	tegra_gpio_mask_write(GPIO_MSK_INT_ENB(gpio), gpio, 0);
+	__raw_writel(1 << GPIO_BIT(gpio), GPIO_INT_CLR(gpio));
+
+#ifdef CONFIG_TEGRA_FPGA_PLATFORM
+	udelay(15);
+#endif
+}
+
 static void tegra_gpio_irq_mask(struct irq_data *d)
 {
 	int gpio = d->irq - INT_GPIO_BASE;
@@ -327,28 +363,74 @@ static int tegra_gpio_irq_set_type(struct irq_data *d, unsigned int type)
 	return 0;
 }
 
+static bool irq_stats = true;
+module_param(irq_stats, bool, 0644);
+
+/* Pending and enabled bits of all four ports, port n in bits 8n..8n+7 */
+static u32 tegra_gpio_bank_pending(struct tegra_gpio_bank *bank)
+{
+	u32 pending = 0;
+	int port;
+
+	for (port = 0; port < 4; port++) {
+		int gpio = tegra_gpio_compose(bank->bank, port, 0);
+
+		pending |= (__raw_readl(GPIO_INT_STA(gpio)) &
+			    __raw_readl(GPIO_INT_ENB(gpio)) & 0xff) << (port * 8);
+	}
+	return pending;
+}
+
 static void tegra_gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 {
 	struct tegra_gpio_bank *bank;
-	int port;
-	int pin;
+	struct tegra_gpio_irq_stats *st;
 	struct irq_chip *chip = irq_desc_get_chip(desc);
+	unsigned long long start = 0;
+	unsigned int batch = 0;
+	int first;
+	int pass;
+	u32 pending;
+	u32 ns;
 
 	chained_irq_enter(chip, desc);
 
 	bank = irq_get_handler_data(irq);
+	st = &bank->stats;
+	if (irq_stats)
+		start = sched_clock();
+	first = tegra_gpio_compose(bank->bank, 0, 0);
+
+	for (pass = 0; pass < GPIO_IRQ_MAX_PASSES; pass++) {
+		pending = tegra_gpio_bank_pending(bank);
+		if (!pending)
+			break;
+		if (pass)
+			st->rescans++;
+
+		while (pending) {
+			int pin = __ffs(pending);
+
+			pending &= ~BIT(pin);
+			generic_handle_irq(gpio_to_irq(first + pin));
+			batch++;
+		}
+	}
 
-	for (port = 0; port < 4; port++) {
-		int gpio = tegra_gpio_compose(bank->bank, port, 0);
-		unsigned long sta = __raw_readl(GPIO_INT_STA(gpio)) &
-			__raw_readl(GPIO_INT_ENB(gpio));
-
-		for_each_set_bit(pin, &sta, 8)
-			generic_handle_irq(gpio_to_irq(gpio + pin));
+	st->entries++;
+	if (!batch)
+		st->spurious++;
+	st->dispatched += batch;
+	if (batch > st->max_batch)
+		st->max_batch = batch;
+	if (irq_stats) {
+		ns = (u32)(sched_clock() - start);
+		st->total_ns += ns;
+		if (ns > st->max_ns)
+			st->max_ns = ns;
 	}
 
 	chained_irq_exit(chip, desc);
-
 }
 
 #ifdef CONFIG_PM_SLEEP
@@ -481,6 +563,7 @@ static struct irq_chip tegra_gpio_irq_chip = {
 	.name		= "GPIO",
 	.irq_ack	= tegra_gpio_irq_ack,
 	.irq_mask	= tegra_gpio_irq_mask,
+	.irq_mask_ack	= tegra_gpio_irq_mask_ack,
 	.irq_unmask	= tegra_gpio_irq_unmask,
 	.irq_set_type	= tegra_gpio_irq_set_type,
 	.irq_set_wake	= tegra_gpio_irq_set_wake,
@@ -603,10 +686,57 @@ static const struct file_operations debug_fops = {
 	.release	= single_release,
 };
 
+static int dbg_gpio_irq_show(struct seq_file *s, void *unused)
+{
+	struct tegra_gpio_irq_stats st;
+	int i;
+
+	seq_printf(s, "%-4s %4s %10s %10s %8s %8s %5s %8s %8s\n",
+		   "bank", "irq", "entries", "dispatched", "spurious",
+		   "rescans", "batch", "avg_ns", "max_ns");
+	for (i = 0; i < ARRAY_SIZE(tegra_gpio_banks); i++) {
+		st = tegra_gpio_banks[i].stats;
+		seq_printf(s, "%-4d %4d %10u %10u %8u %8u %5u %8llu %8u\n",
+			   i, tegra_gpio_banks[i].irq, st.entries,
+			   st.dispatched, st.spurious, st.rescans,
+			   st.max_batch,
+			   st.entries ? div_u64(st.total_ns, st.entries) : 0,
+			   st.max_ns);
+	}
+	return 0;
+}
+
+static int dbg_gpio_irq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_gpio_irq_show, &inode->i_private);
+}
+
+static ssize_t dbg_gpio_irq_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	int i;
+
+	/* Any write clears the counters */
+	for (i = 0; i < ARRAY_SIZE(tegra_gpio_banks); i++)
+		memset(&tegra_gpio_banks[i].stats, 0,
+		       sizeof(tegra_gpio_banks[i].stats));
+	return count;
+}
+
+static const struct file_operations debug_irq_fops = {
+	.open		= dbg_gpio_irq_open,
+	.read		= seq_read,
+	.write		= dbg_gpio_irq_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init tegra_gpio_debuginit(void)
 {
 	(void) debugfs_create_file("tegra_gpio", S_IRUGO,
 					NULL, NULL, &debug_fops);
+	(void) debugfs_create_file("tegra_gpio_irq", S_IRUGO | S_IWUSR,
+					NULL, NULL, &debug_irq_fops);
 	return 0;
 }
 late_initcall(tegra_gpio_debuginit);
@@ -565,6 +565,18 @@ struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
 	return handle;
 }
 
+struct nvmap_handle_ref *nvmap_duplicate_handle_fd(struct nvmap_client *client,
+						   int fd)
+{
+	return ion_import_fd(client, fd);
+}
+
+/* ion buffers are shared through ION_IOC_SHARE on the ion device */
+int nvmap_share_fd(struct nvmap_client *client, struct nvmap_handle_ref *r)
+{
+	return -EOPNOTSUPP;
+}
+
 void _nvmap_handle_free(struct nvmap_handle *h)
 {
 	ion_handle_put(h);
@@ -70,6 +70,7 @@ struct mt_device {
 	__u8 num_expected;	/* expected last contact index */
 	__u8 maxcontacts;
 	bool curvalid;		/* is the current contact valid? */
+	ktime_t frame_time;	/* arrival of the first report of the frame */
 	struct mt_slot *slots;
 };
 
@@ -284,6 +285,7 @@ static int mt_input_mapping(struct hid_device *hdev, struct hid_input *hi,
 			if (!td->maxcontacts)
 				td->maxcontacts = MT_DEFAULT_MAXCONTACT;
 			input_mt_init_slots(hi->input, td->maxcontacts);
+			input_set_capability(hi->input, EV_MSC, MSC_TIMESTAMP);
 			td->last_slot_field = usage->hid;
 			td->last_field_index = field->index;
 			td->last_mt_collection = usage->collection_index;
@@ -430,8 +432,24 @@ static void mt_emit_event(struct mt_device *td, struct input_dev *input)
 	}
 
 	input_mt_report_pointer_emulation(input, true);
+	input_event(input, EV_MSC, MSC_TIMESTAMP,
+		    (u32)ktime_to_us(td->frame_time));
 	input_sync(input);
 	td->num_received = 0;
+	td->frame_time = ktime_set(0, 0);
+}
+
+/*
+ * A frame can span several reports: all of its events carry the time the
+ * one holding its first contact came in, as seen by the transport when it
+ * can tell.
+ */
+static void mt_start_frame(struct mt_device *td, struct hid_device *hid,
+		struct input_dev *input)
+{
+	td->frame_time = hid->report_time.tv64 ? hid->report_time :
+		ktime_get();
+	input_set_timestamp(input, td->frame_time);
 }
 
 
@@ -443,6 +461,9 @@ static int mt_event(struct hid_device *hid, struct hid_field *field,
 	__s32 quirks = td->mtclass->quirks;
 
 	if (hid->claimed & HID_CLAIMED_INPUT && td->slots) {
+		if (!td->num_received)
+			mt_start_frame(td, hid, field->hidinput->input);
+
 		switch (usage->hid) {
 		case HID_DG_INRANGE:
 			if (quirks & MT_QUIRK_VALID_IS_INRANGE)
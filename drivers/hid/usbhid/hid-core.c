@@ -244,9 +244,11 @@ static void hid_irq_in(struct urb *urb)
 	case 0:			/* success */
 		usbhid_mark_busy(usbhid);
 		usbhid->retry_delay = 0;
+		hid->report_time = ktime_get();
 		hid_input_report(urb->context, HID_INPUT_REPORT,
 				 urb->transfer_buffer,
 				 urb->actual_length, 1);
+		hid->report_time = ktime_set(0, 0);
 		/*
 		 * autosuspend refused while keys are pressed
 		 * because most keyboards don't wake up when
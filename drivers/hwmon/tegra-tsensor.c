@@ -1655,13 +1655,21 @@ static void tsensor_work_func(struct work_struct *work)
 	if (!tsensor_within_limits(data)) {
 		data->alert_func(data->alert_data);
 
-		if (!tsensor_within_limits(data))
+		/*
+		 * The alert normally recentres the TH1/TH2 window on the
+		 * current temperature, after which the threshold interrupt
+		 * alone is enough. Only keep sampling, once per
+		 * measurement period, while still outside it, as on a fast
+		 * ramp through several zones.
+		 */
+		if (!tsensor_within_limits(data)) {
 			dev_dbg(data->hwmon_dev,
 				"repeated work queueing state=%d\n",
 				get_ts_state(data));
 			queue_delayed_work(data->workqueue, &data->work,
 				HZ * DEFAULT_TSENSOR_M /
 				DEFAULT_TSENSOR_CLK_HZ);
+		}
 	}
 }
 
@@ -34,15 +34,35 @@
 #include <linux/i2c-tegra.h>
 #include <linux/of_i2c.h>
 #include <linux/spinlock.h>
+#include <linux/dma-mapping.h>
+#include <linux/workqueue.h>
+#include <linux/moduleparam.h>
 
 #include <asm/unaligned.h>
 
 #include <mach/clk.h>
+#include <mach/dma.h>
+#include <mach/iomap.h>
 #include <mach/pinmux.h>
 
 #define TEGRA_I2C_TIMEOUT			(msecs_to_jiffies(1000))
 #define TEGRA_I2C_RETRIES			3
 #define BYTES_PER_FIFO_WORD			4
+#define I2C_FIFO_DEPTH				8
+#define I2C_PACKET_HEADER_WORDS			3
+#define I2C_DMA_BUF_SIZE			PAGE_SIZE
+
+/* Messages longer than this, four fifo fills, go through the APB DMA */
+static unsigned int dma_min_bytes = 4 * BYTES_PER_FIFO_WORD * I2C_FIFO_DEPTH;
+module_param(dma_min_bytes, uint, 0644);
+
+/*
+ * Default runtime PM autosuspend delay: the controller clocks stay on this
+ * long after the last transfer. Per controller it can be changed through
+ * power/autosuspend_delay_ms.
+ */
+static unsigned int clk_idle_ms = 10;
+module_param(clk_idle_ms, uint, 0644);
 
 #define I2C_CNFG				0x000
 #define I2C_CNFG_DEBOUNCE_CNT_SHIFT		12
@@ -167,6 +187,11 @@ struct tegra_i2c_bus {
  * @msg_read: identifies read transfers
  * @bus_clk_rate: current i2c bus clock rate
  * @is_suspended: prevents i2c controller accesses after suspend is called
+ * @phys: physical base of the registers, for the DMA fifo addresses
+ * @dma_chan: oneshot APB DMA channel, NULL when the fifo is always used
+ * @dma_buf: bounce buffer for the payload of DMA transfers
+ * @is_curr_dma_xfer: the payload of the current message goes through DMA
+ * @is_fifo_dma_trig: fifo triggers are set up for DMA requests
  */
 struct tegra_i2c_dev {
 	struct device *dev;
@@ -201,9 +226,32 @@ struct tegra_i2c_dev {
 	bool is_high_speed_enable;
 	u16 hs_master_code;
 	int (*arb_recovery)(int scl_gpio, int sda_gpio);
+	unsigned long phys;
+	struct tegra_dma_channel *dma_chan;
+	struct tegra_dma_req dma_req;
+	u32 *dma_buf;
+	dma_addr_t dma_buf_phys;
+	struct completion dma_complete;
+	bool is_curr_dma_xfer;
+	bool is_fifo_dma_trig;
 	struct tegra_i2c_bus busses[1];
 };
 
+static const struct {
+	unsigned long base;
+	unsigned long req_sel;
+} tegra_i2c_dma_req_sels[] = {
+	{ TEGRA_I2C_BASE,	TEGRA_DMA_REQ_SEL_I2C },
+	{ TEGRA_I2C2_BASE,	TEGRA_DMA_REQ_SEL_I2C2 },
+	{ TEGRA_I2C3_BASE,	TEGRA_DMA_REQ_SEL_I2C3 },
+#ifdef CONFIG_ARCH_TEGRA_2x_SOC
+	{ TEGRA_DVC_BASE,	TEGRA_DMA_REQ_SEL_DVC_I2C },
+#else
+	{ TEGRA_I2C4_BASE,	TEGRA_DMA_REQ_SEL_I2C4 },
+	{ TEGRA_I2C5_BASE,	TEGRA_DMA_REQ_SEL_DVC_I2C },
+#endif
+};
+
 static void dvc_writel(struct tegra_i2c_dev *i2c_dev, u32 val, unsigned long reg)
 {
 	writel(val, i2c_dev->base + reg);
@@ -299,6 +347,24 @@ static int tegra_i2c_flush_fifos(struct tegra_i2c_dev *i2c_dev)
 	return 0;
 }
 
+/*
+ * The APB DMA moves one word per request on the i2c request lines, so in
+ * DMA mode both fifos ask for service as soon as one word is free/full.
+ */
+static void tegra_i2c_set_fifo_trig(struct tegra_i2c_dev *i2c_dev, bool dma)
+{
+	u32 val;
+
+	if (dma)
+		val = 0 << I2C_FIFO_CONTROL_TX_TRIG_SHIFT |
+			0 << I2C_FIFO_CONTROL_RX_TRIG_SHIFT;
+	else
+		val = 7 << I2C_FIFO_CONTROL_TX_TRIG_SHIFT |
+			0 << I2C_FIFO_CONTROL_RX_TRIG_SHIFT;
+	i2c_writel(i2c_dev, val, I2C_FIFO_CONTROL);
+	i2c_dev->is_fifo_dma_trig = dma;
+}
+
 static int tegra_i2c_empty_rx_fifo(struct tegra_i2c_dev *i2c_dev)
 {
 	u32 val;
@@ -473,6 +539,90 @@ static inline void tegra_i2c_clock_disable(struct tegra_i2c_dev *i2c_dev)
 	clk_disable(i2c_dev->fast_clk);
 }
 
+static void tegra_i2c_dma_complete(struct tegra_dma_req *req)
+{
+	struct tegra_i2c_dev *i2c_dev = req->dev;
+
+	complete(&i2c_dev->dma_complete);
+}
+
+static void tegra_i2c_init_dma(struct tegra_i2c_dev *i2c_dev)
+{
+	struct tegra_dma_req *req = &i2c_dev->dma_req;
+	unsigned long req_sel = TEGRA_DMA_REQ_SEL_INVALID;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tegra_i2c_dma_req_sels); i++)
+		if (tegra_i2c_dma_req_sels[i].base == i2c_dev->phys)
+			req_sel = tegra_i2c_dma_req_sels[i].req_sel;
+	if (req_sel == TEGRA_DMA_REQ_SEL_INVALID)
+		return;
+
+	i2c_dev->dma_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_ONESHOT,
+				"i2c_%d", i2c_dev->cont_id);
+	if (!i2c_dev->dma_chan) {
+		dev_warn(i2c_dev->dev, "no dma channel, using pio only\n");
+		return;
+	}
+
+	i2c_dev->dma_buf = dma_alloc_coherent(i2c_dev->dev, I2C_DMA_BUF_SIZE,
+				&i2c_dev->dma_buf_phys, GFP_KERNEL);
+	if (!i2c_dev->dma_buf) {
+		dev_warn(i2c_dev->dev, "no dma bounce buffer, using pio only\n");
+		tegra_dma_free_channel(i2c_dev->dma_chan);
+		i2c_dev->dma_chan = NULL;
+		return;
+	}
+
+	memset(req, 0, sizeof(*req));
+	req->req_sel = req_sel;
+	req->dev = i2c_dev;
+	req->complete = tegra_i2c_dma_complete;
+	req->source_bus_width = 32;
+	req->dest_bus_width = 32;
+	req->virt_addr = i2c_dev->dma_buf;
+	init_completion(&i2c_dev->dma_complete);
+}
+
+static void tegra_i2c_deinit_dma(struct tegra_i2c_dev *i2c_dev)
+{
+	if (!i2c_dev->dma_chan)
+		return;
+
+	tegra_dma_free_channel(i2c_dev->dma_chan);
+	dma_free_coherent(i2c_dev->dev, I2C_DMA_BUF_SIZE, i2c_dev->dma_buf,
+			  i2c_dev->dma_buf_phys);
+	i2c_dev->dma_chan = NULL;
+}
+
+/* The payload of msg through the fifo of its direction, headers are in */
+static int tegra_i2c_start_dma(struct tegra_i2c_dev *i2c_dev,
+	struct i2c_msg *msg)
+{
+	struct tegra_dma_req *req = &i2c_dev->dma_req;
+
+	req->size = ALIGN(msg->len, BYTES_PER_FIFO_WORD);
+	if (msg->flags & I2C_M_RD) {
+		req->to_memory = 1;
+		req->source_addr = i2c_dev->phys +
+			tegra_i2c_reg_addr(i2c_dev, I2C_RX_FIFO);
+		req->source_wrap = 4;
+		req->dest_addr = i2c_dev->dma_buf_phys;
+		req->dest_wrap = 0;
+	} else {
+		memcpy(i2c_dev->dma_buf, msg->buf, msg->len);
+		req->to_memory = 0;
+		req->source_addr = i2c_dev->dma_buf_phys;
+		req->source_wrap = 0;
+		req->dest_addr = i2c_dev->phys +
+			tegra_i2c_reg_addr(i2c_dev, I2C_TX_FIFO);
+		req->dest_wrap = 4;
+	}
+
+	INIT_COMPLETION(i2c_dev->dma_complete);
+	return tegra_dma_enqueue_req(i2c_dev->dma_chan, req);
+}
+
 static int tegra_i2c_init(struct tegra_i2c_dev *i2c_dev)
 {
 	u32 val;
@@ -503,9 +653,7 @@ static int tegra_i2c_init(struct tegra_i2c_dev *i2c_dev)
 
 	}
 
-	val = 7 << I2C_FIFO_CONTROL_TX_TRIG_SHIFT |
-		0 << I2C_FIFO_CONTROL_RX_TRIG_SHIFT;
-	i2c_writel(i2c_dev, val, I2C_FIFO_CONTROL);
+	tegra_i2c_set_fifo_trig(i2c_dev, false);
 
 	if (!i2c_dev->is_dvc)
 		tegra_i2c_slave_init(i2c_dev);
@@ -587,6 +735,10 @@ static irqreturn_t tegra_i2c_isr(int irq, void *dev_id)
 		goto err;
 	}
 
+	/* In DMA mode the fifo requests go to the DMA, not here */
+	if (i2c_dev->is_curr_dma_xfer)
+		goto ack;
+
 	if (i2c_dev->msg_read && (status & I2C_INT_RX_FIFO_DATA_REQ)) {
 		if (i2c_dev->msg_buf_remaining)
 			tegra_i2c_empty_rx_fifo(i2c_dev);
@@ -601,6 +753,7 @@ static irqreturn_t tegra_i2c_isr(int irq, void *dev_id)
 			tegra_i2c_mask_irq(i2c_dev, I2C_INT_TX_FIFO_DATA_REQ);
 	}
 
+ack:
 	i2c_writel(i2c_dev, status, I2C_INT_STATUS);
 
 	if (i2c_dev->is_dvc)
@@ -652,36 +805,30 @@ err:
 	return IRQ_HANDLED;
 }
 
-static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
-	struct i2c_msg *msg, enum msg_end_type end_state)
+static enum msg_end_type tegra_i2c_msg_end(struct i2c_msg msgs[], int i,
+	int num)
 {
-	struct tegra_i2c_dev *i2c_dev = i2c_bus->dev;
-	u32 int_mask;
-	int ret;
-	int arb_stat;
-
-	if (msg->len == 0)
-		return -EINVAL;
-
-	tegra_i2c_flush_fifos(i2c_dev);
-
-	i2c_dev->msg_buf = msg->buf;
-	i2c_dev->msg_buf_remaining = msg->len;
-	i2c_dev->msg_err = I2C_ERR_NONE;
-	i2c_dev->msg_read = (msg->flags & I2C_M_RD);
-	INIT_COMPLETION(i2c_dev->msg_complete);
-	i2c_dev->msg_add = msg->addr;
+	if (i == num - 1)
+		return MSG_END_STOP;
+	if (msgs[i + 1].flags & I2C_M_NOSTART)
+		return MSG_END_CONTINUE;
+	return MSG_END_REPEAT_START;
+}
 
+static void tegra_i2c_write_packet_header(struct tegra_i2c_dev *i2c_dev,
+	struct i2c_msg *msg, enum msg_end_type end_state, int packet_id,
+	bool irq_on_complete)
+{
 	i2c_dev->packet_header = (0 << PACKET_HEADER0_HEADER_SIZE_SHIFT) |
 			PACKET_HEADER0_PROTOCOL_I2C |
 			(i2c_dev->cont_id << PACKET_HEADER0_CONT_ID_SHIFT) |
-			(1 << PACKET_HEADER0_PACKET_ID_SHIFT);
+			(packet_id << PACKET_HEADER0_PACKET_ID_SHIFT);
 	i2c_writel(i2c_dev, i2c_dev->packet_header, I2C_TX_FIFO);
 
 	i2c_dev->payload_size = msg->len - 1;
 	i2c_writel(i2c_dev, i2c_dev->payload_size, I2C_TX_FIFO);
 
-	i2c_dev->io_header = I2C_HEADER_IE_ENABLE;
+	i2c_dev->io_header = irq_on_complete ? I2C_HEADER_IE_ENABLE : 0;
 	if (end_state == MSG_END_CONTINUE)
 		i2c_dev->io_header |= I2C_HEADER_CONTINUE_XFER;
 	else if (end_state == MSG_END_REPEAT_START)
@@ -702,15 +849,104 @@ static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
 		i2c_dev->io_header |= ((i2c_dev->hs_master_code & 0x7) <<  I2C_HEADER_MASTER_ADDR_SHIFT);
 	}
 	i2c_writel(i2c_dev, i2c_dev->io_header, I2C_TX_FIFO);
+}
+
+/* Payload of a chained write, known to fit in the fifo */
+static void tegra_i2c_write_payload(struct tegra_i2c_dev *i2c_dev,
+	struct i2c_msg *msg)
+{
+	int words = msg->len / BYTES_PER_FIFO_WORD;
+	int partial = msg->len % BYTES_PER_FIFO_WORD;
+	u32 val = 0;
+
+	if (words)
+		i2c_writesl(i2c_dev, msg->buf, I2C_TX_FIFO, words);
+	if (partial) {
+		memcpy(&val, msg->buf + words * BYTES_PER_FIFO_WORD, partial);
+		i2c_writel(i2c_dev, val, I2C_TX_FIFO);
+	}
+}
+
+/*
+ * Number of short writes at the head of msgs[] that can be queued, headers
+ * and payload, in the tx fifo ahead of the packet header of the message
+ * that follows them. The controller then runs the whole combined
+ * transfer, typically a register address write and the read of its
+ * contents, with a single completion interrupt.
+ */
+static int tegra_i2c_chain_len(struct i2c_msg msgs[], int num)
+{
+	int words = I2C_PACKET_HEADER_WORDS;
+	int i;
+
+	for (i = 0; i < num - 1; i++) {
+		if (msgs[i].flags & (I2C_M_RD | I2C_M_IGNORE_NAK) ||
+		    !msgs[i].len)
+			break;
+		words += I2C_PACKET_HEADER_WORDS +
+			DIV_ROUND_UP(msgs[i].len, BYTES_PER_FIFO_WORD);
+		if (words > I2C_FIFO_DEPTH)
+			break;
+	}
+	return i;
+}
+
+/*
+ * Transfer msgs[count - 1], after queueing msgs[0] to msgs[count - 2] as
+ * chained writes ahead of it.
+ */
+static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
+	struct i2c_msg *msgs, int count, enum msg_end_type end_state)
+{
+	struct tegra_i2c_dev *i2c_dev = i2c_bus->dev;
+	struct i2c_msg *msg = &msgs[count - 1];
+	u32 int_mask;
+	int ret;
+	int arb_stat;
+	bool dma;
+	int i;
+
+	if (msg->len == 0)
+		return -EINVAL;
+
+	dma = i2c_dev->dma_chan && msg->len > dma_min_bytes &&
+		msg->len <= I2C_DMA_BUF_SIZE;
+	if (dma != i2c_dev->is_fifo_dma_trig)
+		tegra_i2c_set_fifo_trig(i2c_dev, dma);
+
+	tegra_i2c_flush_fifos(i2c_dev);
+
+	i2c_dev->is_curr_dma_xfer = dma;
+	i2c_dev->msg_buf = msg->buf;
+	i2c_dev->msg_buf_remaining = dma ? 0 : msg->len;
+	i2c_dev->msg_err = I2C_ERR_NONE;
+	i2c_dev->msg_read = (msg->flags & I2C_M_RD);
+	INIT_COMPLETION(i2c_dev->msg_complete);
+	i2c_dev->msg_add = msg->addr;
 
-	if (!(msg->flags & I2C_M_RD))
+	for (i = 0; i < count - 1; i++) {
+		tegra_i2c_write_packet_header(i2c_dev, &msgs[i],
+			tegra_i2c_msg_end(msgs, i, count), i + 1, false);
+		tegra_i2c_write_payload(i2c_dev, &msgs[i]);
+	}
+	tegra_i2c_write_packet_header(i2c_dev, msg, end_state, count, true);
+
+	if (dma) {
+		ret = tegra_i2c_start_dma(i2c_dev, msg);
+		if (ret) {
+			dev_err(i2c_dev->dev, "dma enqueue failed %d\n", ret);
+			tegra_i2c_init(i2c_dev);
+			return ret;
+		}
+	} else if (!(msg->flags & I2C_M_RD)) {
 		tegra_i2c_fill_tx_fifo(i2c_dev);
+	}
 
 	if (i2c_dev->is_dvc)
 		dvc_i2c_unmask_irq(i2c_dev, DVC_CTRL_REG3_I2C_DONE_INTR_EN);
 
 	int_mask = I2C_INT_NO_ACK | I2C_INT_ARBITRATION_LOST | I2C_INT_TX_FIFO_OVERFLOW;
-	if (msg->flags & I2C_M_RD)
+	if ((msg->flags & I2C_M_RD) && !dma)
 		int_mask |= I2C_INT_RX_FIFO_DATA_REQ;
 	else if (i2c_dev->msg_buf_remaining)
 		int_mask |= I2C_INT_TX_FIFO_DATA_REQ;
@@ -725,6 +961,16 @@ static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
 	if (i2c_dev->is_dvc)
 		dvc_i2c_mask_irq(i2c_dev, DVC_CTRL_REG3_I2C_DONE_INTR_EN);
 
+	/* The last rx words may still be on their way out of the fifo */
+	if (dma) {
+		if (ret && i2c_dev->msg_err == I2C_ERR_NONE)
+			ret = wait_for_completion_timeout(
+				&i2c_dev->dma_complete, TEGRA_I2C_TIMEOUT);
+		if (!completion_done(&i2c_dev->dma_complete))
+			tegra_dma_dequeue_req(i2c_dev->dma_chan,
+					      &i2c_dev->dma_req);
+	}
+
 	if (WARN_ON(ret == 0)) {
 		dev_err(i2c_dev->dev,
 			"i2c transfer timed out, addr 0x%04x, data 0x%02x\n",
@@ -737,8 +983,11 @@ static int tegra_i2c_xfer_msg(struct tegra_i2c_bus *i2c_bus,
 	dev_dbg(i2c_dev->dev, "transfer complete: %d %d %d\n",
 		ret, completion_done(&i2c_dev->msg_complete), i2c_dev->msg_err);
 
-	if (likely(i2c_dev->msg_err == I2C_ERR_NONE))
+	if (likely(i2c_dev->msg_err == I2C_ERR_NONE)) {
+		if (dma && (msg->flags & I2C_M_RD))
+			memcpy(msg->buf, i2c_dev->dma_buf, msg->len);
 		return 0;
+	}
 
 	/* Arbitration Lost occurs, Start recovery */
 	if (i2c_dev->msg_err == I2C_ERR_ARBITRATION_LOST) {
@@ -777,6 +1026,7 @@ static int tegra_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 	struct tegra_i2c_bus *i2c_bus = i2c_get_adapdata(adap);
 	struct tegra_i2c_dev *i2c_dev = i2c_bus->dev;
 	int i;
+	int count;
 	int ret = 0;
 
 	rt_mutex_lock(&i2c_dev->dev_lock);
@@ -814,24 +1064,22 @@ static int tegra_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 	i2c_dev->msgs = msgs;
 	i2c_dev->msgs_num = num;
 
-	pm_runtime_get_sync(&adap->dev);
-	tegra_i2c_clock_enable(i2c_dev);
+	/*
+	 * Bursts of transfers, e.g. a touch or sensor driver polling its
+	 * device, share one clock-on period through autosuspend.
+	 */
+	pm_runtime_get_sync(i2c_dev->dev);
 
-	for (i = 0; i < num; i++) {
-		enum msg_end_type end_type = MSG_END_STOP;
-		if (i < (num - 1)) {
-			if (msgs[i + 1].flags & I2C_M_NOSTART)
-				end_type = MSG_END_CONTINUE;
-			else
-				end_type = MSG_END_REPEAT_START;
-		}
-		ret = tegra_i2c_xfer_msg(i2c_bus, &msgs[i], end_type);
+	for (i = 0; i < num; i += count) {
+		count = tegra_i2c_chain_len(&msgs[i], num - i) + 1;
+		ret = tegra_i2c_xfer_msg(i2c_bus, &msgs[i], count,
+			tegra_i2c_msg_end(msgs, i + count - 1, num));
 		if (ret)
 			break;
 	}
 
-	tegra_i2c_clock_disable(i2c_dev);
-	pm_runtime_put(&adap->dev);
+	pm_runtime_mark_last_busy(i2c_dev->dev);
+	pm_runtime_put_autosuspend(i2c_dev->dev);
 
 	rt_mutex_unlock(&i2c_dev->dev_lock);
 
@@ -878,6 +1126,7 @@ static int __devinit tegra_i2c_probe(struct platform_device *pdev)
 	struct clk *fast_clk = NULL;
 	const unsigned int *prop;
 	void __iomem *base;
+	unsigned long phys;
 	int irq;
 	int nbus;
 	int i = 0;
@@ -907,6 +1156,7 @@ static int __devinit tegra_i2c_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "Cannot request/ioremap I2C registers\n");
 		return -EADDRNOTAVAIL;
 	}
+	phys = res->start;
 
 	res = platform_get_resource(pdev, IORESOURCE_IRQ, 0);
 	if (!res) {
@@ -935,6 +1185,7 @@ static int __devinit tegra_i2c_probe(struct platform_device *pdev)
 	}
 
 	i2c_dev->base = base;
+	i2c_dev->phys = phys;
 	i2c_dev->div_clk = div_clk;
 	i2c_dev->fast_clk = fast_clk;
 	i2c_dev->irq = irq;
@@ -995,7 +1246,13 @@ static int __devinit tegra_i2c_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	tegra_i2c_init_dma(i2c_dev);
+
+	pm_runtime_set_autosuspend_delay(&pdev->dev, clk_idle_ms);
+	pm_runtime_use_autosuspend(&pdev->dev);
 	pm_runtime_enable(&pdev->dev);
+	if (!pm_runtime_enabled(&pdev->dev))
+		tegra_i2c_clock_enable(i2c_dev);
 
 	for (i = 0; i < nbus; i++) {
 		struct tegra_i2c_bus *i2c_bus = &i2c_dev->busses[i];
@@ -1032,17 +1289,23 @@ static int __devinit tegra_i2c_probe(struct platform_device *pdev)
 			goto err_del_bus;
 		}
 		of_i2c_register_devices(&i2c_bus->adapter);
-		pm_runtime_enable(&i2c_bus->adapter.dev);
 
 		i2c_dev->bus_count++;
 	}
 
+	/* clients are children of the adapters and wait for them */
+	device_enable_async_suspend(&pdev->dev);
 
 	return 0;
 
 err_del_bus:
 	while (i2c_dev->bus_count--)
 		i2c_del_adapter(&i2c_dev->busses[i2c_dev->bus_count].adapter);
+	pm_runtime_disable(&pdev->dev);
+	if (!pm_runtime_status_suspended(&pdev->dev))
+		tegra_i2c_clock_disable(i2c_dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+	tegra_i2c_deinit_dma(i2c_dev);
 	return ret;
 }
 
@@ -1050,14 +1313,17 @@ static int __devexit tegra_i2c_remove(struct platform_device *pdev)
 {
 	struct tegra_i2c_dev *i2c_dev = platform_get_drvdata(pdev);
 
-	while (i2c_dev->bus_count--) {
+	while (i2c_dev->bus_count--)
 		i2c_del_adapter(&i2c_dev->busses[i2c_dev->bus_count].adapter);
-		pm_runtime_disable(&i2c_dev->busses[i2c_dev->bus_count].adapter.dev);
-	}
+
+	pm_runtime_disable(&pdev->dev);
+	if (!pm_runtime_status_suspended(&pdev->dev))
+		tegra_i2c_clock_disable(i2c_dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+	tegra_i2c_deinit_dma(i2c_dev);
 
 	if (i2c_dev->is_clkon_always)
 		tegra_i2c_clock_disable(i2c_dev);
-	pm_runtime_disable(&pdev->dev);
 	return 0;
 }
 
@@ -1070,6 +1336,9 @@ static int tegra_i2c_suspend_noirq(struct device *dev)
 	rt_mutex_lock(&i2c_dev->dev_lock);
 
 	i2c_dev->is_suspended = true;
+	/* the PM core holds off runtime PM, drop an autosuspend pending */
+	if (!pm_runtime_status_suspended(dev))
+		tegra_i2c_clock_disable(i2c_dev);
 	if (i2c_dev->is_clkon_always)
 		tegra_i2c_clock_disable(i2c_dev);
 
@@ -1088,6 +1357,8 @@ static int tegra_i2c_resume_noirq(struct device *dev)
 
 	if (i2c_dev->is_clkon_always)
 		tegra_i2c_clock_enable(i2c_dev);
+	if (!pm_runtime_status_suspended(dev))
+		tegra_i2c_clock_enable(i2c_dev);
 
 	ret = tegra_i2c_init(i2c_dev);
 
@@ -1103,14 +1374,34 @@ static int tegra_i2c_resume_noirq(struct device *dev)
 	return 0;
 }
 
+#endif
+
+#ifdef CONFIG_PM_RUNTIME
+static int tegra_i2c_runtime_suspend(struct device *dev)
+{
+	struct tegra_i2c_dev *i2c_dev = dev_get_drvdata(dev);
+
+	tegra_i2c_clock_disable(i2c_dev);
+	return 0;
+}
+
+static int tegra_i2c_runtime_resume(struct device *dev)
+{
+	struct tegra_i2c_dev *i2c_dev = dev_get_drvdata(dev);
+
+	return tegra_i2c_clock_enable(i2c_dev);
+}
+#endif
+
 static const struct dev_pm_ops tegra_i2c_pm = {
+#ifdef CONFIG_PM_SLEEP
 	.suspend_noirq = tegra_i2c_suspend_noirq,
 	.resume_noirq = tegra_i2c_resume_noirq,
+#endif
+	SET_RUNTIME_PM_OPS(tegra_i2c_runtime_suspend,
+			   tegra_i2c_runtime_resume, NULL)
 };
 #define TEGRA_I2C_PM	(&tegra_i2c_pm)
-#else
-#define TEGRA_I2C_PM	NULL
-#endif
 
 static struct platform_driver tegra_i2c_driver = {
 	.probe   = tegra_i2c_probe,
@@ -104,7 +104,8 @@ static void evdev_event(struct input_handle *handle,
 	struct input_event event;
 	struct timespec ts;
 
-	ktime_get_ts(&ts);
+	/* one time for the whole packet, the driver's if it gave one */
+	ts = ktime_to_timespec(input_get_timestamp(handle->dev));
 	event.time.tv_sec = ts.tv_sec;
 	event.time.tv_usec = ts.tv_nsec / NSEC_PER_USEC;
 	event.type = type;
@@ -428,6 +429,10 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 		retval += input_event_size();
 	}
 
+	/* the reader is about to act on user input, let it run fast */
+	if (retval > 0)
+		sched_freq_boost_task(current);
+
 	if (retval == 0 && file->f_flags & O_NONBLOCK)
 		retval = -EAGAIN;
 	return retval;
@@ -105,6 +105,10 @@ static void input_pass_event(struct input_dev *dev,
 	}
 
 	rcu_read_unlock();
+
+	/* the next packet gets its own time */
+	if (type == EV_SYN && code == SYN_REPORT)
+		dev->timestamp = ktime_set(0, 0);
 }
 
 /*
@@ -325,6 +329,10 @@ static void input_handle_event(struct input_dev *dev,
 
 	if (disposition & INPUT_PASS_TO_HANDLERS)
 		input_pass_event(dev, type, code, value);
+
+	/* a packet that was all filtered out does not leave its time behind */
+	if (type == EV_SYN && code == SYN_REPORT)
+		dev->timestamp = ktime_set(0, 0);
 }
 
 /**
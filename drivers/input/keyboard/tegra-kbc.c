@@ -67,6 +67,15 @@
 #define DEFAULT_SCAN_COUNT 2
 #define DEFAULT_INIT_DLY   5
 
+/*
+ * While the held keys stay the same the FIFO repoll interval doubles up
+ * to this many milliseconds, so a long press does not keep a periodic
+ * timer running at the hardware scan rate. Zero keeps the fixed rate.
+ */
+static unsigned int max_repoll_ms = 64;
+module_param(max_repoll_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(max_repoll_ms, "Upper bound on the repoll interval while keys are held steady (ms)");
+
 struct tegra_kbc {
 	void __iomem *mmio;
 	struct input_dev *idev;
@@ -75,6 +84,7 @@ struct tegra_kbc {
 	unsigned int wake_enable_cols;
 	spinlock_t lock;
 	unsigned int repoll_dly;
+	unsigned int cur_repoll_dly;
 	unsigned long cp_dly_jiffies;
 	bool use_fn_map;
 	bool use_ghost_filter;
@@ -260,7 +270,8 @@ static void tegra_kbc_report_pressed_keys(struct input_dev *input,
 	}
 }
 
-static void tegra_kbc_report_keys(struct tegra_kbc *kbc)
+/* Returns true if the set of held keys differs from the previous scan. */
+static bool tegra_kbc_report_keys(struct tegra_kbc *kbc)
 {
 	unsigned char scancodes[KBC_MAX_KPENT];
 	unsigned short keycodes[KBC_MAX_KPENT];
@@ -271,6 +282,7 @@ static void tegra_kbc_report_keys(struct tegra_kbc *kbc)
 	bool fn_keypress = false;
 	bool key_in_same_row = false;
 	bool key_in_same_col = false;
+	bool changed;
 
 	spin_lock_irqsave(&kbc->lock, flags);
 	for (i = 0; i < KBC_MAX_KPENT; i++) {
@@ -338,7 +350,13 @@ static void tegra_kbc_report_keys(struct tegra_kbc *kbc)
 
 	/* Ignore the key presses for this iteration? */
 	if (key_in_same_col && key_in_same_row)
-		return;
+		return true;
+
+	changed = num_down != kbc->num_pressed_keys ||
+		  memcmp(keycodes, kbc->current_keys,
+			 num_down * sizeof(keycodes[0]));
+	if (!changed)
+		return false;
 
 	tegra_kbc_report_released_keys(kbc->idev,
 				       kbc->current_keys, kbc->num_pressed_keys,
@@ -348,6 +366,8 @@ static void tegra_kbc_report_keys(struct tegra_kbc *kbc)
 
 	memcpy(kbc->current_keys, keycodes, sizeof(kbc->current_keys));
 	kbc->num_pressed_keys = num_down;
+
+	return true;
 }
 
 static void tegra_kbc_keypress_timer(unsigned long data)
@@ -360,14 +380,26 @@ static void tegra_kbc_keypress_timer(unsigned long data)
 	val = (readl(kbc->mmio + KBC_INT_0) >> 4) & 0xf;
 	if (val) {
 		unsigned long dly;
+		bool changed;
+
+		changed = tegra_kbc_report_keys(kbc);
 
-		tegra_kbc_report_keys(kbc);
+		/*
+		 * Back off while the same keys stay held; any change drops
+		 * straight back to the hardware repoll rate.
+		 */
+		if (changed || !max_repoll_ms)
+			kbc->cur_repoll_dly = kbc->repoll_dly;
+		else if (kbc->cur_repoll_dly < max_repoll_ms)
+			kbc->cur_repoll_dly = min(kbc->cur_repoll_dly * 2,
+						  max(max_repoll_ms,
+						      kbc->repoll_dly));
 
 		/*
 		 * If more than one keys are pressed we need not wait
 		 * for the repoll delay.
 		 */
-		dly = (val == 1) ? kbc->repoll_dly : 1;
+		dly = (val == 1) ? kbc->cur_repoll_dly : 1;
 		mod_timer(&kbc->timer, jiffies + msecs_to_jiffies(dly));
 	} else {
 		/* Release any pressed keys and exit the polling loop */
@@ -376,6 +408,7 @@ static void tegra_kbc_keypress_timer(unsigned long data)
 		input_sync(kbc->idev);
 
 		kbc->num_pressed_keys = 0;
+		kbc->cur_repoll_dly = kbc->repoll_dly;
 
 		/* All keys are released so enable the keypress interrupt */
 		spin_lock_irqsave(&kbc->lock, flags);
@@ -515,6 +548,7 @@ static int tegra_kbc_start(struct tegra_kbc *kbc)
 	kbc->cp_dly_jiffies = usecs_to_jiffies((val & 0xfffff) * 32);
 
 	kbc->num_pressed_keys = 0;
+	kbc->cur_repoll_dly = kbc->repoll_dly;
 
 	/*
 	 * Atomically clear out any remaining entries in the key FIFO
@@ -744,6 +778,7 @@ static int __devinit tegra_kbc_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, kbc);
 	device_init_wakeup(&pdev->dev, pdata->wakeup);
+	device_enable_async_suspend(&pdev->dev);
 
 	return 0;
 
@@ -22,6 +22,7 @@
 #include <linux/input.h>
 #include <linux/interrupt.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
 #if defined(CONFIG_HAS_EARLYSUSPEND)
 #include <linux/earlysuspend.h>
 #endif
@@ -250,6 +251,10 @@
 
 #define MXT_MAX_FINGER		10
 
+/* Messages read in one I2C transfer, along with the T44 count */
+#define MXT_MAX_BURST_MSGS	16
+#define MXT_MAX_BURSTS		8
+
 #define RESUME_READS		100
 
 #define MXT_DEFAULT_PRESSURE	100
@@ -331,6 +336,25 @@ struct mxt_data {
 	u8 slowscan_shad_actv_cycle_time;
 	u8 slowscan_shad_idle_cycle_time;
 	u8 slowscan_shad_actv2idle_timeout;
+
+	/* T44 message count, 0 unless it sits right in front of T5 */
+	u16 msg_count_address;
+	u8 msg_size;
+	u8 last_msg_count;
+	u8 msg_buf[1 + MXT_MAX_BURST_MSGS * sizeof(struct mxt_message)];
+	bool update_input;
+	int last_touchid;
+
+	/* interrupt to input_sync, and time spent on the bus, per frame */
+	ktime_t irq_time;
+	u32 frames;
+	u32 frame_msgs;
+	u32 frame_reads;
+	u64 latency_total_us;
+	u32 latency_max_us;
+	u32 latency_last_us;
+	u64 read_total_us;
+	u32 read_max_us;
 };
 
 static struct mxt_suspend mxt_save[] = {
@@ -685,7 +709,8 @@ static void mxt_input_touchevent(struct mxt_data *data,
 
 			finger[id].status = MXT_RELEASE;
 			finger[id].pressure = 0;
-			mxt_input_report(data, id);
+			data->last_touchid = id;
+			data->update_input = true;
 		}
 		return;
 	}
@@ -718,49 +743,211 @@ static void mxt_input_touchevent(struct mxt_data *data,
 	finger[id].area = area;
 	finger[id].pressure = pressure;
 
-	trace_nvevent_irq_data_submit("mxt_input_touchevent");
-	mxt_input_report(data, id);
+	data->last_touchid = id;
+	data->update_input = true;
 }
 
-static irqreturn_t mxt_interrupt(int irq, void *dev_id)
+/* Register address write and data read as one combined transfer */
+static int mxt_read_burst(struct mxt_data *data, u16 reg, u16 len, void *val)
+{
+	struct i2c_client *client = data->client;
+	u8 buf[2];
+	struct i2c_msg xfer[2] = {
+		{
+			.addr = client->addr,
+			.len = 2,
+			.buf = buf,
+		}, {
+			.addr = client->addr,
+			.flags = I2C_M_RD,
+			.len = len,
+			.buf = val,
+		},
+	};
+	int retval = 0;
+
+	buf[0] = reg & 0xff;
+	buf[1] = (reg >> 8) & 0xff;
+
+	mutex_lock(&data->access_mutex);
+	if (i2c_transfer(client->adapter, xfer, 2) != 2) {
+		dev_dbg(&client->dev, "i2c retry\n");
+		msleep(MXT_WAKEUP_TIME);
+
+		if (i2c_transfer(client->adapter, xfer, 2) != 2) {
+			dev_err(&client->dev, "%s: i2c transfer failed\n",
+				__func__);
+			retval = -EIO;
+			goto mxt_read_exit;
+		}
+	}
+	data->last_address = reg;
+
+mxt_read_exit:
+	mutex_unlock(&data->access_mutex);
+	return retval;
+}
+
+static u8 mxt_handle_message(struct mxt_data *data,
+		struct mxt_message *message, struct mxt_object *touch_object)
 {
-	struct mxt_data *data = dev_id;
-	struct mxt_message message;
-	struct mxt_object *touch_object;
 	struct device *dev = &data->client->dev;
-	int touchid;
+	u8 reportid = message->reportid;
+
+	if (reportid == MXT_RPTID_NOMSG)
+		return reportid;
+
+	if (data->debug_enabled)
+		print_hex_dump(KERN_DEBUG, "MXT MSG:", DUMP_PREFIX_NONE,
+			16, 1, message, sizeof(struct mxt_message), false);
+
+	if (reportid >= touch_object->min_reportid
+		&& reportid <= touch_object->max_reportid)
+		mxt_input_touchevent(data, message,
+				reportid - touch_object->min_reportid);
+	else
+		mxt_dump_message(dev, message);
+	return reportid;
+}
+
+/* Handle n messages of msg_size bytes, true once the queue was seen empty */
+static bool mxt_handle_messages(struct mxt_data *data, u8 *buf, int n,
+		struct mxt_object *touch_object)
+{
+	struct mxt_message message;
+	bool empty = false;
+	int i;
+
+	for (i = 0; i < n; i++, buf += data->msg_size) {
+		memset(&message, 0, sizeof(message));
+		memcpy(&message, buf, data->msg_size);
+		if (mxt_handle_message(data, &message, touch_object) ==
+				MXT_RPTID_NOMSG)
+			empty = true;
+		else
+			data->frame_msgs++;
+	}
+	return empty;
+}
+
+/*
+ * The T44 count and, going by the previous frame, every pending message
+ * in one transfer. The read runs one message past the expected count so
+ * that the queue is seen empty, and CHG released, without another one;
+ * if it is not, the rest are fetched from T5 in bursts as well.
+ */
+static int mxt_read_messages_burst(struct mxt_data *data,
+		struct mxt_object *touch_object)
+{
+	u8 *buf = data->msg_buf;
+	int want, pending, bursts = 0;
+	bool empty;
+	ktime_t start = ktime_get();
+	int error;
+
+	want = min(data->last_msg_count + 1, MXT_MAX_BURST_MSGS);
+	error = mxt_read_burst(data, data->msg_count_address,
+			1 + want * data->msg_size, buf);
+	if (error)
+		return error;
+	data->frame_reads++;
+
+	pending = buf[0];
+	empty = mxt_handle_messages(data, buf + 1, want, touch_object);
+	pending -= want;
+
+	while (!empty && ++bursts < MXT_MAX_BURSTS) {
+		want = clamp(pending + 1, 1, MXT_MAX_BURST_MSGS);
+		error = mxt_read_burst(data, data->msg_address,
+				want * data->msg_size, buf);
+		if (error)
+			return error;
+		data->frame_reads++;
+		empty = mxt_handle_messages(data, buf, want, touch_object);
+		pending -= want;
+	}
+
+	data->read_total_us += ktime_us_delta(ktime_get(), start);
+	data->read_max_us = max_t(u32, data->read_max_us,
+				  ktime_us_delta(ktime_get(), start));
+	return 0;
+}
+
+static int mxt_read_messages_single(struct mxt_data *data,
+		struct mxt_object *touch_object)
+{
+	struct mxt_message message;
+	ktime_t start = ktime_get();
 	u8 reportid;
 
-	trace_nvevent_irq_data_read_start_series("mxt_input_interrupt");
 	do {
 		trace_nvevent_irq_data_read_start_single("mxt_input_interrupt");
-		if (mxt_read_message(data, &message)) {
-			dev_err(dev, "Failed to read message\n");
-			goto end;
-		}
+		if (mxt_read_message(data, &message))
+			return -EIO;
 		trace_nvevent_irq_data_read_finish_single(
 					"mxt_input_interrupt");
+		data->frame_reads++;
+
+		reportid = mxt_handle_message(data, &message, touch_object);
+		if (reportid != MXT_RPTID_NOMSG)
+			data->frame_msgs++;
+	} while (reportid != MXT_RPTID_NOMSG);
+
+	data->read_total_us += ktime_us_delta(ktime_get(), start);
+	data->read_max_us = max_t(u32, data->read_max_us,
+				  ktime_us_delta(ktime_get(), start));
+	return 0;
+}
 
-		reportid = message.reportid;
+static irqreturn_t mxt_hardirq(int irq, void *dev_id)
+{
+	struct mxt_data *data = dev_id;
 
-		touch_object = mxt_get_object(data, MXT_TOUCH_MULTI_T9);
-		if (!touch_object)
-			goto end;
+	data->irq_time = ktime_get();
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * Runs in the SCHED_FIFO irq thread. Every message pending at the
+ * interrupt is applied to the finger state first, then the whole frame
+ * goes out behind a single input_sync.
+ */
+static irqreturn_t mxt_interrupt(int irq, void *dev_id)
+{
+	struct mxt_data *data = dev_id;
+	struct mxt_object *touch_object;
+	struct device *dev = &data->client->dev;
+	u32 latency;
+	int error;
 
-		if (data->debug_enabled)
-			print_hex_dump(KERN_DEBUG, "MXT MSG:", DUMP_PREFIX_NONE,
-				16, 1, &message, sizeof(struct mxt_message), false);
+	touch_object = mxt_get_object(data, MXT_TOUCH_MULTI_T9);
+	if (!touch_object)
+		return IRQ_HANDLED;
 
-		if (reportid >= touch_object->min_reportid
-			&& reportid <= touch_object->max_reportid) {
-			touchid = reportid - touch_object->min_reportid;
-			mxt_input_touchevent(data, &message, touchid);
-		} else if (reportid != MXT_RPTID_NOMSG)
-			mxt_dump_message(dev, &message);
-	} while (reportid != MXT_RPTID_NOMSG);
+	trace_nvevent_irq_data_read_start_series("mxt_input_interrupt");
+	if (data->msg_count_address)
+		error = mxt_read_messages_burst(data, touch_object);
+	else
+		error = mxt_read_messages_single(data, touch_object);
+	if (error)
+		dev_err(dev, "Failed to read message\n");
 	trace_nvevent_irq_data_read_finish_series("mxt_input_interrupt");
 
-end:
+	if (data->update_input) {
+		trace_nvevent_irq_data_submit("mxt_input_touchevent");
+		mxt_input_report(data, data->last_touchid);
+		data->update_input = false;
+
+		latency = ktime_us_delta(ktime_get(), data->irq_time);
+		data->frames++;
+		data->latency_last_us = latency;
+		data->latency_total_us += latency;
+		data->latency_max_us = max(data->latency_max_us, latency);
+	}
+	data->last_msg_count = min_t(u32, data->frame_msgs,
+				     MXT_MAX_BURST_MSGS);
+	data->frame_msgs = 0;
+
 	return IRQ_HANDLED;
 }
 
@@ -1062,6 +1249,7 @@ static int mxt_get_object_table(struct mxt_data *data)
 	u8 reportid = 0;
 	u8 buf[MXT_OBJECT_SIZE];
 
+	data->msg_count_address = 0;
 	for (i = 0; i < data->info.object_num; i++) {
 		struct mxt_object *object = data->object_table + i;
 
@@ -1085,8 +1273,14 @@ static int mxt_get_object_table(struct mxt_data *data)
 
 		/* Store message window address so we don't have to
 		   search the object table every time we read message */
-		if (object->type == MXT_GEN_MESSAGE_T5)
+		if (object->type == MXT_GEN_MESSAGE_T5) {
 			data->msg_address = object->start_address;
+			/* no checksum byte, it is only sent when asked for */
+			data->msg_size = min_t(u16, object->size - 1,
+					       sizeof(struct mxt_message));
+		}
+		if (object->type == MXT_SPT_MESSAGECOUNT_T44)
+			data->msg_count_address = object->start_address;
 
 		dev_dbg(dev, "T%d, start:%d size:%d instances:%d "
 			"min_reportid:%d max_reportid:%d\n",
@@ -1095,6 +1289,11 @@ static int mxt_get_object_table(struct mxt_data *data)
 			object->min_reportid, object->max_reportid);
 	}
 
+	/* Burst reads run from the T44 count straight into T5 */
+	if (data->msg_count_address + 1 != data->msg_address ||
+	    !data->msg_size)
+		data->msg_count_address = 0;
+
 	return 0;
 }
 
@@ -1373,6 +1572,47 @@ static ssize_t mxt_debug_enable_store(struct device *dev,
 	return count;
 }
 
+static ssize_t mxt_latency_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct mxt_data *data = dev_get_drvdata(dev);
+	u32 frames = data->frames;
+	int count = 0;
+
+	count += sprintf(buf + count, "mode: %s\n",
+			 data->msg_count_address ? "burst" : "single");
+	count += sprintf(buf + count, "frames: %u reads: %u\n",
+			 frames, data->frame_reads);
+	count += sprintf(buf + count, "latency_us: last %u avg %llu max %u\n",
+			 data->latency_last_us,
+			 frames ? div_u64(data->latency_total_us, frames) : 0,
+			 data->latency_max_us);
+	count += sprintf(buf + count, "read_us: avg %llu max %u\n",
+			 frames ? div_u64(data->read_total_us, frames) : 0,
+			 data->read_max_us);
+
+	return count;
+}
+
+static ssize_t mxt_latency_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct mxt_data *data = dev_get_drvdata(dev);
+
+	/* any write clears the counters */
+	disable_irq(data->irq);
+	data->frames = 0;
+	data->frame_reads = 0;
+	data->latency_total_us = 0;
+	data->latency_max_us = 0;
+	data->latency_last_us = 0;
+	data->read_total_us = 0;
+	data->read_max_us = 0;
+	enable_irq(data->irq);
+
+	return count;
+}
+
 static ssize_t mxt_slowscan_show(struct device *dev,
 	struct device_attribute *attr, char *buf)
 {
@@ -1543,6 +1783,7 @@ static DEVICE_ATTR(object, 0444, mxt_object_show, NULL);
 static DEVICE_ATTR(update_fw, 0664, NULL, mxt_update_fw_store);
 static DEVICE_ATTR(pause_driver, 0664, mxt_pause_show, mxt_pause_store);
 static DEVICE_ATTR(debug_enable, 0664, mxt_debug_enable_show, mxt_debug_enable_store);
+static DEVICE_ATTR(latency, 0664, mxt_latency_show, mxt_latency_store);
 static DEVICE_ATTR(slowscan_enable, 0664, mxt_slowscan_show, mxt_slowscan_store);
 
 static struct attribute *mxt_attrs[] = {
@@ -1550,6 +1791,7 @@ static struct attribute *mxt_attrs[] = {
 	&dev_attr_update_fw.attr,
 	&dev_attr_pause_driver.attr,
 	&dev_attr_debug_enable.attr,
+	&dev_attr_latency.attr,
 	&dev_attr_slowscan_enable.attr,
 	NULL
 };
@@ -1690,8 +1932,9 @@ static int __devinit mxt_probe(struct i2c_client *client,
 	if (error)
 		goto err_free_object;
 
-	error = request_threaded_irq(client->irq, NULL, mxt_interrupt,
-			pdata->irqflags, client->dev.driver->name, data);
+	error = request_threaded_irq(client->irq, mxt_hardirq, mxt_interrupt,
+			pdata->irqflags | IRQF_ONESHOT,
+			client->dev.driver->name, data);
 	if (error) {
 		dev_err(&client->dev, "Failed to register interrupt\n");
 		goto err_free_object;
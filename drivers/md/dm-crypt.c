@@ -18,6 +18,8 @@
 #include <linux/crypto.h>
 #include <linux/workqueue.h>
 #include <linux/backing-dev.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
 #include <asm/atomic.h>
 #include <linux/scatterlist.h>
 #include <asm/page.h>
@@ -85,11 +87,23 @@ struct iv_benbi_private {
 	int shift;
 };
 
+/*
+ * per cpu state of the parallel mode: a worker converting one share of
+ * the sectors kcryptd is working on, with its own crypto request
+ */
+struct crypt_cpu {
+	struct work_struct work;
+	struct crypt_config *cc;
+	struct convert_context ctx;
+	unsigned int nr_sectors;
+	struct ablkcipher_request *req;
+};
+
 /*
  * Crypt: maps a linear range of a block device
  * and encrypts / decrypts at the same time.
  */
-enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID };
+enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID, DM_CRYPT_PARALLEL };
 struct crypt_config {
 	struct dm_dev *dev;
 	sector_t start;
@@ -106,6 +120,17 @@ struct crypt_config {
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
 
+	/*
+	 * parallel mode, only set up for synchronous ciphers: kcryptd
+	 * splits each conversion across the online cpus and waits for the
+	 * shares it handed out, so bios still complete in order
+	 */
+	struct workqueue_struct *cpu_queue;
+	struct crypt_cpu __percpu *cpu;
+	atomic_t cpu_pending;
+	struct completion cpu_done;
+	int cpu_error;
+
 	char *cipher;
 	char *cipher_string;
 
@@ -142,6 +167,7 @@ struct crypt_config {
 #define MIN_IOS        16
 #define MIN_POOL_PAGES 32
 #define MIN_BIO_PAGES  8
+#define MIN_CPU_SECTORS 8	/* smallest share handed to another cpu */
 
 static struct kmem_cache *_crypt_io_pool;
 
@@ -465,16 +491,165 @@ static void crypt_alloc_req(struct crypt_config *cc,
 					dmreq_of_req(cc, cc->req));
 }
 
+static unsigned int crypt_sectors_left(struct bio *bio, unsigned int idx,
+				       unsigned int offset)
+{
+	unsigned int bytes = 0;
+
+	for (; idx < bio->bi_vcnt; idx++) {
+		bytes += bio_iovec_idx(bio, idx)->bv_len - offset;
+		offset = 0;
+	}
+
+	return bytes >> SECTOR_SHIFT;
+}
+
+/* move ctx on by sectors without converting them */
+static void crypt_convert_advance(struct convert_context *ctx,
+				  unsigned int sectors)
+{
+	ctx->sector += sectors;
+
+	while (sectors--) {
+		ctx->offset_in += 1 << SECTOR_SHIFT;
+		if (ctx->offset_in >= bio_iovec_idx(ctx->bio_in,
+						    ctx->idx_in)->bv_len) {
+			ctx->offset_in = 0;
+			ctx->idx_in++;
+		}
+
+		ctx->offset_out += 1 << SECTOR_SHIFT;
+		if (ctx->offset_out >= bio_iovec_idx(ctx->bio_out,
+						     ctx->idx_out)->bv_len) {
+			ctx->offset_out = 0;
+			ctx->idx_out++;
+		}
+	}
+}
+
+static void crypt_convert_copy_pos(struct convert_context *dst,
+				   struct convert_context *src)
+{
+	dst->bio_in = src->bio_in;
+	dst->bio_out = src->bio_out;
+	dst->offset_in = src->offset_in;
+	dst->offset_out = src->offset_out;
+	dst->idx_in = src->idx_in;
+	dst->idx_out = src->idx_out;
+	dst->sector = src->sector;
+}
+
+/* synchronously convert nr_sectors from ctx on, with req */
+static int crypt_convert_run(struct crypt_config *cc,
+			     struct convert_context *ctx,
+			     unsigned int nr_sectors,
+			     struct ablkcipher_request *req)
+{
+	int r;
+
+	while (nr_sectors--) {
+		r = crypt_convert_block(cc, ctx, req);
+		if (unlikely(r))
+			return r;
+		ctx->sector++;
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static void kcryptd_crypt_cpu(struct work_struct *work)
+{
+	struct crypt_cpu *cs = container_of(work, struct crypt_cpu, work);
+	struct crypt_config *cc = cs->cc;
+	int r;
+
+	r = crypt_convert_run(cc, &cs->ctx, cs->nr_sectors, cs->req);
+	if (unlikely(r))
+		cc->cpu_error = r;
+
+	if (atomic_dec_and_test(&cc->cpu_pending))
+		complete(&cc->cpu_done);
+}
+
+/*
+ * Hand a share of the nr_sectors from ctx on to each other online cpu,
+ * convert the first share here and wait for the rest.  ctx is left past
+ * the last sector, as crypt_convert() leaves it.
+ */
+static int crypt_convert_parallel(struct crypt_config *cc,
+				  struct convert_context *ctx,
+				  unsigned int nr_sectors)
+{
+	int this_cpu = raw_smp_processor_id();
+	struct crypt_cpu *self = per_cpu_ptr(cc->cpu, this_cpu);
+	struct crypt_cpu *cs;
+	unsigned int share, first, n;
+	int cpu, r;
+
+	share = max_t(unsigned int, MIN_CPU_SECTORS,
+		      DIV_ROUND_UP(nr_sectors, num_online_cpus()));
+	first = min(share, nr_sectors);
+
+	atomic_set(&cc->cpu_pending, 1);
+	INIT_COMPLETION(cc->cpu_done);
+	cc->cpu_error = 0;
+
+	/* self->ctx walks ahead, to where each share starts */
+	crypt_convert_copy_pos(&self->ctx, ctx);
+	crypt_convert_advance(&self->ctx, first);
+	nr_sectors -= first;
+
+	for_each_online_cpu(cpu) {
+		if (!nr_sectors)
+			break;
+		if (cpu == this_cpu)
+			continue;
+
+		cs = per_cpu_ptr(cc->cpu, cpu);
+		n = min(share, nr_sectors);
+		crypt_convert_copy_pos(&cs->ctx, &self->ctx);
+		cs->nr_sectors = n;
+		crypt_convert_advance(&self->ctx, n);
+		nr_sectors -= n;
+
+		atomic_inc(&cc->cpu_pending);
+		queue_work_on(cpu, cc->cpu_queue, &cs->work);
+	}
+
+	/* our share, then whatever is left if cpus went offline */
+	r = crypt_convert_run(cc, ctx, first, self->req);
+	if (!r)
+		r = crypt_convert_run(cc, &self->ctx, nr_sectors, self->req);
+
+	if (!atomic_dec_and_test(&cc->cpu_pending))
+		wait_for_completion(&cc->cpu_done);
+
+	crypt_convert_copy_pos(ctx, &self->ctx);
+
+	return r ? r : cc->cpu_error;
+}
+
 /*
  * Encrypt / decrypt data from one bio to another one (can be the same one)
  */
 static int crypt_convert(struct crypt_config *cc,
 			 struct convert_context *ctx)
 {
+	unsigned int nr_sectors;
 	int r;
 
 	atomic_set(&ctx->pending, 1);
 
+	if (cc->cpu_queue) {
+		nr_sectors = min(crypt_sectors_left(ctx->bio_in, ctx->idx_in,
+						    ctx->offset_in),
+				 crypt_sectors_left(ctx->bio_out, ctx->idx_out,
+						    ctx->offset_out));
+		if (nr_sectors >= 2 * MIN_CPU_SECTORS)
+			return crypt_convert_parallel(cc, ctx, nr_sectors);
+	}
+
 	while(ctx->idx_in < ctx->bio_in->bi_vcnt &&
 	      ctx->idx_out < ctx->bio_out->bi_vcnt) {
 
@@ -995,6 +1170,74 @@ static int crypt_wipe_key(struct crypt_config *cc)
 	return crypto_ablkcipher_setkey(cc->tfm, cc->key, cc->key_size);
 }
 
+static void crypt_free_cpus(struct crypt_config *cc)
+{
+	int cpu;
+
+	if (cc->cpu_queue)
+		destroy_workqueue(cc->cpu_queue);
+	cc->cpu_queue = NULL;
+
+	if (!cc->cpu)
+		return;
+
+	for_each_possible_cpu(cpu)
+		kzfree(per_cpu_ptr(cc->cpu, cpu)->req);
+	free_percpu(cc->cpu);
+	cc->cpu = NULL;
+}
+
+/*
+ * Set up the parallel mode.  Asynchronous ciphers, hardware engines
+ * among them, already get every sector of a bio queued without kcryptd
+ * waiting, so they are left to do that.
+ */
+static int crypt_alloc_cpus(struct crypt_config *cc)
+{
+	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(cc->tfm);
+	struct crypt_cpu *cs;
+	int cpu;
+
+	if (tfm->__crt_alg->cra_flags & CRYPTO_ALG_ASYNC) {
+		DMINFO("%s is asynchronous, not splitting it across cpus",
+		       crypto_tfm_alg_driver_name(tfm));
+		return 0;
+	}
+
+	cc->cpu = alloc_percpu(struct crypt_cpu);
+	if (!cc->cpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		cs = per_cpu_ptr(cc->cpu, cpu);
+		INIT_WORK(&cs->work, kcryptd_crypt_cpu);
+		cs->cc = cc;
+		cs->req = kmalloc(cc->dmreq_start +
+				  sizeof(struct dm_crypt_request) +
+				  cc->iv_size, GFP_KERNEL);
+		if (!cs->req)
+			goto bad;
+		ablkcipher_request_set_tfm(cs->req, cc->tfm);
+		ablkcipher_request_set_callback(cs->req,
+						CRYPTO_TFM_REQ_MAY_SLEEP,
+						NULL, NULL);
+	}
+
+	atomic_set(&cc->cpu_pending, 0);
+	init_completion(&cc->cpu_done);
+
+	cc->cpu_queue = alloc_workqueue("kcryptd_cpu", WQ_CPU_INTENSIVE |
+					WQ_MEM_RECLAIM, 1);
+	if (!cc->cpu_queue)
+		goto bad;
+
+	return 0;
+
+bad:
+	crypt_free_cpus(cc);
+	return -ENOMEM;
+}
+
 static void crypt_dtr(struct dm_target *ti)
 {
 	struct crypt_config *cc = ti->private;
@@ -1008,6 +1251,7 @@ static void crypt_dtr(struct dm_target *ti)
 		destroy_workqueue(cc->io_queue);
 	if (cc->crypt_queue)
 		destroy_workqueue(cc->crypt_queue);
+	crypt_free_cpus(cc);
 
 	if (cc->bs)
 		bioset_free(cc->bs);
@@ -1171,7 +1415,7 @@ bad_mem:
 
 /*
  * Construct an encryption mapping:
- * <cipher> <key> <iv_offset> <dev_path> <start>
+ * <cipher> <key> <iv_offset> <dev_path> <start> [<#opt_params> <opt_params>]
  */
 static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 {
@@ -1183,7 +1427,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	const char *opt_string;
 
 	static struct dm_arg _args[] = {
-		{0, 1, "Invalid number of feature args"},
+		{0, 2, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1268,15 +1512,23 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		if (ret)
 			goto bad;
 
-		opt_string = dm_shift_arg(&as);
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (!opt_string) {
+				ret = -EINVAL;
+				ti->error = "Not enough feature arguments";
+				goto bad;
+			}
 
-		if (opt_params == 1 && opt_string &&
-		    !strcasecmp(opt_string, "allow_discards"))
-			ti->num_discard_requests = 1;
-		else if (opt_params) {
-			ret = -EINVAL;
-			ti->error = "Invalid feature arguments";
-			goto bad;
+			if (!strcasecmp(opt_string, "allow_discards"))
+				ti->num_discard_requests = 1;
+			else if (!strcasecmp(opt_string, "parallel"))
+				set_bit(DM_CRYPT_PARALLEL, &cc->flags);
+			else {
+				ret = -EINVAL;
+				ti->error = "Invalid feature arguments";
+				goto bad;
+			}
 		}
 	}
 
@@ -1293,6 +1545,11 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	if (test_bit(DM_CRYPT_PARALLEL, &cc->flags) && crypt_alloc_cpus(cc)) {
+		ti->error = "Couldn't set up per cpu crypt workers";
+		goto bad;
+	}
+
 	ti->num_flush_requests = 1;
 	ti->discard_zeroes_data_unsupported = 1;
 
@@ -1337,6 +1594,7 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned int sz = 0;
+	unsigned int num_feature_args;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -1361,8 +1619,15 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
 
-		if (ti->num_discard_requests)
-			DMEMIT(" 1 allow_discards");
+		num_feature_args = !!ti->num_discard_requests +
+				   test_bit(DM_CRYPT_PARALLEL, &cc->flags);
+		if (num_feature_args) {
+			DMEMIT(" %u", num_feature_args);
+			if (ti->num_discard_requests)
+				DMEMIT(" allow_discards");
+			if (test_bit(DM_CRYPT_PARALLEL, &cc->flags))
+				DMEMIT(" parallel");
+		}
 
 		break;
 	}
@@ -1460,7 +1725,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 8, 0},
+	.version = {1, 9, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
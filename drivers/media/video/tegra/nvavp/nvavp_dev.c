@@ -11,6 +11,7 @@
 #include <linux/uaccess.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
@@ -21,8 +22,11 @@
 #include <linux/ioctl.h>
 #include <linux/irq.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/miscdevice.h>
+#include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/nvhost.h>
 #include <linux/platform_device.h>
@@ -39,6 +43,7 @@
 #include <mach/hardware.h>
 #include <mach/io.h>
 #include <mach/iomap.h>
+#include <mach/latency_allowance.h>
 #include <mach/legacy_irq.h>
 #include <linux/nvmap.h>
 
@@ -53,6 +58,12 @@
 
 #define NVAVP_PUSHBUFFER_MIN_UPDATE_SPACE	(sizeof(u32) * 3)
 
+/* longest a submission waits for the AVP to free pushbuffer space */
+#define NVAVP_PUSHBUFFER_TIMEOUT_MS		1000
+
+/* longest a busy higher priority channel holds back another's submissions */
+#define NVAVP_PRIORITY_HOLDOFF_MS		20
+
 #define TEGRA_NVAVP_RESET_VECTOR_ADDR	\
 		(IO_ADDRESS(TEGRA_EXCEPTION_VECTORS_BASE) + 0x200)
 
@@ -68,6 +79,42 @@
 /* AVP behavior params */
 #define NVAVP_OS_IDLE_TIMEOUT		100 /* milli-seconds */
 
+/*
+ * When non-zero, the AVP OS and video ucode stay loaded and running for
+ * this long after the last close, so that a player reopening the device
+ * (one per clip, typically) gets a channel reinit instead of a firmware
+ * copy and AVP reboot. VDE and the dvfs votes are idle meanwhile; a
+ * suspend drops the resident state.
+ */
+static unsigned int keep_resident_ms;
+
+module_param_named(keep_resident_ms, keep_resident_ms, uint,
+		S_IRUGO | S_IWUSR);
+
+/*
+ * Rather than run VDE, the AVP and the EMC floor at their maximum for the
+ * whole session, scale them together so that VDE is busy for about
+ * clock_target_pct of the time. Busy time runs from a submission reaching
+ * an idle channel until the sync point catches up with the last one. A
+ * client setting any clock through NVAVP_IOCTL_SET_CLOCK keeps its own
+ * rates for the rest of the session.
+ */
+static bool clock_scaling = true;
+
+module_param_named(clock_scaling, clock_scaling, bool, S_IRUGO | S_IWUSR);
+
+static unsigned int clock_target_pct = 70;
+
+module_param_named(clock_target_pct, clock_target_pct, uint,
+		S_IRUGO | S_IWUSR);
+
+#define NVAVP_SCALE_WINDOW_MS		100
+/* load above which the rate needed can't be told, straight to the max */
+#define NVAVP_SCALE_SATURATED_PCT	95
+/* levels are in permille of the maximum rates */
+#define NVAVP_SCALE_MIN_LEVEL		250
+#define NVAVP_SCALE_MAX_LEVEL		1000
+
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 /* Two control channels: Audio and Video channels */
 #define NVAVP_NUM_CHANNELS		2
@@ -86,6 +133,13 @@
 #define IS_VIDEO_CHANNEL_ID(channel_id)	(channel_id == NVAVP_VIDEO_CHANNEL ? 1: 0)
 
 
+/* a submission whose command buffer the AVP may still be reading */
+struct nvavp_submit {
+	struct list_head		node;
+	struct nvmap_handle_ref		*cmdbuf;
+	u32				syncpt_value;
+};
+
 struct nvavp_channel {
 	struct mutex			pushbuffer_lock;
 	struct nvmap_handle_ref		*pushbuf_handle;
@@ -94,6 +148,34 @@ struct nvavp_channel {
 	u32				pushbuf_index;
 	u32				pushbuf_fence;
 	struct nv_e276_control		*os_control;
+	/* in flight, oldest first, protected by pushbuffer_lock */
+	struct list_head		submits;
+
+	/* see nvavp_pushbuffer_publish(), protected by pushbuffer_lock */
+	u32				priority;
+	bool				put_deferred;
+	unsigned long			deferred_since;
+	u32				unpublished;
+	s64				unpublished_first_us;
+	s64				unpublished_enter_us;
+
+	/* submission to publication, protected by pushbuffer_lock */
+	u64				stat_submits;
+	u64				stat_deferred;
+	u64				stat_delay_us;
+	u32				stat_delay_max_us;
+};
+
+struct nvavp_scale {
+	/* protected by open_lock */
+	bool				fixed;
+	unsigned int			level;
+	/* protected by the video channel's pushbuffer_lock */
+	bool				busy;
+	ktime_t				busy_start;
+	ktime_t				window_start;
+	s64				busy_us;
+	struct work_struct		work;
 };
 
 struct nvavp_info {
@@ -111,6 +193,7 @@ struct nvavp_info {
 	struct clk			*emc_clk;
 	unsigned long			sclk_rate;
 	unsigned long			emc_clk_rate;
+	struct nvavp_scale		scale;
 
 	int				mbox_from_avp_pend_irq;
 
@@ -122,6 +205,10 @@ struct nvavp_info {
 	struct work_struct		app_notify_work;
 #endif
 	struct work_struct		clock_disable_work;
+	/* tears down an AVP left resident by the last close */
+	struct delayed_work		resident_work;
+	/* publishes submissions held back by channel priority */
+	struct delayed_work		priority_work;
 
 	/* os information */
 	struct nvavp_os_info		os_info;
@@ -140,6 +227,9 @@ struct nvavp_info {
 	u32				syncpt_value;
 
 	struct nvhost_device		*nvhost_dev;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry			*debugfs;
+#endif
 	struct miscdevice		video_misc_dev;
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 	struct miscdevice		audio_misc_dev;
@@ -240,6 +330,31 @@ static struct clk *nvavp_clk_get(struct nvavp_info *nvavp, int id)
 	return NULL;
 }
 
+/* Share of the AVP EMC bandwidth taken by each VDE memory client, in
+ * eighths; motion compensation reads dominate during decode. */
+static const struct {
+	enum tegra_la_id id;
+	unsigned int share;
+} nvavp_vde_la[] = {
+	{ TEGRA_LA_VDE_MCER,	4 },
+	{ TEGRA_LA_VDE_MBER,	2 },
+	{ TEGRA_LA_VDE_TPER,	2 },
+	{ TEGRA_LA_VDE_BSEVR,	1 },
+	{ TEGRA_LA_VDE_TPMW,	2 },
+	{ TEGRA_LA_VDE_MBEW,	1 },
+};
+
+static void nvavp_set_vde_la(unsigned long emc_rate)
+{
+	/* EMC rate in Hz to MBps for a 32-bit DDR bus */
+	unsigned long bw = emc_rate / 250000;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(nvavp_vde_la); i++)
+		tegra_set_latency_allowance(nvavp_vde_la[i].id,
+			min(bw * nvavp_vde_la[i].share / 8, 4095UL));
+}
+
 static void nvavp_clks_enable(struct nvavp_info *nvavp)
 {
 	if (nvavp->clk_enabled++ == 0) {
@@ -247,6 +362,8 @@ static void nvavp_clks_enable(struct nvavp_info *nvavp)
 		clk_enable(nvavp->bsev_clk);
 		clk_enable(nvavp->vde_clk);
 		clk_set_rate(nvavp->emc_clk, nvavp->emc_clk_rate);
+		tegra_emc_bw_hint(TEGRA_EMC_BW_AVP, nvavp->emc_clk_rate);
+		nvavp_set_vde_la(nvavp->emc_clk_rate);
 		clk_set_rate(nvavp->sclk, nvavp->sclk_rate);
 		dev_dbg(&nvavp->nvhost_dev->dev, "%s: setting sclk to %lu\n",
 				__func__, nvavp->sclk_rate);
@@ -261,6 +378,8 @@ static void nvavp_clks_disable(struct nvavp_info *nvavp)
 		clk_disable(nvavp->bsev_clk);
 		clk_disable(nvavp->vde_clk);
 		clk_set_rate(nvavp->emc_clk, 0);
+		tegra_emc_bw_hint(TEGRA_EMC_BW_AVP, 0);
+		nvavp_set_vde_la(0);
 		clk_set_rate(nvavp->sclk, 0);
 		nvhost_module_idle_ext(nvhost_get_parent(nvavp->nvhost_dev));
 		dev_dbg(&nvavp->nvhost_dev->dev, "%s: resetting emc_clk "
@@ -268,12 +387,140 @@ static void nvavp_clks_disable(struct nvavp_info *nvavp)
 	}
 }
 
+/* called with open_lock held when a session starts */
+static void nvavp_scale_reset(struct nvavp_info *nvavp)
+{
+	/* If sclk_rate and emc_clk is not set by user space,
+	 * max clock in dvfs table will be used to get best performance.
+	 */
+	nvavp->sclk_rate = ULONG_MAX;
+	nvavp->emc_clk_rate = ULONG_MAX;
+	nvavp->scale.fixed = false;
+	nvavp->scale.level = NVAVP_SCALE_MAX_LEVEL;
+}
+
+static unsigned long nvavp_scale_rate(struct clk *c, unsigned int level)
+{
+	long max = clk_round_rate(c, ULONG_MAX);
+
+	if (max <= 0 || level >= NVAVP_SCALE_MAX_LEVEL)
+		return ULONG_MAX;
+
+	return div_u64((u64)max * level, NVAVP_SCALE_MAX_LEVEL);
+}
+
+/* called with open_lock held */
+static void nvavp_scale_set_level(struct nvavp_info *nvavp,
+				  unsigned int level)
+{
+	if (nvavp->scale.fixed || level == nvavp->scale.level)
+		return;
+
+	nvavp->scale.level = level;
+	nvavp->sclk_rate = nvavp_scale_rate(nvavp->sclk, level);
+	nvavp->emc_clk_rate = nvavp_scale_rate(nvavp->emc_clk, level);
+	clk_set_rate(nvavp->vde_clk, nvavp_scale_rate(nvavp->vde_clk, level));
+
+	/* otherwise applied by the next nvavp_clks_enable() */
+	if (nvavp->clk_enabled) {
+		clk_set_rate(nvavp->emc_clk, nvavp->emc_clk_rate);
+		tegra_emc_bw_hint(TEGRA_EMC_BW_AVP, nvavp->emc_clk_rate);
+		nvavp_set_vde_la(nvavp->emc_clk_rate);
+		clk_set_rate(nvavp->sclk, nvavp->sclk_rate);
+	}
+	dev_dbg(&nvavp->nvhost_dev->dev, "%s: level %u, sclk %lu, emc %lu\n",
+		__func__, level, nvavp->sclk_rate, nvavp->emc_clk_rate);
+}
+
+/* called with the video pushbuffer_lock held, closes a measurement window
+ * once it is long enough and moves the rates to match its load */
+static void nvavp_scale_update(struct nvavp_info *nvavp, ktime_t now)
+{
+	struct nvavp_scale *scale = &nvavp->scale;
+	s64 wall_us = ktime_us_delta(now, scale->window_start);
+	unsigned int load, level;
+
+	if (wall_us < NVAVP_SCALE_WINDOW_MS * USEC_PER_MSEC)
+		return;
+
+	load = div64_s64(scale->busy_us * 100, wall_us);
+	scale->busy_us = 0;
+	scale->window_start = now;
+
+	mutex_lock(&nvavp->open_lock);
+	if (!clock_scaling || !clock_target_pct ||
+	    load >= NVAVP_SCALE_SATURATED_PCT) {
+		level = NVAVP_SCALE_MAX_LEVEL;
+	} else {
+		level = scale->level * load / clock_target_pct;
+		level = clamp_t(unsigned int, level, NVAVP_SCALE_MIN_LEVEL,
+				NVAVP_SCALE_MAX_LEVEL);
+	}
+	nvavp_scale_set_level(nvavp, level);
+	mutex_unlock(&nvavp->open_lock);
+}
+
+/* called with the video pushbuffer_lock held for each submission that ends
+ * with a sync point increment */
+static void nvavp_scale_busy(struct nvavp_info *nvavp)
+{
+	struct nvavp_scale *scale = &nvavp->scale;
+	ktime_t now;
+
+	if (scale->busy)
+		return;
+
+	now = ktime_get();
+	nvavp_scale_update(nvavp, now);
+	scale->busy = true;
+	scale->busy_start = now;
+	queue_work(system_long_wq, &scale->work);
+}
+
+/* times a busy period: waits until the sync point has reached the value of
+ * the latest submission, including those queued while waiting */
+static void nvavp_scale_worker(struct work_struct *work)
+{
+	struct nvavp_info *nvavp = container_of(work, struct nvavp_info,
+						scale.work);
+	struct nvavp_channel *channel_info;
+	struct nvavp_scale *scale = &nvavp->scale;
+	u32 thresh, cur;
+	ktime_t now;
+	int err = 0;
+
+	channel_info = nvavp_get_channel_info(nvavp, NVAVP_VIDEO_CHANNEL);
+
+	for (;;) {
+		mutex_lock(&channel_info->pushbuffer_lock);
+		thresh = nvavp->syncpt_value;
+		cur = nvhost_syncpt_read_ext(nvavp->nvhost_dev,
+					     nvavp->syncpt_id);
+		/* a stalled or halted AVP ends the period, the next
+		 * submission starts another */
+		if (err || (s32)(cur - thresh) >= 0)
+			break;
+		mutex_unlock(&channel_info->pushbuffer_lock);
+
+		err = nvhost_syncpt_wait_timeout_ext(nvavp->nvhost_dev,
+			nvavp->syncpt_id, thresh,
+			msecs_to_jiffies(NVAVP_PUSHBUFFER_TIMEOUT_MS), NULL);
+	}
+
+	now = ktime_get();
+	scale->busy_us += ktime_us_delta(now, scale->busy_start);
+	scale->busy = false;
+	nvavp_scale_update(nvavp, now);
+	mutex_unlock(&channel_info->pushbuffer_lock);
+}
+
 static u32 nvavp_check_idle(struct nvavp_info *nvavp, int channel_id)
 {
 	struct nvavp_channel *channel_info = nvavp_get_channel_info(nvavp, channel_id);
 	struct nv_e276_control *control = channel_info->os_control;
 
-	return (control->put == control->get) ? 1 : 0;
+	return (control->put == control->get &&
+		!channel_info->put_deferred) ? 1 : 0;
 }
 
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
@@ -396,11 +643,7 @@ static int nvavp_reset_avp(struct nvavp_info *nvavp, unsigned long reset_addr)
 	clk_enable(nvavp->sclk);
 	clk_enable(nvavp->emc_clk);
 
-	/* If sclk_rate and emc_clk is not set by user space,
-	 * max clock in dvfs table will be used to get best performance.
-	 */
-	nvavp->sclk_rate = ULONG_MAX;
-	nvavp->emc_clk_rate = ULONG_MAX;
+	nvavp_scale_reset(nvavp);
 
 	tegra_periph_reset_assert(nvavp->cop_clk);
 	udelay(2);
@@ -457,6 +700,35 @@ static int nvavp_reset_vde(struct nvavp_info *nvavp)
 	return 0;
 }
 
+/*
+ * Unpins the command buffers of the submissions the AVP has completed, or of
+ * all of them once it has been halted. Called with pushbuffer_lock held, or
+ * once there are no clients left.
+ */
+static void nvavp_retire_submits(struct nvavp_info *nvavp,
+				 struct nvavp_channel *channel_info, bool all)
+{
+	struct nvavp_submit *submit, *tmp;
+	u32 cur = 0;
+
+	if (list_empty(&channel_info->submits))
+		return;
+
+	if (!all)
+		cur = nvhost_syncpt_read_ext(nvavp->nvhost_dev,
+					     nvavp->syncpt_id);
+
+	list_for_each_entry_safe(submit, tmp, &channel_info->submits, node) {
+		if (!all && (s32)(cur - submit->syncpt_value) < 0)
+			break;
+
+		list_del(&submit->node);
+		nvmap_unpin(nvavp->nvmap, submit->cmdbuf);
+		nvmap_free(nvavp->nvmap, submit->cmdbuf);
+		kfree(submit);
+	}
+}
+
 static int nvavp_pushbuffer_alloc(struct nvavp_info *nvavp, int channel_id)
 {
 	int ret = 0;
@@ -509,6 +781,13 @@ static void nvavp_pushbuffer_free(struct nvavp_info *nvavp)
 	int channel_id;
 
 	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
+		/* no client is left that could submit */
+		nvavp_retire_submits(nvavp,
+			nvavp_get_channel_info(nvavp, channel_id), true);
+		nvavp->channel_info[channel_id].put_deferred = false;
+		nvavp->channel_info[channel_id].unpublished = 0;
+		nvavp->channel_info[channel_id].unpublished_enter_us = 0;
+
 		if (nvavp->channel_info[channel_id].pushbuf_data) {
 			nvmap_unpin(nvavp->nvmap,
 				nvavp->channel_info[channel_id].pushbuf_handle);
@@ -549,15 +828,135 @@ static void nvavp_pushbuffer_deinit(struct nvavp_info *nvavp)
 	nvavp_pushbuffer_free(nvavp);
 }
 
+/* bytes the AVP has consumed ahead of put; one word stays unused so that
+ * put == get means empty */
+static u32 nvavp_pushbuffer_space(struct nvavp_channel *channel_info)
+{
+	u32 get = readl(&channel_info->os_control->get);
+
+	return (get - channel_info->pushbuf_index - sizeof(u32)) &
+		(NVAVP_PUSHBUFFER_SIZE - 1);
+}
+
+/*
+ * The AVP OS runs one gather at a time and can't be preempted, so channel
+ * priority is enforced at submission granularity: while a channel of higher
+ * priority has work queued, the submissions of the others are written to
+ * their pushbuffers but their put pointers are only moved once it drains,
+ * or after NVAVP_PRIORITY_HOLDOFF_MS at the latest. Called with the
+ * channel's pushbuffer_lock held.
+ */
+static bool nvavp_pushbuffer_held_back(struct nvavp_info *nvavp,
+				       int channel_id)
+{
+	struct nvavp_channel *channel_info = nvavp_get_channel_info(nvavp,
+								     channel_id);
+	struct nvavp_channel *other;
+	int i;
+
+	if (channel_info->put_deferred &&
+	    time_after(jiffies, channel_info->deferred_since +
+			msecs_to_jiffies(NVAVP_PRIORITY_HOLDOFF_MS)))
+		return false;
+
+	for (i = 0; i < NVAVP_NUM_CHANNELS; i++) {
+		other = nvavp_get_channel_info(nvavp, i);
+		if (i == channel_id || other->priority <= channel_info->priority)
+			continue;
+		if (other->pushbuf_data &&
+		    readl(&other->os_control->put) !=
+		    readl(&other->os_control->get))
+			return true;
+	}
+	return false;
+}
+
+/* called with the channel's pushbuffer_lock held, hands everything
+ * written so far to the AVP */
+static void nvavp_pushbuffer_publish(struct nvavp_info *nvavp,
+				     int channel_id)
+{
+	struct nvavp_channel *channel_info = nvavp_get_channel_info(nvavp,
+								     channel_id);
+	s64 now_us = ktime_to_us(ktime_get());
+
+	/* update put pointer */
+	writel(channel_info->pushbuf_index, &channel_info->os_control->put);
+	wmb();
+
+	/* wake up avp */
+
+	if (IS_VIDEO_CHANNEL_ID(channel_id)) {
+		pr_debug("Wake up Video Channel\n");
+		writel(0xA0000001, NVAVP_OS_OUTBOX);
+	}
+	else {
+#if defined(CONFIG_TEGRA_NVAVP_AUDIO)
+		if (IS_AUDIO_CHANNEL_ID(channel_id)) {
+			pr_debug("Wake up Audio Channel\n");
+			writel(0xA0000002, NVAVP_OS_OUTBOX);
+		}
+#endif
+	}
+
+	/* the oldest submission has waited the longest */
+	channel_info->stat_submits += channel_info->unpublished;
+	channel_info->stat_delay_us += now_us * channel_info->unpublished -
+		channel_info->unpublished_enter_us;
+	channel_info->stat_delay_max_us = max_t(u32,
+		channel_info->stat_delay_max_us,
+		now_us - channel_info->unpublished_first_us);
+	channel_info->unpublished = 0;
+	channel_info->unpublished_enter_us = 0;
+	channel_info->put_deferred = false;
+}
+
+static void nvavp_priority_handler(struct work_struct *work)
+{
+	struct nvavp_info *nvavp = container_of(to_delayed_work(work),
+			struct nvavp_info, priority_work);
+	struct nvavp_channel *channel_info;
+	bool again = false;
+	int channel_id;
+
+	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
+		channel_info = nvavp_get_channel_info(nvavp, channel_id);
+
+		mutex_lock(&channel_info->pushbuffer_lock);
+		if (channel_info->put_deferred) {
+			if (nvavp_pushbuffer_held_back(nvavp, channel_id))
+				again = true;
+			else
+				nvavp_pushbuffer_publish(nvavp, channel_id);
+		}
+		mutex_unlock(&channel_info->pushbuffer_lock);
+	}
+
+	if (again)
+		schedule_delayed_work(&nvavp->priority_work, 1);
+}
+
+/*
+ * Appends a gather of the command buffer at phys_addr to the channel's
+ * pushbuffer. Several submissions can be in flight: this only waits for the
+ * AVP to free enough pushbuffer space, not for the previous one to complete.
+ * With syncpt, the gather is followed by a sync point increment whose value
+ * is returned; with submit, that value is also used to keep the command
+ * buffer pinned until the AVP is done with it.
+ */
 static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 			u32 gather_count, struct nvavp_syncpt *syncpt,
-			u32 ext_ucode_flag, int channel_id)
+			u32 ext_ucode_flag, int channel_id,
+			struct nvavp_submit *submit)
 {
 	struct nvavp_channel  *channel_info;
 	struct nv_e276_control *control;
 	u32 gather_cmd, setucode_cmd, sync = 0;
 	u32 wordcount = 0;
 	u32 index, value = -1;
+	u32 bytes, needed;
+	unsigned long timeout;
+	s64 enter_us = ktime_to_us(ktime_get());
 
 	channel_info = nvavp_get_channel_info(nvavp, channel_id);
 
@@ -566,10 +965,31 @@ static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 		control->put (0x%x) control->get (0x%x)\n",
 		channel_id, (u32) &control->put, (u32) &control->get);
 
+	bytes = sizeof(u32) * (2 + (ext_ucode_flag ? 0 : 4) + (syncpt ? 1 : 0));
+
 	mutex_lock(&channel_info->pushbuffer_lock);
 
-	/* check for pushbuffer wrapping */
-	if (channel_info->pushbuf_index >= channel_info->pushbuf_fence)
+	nvavp_retire_submits(nvavp, channel_info, false);
+
+	/* check for pushbuffer wrapping, the skipped tail counts as used */
+	needed = bytes;
+	if (channel_info->pushbuf_index >= channel_info->pushbuf_fence ||
+	    channel_info->pushbuf_index + bytes > NVAVP_PUSHBUFFER_SIZE)
+		needed += NVAVP_PUSHBUFFER_SIZE - channel_info->pushbuf_index;
+
+	timeout = jiffies + msecs_to_jiffies(NVAVP_PUSHBUFFER_TIMEOUT_MS);
+	while (nvavp_pushbuffer_space(channel_info) < needed) {
+		if (time_after(jiffies, timeout)) {
+			dev_err(&nvavp->nvhost_dev->dev,
+				"pushbuffer of channel %d stalled\n",
+				channel_id);
+			mutex_unlock(&channel_info->pushbuffer_lock);
+			return -ETIMEDOUT;
+		}
+		usleep_range(200, 400);
+	}
+
+	if (needed != bytes)
 		channel_info->pushbuf_index = 0;
 
 	if (!ext_ucode_flag) {
@@ -630,26 +1050,20 @@ static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 		mutex_unlock(&nvavp->open_lock);
 	}
 
-	/* update put pointer */
 	channel_info->pushbuf_index = (channel_info->pushbuf_index + wordcount)&
 					(NVAVP_PUSHBUFFER_SIZE - 1);
 
-	writel(channel_info->pushbuf_index, &control->put);
-	wmb();
-
-	/* wake up avp */
-
-	if (IS_VIDEO_CHANNEL_ID(channel_id)) {
-		pr_debug("Wake up Video Channel\n");
-		writel(0xA0000001, NVAVP_OS_OUTBOX);
-	}
-	else {
-#if defined(CONFIG_TEGRA_NVAVP_AUDIO)
-		if (IS_AUDIO_CHANNEL_ID(channel_id)) {
-			pr_debug("Wake up Audio Channel\n");
-			writel(0xA0000002, NVAVP_OS_OUTBOX);
-		}
-#endif
+	if (!channel_info->unpublished++)
+		channel_info->unpublished_first_us = enter_us;
+	channel_info->unpublished_enter_us += enter_us;
+
+	if (!nvavp_pushbuffer_held_back(nvavp, channel_id)) {
+		nvavp_pushbuffer_publish(nvavp, channel_id);
+	} else if (!channel_info->put_deferred) {
+		channel_info->put_deferred = true;
+		channel_info->deferred_since = jiffies;
+		channel_info->stat_deferred++;
+		schedule_delayed_work(&nvavp->priority_work, 1);
 	}
 	/* Fill out fence struct */
 	if (syncpt) {
@@ -657,6 +1071,14 @@ static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 		syncpt->value = value;
 	}
 
+	if (syncpt && IS_VIDEO_CHANNEL_ID(channel_id))
+		nvavp_scale_busy(nvavp);
+
+	if (submit) {
+		submit->syncpt_value = value;
+		list_add_tail(&submit->node, &channel_info->submits);
+	}
+
 	mutex_unlock(&channel_info->pushbuffer_lock);
 
 	return 0;
@@ -995,6 +1417,9 @@ static void nvavp_uninit(struct nvavp_info *nvavp)
 		pr_debug("nvavp_uninit nvavp->video_initialized\n");
 		cancel_work_sync(&nvavp->clock_disable_work);
 		nvavp_halt_vde(nvavp);
+		/* the last video client is gone and VDE is halted */
+		nvavp_retire_submits(nvavp, nvavp_get_channel_info(nvavp,
+					NVAVP_VIDEO_CHANNEL), true);
 		nvavp_set_video_init_status(nvavp, 0);
 		video_initialized = 0;
 	}
@@ -1014,6 +1439,7 @@ static void nvavp_uninit(struct nvavp_info *nvavp)
 		clk_disable(nvavp->sclk);
 		clk_disable(nvavp->emc_clk);
 		disable_irq(nvavp->mbox_from_avp_pend_irq);
+		cancel_delayed_work_sync(&nvavp->priority_work);
 		nvavp_pushbuffer_deinit(nvavp);
 		nvavp_halt_avp(nvavp);
 	}
@@ -1033,10 +1459,19 @@ static int nvavp_set_clock_ioctl(struct file *filp, unsigned int cmd,
 	dev_dbg(&nvavp->nvhost_dev->dev, "%s: clk_id=%d, clk_rate=%u\n",
 			__func__, config.id, config.rate);
 
+	mutex_lock(&nvavp->open_lock);
+	/* the client manages the clocks from now on */
+	nvavp->scale.fixed = true;
 	if (config.id == NVAVP_MODULE_ID_AVP)
 		nvavp->sclk_rate = config.rate;
-	else if	(config.id == NVAVP_MODULE_ID_EMC)
+	else if	(config.id == NVAVP_MODULE_ID_EMC) {
 		nvavp->emc_clk_rate = config.rate;
+		if (nvavp->clk_enabled) {
+			tegra_emc_bw_hint(TEGRA_EMC_BW_AVP, config.rate);
+			nvavp_set_vde_la(config.rate);
+		}
+	}
+	mutex_unlock(&nvavp->open_lock);
 
 	c = nvavp_clk_get(nvavp, config.id);
 	if (IS_ERR_OR_NULL(c))
@@ -1131,6 +1566,10 @@ static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
 	struct nvavp_pushbuffer_submit_hdr *user_hdr =
 			(struct nvavp_pushbuffer_submit_hdr *) arg;
 	struct nvavp_syncpt syncpt;
+	struct nvhost_fence *pre_fence = NULL;
+	struct nvavp_submit *submit = NULL;
+	struct nvavp_pushbuffer_submit_fence_hdr __user *fence_hdr = NULL;
+	s32 pre_fence_fd;
 
 	syncpt.id = NVSYNCPT_INVALID;
 	syncpt.value = 0;
@@ -1144,35 +1583,59 @@ static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
 	if (!hdr.cmdbuf.mem)
 		return 0;
 
+	if (cmd == NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_FENCE) {
+		fence_hdr = (void __user *)arg;
+
+		if (get_user(pre_fence_fd, &fence_hdr->pre_fence_fd))
+			return -EFAULT;
+
+		pre_fence = nvhost_fence_fdget(pre_fence_fd);
+		if (IS_ERR(pre_fence))
+			return PTR_ERR(pre_fence);
+	}
+
 	if (copy_from_user(clientctx->relocs, (void __user *)hdr.relocs,
 			sizeof(struct nvavp_reloc) * hdr.num_relocs)) {
-		return -EFAULT;
+		ret = -EFAULT;
+		goto err_put_fence;
 	}
 
-	cmdbuf_handle = nvmap_get_handle_id(clientctx->nvmap, hdr.cmdbuf.mem);
-	if (cmdbuf_handle == NULL) {
-		dev_err(&nvavp->nvhost_dev->dev,
-			"invalid cmd buffer handle %08x\n", hdr.cmdbuf.mem);
-		return -EPERM;
-	}
+	if (hdr.flags & NVAVP_CMDBUF_MEM_FD) {
+		/* the share fd itself grants access to the pushbuffer */
+		cmdbuf_dupe = nvmap_duplicate_handle_fd(nvavp->nvmap,
+							hdr.cmdbuf.mem);
+	} else {
+		cmdbuf_handle = nvmap_get_handle_id(clientctx->nvmap,
+						    hdr.cmdbuf.mem);
+		if (cmdbuf_handle == NULL) {
+			dev_err(&nvavp->nvhost_dev->dev,
+				"invalid cmd buffer handle %08x\n",
+				hdr.cmdbuf.mem);
+			ret = -EPERM;
+			goto err_put_fence;
+		}
 
-	/* duplicate the new pushbuffer's handle into the nvavp driver's
-	 * nvmap context, to ensure that the handle won't be freed as
-	 * long as it is in-use by the fb driver */
-	cmdbuf_dupe = nvmap_duplicate_handle_id(nvavp->nvmap, hdr.cmdbuf.mem);
-	nvmap_handle_put(cmdbuf_handle);
+		/* duplicate the new pushbuffer's handle into the nvavp
+		 * driver's nvmap context, to ensure that the handle won't be
+		 * freed as long as it is in-use by the fb driver */
+		cmdbuf_dupe = nvmap_duplicate_handle_id(nvavp->nvmap,
+							hdr.cmdbuf.mem);
+		nvmap_handle_put(cmdbuf_handle);
+	}
 
 	if (IS_ERR(cmdbuf_dupe)) {
 		dev_err(&nvavp->nvhost_dev->dev,
 			"could not duplicate handle\n");
-		return PTR_ERR(cmdbuf_dupe);
+		ret = PTR_ERR(cmdbuf_dupe);
+		goto err_put_fence;
 	}
 
 	phys_addr = nvmap_pin(nvavp->nvmap, cmdbuf_dupe);
 	if (IS_ERR((void *)phys_addr)) {
 		dev_err(&nvavp->nvhost_dev->dev, "could not pin handle\n");
 		nvmap_free(nvavp->nvmap, cmdbuf_dupe);
-		return PTR_ERR((void *)phys_addr);
+		ret = PTR_ERR((void *)phys_addr);
+		goto err_put_fence;
 	}
 
 	virt_addr = (unsigned long)nvmap_mmap(cmdbuf_dupe);
@@ -1203,31 +1666,64 @@ static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
 		writel(target_phys_addr, reloc_addr);
 	}
 
-	if (hdr.syncpt) {
-		ret = nvavp_pushbuffer_update(nvavp,
-					     (phys_addr + hdr.cmdbuf.offset),
-					      hdr.cmdbuf.words, &syncpt,
-					      (hdr.flags & NVAVP_UCODE_EXT),
-						clientctx->channel_id);
+	if (pre_fence) {
+		ret = nvhost_fence_wait(pre_fence, MAX_SCHEDULE_TIMEOUT);
+		if (ret)
+			goto err_reloc_info;
+	}
 
-		if (copy_to_user((void __user *)user_hdr->syncpt, &syncpt,
-				sizeof(struct nvavp_syncpt))) {
-			ret = -EFAULT;
+	/*
+	 * Video submissions always end in a sync point increment, so that the
+	 * command buffer stays pinned until the AVP has read it and the next
+	 * submission doesn't have to wait for this one.
+	 */
+	if (IS_VIDEO_CHANNEL_ID(clientctx->channel_id)) {
+		submit = kzalloc(sizeof(*submit), GFP_KERNEL);
+		if (!submit) {
+			ret = -ENOMEM;
 			goto err_reloc_info;
 		}
-	} else {
-		ret = nvavp_pushbuffer_update(nvavp,
-					     (phys_addr + hdr.cmdbuf.offset),
-					      hdr.cmdbuf.words, NULL,
-					      (hdr.flags & NVAVP_UCODE_EXT),
-						clientctx->channel_id);
+		submit->cmdbuf = cmdbuf_dupe;
+	}
+
+	ret = nvavp_pushbuffer_update(nvavp, (phys_addr + hdr.cmdbuf.offset),
+				      hdr.cmdbuf.words,
+				      (hdr.syncpt || submit) ? &syncpt : NULL,
+				      (hdr.flags & NVAVP_UCODE_EXT),
+				      clientctx->channel_id, submit);
+	if (ret) {
+		kfree(submit);
+		submit = NULL;
+		goto err_reloc_info;
+	}
+
+	if (hdr.syncpt &&
+	    copy_to_user((void __user *)user_hdr->syncpt, &syncpt,
+			 sizeof(struct nvavp_syncpt)))
+		ret = -EFAULT;
+
+	/* the submission is queued, a fence that can't be created is reported
+	 * in its fd field */
+	if (fence_hdr && (hdr.flags & NVAVP_POST_FENCE_FD)) {
+		s32 fd = syncpt.id == NVSYNCPT_INVALID ? -EINVAL :
+			nvhost_fence_create_syncpt_fd(nvavp->nvhost_dev,
+						      syncpt.id, syncpt.value);
+
+		if (put_user(fd, &fence_hdr->post_fence_fd))
+			ret = -EFAULT;
 	}
 
 err_reloc_info:
 	nvmap_munmap(cmdbuf_dupe, (void *)virt_addr);
 err_cmdbuf_mmap:
-	nvmap_unpin(nvavp->nvmap, cmdbuf_dupe);
-	nvmap_free(nvavp->nvmap, cmdbuf_dupe);
+	/* an in-flight submission owns the pin until it is retired */
+	if (!submit) {
+		nvmap_unpin(nvavp->nvmap, cmdbuf_dupe);
+		nvmap_free(nvavp->nvmap, cmdbuf_dupe);
+	}
+err_put_fence:
+	if (pre_fence)
+		nvhost_fence_put(pre_fence);
 	return ret;
 }
 
@@ -1240,6 +1736,30 @@ static int nvavp_wake_avp_ioctl(struct file *filp, unsigned int cmd,
 	return 0;
 }
 
+static int nvavp_set_channel_priority_ioctl(struct file *filp,
+				unsigned int cmd, unsigned long arg)
+{
+	struct nvavp_clientctx *clientctx = filp->private_data;
+	struct nvavp_info *nvavp = clientctx->nvavp;
+	struct nvavp_channel *channel_info;
+	struct nvavp_channel_priority_args args;
+
+	if (copy_from_user(&args, (void __user *)arg, sizeof(args)))
+		return -EFAULT;
+
+	if (args.priority > NVAVP_PRIORITY_HIGH)
+		return -EINVAL;
+
+	channel_info = nvavp_get_channel_info(nvavp, clientctx->channel_id);
+	mutex_lock(&channel_info->pushbuffer_lock);
+	channel_info->priority = args.priority;
+	mutex_unlock(&channel_info->pushbuffer_lock);
+
+	/* anything a lowered priority held back can go now */
+	schedule_delayed_work(&nvavp->priority_work, 0);
+	return 0;
+}
+
 static int nvavp_force_clock_stay_on_ioctl(struct file *filp, unsigned int cmd,
 							unsigned long arg)
 {
@@ -1329,6 +1849,54 @@ static int nvavp_disable_audio_clocks(struct file *filp, unsigned int cmd,
 }
 #endif
 
+/* called with open_lock held */
+static bool nvavp_is_resident(struct nvavp_info *nvavp)
+{
+	if (nvavp->refcount)
+		return false;
+#if defined(CONFIG_TEGRA_NVAVP_AUDIO)
+	if (nvavp_get_audio_init_status(nvavp))
+		return true;
+#endif
+	return nvavp_get_video_init_status(nvavp);
+}
+
+/* called with open_lock held, first open of an AVP left resident */
+static void nvavp_resident_reinit(struct nvavp_info *nvavp)
+{
+	/* the worker rechecks the refcount, so it needn't be waited for */
+	cancel_delayed_work(&nvavp->resident_work);
+
+	/* a session that went away with the AVP still busy gets the full
+	 * reset it would have had without residency */
+	if ((nvavp_get_video_init_status(nvavp) &&
+	     !nvavp_check_idle(nvavp, NVAVP_VIDEO_CHANNEL))
+#if defined(CONFIG_TEGRA_NVAVP_AUDIO)
+	    || (nvavp_get_audio_init_status(nvavp) &&
+		!nvavp_check_idle(nvavp, NVAVP_AUDIO_CHANNEL))
+#endif
+	    ) {
+		nvavp_uninit(nvavp);
+		return;
+	}
+
+	/* forget the previous session's clock requests */
+	nvavp_scale_reset(nvavp);
+}
+
+static void nvavp_resident_handler(struct work_struct *work)
+{
+	struct nvavp_info *nvavp = container_of(to_delayed_work(work),
+			struct nvavp_info, resident_work);
+
+	mutex_lock(&nvavp->open_lock);
+	if (nvavp_is_resident(nvavp)) {
+		dev_dbg(&nvavp->nvhost_dev->dev, "releasing resident AVP\n");
+		nvavp_uninit(nvavp);
+	}
+	mutex_unlock(&nvavp->open_lock);
+}
+
 static int tegra_nvavp_open(struct inode *inode, struct file *filp, int channel_id)
 {
 	struct miscdevice *miscdev = filp->private_data;
@@ -1350,6 +1918,9 @@ static int tegra_nvavp_open(struct inode *inode, struct file *filp, int channel_
 
 	clientctx->channel_id = channel_id;
 
+	if (nvavp_is_resident(nvavp))
+		nvavp_resident_reinit(nvavp);
+
 	ret = nvavp_init(nvavp, channel_id);
 
 	if (!ret)
@@ -1403,8 +1974,13 @@ static int tegra_nvavp_release(struct inode *inode, struct file *filp)
 
 	if (nvavp->refcount > 0)
 		nvavp->refcount--;
-	if (!nvavp->refcount)
-		nvavp_uninit(nvavp);
+	if (!nvavp->refcount) {
+		if (keep_resident_ms)
+			schedule_delayed_work(&nvavp->resident_work,
+				msecs_to_jiffies(keep_resident_ms));
+		else
+			nvavp_uninit(nvavp);
+	}
 
 out:
 	nvmap_client_put(clientctx->nvmap);
@@ -1431,6 +2007,7 @@ static long tegra_nvavp_ioctl(struct file *filp, unsigned int cmd,
 		ret = nvavp_get_syncpointid_ioctl(filp, cmd, arg);
 		break;
 	case NVAVP_IOCTL_PUSH_BUFFER_SUBMIT:
+	case NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_FENCE:
 		ret = nvavp_pushbuffer_submit_ioctl(filp, cmd, arg);
 		break;
 	case NVAVP_IOCTL_SET_CLOCK:
@@ -1451,6 +2028,9 @@ static long tegra_nvavp_ioctl(struct file *filp, unsigned int cmd,
 	case NVAVP_IOCTL_DISABLE_AUDIO_CLOCKS:
 		ret = nvavp_disable_audio_clocks(filp, cmd, arg);
 		break;
+	case NVAVP_IOCTL_SET_CHANNEL_PRIORITY:
+		ret = nvavp_set_channel_priority_ioctl(filp, cmd, arg);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -1458,6 +2038,73 @@ static long tegra_nvavp_ioctl(struct file *filp, unsigned int cmd,
 	return ret;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int dbg_nvavp_channels_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[] = { "video", "audio" };
+	struct nvavp_info *nvavp = s->private;
+	struct nvavp_channel *channel_info;
+	int channel_id;
+
+	seq_printf(s, "%-8s %8s %10s %10s %12s %12s\n", "channel",
+		   "priority", "submits", "deferred", "avg_delay_us",
+		   "max_delay_us");
+
+	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
+		channel_info = nvavp_get_channel_info(nvavp, channel_id);
+
+		mutex_lock(&channel_info->pushbuffer_lock);
+		seq_printf(s, "%-8s %8u %10llu %10llu %12llu %12u\n",
+			   names[channel_id], channel_info->priority,
+			   channel_info->stat_submits,
+			   channel_info->stat_deferred,
+			   channel_info->stat_submits ?
+				div64_u64(channel_info->stat_delay_us,
+					  channel_info->stat_submits) : 0,
+			   channel_info->stat_delay_max_us);
+		mutex_unlock(&channel_info->pushbuffer_lock);
+	}
+	return 0;
+}
+
+static int dbg_nvavp_channels_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_nvavp_channels_show, inode->i_private);
+}
+
+static const struct file_operations channels_fops = {
+	.open		= dbg_nvavp_channels_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void nvavp_remove_debugfs(struct nvavp_info *nvavp)
+{
+	if (nvavp->debugfs)
+		debugfs_remove_recursive(nvavp->debugfs);
+	nvavp->debugfs = NULL;
+}
+
+static void nvavp_create_debugfs(struct nvavp_info *nvavp)
+{
+	nvavp->debugfs = debugfs_create_dir(TEGRA_NVAVP_NAME, NULL);
+	if (!nvavp->debugfs)
+		goto err;
+
+	if (!debugfs_create_file("channels", S_IRUGO, nvavp->debugfs, nvavp,
+				 &channels_fops))
+		goto err;
+	return;
+err:
+	dev_err(&nvavp->nvhost_dev->dev, "could not create debugfs\n");
+	nvavp_remove_debugfs(nvavp);
+}
+#else /* !CONFIG_DEBUG_FS */
+static inline void nvavp_create_debugfs(struct nvavp_info *nvavp) { }
+static inline void nvavp_remove_debugfs(struct nvavp_info *nvavp) { }
+#endif /* CONFIG_DEBUG_FS */
+
 static const struct file_operations tegra_video_nvavp_fops = {
 	.owner		= THIS_MODULE,
 	.open		= tegra_nvavp_video_open,
@@ -1585,8 +2232,11 @@ static int tegra_nvavp_probe(struct nvhost_device *ndev,
 	nvavp->mbox_from_avp_pend_irq = irq;
 	mutex_init(&nvavp->open_lock);
 
-	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++)
+	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
 		mutex_init(&nvavp->channel_info[channel_id].pushbuffer_lock);
+		INIT_LIST_HEAD(&nvavp->channel_info[channel_id].submits);
+		nvavp->channel_info[channel_id].priority = NVAVP_PRIORITY_NORMAL;
+	}
 
 	/* TODO DO NOT USE NVAVP DEVICE */
 	nvavp->cop_clk = clk_get(&ndev->dev, "cop");
@@ -1644,6 +2294,10 @@ static int tegra_nvavp_probe(struct nvhost_device *ndev,
 	nvavp_halt_avp(nvavp);
 
 	INIT_WORK(&nvavp->clock_disable_work, clock_disable_handler);
+	INIT_DELAYED_WORK(&nvavp->resident_work, nvavp_resident_handler);
+	INIT_WORK(&nvavp->scale.work, nvavp_scale_worker);
+	nvavp->scale.window_start = ktime_get();
+	INIT_DELAYED_WORK(&nvavp->priority_work, nvavp_priority_handler);
 
 	nvavp->video_misc_dev.minor = MISC_DYNAMIC_MINOR;
 	nvavp->video_misc_dev.name = "tegra_avpchannel";
@@ -1683,6 +2337,8 @@ static int tegra_nvavp_probe(struct nvhost_device *ndev,
 	nvhost_set_drvdata(ndev, nvavp);
 	nvavp->nvhost_dev = ndev;
 
+	nvavp_create_debugfs(nvavp);
+
 	return 0;
 
 err_req_irq_pend:
@@ -1739,6 +2395,15 @@ static int tegra_nvavp_remove(struct nvhost_device *ndev)
 	}
 	mutex_unlock(&nvavp->open_lock);
 
+	nvavp_remove_debugfs(nvavp);
+
+	cancel_delayed_work_sync(&nvavp->resident_work);
+	cancel_work_sync(&nvavp->scale.work);
+	mutex_lock(&nvavp->open_lock);
+	if (nvavp_is_resident(nvavp))
+		nvavp_uninit(nvavp);
+	mutex_unlock(&nvavp->open_lock);
+
 	nvavp_unload_ucode(nvavp);
 	nvavp_unload_os(nvavp);
 
@@ -1784,6 +2449,9 @@ static int tegra_nvavp_suspend(struct nvhost_device *ndev, pm_message_t state)
 		else {
 			ret = -EBUSY;
 		}
+	} else if (nvavp_is_resident(nvavp)) {
+		/* without clients the AVP is idle, resume reloads on open */
+		nvavp_uninit(nvavp);
 	}
 
 	mutex_unlock(&nvavp->open_lock);
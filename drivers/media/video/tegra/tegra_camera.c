@@ -28,6 +28,7 @@
 #include <mach/iomap.h>
 #include <mach/clk.h>
 #include <mach/powergate.h>
+#include <mach/latency_allowance.h>
 
 #include <media/tegra_camera.h>
 
@@ -113,6 +114,19 @@ static int tegra_camera_disable_clk(struct tegra_camera_dev *dev)
 	return 0;
 }
 
+/* The EMC rate requested for capture covers the VI write clients: Y (or
+ * the single buffer) at full bandwidth, U and V at a quarter each. EMC
+ * rate in Hz is converted to MBps for a 32-bit DDR bus. */
+static void tegra_camera_set_la(unsigned long emc_rate)
+{
+	unsigned int bw = min(emc_rate / 250000 / 2, 4095UL);
+
+	tegra_set_latency_allowance(TEGRA_LA_VI_WSB, bw);
+	tegra_set_latency_allowance(TEGRA_LA_VI_WY, bw);
+	tegra_set_latency_allowance(TEGRA_LA_VI_WU, bw / 2);
+	tegra_set_latency_allowance(TEGRA_LA_VI_WV, bw / 2);
+}
+
 static int tegra_camera_enable_emc(struct tegra_camera_dev *dev)
 {
 	int ret = tegra_emc_disable_eack();
@@ -125,6 +139,7 @@ static int tegra_camera_enable_emc(struct tegra_camera_dev *dev)
 
 static int tegra_camera_disable_emc(struct tegra_camera_dev *dev)
 {
+	tegra_camera_set_la(0);
 	clk_disable(dev->emc_clk);
 	return tegra_emc_enable_eack();
 }
@@ -163,6 +178,7 @@ static int tegra_camera_clk_set_rate(struct tegra_camera_dev *dev)
 		dev_dbg(dev->dev, "%s: emc_clk rate=%lu\n",
 			__func__, info->rate);
 		clk_set_rate(dev->emc_clk, info->rate);
+		tegra_camera_set_la(info->rate);
 #endif
 		goto set_rate_end;
 	default:
@@ -38,6 +38,10 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/delay.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/nvmap.h>
 
 #include <media/tegra_dtv.h>
 
@@ -111,6 +115,10 @@
 #define DTV_BUF_SIZE_ORDER                PAGE_SHIFT
 #define DTV_MAX_NUM_BUFS                  4
 
+/* streaming ring limits, a DMA pair of periods is at most 64KB */
+#define DTV_RING_MAX_PERIOD               (32 << 10)
+#define DTV_RING_MAX_SIZE                 (4 << 20)
+
 #define DTV_FIFO_ATN_LVL_LOW_GEAR         0
 #define DTV_FIFO_ATN_LVL_SECOND_GEAR      1
 #define DTV_FIFO_ATN_LVL_THIRD_GEAR       2
@@ -138,6 +146,26 @@ struct dtv_stream {
 	struct work_struct	work;
 	struct wake_lock	wake_lock;
 	char			wake_lock_name[16];
+
+	/*
+	 * streaming ring, filled by a cyclic DMA instead of read(). mmap()
+	 * comes with mmap_sem held, which mtx is taken outside of, so the
+	 * ring is set up and freed under ring_mtx as well.
+	 */
+	struct mutex			 ring_mtx;
+	struct nvmap_handle_ref		*ring;
+	phys_addr_t			 ring_phys;
+	size_t				 ring_size;
+	size_t				 ring_period;
+	atomic_t			 ring_maps;
+	struct tegra_dma_channel	*ring_chan;
+	struct tegra_dma_req		 ring_req;
+	wait_queue_head_t		 ring_wait;
+	/* under dma_req_lock */
+	unsigned			 ring_head;	/* ring offset filled to */
+	u64				 ring_produced;
+	u64				 ring_consumed;
+	unsigned			 ring_overruns;
 };
 
 struct tegra_dtv_context {
@@ -155,6 +183,7 @@ struct tegra_dtv_context {
 	/* for refer back */
 	struct platform_device    *pdev;
 	struct miscdevice          miscdev;
+	struct nvmap_client       *nvmap;
 };
 
 static inline struct tegra_dtv_context *to_ctx(struct dtv_stream *s)
@@ -255,6 +284,28 @@ static void tegra_dtv_rx_dma_complete(struct tegra_dma_req *req)
 	spin_unlock_irqrestore(&s->dma_req_lock, flags);
 }
 
+/* period callback of the streaming ring, from the DMA ISR */
+static void tegra_dtv_ring_complete(struct tegra_dma_req *req)
+{
+	unsigned long flags;
+	unsigned pos;
+	struct dtv_stream *s = req->dev;
+
+	if (req->status == -TEGRA_DMA_REQ_ERROR_ABORTED)
+		return;
+
+	/* publish whole periods only, the one in flight is still filling */
+	pos = tegra_dma_get_transfer_count(s->ring_chan, req);
+	pos = rounddown(pos, s->ring_period);
+
+	spin_lock_irqsave(&s->dma_req_lock, flags);
+	s->ring_produced += (pos + s->ring_size - s->ring_head) % s->ring_size;
+	s->ring_head = pos;
+	spin_unlock_irqrestore(&s->dma_req_lock, flags);
+
+	wake_up_interruptible(&s->ring_wait);
+}
+
 /* hw */
 static inline void _dtv_enable_protocol(struct tegra_dtv_context *dtv_ctx)
 {
@@ -360,6 +411,8 @@ static int stop_xfer_unsafe(struct dtv_stream *s)
 
 	pr_debug("%s called\n", __func__);
 	tegra_dma_cancel(s->dma_chan);
+	if (s->ring_chan)
+		tegra_dma_cancel(s->ring_chan);
 	_dtv_disable_protocol(dtv_ctx);
 	while ((_dtv_get_status(dtv_ctx) & DTV_STATUS_RXF_FULL) &&
 	       spin < 100) {
@@ -391,11 +444,144 @@ static void __force_xfer_stop(struct dtv_stream *s)
 	}
 
 	tegra_dma_cancel(s->dma_chan);
+	if (s->ring_chan) {
+		tegra_dma_cancel(s->ring_chan);
+		/* nothing waits for a ring buffer to let go of the wake lock */
+		wakeup_suspend(s);
+		wake_up_interruptible(&s->ring_wait);
+	}
 	s->xferring = false;
 
 	pr_debug("%s: done\n", __func__);
 }
 
+static void setup_dma_rx_request(struct tegra_dma_req *req,
+				 struct dtv_stream *s);
+
+/* must call with stream->mtx and ring_mtx held, not while transferring. */
+static void release_ring(struct tegra_dtv_context *dtv_ctx)
+{
+	struct dtv_stream *s = &dtv_ctx->stream;
+
+	if (!s->ring)
+		return;
+
+	tegra_dma_free_channel(s->ring_chan);
+	s->ring_chan = NULL;
+	nvmap_unpin(dtv_ctx->nvmap, s->ring);
+	nvmap_free(dtv_ctx->nvmap, s->ring);
+	s->ring = NULL;
+	s->ring_size = 0;
+}
+
+/* must call with stream->mtx and ring_mtx held, not while transferring. */
+static int setup_ring(struct tegra_dtv_context *dtv_ctx,
+		      struct tegra_dtv_ring_config *cfg)
+{
+	int ret;
+	size_t size;
+	struct dtv_stream *s = &dtv_ctx->stream;
+
+	if (!cfg->period_size || !IS_ALIGNED(cfg->period_size, 4) ||
+	    cfg->period_size > DTV_RING_MAX_PERIOD ||
+	    cfg->num_periods < 2 || (cfg->num_periods & 1) ||
+	    cfg->num_periods > DTV_RING_MAX_SIZE / cfg->period_size)
+		return -EINVAL;
+	size = cfg->period_size * cfg->num_periods;
+
+	if (!dtv_ctx->nvmap) {
+		dtv_ctx->nvmap = nvmap_create_client(nvmap_dev, "tegra_dtv");
+		if (IS_ERR_OR_NULL(dtv_ctx->nvmap)) {
+			pr_err("%s: cannot create nvmap client.\n", __func__);
+			dtv_ctx->nvmap = NULL;
+			return -ENODEV;
+		}
+	}
+
+	/* APB DMA needs it contiguous; nobody writes it but the DMA, so
+	 * write combined mappings need no cache maintenance at all */
+	s->ring = nvmap_alloc(dtv_ctx->nvmap, size, PAGE_SIZE,
+			      NVMAP_HANDLE_WRITE_COMBINE,
+			      NVMAP_HEAP_CARVEOUT_GENERIC);
+	if (IS_ERR(s->ring)) {
+		pr_err("%s: cannot allocate %zu byte ring.\n", __func__, size);
+		ret = PTR_ERR(s->ring);
+		s->ring = NULL;
+		return ret;
+	}
+
+	s->ring_phys = nvmap_pin(dtv_ctx->nvmap, s->ring);
+	if (IS_ERR((void *)s->ring_phys)) {
+		ret = PTR_ERR((void *)s->ring_phys);
+		goto fail_pin;
+	}
+
+	s->ring_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CYCLIC,
+						  "tegra_dtv_ring");
+	if (!s->ring_chan) {
+		pr_err("%s: cannot allocate ring DMA channel.\n", __func__);
+		ret = -ENODEV;
+		goto fail_chan;
+	}
+
+	ret = nvmap_share_fd(dtv_ctx->nvmap, s->ring);
+	if (ret < 0)
+		goto fail_share;
+	cfg->fd = ret;
+
+	setup_dma_rx_request(&s->ring_req, s);
+	s->ring_req.complete = tegra_dtv_ring_complete;
+	s->ring_req.dest_addr = s->ring_phys;
+	s->ring_req.size = size;
+	s->ring_req.period_size = cfg->period_size;
+	s->ring_size = size;
+	s->ring_period = cfg->period_size;
+
+	return 0;
+
+fail_share:
+	tegra_dma_free_channel(s->ring_chan);
+	s->ring_chan = NULL;
+fail_chan:
+	nvmap_unpin(dtv_ctx->nvmap, s->ring);
+fail_pin:
+	nvmap_free(dtv_ctx->nvmap, s->ring);
+	s->ring = NULL;
+	return ret;
+}
+
+/* must call with stream->mtx held. */
+static int start_ring_xfer(struct dtv_stream *s)
+{
+	int ret;
+	unsigned long flags;
+	struct tegra_dtv_context *dtv_ctx = to_ctx(s);
+
+	spin_lock_irqsave(&s->dma_req_lock, flags);
+	s->ring_head = 0;
+	s->ring_produced = 0;
+	s->ring_consumed = 0;
+	s->ring_overruns = 0;
+	spin_unlock_irqrestore(&s->dma_req_lock, flags);
+
+	prevent_suspend(s);
+
+	s->ring_req.start_offset = 0;
+	s->ring_req.overruns = 0;
+	ret = tegra_dma_enqueue_req(s->ring_chan, &s->ring_req);
+	if (ret) {
+		pr_err("%s: start ring transfer failed.\n", __func__);
+		wakeup_suspend(s);
+		return ret;
+	}
+
+	_dtv_set_attn_level(dtv_ctx);
+	_dtv_enable_protocol(dtv_ctx);
+	s->xferring = true;
+
+	return 0;
+}
+
 static long tegra_dtv_ioctl(struct file *file, unsigned int cmd,
 			    unsigned long arg)
 {
@@ -413,6 +599,8 @@ static long tegra_dtv_ioctl(struct file *file, unsigned int cmd,
 	case TEGRA_DTV_IOCTL_START:
 		pr_debug("%s: run serial ts handling.\n", __func__);
 		s->stopped = false;
+		if (s->ring && !s->xferring)
+			ret = start_ring_xfer(s);
 		break;
 	case TEGRA_DTV_IOCTL_STOP:
 		pr_debug("%s: stop serial ts handling.\n", __func__);
@@ -454,6 +642,70 @@ static long tegra_dtv_ioctl(struct file *file, unsigned int cmd,
 			ret = -EFAULT;
 		break;
 	}
+	case TEGRA_DTV_IOCTL_RING_SETUP:
+	{
+		struct tegra_dtv_ring_config cfg;
+
+		if (s->xferring) {
+			ret = -EBUSY;
+			break;
+		}
+
+		if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		mutex_lock(&s->ring_mtx);
+		if (atomic_read(&s->ring_maps)) {
+			ret = -EBUSY;
+		} else {
+			release_ring(dtv_ctx);
+			cfg.fd = -1;
+			if (cfg.num_periods)
+				ret = setup_ring(dtv_ctx, &cfg);
+		}
+		mutex_unlock(&s->ring_mtx);
+
+		if (!ret && copy_to_user((void __user *)arg, &cfg,
+					 sizeof(cfg)))
+			ret = -EFAULT;
+		break;
+	}
+	case TEGRA_DTV_IOCTL_RING_SYNC:
+	{
+		struct tegra_dtv_ring_pos pos;
+		unsigned long flags;
+
+		if (!s->ring) {
+			ret = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&pos, (void __user *)arg, sizeof(pos))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		spin_lock_irqsave(&s->dma_req_lock, flags);
+		if (pos.consumed > s->ring_produced) {
+			ret = -EINVAL;
+		} else {
+			/* the period in flight overwrites the oldest one */
+			if (s->ring_produced - pos.consumed >
+			    s->ring_size - s->ring_period)
+				s->ring_overruns++;
+			s->ring_consumed = pos.consumed;
+			pos.produced = s->ring_produced;
+			pos.overruns = s->ring_overruns + s->ring_req.overruns;
+		}
+		spin_unlock_irqrestore(&s->dma_req_lock, flags);
+
+		if (!ret && copy_to_user((void __user *)arg, &pos,
+					 sizeof(pos)))
+			ret = -EFAULT;
+		break;
+	}
 	default:
 		ret = -EINVAL;
 	}
@@ -529,6 +781,11 @@ static ssize_t tegra_dtv_read(struct file *file, char __user *buf,
 
 	mutex_lock(&dtv_ctx->stream.mtx);
 
+	if (dtv_ctx->stream.ring) {
+		mutex_unlock(&dtv_ctx->stream.mtx);
+		return -EBUSY;
+	}
+
 	if (!IS_ALIGNED(size, 4) || size < 4 ||
 	    size > dtv_ctx->stream.buf_size) {
 		pr_err("%s: invalid user size %d\n", __func__, size);
@@ -613,6 +870,84 @@ static ssize_t tegra_dtv_read(struct file *file, char __user *buf,
 	return ret;
 }
 
+static unsigned int tegra_dtv_poll(struct file *file, poll_table *wait)
+{
+	unsigned int mask = 0;
+	unsigned long flags;
+	struct tegra_dtv_context *dtv_ctx = file->private_data;
+	struct dtv_stream *s = &dtv_ctx->stream;
+
+	/* read() blocks by itself */
+	if (!s->ring)
+		return POLLIN | POLLRDNORM;
+
+	poll_wait(file, &s->ring_wait, wait);
+
+	spin_lock_irqsave(&s->dma_req_lock, flags);
+	if (s->ring_produced != s->ring_consumed)
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&s->dma_req_lock, flags);
+
+	if (s->stopped || !s->xferring)
+		mask |= POLLHUP;
+
+	return mask;
+}
+
+static void tegra_dtv_vm_open(struct vm_area_struct *vma)
+{
+	struct dtv_stream *s = vma->vm_private_data;
+
+	atomic_inc(&s->ring_maps);
+}
+
+static void tegra_dtv_vm_close(struct vm_area_struct *vma)
+{
+	struct dtv_stream *s = vma->vm_private_data;
+
+	atomic_dec(&s->ring_maps);
+}
+
+static const struct vm_operations_struct tegra_dtv_vm_ops = {
+	.open = tegra_dtv_vm_open,
+	.close = tegra_dtv_vm_close,
+};
+
+static int tegra_dtv_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret;
+	size_t size = vma->vm_end - vma->vm_start;
+	struct tegra_dtv_context *dtv_ctx = file->private_data;
+	struct dtv_stream *s = &dtv_ctx->stream;
+
+	mutex_lock(&s->ring_mtx);
+
+	if (!s->ring || vma->vm_pgoff || size > PAGE_ALIGN(s->ring_size)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	/* the ring belongs to the DMA */
+	if (vma->vm_flags & VM_WRITE) {
+		ret = -EPERM;
+		goto out;
+	}
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	/* same attributes as the write combined nvmap handle */
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	ret = remap_pfn_range(vma, vma->vm_start, s->ring_phys >> PAGE_SHIFT,
+			      size, vma->vm_page_prot);
+	if (ret)
+		goto out;
+
+	vma->vm_ops = &tegra_dtv_vm_ops;
+	vma->vm_private_data = s;
+	atomic_inc(&s->ring_maps);
+out:
+	mutex_unlock(&s->ring_mtx);
+	return ret;
+}
+
 static int tegra_dtv_open(struct inode *inode, struct file *file)
 {
 	int i;
@@ -664,6 +999,10 @@ static int tegra_dtv_release(struct inode *inode, struct file *file)
 		complete(&dtv_ctx->stream.stop_completion);
 		__force_xfer_stop(&dtv_ctx->stream);
 	}
+	/* the ring is per open, mappings hold the file until unmapped */
+	mutex_lock(&dtv_ctx->stream.ring_mtx);
+	release_ring(dtv_ctx);
+	mutex_unlock(&dtv_ctx->stream.ring_mtx);
 	/* wakeup any pending process */
 	wakeup_suspend(&dtv_ctx->stream);
 	mutex_unlock(&dtv_ctx->stream.mtx);
@@ -677,6 +1016,8 @@ static const struct file_operations tegra_dtv_fops = {
 	.owner = THIS_MODULE,
 	.open = tegra_dtv_open,
 	.read = tegra_dtv_read,
+	.poll = tegra_dtv_poll,
+	.mmap = tegra_dtv_mmap,
 	.unlocked_ioctl = tegra_dtv_ioctl,
 	.release = tegra_dtv_release,
 };
@@ -696,6 +1037,12 @@ static int dtv_reg_show(struct seq_file *s, void *unused)
 		   tegra_dtv_readl(dtv_ctx, DTV_CTRL));
 	seq_printf(s, "DTV_FIFO:          0x%08x\n",
 		   tegra_dtv_readl(dtv_ctx, DTV_RX_FIFO));
+	if (dtv_ctx->stream.ring)
+		seq_printf(s, "ring: %zu bytes, produced %llu, overruns %u/%u\n",
+			   dtv_ctx->stream.ring_size,
+			   dtv_ctx->stream.ring_produced,
+			   dtv_ctx->stream.ring_overruns,
+			   dtv_ctx->stream.ring_req.overruns);
 
 	return 0;
 
@@ -886,6 +1233,12 @@ static int setup_stream(struct dtv_stream *stream)
 	if (ret < 0)
 		return ret;
 
+	mutex_init(&stream->ring_mtx);
+	init_waitqueue_head(&stream->ring_wait);
+	atomic_set(&stream->ring_maps, 0);
+	stream->ring = NULL;
+	stream->ring_chan = NULL;
+
 	INIT_WORK(&stream->work, tegra_dtv_worker);
 	wake_lock_init(&stream->wake_lock, WAKE_LOCK_SUSPEND, "tegra_dtv");
 
@@ -1008,6 +1361,8 @@ static int __devexit tegra_dtv_remove(struct platform_device *pdev)
 	dtv_debugfs_exit(dtv_ctx);
 	tear_down_dma(dtv_ctx);
 	release_stream_buffer(&dtv_ctx->stream, dtv_ctx->stream.num_bufs);
+	if (dtv_ctx->nvmap)
+		nvmap_client_put(dtv_ctx->nvmap);
 
 	clk_put(dtv_ctx->clk);
 
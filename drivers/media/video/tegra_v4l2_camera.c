@@ -48,6 +48,9 @@
 
 #define TEGRA_SYNCPT_RETRY_COUNT			10
 
+/* one being captured, one queued behind it and one held by userspace */
+#define TEGRA_CAMERA_MIN_BUFFERS			3
+
 /* SYNCPTs 12-17 are reserved for VI. */
 #define TEGRA_VI_SYNCPT_VI                              NVSYNCPT_VI_ISP_2
 #define TEGRA_VI_SYNCPT_CSI_A                           NVSYNCPT_VI_ISP_3
@@ -307,6 +310,10 @@ struct tegra_camera_dev {
 
 	struct work_struct		work;
 	struct mutex			work_mutex;
+	/* camera the capture path is programmed for, protected by work_mutex;
+	 * NULL when it needs to be set up again */
+	struct soc_camera_device	*armed_icd;
+	int				armed_output_channel;
 
 	u32				syncpt_vi;
 	u32				syncpt_csi_a;
@@ -968,8 +975,11 @@ static int tegra_camera_capture_start(struct tegra_camera_dev *pcdev,
 		}
 	}
 
-	if (!err)
+	if (!err) {
+		/* the frame end sync point has just been reached */
+		do_gettimeofday(&buf->vb.v4l2_buf.timestamp);
 		return 0;
+	}
 
 	if (tegra_camera_port_is_csi(port)) {
 		u32 ppstatus;
@@ -1125,6 +1135,7 @@ static void tegra_camera_deactivate(struct tegra_camera_dev *pcdev)
 	nvhost_module_idle_ext(pcdev->ndev);
 
 	pcdev->cal_done = 0;
+	pcdev->armed_icd = NULL;
 }
 
 static int tegra_camera_capture_frame(struct tegra_camera_dev *pcdev)
@@ -1197,7 +1208,6 @@ static int tegra_camera_capture_frame(struct tegra_camera_dev *pcdev)
 	}
 
 	spin_lock_irq(&pcdev->videobuf_queue_lock);
-	do_gettimeofday(&vb->v4l2_buf.timestamp);
 	vb->v4l2_buf.field = pcdev->field;
 	if (port == TEGRA_CAMERA_PORT_CSI_A)
 		vb->v4l2_buf.sequence = pcdev->sequence_a++;
@@ -1314,7 +1324,21 @@ static void tegra_camera_work(struct work_struct *work)
 		pcdev->active = &buf->vb;
 		spin_unlock_irq(&pcdev->videobuf_queue_lock);
 
-		tegra_camera_capture_setup(pcdev);
+		/*
+		 * The input and output channels keep their setup from one
+		 * frame to the next, so each buffer only costs its addresses
+		 * and a single shot and the next frame start isn't missed
+		 * while a full setup is redone.
+		 */
+		if (pcdev->armed_icd != buf->icd) {
+			if (!tegra_camera_capture_setup(pcdev)) {
+				pcdev->armed_icd = buf->icd;
+				pcdev->armed_output_channel =
+					buf->output_channel;
+			}
+		} else {
+			buf->output_channel = pcdev->armed_output_channel;
+		}
 		if (!pcdev->cal_done) {
 			tegra_camera_csi_pad_calibration(pcdev);
 			pcdev->cal_done = 1;
@@ -1432,6 +1456,8 @@ static int tegra_camera_videobuf_setup(struct vb2_queue *vq,
 		return bytes_per_line;
 
 	*num_planes = 1;
+	if (*num_buffers < TEGRA_CAMERA_MIN_BUFFERS)
+		*num_buffers = TEGRA_CAMERA_MIN_BUFFERS;
 	if (pdata->port == TEGRA_CAMERA_PORT_CSI_A)
 		pcdev->sequence_a = 0;
 	else if (pdata->port == TEGRA_CAMERA_PORT_CSI_B)
@@ -1439,9 +1465,6 @@ static int tegra_camera_videobuf_setup(struct vb2_queue *vq,
 	sizes[0] = bytes_per_line * icd->user_height;
 	alloc_ctxs[0] = pcdev->alloc_ctx;
 
-	if (!*num_buffers)
-		*num_buffers = 2;
-
 	if (IS_INTERLACED)
 		pcdev->internal_vbuf = vb2_dma_nvmap_memops.alloc(pcdev->alloc_ctx, bytes_per_line * icd->user_height);
 
@@ -1600,6 +1623,10 @@ static int tegra_camera_stop_streaming(struct vb2_queue *q)
 			pcdev->active = NULL;
 	}
 
+	/* the next stream may come with another format */
+	if (pcdev->armed_icd == icd)
+		pcdev->armed_icd = NULL;
+
 	mutex_unlock(&pcdev->work_mutex);
 
 	return 0;
@@ -1875,6 +1902,31 @@ static unsigned int tegra_camera_poll(struct file *file, poll_table *pt)
 	return vb2_poll(&icd->vb2_vidq, file, pt);
 }
 
+static long tegra_camera_default_ioctl(struct soc_camera_device *icd,
+				       struct file *file, int cmd, void *arg)
+{
+	struct vb2_queue *q = &icd->vb2_vidq;
+	struct tegra_camera_expbuf *exp = arg;
+	int fd;
+
+	if (cmd != TEGRA_CAMERA_IOC_EXPBUF)
+		return -EINVAL;
+
+	if (icd->streamer != file)
+		return -EBUSY;
+
+	if (exp->index >= q->num_buffers)
+		return -EINVAL;
+
+	fd = vb2_dma_nvmap_share_fd(q->bufs[exp->index], exp->plane);
+	if (fd < 0)
+		return fd;
+
+	exp->fd = fd;
+
+	return 0;
+}
+
 static int tegra_camera_querycap(struct soc_camera_host *ici,
 		struct v4l2_capability *cap)
 {
@@ -1898,6 +1950,7 @@ static struct soc_camera_host_ops tegra_soc_camera_host_ops = {
 	.reqbufs	= tegra_camera_reqbufs,
 	.poll		= tegra_camera_poll,
 	.querycap	= tegra_camera_querycap,
+	.default_ioctl	= tegra_camera_default_ioctl,
 };
 
 
@@ -212,6 +212,26 @@ static void vb2_dma_nvmap_put_userptr(void *mem_priv)
 	kfree(buf);
 }
 
+/*
+ * Returns an nvmap share fd for an MMAP buffer, so that the frame can be
+ * handed to display or nvavp without copying it or making it global.
+ */
+int vb2_dma_nvmap_share_fd(struct vb2_buffer *vb, unsigned int plane_no)
+{
+	struct vb2_dc_buf *buf;
+
+	if (plane_no >= vb->num_planes ||
+	    vb->v4l2_buf.memory != V4L2_MEMORY_MMAP)
+		return -EINVAL;
+
+	buf = vb->planes[plane_no].mem_priv;
+	if (!buf || !buf->nvmap_ref)
+		return -EINVAL;
+
+	return nvmap_share_fd(buf->conf->nvmap_client, buf->nvmap_ref);
+}
+EXPORT_SYMBOL_GPL(vb2_dma_nvmap_share_fd);
+
 const struct vb2_mem_ops vb2_dma_nvmap_memops = {
 	.alloc		= vb2_dma_nvmap_alloc,
 	.put		= vb2_dma_nvmap_put,
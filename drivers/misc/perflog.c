@@ -0,0 +1,224 @@
+/*
+ * drivers/misc/perflog.c
+ *
+ * Crash-persistent log of performance events
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Keeps a ring of fixed size binary records (cluster switches, thermal
+ * throttling, EMC and cbus rate changes, low memory killer kills) in a
+ * carveout that survives a warm reboot, the same way ram_console keeps
+ * the kernel log. On the next boot the previous ring is handed to pstore
+ * and shows up as /dev/pstore/perf-perflog-<boot>; the format is in
+ * include/linux/perflog.h.
+ *
+ * Recording takes no lock: a writer claims a slot with an atomic
+ * increment and fills it, writing the sequence number last, so that an
+ * entry torn by a reset is recognised and skipped.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/io.h>
+#include <linux/log2.h>
+#include <linux/platform_device.h>
+#include <linux/pstore.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/string.h>
+#include <linux/perflog.h>
+
+#define PERFLOG_SIG	0x474c4650	/* PFLG */
+
+int perflog_recording;
+EXPORT_SYMBOL(perflog_recording);
+
+static struct perflog_header *perflog_hdr;
+static struct perflog_entry *perflog_ring;
+static u32 perflog_mask;
+static atomic_t perflog_seq = ATOMIC_INIT(0);
+
+/* previous boot's log, header then entries in order */
+static void *perflog_old;
+static size_t perflog_old_size;
+static bool perflog_old_read;
+
+void __perflog_record(u16 event, u32 arg0, u32 arg1)
+{
+	u32 seq = atomic_inc_return(&perflog_seq);
+	struct perflog_entry *e = &perflog_ring[seq & perflog_mask];
+
+	e->seq = 0;
+	e->time = (u32)(sched_clock() >> 10);
+	e->event = event;
+	e->cpu = raw_smp_processor_id();
+	e->arg0 = arg0;
+	e->arg1 = arg1;
+	wmb();
+	e->seq = seq;
+}
+EXPORT_SYMBOL(__perflog_record);
+
+static void __init perflog_save_old(void)
+{
+	struct perflog_header *hdr;
+	struct perflog_entry *out;
+	u32 nr = perflog_mask + 1;
+	u32 last = 0, first, seq, i;
+
+	for (i = 0; i < nr; i++)
+		last = max(last, perflog_ring[i].seq);
+	if (!last)
+		return;
+	first = last >= nr ? last - nr + 1 : 1;
+
+	perflog_old_size = sizeof(*hdr) + (last - first + 1) * sizeof(*out);
+	perflog_old = kmalloc(perflog_old_size, GFP_KERNEL);
+	if (!perflog_old) {
+		pr_err("perflog: failed to allocate buffer for old log\n");
+		return;
+	}
+
+	hdr = perflog_old;
+	*hdr = *perflog_hdr;
+	out = (struct perflog_entry *)(hdr + 1);
+	for (seq = first; seq <= last; seq++) {
+		struct perflog_entry *e = &perflog_ring[seq & perflog_mask];
+
+		if (e->seq == seq)
+			*out++ = *e;
+	}
+	perflog_old_size = (void *)out - perflog_old;
+	hdr->nr = (perflog_old_size - sizeof(*hdr)) / sizeof(*out);
+}
+
+static int perflog_pstore_open(struct pstore_info *psi)
+{
+	perflog_old_read = false;
+	return 0;
+}
+
+static int perflog_pstore_close(struct pstore_info *psi)
+{
+	return 0;
+}
+
+static ssize_t perflog_pstore_read(u64 *id, enum pstore_type_id *type,
+				   struct timespec *time,
+				   struct pstore_info *psi)
+{
+	if (perflog_old_read || !perflog_old)
+		return 0;
+	perflog_old_read = true;
+
+	*id = ((struct perflog_header *)perflog_old)->boot;
+	*type = PSTORE_TYPE_PERF;
+	time->tv_sec = 0;
+	time->tv_nsec = 0;
+	memcpy(psi->buf, perflog_old, perflog_old_size);
+	return perflog_old_size;
+}
+
+/* The kernel log is kept by ram_console; nothing is stored for pstore */
+static u64 perflog_pstore_write(enum pstore_type_id type, unsigned int part,
+				size_t size, struct pstore_info *psi)
+{
+	return 0;
+}
+
+static int perflog_pstore_erase(enum pstore_type_id type, u64 id,
+				struct pstore_info *psi)
+{
+	if (type != PSTORE_TYPE_PERF)
+		return -EINVAL;
+	kfree(perflog_old);
+	perflog_old = NULL;
+	perflog_old_size = 0;
+	return 0;
+}
+
+static struct pstore_info perflog_pstore = {
+	.owner		= THIS_MODULE,
+	.name		= "perflog",
+	.buf_mutex	= __MUTEX_INITIALIZER(perflog_pstore.buf_mutex),
+	.open		= perflog_pstore_open,
+	.close		= perflog_pstore_close,
+	.read		= perflog_pstore_read,
+	.write		= perflog_pstore_write,
+	.erase		= perflog_pstore_erase,
+};
+
+static int __init perflog_probe(struct platform_device *pdev)
+{
+	struct resource *res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	size_t size;
+	void *buffer;
+	u32 nr;
+	int err;
+
+	if (!res) {
+		dev_err(&pdev->dev, "no memory resource\n");
+		return -ENXIO;
+	}
+	size = resource_size(res);
+	if (size < sizeof(*perflog_hdr) + 2 * sizeof(*perflog_ring)) {
+		dev_err(&pdev->dev, "buffer too small, %zu bytes\n", size);
+		return -EINVAL;
+	}
+	nr = rounddown_pow_of_two((size - sizeof(*perflog_hdr)) /
+				  sizeof(*perflog_ring));
+
+	buffer = ioremap(res->start, size);
+	if (!buffer) {
+		dev_err(&pdev->dev, "failed to map memory\n");
+		return -ENOMEM;
+	}
+	perflog_hdr = buffer;
+	perflog_ring = buffer + sizeof(*perflog_hdr);
+	perflog_mask = nr - 1;
+
+	if (perflog_hdr->sig == PERFLOG_SIG && perflog_hdr->nr == nr) {
+		perflog_save_old();
+		perflog_hdr->boot++;
+	} else {
+		perflog_hdr->boot = 0;
+	}
+	memset(perflog_ring, 0, nr * sizeof(*perflog_ring));
+	perflog_hdr->sig = PERFLOG_SIG;
+	perflog_hdr->nr = nr;
+	perflog_recording = 1;
+
+	dev_info(&pdev->dev, "%u entries at %08lx, previous boot %zu bytes\n",
+		 nr, (unsigned long)res->start, perflog_old_size);
+
+	perflog_pstore.bufsize = max_t(size_t, perflog_old_size, PAGE_SIZE);
+	perflog_pstore.buf = kmalloc(perflog_pstore.bufsize, GFP_KERNEL);
+	if (!perflog_pstore.buf)
+		return 0;
+	err = pstore_register(&perflog_pstore);
+	if (err) {
+		dev_info(&pdev->dev, "pstore not available (%d)\n", err);
+		kfree(perflog_pstore.buf);
+		perflog_pstore.buf = NULL;
+	}
+	return 0;
+}
+
+static struct platform_driver perflog_driver = {
+	.driver		= {
+		.name	= "perflog",
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int __init perflog_init(void)
+{
+	return platform_driver_probe(&perflog_driver, perflog_probe);
+}
+postcore_initcall(perflog_init);
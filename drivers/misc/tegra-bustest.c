@@ -0,0 +1,686 @@
+/*
+ * drivers/misc/tegra-bustest.c
+ *
+ * Throughput and latency benchmark for the Tegra SPI, I2C, high speed UART
+ * and APB DMA paths
+ *
+ * Copyright (c) 2012, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Runs a fixed number of transfers for each of the configured sizes on each
+ * selected bus and records the latency of every transfer. Results keep the
+ * minimum, median, 90th and 99th percentile and maximum latency, the
+ * throughput, the CPU time of the test thread and the overall CPU busy
+ * share while the test ran.
+ *
+ *   echo spi,i2c > /sys/kernel/debug/tegra_bustest/run
+ *   cat /sys/kernel/debug/tegra_bustest/results
+ *
+ * spi:  full duplex transfers to the device at spi_bus.spi_cs; a dummy one
+ *       is created when the chip select is free. With spi_verify the data
+ *       is checked, which needs MOSI looped back to MISO.
+ * i2c:  register reads of the given size from i2c_addr on i2c_bus, the
+ *       register pointer i2c_reg written first with a repeated start.
+ * uart: writes to /dev/ttyHS<uart_port> in raw mode, read back through
+ *       the controller's internal loopback unless uart_loop is cleared.
+ * dma:  APB DMA reads of a fixed APB register into memory, the same kind
+ *       of request the drivers above and apbio queue.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel_stat.h>
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/fs.h>
+#include <linux/tty.h>
+#include <linux/termios.h>
+#include <linux/i2c.h>
+#include <linux/spi/spi.h>
+
+#include <mach/dma.h>
+#include <mach/iomap.h>
+
+#define BUSTEST_MAX_SIZES	8
+#define BUSTEST_MAX_ITER	4096
+#define BUSTEST_MAX_RESULTS	(4 * BUSTEST_MAX_SIZES)
+#define BUSTEST_BUF_SIZE	PAGE_SIZE
+
+static unsigned int sizes[BUSTEST_MAX_SIZES] = { 4, 64, 1024, 4096 };
+static unsigned int nr_sizes = 4;
+module_param_array(sizes, uint, &nr_sizes, 0644);
+MODULE_PARM_DESC(sizes, "Transfer sizes in bytes, up to a page each");
+
+static unsigned int iterations = 200;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Transfers per size (default: 200)");
+
+static unsigned int timeout = 3000;
+module_param(timeout, uint, 0644);
+MODULE_PARM_DESC(timeout, "Transfer timeout in msec (default: 3000)");
+
+static int spi_bus = -1;
+module_param(spi_bus, int, 0644);
+MODULE_PARM_DESC(spi_bus, "SPI bus number to test");
+
+static unsigned int spi_cs;
+module_param(spi_cs, uint, 0644);
+MODULE_PARM_DESC(spi_cs, "SPI chip select to test");
+
+static unsigned int spi_hz = 12000000;
+module_param(spi_hz, uint, 0644);
+MODULE_PARM_DESC(spi_hz, "SPI clock for a created dummy device");
+
+static bool spi_verify;
+module_param(spi_verify, bool, 0644);
+MODULE_PARM_DESC(spi_verify, "Check SPI data, MOSI looped to MISO");
+
+static int i2c_bus = -1;
+module_param(i2c_bus, int, 0644);
+MODULE_PARM_DESC(i2c_bus, "I2C adapter number to test");
+
+static unsigned int i2c_addr;
+module_param(i2c_addr, uint, 0644);
+MODULE_PARM_DESC(i2c_addr, "7-bit address of the I2C device to read");
+
+static unsigned int i2c_reg;
+module_param(i2c_reg, uint, 0644);
+MODULE_PARM_DESC(i2c_reg, "Register the I2C reads start at");
+
+static int uart_port = -1;
+module_param(uart_port, int, 0644);
+MODULE_PARM_DESC(uart_port, "ttyHS port number to test");
+
+static unsigned int uart_baud = 3000000;
+module_param(uart_baud, uint, 0644);
+MODULE_PARM_DESC(uart_baud, "UART baud rate (default: 3000000)");
+
+static bool uart_loop = true;
+module_param(uart_loop, bool, 0644);
+MODULE_PARM_DESC(uart_loop, "Use the UART internal loopback (default: Y)");
+
+struct bustest_result {
+	char name[16];
+	unsigned int size;
+	unsigned int done;
+	unsigned int failed;
+	int err;
+	u32 min_us;
+	u32 p50_us;
+	u32 p90_us;
+	u32 p99_us;
+	u32 max_us;
+	u64 bytes_per_sec;
+	u32 cpu_permille;	/* of one CPU, the test thread */
+	u32 busy_permille;	/* of all online CPUs */
+};
+
+struct bustest {
+	const char *name;
+	int (*setup)(struct bustest *bt);
+	int (*xfer)(struct bustest *bt, unsigned int len);
+	void (*teardown)(struct bustest *bt);
+	char dev_name[16];
+	void *priv;
+	bool created;
+	u8 *tx;
+	u8 *rx;
+};
+
+static DEFINE_MUTEX(bustest_lock);
+static struct bustest_result results[BUSTEST_MAX_RESULTS];
+static unsigned int nr_results;
+static u32 *latency;
+
+static void bustest_fill(u8 *buf, unsigned int len, unsigned int seed)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (u8)(seed + i * 7);
+}
+
+/* SPI */
+
+static int bustest_spi_setup(struct bustest *bt)
+{
+	struct spi_board_info info = {
+		.modalias = "tegra-bustest",
+		.max_speed_hz = spi_hz,
+	};
+	struct spi_master *master;
+	struct spi_device *spi;
+	struct device *dev;
+	char name[16];
+
+	if (spi_bus < 0)
+		return -ENODEV;
+
+	snprintf(name, sizeof(name), "spi%d.%u", spi_bus, spi_cs);
+	dev = bus_find_device_by_name(&spi_bus_type, NULL, name);
+	if (dev) {
+		/* keeps the reference bus_find_device_by_name() took */
+		spi = to_spi_device(dev);
+	} else {
+		master = spi_busnum_to_master(spi_bus);
+		if (!master)
+			return -ENODEV;
+		info.bus_num = spi_bus;
+		info.chip_select = spi_cs;
+		spi = spi_new_device(master, &info);
+		put_device(&master->dev);
+		if (!spi)
+			return -EBUSY;
+		get_device(&spi->dev);
+		bt->created = true;
+	}
+
+	strlcpy(bt->dev_name, name, sizeof(bt->dev_name));
+	bt->priv = spi;
+	return 0;
+}
+
+static int bustest_spi_xfer(struct bustest *bt, unsigned int len)
+{
+	struct spi_transfer t = {
+		.tx_buf = bt->tx,
+		.rx_buf = bt->rx,
+		.len = len,
+	};
+	struct spi_message m;
+	int ret;
+
+	spi_message_init(&m);
+	spi_message_add_tail(&t, &m);
+	ret = spi_sync(bt->priv, &m);
+	if (ret)
+		return ret;
+	if (spi_verify && memcmp(bt->tx, bt->rx, len))
+		return -EIO;
+	return 0;
+}
+
+static void bustest_spi_teardown(struct bustest *bt)
+{
+	struct spi_device *spi = bt->priv;
+
+	put_device(&spi->dev);
+	if (bt->created)
+		spi_unregister_device(spi);
+	bt->created = false;
+}
+
+/* I2C */
+
+static int bustest_i2c_setup(struct bustest *bt)
+{
+	struct i2c_adapter *adap;
+
+	if (i2c_bus < 0 || !i2c_addr)
+		return -ENODEV;
+
+	adap = i2c_get_adapter(i2c_bus);
+	if (!adap)
+		return -ENODEV;
+
+	snprintf(bt->dev_name, sizeof(bt->dev_name), "i2c-%d:%02x",
+		 i2c_bus, i2c_addr);
+	bt->priv = adap;
+	return 0;
+}
+
+static int bustest_i2c_xfer(struct bustest *bt, unsigned int len)
+{
+	u8 reg = i2c_reg;
+	struct i2c_msg msgs[2] = {
+		{ .addr = i2c_addr, .flags = 0, .len = 1, .buf = &reg },
+		{ .addr = i2c_addr, .flags = I2C_M_RD, .len = len,
+		  .buf = bt->rx },
+	};
+	int ret;
+
+	ret = i2c_transfer(bt->priv, msgs, ARRAY_SIZE(msgs));
+	if (ret < 0)
+		return ret;
+	return ret == ARRAY_SIZE(msgs) ? 0 : -EIO;
+}
+
+static void bustest_i2c_teardown(struct bustest *bt)
+{
+	i2c_put_adapter(bt->priv);
+}
+
+/* High speed UART, through the tty like any user would */
+
+static long bustest_tty_ioctl(struct file *filp, unsigned int cmd, void *arg)
+{
+	mm_segment_t fs = get_fs();
+	long ret;
+
+	set_fs(KERNEL_DS);
+	ret = filp->f_op->unlocked_ioctl(filp, cmd, (unsigned long)arg);
+	set_fs(fs);
+	return ret;
+}
+
+static int bustest_uart_setup(struct bustest *bt)
+{
+	struct termios2 tio;
+	struct file *filp;
+	char path[24];
+	int mctrl = TIOCM_LOOP;
+	long ret;
+
+	if (uart_port < 0)
+		return -ENODEV;
+
+	snprintf(path, sizeof(path), "/dev/ttyHS%d", uart_port);
+	filp = filp_open(path, O_RDWR | O_NOCTTY, 0);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+	if (!filp->f_op || !filp->f_op->unlocked_ioctl) {
+		filp_close(filp, NULL);
+		return -ENOTTY;
+	}
+
+	ret = bustest_tty_ioctl(filp, TCGETS2, &tio);
+	if (!ret) {
+		/* raw, no flow control, reads give up after 0.1s of silence */
+		tio.c_iflag = 0;
+		tio.c_oflag = 0;
+		tio.c_lflag = 0;
+		tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+		tio.c_ispeed = uart_baud;
+		tio.c_ospeed = uart_baud;
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 1;
+		ret = bustest_tty_ioctl(filp, TCSETS2, &tio);
+	}
+	if (!ret)
+		ret = bustest_tty_ioctl(filp, uart_loop ? TIOCMBIS : TIOCMBIC,
+					&mctrl);
+	if (ret) {
+		filp_close(filp, NULL);
+		return ret;
+	}
+
+	strlcpy(bt->dev_name, path + 5, sizeof(bt->dev_name));
+	bt->priv = filp;
+	return 0;
+}
+
+static int bustest_uart_xfer(struct bustest *bt, unsigned int len)
+{
+	struct file *filp = bt->priv;
+	unsigned long end = jiffies + msecs_to_jiffies(timeout);
+	mm_segment_t fs = get_fs();
+	unsigned int got = 0;
+	loff_t pos = 0;
+	ssize_t n;
+	int ret = 0;
+
+	set_fs(KERNEL_DS);
+	n = vfs_write(filp, (const char __user *)bt->tx, len, &pos);
+	if (n != len) {
+		ret = n < 0 ? n : -EIO;
+		goto out;
+	}
+	while (got < len) {
+		n = vfs_read(filp, (char __user *)bt->rx + got, len - got,
+			     &pos);
+		if (n < 0) {
+			ret = n;
+			goto out;
+		}
+		got += n;
+		if (got < len && time_after(jiffies, end)) {
+			ret = -ETIMEDOUT;
+			goto out;
+		}
+	}
+	if (uart_loop && memcmp(bt->tx, bt->rx, len))
+		ret = -EIO;
+out:
+	set_fs(fs);
+	return ret;
+}
+
+static void bustest_uart_teardown(struct bustest *bt)
+{
+	int mctrl = TIOCM_LOOP;
+
+	if (uart_loop)
+		bustest_tty_ioctl(bt->priv, TIOCMBIC, &mctrl);
+	filp_close(bt->priv, NULL);
+}
+
+/* APB DMA */
+
+struct bustest_dma {
+	struct tegra_dma_channel *chan;
+	struct tegra_dma_req req;
+	struct completion done;
+	void *buf;
+	dma_addr_t buf_phys;
+};
+
+static void bustest_dma_complete(struct tegra_dma_req *req)
+{
+	struct bustest_dma *d = req->dev;
+
+	complete(&d->done);
+}
+
+static int bustest_dma_setup(struct bustest *bt)
+{
+	struct bustest_dma *d;
+
+	d = kzalloc(sizeof(*d), GFP_KERNEL);
+	if (!d)
+		return -ENOMEM;
+
+	d->chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_ONESHOT,
+					     "bustest");
+	if (!d->chan) {
+		kfree(d);
+		return -EBUSY;
+	}
+	d->buf = dma_alloc_coherent(NULL, BUSTEST_BUF_SIZE, &d->buf_phys,
+				    GFP_KERNEL);
+	if (!d->buf) {
+		tegra_dma_free_channel(d->chan);
+		kfree(d);
+		return -ENOMEM;
+	}
+	init_completion(&d->done);
+
+	strlcpy(bt->dev_name, "apbdma", sizeof(bt->dev_name));
+	bt->priv = d;
+	return 0;
+}
+
+static int bustest_dma_xfer(struct bustest *bt, unsigned int len)
+{
+	struct bustest_dma *d = bt->priv;
+	struct tegra_dma_req *req = &d->req;
+	int ret;
+
+	memset(req, 0, sizeof(*req));
+	req->complete = bustest_dma_complete;
+	req->dev = d;
+	req->to_memory = 1;
+	/* the chip id register: readable, side effect free, always there */
+	req->source_addr = TEGRA_APB_MISC_BASE + 0x804;
+	req->source_wrap = 4;
+	req->source_bus_width = 32;
+	req->dest_addr = d->buf_phys;
+	req->dest_wrap = 0;
+	req->dest_bus_width = 32;
+	req->req_sel = 0;
+	req->size = ALIGN(len, 4);
+
+	INIT_COMPLETION(d->done);
+	ret = tegra_dma_enqueue_req(d->chan, req);
+	if (ret)
+		return ret;
+	if (!wait_for_completion_timeout(&d->done,
+					 msecs_to_jiffies(timeout))) {
+		tegra_dma_dequeue_req(d->chan, req);
+		return -ETIMEDOUT;
+	}
+	return req->status == TEGRA_DMA_REQ_SUCCESS ? 0 : -EIO;
+}
+
+static void bustest_dma_teardown(struct bustest *bt)
+{
+	struct bustest_dma *d = bt->priv;
+
+	tegra_dma_free_channel(d->chan);
+	dma_free_coherent(NULL, BUSTEST_BUF_SIZE, d->buf, d->buf_phys);
+	kfree(d);
+}
+
+static struct bustest bustests[] = {
+	{ "spi", bustest_spi_setup, bustest_spi_xfer, bustest_spi_teardown },
+	{ "i2c", bustest_i2c_setup, bustest_i2c_xfer, bustest_i2c_teardown },
+	{ "uart", bustest_uart_setup, bustest_uart_xfer,
+	  bustest_uart_teardown },
+	{ "dma", bustest_dma_setup, bustest_dma_xfer, bustest_dma_teardown },
+};
+
+static int bustest_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a;
+	u32 y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u64 bustest_idle_jiffies(void)
+{
+	u64 idle = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		idle += cputime64_to_jiffies64(kstat_cpu(cpu).cpustat.idle) +
+			cputime64_to_jiffies64(kstat_cpu(cpu).cpustat.iowait);
+	return idle;
+}
+
+static void bustest_run_size(struct bustest *bt, unsigned int size,
+			     struct bustest_result *r)
+{
+	unsigned int iter = min(iterations, (unsigned int)BUSTEST_MAX_ITER);
+	u64 cpu_start, idle_start, idle;
+	unsigned long jif_start, jif;
+	ktime_t start, t0;
+	s64 wall_ns;
+	unsigned int i;
+	int ret;
+
+	memset(r, 0, sizeof(*r));
+	snprintf(r->name, sizeof(r->name), "%s", bt->dev_name);
+	r->size = size;
+
+	cpu_start = current->se.sum_exec_runtime;
+	idle_start = bustest_idle_jiffies();
+	jif_start = jiffies;
+	start = ktime_get();
+
+	for (i = 0; i < iter; i++) {
+		bustest_fill(bt->tx, size, i);
+		t0 = ktime_get();
+		ret = bt->xfer(bt, size);
+		latency[r->done] = (u32)ktime_us_delta(ktime_get(), t0);
+		if (ret) {
+			r->failed++;
+			r->err = ret;
+			/* a missing device will not show up within the run */
+			if (ret == -ENODEV || ret == -ETIMEDOUT)
+				break;
+			continue;
+		}
+		r->done++;
+	}
+
+	wall_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	jif = jiffies - jif_start;
+	idle = bustest_idle_jiffies() - idle_start;
+
+	if (r->done) {
+		sort(latency, r->done, sizeof(u32), bustest_cmp_u32, NULL);
+		r->min_us = latency[0];
+		r->p50_us = latency[r->done / 2];
+		r->p90_us = latency[(r->done * 9) / 10];
+		r->p99_us = latency[(r->done * 99) / 100];
+		r->max_us = latency[r->done - 1];
+	}
+	if (wall_ns > 0) {
+		r->bytes_per_sec = div64_u64((u64)r->done * size *
+					     NSEC_PER_SEC, wall_ns);
+		r->cpu_permille = div64_u64((current->se.sum_exec_runtime -
+					     cpu_start) * 1000, wall_ns);
+	}
+	if (jif) {
+		u64 total = (u64)jif * num_online_cpus();
+
+		r->busy_permille = idle < total ?
+			div64_u64((total - idle) * 1000, total) : 0;
+	}
+}
+
+static int bustest_run(struct bustest *bt)
+{
+	unsigned int i;
+	int ret;
+
+	ret = bt->setup(bt);
+	if (ret) {
+		pr_info("tegra_bustest: %s: not run, err %d\n", bt->name, ret);
+		return ret;
+	}
+
+	for (i = 0; i < nr_sizes && nr_results < BUSTEST_MAX_RESULTS; i++) {
+		unsigned int size = min_t(unsigned int, sizes[i],
+					  BUSTEST_BUF_SIZE);
+
+		if (!size)
+			continue;
+		bustest_run_size(bt, size, &results[nr_results]);
+		nr_results++;
+	}
+
+	bt->teardown(bt);
+	bt->priv = NULL;
+	return 0;
+}
+
+static ssize_t bustest_run_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	char buf[32];
+	bool all;
+	int i;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	all = sysfs_streq(buf, "all");
+
+	mutex_lock(&bustest_lock);
+	nr_results = 0;
+	for (i = 0; i < ARRAY_SIZE(bustests); i++) {
+		struct bustest *bt = &bustests[i];
+
+		if (!all && !strstr(buf, bt->name))
+			continue;
+		bt->tx = kmalloc(BUSTEST_BUF_SIZE, GFP_KERNEL);
+		bt->rx = kmalloc(BUSTEST_BUF_SIZE, GFP_KERNEL);
+		if (bt->tx && bt->rx)
+			bustest_run(bt);
+		kfree(bt->tx);
+		kfree(bt->rx);
+		bt->tx = bt->rx = NULL;
+	}
+	mutex_unlock(&bustest_lock);
+
+	return count;
+}
+
+static const struct file_operations bustest_run_fops = {
+	.write		= bustest_run_write,
+	.llseek		= noop_llseek,
+};
+
+static int bustest_results_show(struct seq_file *s, void *unused)
+{
+	struct bustest_result *r;
+	unsigned int i;
+
+	seq_printf(s, "%-12s %6s %6s %4s %7s %7s %7s %7s %7s %10s %5s %5s\n",
+		   "device", "size", "done", "fail", "min_us", "p50_us",
+		   "p90_us", "p99_us", "max_us", "KB/s", "cpu%", "busy%");
+
+	mutex_lock(&bustest_lock);
+	for (i = 0; i < nr_results; i++) {
+		r = &results[i];
+		seq_printf(s, "%-12s %6u %6u %4u %7u %7u %7u %7u %7u %10llu "
+			   "%3u.%u %3u.%u",
+			   r->name, r->size, r->done, r->failed, r->min_us,
+			   r->p50_us, r->p90_us, r->p99_us, r->max_us,
+			   div_u64(r->bytes_per_sec, 1024),
+			   r->cpu_permille / 10, r->cpu_permille % 10,
+			   r->busy_permille / 10, r->busy_permille % 10);
+		if (r->failed)
+			seq_printf(s, "  err %d", r->err);
+		seq_printf(s, "\n");
+	}
+	mutex_unlock(&bustest_lock);
+	return 0;
+}
+
+static int bustest_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bustest_results_show, inode->i_private);
+}
+
+static const struct file_operations bustest_results_fops = {
+	.open		= bustest_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *bustest_dir;
+
+static int __init tegra_bustest_init(void)
+{
+	latency = vmalloc(BUSTEST_MAX_ITER * sizeof(*latency));
+	if (!latency)
+		return -ENOMEM;
+
+	bustest_dir = debugfs_create_dir("tegra_bustest", NULL);
+	if (!bustest_dir)
+		goto fail;
+	if (!debugfs_create_file("run", S_IWUSR, bustest_dir, NULL,
+				 &bustest_run_fops))
+		goto fail;
+	if (!debugfs_create_file("results", S_IRUGO, bustest_dir, NULL,
+				 &bustest_results_fops))
+		goto fail;
+	return 0;
+
+fail:
+	debugfs_remove_recursive(bustest_dir);
+	vfree(latency);
+	return -ENOMEM;
+}
+module_init(tegra_bustest_init);
+
+static void __exit tegra_bustest_exit(void)
+{
+	debugfs_remove_recursive(bustest_dir);
+	vfree(latency);
+}
+module_exit(tegra_bustest_exit);
+
+MODULE_DESCRIPTION("Tegra SPI, I2C, UART and APB DMA benchmark");
+MODULE_LICENSE("GPL v2");
@@ -30,6 +30,11 @@
 #include <linux/crypto.h>
 #include <linux/scatterlist.h>
 #include <linux/uaccess.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
 #include <crypto/rng.h>
 #include <crypto/hash.h>
 #include <mach/hardware.h>
@@ -37,7 +42,11 @@
 #include "tegra-cryptodev.h"
 
 #define NBUFS 2
-#define XBUFSIZE 8
+
+/* pages per hardware request, within the SE linked list limit */
+#define ZC_CHUNK_PAGES	32
+/* async requests per open file that are running or not yet read */
+#define MAX_ASYNC_JOBS	8
 
 struct tegra_crypto_ctx {
 	struct crypto_ablkcipher *ecb_tfm;
@@ -48,6 +57,11 @@ struct tegra_crypto_ctx {
 	struct crypto_rng *rng;
 	u8 seed[TEGRA_CRYPTO_RNG_SEED_SIZE];
 	int use_ssk;
+	spinlock_t lock;	/* protects the async job state below */
+	struct list_head done;	/* finished async jobs, oldest first */
+	wait_queue_head_t waitq;	/* woken when an async job finishes */
+	int jobs;	/* async jobs running or waiting to be read */
+	int running;	/* async jobs still running */
 };
 
 struct tegra_crypto_completion {
@@ -55,6 +69,31 @@ struct tegra_crypto_completion {
 	int req_err;
 };
 
+/* user pages pinned for a zero copy request */
+struct tegra_crypt_zc {
+	struct page **src_pages;
+	struct page **dst_pages;	/* src_pages in place, or NULL */
+	int nr_src;	/* pages pinned in src_pages */
+	int nr_dst;	/* pages pinned in dst_pages, if separate */
+	int nr_pages;
+	unsigned int offset;	/* of the data in the first page */
+	struct scatterlist in_sg[ZC_CHUNK_PAGES];
+	struct scatterlist out_sg[ZC_CHUNK_PAGES];
+};
+
+struct tegra_crypt_job {
+	struct list_head node;	/* in ctx->done once finished */
+	struct work_struct work;
+	struct tegra_crypto_ctx *ctx;
+	struct tegra_crypt_async_req areq;
+	struct crypto_ablkcipher *tfm;	/* own tfm, so its key stays put */
+	struct ablkcipher_request *req;
+	struct tegra_crypt_zc *zc;
+	int status;
+};
+
+static struct workqueue_struct *tegra_crypto_wq;
+
 static int alloc_bufs(unsigned long *buf[NBUFS])
 {
 	int i;
@@ -139,6 +178,10 @@ static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 		goto fail_rng;
 	}
 
+	spin_lock_init(&ctx->lock);
+	INIT_LIST_HEAD(&ctx->done);
+	init_waitqueue_head(&ctx->waitq);
+
 	filp->private_data = ctx;
 	return ret;
 
@@ -159,9 +202,26 @@ fail_ecb:
 	return ret;
 }
 
+static bool tegra_crypt_jobs_idle(struct tegra_crypto_ctx *ctx)
+{
+	bool idle;
+
+	spin_lock(&ctx->lock);
+	idle = !ctx->running;
+	spin_unlock(&ctx->lock);
+
+	return idle;
+}
+
 static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 {
 	struct tegra_crypto_ctx *ctx = filp->private_data;
+	struct tegra_crypt_job *job, *tmp;
+
+	/* the pages of running jobs are still being written */
+	wait_event(ctx->waitq, tegra_crypt_jobs_idle(ctx));
+	list_for_each_entry_safe(job, tmp, &ctx->done, node)
+		kfree(job);
 
 	crypto_free_ablkcipher(ctx->ecb_tfm);
 	crypto_free_ablkcipher(ctx->cbc_tfm);
@@ -187,6 +247,238 @@ static void tegra_crypt_complete(struct crypto_async_request *req, int err)
 	}
 }
 
+static const char *tegra_crypt_alg_name(int op)
+{
+	if (op & TEGRA_CRYPTO_ECB)
+		return "ecb-aes-tegra";
+	if (op & TEGRA_CRYPTO_CBC)
+		return "cbc-aes-tegra";
+	if (tegra_get_chipid() == TEGRA_CHIPID_TEGRA2)
+		return NULL;
+	if (op & TEGRA_CRYPTO_OFB)
+		return "ofb-aes-tegra";
+	if (op & TEGRA_CRYPTO_CTR)
+		return "ctr-aes-tegra";
+	return NULL;
+}
+
+/*
+ * The engine walks source and destination scatterlists in lock step, so
+ * both buffers must split into the same page sized pieces, and each piece
+ * must be whole blocks.
+ */
+static bool tegra_crypt_zc_ok(struct tegra_crypt_req *crypt_req)
+{
+	unsigned long src = (unsigned long)crypt_req->plaintext;
+	unsigned long dst = (unsigned long)crypt_req->result;
+	unsigned long len = crypt_req->plaintext_sz;
+
+	if (!src || !dst || (crypt_req->plaintext_sz <= 0) ||
+		(len > TEGRA_CRYPTO_ZC_MAX_SIZE) || (len % AES_BLOCK_SIZE))
+		return false;
+
+	if (((src ^ dst) & ~PAGE_MASK) || (src % AES_BLOCK_SIZE))
+		return false;
+
+	/* in place is fine, a partial overlap is not */
+	if ((src != dst) && (src < dst + len) && (dst < src + len))
+		return false;
+
+	return true;
+}
+
+static void tegra_crypt_zc_unpin(struct tegra_crypt_zc *zc)
+{
+	int i;
+
+	for (i = 0; i < zc->nr_dst; i++) {
+		set_page_dirty_lock(zc->dst_pages[i]);
+		put_page(zc->dst_pages[i]);
+	}
+	for (i = 0; i < zc->nr_src; i++) {
+		if (zc->dst_pages == zc->src_pages)
+			set_page_dirty_lock(zc->src_pages[i]);
+		put_page(zc->src_pages[i]);
+	}
+
+	kfree(zc->src_pages);
+	kfree(zc);
+}
+
+/*
+ * Pin the @len bytes at @src, and at @dst unless it is NULL (read only)
+ * or equal to @src (in place).
+ */
+static struct tegra_crypt_zc *tegra_crypt_zc_pin(const u8 *src, u8 *dst,
+	unsigned long len)
+{
+	unsigned long start = (unsigned long)src & PAGE_MASK;
+	struct tegra_crypt_zc *zc;
+	int nr_arrays = (dst && (dst != src)) ? 2 : 1;
+
+	zc = kzalloc(sizeof(struct tegra_crypt_zc), GFP_KERNEL);
+	if (!zc)
+		return ERR_PTR(-ENOMEM);
+
+	zc->offset = (unsigned long)src & ~PAGE_MASK;
+	zc->nr_pages = PAGE_ALIGN(zc->offset + len) >> PAGE_SHIFT;
+	zc->src_pages = kcalloc(zc->nr_pages * nr_arrays,
+		sizeof(struct page *), GFP_KERNEL);
+	if (!zc->src_pages) {
+		kfree(zc);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	zc->nr_src = get_user_pages_fast(start, zc->nr_pages, dst == src,
+		zc->src_pages);
+	if (zc->nr_src < 0)
+		zc->nr_src = 0;
+	if (zc->nr_src != zc->nr_pages)
+		goto fault;
+
+	if (nr_arrays == 1) {
+		if (dst)
+			zc->dst_pages = zc->src_pages;
+		return zc;
+	}
+
+	zc->dst_pages = zc->src_pages + zc->nr_pages;
+	zc->nr_dst = get_user_pages_fast((unsigned long)dst & PAGE_MASK,
+		zc->nr_pages, 1, zc->dst_pages);
+	if (zc->nr_dst < 0)
+		zc->nr_dst = 0;
+	if (zc->nr_dst != zc->nr_pages)
+		goto fault;
+
+	return zc;
+
+fault:
+	tegra_crypt_zc_unpin(zc);
+	return ERR_PTR(-EFAULT);
+}
+
+/*
+ * Fill the scatterlists with up to ZC_CHUNK_PAGES pieces of the data from
+ * byte @pos of the first page up to @end, returning the bytes covered.
+ */
+static unsigned int tegra_crypt_zc_sg(struct tegra_crypt_zc *zc,
+	unsigned int pos, unsigned int end)
+{
+	int page = pos >> PAGE_SHIFT;
+	int i, n = min(zc->nr_pages - page, ZC_CHUNK_PAGES);
+	unsigned int off, len, chunk = 0;
+
+	sg_init_table(zc->in_sg, n);
+	if (zc->dst_pages)
+		sg_init_table(zc->out_sg, n);
+
+	for (i = 0; i < n; i++) {
+		off = (pos + chunk) & ~PAGE_MASK;
+		len = min_t(unsigned int, PAGE_SIZE - off, end - pos - chunk);
+		sg_set_page(&zc->in_sg[i], zc->src_pages[page + i], len, off);
+		if (zc->dst_pages)
+			sg_set_page(&zc->out_sg[i], zc->dst_pages[page + i],
+				len, off);
+		chunk += len;
+	}
+
+	return chunk;
+}
+
+/* copy out the block at byte @pos of the first page */
+static void tegra_crypt_zc_read_block(struct page **pages, unsigned int pos,
+	u8 *block)
+{
+	u8 *vaddr = kmap_atomic(pages[pos >> PAGE_SHIFT], KM_USER0);
+
+	memcpy(block, vaddr + (pos & ~PAGE_MASK), AES_BLOCK_SIZE);
+	kunmap_atomic(vaddr, KM_USER0);
+}
+
+/*
+ * The drivers leave the IV as it was, so work out the one that carries on
+ * after @nbytes, given the last input and output blocks.
+ */
+static void tegra_crypt_next_iv(struct tegra_crypt_req *crypt_req,
+	unsigned int nbytes, const u8 *last_in, const u8 *last_out)
+{
+	u8 *iv = (u8 *)crypt_req->iv;
+	u32 nblocks = nbytes / AES_BLOCK_SIZE;
+	int i;
+
+	if (crypt_req->op & TEGRA_CRYPTO_ECB)
+		return;
+
+	if (crypt_req->op & TEGRA_CRYPTO_CBC) {
+		memcpy(iv, crypt_req->encrypt ? last_out : last_in,
+			AES_BLOCK_SIZE);
+	} else if (crypt_req->op & TEGRA_CRYPTO_OFB) {
+		/* the last key stream block */
+		for (i = 0; i < AES_BLOCK_SIZE; i++)
+			iv[i] = last_in[i] ^ last_out[i];
+	} else if (crypt_req->op & TEGRA_CRYPTO_CTR) {
+		for (i = AES_BLOCK_SIZE - 1; i >= 0 && nblocks; i--) {
+			nblocks += iv[i];
+			iv[i] = nblocks & 0xff;
+			nblocks >>= 8;
+		}
+	}
+}
+
+/* run @req over the pinned pages, ZC_CHUNK_PAGES at a time */
+static int tegra_crypt_zc_process(struct ablkcipher_request *req,
+	struct tegra_crypt_req *crypt_req, struct tegra_crypt_zc *zc)
+{
+	struct tegra_crypto_completion tcrypt_complete;
+	unsigned int pos = zc->offset;
+	unsigned int end = zc->offset + crypt_req->plaintext_sz;
+	unsigned int chunk;
+	u8 last_in[AES_BLOCK_SIZE], last_out[AES_BLOCK_SIZE];
+	int ret;
+
+	init_completion(&tcrypt_complete.restart);
+	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypt_complete, &tcrypt_complete);
+
+	while (pos < end) {
+		chunk = tegra_crypt_zc_sg(zc, pos, end);
+
+		/* in place, the input is gone once the request is done */
+		tegra_crypt_zc_read_block(zc->src_pages,
+			pos + chunk - AES_BLOCK_SIZE, last_in);
+
+		ablkcipher_request_set_crypt(req, zc->in_sg, zc->out_sg,
+			chunk, crypt_req->iv);
+
+		INIT_COMPLETION(tcrypt_complete.restart);
+		tcrypt_complete.req_err = 0;
+		ret = crypt_req->encrypt ?
+			crypto_ablkcipher_encrypt(req) :
+			crypto_ablkcipher_decrypt(req);
+
+		/*
+		 * not interruptible: the engine is writing to the pages, which
+		 * have to stay pinned until it is done
+		 */
+		if ((ret == -EINPROGRESS) || (ret == -EBUSY)) {
+			wait_for_completion(&tcrypt_complete.restart);
+			ret = tcrypt_complete.req_err;
+		}
+		if (ret < 0) {
+			pr_debug("%scrypt failed (%d)\n",
+				crypt_req->encrypt ? "en" : "de", ret);
+			return ret;
+		}
+
+		tegra_crypt_zc_read_block(zc->dst_pages,
+			pos + chunk - AES_BLOCK_SIZE, last_out);
+		tegra_crypt_next_iv(crypt_req, chunk, last_in, last_out);
+		pos += chunk;
+	}
+
+	return 0;
+}
+
 static int process_crypt_req(struct tegra_crypto_ctx *ctx, struct tegra_crypt_req *crypt_req)
 {
 	struct crypto_ablkcipher *tfm;
@@ -198,6 +490,7 @@ static int process_crypt_req(struct tegra_crypto_ctx *ctx, struct tegra_crypt_re
 	unsigned long total = 0;
 	const u8 *key = NULL;
 	struct tegra_crypto_completion tcrypt_complete;
+	struct tegra_crypt_zc *zc;
 
 	if (crypt_req->op & TEGRA_CRYPTO_ECB) {
 		req = ablkcipher_request_alloc(ctx->ecb_tfm, GFP_KERNEL);
@@ -236,6 +529,19 @@ static int process_crypt_req(struct tegra_crypto_ctx *ctx, struct tegra_crypt_re
 		goto process_req_out;
 	}
 
+	if ((crypt_req->op & TEGRA_CRYPTO_ZERO_COPY) &&
+		tegra_crypt_zc_ok(crypt_req)) {
+		zc = tegra_crypt_zc_pin(crypt_req->plaintext,
+			crypt_req->result, crypt_req->plaintext_sz);
+		if (IS_ERR(zc)) {
+			ret = PTR_ERR(zc);
+			goto process_req_out;
+		}
+		ret = tegra_crypt_zc_process(req, crypt_req, zc);
+		tegra_crypt_zc_unpin(zc);
+		goto process_req_out;
+	}
+
 	ret = alloc_bufs(xbuf);
 	if (ret < 0) {
 		pr_err("alloc_bufs failed");
@@ -303,14 +609,185 @@ process_req_out:
 	return ret;
 }
 
+static void tegra_crypt_job_free(struct tegra_crypt_job *job)
+{
+	if (job->zc)
+		tegra_crypt_zc_unpin(job->zc);
+	if (job->req)
+		ablkcipher_request_free(job->req);
+	if (job->tfm)
+		crypto_free_ablkcipher(job->tfm);
+	job->zc = NULL;
+	job->req = NULL;
+	job->tfm = NULL;
+}
+
+static void tegra_crypt_job_work(struct work_struct *work)
+{
+	struct tegra_crypt_job *job =
+		container_of(work, struct tegra_crypt_job, work);
+	struct tegra_crypto_ctx *ctx = job->ctx;
+
+	job->status = tegra_crypt_zc_process(job->req, &job->areq.req,
+		job->zc);
+	tegra_crypt_job_free(job);
+
+	/* wake under the lock, release() may free ctx once running is 0 */
+	spin_lock(&ctx->lock);
+	list_add_tail(&job->node, &ctx->done);
+	ctx->running--;
+	wake_up(&ctx->waitq);
+	spin_unlock(&ctx->lock);
+}
+
+/*
+ * Pin the pages of an async request and queue it.  Each job gets its own
+ * tfm, so that a request queued later with another key, or a synchronous
+ * one meanwhile, cannot change the key under it.
+ */
+static int tegra_crypt_submit(struct tegra_crypto_ctx *ctx,
+	void __user *arg)
+{
+	struct tegra_crypt_job *job;
+	struct tegra_crypt_req *crypt_req;
+	const char *name;
+	const u8 *key = NULL;
+	int ret;
+
+	job = kzalloc(sizeof(struct tegra_crypt_job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	if (copy_from_user(&job->areq, arg, sizeof(job->areq))) {
+		ret = -EFAULT;
+		goto fail;
+	}
+	crypt_req = &job->areq.req;
+
+	name = tegra_crypt_alg_name(crypt_req->op);
+	if (!name || !tegra_crypt_zc_ok(crypt_req) ||
+		(crypt_req->keylen < 0) ||
+		(crypt_req->keylen > AES_MAX_KEY_SIZE)) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	job->tfm = crypto_alloc_ablkcipher(name,
+		CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
+	if (IS_ERR(job->tfm)) {
+		ret = PTR_ERR(job->tfm);
+		job->tfm = NULL;
+		goto fail;
+	}
+
+	if (!ctx->use_ssk)
+		key = crypt_req->key;
+	ret = crypto_ablkcipher_setkey(job->tfm, key, crypt_req->keylen);
+	if (ret < 0)
+		goto fail;
+
+	job->req = ablkcipher_request_alloc(job->tfm, GFP_KERNEL);
+	if (!job->req) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	job->zc = tegra_crypt_zc_pin(crypt_req->plaintext, crypt_req->result,
+		crypt_req->plaintext_sz);
+	if (IS_ERR(job->zc)) {
+		ret = PTR_ERR(job->zc);
+		job->zc = NULL;
+		goto fail;
+	}
+
+	spin_lock(&ctx->lock);
+	if (ctx->jobs >= MAX_ASYNC_JOBS) {
+		spin_unlock(&ctx->lock);
+		ret = -EBUSY;
+		goto fail;
+	}
+	ctx->jobs++;
+	ctx->running++;
+	spin_unlock(&ctx->lock);
+
+	job->ctx = ctx;
+	INIT_WORK(&job->work, tegra_crypt_job_work);
+	queue_work(tegra_crypto_wq, &job->work);
+
+	return 0;
+
+fail:
+	tegra_crypt_job_free(job);
+	kfree(job);
+	return ret;
+}
+
+static ssize_t tegra_crypto_dev_read(struct file *filp, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	struct tegra_crypt_async_result result;
+	struct tegra_crypt_job *job;
+	ssize_t done = 0;
+	int ret;
+
+	if (count < sizeof(result))
+		return -EINVAL;
+
+	if (!(filp->f_flags & O_NONBLOCK)) {
+		ret = wait_event_interruptible(ctx->waitq,
+			!list_empty(&ctx->done));
+		if (ret)
+			return ret;
+	}
+
+	while (count - done >= sizeof(result)) {
+		spin_lock(&ctx->lock);
+		if (list_empty(&ctx->done)) {
+			spin_unlock(&ctx->lock);
+			break;
+		}
+		job = list_first_entry(&ctx->done, struct tegra_crypt_job,
+			node);
+		list_del(&job->node);
+		ctx->jobs--;
+		spin_unlock(&ctx->lock);
+
+		result.cookie = job->areq.cookie;
+		result.status = job->status;
+		kfree(job);
+
+		if (copy_to_user(buf + done, &result, sizeof(result)))
+			return done ? done : -EFAULT;
+		done += sizeof(result);
+	}
+
+	return done ? done : -EAGAIN;
+}
+
+static unsigned int tegra_crypto_dev_poll(struct file *filp, poll_table *wait)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &ctx->waitq, wait);
+
+	spin_lock(&ctx->lock);
+	if (!list_empty(&ctx->done))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock(&ctx->lock);
+
+	return mask;
+}
+
 static int sha_async_hash_op(struct ahash_request *req,
 				struct tegra_crypto_completion *tr,
 				int ret)
 {
+	/* not interruptible: the request reads from the pinned pages */
 	if (ret == -EINPROGRESS || ret == -EBUSY) {
-		ret = wait_for_completion_interruptible(&tr->restart);
-		if (!ret)
-			ret = tr->req_err;
+		wait_for_completion(&tr->restart);
+		ret = tr->req_err;
 		INIT_COMPLETION(tr->restart);
 	}
 	return ret;
@@ -320,12 +797,11 @@ static int tegra_crypto_sha(struct tegra_sha_req *sha_req)
 {
 
 	struct crypto_ahash *tfm;
-	struct scatterlist sg[1];
 	char result[64];
 	struct ahash_request *req;
 	struct tegra_crypto_completion sha_complete;
-	void *hash_buff;
-	unsigned long *xbuf[XBUFSIZE];
+	struct tegra_crypt_zc *zc = NULL;
+	unsigned int pos, end, chunk;
 	int ret = -ENOMEM;
 
 	tfm = crypto_alloc_ahash(sha_req->algo, 0, 0);
@@ -342,21 +818,29 @@ static int tegra_crypto_sha(struct tegra_sha_req *sha_req)
 		goto out_noreq;
 	}
 
-	ret = alloc_bufs(xbuf);
-	if (ret < 0) {
-		pr_err("alloc_bufs failed");
+	if ((sha_req->plaintext_sz < 0) ||
+		(sha_req->plaintext_sz > TEGRA_CRYPTO_ZC_MAX_SIZE)) {
+		ret = -EINVAL;
 		goto out_buf;
 	}
 
+	/* hash straight from the user pages */
+	if (sha_req->plaintext_sz) {
+		zc = tegra_crypt_zc_pin(sha_req->plaintext, NULL,
+			sha_req->plaintext_sz);
+		if (IS_ERR(zc)) {
+			ret = PTR_ERR(zc);
+			zc = NULL;
+			goto out_buf;
+		}
+	}
+
 	init_completion(&sha_complete.restart);
+	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypt_complete, &sha_complete);
 
 	memset(result, 0, 64);
 
-	hash_buff = xbuf[0];
-
-	memcpy(hash_buff, sha_req->plaintext, sha_req->plaintext_sz);
-	sg_init_one(&sg[0], hash_buff, sha_req->plaintext_sz);
-
 	if (sha_req->keylen) {
 		crypto_ahash_clear_flags(tfm, ~0);
 		ret = crypto_ahash_setkey(tfm, sha_req->key,
@@ -369,7 +853,7 @@ static int tegra_crypto_sha(struct tegra_sha_req *sha_req)
 		}
 	}
 
-	ahash_request_set_crypt(req, sg, result, sha_req->plaintext_sz);
+	ahash_request_set_crypt(req, NULL, result, 0);
 
 	ret = sha_async_hash_op(req, &sha_complete, crypto_ahash_init(req));
 	if (ret) {
@@ -378,11 +862,19 @@ static int tegra_crypto_sha(struct tegra_sha_req *sha_req)
 		goto out;
 	}
 
-	ret = sha_async_hash_op(req, &sha_complete, crypto_ahash_update(req));
-	if (ret) {
-		pr_err("alg: hash: update failed on "
-		       "for %s: ret=%d\n", sha_req->algo, -ret);
-		goto out;
+	pos = zc ? zc->offset : 0;
+	end = pos + sha_req->plaintext_sz;
+	while (pos < end) {
+		chunk = tegra_crypt_zc_sg(zc, pos, end);
+		ahash_request_set_crypt(req, zc->in_sg, result, chunk);
+		ret = sha_async_hash_op(req, &sha_complete,
+			crypto_ahash_update(req));
+		if (ret) {
+			pr_err("alg: hash: update failed on "
+			       "for %s: ret=%d\n", sha_req->algo, -ret);
+			goto out;
+		}
+		pos += chunk;
 	}
 
 	ret = sha_async_hash_op(req, &sha_complete, crypto_ahash_final(req));
@@ -398,7 +890,8 @@ static int tegra_crypto_sha(struct tegra_sha_req *sha_req)
 		goto out;
 
 out:
-	free_bufs(xbuf);
+	if (zc)
+		tegra_crypt_zc_unpin(zc);
 
 out_buf:
 	ahash_request_free(req);
@@ -436,6 +929,10 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 		ret = process_crypt_req(ctx, &crypt_req);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_PROCESS_REQ_ASYNC:
+		ret = tegra_crypt_submit(ctx, (void __user *)arg);
+		break;
+
 	case TEGRA_CRYPTO_IOCTL_SET_SEED:
 		if (copy_from_user(&rng_req, (void __user *)arg, sizeof(rng_req)))
 			return -EFAULT;
@@ -497,6 +994,8 @@ struct file_operations tegra_crypto_fops = {
 	.owner = THIS_MODULE,
 	.open = tegra_crypto_dev_open,
 	.release = tegra_crypto_dev_release,
+	.read = tegra_crypto_dev_read,
+	.poll = tegra_crypto_dev_poll,
 	.unlocked_ioctl = tegra_crypto_dev_ioctl,
 };
 
@@ -508,7 +1007,17 @@ struct miscdevice tegra_crypto_device = {
 
 static int __init tegra_crypto_dev_init(void)
 {
-	return misc_register(&tegra_crypto_device);
+	int ret;
+
+	tegra_crypto_wq = alloc_workqueue("tegra_cryptodev", WQ_UNBOUND, 0);
+	if (!tegra_crypto_wq)
+		return -ENOMEM;
+
+	ret = misc_register(&tegra_crypto_device);
+	if (ret)
+		destroy_workqueue(tegra_crypto_wq);
+
+	return ret;
 }
 
 late_initcall(tegra_crypto_dev_init);
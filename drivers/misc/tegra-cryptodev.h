@@ -29,6 +29,7 @@
 #define TEGRA_CRYPTO_IOCTL_SET_SEED	_IOWR(0x98, 102, int*)
 #define TEGRA_CRYPTO_IOCTL_GET_RANDOM	_IOWR(0x98, 103, int*)
 #define TEGRA_CRYPTO_IOCTL_GET_SHA	_IOWR(0x98, 104, int*)
+#define TEGRA_CRYPTO_IOCTL_PROCESS_REQ_ASYNC	_IOWR(0x98, 105, int*)
 
 #define TEGRA_CRYPTO_MAX_KEY_SIZE	AES_MAX_KEY_SIZE
 #define TEGRA_CRYPTO_IV_SIZE	AES_BLOCK_SIZE
@@ -46,6 +47,16 @@
 #define TEGRA_CRYPTO_CMAC	BIT(4)
 #define TEGRA_CRYPTO_RNG	BIT(5)
 
+/*
+ * or'ed into op: work on the user pages in place instead of copying them,
+ * when plaintext and result start at the same 16 byte aligned offset in
+ * a page and plaintext_sz is a multiple of the block size
+ */
+#define TEGRA_CRYPTO_ZERO_COPY	BIT(8)
+
+/* the largest request processed from pinned user pages */
+#define TEGRA_CRYPTO_ZC_MAX_SIZE	SZ_16M
+
 /* a pointer to this struct needs to be passed to:
  * TEGRA_CRYPTO_IOCTL_PROCESS_REQ
  */
@@ -71,6 +82,25 @@ struct tegra_rng_req {
 	int nbytes; /* random data length */
 };
 
+/* a pointer to this struct needs to be passed to:
+ * TEGRA_CRYPTO_IOCTL_PROCESS_REQ_ASYNC
+ *
+ * The request always works on the user pages, so it has the alignment
+ * needs of TEGRA_CRYPTO_ZERO_COPY.  The ioctl returns once the pages are
+ * pinned; read() on the device then returns a struct
+ * tegra_crypt_async_result per finished request, and poll() tells when
+ * one is waiting.
+ */
+struct tegra_crypt_async_req {
+	struct tegra_crypt_req req;
+	u64 cookie; /* handed back in the result */
+};
+
+struct tegra_crypt_async_result {
+	u64 cookie;
+	int status; /* 0 or -errno */
+};
+
 struct tegra_sha_req {
 	char key[TEGRA_CRYPTO_MAX_KEY_SIZE];
 	int keylen;
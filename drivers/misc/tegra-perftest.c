@@ -0,0 +1,849 @@
+/*
+ * drivers/misc/tegra-perftest.c
+ *
+ * Latency and throughput benchmarks for Tegra memory management, host1x,
+ * storage, crypto and CPU idle paths
+ *
+ * Copyright (c) 2012, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Runs a fixed number of operations for each of the configured sizes on
+ * each selected test and records the latency of every one. Results keep
+ * the minimum, median, 90th and 99th percentile and maximum latency, the
+ * throughput and the CPU time of the test thread, one record of key=value
+ * pairs per line after a header naming the kernel, so that the output of
+ * two kernels on the same board can be compared by a script:
+ *
+ *   echo nvmap,gr2d > /sys/kernel/debug/tegra_perftest/run
+ *   cat /sys/kernel/debug/tegra_perftest/results
+ *
+ * nvmap-alloc: nvmap_alloc() and nvmap_free() of a handle from nvmap_heap.
+ * nvmap-pin:   nvmap_pin() and nvmap_unpin() of a handle allocated before
+ *              the timed loop.
+ * gr2d:        a fill of the given number of bytes submitted through the
+ *              kernel gr2d API, timed until its sync point is reached.
+ * mmc-seq:     sequential reads from mmc_dev through the block layer,
+ *              below the page cache.
+ * mmc-rand:    the same at random offsets aligned to the read size.
+ * aes:         cbc(aes) encryption through the crypto API. The driver
+ *              that served it (tegra-se or tegra-aes) is the device name.
+ * lp2:         wake up latency after sleeping for each of lp2_us; the idle
+ *              governor picks LP2 for the longer sleeps, so the difference
+ *              to the short ones is the LP2 entry and exit cost.
+ * slab:        kmalloc() of the given number of bytes in objects of 64 to
+ *              2048 bytes, then kfree() of every other one followed by the
+ *              rest, so that slabs pass through the partial lists. The
+ *              device is the allocator; compare with slabinfo -T taken
+ *              before and after a run on each kernel.
+ *
+ * APB DMA throughput is covered by tegra_bustest.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/random.h>
+#include <linux/utsname.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/fs.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+#include <linux/nvmap.h>
+#include <linux/nvhost.h>
+
+#define PERFTEST_MAX_SIZES	8
+#define PERFTEST_MAX_ITER	4096
+#define PERFTEST_MAX_RESULTS	(8 * PERFTEST_MAX_SIZES)
+#define PERFTEST_BUF_ORDER	4
+#define PERFTEST_BUF_SIZE	(PAGE_SIZE << PERFTEST_BUF_ORDER)
+#define PERFTEST_GR2D_PITCH	4096
+#define PERFTEST_SLAB_MIN_OBJ	64
+
+static unsigned int sizes[PERFTEST_MAX_SIZES] = { 4096, 16384, 65536 };
+static unsigned int nr_sizes = 3;
+module_param_array(sizes, uint, &nr_sizes, 0644);
+MODULE_PARM_DESC(sizes, "Operation sizes in bytes, up to 64KB each");
+
+static unsigned int iterations = 200;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Operations per size (default: 200)");
+
+static unsigned int timeout = 3000;
+module_param(timeout, uint, 0644);
+MODULE_PARM_DESC(timeout, "Operation timeout in msec (default: 3000)");
+
+static unsigned int nvmap_heap = NVMAP_HEAP_IOVMM;
+module_param(nvmap_heap, uint, 0644);
+MODULE_PARM_DESC(nvmap_heap, "nvmap heap mask for the nvmap tests");
+
+static char *mmc_dev = "/dev/mmcblk0";
+module_param(mmc_dev, charp, 0644);
+MODULE_PARM_DESC(mmc_dev, "Block device read by the mmc tests");
+
+static unsigned int lp2_us[PERFTEST_MAX_SIZES] = { 200, 2000, 20000 };
+static unsigned int nr_lp2_us = 3;
+module_param_array(lp2_us, uint, &nr_lp2_us, 0644);
+MODULE_PARM_DESC(lp2_us, "Sleep times in usec for the lp2 test");
+
+struct perftest_result {
+	char name[16];
+	char dev_name[24];
+	unsigned int size;
+	unsigned int done;
+	unsigned int failed;
+	int err;
+	u32 min_us;
+	u32 p50_us;
+	u32 p90_us;
+	u32 p99_us;
+	u32 max_us;
+	u64 bytes_per_sec;
+	u32 cpu_permille;	/* of one CPU, the test thread */
+};
+
+struct perftest {
+	const char *name;
+	int (*setup)(struct perftest *pt);
+	/* optional, untimed, before and after the operations of one size */
+	int (*prepare)(struct perftest *pt, unsigned int size);
+	void (*finish)(struct perftest *pt);
+	/* one timed operation; may move *start past untimed work */
+	int (*op)(struct perftest *pt, unsigned int size, ktime_t *start);
+	void (*teardown)(struct perftest *pt);
+	bool sleeps;		/* sizes are lp2_us, not bytes */
+	char dev_name[24];
+	void *priv;
+};
+
+static DEFINE_MUTEX(perftest_lock);
+static struct perftest_result results[PERFTEST_MAX_RESULTS];
+static unsigned int nr_results;
+static u32 *latency;
+static struct page *buf_page;
+
+/* nvmap */
+
+struct perftest_nvmap {
+	struct nvmap_client *client;
+	struct nvmap_handle_ref *ref;
+	u32 base;
+};
+
+static int perftest_nvmap_setup(struct perftest *pt)
+{
+	struct perftest_nvmap *n;
+
+	n = kzalloc(sizeof(*n), GFP_KERNEL);
+	if (!n)
+		return -ENOMEM;
+
+	n->client = nvmap_create_client(nvmap_dev, "tegra_perftest");
+	if (!n->client) {
+		kfree(n);
+		return -ENODEV;
+	}
+
+	snprintf(pt->dev_name, sizeof(pt->dev_name), "%s",
+		 nvmap_heap & NVMAP_HEAP_IOVMM ? "iovmm" :
+		 nvmap_heap & NVMAP_HEAP_SYSMEM ? "sysmem" : "carveout");
+	pt->priv = n;
+	return 0;
+}
+
+static struct nvmap_handle_ref *perftest_nvmap_alloc(struct perftest_nvmap *n,
+						     unsigned int size)
+{
+	struct nvmap_handle_ref *ref;
+
+	ref = nvmap_alloc(n->client, size, PAGE_SIZE,
+			  NVMAP_HANDLE_WRITE_COMBINE, nvmap_heap);
+	return ref ? ref : ERR_PTR(-ENOMEM);
+}
+
+static int perftest_nvmap_alloc_op(struct perftest *pt, unsigned int size,
+				   ktime_t *start)
+{
+	struct perftest_nvmap *n = pt->priv;
+	struct nvmap_handle_ref *ref;
+
+	ref = perftest_nvmap_alloc(n, size);
+	if (IS_ERR(ref))
+		return PTR_ERR(ref);
+	nvmap_free(n->client, ref);
+	return 0;
+}
+
+static int perftest_nvmap_pin_prepare(struct perftest *pt, unsigned int size)
+{
+	struct perftest_nvmap *n = pt->priv;
+
+	n->ref = perftest_nvmap_alloc(n, size);
+	if (IS_ERR(n->ref)) {
+		int err = PTR_ERR(n->ref);
+
+		n->ref = NULL;
+		return err;
+	}
+	return 0;
+}
+
+static int perftest_nvmap_pin_op(struct perftest *pt, unsigned int size,
+				 ktime_t *start)
+{
+	struct perftest_nvmap *n = pt->priv;
+	phys_addr_t phys;
+
+	phys = nvmap_pin(n->client, n->ref);
+	if (IS_ERR_VALUE(phys))
+		return (int)phys;
+	nvmap_unpin(n->client, n->ref);
+	return 0;
+}
+
+static void perftest_nvmap_finish(struct perftest *pt)
+{
+	struct perftest_nvmap *n = pt->priv;
+
+	nvmap_free(n->client, n->ref);
+	n->ref = NULL;
+}
+
+static void perftest_nvmap_teardown(struct perftest *pt)
+{
+	struct perftest_nvmap *n = pt->priv;
+
+	if (n->ref) {
+		nvmap_unpin(n->client, n->ref);
+		nvmap_free(n->client, n->ref);
+	}
+	nvmap_client_put(n->client);
+	kfree(n);
+}
+
+/* gr2d */
+
+static int perftest_gr2d_setup(struct perftest *pt)
+{
+	struct perftest_nvmap *n;
+	phys_addr_t phys;
+	int ret;
+
+	ret = perftest_nvmap_setup(pt);
+	if (ret)
+		return ret;
+	n = pt->priv;
+
+	ret = perftest_nvmap_pin_prepare(pt, PERFTEST_BUF_SIZE);
+	if (ret)
+		goto fail;
+	phys = nvmap_pin(n->client, n->ref);
+	if (IS_ERR_VALUE(phys)) {
+		ret = (int)phys;
+		nvmap_free(n->client, n->ref);
+		n->ref = NULL;
+		goto fail;
+	}
+	n->base = phys;
+
+	strlcpy(pt->dev_name, "gr2d", sizeof(pt->dev_name));
+	return 0;
+
+fail:
+	perftest_nvmap_teardown(pt);
+	return ret;
+}
+
+static int perftest_gr2d_op(struct perftest *pt, unsigned int size,
+			    ktime_t *start)
+{
+	struct perftest_nvmap *n = pt->priv;
+	struct nvhost_gr2d_surface dst = {
+		.base	= n->base,
+		.pitch	= PERFTEST_GR2D_PITCH,
+		.width	= PERFTEST_GR2D_PITCH / 4,
+		.height	= PERFTEST_BUF_SIZE / PERFTEST_GR2D_PITCH,
+		.format	= NVHOST_GR2D_FORMAT_B8G8R8A8,
+	};
+	struct nvhost_gr2d_rect rect = { 0, 0, 0, 0 };
+	struct nvhost_gr2d_fence fence;
+	unsigned int pixels = max(size / 4, 1U);
+	int ret;
+
+	rect.w = min(pixels, dst.width);
+	rect.h = DIV_ROUND_UP(pixels, dst.width);
+
+	ret = nvhost_gr2d_fill(&dst, &rect, size, NVHOST_GR2D_ROP_COPY,
+			       &fence);
+	if (ret)
+		return ret;
+	ret = nvhost_gr2d_wait(&fence, msecs_to_jiffies(timeout));
+	return ret == -EAGAIN ? -ETIMEDOUT : ret;
+}
+
+/* mmc */
+
+struct perftest_mmc {
+	struct block_device *bdev;
+	sector_t sectors;
+	sector_t pos;
+	bool random;
+	struct completion done;
+	int err;
+};
+
+static int perftest_mmc_open(struct perftest *pt, bool random)
+{
+	struct perftest_mmc *m;
+
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	m->bdev = blkdev_get_by_path(mmc_dev, FMODE_READ, m);
+	if (IS_ERR(m->bdev)) {
+		int err = PTR_ERR(m->bdev);
+
+		kfree(m);
+		return err;
+	}
+	m->sectors = i_size_read(m->bdev->bd_inode) >> 9;
+	m->random = random;
+	init_completion(&m->done);
+
+	snprintf(pt->dev_name, sizeof(pt->dev_name), "%s",
+		 strrchr(mmc_dev, '/') ? strrchr(mmc_dev, '/') + 1 : mmc_dev);
+	pt->priv = m;
+	return 0;
+}
+
+static int perftest_mmc_seq_setup(struct perftest *pt)
+{
+	return perftest_mmc_open(pt, false);
+}
+
+static int perftest_mmc_rand_setup(struct perftest *pt)
+{
+	return perftest_mmc_open(pt, true);
+}
+
+static void perftest_mmc_end_io(struct bio *bio, int err)
+{
+	struct perftest_mmc *m = bio->bi_private;
+
+	m->err = err;
+	complete(&m->done);
+}
+
+static int perftest_mmc_op(struct perftest *pt, unsigned int size,
+			   ktime_t *start)
+{
+	struct perftest_mmc *m = pt->priv;
+	unsigned int nr = size >> 9;
+	unsigned int pages = DIV_ROUND_UP(size, PAGE_SIZE);
+	unsigned int i, len;
+	struct bio *bio;
+
+	if (!nr || m->sectors < nr)
+		return -EINVAL;
+
+	if (m->random) {
+		m->pos = random32() % (m->sectors / nr) * nr;
+	} else if (m->pos + nr > m->sectors) {
+		m->pos = 0;
+	}
+
+	bio = bio_alloc(GFP_KERNEL, pages);
+	if (!bio)
+		return -ENOMEM;
+	bio->bi_bdev = m->bdev;
+	bio->bi_sector = m->pos;
+	bio->bi_end_io = perftest_mmc_end_io;
+	bio->bi_private = m;
+	for (i = 0; i < pages; i++) {
+		len = min_t(unsigned int, size - i * PAGE_SIZE, PAGE_SIZE);
+		if (bio_add_page(bio, buf_page + i, len, 0) < len) {
+			bio_put(bio);
+			return -EIO;
+		}
+	}
+
+	INIT_COMPLETION(m->done);
+	submit_bio(READ_SYNC, bio);
+	wait_for_completion(&m->done);
+	bio_put(bio);
+
+	if (!m->random)
+		m->pos += nr;
+	return m->err;
+}
+
+static void perftest_mmc_teardown(struct perftest *pt)
+{
+	struct perftest_mmc *m = pt->priv;
+
+	blkdev_put(m->bdev, FMODE_READ);
+	kfree(m);
+}
+
+/* aes */
+
+struct perftest_aes {
+	struct crypto_ablkcipher *tfm;
+	struct ablkcipher_request *req;
+	struct completion done;
+	int err;
+};
+
+static void perftest_aes_complete(struct crypto_async_request *req, int err)
+{
+	struct perftest_aes *a = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+	a->err = err;
+	complete(&a->done);
+}
+
+static int perftest_aes_setup(struct perftest *pt)
+{
+	static const u8 key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2,
+				    0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf,
+				    0x4f, 0x3c };
+	struct perftest_aes *a;
+	int ret;
+
+	a = kzalloc(sizeof(*a), GFP_KERNEL);
+	if (!a)
+		return -ENOMEM;
+
+	a->tfm = crypto_alloc_ablkcipher("cbc(aes)", 0, 0);
+	if (IS_ERR(a->tfm)) {
+		ret = PTR_ERR(a->tfm);
+		goto fail;
+	}
+	ret = crypto_ablkcipher_setkey(a->tfm, key, sizeof(key));
+	if (ret)
+		goto fail_tfm;
+	a->req = ablkcipher_request_alloc(a->tfm, GFP_KERNEL);
+	if (!a->req) {
+		ret = -ENOMEM;
+		goto fail_tfm;
+	}
+	ablkcipher_request_set_callback(a->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					perftest_aes_complete, a);
+	init_completion(&a->done);
+
+	snprintf(pt->dev_name, sizeof(pt->dev_name), "%s",
+		 crypto_tfm_alg_driver_name(crypto_ablkcipher_tfm(a->tfm)));
+	pt->priv = a;
+	return 0;
+
+fail_tfm:
+	crypto_free_ablkcipher(a->tfm);
+fail:
+	kfree(a);
+	return ret;
+}
+
+static int perftest_aes_op(struct perftest *pt, unsigned int size,
+			   ktime_t *start)
+{
+	struct perftest_aes *a = pt->priv;
+	unsigned int len = ALIGN(min_t(unsigned int, size,
+				       PERFTEST_BUF_SIZE / 2), 16);
+	u8 *buf = page_address(buf_page);
+	struct scatterlist src, dst;
+	u8 iv[16] = { 0 };
+	int ret;
+
+	sg_init_one(&src, buf, len);
+	sg_init_one(&dst, buf + PERFTEST_BUF_SIZE / 2, len);
+	ablkcipher_request_set_crypt(a->req, &src, &dst, len, iv);
+
+	INIT_COMPLETION(a->done);
+	ret = crypto_ablkcipher_encrypt(a->req);
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		if (!wait_for_completion_timeout(&a->done,
+						 msecs_to_jiffies(timeout)))
+			return -ETIMEDOUT;
+		ret = a->err;
+	}
+	return ret;
+}
+
+static void perftest_aes_teardown(struct perftest *pt)
+{
+	struct perftest_aes *a = pt->priv;
+
+	ablkcipher_request_free(a->req);
+	crypto_free_ablkcipher(a->tfm);
+	kfree(a);
+}
+
+/* lp2 */
+
+static int perftest_lp2_setup(struct perftest *pt)
+{
+	strlcpy(pt->dev_name, "cpu", sizeof(pt->dev_name));
+	return 0;
+}
+
+static int perftest_lp2_op(struct perftest *pt, unsigned int size,
+			   ktime_t *start)
+{
+	ktime_t expires = ktime_add_us(ktime_get(), size);
+
+	/* time from the expiry, not from going to sleep */
+	*start = expires;
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+	return 0;
+}
+
+static void perftest_lp2_teardown(struct perftest *pt)
+{
+}
+
+/* slab */
+
+static const unsigned int perftest_slab_obj[] = { 64, 192, 512, 2048 };
+
+static int perftest_slab_setup(struct perftest *pt)
+{
+#ifdef CONFIG_SLUB
+	strlcpy(pt->dev_name, "slub", sizeof(pt->dev_name));
+#elif defined(CONFIG_SLOB)
+	strlcpy(pt->dev_name, "slob", sizeof(pt->dev_name));
+#else
+	strlcpy(pt->dev_name, "slab", sizeof(pt->dev_name));
+#endif
+	pt->priv = kcalloc(PERFTEST_BUF_SIZE / PERFTEST_SLAB_MIN_OBJ,
+			   sizeof(void *), GFP_KERNEL);
+	return pt->priv ? 0 : -ENOMEM;
+}
+
+static int perftest_slab_op(struct perftest *pt, unsigned int size,
+			    ktime_t *start)
+{
+	void **obj = pt->priv;
+	unsigned int n = 0, bytes = 0, i;
+	int ret = 0;
+
+	while (bytes < size) {
+		unsigned int len = perftest_slab_obj[n %
+					ARRAY_SIZE(perftest_slab_obj)];
+
+		obj[n] = kmalloc(len, GFP_KERNEL);
+		if (!obj[n]) {
+			ret = -ENOMEM;
+			break;
+		}
+		bytes += len;
+		n++;
+	}
+
+	for (i = 1; i < n; i += 2)
+		kfree(obj[i]);
+	for (i = 0; i < n; i += 2)
+		kfree(obj[i]);
+	return ret;
+}
+
+static void perftest_slab_teardown(struct perftest *pt)
+{
+	kfree(pt->priv);
+}
+
+static struct perftest perftests[] = {
+	{
+		.name		= "nvmap-alloc",
+		.setup		= perftest_nvmap_setup,
+		.op		= perftest_nvmap_alloc_op,
+		.teardown	= perftest_nvmap_teardown,
+	}, {
+		.name		= "nvmap-pin",
+		.setup		= perftest_nvmap_setup,
+		.prepare	= perftest_nvmap_pin_prepare,
+		.op		= perftest_nvmap_pin_op,
+		.finish		= perftest_nvmap_finish,
+		.teardown	= perftest_nvmap_teardown,
+	}, {
+		.name		= "gr2d",
+		.setup		= perftest_gr2d_setup,
+		.op		= perftest_gr2d_op,
+		.teardown	= perftest_nvmap_teardown,
+	}, {
+		.name		= "mmc-seq",
+		.setup		= perftest_mmc_seq_setup,
+		.op		= perftest_mmc_op,
+		.teardown	= perftest_mmc_teardown,
+	}, {
+		.name		= "mmc-rand",
+		.setup		= perftest_mmc_rand_setup,
+		.op		= perftest_mmc_op,
+		.teardown	= perftest_mmc_teardown,
+	}, {
+		.name		= "aes",
+		.setup		= perftest_aes_setup,
+		.op		= perftest_aes_op,
+		.teardown	= perftest_aes_teardown,
+	}, {
+		.name		= "lp2",
+		.setup		= perftest_lp2_setup,
+		.op		= perftest_lp2_op,
+		.teardown	= perftest_lp2_teardown,
+		.sleeps		= true,
+	}, {
+		.name		= "slab",
+		.setup		= perftest_slab_setup,
+		.op		= perftest_slab_op,
+		.teardown	= perftest_slab_teardown,
+	},
+};
+
+static int perftest_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a;
+	u32 y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void perftest_run_size(struct perftest *pt, unsigned int size,
+			      struct perftest_result *r)
+{
+	unsigned int iter = min(iterations, (unsigned int)PERFTEST_MAX_ITER);
+	u64 cpu_start;
+	ktime_t start, t0;
+	s64 wall_ns, t;
+	unsigned int i;
+	int ret;
+
+	memset(r, 0, sizeof(*r));
+	strlcpy(r->name, pt->name, sizeof(r->name));
+	strlcpy(r->dev_name, pt->dev_name, sizeof(r->dev_name));
+	r->size = size;
+
+	if (pt->prepare) {
+		ret = pt->prepare(pt, size);
+		if (ret) {
+			r->err = ret;
+			return;
+		}
+	}
+
+	cpu_start = current->se.sum_exec_runtime;
+	start = ktime_get();
+
+	for (i = 0; i < iter; i++) {
+		t0 = ktime_get();
+		ret = pt->op(pt, size, &t0);
+		t = ktime_us_delta(ktime_get(), t0);
+		latency[r->done] = t > 0 ? (u32)t : 0;
+		if (ret) {
+			r->failed++;
+			r->err = ret;
+			/* a missing device will not show up within the run */
+			if (ret == -ENODEV || ret == -ETIMEDOUT)
+				break;
+			continue;
+		}
+		r->done++;
+	}
+
+	wall_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (pt->finish)
+		pt->finish(pt);
+
+	if (r->done) {
+		sort(latency, r->done, sizeof(u32), perftest_cmp_u32, NULL);
+		r->min_us = latency[0];
+		r->p50_us = latency[r->done / 2];
+		r->p90_us = latency[(r->done * 9) / 10];
+		r->p99_us = latency[(r->done * 99) / 100];
+		r->max_us = latency[r->done - 1];
+	}
+	if (wall_ns > 0) {
+		if (!pt->sleeps)
+			r->bytes_per_sec = div64_u64((u64)r->done * size *
+						     NSEC_PER_SEC, wall_ns);
+		r->cpu_permille = div64_u64((current->se.sum_exec_runtime -
+					     cpu_start) * 1000, wall_ns);
+	}
+}
+
+static int perftest_run(struct perftest *pt)
+{
+	const unsigned int *list = pt->sleeps ? lp2_us : sizes;
+	unsigned int nr = pt->sleeps ? nr_lp2_us : nr_sizes;
+	unsigned int i;
+	int ret;
+
+	ret = pt->setup(pt);
+	if (ret) {
+		pr_info("tegra_perftest: %s: not run, err %d\n", pt->name, ret);
+		return ret;
+	}
+
+	for (i = 0; i < nr && nr_results < PERFTEST_MAX_RESULTS; i++) {
+		unsigned int size = list[i];
+
+		if (!pt->sleeps)
+			size = min_t(unsigned int, size, PERFTEST_BUF_SIZE);
+		if (!size)
+			continue;
+		perftest_run_size(pt, size, &results[nr_results]);
+		nr_results++;
+	}
+
+	pt->teardown(pt);
+	pt->priv = NULL;
+	return 0;
+}
+
+/* whole test names, or the part before the dash for a group: "mmc" */
+static bool perftest_selected(const char *list, const char *name)
+{
+	const char *dash = strchr(name, '-');
+	size_t group = dash ? dash - name : strlen(name);
+	size_t len;
+
+	while (*list) {
+		len = strcspn(list, ", \n");
+		if (len && ((len == strlen(name) && !strncmp(list, name, len)) ||
+			    (len == group && !strncmp(list, name, len))))
+			return true;
+		list += len;
+		if (*list)
+			list++;
+	}
+	return false;
+}
+
+static ssize_t perftest_run_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	char buf[64];
+	bool all;
+	int i;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	all = sysfs_streq(buf, "all");
+
+	mutex_lock(&perftest_lock);
+	nr_results = 0;
+	for (i = 0; i < ARRAY_SIZE(perftests); i++) {
+		struct perftest *pt = &perftests[i];
+
+		if (all || perftest_selected(buf, pt->name))
+			perftest_run(pt);
+	}
+	mutex_unlock(&perftest_lock);
+
+	return count;
+}
+
+static const struct file_operations perftest_run_fops = {
+	.write		= perftest_run_write,
+	.llseek		= noop_llseek,
+};
+
+static int perftest_results_show(struct seq_file *s, void *unused)
+{
+	struct perftest_result *r;
+	unsigned int i;
+
+	seq_printf(s, "# tegra_perftest release=%s version=\"%s\"\n",
+		   init_utsname()->release, init_utsname()->version);
+
+	mutex_lock(&perftest_lock);
+	for (i = 0; i < nr_results; i++) {
+		r = &results[i];
+		seq_printf(s, "test=%s dev=%s %s=%u done=%u failed=%u err=%d "
+			   "min_us=%u p50_us=%u p90_us=%u p99_us=%u max_us=%u "
+			   "bytes_per_sec=%llu cpu_permille=%u\n",
+			   r->name, r->dev_name,
+			   strcmp(r->name, "lp2") ? "size" : "sleep_us",
+			   r->size, r->done, r->failed, r->err, r->min_us,
+			   r->p50_us, r->p90_us, r->p99_us, r->max_us,
+			   r->bytes_per_sec, r->cpu_permille);
+	}
+	mutex_unlock(&perftest_lock);
+	return 0;
+}
+
+static int perftest_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, perftest_results_show, inode->i_private);
+}
+
+static const struct file_operations perftest_results_fops = {
+	.open		= perftest_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *perftest_dir;
+
+static int __init tegra_perftest_init(void)
+{
+	latency = vmalloc(PERFTEST_MAX_ITER * sizeof(*latency));
+	if (!latency)
+		return -ENOMEM;
+	buf_page = alloc_pages(GFP_KERNEL, PERFTEST_BUF_ORDER);
+	if (!buf_page)
+		goto fail;
+
+	perftest_dir = debugfs_create_dir("tegra_perftest", NULL);
+	if (!perftest_dir)
+		goto fail;
+	if (!debugfs_create_file("run", S_IWUSR, perftest_dir, NULL,
+				 &perftest_run_fops))
+		goto fail;
+	if (!debugfs_create_file("results", S_IRUGO, perftest_dir, NULL,
+				 &perftest_results_fops))
+		goto fail;
+	return 0;
+
+fail:
+	debugfs_remove_recursive(perftest_dir);
+	if (buf_page)
+		__free_pages(buf_page, PERFTEST_BUF_ORDER);
+	vfree(latency);
+	return -ENOMEM;
+}
+module_init(tegra_perftest_init);
+
+static void __exit tegra_perftest_exit(void)
+{
+	debugfs_remove_recursive(perftest_dir);
+	__free_pages(buf_page, PERFTEST_BUF_ORDER);
+	vfree(latency);
+}
+module_exit(tegra_perftest_exit);
+
+MODULE_DESCRIPTION("Tegra nvmap, host1x, MMC, crypto, LP2 and slab benchmark");
+MODULE_LICENSE("GPL v2");
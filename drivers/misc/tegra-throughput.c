@@ -42,6 +42,7 @@ static void set_throughput_hint(struct work_struct *work)
 {
 	/* notify throughput hint clients here */
 	nvhost_scale3d_set_throughput_hint(throughput_hint);
+	nvhost_scale3d_set_frame_time(target_frame_time, last_frame_time);
 }
 
 static int throughput_flip_callback(void)
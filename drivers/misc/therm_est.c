@@ -28,6 +28,33 @@
 #include <linux/syscalls.h>
 #include <linux/therm_est.h>
 
+/*
+ * Outside this distance (milli-Celsius) from both alert limits the next
+ * sample rides a deferrable timer, so an idle system is not woken just
+ * to confirm it is still cool.  Closer in, samples are taken on time.
+ */
+#define THERM_EST_NEAR_MARGIN	5000
+
+static bool therm_est_near_limits(struct therm_estimator *est)
+{
+	if (est->cur_temp >= est->therm_est_hi_limit - THERM_EST_NEAR_MARGIN)
+		return true;
+
+	return est->therm_est_lo_limit > 0 &&
+		est->cur_temp <= est->therm_est_lo_limit + THERM_EST_NEAR_MARGIN;
+}
+
+static void therm_est_queue(struct therm_estimator *est)
+{
+	unsigned long delay = msecs_to_jiffies(est->polling_period);
+
+	if (therm_est_near_limits(est))
+		queue_delayed_work(est->workqueue, &est->therm_est_work, delay);
+	else
+		queue_delayed_work(est->workqueue, &est->therm_est_idle_work,
+				   delay);
+}
+
 int therm_est_get_temp(struct therm_estimator *est, long *temp)
 {
 	*temp = est->cur_temp;
@@ -56,16 +83,10 @@ int therm_est_set_alert(struct therm_estimator *est,
 	return 0;
 }
 
-static void therm_est_work_func(struct work_struct *work)
+static void therm_est_update(struct therm_estimator *est)
 {
 	int i, j, index, sum = 0;
 	long temp;
-	struct delayed_work *dwork = container_of (work,
-					struct delayed_work, work);
-	struct therm_estimator *est = container_of(
-					dwork,
-					struct therm_estimator,
-					therm_est_work);
 
 	for (i = 0; i < est->ndevs; i++) {
 		if (est->devs[i]->get_temp(est->devs[i]->dev_data, &temp))
@@ -89,8 +110,25 @@ static void therm_est_work_func(struct work_struct *work)
 			 (est->cur_temp <= est->therm_est_lo_limit)))
 		est->callback(est->callback_data);
 
-	queue_delayed_work(est->workqueue, &est->therm_est_work,
-				msecs_to_jiffies(est->polling_period));
+	therm_est_queue(est);
+}
+
+static void therm_est_work_func(struct work_struct *work)
+{
+	struct therm_estimator *est = container_of(to_delayed_work(work),
+					struct therm_estimator,
+					therm_est_work);
+
+	therm_est_update(est);
+}
+
+static void therm_est_idle_work_func(struct work_struct *work)
+{
+	struct therm_estimator *est = container_of(to_delayed_work(work),
+					struct therm_estimator,
+					therm_est_idle_work);
+
+	therm_est_update(est);
 }
 
 struct therm_estimator *therm_est_register(
@@ -130,6 +168,8 @@ struct therm_estimator *therm_est_register(
 	est->workqueue = alloc_workqueue("therm_est",
 				    WQ_HIGHPRI | WQ_UNBOUND | WQ_RESCUER, 1);
 	INIT_DELAYED_WORK(&est->therm_est_work, therm_est_work_func);
+	INIT_DELAYED_WORK_DEFERRABLE(&est->therm_est_idle_work,
+				     therm_est_idle_work_func);
 
 	queue_delayed_work(est->workqueue,
 				&est->therm_est_work,
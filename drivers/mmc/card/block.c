@@ -34,6 +34,7 @@
 #include <linux/delay.h>
 #include <linux/capability.h>
 #include <linux/compat.h>
+#include <linux/ktime.h>
 
 #include <linux/mmc/ioctl.h>
 #include <linux/mmc/card.h>
@@ -73,6 +74,15 @@ static int perdev_minors = CONFIG_MMC_BLOCK_MINORS;
  */
 static int max_devices;
 
+/*
+ * Background ops and plain discards wait until the queue has been empty for
+ * idle_ms, and an async BKOPS is cut short with HPI by the next request. A
+ * discard is held back for at most discard_defer_ms under steady foreground
+ * I/O. idle_ms=0 runs both inline, as soon as they come up.
+ */
+static unsigned int idle_ms = 100;
+static unsigned int discard_defer_ms = 1000;
+
 /* 256 minors, so at most 256 separate devices */
 static DECLARE_BITMAP(dev_use, 256);
 static DECLARE_BITMAP(name_use, 256);
@@ -89,6 +99,7 @@ struct mmc_blk_data {
 	unsigned int	flags;
 #define MMC_BLK_CMD23	(1 << 0)	/* Can do SET_BLOCK_COUNT for multiblock */
 #define MMC_BLK_REL_WR	(1 << 1)	/* MMC Reliable write support */
+#define MMC_BLK_PACKED_CMD	(1 << 2)	/* MMC packed command support */
 
 	unsigned int	usage;
 	unsigned int	read_only;
@@ -102,6 +113,37 @@ struct mmc_blk_data {
 	 */
 	unsigned int	part_curr;
 	struct device_attribute force_ro;
+
+	/*
+	 * Writes issued, by how many requests went into the command: [1]
+	 * counts writes sent on their own, the last slot any longer pack.
+	 */
+#define MMC_BLK_PACKED_HIST	64
+	unsigned long	packed_hist[MMC_BLK_PACKED_HIST];
+	struct device_attribute packed_stats;
+
+	/* discards held back for the queue to go idle, see mmc_blk_idle() */
+	struct list_head discards;
+	unsigned long	discard_deadline;
+
+	/*
+	 * Time foreground requests spent behind background work: inline
+	 * discards and BKOPS ran with requests waiting, HPI cut an async
+	 * BKOPS short for one.
+	 */
+	struct mmc_blk_idle_stats {
+		unsigned long	discards_deferred;
+		unsigned long	discards_idle;
+		unsigned long	discards_inline;
+		unsigned long	bkops_idle;
+		unsigned long	bkops_inline;
+		unsigned long	hpi;
+		s64		inline_us;
+		s64		inline_max_us;
+		s64		hpi_us;
+		s64		hpi_max_us;
+	} idle;
+	struct device_attribute idle_stats;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -119,6 +161,12 @@ enum mmc_blk_status {
 module_param(perdev_minors, int, 0444);
 MODULE_PARM_DESC(perdev_minors, "Minors numbers to allocate per device");
 
+module_param(idle_ms, uint, 0644);
+MODULE_PARM_DESC(idle_ms, "Idle time before background ops and discards");
+
+module_param(discard_defer_ms, uint, 0644);
+MODULE_PARM_DESC(discard_defer_ms, "Longest a discard waits for idle time");
+
 static struct mmc_blk_data *mmc_blk_get(struct gendisk *disk)
 {
 	struct mmc_blk_data *md;
@@ -188,6 +236,51 @@ out:
 	return ret;
 }
 
+static ssize_t packed_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	unsigned long reqs = 0, cmds = 0;
+	ssize_t len = 0;
+	int i;
+
+	for (i = 1; i < MMC_BLK_PACKED_HIST; i++) {
+		cmds += md->packed_hist[i];
+		reqs += md->packed_hist[i] * i;
+		if (!md->packed_hist[i])
+			continue;
+		len += snprintf(buf + len, PAGE_SIZE - len, "%d%s: %lu\n", i,
+				i == MMC_BLK_PACKED_HIST - 1 ? "+" : "",
+				md->packed_hist[i]);
+	}
+	len += snprintf(buf + len, PAGE_SIZE - len,
+			"write requests: %lu, commands: %lu\n", reqs, cmds);
+
+	mmc_blk_put(md);
+	return len;
+}
+
+static ssize_t idle_stats_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_blk_idle_stats *st = &md->idle;
+	ssize_t len;
+
+	len = snprintf(buf, PAGE_SIZE,
+		       "discards deferred: %lu, at idle: %lu, inline: %lu\n"
+		       "bkops at idle: %lu, inline: %lu\n"
+		       "inline stall: %lld us, max %lld us\n"
+		       "hpi: %lu, %lld us, max %lld us\n",
+		       st->discards_deferred, st->discards_idle,
+		       st->discards_inline, st->bkops_idle, st->bkops_inline,
+		       st->inline_us, st->inline_max_us,
+		       st->hpi, st->hpi_us, st->hpi_max_us);
+
+	mmc_blk_put(md);
+	return len;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -776,6 +869,140 @@ out:
 	return err ? 0 : 1;
 }
 
+static void mmc_blk_account_stall(s64 *total, s64 *max, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	*total += us;
+	if (us > *max)
+		*max = us;
+}
+
+/* Abort any current bk ops of eMMC card by issuing HPI */
+static void mmc_blk_interrupt_bkops(struct mmc_blk_data *md)
+{
+	struct mmc_card *card = md->queue.card;
+	ktime_t start;
+
+	if (!mmc_card_mmc(card) || !mmc_card_doing_bkops(card))
+		return;
+
+	start = ktime_get();
+	mmc_interrupt_hpi(card);
+	md->idle.hpi++;
+	mmc_blk_account_stall(&md->idle.hpi_us, &md->idle.hpi_max_us, start);
+}
+
+static int mmc_blk_defer_discard(struct mmc_blk_data *md, struct request *req)
+{
+	if (list_empty(&md->discards))
+		md->discard_deadline = jiffies +
+			msecs_to_jiffies(discard_defer_ms);
+	list_add_tail(&req->queuelist, &md->discards);
+	md->idle.discards_deferred++;
+
+	return 1;
+}
+
+/*
+ * Issues the deferred discards, called with the host claimed and the
+ * partition switched. At idle time it stops as soon as a request comes in,
+ * otherwise the whole batch is in the way of foreground I/O.
+ */
+static void mmc_blk_issue_deferred(struct mmc_queue *mq, bool idle)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct request *req;
+	ktime_t start = ktime_get();
+
+	while (!list_empty(&md->discards)) {
+		if (idle && mmc_queue_busy(mq))
+			break;
+
+		req = list_first_entry(&md->discards, struct request,
+				       queuelist);
+		list_del_init(&req->queuelist);
+		mmc_blk_issue_discard_rq(mq, req);
+
+		if (idle)
+			md->idle.discards_idle++;
+		else
+			md->idle.discards_inline++;
+	}
+
+	if (!idle)
+		mmc_blk_account_stall(&md->idle.inline_us,
+				      &md->idle.inline_max_us, start);
+}
+
+static void mmc_blk_fail_deferred(struct mmc_blk_data *md)
+{
+	struct request *req;
+
+	while (!list_empty(&md->discards)) {
+		req = list_first_entry(&md->discards, struct request,
+				       queuelist);
+		list_del_init(&req->queuelist);
+		spin_lock_irq(&md->lock);
+		__blk_end_request(req, -EIO, blk_rq_bytes(req));
+		spin_unlock_irq(&md->lock);
+	}
+}
+
+/*
+ * The queue has run dry. Deferred discards go out once it has stayed so for
+ * idle_ms, then background ops are started if the card asked for them.
+ * Those are started async whenever the card can be interrupted with HPI, so
+ * that the next request only waits for the HPI instead of the whole BKOPS.
+ */
+static long mmc_blk_idle(struct mmc_queue *mq, bool force)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	unsigned long due = mq->last_active + msecs_to_jiffies(idle_ms);
+	bool bkops;
+	ktime_t start;
+
+	/* background ops are per card, leave them to the main partition */
+	bkops = !force && md == mmc_get_drvdata(card) &&
+		mmc_card_mmc(card) && card->ext_csd.bk_ops_en &&
+		mmc_card_need_bkops(card) && !mmc_card_doing_bkops(card);
+
+	if (list_empty(&md->discards) && !bkops)
+		return MAX_SCHEDULE_TIMEOUT;
+	if (!force && time_before(jiffies, due))
+		return due - jiffies;
+
+	__set_current_state(TASK_RUNNING);
+
+	if (!list_empty(&md->discards)) {
+		mmc_claim_host(card->host);
+		mmc_blk_interrupt_bkops(md);
+		if (mmc_blk_part_switch(card, md))
+			mmc_blk_fail_deferred(md);
+		else
+			mmc_blk_issue_deferred(mq, !force);
+		mmc_release_host(card->host);
+	}
+
+	if (!bkops || !list_empty(&md->discards) || mmc_queue_busy(mq))
+		return 0;
+
+	if (!idle_ms) {
+		/* the old way, for comparison */
+		start = ktime_get();
+		mmc_bkops_start(card, true);
+		md->idle.bkops_inline++;
+		mmc_blk_account_stall(&md->idle.inline_us,
+				      &md->idle.inline_max_us, start);
+	} else {
+		mmc_bkops_start(card, !card->ext_csd.hpi_en);
+		md->idle.bkops_idle++;
+	}
+
+	return 0;
+}
+
 static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -915,6 +1142,13 @@ static int mmc_blk_err_check(struct mmc_card *card,
 		}
 	}
 
+	/* a pack covers several requests, all of its data is the whole */
+	if (mmc_packed_cmd(mq_mrq->cmd_type)) {
+		if (brq->data.blocks << 9 != brq->data.bytes_xfered)
+			return MMC_BLK_PARTIAL;
+		return MMC_BLK_SUCCESS;
+	}
+
 	if (ret == MMC_BLK_SUCCESS &&
 	    blk_rq_bytes(req) != brq->data.bytes_xfered)
 		ret = MMC_BLK_PARTIAL;
@@ -922,6 +1156,77 @@ static int mmc_blk_err_check(struct mmc_card *card,
 	return ret;
 }
 
+/*
+ * On a failed pack the card reports the entry it stopped at through the
+ * exception event bit, everything before that entry is on the card.
+ */
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						   mmc_active);
+	struct request *req = mq_rq->req;
+	struct mmc_packed *packed = mq_rq->packed;
+	int err, check;
+	u32 status;
+	u8 *ext_csd;
+
+	BUG_ON(!packed);
+
+	packed->retries--;
+	check = mmc_blk_err_check(card, areq);
+	err = get_card_status(card, &status, 0);
+	if (err) {
+		pr_err("%s: error %d sending status command\n",
+		       req->rq_disk->disk_name, err);
+		return MMC_BLK_ABORT;
+	}
+
+	if (!(status & R1_EXCEPTION_EVENT))
+		goto out;
+
+	ext_csd = kzalloc(512, GFP_KERNEL);
+	if (!ext_csd) {
+		pr_err("%s: unable to allocate buffer for ext_csd\n",
+		       req->rq_disk->disk_name);
+		return MMC_BLK_ABORT;
+	}
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (err) {
+		pr_err("%s: error %d sending ext_csd\n",
+		       req->rq_disk->disk_name, err);
+		check = MMC_BLK_ABORT;
+		goto free;
+	}
+
+	if ((ext_csd[EXT_CSD_EXP_EVENTS_STATUS] & EXT_CSD_PACKED_FAILURE) &&
+	    (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+	     EXT_CSD_PACKED_GENERIC_ERROR)) {
+		if (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		    EXT_CSD_PACKED_INDEXED_ERROR) {
+			packed->idx_failure =
+				ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+			check = MMC_BLK_PARTIAL;
+		}
+		pr_err("%s: packed cmd %s, failure index: %d, reason: %d\n",
+		       req->rq_disk->disk_name,
+		       packed->idx_failure == MMC_PACKED_NR_IDX ?
+				"failed" : "partial",
+		       packed->idx_failure,
+		       ext_csd[EXT_CSD_PACKED_CMD_STATUS]);
+	}
+free:
+	kfree(ext_csd);
+out:
+	/* short, but with no entry to resume from: send it all again */
+	if (check == MMC_BLK_PARTIAL &&
+	    packed->idx_failure == MMC_PACKED_NR_IDX)
+		check = MMC_BLK_RETRY;
+
+	return check;
+}
+
 static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 			       struct mmc_card *card,
 			       int disable_multi,
@@ -944,6 +1249,8 @@ static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 		(rq_data_dir(req) == WRITE) &&
 		(md->flags & MMC_BLK_REL_WR);
 
+	mqrq->cmd_type = MMC_PACKED_NONE;
+
 	memset(brq, 0, sizeof(struct mmc_blk_request));
 	brq->mrq.cmd = &brq->cmd;
 	brq->mrq.data = &brq->data;
@@ -1058,6 +1365,282 @@ static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 	mmc_queue_bounce_pre(mqrq);
 }
 
+#define PACKED_CMD_VER	0x01
+#define PACKED_CMD_WR	0x02
+
+#define MMC_CMD23_ARG_REL_WR	(1 << 31)
+#define MMC_CMD23_ARG_PACKED	(1 << 30)
+
+static inline bool mmc_req_rel_wr(struct request *req)
+{
+	return ((req->cmd_flags & REQ_FUA) || (req->cmd_flags & REQ_META)) &&
+		(rq_data_dir(req) == WRITE);
+}
+
+static inline void mmc_blk_clear_packed(struct mmc_queue_req *mqrq)
+{
+	struct mmc_packed *packed = mqrq->packed;
+
+	BUG_ON(!packed);
+
+	mqrq->cmd_type = MMC_PACKED_NONE;
+	packed->nr_entries = MMC_PACKED_NR_ZERO;
+	packed->idx_failure = MMC_PACKED_NR_IDX;
+	packed->retries = 0;
+	packed->blocks = 0;
+}
+
+/*
+ * Pulls the writes that follow req off the queue for as long as they can
+ * go into the same packed command, and returns how many requests that
+ * command holds (0 if req goes on its own).
+ */
+static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct request *cur = req, *next = NULL;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	bool en_rel_wr = card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN;
+	unsigned int req_sectors = 0, phys_segments = 0;
+	unsigned int max_blk_count, max_phys_segs;
+	bool put_back = true;
+	u8 max_packed_rw;
+	u8 reqs = 0;
+
+	if (!(md->flags & MMC_BLK_PACKED_CMD) || mqrq->bounce_buf)
+		goto no_packed;
+
+	if (rq_data_dir(cur) != WRITE ||
+	    (cur->cmd_flags & (REQ_DISCARD | REQ_FLUSH)))
+		goto no_packed;
+
+	max_packed_rw = card->ext_csd.max_packed_writes;
+	if (max_packed_rw < 2)
+		goto no_packed;
+
+	/* legacy reliable writes restrict the transfer, keep them alone */
+	if (mmc_req_rel_wr(cur) && (md->flags & MMC_BLK_REL_WR) && !en_rel_wr)
+		goto no_packed;
+
+	mmc_blk_clear_packed(mqrq);
+
+	max_blk_count = min(card->host->max_blk_count,
+			    card->host->max_req_size >> 9);
+	if (unlikely(max_blk_count > 0xffff))
+		max_blk_count = 0xffff;
+
+	max_phys_segs = queue_max_segments(q);
+
+	/* the header takes one block and one segment */
+	req_sectors += blk_rq_sectors(cur) + 1;
+	phys_segments += cur->nr_phys_segments + 1;
+
+	do {
+		if (reqs >= max_packed_rw - 1) {
+			put_back = false;
+			break;
+		}
+
+		spin_lock_irq(q->queue_lock);
+		next = blk_fetch_request(q);
+		spin_unlock_irq(q->queue_lock);
+		if (!next) {
+			put_back = false;
+			break;
+		}
+
+		if (next->cmd_flags & (REQ_DISCARD | REQ_FLUSH))
+			break;
+
+		if (rq_data_dir(cur) != rq_data_dir(next))
+			break;
+
+		if (mmc_req_rel_wr(next) &&
+		    (md->flags & MMC_BLK_REL_WR) && !en_rel_wr)
+			break;
+
+		req_sectors += blk_rq_sectors(next);
+		if (req_sectors > max_blk_count)
+			break;
+
+		phys_segments += next->nr_phys_segments;
+		if (phys_segments > max_phys_segs)
+			break;
+
+		list_add_tail(&next->queuelist, &mqrq->packed->list);
+		cur = next;
+		reqs++;
+	} while (1);
+
+	if (put_back) {
+		spin_lock_irq(q->queue_lock);
+		blk_requeue_request(q, next);
+		spin_unlock_irq(q->queue_lock);
+	}
+
+	if (reqs > 0) {
+		list_add(&req->queuelist, &mqrq->packed->list);
+		mqrq->packed->nr_entries = ++reqs;
+		mqrq->packed->retries = reqs;
+		return reqs;
+	}
+
+no_packed:
+	mqrq->cmd_type = MMC_PACKED_NONE;
+	return 0;
+}
+
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct request *prq;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_packed *packed = mqrq->packed;
+	bool do_rel_wr;
+	u32 *packed_cmd_hdr;
+	u8 i = 1;
+
+	BUG_ON(!packed);
+
+	mqrq->cmd_type = MMC_PACKED_WRITE;
+	packed->blocks = 0;
+	packed->idx_failure = MMC_PACKED_NR_IDX;
+
+	packed_cmd_hdr = packed->cmd_hdr;
+	memset(packed_cmd_hdr, 0, sizeof(packed->cmd_hdr));
+	packed_cmd_hdr[0] = (packed->nr_entries << 16) |
+		(PACKED_CMD_WR << 8) | PACKED_CMD_VER;
+
+	/*
+	 * Argument for each entry of packed group
+	 */
+	list_for_each_entry(prq, &packed->list, queuelist) {
+		do_rel_wr = mmc_req_rel_wr(prq) && (md->flags & MMC_BLK_REL_WR);
+		/* Argument of CMD23 */
+		packed_cmd_hdr[(i * 2)] =
+			(do_rel_wr ? MMC_CMD23_ARG_REL_WR : 0) |
+			blk_rq_sectors(prq);
+		/* Argument of CMD25 */
+		packed_cmd_hdr[((i * 2)) + 1] =
+			mmc_card_blockaddr(card) ?
+			blk_rq_pos(prq) : blk_rq_pos(prq) << 9;
+		packed->blocks += blk_rq_sectors(prq);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.stop = &brq->stop;
+
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | (packed->blocks + 1);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = packed->blocks + 1;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+
+	mmc_queue_bounce_pre(mqrq);
+}
+
+/*
+ * Completes the packed requests the card got, returns 1 if the ones from
+ * the failure index on have to be sent again.
+ */
+static int mmc_blk_end_packed_req(struct mmc_blk_data *md,
+				  struct mmc_queue_req *mq_rq)
+{
+	struct request *prq;
+	struct mmc_packed *packed = mq_rq->packed;
+	int idx = packed->idx_failure, i = 0;
+
+	while (!list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.next);
+		if (idx == i) {
+			/* retry from error index */
+			packed->nr_entries -= idx;
+			mq_rq->req = prq;
+
+			if (packed->nr_entries == MMC_PACKED_NR_SINGLE) {
+				list_del_init(&prq->queuelist);
+				mmc_blk_clear_packed(mq_rq);
+			}
+			return 1;
+		}
+		list_del_init(&prq->queuelist);
+		spin_lock_irq(&md->lock);
+		__blk_end_request(prq, 0, blk_rq_bytes(prq));
+		spin_unlock_irq(&md->lock);
+		i++;
+	}
+
+	mmc_blk_clear_packed(mq_rq);
+	return 0;
+}
+
+static void mmc_blk_abort_packed_req(struct mmc_blk_data *md,
+				     struct mmc_queue_req *mq_rq)
+{
+	struct request *prq;
+	struct mmc_packed *packed = mq_rq->packed;
+
+	while (!list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.next);
+		list_del_init(&prq->queuelist);
+		spin_lock_irq(&md->lock);
+		__blk_end_request(prq, -EIO, blk_rq_bytes(prq));
+		spin_unlock_irq(&md->lock);
+	}
+
+	mmc_blk_clear_packed(mq_rq);
+}
+
+/* gives a pack that was never started back to the queue, but its head */
+static void mmc_blk_revert_packed_req(struct mmc_queue *mq,
+				      struct mmc_queue_req *mq_rq)
+{
+	struct request *prq;
+	struct request_queue *q = mq->queue;
+	struct mmc_packed *packed = mq_rq->packed;
+
+	while (!list_empty(&packed->list)) {
+		prq = list_entry_rq(packed->list.prev);
+		list_del_init(&prq->queuelist);
+		if (prq != mq_rq->req) {
+			spin_lock_irq(q->queue_lock);
+			blk_requeue_request(q, prq);
+			spin_unlock_irq(q->queue_lock);
+		}
+	}
+
+	mmc_blk_clear_packed(mq_rq);
+}
+
 static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -1068,13 +1651,25 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	struct mmc_queue_req *mq_rq;
 	struct request *req;
 	struct mmc_async_req *areq;
+	u8 reqs = 0;
 
 	if (!rqc && !mq->mqrq_prev->req)
 		return 0;
 
+	if (rqc) {
+		reqs = mmc_blk_prep_packed_list(mq, rqc);
+		if (rq_data_dir(rqc) == WRITE)
+			md->packed_hist[min_t(int, max_t(int, reqs, 1),
+				MMC_BLK_PACKED_HIST - 1)]++;
+	}
+
 	do {
 		if (rqc) {
-			mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			if (reqs >= 2)
+				mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur,
+							    card, mq);
+			else
+				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 			areq = &mq->mqrq_cur->mmc_active;
 		} else
 			areq = NULL;
@@ -1093,6 +1688,10 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			/*
 			 * A block was successfully transferred.
 			 */
+			if (mmc_packed_cmd(mq_rq->cmd_type)) {
+				ret = mmc_blk_end_packed_req(md, mq_rq);
+				break;
+			}
 			spin_lock_irq(&md->lock);
 			ret = __blk_end_request(req, 0,
 						brq->data.bytes_xfered);
@@ -1112,6 +1711,8 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			}
 			break;
 		case MMC_BLK_CMD_ERR:
+			if (mmc_packed_cmd(mq_rq->cmd_type))
+				goto cmd_abort;
 			goto cmd_err;
 		case MMC_BLK_RETRY_SINGLE:
 			disable_multi = 1;
@@ -1141,7 +1742,13 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			 * In case of a none complete request
 			 * prepare it again and resend.
 			 */
-			mmc_blk_rw_rq_prep(mq_rq, card, disable_multi, mq);
+			if (mmc_packed_cmd(mq_rq->cmd_type)) {
+				if (!mq_rq->packed->retries)
+					goto cmd_abort;
+				mmc_blk_packed_hdr_wrq_prep(mq_rq, card, mq);
+			} else
+				mmc_blk_rw_rq_prep(mq_rq, card, disable_multi,
+						   mq);
 			mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
 		}
 	} while (ret);
@@ -1176,13 +1783,21 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	}
 
  cmd_abort:
-	spin_lock_irq(&md->lock);
-	while (ret)
-		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
-	spin_unlock_irq(&md->lock);
+	if (mmc_packed_cmd(mq_rq->cmd_type)) {
+		mmc_blk_abort_packed_req(md, mq_rq);
+	} else {
+		spin_lock_irq(&md->lock);
+		while (ret)
+			ret = __blk_end_request(req, -EIO,
+						blk_rq_cur_bytes(req));
+		spin_unlock_irq(&md->lock);
+	}
 
  start_new_req:
 	if (rqc) {
+		/* the new request goes again, on its own */
+		if (mmc_packed_cmd(mq->mqrq_cur->cmd_type))
+			mmc_blk_revert_packed_req(mq, mq->mqrq_cur);
 		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
 	}
@@ -1198,6 +1813,8 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	int ret;
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
+	ktime_t start;
+	bool defer;
 
 #ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
 	if (mmc_bus_needs_resume(card->host)) {
@@ -1206,34 +1823,52 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 #endif
 
+	/* plain discards can wait for the queue to go idle */
+	defer = req && idle_ms && req->cmd_flags & REQ_DISCARD &&
+		!(req->cmd_flags & REQ_SECURE);
+
 	if (req && !mq->mqrq_prev->req)
 		/* claim host only for the first request */
 		mmc_claim_host(card->host);
 
+	if (req && !defer)
+		mmc_blk_interrupt_bkops(md);
+
 	ret = mmc_blk_part_switch(card, md);
 	if (ret) {
 		ret = 0;
 		goto out;
 	}
 
-	if (req && req->cmd_flags & REQ_DISCARD) {
+	if (req && !defer && !list_empty(&md->discards) &&
+	    time_after_eq(jiffies, md->discard_deadline)) {
+		/* foreground I/O has kept the queue busy for too long */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
+		mmc_blk_issue_deferred(mq, false);
+	}
+
+	if (defer) {
+		ret = mmc_blk_defer_discard(md, req);
+	} else if (req && req->cmd_flags & REQ_DISCARD) {
 		/* complete ongoing async transfer before issuing discard */
 		if (card->host->areq)
 			mmc_blk_issue_rw_rq(mq, NULL);
-		if (req->cmd_flags & REQ_SECURE)
+		if (req->cmd_flags & REQ_SECURE) {
 			ret = mmc_blk_issue_secdiscard_rq(mq, req);
-		else
+		} else {
+			start = ktime_get();
 			ret = mmc_blk_issue_discard_rq(mq, req);
+			md->idle.discards_inline++;
+			mmc_blk_account_stall(&md->idle.inline_us,
+					      &md->idle.inline_max_us, start);
+		}
 	} else if (req && req->cmd_flags & REQ_FLUSH) {
 		/* complete ongoing async transfer before issuing flush */
 		if (card->host->areq)
 			mmc_blk_issue_rw_rq(mq, NULL);
 		ret = mmc_blk_issue_flush(mq, req);
 	} else {
-		/* Abort any current bk ops of eMMC card by issuing HPI */
-		if (mmc_card_mmc(mq->card) && mmc_card_doing_bkops(mq->card))
-			mmc_interrupt_hpi(mq->card);
-
 		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
 
@@ -1298,6 +1933,7 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 
 	spin_lock_init(&md->lock);
 	INIT_LIST_HEAD(&md->part);
+	INIT_LIST_HEAD(&md->discards);
 	md->usage = 1;
 
 	ret = mmc_init_queue(&md->queue, card, &md->lock, subname);
@@ -1305,6 +1941,7 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 		goto err_putdisk;
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
+	md->queue.idle_fn = mmc_blk_idle;
 	md->queue.data = md;
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
@@ -1349,6 +1986,14 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 		blk_queue_flush(md->queue.queue, REQ_FLUSH | REQ_FUA);
 	}
 
+	if (mmc_card_mmc(card) &&
+	    md->flags & MMC_BLK_CMD23 &&
+	    (card->host->caps2 & MMC_CAP2_PACKED_WR) &&
+	    card->ext_csd.packed_event_en) {
+		if (!mmc_packed_init(&md->queue, card))
+			md->flags |= MMC_BLK_PACKED_CMD;
+	}
+
 	return md;
 
  err_putdisk:
@@ -1455,6 +2100,11 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 	if (md) {
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+			device_remove_file(disk_to_dev(md->disk),
+					   &md->idle_stats);
+			if (md->flags & MMC_BLK_PACKED_CMD)
+				device_remove_file(disk_to_dev(md->disk),
+						   &md->packed_stats);
 
 			/* Stop new requests from getting into the queue */
 			del_gendisk(md->disk);
@@ -1491,8 +2141,37 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	md->force_ro.attr.name = "force_ro";
 	md->force_ro.attr.mode = S_IRUGO | S_IWUSR;
 	ret = device_create_file(disk_to_dev(md->disk), &md->force_ro);
-	if (ret)
+	if (ret) {
+		del_gendisk(md->disk);
+		return ret;
+	}
+
+	md->idle_stats.show = idle_stats_show;
+	sysfs_attr_init(&md->idle_stats.attr);
+	md->idle_stats.attr.name = "idle_stats";
+	md->idle_stats.attr.mode = S_IRUGO;
+	ret = device_create_file(disk_to_dev(md->disk), &md->idle_stats);
+	if (ret) {
+		device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 		del_gendisk(md->disk);
+		return ret;
+	}
+
+	if (md->flags & MMC_BLK_PACKED_CMD) {
+		md->packed_stats.show = packed_stats_show;
+		sysfs_attr_init(&md->packed_stats.attr);
+		md->packed_stats.attr.name = "packed_stats";
+		md->packed_stats.attr.mode = S_IRUGO;
+		ret = device_create_file(disk_to_dev(md->disk),
+					 &md->packed_stats);
+		if (ret) {
+			device_remove_file(disk_to_dev(md->disk),
+					   &md->idle_stats);
+			device_remove_file(disk_to_dev(md->disk),
+					   &md->force_ro);
+			del_gendisk(md->disk);
+		}
+	}
 
 	return ret;
 }
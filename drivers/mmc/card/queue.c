@@ -63,19 +63,28 @@ static int mmc_queue_thread(void *d)
 		if (req || mq->mqrq_prev->req) {
 			set_current_state(TASK_RUNNING);
 			mq->issue_fn(mq, req);
+			mq->last_active = jiffies;
 		} else {
-			/*
-			 * Since the queue is empty, start synchronous
-			 * background ops if there is a request for it.
-			 */
-			if (mmc_card_need_bkops(mq->card))
-				mmc_bkops_start(mq->card, true);
+			long timeout = MAX_SCHEDULE_TIMEOUT;
+
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
+				if (mq->idle_fn)
+					mq->idle_fn(mq, true);
 				break;
 			}
+			/*
+			 * The queue is empty, leave it to the idle handler to
+			 * run background ops and deferred discards once it
+			 * has stayed so for long enough.
+			 */
+			if (mq->idle_fn) {
+				timeout = mq->idle_fn(mq, false);
+				if (!timeout)
+					continue;
+			}
 			up(&mq->thread_sem);
-			schedule();
+			schedule_timeout(timeout);
 			down(&mq->thread_sem);
 		}
 
@@ -91,6 +100,22 @@ static int mmc_queue_thread(void *d)
 	return 0;
 }
 
+/*
+ * Whether a request is waiting to be fetched, used by the idle handler to
+ * back off from background work as soon as foreground I/O shows up.
+ */
+bool mmc_queue_busy(struct mmc_queue *mq)
+{
+	struct request_queue *q = mq->queue;
+	bool busy;
+
+	spin_lock_irq(q->queue_lock);
+	busy = blk_peek_request(q) != NULL;
+	spin_unlock_irq(q->queue_lock);
+
+	return busy;
+}
+
 /*
  * Generic MMC request handler.  This is called for any queue on a
  * particular host.  When the host is not busy, we look for a request
@@ -172,6 +197,7 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		limit = *mmc_dev(host)->dma_mask;
 
 	mq->card = card;
+	mq->last_active = jiffies;
 	mq->queue = blk_init_queue(mmc_request, lock);
 	if (!mq->queue)
 		return -ENOMEM;
@@ -184,6 +210,8 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
+	/* Writing whole erase blocks is what the card handles best */
+	blk_queue_io_opt(mq->queue, card->pref_erase << 9);
 	if (mmc_can_erase(card))
 		mmc_queue_setup_discard(mq->queue, card);
 
@@ -330,10 +358,43 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	kfree(mqrq_prev->bounce_buf);
 	mqrq_prev->bounce_buf = NULL;
 
+	mmc_packed_clean(mq);
+
 	mq->card = NULL;
 }
 EXPORT_SYMBOL(mmc_cleanup_queue);
 
+int mmc_packed_init(struct mmc_queue *mq, struct mmc_card *card)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+		struct mmc_queue_req *mqrq = &mq->mqrq[i];
+
+		/* the header is part of the DMA, keep it off the stack */
+		mqrq->packed = kzalloc(sizeof(struct mmc_packed), GFP_KERNEL);
+		if (!mqrq->packed) {
+			pr_warning("%s: unable to allocate packed cmd for "
+				   "mqrq[%d]\n", mmc_card_name(card), i);
+			mmc_packed_clean(mq);
+			return -ENOMEM;
+		}
+		INIT_LIST_HEAD(&mqrq->packed->list);
+	}
+
+	return 0;
+}
+
+void mmc_packed_clean(struct mmc_queue *mq)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+		kfree(mq->mqrq[i].packed);
+		mq->mqrq[i].packed = NULL;
+	}
+}
+
 /**
  * mmc_queue_suspend - suspend a MMC request queue
  * @mq: MMC queue to suspend
@@ -378,6 +439,32 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	}
 }
 
+/*
+ * The header block followed by the data of every packed request, as one
+ * sg list. Packing is never used along with the bounce buffer.
+ */
+static unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
+					    struct mmc_packed *packed,
+					    struct scatterlist *sg)
+{
+	struct scatterlist *__sg = sg;
+	unsigned int sg_len = 1;
+	struct request *req;
+
+	sg_set_buf(__sg, packed->cmd_hdr, sizeof(packed->cmd_hdr));
+	__sg++;
+
+	/* blk_rq_map_sg() ends the list at each request, undo that */
+	list_for_each_entry(req, &packed->list, queuelist) {
+		sg_len += blk_rq_map_sg(mq->queue, req, __sg);
+		__sg = sg + (sg_len - 1);
+		(__sg++)->page_link &= ~0x02;
+	}
+	sg_mark_end(sg + (sg_len - 1));
+
+	return sg_len;
+}
+
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
@@ -388,6 +475,11 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 	struct scatterlist *sg;
 	int i;
 
+	if (mmc_packed_cmd(mqrq->cmd_type)) {
+		BUG_ON(mqrq->bounce_buf);
+		return mmc_queue_packed_map_sg(mq, mqrq->packed, mqrq->sg);
+	}
+
 	if (!mqrq->bounce_buf)
 		return blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
 
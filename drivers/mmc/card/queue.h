@@ -12,6 +12,31 @@ struct mmc_blk_request {
 	struct mmc_data		data;
 };
 
+enum mmc_packed_type {
+	MMC_PACKED_NONE = 0,
+	MMC_PACKED_WRITE,
+};
+
+#define mmc_packed_cmd(type)	((type) != MMC_PACKED_NONE)
+#define mmc_packed_wr(type)	((type) == MMC_PACKED_WRITE)
+
+#define MMC_PACKED_NR_IDX	-1
+#define MMC_PACKED_NR_ZERO	0
+#define MMC_PACKED_NR_SINGLE	1
+
+/*
+ * A packed write sends the requests on list as a single CMD25, behind a
+ * header block holding the CMD23 and CMD25 arguments of every entry.
+ */
+struct mmc_packed {
+	struct list_head	list;
+	u32			cmd_hdr[128];	/* one 512 byte block */
+	unsigned int		blocks;		/* data blocks, no header */
+	u8			nr_entries;
+	u8			retries;
+	s16			idx_failure;	/* first entry to resend */
+};
+
 struct mmc_queue_req {
 	struct request		*req;
 	struct mmc_blk_request	brq;
@@ -20,6 +45,8 @@ struct mmc_queue_req {
 	struct scatterlist	*bounce_sg;
 	unsigned int		bounce_sg_len;
 	struct mmc_async_req	mmc_active;
+	enum mmc_packed_type	cmd_type;
+	struct mmc_packed	*packed;
 };
 
 struct mmc_queue {
@@ -28,6 +55,13 @@ struct mmc_queue {
 	struct semaphore	thread_sem;
 	unsigned int		flags;
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
+	/*
+	 * Called whenever the queue has run dry, returns the jiffies until
+	 * it wants to be called again or 0 once it did some work. force is
+	 * set on the way out, when nothing may be left pending.
+	 */
+	long			(*idle_fn)(struct mmc_queue *, bool force);
+	unsigned long		last_active;	/* jiffies, last request done */
 	void			*data;
 	struct request_queue	*queue;
 	struct mmc_queue_req	mqrq[2];
@@ -40,10 +74,14 @@ extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
 extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
 extern void mmc_queue_resume(struct mmc_queue *);
+extern bool mmc_queue_busy(struct mmc_queue *);
 
 extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 				     struct mmc_queue_req *);
 extern void mmc_queue_bounce_pre(struct mmc_queue_req *);
 extern void mmc_queue_bounce_post(struct mmc_queue_req *);
 
+extern int mmc_packed_init(struct mmc_queue *, struct mmc_card *);
+extern void mmc_packed_clean(struct mmc_queue *);
+
 #endif
@@ -14,8 +14,10 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/err.h>
 #include <linux/init.h>
+#include <linux/ktime.h>
 #include <linux/platform_device.h>
 #include <linux/clk.h>
 #include <linux/io.h>
@@ -26,6 +28,7 @@
 #include <linux/mmc/sd.h>
 #include <linux/regulator/consumer.h>
 #include <linux/delay.h>
+#include <linux/seq_file.h>
 
 #include <mach/gpio.h>
 #include <mach/sdhci.h>
@@ -121,6 +124,20 @@ struct tegra_sdhci_host {
 	bool is_rail_enabled;
 	struct clk *emc_clk;
 	unsigned int emc_max_clk;
+	/* tap picked by the last full tuning sweep, reused for the same card
+	 * at the same clock and bus mode */
+	struct {
+		bool valid;
+		bool cid_known;
+		u32 cid[4];
+		unsigned int clock;
+		u16 uhs_mode;
+		unsigned int tap;
+	} tuning;
+	unsigned int tuning_sweeps;
+	unsigned int tuning_reuses;
+	s64 last_tuning_us;
+	s64 max_tuning_us;
 };
 
 static u32 tegra_sdhci_readl(struct sdhci_host *host, int reg)
@@ -758,42 +775,24 @@ out:
 	return err;
 }
 
-static int sdhci_tegra_execute_tuning(struct sdhci_host *sdhci)
+/* tries every tap and returns the one 3/4 into the widest passing window */
+static int sdhci_tegra_sweep_taps(struct sdhci_host *sdhci, unsigned int *tap)
 {
 	int err;
-	u16 ctrl_2;
 	u8 *tap_delay_status;
 	unsigned int i = 0;
 	unsigned int temp_low_pass_tap = 0;
 	unsigned int temp_pass_window = 0;
 	unsigned int best_low_pass_tap = 0;
 	unsigned int best_pass_window = 0;
-	u32 ier;
-
-	/* Tuning is valid only in SDR104 and SDR50 modes */
-	ctrl_2 = sdhci_readw(sdhci, SDHCI_HOST_CONTROL2);
-	if (!(((ctrl_2 & SDHCI_CTRL_UHS_MASK) == SDHCI_CTRL_UHS_SDR104) ||
-		(((ctrl_2 & SDHCI_CTRL_UHS_MASK) == SDHCI_CTRL_UHS_SDR50) &&
-		(sdhci->flags & SDHCI_SDR50_NEEDS_TUNING))))
-			return 0;
 
-	tap_delay_status = kzalloc(MAX_TAP_VALUES, GFP_KERNEL);
+	tap_delay_status = kzalloc(MAX_TAP_VALUES, GFP_ATOMIC);
 	if (tap_delay_status == NULL) {
 		dev_err(mmc_dev(sdhci->mmc), "failed to allocate memory"
 			"for storing tap_delay_status\n");
 		return -ENOMEM;
 	}
 
-	/*
-	 * Disable all interrupts signalling.Enable interrupt status
-	 * detection for buffer read ready and data crc. We use
-	 * polling for tuning as it involves less overhead.
-	 */
-	ier = sdhci_readl(sdhci, SDHCI_INT_ENABLE);
-	sdhci_writel(sdhci, 0, SDHCI_SIGNAL_ENABLE);
-	sdhci_writel(sdhci, SDHCI_INT_DATA_AVAIL |
-		SDHCI_INT_DATA_CRC, SDHCI_INT_ENABLE);
-
 	/*
 	 * Set each tap delay value and run frequency tuning. After each
 	 * run, update the tap delay status as working or not working.
@@ -838,23 +837,161 @@ static int sdhci_tegra_execute_tuning(struct sdhci_host *sdhci)
 		mmc_hostname(sdhci->mmc), best_low_pass_tap,
 		(best_low_pass_tap + best_pass_window));
 
+	*tap = best_low_pass_tap + ((best_pass_window * 3) / 4);
+
+	kfree(tap_delay_status);
+
+	return 0;
+}
+
+static bool sdhci_tegra_tuning_cached(struct sdhci_host *sdhci, u16 uhs_mode)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct tegra_sdhci_host *tegra_host = pltfm_host->priv;
+	struct mmc_card *card = sdhci->mmc->card;
+
+	/*
+	 * A new card is always tuned before it is attached to the host, so
+	 * the sweep of that first init is the one the card's CID goes with.
+	 */
+	if (!tegra_host->tuning.valid || !card)
+		return false;
+
+	if (!tegra_host->tuning.cid_known) {
+		memcpy(tegra_host->tuning.cid, card->raw_cid,
+			sizeof(tegra_host->tuning.cid));
+		tegra_host->tuning.cid_known = true;
+	}
+
+	return !memcmp(tegra_host->tuning.cid, card->raw_cid,
+			sizeof(tegra_host->tuning.cid)) &&
+		tegra_host->tuning.clock == sdhci->mmc->ios.clock &&
+		tegra_host->tuning.uhs_mode == uhs_mode;
+}
+
+static int sdhci_tegra_execute_tuning(struct sdhci_host *sdhci)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct tegra_sdhci_host *tegra_host = pltfm_host->priv;
+	int err;
+	u16 ctrl_2;
+	unsigned int tap;
+	bool drift;
+	ktime_t start;
+	u32 ier;
+
+	/* Tuning is valid only in SDR104 and SDR50 modes */
+	ctrl_2 = sdhci_readw(sdhci, SDHCI_HOST_CONTROL2);
+	if (!(((ctrl_2 & SDHCI_CTRL_UHS_MASK) == SDHCI_CTRL_UHS_SDR104) ||
+		(((ctrl_2 & SDHCI_CTRL_UHS_MASK) == SDHCI_CTRL_UHS_SDR50) &&
+		(sdhci->flags & SDHCI_SDR50_NEEDS_TUNING))))
+			return 0;
+
+	start = ktime_get();
+
+	/* CRC errors on the data lines mean the sampling point drifted */
+	drift = sdhci->flags & SDHCI_TUNING_CRC_ERR;
+	sdhci->flags &= ~SDHCI_TUNING_CRC_ERR;
+
+	/*
+	 * Disable all interrupts signalling.Enable interrupt status
+	 * detection for buffer read ready and data crc. We use
+	 * polling for tuning as it involves less overhead.
+	 */
+	ier = sdhci_readl(sdhci, SDHCI_INT_ENABLE);
+	sdhci_writel(sdhci, 0, SDHCI_SIGNAL_ENABLE);
+	sdhci_writel(sdhci, SDHCI_INT_DATA_AVAIL |
+		SDHCI_INT_DATA_CRC, SDHCI_INT_ENABLE);
+
+	/* Same card at the same clock: check the tap it was tuned to */
+	if (!drift &&
+	    sdhci_tegra_tuning_cached(sdhci, ctrl_2 & SDHCI_CTRL_UHS_MASK)) {
+		sdhci_tegra_set_tap_delay(sdhci, tegra_host->tuning.tap);
+		err = sdhci_tegra_run_frequency_tuning(sdhci);
+		if (!err) {
+			tegra_host->tuning_reuses++;
+			goto out;
+		}
+	}
+
+	tegra_host->tuning.valid = false;
+	err = sdhci_tegra_sweep_taps(sdhci, &tap);
+	if (err)
+		goto out;
+
 	/* Set the best tap */
-	sdhci_tegra_set_tap_delay(sdhci,
-		(best_low_pass_tap + ((best_pass_window * 3) / 4)));
+	sdhci_tegra_set_tap_delay(sdhci, tap);
 
 	/* Run frequency tuning */
 	err = sdhci_tegra_run_frequency_tuning(sdhci);
+	tegra_host->tuning_sweeps++;
+	if (!err) {
+		tegra_host->tuning.valid = true;
+		tegra_host->tuning.cid_known = false;
+		tegra_host->tuning.clock = sdhci->mmc->ios.clock;
+		tegra_host->tuning.uhs_mode = ctrl_2 & SDHCI_CTRL_UHS_MASK;
+		tegra_host->tuning.tap = tap;
+		/* a retune of the current card keeps its CID */
+		sdhci_tegra_tuning_cached(sdhci, tegra_host->tuning.uhs_mode);
+	}
 
+out:
 	/* Enable the normal interrupts signalling */
 	sdhci_writel(sdhci, ier, SDHCI_INT_ENABLE);
 	sdhci_writel(sdhci, ier, SDHCI_SIGNAL_ENABLE);
 
-	if (tap_delay_status)
-		kfree(tap_delay_status);
+	tegra_host->last_tuning_us = ktime_us_delta(ktime_get(), start);
+	if (tegra_host->last_tuning_us > tegra_host->max_tuning_us)
+		tegra_host->max_tuning_us = tegra_host->last_tuning_us;
 
 	return err;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int sdhci_tegra_tuning_show(struct seq_file *s, void *unused)
+{
+	struct sdhci_host *sdhci = s->private;
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
+	struct tegra_sdhci_host *tegra_host = pltfm_host->priv;
+
+	if (tegra_host->tuning.valid)
+		seq_printf(s, "tap: %u at %u Hz\n", tegra_host->tuning.tap,
+			tegra_host->tuning.clock);
+	else
+		seq_printf(s, "tap: none\n");
+	seq_printf(s, "full sweeps: %u\n", tegra_host->tuning_sweeps);
+	seq_printf(s, "cached tap reuses: %u\n", tegra_host->tuning_reuses);
+	seq_printf(s, "last tuning: %lld us\n", tegra_host->last_tuning_us);
+	seq_printf(s, "max tuning: %lld us\n", tegra_host->max_tuning_us);
+
+	return 0;
+}
+
+static int sdhci_tegra_tuning_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sdhci_tegra_tuning_show, inode->i_private);
+}
+
+static const struct file_operations sdhci_tegra_tuning_fops = {
+	.open		= sdhci_tegra_tuning_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* removed along with the rest of the host's debugfs directory */
+static void sdhci_tegra_debug_add(struct sdhci_host *sdhci)
+{
+	if (sdhci->mmc->debugfs_root)
+		debugfs_create_file("tuning", S_IRUSR, sdhci->mmc->debugfs_root,
+			sdhci, &sdhci_tegra_tuning_fops);
+}
+#else
+static inline void sdhci_tegra_debug_add(struct sdhci_host *sdhci)
+{
+}
+#endif
+
 static int tegra_sdhci_suspend(struct sdhci_host *sdhci, pm_message_t state)
 {
 	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(sdhci);
@@ -1143,6 +1280,7 @@ static int __devinit sdhci_tegra_probe(struct platform_device *pdev)
 	host->mmc->pm_caps |= MMC_PM_KEEP_POWER | MMC_PM_IGNORE_PM_NOTIFY;
 	if (plat->mmc_data.built_in) {
 		host->mmc->caps |= MMC_CAP_NONREMOVABLE;
+		host->mmc->caps2 |= MMC_CAP2_PACKED_WR;
 	}
 	host->mmc->pm_flags |= MMC_PM_IGNORE_PM_NOTIFY;
 
@@ -1163,6 +1301,11 @@ static int __devinit sdhci_tegra_probe(struct platform_device *pdev)
 	if (rc)
 		goto err_add_host;
 
+	sdhci_tegra_debug_add(host);
+
+	/* no resume ordering against other devices beyond the parent */
+	device_enable_async_suspend(&pdev->dev);
+
 	return 0;
 
 err_add_host:
@@ -48,6 +48,11 @@
  */
 
 #define EEM_HEAD	2		/* 2 byte header */
+#define EEM_RX_BUNDLE	8192		/* rx urb, room for a bundle */
+
+static unsigned tx_bundle = 4096;
+module_param(tx_bundle, uint, 0444);
+MODULE_PARM_DESC(tx_bundle, "max bytes of frames bundled per tx urb, 0 = off");
 
 /*-------------------------------------------------------------------------*/
 
@@ -94,12 +99,17 @@ static int eem_bind(struct usbnet *dev, struct usb_interface *intf)
 
 	dev->net->hard_header_len += EEM_HEAD + ETH_FCS_LEN;
 
+	/* let the device bundle several frames per transfer, as we do */
+	dev->rx_urb_size = EEM_RX_BUNDLE;
+	dev->tx_bundle_size = tx_bundle;
+
 	return 0;
 }
 
 /*
  * EEM permits packing multiple Ethernet frames into USB transfers
- * (a "bundle"), but for TX we don't try to do that.
+ * (a "bundle").  Each frame is framed on its own here; usbnet gathers
+ * them into bundles under load (see tx_bundle_size).
  */
 static struct sk_buff *eem_tx_fixup(struct usbnet *dev, struct sk_buff *skb,
 				       gfp_t flags)
@@ -79,6 +79,12 @@
 // between wakeups
 #define UNLINK_TIMEOUT_MS	3
 
+// completed urbs handled per NAPI poll; multi-packet urbs count once
+#define NAPI_WEIGHT		64
+
+// only bundle tx frames once this many urbs are already in flight
+#define TX_BUNDLE_BACKLOG	2
+
 /*-------------------------------------------------------------------------*/
 
 // randomly generated ethernet address
@@ -219,19 +225,10 @@ static int init_status (struct usbnet *dev, struct usb_interface *intf)
 	return 0;
 }
 
-/* Passes this packet up the stack, updating its accounting.
- * Some link protocols batch packets, so their rx_fixup paths
- * can return clones as well as just modify the original skb.
- */
-void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+static void usbnet_deliver(struct usbnet *dev, struct sk_buff *skb, bool napi)
 {
 	int	status;
 
-	if (test_bit(EVENT_RX_PAUSED, &dev->flags)) {
-		skb_queue_tail(&dev->rxq_pause, skb);
-		return;
-	}
-
 	skb->protocol = eth_type_trans (skb, dev->net);
 	dev->net->stats.rx_packets++;
 	dev->net->stats.rx_bytes += skb->len;
@@ -239,11 +236,31 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 	netif_dbg(dev, rx_status, dev->net, "< rx, len %zu, type 0x%x\n",
 		  skb->len + sizeof (struct ethhdr), skb->protocol);
 	memset (skb->cb, 0, sizeof (struct skb_data));
+	if (napi) {
+		if (napi_gro_receive(&dev->napi, skb) == GRO_DROP)
+			netif_dbg(dev, rx_err, dev->net, "gro dropped\n");
+		return;
+	}
 	status = netif_rx (skb);
 	if (status != NET_RX_SUCCESS)
 		netif_dbg(dev, rx_err, dev->net,
 			  "netif_rx status %d\n", status);
 }
+
+/* Passes this packet up the stack, updating its accounting.
+ * Some link protocols batch packets, so their rx_fixup paths
+ * can return clones as well as just modify the original skb.
+ * rx_fixup only runs from usbnet_poll(), so this goes through GRO.
+ */
+void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+{
+	if (test_bit(EVENT_RX_PAUSED, &dev->flags)) {
+		skb_queue_tail(&dev->rxq_pause, skb);
+		return;
+	}
+
+	usbnet_deliver(dev, skb, true);
+}
 EXPORT_SYMBOL_GPL(usbnet_skb_return);
 
 
@@ -308,9 +325,8 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 	spin_unlock(&list->lock);
 	spin_lock(&dev->done.lock);
 	__skb_queue_tail(&dev->done, skb);
-	if (dev->done.qlen == 1)
-		tasklet_schedule(&dev->bh);
 	spin_unlock_irqrestore(&dev->done.lock, flags);
+	napi_schedule(&dev->napi);
 	return old_state;
 }
 
@@ -340,8 +356,21 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 	int			retval = 0;
 	unsigned long		lockflags;
 	size_t			size = dev->rx_urb_size;
+	unsigned		align = dev->udev->bus->dma_align;
 
-	skb = __netdev_alloc_skb_ip_align(dev->net, size, flags);
+	/*
+	 * An IP aligned buffer would be bounced by hosts that need aligned
+	 * DMA, a copy of the whole URB that costs more than the unaligned
+	 * header accesses.
+	 */
+	if (align) {
+		skb = __netdev_alloc_skb(dev->net, size + align - 1, flags);
+		if (skb)
+			skb_reserve(skb, PTR_ALIGN(skb->data, align) -
+				    skb->data);
+	} else {
+		skb = __netdev_alloc_skb_ip_align(dev->net, size, flags);
+	}
 	if (!skb) {
 		netif_dbg(dev, rx_err, dev->net, "no rx skb\n");
 		usbnet_defer_kevent (dev, EVENT_RX_MEMORY);
@@ -568,7 +597,7 @@ void usbnet_resume_rx(struct usbnet *dev)
 	clear_bit(EVENT_RX_PAUSED, &dev->flags);
 
 	while ((skb = skb_dequeue(&dev->rxq_pause)) != NULL) {
-		usbnet_skb_return(dev, skb);
+		usbnet_deliver(dev, skb, false);
 		num++;
 	}
 
@@ -648,6 +677,19 @@ EXPORT_SYMBOL_GPL(usbnet_unlink_rx_urbs);
 
 /*-------------------------------------------------------------------------*/
 
+/* free what completed after usbnet_poll() was disabled */
+static void usbnet_purge_done(struct usbnet *dev)
+{
+	struct sk_buff		*skb;
+	struct skb_data		*entry;
+
+	while ((skb = skb_dequeue (&dev->done))) {
+		entry = (struct skb_data *) skb->cb;
+		usb_free_urb (entry->urb);
+		dev_kfree_skb (skb);
+	}
+}
+
 // precondition: never called in_interrupt
 static void usbnet_terminate_urbs(struct usbnet *dev)
 {
@@ -702,9 +744,17 @@ int usbnet_stop (struct net_device *net)
 				   info->description);
 	}
 
+	netif_tx_lock_bh(net);
+	dev_kfree_skb(dev->tx_bundle);
+	dev->tx_bundle = NULL;
+	netif_tx_unlock_bh(net);
+
 	if (!(info->flags & FLAG_AVOID_UNLINK_URBS))
 		usbnet_terminate_urbs(dev);
 
+	napi_disable(&dev->napi);
+	usbnet_purge_done(dev);
+
 	usb_kill_urb(dev->interrupt);
 
 	usbnet_purge_paused_rxq(dev);
@@ -775,6 +825,7 @@ int usbnet_open (struct net_device *net)
 	}
 
 	set_bit(EVENT_DEV_OPEN, &dev->flags);
+	napi_enable(&dev->napi);
 	netif_start_queue (net);
 	netif_info(dev, ifup, dev->net,
 		   "open: enable queueing (rx %d, tx %d) mtu %d %s framing\n",
@@ -791,8 +842,10 @@ int usbnet_open (struct net_device *net)
 	tasklet_schedule (&dev->bh);
 	if (info->manage_power) {
 		retval = info->manage_power(dev, 1);
-		if (retval < 0)
+		if (retval < 0) {
+			napi_disable(&dev->napi);
 			goto done;
+		}
 		usb_autopm_put_interface(dev->intf);
 	}
 	return retval;
@@ -1022,7 +1075,7 @@ static void tx_complete (struct urb *urb)
 
 	if (urb->status == 0) {
 		if (!(dev->driver_info->flags & FLAG_MULTI_PACKET))
-			dev->net->stats.tx_packets++;
+			dev->net->stats.tx_packets += entry->packets;
 		dev->net->stats.tx_bytes += entry->length;
 	} else {
 		dev->net->stats.tx_errors++;
@@ -1077,33 +1130,17 @@ EXPORT_SYMBOL_GPL(usbnet_tx_timeout);
 
 /*-------------------------------------------------------------------------*/
 
-netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
-				     struct net_device *net)
+static void usbnet_tx_submit(struct usbnet *dev, struct sk_buff *skb,
+			     unsigned packets)
 {
-	struct usbnet		*dev = netdev_priv(net);
-	int			length;
+	struct net_device	*net = dev->net;
+	int			length = skb->len;
 	struct urb		*urb = NULL;
 	struct skb_data		*entry;
 	struct driver_info	*info = dev->driver_info;
 	unsigned long		flags;
 	int retval;
 
-	// some devices want funky USB-level framing, for
-	// win32 driver (usually) and/or hardware quirks
-	if (info->tx_fixup) {
-		skb = info->tx_fixup (dev, skb, GFP_ATOMIC);
-		if (!skb) {
-			if (netif_msg_tx_err(dev)) {
-				netif_dbg(dev, tx_err, dev->net, "can't tx_fixup skb\n");
-				goto drop;
-			} else {
-				/* cdc_ncm collected packet; waits for more */
-				goto not_drop;
-			}
-		}
-	}
-	length = skb->len;
-
 	if (!(urb = usb_alloc_urb (0, GFP_ATOMIC))) {
 		netif_dbg(dev, tx_err, dev->net, "no urb\n");
 		goto drop;
@@ -1113,6 +1150,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	entry->urb = urb;
 	entry->dev = dev;
 	entry->length = length;
+	entry->packets = packets;
 
 	usb_fill_bulk_urb (urb, dev->udev, dev->out,
 			skb->data, skb->len, tx_complete, skb);
@@ -1123,6 +1161,8 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	 * NOTE2: CDC NCM specification is different from CDC ECM when
 	 * handling ZLP/short packets, so cdc_ncm driver will make short
 	 * packet itself if needed.
+	 * NOTE3: tx bundles never end on a packet boundary, see
+	 * usbnet_tx_bundle().
 	 */
 	if (length % dev->maxpacket == 0) {
 		if (!(info->flags & FLAG_SEND_ZLP)) {
@@ -1153,7 +1193,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 		netif_stop_queue(net);
 		spin_unlock_irqrestore(&dev->txq.lock, flags);
 		netdev_dbg(dev->net, "Delaying transmission for resumption\n");
-		goto deferred;
+		return;
 	}
 #endif
 
@@ -1179,17 +1219,131 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	if (retval) {
 		netif_dbg(dev, tx_err, dev->net, "drop, code %d\n", retval);
 drop:
-		dev->net->stats.tx_dropped++;
-not_drop:
-		if (skb)
-			dev_kfree_skb_any (skb);
+		dev->net->stats.tx_dropped += packets;
+		dev_kfree_skb_any (skb);
 		usb_free_urb (urb);
 	} else
 		netif_dbg(dev, tx_queued, dev->net,
 			  "> tx, len %d, type 0x%x\n", length, skb->protocol);
-#ifdef CONFIG_PM
-deferred:
-#endif
+}
+
+/* Caller holds the tx lock.  The bundle is only ever flushed here, from
+ * usbnet_poll() as tx urbs complete, and from usbnet_stop().
+ */
+static void usbnet_tx_flush(struct usbnet *dev)
+{
+	struct sk_buff		*skb = dev->tx_bundle;
+
+	if (!skb)
+		return;
+	dev->tx_bundle = NULL;
+	usbnet_tx_submit(dev, skb, dev->tx_bundle_packets);
+}
+
+/* Minidrivers whose framing lets several tx_fixup() results share one
+ * transfer (EEM bundles, for example) set tx_bundle_size in bind().
+ * While the link keeps up every frame still gets its own urb; once a
+ * couple of urbs are in flight, later frames are copied into a bundle
+ * that goes out when the next tx urb completes or when it fills up,
+ * trading one copy for far fewer urbs and completion interrupts.
+ *
+ * A bundle of several frames never ends on a maxpacket boundary, so
+ * usbnet_tx_submit() never pads it with a byte the framing can't parse.
+ *
+ * Returns true if the frame was consumed.  Caller holds the tx lock.
+ */
+static bool usbnet_tx_bundle(struct usbnet *dev, struct sk_buff *skb)
+{
+	struct sk_buff		*bundle = dev->tx_bundle;
+	unsigned		len;
+
+	if (!bundle && dev->txq.qlen < TX_BUNDLE_BACKLOG)
+		return false;
+
+	if (bundle) {
+		len = bundle->len + skb->len;
+		if (len > dev->tx_bundle_size || len % dev->maxpacket == 0) {
+			usbnet_tx_flush(dev);
+			bundle = NULL;
+		}
+	}
+
+	if (!bundle) {
+		if (skb->len > dev->tx_bundle_size / 2)
+			return false;
+		bundle = alloc_skb(dev->tx_bundle_size, GFP_ATOMIC);
+		if (!bundle)
+			return false;
+		dev->tx_bundle = bundle;
+		dev->tx_bundle_packets = 0;
+	}
+
+	memcpy(skb_put(bundle, skb->len), skb->data, skb->len);
+	dev->tx_bundle_packets++;
+	dev_kfree_skb_any(skb);
+	return true;
+}
+
+/* Page fragments (sendfile, splice) are copied once into a linear skb
+ * here rather than by the socket layer, and a partial checksum is
+ * resolved unless the minidriver offloads it.  EHCI would end a bulk
+ * transfer at the first fragment that isn't a multiple of maxpacket, so
+ * the fragments can't go out as an sg urb as they are.
+ */
+static struct sk_buff *usbnet_tx_flatten(struct usbnet *dev,
+					 struct sk_buff *skb)
+{
+	struct sk_buff		*flat = skb;
+
+	if (skb_is_nonlinear(skb)) {
+		flat = skb_copy_expand(skb, skb_headroom(skb),
+				       dev->net->needed_tailroom + 4,
+				       GFP_ATOMIC);
+		dev_kfree_skb_any(skb);
+		if (!flat)
+			return NULL;
+	}
+	if (dev->tx_sw_csum && flat->ip_summed == CHECKSUM_PARTIAL &&
+	    skb_checksum_help(flat)) {
+		dev_kfree_skb_any(flat);
+		return NULL;
+	}
+	return flat;
+}
+
+netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
+				     struct net_device *net)
+{
+	struct usbnet		*dev = netdev_priv(net);
+	struct driver_info	*info = dev->driver_info;
+
+	if (skb_is_nonlinear(skb) ||
+	    (dev->tx_sw_csum && skb->ip_summed == CHECKSUM_PARTIAL)) {
+		skb = usbnet_tx_flatten(dev, skb);
+		if (!skb) {
+			dev->net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+	}
+
+	// some devices want funky USB-level framing, for
+	// win32 driver (usually) and/or hardware quirks
+	if (info->tx_fixup) {
+		skb = info->tx_fixup (dev, skb, GFP_ATOMIC);
+		if (!skb) {
+			/* cdc_ncm collected packet; waits for more */
+			if (netif_msg_tx_err(dev)) {
+				netif_dbg(dev, tx_err, dev->net, "can't tx_fixup skb\n");
+				dev->net->stats.tx_dropped++;
+			}
+			return NETDEV_TX_OK;
+		}
+	}
+
+	if (dev->tx_bundle_size && usbnet_tx_bundle(dev, skb))
+		return NETDEV_TX_OK;
+
+	usbnet_tx_submit(dev, skb, 1);
 	return NETDEV_TX_OK;
 }
 EXPORT_SYMBOL_GPL(usbnet_start_xmit);
@@ -1201,25 +1355,6 @@ EXPORT_SYMBOL_GPL(usbnet_start_xmit);
 static void usbnet_bh (unsigned long param)
 {
 	struct usbnet		*dev = (struct usbnet *) param;
-	struct sk_buff		*skb;
-	struct skb_data		*entry;
-
-	while ((skb = skb_dequeue (&dev->done))) {
-		entry = (struct skb_data *) skb->cb;
-		switch (entry->state) {
-		case rx_done:
-			entry->state = rx_cleanup;
-			rx_process (dev, skb);
-			continue;
-		case tx_done:
-		case rx_cleanup:
-			usb_free_urb (entry->urb);
-			dev_kfree_skb (skb);
-			continue;
-		default:
-			netdev_dbg(dev->net, "bogus skb state %d\n", entry->state);
-		}
-	}
 
 	// waiting for all pending urbs to complete?
 	if (dev->wait) {
@@ -1261,6 +1396,58 @@ static void usbnet_bh (unsigned long param)
 }
 
 
+/* NAPI poll: completed urbs queued by defer_bh(); rx frames go up
+ * through GRO, and a pending tx bundle is flushed as tx urbs retire.
+ * Refilling rx urbs and waking the tx queue are left to usbnet_bh().
+ */
+static int usbnet_poll(struct napi_struct *napi, int budget)
+{
+	struct usbnet		*dev = container_of(napi, struct usbnet, napi);
+	struct sk_buff		*skb;
+	struct skb_data		*entry;
+	int			work = 0;
+	bool			tx = false;
+
+	while (work < budget && (skb = skb_dequeue (&dev->done))) {
+		entry = (struct skb_data *) skb->cb;
+		work++;
+		switch (entry->state) {
+		case rx_done:
+			entry->state = rx_cleanup;
+			rx_process (dev, skb);
+			continue;
+		case tx_done:
+			tx = true;
+			/* FALLTHROUGH */
+		case rx_cleanup:
+			usb_free_urb (entry->urb);
+			dev_kfree_skb (skb);
+			continue;
+		default:
+			netdev_dbg(dev->net, "bogus skb state %d\n", entry->state);
+		}
+	}
+
+	if (tx && dev->tx_bundle) {
+		netif_tx_lock(dev->net);
+		usbnet_tx_flush(dev);
+		netif_tx_unlock(dev->net);
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* defer_bh() may have queued more after our last dequeue */
+		if (!skb_queue_empty(&dev->done))
+			napi_schedule(napi);
+	}
+
+	if (dev->wait || dev->rxq.qlen < RX_QLEN (dev) ||
+	    netif_queue_stopped (dev->net))
+		tasklet_schedule (&dev->bh);
+	return work;
+}
+
+
 /*-------------------------------------------------------------------------
  *
  * USB Device Driver support
@@ -1298,6 +1485,7 @@ void usbnet_disconnect (struct usb_interface *intf)
 	usb_kill_urb(dev->interrupt);
 	usb_free_urb(dev->interrupt);
 
+	usbnet_purge_done(dev);
 	free_netdev(net);
 	usb_put_dev (xdev);
 }
@@ -1387,6 +1575,7 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	dev->delay.function = usbnet_bh;
 	dev->delay.data = (unsigned long) dev;
 	init_timer (&dev->delay);
+	netif_napi_add(net, &dev->napi, usbnet_poll, NAPI_WEIGHT);
 	mutex_init (&dev->phy_mutex);
 
 	dev->net = net;
@@ -1462,6 +1651,15 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	if ((dev->driver_info->flags & FLAG_WWAN) != 0)
 		SET_NETDEV_DEVTYPE(net, &wwan_type);
 
+	/* take page fragments from the stack, see usbnet_tx_flatten() */
+	if (!(net->features & NETIF_F_ALL_CSUM)) {
+		dev->tx_sw_csum = 1;
+		net->hw_features |= NETIF_F_HW_CSUM;
+		net->features |= NETIF_F_HW_CSUM;
+	}
+	net->hw_features |= NETIF_F_SG;
+	net->features |= NETIF_F_SG;
+
 	status = register_netdev (net);
 	if (status)
 		goto out3;
@@ -1856,7 +1856,8 @@ wlan_get_rxreorder_tbl(mlan_private * priv, rx_reorder_tbl * buf)
         ptbl->win_size = rxReorderTblPtr->win_size;
         ptbl->amsdu = rxReorderTblPtr->amsdu;
         for (i = 0; i < rxReorderTblPtr->win_size; ++i) {
-            if (rxReorderTblPtr->rx_reorder_ptr[i])
+            if (rxReorderTblPtr->
+                rx_reorder_ptr[wlan_11n_rxreorder_slot(rxReorderTblPtr, i)])
                 ptbl->buffer[i] = MTRUE;
             else
                 ptbl->buffer[i] = MFALSE;
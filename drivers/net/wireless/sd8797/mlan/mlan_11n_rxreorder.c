@@ -119,6 +119,199 @@ wlan_11n_dispatch_pkt(t_void * priv, t_void * payload)
     return ret;
 }
 
+/**
+ *  @brief This function returns the TA/TID hash bucket of a reorder table
+ *
+ *  @param ta       TA of the reorder table
+ *  @param tid      TID of the reorder table
+ *
+ *  @return         Index in rx_reorder_hash
+ */
+static INLINE t_u32
+wlan_11n_rxreorder_hash(t_u8 * ta, int tid)
+{
+    return (ta[4] ^ ta[5] ^ tid) & (RX_REORDER_HASH_SIZE - 1);
+}
+
+/**
+ *  @brief This function returns the index of the lowest set bit
+ *
+ *  @param word     A non-zero 32 bit value
+ *
+ *  @return         Bit index 0 - 31
+ */
+static INLINE int
+wlan_11n_lowest_bit(t_u32 word)
+{
+    int bit = 0;
+
+    if (!(word & 0xffff)) {
+        word >>= 16;
+        bit += 16;
+    }
+    if (!(word & 0xff)) {
+        word >>= 8;
+        bit += 8;
+    }
+    if (!(word & 0xf)) {
+        word >>= 4;
+        bit += 4;
+    }
+    if (!(word & 0x3)) {
+        word >>= 2;
+        bit += 2;
+    }
+    if (!(word & 0x1))
+        bit += 1;
+    return bit;
+}
+
+/**
+ *  @brief This function returns the index of the highest set bit
+ *
+ *  @param word     A non-zero 32 bit value
+ *
+ *  @return         Bit index 0 - 31
+ */
+static INLINE int
+wlan_11n_highest_bit(t_u32 word)
+{
+    int bit = 0;
+
+    if (word & 0xffff0000) {
+        word >>= 16;
+        bit += 16;
+    }
+    if (word & 0xff00) {
+        word >>= 8;
+        bit += 8;
+    }
+    if (word & 0xf0) {
+        word >>= 4;
+        bit += 4;
+    }
+    if (word & 0xc) {
+        word >>= 2;
+        bit += 2;
+    }
+    if (word & 0x2)
+        bit += 1;
+    return bit;
+}
+
+/**
+ *  @brief This function finds the first slot in [lo, hi) whose
+ *  		occupancy bit matches, a word at a time
+ *
+ *  @param bitmap   A pointer to the occupancy bitmap
+ *  @param lo       First slot to check
+ *  @param hi       End of the slot range
+ *  @param set      MTRUE to find an occupied slot, MFALSE for a hole
+ *
+ *  @return         Matching slot, or hi if there is none
+ */
+static int
+wlan_11n_bitmap_next(t_u32 * bitmap, int lo, int hi, t_u8 set)
+{
+    t_u32 word;
+
+    while (lo < hi) {
+        word = bitmap[lo >> 5];
+        if (!set)
+            word = ~word;
+        word >>= (lo & 31);
+        if (word) {
+            lo += wlan_11n_lowest_bit(word);
+            return MIN(lo, hi);
+        }
+        lo = (lo | 31) + 1;
+    }
+    return hi;
+}
+
+/**
+ *  @brief This function finds the last occupied slot in [lo, hi),
+ *  		a word at a time
+ *
+ *  @param bitmap   A pointer to the occupancy bitmap
+ *  @param lo       First slot of the range
+ *  @param hi       End of the slot range
+ *
+ *  @return         Last occupied slot, or -1 if there is none
+ */
+static int
+wlan_11n_bitmap_last(t_u32 * bitmap, int lo, int hi)
+{
+    t_u32 word;
+    int base;
+
+    while (hi > lo) {
+        base = (hi - 1) & ~31;
+        word = bitmap[base >> 5];
+        if (hi - base < 32)
+            word &= (1U << (hi - base)) - 1;
+        if (word) {
+            base += wlan_11n_highest_bit(word);
+            return (base >= lo) ? base : -1;
+        }
+        hi = base;
+    }
+    return -1;
+}
+
+/**
+ *  @brief This function finds the first window offset in [offset, end)
+ *  		whose slot occupancy matches
+ *
+ *  @param rx_reor_tbl_ptr  A pointer to structure RxReorderTbl
+ *  @param offset           First offset from start_win to check
+ *  @param end              End offset, not more than win_size
+ *  @param set              MTRUE to find a packet, MFALSE for a hole
+ *
+ *  @return                 Matching offset, or end if there is none
+ */
+static int
+wlan_11n_rxreorder_next(RxReorderTbl * rx_reor_tbl_ptr, int offset, int end,
+                        t_u8 set)
+{
+    int head = rx_reor_tbl_ptr->win_head;
+    int first = rx_reor_tbl_ptr->win_size - head;
+    int hi, slot;
+
+    /* Offsets [0, first) live in slots [head, win_size) */
+    if (offset < first) {
+        hi = head + MIN(end, first);
+        slot = wlan_11n_bitmap_next(rx_reor_tbl_ptr->win_bitmap,
+                                    head + offset, hi, set);
+        if (slot < hi)
+            return slot - head;
+        offset = first;
+    }
+    /* The remaining offsets wrap around to slots [0, head) */
+    if (offset < end)
+        return wlan_11n_bitmap_next(rx_reor_tbl_ptr->win_bitmap,
+                                    offset - first, end - first, set) + first;
+    return end;
+}
+
+/**
+ *  @brief This function takes the packet out of a reorder slot
+ *
+ *  @param rx_reor_tbl_ptr  A pointer to structure RxReorderTbl
+ *  @param slot             Slot index in rx_reorder_ptr
+ *
+ *  @return                 The packet held in the slot
+ */
+static INLINE t_void *
+wlan_11n_rxreorder_take(RxReorderTbl * rx_reor_tbl_ptr, int slot)
+{
+    t_void *rx_tmp_ptr = rx_reor_tbl_ptr->rx_reorder_ptr[slot];
+
+    rx_reor_tbl_ptr->rx_reorder_ptr[slot] = MNULL;
+    rx_reor_tbl_ptr->win_bitmap[slot >> 5] &= ~(1U << (slot & 31));
+    return rx_tmp_ptr;
+}
+
 /**
  *  @brief This function restarts the reordering timeout timer
  *
@@ -162,7 +355,7 @@ wlan_11n_dispatch_pkt_until_start_win(t_void * priv,
                                       RxReorderTbl * rx_reor_tbl_ptr,
                                       int start_win)
 {
-    int no_pkt_to_send, i, xchg;
+    int no_pkt_to_send, i;
     mlan_status ret = MLAN_STATUS_SUCCESS;
     void *rx_tmp_ptr = MNULL;
     mlan_private *pmpriv = (mlan_private *) priv;
@@ -173,34 +366,26 @@ wlan_11n_dispatch_pkt_until_start_win(t_void * priv,
         MIN((start_win - rx_reor_tbl_ptr->start_win),
             rx_reor_tbl_ptr->win_size) : rx_reor_tbl_ptr->win_size;
 
-    for (i = 0; i < no_pkt_to_send; ++i) {
+    /* Only visit the occupied slots, holes are skipped via the bitmap */
+    for (i = 0;; ++i) {
         pmpriv->adapter->callbacks.moal_spin_lock(pmpriv->adapter->pmoal_handle,
                                                   pmpriv->rx_pkt_lock);
-        rx_tmp_ptr = MNULL;
-        if (rx_reor_tbl_ptr->rx_reorder_ptr[i]) {
-            rx_tmp_ptr = rx_reor_tbl_ptr->rx_reorder_ptr[i];
-            rx_reor_tbl_ptr->rx_reorder_ptr[i] = MNULL;
-        }
+        i = wlan_11n_rxreorder_next(rx_reor_tbl_ptr, i, no_pkt_to_send, MTRUE);
+        if (i >= no_pkt_to_send)
+            break;
+        rx_tmp_ptr = wlan_11n_rxreorder_take(rx_reor_tbl_ptr,
+                                             wlan_11n_rxreorder_slot
+                                             (rx_reor_tbl_ptr, i));
         pmpriv->adapter->callbacks.moal_spin_unlock(pmpriv->adapter->
                                                     pmoal_handle,
                                                     pmpriv->rx_pkt_lock);
-        if (rx_tmp_ptr)
-            wlan_11n_dispatch_pkt(priv, rx_tmp_ptr);
-    }
-
-    pmpriv->adapter->callbacks.moal_spin_lock(pmpriv->adapter->pmoal_handle,
-                                              pmpriv->rx_pkt_lock);
-    /*
-     * We don't have a circular buffer, hence use rotation to simulate
-     * circular buffer
-     */
-    xchg = rx_reor_tbl_ptr->win_size - no_pkt_to_send;
-    for (i = 0; i < xchg; ++i) {
-        rx_reor_tbl_ptr->rx_reorder_ptr[i] =
-            rx_reor_tbl_ptr->rx_reorder_ptr[no_pkt_to_send + i];
-        rx_reor_tbl_ptr->rx_reorder_ptr[no_pkt_to_send + i] = MNULL;
+        wlan_11n_dispatch_pkt(priv, rx_tmp_ptr);
     }
 
+    /* The slots are circular, moving the window only moves its head */
+    if (no_pkt_to_send < rx_reor_tbl_ptr->win_size)
+        rx_reor_tbl_ptr->win_head =
+            wlan_11n_rxreorder_slot(rx_reor_tbl_ptr, no_pkt_to_send);
     rx_reor_tbl_ptr->start_win = start_win;
     pmpriv->adapter->callbacks.moal_spin_unlock(pmpriv->adapter->pmoal_handle,
                                                 pmpriv->rx_pkt_lock);
@@ -242,46 +427,40 @@ wlan_11n_display_tbl_ptr(pmlan_adapter pmadapter,
 static mlan_status
 wlan_11n_scan_and_dispatch(t_void * priv, RxReorderTbl * rx_reor_tbl_ptr)
 {
-    int i, j, xchg;
+    int i, no_pkt_to_send;
     mlan_status ret = MLAN_STATUS_SUCCESS;
     void *rx_tmp_ptr = MNULL;
     mlan_private *pmpriv = (mlan_private *) priv;
 
     ENTER();
 
-    for (i = 0; i < rx_reor_tbl_ptr->win_size; ++i) {
+    /* The in-order run ends at the first hole in the bitmap */
+    pmpriv->adapter->callbacks.moal_spin_lock(pmpriv->adapter->pmoal_handle,
+                                              pmpriv->rx_pkt_lock);
+    no_pkt_to_send = wlan_11n_rxreorder_next(rx_reor_tbl_ptr, 0,
+                                             rx_reor_tbl_ptr->win_size, MFALSE);
+    pmpriv->adapter->callbacks.moal_spin_unlock(pmpriv->adapter->pmoal_handle,
+                                                pmpriv->rx_pkt_lock);
+
+    for (i = 0; i < no_pkt_to_send; ++i) {
         pmpriv->adapter->callbacks.moal_spin_lock(pmpriv->adapter->pmoal_handle,
                                                   pmpriv->rx_pkt_lock);
-        if (!rx_reor_tbl_ptr->rx_reorder_ptr[i]) {
-            pmpriv->adapter->callbacks.moal_spin_unlock(pmpriv->adapter->
-                                                        pmoal_handle,
-                                                        pmpriv->rx_pkt_lock);
-            break;
-        }
-        rx_tmp_ptr = rx_reor_tbl_ptr->rx_reorder_ptr[i];
-        rx_reor_tbl_ptr->rx_reorder_ptr[i] = MNULL;
+        rx_tmp_ptr = wlan_11n_rxreorder_take(rx_reor_tbl_ptr,
+                                             wlan_11n_rxreorder_slot
+                                             (rx_reor_tbl_ptr, i));
         pmpriv->adapter->callbacks.moal_spin_unlock(pmpriv->adapter->
                                                     pmoal_handle,
                                                     pmpriv->rx_pkt_lock);
-        wlan_11n_dispatch_pkt(priv, rx_tmp_ptr);
+        if (rx_tmp_ptr)
+            wlan_11n_dispatch_pkt(priv, rx_tmp_ptr);
     }
 
     pmpriv->adapter->callbacks.moal_spin_lock(pmpriv->adapter->pmoal_handle,
                                               pmpriv->rx_pkt_lock);
-    /*
-     * We don't have a circular buffer, hence use rotation to simulate
-     * circular buffer
-     */
-    if (i > 0) {
-        xchg = rx_reor_tbl_ptr->win_size - i;
-        for (j = 0; j < xchg; ++j) {
-            rx_reor_tbl_ptr->rx_reorder_ptr[j] =
-                rx_reor_tbl_ptr->rx_reorder_ptr[i + j];
-            rx_reor_tbl_ptr->rx_reorder_ptr[i + j] = MNULL;
-        }
-    }
-
-    rx_reor_tbl_ptr->start_win = (rx_reor_tbl_ptr->start_win + i)
+    if (no_pkt_to_send < rx_reor_tbl_ptr->win_size)
+        rx_reor_tbl_ptr->win_head =
+            wlan_11n_rxreorder_slot(rx_reor_tbl_ptr, no_pkt_to_send);
+    rx_reor_tbl_ptr->start_win = (rx_reor_tbl_ptr->start_win + no_pkt_to_send)
         & (MAX_TID_VALUE - 1);
 
     pmpriv->adapter->callbacks.moal_spin_unlock(pmpriv->adapter->pmoal_handle,
@@ -304,6 +483,7 @@ wlan_11n_delete_rxreorder_tbl_entry(mlan_private * priv,
                                     RxReorderTbl * rx_reor_tbl_ptr)
 {
     pmlan_adapter pmadapter = priv->adapter;
+    RxReorderTbl **pprev;
 
     ENTER();
 
@@ -328,6 +508,17 @@ wlan_11n_delete_rxreorder_tbl_entry(mlan_private * priv,
     }
 
     PRINTM(MDAT_D, "Delete rx_reor_tbl_ptr: %p\n", rx_reor_tbl_ptr);
+    pmadapter->callbacks.moal_spin_lock(pmadapter->pmoal_handle,
+                                        priv->rx_reorder_tbl_ptr.plock);
+    pprev = &priv->rx_reorder_hash[wlan_11n_rxreorder_hash(rx_reor_tbl_ptr->ta,
+                                                           rx_reor_tbl_ptr->
+                                                           tid)];
+    while (*pprev && *pprev != rx_reor_tbl_ptr)
+        pprev = &(*pprev)->hnext;
+    if (*pprev)
+        *pprev = rx_reor_tbl_ptr->hnext;
+    pmadapter->callbacks.moal_spin_unlock(pmadapter->pmoal_handle,
+                                          priv->rx_reorder_tbl_ptr.plock);
     util_unlink_list(pmadapter->pmoal_handle,
                      &priv->rx_reorder_tbl_ptr,
                      (pmlan_linked_list) rx_reor_tbl_ptr,
@@ -352,17 +543,20 @@ wlan_11n_delete_rxreorder_tbl_entry(mlan_private * priv,
 static int
 wlan_11n_find_last_seqnum(RxReorderTbl * rx_reorder_tbl_ptr)
 {
-    int i;
+    int head = rx_reorder_tbl_ptr->win_head;
+    int slot;
 
     ENTER();
-    for (i = (rx_reorder_tbl_ptr->win_size - 1); i >= 0; --i) {
-        if (rx_reorder_tbl_ptr->rx_reorder_ptr[i]) {
-            LEAVE();
-            return i;
-        }
+    /* Wrapped slots [0, head) hold the highest offsets */
+    slot = wlan_11n_bitmap_last(rx_reorder_tbl_ptr->win_bitmap, 0, head);
+    if (slot >= 0) {
+        LEAVE();
+        return rx_reorder_tbl_ptr->win_size - head + slot;
     }
+    slot = wlan_11n_bitmap_last(rx_reorder_tbl_ptr->win_bitmap, head,
+                                rx_reorder_tbl_ptr->win_size);
     LEAVE();
-    return -1;
+    return (slot >= 0) ? slot - head : -1;
 }
 
 /**
@@ -411,11 +605,11 @@ static t_void
 wlan_11n_create_rxreorder_tbl(mlan_private * priv, t_u8 * ta, int tid,
                               int win_size, int seq_num)
 {
-    int i;
     pmlan_adapter pmadapter = priv->adapter;
     RxReorderTbl *rx_reor_tbl_ptr, *new_node;
     sta_node *sta_ptr = MNULL;
     t_u16 last_seq = 0;
+    t_u32 hash, slots_size, bitmap_size;
 
     ENTER();
 
@@ -459,9 +653,13 @@ wlan_11n_create_rxreorder_tbl(mlan_private * priv, t_u8 * ta, int tid,
             new_node->start_win = last_seq + 1;
         }
         new_node->win_size = win_size;
+        new_node->win_head = 0;
 
+        /* The slot array and its occupancy bitmap share one allocation */
+        slots_size = sizeof(t_void *) * win_size;
+        bitmap_size = sizeof(t_u32) * ((win_size + 31) >> 5);
         if (pmadapter->callbacks.
-            moal_malloc(pmadapter->pmoal_handle, sizeof(t_void *) * win_size,
+            moal_malloc(pmadapter->pmoal_handle, slots_size + bitmap_size,
                         MLAN_MEM_DEF, (t_u8 **) & new_node->rx_reorder_ptr)) {
             PRINTM(MERROR, "Rx reorder table memory allocation" "failed\n");
             pmadapter->callbacks.moal_mfree(pmadapter->pmoal_handle,
@@ -481,14 +679,24 @@ wlan_11n_create_rxreorder_tbl(mlan_private * priv, t_u8 * ta, int tid,
                                              wlan_flush_data,
                                              &new_node->timer_context);
 
-        for (i = 0; i < win_size; ++i)
-            new_node->rx_reorder_ptr[i] = MNULL;
+        memset(pmadapter, new_node->rx_reorder_ptr, 0,
+               slots_size + bitmap_size);
+        new_node->win_bitmap =
+            (t_u32 *) ((t_u8 *) new_node->rx_reorder_ptr + slots_size);
 
         util_enqueue_list_tail(pmadapter->pmoal_handle,
                                &priv->rx_reorder_tbl_ptr,
                                (pmlan_linked_list) new_node,
                                pmadapter->callbacks.moal_spin_lock,
                                pmadapter->callbacks.moal_spin_unlock);
+
+        hash = wlan_11n_rxreorder_hash(ta, tid);
+        pmadapter->callbacks.moal_spin_lock(pmadapter->pmoal_handle,
+                                            priv->rx_reorder_tbl_ptr.plock);
+        new_node->hnext = priv->rx_reorder_hash[hash];
+        priv->rx_reorder_hash[hash] = new_node;
+        pmadapter->callbacks.moal_spin_unlock(pmadapter->pmoal_handle,
+                                              priv->rx_reorder_tbl_ptr.plock);
     }
 
     LEAVE();
@@ -515,31 +723,21 @@ wlan_11n_get_rxreorder_tbl(mlan_private * priv, int tid, t_u8 * ta)
 
     ENTER();
 
-    if (!
-        (rx_reor_tbl_ptr =
-         (RxReorderTbl *) util_peek_list(priv->adapter->pmoal_handle,
-                                         &priv->rx_reorder_tbl_ptr,
-                                         priv->adapter->callbacks.
-                                         moal_spin_lock,
-                                         priv->adapter->callbacks.
-                                         moal_spin_unlock))) {
-        LEAVE();
-        return MNULL;
-    }
-
-    while (rx_reor_tbl_ptr != (RxReorderTbl *) & priv->rx_reorder_tbl_ptr) {
-        if ((!memcmp
-             (priv->adapter, rx_reor_tbl_ptr->ta, ta, MLAN_MAC_ADDR_LENGTH)) &&
-            (rx_reor_tbl_ptr->tid == tid)) {
-            LEAVE();
-            return rx_reor_tbl_ptr;
-        }
-
-        rx_reor_tbl_ptr = rx_reor_tbl_ptr->pnext;
+    priv->adapter->callbacks.moal_spin_lock(priv->adapter->pmoal_handle,
+                                            priv->rx_reorder_tbl_ptr.plock);
+    rx_reor_tbl_ptr = priv->rx_reorder_hash[wlan_11n_rxreorder_hash(ta, tid)];
+    while (rx_reor_tbl_ptr) {
+        if ((rx_reor_tbl_ptr->tid == tid) &&
+            (!memcmp
+             (priv->adapter, rx_reor_tbl_ptr->ta, ta, MLAN_MAC_ADDR_LENGTH)))
+            break;
+        rx_reor_tbl_ptr = rx_reor_tbl_ptr->hnext;
     }
+    priv->adapter->callbacks.moal_spin_unlock(priv->adapter->pmoal_handle,
+                                              priv->rx_reorder_tbl_ptr.plock);
 
     LEAVE();
-    return MNULL;
+    return rx_reor_tbl_ptr;
 }
 
 /**
@@ -700,7 +898,7 @@ mlan_11n_rxreorder_pkt(void *priv, t_u16 seq_num, t_u16 tid,
                        t_u8 * ta, t_u8 pkt_type, void *payload)
 {
     RxReorderTbl *rx_reor_tbl_ptr;
-    int prev_start_win, start_win, end_win, win_size;
+    int prev_start_win, start_win, end_win, win_size, slot;
     mlan_status ret = MLAN_STATUS_SUCCESS;
     pmlan_adapter pmadapter = ((mlan_private *) priv)->adapter;
 
@@ -785,25 +983,20 @@ mlan_11n_rxreorder_pkt(void *priv, t_u16 seq_num, t_u16 tid,
         PRINTM(MDAT_D, "3:seq_num %d start_win %d win_size %d"
                " end_win %d\n", seq_num, start_win, win_size, end_win);
         if (pkt_type != PKT_TYPE_BAR) {
-            if (seq_num >= start_win) {
-                if (rx_reor_tbl_ptr->rx_reorder_ptr[seq_num - start_win]) {
-                    PRINTM(MDAT_D, "Drop Duplicate Pkt\n");
-                    ret = MLAN_STATUS_FAILURE;
-                    goto done;
-                }
-                rx_reor_tbl_ptr->rx_reorder_ptr[seq_num - start_win] = payload;
-            } else {            /* Wrap condition */
-                if (rx_reor_tbl_ptr->rx_reorder_ptr[(seq_num
-                                                     + (MAX_TID_VALUE)) -
-                                                    start_win]) {
-                    PRINTM(MDAT_D, "Drop Duplicate Pkt\n");
-                    ret = MLAN_STATUS_FAILURE;
-                    goto done;
-                }
-                rx_reor_tbl_ptr->rx_reorder_ptr[(seq_num
-                                                 + (MAX_TID_VALUE)) -
-                                                start_win] = payload;
+            if (seq_num >= start_win)
+                slot = wlan_11n_rxreorder_slot(rx_reor_tbl_ptr,
+                                               seq_num - start_win);
+            else                /* Wrap condition */
+                slot = wlan_11n_rxreorder_slot(rx_reor_tbl_ptr,
+                                               (seq_num + (MAX_TID_VALUE)) -
+                                               start_win);
+            if (rx_reor_tbl_ptr->win_bitmap[slot >> 5] & (1U << (slot & 31))) {
+                PRINTM(MDAT_D, "Drop Duplicate Pkt\n");
+                ret = MLAN_STATUS_FAILURE;
+                goto done;
             }
+            rx_reor_tbl_ptr->rx_reorder_ptr[slot] = payload;
+            rx_reor_tbl_ptr->win_bitmap[slot >> 5] |= (1U << (slot & 31));
         }
 
         wlan_11n_display_tbl_ptr(pmadapter, rx_reor_tbl_ptr);
@@ -1005,6 +1198,8 @@ wlan_11n_cleanup_reorder_tbl(mlan_private * priv)
     }
 
     util_init_list((pmlan_linked_list) & priv->rx_reorder_tbl_ptr);
+    memset(priv->adapter, priv->rx_reorder_hash, 0,
+           sizeof(priv->rx_reorder_hash));
 
     memset(priv->adapter, priv->rx_seq, 0xff, sizeof(priv->rx_seq));
     LEAVE();
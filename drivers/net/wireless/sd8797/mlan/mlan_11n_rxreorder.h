@@ -74,6 +74,24 @@ Change log:
 /** Indicate packet has been dropped in FW */
 #define RX_PKT_DROPPED_IN_FW             0xffffffff
 
+/**
+ *  @brief This function maps a window offset to its rx_reorder_ptr slot
+ *
+ *  @param rx_reor_tbl_ptr  A pointer to structure RxReorderTbl
+ *  @param offset           Offset from start_win, less than win_size
+ *
+ *  @return                 Slot index in rx_reorder_ptr
+ */
+static INLINE int
+wlan_11n_rxreorder_slot(RxReorderTbl * rx_reor_tbl_ptr, int offset)
+{
+    int slot = rx_reor_tbl_ptr->win_head + offset;
+
+    if (slot >= rx_reor_tbl_ptr->win_size)
+        slot -= rx_reor_tbl_ptr->win_size;
+    return slot;
+}
+
 mlan_status mlan_11n_rxreorder_pkt(void *priv, t_u16 seqNum, t_u16 tid,
                                    t_u8 * ta, t_u8 pkttype, void *payload);
 void mlan_11n_delete_bastream_tbl(mlan_private * priv, int Tid,
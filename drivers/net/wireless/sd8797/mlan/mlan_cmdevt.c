@@ -445,6 +445,14 @@ wlan_dnld_cmd_to_fw(IN mlan_private * pmpriv, IN cmd_ctrl_node * pcmd_node)
         goto done;
     }
 
+#ifdef STA_SUPPORT
+    /* Note when the firmware leaves the channel, see wlan_ret_802_11_scan */
+    if (cmd_code == HostCmd_CMD_802_11_SCAN)
+        pcb->moal_get_system_time(pmadapter->pmoal_handle,
+                                  &pmadapter->scan_cmd_sec,
+                                  &pmadapter->scan_cmd_usec);
+#endif
+
     /* Setup the timer after transmit command */
     pcb->moal_start_timer(pmadapter->pmoal_handle, pmadapter->pmlan_cmd_timer,
                           MFALSE, MRVDRV_TIMER_60S);
@@ -1472,6 +1480,11 @@ wlan_flush_scan_queue(IN pmlan_adapter pmadapter)
         pcmd_node->pioctl_buf = MNULL;
         wlan_insert_cmd_to_free_q(pmadapter, pcmd_node);
     }
+    if (pmadapter->scan_home_timer_is_set) {
+        pcb->moal_stop_timer(pmadapter->pmoal_handle,
+                             pmadapter->pscan_home_timer);
+        pmadapter->scan_home_timer_is_set = MFALSE;
+    }
     wlan_request_cmd_lock(pmadapter);
     pmadapter->scan_processing = MFALSE;
     wlan_release_cmd_lock(pmadapter);
@@ -412,6 +412,22 @@ wlan_init_adapter(pmlan_adapter pmadapter)
         pmadapter->mpa_tx.enabled = MTRUE;
     }
     pmadapter->mpa_tx.pkt_aggr_limit = SDIO_MP_AGGR_DEF_PKT_LIMIT;
+    if (pmadapter->init_para.mpa_tx_adaptive == MLAN_INIT_PARA_ENABLED) {
+        /* Start small and let sustained load grow the limit */
+        pmadapter->mpa_tx.adaptive = MTRUE;
+        pmadapter->mpa_tx.cur_limit = SDIO_MP_TX_AGGR_ADAPT_MIN_LIMIT;
+    } else {
+        pmadapter->mpa_tx.adaptive = MFALSE;
+        pmadapter->mpa_tx.cur_limit = pmadapter->mpa_tx.pkt_aggr_limit;
+    }
+    pmadapter->mpa_tx.full_cnt = 0;
+    /* Gather from the packets themselves when MOAL can do it */
+    pmadapter->mpa_tx.sg =
+        pmadapter->callbacks.moal_write_data_mp ? MTRUE : MFALSE;
+    memset(pmadapter, pmadapter->mpa_tx.mbuf_arr, 0,
+           sizeof(pmadapter->mpa_tx.mbuf_arr));
+    memset(pmadapter, pmadapter->mpa_tx.pkt_hist, 0,
+           sizeof(pmadapter->mpa_tx.pkt_hist));
 #endif /* SDIO_MULTI_PORT_TX_AGGR */
 
 #ifdef SDIO_MULTI_PORT_RX_AGGR
@@ -427,6 +443,8 @@ wlan_init_adapter(pmlan_adapter pmadapter)
         pmadapter->mpa_rx.enabled = MTRUE;
     }
     pmadapter->mpa_rx.pkt_aggr_limit = SDIO_MP_AGGR_DEF_PKT_LIMIT;
+    memset(pmadapter, pmadapter->mpa_rx.pkt_hist, 0,
+           sizeof(pmadapter->mpa_rx.pkt_hist));
 #endif /* SDIO_MULTI_PORT_RX_AGGR */
 
     pmadapter->cmd_resp_received = MFALSE;
@@ -466,6 +484,8 @@ wlan_init_adapter(pmlan_adapter pmadapter)
            (sizeof(BSSDescriptor_t) * MRVDRV_MAX_BSSID_LIST));
     pmadapter->ext_scan = 0;
     pmadapter->scan_probes = DEFAULT_PROBES;
+    pmadapter->scan_home_dwell = pmadapter->init_para.scan_home_dwell;
+    pmadapter->scan_home_timer_is_set = MFALSE;
 
     memset(pmadapter, pmadapter->bcn_buf, 0, pmadapter->bcn_buf_size);
     pmadapter->pbcn_buf_end = pmadapter->bcn_buf;
@@ -820,6 +840,15 @@ wlan_init_timer(IN pmlan_adapter pmadapter)
         ret = MLAN_STATUS_FAILURE;
         goto error;
     }
+#ifdef STA_SUPPORT
+    if (pcb->
+        moal_init_timer(pmadapter->pmoal_handle, &pmadapter->pscan_home_timer,
+                        wlan_scan_home_timeout_func, pmadapter)
+        != MLAN_STATUS_SUCCESS) {
+        ret = MLAN_STATUS_FAILURE;
+        goto error;
+    }
+#endif
   error:
     LEAVE();
     return ret;
@@ -843,6 +872,11 @@ wlan_free_timer(IN pmlan_adapter pmadapter)
     if (pmadapter->pmlan_cmd_timer)
         pcb->moal_free_timer(pmadapter->pmoal_handle,
                              pmadapter->pmlan_cmd_timer);
+#ifdef STA_SUPPORT
+    if (pmadapter->pscan_home_timer)
+        pcb->moal_free_timer(pmadapter->pmoal_handle,
+                             pmadapter->pscan_home_timer);
+#endif
 
     LEAVE();
     return;
@@ -940,6 +974,11 @@ wlan_free_adapter(pmlan_adapter pmadapter)
         pmadapter->cmd_timer_is_set = MFALSE;
     }
 #ifdef STA_SUPPORT
+    if (pmadapter->scan_home_timer_is_set) {
+        pcb->moal_stop_timer(pmadapter->pmoal_handle,
+                             pmadapter->pscan_home_timer);
+        pmadapter->scan_home_timer_is_set = MFALSE;
+    }
     PRINTM(MINFO, "Free ScanTable\n");
     if (pmadapter->pscan_table) {
         pcb->moal_mfree(pmadapter->pmoal_handle,
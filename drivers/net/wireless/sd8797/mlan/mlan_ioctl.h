@@ -1440,6 +1440,24 @@ typedef struct _mlan_debug_info
     t_u8 event_received;
     /**  pendig tx pkts */
     t_u32 tx_pkts_queued;
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+    /** SDIO MP-A Tx transactions, indexed by packets per transaction */
+    t_u32 mpa_tx_count[MLAN_MP_AGGR_HIST_NUM];
+    /** SDIO MP-A Tx current packet limit */
+    t_u32 mpa_tx_limit;
+#endif
+#ifdef SDIO_MULTI_PORT_RX_AGGR
+    /** SDIO MP-A Rx transactions, indexed by packets per transaction */
+    t_u32 mpa_rx_count[MLAN_MP_AGGR_HIST_NUM];
+#endif
+#ifdef STA_SUPPORT
+    /** Returns to the home channel between scan commands */
+    t_u32 num_scan_home;
+    /** Time spent off channel by scans while connected, in ms */
+    t_u32 scan_off_chan_ms;
+    /** Longest single off channel scan command while connected, in ms */
+    t_u32 scan_off_chan_max_ms;
+#endif
 #ifdef UAP_SUPPORT
     /**  pending bridge pkts */
     t_u16 num_bridge_pkts;
@@ -2711,6 +2729,10 @@ typedef struct _mlan_ds_misc_sdio_mpa_ctrl
     t_u16 tx_max_ports;
     /** SDIO MP-A RX Max Ports */
     t_u16 rx_max_ports;
+    /** SDIO MP-A TX adaptive aggregation enable/disable */
+    t_u16 tx_adaptive;
+    /** SDIO MP-A TX ports currently used by adaptive aggregation (get only) */
+    t_u16 tx_cur_ports;
 } mlan_ds_misc_sdio_mpa_ctrl;
 #endif
 
@@ -447,6 +447,12 @@ do {                                    \
 #ifdef SDIO_MULTI_PORT_TX_AGGR
 /** Multi port TX aggregation buffer size */
 #define SDIO_MP_TX_AGGR_DEF_BUF_SIZE        (16384)     /* 16K */
+/** Adaptive TX aggregation: smallest packet limit */
+#define SDIO_MP_TX_AGGR_ADAPT_MIN_LIMIT     (2)
+/** Adaptive TX aggregation: full aggregates in a row before the limit grows */
+#define SDIO_MP_TX_AGGR_ADAPT_GROW_CNT      (4)
+/** Adaptive TX aggregation: queue depth below which the aggregate is flushed */
+#define SDIO_MP_TX_AGGR_ADAPT_SHALLOW_PKTS  (2)
 #endif /* SDIO_MULTI_PORT_TX_AGGR */
 
 #ifdef SDIO_MULTI_PORT_RX_AGGR
@@ -515,6 +521,14 @@ typedef struct _wlan_dbg
     t_u16 last_event[DBG_CMD_NUM];
     /** Last event index */
     t_u16 last_event_index;
+#ifdef STA_SUPPORT
+    /** Returns to the home channel between scan commands */
+    t_u32 num_scan_home;
+    /** Time spent off channel by scans while connected, in ms */
+    t_u32 scan_off_chan_ms;
+    /** Longest single off channel scan command while connected, in ms */
+    t_u32 scan_off_chan_max_ms;
+#endif
 } wlan_dbg;
 
 /** Hardware status codes */
@@ -872,6 +886,9 @@ typedef struct _mlan_operations
     mlan_bss_role bss_role;
 } mlan_operations;
 
+/** Number of TA/TID hash buckets for the Rx reorder table, power of 2 */
+#define RX_REORDER_HASH_SIZE    16
+
 /** Private structure for MLAN */
 typedef struct _mlan_private
 {
@@ -1051,6 +1068,8 @@ typedef struct _mlan_private
     t_u16 rx_seq[MAX_NUM_TID];
     /** Pointer to the Receive Reordering table*/
     mlan_list_head rx_reorder_tbl_ptr;
+    /** Receive Reordering table entries hashed on TA/TID */
+    struct _RxReorderTbl *rx_reorder_hash[RX_REORDER_HASH_SIZE];
     /** Lock for Rx packets */
     t_void *rx_pkt_lock;
 
@@ -1149,8 +1168,14 @@ struct _RxReorderTbl
     int start_win;
     /** Window size */
     int win_size;
+    /** Next entry in the same TA/TID hash bucket */
+    RxReorderTbl *hnext;
+    /** Slot of rx_reorder_ptr holding start_win */
+    int win_head;
     /** Pointer to pointer to RxReorderTbl */
     t_void **rx_reorder_ptr;
+    /** Bitmap of the occupied slots of rx_reorder_ptr */
+    t_u32 *win_bitmap;
     /** Timer context */
     reorder_tmr_cnxt_t timer_context;
     /** BA stream status */
@@ -1404,6 +1429,18 @@ typedef struct _sdio_mpa_tx
     t_u32 buf_size;
         /** multiport tx aggregation pkt aggr limit */
     t_u32 pkt_aggr_limit;
+        /** multiport tx aggregation gathers packets in place, no copy */
+    t_u8 sg;
+        /** multiport tx aggregation mbuf array, used when sg is set */
+    pmlan_buffer mbuf_arr[SDIO_MP_AGGR_DEF_PKT_LIMIT];
+        /** multiport tx adaptive aggregation enable/disable flag */
+    t_u8 adaptive;
+        /** multiport tx aggregation limit in use, <= pkt_aggr_limit */
+    t_u32 cur_limit;
+        /** multiport tx aggregates sent full since the limit last changed */
+    t_u32 full_cnt;
+        /** multiport tx transactions by number of packets */
+    t_u32 pkt_hist[MLAN_MP_AGGR_HIST_NUM];
 } sdio_mpa_tx;
 #endif
 
@@ -1435,6 +1472,8 @@ typedef struct _sdio_mpa_rx
     t_u32 buf_size;
         /** multiport rx aggregation pkt aggr limit */
     t_u32 pkt_aggr_limit;
+        /** multiport rx transactions by number of packets */
+    t_u32 pkt_hist[MLAN_MP_AGGR_HIST_NUM];
 } sdio_mpa_rx;
 #endif /* SDIO_MULTI_PORT_RX_AGGR */
 
@@ -1452,10 +1491,16 @@ typedef struct _mlan_init_para
 #ifdef SDIO_MULTI_PORT_TX_AGGR
     /** SDIO MPA Tx */
     t_u32 mpa_tx_cfg;
+    /** SDIO MPA Tx adaptive aggregation */
+    t_u32 mpa_tx_adaptive;
 #endif
 #ifdef SDIO_MULTI_PORT_RX_AGGR
     /** SDIO MPA Rx */
     t_u32 mpa_rx_cfg;
+#endif
+#ifdef STA_SUPPORT
+    /** Return-to-home time between scan commands while connected, in ms */
+    t_u32 scan_home_dwell;
 #endif
     /** Auto deep sleep */
     t_u32 auto_ds;
@@ -1616,6 +1661,18 @@ typedef struct _mlan_adapter
     mlan_list_head scan_pending_q;
     /** mlan_processing */
     t_u32 scan_processing;
+#ifdef STA_SUPPORT
+    /** Return-to-home time between scan commands while connected, in ms */
+    t_u32 scan_home_dwell;
+    /** Scan return-to-home timer */
+    t_void *pscan_home_timer;
+    /** Scan return-to-home timer set flag */
+    t_u8 scan_home_timer_is_set;
+    /** Time the last scan command was sent, seconds part */
+    t_u32 scan_cmd_sec;
+    /** Time the last scan command was sent, microseconds part */
+    t_u32 scan_cmd_usec;
+#endif
 
     /** Region code */
     t_u16 region_code;
@@ -2106,6 +2163,9 @@ mlan_status wlan_cmd_802_11_scan(IN pmlan_private pmpriv,
 t_void wlan_queue_scan_cmd(IN mlan_private * pmpriv,
                            IN cmd_ctrl_node * pcmd_node);
 
+/** Scan return-to-home timeout handler */
+t_void wlan_scan_home_timeout_func(t_void * function_context);
+
 /** Handler for scan command response */
 mlan_status wlan_ret_802_11_scan(IN pmlan_private pmpriv,
                                  IN HostCmd_DS_COMMAND * resp,
@@ -2528,6 +2588,15 @@ t_void wlan_delay_func(mlan_adapter * pmadapter, t_u32 delay, t_delay_unit u);
                                        pmadapter->callbacks.moal_spin_lock,\
                                        pmadapter->callbacks.moal_spin_unlock))
 
+#ifdef STA_SUPPORT
+/** Scan holds data back, except while at home between scan commands */
+#define SCAN_BLOCKS_TX(pmadapter) ((pmadapter)->scan_processing && \
+                                   !(pmadapter)->scan_home_timer_is_set)
+#else
+/** Scan holds data back */
+#define SCAN_BLOCKS_TX(pmadapter) ((pmadapter)->scan_processing)
+#endif
+
 /** Get BSS number from priv */
 #define GET_BSS_NUM(priv)   (priv)->bss_num
 /**
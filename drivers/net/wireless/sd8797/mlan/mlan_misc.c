@@ -528,6 +528,22 @@ wlan_get_info_debug_info(IN pmlan_adapter pmadapter,
         info->param.debug_info.tx_pkts_queued =
             util_scalar_read(pmadapter->pmoal_handle,
                              &pmpriv->wmm.tx_pkts_queued, MNULL, MNULL);
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+        memcpy(pmadapter, info->param.debug_info.mpa_tx_count,
+               pmadapter->mpa_tx.pkt_hist, sizeof(pmadapter->mpa_tx.pkt_hist));
+        info->param.debug_info.mpa_tx_limit = pmadapter->mpa_tx.cur_limit;
+#endif
+#ifdef SDIO_MULTI_PORT_RX_AGGR
+        memcpy(pmadapter, info->param.debug_info.mpa_rx_count,
+               pmadapter->mpa_rx.pkt_hist, sizeof(pmadapter->mpa_rx.pkt_hist));
+#endif
+#ifdef STA_SUPPORT
+        info->param.debug_info.num_scan_home = pmadapter->dbg.num_scan_home;
+        info->param.debug_info.scan_off_chan_ms =
+            pmadapter->dbg.scan_off_chan_ms;
+        info->param.debug_info.scan_off_chan_max_ms =
+            pmadapter->dbg.scan_off_chan_max_ms;
+#endif
 #ifdef UAP_SUPPORT
         info->param.debug_info.num_bridge_pkts = pmadapter->pending_bridge_pkts;
         info->param.debug_info.num_drop_pkts = pmpriv->num_drop_pkts;
@@ -49,6 +49,12 @@ Change log:
  */
 #define MRVDRV_CHANNELS_PER_SCAN_CMD            4
 
+/**
+ * Number of channels per scan command while connected and returning to the
+ * home channel between commands, to keep each trip off channel short.
+ */
+#define MRVDRV_CHANNELS_PER_SCAN_CMD_CONNECTED  2
+
 /** Memory needed to store a max sized Channel List TLV for a firmware scan */
 #define CHAN_TLV_MAX_SIZE  (sizeof(MrvlIEtypesHeader_t)                  \
                             + (MRVDRV_MAX_CHANNELS_PER_SPECIFIC_SCAN     \
@@ -806,6 +812,15 @@ wlan_scan_setup_scan_config(IN mlan_private * pmpriv,
     else
         *pmax_chan_per_scan = MRVDRV_CHANNELS_PER_SCAN_CMD;
 
+    /*
+     *  While connected, data is held back for as long as a scan command
+     *  keeps the firmware off channel.  Keep those trips short and go back
+     *  home between them (see wlan_ret_802_11_scan).
+     */
+    if (pmpriv->media_connected == MTRUE && pmadapter->scan_home_dwell)
+        *pmax_chan_per_scan = MIN(*pmax_chan_per_scan,
+                                  MRVDRV_CHANNELS_PER_SCAN_CMD_CONNECTED);
+
     /* If the input config or adapter has the number of Probes set, add tlv */
     if (num_probes) {
 
@@ -949,6 +964,34 @@ wlan_scan_setup_scan_config(IN mlan_private * pmpriv,
     return ret;
 }
 
+/**
+ *  @brief Account the time the last scan command kept us off channel
+ *
+ *  @param pmadapter    A pointer to mlan_adapter structure
+ *  @param sec          Response time, seconds part
+ *  @param usec         Response time, microseconds part
+ *
+ *  @return             N/A
+ */
+static t_void
+wlan_scan_account_off_chan(IN mlan_adapter * pmadapter, IN t_u32 sec,
+                           IN t_u32 usec)
+{
+    t_s32 ms;
+
+    ENTER();
+
+    ms = (t_s32) (sec - pmadapter->scan_cmd_sec) * 1000 +
+        ((t_s32) usec - (t_s32) pmadapter->scan_cmd_usec) / 1000;
+    if (ms > 0) {
+        pmadapter->dbg.scan_off_chan_ms += ms;
+        if ((t_u32) ms > pmadapter->dbg.scan_off_chan_max_ms)
+            pmadapter->dbg.scan_off_chan_max_ms = ms;
+    }
+
+    LEAVE();
+}
+
 /**
  *  @brief Inspect the scan response buffer for pointers to expected TLVs
  *
@@ -2947,6 +2990,9 @@ wlan_ret_802_11_scan(IN mlan_private * pmpriv,
                                               &age_ts_usec);
     if (is_bgscan_resp)
         goto done;
+    if (pmpriv->media_connected == MTRUE)
+        wlan_scan_account_off_chan(pmadapter, pmadapter->age_in_secs,
+                                   age_ts_usec);
     if (!util_peek_list
         (pmadapter->pmoal_handle, &pmadapter->scan_pending_q,
          pcb->moal_spin_lock, pcb->moal_spin_unlock)) {
@@ -2985,6 +3031,17 @@ wlan_ret_802_11_scan(IN mlan_private * pmpriv,
                                          (pmlan_ioctl_req) pioctl_buf,
                                          MLAN_STATUS_FAILURE);
             }
+        } else if (pmpriv->media_connected == MTRUE &&
+                   pmadapter->scan_home_dwell) {
+            /*
+             * Stay on the home channel for a while so queued data can go
+             * out; wlan_scan_home_timeout_func() sends the next command.
+             */
+            pmadapter->dbg.num_scan_home++;
+            pmadapter->scan_home_timer_is_set = MTRUE;
+            pcb->moal_start_timer(pmadapter->pmoal_handle,
+                                  pmadapter->pscan_home_timer, MFALSE,
+                                  pmadapter->scan_home_dwell);
         } else {
             /* Get scan command from scan_pending_q and put to cmd_pending_q */
             pcmd_node =
@@ -4017,6 +4074,38 @@ wlan_ssid_cmp(IN pmlan_adapter pmadapter,
     return memcmp(pmadapter, ssid1->ssid, ssid2->ssid, ssid1->ssid_len);
 }
 
+/**
+ *  @brief Return-to-home timer handler: send the next scan command
+ *
+ *  @param function_context   A pointer to mlan_adapter structure
+ *
+ *  @return                   N/A
+ */
+t_void
+wlan_scan_home_timeout_func(t_void * function_context)
+{
+    mlan_adapter *pmadapter = (mlan_adapter *) function_context;
+    mlan_callbacks *pcb = &pmadapter->callbacks;
+    cmd_ctrl_node *pcmd_node = MNULL;
+
+    ENTER();
+
+    pmadapter->scan_home_timer_is_set = MFALSE;
+    /* The queue is empty if the scan was cancelled meanwhile */
+    pcmd_node = (cmd_ctrl_node *) util_dequeue_list(pmadapter->pmoal_handle,
+                                                    &pmadapter->scan_pending_q,
+                                                    pcb->moal_spin_lock,
+                                                    pcb->moal_spin_unlock);
+    if (pcmd_node) {
+        wlan_insert_cmd_to_pending_q(pmadapter, pcmd_node, MTRUE);
+        /* Signal MOAL to trigger mlan_main_process */
+        wlan_recv_event(pcmd_node->priv, MLAN_EVENT_ID_DRV_DEFER_HANDLING,
+                        MNULL);
+    }
+
+    LEAVE();
+}
+
 /**
  *  @brief This function inserts scan command node to scan_pending_q.
  *
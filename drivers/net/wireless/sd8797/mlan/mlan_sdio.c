@@ -615,7 +615,7 @@ wlan_prog_fw_w_helper(IN pmlan_adapter pmadapter, IN pmlan_fw_image pmfw)
  *  @param pmadapter A pointer to mlan_adapter structure
  *  @return 	   MLAN_STATUS_SUCCESS or MLAN_STATUS_FAILURE
  */
-static mlan_status
+mlan_status
 wlan_disable_host_int(pmlan_adapter pmadapter)
 {
     mlan_status ret;
@@ -826,6 +826,7 @@ wlan_sdio_card_to_host_mp_aggr(mlan_adapter * pmadapter, mlan_buffer
 
         DBG_HEXDUMP(MIF_D, "SDIO MP-A Blk Rd", pmadapter->mpa_rx.buf,
                     MIN(pmadapter->mpa_rx.buf_len, MAX_DATA_DUMP_LEN));
+        pmadapter->mpa_rx.pkt_hist[pmadapter->mpa_rx.pkt_cnt]++;
 
         curr_ptr = pmadapter->mpa_rx.buf;
 
@@ -879,6 +880,8 @@ wlan_sdio_card_to_host_mp_aggr(mlan_adapter * pmadapter, mlan_buffer
             ret = MLAN_STATUS_FAILURE;
             goto done;
         }
+        if (port != CTRL_PORT)
+            pmadapter->mpa_rx.pkt_hist[1]++;
         wlan_decode_rx_packet(pmadapter, pmbuf, pkt_type);
     }
 
@@ -907,6 +910,145 @@ wlan_sdio_card_to_host_mp_aggr(mlan_adapter * pmadapter, mlan_buffer
 #endif
 
 #ifdef SDIO_MULTI_PORT_TX_AGGR
+/**
+ *  @brief This function returns the number of data packets still
+ *  queued for transmission on all interfaces.
+ *
+ *  @param pmadapter A pointer to mlan_adapter structure
+ *  @return 	     Number of queued packets
+ */
+static t_u32
+wlan_mp_aggr_tx_pkts_queued(mlan_adapter * pmadapter)
+{
+    t_u32 queued = 0;
+    t_u8 i;
+
+    for (i = 0; i < pmadapter->priv_num; i++) {
+        if (pmadapter->priv[i])
+            queued += util_scalar_read(pmadapter->pmoal_handle,
+                                       &pmadapter->priv[i]->wmm.tx_pkts_queued,
+                                       MNULL, MNULL);
+    }
+    return queued;
+}
+
+/**
+ *  @brief This function writes the packets held in the Tx aggregate to
+ *  the card in one scatter-gather CMD53, retrying like
+ *  wlan_write_data_sync().
+ *
+ *  @param pmadapter A pointer to mlan_adapter structure
+ *  @param port      CMD53 port (with the MP-A port bitmap)
+ *  @return 	     MLAN_STATUS_SUCCESS or MLAN_STATUS_FAILURE
+ */
+static mlan_status
+wlan_write_data_mp_sync(mlan_adapter * pmadapter, t_u32 port)
+{
+    t_u32 i = 0;
+    pmlan_callbacks pcb = &pmadapter->callbacks;
+    mlan_status ret = MLAN_STATUS_SUCCESS;
+
+    ENTER();
+
+    do {
+        ret = pcb->moal_write_data_mp(pmadapter->pmoal_handle,
+                                      pmadapter->mpa_tx.mbuf_arr,
+                                      pmadapter->mpa_tx.pkt_cnt, port, 0);
+        if (ret != MLAN_STATUS_SUCCESS) {
+            i++;
+            PRINTM(MERROR, "host_to_card, write iomem sg (%d) failed: %d\n",
+                   i, ret);
+            if (MLAN_STATUS_SUCCESS !=
+                pcb->moal_write_reg(pmadapter->pmoal_handle,
+                                    HOST_TO_CARD_EVENT_REG, 0x04)) {
+                PRINTM(MERROR, "write CFG reg failed\n");
+            }
+            ret = MLAN_STATUS_FAILURE;
+            if (i > MAX_WRITE_IOMEM_RETRY)
+                goto exit;
+        }
+    } while (ret == MLAN_STATUS_FAILURE);
+  exit:
+    LEAVE();
+    return ret;
+}
+
+/**
+ *  @brief This function completes the packets held in the Tx aggregate.
+ *  The caller of wlan_host_to_card_mp_aggr() completes the packet it
+ *  passed in itself, so that one is only released here.
+ *
+ *  @param pmadapter A pointer to mlan_adapter structure
+ *  @param pmbuf_cur Packet the caller completes, or MNULL
+ *  @param status    Status to complete the packets with
+ *  @return 	     N/A
+ */
+static t_void
+wlan_mp_aggr_tx_complete(mlan_adapter * pmadapter, mlan_buffer * pmbuf_cur,
+                         mlan_status status)
+{
+    pmlan_buffer pmbuf;
+    t_u32 i;
+
+    if (!pmadapter->mpa_tx.sg)
+        return;
+
+    for (i = 0; i < pmadapter->mpa_tx.pkt_cnt; i++) {
+        pmbuf = pmadapter->mpa_tx.mbuf_arr[i];
+        pmadapter->mpa_tx.mbuf_arr[i] = MNULL;
+        if (!pmbuf)
+            continue;
+        pmbuf->flags &= ~MLAN_BUF_FLAG_MPA_HELD;
+        if (pmbuf == pmbuf_cur)
+            continue;
+        if (status != MLAN_STATUS_SUCCESS)
+            pmbuf->status_code = MLAN_ERROR_DATA_TX_FAIL;
+        wlan_write_data_complete(pmadapter, pmbuf, status);
+    }
+}
+
+/**
+ *  @brief This function accounts one data transaction to the card and,
+ *  in adaptive mode, moves the aggregation limit. The limit doubles
+ *  after SDIO_MP_TX_AGGR_ADAPT_GROW_CNT full aggregates in a row and
+ *  halves when a transaction goes out less than half full.
+ *
+ *  @param pmadapter A pointer to mlan_adapter structure
+ *  @param pkt_cnt   Number of packets in the transaction
+ *  @return 	     N/A
+ */
+static void
+wlan_mp_aggr_tx_account(mlan_adapter * pmadapter, t_u32 pkt_cnt)
+{
+    sdio_mpa_tx *mpa_tx = &pmadapter->mpa_tx;
+
+    if (pkt_cnt < MLAN_MP_AGGR_HIST_NUM)
+        mpa_tx->pkt_hist[pkt_cnt]++;
+
+    if (!mpa_tx->adaptive) {
+        mpa_tx->cur_limit = mpa_tx->pkt_aggr_limit;
+        return;
+    }
+
+    if (pkt_cnt >= mpa_tx->cur_limit) {
+        if (++mpa_tx->full_cnt >= SDIO_MP_TX_AGGR_ADAPT_GROW_CNT) {
+            mpa_tx->full_cnt = 0;
+            mpa_tx->cur_limit = MIN(mpa_tx->cur_limit << 1,
+                                    mpa_tx->pkt_aggr_limit);
+            PRINTM(MIF_D, "MP-A Tx: limit up to %d\n", mpa_tx->cur_limit);
+        }
+    } else {
+        mpa_tx->full_cnt = 0;
+        if (pkt_cnt < (mpa_tx->cur_limit >> 1)) {
+            mpa_tx->cur_limit = MAX(mpa_tx->cur_limit >> 1,
+                                    SDIO_MP_TX_AGGR_ADAPT_MIN_LIMIT);
+            PRINTM(MIF_D, "MP-A Tx: limit down to %d\n", mpa_tx->cur_limit);
+        }
+    }
+    if (mpa_tx->cur_limit > mpa_tx->pkt_aggr_limit)
+        mpa_tx->cur_limit = mpa_tx->pkt_aggr_limit;
+}
+
 /**
  *  @brief This function sends data to the card in SDIO aggregated mode.
  *
@@ -940,6 +1082,14 @@ wlan_host_to_card_mp_aggr(mlan_adapter * pmadapter, mlan_buffer * mbuf,
         goto tx_curr_single;
     }
 
+    if (next_pkt_len && pmadapter->mpa_tx.adaptive &&
+        wlan_mp_aggr_tx_pkts_queued(pmadapter) <
+        SDIO_MP_TX_AGGR_ADAPT_SHALLOW_PKTS) {
+        /* Shallow queue: don't hold this packet back waiting for more */
+        PRINTM(MINFO, "host_2_card_mp_aggr: Shallow Tx Queue, flush.\n");
+        next_pkt_len = 0;
+    }
+
     if (next_pkt_len) {
         /* More pkt in TX queue */
         PRINTM(MINFO, "host_2_card_mp_aggr: More packets in Queue.\n");
@@ -1011,14 +1161,20 @@ wlan_host_to_card_mp_aggr(mlan_adapter * pmadapter, mlan_buffer * mbuf,
                "%d %d\n", pmadapter->mpa_tx.start_port,
                pmadapter->mpa_tx.ports);
 
-        memset(pmadapter, &mbuf_aggr, 0, sizeof(mlan_buffer));
-
-        mbuf_aggr.pbuf = (t_u8 *) pmadapter->mpa_tx.buf;
-        mbuf_aggr.data_len = pmadapter->mpa_tx.buf_len;
         cmd53_port = (pmadapter->ioport | SDIO_MPA_ADDR_BASE |
                       (pmadapter->mpa_tx.ports << 4)) +
             pmadapter->mpa_tx.start_port;
-        ret = wlan_write_data_sync(pmadapter, &mbuf_aggr, cmd53_port);
+        if (pmadapter->mpa_tx.sg) {
+            ret = wlan_write_data_mp_sync(pmadapter, cmd53_port);
+        } else {
+            memset(pmadapter, &mbuf_aggr, 0, sizeof(mlan_buffer));
+
+            mbuf_aggr.pbuf = (t_u8 *) pmadapter->mpa_tx.buf;
+            mbuf_aggr.data_len = pmadapter->mpa_tx.buf_len;
+            ret = wlan_write_data_sync(pmadapter, &mbuf_aggr, cmd53_port);
+        }
+        wlan_mp_aggr_tx_account(pmadapter, pmadapter->mpa_tx.pkt_cnt);
+        wlan_mp_aggr_tx_complete(pmadapter, mbuf, ret);
         MP_TX_AGGR_BUF_RESET(pmadapter);
     }
 
@@ -1026,6 +1182,7 @@ wlan_host_to_card_mp_aggr(mlan_adapter * pmadapter, mlan_buffer * mbuf,
     if (f_send_cur_buf) {
         PRINTM(MINFO, "host_2_card_mp_aggr: writing to port #%d\n", port);
         ret = wlan_write_data_sync(pmadapter, mbuf, pmadapter->ioport + port);
+        wlan_mp_aggr_tx_account(pmadapter, 1);
     }
     if (f_postcopy_cur_buf) {
         PRINTM(MINFO, "host_2_card_mp_aggr: Postcopy current buffer\n");
@@ -1041,6 +1198,24 @@ wlan_host_to_card_mp_aggr(mlan_adapter * pmadapter, mlan_buffer * mbuf,
 		Global functions
 ********************************************************/
 
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+/**
+ *  @brief This function drops a pending Tx aggregate, completing any
+ *  packets it still holds with failure.
+ *
+ *  @param pmadapter A pointer to mlan_adapter structure
+ *  @return 	     N/A
+ */
+t_void
+wlan_mp_aggr_tx_cleanup(pmlan_adapter pmadapter)
+{
+    ENTER();
+    wlan_mp_aggr_tx_complete(pmadapter, MNULL, MLAN_STATUS_FAILURE);
+    MP_TX_AGGR_BUF_RESET(pmadapter);
+    LEAVE();
+}
+#endif /* SDIO_MULTI_PORT_TX_AGGR */
+
 /**
  *  @brief This function checks if the interface is ready to download
  *  or not while other download interface is present
@@ -207,9 +207,15 @@ Change log:
 /** SDIO Tx aggregation buffer room for next packet ? */
 #define MP_TX_AGGR_BUF_HAS_ROOM(a,mbuf, len) ((a->mpa_tx.buf_len+len)<= a->mpa_tx.buf_size)
 
-/** Copy current packet (SDIO Tx aggregation buffer) to SDIO buffer */
+/** Add current packet to SDIO Tx aggregation: hold it for a gathered
+    write, or copy it to the SDIO aggregation buffer */
 #define MP_TX_AGGR_BUF_PUT(a, mbuf, port) do{                   \
-    pmadapter->callbacks.moal_memmove(a->pmoal_handle, &a->mpa_tx.buf[a->mpa_tx.buf_len],mbuf->pbuf+mbuf->data_offset,mbuf->data_len);\
+    if(a->mpa_tx.sg){                                           \
+        mbuf->flags |= MLAN_BUF_FLAG_MPA_HELD;                  \
+        a->mpa_tx.mbuf_arr[a->mpa_tx.pkt_cnt] = mbuf;           \
+    }else{                                                      \
+        pmadapter->callbacks.moal_memmove(a->pmoal_handle, &a->mpa_tx.buf[a->mpa_tx.buf_len],mbuf->pbuf+mbuf->data_offset,mbuf->data_len);\
+    }                                                           \
     a->mpa_tx.buf_len += mbuf->data_len;                        \
     if(!a->mpa_tx.pkt_cnt){                                     \
         a->mpa_tx.start_port = port;                            \
@@ -223,7 +229,7 @@ Change log:
 }while(0);
 
 /** SDIO Tx aggregation limit ? */
-#define MP_TX_AGGR_PKT_LIMIT_REACHED(a) (a->mpa_tx.pkt_cnt==a->mpa_tx.pkt_aggr_limit)
+#define MP_TX_AGGR_PKT_LIMIT_REACHED(a) (a->mpa_tx.pkt_cnt>=a->mpa_tx.cur_limit)
 
 /** SDIO Tx aggregation port limit ? */
 #define MP_TX_AGGR_PORT_LIMIT_REACHED(a) ((a->curr_wr_port < \
@@ -239,6 +245,9 @@ Change log:
    a->mpa_tx.start_port = 0;                \
 } while(0);
 
+/** Release packets held by SDIO Tx aggregation and reset it */
+t_void wlan_mp_aggr_tx_cleanup(pmlan_adapter pmadapter);
+
 #endif /* SDIO_MULTI_PORT_TX_AGGR */
 
 #ifdef SDIO_MULTI_PORT_RX_AGGR
@@ -286,6 +295,8 @@ Change log:
 
 /** Enable host interrupt */
 mlan_status wlan_enable_host_int(pmlan_adapter pmadapter);
+/** Disable host interrupt */
+mlan_status wlan_disable_host_int(pmlan_adapter pmadapter);
 /** Probe and initialization function */
 mlan_status wlan_sdio_probe(pmlan_adapter pmadapter);
 /** multi interface download check */
@@ -246,9 +246,13 @@ mlan_register(IN pmlan_device pmdevice, OUT t_void ** ppmlan_adapter)
 #endif
 #ifdef SDIO_MULTI_PORT_TX_AGGR
     pmadapter->init_para.mpa_tx_cfg = pmdevice->mpa_tx_cfg;
+    pmadapter->init_para.mpa_tx_adaptive = pmdevice->mpa_tx_adaptive;
 #endif
 #ifdef SDIO_MULTI_PORT_RX_AGGR
     pmadapter->init_para.mpa_rx_cfg = pmdevice->mpa_rx_cfg;
+#endif
+#ifdef STA_SUPPORT
+    pmadapter->init_para.scan_home_dwell = pmdevice->scan_home_dwell;
 #endif
     pmadapter->init_para.auto_ds = pmdevice->auto_ds;
     pmadapter->init_para.ps_mode = pmdevice->ps_mode;
@@ -690,7 +694,7 @@ mlan_main_process(IN t_void * pmlan_adapter)
                 (pmadapter->tx_lock_flag == MTRUE))
                 break;
 
-            if (pmadapter->scan_processing || pmadapter->data_sent
+            if (SCAN_BLOCKS_TX(pmadapter) || pmadapter->data_sent
                 || (wlan_bypass_tx_list_empty(pmadapter) &&
                     wlan_wmm_lists_empty(pmadapter))
                 || wlan_11h_radar_detected_tx_blocked(pmadapter)
@@ -747,7 +751,7 @@ mlan_main_process(IN t_void * pmlan_adapter)
             }
         }
 
-        if (!pmadapter->scan_processing && !pmadapter->data_sent &&
+        if (!SCAN_BLOCKS_TX(pmadapter) && !pmadapter->data_sent &&
             !wlan_11h_radar_detected_tx_blocked(pmadapter) &&
             !wlan_bypass_tx_list_empty(pmadapter)) {
             PRINTM(MINFO, "mlan_send_pkt(): deq(bybass_txq)\n");
@@ -760,7 +764,7 @@ mlan_main_process(IN t_void * pmlan_adapter)
             }
         }
 
-        if (!pmadapter->scan_processing && !pmadapter->data_sent &&
+        if (!SCAN_BLOCKS_TX(pmadapter) && !pmadapter->data_sent &&
             !wlan_wmm_lists_empty(pmadapter)
             && !wlan_11h_radar_detected_tx_blocked(pmadapter)
             ) {
@@ -944,3 +948,52 @@ mlan_interrupt(IN t_void * adapter)
     wlan_interrupt(pmadapter);
     LEAVE();
 }
+
+/**
+ *  @brief This function reads the interrupt status for the
+ *  		polling mode, with the host interrupts masked.
+ *
+ *  @param adapter  A pointer to mlan_adapter structure
+ *  @return         MTRUE if the card had status pending, otherwise MFALSE
+ */
+t_u8
+mlan_poll_interrupt(IN t_void * adapter)
+{
+    mlan_adapter *pmadapter = (mlan_adapter *) adapter;
+    t_u8 pending = MFALSE;
+
+    ENTER();
+    /* A card going to sleep has nothing more to deliver */
+    if (pmadapter->ps_state != PS_STATE_AWAKE) {
+        LEAVE();
+        return pending;
+    }
+    wlan_interrupt(pmadapter);
+    if (pmadapter->sdio_ireg)
+        pending = MTRUE;
+    LEAVE();
+    return pending;
+}
+
+/**
+ *  @brief This function masks the host interrupts for the polling
+ *  		mode, or unmasks them to go back to the interrupt mode.
+ *
+ *  @param adapter  A pointer to mlan_adapter structure
+ *  @param poll     MTRUE to poll, MFALSE for interrupt mode
+ *  @return         MLAN_STATUS_SUCCESS or MLAN_STATUS_FAILURE
+ */
+mlan_status
+mlan_set_int_mode(IN t_void * adapter, IN t_u8 poll)
+{
+    mlan_adapter *pmadapter = (mlan_adapter *) adapter;
+    mlan_status ret;
+
+    ENTER();
+    if (poll)
+        ret = wlan_disable_host_int(pmadapter);
+    else
+        ret = wlan_enable_host_int(pmadapter);
+    LEAVE();
+    return ret;
+}
@@ -4273,13 +4273,29 @@ wlan_misc_ioctl_sdio_mpa_ctrl(IN pmlan_adapter pmadapter,
 
     if (pioctl_req->action == MLAN_ACT_SET) {
 
-        if (pmpriv->media_connected == MTRUE) {
+        if (mpa_ctrl->tx_buf_size == pmadapter->mpa_tx.buf_size)
+            mpa_ctrl->tx_buf_size = 0;
+        if (mpa_ctrl->rx_buf_size == pmadapter->mpa_rx.buf_size)
+            mpa_ctrl->rx_buf_size = 0;
+
+        /* The aggregation window and adaptive mode may change at any time;
+           switching MP-A on/off or reallocating its buffers may not */
+        if ((pmpriv->media_connected == MTRUE) &&
+            (mpa_ctrl->tx_buf_size || mpa_ctrl->rx_buf_size ||
+             (mpa_ctrl->tx_enable != (t_u16) pmadapter->mpa_tx.enabled) ||
+             (mpa_ctrl->rx_enable != (t_u16) pmadapter->mpa_rx.enabled))) {
             PRINTM(MMSG, "SDIO MPA CTRL: not allowed in connected state\n");
             pioctl_req->status_code = MLAN_ERROR_IOCTL_INVALID;
             ret = MLAN_STATUS_FAILURE;
             goto exit;
         }
 
+        if (mpa_ctrl->tx_adaptive > 1) {
+            pioctl_req->status_code = MLAN_ERROR_INVALID_PARAMETER;
+            ret = MLAN_STATUS_FAILURE;
+            goto exit;
+        }
+
         if (mpa_ctrl->tx_enable > 1) {
             pioctl_req->status_code = MLAN_ERROR_INVALID_PARAMETER;
             ret = MLAN_STATUS_FAILURE;
@@ -4305,18 +4321,21 @@ wlan_misc_ioctl_sdio_mpa_ctrl(IN pmlan_adapter pmadapter,
         }
 
         if (mpa_ctrl->tx_buf_size || mpa_ctrl->rx_buf_size) {
+            t_u32 tx_buf_size = pmadapter->mpa_tx.buf_size;
+            t_u32 rx_buf_size = pmadapter->mpa_rx.buf_size;
 
+            /* Freeing the buffers zeroes their recorded sizes */
+            wlan_mp_aggr_tx_cleanup(pmadapter);
             wlan_free_sdio_mpa_buffers(pmadapter);
 
             if (mpa_ctrl->tx_buf_size > 0)
-                pmadapter->mpa_tx.buf_size = mpa_ctrl->tx_buf_size;
+                tx_buf_size = mpa_ctrl->tx_buf_size;
 
             if (mpa_ctrl->rx_buf_size > 0)
-                pmadapter->mpa_rx.buf_size = mpa_ctrl->rx_buf_size;
+                rx_buf_size = mpa_ctrl->rx_buf_size;
 
-            if (wlan_alloc_sdio_mpa_buffers(pmadapter,
-                                            pmadapter->mpa_tx.buf_size,
-                                            pmadapter->mpa_rx.buf_size) !=
+            if (wlan_alloc_sdio_mpa_buffers(pmadapter, tx_buf_size,
+                                            rx_buf_size) !=
                 MLAN_STATUS_SUCCESS) {
                 PRINTM(MERROR, "Failed to allocate sdio mp-a buffers\n");
                 pioctl_req->status_code = MLAN_ERROR_NO_MEM;
@@ -4333,6 +4352,15 @@ wlan_misc_ioctl_sdio_mpa_ctrl(IN pmlan_adapter pmadapter,
         pmadapter->mpa_tx.enabled = (t_u8) mpa_ctrl->tx_enable;
         pmadapter->mpa_rx.enabled = (t_u8) mpa_ctrl->rx_enable;
 
+        pmadapter->mpa_tx.adaptive = (t_u8) mpa_ctrl->tx_adaptive;
+        pmadapter->mpa_tx.full_cnt = 0;
+        if (pmadapter->mpa_tx.adaptive)
+            pmadapter->mpa_tx.cur_limit =
+                MIN(SDIO_MP_TX_AGGR_ADAPT_MIN_LIMIT,
+                    pmadapter->mpa_tx.pkt_aggr_limit);
+        else
+            pmadapter->mpa_tx.cur_limit = pmadapter->mpa_tx.pkt_aggr_limit;
+
     } else {
         mpa_ctrl->tx_enable = (t_u16) pmadapter->mpa_tx.enabled;
         mpa_ctrl->rx_enable = (t_u16) pmadapter->mpa_rx.enabled;
@@ -4340,6 +4368,8 @@ wlan_misc_ioctl_sdio_mpa_ctrl(IN pmlan_adapter pmadapter,
         mpa_ctrl->rx_buf_size = (t_u16) pmadapter->mpa_rx.buf_size;
         mpa_ctrl->tx_max_ports = (t_u16) pmadapter->mpa_tx.pkt_aggr_limit;
         mpa_ctrl->rx_max_ports = (t_u16) pmadapter->mpa_rx.pkt_aggr_limit;
+        mpa_ctrl->tx_adaptive = (t_u16) pmadapter->mpa_tx.adaptive;
+        mpa_ctrl->tx_cur_ports = (t_u16) pmadapter->mpa_tx.cur_limit;
     }
 
   exit:
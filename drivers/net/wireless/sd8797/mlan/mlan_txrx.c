@@ -185,6 +185,11 @@ wlan_write_data_complete(IN pmlan_adapter pmadapter,
     MASSERT(pmadapter && pmbuf);
 
     pcb = &pmadapter->callbacks;
+    if (pmbuf->flags & MLAN_BUF_FLAG_MPA_HELD) {
+        /* Still gathered in an SDIO Tx aggregate, completed once it is sent */
+        LEAVE();
+        return ret;
+    }
     if ((pmbuf->buf_type == MLAN_BUF_TYPE_DATA) ||
         (pmbuf->buf_type == MLAN_BUF_TYPE_RAW_DATA)) {
         PRINTM(MINFO, "wlan_write_data_complete: DATA %p\n", pmbuf);
@@ -1144,7 +1144,7 @@ wlan_clean_txrx(pmlan_private priv)
     wlan_wmm_cleanup_queues(priv);
     wlan_11n_deleteall_txbastream_tbl(priv);
 #ifdef SDIO_MULTI_PORT_TX_AGGR
-    MP_TX_AGGR_BUF_RESET(priv->adapter);
+    wlan_mp_aggr_tx_cleanup(priv->adapter);
 #endif
 #ifdef SDIO_MULTI_PORT_RX_AGGR
     MP_RX_AGGR_BUF_RESET(priv->adapter);
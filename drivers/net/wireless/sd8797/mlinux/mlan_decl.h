@@ -135,6 +135,10 @@ typedef t_s32 t_sval;
 #define MLAN_MAX_TX_BASTREAM_SUPPORTED     2
 /** This is current limit on Maximum Rx AMPDU allowed */
 #define MLAN_MAX_RX_BASTREAM_SUPPORTED     16
+/** Maximum packets in one SDIO multi-port aggregate */
+#define MLAN_SDIO_MP_AGGR_MAX_PKTS         8
+/** SDIO MP-A histogram buckets, one per packets-per-transaction count 0..8 */
+#define MLAN_MP_AGGR_HIST_NUM              (MLAN_SDIO_MP_AGGR_MAX_PKTS + 1)
 
 #ifdef STA_SUPPORT
 /** Default Win size attached during ADDBA request */
@@ -249,6 +253,9 @@ typedef t_u8 mlan_802_11_mac_addr[MLAN_MAC_ADDR_LENGTH];
 /** Buffer flag for bridge packet */
 #define MLAN_BUF_FLAG_BRIDGE_BUF        MBIT(3)
 
+/** Buffer flag for packet held in a scatter-gather SDIO Tx aggregate */
+#define MLAN_BUF_FLAG_MPA_HELD          MBIT(4)
+
 #ifdef DEBUG_LEVEL1
 /** Debug level bit definition */
 #define	MMSG        MBIT(0)
@@ -726,6 +733,11 @@ typedef struct _mlan_callbacks
     mlan_status(*moal_write_data_sync) (IN t_void * pmoal_handle,
                                         IN pmlan_buffer pmbuf,
                                         IN t_u32 port, IN t_u32 timeout);
+    /** moal_write_data_mp: one CMD53 gathered from several buffers (optional) */
+    mlan_status(*moal_write_data_mp) (IN t_void * pmoal_handle,
+                                      IN pmlan_buffer * pmbuf_arr,
+                                      IN t_u32 num, IN t_u32 port,
+                                      IN t_u32 timeout);
     /** moal_read_data_sync */
     mlan_status(*moal_read_data_sync) (IN t_void * pmoal_handle,
                                        IN OUT pmlan_buffer pmbuf,
@@ -828,10 +840,16 @@ typedef struct _mlan_device
 #ifdef SDIO_MULTI_PORT_TX_AGGR
     /** SDIO MPA Tx */
     t_u32 mpa_tx_cfg;
+    /** SDIO MPA Tx adaptive aggregation */
+    t_u32 mpa_tx_adaptive;
 #endif
 #ifdef SDIO_MULTI_PORT_RX_AGGR
     /** SDIO MPA Rx */
     t_u32 mpa_rx_cfg;
+#endif
+#ifdef STA_SUPPORT
+    /** Return-to-home time between scan commands while connected, in ms */
+    t_u32 scan_home_dwell;
 #endif
     /** Auto deep sleep */
     t_u32 auto_ds;
@@ -884,6 +902,13 @@ MLAN_API mlan_status mlan_recv_packet_complete(IN t_void * pmlan_adapter,
 /** interrupt handler */
 MLAN_API t_void mlan_interrupt(IN t_void * pmlan_adapter);
 
+/** interrupt status poll, host interrupts masked */
+MLAN_API t_u8 mlan_poll_interrupt(IN t_void * pmlan_adapter);
+
+/** switch between interrupt and polling mode */
+MLAN_API mlan_status mlan_set_int_mode(IN t_void * pmlan_adapter,
+                                       IN t_u8 poll);
+
 /** mlan ioctl */
 MLAN_API mlan_status mlan_ioctl(IN t_void * pmlan_adapter,
                                 IN pmlan_ioctl_req pioctl_req);
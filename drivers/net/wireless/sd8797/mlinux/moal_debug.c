@@ -102,6 +102,14 @@ static struct debug_data items[] = {
     ,
     {"scan_processing", item_size(scan_processing), item_addr(scan_processing)}
     ,
+    {"num_scan_home", item_size(num_scan_home), item_addr(num_scan_home)}
+    ,
+    {"scan_off_chan_ms", item_size(scan_off_chan_ms),
+     item_addr(scan_off_chan_ms)}
+    ,
+    {"scan_off_chan_max_ms", item_size(scan_off_chan_max_ms),
+     item_addr(scan_off_chan_max_ms)}
+    ,
     {"num_tx_timeout", item_size(num_tx_timeout), item_addr(num_tx_timeout)}
     ,
     {"num_cmd_timeout", item_size(num_cmd_timeout), item_addr(num_cmd_timeout)}
@@ -415,6 +423,26 @@ woal_debug_read(char *page, char **s, off_t off, int cnt, int *eof, void *data)
         else
             p += sprintf(p, "%s=%d\n", d[i].name, val);
     }
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+    p += sprintf(p, "mpa_tx_limit=%d\n", (int) info.mpa_tx_limit);
+    p += sprintf(p, "mpa_tx_count=");
+    for (i = 1; i < MLAN_MP_AGGR_HIST_NUM; i++)
+        p += sprintf(p, "%u ", info.mpa_tx_count[i]);
+    p += sprintf(p, "\n");
+#endif
+#ifdef SDIO_MULTI_PORT_RX_AGGR
+    p += sprintf(p, "mpa_rx_count=");
+    for (i = 1; i < MLAN_MP_AGGR_HIST_NUM; i++)
+        p += sprintf(p, "%u ", info.mpa_rx_count[i]);
+    p += sprintf(p, "\n");
+#endif
+#ifdef STA_CFG80211
+    if (GET_BSS_ROLE(priv) == MLAN_BSS_ROLE_STA) {
+        p += sprintf(p, "scan_full=%u\n", priv->phandle->num_scan_full);
+        p += sprintf(p, "scan_partial=%u\n", priv->phandle->num_scan_partial);
+        p += sprintf(p, "scan_cached=%u\n", priv->phandle->num_scan_cached);
+    }
+#endif
     if (info.tx_tbl_num) {
         p += sprintf(p, "Tx BA stream table:\n");
         for (i = 0; i < info.tx_tbl_num; i++) {
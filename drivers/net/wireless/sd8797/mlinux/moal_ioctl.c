@@ -926,6 +926,57 @@ woal_set_get_frag(moal_private * priv, t_u32 action,
     return ret;
 }
 
+#if defined(SDIO_MULTI_PORT_TX_AGGR) || defined(SDIO_MULTI_PORT_RX_AGGR)
+/**
+ *  @brief Set/Get SDIO multi-port aggregation parameters
+ *
+ *  @param priv                 A pointer to moal_private structure
+ *  @param action               Action set or get
+ *  @param wait_option          Wait option
+ *  @param mpa_ctrl             A pointer to mlan_ds_misc_sdio_mpa_ctrl structure
+ *
+ *  @return                     MLAN_STATUS_SUCCESS/MLAN_STATUS_PENDING -- success, otherwise fail
+ */
+mlan_status
+woal_set_get_sdio_mpa_ctrl(moal_private * priv, t_u32 action,
+                           t_u8 wait_option,
+                           mlan_ds_misc_sdio_mpa_ctrl * mpa_ctrl)
+{
+    mlan_ioctl_req *req = NULL;
+    mlan_ds_misc_cfg *misc = NULL;
+    mlan_status ret = MLAN_STATUS_SUCCESS;
+    ENTER();
+
+    /* Allocate an IOCTL request buffer */
+    req = woal_alloc_mlan_ioctl_req(sizeof(mlan_ds_misc_cfg));
+    if (req == NULL) {
+        ret = MLAN_STATUS_FAILURE;
+        goto done;
+    }
+
+    /* Fill request buffer */
+    misc = (mlan_ds_misc_cfg *) req->pbuf;
+    misc->sub_command = MLAN_OID_MISC_SDIO_MPA_CTRL;
+    req->req_id = MLAN_IOCTL_MISC_CFG;
+    req->action = action;
+    if (action == MLAN_ACT_SET)
+        memcpy(&misc->param.mpa_ctrl, mpa_ctrl,
+               sizeof(mlan_ds_misc_sdio_mpa_ctrl));
+
+    /* Send IOCTL request to MLAN */
+    ret = woal_request_ioctl(priv, req, wait_option);
+    if (ret == MLAN_STATUS_SUCCESS && action == MLAN_ACT_GET)
+        memcpy(mpa_ctrl, &misc->param.mpa_ctrl,
+               sizeof(mlan_ds_misc_sdio_mpa_ctrl));
+
+  done:
+    if (req && (ret != MLAN_STATUS_PENDING))
+        kfree(req);
+    LEAVE();
+    return ret;
+}
+#endif /* SDIO_MULTI_PORT_TX_AGGR || SDIO_MULTI_PORT_RX_AGGR */
+
 /**
  *  @brief Set/Get generic IE
  *
@@ -129,6 +129,31 @@ struct wifi_platform_data *wifi_control_data = NULL;
 
 int cfg80211_wext = STA_WEXT_MASK | UAP_WEXT_MASK;
 
+/** Deliver received packets through NAPI and GRO */
+int rx_napi = 1;
+/** Packets per NAPI poll */
+int napi_weight = DEF_NAPI_WEIGHT;
+/** Interrupt status poll interval in us under load, 0: interrupt mode only */
+int int_poll = 0;
+
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+/** Adapt the SDIO Tx aggregation limit to the load */
+int mpa_adaptive = 0;
+/** Gather SDIO Tx aggregates from the packets instead of copying them */
+int mpa_tx_sg = 1;
+#endif
+
+#ifdef STA_SUPPORT
+/** Time on the home channel between scan commands while connected, ms */
+int scan_home_dwell = 100;
+#endif
+#ifdef STA_CFG80211
+/** Age in ms up to which a full scan answers a new scan request, 0: off */
+int scan_cache_age = 2000;
+/** Scan only where the requested SSIDs were last seen while connected */
+int partial_scan = 1;
+#endif
+
 /** woal_callbacks */
 static mlan_callbacks woal_callbacks = {
     .moal_get_fw_data = moal_get_fw_data,
@@ -143,6 +168,9 @@ static mlan_callbacks woal_callbacks = {
     .moal_write_reg = moal_write_reg,
     .moal_read_reg = moal_read_reg,
     .moal_write_data_sync = moal_write_data_sync,
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+    .moal_write_data_mp = moal_write_data_mp,
+#endif
     .moal_read_data_sync = moal_read_data_sync,
     .moal_malloc = moal_malloc,
     .moal_mfree = moal_mfree,
@@ -473,6 +501,8 @@ woal_init_sw(moal_handle * handle)
 #else
     device.mpa_tx_cfg = MLAN_INIT_PARA_DISABLED;
 #endif
+    device.mpa_tx_adaptive =
+        mpa_adaptive ? MLAN_INIT_PARA_ENABLED : MLAN_INIT_PARA_DISABLED;
 #endif
 #ifdef SDIO_MULTI_PORT_RX_AGGR
 #ifdef MMC_QUIRK_BLKSZ_FOR_BYTE_MODE
@@ -480,6 +510,9 @@ woal_init_sw(moal_handle * handle)
 #else
     device.mpa_rx_cfg = MLAN_INIT_PARA_DISABLED;
 #endif
+#endif
+#ifdef STA_SUPPORT
+    device.scan_home_dwell = scan_home_dwell > 0 ? scan_home_dwell : 0;
 #endif
 
     for (i = 0; i < handle->drv_mode.intf_num; i++) {
@@ -491,6 +524,13 @@ woal_init_sw(moal_handle * handle)
         device.bss_attr[i].bss_num = handle->drv_mode.bss_attr[i].bss_num;
     }
     memcpy(&device.callbacks, &woal_callbacks, sizeof(mlan_callbacks));
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+    /* A gathered aggregate needs one DMA segment per packet */
+    if (!mpa_tx_sg ||
+        ((struct sdio_mmc_card *) handle->card)->func->card->host->max_segs <
+        MLAN_SDIO_MP_AGGR_MAX_PKTS)
+        device.callbacks.moal_write_data_mp = NULL;
+#endif
 
     sdio_claim_host(((struct sdio_mmc_card *) handle->card)->func);
     if (MLAN_STATUS_SUCCESS == mlan_register(&device, &pmlan))
@@ -1482,6 +1522,15 @@ woal_add_interface(moal_handle * handle, t_u8 bss_index, t_u8 bss_type)
     SET_NETDEV_DEVTYPE(dev, &wlan_type);
 #endif
 
+    /*
+     * Accept page fragments (sendfile/splice) and partial checksums;
+     * woal_hard_start_xmit() flattens and checksums them in software.
+     */
+    dev->features |= NETIF_F_SG | NETIF_F_HW_CSUM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,39)
+    dev->hw_features |= NETIF_F_SG | NETIF_F_HW_CSUM;
+#endif
+
     /* Register network device */
     if (register_netdev(dev)) {
         PRINTM(MERROR, "Cannot register virtual network device\n");
@@ -1683,6 +1732,7 @@ woal_terminate_workqueue(moal_handle * handle)
 
     /* Terminate main workqueue */
     if (handle->workqueue) {
+        woal_int_poll_cancel(handle);
         flush_workqueue(handle->workqueue);
         destroy_workqueue(handle->workqueue);
         handle->workqueue = NULL;
@@ -2373,6 +2423,28 @@ woal_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
         priv->stats.tx_dropped++;
         goto done;
     }
+    if (skb_is_nonlinear(skb)) {
+        /*
+         * Page fragments from sendfile/splice: a single copy straight
+         * into a buffer with the headroom mlan needs, which replaces the
+         * headroom copy below that TCP's cloned skbs would take anyway.
+         */
+        new_skb = skb_copy_expand(skb, MLAN_MIN_DATA_HEADER_LEN +
+                                  sizeof(mlan_buffer), 0, GFP_ATOMIC);
+        dev_kfree_skb_any(skb);
+        if (unlikely(!new_skb)) {
+            PRINTM(MERROR, "Tx: Cannot linearize skb\n");
+            priv->stats.tx_dropped++;
+            goto done;
+        }
+        skb = new_skb;
+    }
+    if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb)) {
+        PRINTM(MERROR, "Tx: Checksum failed\n");
+        dev_kfree_skb_any(skb);
+        priv->stats.tx_dropped++;
+        goto done;
+    }
     if (skb->cloned ||
         (skb_headroom(skb) <
          (MLAN_MIN_DATA_HEADER_LEN + sizeof(mlan_buffer)))) {
@@ -3442,7 +3514,155 @@ woal_main_work_queue(struct work_struct * work)
     mlan_main_process(handle->pmlan_adapter);
     handle->main_state = MOAL_END_MAIN_PROCESS;
     sdio_release_host(((struct sdio_mmc_card *) handle->card)->func);
+    woal_rx_napi_kick(handle);
+
+    LEAVE();
+}
+
+/**
+ * @brief Arm the timer for the next interrupt status poll
+ *
+ * @param handle  A pointer to moal_handle struct
+ *
+ * @return        N/A
+ */
+static void
+woal_int_poll_arm(moal_handle * handle)
+{
+    hrtimer_start(&handle->int_poll_timer,
+                  ktime_set(0, handle->int_poll_us * NSEC_PER_USEC),
+                  HRTIMER_MODE_REL);
+}
+
+/**
+ * @brief Switch to the polling mode when interrupts come back to back
+ *
+ * @param handle  A pointer to moal_handle struct
+ *
+ * @return        N/A
+ */
+static void
+woal_int_poll_start(moal_handle * handle)
+{
+    ktime_t now = ktime_get();
+    s64 gap = ktime_us_delta(now, handle->last_int_time);
+
+    handle->last_int_time = now;
+    /* A lone interrupt is cheaper than masking and unmasking the card */
+    if (handle->int_polling || handle->is_suspended || handle->hs_activated ||
+        gap > (s64) handle->int_poll_us * INT_POLL_IDLE_MAX)
+        return;
+    if (mlan_set_int_mode(handle->pmlan_adapter, MTRUE) != MLAN_STATUS_SUCCESS)
+        return;
+    handle->int_polling = MTRUE;
+    handle->int_poll_idle = 0;
+    handle->int_poll_entries++;
+    woal_int_poll_arm(handle);
+}
+
+/**
+ * @brief Go back to the interrupt mode, SDIO host claimed
+ *
+ * @param handle  A pointer to moal_handle struct
+ *
+ * @return        N/A
+ */
+static void
+woal_int_poll_stop(moal_handle * handle)
+{
+    handle->int_polling = MFALSE;
+    mlan_set_int_mode(handle->pmlan_adapter, MFALSE);
+    /* Pick up status raised after the last poll but before the unmask */
+    if (mlan_poll_interrupt(handle->pmlan_adapter))
+        mlan_main_process(handle->pmlan_adapter);
+}
+
+/**
+ * @brief Interrupt status poll timer, hands the SDIO work to the workqueue
+ *
+ * @param timer   A pointer to hrtimer structure
+ *
+ * @return        HRTIMER_NORESTART
+ */
+static enum hrtimer_restart
+woal_int_poll_timer_func(struct hrtimer *timer)
+{
+    moal_handle *handle = container_of(timer, moal_handle, int_poll_timer);
+
+    queue_work(handle->workqueue, &handle->int_poll_work);
+    return HRTIMER_NORESTART;
+}
+
+/**
+ * @brief Poll the interrupt status and run the main process, in place of
+ * 		the SDIO interrupt while the polling mode is on
+ *
+ * @param work    A pointer to work_struct
+ *
+ * @return        N/A
+ */
+static t_void
+woal_int_poll_work_queue(struct work_struct *work)
+{
+    moal_handle *handle = container_of(work, moal_handle, int_poll_work);
+    struct sdio_func *func = ((struct sdio_mmc_card *) handle->card)->func;
+
+    ENTER();
+    sdio_claim_host(func);
+    if (!handle->int_polling || handle->surprise_removed == MTRUE) {
+        sdio_release_host(func);
+        LEAVE();
+        return;
+    }
+    handle->int_polls++;
+    handle->main_state = MOAL_RECV_INT;
+    if (mlan_poll_interrupt(handle->pmlan_adapter)) {
+        handle->int_poll_hits++;
+        handle->int_poll_idle = 0;
+    } else {
+        handle->int_poll_idle++;
+    }
+    handle->main_state = MOAL_START_MAIN_PROCESS;
+    mlan_main_process(handle->pmlan_adapter);
+    handle->main_state = MOAL_END_MAIN_PROCESS;
+    if (handle->int_poll_idle >= INT_POLL_IDLE_MAX || handle->hs_activated)
+        woal_int_poll_stop(handle);
+    else
+        woal_int_poll_arm(handle);
+    sdio_release_host(func);
+    woal_rx_napi_kick(handle);
+    LEAVE();
+}
+
+/**
+ * @brief Stop polling and return to the interrupt mode
+ *
+ * @param handle  A pointer to moal_handle struct
+ *
+ * @return        N/A
+ */
+void
+woal_int_poll_cancel(moal_handle * handle)
+{
+    struct sdio_func *func;
 
+    ENTER();
+    if (!handle->int_poll_us || !handle->card) {
+        LEAVE();
+        return;
+    }
+    func = ((struct sdio_mmc_card *) handle->card)->func;
+    sdio_claim_host(func);
+    if (handle->int_polling) {
+        if (handle->surprise_removed == MTRUE)
+            handle->int_polling = MFALSE;
+        else
+            woal_int_poll_stop(handle);
+    }
+    sdio_release_host(func);
+    /* With int_polling clear a late timer or work does not re-arm */
+    hrtimer_cancel(&handle->int_poll_timer);
+    cancel_work_sync(&handle->int_poll_work);
     LEAVE();
 }
 
@@ -3469,9 +3689,109 @@ woal_interrupt(moal_handle * handle)
     /* Call MLAN main process */
     mlan_main_process(handle->pmlan_adapter);
     handle->main_state = MOAL_END_MAIN_PROCESS;
+    if (handle->int_poll_us)
+        woal_int_poll_start(handle);
+    woal_rx_napi_kick(handle);
     LEAVE();
 }
 
+/**
+ * @brief NAPI poll: hands queued packets to GRO, up to the budget
+ *
+ * @param napi    A pointer to napi_struct
+ * @param budget  Maximum number of packets to deliver
+ *
+ * @return        Number of packets delivered
+ */
+static int
+woal_napi_poll(struct napi_struct *napi, int budget)
+{
+    moal_handle *handle = container_of(napi, moal_handle, napi);
+    struct sk_buff *skb;
+    int done = 0;
+
+    while (done < budget && (skb = skb_dequeue(&handle->rx_napi_q))) {
+        napi_gro_receive(napi, skb);
+        done++;
+    }
+
+    handle->napi_polls++;
+    handle->napi_pkts += done;
+    handle->napi_hist[done ? MIN(fls(done), NAPI_HIST_BUCKETS - 1) : 0]++;
+    if (done == budget) {
+        handle->napi_full_polls++;
+        return done;
+    }
+
+    napi_complete(napi);
+    /* A packet queued since the last dequeue found the poll still
+       scheduled and did not schedule it again */
+    if (!skb_queue_empty(&handle->rx_napi_q))
+        napi_schedule(napi);
+    return done;
+}
+
+/**
+ * @brief Queue a received packet for the NAPI poll
+ *
+ * The poll is scheduled straight away from the 11n reorder timer. From
+ * the main process it runs once a poll's worth of packets is waiting,
+ * or when the main process is done, so that the packets of one SDIO
+ * aggregate go up the stack together.
+ *
+ * @param handle  A pointer to moal_handle structure
+ * @param skb     A pointer to the packet, with protocol set
+ *
+ * @return        N/A
+ */
+void
+woal_rx_napi_queue(moal_handle * handle, struct sk_buff *skb)
+{
+    /* GRO only merges TCP segments whose checksum it can check, and
+       this is the last time the data is in cache before the stack */
+    skb->csum = csum_partial(skb->data, skb->len, 0);
+    skb->ip_summed = CHECKSUM_COMPLETE;
+
+    skb_queue_tail(&handle->rx_napi_q, skb);
+    if (in_interrupt())
+        napi_schedule(&handle->napi);
+    else if (skb_queue_len(&handle->rx_napi_q) >= handle->napi.weight)
+        woal_rx_napi_kick(handle);
+}
+
+/**
+ * @brief Run the NAPI poll for the packets queued so far
+ *
+ * @param handle  A pointer to moal_handle structure
+ *
+ * @return        N/A
+ */
+void
+woal_rx_napi_kick(moal_handle * handle)
+{
+    if (skb_queue_empty(&handle->rx_napi_q))
+        return;
+    /* the poll runs when bottom halves are enabled again */
+    local_bh_disable();
+    napi_schedule(&handle->napi);
+    local_bh_enable();
+}
+
+/**
+ * @brief Stop NAPI and drop the packets it had not delivered
+ *
+ * @param handle  A pointer to moal_handle structure
+ *
+ * @return        N/A
+ */
+static void
+woal_rx_napi_stop(moal_handle * handle)
+{
+    napi_disable(&handle->napi);
+    netif_napi_del(&handle->napi);
+    skb_queue_purge(&handle->rx_napi_q);
+}
+
 /**
  * @brief This function adds the card. it will probe the
  * 		card, allocate the mlan_private and initialize the device.
@@ -3583,6 +3903,17 @@ woal_add_card(void *card)
         goto err_kmalloc;
 
     MLAN_INIT_WORK(&handle->main_work, woal_main_work_queue);
+    MLAN_INIT_WORK(&handle->int_poll_work, woal_int_poll_work_queue);
+    hrtimer_init(&handle->int_poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    handle->int_poll_timer.function = woal_int_poll_timer_func;
+    handle->int_poll_us = int_poll > 0 ? int_poll : 0;
+
+    skb_queue_head_init(&handle->rx_napi_q);
+    handle->rx_napi = rx_napi ? MTRUE : MFALSE;
+    init_dummy_netdev(&handle->napi_dev);
+    netif_napi_add(&handle->napi_dev, &handle->napi, woal_napi_poll,
+                   napi_weight > 0 ? napi_weight : DEF_NAPI_WEIGHT);
+    napi_enable(&handle->napi);
 
 #ifdef REASSOCIATION
     PRINTM(MINFO, "Starting re-association thread...\n");
@@ -3627,6 +3958,7 @@ woal_add_card(void *card)
     }
 #endif /* REASSOCIATION */
     woal_terminate_workqueue(handle);
+    woal_rx_napi_stop(handle);
   err_kmalloc:
     if ((handle->hardware_status == HardwareStatusFwReady) ||
         (handle->hardware_status == HardwareStatusReady)) {
@@ -3709,6 +4041,8 @@ woal_remove_card(void *card)
                atomic_read(&handle->ioctl_pending));
     }
 
+    woal_rx_napi_stop(handle);
+
     /* Remove interface */
     for (i = 0; i < handle->priv_num; i++)
         woal_remove_interface(handle, i);
@@ -3805,6 +4139,8 @@ woal_switch_drv_mode(moal_handle * handle, t_u32 mode)
                atomic_read(&handle->ioctl_pending));
     }
 
+    woal_rx_napi_stop(handle);
+
     /* Remove interface */
     for (i = 0; i < handle->priv_num; i++)
         woal_remove_interface(handle, i);
@@ -4015,6 +4351,35 @@ MODULE_PARM_DESC(cal_data_cfg, "Calibration data file name");
 module_param(minicard_pwrup, int, 1);
 MODULE_PARM_DESC(minicard_pwrup,
                  "1: Driver load clears PDn/Rst, unload sets (default); 0: Don't do this.");
+module_param(rx_napi, int, 0);
+MODULE_PARM_DESC(rx_napi,
+                 "1: Deliver Rx packets through NAPI and GRO (default); 0: netif_rx per packet");
+module_param(napi_weight, int, 0);
+MODULE_PARM_DESC(napi_weight, "Packets per NAPI poll (64)");
+module_param(int_poll, int, 0);
+MODULE_PARM_DESC(int_poll,
+                 "0: SDIO interrupt per event (default); N: Poll the card status every N us while interrupts keep coming");
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+module_param(mpa_adaptive, int, 0);
+MODULE_PARM_DESC(mpa_adaptive,
+                 "1: Grow/shrink SDIO Tx aggregation with the load; 0: Always aggregate up to max ports (default)");
+module_param(mpa_tx_sg, int, 0);
+MODULE_PARM_DESC(mpa_tx_sg,
+                 "1: Scatter-gather SDIO Tx aggregation, no copy (default); 0: Copy into the aggregation buffer");
+#endif
+#ifdef STA_SUPPORT
+module_param(scan_home_dwell, int, 0);
+MODULE_PARM_DESC(scan_home_dwell,
+                 "N: Return to the home channel for N ms between scan commands while connected (100); 0: Scan straight through");
+#endif
+#ifdef STA_CFG80211
+module_param(scan_cache_age, int, 0644);
+MODULE_PARM_DESC(scan_cache_age,
+                 "N: Answer wildcard scan requests from a full scan less than N ms old (2000); 0: Always scan");
+module_param(partial_scan, int, 0644);
+MODULE_PARM_DESC(partial_scan,
+                 "1: While connected, scan for known SSIDs only on the channels they were seen on (default); 0: Full scans");
+#endif
 module_param(cfg80211_wext, int, 0);
 MODULE_PARM_DESC(cfg80211_wext,
 #ifdef STA_WEXT
@@ -44,6 +44,7 @@ Change log:
 #include        <linux/types.h>
 #include        <linux/sched.h>
 #include        <linux/timer.h>
+#include        <linux/hrtimer.h>
 #include        <linux/ioport.h>
 #include        <linux/pci.h>
 #include        <linux/ctype.h>
@@ -589,6 +590,15 @@ typedef struct _wait_queue
 #define IS_STA_OR_UAP_WEXT(x)       (x & (STA_WEXT_MASK | UAP_WEXT_MASK))
 #endif
 
+/** Default packets per NAPI poll */
+#define DEF_NAPI_WEIGHT    64
+/** Received packets held for NAPI before dropping */
+#define MAX_RX_NAPI_QUEUE  1000
+/** NAPI packets-per-poll histogram: 0, 1, 2-3, 4-7, ... 64 and more */
+#define NAPI_HIST_BUCKETS  8
+/** Empty interrupt status polls before going back to the interrupt mode */
+#define INT_POLL_IDLE_MAX  4
+
 #ifdef STA_SUPPORT
 /** Driver mode STA bit */
 #define DRV_MODE_STA       MBIT(0)
@@ -730,6 +740,8 @@ struct _moal_private
 #ifdef STA_SUPPORT
         /** CFG80211 scan request description */
     struct cfg80211_scan_request *scan_request;
+        /** CFG80211 scan request covers known channels only */
+    t_u8 scan_is_partial;
         /** CFG80211 association description */
     t_u8 cfg_bssid[ETH_ALEN];
         /** Disconnect request from CFG80211 */
@@ -906,6 +918,42 @@ struct _moal_handle
     struct workqueue_struct *workqueue;
         /** main work */
     struct work_struct main_work;
+        /** NAPI context delivering received packets */
+    struct napi_struct napi;
+        /** Dummy net device the NAPI context hangs off */
+    struct net_device napi_dev;
+        /** Received packets waiting for the NAPI poll */
+    struct sk_buff_head rx_napi_q;
+        /** Deliver received packets through NAPI and GRO */
+    t_u8 rx_napi;
+        /** NAPI polls run */
+    t_u32 napi_polls;
+        /** NAPI polls that used up their budget */
+    t_u32 napi_full_polls;
+        /** Packets delivered by NAPI polls */
+    t_u32 napi_pkts;
+        /** Packets dropped because the NAPI queue was full */
+    t_u32 napi_drops;
+        /** Histogram of packets per NAPI poll */
+    t_u32 napi_hist[NAPI_HIST_BUCKETS];
+        /** Interrupt status poll interval in us, 0: interrupt mode only */
+    t_u32 int_poll_us;
+        /** Host interrupts masked, card status polled instead */
+    t_u8 int_polling;
+        /** Consecutive polls that found no status */
+    t_u8 int_poll_idle;
+        /** Time of the last SDIO interrupt */
+    ktime_t last_int_time;
+        /** Timer scheduling the next status poll */
+    struct hrtimer int_poll_timer;
+        /** Status poll work, SDIO transfers may sleep */
+    struct work_struct int_poll_work;
+        /** Switches from the interrupt to the polling mode */
+    t_u32 int_poll_entries;
+        /** Status polls run */
+    t_u32 int_polls;
+        /** Status polls that found interrupt status */
+    t_u32 int_poll_hits;
 #if defined(STA_CFG80211) || defined(UAP_CFG80211)
 #ifdef WIFI_DIRECT_SUPPORT
         /** remain on channel flag */
@@ -953,6 +1001,18 @@ struct _moal_handle
     t_u8 scan_pending_on_block;
         /** Async scan semaphore */
     struct semaphore async_sem;
+#ifdef STA_CFG80211
+        /** jiffies when the last full scan completed, 0: scan table stale */
+    unsigned long scan_cache_time;
+        /** Partial scans since the last full one */
+    t_u8 partial_scans;
+        /** Full scans requested through cfg80211 */
+    t_u32 num_scan_full;
+        /** Partial scans requested through cfg80211 */
+    t_u32 num_scan_partial;
+        /** cfg80211 scan requests answered from the scan table */
+    t_u32 num_scan_cached;
+#endif
 
 #endif
         /** main state */
@@ -1309,6 +1369,13 @@ mlan_status woal_switch_drv_mode(moal_handle * handle, t_u32 mode);
 
 /** Interrupt handler */
 void woal_interrupt(moal_handle * handle);
+/** Stop polling and return to the interrupt mode */
+void woal_int_poll_cancel(moal_handle * handle);
+
+/** Queue a received packet for the NAPI poll */
+void woal_rx_napi_queue(moal_handle * handle, struct sk_buff *skb);
+/** Run the NAPI poll for packets queued by the main process */
+void woal_rx_napi_kick(moal_handle * handle);
 
 #ifdef STA_WEXT
 #endif
@@ -1328,6 +1395,12 @@ int woal_set_drvdbg(moal_private * priv, t_u32 drvdbg);
 /** Set/Get TX beamforming configurations */
 mlan_status woal_set_get_tx_bf_cfg(moal_private * priv, t_u16 action,
                                    mlan_ds_11n_tx_bf_cfg * bf_cfg);
+#if defined(SDIO_MULTI_PORT_TX_AGGR) || defined(SDIO_MULTI_PORT_RX_AGGR)
+/** Set/Get SDIO multi-port aggregation parameters */
+mlan_status woal_set_get_sdio_mpa_ctrl(moal_private * priv, t_u32 action,
+                                       t_u8 wait_option,
+                                       mlan_ds_misc_sdio_mpa_ctrl * mpa_ctrl);
+#endif
 /** Request MAC address setting */
 mlan_status woal_request_set_mac_address(moal_private * priv);
 /** Request multicast list setting */
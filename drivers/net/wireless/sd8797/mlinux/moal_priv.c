@@ -4806,7 +4806,7 @@ woal_cmd53rdwr_ioctl(moal_private * priv, struct iwreq *wrq)
 static int
 woal_do_sdio_mpa_ctrl(moal_private * priv, struct iwreq *wrq)
 {
-    int data[6], data_length = wrq->u.data.length;
+    int data[7], data_length = wrq->u.data.length;
     int ret = 0;
     mlan_ds_misc_cfg *misc = NULL;
     mlan_ioctl_req *req = NULL;
@@ -4848,9 +4848,10 @@ woal_do_sdio_mpa_ctrl(moal_private * priv, struct iwreq *wrq)
         data[3] = misc->param.mpa_ctrl.rx_buf_size;
         data[4] = misc->param.mpa_ctrl.tx_max_ports;
         data[5] = misc->param.mpa_ctrl.rx_max_ports;
+        data[6] = misc->param.mpa_ctrl.tx_adaptive;
 
-        PRINTM(MINFO, "Get Param: %d %d %d %d %d %d\n", data[0], data[1],
-               data[2], data[3], data[4], data[5]);
+        PRINTM(MINFO, "Get Param: %d %d %d %d %d %d %d\n", data[0], data[1],
+               data[2], data[3], data[4], data[5], data[6]);
 
         if (copy_to_user(wrq->u.data.pointer, data, sizeof(data))) {
             ret = -EFAULT;
@@ -4867,6 +4868,8 @@ woal_do_sdio_mpa_ctrl(moal_private * priv, struct iwreq *wrq)
     }
 
     switch (data_length) {
+    case 7:
+        misc->param.mpa_ctrl.tx_adaptive = data[6];
     case 6:
         misc->param.mpa_ctrl.rx_max_ports = data[5];
     case 5:
@@ -4881,8 +4884,8 @@ woal_do_sdio_mpa_ctrl(moal_private * priv, struct iwreq *wrq)
         /* Set cmd */
         req->action = MLAN_ACT_SET;
 
-        PRINTM(MINFO, "Set Param: %d %d %d %d %d %d\n", data[0], data[1],
-               data[2], data[3], data[4], data[5]);
+        PRINTM(MINFO, "Set Param: %d %d %d %d %d %d %d\n", data[0],
+               data[1], data[2], data[3], data[4], data[5], data[6]);
 
         misc->param.mpa_ctrl.tx_enable = data[0];
         break;
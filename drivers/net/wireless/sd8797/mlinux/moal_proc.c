@@ -316,6 +316,11 @@ woal_config_write(struct file *f, const char *buf, unsigned long cnt,
     t_u32 config_data = 0;
     moal_handle *handle = (moal_handle *) data;
     int func, reg, val;
+#if defined(SDIO_MULTI_PORT_TX_AGGR) || defined(SDIO_MULTI_PORT_RX_AGGR)
+    moal_private *priv = woal_get_priv(handle, MLAN_BSS_ROLE_ANY);
+    mlan_ds_misc_sdio_mpa_ctrl mpa_ctrl;
+    int mpa[7], num;
+#endif
 
     ENTER();
     if (!MODULE_GET) {
@@ -355,10 +360,69 @@ woal_config_write(struct file *f, const char *buf, unsigned long cnt,
                 PRINTM(MERROR, "Could not switch drv mode\n");
             }
     }
+    if (!strncmp(databuf, "rx_napi", strlen("rx_napi"))) {
+        line += strlen("rx_napi") + 1;
+        config_data = (t_u32) woal_string_to_number(line);
+        PRINTM(MINFO, "rx_napi: %d\n", (int) config_data);
+        /* packets already queued are still delivered by the poll */
+        handle->rx_napi = config_data ? MTRUE : MFALSE;
+    }
+    if (!strncmp(databuf, "napi_stats", strlen("napi_stats"))) {
+        handle->napi_polls = 0;
+        handle->napi_full_polls = 0;
+        handle->napi_pkts = 0;
+        handle->napi_drops = 0;
+        memset(handle->napi_hist, 0, sizeof(handle->napi_hist));
+    }
+    if (!strncmp(databuf, "int_poll=", strlen("int_poll="))) {
+        line += strlen("int_poll=");
+        config_data = (t_u32) woal_string_to_number(line);
+        PRINTM(MINFO, "int_poll: %d\n", (int) config_data);
+        /* go back to the interrupt mode before changing the interval */
+        woal_int_poll_cancel(handle);
+        handle->int_poll_us = config_data;
+        handle->int_poll_entries = 0;
+        handle->int_polls = 0;
+        handle->int_poll_hits = 0;
+    }
     if (!strncmp(databuf, "sdcmd52rw=", strlen("sdcmd52rw="))) {
         parse_cmd52_string(databuf, (size_t) cnt, &func, &reg, &val);
         woal_sdio_read_write_cmd52(handle, func, reg, val);
     }
+#if defined(SDIO_MULTI_PORT_TX_AGGR) || defined(SDIO_MULTI_PORT_RX_AGGR)
+    if (!strncmp(databuf, "mpactrl=", strlen("mpactrl="))) {
+        /* tx_en rx_en tx_buf rx_buf tx_ports rx_ports adaptive; trailing
+           values may be left out and keep their current setting */
+        line += strlen("mpactrl=");
+        num = sscanf(line, "%d %d %d %d %d %d %d", &mpa[0], &mpa[1], &mpa[2],
+                     &mpa[3], &mpa[4], &mpa[5], &mpa[6]);
+        memset(&mpa_ctrl, 0, sizeof(mpa_ctrl));
+        if (priv && num > 0 &&
+            woal_set_get_sdio_mpa_ctrl(priv, MLAN_ACT_GET, MOAL_PROC_WAIT,
+                                       &mpa_ctrl) == MLAN_STATUS_SUCCESS) {
+            switch (num) {
+            case 7:
+                mpa_ctrl.tx_adaptive = (t_u16) mpa[6];
+            case 6:
+                mpa_ctrl.rx_max_ports = (t_u16) mpa[5];
+            case 5:
+                mpa_ctrl.tx_max_ports = (t_u16) mpa[4];
+            case 4:
+                mpa_ctrl.rx_buf_size = (t_u16) mpa[3];
+            case 3:
+                mpa_ctrl.tx_buf_size = (t_u16) mpa[2];
+            case 2:
+                mpa_ctrl.rx_enable = (t_u16) mpa[1];
+            default:
+                mpa_ctrl.tx_enable = (t_u16) mpa[0];
+                break;
+            }
+            if (woal_set_get_sdio_mpa_ctrl(priv, MLAN_ACT_SET, MOAL_PROC_WAIT,
+                                           &mpa_ctrl) != MLAN_STATUS_SUCCESS)
+                PRINTM(MERROR, "Could not set SDIO MP-A parameters\n");
+        }
+    }
+#endif
     MODULE_PUT;
     LEAVE();
     return (int) cnt;
@@ -380,6 +444,11 @@ woal_config_read(char *page, char **s, off_t off, int cnt, int *eof, void *data)
 {
     char *p = page;
     moal_handle *handle = (moal_handle *) data;
+    int i;
+#if defined(SDIO_MULTI_PORT_TX_AGGR) || defined(SDIO_MULTI_PORT_RX_AGGR)
+    moal_private *priv = woal_get_priv(handle, MLAN_BSS_ROLE_ANY);
+    mlan_ds_misc_sdio_mpa_ctrl mpa_ctrl;
+#endif
 
     ENTER();
     if (!MODULE_GET) {
@@ -391,6 +460,36 @@ woal_config_read(char *page, char **s, off_t off, int cnt, int *eof, void *data)
     p += sprintf(p, "drv_mode=%d\n", (int) drv_mode);
     p += sprintf(p, "sdcmd52rw=%d 0x%0x 0x%02X\n", handle->cmd52_func,
                  handle->cmd52_reg, handle->cmd52_val);
+    p += sprintf(p, "rx_napi=%d\n", (int) handle->rx_napi);
+    p += sprintf(p, "napi_polls=%u full=%u pkts=%u drops=%u queued=%u\n",
+                 handle->napi_polls, handle->napi_full_polls,
+                 handle->napi_pkts, handle->napi_drops,
+                 skb_queue_len(&handle->rx_napi_q));
+    p += sprintf(p, "napi_pkts_per_poll=");
+    for (i = 0; i < NAPI_HIST_BUCKETS; i++) {
+        if (i == 0)
+            p += sprintf(p, "0:%u", handle->napi_hist[i]);
+        else if (i == NAPI_HIST_BUCKETS - 1)
+            p += sprintf(p, " %d+:%u", 1 << (i - 1), handle->napi_hist[i]);
+        else
+            p += sprintf(p, " %d-%d:%u", 1 << (i - 1), (1 << i) - 1,
+                         handle->napi_hist[i]);
+    }
+    p += sprintf(p, "\n");
+    p += sprintf(p, "int_poll=%u\n", handle->int_poll_us);
+    p += sprintf(p, "int_poll_stats=polling:%d entries:%u polls:%u hits:%u\n",
+                 (int) handle->int_polling, handle->int_poll_entries,
+                 handle->int_polls, handle->int_poll_hits);
+#if defined(SDIO_MULTI_PORT_TX_AGGR) || defined(SDIO_MULTI_PORT_RX_AGGR)
+    memset(&mpa_ctrl, 0, sizeof(mpa_ctrl));
+    if (priv && woal_set_get_sdio_mpa_ctrl(priv, MLAN_ACT_GET, MOAL_PROC_WAIT,
+                                           &mpa_ctrl) == MLAN_STATUS_SUCCESS)
+        p += sprintf(p, "mpactrl=%d %d %d %d %d %d %d (tx ports in use %d)\n",
+                     mpa_ctrl.tx_enable, mpa_ctrl.rx_enable,
+                     mpa_ctrl.tx_buf_size, mpa_ctrl.rx_buf_size,
+                     mpa_ctrl.tx_max_ports, mpa_ctrl.rx_max_ports,
+                     mpa_ctrl.tx_adaptive, mpa_ctrl.tx_cur_ports);
+#endif
     MODULE_PUT;
     LEAVE();
     return p - page;
@@ -31,6 +31,8 @@ Change log:
 #include        <linux/mmc/sdio_func.h>
 #include        <linux/mmc/card.h>
 #include        <linux/mmc/host.h>
+#include        <linux/mmc/core.h>
+#include        <linux/scatterlist.h>
 
 #include "moal_main.h"
 
@@ -98,6 +100,11 @@ mlan_status woal_write_data_sync(moal_handle * handle, mlan_buffer * pmbuf,
 /** Function to read data from IO memory */
 mlan_status woal_read_data_sync(moal_handle * handle, mlan_buffer * pmbuf,
                                 t_u32 port, t_u32 timeout);
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+/** Function to write data gathered from several buffers to IO memory */
+mlan_status woal_write_data_mp(moal_handle * handle, mlan_buffer ** pmbuf_arr,
+                               t_u32 num, t_u32 port, t_u32 timeout);
+#endif
 
 /** Register to bus driver function */
 mlan_status woal_bus_register(void);
@@ -344,6 +344,8 @@ woal_sdio_suspend(struct device *dev)
         handle->suspend_notify_req = MFALSE;
 #endif
         if (hs_actived) {
+            /* Leave the card able to wake us with an interrupt */
+            woal_int_poll_cancel(handle);
 #ifdef MMC_PM_SKIP_RESUME_PROBE
             PRINTM(MCMND, "suspend with MMC_PM_KEEP_POWER and "
                    "MMC_PM_SKIP_RESUME_PROBE\n");
@@ -497,6 +499,90 @@ woal_write_data_sync(moal_handle * handle, mlan_buffer * pmbuf, t_u32 port,
     return ret;
 }
 
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+/**
+ *  @brief This function writes several buffers into card memory with a
+ *  single block mode CMD53, letting the host controller gather them
+ *  through its scatter-gather DMA instead of copying them together
+ *
+ *  @param handle   	A Pointer to the moal_handle structure
+ *  @param pmbuf_arr	Array of mlan_buffer pointers, lengths are block multiples
+ *  @param num		Number of buffers
+ *  @param port		Port
+ *  @param timeout 	Time out value
+ *
+ *  @return    		MLAN_STATUS_SUCCESS or MLAN_STATUS_FAILURE
+ */
+mlan_status
+woal_write_data_mp(moal_handle * handle, mlan_buffer ** pmbuf_arr, t_u32 num,
+                   t_u32 port, t_u32 timeout)
+{
+    struct sdio_func *func = ((struct sdio_mmc_card *) handle->card)->func;
+    struct mmc_card *card = func->card;
+    struct scatterlist sg[MLAN_SDIO_MP_AGGR_MAX_PKTS];
+    struct mmc_request mrq;
+    struct mmc_command cmd;
+    struct mmc_data data;
+    t_u32 ioport = (port & MLAN_SDIO_IO_PORT_MASK);
+    t_u32 blkcnt = 0;
+    t_u32 i;
+
+    if (!num || num > ARRAY_SIZE(sg) || num > card->host->max_segs ||
+        (ioport & ~0x1ffff))
+        return MLAN_STATUS_FAILURE;
+
+    sg_init_table(sg, num);
+    for (i = 0; i < num; i++) {
+        sg_set_buf(&sg[i], pmbuf_arr[i]->pbuf + pmbuf_arr[i]->data_offset,
+                   pmbuf_arr[i]->data_len);
+        blkcnt += pmbuf_arr[i]->data_len / MLAN_SDIO_BLOCK_SIZE;
+    }
+    if (!blkcnt || blkcnt > card->host->max_blk_count ||
+        blkcnt > 511 || blkcnt * MLAN_SDIO_BLOCK_SIZE > card->host->max_req_size)
+        return MLAN_STATUS_FAILURE;
+
+    memset(&mrq, 0, sizeof(mrq));
+    memset(&cmd, 0, sizeof(cmd));
+    memset(&data, 0, sizeof(data));
+
+    /* CMD53 write, block mode, fixed address: same as sdio_writesb() */
+    cmd.opcode = SD_IO_RW_EXTENDED;
+    cmd.arg = 0x80000000 | (func->num << 28) | 0x08000000 |
+        (ioport << 9) | blkcnt;
+    cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
+
+    data.blksz = MLAN_SDIO_BLOCK_SIZE;
+    data.blocks = blkcnt;
+    data.flags = MMC_DATA_WRITE;
+    data.sg = sg;
+    data.sg_len = num;
+    mmc_set_data_timeout(&data, card);
+
+    mrq.cmd = &cmd;
+    mrq.data = &data;
+
+#ifdef SDIO_MMC_DEBUG
+    handle->cmd53w = 1;
+#endif
+    mmc_wait_for_req(card->host, &mrq);
+#ifdef SDIO_MMC_DEBUG
+    handle->cmd53w = 2;
+#endif
+
+    if (cmd.error || data.error) {
+        PRINTM(MERROR, "CMD53 sg write failed: cmd %d data %d\n", cmd.error,
+               data.error);
+        return MLAN_STATUS_FAILURE;
+    }
+    if (!mmc_host_is_spi(card->host) &&
+        (cmd.resp[0] & (R5_ERROR | R5_FUNCTION_NUMBER | R5_OUT_OF_RANGE))) {
+        PRINTM(MERROR, "CMD53 sg write: R5 error 0x%x\n", cmd.resp[0]);
+        return MLAN_STATUS_FAILURE;
+    }
+    return MLAN_STATUS_SUCCESS;
+}
+#endif /* SDIO_MULTI_PORT_TX_AGGR */
+
 /**
  *  @brief This function reads multiple bytes from card memory
  *
@@ -655,6 +655,30 @@ moal_write_data_sync(IN t_void * pmoal_handle,
                                 timeout);
 }
 
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+/**
+ *  @brief This function writes several data packets to card in one
+ *         transfer, gathered from the buffers in place.
+ *         This function blocks the call until it finishes
+ *
+ *  @param pmoal_handle Pointer to the MOAL context
+ *  @param pmbuf_arr	Array of mlan buffer structure pointers
+ *  @param num		Number of buffers
+ *  @param port 	Port number for sent
+ *  @param timeout 	Timeout value in milliseconds (if 0 the wait is forever)
+ *
+ *  @return    		MLAN_STATUS_SUCCESS or MLAN_STATUS_FAILURE
+ */
+mlan_status
+moal_write_data_mp(IN t_void * pmoal_handle,
+                   IN pmlan_buffer * pmbuf_arr, IN t_u32 num,
+                   IN t_u32 port, IN t_u32 timeout)
+{
+    return woal_write_data_mp((moal_handle *) pmoal_handle, pmbuf_arr, num,
+                              port, timeout);
+}
+#endif
+
 /**
  *  @brief This function read data packet/event/command from card.
  *         This function blocks the call until it finish
@@ -750,6 +774,20 @@ moal_recv_packet(IN t_void * pmoal_handle, IN pmlan_buffer pmbuf)
                 woal_check_tcp_fin(priv, skb);
             }
 
+            if (priv->phandle->rx_napi == MTRUE) {
+                if (skb_queue_len(&priv->phandle->rx_napi_q) >=
+                    MAX_RX_NAPI_QUEUE) {
+                    priv->phandle->napi_drops++;
+                    priv->stats.rx_dropped++;
+                    dev_kfree_skb_any(skb);
+                    goto done;
+                }
+                priv->stats.rx_bytes += skb->len;
+                priv->stats.rx_packets++;
+                woal_rx_napi_queue(priv->phandle, skb);
+                goto done;
+            }
+
             priv->stats.rx_bytes += skb->len;
             priv->stats.rx_packets++;
             if (in_interrupt())
@@ -845,6 +883,17 @@ moal_recv_event(IN t_void * pmoal_handle, IN pmlan_event pmevent)
             priv->phandle->scan_pending_on_block = MFALSE;
             MOAL_REL_SEMAPHORE(&priv->phandle->async_sem);
         }
+#ifdef STA_CFG80211
+        if (IS_STA_CFG80211(cfg80211_wext)) {
+            /* Only a full cfg80211 scan leaves a table to answer from */
+            if (priv->scan_request && !priv->scan_is_partial) {
+                priv->phandle->scan_cache_time = jiffies;
+                priv->phandle->partial_scans = 0;
+            } else if (!priv->scan_request)
+                priv->phandle->scan_cache_time = 0;
+            priv->scan_is_partial = MFALSE;
+        }
+#endif
 
         if (priv->report_scan_result) {
 #ifdef STA_WEXT
@@ -55,6 +55,11 @@ mlan_status moal_write_data_sync(IN t_void * pmoal_handle,
 mlan_status moal_read_data_sync(IN t_void * pmoal_handle,
                                 IN OUT pmlan_buffer pmbuf,
                                 IN t_u32 port, IN t_u32 timeout);
+#ifdef SDIO_MULTI_PORT_TX_AGGR
+mlan_status moal_write_data_mp(IN t_void * pmoal_handle,
+                               IN pmlan_buffer * pmbuf_arr, IN t_u32 num,
+                               IN t_u32 port, IN t_u32 timeout);
+#endif
 mlan_status moal_recv_packet(IN t_void * pmoal_handle, IN pmlan_buffer pmbuf);
 mlan_status moal_recv_event(IN t_void * pmoal_handle, IN pmlan_event pmevent);
 mlan_status moal_malloc(IN t_void * pmoal_handle,
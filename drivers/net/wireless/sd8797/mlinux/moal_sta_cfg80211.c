@@ -21,6 +21,15 @@
 
 #include "moal_cfg80211.h"
 #include "moal_sta_cfg80211.h"
+
+/** Scan table age (ms) up to which a wildcard scan is answered from it */
+extern int scan_cache_age;
+/** Restrict SSID scans while connected to the channels already known */
+extern int partial_scan;
+
+/** Number of partial scans before a full scan is forced again */
+#define MAX_PARTIAL_SCANS       4
+
 static int woal_cfg80211_reg_notifier(struct wiphy *wiphy,
                                       struct regulatory_request *request);
 
@@ -1517,6 +1526,121 @@ woal_cfg80211_reg_notifier(struct wiphy *wiphy,
     return ret;
 }
 
+/**
+ * @brief Complete a wildcard scan request from a recent scan table
+ *
+ * @param priv            A pointer to moal_private structure
+ * @param request         A pointer to cfg80211_scan_request structure
+ *
+ * @return                MTRUE if the request was completed, otherwise MFALSE
+ */
+static t_u8
+woal_cfg80211_scan_cached(moal_private * priv,
+                          struct cfg80211_scan_request *request)
+{
+    moal_handle *handle = priv->phandle;
+    int i;
+
+    ENTER();
+    if (!scan_cache_age || !handle->scan_cache_time || request->ie_len)
+        goto fail;
+    for (i = 0; i < request->n_ssids; i++) {
+        if (request->ssids[i].ssid_len)
+            goto fail;
+    }
+    if (time_after(jiffies, handle->scan_cache_time +
+                   msecs_to_jiffies(scan_cache_age)))
+        goto fail;
+    if (MLAN_STATUS_SUCCESS != woal_inform_bss_from_scan_result(priv, NULL))
+        goto fail;
+    PRINTM(MINFO, "scan: answered from a %u ms old scan table\n",
+           jiffies_to_msecs(jiffies - handle->scan_cache_time));
+    handle->num_scan_cached++;
+    cfg80211_scan_done(request, MFALSE);
+    LEAVE();
+    return MTRUE;
+  fail:
+    LEAVE();
+    return MFALSE;
+}
+
+/**
+ * @brief Restrict an SSID scan to the channels those SSIDs were last seen on
+ *
+ * @param priv            A pointer to moal_private structure
+ * @param request         A pointer to cfg80211_scan_request structure
+ * @param scan_req        A pointer to wlan_user_scan_cfg structure
+ *
+ * @return                MTRUE if scan_req was restricted, otherwise MFALSE
+ */
+static t_u8
+woal_cfg80211_scan_partial(moal_private * priv,
+                           struct cfg80211_scan_request *request,
+                           wlan_user_scan_cfg * scan_req)
+{
+    moal_handle *handle = priv->phandle;
+    mlan_scan_resp scan_resp;
+    BSSDescriptor_t *scan_table;
+    t_u8 seen[32];
+    t_u8 chan;
+    int i, j, n_chan = 0;
+
+    ENTER();
+    if (!partial_scan || !priv->media_connected || !handle->scan_cache_time ||
+        handle->partial_scans >= MAX_PARTIAL_SCANS || !request->n_ssids ||
+        request->ie_len)
+        goto fail;
+    for (i = 0; i < request->n_ssids; i++) {
+        if (!request->ssids[i].ssid_len)
+            goto fail;
+    }
+
+    memset(&scan_resp, 0, sizeof(scan_resp));
+    if (MLAN_STATUS_SUCCESS !=
+        woal_get_scan_table(priv, MOAL_IOCTL_WAIT, &scan_resp))
+        goto fail;
+
+    /* Channel bitmap of the entries matching any requested SSID */
+    memset(seen, 0, sizeof(seen));
+    scan_table = (BSSDescriptor_t *) scan_resp.pscan_table;
+    for (i = 0; i < scan_resp.num_in_scan_table; i++) {
+        for (j = 0; j < request->n_ssids; j++) {
+            if (scan_table[i].ssid.ssid_len == request->ssids[j].ssid_len &&
+                !memcmp(scan_table[i].ssid.ssid, request->ssids[j].ssid,
+                        request->ssids[j].ssid_len)) {
+                chan = (t_u8) scan_table[i].channel;
+                seen[chan / 8] |= 1 << (chan % 8);
+                break;
+            }
+        }
+    }
+    for (i = 0; i < request->n_channels; i++) {
+        chan = scan_req->chan_list[i].chan_number;
+        if (seen[chan / 8] & (1 << (chan % 8)))
+            n_chan++;
+    }
+    /* Never seen: only a full scan can find them */
+    if (!n_chan)
+        goto fail;
+
+    for (i = 0, j = 0; i < request->n_channels; i++) {
+        chan = scan_req->chan_list[i].chan_number;
+        if (seen[chan / 8] & (1 << (chan % 8)))
+            scan_req->chan_list[j++] = scan_req->chan_list[i];
+    }
+    memset(&scan_req->chan_list[n_chan], 0,
+           (request->n_channels - n_chan) * sizeof(wlan_user_scan_chan));
+    /* The other channels keep their entries from the last full scan */
+    scan_req->keep_previous_scan = MTRUE;
+    PRINTM(MINFO, "scan: partial scan of %d of %d channels\n", n_chan,
+           request->n_channels);
+    LEAVE();
+    return MTRUE;
+  fail:
+    LEAVE();
+    return MFALSE;
+}
+
 /**
  * @brief Request the driver to do a scan. Always returning
  * zero meaning that the scan request is given to driver,
@@ -1546,6 +1670,10 @@ woal_cfg80211_scan(struct wiphy *wiphy, struct net_device *dev,
         LEAVE();
         return -EBUSY;
     }
+    if (woal_cfg80211_scan_cached(priv, request)) {
+        LEAVE();
+        return 0;
+    }
     priv->scan_request = request;
 
     memset(&scan_req, 0x00, sizeof(scan_req));
@@ -1581,6 +1709,14 @@ woal_cfg80211_scan(struct wiphy *wiphy, struct net_device *dev,
             scan_req.chan_list[i].scan_type = MLAN_SCAN_TYPE_ACTIVE;
         scan_req.chan_list[i].scan_time = 0;
     }
+    if (woal_cfg80211_scan_partial(priv, request, &scan_req)) {
+        priv->scan_is_partial = MTRUE;
+        priv->phandle->partial_scans++;
+        priv->phandle->num_scan_partial++;
+    } else {
+        priv->scan_is_partial = MFALSE;
+        priv->phandle->num_scan_full++;
+    }
     if (priv->scan_request->ie && priv->scan_request->ie_len) {
         if (MLAN_STATUS_SUCCESS !=
             woal_cfg80211_mgmt_frame_ie(priv, NULL, 0,
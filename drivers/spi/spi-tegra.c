@@ -35,6 +35,9 @@
 #include <linux/completion.h>
 #include <linux/kthread.h>
 #include <linux/pm_runtime.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 
 #include <linux/spi/spi.h>
 #include <linux/spi-tegra.h>
@@ -170,6 +173,28 @@ static const unsigned long spi_tegra_req_sels[] = {
 #define MAX_CHIP_SELECT		4
 #define SLINK_FIFO_DEPTH	32
 
+/* Initial per chunk overheads, before any chunk has been measured */
+#define PIO_CHUNK_OVERHEAD_NS	20000
+#define DMA_CHUNK_OVERHEAD_NS	60000
+
+/*
+ * PIO chunks shorter than this on the wire are polled for from the pump
+ * or the IRQ thread rather than waited for with an interrupt.
+ */
+static unsigned int poll_max_us = 20;
+module_param(poll_max_us, uint, 0644);
+
+/* Pick PIO or DMA by measured overhead rather than by size alone */
+static bool auto_dma = true;
+module_param(auto_dma, bool, 0644);
+
+/*
+ * Default runtime PM autosuspend delay, the clocks stay on this long after
+ * the queue drains; per controller in power/autosuspend_delay_ms.
+ */
+static unsigned int autosuspend_ms = 10;
+module_param(autosuspend_ms, uint, 0644);
+
 struct spi_tegra_data {
 	struct spi_master	*master;
 	struct platform_device	*pdev;
@@ -243,8 +268,17 @@ struct spi_tegra_data {
 	unsigned long		max_rate;
 	unsigned long		max_parent_rate;
 	int			min_div;
-	struct workqueue_struct *spi_workqueue;
-	struct work_struct spi_transfer_work;
+
+	struct kthread_worker	kworker;
+	struct task_struct	*kworker_task;
+	struct kthread_work	pump_messages;
+
+	bool			use_dma;
+	bool			is_polled;
+	ktime_t			chunk_start;
+	unsigned		chunk_bytes;
+	u32			pio_overhead_ns;
+	u32			dma_overhead_ns;
 };
 
 static inline unsigned long spi_tegra_readl(struct spi_tegra_data *tspi,
@@ -303,6 +337,58 @@ static int tegra_spi_clk_enable(struct spi_tegra_data *tspi)
 	return 0;
 }
 
+/*
+ * Clocks stay on from the first message of a burst until the queue drains,
+ * then for the autosuspend delay so back to back bursts share them.
+ */
+static void spi_tegra_busy(struct spi_tegra_data *tspi)
+{
+	pm_runtime_get_sync(&tspi->pdev->dev);
+}
+
+static void spi_tegra_idle(struct spi_tegra_data *tspi)
+{
+	pm_runtime_mark_last_busy(&tspi->pdev->dev);
+	pm_runtime_put_autosuspend(&tspi->pdev->dev);
+}
+
+static u32 spi_tegra_wire_ns(struct spi_tegra_data *tspi, unsigned bytes)
+{
+	if (!tspi->cur_speed)
+		return 0;
+	return div_u64((u64)bytes * 8 * NSEC_PER_SEC, tspi->cur_speed);
+}
+
+/* Fold the time a chunk took beyond its time on the wire into the mode */
+static void spi_tegra_account_chunk(struct spi_tegra_data *tspi)
+{
+	s64 elapsed = ktime_to_ns(ktime_sub(ktime_get(), tspi->chunk_start));
+	u32 *avg = tspi->is_curr_dma_xfer ? &tspi->dma_overhead_ns :
+		&tspi->pio_overhead_ns;
+	s64 overhead;
+
+	overhead = elapsed - spi_tegra_wire_ns(tspi, tspi->chunk_bytes);
+	if (overhead < 0)
+		overhead = 0;
+	*avg = *avg - (*avg >> 3) + ((u32)min_t(s64, overhead, ~0U) >> 3);
+}
+
+static bool spi_tegra_use_dma(struct spi_tegra_data *tspi,
+	unsigned fifo_words)
+{
+	unsigned pio_chunks, dma_chunks;
+
+	if (!tspi->rx_dma || fifo_words <= SLINK_FIFO_DEPTH)
+		return false;
+	if (!auto_dma)
+		return true;
+
+	pio_chunks = DIV_ROUND_UP(fifo_words, SLINK_FIFO_DEPTH);
+	dma_chunks = DIV_ROUND_UP(fifo_words, tspi->max_buf_size / 4);
+	return dma_chunks * tspi->dma_overhead_ns <
+		pio_chunks * tspi->pio_overhead_ns;
+}
+
 static void cancel_dma(struct tegra_dma_channel *dma_chan,
 	struct tegra_dma_req *req)
 {
@@ -364,6 +450,7 @@ static unsigned spi_tegra_calculate_curr_xfer_param(
 	unsigned bits_per_word ;
 	unsigned max_len;
 	unsigned total_fifo_words;
+	unsigned max_buf_size;
 
 	bits_per_word = t->bits_per_word ? t->bits_per_word :
 						spi->bits_per_word;
@@ -378,13 +465,22 @@ static unsigned spi_tegra_calculate_curr_xfer_param(
 	}
 	tspi->packed_size = spi_tegra_get_packed_size(tspi, t);
 
+	/* A PIO chunk has to fit the fifo */
+	if (tspi->is_packed)
+		total_fifo_words = DIV_ROUND_UP(remain_len, 4);
+	else
+		total_fifo_words = (remain_len - 1) / tspi->bytes_per_word + 1;
+	tspi->use_dma = spi_tegra_use_dma(tspi, total_fifo_words);
+	max_buf_size = tspi->use_dma ? tspi->max_buf_size :
+		SLINK_FIFO_DEPTH * 4;
+
 	if (tspi->is_packed) {
-		max_len = min(remain_len, tspi->max_buf_size);
+		max_len = min(remain_len, max_buf_size);
 		tspi->curr_dma_words = max_len/tspi->bytes_per_word;
 		total_fifo_words = max_len/4;
 	} else {
 		max_word = (remain_len - 1) / tspi->bytes_per_word + 1;
-		max_word = min(max_word, tspi->max_buf_size/4);
+		max_word = min(max_word, max_buf_size/4);
 		tspi->curr_dma_words = max_word;
 		total_fifo_words = max_word;
 	}
@@ -627,6 +723,8 @@ static int spi_tegra_start_dma_based_transfer(
 	}
 	tspi->dma_control_reg = val;
 
+	tspi->chunk_bytes = tspi->curr_dma_words * tspi->bytes_per_word;
+	tspi->chunk_start = ktime_get();
 	val |= SLINK_DMA_EN;
 	spi_tegra_writel(tspi, val, SLINK_DMA_CTL);
 	return ret;
@@ -664,11 +762,31 @@ static int spi_tegra_start_cpu_based_transfer(
 		wmb();
 	}
 	tspi->dma_control_reg = val;
+
+	/*
+	 * Short chunks are done before the IRQ thread could be woken up:
+	 * keep the interrupt off and let spi_tegra_run_polled() finish it.
+	 */
+	tspi->chunk_bytes = curr_words * tspi->bytes_per_word;
+	if (poll_max_us && spi_tegra_wire_ns(tspi, tspi->chunk_bytes) <=
+				poll_max_us * NSEC_PER_USEC) {
+		disable_irq_nosync(tspi->irq);
+		tspi->is_polled = true;
+	}
+	tspi->chunk_start = ktime_get();
 	val |= SLINK_DMA_EN;
 	spi_tegra_writel(tspi, val, SLINK_DMA_CTL);
 	return 0;
 }
 
+static int spi_tegra_start_chunk(struct spi_tegra_data *tspi,
+		struct spi_transfer *t)
+{
+	if (tspi->use_dma)
+		return spi_tegra_start_dma_based_transfer(tspi, t);
+	return spi_tegra_start_cpu_based_transfer(tspi, t);
+}
+
 static void set_best_clk_source(struct spi_tegra_data *tspi,
 		unsigned long speed)
 {
@@ -734,7 +852,6 @@ static void spi_tegra_start_transfer(struct spi_device *spi,
 	struct spi_tegra_data *tspi = spi_master_get_devdata(spi->master);
 	u32 speed;
 	u8 bits_per_word;
-	unsigned total_fifo_words;
 	int ret;
 	struct tegra_spi_device_controller_data *cdata = spi->controller_data;
 	unsigned long command;
@@ -769,13 +886,10 @@ static void spi_tegra_start_transfer(struct spi_device *spi,
 	tspi->cur_tx_pos = 0;
 	tspi->rx_complete = 0;
 	tspi->tx_complete = 0;
-	total_fifo_words = spi_tegra_calculate_curr_xfer_param(spi, tspi, t);
+	spi_tegra_calculate_curr_xfer_param(spi, tspi, t);
 
 	command2 = tspi->def_command2_reg;
 	if (is_first_of_msg) {
-		pm_runtime_get_sync(&tspi->pdev->dev);
-		tegra_spi_clk_enable(tspi);
-
 		spi_tegra_clear_status(tspi);
 
 		command = tspi->def_command_reg;
@@ -844,10 +958,7 @@ static void spi_tegra_start_transfer(struct spi_device *spi,
 	spi_tegra_writel(tspi, command2, SLINK_COMMAND2);
 	tspi->command2_reg = command2;
 
-	if (total_fifo_words > SLINK_FIFO_DEPTH)
-		ret = spi_tegra_start_dma_based_transfer(tspi, t);
-	else
-		ret = spi_tegra_start_cpu_based_transfer(tspi, t);
+	ret = spi_tegra_start_chunk(tspi, t);
 	WARN_ON(ret < 0);
 }
 
@@ -886,8 +997,7 @@ static int spi_tegra_setup(struct spi_device *spi)
 		return -EINVAL;
 	}
 
-	pm_runtime_get_sync(&tspi->pdev->dev);
-	tegra_spi_clk_enable(tspi);
+	spi_tegra_busy(tspi);
 
 	spin_lock_irqsave(&tspi->lock, flags);
 	val = tspi->def_command_reg;
@@ -899,12 +1009,13 @@ static int spi_tegra_setup(struct spi_device *spi)
 	spi_tegra_writel(tspi, tspi->def_command_reg, SLINK_COMMAND);
 	spin_unlock_irqrestore(&tspi->lock, flags);
 
-	tegra_spi_clk_disable(tspi);
-	pm_runtime_put_sync(&tspi->pdev->dev);
+	spi_tegra_idle(tspi);
 	return 0;
 }
 
-static void tegra_spi_transfer_work(struct work_struct *work)
+static void spi_tegra_run_polled(struct spi_tegra_data *tspi);
+
+static void tegra_spi_pump_messages(struct kthread_work *work)
 {
 	struct spi_tegra_data *tspi;
 	struct spi_device *spi;
@@ -913,7 +1024,7 @@ static void tegra_spi_transfer_work(struct work_struct *work)
 	int single_xfer = 0;
 	unsigned long flags;
 
-	tspi = container_of(work, struct spi_tegra_data, spi_transfer_work);
+	tspi = container_of(work, struct spi_tegra_data, pump_messages);
 
 	spin_lock_irqsave(&tspi->lock, flags);
 
@@ -935,7 +1046,9 @@ static void tegra_spi_transfer_work(struct work_struct *work)
 	tspi->is_transfer_in_progress = true;
 
 	spin_unlock_irqrestore(&tspi->lock, flags);
+	spi_tegra_busy(tspi);
 	spi_tegra_start_transfer(spi, t, true, single_xfer);
+	spi_tegra_run_polled(tspi);
 }
 
 static int spi_tegra_transfer(struct spi_device *spi, struct spi_message *m)
@@ -979,8 +1092,8 @@ static int spi_tegra_transfer(struct spi_device *spi, struct spi_message *m)
 	m->state = spi;
 	was_empty = list_empty(&tspi->queue);
 	list_add_tail(&m->queue, &tspi->queue);
-	if (was_empty)
-		queue_work(tspi->spi_workqueue, &tspi->spi_transfer_work);
+	if (was_empty && !tspi->is_transfer_in_progress)
+		queue_kthread_work(&tspi->kworker, &tspi->pump_messages);
 
 	spin_unlock_irqrestore(&tspi->lock, flags);
 	return 0;
@@ -1027,6 +1140,9 @@ static void spi_tegra_curr_transfer_complete(struct spi_tegra_data *tspi,
 						SLINK_COMMAND);
 				spi_tegra_writel(tspi, tspi->def_command2_reg,
 						SLINK_COMMAND2);
+				spin_unlock_irqrestore(&tspi->lock, *irq_flags);
+				spi_tegra_idle(tspi);
+				spin_lock_irqsave(&tspi->lock, *irq_flags);
 				tspi->is_transfer_in_progress = false;
 				return;
 			}
@@ -1050,14 +1166,14 @@ static void spi_tegra_curr_transfer_complete(struct spi_tegra_data *tspi,
 			/* Provide delay to stablize the signal state */
 			spin_unlock_irqrestore(&tspi->lock, *irq_flags);
 			udelay(10);
-			tegra_spi_clk_disable(tspi);
-			pm_runtime_put_sync(&tspi->pdev->dev);
+			spi_tegra_idle(tspi);
 			spin_lock_irqsave(&tspi->lock, *irq_flags);
 			tspi->is_transfer_in_progress = false;
 			/* Check if any new request has come between
 			 * clock disable */
-			queue_work(tspi->spi_workqueue,
-					&tspi->spi_transfer_work);
+			if (!list_empty(&tspi->queue))
+				queue_kthread_work(&tspi->kworker,
+						&tspi->pump_messages);
 		}
 	}
 	return;
@@ -1120,7 +1236,7 @@ static void handle_cpu_based_xfer(void *context_data)
 	}
 
 	spi_tegra_calculate_curr_xfer_param(tspi->cur_spi, tspi, t);
-	spi_tegra_start_cpu_based_transfer(tspi, t);
+	spi_tegra_start_chunk(tspi, t);
 exit:
 	spin_unlock_irqrestore(&tspi->lock, flags);
 	return;
@@ -1132,11 +1248,12 @@ static irqreturn_t spi_tegra_isr_thread(int irq, void *context_data)
 	struct spi_transfer *t = tspi->cur;
 	long wait_status;
 	int err = 0;
-	unsigned total_fifo_words;
 	unsigned long flags;
 
+	spi_tegra_account_chunk(tspi);
 	if (!tspi->is_curr_dma_xfer) {
 		handle_cpu_based_xfer(context_data);
+		spi_tegra_run_polled(tspi);
 		return IRQ_HANDLED;
 	}
 
@@ -1186,6 +1303,7 @@ static irqreturn_t spi_tegra_isr_thread(int irq, void *context_data)
 		WARN_ON(1);
 		spi_tegra_curr_transfer_complete(tspi, err, t->len, &flags);
 		spin_unlock_irqrestore(&tspi->lock, flags);
+		spi_tegra_run_polled(tspi);
 		return IRQ_HANDLED;
 	}
 
@@ -1203,19 +1321,17 @@ static irqreturn_t spi_tegra_isr_thread(int irq, void *context_data)
 		spi_tegra_curr_transfer_complete(tspi,
 			tspi->tx_status || tspi->rx_status, t->len, &flags);
 		spin_unlock_irqrestore(&tspi->lock, flags);
+		spi_tegra_run_polled(tspi);
 		return IRQ_HANDLED;
 	}
 
 	/* Continue transfer in current message */
-	total_fifo_words = spi_tegra_calculate_curr_xfer_param(tspi->cur_spi,
-							tspi, t);
-	if (total_fifo_words > SLINK_FIFO_DEPTH)
-		err = spi_tegra_start_dma_based_transfer(tspi, t);
-	else
-		err = spi_tegra_start_cpu_based_transfer(tspi, t);
+	spi_tegra_calculate_curr_xfer_param(tspi->cur_spi, tspi, t);
+	err = spi_tegra_start_chunk(tspi, t);
 
 	spin_unlock_irqrestore(&tspi->lock, flags);
 	WARN_ON(err < 0);
+	spi_tegra_run_polled(tspi);
 	return IRQ_HANDLED;
 }
 
@@ -1237,6 +1353,33 @@ static irqreturn_t spi_tegra_isr(int irq, void *context_data)
 	return IRQ_WAKE_THREAD;
 }
 
+/*
+ * Finish polled PIO chunks, and the ones they lead to, in the calling
+ * thread. If one takes too long its interrupt is turned back on and the
+ * IRQ thread takes over.
+ */
+static void spi_tegra_run_polled(struct spi_tegra_data *tspi)
+{
+	ktime_t deadline;
+
+	while (tspi->is_polled) {
+		tspi->is_polled = false;
+		deadline = ktime_add_us(tspi->chunk_start, 2 * poll_max_us);
+		while (!(spi_tegra_readl(tspi, SLINK_STATUS) & SLINK_RDY)) {
+			if (ktime_to_ns(ktime_sub(ktime_get(), deadline)) > 0) {
+				enable_irq(tspi->irq);
+				return;
+			}
+			cpu_relax();
+		}
+
+		spi_tegra_isr(tspi->irq, tspi);
+		enable_irq(tspi->irq);
+		spi_tegra_account_chunk(tspi);
+		handle_cpu_based_xfer(tspi);
+	}
+}
+
 static void spi_tegra_deinit_dma_param(struct spi_tegra_data *tspi,
 	bool dma_to_memory)
 {
@@ -1326,7 +1469,7 @@ static int __init spi_tegra_probe(struct platform_device *pdev)
 	struct tegra_spi_platform_data *pdata = pdev->dev.platform_data;
 	int ret, spi_irq;
 	int i;
-	char spi_wq_name[20];
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO / 2 };
 
 	master = spi_alloc_master(&pdev->dev, sizeof *tspi);
 	if (master == NULL) {
@@ -1421,6 +1564,8 @@ static int __init spi_tegra_probe(struct platform_device *pdev)
 
 	tspi->max_parent_rate = 0;
 	tspi->min_div = 0;
+	tspi->pio_overhead_ns = PIO_CHUNK_OVERHEAD_NS;
+	tspi->dma_overhead_ns = DMA_CHUNK_OVERHEAD_NS;
 
 	if (tspi->parent_clk_count) {
 		tspi->max_parent_rate = tspi->parent_clk_list[0].fixed_clk_rate;
@@ -1457,22 +1602,27 @@ static int __init spi_tegra_probe(struct platform_device *pdev)
 	tspi->def_command2_reg = SLINK_CS_ACTIVE_BETWEEN;
 
 skip_dma_alloc:
+	pm_runtime_set_autosuspend_delay(&pdev->dev, autosuspend_ms);
+	pm_runtime_use_autosuspend(&pdev->dev);
 	pm_runtime_enable(&pdev->dev);
+	if (!pm_runtime_enabled(&pdev->dev))
+		tegra_spi_clk_enable(tspi);
 
 	/* Enable clock if it is require to be enable always */
 	if (tspi->is_clkon_always)
 		tegra_spi_clk_enable(tspi);
 
-	/* create the workqueue for the spi transfer */
-	snprintf(spi_wq_name, sizeof(spi_wq_name), "spi_tegra-%d", pdev->id);
-	tspi->spi_workqueue = create_singlethread_workqueue(spi_wq_name);
-	if (!tspi->spi_workqueue) {
-		dev_err(&pdev->dev, "Failed to create work queue\n");
-		ret = -ENODEV;
+	/* realtime message pump, next to the IRQ thread that continues it */
+	init_kthread_worker(&tspi->kworker);
+	tspi->kworker_task = kthread_run(kthread_worker_fn, &tspi->kworker,
+					"spi_tegra-%d", pdev->id);
+	if (IS_ERR(tspi->kworker_task)) {
+		dev_err(&pdev->dev, "Failed to create message pump\n");
+		ret = PTR_ERR(tspi->kworker_task);
 		goto exit_fail_wq;
 	}
-
-	INIT_WORK(&tspi->spi_transfer_work, tegra_spi_transfer_work);
+	sched_setscheduler(tspi->kworker_task, SCHED_FIFO, &param);
+	init_kthread_work(&tspi->pump_messages, tegra_spi_pump_messages);
 
 	master->dev.of_node = pdev->dev.of_node;
 	ret = spi_register_master(master);
@@ -1481,16 +1631,23 @@ skip_dma_alloc:
 		goto exit_destry_wq;
 	}
 
+	/* slaves are children of the master and wait for it */
+	device_enable_async_suspend(&pdev->dev);
+
 	return ret;
 
 exit_destry_wq:
-	destroy_workqueue(tspi->spi_workqueue);
+	flush_kthread_worker(&tspi->kworker);
+	kthread_stop(tspi->kworker_task);
 
 exit_fail_wq:
 	if (tspi->is_clkon_always)
 		tegra_spi_clk_disable(tspi);
 
 	pm_runtime_disable(&pdev->dev);
+	if (!pm_runtime_status_suspended(&pdev->dev))
+		tegra_spi_clk_disable(tspi);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
 
 	spi_tegra_deinit_dma_param(tspi, false);
 
@@ -1523,8 +1680,12 @@ static int __devexit spi_tegra_remove(struct platform_device *pdev)
 		tegra_spi_clk_disable(tspi);
 
 	pm_runtime_disable(&pdev->dev);
+	if (!pm_runtime_status_suspended(&pdev->dev))
+		tegra_spi_clk_disable(tspi);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
 
-	destroy_workqueue(tspi->spi_workqueue);
+	flush_kthread_worker(&tspi->kworker);
+	kthread_stop(tspi->kworker_task);
 
 	return 0;
 }
@@ -1579,6 +1740,10 @@ static int spi_tegra_suspend(struct device *dev)
 	if (tspi->is_clkon_always)
 		tegra_spi_clk_disable(tspi);
 
+	/* the PM core holds off runtime PM, drop an autosuspend pending */
+	if (!pm_runtime_status_suspended(dev))
+		tegra_spi_clk_disable(tspi);
+
 	return 0;
 }
 
@@ -1595,12 +1760,12 @@ static int spi_tegra_resume(struct device *dev)
 	/* Enable clock if it is always enabled */
 	if (tspi->is_clkon_always)
 		tegra_spi_clk_enable(tspi);
+	if (!pm_runtime_status_suspended(dev))
+		tegra_spi_clk_enable(tspi);
 
-	pm_runtime_get_sync(dev);
-	tegra_spi_clk_enable(tspi);
+	spi_tegra_busy(tspi);
 	spi_tegra_writel(tspi, tspi->command_reg, SLINK_COMMAND);
-	tegra_spi_clk_disable(tspi);
-	pm_runtime_put_sync(dev);
+	spi_tegra_idle(tspi);
 
 	spin_lock_irqsave(&tspi->lock, flags);
 
@@ -1617,17 +1782,40 @@ static int spi_tegra_resume(struct device *dev)
 		tspi->is_transfer_in_progress = true;
 	}
 	spin_unlock_irqrestore(&tspi->lock, flags);
-	if (t)
+	if (t) {
+		spi_tegra_busy(tspi);
 		spi_tegra_start_transfer(spi, t, true, single_xfer);
+		spi_tegra_run_polled(tspi);
+	}
 	return 0;
 }
 #endif
 
+#ifdef CONFIG_PM_RUNTIME
+static int spi_tegra_runtime_suspend(struct device *dev)
+{
+	struct spi_master *master = dev_get_drvdata(dev);
+	struct spi_tegra_data *tspi = spi_master_get_devdata(master);
+
+	return tegra_spi_clk_disable(tspi);
+}
+
+static int spi_tegra_runtime_resume(struct device *dev)
+{
+	struct spi_master *master = dev_get_drvdata(dev);
+	struct spi_tegra_data *tspi = spi_master_get_devdata(master);
+
+	return tegra_spi_clk_enable(tspi);
+}
+#endif
+
 static const struct dev_pm_ops tegra_spi_dev_pm_ops = {
 #ifdef CONFIG_PM
 	.suspend = spi_tegra_suspend,
 	.resume = spi_tegra_resume,
 #endif
+	SET_RUNTIME_PM_OPS(spi_tegra_runtime_suspend,
+			   spi_tegra_runtime_resume, NULL)
 };
 
 MODULE_ALIAS("platform:spi_tegra");
@@ -36,8 +36,53 @@
 
 #include "binder.h"
 
-static DEFINE_MUTEX(binder_lock);
-static DEFINE_MUTEX(binder_deferred_lock);
+/*
+ * Lock order: binder_main_lock, then a proc's threads_lock or
+ * binder_procs_lock. binder_deferred_lock nests inside binder_main_lock.
+ *
+ * binder_main_lock still covers nodes, refs, buffers, transactions and the
+ * context manager, which binder_transaction() touches in both the sending
+ * and the receiving proc. binder_procs_lock only guards the binder_procs
+ * list and each proc's threads_lock only its thread tree, so opening the
+ * device, looking up the calling thread and polling no longer wait for
+ * transactions of unrelated processes.
+ */
+struct binder_lock {
+	struct mutex lock;
+	unsigned long acquired;
+	unsigned long contended;
+	u64 wait_ns;
+	u64 max_wait_ns;
+};
+
+#define BINDER_LOCK_INIT(name) { .lock = __MUTEX_INITIALIZER(name.lock) }
+
+static struct binder_lock binder_main_lock = BINDER_LOCK_INIT(binder_main_lock);
+static struct binder_lock binder_procs_lock = BINDER_LOCK_INIT(binder_procs_lock);
+static struct binder_lock binder_deferred_lock =
+	BINDER_LOCK_INIT(binder_deferred_lock);
+
+static void binder_lock(struct binder_lock *l)
+{
+	u64 start, wait;
+
+	if (!mutex_trylock(&l->lock)) {
+		start = local_clock();
+		mutex_lock(&l->lock);
+		wait = local_clock() - start;
+		/* Counted under the lock itself */
+		l->contended++;
+		l->wait_ns += wait;
+		if (wait > l->max_wait_ns)
+			l->max_wait_ns = wait;
+	}
+	l->acquired++;
+}
+
+static void binder_unlock(struct binder_lock *l)
+{
+	mutex_unlock(&l->lock);
+}
 
 static HLIST_HEAD(binder_procs);
 static HLIST_HEAD(binder_deferred_list);
@@ -105,6 +150,19 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static int binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/*
+ * Pages freed from a proc's buffer stay mapped, up to its recent peak of
+ * pages in use but at most warm_pages, so the next transaction of similar
+ * size does not allocate and map them again. The peak restarts from the
+ * current use after warm_decay_ms without a new peak. 0 disables.
+ */
+static unsigned int binder_warm_pages = 64;
+module_param_named(warm_pages, binder_warm_pages, uint, S_IWUSR | S_IRUGO);
+
+static unsigned int binder_warm_decay_ms = 5000;
+module_param_named(warm_decay_ms, binder_warm_decay_ms, uint,
+		   S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -148,20 +206,20 @@ enum binder_stat_types {
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
 	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
-	int obj_created[BINDER_STAT_COUNT];
-	int obj_deleted[BINDER_STAT_COUNT];
+	atomic_t obj_created[BINDER_STAT_COUNT];
+	atomic_t obj_deleted[BINDER_STAT_COUNT];
 };
 
 static struct binder_stats binder_stats;
 
 static inline void binder_stats_deleted(enum binder_stat_types type)
 {
-	binder_stats.obj_deleted[type]++;
+	atomic_inc(&binder_stats.obj_deleted[type]);
 }
 
 static inline void binder_stats_created(enum binder_stat_types type)
 {
-	binder_stats.obj_created[type]++;
+	atomic_inc(&binder_stats.obj_created[type]);
 }
 
 struct binder_transaction_log_entry {
@@ -279,8 +337,21 @@ enum binder_deferred_state {
 	BINDER_DEFERRED_RELEASE      = 0x04,
 };
 
+struct binder_alloc_stats {
+	unsigned long allocs;
+	unsigned long failed;
+	u64 total_ns;
+	u64 max_ns;
+	unsigned long page_maps;
+	unsigned long page_map_failed;
+	unsigned long page_warm_hits;
+	unsigned long page_unmaps;
+	unsigned long page_kept;
+};
+
 struct binder_proc {
 	struct hlist_node proc_node;
+	struct binder_lock threads_lock;
 	struct rb_root threads;
 	struct rb_root nodes;
 	struct rb_root refs_by_desc;
@@ -302,6 +373,11 @@ struct binder_proc {
 	struct page **pages;
 	size_t buffer_size;
 	uint32_t buffer_free;
+	size_t pages_used;
+	size_t pages_idle;
+	size_t pages_peak;
+	unsigned long pages_peak_stamp;
+	struct binder_alloc_stats alloc_stats;
 	struct list_head todo;
 	wait_queue_head_t wait;
 	struct binder_stats stats;
@@ -607,6 +683,37 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 	return NULL;
 }
 
+static void binder_update_pages_peak(struct binder_proc *proc)
+{
+	if (proc->pages_used >= proc->pages_peak ||
+	    time_after(jiffies, proc->pages_peak_stamp +
+		       msecs_to_jiffies(binder_warm_decay_ms))) {
+		proc->pages_peak = proc->pages_used;
+		proc->pages_peak_stamp = jiffies;
+	}
+}
+
+/*
+ * Leaves the pages of [start, end) mapped but idle if they fit in the warm
+ * set, so binder_update_page_range() does not have to unmap them.
+ */
+static int binder_keep_pages(struct binder_proc *proc, void *start, void *end)
+{
+	size_t count = (end - start) / PAGE_SIZE;
+	size_t limit;
+
+	binder_update_pages_peak(proc);
+	limit = min_t(size_t, binder_warm_pages,
+		      proc->pages_peak - min(proc->pages_peak, proc->pages_used));
+	if (!proc->vma || proc->pages_idle + count > limit)
+		return 0;
+
+	proc->pages_used -= count;
+	proc->pages_idle += count;
+	proc->alloc_stats.page_kept += count;
+	return 1;
+}
+
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				    void *start, void *end,
 				    struct vm_area_struct *vma)
@@ -624,6 +731,9 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	if (end <= start)
 		return 0;
 
+	if (allocate == 0 && binder_keep_pages(proc, start, end))
+		return 0;
+
 	if (vma)
 		mm = NULL;
 	else
@@ -648,7 +758,14 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
+		if (*page) {
+			/* Still mapped from a buffer freed earlier */
+			BUG_ON(!proc->pages_idle);
+			proc->pages_idle--;
+			proc->pages_used++;
+			proc->alloc_stats.page_warm_hits++;
+			continue;
+		}
 		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
 		if (*page == NULL) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
@@ -675,6 +792,8 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 			goto err_vm_insert_page_failed;
 		}
 		/* vm_insert_page does not seem to increment the refcount */
+		proc->pages_used++;
+		proc->alloc_stats.page_maps++;
 	}
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -686,6 +805,8 @@ free_range:
 	for (page_addr = end - PAGE_SIZE; page_addr >= start;
 	     page_addr -= PAGE_SIZE) {
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		proc->pages_used--;
+		proc->alloc_stats.page_unmaps++;
 		if (vma)
 			zap_page_range(vma, (uintptr_t)page_addr +
 				proc->user_buffer_offset, PAGE_SIZE, NULL);
@@ -698,6 +819,8 @@ err_alloc_page_failed:
 		;
 	}
 err_no_vma:
+	if (allocate)
+		proc->alloc_stats.page_map_failed++;
 	if (mm) {
 		up_write(&mm->mmap_sem);
 		mmput(mm);
@@ -705,9 +828,10 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -811,6 +935,28 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async)
+{
+	struct binder_alloc_stats *stats = &proc->alloc_stats;
+	struct binder_buffer *buffer;
+	u64 start, elapsed;
+
+	start = local_clock();
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size, is_async);
+	elapsed = local_clock() - start;
+
+	stats->allocs++;
+	if (!buffer)
+		stats->failed++;
+	stats->total_ns += elapsed;
+	if (elapsed > stats->max_ns)
+		stats->max_ns = elapsed;
+	binder_update_pages_peak(proc);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -2232,7 +2378,7 @@ retry:
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
 	if (wait_for_proc_work)
 		proc->ready_threads++;
-	mutex_unlock(&binder_lock);
+	binder_unlock(&binder_main_lock);
 	if (wait_for_proc_work) {
 		if (!(thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 					BINDER_LOOPER_STATE_ENTERED))) {
@@ -2256,7 +2402,7 @@ retry:
 		} else
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
-	mutex_lock(&binder_lock);
+	binder_lock(&binder_main_lock);
 	if (wait_for_proc_work)
 		proc->ready_threads--;
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
@@ -2521,6 +2667,7 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 	struct rb_node *parent = NULL;
 	struct rb_node **p = &proc->threads.rb_node;
 
+	binder_lock(&proc->threads_lock);
 	while (*p) {
 		parent = *p;
 		thread = rb_entry(parent, struct binder_thread, rb_node);
@@ -2535,7 +2682,7 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 	if (*p == NULL) {
 		thread = kzalloc(sizeof(*thread), GFP_KERNEL);
 		if (thread == NULL)
-			return NULL;
+			goto out;
 		binder_stats_created(BINDER_STAT_THREAD);
 		thread->proc = proc;
 		thread->pid = current->pid;
@@ -2547,6 +2694,8 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 		thread->return_error = BR_OK;
 		thread->return_error2 = BR_OK;
 	}
+out:
+	binder_unlock(&proc->threads_lock);
 	return thread;
 }
 
@@ -2557,7 +2706,9 @@ static int binder_free_thread(struct binder_proc *proc,
 	struct binder_transaction *send_reply = NULL;
 	int active_transactions = 0;
 
+	binder_lock(&proc->threads_lock);
 	rb_erase(&thread->rb_node, &proc->threads);
+	binder_unlock(&proc->threads_lock);
 	t = thread->transaction_stack;
 	if (t && t->to_thread == thread)
 		send_reply = t;
@@ -2598,12 +2749,17 @@ static unsigned int binder_poll(struct file *filp,
 	struct binder_thread *thread = NULL;
 	int wait_for_proc_work;
 
-	mutex_lock(&binder_lock);
 	thread = binder_get_thread(proc);
+	if (thread == NULL)
+		return POLLERR;
 
+	/*
+	 * Only the calling thread changes its own transaction stack and
+	 * return error, and a racing todo list update is caught by the
+	 * has_work checks around poll_wait() below.
+	 */
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 		list_empty(&thread->todo) && thread->return_error == BR_OK;
-	mutex_unlock(&binder_lock);
 
 	if (wait_for_proc_work) {
 		if (binder_has_proc_work(proc, thread))
@@ -2621,6 +2777,54 @@ static unsigned int binder_poll(struct file *filp,
 	return 0;
 }
 
+static int binder_ioctl_write_read(struct file *filp, unsigned int cmd,
+				   unsigned long arg,
+				   struct binder_thread *thread)
+{
+	int ret = 0;
+	struct binder_proc *proc = filp->private_data;
+	unsigned int size = _IOC_SIZE(cmd);
+	void __user *ubuf = (void __user *)arg;
+	struct binder_write_read bwr;
+
+	if (size != sizeof(struct binder_write_read))
+		return -EINVAL;
+	if (copy_from_user(&bwr, ubuf, sizeof(bwr)))
+		return -EFAULT;
+	binder_debug(BINDER_DEBUG_READ_WRITE,
+		     "binder: %d:%d write %ld at %08lx, read %ld at %08lx\n",
+		     proc->pid, thread->pid, bwr.write_size, bwr.write_buffer,
+		     bwr.read_size, bwr.read_buffer);
+
+	binder_lock(&binder_main_lock);
+	if (bwr.write_size > 0) {
+		ret = binder_thread_write(proc, thread, (void __user *)bwr.write_buffer, bwr.write_size, &bwr.write_consumed);
+		if (ret < 0) {
+			bwr.read_consumed = 0;
+			goto out;
+		}
+	}
+	if (bwr.read_size > 0) {
+		ret = binder_thread_read(proc, thread, (void __user *)bwr.read_buffer, bwr.read_size, &bwr.read_consumed, filp->f_flags & O_NONBLOCK);
+		if (!list_empty(&proc->todo))
+			wake_up_interruptible(&proc->wait);
+		if (ret < 0)
+			goto out;
+	}
+out:
+	thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
+	binder_unlock(&binder_main_lock);
+
+	if (ret >= 0)
+		binder_debug(BINDER_DEBUG_READ_WRITE,
+			     "binder: %d:%d wrote %ld of %ld, read return %ld of %ld\n",
+			     proc->pid, thread->pid, bwr.write_consumed, bwr.write_size,
+			     bwr.read_consumed, bwr.read_size);
+	if (copy_to_user(ubuf, &bwr, sizeof(bwr)))
+		ret = -EFAULT;
+	return ret < 0 ? ret : 0;
+}
+
 static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	int ret;
@@ -2635,58 +2839,20 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		return ret;
 
-	mutex_lock(&binder_lock);
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
 		ret = -ENOMEM;
-		goto err;
+		goto err_unlocked;
 	}
 
-	switch (cmd) {
-	case BINDER_WRITE_READ: {
-		struct binder_write_read bwr;
-		if (size != sizeof(struct binder_write_read)) {
-			ret = -EINVAL;
-			goto err;
-		}
-		if (copy_from_user(&bwr, ubuf, sizeof(bwr))) {
-			ret = -EFAULT;
-			goto err;
-		}
-		binder_debug(BINDER_DEBUG_READ_WRITE,
-			     "binder: %d:%d write %ld at %08lx, read %ld at %08lx\n",
-			     proc->pid, thread->pid, bwr.write_size, bwr.write_buffer,
-			     bwr.read_size, bwr.read_buffer);
-
-		if (bwr.write_size > 0) {
-			ret = binder_thread_write(proc, thread, (void __user *)bwr.write_buffer, bwr.write_size, &bwr.write_consumed);
-			if (ret < 0) {
-				bwr.read_consumed = 0;
-				if (copy_to_user(ubuf, &bwr, sizeof(bwr)))
-					ret = -EFAULT;
-				goto err;
-			}
-		}
-		if (bwr.read_size > 0) {
-			ret = binder_thread_read(proc, thread, (void __user *)bwr.read_buffer, bwr.read_size, &bwr.read_consumed, filp->f_flags & O_NONBLOCK);
-			if (!list_empty(&proc->todo))
-				wake_up_interruptible(&proc->wait);
-			if (ret < 0) {
-				if (copy_to_user(ubuf, &bwr, sizeof(bwr)))
-					ret = -EFAULT;
-				goto err;
-			}
-		}
-		binder_debug(BINDER_DEBUG_READ_WRITE,
-			     "binder: %d:%d wrote %ld of %ld, read return %ld of %ld\n",
-			     proc->pid, thread->pid, bwr.write_consumed, bwr.write_size,
-			     bwr.read_consumed, bwr.read_size);
-		if (copy_to_user(ubuf, &bwr, sizeof(bwr))) {
-			ret = -EFAULT;
-			goto err;
-		}
-		break;
+	/* Copies to and from user space are done outside binder_main_lock */
+	if (cmd == BINDER_WRITE_READ) {
+		ret = binder_ioctl_write_read(filp, cmd, arg, thread);
+		goto err_unlocked;
 	}
+
+	binder_lock(&binder_main_lock);
+	switch (cmd) {
 	case BINDER_SET_MAX_THREADS:
 		if (copy_from_user(&proc->max_threads, ubuf, sizeof(proc->max_threads))) {
 			ret = -EINVAL;
@@ -2744,7 +2910,8 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
-	mutex_unlock(&binder_lock);
+	binder_unlock(&binder_main_lock);
+err_unlocked:
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
@@ -2884,14 +3051,15 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
+	mutex_init(&proc->threads_lock.lock);
 	proc->default_priority = task_nice(current);
-	mutex_lock(&binder_lock);
-	binder_stats_created(BINDER_STAT_PROC);
-	hlist_add_head(&proc->proc_node, &binder_procs);
 	proc->pid = current->group_leader->pid;
 	INIT_LIST_HEAD(&proc->delivered_death);
 	filp->private_data = proc;
-	mutex_unlock(&binder_lock);
+	binder_stats_created(BINDER_STAT_PROC);
+	binder_lock(&binder_procs_lock);
+	hlist_add_head(&proc->proc_node, &binder_procs);
+	binder_unlock(&binder_procs_lock);
 
 	if (binder_debugfs_dir_entry_proc) {
 		char strbuf[11];
@@ -2916,6 +3084,8 @@ static void binder_deferred_flush(struct binder_proc *proc)
 {
 	struct rb_node *n;
 	int wake_count = 0;
+
+	binder_lock(&proc->threads_lock);
 	for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n)) {
 		struct binder_thread *thread = rb_entry(n, struct binder_thread, rb_node);
 		thread->looper |= BINDER_LOOPER_STATE_NEED_RETURN;
@@ -2924,6 +3094,7 @@ static void binder_deferred_flush(struct binder_proc *proc)
 			wake_count++;
 		}
 	}
+	binder_unlock(&proc->threads_lock);
 	wake_up_interruptible_all(&proc->wait);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
@@ -2950,7 +3121,9 @@ static void binder_deferred_release(struct binder_proc *proc)
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
 
+	binder_lock(&binder_procs_lock);
 	hlist_del(&proc->proc_node);
+	binder_unlock(&binder_procs_lock);
 	if (binder_context_mgr_node && binder_context_mgr_node->proc == proc) {
 		binder_debug(BINDER_DEBUG_DEAD_BINDER,
 			     "binder_release: %d context_mgr_node gone\n",
@@ -3071,8 +3244,8 @@ static void binder_deferred_func(struct work_struct *work)
 
 	int defer;
 	do {
-		mutex_lock(&binder_lock);
-		mutex_lock(&binder_deferred_lock);
+		binder_lock(&binder_main_lock);
+		binder_lock(&binder_deferred_lock);
 		if (!hlist_empty(&binder_deferred_list)) {
 			proc = hlist_entry(binder_deferred_list.first,
 					struct binder_proc, deferred_work_node);
@@ -3083,7 +3256,7 @@ static void binder_deferred_func(struct work_struct *work)
 			proc = NULL;
 			defer = 0;
 		}
-		mutex_unlock(&binder_deferred_lock);
+		binder_unlock(&binder_deferred_lock);
 
 		files = NULL;
 		if (defer & BINDER_DEFERRED_PUT_FILES) {
@@ -3098,7 +3271,7 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_RELEASE)
 			binder_deferred_release(proc); /* frees proc */
 
-		mutex_unlock(&binder_lock);
+		binder_unlock(&binder_main_lock);
 		if (files)
 			put_files_struct(files);
 	} while (proc);
@@ -3108,14 +3281,14 @@ static DECLARE_WORK(binder_deferred_work, binder_deferred_func);
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer)
 {
-	mutex_lock(&binder_deferred_lock);
+	binder_lock(&binder_deferred_lock);
 	proc->deferred_work |= defer;
 	if (hlist_unhashed(&proc->deferred_work_node)) {
 		hlist_add_head(&proc->deferred_work_node,
 				&binder_deferred_list);
 		queue_work(binder_deferred_workqueue, &binder_deferred_work);
 	}
-	mutex_unlock(&binder_deferred_lock);
+	binder_unlock(&binder_deferred_lock);
 }
 
 static void print_binder_transaction(struct seq_file *m, const char *prefix,
@@ -3263,9 +3436,11 @@ static void print_binder_proc(struct seq_file *m,
 	seq_printf(m, "proc %d\n", proc->pid);
 	header_pos = m->count;
 
+	binder_lock(&proc->threads_lock);
 	for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n))
 		print_binder_thread(m, rb_entry(n, struct binder_thread,
 						rb_node), print_all);
+	binder_unlock(&proc->threads_lock);
 	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
 		struct binder_node *node = rb_entry(n, struct binder_node,
 						    rb_node);
@@ -3369,11 +3544,13 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 	BUILD_BUG_ON(ARRAY_SIZE(stats->obj_created) !=
 		     ARRAY_SIZE(stats->obj_deleted));
 	for (i = 0; i < ARRAY_SIZE(stats->obj_created); i++) {
-		if (stats->obj_created[i] || stats->obj_deleted[i])
+		int created = atomic_read(&stats->obj_created[i]);
+		int deleted = atomic_read(&stats->obj_deleted[i]);
+
+		if (created || deleted)
 			seq_printf(m, "%s%s: active %d total %d\n", prefix,
 				binder_objstat_strings[i],
-				stats->obj_created[i] - stats->obj_deleted[i],
-				stats->obj_created[i]);
+				created - deleted, created);
 	}
 }
 
@@ -3386,8 +3563,10 @@ static void print_binder_proc_stats(struct seq_file *m,
 
 	seq_printf(m, "proc %d\n", proc->pid);
 	count = 0;
+	binder_lock(&proc->threads_lock);
 	for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n))
 		count++;
+	binder_unlock(&proc->threads_lock);
 	seq_printf(m, "  threads: %d\n", count);
 	seq_printf(m, "  requested threads: %d+%d/%d\n"
 			"  ready threads %d\n"
@@ -3427,6 +3606,22 @@ static void print_binder_proc_stats(struct seq_file *m,
 	}
 	seq_printf(m, "  pending transactions: %d\n", count);
 
+	seq_printf(m, "  pages: used %zd idle %zd peak %zd\n",
+		   proc->pages_used, proc->pages_idle, proc->pages_peak);
+	seq_printf(m, "  alloc: %lu failed %lu avg_us %llu max_us %llu\n",
+		   proc->alloc_stats.allocs, proc->alloc_stats.failed,
+		   proc->alloc_stats.allocs ?
+		   (unsigned long long)div_u64(div_u64(
+			proc->alloc_stats.total_ns, proc->alloc_stats.allocs),
+			NSEC_PER_USEC) : 0ULL,
+		   (unsigned long long)div_u64(proc->alloc_stats.max_ns,
+					       NSEC_PER_USEC));
+	seq_printf(m, "  page maps %lu failed %lu warm hits %lu unmaps %lu "
+		   "kept %lu\n", proc->alloc_stats.page_maps,
+		   proc->alloc_stats.page_map_failed,
+		   proc->alloc_stats.page_warm_hits,
+		   proc->alloc_stats.page_unmaps, proc->alloc_stats.page_kept);
+
 	print_binder_stats(m, "  ", &proc->stats);
 }
 
@@ -3439,7 +3634,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(&binder_main_lock);
 
 	seq_puts(m, "binder state:\n");
 
@@ -3448,10 +3643,12 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(node, pos, &binder_dead_nodes, dead_node)
 		print_binder_node(m, node);
 
+	binder_lock(&binder_procs_lock);
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 1);
+	binder_unlock(&binder_procs_lock);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(&binder_main_lock);
 	return 0;
 }
 
@@ -3462,16 +3659,18 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(&binder_main_lock);
 
 	seq_puts(m, "binder stats:\n");
 
 	print_binder_stats(m, "", &binder_stats);
 
+	binder_lock(&binder_procs_lock);
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
+	binder_unlock(&binder_procs_lock);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(&binder_main_lock);
 	return 0;
 }
 
@@ -3482,13 +3681,49 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(&binder_main_lock);
 
 	seq_puts(m, "binder transactions:\n");
+	binder_lock(&binder_procs_lock);
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 0);
+	binder_unlock(&binder_procs_lock);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(&binder_main_lock);
+	return 0;
+}
+
+static void print_binder_lock(struct seq_file *m, const char *name,
+			      struct binder_lock *l)
+{
+	seq_printf(m, "%-10s %10lu %10lu %12llu %10llu\n", name,
+		   l->acquired, l->contended,
+		   (unsigned long long)div_u64(l->wait_ns, NSEC_PER_USEC),
+		   (unsigned long long)div_u64(l->max_wait_ns, NSEC_PER_USEC));
+}
+
+static int binder_locks_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	struct binder_lock threads = { .acquired = 0 };
+
+	seq_printf(m, "%-10s %10s %10s %12s %10s\n", "lock", "acquired",
+		   "contended", "wait_us", "max_us");
+	print_binder_lock(m, "main", &binder_main_lock);
+	print_binder_lock(m, "deferred", &binder_deferred_lock);
+
+	binder_lock(&binder_procs_lock);
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		threads.acquired += proc->threads_lock.acquired;
+		threads.contended += proc->threads_lock.contended;
+		threads.wait_ns += proc->threads_lock.wait_ns;
+		threads.max_wait_ns = max(threads.max_wait_ns,
+					  proc->threads_lock.max_wait_ns);
+	}
+	print_binder_lock(m, "procs", &binder_procs_lock);
+	binder_unlock(&binder_procs_lock);
+	print_binder_lock(m, "threads", &threads);
 	return 0;
 }
 
@@ -3498,11 +3733,11 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(&binder_main_lock);
 	seq_puts(m, "binder proc state:\n");
 	print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock(&binder_main_lock);
 	return 0;
 }
 
@@ -3550,6 +3785,7 @@ static struct miscdevice binder_miscdev = {
 BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
+BINDER_DEBUG_ENTRY(locks);
 BINDER_DEBUG_ENTRY(transaction_log);
 
 static int __init binder_init(void)
@@ -3581,6 +3817,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    NULL,
 				    &binder_transactions_fops);
+		debugfs_create_file("locks",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_locks_fops);
 		debugfs_create_file("transaction_log",
 				    S_IRUGO,
 				    binder_debugfs_dir_entry_root,
@@ -33,16 +33,28 @@
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting.
+ *
+ * Positions are free running byte counts; logger_offset() turns them into
+ * offsets within 'buffer'. Writers reserve [reserve, reserve + len) and write
+ * the entry header under the spinlock 'lock', copy the payload without any
+ * lock, and commit. 'w_pos' only moves past a reservation once it and all
+ * older ones have committed, so readers never see a half written entry.
+ * 'head' is the oldest entry not yet overwritten; it is pulled forward by the
+ * writers and a reader whose position falls behind it has been lapped.
+ *
+ * The mutex 'mutex' only serialises readers' bookkeeping.
  */
 struct logger_log {
 	unsigned char 		*buffer;/* the ring buffer itself */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
-	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
-	size_t			w_off;	/* current write head offset */
+	wait_queue_head_t	commit_wq; /* writers waiting on older ones */
+	struct list_head	pending; /* uncommitted writes, oldest first */
+	spinlock_t		lock;	/* protects positions and 'pending' */
+	struct mutex		mutex;	/* mutex protecting reader state */
+	size_t			w_pos;	/* committed write position */
+	size_t			reserve; /* next write starts here */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
 };
@@ -55,15 +67,26 @@ struct logger_log {
  */
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
-	struct list_head	list;	/* entry in logger_log's list */
-	size_t			r_off;	/* current read head offset */
+	size_t			r_pos;	/* current read position */
 	bool			r_all;	/* reader can read all entries */
+	bool			r_batch; /* read() may return several entries */
 	int			r_ver;	/* reader ABI version */
 };
 
+/*
+ * struct logger_write - an in-flight write, on the writer's stack
+ */
+struct logger_write {
+	struct list_head	list;	/* entry in logger_log's pending */
+	size_t			start;	/* position of the entry header */
+};
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 #define logger_offset(n)	((n) & (log->size - 1))
 
+/* is position 'a' before position 'b'? */
+#define logger_before(a, b)	((long)((a) - (b)) < 0)
+
 /*
  * file_get_log - Given a file structure, return the associated log
  *
@@ -89,14 +112,15 @@ static inline struct logger_log *file_get_log(struct file *file)
 
 /*
  * get_entry_header - returns a pointer to the logger_entry header within
- * 'log' starting at offset 'off'. A temporary logger_entry 'scratch' must
+ * 'log' starting at position 'pos'. A temporary logger_entry 'scratch' must
  * be provided. Typically the return value will be a pointer within
  * 'logger->buf'.  However, a pointer to 'scratch' may be returned if
  * the log entry spans the end and beginning of the circular buffer.
  */
 static struct logger_entry *get_entry_header(struct logger_log *log,
-		size_t off, struct logger_entry *scratch)
+		size_t pos, struct logger_entry *scratch)
 {
+	size_t off = logger_offset(pos);
 	size_t len = min(sizeof(struct logger_entry), log->size - off);
 	if (len != sizeof(struct logger_entry)) {
 		memcpy(((void *) scratch), log->buffer + off, len);
@@ -109,18 +133,80 @@ static struct logger_entry *get_entry_header(struct logger_log *log,
 }
 
 /*
- * get_entry_msg_len - Grabs the length of the message of the entry
- * starting from from 'off'.
+ * logger_snapshot - reads the committed write position and the head
+ */
+static void logger_snapshot(struct logger_log *log, size_t *w_pos,
+			    size_t *head)
+{
+	spin_lock(&log->lock);
+	*w_pos = log->w_pos;
+	*head = log->head;
+	spin_unlock(&log->lock);
+}
+
+/*
+ * reader_catch_up - moves a lapped reader to the oldest entry left and
+ * returns the committed write position.
  *
  * Caller needs to hold log->mutex.
  */
-static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
+static size_t reader_catch_up(struct logger_log *log,
+			      struct logger_reader *reader)
+{
+	size_t w_pos, head;
+
+	logger_snapshot(log, &w_pos, &head);
+	if (logger_before(reader->r_pos, head))
+		reader->r_pos = head;
+	return w_pos;
+}
+
+/*
+ * reader_entry_header - copies the header of the reader's next entry into
+ * 'entry'. Entries not yet overwritten always have a sane header; the lap
+ * is checked after the copy, since writers do not wait for readers.
+ *
+ * Returns false if the reader was lapped while copying and has to catch
+ * up before looking again.
+ *
+ * Caller needs to hold log->mutex.
+ */
+static bool reader_entry_header(struct logger_log *log,
+				struct logger_reader *reader,
+				struct logger_entry *entry)
 {
 	struct logger_entry scratch;
-	struct logger_entry *entry;
 
-	entry = get_entry_header(log, off, &scratch);
-	return entry->len;
+	*entry = *get_entry_header(log, reader->r_pos, &scratch);
+	smp_rmb();
+	return !logger_before(reader->r_pos, ACCESS_ONCE(log->head));
+}
+
+/*
+ * reader_next_entry - skips entries this reader may not see and returns the
+ * committed write position; reader->r_pos is the next entry to read, or
+ * equal to the returned position if there is none.
+ *
+ * Caller needs to hold log->mutex.
+ */
+static size_t reader_next_entry(struct logger_log *log,
+				struct logger_reader *reader,
+				struct logger_entry *entry)
+{
+	uid_t euid = current_euid();
+	size_t w_pos;
+
+	w_pos = reader_catch_up(log, reader);
+	while (reader->r_pos != w_pos) {
+		if (!reader_entry_header(log, reader, entry)) {
+			w_pos = reader_catch_up(log, reader);
+			continue;
+		}
+		if (reader->r_all || entry->euid == euid)
+			break;
+		reader->r_pos += sizeof(struct logger_entry) + entry->len;
+	}
+	return w_pos;
 }
 
 static size_t get_user_hdr_len(int ver)
@@ -156,18 +242,19 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log_to_user - copies the entry 'entry' at the reader's position
+ * into the user-space buffer 'buf', which has room for it. Returns the
+ * number of bytes copied, 0 if the entry was overwritten while copying and
+ * has to be dropped, or a negative error code.
  *
  * Caller must hold log->mutex.
  */
 static ssize_t do_read_log_to_user(struct logger_log *log,
 				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+				   struct logger_entry *entry,
+				   char __user *buf)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
+	size_t count = entry->len;
 	size_t len;
 	size_t msg_start;
 
@@ -175,13 +262,11 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	 * First, copy the header to userspace, using the version of
 	 * the header requested
 	 */
-	entry = get_entry_header(log, reader->r_off, &scratch);
 	if (copy_header_to_user(reader->r_ver, entry, buf))
 		return -EFAULT;
 
-	count -= get_user_hdr_len(reader->r_ver);
 	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(reader->r_off + sizeof(struct logger_entry));
+	msg_start = logger_offset(reader->r_pos + sizeof(struct logger_entry));
 
 	/*
 	 * We read from the msg in two disjoint operations. First, we read from
@@ -200,34 +285,14 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 		if (copy_to_user(buf + len, log->buffer, count - len))
 			return -EFAULT;
 
-	reader->r_off = logger_offset(reader->r_off +
-		sizeof(struct logger_entry) + count);
-
-	return count + get_user_hdr_len(reader->r_ver);
-}
-
-/*
- * get_next_entry_by_uid - Starting at 'off', returns an offset into
- * 'log->buffer' which contains the first entry readable by 'euid'
- */
-static size_t get_next_entry_by_uid(struct logger_log *log,
-		size_t off, uid_t euid)
-{
-	while (off != log->w_off) {
-		struct logger_entry *entry;
-		struct logger_entry scratch;
-		size_t next_len;
-
-		entry = get_entry_header(log, off, &scratch);
-
-		if (entry->euid == euid)
-			return off;
+	/* a writer may have lapped us while we were copying */
+	smp_rmb();
+	if (logger_before(reader->r_pos, ACCESS_ONCE(log->head)))
+		return 0;
 
-		next_len = sizeof(struct logger_entry) + entry->len;
-		off = logger_offset(off + next_len);
-	}
+	reader->r_pos += sizeof(struct logger_entry) + count;
 
-	return off;
+	return count + get_user_hdr_len(reader->r_ver);
 }
 
 /*
@@ -237,7 +302,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
  *
  * 	- O_NONBLOCK works
  * 	- If there are no log entries to read, blocks until log is written to
- * 	- Atomically reads exactly one log entry
+ * 	- Atomically reads exactly one log entry, or as many whole entries as
+ * 	  fit in 'count' after LOGGER_SET_BATCH
  *
  * Will set errno to EINVAL if read
  * buffer is insufficient to hold next entry.
@@ -247,16 +313,17 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 {
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
-	ssize_t ret;
+	struct logger_entry entry;
+	size_t w_pos, head;
+	ssize_t ret, done = 0;
 	DEFINE_WAIT(wait);
 
 start:
 	while (1) {
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		mutex_lock(&log->mutex);
-		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		logger_snapshot(log, &w_pos, &head);
+		ret = (w_pos == reader->r_pos);
 		if (!ret)
 			break;
 
@@ -279,135 +346,133 @@ start:
 
 	mutex_lock(&log->mutex);
 
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
+	do {
+		w_pos = reader_next_entry(log, reader, &entry);
 
-	/* is there still something to read or did we race? */
-	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
-		goto start;
-	}
+		/* is there still something to read or did we race? */
+		if (w_pos == reader->r_pos)
+			break;
 
-	/* get the size of the next entry */
-	ret = get_user_hdr_len(reader->r_ver) +
-		get_entry_msg_len(log, reader->r_off);
-	if (count < ret) {
-		ret = -EINVAL;
-		goto out;
-	}
+		/* get the size of the next entry */
+		ret = get_user_hdr_len(reader->r_ver) + entry.len;
+		if (count - done < ret) {
+			if (!done)
+				done = -EINVAL;
+			break;
+		}
 
-	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+		ret = do_read_log_to_user(log, reader, &entry, buf + done);
+		if (ret < 0) {
+			if (!done)
+				done = ret;
+			break;
+		}
+		done += ret;
+	} while (reader->r_batch || !done);
 
-out:
 	mutex_unlock(&log->mutex);
 
-	return ret;
-}
-
-/*
- * get_next_entry - return the offset of the first valid entry at least 'len'
- * bytes after 'off'.
- *
- * Caller must hold log->mutex.
- */
-static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
-{
-	size_t count = 0;
-
-	do {
-		size_t nr = sizeof(struct logger_entry) +
-			get_entry_msg_len(log, off);
-		off = logger_offset(off + nr);
-		count += nr;
-	} while (count < len);
+	if (!done)
+		goto start;
 
-	return off;
+	return done;
 }
 
 /*
- * clock_interval - is a < c < b in mod-space? Put another way, does the line
- * from a to b cross c?
+ * logger_copy_in - copies 'count' bytes of 'buf' into 'log' at position
+ * 'pos'. 'buf' is in user space when 'user' is set.
  */
-static inline int clock_interval(size_t a, size_t b, size_t c)
+static int logger_copy_in(struct logger_log *log, size_t pos,
+			  const void *buf, size_t count, bool user)
 {
-	if (b < a) {
-		if (a < c || b >= c)
-			return 1;
-	} else {
-		if (a < c && b >= c)
-			return 1;
+	size_t off = logger_offset(pos);
+	size_t len = min(count, log->size - off);
+
+	if (!user) {
+		memcpy(log->buffer + off, buf, len);
+		memcpy(log->buffer, buf + len, count - len);
+		return 0;
 	}
 
+	if (len && copy_from_user(log->buffer + off,
+				  (const void __user *)buf, len))
+		return -EFAULT;
+	if (count != len && copy_from_user(log->buffer,
+				(const void __user *)buf + len, count - len))
+		return -EFAULT;
 	return 0;
 }
 
 /*
- * fix_up_readers - walk the list of all readers and "fix up" any who were
- * lapped by the writer; also do the same for the default "start head".
- * We do this by "pulling forward" the readers and start head to the first
- * entry after the new write head.
- *
- * The caller needs to hold log->mutex.
+ * logger_reserve - reserves room for an entry of 'len' payload bytes,
+ * writes its header and queues it as pending. Entries about to be
+ * overwritten are dropped by moving the head past them; if that would
+ * reach a write still in flight, waits for it to commit first.
  */
-static void fix_up_readers(struct logger_log *log, size_t len)
+static void logger_reserve(struct logger_log *log, struct logger_write *w,
+			   struct logger_entry *header)
 {
-	size_t old = log->w_off;
-	size_t new = logger_offset(old + len);
-	struct logger_reader *reader;
-
-	if (clock_interval(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
-
-	list_for_each_entry(reader, &log->readers, list)
-		if (clock_interval(old, new, reader->r_off))
-			reader->r_off = get_next_entry(log, reader->r_off, len);
-}
-
-/*
- * do_write_log - writes 'len' bytes from 'buf' to 'log'
- *
- * The caller needs to hold log->mutex.
- */
-static void do_write_log(struct logger_log *log, const void *buf, size_t count)
-{
-	size_t len;
+	size_t len = sizeof(struct logger_entry) + header->len;
+	struct logger_write *oldest;
+	DEFINE_WAIT(wait);
 
-	len = min(count, log->size - log->w_off);
-	memcpy(log->buffer + log->w_off, buf, len);
+	spin_lock(&log->lock);
+	while (!list_empty(&log->pending)) {
+		oldest = list_first_entry(&log->pending, struct logger_write,
+					  list);
+		if (!logger_before(oldest->start, log->reserve + len - log->size))
+			break;
 
-	if (count != len)
-		memcpy(log->buffer, buf + len, count - len);
+		prepare_to_wait(&log->commit_wq, &wait, TASK_UNINTERRUPTIBLE);
+		spin_unlock(&log->lock);
+		schedule();
+		finish_wait(&log->commit_wq, &wait);
+		spin_lock(&log->lock);
+	}
 
-	log->w_off = logger_offset(log->w_off + count);
+	while (logger_before(log->head, log->reserve + len - log->size)) {
+		struct logger_entry scratch;
 
+		log->head += sizeof(struct logger_entry) +
+			get_entry_header(log, log->head, &scratch)->len;
+	}
+	/* readers must see the new head before any overwritten byte */
+	smp_wmb();
+
+	w->start = log->reserve;
+	logger_copy_in(log, w->start, header, sizeof(struct logger_entry),
+		       false);
+	log->reserve += len;
+	list_add_tail(&w->list, &log->pending);
+	spin_unlock(&log->lock);
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
- *
- * Returns 'count' on success, negative error code on failure.
+ * logger_commit - retires a write and publishes every entry up to the
+ * oldest write still in flight
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static void logger_commit(struct logger_log *log, struct logger_write *w)
 {
-	size_t len;
-
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
-
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			return -EFAULT;
-
-	log->w_off = logger_offset(log->w_off + count);
+	struct logger_write *oldest;
+	bool was_oldest;
+
+	spin_lock(&log->lock);
+	was_oldest = (log->pending.next == &w->list);
+	list_del(&w->list);
+	if (list_empty(&log->pending))
+		log->w_pos = log->reserve;
+	else {
+		oldest = list_first_entry(&log->pending, struct logger_write,
+					  list);
+		log->w_pos = oldest->start;
+	}
+	spin_unlock(&log->lock);
 
-	return count;
+	if (was_oldest) {
+		/* wake up any blocked readers and lapping writers */
+		wake_up_interruptible(&log->wq);
+		wake_up(&log->commit_wq);
+	}
 }
 
 /*
@@ -419,10 +484,12 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
+	struct logger_write w;
 	struct timespec now;
+	size_t pos;
 	ssize_t ret = 0;
+	int err = 0;
 
 	now = current_kernel_time();
 
@@ -438,43 +505,40 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	logger_reserve(log, &w, &header);
+	pos = w.start + sizeof(struct logger_entry);
 
-	while (nr_segs-- > 0) {
+	while (nr_segs-- > 0 && ret < header.len) {
 		size_t len;
-		ssize_t nr;
 
 		/* figure out how much of this vector we can keep */
 		len = min_t(size_t, iov->iov_len, header.len - ret);
 
 		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
-		}
+		err = logger_copy_in(log, pos + ret, iov->iov_base, len, true);
+		if (unlikely(err))
+			break;
 
 		iov++;
-		ret += nr;
+		ret += len;
 	}
 
-	mutex_unlock(&log->mutex);
+	/*
+	 * The entry cannot be taken back once newer ones are reserved behind
+	 * it: blank what was not written instead.
+	 */
+	if (unlikely(ret < header.len)) {
+		size_t off = logger_offset(pos + ret);
+		size_t left = header.len - ret;
+		size_t len = min(left, log->size - off);
+
+		memset(log->buffer + off, 0, len);
+		memset(log->buffer, 0, left - len);
+	}
 
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	logger_commit(log, &w);
 
-	return ret;
+	return err ? err : ret;
 }
 
 static struct logger_log *get_log_from_minor(int);
@@ -487,6 +551,7 @@ static struct logger_log *get_log_from_minor(int);
 static int logger_open(struct inode *inode, struct file *file)
 {
 	struct logger_log *log;
+	size_t w_pos;
 	int ret;
 
 	ret = nonseekable_open(inode, file);
@@ -506,15 +571,11 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		reader->log = log;
 		reader->r_ver = 1;
+		reader->r_batch = false;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
 			capable(CAP_SYSLOG);
 
-		INIT_LIST_HEAD(&reader->list);
-
-		mutex_lock(&log->mutex);
-		reader->r_off = log->head;
-		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		logger_snapshot(log, &w_pos, &reader->r_pos);
 
 		file->private_data = reader;
 	} else
@@ -530,11 +591,8 @@ static int logger_open(struct inode *inode, struct file *file)
  */
 static int logger_release(struct inode *ignored, struct file *file)
 {
-	if (file->f_mode & FMODE_READ) {
-		struct logger_reader *reader = file->private_data;
-		list_del(&reader->list);
-		kfree(reader);
-	}
+	if (file->f_mode & FMODE_READ)
+		kfree(file->private_data);
 
 	return 0;
 }
@@ -552,6 +610,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 {
 	struct logger_reader *reader;
 	struct logger_log *log;
+	struct logger_entry entry;
 	unsigned int ret = POLLOUT | POLLWRNORM;
 
 	if (!(file->f_mode & FMODE_READ))
@@ -563,11 +622,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
-
-	if (log->w_off != reader->r_off)
+	if (reader_next_entry(log, reader, &entry) != reader->r_pos)
 		ret |= POLLIN | POLLRDNORM;
 	mutex_unlock(&log->mutex);
 
@@ -591,6 +646,8 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
+	struct logger_entry entry;
+	size_t w_pos;
 	long ret = -EINVAL;
 	void __user *argp = (void __user *) arg;
 
@@ -606,10 +663,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
-		else
-			ret = (log->size - reader->r_off) + log->w_off;
+		ret = reader_catch_up(log, reader) - reader->r_pos;
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -618,13 +672,9 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		reader = file->private_data;
 
-		if (!reader->r_all)
-			reader->r_off = get_next_entry_by_uid(log,
-				reader->r_off, current_euid());
-
-		if (log->w_off != reader->r_off)
-			ret = get_user_hdr_len(reader->r_ver) +
-				get_entry_msg_len(log, reader->r_off);
+		w_pos = reader_next_entry(log, reader, &entry);
+		if (w_pos != reader->r_pos)
+			ret = get_user_hdr_len(reader->r_ver) + entry.len;
 		else
 			ret = 0;
 		break;
@@ -633,9 +683,10 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ret = -EBADF;
 			break;
 		}
-		list_for_each_entry(reader, &log->readers, list)
-			reader->r_off = log->w_off;
-		log->head = log->w_off;
+		/* readers behind the head catch up on their next access */
+		spin_lock(&log->lock);
+		log->head = log->w_pos;
+		spin_unlock(&log->lock);
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -654,6 +705,15 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = logger_set_version(reader, argp);
 		break;
+	case LOGGER_SET_BATCH:
+		if (!(file->f_mode & FMODE_READ)) {
+			ret = -EBADF;
+			break;
+		}
+		reader = file->private_data;
+		reader->r_batch = !!arg;
+		ret = 0;
+		break;
 	}
 
 	mutex_unlock(&log->mutex);
@@ -688,9 +748,12 @@ static struct logger_log VAR = { \
 		.parent = NULL, \
 	}, \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
-	.readers = LIST_HEAD_INIT(VAR .readers), \
+	.commit_wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .commit_wq), \
+	.pending = LIST_HEAD_INIT(VAR .pending), \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
-	.w_off = 0, \
+	.w_pos = 0, \
+	.reserve = 0, \
 	.head = 0, \
 	.size = SIZE, \
 };
@@ -16,6 +16,10 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Thread group leaders are kept on one list per oom_adj value, moved by
+ * the fork, exit and oom_adj write paths, so picking a victim only looks
+ * at the lists at or above the adj to kill instead of at every task.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -35,6 +39,9 @@
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/perflog.h>
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -54,6 +61,17 @@ static int lowmem_minfree_size = 4;
 
 static struct task_struct *lowmem_deathpending;
 static unsigned long lowmem_deathpending_timeout;
+static ktime_t lowmem_deathpending_start;
+
+/* from the kill until the victim let go of its memory */
+static uint32_t lowmem_kill_latency_us;
+static uint32_t lowmem_kill_latency_max_us;
+
+#define LOWMEM_NR_ADJ	(OOM_ADJUST_MAX - OOM_DISABLE + 1)
+
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+static struct list_head lowmem_adj_list[LOWMEM_NR_ADJ];
+static bool lowmem_adj_ready;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -79,13 +97,53 @@ task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 	return NOTIFY_OK;
 }
 
+/* caller holds lowmem_adj_lock */
+static void lowmem_adj_add(struct task_struct *tsk)
+{
+	if (tsk->flags & (PF_EXITING | PF_KTHREAD))
+		return;
+
+	list_move_tail(&tsk->lowmem_node,
+		       &lowmem_adj_list[tsk->signal->oom_adj - OOM_DISABLE]);
+}
+
+/* put the thread group of tsk on the list of its current oom_adj */
+void lowmem_task_update(struct task_struct *tsk)
+{
+	tsk = tsk->group_leader;
+
+	spin_lock(&lowmem_adj_lock);
+	if (lowmem_adj_ready)
+		lowmem_adj_add(tsk);
+	spin_unlock(&lowmem_adj_lock);
+}
+
+void lowmem_task_exit(struct task_struct *tsk)
+{
+	s64 us;
+
+	spin_lock(&lowmem_adj_lock);
+	list_del_init(&tsk->lowmem_node);
+	spin_unlock(&lowmem_adj_lock);
+
+	if (tsk != lowmem_deathpending)
+		return;
+
+	us = ktime_us_delta(ktime_get(), lowmem_deathpending_start);
+	lowmem_kill_latency_us = us;
+	if (us > lowmem_kill_latency_max_us)
+		lowmem_kill_latency_max_us = us;
+	lowmem_print(2, "%d (%s) exited %lld us after sigkill\n",
+		     tsk->pid, tsk->comm, us);
+}
+
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
 	struct task_struct *p;
 	struct task_struct *selected = NULL;
 	int rem = 0;
 	int tasksize;
-	int i;
+	int i, adj;
 	int min_adj = OOM_ADJUST_MAX + 1;
 	int selected_tasksize = 0;
 	int selected_oom_adj;
@@ -131,53 +189,57 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	}
 	selected_oom_adj = min_adj;
 
-	read_lock(&tasklist_lock);
-	for_each_process(p) {
-		struct mm_struct *mm;
-		struct signal_struct *sig;
-		int oom_adj;
-
-		task_lock(p);
-		mm = p->mm;
-		sig = p->signal;
-		if (!mm || !sig) {
-			task_unlock(p);
-			continue;
-		}
-		oom_adj = sig->oom_adj;
-		if (oom_adj < min_adj) {
+	/*
+	 * The highest oom_adj with a task holding memory gets killed, the
+	 * largest of them if there are several.
+	 */
+	spin_lock(&lowmem_adj_lock);
+	min_adj = max(min_adj, OOM_DISABLE);
+	for (adj = OOM_ADJUST_MAX; adj >= min_adj && !selected; adj--) {
+		list_for_each_entry(p, &lowmem_adj_list[adj - OOM_DISABLE],
+				    lowmem_node) {
+			struct mm_struct *mm;
+
+			task_lock(p);
+			mm = p->mm;
+			if (!mm) {
+				task_unlock(p);
+				continue;
+			}
+			tasksize = get_mm_rss(mm);
 			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
+			if (tasksize <= 0)
 				continue;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
+			if (selected && tasksize <= selected_tasksize)
 				continue;
+			selected = p;
+			selected_tasksize = tasksize;
+			selected_oom_adj = adj;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, "
+				     "to kill\n",
+				     p->pid, p->comm, adj, tasksize);
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_adj, tasksize);
 	}
+	if (selected)
+		get_task_struct(selected);
+	spin_unlock(&lowmem_adj_lock);
+
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_adj, selected_tasksize);
 		lowmem_deathpending = selected;
 		lowmem_deathpending_timeout = jiffies + HZ;
+		lowmem_deathpending_start = ktime_get();
+		perflog_record(PERFLOG_LMK_KILL, selected->pid,
+			       (selected_oom_adj & 0xff) << 24 |
+			       min(selected_tasksize, 0xffffff));
 		force_sig(SIGKILL, selected);
+		put_task_struct(selected);
 		rem -= selected_tasksize;
 	}
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
-	read_unlock(&tasklist_lock);
 	return rem;
 }
 
@@ -188,6 +250,21 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	struct task_struct *p;
+	int i;
+
+	for (i = 0; i < LOWMEM_NR_ADJ; i++)
+		INIT_LIST_HEAD(&lowmem_adj_list[i]);
+
+	/* sort what was forked before, the hooks take over from here */
+	read_lock(&tasklist_lock);
+	spin_lock(&lowmem_adj_lock);
+	lowmem_adj_ready = true;
+	for_each_process(p)
+		lowmem_adj_add(p);
+	spin_unlock(&lowmem_adj_lock);
+	read_unlock(&tasklist_lock);
+
 	task_free_register(&task_nb);
 	register_shrinker(&lowmem_shrinker);
 	return 0;
@@ -205,6 +282,9 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(kill_latency_us, lowmem_kill_latency_us, uint, S_IRUGO);
+module_param_named(kill_latency_max_us, lowmem_kill_latency_max_us, uint,
+		   S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
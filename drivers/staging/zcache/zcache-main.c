@@ -60,7 +60,7 @@ MODULE_LICENSE("GPL");
 
 struct zcache_client {
 	struct tmem_pool *tmem_pools[MAX_POOLS_PER_CLIENT];
-	struct xv_pool *xvpool;
+	struct xv_pool *xvpool[NR_CPUS];
 	bool allocated;
 	atomic_t refcount;
 };
@@ -633,8 +633,13 @@ static int zbud_show_cumul_chunk_counts(char *buf)
 
 #define ZVH_SENTINEL  0x43214321
 
+/*
+ * Each cpu allocates from its own xv_pool so concurrent frontswap puts do
+ * not all queue on one pool lock; cpu records which pool to free back to.
+ */
 struct zv_hdr {
-	uint32_t pool_id;
+	uint16_t pool_id;
+	uint16_t cpu;
 	struct tmem_oid oid;
 	uint32_t index;
 	DECL_SENTINEL
@@ -658,10 +663,11 @@ static unsigned int zv_max_mean_zsize = (PAGE_SIZE / 8) * 5;
 static unsigned long zv_curr_dist_counts[NCHUNKS];
 static unsigned long zv_cumul_dist_counts[NCHUNKS];
 
-static struct zv_hdr *zv_create(struct xv_pool *xvpool, uint32_t pool_id,
+static struct zv_hdr *zv_create(struct zcache_client *cli, uint32_t pool_id,
 				struct tmem_oid *oid, uint32_t index,
 				void *cdata, unsigned clen)
 {
+	int cpu = smp_processor_id();
 	struct page *page;
 	struct zv_hdr *zv = NULL;
 	uint32_t offset;
@@ -671,7 +677,7 @@ static struct zv_hdr *zv_create(struct xv_pool *xvpool, uint32_t pool_id,
 
 	BUG_ON(!irqs_disabled());
 	BUG_ON(chunks >= NCHUNKS);
-	ret = xv_malloc(xvpool, alloc_size,
+	ret = xv_malloc(cli->xvpool[cpu], alloc_size,
 			&page, &offset, ZCACHE_GFP_MASK);
 	if (unlikely(ret))
 		goto out;
@@ -681,6 +687,7 @@ static struct zv_hdr *zv_create(struct xv_pool *xvpool, uint32_t pool_id,
 	zv->index = index;
 	zv->oid = *oid;
 	zv->pool_id = pool_id;
+	zv->cpu = cpu;
 	SET_SENTINEL(zv, ZVH);
 	memcpy((char *)zv + sizeof(struct zv_hdr), cdata, clen);
 	kunmap_atomic(zv, KM_USER0);
@@ -688,7 +695,7 @@ out:
 	return zv;
 }
 
-static void zv_free(struct xv_pool *xvpool, struct zv_hdr *zv)
+static void zv_free(struct zcache_client *cli, struct zv_hdr *zv)
 {
 	unsigned long flags;
 	struct page *page;
@@ -705,10 +712,20 @@ static void zv_free(struct xv_pool *xvpool, struct zv_hdr *zv)
 	page = virt_to_page(zv);
 	offset = (unsigned long)zv & ~PAGE_MASK;
 	local_irq_save(flags);
-	xv_free(xvpool, page, offset);
+	xv_free(cli->xvpool[zv->cpu], page, offset);
 	local_irq_restore(flags);
 }
 
+static u64 zv_total_size_bytes(struct zcache_client *cli)
+{
+	u64 total = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		total += xv_get_total_size_bytes(cli->xvpool[cpu]);
+	return total;
+}
+
 static void zv_decompress(struct page *page, struct zv_hdr *zv)
 {
 	size_t clen = PAGE_SIZE;
@@ -938,6 +955,9 @@ int zcache_new_client(uint16_t cli_id)
 {
 	struct zcache_client *cli = NULL;
 	int ret = -1;
+#ifdef CONFIG_FRONTSWAP
+	int cpu;
+#endif
 
 	if (cli_id == LOCAL_CLIENT)
 		cli = &zcache_host;
@@ -949,9 +969,11 @@ int zcache_new_client(uint16_t cli_id)
 		goto out;
 	cli->allocated = 1;
 #ifdef CONFIG_FRONTSWAP
-	cli->xvpool = xv_create_pool();
-	if (cli->xvpool == NULL)
-		goto out;
+	for_each_possible_cpu(cpu) {
+		cli->xvpool[cpu] = xv_create_pool();
+		if (cli->xvpool[cpu] == NULL)
+			goto out;
+	}
 #endif
 	ret = 0;
 out:
@@ -962,15 +984,6 @@ out:
 static unsigned long zcache_failed_get_free_pages;
 static unsigned long zcache_failed_alloc;
 static unsigned long zcache_put_to_flush;
-static unsigned long zcache_aborted_preload;
-static unsigned long zcache_aborted_shrink;
-
-/*
- * Ensure that memory allocation requests in zcache don't result
- * in direct reclaim requests via the shrinker, which would cause
- * an infinite loop.  Maybe a GFP flag would be better?
- */
-static DEFINE_SPINLOCK(zcache_direct_reclaim_lock);
 
 /*
  * for now, used named slabs so can easily track usage; later can
@@ -987,13 +1000,18 @@ static unsigned long zcache_curr_objnode_count_max;
 /*
  * to avoid memory allocation recursion (e.g. due to direct reclaim), we
  * preload all necessary data structures so the hostops callbacks never
- * actually do a malloc
+ * actually do a malloc.  ZCACHE_GFP_MASK never enters reclaim, so the
+ * preload needs no global lock against the shrinker.  The page is also
+ * compressed up front, into the per-cpu dstmem, so that tmem_put only
+ * copies it while holding the hashbucket lock.
  */
 struct zcache_preload {
 	void *page;
 	struct tmem_obj *obj;
 	int nr;
 	struct tmem_objnode *objnodes[OBJNODE_TREE_MAX_PATH];
+	void *cdata;
+	size_t clen;
 };
 static DEFINE_PER_CPU(struct zcache_preload, zcache_preloads) = { 0, };
 
@@ -1009,10 +1027,6 @@ static int zcache_do_preload(struct tmem_pool *pool)
 		goto out;
 	if (unlikely(zcache_obj_cache == NULL))
 		goto out;
-	if (!spin_trylock(&zcache_direct_reclaim_lock)) {
-		zcache_aborted_preload++;
-		goto out;
-	}
 	preempt_disable();
 	kp = &__get_cpu_var(zcache_preloads);
 	while (kp->nr < ARRAY_SIZE(kp->objnodes)) {
@@ -1021,7 +1035,7 @@ static int zcache_do_preload(struct tmem_pool *pool)
 				ZCACHE_GFP_MASK);
 		if (unlikely(objnode == NULL)) {
 			zcache_failed_alloc++;
-			goto unlock_out;
+			goto out;
 		}
 		preempt_disable();
 		kp = &__get_cpu_var(zcache_preloads);
@@ -1034,13 +1048,13 @@ static int zcache_do_preload(struct tmem_pool *pool)
 	obj = kmem_cache_alloc(zcache_obj_cache, ZCACHE_GFP_MASK);
 	if (unlikely(obj == NULL)) {
 		zcache_failed_alloc++;
-		goto unlock_out;
+		goto out;
 	}
 	page = (void *)__get_free_page(ZCACHE_GFP_MASK);
 	if (unlikely(page == NULL)) {
 		zcache_failed_get_free_pages++;
 		kmem_cache_free(zcache_obj_cache, obj);
-		goto unlock_out;
+		goto out;
 	}
 	preempt_disable();
 	kp = &__get_cpu_var(zcache_preloads);
@@ -1053,8 +1067,6 @@ static int zcache_do_preload(struct tmem_pool *pool)
 	else
 		free_page((unsigned long)page);
 	ret = 0;
-unlock_out:
-	spin_unlock(&zcache_direct_reclaim_lock);
 out:
 	return ret;
 }
@@ -1150,6 +1162,19 @@ static unsigned long zcache_curr_pers_pampd_count_max;
 /* forward reference */
 static int zcache_compress(struct page *from, void **out_va, size_t *out_len);
 
+/* result of the compression zcache_put_page did before tmem_put */
+static int zcache_preloaded_cdata(void **out_va, size_t *out_len)
+{
+	struct zcache_preload *kp = &__get_cpu_var(zcache_preloads);
+
+	if (kp->cdata == NULL)
+		return 0;
+	*out_va = kp->cdata;
+	*out_len = kp->clen;
+	kp->cdata = NULL;
+	return 1;
+}
+
 static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 				struct tmem_pool *pool, struct tmem_oid *oid,
 				 uint32_t index)
@@ -1166,7 +1191,7 @@ static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 	u64 total_zsize;
 
 	if (eph) {
-		ret = zcache_compress(page, &cdata, &clen);
+		ret = zcache_preloaded_cdata(&cdata, &clen);
 		if (ret == 0)
 			goto out;
 		if (clen == 0 || clen > zbud_max_buddy_size()) {
@@ -1186,7 +1211,7 @@ static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 		if (curr_pers_pampd_count >
 		    (zv_page_count_policy_percent * totalram_pages) / 100)
 			goto out;
-		ret = zcache_compress(page, &cdata, &clen);
+		ret = zcache_preloaded_cdata(&cdata, &clen);
 		if (ret == 0)
 			goto out;
 		/* reject if compression is too poor */
@@ -1196,7 +1221,7 @@ static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 		}
 		/* reject if mean compression is too poor */
 		if ((clen > zv_max_mean_zsize) && (curr_pers_pampd_count > 0)) {
-			total_zsize = xv_get_total_size_bytes(cli->xvpool);
+			total_zsize = zv_total_size_bytes(cli);
 			zv_mean_zsize = div_u64(total_zsize,
 						curr_pers_pampd_count);
 			if (zv_mean_zsize > zv_max_mean_zsize) {
@@ -1204,7 +1229,7 @@ static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 				goto out;
 			}
 		}
-		pampd = (void *)zv_create(cli->xvpool, pool->pool_id,
+		pampd = (void *)zv_create(cli, pool->pool_id,
 						oid, index, cdata, clen);
 		if (pampd == NULL)
 			goto out;
@@ -1262,7 +1287,7 @@ static void zcache_pampd_free(void *pampd, struct tmem_pool *pool,
 		atomic_dec(&zcache_curr_eph_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_eph_pampd_count) < 0);
 	} else {
-		zv_free(cli->xvpool, (struct zv_hdr *)pampd);
+		zv_free(cli, (struct zv_hdr *)pampd);
 		atomic_dec(&zcache_curr_pers_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_pers_pampd_count) < 0);
 	}
@@ -1423,8 +1448,6 @@ ZCACHE_SYSFS_RO(evicted_buddied_pages);
 ZCACHE_SYSFS_RO(failed_get_free_pages);
 ZCACHE_SYSFS_RO(failed_alloc);
 ZCACHE_SYSFS_RO(put_to_flush);
-ZCACHE_SYSFS_RO(aborted_preload);
-ZCACHE_SYSFS_RO(aborted_shrink);
 ZCACHE_SYSFS_RO(compress_poor);
 ZCACHE_SYSFS_RO(mean_compress_poor);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
@@ -1466,8 +1489,6 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_failed_get_free_pages_attr.attr,
 	&zcache_failed_alloc_attr.attr,
 	&zcache_put_to_flush_attr.attr,
-	&zcache_aborted_preload_attr.attr,
-	&zcache_aborted_shrink_attr.attr,
 	&zcache_zbud_unbuddied_list_counts_attr.attr,
 	&zcache_zbud_cumul_chunk_counts_attr.attr,
 	&zcache_zv_curr_dist_counts_attr.attr,
@@ -1507,11 +1528,7 @@ static int shrink_zcache_memory(struct shrinker *shrink,
 		if (!(gfp_mask & __GFP_FS))
 			/* does this case really need to be skipped? */
 			goto out;
-		if (spin_trylock(&zcache_direct_reclaim_lock)) {
-			zbud_evict_pages(nr);
-			spin_unlock(&zcache_direct_reclaim_lock);
-		} else
-			zcache_aborted_shrink++;
+		zbud_evict_pages(nr);
 	}
 	ret = (int)atomic_read(&zcache_zbud_curr_raw_pages);
 out:
@@ -1531,6 +1548,7 @@ static int zcache_put_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 				uint32_t index, struct page *page)
 {
 	struct tmem_pool *pool;
+	struct zcache_preload *kp;
 	int ret = -1;
 
 	BUG_ON(!irqs_disabled());
@@ -1539,6 +1557,9 @@ static int zcache_put_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 		goto out;
 	if (!zcache_freeze && zcache_do_preload(pool) == 0) {
 		/* preload does preempt_disable on success */
+		kp = &__get_cpu_var(zcache_preloads);
+		if (!zcache_compress(page, &kp->cdata, &kp->clen))
+			kp->cdata = NULL;
 		ret = tmem_put(pool, oidp, index, (char *)(page),
 				PAGE_SIZE, 0, is_ephemeral(pool));
 		if (ret < 0) {
@@ -1797,9 +1818,11 @@ static int zcache_frontswap_poolid = -1;
 
 /*
  * Swizzling increases objects per swaptype, increasing tmem concurrency
- * for heavy swaploads.  Later, larger nr_cpus -> larger SWIZ_BITS
+ * for heavy swaploads.  With 16 objects only a handful of hashbuckets were
+ * ever used, so concurrent swapouts kept meeting on the same hb->lock;
+ * 256 objects spread them across all of the buckets.
  */
-#define SWIZ_BITS		4
+#define SWIZ_BITS		8
 #define SWIZ_MASK		((1 << SWIZ_BITS) - 1)
 #define _oswiz(_type, _ind)	((_type << SWIZ_BITS) | (_ind & SWIZ_MASK))
 #define iswiz(_ind)		(_ind >> SWIZ_BITS)
@@ -21,6 +21,7 @@
 
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/percpu.h>
 #include <linux/bio.h>
 #include <linux/bitops.h>
 #include <linux/blkdev.h>
@@ -28,8 +29,12 @@
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
+#include <linux/sched.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -71,6 +76,18 @@ static void zram_stat64_inc(struct zram *zram, u64 *v)
 	zram_stat64_add(zram, v, 1);
 }
 
+/* account one (de)compression that began at local_clock() time start */
+static void zram_stat64_time(struct zram *zram, u64 *time, u64 *count,
+			     u64 start)
+{
+	u64 delta = local_clock() - start;
+
+	spin_lock(&zram->stat64_lock);
+	*time += delta;
+	*count += 1;
+	spin_unlock(&zram->stat64_lock);
+}
+
 static int zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
@@ -104,6 +121,51 @@ static int page_zero_filled(void *ptr)
 	return 1;
 }
 
+static int zram_lzo_compress(const unsigned char *src, unsigned char *dst,
+			     size_t *dst_len, void *workmem)
+{
+	return lzo1x_1_compress(src, PAGE_SIZE, dst, dst_len, workmem);
+}
+
+static int zram_lzo_decompress(const unsigned char *src, size_t src_len,
+			       unsigned char *dst, size_t *dst_len)
+{
+	return lzo1x_decompress_safe(src, src_len, dst, dst_len);
+}
+
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+static int zram_lz4_compress(const unsigned char *src, unsigned char *dst,
+			     size_t *dst_len, void *workmem)
+{
+	return lz4_compress(src, PAGE_SIZE, dst, dst_len, workmem);
+}
+
+static int zram_lz4_decompress(const unsigned char *src, size_t src_len,
+			       unsigned char *dst, size_t *dst_len)
+{
+	return lz4_decompress_unknownoutputsize(src, src_len, dst, dst_len);
+}
+#endif
+
+/* The first one is the default, the list ends with an empty entry */
+const struct zram_compressor zram_compressors[] = {
+	{
+		.name		= "lzo",
+		.workmem_size	= LZO1X_MEM_COMPRESS,
+		.compress	= zram_lzo_compress,
+		.decompress	= zram_lzo_decompress,
+	},
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+	{
+		.name		= "lz4",
+		.workmem_size	= LZ4_MEM_COMPRESS,
+		.compress	= zram_lz4_compress,
+		.decompress	= zram_lz4_decompress,
+	},
+#endif
+	{ }
+};
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -133,15 +195,120 @@ static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 	zram->disksize &= PAGE_MASK;
 }
 
+/* zsmalloc handle of the compressed object of table entry index */
+static unsigned long zram_handle(struct zram *zram, u32 index)
+{
+	unsigned long handle = zram->table[index].handle;
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP))
+		return ((struct zram_dedup_entry *)handle)->handle;
+	return handle;
+}
+
+static u32 zram_dedup_checksum(void *mem)
+{
+	return jhash2(mem, PAGE_SIZE / sizeof(u32), 0);
+}
+
+/*
+ * Drop a reference to entry, freeing the object along with the last one.
+ * Returns true if it was the last.
+ */
+static bool zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	spin_lock(&zram->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&zram->dedup_lock);
+		return false;
+	}
+	hlist_del(&entry->node);
+	spin_unlock(&zram->dedup_lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	kfree(entry);
+	return true;
+}
+
+/* whether entry holds the page at mem, decompressing it into buffer */
+static bool zram_dedup_match(struct zram *zram,
+			     struct zram_dedup_entry *entry,
+			     void *mem, void *buffer)
+{
+	size_t len = PAGE_SIZE;
+	unsigned char *cmem;
+	int ret;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+	ret = zram->comp->decompress(cmem, entry->len, buffer, &len);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return !ret && len == PAGE_SIZE && !memcmp(mem, buffer, PAGE_SIZE);
+}
+
+/*
+ * Look for a stored copy of the page at mem and return it referenced, or
+ * NULL. Only the first entry with a matching checksum is tried: telling
+ * a collision apart costs a decompression, walking on for more is not
+ * worth it.
+ */
+static struct zram_dedup_entry *zram_dedup_find(struct zram *zram, void *mem,
+						u32 checksum, void *buffer)
+{
+	struct zram_dedup_entry *entry;
+	struct hlist_node *pos;
+	struct hlist_head *head;
+
+	head = &zram->dedup_hash[checksum & zram->dedup_mask];
+
+	spin_lock(&zram->dedup_lock);
+	hlist_for_each_entry(entry, pos, head, node) {
+		if (entry->checksum == checksum)
+			goto found;
+	}
+	spin_unlock(&zram->dedup_lock);
+	return NULL;
+
+found:
+	entry->refcount++;
+	spin_unlock(&zram->dedup_lock);
+
+	if (zram_dedup_match(zram, entry, mem, buffer))
+		return entry;
+
+	zram_dedup_put(zram, entry);
+	return NULL;
+}
+
+/* make a freshly stored object shareable, NULL if out of memory */
+static struct zram_dedup_entry *zram_dedup_add(struct zram *zram,
+					       unsigned long handle,
+					       size_t len, u32 checksum)
+{
+	struct zram_dedup_entry *entry;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+	entry->len = len;
+
+	spin_lock(&zram->dedup_lock);
+	hlist_add_head(&entry->node,
+		       &zram->dedup_hash[checksum & zram->dedup_mask]);
+	spin_unlock(&zram->dedup_lock);
+
+	return entry;
+}
+
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	u32 clen;
-	void *obj;
+	unsigned long handle = zram->table[index].handle;
 
-	struct page *page = zram->table[index].page;
-	u32 offset = zram->table[index].offset;
-
-	if (unlikely(!page)) {
+	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
 		 * Simply clear zero page flag.
@@ -155,26 +322,34 @@ static void zram_free_page(struct zram *zram, size_t index)
 
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		clen = PAGE_SIZE;
-		__free_page(page);
+		__free_page((struct page *)handle);
 		zram_clear_flag(zram, index, ZRAM_UNCOMPRESSED);
 		zram_stat_dec(&zram->stats.pages_expand);
 		goto out;
 	}
 
-	obj = kmap_atomic(page, KM_USER0) + offset;
-	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
-	kunmap_atomic(obj, KM_USER0);
-
-	xv_free(zram->mem_pool, page, offset);
+	clen = zram->table[index].size;
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_dec(&zram->stats.good_compress);
 
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		if (!zram_dedup_put(zram, (struct zram_dedup_entry *)handle)) {
+			/* others still share the object */
+			zram_stat64_sub(zram, &zram->stats.dedup_saved, clen);
+			goto put;
+		}
+	} else {
+		zs_free(zram->mem_pool, handle);
+	}
+
 out:
 	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
+put:
 	zram_stat_dec(&zram->stats.pages_stored);
 
-	zram->table[index].page = NULL;
-	zram->table[index].offset = 0;
+	zram->table[index].handle = 0;
+	zram->table[index].size = 0;
 }
 
 static void handle_zero_page(struct bio_vec *bvec)
@@ -196,7 +371,7 @@ static void handle_uncompressed_page(struct zram *zram, struct bio_vec *bvec,
 	unsigned char *user_mem, *cmem;
 
 	user_mem = kmap_atomic(page, KM_USER0);
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1);
+	cmem = kmap_atomic((struct page *)zram->table[index].handle, KM_USER1);
 
 	memcpy(user_mem + bvec->bv_offset, cmem + offset, bvec->bv_len);
 	kunmap_atomic(cmem, KM_USER1);
@@ -210,13 +385,31 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+/* decompress the object of table entry index, a whole page, into mem */
+static int zram_decompress(struct zram *zram, u32 index, unsigned char *mem)
+{
+	size_t clen = PAGE_SIZE;
+	u64 start;
+	unsigned char *cmem;
+	int ret;
+
+	cmem = zs_map_object(zram->mem_pool, zram_handle(zram, index),
+			     ZS_MM_RO);
+	start = local_clock();
+	ret = zram->comp->decompress(cmem, zram->table[index].size,
+				     mem, &clen);
+	zram_stat64_time(zram, &zram->stats.decompr_time,
+			 &zram->stats.num_decompr, start);
+	zs_unmap_object(zram->mem_pool, zram_handle(zram, index));
+
+	return ret;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
 	struct page *page;
-	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
 
 	page = bvec->bv_page;
@@ -227,7 +420,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	}
 
 	/* Requested page is not present in compressed area */
-	if (unlikely(!zram->table[index].page)) {
+	if (unlikely(!zram->table[index].handle)) {
 		pr_debug("Read before write: sector=%lu, size=%u",
 			 (ulong)(bio->bi_sector), bio->bi_size);
 		handle_zero_page(bvec);
@@ -252,14 +445,8 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	user_mem = kmap_atomic(page, KM_USER0);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
-
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-		zram->table[index].offset;
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    uncmem, &clen);
+	ret = zram_decompress(zram, index, uncmem);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -267,11 +454,10 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		kfree(uncmem);
 	}
 
-	kunmap_atomic(cmem, KM_USER1);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -285,33 +471,27 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
-	struct zobj_header *zheader;
 	unsigned char *cmem;
 
 	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
-	    !zram->table[index].page) {
+	    !zram->table[index].handle) {
 		memset(mem, 0, PAGE_SIZE);
 		return 0;
 	}
 
-	cmem = kmap_atomic(zram->table[index].page, KM_USER0) +
-		zram->table[index].offset;
-
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic((struct page *)zram->table[index].handle,
+				   KM_USER0);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem, KM_USER0);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    mem, &clen);
-	kunmap_atomic(cmem, KM_USER0);
+	ret = zram_decompress(zram, index, mem);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -320,30 +500,59 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/*
+ * Writers compress into the stream of the CPU they run on, so that they do
+ * so in parallel and only the allocation and table update that follow are
+ * serialised by zram->lock. The mutex covers being migrated meanwhile, and
+ * is always taken before zram->lock.
+ */
+static struct zram_stream *zram_stream_get(struct zram *zram)
+{
+	struct zram_stream *zstrm;
+
+	zstrm = per_cpu_ptr(zram->streams, raw_smp_processor_id());
+	mutex_lock(&zstrm->lock);
+	return zstrm;
+}
+
+static void zram_stream_put(struct zram_stream *zstrm)
+{
+	mutex_unlock(&zstrm->lock);
+}
+
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
-	int ret;
-	u32 store_offset;
+	int ret = 0;
+	int zero;
+	u64 start;
 	size_t clen;
-	struct zobj_header *zheader;
+	u32 checksum = 0;
+	unsigned long handle;
+	struct zram_dedup_entry *entry = NULL;
+	struct zram_stream *zstrm;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
-		/*
-		 * This is a partial IO. We need to read the full page
-		 * before to write the changes.
-		 */
 		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
 		if (!uncmem) {
 			pr_info("Error allocating temp memory!\n");
-			ret = -ENOMEM;
-			goto out;
+			zram_stat64_inc(zram, &zram->stats.failed_writes);
+			return -ENOMEM;
 		}
+	}
+
+	zstrm = zram_stream_get(zram);
+
+	if (is_partial_io(bvec)) {
+		/*
+		 * This is a partial IO. We need to read the full page
+		 * before to write the changes, all under the lock.
+		 */
+		down_write(&zram->lock);
 		ret = zram_read_before_write(zram, uncmem, index);
 		if (ret) {
 			kfree(uncmem);
@@ -351,14 +560,6 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		}
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].page ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
-
 	user_mem = kmap_atomic(page, KM_USER0);
 
 	if (is_partial_io(bvec))
@@ -367,28 +568,55 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	else
 		uncmem = user_mem;
 
-	if (page_zero_filled(uncmem)) {
-		kunmap_atomic(user_mem, KM_USER0);
-		if (is_partial_io(bvec))
-			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
-		ret = 0;
-		goto out;
+	zero = page_zero_filled(uncmem);
+	if (!zero && zram->use_dedup) {
+		checksum = zram_dedup_checksum(uncmem);
+		entry = zram_dedup_find(zram, uncmem, checksum, zstrm->buffer);
+	}
+	if (!zero && !entry) {
+		start = local_clock();
+		ret = zram->comp->compress(uncmem, zstrm->buffer, &clen,
+					   zstrm->workmem);
+		zram_stat64_time(zram, &zram->stats.compr_time,
+				 &zram->stats.num_compr, start);
 	}
-
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
 
 	kunmap_atomic(user_mem, KM_USER0);
 	if (is_partial_io(bvec))
-			kfree(uncmem);
+		kfree(uncmem);
+	else
+		down_write(&zram->lock);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
 
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	if (zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_ZERO))
+		zram_free_page(zram, index);
+
+	if (zero) {
+		zram_stat_inc(&zram->stats.pages_zero);
+		zram_set_flag(zram, index, ZRAM_ZERO);
+		goto out;
+	}
+
+	if (entry) {
+		/* the page is stored already, share that object */
+		clen = entry->len;
+		zram_set_flag(zram, index, ZRAM_DEDUP);
+		zram->table[index].handle = (unsigned long)entry;
+		zram->table[index].size = clen;
+		zram_stat64_inc(zram, &zram->stats.dedup_hits);
+		zram_stat64_add(zram, &zram->stats.dedup_saved, clen);
+		goto count;
+	}
+
 	/*
 	 * Page is incompressible. Store it as-is (uncompressed)
 	 * since we do not want to return too many disk write
@@ -404,53 +632,53 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 
-		store_offset = 0;
 		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
 		zram_stat_inc(&zram->stats.pages_expand);
-		zram->table[index].page = page_store;
+		zram->table[index].handle = (unsigned long)page_store;
+
 		src = kmap_atomic(page, KM_USER0);
-		goto memstore;
+		cmem = kmap_atomic(page_store, KM_USER1);
+		memcpy(cmem, src, PAGE_SIZE);
+		kunmap_atomic(cmem, KM_USER1);
+		kunmap_atomic(src, KM_USER0);
+		goto stats;
 	}
 
-	if (xv_malloc(zram->mem_pool, clen + sizeof(*zheader),
-		      &zram->table[index].page, &store_offset,
-		      GFP_NOIO | __GFP_HIGHMEM)) {
+	handle = zs_malloc(zram->mem_pool, clen);
+	if (unlikely(!handle)) {
 		pr_info("Error allocating memory for compressed "
 			"page: %u, size=%zu\n", index, clen);
 		ret = -ENOMEM;
 		goto out;
 	}
 
-memstore:
-	zram->table[index].offset = store_offset;
+	zram->table[index].handle = handle;
+	zram->table[index].size = clen;
 
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-		zram->table[index].offset;
+	cmem = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
+	memcpy(cmem, zstrm->buffer, clen);
+	zs_unmap_object(zram->mem_pool, handle);
 
-#if 0
-	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
+	/* without an entry the object just isn't shared */
+	if (zram->use_dedup) {
+		entry = zram_dedup_add(zram, handle, clen, checksum);
+		if (entry) {
+			zram_set_flag(zram, index, ZRAM_DEDUP);
+			zram->table[index].handle = (unsigned long)entry;
+		}
 	}
-#endif
-
-	memcpy(cmem, src, clen);
-
-	kunmap_atomic(cmem, KM_USER1);
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
-		kunmap_atomic(src, KM_USER0);
 
+stats:
 	/* Update stats */
 	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+count:
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
 
-	return 0;
-
 out:
+	up_write(&zram->lock);
+	zram_stream_put(zstrm);
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
@@ -466,9 +694,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
 	}
 
 	return ret;
@@ -579,38 +805,45 @@ static int zram_make_request(struct request_queue *queue, struct bio *bio)
 void zram_reset_device(struct zram *zram)
 {
 	size_t index;
+	struct zram_stream *zstrm;
+	int cpu;
 
 	mutex_lock(&zram->init_lock);
 	zram->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
-
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	if (zram->streams) {
+		for_each_possible_cpu(cpu) {
+			zstrm = per_cpu_ptr(zram->streams, cpu);
+			kfree(zstrm->workmem);
+			free_pages((unsigned long)zstrm->buffer, 1);
+		}
+		free_percpu(zram->streams);
+		zram->streams = NULL;
+	}
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
-		struct page *page;
-		u16 offset;
+		unsigned long handle = zram->table[index].handle;
 
-		page = zram->table[index].page;
-		offset = zram->table[index].offset;
-
-		if (!page)
+		if (!handle)
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
-			__free_page(page);
+			__free_page((struct page *)handle);
+		else if (zram_test_flag(zram, index, ZRAM_DEDUP))
+			zram_dedup_put(zram, (struct zram_dedup_entry *)handle);
 		else
-			xv_free(zram->mem_pool, page, offset);
+			zs_free(zram->mem_pool, handle);
 	}
 
 	vfree(zram->table);
 	zram->table = NULL;
 
-	xv_destroy_pool(zram->mem_pool);
+	vfree(zram->dedup_hash);
+	zram->dedup_hash = NULL;
+
+	zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
 	/* Reset stats */
@@ -622,8 +855,9 @@ void zram_reset_device(struct zram *zram)
 
 int zram_init_device(struct zram *zram)
 {
-	int ret;
+	int ret, cpu;
 	size_t num_pages;
+	struct zram_stream *zstrm;
 
 	mutex_lock(&zram->init_lock);
 
@@ -634,18 +868,31 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
+	zram->streams = alloc_percpu(struct zram_stream);
+	if (!zram->streams) {
+		pr_err("Error allocating compression streams\n");
 		ret = -ENOMEM;
 		goto fail;
 	}
 
-	zram->compress_buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
-		goto fail;
+	for_each_possible_cpu(cpu) {
+		zstrm = per_cpu_ptr(zram->streams, cpu);
+		mutex_init(&zstrm->lock);
+
+		zstrm->workmem = kzalloc(zram->comp->workmem_size,
+					 GFP_KERNEL);
+		if (!zstrm->workmem) {
+			pr_err("Error allocating compressor working memory!\n");
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		zstrm->buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
+		if (!zstrm->buffer) {
+			pr_err("Error allocating compressor buffer space\n");
+			ret = -ENOMEM;
+			goto fail;
+		}
 	}
 
 	num_pages = zram->disksize >> PAGE_SHIFT;
@@ -658,12 +905,27 @@ int zram_init_device(struct zram *zram)
 		goto fail;
 	}
 
+	if (zram->use_dedup) {
+		/* about one bucket per eight pages */
+		zram->dedup_mask = roundup_pow_of_two(max_t(size_t,
+					num_pages >> 3, 1)) - 1;
+		zram->dedup_hash = vzalloc((zram->dedup_mask + 1) *
+					   sizeof(*zram->dedup_hash));
+		if (!zram->dedup_hash) {
+			pr_err("Error allocating dedup hash table\n");
+			ret = -ENOMEM;
+			goto fail;
+		}
+	}
+
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
+	/* ...whose every read costs a decompression rather than a seek */
+	queue_flag_set_unlocked(QUEUE_FLAG_RAMBACKED, zram->disk->queue);
 
-	zram->mem_pool = xv_create_pool();
+	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
@@ -704,6 +966,8 @@ static int create_device(struct zram *zram, int device_id)
 
 	init_rwsem(&zram->lock);
 	mutex_init(&zram->init_lock);
+	spin_lock_init(&zram->dedup_lock);
+	zram->comp = &zram_compressors[0];
 	spin_lock_init(&zram->stat64_lock);
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
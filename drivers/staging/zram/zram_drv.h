@@ -15,10 +15,11 @@
 #ifndef _ZRAM_DRV_H_
 #define _ZRAM_DRV_H_
 
+#include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
 
-#include "xvmalloc.h"
+#include "../zsmalloc/zsmalloc.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -26,18 +27,6 @@
  */
 static const unsigned max_num_devices = 32;
 
-/*
- * Stored at beginning of each compressed object.
- *
- * It stores back-reference to table entry which points to this
- * object. This is required to support memory defragmentation.
- */
-struct zobj_header {
-#if 0
-	u32 table_idx;
-#endif
-};
-
 /*-- Configurable parameters */
 
 /* Default zram disk size: 25% of total RAM */
@@ -50,9 +39,9 @@ static const unsigned default_disksize_perc_ram = 25;
 static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
 
 /*
- * NOTE: max_zpage_size must be less than or equal to:
- *   XV_MAX_ALLOC_SIZE - sizeof(struct zobj_header)
- * otherwise, xv_malloc() would always return failure.
+ * NOTE: max_zpage_size must be less than or equal to the largest
+ * object zsmalloc hands out (PAGE_SIZE less its handle word),
+ * otherwise, zs_malloc() would always return failure.
  */
 
 /*-- End of configurable params */
@@ -74,6 +63,9 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
+	/* handle is a struct zram_dedup_entry shared with other pages */
+	ZRAM_DEDUP,
+
 	__NR_ZRAM_PAGEFLAGS,
 };
 
@@ -81,8 +73,8 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct table {
-	struct page *page;
-	u16 offset;
+	unsigned long handle;	/* zsmalloc handle, or page if uncompressed */
+	u16 size;		/* compressed object size */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
 } __attribute__((aligned(4)));
@@ -99,16 +91,59 @@ struct zram_stats {
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u64 num_compr;		/* pages compressed */
+	u64 compr_time;		/* ns spent compressing them */
+	u64 num_decompr;	/* pages decompressed */
+	u64 decompr_time;	/* ns spent decompressing them */
+	u64 dedup_hits;		/* writes that found their page stored */
+	u64 dedup_saved;	/* compressed bytes not stored twice */
+};
+
+/*
+ * A compressed object that identical pages share, hashed by the checksum
+ * of its uncompressed content.
+ */
+struct zram_dedup_entry {
+	struct hlist_node node;
+	unsigned long handle;
+	u32 checksum;
+	u32 refcount;		/* table entries pointing here */
+	u16 len;
+};
+
+/*
+ * A compression backend. compress() takes a whole page into a buffer of
+ * two pages, decompress() gets the room in dst passed in *dst_len; both
+ * return 0 on success.
+ */
+struct zram_compressor {
+	const char *name;
+	size_t workmem_size;
+	int (*compress)(const unsigned char *src, unsigned char *dst,
+			size_t *dst_len, void *workmem);
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			  unsigned char *dst, size_t *dst_len);
+};
+
+/* Per-CPU compression workspace and output buffer */
+struct zram_stream {
+	struct mutex lock;
+	void *workmem;
+	void *buffer;
 };
 
 struct zram {
-	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zs_pool *mem_pool;
+	const struct zram_compressor *comp;
+	struct zram_stream __percpu *streams;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	bool use_dedup;		/* share objects between identical pages */
+	spinlock_t dedup_lock;	/* protect dedup_hash and refcounts */
+	struct hlist_head *dedup_hash;
+	u32 dedup_mask;
+	struct rw_semaphore lock; /* protect table against concurrent
+				   * read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -129,6 +164,8 @@ extern unsigned int num_devices;
 extern struct attribute_group zram_disk_attr_group;
 #endif
 
+extern const struct zram_compressor zram_compressors[];
+
 extern int zram_init_device(struct zram *zram);
 extern void zram_reset_device(struct zram *zram);
 
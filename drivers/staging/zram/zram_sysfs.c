@@ -14,6 +14,7 @@
 
 #include <linux/device.h>
 #include <linux/genhd.h>
+#include <linux/math64.h>
 #include <linux/mm.h>
 
 #include "zram_drv.h"
@@ -112,6 +113,79 @@ static ssize_t reset_store(struct device *dev,
 	return len;
 }
 
+static ssize_t comp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	const struct zram_compressor *comp;
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t len = 0;
+
+	for (comp = zram_compressors; comp->name; comp++) {
+		if (comp == zram->comp)
+			len += sprintf(buf + len, "[%s] ", comp->name);
+		else
+			len += sprintf(buf + len, "%s ", comp->name);
+	}
+	buf[len - 1] = '\n';
+
+	return len;
+}
+
+static ssize_t comp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	const struct zram_compressor *comp;
+	struct zram *zram = dev_to_zram(dev);
+
+	for (comp = zram_compressors; comp->name; comp++)
+		if (sysfs_streq(buf, comp->name))
+			break;
+	if (!comp->name)
+		return -EINVAL;
+
+	mutex_lock(&zram->init_lock);
+	if (zram->init_done) {
+		mutex_unlock(&zram->init_lock);
+		pr_info("Cannot change compressor for initialized device\n");
+		return -EBUSY;
+	}
+	zram->comp = comp;
+	mutex_unlock(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%d\n", zram->use_dedup);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int ret;
+	unsigned long val;
+	struct zram *zram = dev_to_zram(dev);
+
+	ret = strict_strtoul(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&zram->init_lock);
+	if (zram->init_done) {
+		mutex_unlock(&zram->init_lock);
+		pr_info("Cannot change dedup for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = !!val;
+	mutex_unlock(&zram->init_lock);
+
+	return len;
+}
+
 static ssize_t num_reads_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -174,6 +248,66 @@ static ssize_t compr_data_size_show(struct device *dev,
 		zram_stat64_read(zram, &zram->stats.compr_size));
 }
 
+/* compressed size in percent of the original, incompressible pages count */
+static ssize_t compr_ratio_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	u64 orig = (u64)(zram->stats.pages_stored) << PAGE_SHIFT;
+	u64 compr = zram_stat64_read(zram, &zram->stats.compr_size);
+
+	return sprintf(buf, "%llu\n", orig ? div64_u64(compr * 100, orig) : 0);
+}
+
+/* average ns per page */
+static u64 zram_stat64_avg(struct zram *zram, u64 *time, u64 *count)
+{
+	u64 t, n;
+
+	spin_lock(&zram->stat64_lock);
+	t = *time;
+	n = *count;
+	spin_unlock(&zram->stat64_lock);
+
+	return n ? div64_u64(t, n) : 0;
+}
+
+static ssize_t avg_compr_time_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%llu\n", zram_stat64_avg(zram,
+		&zram->stats.compr_time, &zram->stats.num_compr));
+}
+
+static ssize_t avg_decompr_time_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%llu\n", zram_stat64_avg(zram,
+		&zram->stats.decompr_time, &zram->stats.num_decompr));
+}
+
+static ssize_t dedup_hits_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%llu\n",
+		zram_stat64_read(zram, &zram->stats.dedup_hits));
+}
+
+static ssize_t dedup_saved_size_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%llu\n",
+		zram_stat64_read(zram, &zram->stats.dedup_saved));
+}
+
 static ssize_t mem_used_total_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -181,16 +315,55 @@ static ssize_t mem_used_total_show(struct device *dev,
 	struct zram *zram = dev_to_zram(dev);
 
 	if (zram->init_done) {
-		val = xv_get_total_size_bytes(zram->mem_pool) +
+		val = zs_get_total_size_bytes(zram->mem_pool) +
+			((u64)(zram->stats.pages_expand) << PAGE_SHIFT);
+	}
+
+	return sprintf(buf, "%llu\n", val);
+}
+
+/*
+ * Percentage of the pool that holds no live object: the space zs_compact()
+ * could hand back at best.
+ */
+static ssize_t frag_ratio_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	u64 pool, used;
+	u64 val = 0;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (zram->init_done) {
+		pool = zs_get_total_size_bytes(zram->mem_pool);
+		used = zram_stat64_read(zram, &zram->stats.compr_size) -
 			((u64)(zram->stats.pages_expand) << PAGE_SHIFT);
+		if (pool > used)
+			val = div64_u64((pool - used) * 100, pool);
 	}
 
 	return sprintf(buf, "%llu\n", val);
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	mutex_lock(&zram->init_lock);
+	if (zram->init_done)
+		zs_compact(zram->mem_pool);
+	mutex_unlock(&zram->init_lock);
+
+	return len;
+}
+
 static DEVICE_ATTR(disksize, S_IRUGO | S_IWUSR,
 		disksize_show, disksize_store);
 static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
+static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
+		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
 static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
 static DEVICE_ATTR(num_reads, S_IRUGO, num_reads_show, NULL);
 static DEVICE_ATTR(num_writes, S_IRUGO, num_writes_show, NULL);
@@ -199,11 +372,20 @@ static DEVICE_ATTR(notify_free, S_IRUGO, notify_free_show, NULL);
 static DEVICE_ATTR(zero_pages, S_IRUGO, zero_pages_show, NULL);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(compr_data_size, S_IRUGO, compr_data_size_show, NULL);
+static DEVICE_ATTR(compr_ratio, S_IRUGO, compr_ratio_show, NULL);
+static DEVICE_ATTR(avg_compr_time, S_IRUGO, avg_compr_time_show, NULL);
+static DEVICE_ATTR(avg_decompr_time, S_IRUGO, avg_decompr_time_show, NULL);
+static DEVICE_ATTR(dedup_hits, S_IRUGO, dedup_hits_show, NULL);
+static DEVICE_ATTR(dedup_saved_size, S_IRUGO, dedup_saved_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(frag_ratio, S_IRUGO, frag_ratio_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
 	&dev_attr_initstate.attr,
+	&dev_attr_comp_algorithm.attr,
+	&dev_attr_use_dedup.attr,
 	&dev_attr_reset.attr,
 	&dev_attr_num_reads.attr,
 	&dev_attr_num_writes.attr,
@@ -212,7 +394,14 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_zero_pages.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
+	&dev_attr_compr_ratio.attr,
+	&dev_attr_avg_compr_time.attr,
+	&dev_attr_avg_decompr_time.attr,
+	&dev_attr_dedup_hits.attr,
+	&dev_attr_dedup_saved_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_frag_ratio.attr,
+	&dev_attr_compact.attr,
 	NULL,
 };
 
@@ -0,0 +1,713 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * An allocator for compressed pages: objects of any size up to a page are
+ * packed into zspages of their size class, so that little more memory is
+ * used than the objects need, and objects are only known by handles, so
+ * that they can be moved. xvmalloc, which this replaces in zram, neither
+ * groups objects by size nor moves them, and after a while of freeing in
+ * random order holds far more pages than it has data for.
+ *
+ * Compaction moves the objects of the emptiest zspages of a class into
+ * the fullest ones until no more zspages can be freed. It runs when the
+ * VM asks the pool's shrinker for memory and through zs_compact().
+ */
+
+#ifdef CONFIG_ZSMALLOC_DEBUG
+#define DEBUG
+#endif
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/bit_spinlock.h>
+#include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zsmalloc.h"
+#include "zsmalloc_int.h"
+
+/*
+ * Objects that straddle two pages are mapped by copying them into the
+ * buffer of the CPU, which is held with preemption off until unmapped.
+ */
+struct zs_map_area {
+	char *buf;
+	void *kaddr;		/* the object's page, if it doesn't straddle */
+	enum zs_mapmode mm;
+};
+
+static DEFINE_PER_CPU(struct zs_map_area, zs_map_area);
+
+static struct kmem_cache *zs_handle_cache;
+static struct kmem_cache *zs_zspage_cache;
+
+static int get_size_class_index(int size)
+{
+	int idx = 0;
+
+	if (likely(size > ZS_MIN_ALLOC_SIZE))
+		idx = DIV_ROUND_UP(size - ZS_MIN_ALLOC_SIZE,
+				   ZS_SIZE_CLASS_DELTA);
+
+	return idx;
+}
+
+/* the zspage length that leaves the least of it unused */
+static int get_pages_per_zspage(int class_size)
+{
+	int i, max_usedpc = 0;
+	int max_usedpc_order = 1;
+
+	for (i = 1; i <= ZS_MAX_PAGES_PER_ZSPAGE; i++) {
+		int zspage_size = i * PAGE_SIZE;
+		int waste = zspage_size % class_size;
+		int usedpc = (zspage_size - waste) * 100 / zspage_size;
+
+		if (usedpc > max_usedpc) {
+			max_usedpc = usedpc;
+			max_usedpc_order = i;
+		}
+	}
+
+	return max_usedpc_order;
+}
+
+static enum fullness_group get_fullness_group(struct size_class *class,
+					      struct zspage *zspage)
+{
+	if (zspage->inuse == 0)
+		return ZS_EMPTY;
+	if (zspage->inuse == class->objs_per_zspage)
+		return ZS_FULL;
+	if (zspage->inuse * ZS_ALMOST_FULL_DEN <=
+	    class->objs_per_zspage * ZS_ALMOST_FULL_NUM)
+		return ZS_ALMOST_EMPTY;
+	return ZS_ALMOST_FULL;
+}
+
+static void insert_zspage(struct size_class *class, struct zspage *zspage)
+{
+	zspage->fullness = get_fullness_group(class, zspage);
+	list_add(&zspage->list, &class->fullness_list[zspage->fullness]);
+}
+
+static void remove_zspage(struct zspage *zspage)
+{
+	list_del_init(&zspage->list);
+}
+
+/* move to the list it now belongs on, unless it is empty */
+static enum fullness_group fix_fullness_group(struct size_class *class,
+					      struct zspage *zspage)
+{
+	enum fullness_group fg = get_fullness_group(class, zspage);
+
+	if (fg == zspage->fullness)
+		return fg;
+
+	remove_zspage(zspage);
+	if (fg == ZS_EMPTY)
+		zspage->fullness = ZS_EMPTY;
+	else
+		insert_zspage(class, zspage);
+	return fg;
+}
+
+static struct zspage *find_get_zspage(struct size_class *class)
+{
+	struct list_head *list;
+
+	list = &class->fullness_list[ZS_ALMOST_FULL];
+	if (list_empty(list))
+		list = &class->fullness_list[ZS_ALMOST_EMPTY];
+	if (list_empty(list))
+		return NULL;
+
+	return list_first_entry(list, struct zspage, list);
+}
+
+/* object locations: the pfn of the zspage's first page and the index */
+static unsigned long location_to_obj(struct zspage *zspage, unsigned int idx)
+{
+	return (page_to_pfn(zspage->pages[0]) << OBJ_INDEX_BITS) | idx;
+}
+
+static struct zspage *obj_to_location(unsigned long obj, unsigned int *idx)
+{
+	*idx = obj & OBJ_INDEX_MASK;
+	return (struct zspage *)page_private(pfn_to_page(obj >>
+							 OBJ_INDEX_BITS));
+}
+
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return *(unsigned long *)handle >> OBJ_TAG_BITS;
+}
+
+/* keeps the pin, which the caller holds */
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	unsigned long *slot = (unsigned long *)handle;
+
+	*slot = (obj << OBJ_TAG_BITS) | (*slot & (1UL << HANDLE_PIN_BIT));
+}
+
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+/*
+ * The head word of an object never straddles pages: class sizes and so
+ * object offsets are multiples of ZS_SIZE_CLASS_DELTA.
+ */
+static unsigned long obj_read_head(struct size_class *class,
+				   struct zspage *zspage, unsigned int idx)
+{
+	unsigned long off = (unsigned long)idx * class->size;
+	unsigned long head;
+	void *addr;
+
+	addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+	head = *(unsigned long *)(addr + (off & ~PAGE_MASK));
+	kunmap_atomic(addr, KM_USER0);
+
+	return head;
+}
+
+static void obj_write_head(struct size_class *class, struct zspage *zspage,
+			   unsigned int idx, unsigned long head)
+{
+	unsigned long off = (unsigned long)idx * class->size;
+	void *addr;
+
+	addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+	*(unsigned long *)(addr + (off & ~PAGE_MASK)) = head;
+	kunmap_atomic(addr, KM_USER0);
+}
+
+/* copy bytes [start, size) of an object from or to buf */
+static void obj_copy(struct size_class *class, struct zspage *zspage,
+		     unsigned int idx, char *buf, int start, bool to_obj)
+{
+	unsigned long off = (unsigned long)idx * class->size + start;
+	int len = class->size - start;
+	int n;
+	char *addr;
+
+	while (len) {
+		n = min_t(int, len, PAGE_SIZE - (off & ~PAGE_MASK));
+		addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+		if (to_obj)
+			memcpy(addr + (off & ~PAGE_MASK), buf, n);
+		else
+			memcpy(buf, addr + (off & ~PAGE_MASK), n);
+		kunmap_atomic(addr, KM_USER0);
+		buf += n;
+		off += n;
+		len -= n;
+	}
+}
+
+/* called with class->lock held */
+static unsigned int obj_malloc(struct size_class *class,
+			       struct zspage *zspage, unsigned long handle)
+{
+	unsigned int idx = zspage->freeobj;
+
+	zspage->freeobj = obj_read_head(class, zspage, idx) >> OBJ_TAG_BITS;
+	obj_write_head(class, zspage, idx, handle | OBJ_ALLOCATED_TAG);
+
+	zspage->inuse++;
+	class->objs_inuse++;
+	fix_fullness_group(class, zspage);
+
+	return idx;
+}
+
+/* called with class->lock held, the caller frees an emptied zspage */
+static enum fullness_group obj_free(struct size_class *class,
+				    struct zspage *zspage, unsigned int idx)
+{
+	obj_write_head(class, zspage, idx,
+		       (unsigned long)zspage->freeobj << OBJ_TAG_BITS);
+	zspage->freeobj = idx;
+
+	zspage->inuse--;
+	class->objs_inuse--;
+	return fix_fullness_group(class, zspage);
+}
+
+static void free_zspage(struct zs_pool *pool, struct size_class *class,
+			struct zspage *zspage)
+{
+	int i;
+
+	set_page_private(zspage->pages[0], 0);
+	for (i = 0; i < class->pages_per_zspage; i++)
+		__free_page(zspage->pages[i]);
+	kmem_cache_free(zs_zspage_cache, zspage);
+
+	class->nr_zspages--;
+	atomic_long_sub(class->pages_per_zspage, &pool->pages_allocated);
+}
+
+static struct zspage *alloc_zspage(struct zs_pool *pool,
+				   struct size_class *class)
+{
+	struct zspage *zspage;
+	unsigned int idx;
+	int i;
+
+	zspage = kmem_cache_alloc(zs_zspage_cache,
+				  pool->flags & ~__GFP_HIGHMEM);
+	if (!zspage)
+		return NULL;
+
+	for (i = 0; i < class->pages_per_zspage; i++) {
+		zspage->pages[i] = alloc_page(pool->flags);
+		if (!zspage->pages[i])
+			goto fail;
+	}
+
+	INIT_LIST_HEAD(&zspage->list);
+	zspage->class = class;
+	zspage->inuse = 0;
+	zspage->fullness = ZS_EMPTY;
+	zspage->freeobj = 0;
+	for (idx = 0; idx < class->objs_per_zspage; idx++)
+		obj_write_head(class, zspage, idx,
+			       (unsigned long)(idx + 1) << OBJ_TAG_BITS);
+	set_page_private(zspage->pages[0], (unsigned long)zspage);
+
+	return zspage;
+
+fail:
+	while (i--)
+		__free_page(zspage->pages[i]);
+	kmem_cache_free(zs_zspage_cache, zspage);
+	return NULL;
+}
+
+/**
+ * zs_malloc - allocate an object from a pool
+ * @pool: pool to allocate from
+ * @size: size of the object
+ *
+ * Returns a handle to the object, or 0 if there was no memory or @size
+ * is out of range. The object is only accessed through zs_map_object().
+ */
+unsigned long zs_malloc(struct zs_pool *pool, size_t size)
+{
+	struct size_class *class;
+	struct zspage *zspage;
+	unsigned long handle;
+	unsigned int idx;
+
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE))
+		return 0;
+
+	handle = (unsigned long)kmem_cache_alloc(zs_handle_cache,
+					pool->flags & ~__GFP_HIGHMEM);
+	if (!handle)
+		return 0;
+	*(unsigned long *)handle = 0;
+
+	class = &pool->size_class[get_size_class_index(size +
+						       ZS_HANDLE_SIZE)];
+
+	spin_lock(&class->lock);
+	zspage = find_get_zspage(class);
+	if (!zspage) {
+		spin_unlock(&class->lock);
+		zspage = alloc_zspage(pool, class);
+		if (unlikely(!zspage)) {
+			kmem_cache_free(zs_handle_cache, (void *)handle);
+			return 0;
+		}
+		atomic_long_add(class->pages_per_zspage,
+				&pool->pages_allocated);
+
+		spin_lock(&class->lock);
+		class->nr_zspages++;
+	}
+
+	idx = obj_malloc(class, zspage, handle);
+	record_obj(handle, location_to_obj(zspage, idx));
+	spin_unlock(&class->lock);
+
+	return handle;
+}
+EXPORT_SYMBOL_GPL(zs_malloc);
+
+void zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	struct size_class *class;
+	struct zspage *zspage;
+	unsigned int idx;
+
+	if (unlikely(!handle))
+		return;
+
+	pin_tag(handle);
+	zspage = obj_to_location(handle_to_obj(handle), &idx);
+	class = zspage->class;
+
+	spin_lock(&class->lock);
+	if (obj_free(class, zspage, idx) == ZS_EMPTY)
+		free_zspage(pool, class, zspage);
+	spin_unlock(&class->lock);
+	unpin_tag(handle);
+
+	kmem_cache_free(zs_handle_cache, (void *)handle);
+}
+EXPORT_SYMBOL_GPL(zs_free);
+
+/**
+ * zs_map_object - get the address of an object
+ * @pool: pool the object was allocated from
+ * @handle: handle returned by zs_malloc()
+ * @mm: what the object will be used for until unmapped
+ *
+ * The mapping is atomic, like kmap_atomic(): nothing may sleep until
+ * zs_unmap_object(), and only one object can be mapped at a time. The
+ * object doesn't move meanwhile.
+ */
+void *zs_map_object(struct zs_pool *pool, unsigned long handle,
+		    enum zs_mapmode mm)
+{
+	struct size_class *class;
+	struct zspage *zspage;
+	struct zs_map_area *area;
+	unsigned long off;
+	unsigned int idx;
+
+	BUG_ON(!handle);
+
+	pin_tag(handle);
+	zspage = obj_to_location(handle_to_obj(handle), &idx);
+	class = zspage->class;
+	off = (unsigned long)idx * class->size;
+
+	area = &get_cpu_var(zs_map_area);
+	area->mm = mm;
+	if ((off & ~PAGE_MASK) + class->size <= PAGE_SIZE) {
+		area->kaddr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT],
+					  KM_USER1);
+		return area->kaddr + (off & ~PAGE_MASK) + ZS_HANDLE_SIZE;
+	}
+
+	/* the object straddles two pages, work on a copy */
+	area->kaddr = NULL;
+	if (mm != ZS_MM_WO)
+		obj_copy(class, zspage, idx, area->buf + ZS_HANDLE_SIZE,
+			 ZS_HANDLE_SIZE, false);
+	return area->buf + ZS_HANDLE_SIZE;
+}
+EXPORT_SYMBOL_GPL(zs_map_object);
+
+void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
+{
+	struct zs_map_area *area = &__get_cpu_var(zs_map_area);
+	struct zspage *zspage;
+	unsigned int idx;
+
+	if (area->kaddr) {
+		kunmap_atomic(area->kaddr, KM_USER1);
+	} else if (area->mm != ZS_MM_RO) {
+		zspage = obj_to_location(handle_to_obj(handle), &idx);
+		obj_copy(zspage->class, zspage, idx,
+			 area->buf + ZS_HANDLE_SIZE, ZS_HANDLE_SIZE, true);
+	}
+	put_cpu_var(zs_map_area);
+
+	unpin_tag(handle);
+}
+EXPORT_SYMBOL_GPL(zs_unmap_object);
+
+u64 zs_get_total_size_bytes(struct zs_pool *pool)
+{
+	return (u64)atomic_long_read(&pool->pages_allocated) << PAGE_SHIFT;
+}
+EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
+
+/* how many zspages of the class its objects would fit into fewer */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long obj_wasted = class->nr_zspages *
+		class->objs_per_zspage - class->objs_inuse;
+
+	return obj_wasted / class->objs_per_zspage;
+}
+
+/* the fullest zspage that isn't full */
+static struct zspage *zs_compact_dest(struct size_class *class)
+{
+	return find_get_zspage(class);
+}
+
+/*
+ * Move the objects of src elsewhere in its class, returns false if one
+ * couldn't be: it was pinned, or there was no room left. Called with
+ * class->lock held and src off the lists.
+ */
+static bool zs_migrate_zspage(struct size_class *class, struct zspage *src,
+			      char *buf)
+{
+	struct zspage *dst;
+	unsigned long head, handle;
+	unsigned int idx, new_idx;
+
+	for (idx = 0; src->inuse && idx < class->objs_per_zspage; idx++) {
+		head = obj_read_head(class, src, idx);
+		if (!(head & OBJ_ALLOCATED_TAG))
+			continue;
+		handle = head & ~OBJ_ALLOCATED_TAG;
+
+		dst = zs_compact_dest(class);
+		if (!dst)
+			return false;
+		/* mapped, or being freed */
+		if (!trypin_tag(handle))
+			return false;
+
+		obj_copy(class, src, idx, buf, 0, false);
+		new_idx = obj_malloc(class, dst, handle);
+		obj_copy(class, dst, new_idx, buf, 0, true);
+		record_obj(handle, location_to_obj(dst, new_idx));
+
+		/* src is off the lists and stays there */
+		obj_write_head(class, src, idx,
+			       (unsigned long)src->freeobj << OBJ_TAG_BITS);
+		src->freeobj = idx;
+		src->inuse--;
+		class->objs_inuse--;
+
+		unpin_tag(handle);
+	}
+
+	return true;
+}
+
+static unsigned long zs_compact_class(struct zs_pool *pool,
+				      struct size_class *class)
+{
+	struct list_head *list = &class->fullness_list[ZS_ALMOST_EMPTY];
+	unsigned long freed = 0;
+	struct zspage *src;
+	bool done;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class) && !list_empty(list)) {
+		/* the last one to drop below ZS_ALMOST_FULL, or a new one */
+		src = list_first_entry(list, struct zspage, list);
+		remove_zspage(src);
+
+		done = zs_migrate_zspage(class, src,
+					 __get_cpu_var(zs_map_area).buf);
+
+		if (!src->inuse) {
+			free_zspage(pool, class, src);
+			freed += class->pages_per_zspage;
+		} else {
+			insert_zspage(class, src);
+		}
+		if (!done)
+			break;
+
+		if (need_resched()) {
+			spin_unlock(&class->lock);
+			cond_resched();
+			spin_lock(&class->lock);
+		}
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/**
+ * zs_compact - move objects to free as many zspages as possible
+ * @pool: pool to compact
+ *
+ * Returns the number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	unsigned long freed = 0;
+	int i;
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--)
+		freed += zs_compact_class(pool, &pool->size_class[i]);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+static unsigned long zs_compactable_pages(struct zs_pool *pool)
+{
+	struct size_class *class;
+	unsigned long pages = 0;
+	int i;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->size_class[i];
+		spin_lock(&class->lock);
+		pages += zs_can_compact(class) * class->pages_per_zspage;
+		spin_unlock(&class->lock);
+	}
+
+	return pages;
+}
+
+static int zs_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+					    shrinker);
+
+	if (sc->nr_to_scan)
+		zs_compact(pool);
+
+	return min_t(unsigned long, zs_compactable_pages(pool), INT_MAX);
+}
+
+/**
+ * zs_create_pool - create an allocation pool
+ * @name: name of the pool
+ * @flags: allocation flags for the pages backing the pool, highmem is
+ *	fine
+ *
+ * Returns the pool, or NULL if there was no memory.
+ */
+struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
+{
+	struct zs_pool *pool;
+	int i, j;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		class->size = ZS_MIN_ALLOC_SIZE + i * ZS_SIZE_CLASS_DELTA;
+		class->index = i;
+		class->pages_per_zspage = get_pages_per_zspage(class->size);
+		class->objs_per_zspage = class->pages_per_zspage *
+					 PAGE_SIZE / class->size;
+		spin_lock_init(&class->lock);
+		for (j = 0; j < _ZS_NR_FULLNESS_GROUPS; j++)
+			INIT_LIST_HEAD(&class->fullness_list[j]);
+	}
+
+	pool->name = name;
+	pool->flags = flags;
+	atomic_long_set(&pool->pages_allocated, 0);
+
+	pool->shrinker.shrink = zs_shrink;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+
+	return pool;
+}
+EXPORT_SYMBOL_GPL(zs_create_pool);
+
+void zs_destroy_pool(struct zs_pool *pool)
+{
+	struct size_class *class;
+	struct zspage *zspage, *tmp;
+	unsigned long leaked = 0;
+	int i, j;
+
+	unregister_shrinker(&pool->shrinker);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->size_class[i];
+
+		for (j = 0; j < _ZS_NR_FULLNESS_GROUPS; j++) {
+			list_for_each_entry_safe(zspage, tmp,
+					&class->fullness_list[j], list) {
+				list_del(&zspage->list);
+				free_zspage(pool, class, zspage);
+				leaked++;
+			}
+		}
+	}
+	if (leaked)
+		pr_info("zsmalloc: %s: freed %lu non-empty zspages\n",
+			pool->name, leaked);
+
+	kfree(pool);
+}
+EXPORT_SYMBOL_GPL(zs_destroy_pool);
+
+static void zs_free_map_areas(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		kfree(per_cpu(zs_map_area, cpu).buf);
+		per_cpu(zs_map_area, cpu).buf = NULL;
+	}
+}
+
+static int __init zs_init(void)
+{
+	int cpu;
+
+	zs_handle_cache = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					    0, 0, NULL);
+	zs_zspage_cache = kmem_cache_create("zspage", sizeof(struct zspage),
+					    0, 0, NULL);
+	if (!zs_handle_cache || !zs_zspage_cache)
+		goto fail;
+
+	/* an object straddling pages is at most ZS_MAX_ALLOC_SIZE */
+	for_each_possible_cpu(cpu) {
+		per_cpu(zs_map_area, cpu).buf = kmalloc(ZS_MAX_ALLOC_SIZE,
+							GFP_KERNEL);
+		if (!per_cpu(zs_map_area, cpu).buf)
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	zs_free_map_areas();
+	if (zs_zspage_cache)
+		kmem_cache_destroy(zs_zspage_cache);
+	if (zs_handle_cache)
+		kmem_cache_destroy(zs_handle_cache);
+	return -ENOMEM;
+}
+
+static void __exit zs_exit(void)
+{
+	zs_free_map_areas();
+	kmem_cache_destroy(zs_zspage_cache);
+	kmem_cache_destroy(zs_handle_cache);
+}
+
+module_init(zs_init);
+module_exit(zs_exit);
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("Memory allocator for compressed pages");
@@ -0,0 +1,98 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZS_MALLOC_INT_H_
+#define _ZS_MALLOC_INT_H_
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/shrinker.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+/*
+ * A zspage is a chain of up to ZS_MAX_PAGES_PER_ZSPAGE 0-order pages cut
+ * into objects of a single size class, where objects may straddle page
+ * boundaries. The chain length is chosen per class to waste the least.
+ */
+#define ZS_MAX_PAGES_PER_ZSPAGE	4
+
+#define ZS_MIN_ALLOC_SIZE	32
+#define ZS_MAX_ALLOC_SIZE	PAGE_SIZE
+#define ZS_SIZE_CLASS_DELTA	16
+#define ZS_SIZE_CLASSES		((ZS_MAX_ALLOC_SIZE - ZS_MIN_ALLOC_SIZE) / \
+				 ZS_SIZE_CLASS_DELTA + 1)
+
+/*
+ * Every object starts with a word that holds its handle while it is
+ * allocated, tagged with OBJ_ALLOCATED_TAG, and the index of the next
+ * free object in the zspage otherwise. The handle is what compaction
+ * follows to update an object it moves.
+ */
+#define ZS_HANDLE_SIZE		(sizeof(unsigned long))
+#define OBJ_ALLOCATED_TAG	1UL
+#define OBJ_TAG_BITS		1
+
+/*
+ * A handle is the address of a word that holds the location of the
+ * object, the pfn of the first page of its zspage and its index there,
+ * shifted above HANDLE_PIN_BIT. The pin keeps the object in place while
+ * it is mapped or freed.
+ */
+#define HANDLE_PIN_BIT		0
+#define OBJ_INDEX_BITS		10
+#define OBJ_INDEX_MASK		((1UL << OBJ_INDEX_BITS) - 1)
+
+/*
+ * zspages are kept on a list per class by how full they are: allocation
+ * fills the fullest first and compaction empties the emptiest into them.
+ */
+enum fullness_group {
+	ZS_ALMOST_FULL,
+	ZS_ALMOST_EMPTY,
+	ZS_FULL,
+	_ZS_NR_FULLNESS_GROUPS,
+
+	ZS_EMPTY,
+};
+
+/* at most this part full counts as almost empty */
+#define ZS_ALMOST_FULL_NUM	3
+#define ZS_ALMOST_FULL_DEN	4
+
+struct size_class;
+
+struct zspage {
+	struct list_head list;
+	struct size_class *class;
+	unsigned int inuse;
+	unsigned int freeobj;	/* first free object, objs_per_zspage if none */
+	enum fullness_group fullness;
+	struct page *pages[ZS_MAX_PAGES_PER_ZSPAGE];
+};
+
+struct size_class {
+	spinlock_t lock;
+	int size;		/* object size, handle word included */
+	unsigned int index;
+	int pages_per_zspage;
+	unsigned int objs_per_zspage;
+
+	unsigned long nr_zspages;
+	unsigned long objs_inuse;
+	struct list_head fullness_list[_ZS_NR_FULLNESS_GROUPS];
+};
+
+struct zs_pool {
+	const char *name;
+	gfp_t flags;		/* for the pages of zspages */
+	atomic_long_t pages_allocated;
+	struct shrinker shrinker;
+
+	struct size_class size_class[ZS_SIZE_CLASSES];
+};
+
+#endif
@@ -38,6 +38,8 @@
 #include <linux/debugfs.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/pm_runtime.h>
 #include <linux/tegra_uart.h>
 
 #include <mach/dma.h>
@@ -52,6 +54,14 @@
 
 #define UART_RX_DMA_BUFFER_SIZE    (2048*8)
 
+/* the RX ring completes a DMA period, and gets drained, every this many
+ * bytes; the ring is UART_RX_DMA_BUFFER_SIZE */
+#define UART_RX_RING_PERIOD        1024
+
+/* how long the received byte rate is averaged over before rx switches
+ * between PIO and the DMA ring */
+#define TEGRA_UART_RX_SAMPLE_PERIOD	(HZ / 10)
+
 #define UART_LSR_FIFOE		0x80
 #define UART_LSR_TXFIFO_FULL	0x100
 #define UART_IER_EORD		0x20
@@ -65,6 +75,44 @@
 #define TX_FORCE_PIO 0
 #define RX_FORCE_PIO 0
 
+/*
+ * RX DMA runs as one cyclic ring that the APB DMA keeps filling, drained on
+ * every period and on the receive timeout, instead of a buffer that is
+ * dequeued and queued again on each of them. Bytes arriving meanwhile are
+ * not held up in the FIFO.
+ */
+static bool rx_dma_ring = true;
+module_param(rx_dma_ring, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_dma_ring, "Receive into a cyclic DMA ring (default: Y)");
+
+/*
+ * With the ring, rx moves to PIO when fewer than rx_dma_rate_low bytes/s
+ * arrive and back to DMA as soon as rx_dma_rate_high bytes/s are reached.
+ */
+static bool rx_dma_adaptive = true;
+module_param(rx_dma_adaptive, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_dma_adaptive,
+	"Switch rx between PIO and DMA by data rate (default: Y)");
+
+static unsigned int rx_dma_rate_low = 2000;
+module_param(rx_dma_rate_low, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_dma_rate_low, "Rx bytes/s below which PIO is used");
+
+static unsigned int rx_dma_rate_high = 10000;
+module_param(rx_dma_rate_high, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_dma_rate_high, "Rx bytes/s above which DMA is used");
+
+/*
+ * The receiver needs its clock, so the controller is runtime active from
+ * open to close. It only suspends when the port is closed or its owner
+ * switched the clock off with tegra_uart_request_clock_off(), and then
+ * after this delay so quick off/on pairs from a low power protocol share
+ * one clock-on period. Per port in power/autosuspend_delay_ms.
+ */
+static unsigned int autosuspend_ms = 20;
+module_param(autosuspend_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(autosuspend_ms, "Default runtime PM autosuspend delay");
+
 const int dma_req_sel[] = {
 	TEGRA_DMA_REQ_SEL_UARTA,
 	TEGRA_DMA_REQ_SEL_UARTB,
@@ -132,6 +180,29 @@ struct tegra_uart_port {
 	int			uart_state;
 	bool			rx_timeout;
 	int			rx_in_progress;
+
+	/* RX DMA ring, rx_dma was allocated in TEGRA_DMA_MODE_CYCLIC */
+	bool			rx_ring;
+	unsigned int		rx_ring_tail;	/* ring offset drained to */
+	unsigned int		rx_ring_overruns_seen;
+
+	/* received byte rate, for switching between PIO and DMA */
+	unsigned long		rx_sample_start;
+	__u32			rx_sample_rx;	/* icount.rx then */
+
+	/* received data goes here instead of the tty when set */
+	tegra_uart_rx_fn	rx_direct;
+	void			*rx_direct_data;
+
+	/* statistics */
+	unsigned int		rx_ring_overruns;
+	unsigned int		rx_tty_drops;
+	unsigned int		rx_to_dma;
+	unsigned int		rx_to_pio;
+	unsigned int		rx_direct_calls;
+	unsigned int		rx_direct_bytes;
+	unsigned int		rx_direct_max_us;
+	u64			rx_direct_total_us;
 };
 
 static void tegra_set_baudrate(struct tegra_uart_port *t, unsigned int baud);
@@ -290,6 +361,12 @@ static void tegra_start_tx(struct uart_port *u)
 
 static int tegra_start_dma_rx(struct tegra_uart_port *t)
 {
+	if (t->rx_ring) {
+		t->rx_ring_tail = 0;
+		t->rx_ring_overruns_seen = 0;
+		t->rx_dma_req.start_offset = 0;
+	}
+
 	wmb();
 	dma_sync_single_for_device(t->uport.dev, t->rx_dma_req.dest_addr,
 			t->rx_dma_req.size, DMA_TO_DEVICE);
@@ -313,6 +390,32 @@ static void tegra_rx_dma_threshold_callback(struct tegra_dma_req *req)
 	spin_unlock_irqrestore(&u->lock, flags);
 }
 
+/*
+ * Pass count received bytes at buf on, to the direct rx handler when one is
+ * set and to the tty otherwise. Returns how many were taken. Called with the
+ * port lock held.
+ */
+static int tegra_rx_deliver(struct tegra_uart_port *t, struct tty_struct *tty,
+	const unsigned char *buf, int count)
+{
+	ktime_t start;
+	unsigned int us;
+
+	if (!t->rx_direct)
+		return tty_insert_flip_string(tty, buf, count);
+
+	start = ktime_get();
+	t->rx_direct(t->rx_direct_data, buf, count);
+	us = ktime_us_delta(ktime_get(), start);
+
+	t->rx_direct_calls++;
+	t->rx_direct_bytes += count;
+	t->rx_direct_total_us += us;
+	if (us > t->rx_direct_max_us)
+		t->rx_direct_max_us = us;
+	return count;
+}
+
 /*
  * It is expected that the callers take the UART lock when this API is called.
  *
@@ -340,7 +443,7 @@ static void tegra_rx_dma_complete_callback(struct tegra_dma_req *req)
 		t->uport.icount.rx += req->bytes_transferred;
 		dma_sync_single_for_cpu(t->uport.dev, req->dest_addr,
 				req->size, DMA_FROM_DEVICE);
-		copied = tty_insert_flip_string(tty,
+		copied = tegra_rx_deliver(t, tty,
 			((unsigned char *)(req->virt_addr)),
 			req->bytes_transferred);
 		if (copied != req->bytes_transferred) {
@@ -364,12 +467,144 @@ static void tegra_rx_dma_complete_callback(struct tegra_dma_req *req)
 	spin_lock(&u->lock);
 }
 
+/*
+ * Pass what the DMA ring received since the last call, up to ring offset
+ * pos, on to the tty. The ring is coherent memory, no syncs are needed.
+ * Called with the port lock held.
+ */
+static void tegra_rx_ring_drain(struct tegra_uart_port *t, unsigned int pos)
+{
+	struct tegra_dma_req *req = &t->rx_dma_req;
+	struct tty_struct *tty = t->uport.state->port.tty;
+	unsigned int tail = t->rx_ring_tail;
+	unsigned int count;
+	int copied;
+
+	/* the hardware went over a pair again, what it held is gone and
+	 * the data before pos isn't contiguous any more */
+	if (req->overruns != t->rx_ring_overruns_seen) {
+		dev_err(t->uport.dev, "Rx DMA ring overrun\n");
+		t->rx_ring_overruns += req->overruns -
+			t->rx_ring_overruns_seen;
+		t->rx_ring_overruns_seen = req->overruns;
+		t->rx_ring_tail = pos;
+		return;
+	}
+
+	while (tail != pos) {
+		count = (pos > tail ? pos : req->size) - tail;
+		t->uport.icount.rx += count;
+		copied = tegra_rx_deliver(t, tty,
+			(unsigned char *)req->virt_addr + tail, count);
+		if (copied != count)
+			t->rx_tty_drops += count - copied;
+		tail += count;
+		if (tail == req->size)
+			tail = 0;
+	}
+	t->rx_ring_tail = tail;
+}
+
+/*
+ * Period callback of the ring, from the DMA ISR. When the ring is dequeued
+ * it comes with the port lock already held, to pass on the rest.
+ */
+static void tegra_rx_ring_callback(struct tegra_dma_req *req)
+{
+	struct tegra_uart_port *t = req->dev;
+	struct uart_port *u = &t->uport;
+	unsigned long flags;
+
+	if (req->status == -TEGRA_DMA_REQ_ERROR_ABORTED) {
+		tegra_rx_ring_drain(t, req->bytes_transferred);
+		do_handle_rx_pio(t);
+		return;
+	}
+
+	spin_lock_irqsave(&u->lock, flags);
+	tegra_rx_ring_drain(t, tegra_dma_get_transfer_count(t->rx_dma, req));
+	spin_unlock_irqrestore(&u->lock, flags);
+
+	tty_flip_buffer_push(u->state->port.tty);
+}
+
+/* Called with the port lock held */
+static void tegra_rx_switch(struct tegra_uart_port *t, bool dma)
+{
+	unsigned char ier = t->ier_shadow;
+
+	if (dma) {
+		t->fcr_shadow |= UART_FCR_DMA_SELECT;
+		uart_writeb(t, t->fcr_shadow, UART_FCR);
+		if (tegra_start_dma_rx(t)) {
+			t->fcr_shadow &= ~UART_FCR_DMA_SELECT;
+			uart_writeb(t, t->fcr_shadow, UART_FCR);
+			return;
+		}
+		t->rx_to_dma++;
+	} else {
+		tegra_dma_dequeue_req(t->rx_dma, &t->rx_dma_req);
+		t->fcr_shadow &= ~UART_FCR_DMA_SELECT;
+		uart_writeb(t, t->fcr_shadow, UART_FCR);
+		t->rx_to_pio++;
+	}
+	t->use_rx_dma = dma;
+
+	/* unless the ISR has them off while it handles them */
+	if (ier & (UART_IER_RDI | UART_IER_EORD)) {
+		ier &= ~(UART_IER_RDI | UART_IER_EORD);
+		ier |= dma ? UART_IER_EORD : UART_IER_RDI;
+		t->ier_shadow = ier;
+		uart_writeb(t, ier, UART_IER);
+	}
+
+	dev_dbg(t->uport.dev, "Rx switched to %s\n", dma ? "DMA" : "PIO");
+}
+
+/*
+ * Called with the port lock held once received data has been handled. A
+ * burst moves rx from PIO to the DMA ring right away, before the FIFO can
+ * overrun; falling back to PIO waits for a whole sample period.
+ */
+static void tegra_rx_sample(struct tegra_uart_port *t)
+{
+	unsigned long elapsed = jiffies - t->rx_sample_start;
+	unsigned long bytes = t->uport.icount.rx - t->rx_sample_rx;
+	unsigned long high;
+
+	if (!t->rx_ring || !rx_dma_adaptive)
+		return;
+
+	high = rx_dma_rate_high / (HZ / TEGRA_UART_RX_SAMPLE_PERIOD);
+	if (!t->use_rx_dma && bytes >= high)
+		tegra_rx_switch(t, true);
+	else if (elapsed < TEGRA_UART_RX_SAMPLE_PERIOD)
+		return;
+	else if (t->use_rx_dma && bytes * HZ / elapsed < rx_dma_rate_low)
+		tegra_rx_switch(t, false);
+
+	t->rx_sample_start = jiffies;
+	t->rx_sample_rx = t->uport.icount.rx;
+}
+
 /* Lock already taken */
 static void do_handle_rx_dma(struct tegra_uart_port *t)
 {
 	struct uart_port *u = &t->uport;
 	if (t->rts_active)
 		set_rts(t, false);
+	if (t->rx_ring) {
+		/* rx timeout, the DMA keeps running; what is short of a
+		 * DMA burst is still in the FIFO */
+		tegra_rx_ring_drain(t, tegra_dma_get_transfer_count(t->rx_dma,
+			&t->rx_dma_req));
+		do_handle_rx_pio(t);
+		tegra_rx_sample(t);
+		tty_flip_buffer_push(u->state->port.tty);
+		if (t->rts_active)
+			set_rts(t, true);
+		return;
+	}
 	tegra_dma_dequeue_req(t->rx_dma, &t->rx_dma_req);
 	tty_flip_buffer_push(u->state->port.tty);
 	/* enqueue the request again */
@@ -466,7 +701,8 @@ static char do_decode_rx_error(struct tegra_uart_port *t, u8 lsr)
 
 static void do_handle_rx_pio(struct tegra_uart_port *t)
 {
-	int count = 0;
+	unsigned char buf[32];
+	int count = 0, n = 0;
 	do {
 		char flag = TTY_NORMAL;
 		unsigned char lsr = 0;
@@ -482,10 +718,23 @@ static void do_handle_rx_pio(struct tegra_uart_port *t)
 		t->uport.icount.rx++;
 		count++;
 
+		/* the direct handler gets the FIFO in one go, errors and all */
+		if (t->rx_direct) {
+			buf[n++] = ch;
+			if (n == sizeof(buf)) {
+				tegra_rx_deliver(t, NULL, buf, n);
+				n = 0;
+			}
+			continue;
+		}
+
 		if (!uart_handle_sysrq_char(&t->uport, c))
 			uart_insert_char(&t->uport, lsr, UART_LSR_OE, ch, flag);
 	} while (1);
 
+	if (n)
+		tegra_rx_deliver(t, NULL, buf, n);
+
 	dev_dbg(t->uport.dev, "PIO received %d bytes\n", count);
 	return;
 }
@@ -570,8 +819,9 @@ static irqreturn_t tegra_uart_isr(int irq, void *data)
 
 				if (t->rx_in_progress) {
 					ier = t->ier_shadow;
-					ier |= (UART_IER_RLSI | UART_IER_RTOIE |
-								UART_IER_EORD);
+					ier |= UART_IER_RLSI | UART_IER_RTOIE;
+					ier |= t->use_rx_dma ? UART_IER_EORD :
+						UART_IER_RDI;
 					t->ier_shadow = ier;
 					uart_writeb(t, ier, UART_IER);
 				}
@@ -608,6 +858,7 @@ static irqreturn_t tegra_uart_isr(int irq, void *data)
 				}
 			} else {
 				do_handle_rx_pio(t);
+				tegra_rx_sample(t);
 
 				spin_unlock_irqrestore(&u->lock, flags);
 				tty_flip_buffer_push(u->state->port.tty);
@@ -653,7 +904,7 @@ static void tegra_start_rx(struct uart_port *u)
 		t->rx_in_progress = 1;
 
 		if (t->use_rx_dma && t->rx_dma)
-			tegra_dma_enqueue_req(t->rx_dma, &t->rx_dma_req);
+			tegra_start_dma_rx(t);
 
 		tty_flip_buffer_push(u->state->port.tty);
 	}
@@ -742,7 +993,8 @@ static void tegra_uart_hw_deinit(struct tegra_uart_port *t)
 
 	spin_unlock_irqrestore(&t->uport.lock, flags);
 
-	clk_disable(t->clk);
+	pm_runtime_mark_last_busy(t->uport.dev);
+	pm_runtime_put_autosuspend(t->uport.dev);
 }
 
 static void tegra_uart_free_rx_dma_buffer(struct tegra_uart_port *t)
@@ -756,7 +1008,7 @@ static void tegra_uart_free_rx_dma_buffer(struct tegra_uart_port *t)
 
 static void tegra_uart_free_rx_dma(struct tegra_uart_port *t)
 {
-	if (!t->use_rx_dma)
+	if (!t->rx_dma)
 		return;
 
 	tegra_dma_free_channel(t->rx_dma);
@@ -777,7 +1029,7 @@ static int tegra_uart_hw_init(struct tegra_uart_port *t)
 	t->ier_shadow = 0;
 	t->baud = 0;
 
-	clk_enable(t->clk);
+	pm_runtime_get_sync(t->uport.dev);
 
 	/* Reset the UART controller to clear all previous status.*/
 	tegra_periph_reset_assert(t->clk);
@@ -909,13 +1161,28 @@ static int tegra_uart_init_rx_dma_buffer(struct tegra_uart_port *t)
 
 static int tegra_uart_init_rx_dma(struct tegra_uart_port *t)
 {
-	t->rx_dma = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CONTINUOUS,
+	t->rx_ring = rx_dma_ring;
+	t->rx_dma = tegra_dma_allocate_channel(t->rx_ring ?
+					TEGRA_DMA_MODE_CYCLIC :
+					TEGRA_DMA_MODE_CONTINUOUS,
 					"uart_rx_%d", t->uport.line);
 	if (!t->rx_dma) {
 		dev_err(t->uport.dev, "%s: failed to allocate RX DMA.\n",
 				__func__);
 		return -ENODEV;
 	}
+
+	if (t->rx_ring) {
+		t->rx_dma_req.complete = tegra_rx_ring_callback;
+		t->rx_dma_req.threshold = NULL;
+		t->rx_dma_req.period_size = UART_RX_RING_PERIOD;
+	} else {
+		t->rx_dma_req.complete = tegra_rx_dma_complete_callback;
+		t->rx_dma_req.threshold = tegra_rx_dma_threshold_callback;
+	}
+	t->rx_sample_start = jiffies;
+	t->rx_sample_rx = t->uport.icount.rx;
+
 	return 0;
 }
 
@@ -1070,8 +1337,23 @@ static void set_dtr(struct tegra_uart_port *t, bool active)
 	return;
 }
 
+static void set_loop(struct tegra_uart_port *t, bool active)
+{
+	unsigned char mcr;
+	mcr = t->mcr_shadow;
+	if (active)
+		mcr |= UART_MCR_LOOP;
+	else
+		mcr &= ~UART_MCR_LOOP;
+	if (mcr != t->mcr_shadow) {
+		uart_writeb(t, mcr, UART_MCR);
+		t->mcr_shadow = mcr;
+	}
+}
+
 static void tegra_set_mctrl(struct uart_port *u, unsigned int mctrl)
 {
+	struct tegra_uart_platform_data *pdata;
 	unsigned char mcr;
 	struct tegra_uart_port *t;
 
@@ -1091,6 +1373,10 @@ static void tegra_set_mctrl(struct uart_port *u, unsigned int mctrl)
 		set_dtr(t, true);
 	else
 		set_dtr(t, false);
+
+	/* boards with is_loopback keep it on whatever is asked for */
+	pdata = u->dev->platform_data;
+	set_loop(t, (mctrl & TIOCM_LOOP) || (pdata && pdata->is_loopback));
 	return;
 }
 
@@ -1493,6 +1779,26 @@ static struct uart_driver tegra_uart_driver = {
 	.nr		= 5,
 };
 
+static ssize_t rx_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_uart_port *t = dev_get_drvdata(dev);
+	u64 avg_us = t->rx_direct_total_us;
+
+	if (t->rx_direct_calls)
+		do_div(avg_us, t->rx_direct_calls);
+	return sprintf(buf, "mode: %s, overrun: %u, ring_overrun: %u, "
+		"tty_drop: %u, to_dma: %u, to_pio: %u, direct: %s, "
+		"direct_calls: %u, direct_bytes: %u, direct_avg_us: %llu, "
+		"direct_max_us: %u\n",
+		!t->use_rx_dma ? "pio" : t->rx_ring ? "dma ring" : "dma",
+		t->uport.icount.overrun, t->rx_ring_overruns,
+		t->rx_tty_drops, t->rx_to_dma, t->rx_to_pio,
+		t->rx_direct ? "on" : "off", t->rx_direct_calls,
+		t->rx_direct_bytes, avg_us, t->rx_direct_max_us);
+}
+static DEVICE_ATTR(rx_stats, S_IRUGO, rx_stats_show, NULL);
+
 static int __init tegra_uart_probe(struct platform_device *pdev)
 {
 	struct tegra_uart_port *t;
@@ -1562,6 +1868,14 @@ static int __init tegra_uart_probe(struct platform_device *pdev)
 		goto fail;
 	}
 
+	/* clock requests come from atomic context, see request_clock_on */
+	pm_runtime_irq_safe(&pdev->dev);
+	pm_runtime_set_autosuspend_delay(&pdev->dev, autosuspend_ms);
+	pm_runtime_use_autosuspend(&pdev->dev);
+	pm_runtime_enable(&pdev->dev);
+	if (!pm_runtime_enabled(&pdev->dev))
+		clk_enable(t->clk);
+
 	ret = uart_add_one_port(&tegra_uart_driver, u);
 	if (ret) {
 		pr_err("%s: Failed(%d) to add uart port %s%d\n",
@@ -1583,11 +1897,19 @@ static int __init tegra_uart_probe(struct platform_device *pdev)
 			goto rx_dma_buff_fail;
 		}
 	}
+
+	if (device_create_file(&pdev->dev, &dev_attr_rx_stats))
+		dev_warn(&pdev->dev, "Couldn't create rx_stats\n");
+
 	return ret;
 
 rx_dma_buff_fail:
 	uart_remove_one_port(&tegra_uart_driver, u);
 fail:
+	if (pm_runtime_enabled(&pdev->dev))
+		pm_runtime_disable(&pdev->dev);
+	else if (!IS_ERR_OR_NULL(t->clk))
+		clk_disable(t->clk);
 	if (t->clk)
 		clk_put(t->clk);
 	platform_set_drvdata(pdev, NULL);
@@ -1607,10 +1929,16 @@ static int __devexit tegra_uart_remove(struct platform_device *pdev)
 		t->irda_remove();
 
 	u = &t->uport;
+	device_remove_file(&pdev->dev, &dev_attr_rx_stats);
 	uart_remove_one_port(&tegra_uart_driver, u);
 
 	tegra_uart_free_rx_dma_buffer(t);
 
+	if (!pm_runtime_enabled(&pdev->dev))
+		clk_disable(t->clk);
+	pm_runtime_disable(&pdev->dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+
 	platform_set_drvdata(pdev, NULL);
 
 	pr_info("Unregistered UART port %s%d\n",
@@ -1619,8 +1947,9 @@ static int __devexit tegra_uart_remove(struct platform_device *pdev)
 	return 0;
 }
 
-static int tegra_uart_suspend(struct platform_device *pdev, pm_message_t state)
+static int tegra_uart_suspend(struct device *dev)
 {
+	struct platform_device *pdev = to_platform_device(dev);
 	struct tegra_uart_port *t = platform_get_drvdata(pdev);
 	struct uart_port *u;
 
@@ -1633,18 +1962,23 @@ static int tegra_uart_suspend(struct platform_device *pdev, pm_message_t state)
 	/* enable clock before calling suspend so that controller
 	   register can be accessible */
 	if (t->uart_state == TEGRA_UART_CLOCK_OFF) {
-		clk_enable(t->clk);
+		pm_runtime_get_sync(t->uport.dev);
 		t->uart_state = TEGRA_UART_OPENED;
 	}
 
 	uart_suspend_port(&tegra_uart_driver, u);
 	t->uart_state = TEGRA_UART_SUSPEND;
 
+	/* the PM core holds off runtime PM, drop an autosuspend pending */
+	if (!pm_runtime_status_suspended(dev))
+		clk_disable(t->clk);
+
 	return 0;
 }
 
-static int tegra_uart_resume(struct platform_device *pdev)
+static int tegra_uart_resume(struct device *dev)
 {
+	struct platform_device *pdev = to_platform_device(dev);
 	struct tegra_uart_port *t = platform_get_drvdata(pdev);
 	struct uart_port *u;
 
@@ -1654,6 +1988,9 @@ static int tegra_uart_resume(struct platform_device *pdev)
 	u = &t->uport;
 	dev_dbg(t->uport.dev, "tegra_uart_resume called\n");
 
+	if (!pm_runtime_status_suspended(dev))
+		clk_enable(t->clk);
+
 	if (t->uart_state == TEGRA_UART_SUSPEND)
 		uart_resume_port(&tegra_uart_driver, u);
 	return 0;
@@ -1679,8 +2016,10 @@ void tegra_uart_request_clock_off(struct uart_port *uport)
 	}
 	spin_unlock_irqrestore(&uport->lock, flags);
 
-	if (is_clk_disable)
-		clk_disable(t->clk);
+	if (is_clk_disable) {
+		pm_runtime_mark_last_busy(uport->dev);
+		pm_runtime_put_autosuspend(uport->dev);
+	}
 
 	return;
 }
@@ -1704,7 +2043,7 @@ void tegra_uart_request_clock_on(struct uart_port *uport)
 	spin_unlock_irqrestore(&uport->lock, flags);
 
 	if (is_clk_enable)
-		clk_enable(t->clk);
+		pm_runtime_get_sync(uport->dev);
 
 	return;
 }
@@ -1748,13 +2087,63 @@ int tegra_uart_is_tx_empty(struct uart_port *uport)
 	return tegra_tx_empty(uport);
 }
 
+/*
+ * Have everything received on the Tegra UART behind tty handed to fn,
+ * straight from the DMA ring or the FIFO, instead of going through the flip
+ * buffers and the line discipline; fn NULL goes back to the tty. fn runs
+ * in interrupt context with the port lock held, so it must not write to
+ * the port. Returns -ENODEV when tty isn't one of ours.
+ */
+int tegra_uart_set_rx_handler(struct tty_struct *tty, tegra_uart_rx_fn fn,
+	void *data)
+{
+	struct uart_state *state = tty->driver_data;
+	struct tegra_uart_port *t;
+	unsigned long flags;
+
+	if (tty->driver != tegra_uart_driver.tty_driver || !state)
+		return -ENODEV;
+
+	t = container_of(state->uart_port, struct tegra_uart_port, uport);
+	spin_lock_irqsave(&t->uport.lock, flags);
+	t->rx_direct = fn;
+	t->rx_direct_data = fn ? data : NULL;
+	spin_unlock_irqrestore(&t->uport.lock, flags);
+
+	dev_dbg(t->uport.dev, "Rx %s\n", fn ? "direct" : "to tty");
+	return 0;
+}
+EXPORT_SYMBOL_GPL(tegra_uart_set_rx_handler);
+
+#ifdef CONFIG_PM_RUNTIME
+static int tegra_uart_runtime_suspend(struct device *dev)
+{
+	struct tegra_uart_port *t = dev_get_drvdata(dev);
+
+	clk_disable(t->clk);
+	return 0;
+}
+
+static int tegra_uart_runtime_resume(struct device *dev)
+{
+	struct tegra_uart_port *t = dev_get_drvdata(dev);
+
+	return clk_enable(t->clk);
+}
+#endif
+
+static const struct dev_pm_ops tegra_uart_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(tegra_uart_suspend, tegra_uart_resume)
+	SET_RUNTIME_PM_OPS(tegra_uart_runtime_suspend,
+			   tegra_uart_runtime_resume, NULL)
+};
+
 static struct platform_driver tegra_uart_platform_driver __refdata= {
 	.probe		= tegra_uart_probe,
 	.remove		= __devexit_p(tegra_uart_remove),
-	.suspend	= tegra_uart_suspend,
-	.resume		= tegra_uart_resume,
 	.driver		= {
-		.name	= "tegra_uart"
+		.name	= "tegra_uart",
+		.pm	= &tegra_uart_pm_ops,
 	}
 };
 
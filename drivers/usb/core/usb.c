@@ -704,6 +704,58 @@ void usb_free_coherent(struct usb_device *dev, size_t size, void *addr,
 }
 EXPORT_SYMBOL_GPL(usb_free_coherent);
 
+static bool usb_aligned_use_pages(struct usb_device *dev, size_t size)
+{
+	return size >= PAGE_SIZE || dev->bus->dma_align > ARCH_KMALLOC_MINALIGN;
+}
+
+/**
+ * usb_alloc_aligned - allocate a transfer buffer that is never bounced
+ * @dev: device the buffer will be used with
+ * @size: requested buffer size
+ * @mem_flags: affect whether allocation may block
+ *
+ * Return value is either null (indicating no buffer could be allocated), or
+ * a normal, cached buffer that satisfies the DMA alignment of the host
+ * controller, so that it can be used as transfer_buffer without the HCD
+ * copying it through a bounce buffer.  Buffers of a page or more are page
+ * aligned.
+ *
+ * Unlike usb_alloc_coherent() the buffer is mapped for every URB, use it
+ * for bulk data the CPU also reads or writes a lot.  Free it with
+ * usb_free_aligned(), not with kfree() or URB_FREE_BUFFER.
+ */
+void *usb_alloc_aligned(struct usb_device *dev, size_t size, gfp_t mem_flags)
+{
+	if (!dev || !dev->bus)
+		return NULL;
+	if (usb_aligned_use_pages(dev, size))
+		return alloc_pages_exact(size, mem_flags);
+	return kmalloc(size, mem_flags);
+}
+EXPORT_SYMBOL_GPL(usb_alloc_aligned);
+
+/**
+ * usb_free_aligned - free memory allocated with usb_alloc_aligned()
+ * @dev: device the buffer was used with
+ * @size: requested buffer size
+ * @addr: CPU address of buffer
+ *
+ * The parameters must match those provided in the allocation request.
+ */
+void usb_free_aligned(struct usb_device *dev, size_t size, void *addr)
+{
+	if (!dev || !dev->bus)
+		return;
+	if (!addr)
+		return;
+	if (usb_aligned_use_pages(dev, size))
+		free_pages_exact(addr, size);
+	else
+		kfree(addr);
+}
+EXPORT_SYMBOL_GPL(usb_free_aligned);
+
 /**
  * usb_buffer_map - create DMA mapping(s) for an urb
  * @urb: urb whose transfer_buffer/setup_packet will be mapped
@@ -29,6 +29,10 @@
 
 #include <linux/blkdev.h>
 #include <linux/pagemap.h>
+#include <linux/aio.h>
+#include <linux/uio.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
 #include <asm/unaligned.h>
 
 #include <linux/usb/composite.h>
@@ -743,6 +747,127 @@ static const struct file_operations ffs_ep0_operations = {
 
 /* "Normal" endpoints operations ********************************************/
 
+/*
+ * Transfers of at least FFS_ZC_MIN bytes from a single user buffer are
+ * done straight from/to the caller's pages when the controller can
+ * take a scatterlist, instead of going through a kernel bounce buffer.
+ */
+#define FFS_ZC_MIN	(4 * PAGE_SIZE)
+#define FFS_ZC_MAX	(256 * PAGE_SIZE)
+
+struct ffs_io_data {
+	struct kiocb			*kiocb;	/* NULL for read(2)/write(2) */
+	struct ffs_epfile		*epfile;
+	struct usb_ep			*ep;
+	struct usb_request		*req;	/* P: ffs->eps_lock */
+
+	int				read;
+	const struct iovec		*iov;
+	unsigned long			nr_segs;
+	size_t				len;
+
+	/* either a bounce buffer ... */
+	char				*buf;
+	/* ... or the pinned user pages */
+	struct page			**pages;
+	struct scatterlist		*sg;
+	unsigned			nr_pages;
+
+	unsigned			actual;
+	int				status;
+};
+
+static int ffs_io_pin(struct ffs_io_data *io, unsigned long addr)
+{
+	unsigned off = addr & ~PAGE_MASK;
+	unsigned n = (off + io->len + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	size_t left = io->len;
+	unsigned i;
+	int got;
+
+	io->pages = kmalloc(n * (sizeof *io->pages + sizeof *io->sg),
+			    GFP_KERNEL);
+	if (unlikely(!io->pages))
+		return -ENOMEM;
+	io->sg = (struct scatterlist *)(io->pages + n);
+
+	/* the device writes into the pages on reads */
+	got = get_user_pages_fast(addr & PAGE_MASK, n, io->read, io->pages);
+	if (unlikely(got < (int)n)) {
+		while (got > 0)
+			put_page(io->pages[--got]);
+		kfree(io->pages);
+		io->pages = NULL;
+		return -EFAULT;
+	}
+
+	sg_init_table(io->sg, n);
+	for (i = 0; i < n; i++) {
+		unsigned len = min_t(size_t, left, PAGE_SIZE - off);
+		sg_set_page(&io->sg[i], io->pages[i], len, off);
+		left -= len;
+		off = 0;
+	}
+	io->nr_pages = n;
+
+	return 0;
+}
+
+static void ffs_io_release(struct ffs_io_data *io, bool dirty)
+{
+	unsigned i;
+
+	for (i = 0; i < io->nr_pages; i++) {
+		if (dirty)
+			set_page_dirty_lock(io->pages[i]);
+		put_page(io->pages[i]);
+	}
+	kfree(io->pages);
+	kfree(io->buf);
+	io->pages = NULL;
+	io->nr_pages = 0;
+	io->buf = NULL;
+}
+
+/* Pin the user buffer or fill a bounce buffer for io->len bytes. */
+static int ffs_io_setup(struct ffs_io_data *io)
+{
+	struct usb_gadget *gadget = io->epfile->ffs->gadget;
+	const struct iovec *iov = io->iov;
+	size_t done = 0;
+	unsigned long i;
+
+	if (io->nr_segs == 1 && gadget && gadget->sg_supported &&
+	    io->len >= FFS_ZC_MIN && io->len <= FFS_ZC_MAX &&
+	    !ffs_io_pin(io, (unsigned long)iov->iov_base))
+		return 0;
+
+	io->buf = kzalloc(io->len, GFP_KERNEL);
+	if (unlikely(!io->buf))
+		return -ENOMEM;
+	if (io->read)
+		return 0;
+
+	for (i = 0; i < io->nr_segs; i++) {
+		if (unlikely(copy_from_user(io->buf + done, iov[i].iov_base,
+					    iov[i].iov_len))) {
+			ffs_io_release(io, false);
+			return -EFAULT;
+		}
+		done += iov[i].iov_len;
+	}
+
+	return 0;
+}
+
+static void ffs_io_prepare_req(struct ffs_io_data *io, struct usb_request *req)
+{
+	req->buf     = io->buf;
+	req->sg      = io->sg;
+	req->num_sgs = io->nr_pages;
+	req->length  = io->len;
+}
+
 static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 {
 	ENTER();
@@ -757,8 +882,15 @@ static ssize_t ffs_epfile_io(struct file *file,
 			     char __user *buf, size_t len, int read)
 {
 	struct ffs_epfile *epfile = file->private_data;
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct ffs_io_data io = {
+		.epfile  = epfile,
+		.read    = read,
+		.iov     = &iov,
+		.nr_segs = 1,
+		.len     = len,
+	};
 	struct ffs_ep *ep;
-	char *data = NULL;
 	ssize_t ret;
 	int halt;
 
@@ -796,17 +928,11 @@ first_try:
 			goto error;
 		}
 
-		/* Allocate & copy */
-		if (!halt && !data) {
-			data = kzalloc(len, GFP_KERNEL);
-			if (unlikely(!data))
-				return -ENOMEM;
-
-			if (!read &&
-			    unlikely(__copy_from_user(data, buf, len))) {
-				ret = -EFAULT;
-				goto error;
-			}
+		/* Pin or allocate & copy */
+		if (!halt && !io.buf && !io.pages) {
+			ret = ffs_io_setup(&io);
+			if (unlikely(ret))
+				return ret;
 		}
 
 		/* We will be using request */
@@ -840,8 +966,7 @@ first_try:
 		struct usb_request *req = ep->req;
 		req->context  = &done;
 		req->complete = ffs_epfile_io_complete;
-		req->buf      = data;
-		req->length   = len;
+		ffs_io_prepare_req(&io, req);
 
 		ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
 
@@ -854,18 +979,185 @@ first_try:
 			usb_ep_dequeue(ep->ep, req);
 		} else {
 			ret = ep->status;
-			if (read && ret > 0 &&
-			    unlikely(copy_to_user(buf, data, ret)))
+			if (read && ret > 0 && io.buf &&
+			    unlikely(copy_to_user(buf, io.buf, ret)))
 				ret = -EFAULT;
 		}
+		req->sg = NULL;
+		req->num_sgs = 0;
 	}
 
 	mutex_unlock(&epfile->mutex);
 error:
-	kfree(data);
+	ffs_io_release(&io, read && ret > 0);
 	return ret;
 }
 
+/*
+ * Asynchronous I/O.  Each kiocb gets its own request so a daemon can keep
+ * several transfers queued on an endpoint; the shared ep->req and the
+ * epfile mutex are only used by read(2) and write(2).
+ */
+
+static int ffs_aio_cancel(struct kiocb *kiocb, struct io_event *e)
+{
+	struct ffs_io_data *io = kiocb->private;
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	int value;
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	if (likely(io && io->req))
+		value = usb_ep_dequeue(io->ep, io->req);
+	else
+		value = -EINVAL;
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	aio_put_req(kiocb);
+	return value;
+}
+
+static ssize_t ffs_epfile_aio_read_retry(struct kiocb *kiocb)
+{
+	struct ffs_io_data *io = kiocb->private;
+	ssize_t total = io->actual, len = 0;
+	char *to_copy = io->buf;
+	unsigned long i;
+
+	/* we are back in the submitter's mm now */
+	for (i = 0; to_copy && i < io->nr_segs && total; i++) {
+		ssize_t this = min_t(ssize_t, io->iov[i].iov_len, total);
+
+		if (copy_to_user(io->iov[i].iov_base, to_copy, this)) {
+			if (len == 0)
+				len = -EFAULT;
+			break;
+		}
+		total -= this;
+		len += this;
+		to_copy += this;
+	}
+	if (!to_copy)
+		len = io->actual;
+
+	ffs_io_release(io, true);
+	kiocb->private = NULL;
+	kfree(io);
+	return len;
+}
+
+static void ffs_epfile_async_io_complete(struct usb_ep *_ep,
+					 struct usb_request *req)
+{
+	struct ffs_io_data *io = req->context;
+	struct kiocb *kiocb = io->kiocb;
+
+	ENTER();
+
+	io->req = NULL;
+	io->status = req->status;
+	io->actual = req->actual;
+	usb_ep_free_request(_ep, req);
+
+	/* copying out or dirtying the pages needs process context */
+	if (io->read && io->actual && !kiocbIsCancelled(kiocb)) {
+		kick_iocb(kiocb);
+		return;
+	}
+
+	ffs_io_release(io, false);
+	kiocb->private = NULL;
+	aio_complete(kiocb, io->actual ? io->actual : io->status, io->status);
+	kfree(io);
+}
+
+static ssize_t ffs_epfile_aio_io(struct kiocb *kiocb, const struct iovec *iov,
+				 unsigned long nr_segs, int read)
+{
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct usb_request *req;
+	struct ffs_io_data *io;
+	struct ffs_ep *ep;
+	ssize_t ret;
+
+	ENTER();
+
+	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE))
+		return -ENODEV;
+
+	io = kzalloc(sizeof *io, GFP_KERNEL);
+	if (unlikely(!io))
+		return -ENOMEM;
+	io->kiocb   = kiocb;
+	io->epfile  = epfile;
+	io->read    = read;
+	io->iov     = iov;
+	io->nr_segs = nr_segs;
+	io->len     = iov_length(iov, nr_segs);
+
+	ret = ffs_io_setup(io);
+	if (unlikely(ret))
+		goto error;
+
+	kiocb->private = io;
+	if (read)
+		kiocb->ki_retry = ffs_epfile_aio_read_retry;
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	ep = epfile->ep;
+	if (!ep) {
+		ret = -EAGAIN;
+	} else if (!read == !epfile->in) {
+		/* no halting from aio, the direction is simply wrong */
+		ret = -EINVAL;
+	} else {
+		req = usb_ep_alloc_request(ep->ep, GFP_ATOMIC);
+		if (likely(req)) {
+			io->ep  = ep->ep;
+			io->req = req;
+			req->context  = io;
+			req->complete = ffs_epfile_async_io_complete;
+			ffs_io_prepare_req(io, req);
+			kiocb->ki_cancel = ffs_aio_cancel;
+			ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
+			if (unlikely(ret)) {
+				kiocb->ki_cancel = NULL;
+				io->req = NULL;
+				usb_ep_free_request(ep->ep, req);
+			}
+		} else {
+			ret = -ENOMEM;
+		}
+	}
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	if (likely(!ret))
+		return read ? -EIOCBRETRY : -EIOCBQUEUED;
+
+	kiocb->private = NULL;
+	ffs_io_release(io, false);
+error:
+	kfree(io);
+	return ret;
+}
+
+static ssize_t ffs_epfile_aio_write(struct kiocb *kiocb,
+				    const struct iovec *iov,
+				    unsigned long nr_segs, loff_t pos)
+{
+	ENTER();
+
+	return ffs_epfile_aio_io(kiocb, iov, nr_segs, 0);
+}
+
+static ssize_t ffs_epfile_aio_read(struct kiocb *kiocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	ENTER();
+
+	return ffs_epfile_aio_io(kiocb, iov, nr_segs, 1);
+}
+
 static ssize_t
 ffs_epfile_write(struct file *file, const char __user *buf, size_t len,
 		 loff_t *ptr)
@@ -956,6 +1248,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.open =		ffs_epfile_open,
 	.write =	ffs_epfile_write,
 	.read =		ffs_epfile_read,
+	.aio_write =	ffs_epfile_aio_write,
+	.aio_read =	ffs_epfile_aio_read,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
@@ -28,6 +28,7 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/pagemap.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
@@ -49,8 +50,11 @@
 #define STATE_CANCELED              3   /* transaction canceled by host */
 #define STATE_ERROR                 4   /* error from completion routine */
 
+/* file data a zero copy tx request points at, in page cache pages */
+#define MTP_ZC_PAGES               16
+
 /* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
+#define MTP_TX_REQ_MAX 8
 #define RX_REQ_MAX 2
 #define INTR_REQ_MAX 5
 
@@ -69,6 +73,17 @@
 
 static const char mtp_shortname[] = "mtp_usb";
 
+/*
+ * With a controller that takes scatterlists, send_file_work hands the page
+ * cache pages of the file to the tx requests instead of copying them into
+ * req->buf; these hold the pages until the request completes.
+ */
+struct mtp_tx_pages {
+	struct scatterlist sg[MTP_ZC_PAGES];
+	struct page *pages[MTP_ZC_PAGES];
+	int nr_pages;
+};
+
 struct mtp_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -345,6 +360,20 @@ static struct usb_request
 	return req;
 }
 
+/* drop the page cache pages a zero copy request was sent from */
+static void mtp_release_pages(struct usb_request *req)
+{
+	struct mtp_tx_pages *tx = req->context;
+
+	if (!tx)
+		return;
+
+	while (tx->nr_pages)
+		page_cache_release(tx->pages[--tx->nr_pages]);
+	req->sg = NULL;
+	req->num_sgs = 0;
+}
+
 static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
@@ -352,6 +381,8 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
+	mtp_release_pages(req);
+
 	mtp_req_put(dev, &dev->tx_idle, req);
 
 	wake_up(&dev->write_wq);
@@ -429,12 +460,18 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
+	for (i = 0; i < MTP_TX_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
 		if (!req)
 			goto fail;
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
+		if (cdev->gadget->sg_supported) {
+			req->context = kzalloc(sizeof(struct mtp_tx_pages),
+					GFP_KERNEL);
+			if (!req->context)
+				goto fail;
+		}
 	}
 	for (i = 0; i < RX_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
@@ -627,6 +664,75 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/*
+ * Point req at the page cache pages holding up to count bytes of filp from
+ * *offset on, reading them in where needed, and return the number of bytes
+ * covered. Each transfer but the last has to end on a packet boundary, so
+ * only whole packets are taken unless the rest of the file fits. The pages
+ * are released again once the request completes.
+ */
+static int mtp_get_file_pages(struct mtp_dev *dev, struct file *filp,
+		struct usb_request *req, loff_t *offset, int64_t count)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct mtp_tx_pages *tx = req->context;
+	unsigned maxpacket = dev->ep_in->maxpacket;
+	unsigned poff = *offset & ~PAGE_CACHE_MASK;
+	pgoff_t index = *offset >> PAGE_CACHE_SHIFT;
+	unsigned long nr_pages;
+	loff_t isize = i_size_read(mapping->host);
+	struct page *page;
+	int64_t avail;
+	unsigned len, total = 0;
+
+	avail = min_t(int64_t, count, isize - *offset);
+	if (avail <= 0)
+		return 0;
+	if (avail > MTP_ZC_PAGES * PAGE_CACHE_SIZE - poff)
+		avail = MTP_ZC_PAGES * PAGE_CACHE_SIZE - poff;
+	if (avail < count)
+		avail -= (unsigned)avail % maxpacket;
+	if (!avail)
+		return 0;
+
+	nr_pages = (poff + avail + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	sg_init_table(tx->sg, nr_pages);
+
+	while (total < avail) {
+		page = find_get_page(mapping, index);
+		if (!page) {
+			page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					index, nr_pages - tx->nr_pages);
+			page = find_get_page(mapping, index);
+		}
+		if (page && PageReadahead(page))
+			page_cache_async_readahead(mapping, &filp->f_ra, filp,
+					page, index, nr_pages - tx->nr_pages);
+		if (!page || !PageUptodate(page)) {
+			if (page)
+				page_cache_release(page);
+			page = read_mapping_page(mapping, index, filp);
+			if (IS_ERR(page)) {
+				mtp_release_pages(req);
+				return PTR_ERR(page);
+			}
+		}
+
+		len = min_t(int64_t, avail - total, PAGE_CACHE_SIZE - poff);
+		sg_set_page(&tx->sg[tx->nr_pages], page, len, poff);
+		tx->pages[tx->nr_pages++] = page;
+		total += len;
+		poff = 0;
+		index++;
+	}
+
+	req->sg = tx->sg;
+	req->num_sgs = tx->nr_pages;
+	*offset += total;
+
+	return total;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data) {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, send_file_work);
@@ -639,6 +745,7 @@ static void send_file_work(struct work_struct *data) {
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	bool zero_copy;
 
 	/* read our parameters */
 	smp_rmb();
@@ -646,6 +753,9 @@ static void send_file_work(struct work_struct *data) {
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
 
+	zero_copy = cdev->gadget->sg_supported &&
+		filp->f_mapping->a_ops->readpage;
+
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
 	if (dev->xfer_send_header) {
@@ -681,6 +791,19 @@ static void send_file_work(struct work_struct *data) {
 			break;
 		}
 
+		/* the header, if any, goes out from the request's own buffer */
+		xfer = 0;
+		if (zero_copy && !hdr_size && count) {
+			xfer = mtp_get_file_pages(dev, filp, req, &offset,
+					count);
+			if (xfer < 0) {
+				r = xfer;
+				break;
+			}
+		}
+		if (xfer)
+			goto queue;
+
 		if (count > MTP_BULK_BUFFER_SIZE)
 			xfer = MTP_BULK_BUFFER_SIZE;
 		else
@@ -703,10 +826,12 @@ static void send_file_work(struct work_struct *data) {
 		xfer = ret + hdr_size;
 		hdr_size = 0;
 
+queue:
 		req->length = xfer;
 		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
 		if (ret < 0) {
 			DBG(cdev, "send_file_work: xfer error %d\n", ret);
+			mtp_release_pages(req);
 			dev->state = STATE_ERROR;
 			r = -EIO;
 			break;
@@ -1115,8 +1240,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	struct usb_request *req;
 	int i;
 
-	while ((req = mtp_req_get(dev, &dev->tx_idle)))
+	while ((req = mtp_req_get(dev, &dev->tx_idle))) {
+		kfree(req->context);
 		mtp_request_free(req, dev->ep_in);
+	}
 	for (i = 0; i < RX_REQ_MAX; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
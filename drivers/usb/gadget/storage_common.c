@@ -262,8 +262,15 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
-/* Number of buffers we will use.  2 is enough for double-buffering */
+/*
+ * Number of buffers we will use.  2 is enough for double-buffering, more
+ * keep the controller busy while the VFS side stalls now and then.
+ */
+#ifdef CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
+#define FSG_NUM_BUFFERS	CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
+#else
 #define FSG_NUM_BUFFERS	2
+#endif
 
 /* Default size of buffer length. */
 #define FSG_BUFLEN	((u32)16384)
@@ -126,6 +126,24 @@ static inline bool vbus_enabled(struct tegra_udc *udc)
 	return status;
 }
 
+/* undo the mapping tegra_ep_queue() did for the request */
+static void tegra_unmap_request(struct tegra_ep *ep, struct tegra_req *req)
+{
+	struct device *dev = ep->udc->gadget.dev.parent;
+	enum dma_data_direction dir;
+
+	dir = ep_is_in(ep) ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+
+	if (req->req.num_mapped_sgs) {
+		dma_unmap_sg(dev, req->req.sg, req->req.num_sgs, dir);
+		req->req.num_mapped_sgs = 0;
+	} else {
+		dma_unmap_single(dev, req->req.dma, req->req.length, dir);
+		req->req.dma = DMA_ADDR_INVALID;
+	}
+	req->mapped = 0;
+}
+
 /**
  * done() - retire a request; caller blocked irqs
  * @status : request status to be set, only works when
@@ -166,15 +184,9 @@ static void done(struct tegra_ep *ep, struct tegra_req *req, int status)
 		dma_pool_free(udc->td_pool, curr_td, curr_td->td_dma);
 	}
 
-	if (req->mapped) {
-		dma_unmap_single(ep->udc->gadget.dev.parent,
-			req->req.dma, req->req.length,
-			ep_is_in(ep)
-				? DMA_TO_DEVICE
-				: DMA_FROM_DEVICE);
-		req->req.dma = DMA_ADDR_INVALID;
-		req->mapped = 0;
-	} else
+	if (req->mapped)
+		tegra_unmap_request(ep, req);
+	else
 		dma_sync_single_for_cpu(ep->udc->gadget.dev.parent,
 			req->req.dma, req->req.length,
 			ep_is_in(ep)
@@ -783,27 +795,106 @@ out:
 	return;
 }
 
+/*
+ * Walk a mapped scatterlist from where the request stands, for at most
+ * limit bytes and as far as the five page pointers of one dTD reach: only
+ * the first page may start at an offset, and the data may only move on to
+ * another page (of the same entry or the next one) at a page boundary.
+ * With ptr set the pointers are filled in and the position is advanced.
+ */
+static unsigned tegra_walk_sg(struct tegra_req *req, unsigned limit,
+	u32 *ptr)
+{
+	struct scatterlist *sg = req->sg_cur;
+	unsigned off = req->sg_off;
+	unsigned left = req->sg_left;
+	unsigned len = 0, chunk;
+	dma_addr_t addr;
+	int i;
+
+	for (i = 0; i < DTD_BUFF_PTRS && left && len < limit; i++) {
+		addr = sg_dma_address(sg) + off;
+		if (i && (addr & (DTD_BUFF_PAGE_SIZE - 1)))
+			break;
+
+		chunk = min3(sg_dma_len(sg) - off, limit - len,
+			DTD_BUFF_PAGE_SIZE - (unsigned)(addr &
+				(DTD_BUFF_PAGE_SIZE - 1)));
+		if (ptr)
+			ptr[i] = (u32)addr;
+
+		len += chunk;
+		off += chunk;
+		if (off == sg_dma_len(sg)) {
+			off = 0;
+			if (--left)
+				sg = sg_next(sg);
+		}
+
+		if ((addr + chunk) & (DTD_BUFF_PAGE_SIZE - 1))
+			break;
+	}
+
+	if (ptr) {
+		req->sg_cur = sg;
+		req->sg_off = off;
+		req->sg_left = left;
+	}
+
+	return len;
+}
+
+/*
+ * Length of the next dTD of a scatter-gather request. Every dTD but the
+ * last has to be a whole number of packets, the controller ends a packet
+ * with each of them.
+ */
+static int tegra_sg_dtd_length(struct tegra_req *req)
+{
+	unsigned remaining = req->req.length - req->req.actual;
+	unsigned maxpacket = req->ep->ep.maxpacket;
+	unsigned length;
+
+	length = tegra_walk_sg(req, min(remaining,
+		(unsigned)EP_MAX_LENGTH_TRANSFER), NULL);
+	if (length < remaining)
+		length -= length % maxpacket;
+
+	if (!length && remaining)
+		return -EINVAL;
+
+	return length;
+}
+
 /**
  * Fill in the dTD structure
  * @req     : request that the transfer belongs to
  * @length  : return actually data length of the dTD
  * @dma     : return dma address of the dTD
  * @is_last : return flag if it is the last dTD of the request
- * return   : pointer to the built dTD
+ * return   : pointer to the built dTD or an ERR_PTR
  */
 static struct ep_td_struct *tegra_build_dtd(struct tegra_req *req,
 	unsigned *length, dma_addr_t *dma, int *is_last, gfp_t gfp_flags)
 {
 	u32 swap_temp;
+	u32 ptr[DTD_BUFF_PTRS];
 	struct ep_td_struct *dtd;
+	int ret;
 
 	/* how big will this transfer be? */
-	*length = min(req->req.length - req->req.actual,
-			(unsigned)EP_MAX_LENGTH_TRANSFER);
+	if (req->req.num_mapped_sgs) {
+		ret = tegra_sg_dtd_length(req);
+		if (ret < 0)
+			return ERR_PTR(ret);
+		*length = ret;
+	} else
+		*length = min(req->req.length - req->req.actual,
+				(unsigned)EP_MAX_LENGTH_TRANSFER);
 
 	dtd = dma_pool_alloc(the_udc->td_pool, gfp_flags, dma);
 	if (dtd == NULL)
-		return dtd;
+		return ERR_PTR(-ENOMEM);
 
 	dtd->td_dma = *dma;
 	/* Clear reserved field */
@@ -812,12 +903,22 @@ static struct ep_td_struct *tegra_build_dtd(struct tegra_req *req,
 	dtd->size_ioc_sts = cpu_to_le32(swap_temp);
 
 	/* Init all of buffer page pointers */
-	swap_temp = (u32) (req->req.dma + req->req.actual);
-	dtd->buff_ptr0 = cpu_to_le32(swap_temp);
-	dtd->buff_ptr1 = cpu_to_le32(swap_temp + 0x1000);
-	dtd->buff_ptr2 = cpu_to_le32(swap_temp + 0x2000);
-	dtd->buff_ptr3 = cpu_to_le32(swap_temp + 0x3000);
-	dtd->buff_ptr4 = cpu_to_le32(swap_temp + 0x4000);
+	if (req->req.num_mapped_sgs) {
+		memset(ptr, 0, sizeof(ptr));
+		tegra_walk_sg(req, *length, ptr);
+	} else {
+		swap_temp = (u32) (req->req.dma + req->req.actual);
+		ptr[0] = swap_temp;
+		ptr[1] = swap_temp + 0x1000;
+		ptr[2] = swap_temp + 0x2000;
+		ptr[3] = swap_temp + 0x3000;
+		ptr[4] = swap_temp + 0x4000;
+	}
+	dtd->buff_ptr0 = cpu_to_le32(ptr[0]);
+	dtd->buff_ptr1 = cpu_to_le32(ptr[1]);
+	dtd->buff_ptr2 = cpu_to_le32(ptr[2]);
+	dtd->buff_ptr3 = cpu_to_le32(ptr[3]);
+	dtd->buff_ptr4 = cpu_to_le32(ptr[4]);
 
 	req->req.actual += *length;
 
@@ -851,6 +952,20 @@ static struct ep_td_struct *tegra_build_dtd(struct tegra_req *req,
 	return dtd;
 }
 
+/* release the dTDs of a request whose chain could not be completed */
+static void tegra_free_dtds(struct tegra_req *req)
+{
+	struct ep_td_struct *dtd = req->head, *next;
+
+	while (req->dtd_count--) {
+		next = dtd->next_td_virt;
+		dma_pool_free(the_udc->td_pool, dtd, dtd->td_dma);
+		dtd = next;
+	}
+	req->dtd_count = 0;
+	req->head = req->tail = NULL;
+}
+
 /* Generate dtd chain for a request */
 static int tegra_req_to_dtd(struct tegra_req *req, gfp_t gfp_flags)
 {
@@ -864,8 +979,10 @@ static int tegra_req_to_dtd(struct tegra_req *req, gfp_t gfp_flags)
 
 	do {
 		dtd = tegra_build_dtd(req, &count, &dma, &is_last, gfp_flags);
-		if (dtd == NULL)
-			return -ENOMEM;
+		if (IS_ERR(dtd)) {
+			tegra_free_dtds(req);
+			return PTR_ERR(dtd);
+		}
 
 		if (is_first) {
 			is_first = 0;
@@ -898,7 +1015,8 @@ tegra_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 	int status;
 
 	/* catch various bogus parameters */
-	if (!_req || !req->req.complete || !req->req.buf
+	if (!_req || !req->req.complete
+			|| (!req->req.buf && !req->req.num_sgs)
 			|| !list_empty(&req->queue)) {
 		VDBG("%s, bad params", __func__);
 		return -EINVAL;
@@ -937,7 +1055,16 @@ tegra_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 	req->ep = ep;
 
 	/* map virtual address to hardware */
-	if (req->req.dma == DMA_ADDR_INVALID) {
+	if (req->req.num_sgs) {
+		req->req.num_mapped_sgs = dma_map_sg(udc->gadget.dev.parent,
+					req->req.sg, req->req.num_sgs, dir);
+		if (!req->req.num_mapped_sgs)
+			return -ENOMEM;
+		req->sg_cur = req->req.sg;
+		req->sg_off = 0;
+		req->sg_left = req->req.num_mapped_sgs;
+		req->mapped = 1;
+	} else if (req->req.dma == DMA_ADDR_INVALID) {
 		req->req.dma = dma_map_single(udc->gadget.dev.parent,
 					req->req.buf, req->req.length, dir);
 		req->mapped = 1;
@@ -980,12 +1107,8 @@ tegra_ep_queue(struct usb_ep *_ep, struct usb_request *_req, gfp_t gfp_flags)
 	return 0;
 
 err_unmap:
-	if (req->mapped) {
-		dma_unmap_single(udc->gadget.dev.parent,
-			req->req.dma, req->req.length, dir);
-		req->req.dma = DMA_ADDR_INVALID;
-		req->mapped = 0;
-	}
+	if (req->mapped)
+		tegra_unmap_request(ep, req);
 	return status;
 }
 
@@ -1466,6 +1589,7 @@ static int tegra_udc_setup_gadget_dev(struct tegra_udc *udc)
 	/* Setup gadget structure */
 	udc->gadget.ops = &tegra_gadget_ops;
 	udc->gadget.is_dualspeed = 1;
+	udc->gadget.sg_supported = 1;
 	udc->gadget.ep0 = &udc->eps[0].ep;
 	INIT_LIST_HEAD(&udc->gadget.ep_list);
 	udc->gadget.speed = USB_SPEED_UNKNOWN;
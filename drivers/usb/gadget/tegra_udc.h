@@ -319,6 +319,8 @@
 #define  DTD_ADDR_MASK                        0xFFFFFFE0
 #define  DTD_PACKET_SIZE                      0x7FFF0000
 #define  DTD_LENGTH_BIT_POS                   16
+#define  DTD_BUFF_PTRS                        5
+#define  DTD_BUFF_PAGE_SIZE                   0x1000
 #define  DTD_ERROR_MASK                       (DTD_STATUS_HALTED | \
 						DTD_STATUS_DATA_BUFF_ERR | \
 						DTD_STATUS_TRANSACTION_ERR)
@@ -384,6 +386,11 @@ struct tegra_req {
 	struct tegra_ep *ep;
 	unsigned mapped:1;
 
+	/* where the next dTD of a scatter-gather request starts */
+	struct scatterlist *sg_cur;
+	unsigned int sg_off;
+	unsigned int sg_left;		/* mapped entries from sg_cur on */
+
 	struct ep_td_struct *head, *tail;	/* For dTD List
 						   cpu endian Virtual addr */
 	unsigned int dtd_count;
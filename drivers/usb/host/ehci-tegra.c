@@ -19,6 +19,7 @@
 #include <linux/platform_device.h>
 #include <linux/platform_data/tegra_usb.h>
 #include <linux/irq.h>
+#include <linux/log2.h>
 #include <linux/usb/otg.h>
 #include <mach/usb_phy.h>
 #include <mach/iomap.h>
@@ -37,6 +38,31 @@ static const char driver_name[] = "tegra-ehci";
 
 #define TEGRA_USB_DMA_ALIGN 32
 
+/*
+ * Interrupt threshold control, USBCMD 23:16 in microframes. The Tegra
+ * controller takes a new threshold while running. In adaptive mode the IRQ
+ * rate is sampled every TEGRA_EHCI_ITC_SAMPLE: above ITC_RATE_HIGH the
+ * threshold doubles up to itc_max, below ITC_RATE_LOW it halves back down
+ * to itc. Pending isochronous URBs bring it straight back to itc, and
+ * interrupt URBs cap it at one frame, so that neither is held back past
+ * its polling interval.
+ */
+#define TEGRA_USB_CMD_ITC_SHIFT	16
+#define TEGRA_USB_CMD_ITC_MASK	(0xff << TEGRA_USB_CMD_ITC_SHIFT)
+#define TEGRA_EHCI_ITC_LIMIT	64
+#define TEGRA_EHCI_ITC_FRAME	8
+#define TEGRA_EHCI_ITC_SAMPLE	(HZ / 10)
+#define TEGRA_EHCI_ITC_RATE_HIGH	2000
+#define TEGRA_EHCI_ITC_RATE_LOW		500
+
+static bool itc_adaptive = true;
+module_param(itc_adaptive, bool, S_IRUGO);
+MODULE_PARM_DESC(itc_adaptive, "Raise the IRQ threshold under bulk load");
+
+static unsigned int itc_max = 16;
+module_param(itc_max, uint, S_IRUGO);
+MODULE_PARM_DESC(itc_max, "Highest adaptive IRQ threshold, in microframes");
+
 struct tegra_ehci_hcd {
 	struct ehci_hcd *ehci;
 	struct tegra_usb_phy *phy;
@@ -47,6 +73,20 @@ struct tegra_ehci_hcd {
 	bool port_resuming;
 	unsigned int irq;
 	bool bus_suspended_fail;
+	/* URBs copied through an aligned buffer, and the bytes copied */
+	atomic_t bounce_in;
+	atomic_t bounce_out;
+	atomic_long_t bounce_bytes;
+	/* interrupt threshold, in microframes, and IRQ rate accounting */
+	unsigned int itc;
+	unsigned int itc_max;
+	bool itc_adaptive;
+	unsigned long irqs;
+	unsigned long sample_irqs;
+	unsigned long sample_start;
+	unsigned int irq_rate;
+	unsigned long itc_raised;
+	unsigned long itc_lowered;
 };
 
 struct dma_align_buffer {
@@ -71,7 +111,7 @@ __setup("usb_high_speed=", enable_usb_high_speed);
 EXPORT_SYMBOL_GPL(g_usb_high_speed);
 #endif /* CONFIG_MACH_COLIBRI_T20 */
 
-static void free_align_buffer(struct urb *urb)
+static void free_align_buffer(struct urb *urb, struct tegra_ehci_hcd *tegra)
 {
 	struct dma_align_buffer *temp = container_of(urb->transfer_buffer,
 						struct dma_align_buffer, data);
@@ -79,22 +119,30 @@ static void free_align_buffer(struct urb *urb)
 	if (!(urb->transfer_flags & URB_ALIGNED_TEMP_BUFFER))
 		return;
 
-	/* In transaction, DMA from Device */
-	if (usb_urb_dir_in(urb))
-		memcpy(temp->old_xfer_buffer, temp->data,
-					urb->transfer_buffer_length);
+	/* In transaction, DMA from Device, only what was received */
+	if (usb_urb_dir_in(urb)) {
+		memcpy(temp->old_xfer_buffer, temp->data, urb->actual_length);
+		atomic_long_add(urb->actual_length, &tegra->bounce_bytes);
+	}
 
 	urb->transfer_buffer = temp->old_xfer_buffer;
 	urb->transfer_flags &= ~URB_ALIGNED_TEMP_BUFFER;
 	kfree(temp->kmalloc_ptr);
 }
 
-static int alloc_align_buffer(struct urb *urb, gfp_t mem_flags)
+static int alloc_align_buffer(struct urb *urb, struct tegra_ehci_hcd *tegra,
+	gfp_t mem_flags)
 {
 	struct dma_align_buffer *temp, *kmalloc_ptr;
 	size_t kmalloc_size;
 
+	/*
+	 * Only a buffer the controller will DMA to or from itself needs to
+	 * be aligned: sg lists are mapped page by page, and a buffer the
+	 * driver mapped already is used as it is.
+	 */
 	if (urb->num_sgs || urb->sg ||
+		(urb->transfer_flags & URB_NO_TRANSFER_DMA_MAP) ||
 		urb->transfer_buffer_length == 0 ||
 		!((uintptr_t)urb->transfer_buffer & (TEGRA_USB_DMA_ALIGN - 1)))
 		return 0;
@@ -112,9 +160,15 @@ static int alloc_align_buffer(struct urb *urb, gfp_t mem_flags)
 	temp->kmalloc_ptr = kmalloc_ptr;
 	temp->old_xfer_buffer = urb->transfer_buffer;
 	/* OUT transaction, DMA to Device */
-	if (!usb_urb_dir_in(urb))
+	if (!usb_urb_dir_in(urb)) {
 		memcpy(temp->data, urb->transfer_buffer,
 				urb->transfer_buffer_length);
+		atomic_long_add(urb->transfer_buffer_length,
+				&tegra->bounce_bytes);
+		atomic_inc(&tegra->bounce_out);
+	} else {
+		atomic_inc(&tegra->bounce_in);
+	}
 
 	urb->transfer_buffer = temp->data;
 	urb->transfer_flags |= URB_ALIGNED_TEMP_BUFFER;
@@ -125,9 +179,10 @@ static int alloc_align_buffer(struct urb *urb, gfp_t mem_flags)
 static int tegra_ehci_map_urb_for_dma(struct usb_hcd *hcd,
 	struct urb *urb, gfp_t mem_flags)
 {
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(hcd->self.controller);
 	int ret;
 
-	ret = alloc_align_buffer(urb, mem_flags);
+	ret = alloc_align_buffer(urb, tegra, mem_flags);
 	if (ret)
 		return ret;
 
@@ -149,7 +204,7 @@ static int tegra_ehci_map_urb_for_dma(struct usb_hcd *hcd,
 	}
 
 	if (ret)
-		free_align_buffer(urb);
+		free_align_buffer(urb, tegra);
 
 	return ret;
 }
@@ -157,6 +212,7 @@ static int tegra_ehci_map_urb_for_dma(struct usb_hcd *hcd,
 static void tegra_ehci_unmap_urb_for_dma(struct usb_hcd *hcd,
 	struct urb *urb)
 {
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(hcd->self.controller);
 
 	if (urb->transfer_dma) {
 		enum dma_data_direction dir;
@@ -168,7 +224,203 @@ static void tegra_ehci_unmap_urb_for_dma(struct usb_hcd *hcd,
 	}
 
 	usb_hcd_unmap_urb_for_dma(hcd, urb);
-	free_align_buffer(urb);
+	free_align_buffer(urb, tegra);
+}
+
+static ssize_t bounce_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+
+	return sprintf(buf, "in: %d, out: %d, bytes: %ld\n",
+		atomic_read(&tegra->bounce_in),
+		atomic_read(&tegra->bounce_out),
+		atomic_long_read(&tegra->bounce_bytes));
+}
+static DEVICE_ATTR(bounce_stats, S_IRUGO, bounce_stats_show, NULL);
+
+/* called with ehci->lock held */
+static void tegra_ehci_write_itc(struct ehci_hcd *ehci, unsigned int itc)
+{
+	u32 cmd = ehci_readl(ehci, &ehci->regs->command);
+
+	/* don't ring the doorbell again */
+	cmd &= ~(CMD_IAAD | TEGRA_USB_CMD_ITC_MASK);
+	cmd |= itc << TEGRA_USB_CMD_ITC_SHIFT;
+	ehci_writel(ehci, cmd, &ehci->regs->command);
+
+	/* also what ehci->command restores after a bus resume */
+	ehci->command &= ~TEGRA_USB_CMD_ITC_MASK;
+	ehci->command |= itc << TEGRA_USB_CMD_ITC_SHIFT;
+}
+
+static unsigned int tegra_ehci_read_itc(struct ehci_hcd *ehci)
+{
+	return (ehci->command & TEGRA_USB_CMD_ITC_MASK) >>
+		TEGRA_USB_CMD_ITC_SHIFT;
+}
+
+/* thresholds are powers of two from 1 to 64 microframes */
+static unsigned int tegra_ehci_itc_valid(unsigned long val)
+{
+	return rounddown_pow_of_two(clamp_val(val, 1, TEGRA_EHCI_ITC_LIMIT));
+}
+
+static ssize_t itc_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", tegra->itc);
+}
+
+static ssize_t itc_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	struct ehci_hcd *ehci = tegra->ehci;
+	unsigned long flags, val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	tegra->itc = tegra_ehci_itc_valid(val);
+	tegra->itc_max = max(tegra->itc_max, tegra->itc);
+	if (tegra_usb_phy_hw_accessible(tegra->phy))
+		tegra_ehci_write_itc(ehci, tegra->itc);
+	spin_unlock_irqrestore(&ehci->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR(itc, S_IRUGO | S_IWUSR, itc_show, itc_store);
+
+static ssize_t itc_max_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", tegra->itc_max);
+}
+
+static ssize_t itc_max_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	unsigned long flags, val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	spin_lock_irqsave(&tegra->ehci->lock, flags);
+	tegra->itc_max = max(tegra_ehci_itc_valid(val), tegra->itc);
+	spin_unlock_irqrestore(&tegra->ehci->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR(itc_max, S_IRUGO | S_IWUSR, itc_max_show, itc_max_store);
+
+static ssize_t itc_adaptive_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", tegra->itc_adaptive);
+}
+
+static ssize_t itc_adaptive_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+	struct ehci_hcd *ehci = tegra->ehci;
+	unsigned long flags, val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	tegra->itc_adaptive = !!val;
+	/* back to the fixed threshold */
+	if (!val && tegra_usb_phy_hw_accessible(tegra->phy))
+		tegra_ehci_write_itc(ehci, tegra->itc);
+	spin_unlock_irqrestore(&ehci->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR(itc_adaptive, S_IRUGO | S_IWUSR, itc_adaptive_show,
+	itc_adaptive_store);
+
+static ssize_t irq_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_ehci_hcd *tegra = dev_get_drvdata(dev);
+
+	return sprintf(buf, "irqs: %lu, rate: %u/s, itc: %u uframes, "
+		"raised: %lu, lowered: %lu\n", tegra->irqs, tegra->irq_rate,
+		tegra_ehci_read_itc(tegra->ehci), tegra->itc_raised,
+		tegra->itc_lowered);
+}
+static DEVICE_ATTR(irq_stats, S_IRUGO, irq_stats_show, NULL);
+
+static struct attribute *tegra_ehci_attrs[] = {
+	&dev_attr_bounce_stats.attr,
+	&dev_attr_itc.attr,
+	&dev_attr_itc_max.attr,
+	&dev_attr_itc_adaptive.attr,
+	&dev_attr_irq_stats.attr,
+	NULL,
+};
+
+static const struct attribute_group tegra_ehci_attr_group = {
+	.attrs = tegra_ehci_attrs,
+};
+
+/* called with ehci->lock held from the IRQ handler */
+static void tegra_ehci_itc_sample(struct tegra_ehci_hcd *tegra,
+	struct ehci_hcd *ehci)
+{
+	struct usb_bus *bus = &ehci_to_hcd(ehci)->self;
+	unsigned long elapsed = jiffies - tegra->sample_start;
+	unsigned int cur, itc, limit;
+
+	tegra->irqs++;
+	tegra->sample_irqs++;
+	if (elapsed < TEGRA_EHCI_ITC_SAMPLE)
+		return;
+
+	tegra->irq_rate = tegra->sample_irqs * HZ / elapsed;
+	tegra->sample_irqs = 0;
+	tegra->sample_start = jiffies;
+
+	if (!tegra->itc_adaptive)
+		return;
+
+	cur = tegra_ehci_read_itc(ehci);
+	if (!cur)
+		cur = tegra->itc;
+
+	limit = tegra->itc_max;
+	if (bus->bandwidth_isoc_reqs)
+		limit = tegra->itc;
+	else if (bus->bandwidth_int_reqs)
+		limit = min_t(unsigned int, limit, TEGRA_EHCI_ITC_FRAME);
+	limit = max(limit, tegra->itc);
+
+	itc = cur;
+	if (tegra->irq_rate > TEGRA_EHCI_ITC_RATE_HIGH)
+		itc = cur * 2;
+	else if (tegra->irq_rate < TEGRA_EHCI_ITC_RATE_LOW)
+		itc = cur / 2;
+	itc = clamp(itc, tegra->itc, limit);
+
+	if (itc == cur)
+		return;
+
+	if (itc > cur)
+		tegra->itc_raised++;
+	else
+		tegra->itc_lowered++;
+	tegra_ehci_write_itc(ehci, itc);
 }
 
 static irqreturn_t tegra_ehci_irq(struct usb_hcd *hcd)
@@ -198,6 +450,12 @@ static irqreturn_t tegra_ehci_irq(struct usb_hcd *hcd)
 
 	irq_status = ehci_irq(hcd);
 
+	if (irq_status == IRQ_HANDLED) {
+		spin_lock(&ehci->lock);
+		tegra_ehci_itc_sample(tegra, ehci);
+		spin_unlock(&ehci->lock);
+	}
+
 	if (ehci->controller_remote_wakeup) {
 		ehci->controller_remote_wakeup = false;
 		tegra_usb_phy_pre_resume(tegra->phy, true);
@@ -587,6 +845,15 @@ static int tegra_ehci_probe(struct platform_device *pdev)
 		goto fail_phy;
 	}
 
+	/* ehci_init() starts out with the log2_irq_thresh of ehci-hcd */
+	tegra->itc = tegra_ehci_itc_valid(1 << clamp(log2_irq_thresh, 0, 6));
+	tegra->itc_max = max(tegra_ehci_itc_valid(itc_max), tegra->itc);
+	tegra->itc_adaptive = itc_adaptive;
+	tegra->sample_start = jiffies;
+
+	/* let class drivers allocate buffers that don't need a bounce */
+	hcd->self.dma_align = TEGRA_USB_DMA_ALIGN;
+
 	err = usb_add_hcd(hcd, irq, IRQF_SHARED | IRQF_TRIGGER_HIGH);
 	if (err) {
 		dev_err(&pdev->dev, "Failed to add USB HCD, error=%d\n", err);
@@ -606,6 +873,16 @@ static int tegra_ehci_probe(struct platform_device *pdev)
 
 	tegra->ehci = hcd_to_ehci(hcd);
 
+	/*
+	 * The root hub and its devices are children and wait for us. The OTG
+	 * port shares its phy with tegra-otg, which must stay ordered.
+	 */
+	if (!tegra_usb_phy_otg_supported(tegra->phy))
+		device_enable_async_suspend(&pdev->dev);
+
+	if (sysfs_create_group(&pdev->dev.kobj, &tegra_ehci_attr_group))
+		dev_warn(&pdev->dev, "failed to create sysfs attributes\n");
+
 #ifdef CONFIG_USB_OTG_UTILS
 	if (tegra_usb_phy_otg_supported(tegra->phy)) {
 		tegra->transceiver = otg_get_transceiver();
@@ -665,6 +942,8 @@ static int tegra_ehci_remove(struct platform_device *pdev)
 	if (tegra->irq && pdata->u_data.host.remote_wakeup_supported)
 		disable_irq_wake(tegra->irq);
 
+	sysfs_remove_group(&pdev->dev.kobj, &tegra_ehci_attr_group);
+
 	/* Make sure phy is powered ON to access USB register */
 	if(!tegra_usb_phy_hw_accessible(tegra->phy))
 		tegra_usb_phy_power_on(tegra->phy);
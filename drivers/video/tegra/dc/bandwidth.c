@@ -33,19 +33,26 @@ static int use_dynamic_emc = 1;
 
 module_param_named(use_dynamic_emc, use_dynamic_emc, int, S_IRUGO | S_IWUSR);
 
+/* drop to the scanout-only EMC rate once no flip has happened for this long,
+ * 0 disables the reclaim */
+static unsigned int emc_reclaim_ms = 1000;
+
+module_param_named(emc_reclaim_ms, emc_reclaim_ms, uint, S_IRUGO | S_IWUSR);
+
+/* windows A, B, C for first and second display */
+static const enum tegra_la_id la_id_tab[2][3] = {
+	/* first display */
+	{ TEGRA_LA_DISPLAY_0A, TEGRA_LA_DISPLAY_0B,
+		TEGRA_LA_DISPLAY_0C },
+	/* second display */
+	{ TEGRA_LA_DISPLAY_0AB, TEGRA_LA_DISPLAY_0BB,
+		TEGRA_LA_DISPLAY_0CB },
+};
+
 /* uses the larger of w->bandwidth or w->new_bandwidth */
 static void tegra_dc_set_latency_allowance(struct tegra_dc *dc,
 	struct tegra_dc_win *w)
 {
-	/* windows A, B, C for first and second display */
-	static const enum tegra_la_id la_id_tab[2][3] = {
-		/* first display */
-		{ TEGRA_LA_DISPLAY_0A, TEGRA_LA_DISPLAY_0B,
-			TEGRA_LA_DISPLAY_0C },
-		/* second display */
-		{ TEGRA_LA_DISPLAY_0AB, TEGRA_LA_DISPLAY_0BB,
-			TEGRA_LA_DISPLAY_0CB },
-	};
 	/* window B V-filter tap for first and second display. */
 	static const enum tegra_la_id vfilter_tab[2] = {
 		TEGRA_LA_DISPLAY_1B, TEGRA_LA_DISPLAY_1BB,
@@ -75,73 +82,70 @@ static void tegra_dc_set_latency_allowance(struct tegra_dc *dc,
 #endif
 }
 
-static unsigned int tegra_dc_windows_is_overlapped(struct tegra_dc_win *a,
-						   struct tegra_dc_win *b)
+/* account a window underflow against its latency allowance client */
+void tegra_dc_la_underflow(struct tegra_dc *dc, int win_idx)
 {
-	if (!WIN_IS_ENABLED(a) || !WIN_IS_ENABLED(b))
-		return 0;
+	if (dc->ndev->id >= ARRAY_SIZE(la_id_tab) ||
+	    win_idx >= ARRAY_SIZE(*la_id_tab))
+		return;
+#ifdef CONFIG_TEGRA_SILICON_PLATFORM
+	tegra_latency_allowance_underflow(la_id_tab[dc->ndev->id][win_idx]);
+#endif
+}
+
+/* true if the window is fetched while line y is scanned out */
+static bool tegra_dc_win_covers_line(struct tegra_dc_win *w, unsigned y)
+{
+	if (!WIN_IS_ENABLED(w))
+		return false;
 
-	/* because memory access to load the fifo can overlap, only care
-	 * if windows overlap vertically */
-	return ((a->out_y + a->out_h > b->out_y) && (a->out_y <= b->out_y)) ||
-		((b->out_y + b->out_h > a->out_y) && (b->out_y <= a->out_y));
+	return y >= w->out_y && y < w->out_y + w->out_h;
 }
 
-static unsigned long tegra_dc_find_max_bandwidth(struct tegra_dc_win *wins[],
-						 int n)
+/* because memory access to load the fifo can overlap, only vertical overlap
+ * matters: the worst case is the line crossed by the greatest sum of window
+ * bandwidths. Coverage only grows at a window's top line, so it is enough to
+ * evaluate the top line of every enabled window. */
+static unsigned long tegra_dc_peak_bandwidth(struct tegra_dc_win *windows[],
+	const unsigned long bandwidth[], unsigned n)
 {
+	unsigned long max_bw = 0;
 	unsigned i;
 	unsigned j;
-	unsigned overlap_count;
-	unsigned max_bw = 0;
-
-	WARN_ONCE(n > 3, "Code assumes at most 3 windows, bandwidth is likely"
-			 "inaccurate.\n");
-
-	/* If we had a large number of windows, we would compute adjacency
-	 * graph representing 2 window overlaps, find all cliques in the graph,
-	 * assign bandwidth to each clique, and then select the clique with
-	 * maximum bandwidth. But because we have at most 3 windows,
-	 * implementing proper Bron-Kerbosh algorithm would be an overkill,
-	 * brute force will suffice.
-	 *
-	 * Thus: find maximum bandwidth for either single or a pair of windows
-	 * and count number of window pair overlaps. If there are three
-	 * pairs, all 3 window overlap.
-	 */
 
-	overlap_count = 0;
 	for (i = 0; i < n; i++) {
-		unsigned int bw1;
+		struct tegra_dc_win *top = windows[i];
+		unsigned long bw = 0;
 
-		if (wins[i] == NULL)
+		if (!WIN_IS_ENABLED(top) || !bandwidth[i])
 			continue;
-		bw1 = wins[i]->new_bandwidth;
-		if (bw1 > max_bw)
-			/* Single window */
-			max_bw = bw1;
-
-		for (j = i + 1; j < n; j++) {
-			if (wins[j] == NULL)
-				continue;
-			if (tegra_dc_windows_is_overlapped(wins[i], wins[j])) {
-				unsigned int bw2 = wins[j]->new_bandwidth;
-				if (bw1 + bw2 > max_bw)
-					/* Window pair overlaps */
-					max_bw = bw1 + bw2;
-				overlap_count++;
-			}
+
+		for (j = 0; j < n; j++) {
+			if (tegra_dc_win_covers_line(windows[j], top->out_y))
+				bw += bandwidth[j];
 		}
-	}
 
-	if (overlap_count == 3)
-		/* All three windows overlap */
-		max_bw = wins[0]->new_bandwidth + wins[1]->new_bandwidth +
-			 wins[2]->new_bandwidth;
+		if (bw > max_bw)
+			max_bw = bw;
+	}
 
 	return max_bw;
 }
 
+static unsigned long tegra_dc_find_max_bandwidth(struct tegra_dc *dc)
+{
+	struct tegra_dc_win *windows[DC_N_WINDOWS];
+	unsigned long bandwidth[DC_N_WINDOWS];
+	unsigned i;
+
+	for (i = 0; i < dc->n_windows; i++) {
+		windows[i] = &dc->windows[i];
+		bandwidth[i] = windows[i]->new_bandwidth;
+	}
+
+	return tegra_dc_peak_bandwidth(windows, bandwidth, dc->n_windows);
+}
+
 /*
  * Calculate peak EMC bandwidth for each enabled window =
  * pixel_clock * win_bpp * (use_v_filter ? 2 : 1)) * H_scale_factor *
@@ -191,8 +195,10 @@ static unsigned long tegra_dc_calc_win_bandwidth(struct tegra_dc *dc,
 	return ret;
 }
 
-static unsigned long tegra_dc_get_bandwidth(
-	struct tegra_dc_win *windows[], int n)
+/* windows that are not part of this update keep their last new_bandwidth,
+ * tegra_dc_find_max_bandwidth() combines them with the updated ones */
+static void tegra_dc_update_win_bandwidth(struct tegra_dc_win *windows[],
+	int n)
 {
 	int i;
 
@@ -207,8 +213,25 @@ static unsigned long tegra_dc_get_bandwidth(
 			w->new_bandwidth =
 				tegra_dc_calc_win_bandwidth(w->dc, w);
 	}
+}
 
-	return tegra_dc_find_max_bandwidth(windows, n);
+/* EMC rate that scanout of the current windows needs on its own */
+static unsigned long tegra_dc_scanout_emc_rate(struct tegra_dc *dc)
+{
+	unsigned long bw = tegra_dc_find_max_bandwidth(dc);
+
+	if (WARN_ONCE(bw > (ULONG_MAX / 1000), "bandwidth maxed out\n"))
+		return ULONG_MAX;
+
+	return EMC_BW_TO_FREQ(bw * 1000);
+}
+
+/* let the EMC governor know display demand ahead of ACTMON */
+static inline void tegra_dc_emc_bw_hint(struct tegra_dc *dc,
+					unsigned long rate)
+{
+	tegra_emc_bw_hint(dc->ndev->id ? TEGRA_EMC_BW_DISP2 :
+			  TEGRA_EMC_BW_DISP1, rate);
 }
 
 /* to save power, call when display memory clients would be idle */
@@ -218,6 +241,7 @@ void tegra_dc_clear_bandwidth(struct tegra_dc *dc)
 		dc->emc_clk_rate);
 	if (tegra_is_clk_enabled(dc->emc_clk))
 		clk_disable(dc->emc_clk);
+	tegra_dc_emc_bw_hint(dc, 0);
 	dc->emc_clk_rate = 0;
 }
 
@@ -238,6 +262,8 @@ void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new)
 
 		clk_set_rate(dc->emc_clk,
 			max(dc->emc_clk_rate, dc->new_emc_clk_rate));
+		tegra_dc_emc_bw_hint(dc,
+			max(dc->emc_clk_rate, dc->new_emc_clk_rate));
 		dc->emc_clk_rate = dc->new_emc_clk_rate;
 
 		/* going from non-zero to 0 */
@@ -268,11 +294,8 @@ int tegra_dc_set_dynamic_emc(struct tegra_dc_win *windows[], int n)
 	dc = windows[0]->dc;
 
 	/* calculate the new rate based on this POST */
-	new_rate = tegra_dc_get_bandwidth(windows, n);
-	if (WARN_ONCE(new_rate > (ULONG_MAX / 1000), "bandwidth maxed out\n"))
-		new_rate = ULONG_MAX;
-	else
-		new_rate = EMC_BW_TO_FREQ(new_rate * 1000);
+	tegra_dc_update_win_bandwidth(windows, n);
+	new_rate = tegra_dc_scanout_emc_rate(dc);
 
 	if (tegra_dc_has_multiple_dc())
 		new_rate = ULONG_MAX;
@@ -282,3 +305,100 @@ int tegra_dc_set_dynamic_emc(struct tegra_dc_win *windows[], int n)
 
 	return 0;
 }
+
+/*
+ * Admission check for a flip: windows[] are the new states of some windows,
+ * the others keep their current one. Returns -ENOSPC if scanout of the result
+ * would need more than the highest EMC rate, so that a client can fall back
+ * to composing before it flips rather than underflow after.
+ */
+int tegra_dc_check_bandwidth(struct tegra_dc *dc,
+	struct tegra_dc_win *windows[], int n)
+{
+	struct tegra_dc_win *wins[DC_N_WINDOWS];
+	unsigned long bandwidth[DC_N_WINDOWS];
+	unsigned long bw;
+	long max_rate;
+	int i;
+
+	max_rate = clk_round_rate(dc->emc_clk, ULONG_MAX);
+	if (max_rate <= 0)
+		return 0;
+
+	for (i = 0; i < dc->n_windows; i++) {
+		wins[i] = &dc->windows[i];
+		bandwidth[i] = wins[i]->new_bandwidth;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct tegra_dc_win *w = windows[i];
+
+		if (WARN_ON(w->idx >= dc->n_windows))
+			return -EINVAL;
+
+		wins[w->idx] = w;
+		bandwidth[w->idx] = tegra_dc_calc_win_bandwidth(dc, w);
+	}
+
+	bw = tegra_dc_peak_bandwidth(wins, bandwidth, dc->n_windows);
+	if (bw > ULONG_MAX / 1000 ||
+	    EMC_BW_TO_FREQ(bw * 1000) > max_rate) {
+		trace_printk("%s:flip needs %lu kBps, rejected\n",
+			dc->ndev->name, bw);
+		return -ENOSPC;
+	}
+
+	return 0;
+}
+
+/* called on every flip, restarts the static scene timer */
+void tegra_dc_schedule_emc_reclaim(struct tegra_dc *dc)
+{
+	dc->last_flip = jiffies;
+
+	if (!use_dynamic_emc || !emc_reclaim_ms ||
+	    (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE))
+		return;
+
+	schedule_delayed_work(&dc->emc_reclaim_work,
+		msecs_to_jiffies(emc_reclaim_ms));
+}
+
+/*
+ * The rate chosen at flip time may be padded beyond what scanout needs, e.g.
+ * pinned to the maximum while several heads are active. Once the scene has
+ * been static for emc_reclaim_ms, request only what scanout of the current
+ * windows needs; the next flip restores the full rate before it is latched.
+ */
+void tegra_dc_emc_reclaim_worker(struct work_struct *work)
+{
+	struct tegra_dc *dc = container_of(to_delayed_work(work),
+		struct tegra_dc, emc_reclaim_work);
+	unsigned long delay = msecs_to_jiffies(emc_reclaim_ms);
+	unsigned long rate;
+
+	mutex_lock(&dc->lock);
+
+	if (!dc->enabled || dc->suspended || !use_dynamic_emc || !emc_reclaim_ms)
+		goto out;
+
+	/* a flip came in after the work was queued */
+	if (time_before(jiffies, dc->last_flip + delay)) {
+		schedule_delayed_work(&dc->emc_reclaim_work,
+			dc->last_flip + delay - jiffies);
+		goto out;
+	}
+
+	rate = tegra_dc_scanout_emc_rate(dc);
+	if (rate >= dc->new_emc_clk_rate)
+		goto out;
+
+	trace_printk("%s:static scene, emc_clk_rate=%ld\n", dc->ndev->name,
+		rate);
+	tegra_dc_hold_dc_out(dc);
+	dc->new_emc_clk_rate = rate;
+	tegra_dc_program_bandwidth(dc, true);
+	tegra_dc_release_dc_out(dc);
+out:
+	mutex_unlock(&dc->lock);
+}
@@ -53,6 +53,9 @@
 #include "dc_priv.h"
 #include "nvsd.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/display.h>
+
 #define TEGRA_CRC_LATCHED_DELAY		34
 
 #define DC_COM_PIN_OUTPUT_POLARITY1_INIT_VAL	0x01000000
@@ -378,11 +381,17 @@ static int dbg_dc_stats_show(struct seq_file *s, void *unused)
 		"underflows: %llu\n"
 		"underflows_a: %llu\n"
 		"underflows_b: %llu\n"
-		"underflows_c: %llu\n",
+		"underflows_c: %llu\n"
+		"idle_refresh_entries: %u\n"
+		"idle_refresh_ms: %llu\n",
 		dc->stats.underflows,
 		dc->stats.underflows_a,
 		dc->stats.underflows_b,
-		dc->stats.underflows_c);
+		dc->stats.underflows_c,
+		dc->idle.entries,
+		div_u64(dc->idle.residency_us + (dc->idle.active ?
+			ktime_us_delta(ktime_get(), dc->idle.enter_time) : 0),
+			1000));
 	mutex_unlock(&dc->lock);
 
 	return 0;
@@ -888,6 +897,209 @@ int tegra_dc_wait_for_vsync(struct tegra_dc *dc)
 	return ret;
 }
 
+/* waits for the next frame end of a continuous mode output, which is when
+ * the window state programmed during the frame has been latched */
+int tegra_dc_wait_for_frame_end(struct tegra_dc *dc, u32 timeout_ms,
+				s64 *timestamp_ns)
+{
+	long ret;
+
+	if (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE)
+		return -ENOTTY;
+
+	mutex_lock(&dc->lock);
+	if (!dc->enabled) {
+		mutex_unlock(&dc->lock);
+		return -ENXIO;
+	}
+
+	/* tegra_dc_trigger_windows() masks the interrupt again once it has
+	 * fired and no window update is pending */
+	tegra_dc_hold_dc_out(dc);
+	INIT_COMPLETION(dc->frame_end_complete);
+	tegra_dc_writel(dc, FRAME_END_INT, DC_CMD_INT_STATUS);
+	tegra_dc_unmask_interrupt(dc, FRAME_END_INT);
+	tegra_dc_release_dc_out(dc);
+	mutex_unlock(&dc->lock);
+
+	ret = wait_for_completion_interruptible_timeout(&dc->frame_end_complete,
+		msecs_to_jiffies(timeout_ms));
+	if (ret < 0)
+		return ret;
+	if (!ret)
+		return -ETIMEDOUT;
+
+	if (timestamp_ns)
+		*timestamp_ns = ktime_to_ns(dc->frame_end_time);
+	return 0;
+}
+
+/* closes the record of the frame that just ended, called from the interrupt
+ * before tegra_dc_trigger_windows() clears the windows' dirty state */
+static void tegra_dc_record_frame(struct tegra_dc *dc, ktime_t now)
+{
+	struct tegra_dc_frame_stat *stat;
+	struct tegra_dc_frame_stat rec;
+	u32 latched = 0;
+	s64 latency = 0;
+	u32 val;
+	int i;
+
+	spin_lock(&dc->frame_stats.lock);
+	if (dc->frame_stats.pending) {
+		val = tegra_dc_readl(dc, DC_CMD_STATE_CONTROL);
+		for (i = 0; i < DC_N_WINDOWS; i++) {
+			s64 delta;
+
+			if (!(dc->frame_stats.pending & BIT(i)) ||
+			    (val & (WIN_A_ACT_REQ << i)))
+				continue;
+
+			latched |= BIT(i);
+			delta = ktime_us_delta(now,
+					       dc->frame_stats.flip_time[i]);
+			if (delta > latency)
+				latency = delta;
+		}
+		dc->frame_stats.pending &= ~latched;
+	}
+
+	rec.timestamp_ns = ktime_to_ns(now);
+	rec.frame = dc->frame_stats.frame++;
+	rec.flips = hweight32(latched);
+	rec.underflow_mask = dc->frame_stats.underflow_mask;
+	rec.latency_us = latency;
+	dc->frame_stats.underflow_mask = 0;
+
+	stat = &dc->frame_stats.ring[rec.frame &
+				     (TEGRA_DC_FRAME_STATS_LEN - 1)];
+	*stat = rec;
+	spin_unlock(&dc->frame_stats.lock);
+
+	trace_display_frame(dc->ndev->name, rec.frame, rec.flips,
+			    rec.underflow_mask, rec.latency_us,
+			    rec.timestamp_ns);
+}
+
+/* copies up to max records from frame *start on, oldest first; *start is
+ * moved past any records that have already been overwritten */
+int tegra_dc_get_frame_stats(struct tegra_dc *dc, u32 *start,
+			     struct tegra_dc_frame_stat *stats, int max,
+			     u32 *next)
+{
+	unsigned long flags;
+	u32 frame;
+	int n = 0;
+
+	spin_lock_irqsave(&dc->frame_stats.lock, flags);
+	*next = dc->frame_stats.frame;
+	if ((s32)(*next - *start) > TEGRA_DC_FRAME_STATS_LEN)
+		*start = *next - TEGRA_DC_FRAME_STATS_LEN;
+	else if ((s32)(*next - *start) < 0)
+		*start = *next;
+
+	for (frame = *start; frame != *next && n < max; frame++)
+		stats[n++] = dc->frame_stats.ring[frame &
+					(TEGRA_DC_FRAME_STATS_LEN - 1)];
+	spin_unlock_irqrestore(&dc->frame_stats.lock, flags);
+
+	return n;
+}
+EXPORT_SYMBOL(tegra_dc_get_frame_stats);
+
+#define CURSOR_RGB(c)	CURSOR_COLOR(((c) >> 16) & 0xff, ((c) >> 8) & 0xff, \
+			     (c) & 0xff)
+
+/* called with dc->lock and the output held */
+static void tegra_dc_cursor_write_image(struct tegra_dc *dc)
+{
+	tegra_dc_writel(dc, CURSOR_RGB(dc->cursor.foreground),
+			DC_DISP_CURSOR_FOREGROUND);
+	tegra_dc_writel(dc, CURSOR_RGB(dc->cursor.background),
+			DC_DISP_CURSOR_BACKGROUND);
+	tegra_dc_writel(dc, CURSOR_START_ADDR((u32)dc->cursor.phys_addr) |
+			(dc->cursor.size_64 ? CURSOR_SIZE_64 : 0),
+			DC_DISP_CURSOR_START_ADDR);
+}
+
+/* called with dc->lock and the output held */
+static void tegra_dc_cursor_write_position(struct tegra_dc *dc)
+{
+	bool visible = dc->cursor.visible && dc->cursor.phys_addr;
+	u32 win_options;
+
+	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
+	if (!!(win_options & CURSOR_ENABLE) != visible) {
+		win_options &= ~CURSOR_ENABLE;
+		if (visible)
+			win_options |= CURSOR_ENABLE;
+		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
+	}
+
+	tegra_dc_writel(dc, CURSOR_POSITION(dc->cursor.x, dc->cursor.y),
+			DC_DISP_CURSOR_POSITION);
+}
+
+/*
+ * The cursor only uses the general (non-window) state, so a change is
+ * latched at the next vblank by GENERAL_ACT_REQ alone and nobody waits for
+ * it; pending window updates are left alone.
+ */
+static void tegra_dc_cursor_latch(struct tegra_dc *dc)
+{
+	tegra_dc_writel(dc, GENERAL_UPDATE, DC_CMD_STATE_CONTROL);
+	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
+}
+
+/*
+ * Sets the cursor image, two 1bpp bitmaps (color, then mask; 32x32 or
+ * 64x64) at the 1KB aligned phys_addr. Colors are 0x00rrggbb.
+ */
+int tegra_dc_set_cursor_image(struct tegra_dc *dc, dma_addr_t phys_addr,
+			      bool size_64, u32 foreground, u32 background)
+{
+	if (!phys_addr || (phys_addr & ~CURSOR_START_ADDR_MASK))
+		return -EINVAL;
+
+	mutex_lock(&dc->lock);
+	dc->cursor.phys_addr = phys_addr;
+	dc->cursor.size_64 = size_64;
+	dc->cursor.foreground = foreground;
+	dc->cursor.background = background;
+
+	if (dc->enabled) {
+		tegra_dc_hold_dc_out(dc);
+		tegra_dc_cursor_write_image(dc);
+		tegra_dc_cursor_write_position(dc);
+		tegra_dc_cursor_latch(dc);
+		tegra_dc_release_dc_out(dc);
+	}
+	mutex_unlock(&dc->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_dc_set_cursor_image);
+
+/* moves and shows or hides the cursor without touching any window */
+int tegra_dc_set_cursor(struct tegra_dc *dc, int x, int y, bool visible)
+{
+	mutex_lock(&dc->lock);
+	dc->cursor.x = x;
+	dc->cursor.y = y;
+	dc->cursor.visible = visible;
+
+	if (dc->enabled) {
+		tegra_dc_hold_dc_out(dc);
+		tegra_dc_cursor_write_position(dc);
+		tegra_dc_cursor_latch(dc);
+		tegra_dc_release_dc_out(dc);
+	}
+	mutex_unlock(&dc->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_dc_set_cursor);
+
 static void tegra_dc_vblank(struct work_struct *work)
 {
 	struct tegra_dc *dc = container_of(work, struct tegra_dc, vblank_work);
@@ -991,6 +1203,7 @@ static void tegra_dc_underflow_handler(struct tegra_dc *dc)
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		if (dc->underflow_mask & (WIN_A_UF_INT << i)) {
 			dc->windows[i].underflows++;
+			tegra_dc_la_underflow(dc, i);
 
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
 			if (dc->windows[i].underflows > 4) {
@@ -1046,6 +1259,8 @@ static void tegra_dc_one_shot_irq(struct tegra_dc *dc, unsigned long status)
 	}
 
 	if (status & V_BLANK_INT) {
+		tegra_dc_record_frame(dc, ktime_get());
+
 		/* Sync up windows. */
 		tegra_dc_trigger_windows(dc);
 
@@ -1072,6 +1287,8 @@ static void tegra_dc_continuous_irq(struct tegra_dc *dc, unsigned long status)
 		dc->frame_end_timestamp = timespec_to_ns(&tm);
 		wake_up(&dc->timestamp_wq);
 #endif /* !CONFIG_ANDROID */
+		dc->frame_end_time = ktime_get();
+		tegra_dc_record_frame(dc, dc->frame_end_time);
 
 		/* Mark the frame_end as complete. */
 		if (!completion_done(&dc->frame_end_complete))
@@ -1133,6 +1350,10 @@ static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 
 	/* Check underflow */
 	if (underflow_mask) {
+		spin_lock(&dc->frame_stats.lock);
+		dc->frame_stats.underflow_mask |= underflow_mask / WIN_A_UF_INT;
+		spin_unlock(&dc->frame_stats.lock);
+
 		dc->underflow_mask |= underflow_mask;
 		schedule_delayed_work(&dc->underflow_work,
 			msecs_to_jiffies(1));
@@ -1368,6 +1589,12 @@ static bool _tegra_dc_controller_enable(struct tegra_dc *dc)
 	if (dc->out_ops && dc->out_ops->enable)
 		dc->out_ops->enable(dc);
 
+	/* the output enable rewrites DC_DISP_DISP_WIN_OPTIONS */
+	if (dc->cursor.phys_addr) {
+		tegra_dc_cursor_write_image(dc);
+		tegra_dc_cursor_write_position(dc);
+	}
+
 	/* force a full blending update */
 	dc->blend.z[0] = -1;
 
@@ -1589,10 +1816,14 @@ void tegra_dc_disable(struct tegra_dc *dc)
 	/* it's important that new underflow work isn't scheduled before the
 	 * lock is acquired. */
 	cancel_delayed_work_sync(&dc->underflow_work);
+	cancel_delayed_work_sync(&dc->emc_reclaim_work);
+	tegra_dc_idle_cancel(dc);
 
 	mutex_lock(&dc->lock);
 
 	if (dc->enabled) {
+		/* come back at the full refresh rate */
+		tegra_dc_idle_exit(dc);
 		dc->enabled = false;
 
 		if (!dc->suspended)
@@ -1793,6 +2024,7 @@ static int tegra_dc_probe(struct nvhost_device *ndev,
 	mutex_init(&dc->lock);
 	mutex_init(&dc->one_shot_lock);
 	init_completion(&dc->frame_end_complete);
+	spin_lock_init(&dc->frame_stats.lock);
 	init_waitqueue_head(&dc->wq);
 #ifndef CONFIG_ANDROID
 	init_waitqueue_head(&dc->timestamp_wq);
@@ -1804,6 +2036,8 @@ static int tegra_dc_probe(struct nvhost_device *ndev,
 	dc->vblank_ref_count = 0;
 	INIT_DELAYED_WORK(&dc->underflow_work, tegra_dc_underflow_worker);
 	INIT_DELAYED_WORK(&dc->one_shot_work, tegra_dc_one_shot_worker);
+	INIT_DELAYED_WORK(&dc->emc_reclaim_work, tegra_dc_emc_reclaim_worker);
+	tegra_dc_idle_init(dc);
 
 	tegra_dc_init_lut_defaults(&dc->fb_lut);
 
@@ -1857,6 +2091,9 @@ static int tegra_dc_probe(struct nvhost_device *ndev,
 	disable_dc_irq(irq);
 
 	mutex_lock(&dc->lock);
+	if ((dc->pdata->flags & TEGRA_DC_FLAG_ENABLED) &&
+	    (dc->pdata->flags & TEGRA_DC_FLAG_BOOT_HANDOFF) && dc->out)
+		tegra_dc_adopt_boot_mode(dc);
 	if (dc->pdata->flags & TEGRA_DC_FLAG_ENABLED)
 		dc->enabled = _tegra_dc_enable(dc);
 	mutex_unlock(&dc->lock);
@@ -1933,6 +2170,8 @@ static int tegra_dc_remove(struct nvhost_device *ndev)
 	}
 
 	tegra_dc_ext_disable(dc->ext);
+	cancel_delayed_work_sync(&dc->emc_reclaim_work);
+	tegra_dc_idle_cancel(dc);
 
 	if (dc->ext)
 		tegra_dc_ext_unregister(dc->ext);
@@ -1963,6 +2202,8 @@ static int tegra_dc_suspend(struct nvhost_device *ndev, pm_message_t state)
 	dev_info(&ndev->dev, "suspend\n");
 
 	tegra_dc_ext_disable(dc->ext);
+	cancel_delayed_work_sync(&dc->emc_reclaim_work);
+	tegra_dc_idle_cancel(dc);
 
 	mutex_lock(&dc->lock);
 
@@ -1970,6 +2211,7 @@ static int tegra_dc_suspend(struct nvhost_device *ndev, pm_message_t state)
 		dc->out_ops->suspend(dc);
 
 	if (dc->enabled) {
+		tegra_dc_idle_exit(dc);
 		_tegra_dc_disable(dc);
 
 		dc->suspended = true;
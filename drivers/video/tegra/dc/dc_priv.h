@@ -22,6 +22,7 @@
 
 #include <linux/io.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
 #include <linux/wait.h>
 #include <linux/fb.h>
 #include <linux/clk.h>
@@ -90,6 +91,9 @@ struct tegra_dc_out_ops {
 			struct fb_videomode *mode);
 };
 
+/* per-frame statistics kept, must be a power of two */
+#define TEGRA_DC_FRAME_STATS_LEN	64
+
 struct tegra_dc {
 	struct nvhost_device		*ndev;
 	struct tegra_dc_platform_data	*pdata;
@@ -147,6 +151,8 @@ struct tegra_dc {
 #endif
 
 	struct completion		frame_end_complete;
+	/* monotonic time of the last frame end interrupt */
+	ktime_t				frame_end_time;
 
 	struct work_struct		vblank_work;
 	long				vblank_ref_count;
@@ -158,6 +164,28 @@ struct tegra_dc {
 		u64			underflows_c;
 	} stats;
 
+	/* per-frame ring, filled from the frame end interrupt */
+	struct {
+		spinlock_t		lock;
+		u32			frame;
+		/* windows with an update waiting to be latched */
+		u32			pending;
+		ktime_t			flip_time[DC_N_WINDOWS];
+		u32			underflow_mask;
+		struct tegra_dc_frame_stat ring[TEGRA_DC_FRAME_STATS_LEN];
+	} frame_stats;
+
+	/* hardware cursor, restored whenever the controller is enabled */
+	struct {
+		dma_addr_t		phys_addr;	/* 0 until set */
+		bool			size_64;
+		bool			visible;
+		u32			foreground;
+		u32			background;
+		s16			x;
+		s16			y;
+	} cursor;
+
 	struct tegra_dc_ext		*ext;
 
 	struct tegra_dc_feature		*feature;
@@ -169,6 +197,20 @@ struct tegra_dc {
 	struct delayed_work		underflow_work;
 	u32				one_shot_delay_ms;
 	struct delayed_work		one_shot_work;
+	unsigned long			last_flip;
+	struct delayed_work		emc_reclaim_work;
+
+	/* reduced refresh rate of an idle panel, see idle.c */
+	struct {
+		bool			active;
+		struct tegra_dc_mode	full_mode;
+		ktime_t			enter_time;
+		unsigned long		last_active;
+		u32			entries;
+		u64			residency_us;
+		struct delayed_work	work;
+		struct work_struct	wake_work;
+	} idle;
 #ifndef CONFIG_ANDROID
 	s64				frame_end_timestamp;
 #endif /* !CONFIG_ANDROID */
@@ -201,6 +243,17 @@ static inline void tegra_dc_io_end(struct tegra_dc *dc)
 	nvhost_module_idle_ext(nvhost_get_parent(dc->ndev));
 }
 
+/* notes that an update of window idx now waits for the next frame end */
+static inline void tegra_dc_frame_stats_flip(struct tegra_dc *dc, int idx)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dc->frame_stats.lock, flags);
+	dc->frame_stats.flip_time[idx] = ktime_get();
+	dc->frame_stats.pending |= BIT(idx);
+	spin_unlock_irqrestore(&dc->frame_stats.lock, flags);
+}
+
 static inline unsigned long tegra_dc_readl(struct tegra_dc *dc,
 					   unsigned long reg)
 {
@@ -396,11 +449,31 @@ void tegra_dc_release_dc_out(struct tegra_dc *dc);
 void tegra_dc_clear_bandwidth(struct tegra_dc *dc);
 void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new);
 int tegra_dc_set_dynamic_emc(struct tegra_dc_win *windows[], int n);
+void tegra_dc_schedule_emc_reclaim(struct tegra_dc *dc);
+void tegra_dc_emc_reclaim_worker(struct work_struct *work);
+void tegra_dc_la_underflow(struct tegra_dc *dc, int win_idx);
+
+/* defined in bandwidth.c, used in ext/dev.c */
+int tegra_dc_check_bandwidth(struct tegra_dc *dc,
+	struct tegra_dc_win *windows[], int n);
 
 /* defined in mode.c, used in dc.c */
 int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode);
+bool tegra_dc_adopt_boot_mode(struct tegra_dc *dc);
 int tegra_dc_calc_refresh(const struct tegra_dc_mode *m);
 
+/* defined in mode.c, used in idle.c */
+void tegra_dc_store_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode);
+int _tegra_dc_update_mode(struct tegra_dc *dc,
+			  const struct tegra_dc_mode *mode);
+
+/* defined in idle.c, used in dc.c, mode.c and window.c */
+void tegra_dc_idle_init(struct tegra_dc *dc);
+void tegra_dc_idle_cancel(struct tegra_dc *dc);
+void tegra_dc_idle_flip(struct tegra_dc *dc);
+void tegra_dc_idle_exit(struct tegra_dc *dc);
+void tegra_dc_idle_forget(struct tegra_dc *dc);
+
 /* defined in clock.c, used in dc.c, dsi.c and hdmi.c */
 void tegra_dc_setup_clk(struct tegra_dc *dc, struct clk *clk);
 unsigned long tegra_dc_pclk_round_rate(struct tegra_dc *dc, int pclk);
@@ -21,7 +21,9 @@
 #include <linux/debugfs.h>
 #include <linux/fb.h>
 #include <linux/i2c.h>
+#include <linux/jiffies.h>
 #include <linux/seq_file.h>
+#include <linux/slab.h>
 #include <linux/vmalloc.h>
 
 #include "edid.h"
@@ -35,12 +37,25 @@ struct tegra_edid_pvt {
 	struct tegra_dc_edid		dc_edid;
 };
 
+/* parsed EDIDs of recently seen sinks, keyed by the block 0 checksum */
+#define TEGRA_EDID_CACHE_SIZE	4
+
+struct tegra_edid_cache_entry {
+	struct tegra_edid_pvt	*data;	/* holds a reference, NULL if unused */
+	struct fb_monspecs	specs;	/* owns specs.modedb */
+	unsigned long		last_used;
+};
+
 struct tegra_edid {
 	struct i2c_client	*client;
 	struct i2c_board_info	info;
 	int			bus;
 
 	struct tegra_edid_pvt	*data;
+	/* data was taken from the cache and is the one used before */
+	bool			same_sink;
+
+	struct tegra_edid_cache_entry	cache[TEGRA_EDID_CACHE_SIZE];
 
 	struct mutex		lock;
 };
@@ -334,6 +349,107 @@ static void data_release(struct kref *ref)
 	vfree(data);
 }
 
+/* installs data as the current EDID, consuming the caller's reference */
+static void tegra_edid_set_data(struct tegra_edid *edid,
+				struct tegra_edid_pvt *data, bool cached)
+{
+	struct tegra_edid_pvt *old_data;
+
+	mutex_lock(&edid->lock);
+	old_data = edid->data;
+	edid->data = data;
+	edid->same_sink = cached && old_data == data;
+	mutex_unlock(&edid->lock);
+
+	if (old_data)
+		kref_put(&old_data->refcnt, data_release);
+}
+
+static void tegra_edid_cache_release(struct tegra_edid_cache_entry *entry)
+{
+	if (!entry->data)
+		return;
+
+	kref_put(&entry->data->refcnt, data_release);
+	fb_destroy_modedb(entry->specs.modedb);
+	memset(entry, 0, sizeof(*entry));
+}
+
+/* a cached sink whose block 0 matches the one just read, called with
+ * edid->lock held */
+static struct tegra_edid_cache_entry *tegra_edid_cache_lookup(
+	struct tegra_edid *edid, const u8 *block0)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_EDID_CACHE_SIZE; i++) {
+		struct tegra_edid_cache_entry *entry = &edid->cache[i];
+
+		if (entry->data &&
+		    entry->data->dc_edid.buf[127] == block0[127] &&
+		    !memcmp(entry->data->dc_edid.buf, block0, 128))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* remembers a freshly parsed sink in place of the least recently used one,
+ * called with edid->lock held */
+static void tegra_edid_cache_insert(struct tegra_edid *edid,
+	struct tegra_edid_pvt *data, const struct fb_monspecs *specs)
+{
+	struct tegra_edid_cache_entry *entry = &edid->cache[0];
+	struct fb_videomode *modedb;
+	int i;
+
+	for (i = 1; i < TEGRA_EDID_CACHE_SIZE && entry->data; i++)
+		if (!edid->cache[i].data ||
+		    time_before(edid->cache[i].last_used, entry->last_used))
+			entry = &edid->cache[i];
+
+	modedb = kmemdup(specs->modedb,
+		specs->modedb_len * sizeof(*specs->modedb), GFP_KERNEL);
+	if (!modedb)
+		return;
+
+	tegra_edid_cache_release(entry);
+	kref_get(&data->refcnt);
+	entry->data = data;
+	entry->specs = *specs;
+	entry->specs.modedb = modedb;
+	entry->last_used = jiffies;
+}
+
+/* fills specs from a cached sink, skipping the extension blocks */
+static int tegra_edid_use_cached(struct tegra_edid *edid, const u8 *block0,
+				 struct fb_monspecs *specs)
+{
+	struct tegra_edid_cache_entry *entry;
+	struct tegra_edid_pvt *data = NULL;
+
+	mutex_lock(&edid->lock);
+	entry = tegra_edid_cache_lookup(edid, block0);
+	if (entry) {
+		*specs = entry->specs;
+		specs->modedb = kmemdup(entry->specs.modedb,
+			entry->specs.modedb_len * sizeof(*specs->modedb),
+			GFP_KERNEL);
+		if (specs->modedb) {
+			entry->last_used = jiffies;
+			data = entry->data;
+			kref_get(&data->refcnt);
+		}
+	}
+	mutex_unlock(&edid->lock);
+
+	if (!data)
+		return -ENOENT;
+
+	tegra_edid_set_data(edid, data, true);
+	return 0;
+}
+
 int tegra_edid_get_monspecs_test(struct tegra_edid *edid,
 			struct fb_monspecs *specs, unsigned char *edid_ptr)
 {
@@ -419,7 +535,7 @@ int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 	int j;
 	int ret;
 	int extension_blocks;
-	struct tegra_edid_pvt *new_data, *old_data;
+	struct tegra_edid_pvt *new_data;
 	u8 *data;
 
 	new_data = vmalloc(SZ_32K + sizeof(struct tegra_edid_pvt));
@@ -436,6 +552,12 @@ int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 	if (ret)
 		goto fail;
 
+	/* a sink seen before: its extension blocks need not be read again */
+	if (!tegra_edid_use_cached(edid, data, specs)) {
+		vfree(new_data);
+		return 0;
+	}
+
 	memset(specs, 0x0, sizeof(struct fb_monspecs));
 	memset(&new_data->eld, 0x0, sizeof(new_data->eld));
 	fb_edid_to_monspecs(data, specs);
@@ -481,12 +603,10 @@ int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 	new_data->dc_edid.len = i * 128;
 
 	mutex_lock(&edid->lock);
-	old_data = edid->data;
-	edid->data = new_data;
+	tegra_edid_cache_insert(edid, new_data, specs);
 	mutex_unlock(&edid->lock);
 
-	if (old_data)
-		kref_put(&old_data->refcnt, data_release);
+	tegra_edid_set_data(edid, new_data, false);
 
 	tegra_edid_dump(edid);
 	return 0;
@@ -496,6 +616,18 @@ fail:
 	return ret;
 }
 
+/* true if the last tegra_edid_get_monspecs() found the sink read before it */
+bool tegra_edid_same_sink(struct tegra_edid *edid)
+{
+	bool same;
+
+	mutex_lock(&edid->lock);
+	same = edid->same_sink;
+	mutex_unlock(&edid->lock);
+
+	return same;
+}
+
 int tegra_edid_underscan_supported(struct tegra_edid *edid)
 {
 	if ((!edid) || (!edid->data))
@@ -558,6 +690,11 @@ free_edid:
 
 void tegra_edid_destroy(struct tegra_edid *edid)
 {
+	int i;
+
+	for (i = 0; i < TEGRA_EDID_CACHE_SIZE; i++)
+		tegra_edid_cache_release(&edid->cache[i]);
+
 	i2c_release_client(edid->client);
 	if (edid->data)
 		kref_put(&edid->data->refcnt, data_release);
@@ -58,29 +58,8 @@ int tegra_dc_ext_put_cursor(struct tegra_dc_ext_user *user)
 	return ret;
 }
 
-static void set_cursor_image_hw(struct tegra_dc *dc,
-				struct tegra_dc_ext_cursor_image *args,
-				dma_addr_t phys_addr)
-{
-	tegra_dc_writel(dc,
-		CURSOR_COLOR(args->foreground.r,
-			     args->foreground.g,
-			     args->foreground.b),
-		DC_DISP_CURSOR_FOREGROUND);
-	tegra_dc_writel(dc,
-		CURSOR_COLOR(args->background.r,
-			     args->background.g,
-			     args->background.b),
-		DC_DISP_CURSOR_BACKGROUND);
-
-	BUG_ON(phys_addr & ~CURSOR_START_ADDR_MASK);
-
-	tegra_dc_writel(dc,
-		CURSOR_START_ADDR(((unsigned long) phys_addr)) |
-		((args->flags & TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_64x64) ?
-			CURSOR_SIZE_64 : 0),
-		DC_DISP_CURSOR_START_ADDR);
-}
+/* the foreground/background colors as 0x00rrggbb */
+#define CURSOR_EXT_RGB(c)	(((c).r << 16) | ((c).g << 8) | (c).b)
 
 int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
 				  struct tegra_dc_ext_cursor_image *args)
@@ -116,22 +95,17 @@ int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
 
 	old_handle = ext->cursor.cur_handle;
 
-	ret = tegra_dc_ext_pin_window(user, args->buff_id, &handle, &phys_addr);
+	ret = tegra_dc_ext_pin_window(user, args->buff_id, false,
+				      &handle, &phys_addr);
 	if (ret)
 		goto unlock;
 
 	ext->cursor.cur_handle = handle;
 
-	mutex_lock(&dc->lock);
-
-	set_cursor_image_hw(dc, args, phys_addr);
-
-	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
-	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
-
-	/* XXX sync here? */
-
-	mutex_unlock(&dc->lock);
+	tegra_dc_set_cursor_image(dc, phys_addr,
+		size == TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_64x64,
+		CURSOR_EXT_RGB(args->foreground),
+		CURSOR_EXT_RGB(args->background));
 
 	mutex_unlock(&ext->cursor.lock);
 
@@ -153,7 +127,6 @@ int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc *dc = ext->dc;
-	u32 win_options;
 	bool enable;
 	int ret;
 
@@ -171,26 +144,7 @@ int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 
 	enable = !!(args->flags & TEGRA_DC_EXT_CURSOR_FLAGS_VISIBLE);
 
-	mutex_lock(&dc->lock);
-
-	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
-	if (!!(win_options & CURSOR_ENABLE) != enable) {
-		win_options &= ~CURSOR_ENABLE;
-		if (enable)
-			win_options |= CURSOR_ENABLE;
-		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
-	}
-
-	tegra_dc_writel(dc, CURSOR_POSITION(args->x, args->y),
-		DC_DISP_CURSOR_POSITION);
-
-	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
-	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
-
-	/* TODO: need to sync here?  hopefully can avoid this, but need to
-	 * figure out interaction w/ rest of GENERAL_ACT_REQ */
-
-	mutex_unlock(&dc->lock);
+	tegra_dc_set_cursor(dc, args->x, args->y, enable);
 
 	mutex_unlock(&ext->cursor.lock);
 
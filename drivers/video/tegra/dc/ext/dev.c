@@ -18,8 +18,10 @@
  * more details.
  */
 
+#include <linux/err.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/nvhost.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
@@ -50,6 +52,7 @@ struct tegra_dc_ext_flip_win {
 	dma_addr_t				phys_addr_u;
 	dma_addr_t				phys_addr_v;
 	u32					syncpt_max;
+	struct nvhost_fence			*pre_fence;
 };
 
 struct tegra_dc_ext_flip_data {
@@ -125,7 +128,7 @@ static int tegra_dc_ext_put_window(struct tegra_dc_ext_user *user,
 	mutex_lock(&win->lock);
 
 	if (win->user == user) {
-		flush_workqueue(win->flip_wq);
+		flush_workqueue(ext->flip_wq);
 		win->user = 0;
 	} else {
 		ret = -EACCES;
@@ -162,18 +165,13 @@ void tegra_dc_ext_enable(struct tegra_dc_ext *ext)
 
 void tegra_dc_ext_disable(struct tegra_dc_ext *ext)
 {
-	int i;
 	set_enable(ext, false);
 
 	/*
 	 * Flush the flip queue -- note that this must be called with dc->lock
 	 * unlocked or else it will hang.
 	 */
-	for (i = 0; i < ext->dc->n_windows; i++) {
-		struct tegra_dc_ext_win *win = &ext->win[i];
-
-		flush_workqueue(win->flip_wq);
-	}
+	flush_workqueue(ext->flip_wq);
 }
 
 int tegra_dc_ext_check_windowattr(struct tegra_dc_ext *ext,
@@ -199,27 +197,138 @@ int tegra_dc_ext_check_windowattr(struct tegra_dc_ext *ext,
 		goto fail;
 	}
 
+	/* The window must not go outside the display's active region */
+	if (win->out_x + win->out_w > dc->mode.h_active ||
+	    win->out_y + win->out_h > dc->mode.v_active) {
+		dev_err(&dc->ndev->dev, "Position of window %d is"
+						" invalid.\n", win->idx);
+		goto fail;
+	}
+
+	/* Check the source rectangle against the window's scaler */
+	if (win->w.full < dfixed_const(1) || win->h.full < dfixed_const(1))
+		goto fail;
+
+	if (!tegra_dc_feature_has_scaling(dc, win->idx)) {
+		if (dfixed_trunc(win->w) != win->out_w ||
+		    dfixed_trunc(win->h) != win->out_h) {
+			dev_err(&dc->ndev->dev, "Window %d can't"
+						" scale.\n", win->idx);
+			goto fail;
+		}
+	} else {
+		/* the DDA increments saturate beyond these, see
+		 * compute_dda_inc() */
+		unsigned Bpp_bw = tegra_dc_fmt_bpp(win->fmt) / 8 *
+			(tegra_dc_is_yuv_planar(win->fmt) ? 2 : 1);
+		u32 max_h = Bpp_bw == 2 ? 8 : 4;
+		u32 max_v = 15;
+
+		if (win->w.full - dfixed_const(1) >
+			dfixed_const(max_h * max_t(u32, win->out_w - 1, 1)) ||
+		    win->h.full - dfixed_const(1) >
+			dfixed_const(max_v * max_t(u32, win->out_h - 1, 1))) {
+			dev_err(&dc->ndev->dev, "Downscaling of window %d is"
+						" out of range.\n", win->idx);
+			goto fail;
+		}
+	}
+
 	return 0;
 fail:
 	return -EINVAL;
 }
 
-static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
-			       struct tegra_dc_win *win,
-			       const struct tegra_dc_ext_flip_win *flip_win)
+/* size of a chroma plane in pixels and lines for a luma rectangle */
+static void tegra_dc_ext_chroma_size(int fmt, unsigned *w, unsigned *h)
 {
-	int err = 0;
-	struct tegra_dc_ext_win *ext_win = &ext->win[win->idx];
-#ifndef CONFIG_ANDROID
-	s64 timestamp_ns;
-#endif /* !CONFIG_ANDROID */
+	switch (fmt) {
+	case TEGRA_WIN_FMT_YCbCr420P:
+	case TEGRA_WIN_FMT_YUV420P:
+		*w = DIV_ROUND_UP(*w, 2);
+		*h = DIV_ROUND_UP(*h, 2);
+		break;
+	case TEGRA_WIN_FMT_YCbCr422P:
+	case TEGRA_WIN_FMT_YUV422P:
+		*w = DIV_ROUND_UP(*w, 2);
+		break;
+	default:
+		/* the 422R formats are subsampled vertically only */
+		*h = DIV_ROUND_UP(*h, 2);
+		break;
+	}
+}
 
-	if (flip_win->handle[TEGRA_DC_Y] == NULL) {
-		win->flags = 0;
-		memset(ext_win->cur_handle, 0, sizeof(ext_win->cur_handle));
+/* first whole pixel or line past a fixed-point source span */
+static unsigned tegra_dc_ext_fixed_end(fixed20_12 pos, fixed20_12 size)
+{
+	u32 frac = dfixed_frac(pos) + dfixed_frac(size);
+
+	return dfixed_trunc(pos) + dfixed_trunc(size) +
+		DIV_ROUND_UP(frac, dfixed_const(1));
+}
+
+/* the lines a plane is fetched from must fit its stride and buffer */
+static int tegra_dc_ext_check_plane(struct nvmap_handle_ref *ref, u32 offset,
+				    u32 stride, unsigned row_bytes,
+				    unsigned rows)
+{
+	u64 end;
+
+	if (stride < row_bytes)
+		return -EINVAL;
+
+	end = (u64)offset + (u64)(rows - 1) * stride + row_bytes;
+	if (end > ref->handle->size)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* checks that scanout of flip_win stays inside the buffers it pinned */
+static int tegra_dc_ext_check_buffers(struct tegra_dc_ext *ext,
+		const struct tegra_dc_win *win,
+		const struct tegra_dc_ext_flip_win *flip_win)
+{
+	const struct tegra_dc_ext_flip_windowattr *attr = &flip_win->attr;
+	struct nvmap_handle_ref *ref;
+	unsigned w, h;
+	int err;
+
+	/* tiled surfaces aren't laid out in lines */
+	if (WIN_IS_TILED(win))
 		return 0;
-	}
 
+	w = tegra_dc_ext_fixed_end(win->x, win->w);
+	h = tegra_dc_ext_fixed_end(win->y, win->h);
+
+	err = tegra_dc_ext_check_plane(flip_win->handle[TEGRA_DC_Y],
+			attr->offset, attr->stride,
+			DIV_ROUND_UP(w * tegra_dc_fmt_bpp(win->fmt), 8), h);
+	if (err || !tegra_dc_is_yuv_planar(win->fmt))
+		goto out;
+
+	tegra_dc_ext_chroma_size(win->fmt, &w, &h);
+
+	ref = flip_win->handle[TEGRA_DC_U] ?: flip_win->handle[TEGRA_DC_Y];
+	err = tegra_dc_ext_check_plane(ref, attr->offset_u, attr->stride_uv,
+			w, h);
+	if (err)
+		goto out;
+
+	ref = flip_win->handle[TEGRA_DC_V] ?: flip_win->handle[TEGRA_DC_Y];
+	err = tegra_dc_ext_check_plane(ref, attr->offset_v, attr->stride_uv,
+			w, h);
+out:
+	if (err)
+		dev_err(&ext->dc->ndev->dev, "Window %d reads outside of its"
+						" buffer.\n", win->idx);
+	return err;
+}
+
+static void tegra_dc_ext_fill_win(struct tegra_dc_win *win,
+				  const struct tegra_dc_ext_flip_win *flip_win)
+{
 	win->flags = TEGRA_WIN_FLAG_ENABLED;
 	if (flip_win->attr.blend == TEGRA_DC_EXT_BLEND_PREMULT)
 		win->flags |= TEGRA_WIN_FLAG_BLEND_PREMULT;
@@ -240,16 +349,12 @@ static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 	win->y.full = flip_win->attr.y;
 	win->w.full = flip_win->attr.w;
 	win->h.full = flip_win->attr.h;
-	/* XXX verify that this doesn't go outside display's active region */
 	win->out_x = flip_win->attr.out_x;
 	win->out_y = flip_win->attr.out_y;
 	win->out_w = flip_win->attr.out_w;
 	win->out_h = flip_win->attr.out_h;
 	win->z = flip_win->attr.z;
-	memcpy(ext_win->cur_handle, flip_win->handle,
-	       sizeof(ext_win->cur_handle));
 
-	/* XXX verify that this won't read outside of the surface */
 	win->phys_addr = flip_win->phys_addr + flip_win->attr.offset;
 
 	win->phys_addr_u = flip_win->handle[TEGRA_DC_U] ?
@@ -262,20 +367,33 @@ static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 
 	win->stride = flip_win->attr.stride;
 	win->stride_uv = flip_win->attr.stride_uv;
+}
+
+static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
+			       struct tegra_dc_win *win,
+			       const struct tegra_dc_ext_flip_win *flip_win)
+{
+	int err = 0;
+	struct tegra_dc_ext_win *ext_win = &ext->win[win->idx];
+#ifndef CONFIG_ANDROID
+	s64 timestamp_ns;
+#endif /* !CONFIG_ANDROID */
+
+	if (flip_win->handle[TEGRA_DC_Y] == NULL) {
+		win->flags = 0;
+		memset(ext_win->cur_handle, 0, sizeof(ext_win->cur_handle));
+		return 0;
+	}
+
+	tegra_dc_ext_fill_win(win, flip_win);
+	memcpy(ext_win->cur_handle, flip_win->handle,
+	       sizeof(ext_win->cur_handle));
 
 	err = tegra_dc_ext_check_windowattr(ext, win);
 	if (err < 0)
 		dev_err(&ext->dc->ndev->dev,
 				"Window atrributes are invalid.\n");
 
-	if ((s32)flip_win->attr.pre_syncpt_id >= 0) {
-		nvhost_syncpt_wait_timeout(
-				&nvhost_get_host(ext->dc->ndev)->syncpt,
-				flip_win->attr.pre_syncpt_id,
-				flip_win->attr.pre_syncpt_val,
-				msecs_to_jiffies(500), NULL);
-	}
-
 #ifndef CONFIG_ANDROID
 #ifndef CONFIG_TEGRA_SIMULATION_PLATFORM
 	timestamp_ns = timespec_to_ns(&flip_win->attr.timestamp);
@@ -331,6 +449,48 @@ int tegra_dc_unset_flip_callback()
 }
 EXPORT_SYMBOL(tegra_dc_unset_flip_callback);
 
+static void tegra_dc_ext_put_pre_fences(struct tegra_dc_ext_flip_data *data)
+{
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		if (!data->win[i].pre_fence)
+			continue;
+
+		nvhost_fence_put(data->win[i].pre_fence);
+		data->win[i].pre_fence = NULL;
+	}
+}
+
+/*
+ * Waits for the pre-fences of every window that is about to be programmed
+ * before any window state is touched, so that a buffer that is still being
+ * rendered can never be latched at a vblank behind the worker's back.
+ */
+static void tegra_dc_ext_wait_pre_fences(struct tegra_dc_ext *ext,
+		struct tegra_dc_ext_flip_data *data, u8 apply_mask)
+{
+	struct nvhost_syncpt *sp = &nvhost_get_host(ext->dc->ndev)->syncpt;
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+
+		if (!(apply_mask & BIT(i)) || !flip_win->handle[TEGRA_DC_Y])
+			continue;
+
+		if ((s32)flip_win->attr.pre_syncpt_id >= 0)
+			nvhost_syncpt_wait_timeout(sp,
+					flip_win->attr.pre_syncpt_id,
+					flip_win->attr.pre_syncpt_val,
+					msecs_to_jiffies(500), NULL);
+
+		if (flip_win->pre_fence)
+			nvhost_fence_wait(flip_win->pre_fence,
+					msecs_to_jiffies(500));
+	}
+}
+
 static void tegra_dc_ext_flip_worker(struct work_struct *work)
 {
 	struct tegra_dc_ext_flip_data *data =
@@ -342,6 +502,7 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 	struct nvmap_handle_ref *old_handle;
 	int i, nr_unpin = 0, nr_win = 0;
 	bool skip_flip = false;
+	u8 apply_mask = 0;
 
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
@@ -407,11 +568,24 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 		}
 
 		if (!skip_flip)
-			tegra_dc_ext_set_windowattr(ext, win, &data->win[i]);
+			apply_mask |= BIT(i);
 
 		wins[nr_win++] = win;
 	}
 
+	tegra_dc_ext_wait_pre_fences(ext, data, apply_mask);
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		struct tegra_dc_win *win;
+
+		if (!(apply_mask & BIT(i)))
+			continue;
+
+		win = tegra_dc_get_window(ext->dc, flip_win->attr.index);
+		tegra_dc_ext_set_windowattr(ext, win, flip_win);
+	}
+
 	if (!skip_flip) {
 		tegra_dc_update_windows(wins, nr_win);
 		/* TODO: implement swapinterval here */
@@ -446,6 +620,7 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 		nvmap_free(ext->nvmap, unpin_handles[i]);
 	}
 
+	tegra_dc_ext_put_pre_fences(data);
 	kfree(data);
 }
 
@@ -542,11 +717,59 @@ static int sanitize_flip_args(struct tegra_dc_ext_user *user,
 	return 0;
 }
 
+/*
+ * Validates a flip before it is queued, so that a client gets an error back
+ * instead of a window the worker can only log about: the attributes of every
+ * window against its capabilities and buffers, then the bandwidth of the
+ * resulting configuration.
+ */
+static int tegra_dc_ext_check_flip(struct tegra_dc_ext *ext,
+				   const struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_win *windows[DC_N_WINDOWS];
+	struct tegra_dc_win *wins;
+	int i, n = 0, err = 0;
+
+	wins = kcalloc(DC_N_WINDOWS, sizeof(*wins), GFP_KERNEL);
+	if (!wins)
+		return -ENOMEM;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		const struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		int index = flip_win->attr.index;
+		struct tegra_dc_win *win = &wins[n];
+
+		if (index < 0)
+			continue;
+
+		win->dc = ext->dc;
+		win->idx = index;
+		windows[n++] = win;
+
+		if (!flip_win->handle[TEGRA_DC_Y])
+			continue;
+
+		tegra_dc_ext_fill_win(win, flip_win);
+		err = tegra_dc_ext_check_windowattr(ext, win);
+		if (err)
+			goto out;
+		err = tegra_dc_ext_check_buffers(ext, win, flip_win);
+		if (err)
+			goto out;
+	}
+
+	err = tegra_dc_check_bandwidth(ext->dc, windows, n);
+out:
+	kfree(wins);
+	return err;
+}
+
 static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
-			     struct tegra_dc_ext_flip *args)
+			     struct tegra_dc_ext_flip *args, bool check_only)
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc_ext_flip_data *data;
+	u32 syncpt_vals[DC_N_WINDOWS];
 	int work_index = -1;
 	int i, ret = 0;
 #ifndef CONFIG_ANDROID
@@ -590,6 +813,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
 		int index = args->win[i].index;
+		bool is_fd;
 
 		memcpy(&flip_win->attr, &args->win[i], sizeof(flip_win->attr));
 #ifndef CONFIG_ANDROID
@@ -600,7 +824,20 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		if (index < 0)
 			continue;
 
-		ret = tegra_dc_ext_pin_window(user, flip_win->attr.buff_id,
+		if (flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_PRE_FENCE_FD) {
+			struct nvhost_fence *fence;
+
+			fence = nvhost_fence_fdget(flip_win->attr.pre_fence_fd);
+			if (IS_ERR(fence)) {
+				ret = PTR_ERR(fence);
+				goto fail_pin;
+			}
+			flip_win->pre_fence = fence;
+		}
+
+		is_fd = flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_BUFF_FD;
+		ret = tegra_dc_ext_pin_window(user,
+					      flip_win->attr.buff_id, is_fd,
 					      &flip_win->handle[TEGRA_DC_Y],
 					      &flip_win->phys_addr);
 		if (ret)
@@ -608,7 +845,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 
 		if (flip_win->attr.buff_id_u) {
 			ret = tegra_dc_ext_pin_window(user,
-					      flip_win->attr.buff_id_u,
+					      flip_win->attr.buff_id_u, is_fd,
 					      &flip_win->handle[TEGRA_DC_U],
 					      &flip_win->phys_addr_u);
 			if (ret)
@@ -620,7 +857,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 
 		if (flip_win->attr.buff_id_v) {
 			ret = tegra_dc_ext_pin_window(user,
-					      flip_win->attr.buff_id_v,
+					      flip_win->attr.buff_id_v, is_fd,
 					      &flip_win->handle[TEGRA_DC_V],
 					      &flip_win->phys_addr_v);
 			if (ret)
@@ -640,6 +877,10 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		goto unlock;
 	}
 
+	ret = tegra_dc_ext_check_flip(ext, data);
+	if (ret || check_only)
+		goto unlock;
+
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		u32 syncpt_max;
 		int index = args->win[i].index;
@@ -655,6 +896,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		syncpt_max = tegra_dc_incr_syncpt_max(ext->dc, index);
 
 		data->win[i].syncpt_max = syncpt_max;
+		syncpt_vals[i] = syncpt_max;
 
 		/*
 		 * Any of these windows' syncpoints should be equivalent for
@@ -677,10 +919,27 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		mutex_unlock(&ext->win[work_index].queue_lock);
 	}
 #endif /* !CONFIG_ANDROID */
-	queue_work(ext->win[work_index].flip_wq, &data->work);
+	queue_work(ext->flip_wq, &data->work);
 
 	unlock_windows_for_flip(user, args);
 
+	/*
+	 * The flip is committed at this point, so a release fence that cannot
+	 * be created is reported in its fd field rather than failing the call.
+	 */
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_windowattr *attr = &args->win[i];
+
+		if (attr->index < 0 ||
+		    !(attr->flags & TEGRA_DC_EXT_FLIP_FLAG_POST_FENCE_FD))
+			continue;
+
+		attr->post_fence_fd = nvhost_fence_create_syncpt_fd(
+				ext->dc->ndev,
+				tegra_dc_get_syncpt_id(ext->dc, attr->index),
+				syncpt_vals[i]);
+	}
+
 	return 0;
 
 unlock:
@@ -697,6 +956,7 @@ fail_pin:
 			nvmap_free(ext->nvmap, data->win[i].handle[j]);
 		}
 	}
+	tegra_dc_ext_put_pre_fences(data);
 	kfree(data);
 
 	return ret;
@@ -841,6 +1101,39 @@ static int tegra_dc_ext_get_feature(struct tegra_dc_ext_user *user,
 	return 0;
 }
 
+static int tegra_dc_ext_get_frame_stats(struct tegra_dc_ext_user *user,
+					struct tegra_dc_ext_frame_stats *args)
+{
+	struct tegra_dc *dc = user->ext->dc;
+	struct tegra_dc_frame_stat *stats;
+	struct tegra_dc_ext_frame_stat out;
+	int i, n;
+
+	n = min_t(u32, args->count, TEGRA_DC_FRAME_STATS_LEN);
+	stats = kmalloc(n * sizeof(*stats), GFP_KERNEL);
+	if (n && !stats)
+		return -ENOMEM;
+
+	n = tegra_dc_get_frame_stats(dc, &args->start, stats, n, &args->next);
+
+	for (i = 0; i < n; i++) {
+		out.timestamp_ns = stats[i].timestamp_ns;
+		out.frame = stats[i].frame;
+		out.flips = stats[i].flips;
+		out.underflow_mask = stats[i].underflow_mask;
+		out.latency_us = stats[i].latency_us;
+
+		if (copy_to_user(&args->stats[i], &out, sizeof(out))) {
+			kfree(stats);
+			return -EFAULT;
+		}
+	}
+	args->count = n;
+
+	kfree(stats);
+	return 0;
+}
+
 static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 			   unsigned long arg)
 {
@@ -864,13 +1157,22 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		if (copy_from_user(&args, user_arg, sizeof(args)))
 			return -EFAULT;
 
-		ret = tegra_dc_ext_flip(user, &args);
+		ret = tegra_dc_ext_flip(user, &args, false);
 
 		if (copy_to_user(user_arg, &args, sizeof(args)))
 			return -EFAULT;
 
 		return ret;
 	}
+	case TEGRA_DC_EXT_CHECK_FLIP:
+	{
+		struct tegra_dc_ext_flip args;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		return tegra_dc_ext_flip(user, &args, true);
+	}
 
 	case TEGRA_DC_EXT_GET_CURSOR:
 		return tegra_dc_ext_get_cursor(user);
@@ -954,6 +1256,24 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		return ret;
 	}
 
+	case TEGRA_DC_EXT_GET_FRAME_STATS:
+	{
+		struct tegra_dc_ext_frame_stats args;
+		int ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		ret = tegra_dc_ext_get_frame_stats(user, &args);
+		if (ret)
+			return ret;
+
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return 0;
+	}
+
 	default:
 		return -EINVAL;
 	}
@@ -999,23 +1319,20 @@ static int tegra_dc_release(struct inode *inode, struct file *filp)
 
 static int tegra_dc_ext_setup_windows(struct tegra_dc_ext *ext)
 {
-	int i, ret;
+	char name[32];
+	int i;
+
+	snprintf(name, sizeof(name), "tegradc.%d/flip", ext->dc->ndev->id);
+	ext->flip_wq = create_singlethread_workqueue(name);
+	if (!ext->flip_wq)
+		return -ENOMEM;
 
 	for (i = 0; i < ext->dc->n_windows; i++) {
 		struct tegra_dc_ext_win *win = &ext->win[i];
-		char name[32];
 
 		win->ext = ext;
 		win->idx = i;
 
-		snprintf(name, sizeof(name), "tegradc.%d/%c",
-			 ext->dc->ndev->id, 'a' + i);
-		win->flip_wq = create_singlethread_workqueue(name);
-		if (!win->flip_wq) {
-			ret = -ENOMEM;
-			goto cleanup;
-		}
-
 		mutex_init(&win->lock);
 #ifndef CONFIG_ANDROID
 		mutex_init(&win->queue_lock);
@@ -1024,14 +1341,6 @@ static int tegra_dc_ext_setup_windows(struct tegra_dc_ext *ext)
 	}
 
 	return 0;
-
-cleanup:
-	while (i--) {
-		struct tegra_dc_ext_win *win = &ext->win[i];
-		destroy_workqueue(win->flip_wq);
-	}
-
-	return ret;
 }
 
 static const struct file_operations tegra_dc_devops = {
@@ -1110,14 +1419,8 @@ cleanup_alloc:
 
 void tegra_dc_ext_unregister(struct tegra_dc_ext *ext)
 {
-	int i;
-
-	for (i = 0; i < ext->dc->n_windows; i++) {
-		struct tegra_dc_ext_win *win = &ext->win[i];
-
-		flush_workqueue(win->flip_wq);
-		destroy_workqueue(win->flip_wq);
-	}
+	flush_workqueue(ext->flip_wq);
+	destroy_workqueue(ext->flip_wq);
 
 	nvmap_client_put(ext->nvmap);
 	device_del(ext->dev);
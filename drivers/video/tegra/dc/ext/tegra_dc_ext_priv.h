@@ -55,8 +55,6 @@ struct tegra_dc_ext_win {
 	/* Current nvmap handle (if any) for Y, U, V planes */
 	struct nvmap_handle_ref	*cur_handle[TEGRA_DC_NUM_PLANES];
 
-	struct workqueue_struct	*flip_wq;
-
 	atomic_t		nr_pending_flips;
 
 #ifndef CONFIG_ANDROID
@@ -76,6 +74,9 @@ struct tegra_dc_ext {
 
 	struct tegra_dc_ext_win		win[DC_N_WINDOWS];
 
+	/* flips of all windows are applied in submission order */
+	struct workqueue_struct		*flip_wq;
+
 	struct {
 		struct tegra_dc_ext_user	*user;
 		struct nvmap_handle_ref		*cur_handle;
@@ -130,6 +131,7 @@ extern int tegra_dc_ext_devno;
 extern struct class *tegra_dc_ext_class;
 
 extern int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
+				   bool is_fd,
 				   struct nvmap_handle_ref **handle,
 				   dma_addr_t *phys_addr);
 
@@ -28,6 +28,7 @@
 #include "tegra_dc_ext_priv.h"
 
 int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
+			    bool is_fd,
 			    struct nvmap_handle_ref **handle,
 			    dma_addr_t *phys_addr)
 {
@@ -43,6 +44,18 @@ int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
 		return 0;
 	}
 
+	if (is_fd) {
+		/*
+		 * A share fd is its own permission check, so the buffer can
+		 * come from another process or driver (camera, nvavp)
+		 * without being made global.
+		 */
+		win_dup = nvmap_duplicate_handle_fd(ext->nvmap, id);
+		if (IS_ERR(win_dup))
+			return PTR_ERR(win_dup);
+		goto pin;
+	}
+
 	/*
 	 * Take a reference to the buffer using the user's nvmap context, to
 	 * make sure they have permissions to access it.
@@ -64,6 +77,7 @@ int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
 	if (IS_ERR(win_dup))
 		return PTR_ERR(win_dup);
 
+pin:
 	phys = nvmap_pin(ext->nvmap, win_dup);
 	/* XXX this isn't correct for non-pointers... */
 	if (IS_ERR((void *)phys)) {
@@ -119,6 +119,9 @@ struct tegra_dc_hdmi_data {
 	bool				audio_inject_null;
 
 	bool				dvi;
+
+	/* mode driven before the last unplug, restored on replug */
+	struct tegra_dc_mode		last_mode;
 };
 
 struct tegra_dc_hdmi_data *dc_hdmi;
@@ -1348,6 +1351,9 @@ void tegra_dc_hdmi_detect_config(struct tegra_dc *dc,
 
 	hdmi->dvi = !(specs->misc & FB_MISC_HDMI);
 
+	if (tegra_edid_same_sink(hdmi->edid))
+		dev_dbg(&dc->ndev->dev, "same sink reconnected, EDID cached\n");
+
 	if (dc->fb != NULL)
 		tegra_fb_update_monspecs(dc->fb, specs, tegra_dc_hdmi_mode_filter);
 #ifdef CONFIG_SWITCH
@@ -1473,9 +1479,20 @@ static void tegra_dc_hdmi_detect_worker(struct work_struct *work)
 		container_of(to_delayed_work(work), struct tegra_dc_hdmi_data, work);
 	struct tegra_dc *dc = hdmi->dc;
 
+	/*
+	 * Bring the controller back up with the timings it had before the
+	 * unplug, so that when the same sink returns the fb mode set finds
+	 * them unchanged and leaves the running controller alone.
+	 */
+	if (!dc->enabled && !dc->mode.pclk && hdmi->last_mode.pclk &&
+	    tegra_dc_hdmi_hpd(dc))
+		tegra_dc_set_mode(dc, &hdmi->last_mode);
+
 	tegra_dc_enable(dc);
 	msleep(5);
 	if (!tegra_dc_hdmi_detect(dc)) {
+		if (dc->mode.pclk)
+			hdmi->last_mode = dc->mode;
 		tegra_dc_disable(dc);
 		tegra_fb_update_monspecs(dc->fb, NULL, NULL);
 
@@ -1870,8 +1887,14 @@ static void tegra_dc_hdmi_setup_eld_buff(struct tegra_dc *dc)
 }
 #endif
 
+/*
+ * Programs the audio source and the N/CTS and AVAL values for audio_freq.
+ * Unless restart is set, the ACR packets and the N counter keep running
+ * across the change, so that a rate change made while audio is playing
+ * doesn't make the sink drop and re-acquire the stream.
+ */
 static int tegra_dc_hdmi_setup_audio(struct tegra_dc *dc, unsigned audio_freq,
-					unsigned audio_source)
+					unsigned audio_source, bool restart)
 {
 	struct tegra_dc_hdmi_data *hdmi = tegra_dc_get_outdata(dc);
 	const struct tegra_hdmi_audio_config *config;
@@ -1911,11 +1934,12 @@ static int tegra_dc_hdmi_setup_audio(struct tegra_dc *dc, unsigned audio_freq,
 		return -EINVAL;
 	}
 
-	tegra_hdmi_writel(hdmi, 0, HDMI_NV_PDISP_HDMI_ACR_CTRL);
-
-	audio_n = AUDIO_N_RESETF | AUDIO_N_GENERATE_ALTERNALTE |
-		AUDIO_N_VALUE(config->n - 1);
-	tegra_hdmi_writel(hdmi, audio_n, HDMI_NV_PDISP_AUDIO_N);
+	audio_n = AUDIO_N_GENERATE_ALTERNALTE | AUDIO_N_VALUE(config->n - 1);
+	if (restart) {
+		tegra_hdmi_writel(hdmi, 0, HDMI_NV_PDISP_HDMI_ACR_CTRL);
+		tegra_hdmi_writel(hdmi, audio_n | AUDIO_N_RESETF,
+				  HDMI_NV_PDISP_AUDIO_N);
+	}
 
 	tegra_hdmi_writel(hdmi, ACR_SUBPACK_N(config->n) | ACR_ENABLE,
 			  HDMI_NV_PDISP_HDMI_ACR_0441_SUBPACK_HIGH);
@@ -1927,7 +1951,6 @@ static int tegra_dc_hdmi_setup_audio(struct tegra_dc *dc, unsigned audio_freq,
 			  SPARE_CTS_RESET_VAL(1),
 			  HDMI_NV_PDISP_HDMI_SPARE);
 
-	audio_n &= ~AUDIO_N_RESETF;
 	tegra_hdmi_writel(hdmi, audio_n, HDMI_NV_PDISP_AUDIO_N);
 
 #if !defined(CONFIG_ARCH_TEGRA_2x_SOC)
@@ -1977,9 +2000,16 @@ int tegra_hdmi_setup_audio_freq_source(unsigned audio_freq, unsigned audio_sourc
 		AUDIO_FREQ_96K== audio_freq ||
 		AUDIO_FREQ_176_4K== audio_freq ||
 		AUDIO_FREQ_192K== audio_freq) {
-		/* If we can program HDMI, then proceed */
-		if (hdmi->clk_enabled)
-			tegra_dc_hdmi_setup_audio(hdmi->dc, audio_freq,audio_source);
+		/*
+		 * If we can program HDMI, then proceed.  Only a change of
+		 * source needs the audio path restarted; rates are switched
+		 * on the fly, and an unchanged setup is left alone.
+		 */
+		if (hdmi->clk_enabled &&
+		    (audio_freq != hdmi->audio_freq ||
+		     audio_source != hdmi->audio_source))
+			tegra_dc_hdmi_setup_audio(hdmi->dc, audio_freq,
+				audio_source, audio_source != hdmi->audio_source);
 
 		/* Store it for using it in enable */
 		hdmi->audio_freq = audio_freq;
@@ -2331,7 +2361,7 @@ static void tegra_dc_hdmi_enable(struct tegra_dc *dc)
 
 	if (!hdmi->dvi) {
 		err = tegra_dc_hdmi_setup_audio(dc, hdmi->audio_freq,
-			hdmi->audio_source);
+			hdmi->audio_source, true);
 
 		if (err < 0)
 			hdmi->dvi = true;
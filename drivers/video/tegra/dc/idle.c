@@ -0,0 +1,280 @@
+/*
+ * drivers/video/tegra/dc/idle.c
+ *
+ * Copyright (c) 2012, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include <mach/dc.h>
+
+#include "dc_priv.h"
+
+/*
+ * Once nothing has been flipped for idle_refresh_ms, a running RGB panel is
+ * switched to about idle_refresh_hz through the seamless mode update, which
+ * cuts scanout memory traffic and pixel clock power by the same ratio. The
+ * next flip, key press or touch switches it back to the full rate; that
+ * direction is latched together with the flip and never waits.
+ */
+
+static unsigned int idle_refresh_ms = 2000;
+
+module_param_named(idle_refresh_ms, idle_refresh_ms, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int idle_refresh_hz = 40;
+
+module_param_named(idle_refresh_hz, idle_refresh_hz, uint, S_IRUGO | S_IWUSR);
+
+static bool tegra_dc_idle_supported(struct tegra_dc *dc)
+{
+	return idle_refresh_ms && idle_refresh_hz &&
+		dc->out->type == TEGRA_DC_OUT_RGB &&
+		!(dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE);
+}
+
+/* the current mode slowed down to about idle_refresh_hz with a divider of
+ * the current parent clock, false if that wouldn't be any slower */
+static bool tegra_dc_idle_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode)
+{
+	int refresh = tegra_dc_calc_refresh(&dc->mode);
+	u64 pclk;
+
+	if (refresh <= 0)
+		return false;
+
+	pclk = div_u64((u64)dc->mode.pclk * idle_refresh_hz * 1000, refresh);
+	if (pclk >= dc->mode.pclk)
+		return false;
+
+	*mode = dc->mode;
+	mode->pclk = tegra_dc_pclk_round_rate(dc, pclk);
+
+	return mode->pclk && mode->pclk < dc->mode.pclk;
+}
+
+/* called with dc->lock held */
+static void tegra_dc_idle_leave(struct tegra_dc *dc)
+{
+	dc->idle.residency_us += ktime_us_delta(ktime_get(),
+		dc->idle.enter_time);
+	dc->idle.active = false;
+}
+
+/* called with dc->lock held once the mode the idle rate was derived from
+ * has been replaced */
+void tegra_dc_idle_forget(struct tegra_dc *dc)
+{
+	if (dc->idle.active)
+		tegra_dc_idle_leave(dc);
+}
+
+/* called with dc->lock held, back to the full refresh rate at the next
+ * frame boundary */
+void tegra_dc_idle_exit(struct tegra_dc *dc)
+{
+	if (!dc->idle.active)
+		return;
+
+	if (!dc->enabled || _tegra_dc_update_mode(dc, &dc->idle.full_mode))
+		tegra_dc_store_mode(dc, &dc->idle.full_mode);
+
+	trace_printk("%s:idle refresh exit\n", dc->ndev->name);
+	tegra_dc_idle_leave(dc);
+}
+
+/* called with dc->lock held on every flip, before the windows are written
+ * so that the full rate latches along with them */
+void tegra_dc_idle_flip(struct tegra_dc *dc)
+{
+	tegra_dc_idle_exit(dc);
+
+	dc->idle.last_active = jiffies;
+	if (tegra_dc_idle_supported(dc))
+		schedule_delayed_work(&dc->idle.work,
+			msecs_to_jiffies(idle_refresh_ms));
+}
+
+static void tegra_dc_idle_worker(struct work_struct *work)
+{
+	struct tegra_dc *dc = container_of(to_delayed_work(work),
+		struct tegra_dc, idle.work);
+	unsigned long delay = msecs_to_jiffies(idle_refresh_ms);
+	struct tegra_dc_mode full_mode, mode;
+
+	mutex_lock(&dc->lock);
+
+	if (!dc->enabled || dc->suspended || dc->idle.active ||
+	    !tegra_dc_idle_supported(dc))
+		goto out;
+
+	/* a flip or input event came in after the work was queued */
+	if (time_before(jiffies, dc->idle.last_active + delay)) {
+		schedule_delayed_work(&dc->idle.work,
+			dc->idle.last_active + delay - jiffies);
+		goto out;
+	}
+
+	if (!tegra_dc_idle_mode(dc, &mode))
+		goto out;
+
+	full_mode = dc->mode;
+	if (_tegra_dc_update_mode(dc, &mode))
+		goto out;
+
+	trace_printk("%s:idle refresh enter, pclk=%d\n", dc->ndev->name,
+		mode.pclk);
+	dc->idle.full_mode = full_mode;
+	dc->idle.enter_time = ktime_get();
+	dc->idle.entries++;
+	dc->idle.active = true;
+out:
+	mutex_unlock(&dc->lock);
+}
+
+/* input usually announces a flip, have the full rate back before it */
+static void tegra_dc_idle_wake_worker(struct work_struct *work)
+{
+	struct tegra_dc *dc = container_of(work, struct tegra_dc,
+		idle.wake_work);
+
+	mutex_lock(&dc->lock);
+	if (dc->enabled && !dc->suspended)
+		tegra_dc_idle_flip(dc);
+	mutex_unlock(&dc->lock);
+}
+
+void tegra_dc_idle_init(struct tegra_dc *dc)
+{
+	INIT_DELAYED_WORK(&dc->idle.work, tegra_dc_idle_worker);
+	INIT_WORK(&dc->idle.wake_work, tegra_dc_idle_wake_worker);
+}
+
+/* called without dc->lock, before the controller is disabled */
+void tegra_dc_idle_cancel(struct tegra_dc *dc)
+{
+	cancel_delayed_work_sync(&dc->idle.work);
+	cancel_work_sync(&dc->idle.wake_work);
+}
+
+static void tegra_dc_idle_input_event(struct input_handle *handle,
+	unsigned int type, unsigned int code, int value)
+{
+	struct tegra_dc *dc;
+	unsigned i;
+
+	if (type == EV_SYN)
+		return;
+
+	for (i = 0; i < TEGRA_MAX_DC; i++) {
+		dc = tegra_dc_get_dc(i);
+		if (!dc)
+			continue;
+		dc->idle.last_active = jiffies;
+		if (dc->idle.active)
+			schedule_work(&dc->idle.wake_work);
+	}
+}
+
+static int tegra_dc_idle_input_connect(struct input_handler *handler,
+	struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "tegra-dc-idle";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void tegra_dc_idle_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id tegra_dc_idle_input_ids[] = {
+	/* multi-touch touchscreens and touchpads */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	/* single-touch touchscreens */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] = BIT_MASK(ABS_X) },
+	},
+	/* keyboards, including the Touch/Type Cover */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+		.keybit = { [BIT_WORD(KEY_A)] = BIT_MASK(KEY_A) },
+	},
+	/* mice */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_RELBIT,
+		.evbit = { BIT_MASK(EV_REL) },
+		.relbit = { BIT_MASK(REL_X) },
+	},
+	{ },
+};
+
+static struct input_handler tegra_dc_idle_input_handler = {
+	.event		= tegra_dc_idle_input_event,
+	.connect	= tegra_dc_idle_input_connect,
+	.disconnect	= tegra_dc_idle_input_disconnect,
+	.name		= "tegra-dc-idle",
+	.id_table	= tegra_dc_idle_input_ids,
+};
+
+static int __init tegra_dc_idle_input_init(void)
+{
+	return input_register_handler(&tegra_dc_idle_input_handler);
+}
+late_initcall(tegra_dc_idle_input_init);
@@ -19,6 +19,7 @@
 #include <linux/err.h>
 #include <linux/types.h>
 #include <linux/clk.h>
+#include <linux/delay.h>
 
 #include <mach/clk.h>
 #include <mach/dc.h>
@@ -274,7 +275,7 @@ static int calc_ref_to_sync(struct tegra_dc_mode *mode)
 	return 0;
 }
 
-static bool check_ref_to_sync(struct tegra_dc_mode *mode)
+static bool check_ref_to_sync(const struct tegra_dc_mode *mode)
 {
 	/* Constraint 1: H_REF_TO_SYNC + H_SYNC_WIDTH + H_BACK_PORCH > 11. */
 	if (mode->h_ref_to_sync + mode->h_sync_width + mode->h_back_porch <= 11)
@@ -355,12 +356,41 @@ static inline void print_mode(struct tegra_dc *dc,
 			const struct tegra_dc_mode *mode, const char *note) { }
 #endif /* DEBUG */
 
+static void tegra_dc_write_timings(struct tegra_dc *dc,
+				   const struct tegra_dc_mode *mode)
+{
+	tegra_dc_writel(dc, mode->h_ref_to_sync | (mode->v_ref_to_sync << 16),
+			DC_DISP_REF_TO_SYNC);
+	tegra_dc_writel(dc, mode->h_sync_width | (mode->v_sync_width << 16),
+			DC_DISP_SYNC_WIDTH);
+	tegra_dc_writel(dc, mode->h_back_porch | (mode->v_back_porch << 16),
+			DC_DISP_BACK_PORCH);
+	tegra_dc_writel(dc, mode->h_active | (mode->v_active << 16),
+			DC_DISP_DISP_ACTIVE);
+	tegra_dc_writel(dc, mode->h_front_porch | (mode->v_front_porch << 16),
+			DC_DISP_FRONT_PORCH);
+}
+
+/* the shift clock divider that makes pclk out of the current parent rate,
+ * or -EINVAL if it can't get within -1/+9% of it */
+static long tegra_dc_pclk_divider(struct tegra_dc *dc, int mode_pclk)
+{
+	unsigned long rate = tegra_dc_clk_get_rate(dc);
+	unsigned long pclk = tegra_dc_pclk_round_rate(dc, mode_pclk);
+
+	trace_printk("%s:pclk=%ld\n", dc->ndev->name, pclk);
+	if (pclk < (mode_pclk / 100 * 99) ||
+	    pclk > (mode_pclk / 100 * 109))
+		return -EINVAL;
+
+	return (rate * 2 / pclk) - 2;
+}
+
 int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode)
 {
 	unsigned long val;
 	unsigned long rate;
-	unsigned long div;
-	unsigned long pclk;
+	long div;
 
 	print_mode(dc, mode, __func__);
 
@@ -369,16 +399,7 @@ int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode)
 	tegra_dc_program_bandwidth(dc, true);
 
 	tegra_dc_writel(dc, 0x0, DC_DISP_DISP_TIMING_OPTIONS);
-	tegra_dc_writel(dc, mode->h_ref_to_sync | (mode->v_ref_to_sync << 16),
-			DC_DISP_REF_TO_SYNC);
-	tegra_dc_writel(dc, mode->h_sync_width | (mode->v_sync_width << 16),
-			DC_DISP_SYNC_WIDTH);
-	tegra_dc_writel(dc, mode->h_back_porch | (mode->v_back_porch << 16),
-			DC_DISP_BACK_PORCH);
-	tegra_dc_writel(dc, mode->h_active | (mode->v_active << 16),
-			DC_DISP_DISP_ACTIVE);
-	tegra_dc_writel(dc, mode->h_front_porch | (mode->v_front_porch << 16),
-			DC_DISP_FRONT_PORCH);
+	tegra_dc_write_timings(dc, mode);
 
 	tegra_dc_writel(dc, DE_SELECT_ACTIVE | DE_CONTROL_NORMAL,
 			DC_DISP_DATA_ENABLE_OPTIONS);
@@ -401,19 +422,16 @@ int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode)
 
 	rate = tegra_dc_clk_get_rate(dc);
 
-	pclk = tegra_dc_pclk_round_rate(dc, mode->pclk);
-	trace_printk("%s:pclk=%ld\n", dc->ndev->name, pclk);
-	if (pclk < (mode->pclk / 100 * 99) ||
-	    pclk > (mode->pclk / 100 * 109)) {
+	div = tegra_dc_pclk_divider(dc, mode->pclk);
+	if (div < 0) {
 		dev_err(&dc->ndev->dev,
 			"can't divide %ld clock to %d -1/+9%% %ld %d %d\n",
 			rate, mode->pclk,
-			pclk, (mode->pclk / 100 * 99),
+			tegra_dc_pclk_round_rate(dc, mode->pclk),
+			(mode->pclk / 100 * 99),
 			(mode->pclk / 100 * 109));
 		return -EINVAL;
 	}
-
-	div = (rate * 2 / pclk) - 2;
 	trace_printk("%s:div=%ld\n", dc->ndev->name, div);
 
 	tegra_dc_writel(dc, 0x00010001,
@@ -433,6 +451,66 @@ int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode)
 	return 0;
 }
 
+/* take over the timings a bootloader left scanning out, if they drive the
+ * same active area as the stored mode: the first modeset then rewrites the
+ * values already latched and the panel never blanks */
+bool tegra_dc_adopt_boot_mode(struct tegra_dc *dc)
+{
+	struct tegra_dc_mode mode = dc->mode;
+	unsigned long val;
+	unsigned long rate;
+	bool running;
+
+	if (!mode.pclk)
+		return false;
+
+	/* a running controller keeps running, one in reset reads as stopped */
+	clk_enable(dc->clk);
+	tegra_dc_io_start(dc);
+
+	val = tegra_dc_readl(dc, DC_CMD_DISPLAY_COMMAND);
+	running = (val & (3 << 5)) == DISP_CTRL_MODE_C_DISPLAY;
+	if (running) {
+		val = tegra_dc_readl(dc, DC_DISP_DISP_ACTIVE);
+		running = (val & 0xffff) == mode.h_active &&
+			(val >> 16) == mode.v_active;
+	}
+	if (running) {
+		val = tegra_dc_readl(dc, DC_DISP_REF_TO_SYNC);
+		mode.h_ref_to_sync = val & 0xffff;
+		mode.v_ref_to_sync = val >> 16;
+		val = tegra_dc_readl(dc, DC_DISP_SYNC_WIDTH);
+		mode.h_sync_width = val & 0xffff;
+		mode.v_sync_width = val >> 16;
+		val = tegra_dc_readl(dc, DC_DISP_BACK_PORCH);
+		mode.h_back_porch = val & 0xffff;
+		mode.v_back_porch = val >> 16;
+		val = tegra_dc_readl(dc, DC_DISP_FRONT_PORCH);
+		mode.h_front_porch = val & 0xffff;
+		mode.v_front_porch = val >> 16;
+
+		/* the inverse of tegra_dc_pclk_divider() */
+		val = tegra_dc_readl(dc, DC_DISP_DISP_CLOCK_CONTROL);
+		rate = tegra_dc_clk_get_rate(dc);
+		mode.pclk = rate * 2 / (SHIFT_CLK_DIVIDER(val) + 2);
+	}
+
+	tegra_dc_io_end(dc);
+	clk_disable(dc->clk);
+
+	if (!running)
+		return false;
+
+	/* only adopt a pixel clock the output would have picked itself */
+	if (mode.pclk < (dc->mode.pclk / 100 * 99) ||
+	    mode.pclk > (dc->mode.pclk / 100 * 109))
+		return false;
+
+	dev_info(&dc->ndev->dev, "adopting bootloader display mode\n");
+	tegra_dc_set_mode(dc, &mode);
+	return true;
+}
+
 static int panel_sync_rate;
 
 int tegra_dc_get_panel_sync_rate(void)
@@ -441,15 +519,11 @@ int tegra_dc_get_panel_sync_rate(void)
 }
 EXPORT_SYMBOL(tegra_dc_get_panel_sync_rate);
 
-int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode)
+/* makes mode the one dc->mode and everything derived from it describe */
+void tegra_dc_store_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode)
 {
 	memcpy(&dc->mode, mode, sizeof(dc->mode));
 
-	dev_info(&dc->ndev->dev, "using mode %dx%d pclk=%d href=%d vref=%d\n",
-		mode->h_active, mode->v_active, mode->pclk,
-		mode->h_ref_to_sync, mode->v_ref_to_sync
-	);
-
 	if (dc->out->type == TEGRA_DC_OUT_RGB)
 		panel_sync_rate = tegra_dc_calc_refresh(mode);
 	else if (dc->out->type == TEGRA_DC_OUT_DSI)
@@ -459,11 +533,127 @@ int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode)
 #ifndef CONFIG_ANDROID
 	dc->frametime_ns = calc_frametime_ns(mode);
 #endif /* !CONFIG_ANDROID */
+}
+
+int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode)
+{
+	/* an idle refresh rate derived from the old mode no longer applies */
+	tegra_dc_idle_forget(dc);
+	tegra_dc_store_mode(dc, mode);
+
+	dev_info(&dc->ndev->dev, "using mode %dx%d pclk=%d href=%d vref=%d\n",
+		mode->h_active, mode->v_active, mode->pclk,
+		mode->h_ref_to_sync, mode->v_ref_to_sync
+	);
 
 	return 0;
 }
 EXPORT_SYMBOL(tegra_dc_set_mode);
 
+/* a frame at the lowest refresh rate the seamless path is meant for */
+#define TEGRA_DC_MODE_LATCH_TIMEOUT_MS	50
+
+/* the compatibility check and switch of tegra_dc_update_mode(), called with
+ * dc->lock held on a running controller; only a slower mode waits for the
+ * latch, so that a faster one goes out together with a pending flip */
+int _tegra_dc_update_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode)
+{
+	struct tegra_dc_win *windows[DC_N_WINDOWS];
+	int old_pclk;
+	long div;
+	int i;
+
+	if (dc->out->type != TEGRA_DC_OUT_RGB ||
+	    (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE))
+		return -EINVAL;
+
+	if (mode->h_active != dc->mode.h_active ||
+	    mode->v_active != dc->mode.v_active ||
+	    mode->stereo_mode != dc->mode.stereo_mode ||
+	    mode->flags != dc->mode.flags ||
+	    !check_ref_to_sync(mode))
+		return -EINVAL;
+
+	div = tegra_dc_pclk_divider(dc, mode->pclk);
+	if (div < 0)
+		return -EINVAL;
+
+	old_pclk = dc->mode.pclk;
+	tegra_dc_store_mode(dc, mode);
+
+	for (i = 0; i < DC_N_WINDOWS; i++)
+		windows[i] = &dc->windows[i];
+
+	tegra_dc_hold_dc_out(dc);
+
+	/* a faster scanout needs its voltage and memory bandwidth first */
+	if (mode->pclk > old_pclk) {
+		tegra_dvfs_set_rate(dc->clk,
+				    tegra_dc_pclk_round_rate(dc, mode->pclk));
+		tegra_dc_set_dynamic_emc(windows, DC_N_WINDOWS);
+		tegra_dc_program_bandwidth(dc, true);
+	}
+
+	tegra_dc_writel(dc, WRITE_MUX_ASSEMBLY | READ_MUX_ASSEMBLY,
+			DC_CMD_STATE_ACCESS);
+	tegra_dc_write_timings(dc, mode);
+	tegra_dc_writel(dc, PIXEL_CLK_DIVIDER_PCD1 | SHIFT_CLK_DIVIDER(div),
+			DC_DISP_DISP_CLOCK_CONTROL);
+	tegra_dc_writel(dc, GENERAL_UPDATE, DC_CMD_STATE_CONTROL);
+	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
+
+	/* and a slower one only gives them back once it is on screen */
+	if (mode->pclk <= old_pclk) {
+		for (i = 0; i < TEGRA_DC_MODE_LATCH_TIMEOUT_MS; i++) {
+			if (!(tegra_dc_readl(dc, DC_CMD_STATE_CONTROL) &
+			      GENERAL_ACT_REQ))
+				break;
+			usleep_range(1000, 1500);
+		}
+		if (i == TEGRA_DC_MODE_LATCH_TIMEOUT_MS)
+			dev_warn(&dc->ndev->dev, "mode update not latched\n");
+
+		tegra_dc_set_dynamic_emc(windows, DC_N_WINDOWS);
+		tegra_dc_program_bandwidth(dc, true);
+		tegra_dvfs_set_rate(dc->clk,
+				    tegra_dc_pclk_round_rate(dc, mode->pclk));
+	}
+
+	tegra_dc_release_dc_out(dc);
+
+	return 0;
+}
+
+/*
+ * Switches a running controller to a mode that only differs from the current
+ * one in its pixel clock and blanking, e.g. the internal panel dropping from
+ * 60Hz to 40Hz for video playback, without disabling it. The parent clock is
+ * left alone: the timings and the new shift clock divider are written to the
+ * assembly state and latched together at the next frame boundary, so the
+ * panel never blanks. Returns -EINVAL when that isn't possible and a full
+ * mode set is needed instead, -ENXIO if the controller is not running.
+ */
+int tegra_dc_update_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode)
+{
+	int err;
+
+	mutex_lock(&dc->lock);
+	if (!dc->enabled) {
+		mutex_unlock(&dc->lock);
+		return -ENXIO;
+	}
+
+	err = _tegra_dc_update_mode(dc, mode);
+	if (!err)
+		tegra_dc_idle_forget(dc);
+	mutex_unlock(&dc->lock);
+
+	if (!err)
+		print_mode_info(dc, dc->mode);
+	return err;
+}
+EXPORT_SYMBOL(tegra_dc_update_mode);
+
 int tegra_dc_var_to_dc_mode(struct tegra_dc *dc, struct fb_var_screeninfo *var,
 		struct tegra_dc_mode *mode)
 {
@@ -611,6 +801,11 @@ int tegra_dc_set_fb_mode(struct tegra_dc *dc,
 	if (!(fbmode->sync & FB_SYNC_VERT_HIGH_ACT))
 		mode.flags |= TEGRA_DC_MODE_FLAG_NEG_V_SYNC;
 
+	/* a refresh rate change of the running panel takes effect right away,
+	 * anything else with the next enable */
+	if (!tegra_dc_update_mode(dc, &mode))
+		return 0;
+
 	return tegra_dc_set_mode(dc, &mode);
 }
 EXPORT_SYMBOL(tegra_dc_set_fb_mode);
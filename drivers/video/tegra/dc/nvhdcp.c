@@ -17,6 +17,8 @@
 #include <linux/kernel.h>
 #include <linux/delay.h>
 #include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/lat_hist.h>
 #include <linux/miscdevice.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
@@ -65,6 +67,27 @@ DECLARE_WAIT_QUEUE_HEAD(wq_worker);
 		pr_info("nvhdcp: " __VA_ARGS__)
 
 
+/*
+ * Receivers which authenticated recently, by Bksv.  When one of them
+ * fails link verification, or is plugged back in, authentication is
+ * retried at once rather than after the usual back-off.  If it is a
+ * repeater, it is polled for READY at a finer interval, since it has
+ * normally kept its downstream devices authenticated.
+ */
+#define NVHDCP_SINK_CACHE	4
+
+struct nvhdcp_sink {
+	u64				b_ksv;
+	u8				b_caps;
+	u16				b_status;
+	u32				num_bksv_list;
+	u64				bksv_list[TEGRA_NVHDCP_MAX_DEVS];
+	unsigned long			last_auth; /* jiffies */
+};
+
+/* hotplug or renegotiation to link verified */
+DEFINE_LAT_HIST(nvhdcp_auth_hist, "hdcp_auth");
+
 /* for nvhdcp.state */
 enum tegra_nvhdcp_state {
 	STATE_OFF,
@@ -99,6 +122,9 @@ struct tegra_nvhdcp {
 	u32				num_bksv_list;
 	u64				bksv_list[TEGRA_NVHDCP_MAX_DEVS];
 	int				fail_count;
+	struct nvhdcp_sink		sinks[NVHDCP_SINK_CACHE];
+	struct nvhdcp_sink		*sink; /* cached entry of receiver */
+	ktime_t				auth_start;
 };
 
 static inline bool nvhdcp_is_plugged(struct tegra_nvhdcp *nvhdcp)
@@ -114,6 +140,40 @@ static inline bool nvhdcp_set_plugged(struct tegra_nvhdcp *nvhdcp, bool plugged)
 	return plugged;
 }
 
+static struct nvhdcp_sink *nvhdcp_sink_find(struct tegra_nvhdcp *nvhdcp,
+					    u64 b_ksv)
+{
+	int i;
+
+	for (i = 0; i < NVHDCP_SINK_CACHE; i++)
+		if (nvhdcp->sinks[i].b_ksv == b_ksv)
+			return &nvhdcp->sinks[i];
+	return NULL;
+}
+
+/* remember the receiver just authenticated, replacing the oldest entry */
+static void nvhdcp_sink_store(struct tegra_nvhdcp *nvhdcp, u8 b_caps)
+{
+	struct nvhdcp_sink *sink = nvhdcp_sink_find(nvhdcp, nvhdcp->b_ksv);
+	int i;
+
+	if (!sink) {
+		sink = &nvhdcp->sinks[0];
+		for (i = 1; i < NVHDCP_SINK_CACHE; i++)
+			if (time_before(nvhdcp->sinks[i].last_auth,
+					sink->last_auth))
+				sink = &nvhdcp->sinks[i];
+	}
+
+	sink->b_ksv = nvhdcp->b_ksv;
+	sink->b_caps = b_caps;
+	sink->b_status = nvhdcp->b_status;
+	sink->num_bksv_list = nvhdcp->num_bksv_list;
+	memcpy(sink->bksv_list, nvhdcp->bksv_list, sizeof(sink->bksv_list));
+	sink->last_auth = jiffies;
+	nvhdcp->sink = sink;
+}
+
 static int nvhdcp_i2c_read(struct tegra_nvhdcp *nvhdcp, u8 reg,
 					size_t len, void *data)
 {
@@ -761,11 +821,12 @@ static int get_repeater_info(struct tegra_nvhdcp *nvhdcp)
 	int e, retries;
 	u8 b_caps;
 	u16 b_status = 0;
+	unsigned interval = nvhdcp->sink ? 10 : 100;
 
 	nvhdcp_vdbg("repeater found:fetching repeater info\n");
 
 	/* wait up to 5 seconds for READY on repeater */
-	retries = 51;
+	retries = 5000 / interval + 1;
 	do {
 		if (!nvhdcp_is_plugged(nvhdcp)) {
 			nvhdcp_err("disconnect while waiting for repeater\n");
@@ -778,7 +839,7 @@ static int get_repeater_info(struct tegra_nvhdcp *nvhdcp)
 			break;
 		}
 		if (retries > 1)
-			msleep(100);
+			msleep(interval);
 	} while (--retries);
 	if (!retries) {
 		nvhdcp_err("repeater Bcaps read timeout\n");
@@ -820,6 +881,11 @@ static int get_repeater_info(struct tegra_nvhdcp *nvhdcp)
 		return e;
 	}
 
+	if (nvhdcp->sink && nvhdcp->sink->b_status == b_status &&
+	    !memcmp(nvhdcp->sink->bksv_list, nvhdcp->bksv_list,
+		    sizeof nvhdcp->bksv_list))
+		nvhdcp_debug("repeater topology unchanged\n");
+
 	return 0;
 }
 
@@ -852,6 +918,9 @@ static void nvhdcp_downstream_worker(struct work_struct *work)
 	nvhdcp->a_ksv = 0;
 	nvhdcp->b_ksv = 0;
 	nvhdcp->a_n = 0;
+	nvhdcp->sink = NULL;
+	nvhdcp->b_status = 0;
+	nvhdcp->num_bksv_list = 0;
 
 	e = get_bcaps(nvhdcp, &b_caps);
 	if (e) {
@@ -940,6 +1009,7 @@ static void nvhdcp_downstream_worker(struct work_struct *work)
 	}
 
 	nvhdcp_vdbg("read Bksv = 0x%010llx from device\n", nvhdcp->b_ksv);
+	nvhdcp->sink = nvhdcp_sink_find(nvhdcp, nvhdcp->b_ksv);
 
 	set_bksv(hdmi, nvhdcp->b_ksv, (b_caps & BCAPS_REPEATER));
 
@@ -981,7 +1051,17 @@ static void nvhdcp_downstream_worker(struct work_struct *work)
 	nvhdcp_vdbg("CRYPT enabled\n");
 
 	nvhdcp->state = STATE_LINK_VERIFY;
-	nvhdcp_info("link verified!\n");
+	nvhdcp_sink_store(nvhdcp, b_caps);
+	if (nvhdcp->auth_start.tv64) {
+		s64 us = ktime_us_delta(ktime_get(), nvhdcp->auth_start);
+
+		lat_hist_add(&nvhdcp_auth_hist, us);
+		nvhdcp->auth_start = ktime_set(0, 0);
+		nvhdcp_info("link verified in %lld ms\n", div_s64(us, 1000));
+	} else {
+		nvhdcp_info("link verified!\n");
+	}
+	nvhdcp->fail_count = 0;
 
 	while (1) {
 		if (!nvhdcp_is_plugged(nvhdcp))
@@ -1006,10 +1086,20 @@ failure:
 	nvhdcp->fail_count++;
 	if(nvhdcp->fail_count > 5) {
 	        nvhdcp_err("nvhdcp failure - too many failures, giving up!\n");
+	} else if (nvhdcp->sink && nvhdcp->fail_count == 1) {
+		/* a known receiver glitched: try again straight away */
+		nvhdcp_err("nvhdcp failure - renegotiating\n");
+		if (!nvhdcp_is_plugged(nvhdcp))
+			goto lost_hdmi;
+		if (!nvhdcp->auth_start.tv64)
+			nvhdcp->auth_start = ktime_get();
+		queue_delayed_work(nvhdcp->downstream_wq, &nvhdcp->work, 0);
 	} else {
 		nvhdcp_err("nvhdcp failure - renegotiating in 1 second\n");
 		if (!nvhdcp_is_plugged(nvhdcp))
 			goto lost_hdmi;
+		if (!nvhdcp->auth_start.tv64)
+			nvhdcp->auth_start = ktime_get();
 		queue_delayed_work(nvhdcp->downstream_wq, &nvhdcp->work,
 						msecs_to_jiffies(1000));
 	}
@@ -1028,11 +1118,17 @@ disable:
 	return;
 }
 
+/*
+ * Authentication runs entirely in the downstream worker; turning HDCP on
+ * only queues it, so the mode set that brought the link up never waits
+ * for the handshake.
+ */
 static int tegra_nvhdcp_on(struct tegra_nvhdcp *nvhdcp)
 {
 	nvhdcp->state = STATE_UNAUTHENTICATED;
 	if (nvhdcp_is_plugged(nvhdcp)) {
 		nvhdcp->fail_count = 0;
+		nvhdcp->auth_start = ktime_get();
 		queue_delayed_work(nvhdcp->downstream_wq, &nvhdcp->work,
 						msecs_to_jiffies(100));
 	}
@@ -1041,6 +1137,14 @@ static int tegra_nvhdcp_on(struct tegra_nvhdcp *nvhdcp)
 
 static int tegra_nvhdcp_off(struct tegra_nvhdcp *nvhdcp)
 {
+	/*
+	 * Drop the plug state before taking the lock, which the worker
+	 * holds for a whole handshake: it then bails out at its next I2C
+	 * transfer or wait instead of running the handshake to the end
+	 * while the mode set waits here.
+	 */
+	nvhdcp_set_plugged(nvhdcp, false);
+	wake_up_interruptible(&wq_worker);
 	mutex_lock(&nvhdcp->lock);
 	nvhdcp->state = STATE_OFF;
 	nvhdcp_set_plugged(nvhdcp, false);
@@ -1237,6 +1341,8 @@ struct tegra_nvhdcp *tegra_nvhdcp_create(struct tegra_dc_hdmi_data *hdmi,
 	if (e)
 		goto free_workqueue;
 
+	lat_hist_register(&nvhdcp_auth_hist);
+
 	nvhdcp_vdbg("%s(): created misc device %s\n", __func__, nvhdcp->name);
 
 	return nvhdcp;
@@ -1251,6 +1357,7 @@ free_nvhdcp:
 
 void tegra_nvhdcp_destroy(struct tegra_nvhdcp *nvhdcp)
 {
+	lat_hist_unregister(&nvhdcp_auth_hist);
 	misc_deregister(&nvhdcp->miscdev);
 	tegra_nvhdcp_off(nvhdcp);
 	destroy_workqueue(nvhdcp->downstream_wq);
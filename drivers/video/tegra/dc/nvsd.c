@@ -45,6 +45,7 @@ NVSD_ATTR(enable);
 NVSD_ATTR(aggressiveness);
 NVSD_ATTR(phase_in_settings);
 NVSD_ATTR(phase_in_adjustments);
+NVSD_ATTR(smoothing);
 NVSD_ATTR(bin_width);
 NVSD_ATTR(hw_update_delay);
 NVSD_ATTR(use_vid_luma);
@@ -63,6 +64,7 @@ static struct attribute *nvsd_attrs[] = {
 	NVSD_ATTRS_ENTRY(aggressiveness),
 	NVSD_ATTRS_ENTRY(phase_in_settings),
 	NVSD_ATTRS_ENTRY(phase_in_adjustments),
+	NVSD_ATTRS_ENTRY(smoothing),
 	NVSD_ATTRS_ENTRY(bin_width),
 	NVSD_ATTRS_ENTRY(hw_update_delay),
 	NVSD_ATTRS_ENTRY(use_vid_luma),
@@ -88,6 +90,50 @@ static atomic_t *sd_brightness = NULL;
 /* shared boolean for manual K workaround */
 static atomic_t man_k_until_blank = ATOMIC_INIT(0);
 
+/*
+ * Last values written to the LUT and BL_TF registers, so that phasing
+ * in settings only rewrites the entries that actually change.  A clear
+ * bit in the valid mask forces the next write.
+ */
+static u32 nvsd_lut_cache[DC_DISP_SD_LUT_NUM];
+static u32 nvsd_bltf_cache[DC_DISP_SD_BL_TF_NUM];
+static u32 nvsd_lut_valid, nvsd_bltf_valid;
+
+static void nvsd_write_lut(struct tegra_dc *dc, int i, u32 val)
+{
+	if ((nvsd_lut_valid & BIT(i)) && nvsd_lut_cache[i] == val)
+		return;
+	nvsd_lut_cache[i] = val;
+	nvsd_lut_valid |= BIT(i);
+	tegra_dc_writel(dc, val, DC_DISP_SD_LUT(i));
+}
+
+static void nvsd_write_bltf(struct tegra_dc *dc, int i, u32 val)
+{
+	if ((nvsd_bltf_valid & BIT(i)) && nvsd_bltf_cache[i] == val)
+		return;
+	nvsd_bltf_cache[i] = val;
+	nvsd_bltf_valid |= BIT(i);
+	tegra_dc_writel(dc, val, DC_DISP_SD_BL_TF(i));
+}
+
+/*
+ * One frame's worth of exponential smoothing: move 1/2^shift of the
+ * remaining distance, but at least one unit so the target is reached.
+ */
+static int nvsd_smooth(int cur, int target, u8 shift)
+{
+	int delta = target - cur;
+	int step = abs(delta) >> shift;
+
+	if (!step)
+		step = 1;
+	if (step > abs(delta))
+		step = abs(delta);
+
+	return delta > 0 ? cur + step : cur - step;
+}
+
 static u8 nvsd_get_bw_idx(struct tegra_dc_sd_settings *settings)
 {
 	u8 bw;
@@ -149,6 +195,25 @@ static bool nvsd_phase_in_adjustments(struct tegra_dc *dc,
 	val = tegra_dc_readl(dc, DC_DISP_SD_BL_CONTROL);
 	val = SD_BLC_BRIGHTNESS(val);
 
+	if (settings->smoothing) {
+		if (cur_sd_brightness == val && target_k == cur_k)
+			return false;
+
+		/* Filter backlight and pixel K together, every frame */
+		if (cur_sd_brightness != val)
+			cur_sd_brightness = nvsd_smooth(cur_sd_brightness, val,
+							settings->smoothing);
+		if (target_k != cur_k) {
+			cur_k = nvsd_smooth(cur_k, target_k,
+					    settings->smoothing);
+			man_k = SD_MAN_K_R(cur_k) |
+				SD_MAN_K_G(cur_k) | SD_MAN_K_B(cur_k);
+			tegra_dc_writel(dc, man_k, DC_DISP_SD_MAN_K_VALUES);
+		}
+		atomic_set(sd_brightness, cur_sd_brightness);
+		return true;
+	}
+
 	step = settings->phase_adj_step;
 	if (cur_sd_brightness != val || target_k != cur_k) {
 		if (!step)
@@ -205,7 +270,7 @@ static void nvsd_phase_in_luts(struct tegra_dc_sd_settings *settings,
 			SD_LUT_B((settings->lut[bw_idx][i].b *
 				phase_settings_step)/num_phase_in_steps);
 
-		tegra_dc_writel(dc, val, DC_DISP_SD_LUT(i));
+		nvsd_write_lut(dc, i, val);
 	}
 	/* Phase in Final BLTF */
 	for (i = 0; i < DC_DISP_SD_BL_TF_NUM; i++) {
@@ -218,7 +283,7 @@ static void nvsd_phase_in_luts(struct tegra_dc_sd_settings *settings,
 			SD_BL_TF_POINT_3(255-((255-settings->bltf[bw_idx][i][3])
 				* phase_settings_step)/num_phase_in_steps);
 
-		tegra_dc_writel(dc, val, DC_DISP_SD_BL_TF(i));
+		nvsd_write_bltf(dc, i, val);
 	}
 }
 
@@ -351,6 +416,10 @@ void nvsd_init(struct tegra_dc *dc, struct tegra_dc_sd_settings *settings)
 	u32 bw_idx = 0;
 	/* TODO: check if HW says SD's available */
 
+	/* registers may have been reset, write everything once */
+	nvsd_lut_valid = 0;
+	nvsd_bltf_valid = 0;
+
 	/* If SD's not present or disabled, clear the register and return. */
 	if (!settings || settings->enable == 0) {
 		/* clear the brightness val, too. */
@@ -401,7 +470,7 @@ void nvsd_init(struct tegra_dc *dc, struct tegra_dc_sd_settings *settings)
 			val = SD_LUT_R(settings->lut[bw_idx][i].r) |
 				SD_LUT_G(settings->lut[bw_idx][i].g) |
 				SD_LUT_B(settings->lut[bw_idx][i].b);
-			tegra_dc_writel(dc, val, DC_DISP_SD_LUT(i));
+			nvsd_write_lut(dc, i, val);
 
 			dev_dbg(&dc->ndev->dev, "    %d: 0x%08x\n", i, val);
 		}
@@ -417,7 +486,7 @@ void nvsd_init(struct tegra_dc *dc, struct tegra_dc_sd_settings *settings)
 				SD_BL_TF_POINT_2(settings->bltf[bw_idx][i][2]) |
 				SD_BL_TF_POINT_3(settings->bltf[bw_idx][i][3]);
 
-			tegra_dc_writel(dc, val, DC_DISP_SD_BL_TF(i));
+			nvsd_write_bltf(dc, i, val);
 
 			dev_dbg(&dc->ndev->dev, "    %d: 0x%08x\n", i, val);
 		}
@@ -430,7 +499,7 @@ void nvsd_init(struct tegra_dc *dc, struct tegra_dc_sd_settings *settings)
 				SD_BL_TF_POINT_2(0xFF) |
 				SD_BL_TF_POINT_3(0xFF);
 
-			tegra_dc_writel(dc, val, DC_DISP_SD_BL_TF(i));
+			nvsd_write_bltf(dc, i, val);
 
 			dev_dbg(&dc->ndev->dev, "    %d: 0x%08x\n", i, val);
 		}
@@ -607,6 +676,9 @@ static ssize_t nvsd_settings_show(struct kobject *kobj,
 		else if (IS_NVSD_ATTR(phase_in_adjustments))
 			res = snprintf(buf, PAGE_SIZE, "%d\n",
 				sd_settings->phase_in_adjustments);
+		else if (IS_NVSD_ATTR(smoothing))
+			res = snprintf(buf, PAGE_SIZE, "%d\n",
+				sd_settings->smoothing);
 		else if (IS_NVSD_ATTR(bin_width))
 			res = snprintf(buf, PAGE_SIZE, "%d\n",
 				sd_settings->bin_width);
@@ -762,6 +834,8 @@ static ssize_t nvsd_settings_store(struct kobject *kobj,
 			nvsd_check_and_update(0, 1, phase_in_settings);
 		} else if (IS_NVSD_ATTR(phase_in_adjustments)) {
 			nvsd_check_and_update(0, 1, phase_in_adjustments);
+		} else if (IS_NVSD_ATTR(smoothing)) {
+			nvsd_check_and_update(0, 7, smoothing);
 		} else if (IS_NVSD_ATTR(bin_width)) {
 			nvsd_check_and_update(0, 8, bin_width);
 		} else if (IS_NVSD_ATTR(hw_update_delay)) {
@@ -236,6 +236,7 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 	}
 
 	tegra_dc_hold_dc_out(dc);
+	tegra_dc_idle_flip(dc);
 
 	if (no_vsync)
 		tegra_dc_writel(dc, WRITE_MUX_ACTIVE | READ_MUX_ACTIVE,
@@ -273,8 +274,10 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		tegra_dc_writel(dc, WINDOW_A_SELECT << win->idx,
 				DC_CMD_DISPLAY_WINDOW_HEADER);
 
-		if (!no_vsync)
+		if (!no_vsync) {
 			update_mask |= WIN_A_ACT_REQ << win->idx;
+			tegra_dc_frame_stats_flip(dc, win->idx);
+		}
 
 		if (!WIN_IS_ENABLED(win)) {
 			dc->windows[i].dirty = 1;
@@ -412,6 +415,7 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 	}
 
 	tegra_dc_set_dynamic_emc(windows, n);
+	tegra_dc_schedule_emc_reclaim(dc);
 
 	tegra_dc_writel(dc, update_mask << 8, DC_CMD_STATE_CONTROL);
 
@@ -22,6 +22,7 @@
 #include <linux/fb.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/string.h>
 #include <linux/mm.h>
@@ -31,6 +32,9 @@
 #include <linux/workqueue.h>
 
 #include <asm/atomic.h>
+#include <asm/cacheflush.h>
+#include <asm/outercache.h>
+#include <asm/sizes.h>
 
 #include <video/tegrafb.h>
 
@@ -48,6 +52,18 @@
 /* Pad pitch to 16-byte boundary. */
 #define TEGRA_LINEAR_PITCH_ALIGNMENT 32
 
+/* Longest wait for a gr2d operation to land in the framebuffer */
+#define TEGRA_FB_ACCEL_TIMEOUT_MS 500
+
+/* Dirty lines of clients that never pan are written back after this long */
+#define TEGRA_FB_DAMAGE_DELAY_MS 20
+
+/* Pans that may wait for a vblank, i.e. up to four buffers are useful */
+#define TEGRA_FB_PAN_QUEUE_LEN 2
+
+/* Longest wait for a queued pan to reach the screen */
+#define TEGRA_FB_PAN_TIMEOUT_MS 500
+
 struct tegra_fb_info {
 	struct tegra_dc_win	*win;
 	struct nvhost_device	*ndev;
@@ -55,6 +71,41 @@ struct tegra_fb_info {
 	bool			valid;
 
 	struct resource		*fb_mem;
+
+	/* last gr2d operation on the framebuffer, if any is in flight */
+	struct nvhost_gr2d_fence accel_fence;
+	bool			accel_pending;
+
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+	/* cacheable alias of the framebuffer, used for write back only */
+	void __iomem		*cached_base;
+	struct address_space	*mapping;
+
+	/* lines [damage_y1, damage_y2) were touched since the last flush */
+	spinlock_t		damage_lock;
+	u32			damage_y1;
+	u32			damage_y2;
+	struct delayed_work	damage_work;
+#endif
+
+	/* pans waiting for a vblank in queued panning mode, see tegrafb.h */
+	struct mutex		pan_lock;
+	u32			pan_queue[TEGRA_FB_PAN_QUEUE_LEN];
+	int			pan_head;
+	int			pan_count;
+	u32			pan_last;
+	u32			pans;
+	s64			pan_timestamp_ns;
+	wait_queue_head_t	pan_wait;
+	struct workqueue_struct	*pan_wq;
+	struct work_struct	pan_work;
+
+	/* hardware cursor images, allocated on the first upload */
+	struct nvmap_client	*cursor_nvmap;
+	struct nvmap_handle_ref	*cursor_handle;
+	void			*cursor_virt;
+	phys_addr_t		cursor_phys;
+	int			cursor_slot;
 };
 
 /* palette array used by the fbcon */
@@ -91,9 +142,7 @@ defined(CONFIG_MACH_COLIBRI_T30)
 		fb_videomode_to_var(var, &mode);
 	}
 
-	/* Double yres_virtual to allow double buffering through pan_display */
 	var->xres_virtual = var->xres;
-	var->yres_virtual = var->yres * 2;
 
 	/* we only support RGB ordering for now */
 	switch (var->bits_per_pixel) {
@@ -121,9 +170,38 @@ defined(CONFIG_MACH_COLIBRI_T30)
 		break;
 	}
 
+	/* Double yres_virtual to allow double buffering through pan_display,
+	 * unless the client asks for more buffers for queued panning and they
+	 * fit */
+	if (var->yres_virtual >= var->yres * 3 &&
+	    var->yres_virtual * round_up(var->xres * var->bits_per_pixel / 8,
+			TEGRA_LINEAR_PITCH_ALIGNMENT) <= info->screen_size)
+		var->yres_virtual -= var->yres_virtual % var->yres;
+	else
+		var->yres_virtual = var->yres * 2;
+
 	return 0;
 }
 
+/* true if the controller would be programmed with the same timings */
+static bool tegra_fb_same_timings(const struct tegra_dc_mode *a,
+				  const struct tegra_dc_mode *b)
+{
+	return a->pclk == b->pclk &&
+		a->h_ref_to_sync == b->h_ref_to_sync &&
+		a->v_ref_to_sync == b->v_ref_to_sync &&
+		a->h_sync_width == b->h_sync_width &&
+		a->v_sync_width == b->v_sync_width &&
+		a->h_back_porch == b->h_back_porch &&
+		a->v_back_porch == b->v_back_porch &&
+		a->h_active == b->h_active &&
+		a->v_active == b->v_active &&
+		a->h_front_porch == b->h_front_porch &&
+		a->v_front_porch == b->v_front_porch &&
+		a->stereo_mode == b->stereo_mode &&
+		a->flags == b->flags;
+}
+
 static int tegra_fb_set_par(struct fb_info *info)
 {
 	struct tegra_fb_info *tegra_fb = info->par;
@@ -133,6 +211,9 @@ static int tegra_fb_set_par(struct fb_info *info)
 
 	struct tegra_dc_mode mode;
 
+	/* queued pans refer to the old layout */
+	flush_workqueue(tegra_fb->pan_wq);
+
 	/* This is usually altered to 16/32 by tegra_fb_check_var
 	 * above which is called before this function
 	 */
@@ -171,6 +252,28 @@ static int tegra_fb_set_par(struct fb_info *info)
 		return -EINVAL;
 	}
 
+	/*
+	 * The running timings are unchanged (typically the same sink coming
+	 * back on hotplug): keep the pixel clock and its parent and only
+	 * reprogram the fb window instead of cycling the controller.
+	 */
+	if (dc->enabled && tegra_fb_same_timings(&dc->mode, &mode)) {
+		if (tegra_fb->win->flags & TEGRA_WIN_FLAG_ENABLED) {
+			tegra_dc_update_windows(&tegra_fb->win, 1);
+			tegra_dc_sync_windows(&tegra_fb->win, 1);
+		}
+		return 0;
+	}
+
+	/* a new refresh rate for the running panel needs no teardown either */
+	if (dc->enabled && !tegra_dc_update_mode(dc, &mode)) {
+		if (tegra_fb->win->flags & TEGRA_WIN_FLAG_ENABLED) {
+			tegra_dc_update_windows(&tegra_fb->win, 1);
+			tegra_dc_sync_windows(&tegra_fb->win, 1);
+		}
+		return 0;
+	}
+
 	err = tegra_dc_set_mode(dc, &mode);
 	if (err) {
 		dev_warn(&tegra_fb->ndev->dev, "could not set dc mode %d\n", err);
@@ -285,6 +388,7 @@ static int tegra_fb_blank(int blank, struct fb_info *info)
 	case FB_BLANK_HSYNC_SUSPEND:
 	case FB_BLANK_POWERDOWN:
 		dev_dbg(&tegra_fb->ndev->dev, "blank - powerdown\n");
+		flush_workqueue(tegra_fb->pan_wq);
 		tegra_dc_disable(tegra_fb->win->dc);
 		return 0;
 
@@ -293,17 +397,260 @@ static int tegra_fb_blank(int blank, struct fb_info *info)
 	}
 }
 
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+/*
+ * Processes map the framebuffer cached. Pages are inserted on fault and
+ * every fault marks its page dirty; a flush zaps the ptes of the dirty
+ * pages, so that the next access faults again, and then writes the dirty
+ * lines back through the kernel's cacheable alias. The L1 data cache is
+ * physically tagged, so the alias reaches lines brought in by any mapping.
+ */
+static void tegra_fb_add_damage(struct tegra_fb_info *tegra_fb, u32 y1,
+				u32 y2)
+{
+	bool was_clean;
+
+	y2 = min(y2, tegra_fb->info->var.yres_virtual);
+	if (y1 >= y2)
+		return;
+
+	spin_lock(&tegra_fb->damage_lock);
+	was_clean = tegra_fb->damage_y1 >= tegra_fb->damage_y2;
+	if (was_clean || y1 < tegra_fb->damage_y1)
+		tegra_fb->damage_y1 = y1;
+	if (was_clean || y2 > tegra_fb->damage_y2)
+		tegra_fb->damage_y2 = y2;
+	spin_unlock(&tegra_fb->damage_lock);
+
+	if (was_clean)
+		schedule_delayed_work(&tegra_fb->damage_work,
+			msecs_to_jiffies(TEGRA_FB_DAMAGE_DELAY_MS));
+}
+
+/* writes back dirty lines, true if any of them is in [vis_y1, vis_y2) */
+static bool tegra_fb_flush_damage(struct tegra_fb_info *tegra_fb,
+				  u32 vis_y1, u32 vis_y2)
+{
+	struct fb_info *info;
+	unsigned long start, end;
+	u32 y1, y2;
+
+	spin_lock(&tegra_fb->damage_lock);
+	y1 = tegra_fb->damage_y1;
+	y2 = tegra_fb->damage_y2;
+	tegra_fb->damage_y1 = tegra_fb->damage_y2 = 0;
+	spin_unlock(&tegra_fb->damage_lock);
+
+	/* nothing can be dirty before the first mmap */
+	if (y1 >= y2)
+		return false;
+
+	info = tegra_fb->info;
+	start = y1 * info->fix.line_length;
+	end = y2 * info->fix.line_length;
+
+	if (tegra_fb->mapping)
+		unmap_mapping_range(tegra_fb->mapping,
+			round_down(start, PAGE_SIZE),
+			round_up(end, PAGE_SIZE) - round_down(start, PAGE_SIZE),
+			1);
+
+	__cpuc_flush_dcache_area((void __force *)tegra_fb->cached_base + start,
+		end - start);
+	outer_flush_range(info->fix.smem_start + start,
+		info->fix.smem_start + end);
+
+	return y1 < vis_y2 && vis_y1 < y2;
+}
+
+static void tegra_fb_damage_worker(struct work_struct *work)
+{
+	struct tegra_fb_info *tegra_fb = container_of(to_delayed_work(work),
+		struct tegra_fb_info, damage_work);
+
+	tegra_fb_flush_damage(tegra_fb, 0, 0);
+}
+
+static int tegra_fb_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct tegra_fb_info *tegra_fb = vma->vm_private_data;
+	struct fb_info *info = tegra_fb->info;
+	unsigned long offset = vmf->pgoff << PAGE_SHIFT;
+	u32 line_length = info->fix.line_length;
+	int err;
+
+	if (offset >= info->fix.smem_len)
+		return VM_FAULT_SIGBUS;
+
+	tegra_fb_add_damage(tegra_fb, offset / line_length,
+		DIV_ROUND_UP(offset + PAGE_SIZE, line_length));
+
+	err = vm_insert_pfn(vma, (unsigned long)vmf->virtual_address,
+		(info->fix.smem_start + offset) >> PAGE_SHIFT);
+	/* -EBUSY: a concurrent fault mapped the page first */
+	if (err && err != -EBUSY)
+		return VM_FAULT_SIGBUS;
+
+	return VM_FAULT_NOPAGE;
+}
+
+static const struct vm_operations_struct tegra_fb_vm_ops = {
+	.fault = tegra_fb_vm_fault,
+};
+
+static int tegra_fb_mmap(struct fb_info *info, struct vm_area_struct *vma)
+{
+	struct tegra_fb_info *tegra_fb = info->par;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (!tegra_fb->valid)
+		return -ENODEV;
+
+	if (vma->vm_pgoff > PAGE_ALIGN(info->fix.smem_len) >> PAGE_SHIFT ||
+	    size > PAGE_ALIGN(info->fix.smem_len) -
+			(vma->vm_pgoff << PAGE_SHIFT))
+		return -EINVAL;
+
+	vma->vm_flags |= VM_IO | VM_RESERVED;
+
+	if (!tegra_fb->cached_base) {
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+		return remap_pfn_range(vma, vma->vm_start,
+			(info->fix.smem_start >> PAGE_SHIFT) + vma->vm_pgoff,
+			size, vma->vm_page_prot);
+	}
+
+	/* pfn maps cannot be copied on write */
+	if ((vma->vm_flags & (VM_SHARED | VM_MAYWRITE)) == VM_MAYWRITE)
+		return -EINVAL;
+
+	vma->vm_flags |= VM_PFNMAP | VM_DONTEXPAND;
+	vma->vm_ops = &tegra_fb_vm_ops;
+	vma->vm_private_data = tegra_fb;
+	tegra_fb->mapping = vma->vm_file->f_mapping;
+	return 0;
+}
+
+static int tegra_fb_damage_ioctl(struct tegra_fb_info *tegra_fb,
+				 struct tegra_fb_damage __user *udamage)
+{
+	struct tegra_fb_damage damage;
+
+	if (copy_from_user(&damage, udamage, sizeof(damage)))
+		return -EFAULT;
+
+	if (!tegra_fb->cached_base)
+		return 0;
+
+	if (damage.y >= tegra_fb->info->var.yres_virtual)
+		return -EINVAL;
+
+	/* make the region visible now, clients that report damage may never
+	 * pan */
+	tegra_fb_add_damage(tegra_fb, damage.y, damage.y +
+		min(damage.height, tegra_fb->info->var.yres_virtual));
+	tegra_fb_flush_damage(tegra_fb, 0, 0);
+	return 0;
+}
+#else
+static bool tegra_fb_flush_damage(struct tegra_fb_info *tegra_fb,
+				  u32 vis_y1, u32 vis_y2)
+{
+	return true;
+}
+#endif
+
+/* records a pan that reached the screen, called with pan_lock held */
+static void tegra_fb_pan_done(struct tegra_fb_info *tegra_fb)
+{
+	tegra_fb->pans++;
+	tegra_fb->pan_timestamp_ns = ktime_to_ns(ktime_get());
+	wake_up_all(&tegra_fb->pan_wait);
+}
+
+static void tegra_fb_pan_worker(struct work_struct *work)
+{
+	struct tegra_fb_info *tegra_fb = container_of(work,
+		struct tegra_fb_info, pan_work);
+	struct tegra_dc_win *win = tegra_fb->win;
+
+	mutex_lock(&tegra_fb->pan_lock);
+	while (tegra_fb->pan_count) {
+		u32 addr = tegra_fb->pan_queue[tegra_fb->pan_head];
+
+		mutex_unlock(&tegra_fb->pan_lock);
+
+		win->phys_addr = addr;
+		win->flags = TEGRA_WIN_FLAG_ENABLED;
+		win->virt_addr = tegra_fb->info->screen_base;
+
+		/* one pan per frame, each is latched at the next vblank */
+		tegra_dc_update_windows(&win, 1);
+		tegra_dc_sync_windows(&win, 1);
+
+		mutex_lock(&tegra_fb->pan_lock);
+		tegra_fb->pan_head = (tegra_fb->pan_head + 1) %
+			TEGRA_FB_PAN_QUEUE_LEN;
+		tegra_fb->pan_count--;
+		tegra_fb_pan_done(tegra_fb);
+	}
+	mutex_unlock(&tegra_fb->pan_lock);
+}
+
+/* pans that may be queued behind the one on screen, 0 for blocking pans */
+static int tegra_fb_pan_queue_depth(struct fb_info *info)
+{
+	int buffers = info->var.yres_virtual / info->var.yres;
+
+	return clamp(buffers - 2, 0, TEGRA_FB_PAN_QUEUE_LEN);
+}
+
+static int tegra_fb_queue_pan(struct tegra_fb_info *tegra_fb, u32 addr,
+			      bool dirty, int depth)
+{
+	long ret;
+
+	mutex_lock(&tegra_fb->pan_lock);
+
+	if (!dirty && addr == tegra_fb->pan_last) {
+		mutex_unlock(&tegra_fb->pan_lock);
+		return 0;
+	}
+
+	/* with a full queue the buffer the client draws next is on screen */
+	while (tegra_fb->pan_count >= depth) {
+		mutex_unlock(&tegra_fb->pan_lock);
+		ret = wait_event_interruptible_timeout(tegra_fb->pan_wait,
+			tegra_fb->pan_count < depth,
+			msecs_to_jiffies(TEGRA_FB_PAN_TIMEOUT_MS));
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -ETIMEDOUT;
+		mutex_lock(&tegra_fb->pan_lock);
+	}
+
+	tegra_fb->pan_queue[(tegra_fb->pan_head + tegra_fb->pan_count) %
+		TEGRA_FB_PAN_QUEUE_LEN] = addr;
+	tegra_fb->pan_count++;
+	tegra_fb->pan_last = addr;
+	mutex_unlock(&tegra_fb->pan_lock);
+
+	queue_work(tegra_fb->pan_wq, &tegra_fb->pan_work);
+	return 0;
+}
+
 static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 				struct fb_info *info)
 {
 	struct tegra_fb_info *tegra_fb = info->par;
-	char __iomem *flush_start;
-	char __iomem *flush_end;
+	bool dirty;
 	u32 addr;
+	int depth;
 
 	if (!tegra_fb->win->cur_handle) {
-		flush_start = info->screen_base + (var->yoffset * info->fix.line_length);
-		flush_end = flush_start + (var->yres * info->fix.line_length);
+		dirty = tegra_fb_flush_damage(tegra_fb, var->yoffset,
+			var->yoffset + var->yres);
 
 		info->var.xoffset = var->xoffset;
 		info->var.yoffset = var->yoffset;
@@ -311,35 +658,293 @@ static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 		addr = info->fix.smem_start + (var->yoffset * info->fix.line_length) +
 			(var->xoffset * (var->bits_per_pixel/8));
 
+		depth = tegra_fb_pan_queue_depth(info);
+		if (depth)
+			return tegra_fb_queue_pan(tegra_fb, addr, dirty, depth);
+
+		/* the last queued pan lands first when leaving queued mode */
+		flush_workqueue(tegra_fb->pan_wq);
+
+		/* nothing to wait a frame for */
+		if (!dirty && tegra_fb->win->phys_addr == addr &&
+		    (tegra_fb->win->flags & TEGRA_WIN_FLAG_ENABLED))
+			return 0;
+
 		tegra_fb->win->phys_addr = addr;
 		tegra_fb->win->flags = TEGRA_WIN_FLAG_ENABLED;
 		tegra_fb->win->virt_addr = info->screen_base;
 
 		tegra_dc_update_windows(&tegra_fb->win, 1);
 		tegra_dc_sync_windows(&tegra_fb->win, 1);
+
+		mutex_lock(&tegra_fb->pan_lock);
+		tegra_fb->pan_last = addr;
+		tegra_fb_pan_done(tegra_fb);
+		mutex_unlock(&tegra_fb->pan_lock);
+	}
+
+	return 0;
+}
+
+static int tegra_fb_sync(struct fb_info *info)
+{
+	struct tegra_fb_info *tegra_fb = info->par;
+
+	if (tegra_fb->accel_pending) {
+		nvhost_gr2d_wait(&tegra_fb->accel_fence,
+			msecs_to_jiffies(TEGRA_FB_ACCEL_TIMEOUT_MS));
+		tegra_fb->accel_pending = false;
 	}
 
 	return 0;
 }
 
+#ifdef CONFIG_FB_TEGRA_GR2D
+/* describes the framebuffer to gr2d, false if it cannot draw on it */
+static bool tegra_fb_accel_surface(struct fb_info *info,
+				   struct nvhost_gr2d_surface *surf)
+{
+	struct tegra_fb_info *tegra_fb = info->par;
+
+	if (!tegra_fb->valid || info->state != FBINFO_STATE_RUNNING)
+		return false;
+
+	switch (info->var.bits_per_pixel) {
+	case 16:
+		surf->format = NVHOST_GR2D_FORMAT_RGB565;
+		break;
+	case 32:
+		surf->format = NVHOST_GR2D_FORMAT_B8G8R8A8;
+		break;
+	default:
+		return false;
+	}
+
+	surf->base = info->fix.smem_start;
+	surf->pitch = info->fix.line_length;
+	surf->width = info->var.xres_virtual;
+	surf->height = info->var.yres_virtual;
+	return true;
+}
+#endif
+
 static void tegra_fb_fillrect(struct fb_info *info,
 			      const struct fb_fillrect *rect)
 {
+#ifdef CONFIG_FB_TEGRA_GR2D
+	struct tegra_fb_info *tegra_fb = info->par;
+	struct nvhost_gr2d_surface dst;
+	struct nvhost_gr2d_rect r = {
+		rect->dx, rect->dy, rect->width, rect->height
+	};
+	u32 color = rect->color;
+
+	if (info->fix.visual == FB_VISUAL_TRUECOLOR ||
+	    info->fix.visual == FB_VISUAL_DIRECTCOLOR)
+		color = ((u32 *)info->pseudo_palette)[rect->color];
+
+	if (tegra_fb_accel_surface(info, &dst) &&
+	    !nvhost_gr2d_fill(&dst, &r, color,
+			rect->rop == ROP_XOR ? NVHOST_GR2D_ROP_XOR :
+				NVHOST_GR2D_ROP_COPY,
+			&tegra_fb->accel_fence)) {
+		tegra_fb->accel_pending = true;
+		return;
+	}
+#endif
+	tegra_fb_sync(info);
 	cfb_fillrect(info, rect);
 }
 
 static void tegra_fb_copyarea(struct fb_info *info,
 			      const struct fb_copyarea *region)
 {
+#ifdef CONFIG_FB_TEGRA_GR2D
+	struct tegra_fb_info *tegra_fb = info->par;
+	struct nvhost_gr2d_surface surf;
+	struct nvhost_gr2d_rect r = {
+		region->dx, region->dy, region->width, region->height
+	};
+
+	if (tegra_fb_accel_surface(info, &surf) &&
+	    !nvhost_gr2d_copy(&surf, &surf, &r, region->sx, region->sy,
+			&tegra_fb->accel_fence)) {
+		tegra_fb->accel_pending = true;
+		return;
+	}
+#endif
+	tegra_fb_sync(info);
 	cfb_copyarea(info, region);
 }
 
 static void tegra_fb_imageblit(struct fb_info *info,
 			       const struct fb_image *image)
 {
+	/* the CPU must not draw under a pending gr2d operation */
+	tegra_fb_sync(info);
 	cfb_imageblit(info, image);
 }
 
+static int tegra_fb_wait_vblank_ioctl(struct tegra_fb_info *tegra_fb,
+				      struct tegra_fb_vblank __user *uvblank)
+{
+	struct tegra_dc *dc = tegra_fb->win->dc;
+	struct tegra_fb_vblank vblank;
+	long ret;
+	int err;
+
+	if (copy_from_user(&vblank, uvblank, sizeof(vblank)))
+		return -EFAULT;
+
+	if (vblank.flags & ~TEGRA_FB_VBLANK_PANNED)
+		return -EINVAL;
+
+	if (vblank.flags & TEGRA_FB_VBLANK_PANNED) {
+		ret = wait_event_interruptible_timeout(tegra_fb->pan_wait,
+			!tegra_fb->pan_count,
+			msecs_to_jiffies(TEGRA_FB_PAN_TIMEOUT_MS *
+				(TEGRA_FB_PAN_QUEUE_LEN + 1)));
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -ETIMEDOUT;
+
+		mutex_lock(&tegra_fb->pan_lock);
+		vblank.timestamp_ns = tegra_fb->pan_timestamp_ns;
+		mutex_unlock(&tegra_fb->pan_lock);
+	} else if (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE) {
+		err = tegra_dc_wait_for_vsync(dc);
+		if (err)
+			return err;
+		vblank.timestamp_ns = ktime_to_ns(ktime_get());
+	} else {
+		err = tegra_dc_wait_for_frame_end(dc, TEGRA_FB_PAN_TIMEOUT_MS,
+			&vblank.timestamp_ns);
+		if (err)
+			return err;
+	}
+
+	mutex_lock(&tegra_fb->pan_lock);
+	vblank.pans = tegra_fb->pans;
+	mutex_unlock(&tegra_fb->pan_lock);
+
+	if (copy_to_user(uvblank, &vblank, sizeof(vblank)))
+		return -EFAULT;
+	return 0;
+}
+
+/* two slots of the largest (64x64) image, so that an upload never rewrites
+ * the image that is being scanned out */
+#define TEGRA_FB_CURSOR_SLOT_SIZE	SZ_1K
+
+static int tegra_fb_cursor_alloc(struct tegra_fb_info *tegra_fb)
+{
+	struct nvmap_client *client;
+	struct nvmap_handle_ref *handle;
+	phys_addr_t phys;
+	void *virt;
+	int err;
+
+	client = nvmap_create_client(nvmap_dev, "tegra_fb_cursor");
+	if (!client)
+		return -ENOMEM;
+
+	handle = nvmap_alloc(client, 2 * TEGRA_FB_CURSOR_SLOT_SIZE,
+			     TEGRA_FB_CURSOR_SLOT_SIZE,
+			     NVMAP_HANDLE_WRITE_COMBINE,
+			     NVMAP_HEAP_CARVEOUT_GENERIC);
+	if (IS_ERR_OR_NULL(handle)) {
+		err = handle ? PTR_ERR(handle) : -ENOMEM;
+		goto err_put_client;
+	}
+
+	virt = nvmap_mmap(handle);
+	if (!virt) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+
+	phys = nvmap_pin(client, handle);
+	if (IS_ERR_VALUE(phys)) {
+		err = phys;
+		goto err_munmap;
+	}
+
+	tegra_fb->cursor_nvmap = client;
+	tegra_fb->cursor_handle = handle;
+	tegra_fb->cursor_virt = virt;
+	tegra_fb->cursor_phys = phys;
+	return 0;
+
+err_munmap:
+	nvmap_munmap(handle, virt);
+err_free:
+	nvmap_free(client, handle);
+err_put_client:
+	nvmap_client_put(client);
+	return err;
+}
+
+static void tegra_fb_cursor_free(struct tegra_fb_info *tegra_fb)
+{
+	if (!tegra_fb->cursor_handle)
+		return;
+
+	nvmap_unpin(tegra_fb->cursor_nvmap, tegra_fb->cursor_handle);
+	nvmap_munmap(tegra_fb->cursor_handle, tegra_fb->cursor_virt);
+	nvmap_free(tegra_fb->cursor_nvmap, tegra_fb->cursor_handle);
+	nvmap_client_put(tegra_fb->cursor_nvmap);
+	tegra_fb->cursor_handle = NULL;
+}
+
+static int tegra_fb_cursor_image_ioctl(struct tegra_fb_info *tegra_fb,
+			struct tegra_fb_cursor_image __user *uimage)
+{
+	struct tegra_fb_cursor_image image;
+	bool size_64;
+	size_t len;
+	int err;
+
+	if (copy_from_user(&image, uimage, sizeof(image)))
+		return -EFAULT;
+
+	size_64 = image.flags & TEGRA_FB_CURSOR_SIZE_64x64;
+	len = size_64 ? 64 * 64 * 2 / 8 : 32 * 32 * 2 / 8;
+
+	if (!tegra_fb->cursor_handle) {
+		err = tegra_fb_cursor_alloc(tegra_fb);
+		if (err)
+			return err;
+	}
+
+	tegra_fb->cursor_slot ^= 1;
+	if (copy_from_user(tegra_fb->cursor_virt +
+			   tegra_fb->cursor_slot * TEGRA_FB_CURSOR_SLOT_SIZE,
+			   image.data, len))
+		return -EFAULT;
+
+	/* the write combined image must be in memory before it is latched */
+	wmb();
+
+	return tegra_dc_set_cursor_image(tegra_fb->win->dc,
+		tegra_fb->cursor_phys +
+			tegra_fb->cursor_slot * TEGRA_FB_CURSOR_SLOT_SIZE,
+		size_64, image.foreground & 0xffffff,
+		image.background & 0xffffff);
+}
+
+static int tegra_fb_cursor_ioctl(struct tegra_fb_info *tegra_fb,
+				 struct tegra_fb_cursor __user *ucursor)
+{
+	struct tegra_fb_cursor cursor;
+
+	if (copy_from_user(&cursor, ucursor, sizeof(cursor)))
+		return -EFAULT;
+
+	return tegra_dc_set_cursor(tegra_fb->win->dc, cursor.x, cursor.y,
+				   cursor.flags & TEGRA_FB_CURSOR_VISIBLE);
+}
+
 static int tegra_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg)
 {
 	struct tegra_fb_info *tegra_fb = (struct tegra_fb_info *)info->par;
@@ -399,6 +1004,20 @@ static int tegra_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long
 	case FBIO_WAITFORVSYNC:
 		return tegra_dc_wait_for_vsync(tegra_fb->win->dc);
 
+	case FBIO_TEGRA_WAIT_VBLANK:
+		return tegra_fb_wait_vblank_ioctl(tegra_fb, (void __user *)arg);
+
+	case FBIO_TEGRA_CURSOR_IMAGE:
+		return tegra_fb_cursor_image_ioctl(tegra_fb, (void __user *)arg);
+
+	case FBIO_TEGRA_CURSOR:
+		return tegra_fb_cursor_ioctl(tegra_fb, (void __user *)arg);
+
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+	case FBIO_TEGRA_DAMAGE:
+		return tegra_fb_damage_ioctl(tegra_fb, (void __user *)arg);
+#endif
+
 	default:
 		return -ENOTTY;
 	}
@@ -454,7 +1073,11 @@ static struct fb_ops tegra_fb_ops = {
 	.fb_fillrect = tegra_fb_fillrect,
 	.fb_copyarea = tegra_fb_copyarea,
 	.fb_imageblit = tegra_fb_imageblit,
+	.fb_sync = tegra_fb_sync,
 	.fb_ioctl = tegra_fb_ioctl,
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+	.fb_mmap = tegra_fb_mmap,
+#endif
 };
 
 const struct fb_videomode *tegra_fb_find_best_mode(
@@ -720,12 +1343,33 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 			goto err_free;
 		}
 		tegra_fb->valid = true;
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+		/* without it, mmap falls back to an uncached mapping */
+		tegra_fb->cached_base = ioremap_cached(fb_phys, fb_size);
+#endif
 	}
 
+	mutex_init(&tegra_fb->pan_lock);
+	init_waitqueue_head(&tegra_fb->pan_wait);
+	INIT_WORK(&tegra_fb->pan_work, tegra_fb_pan_worker);
+	tegra_fb->pan_wq = create_singlethread_workqueue("tegra_fb_pan");
+	if (!tegra_fb->pan_wq) {
+		ret = -ENOMEM;
+		goto err_iounmap_fb;
+	}
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+	spin_lock_init(&tegra_fb->damage_lock);
+	INIT_DELAYED_WORK(&tegra_fb->damage_work, tegra_fb_damage_worker);
+#endif
+
 	stride = fb_data->xres * fb_data->bits_per_pixel / 8;
 	stride = round_up(stride, TEGRA_LINEAR_PITCH_ALIGNMENT);
 
 	info->fbops = &tegra_fb_ops;
+#ifdef CONFIG_FB_TEGRA_GR2D
+	info->flags = FBINFO_DEFAULT | FBINFO_HWACCEL_FILLRECT |
+		FBINFO_HWACCEL_COPYAREA;
+#endif
 	info->pseudo_palette = pseudo_palette;
 	info->screen_base = fb_base;
 	info->screen_size = fb_size;
@@ -808,7 +1452,7 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 	if (register_framebuffer(info)) {
 		dev_err(&ndev->dev, "failed to register framebuffer\n");
 		ret = -ENODEV;
-		goto err_iounmap_fb;
+		goto err_destroy_wq;
 	}
 
 	tegra_fb->info = info;
@@ -822,7 +1466,13 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 
 	return tegra_fb;
 
+err_destroy_wq:
+	destroy_workqueue(tegra_fb->pan_wq);
 err_iounmap_fb:
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+	if (tegra_fb->cached_base)
+		iounmap(tegra_fb->cached_base);
+#endif
 	if (fb_base)
 		iounmap(fb_base);
 err_free:
@@ -837,6 +1487,13 @@ void tegra_fb_unregister(struct tegra_fb_info *fb_info)
 
 	unregister_framebuffer(info);
 
+	destroy_workqueue(fb_info->pan_wq);
+	tegra_fb_cursor_free(fb_info);
+#ifdef CONFIG_FB_TEGRA_DAMAGE
+	cancel_delayed_work_sync(&fb_info->damage_work);
+	if (fb_info->cached_base)
+		iounmap(fb_info->cached_base);
+#endif
 	iounmap(info->screen_base);
 	framebuffer_release(info);
 }
@@ -180,6 +180,10 @@ int nvhost_device_register(struct nvhost_device *dev)
 	if (!dev->dev.parent && nvhost && nvhost->dev != dev)
 		dev->dev.parent = &nvhost->dev->dev;
 
+	/* host1x, its clients and dc only depend on their parent for
+	 * suspend/resume ordering, so let them resume asynchronously */
+	device_enable_async_suspend(&dev->dev);
+
 	dev->dev.bus = &nvhost_bus_inst->nvhost_bus_type;
 
 	if (dev->id != -1)
@@ -389,6 +389,343 @@ static int nvhost_ioctl_channel_flush(
 	return err;
 }
 
+/* Build and pin one job of a batched submit from its user description */
+static struct nvhost_job *batch_job_get(struct nvhost_channel_userctx *ctx,
+	struct nvhost_submit_batch_job *ujob)
+{
+	struct nvhost_master *host = nvhost_get_host(ctx->ch->dev);
+	struct nvhost_submit_hdr_ext hdr = {
+		.syncpt_id = ujob->syncpt_id,
+		.syncpt_incrs = ujob->syncpt_incrs,
+		.num_cmdbufs = ujob->num_cmdbufs,
+		.num_relocs = ujob->num_relocs,
+		.submit_version = NVHOST_SUBMIT_VERSION_V2,
+		.num_waitchks = ujob->num_waitchks,
+		.waitchk_mask = ujob->waitchk_mask,
+	};
+	struct nvhost_cmdbuf cmdbuf;
+	struct nvhost_job *job;
+	u32 i;
+	int err;
+
+	if (!hdr.num_cmdbufs ||
+	    !nvhost_syncpt_is_valid(&host->syncpt, hdr.syncpt_id))
+		return ERR_PTR(-EIO);
+
+	job = nvhost_job_alloc(ctx->ch, ctx->hwctx, &hdr, ctx->memmgr,
+			ctx->priority, ctx->clientid);
+	if (!job)
+		return ERR_PTR(-ENOMEM);
+	job->timeout = ctx->timeout;
+
+	err = -EFAULT;
+	for (i = 0; i < hdr.num_cmdbufs; i++) {
+		if (copy_from_user(&cmdbuf, &ujob->cmdbufs[i], sizeof(cmdbuf)))
+			goto fail;
+		nvhost_job_add_gather(job,
+			cmdbuf.mem, cmdbuf.words, cmdbuf.offset);
+	}
+
+	if (copy_from_user(job->relocarray, ujob->relocs,
+			hdr.num_relocs * sizeof(struct nvhost_reloc)))
+		goto fail;
+	if (ujob->reloc_shifts) {
+		if (copy_from_user(job->relocshiftarray, ujob->reloc_shifts,
+				hdr.num_relocs *
+				sizeof(struct nvhost_reloc_shift)))
+			goto fail;
+	} else if (hdr.num_relocs) {
+		memset(job->relocshiftarray, 0,
+			hdr.num_relocs * sizeof(struct nvhost_reloc_shift));
+	}
+	job->num_relocs = hdr.num_relocs;
+
+	if (copy_from_user(job->waitchk, ujob->waitchks,
+			hdr.num_waitchks * sizeof(struct nvhost_waitchk)))
+		goto fail;
+	job->num_waitchk = hdr.num_waitchks;
+
+	err = nvhost_job_pin(job, &host->syncpt);
+	if (err)
+		goto fail;
+
+	return job;
+
+fail:
+	nvhost_job_put(job);
+	return ERR_PTR(err);
+}
+
+/*
+ * Submit several jobs with one ioctl. All the jobs are pinned first and then
+ * pushed to the channel together, and each job's fence is written back.
+ */
+static int nvhost_ioctl_channel_submit_batch(
+	struct nvhost_channel_userctx *ctx,
+	struct nvhost_submit_batch_args *args)
+{
+	struct nvhost_device *ndev = ctx->ch->dev;
+	struct nvhost_job *jobs[NVHOST_SUBMIT_BATCH_MAX_JOBS];
+	struct nvhost_submit_batch_job ujob;
+	int i, n, err = 0, fence_err = 0;
+
+	if (!args->num_jobs || args->num_jobs > NVHOST_SUBMIT_BATCH_MAX_JOBS)
+		return -EINVAL;
+
+	if (!ctx->memmgr) {
+		dev_err(&ndev->dev, "no nvmap context set\n");
+		return -EFAULT;
+	}
+
+	for (n = 0; n < args->num_jobs; n++) {
+		if (copy_from_user(&ujob, &args->jobs[n], sizeof(ujob))) {
+			err = -EFAULT;
+			break;
+		}
+		jobs[n] = batch_job_get(ctx, &ujob);
+		if (IS_ERR(jobs[n])) {
+			err = PTR_ERR(jobs[n]);
+			break;
+		}
+		jobs[n]->null_kickoff =
+			nvhost_debug_null_kickoff_pid == current->tgid;
+	}
+
+	if (!err)
+		err = nvhost_channel_submit_batch(jobs, n);
+	trace_nvhost_ioctl_channel_submit_batch(ndev->name, n, err);
+
+	/* nothing was submitted on error, otherwise the sync queue now
+	 * holds the pins */
+	for (i = 0; i < n; i++) {
+		if (err)
+			nvhost_job_unpin(jobs[i]);
+		else if (put_user(jobs[i]->syncpt_end, &args->jobs[i].fence))
+			fence_err = -EFAULT;
+		nvhost_job_put(jobs[i]);
+	}
+
+	return err ? err : fence_err;
+}
+
+/*
+ * Submit one MPE encode job, built from a per-stream command buffer with
+ * this frame's buffers patched in. The input planes can be the nvmap
+ * buffers the camera captured into, so frames reach MPE without a copy.
+ * Context save and restore and the fence work as for any other submit.
+ */
+/*
+ * Submit a single gather that gets the addresses of bufs patched in, for
+ * the fixed function units whose jobs userspace describes buffer by
+ * buffer. Returns the job with a reference held on success.
+ */
+static int nvhost_submit_patched_job(struct nvhost_channel_userctx *ctx,
+	struct nvhost_cmdbuf *cmdbuf, u32 syncpt_id, u32 syncpt_incrs,
+	struct nvhost_encode_buffer **bufs, u32 num_bufs,
+	struct nvhost_job **jobp)
+{
+	struct nvhost_device *ndev = ctx->ch->dev;
+	struct nvhost_master *host = nvhost_get_host(ndev);
+	struct nvhost_submit_hdr_ext hdr = {
+		.syncpt_id = syncpt_id,
+		.syncpt_incrs = syncpt_incrs,
+		.num_cmdbufs = 1,
+		.num_relocs = num_bufs,
+		.submit_version = NVHOST_SUBMIT_VERSION_V2,
+	};
+	struct nvhost_job *job;
+	u64 start, end;
+	u32 i;
+	int err;
+
+	if (!ctx->memmgr) {
+		dev_err(&ndev->dev, "no nvmap context set\n");
+		return -EFAULT;
+	}
+
+	if (!cmdbuf->words || !syncpt_incrs ||
+	    !nvhost_syncpt_is_valid(&host->syncpt, syncpt_id))
+		return -EINVAL;
+
+	/* only words of the gather itself may be patched */
+	start = cmdbuf->offset;
+	end = start + (u64)cmdbuf->words * sizeof(u32);
+	for (i = 0; i < num_bufs; i++) {
+		if ((bufs[i]->patch_offset & (sizeof(u32) - 1)) ||
+		    bufs[i]->patch_offset < start ||
+		    bufs[i]->patch_offset + (u64)sizeof(u32) > end)
+			return -EINVAL;
+	}
+
+	job = nvhost_job_alloc(ctx->ch, ctx->hwctx, &hdr, ctx->memmgr,
+			ctx->priority, ctx->clientid);
+	if (!job)
+		return -ENOMEM;
+	job->timeout = ctx->timeout;
+
+	nvhost_job_add_gather(job, cmdbuf->mem, cmdbuf->words, cmdbuf->offset);
+	for (i = 0; i < num_bufs; i++) {
+		job->relocarray[i].cmdbuf_mem = cmdbuf->mem;
+		job->relocarray[i].cmdbuf_offset = bufs[i]->patch_offset;
+		job->relocarray[i].target = bufs[i]->mem;
+		job->relocarray[i].target_offset = bufs[i]->offset;
+		job->relocshiftarray[i].shift = 0;
+	}
+	job->num_relocs = num_bufs;
+	job->null_kickoff = nvhost_debug_null_kickoff_pid == current->tgid;
+
+	err = nvhost_job_pin(job, &host->syncpt);
+	if (!err) {
+		err = nvhost_channel_submit(job);
+		if (err)
+			nvhost_job_unpin(job);
+	}
+
+	if (err)
+		nvhost_job_put(job);
+	else
+		*jobp = job;
+	return err;
+}
+
+static int nvhost_ioctl_channel_submit_encode(
+	struct nvhost_channel_userctx *ctx,
+	struct nvhost_submit_encode_args *args)
+{
+	struct nvhost_encode_buffer *bufs[NVHOST_ENCODE_MAX_INPUTS + 1];
+	struct nvhost_job *job;
+	u32 i;
+	int err;
+
+	if (ctx->ch->dev->moduleid != NVHOST_MODULE_MPE)
+		return -ENOTTY;
+
+	if (args->num_inputs > NVHOST_ENCODE_MAX_INPUTS)
+		return -EINVAL;
+
+	for (i = 0; i < args->num_inputs; i++)
+		bufs[i] = &args->inputs[i];
+	bufs[i] = &args->output;
+
+	err = nvhost_submit_patched_job(ctx, &args->cmdbuf, args->syncpt_id,
+			args->syncpt_incrs, bufs, args->num_inputs + 1, &job);
+	if (err)
+		return err;
+
+	args->fence = job->syncpt_end;
+	nvhost_job_put(job);
+	return 0;
+}
+
+/*
+ * Per stage timing of an ISP job. A stage starts where the previous one of
+ * the job ended, the first one when the job reached the head of the
+ * channel, so that stages of pipelined frames are not charged for the time
+ * spent waiting behind the previous frame.
+ */
+struct nvhost_isp_timing {
+	struct nvhost_intr_callback cb;
+	struct nvhost_job *job;
+	u32 first_thresh;
+	atomic_t pending;
+	ktime_t stage_end;
+};
+
+static void nvhost_isp_timing_put(struct nvhost_isp_timing *t)
+{
+	if (atomic_dec_and_test(&t->pending)) {
+		nvhost_job_put(t->job);
+		kfree(t);
+	}
+}
+
+static void nvhost_isp_stage_done(struct nvhost_intr_callback *cb, u32 thresh)
+{
+	struct nvhost_isp_timing *t =
+		container_of(cb, struct nvhost_isp_timing, cb);
+	struct nvhost_job *job = t->job;
+	u32 stage = thresh - t->first_thresh;
+	ktime_t now = ktime_get();
+
+	/* stages complete in threshold order, start_ktime is set by the time
+	 * the previous job's completion has been processed */
+	if (!stage)
+		t->stage_end = ktime_to_ns(job->start_ktime) ?
+			job->start_ktime : job->submit_ktime;
+
+	nvhost_cdma_account_stage(&job->ch->cdma, stage, t->stage_end, now);
+	t->stage_end = now;
+
+	nvhost_isp_timing_put(t);
+}
+
+/* timing is best effort, a job is never failed for it */
+static void nvhost_isp_time_stages(struct nvhost_job *job, u32 num_stages)
+{
+	struct nvhost_master *host = nvhost_get_host(job->ch->dev);
+	struct nvhost_isp_timing *t;
+	void *waiter;
+	u32 i;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return;
+
+	t->cb.fn = nvhost_isp_stage_done;
+	t->job = job;
+	t->first_thresh = job->syncpt_end - num_stages + 1;
+	atomic_set(&t->pending, 1);
+	nvhost_job_get(job);
+
+	for (i = 0; i < num_stages; i++) {
+		waiter = nvhost_intr_alloc_waiter();
+		if (!waiter)
+			break;
+		atomic_inc(&t->pending);
+		if (nvhost_intr_add_action(&host->intr, job->syncpt_id,
+				t->first_thresh + i,
+				NVHOST_INTR_ACTION_CALLBACK, &t->cb,
+				waiter, NULL)) {
+			atomic_dec(&t->pending);
+			break;
+		}
+	}
+
+	nvhost_isp_timing_put(t);
+}
+
+static int nvhost_ioctl_channel_submit_isp(
+	struct nvhost_channel_userctx *ctx,
+	struct nvhost_submit_isp_args *args)
+{
+	struct nvhost_encode_buffer *bufs[NVHOST_ISP_MAX_BUFFERS];
+	struct nvhost_job *job;
+	u32 i;
+	int err;
+
+	BUILD_BUG_ON(NVHOST_ISP_MAX_STAGES > NVHOST_CDMA_JOB_STAGES);
+
+	if (ctx->ch->dev->moduleid != NVHOST_MODULE_ISP)
+		return -ENOTTY;
+
+	if (!args->num_stages || args->num_stages > NVHOST_ISP_MAX_STAGES ||
+	    !args->num_buffers || args->num_buffers > NVHOST_ISP_MAX_BUFFERS)
+		return -EINVAL;
+
+	for (i = 0; i < args->num_buffers; i++)
+		bufs[i] = &args->buffers[i];
+
+	err = nvhost_submit_patched_job(ctx, &args->cmdbuf, args->syncpt_id,
+			args->num_stages, bufs, args->num_buffers, &job);
+	if (err)
+		return err;
+
+	args->fence = job->syncpt_end;
+	nvhost_isp_time_stages(job, args->num_stages);
+	nvhost_job_put(job);
+	return 0;
+}
+
 static int nvhost_ioctl_channel_read_3d_reg(struct nvhost_channel_userctx *ctx,
 	struct nvhost_read_3d_reg_args *args)
 {
@@ -455,6 +792,15 @@ static long nvhost_channelctl(struct file *filp,
 			priv->hdr.syncpt_id, priv->hdr.syncpt_incrs);
 		break;
 	}
+	case NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH:
+		err = nvhost_ioctl_channel_submit_batch(priv, (void *)buf);
+		break;
+	case NVHOST_IOCTL_CHANNEL_SUBMIT_ENCODE:
+		err = nvhost_ioctl_channel_submit_encode(priv, (void *)buf);
+		break;
+	case NVHOST_IOCTL_CHANNEL_SUBMIT_ISP:
+		err = nvhost_ioctl_channel_submit_isp(priv, (void *)buf);
+		break;
 	case NVHOST_IOCTL_CHANNEL_GET_SYNCPOINTS:
 		/* host syncpt ID is used by the RM (and never be given out) */
 		BUG_ON(priv->ch->dev->syncpts & (1 << NVSYNCPT_GRAPHICS_HOST));
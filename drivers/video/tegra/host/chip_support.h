@@ -47,6 +47,7 @@ struct nvhost_channel_ops {
 		    struct nvhost_master *,
 		    int chid);
 	int (*submit)(struct nvhost_job *job);
+	int (*submit_batch)(struct nvhost_job **jobs, int num_jobs);
 	int (*read3dreg)(struct nvhost_channel *channel,
 			struct nvhost_hwctx *hwctx,
 			u32 offset,
@@ -77,6 +78,7 @@ struct nvhost_cdma_ops {
 struct nvhost_pushbuffer_ops {
 	void (*reset)(struct push_buffer *);
 	int (*init)(struct push_buffer *);
+	int (*resize)(struct push_buffer *, u32 slots);
 	void (*destroy)(struct push_buffer *);
 	void (*push_to)(struct push_buffer *,
 			struct mem_mgr *, struct mem_handle *,
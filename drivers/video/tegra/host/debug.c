@@ -21,6 +21,7 @@
 #include <linux/seq_file.h>
 
 #include <linux/io.h>
+#include <linux/math64.h>
 
 #include "bus.h"
 #include "dev.h"
@@ -96,6 +97,19 @@ static void show_syncpts(struct nvhost_master *m, struct output *o)
 					i, base_val);
 	}
 
+	for (i = 0; i < nvhost_syncpt_nb_pts(&m->syncpt); i++) {
+		struct nvhost_intr_syncpt *sp = m->intr.syncpt + i;
+
+		if (!sp->irq_count)
+			continue;
+		nvhost_debug_output(o, "irq id %d count %u waiters %u "
+				"total %lluus avg %lluns max %uns\n",
+				i, sp->irq_count, sp->nr_waiters,
+				div_u64(sp->irq_time_ns, 1000),
+				div_u64(sp->irq_time_ns, sp->irq_count),
+				sp->irq_max_ns);
+	}
+
 	nvhost_debug_output(o, "\n");
 }
 
@@ -152,6 +166,137 @@ static void show_all_no_fifo(struct nvhost_master *m, struct output *o)
 	nvhost_module_idle(m->dev);
 }
 
+static int show_job_pool(struct device *dev, void *data)
+{
+	struct nvhost_device *nvdev = to_nvhost_device(dev);
+	struct nvhost_job_pool *pool;
+	struct nvhost_pin_cache *cache;
+	struct output *o = data;
+	unsigned long hits, misses, oversize, total;
+	int nr_free[NVHOST_JOB_POOL_BUCKETS];
+	int i;
+
+	if (nvdev == NULL || !nvdev->channel)
+		return 0;
+
+	pool = &nvdev->channel->job_pool;
+	spin_lock(&pool->lock);
+	hits = pool->hits;
+	misses = pool->misses;
+	oversize = pool->oversize;
+	for (i = 0; i < NVHOST_JOB_POOL_BUCKETS; i++)
+		nr_free[i] = pool->nr_free[i];
+	spin_unlock(&pool->lock);
+
+	total = hits + misses + oversize;
+	nvhost_debug_output(o, "%s: hits %lu misses %lu oversize %lu "
+			"hit rate %lu%% free",
+			nvdev->name, hits, misses, oversize,
+			total ? hits * 100 / total : 0);
+	for (i = 0; i < NVHOST_JOB_POOL_BUCKETS; i++)
+		nvhost_debug_output(o, " %d", nr_free[i]);
+	nvhost_debug_output(o, "\n");
+
+	cache = &nvdev->channel->pin_cache;
+	mutex_lock(&cache->lock);
+	nvhost_debug_output(o, "%s: pin cache hits %lu misses %lu "
+			"evictions %lu\n", nvdev->name,
+			cache->hits, cache->misses, cache->evictions);
+	mutex_unlock(&cache->lock);
+
+	return 0;
+}
+
+static int nvhost_debug_show_job_pools(struct seq_file *s, void *unused)
+{
+	struct output o = {
+		.fn = write_to_seqfile,
+		.ctx = s
+	};
+	bus_for_each_dev(&(nvhost_bus_get())->nvhost_bus_type, NULL, &o,
+			show_job_pool);
+	return 0;
+}
+
+static void show_cdma_wait_stats(struct output *o, const char *what,
+		struct nvhost_cdma_wait_stats *stats)
+{
+	static const char * const names[NVHOST_CDMA_WAIT_HIST_BUCKETS] = {
+		"<16us", "<64us", "<256us", "<1ms",
+		"<4ms", "<16ms", "<64ms", ">=64ms"
+	};
+	int i;
+
+	nvhost_debug_output(o, "  %s %u total %lluus max %uus\n   ",
+			what, stats->count, stats->total_us, stats->max_us);
+	for (i = 0; i < NVHOST_CDMA_WAIT_HIST_BUCKETS; i++)
+		nvhost_debug_output(o, " %s:%u", names[i],
+				stats->hist[i]);
+	nvhost_debug_output(o, "\n");
+}
+
+static int show_cdma_stats(struct device *dev, void *data)
+{
+	struct nvhost_device *nvdev = to_nvhost_device(dev);
+	struct nvhost_channel *ch;
+	struct nvhost_cdma *cdma;
+	struct output *o = data;
+	int i;
+
+	if (nvdev == NULL || !nvdev->channel)
+		return 0;
+
+	ch = nvdev->channel;
+	cdma = &ch->cdma;
+	mutex_lock(&ch->reflock);
+	if (ch->refcount) {
+		mutex_lock(&cdma->lock);
+		nvhost_debug_output(o, "%s: push buffer %u slots (max %u) "
+				"grown %u times\n", nvdev->name,
+				cdma->push_buffer.size / 8,
+				nvdev->push_buffer_max_slots, cdma->pb_grows);
+		show_cdma_wait_stats(o, "push buffer space waits",
+				&cdma->pb_waits);
+		show_cdma_wait_stats(o, "sync queue empty waits",
+				&cdma->sq_waits);
+		show_cdma_wait_stats(o, "jobs queued", &cdma->queue_lat);
+		show_cdma_wait_stats(o, "jobs executed", &cdma->exec_lat);
+		for (i = 0; i < NVHOST_CDMA_LATENCY_CLIENTS; i++) {
+			struct nvhost_cdma_client_latency *c =
+				&cdma->clients[i];
+
+			if (!c->queue.count)
+				continue;
+			nvhost_debug_output(o, " client %d:\n", c->clientid);
+			show_cdma_wait_stats(o, "jobs queued", &c->queue);
+			show_cdma_wait_stats(o, "jobs executed", &c->exec);
+		}
+		for (i = 0; i < NVHOST_CDMA_JOB_STAGES; i++) {
+			char what[16];
+
+			if (!cdma->stage_lat[i].count)
+				continue;
+			snprintf(what, sizeof(what), "stage %d", i);
+			show_cdma_wait_stats(o, what, &cdma->stage_lat[i]);
+		}
+		mutex_unlock(&cdma->lock);
+	}
+	mutex_unlock(&ch->reflock);
+
+	return 0;
+}
+
+static int nvhost_debug_show_cdma_stats(struct seq_file *s, void *unused)
+{
+	struct output o = {
+		.fn = write_to_seqfile,
+		.ctx = s
+	};
+	bus_for_each_dev(&(nvhost_bus_get())->nvhost_bus_type, NULL, &o,
+			show_cdma_stats);
+	return 0;
+}
+
 static int nvhost_debug_show_all(struct seq_file *s, void *unused)
 {
 	struct output o = {
@@ -195,6 +340,32 @@ static const struct file_operations nvhost_debug_fops = {
 	.release	= single_release,
 };
 
+static int nvhost_debug_open_job_pools(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_debug_show_job_pools,
+			inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_job_pools_fops = {
+	.open		= nvhost_debug_open_job_pools,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int nvhost_debug_open_cdma_stats(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_debug_show_cdma_stats,
+			inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_cdma_stats_fops = {
+	.open		= nvhost_debug_open_cdma_stats,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void nvhost_debug_init(struct nvhost_master *master)
 {
 	struct dentry *de = debugfs_create_dir("tegra_host", NULL);
@@ -203,6 +374,10 @@ void nvhost_debug_init(struct nvhost_master *master)
 			master, &nvhost_debug_fops);
 	debugfs_create_file("status_all", S_IRUGO, de,
 			master, &nvhost_debug_all_fops);
+	debugfs_create_file("job_pools", S_IRUGO, de,
+			master, &nvhost_debug_job_pools_fops);
+	debugfs_create_file("cdma_stats", S_IRUGO, de,
+			master, &nvhost_debug_cdma_stats_fops);
 
 	debugfs_create_u32("null_kickoff_pid", S_IRUGO|S_IWUSR, de,
 			&nvhost_debug_null_kickoff_pid);
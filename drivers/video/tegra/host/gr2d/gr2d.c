@@ -20,16 +20,22 @@
 
 #include "dev.h"
 #include "bus_client.h"
+#include "gr2d.h"
 
 static int __devinit gr2d_probe(struct nvhost_device *dev,
 	struct nvhost_device_id *id_table)
 {
-	return nvhost_client_device_init(dev);
+	int err = nvhost_client_device_init(dev);
+
+	if (!err)
+		nvhost_gr2d_job_init(dev);
+	return err;
 }
 
 static int __exit gr2d_remove(struct nvhost_device *dev)
 {
 	/* Add clean-up */
+	nvhost_gr2d_job_deinit(dev);
 	return 0;
 }
 
@@ -0,0 +1,94 @@
+/*
+ * drivers/video/tegra/host/gr2d/gr2d.h
+ *
+ * Tegra Graphics 2D
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NVHOST_GR2D_H
+#define __NVHOST_GR2D_H
+
+struct nvhost_device;
+
+/* Register word offsets shared by the G2 and stretch blit (SB) classes */
+#define GR2D_TRIGGER			0x009
+#define GR2D_CMDSEL			0x00c
+#define GR2D_VDDA			0x011
+#define GR2D_VDDAINI			0x012
+#define GR2D_HDDA			0x013
+#define GR2D_HDDAINILS			0x014
+#define GR2D_CSCFIRST			0x015
+#define GR2D_CSCSECOND			0x016
+#define GR2D_CSCTHIRD			0x017
+#define GR2D_CONTROLSECOND		0x01e
+#define GR2D_CONTROLMAIN		0x01f
+#define GR2D_ROPFADE			0x020
+#define GR2D_DSTBA			0x02b
+#define GR2D_DSTST			0x02e
+#define GR2D_SRCBA			0x031
+#define GR2D_SRCST			0x033
+#define GR2D_SRCFGC			0x035
+#define GR2D_SRCSIZE			0x037
+#define GR2D_DSTSIZE			0x038
+#define GR2D_SRCPS			0x039
+#define GR2D_DSTPS			0x03a
+#define GR2D_TILEMODE			0x046
+
+/* G2 controlmain */
+#define GR2D_CONTROLMAIN_TURBOFILL	(1 << 2)
+#define GR2D_CONTROLMAIN_SRCSLD		(1 << 6)
+#define GR2D_CONTROLMAIN_XDIR		(1 << 9)
+#define GR2D_CONTROLMAIN_YDIR		(1 << 10)
+#define GR2D_CONTROLMAIN_DSTCD(cpp)	(((cpp) >> 1) << 16)
+
+/* G2 controlsecond, fast rotate unit */
+#define GR2D_CONTROLSECOND_FR_MODE_COPY	(1 << 24)
+#define GR2D_CONTROLSECOND_FR_TYPE(t)	((t) << 26)
+
+enum {
+	GR2D_FR_TYPE_FLIP_X = 0,
+	GR2D_FR_TYPE_FLIP_Y,
+	GR2D_FR_TYPE_TRANS_LR,
+	GR2D_FR_TYPE_TRANS_RL,
+	GR2D_FR_TYPE_ROT_90,
+	GR2D_FR_TYPE_ROT_180,
+	GR2D_FR_TYPE_ROT_270,
+	GR2D_FR_TYPE_IDENTITY
+};
+
+/* SB controlmain */
+#define GR2D_SB_CONTROLMAIN_IFMT(f)	((f) << 16)
+#define GR2D_SB_CONTROLMAIN_OFMT(f)	((f) << 20)
+#define GR2D_SB_CONTROLMAIN_CSC_EN	(1 << 25)
+
+enum {
+	GR2D_SB_FMT_RGB565 = 0,
+	GR2D_SB_FMT_B8G8R8A8 = 1,
+	GR2D_SB_FMT_R8G8B8A8 = 2,
+	GR2D_SB_FMT_UYVY = 4,
+	GR2D_SB_FMT_YUYV = 5
+};
+
+/* BT.601 limited range YUV to RGB */
+#define GR2D_CSC_BT601_FIRST		0x012a00f0
+#define GR2D_CSC_BT601_SECOND		0x000001a0
+#define GR2D_CSC_BT601_THIRD		0x00d00204
+
+/* Kernel blit API, backed by the gr2d channel once it has been probed */
+void nvhost_gr2d_job_init(struct nvhost_device *dev);
+void nvhost_gr2d_job_deinit(struct nvhost_device *dev);
+
+#endif
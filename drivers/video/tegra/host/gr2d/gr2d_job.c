@@ -0,0 +1,431 @@
+/*
+ * drivers/video/tegra/host/gr2d/gr2d_job.c
+ *
+ * Tegra Graphics 2D Kernel Blit Jobs
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/nvhost.h>
+#include <linux/slab.h>
+
+#include "dev.h"
+#include "nvhost_acm.h"
+#include "nvhost_cdma.h"
+#include "nvhost_channel.h"
+#include "nvhost_intr.h"
+#include "nvhost_job.h"
+#include "nvhost_syncpt.h"
+#include "host1x/host1x01_hardware.h"
+#include "host1x/host1x_syncpt.h"
+#include "gr2d.h"
+
+/*
+ * Kernel clients get fill, copy and blit operations that are built on the
+ * fly and pushed straight into the gr2d channel's push buffer, the same way
+ * host1x_channel_read_3d_reg() talks to 3D. Every operation programs all
+ * of the state it depends on, so it can be interleaved with userspace
+ * submits on the same channel, and ends with an op done increment of
+ * NVSYNCPT_2D_0 that callers can wait on.
+ */
+
+#define GR2D_KERNEL_SYNCPT	NVSYNCPT_2D_0
+#define GR2D_MAX_WORDS		32
+
+struct gr2d_cmdbuf {
+	u32 words[GR2D_MAX_WORDS];
+	int count;
+};
+
+static struct nvhost_device *gr2d_dev;
+static DEFINE_MUTEX(gr2d_dev_lock);
+
+static void gr2d_push(struct gr2d_cmdbuf *cb, u32 word)
+{
+	BUG_ON(cb->count >= GR2D_MAX_WORDS);
+	cb->words[cb->count++] = word;
+}
+
+static bool gr2d_format_is_yuv(enum nvhost_gr2d_format format)
+{
+	return format == NVHOST_GR2D_FORMAT_UYVY ||
+		format == NVHOST_GR2D_FORMAT_YUYV;
+}
+
+static int gr2d_format_cpp(enum nvhost_gr2d_format format)
+{
+	switch (format) {
+	case NVHOST_GR2D_FORMAT_RGB565:
+	case NVHOST_GR2D_FORMAT_UYVY:
+	case NVHOST_GR2D_FORMAT_YUYV:
+		return 2;
+	case NVHOST_GR2D_FORMAT_B8G8R8A8:
+	case NVHOST_GR2D_FORMAT_R8G8B8A8:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static u32 gr2d_sb_format(enum nvhost_gr2d_format format)
+{
+	switch (format) {
+	case NVHOST_GR2D_FORMAT_B8G8R8A8:
+		return GR2D_SB_FMT_B8G8R8A8;
+	case NVHOST_GR2D_FORMAT_R8G8B8A8:
+		return GR2D_SB_FMT_R8G8B8A8;
+	case NVHOST_GR2D_FORMAT_UYVY:
+		return GR2D_SB_FMT_UYVY;
+	case NVHOST_GR2D_FORMAT_YUYV:
+		return GR2D_SB_FMT_YUYV;
+	default:
+		return GR2D_SB_FMT_RGB565;
+	}
+}
+
+static bool gr2d_rect_valid(const struct nvhost_gr2d_surface *surf,
+		const struct nvhost_gr2d_rect *rect)
+{
+	return gr2d_format_cpp(surf->format) && rect->w && rect->h &&
+		rect->w <= 0xffff && rect->h <= 0xffff &&
+		rect->x + rect->w <= surf->width &&
+		rect->y + rect->h <= surf->height;
+}
+
+static u32 gr2d_rect_addr(const struct nvhost_gr2d_surface *surf,
+		const struct nvhost_gr2d_rect *rect)
+{
+	return surf->base + rect->y * surf->pitch +
+		rect->x * gr2d_format_cpp(surf->format);
+}
+
+static u32 gr2d_xy(u32 x, u32 y)
+{
+	return (y << 16) | x;
+}
+
+static int gr2d_submit(u32 class, struct gr2d_cmdbuf *cb,
+		struct nvhost_gr2d_fence *fence)
+{
+	struct nvhost_master *host;
+	struct nvhost_channel *ch;
+	struct nvhost_job *job;
+	void *completed_waiter;
+	u32 syncval;
+	int i, err;
+
+	mutex_lock(&gr2d_dev_lock);
+	if (!gr2d_dev) {
+		err = -ENODEV;
+		goto unlock;
+	}
+	host = nvhost_get_host(gr2d_dev);
+	ch = gr2d_dev->channel;
+
+	completed_waiter = nvhost_intr_alloc_waiter();
+	if (!completed_waiter) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	job = nvhost_job_alloc(ch, NULL, NULL, host->memmgr, 0, 0);
+	if (!job) {
+		err = -ENOMEM;
+		goto free_waiter;
+	}
+	job->syncpt_id = GR2D_KERNEL_SYNCPT;
+	job->syncpt_incrs = 1;
+	job->timeout = CONFIG_TEGRA_GRHOST_DEFAULT_TIMEOUT;
+
+	/* keep module powered until the submit complete interrupt */
+	nvhost_module_busy(gr2d_dev);
+
+	mutex_lock(&ch->submitlock);
+	err = nvhost_cdma_begin(&ch->cdma, job);
+	if (err) {
+		mutex_unlock(&ch->submitlock);
+		nvhost_module_idle(gr2d_dev);
+		goto put_job;
+	}
+
+	syncval = nvhost_syncpt_incr_max(&host->syncpt, job->syncpt_id, 1);
+	job->syncpt_end = syncval;
+
+	nvhost_cdma_push(&ch->cdma,
+		nvhost_opcode_setclass(class, 0, 0),
+		NVHOST_OPCODE_NOOP);
+	for (i = 0; i < cb->count; i += 2)
+		nvhost_cdma_push(&ch->cdma, cb->words[i],
+			i + 1 < cb->count ?
+				cb->words[i + 1] : NVHOST_OPCODE_NOOP);
+	nvhost_cdma_push(&ch->cdma,
+		nvhost_opcode_imm_incr_syncpt(
+			host1x_uclass_incr_syncpt_cond_op_done_v(),
+			job->syncpt_id),
+		NVHOST_OPCODE_NOOP);
+
+	nvhost_cdma_end(&ch->cdma, job);
+
+	/* schedule a submit complete interrupt */
+	err = nvhost_intr_add_action(&host->intr, job->syncpt_id, syncval,
+			NVHOST_INTR_ACTION_SUBMIT_COMPLETE, ch,
+			completed_waiter, NULL);
+	completed_waiter = NULL;
+	WARN(err, "Failed to set submit complete interrupt");
+	mutex_unlock(&ch->submitlock);
+
+	if (fence) {
+		fence->id = job->syncpt_id;
+		fence->thresh = syncval;
+	}
+	err = 0;
+
+put_job:
+	nvhost_job_put(job);
+free_waiter:
+	kfree(completed_waiter);
+unlock:
+	mutex_unlock(&gr2d_dev_lock);
+	return err;
+}
+
+/* trigger on dstps, then controlsecond, controlmain and ropfade */
+static void gr2d_push_control(struct gr2d_cmdbuf *cb, u32 controlsecond,
+		u32 controlmain, u8 rop)
+{
+	gr2d_push(cb, nvhost_opcode_mask(GR2D_TRIGGER, 0x9));
+	gr2d_push(cb, GR2D_DSTPS);
+	gr2d_push(cb, 0);
+	gr2d_push(cb, nvhost_opcode_mask(GR2D_CONTROLSECOND, 0x7));
+	gr2d_push(cb, controlsecond);
+	gr2d_push(cb, controlmain);
+	gr2d_push(cb, rop);
+	gr2d_push(cb, nvhost_opcode_nonincr(GR2D_TILEMODE, 1));
+	gr2d_push(cb, 0);
+}
+
+/* dstba, dstst, srcba and srcst */
+static void gr2d_push_surfaces(struct gr2d_cmdbuf *cb, u32 dst, u32 dst_pitch,
+		u32 src, u32 src_pitch)
+{
+	gr2d_push(cb, nvhost_opcode_mask(GR2D_DSTBA, 0x149));
+	gr2d_push(cb, dst);
+	gr2d_push(cb, dst_pitch);
+	gr2d_push(cb, src);
+	gr2d_push(cb, src_pitch);
+}
+
+int nvhost_gr2d_fill(const struct nvhost_gr2d_surface *dst,
+		const struct nvhost_gr2d_rect *rect, u32 color, u8 rop,
+		struct nvhost_gr2d_fence *fence)
+{
+	struct gr2d_cmdbuf cb = { .count = 0 };
+	u32 controlmain;
+
+	if (!gr2d_rect_valid(dst, rect) || gr2d_format_is_yuv(dst->format))
+		return -EINVAL;
+
+	controlmain = GR2D_CONTROLMAIN_SRCSLD |
+		GR2D_CONTROLMAIN_DSTCD(gr2d_format_cpp(dst->format));
+	if (rop == NVHOST_GR2D_ROP_COPY)
+		controlmain |= GR2D_CONTROLMAIN_TURBOFILL;
+
+	gr2d_push_control(&cb, 0, controlmain, rop);
+	gr2d_push(&cb, nvhost_opcode_mask(GR2D_DSTBA, 0x9));
+	gr2d_push(&cb, dst->base);
+	gr2d_push(&cb, dst->pitch);
+	gr2d_push(&cb, nvhost_opcode_nonincr(GR2D_SRCFGC, 1));
+	gr2d_push(&cb, color);
+	gr2d_push(&cb, nvhost_opcode_mask(GR2D_DSTSIZE, 0x5));
+	gr2d_push(&cb, gr2d_xy(rect->w, rect->h));
+	gr2d_push(&cb, gr2d_xy(rect->x, rect->y));
+
+	return gr2d_submit(NV_GRAPHICS_2D_CLASS_ID, &cb, fence);
+}
+EXPORT_SYMBOL(nvhost_gr2d_fill);
+
+int nvhost_gr2d_copy(const struct nvhost_gr2d_surface *dst,
+		const struct nvhost_gr2d_surface *src,
+		const struct nvhost_gr2d_rect *rect, u32 sx, u32 sy,
+		struct nvhost_gr2d_fence *fence)
+{
+	struct gr2d_cmdbuf cb = { .count = 0 };
+	struct nvhost_gr2d_rect srect = { sx, sy, rect->w, rect->h };
+	u32 dx = rect->x, dy = rect->y;
+	u32 controlmain;
+
+	if (!gr2d_rect_valid(dst, rect) || !gr2d_rect_valid(src, &srect) ||
+	    gr2d_format_cpp(dst->format) != gr2d_format_cpp(src->format))
+		return -EINVAL;
+
+	controlmain = GR2D_CONTROLMAIN_DSTCD(gr2d_format_cpp(dst->format));
+
+	/* walk overlapping areas from the far end, positions then name the
+	 * last pixel instead of the first */
+	if (dst->base == src->base) {
+		if (sx < dx) {
+			controlmain |= GR2D_CONTROLMAIN_XDIR;
+			sx += rect->w - 1;
+			dx += rect->w - 1;
+		}
+		if (sy < dy) {
+			controlmain |= GR2D_CONTROLMAIN_YDIR;
+			sy += rect->h - 1;
+			dy += rect->h - 1;
+		}
+	}
+
+	gr2d_push_control(&cb, 0, controlmain, NVHOST_GR2D_ROP_COPY);
+	gr2d_push_surfaces(&cb, dst->base, dst->pitch, src->base, src->pitch);
+	gr2d_push(&cb, nvhost_opcode_mask(GR2D_DSTSIZE, 0x7));
+	gr2d_push(&cb, gr2d_xy(rect->w, rect->h));
+	gr2d_push(&cb, gr2d_xy(sx, sy));
+	gr2d_push(&cb, gr2d_xy(dx, dy));
+
+	return gr2d_submit(NV_GRAPHICS_2D_CLASS_ID, &cb, fence);
+}
+EXPORT_SYMBOL(nvhost_gr2d_copy);
+
+static const u32 gr2d_fr_type[] = {
+	[NVHOST_GR2D_TRANSFORM_NONE] = GR2D_FR_TYPE_IDENTITY,
+	[NVHOST_GR2D_TRANSFORM_FLIP_X] = GR2D_FR_TYPE_FLIP_X,
+	[NVHOST_GR2D_TRANSFORM_FLIP_Y] = GR2D_FR_TYPE_FLIP_Y,
+	[NVHOST_GR2D_TRANSFORM_ROT_90] = GR2D_FR_TYPE_ROT_90,
+	[NVHOST_GR2D_TRANSFORM_ROT_180] = GR2D_FR_TYPE_ROT_180,
+	[NVHOST_GR2D_TRANSFORM_ROT_270] = GR2D_FR_TYPE_ROT_270,
+};
+
+/* rotations and flips go through the fast rotate unit, which moves pixels
+ * without scaling or converting them */
+static int gr2d_rotate(const struct nvhost_gr2d_surface *dst,
+		const struct nvhost_gr2d_rect *drect,
+		const struct nvhost_gr2d_surface *src,
+		const struct nvhost_gr2d_rect *srect,
+		enum nvhost_gr2d_transform transform,
+		struct nvhost_gr2d_fence *fence)
+{
+	struct gr2d_cmdbuf cb = { .count = 0 };
+	bool swap = transform == NVHOST_GR2D_TRANSFORM_ROT_90 ||
+		transform == NVHOST_GR2D_TRANSFORM_ROT_270;
+
+	if (dst->format != src->format || gr2d_format_is_yuv(dst->format))
+		return -EINVAL;
+	if (swap ? (drect->w != srect->h || drect->h != srect->w) :
+		   (drect->w != srect->w || drect->h != srect->h))
+		return -EINVAL;
+
+	gr2d_push_control(&cb,
+		GR2D_CONTROLSECOND_FR_MODE_COPY |
+		GR2D_CONTROLSECOND_FR_TYPE(gr2d_fr_type[transform]),
+		GR2D_CONTROLMAIN_DSTCD(gr2d_format_cpp(dst->format)),
+		NVHOST_GR2D_ROP_COPY);
+	gr2d_push_surfaces(&cb, gr2d_rect_addr(dst, drect), dst->pitch,
+		gr2d_rect_addr(src, srect), src->pitch);
+	gr2d_push(&cb, nvhost_opcode_mask(GR2D_SRCSIZE, 0xf));
+	gr2d_push(&cb, gr2d_xy(srect->w, srect->h));
+	gr2d_push(&cb, gr2d_xy(drect->w, drect->h));
+	gr2d_push(&cb, 0);
+	gr2d_push(&cb, 0);
+
+	return gr2d_submit(NV_GRAPHICS_2D_CLASS_ID, &cb, fence);
+}
+
+int nvhost_gr2d_blit(const struct nvhost_gr2d_surface *dst,
+		const struct nvhost_gr2d_rect *drect,
+		const struct nvhost_gr2d_surface *src,
+		const struct nvhost_gr2d_rect *srect,
+		enum nvhost_gr2d_transform transform,
+		struct nvhost_gr2d_fence *fence)
+{
+	struct gr2d_cmdbuf cb = { .count = 0 };
+	u32 controlmain;
+
+	if (!gr2d_rect_valid(dst, drect) || !gr2d_rect_valid(src, srect) ||
+	    gr2d_format_is_yuv(dst->format) ||
+	    transform >= ARRAY_SIZE(gr2d_fr_type))
+		return -EINVAL;
+
+	if (transform != NVHOST_GR2D_TRANSFORM_NONE)
+		return gr2d_rotate(dst, drect, src, srect, transform, fence);
+
+	if (dst->format == src->format &&
+	    drect->w == srect->w && drect->h == srect->h)
+		return nvhost_gr2d_copy(dst, src, drect, srect->x, srect->y,
+				fence);
+
+	/* scale and convert with the stretch blit class; the DDA steps are
+	 * source pixels per destination pixel in 16.16 fixed point */
+	controlmain = GR2D_SB_CONTROLMAIN_IFMT(gr2d_sb_format(src->format)) |
+		GR2D_SB_CONTROLMAIN_OFMT(gr2d_sb_format(dst->format));
+	if (gr2d_format_is_yuv(src->format))
+		controlmain |= GR2D_SB_CONTROLMAIN_CSC_EN;
+
+	gr2d_push_control(&cb, 0, controlmain, NVHOST_GR2D_ROP_COPY);
+	gr2d_push(&cb, nvhost_opcode_mask(GR2D_VDDA, 0xf));
+	gr2d_push(&cb, (srect->h << 16) / drect->h);
+	gr2d_push(&cb, 0);
+	gr2d_push(&cb, (srect->w << 16) / drect->w);
+	gr2d_push(&cb, 0);
+	if (gr2d_format_is_yuv(src->format)) {
+		gr2d_push(&cb, nvhost_opcode_mask(GR2D_CSCFIRST, 0x7));
+		gr2d_push(&cb, GR2D_CSC_BT601_FIRST);
+		gr2d_push(&cb, GR2D_CSC_BT601_SECOND);
+		gr2d_push(&cb, GR2D_CSC_BT601_THIRD);
+	}
+	gr2d_push_surfaces(&cb, gr2d_rect_addr(dst, drect), dst->pitch,
+		gr2d_rect_addr(src, srect), src->pitch);
+	gr2d_push(&cb, nvhost_opcode_mask(GR2D_SRCSIZE, 0xf));
+	gr2d_push(&cb, gr2d_xy(srect->w, srect->h));
+	gr2d_push(&cb, gr2d_xy(drect->w, drect->h));
+	gr2d_push(&cb, 0);
+	gr2d_push(&cb, 0);
+
+	return gr2d_submit(NV_GRAPHICS_2D_SB_CLASS_ID, &cb, fence);
+}
+EXPORT_SYMBOL(nvhost_gr2d_blit);
+
+int nvhost_gr2d_wait(const struct nvhost_gr2d_fence *fence, u32 timeout)
+{
+	struct nvhost_syncpt *sp = NULL;
+
+	/* do not hold off other submits while waiting */
+	mutex_lock(&gr2d_dev_lock);
+	if (gr2d_dev)
+		sp = &nvhost_get_host(gr2d_dev)->syncpt;
+	mutex_unlock(&gr2d_dev_lock);
+
+	if (!sp)
+		return -ENODEV;
+	return nvhost_syncpt_wait_timeout(sp, fence->id, fence->thresh,
+			timeout, NULL);
+}
+EXPORT_SYMBOL(nvhost_gr2d_wait);
+
+void nvhost_gr2d_job_init(struct nvhost_device *dev)
+{
+	mutex_lock(&gr2d_dev_lock);
+	gr2d_dev = dev;
+	mutex_unlock(&gr2d_dev_lock);
+}
+
+void nvhost_gr2d_job_deinit(struct nvhost_device *dev)
+{
+	mutex_lock(&gr2d_dev_lock);
+	if (gr2d_dev == dev)
+		gr2d_dev = NULL;
+	mutex_unlock(&gr2d_dev_lock);
+}
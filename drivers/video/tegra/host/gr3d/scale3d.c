@@ -31,12 +31,19 @@
  *
  * 3d.emc clock is scaled proportionately to 3d clock, with a quadratic-
  * bezier-like factor added to pull 3d.emc rate a bit lower.
+ *
+ * In frame deadline mode (scale3d.p_use_frame_deadline) the tegra-throughput
+ * driver reports the target and measured frame time on every flip instead.
+ * The 3d busy time of the frame, times the current rate, gives the cycles
+ * the frame took; the lowest rate that fits those cycles in
+ * scale3d.p_deadline_pct percent of the target frame time is picked.
  */
 
 #include <linux/debugfs.h>
 #include <linux/types.h>
 #include <linux/clk.h>
 #include <linux/slab.h>
+#include <linux/math64.h>
 #include <mach/clk.h>
 #include <mach/hardware.h>
 #include "scale3d.h"
@@ -86,6 +93,10 @@ static void scale3d_enable(int enable);
  *                 microseconds, clock down.
  * max_scale     - limits rate changes to no less than (100 - max_scale)% or
  *                 (100 + 2 * max_scale)% of current clock rate
+ * use_frame_deadline - pick rates from frame time reports rather than
+ *                      from idle percentages
+ * deadline_pct  - percentage of the target frame time the 3d work of a
+ *                 frame may take in frame deadline mode
  * verbosity     - bit flag to control debug printouts:
  *                 1 - stats
  *                 2 - busy
@@ -112,6 +123,15 @@ struct scale3d_info_rec {
 	unsigned long max_rate_3d;
 	unsigned long min_rate_3d;
 	ktime_t last_throughput_hint;
+	ktime_t boost_until;
+	unsigned long emc_hint;
+	int emc_hint_dropped;
+
+	/* frame deadline mode */
+	ktime_t frame_start;
+	unsigned long frame_busy;
+	u32 deadline_frames;
+	u32 deadline_misses;
 
 	struct work_struct work;
 	struct delayed_work idle_timer;
@@ -138,6 +158,8 @@ struct scale3d_info_rec {
 	unsigned int p_adjust;
 	unsigned int p_scale_emc;
 	unsigned int p_emc_dip;
+	unsigned int p_use_frame_deadline;
+	unsigned int p_deadline_pct;
 	unsigned int p_verbosity;
 	struct clk *clk_3d;
 	struct clk *clk_3d2;
@@ -148,6 +170,14 @@ struct scale3d_info_rec {
 
 static struct scale3d_info_rec scale3d;
 
+/* mirror 3d.emc request as an EMC governor hint */
+static void scale3d_emc_hint(unsigned long hz)
+{
+	scale3d.emc_hint = hz;
+	scale3d.emc_hint_dropped = 0;
+	tegra_emc_bw_hint(TEGRA_EMC_BW_GR3D, hz);
+}
+
 static void scale_to_freq(unsigned long hz)
 {
 	unsigned long curr;
@@ -177,6 +207,7 @@ static void scale_to_freq(unsigned long hz)
 					POW2(after / 1000 - scale3d.emc_xmid) +
 					scale3d.emc_dip_offset);
 			clk_set_rate(scale3d.clk_3d_emc, hz);
+			scale3d_emc_hint(hz);
 		}
 	}
 }
@@ -210,6 +241,9 @@ void nvhost_scale3d_suspend(struct nvhost_device *dev)
 
 	cancel_work_sync(&scale3d.work);
 	cancel_delayed_work(&scale3d.idle_timer);
+
+	tegra_emc_bw_hint(TEGRA_EMC_BW_GR3D, 0);
+	scale3d.emc_hint_dropped = 1;
 }
 
 /* set 3d clocks to max */
@@ -228,13 +262,15 @@ static void reset_3d_clocks(void)
 							scale3d.max_rate_3d);
 		}
 		if (scale3d.p_scale_emc) {
+			unsigned long emc_hz;
+
 			if (is_tegra_camera_on())
-				clk_set_rate(scale3d.clk_3d_emc,
-					CAMERA_3D_EMC_CLK);
+				emc_hz = CAMERA_3D_EMC_CLK;
 			else
-				clk_set_rate(scale3d.clk_3d_emc,
-					clk_round_rate(scale3d.clk_3d_emc,
-								UINT_MAX));
+				emc_hz = clk_round_rate(scale3d.clk_3d_emc,
+							UINT_MAX);
+			clk_set_rate(scale3d.clk_3d_emc, emc_hz);
+			scale3d_emc_hint(emc_hz);
 		}
 	}
 }
@@ -351,6 +387,12 @@ static void scaling_adjust(ktime_t time)
 #undef HINT_RATIO_MID
 #undef HINT_RATIO_DIFF
 
+/* while boosted, 3d clocks are kept at max and never scaled down */
+static int scale3d_is_boosted(ktime_t time)
+{
+	return ktime_us_delta(scale3d.boost_until, time) > 0;
+}
+
 static void scaling_state_check(ktime_t time)
 {
 	unsigned long dt;
@@ -388,6 +430,9 @@ static void scaling_state_check(ktime_t time)
 			scale3d.idle_estimate);
 
 	if (scale3d.idle_estimate > scale3d.idle_max) {
+		if (scale3d_is_boosted(time))
+			return;
+
 		if (!scale3d.is_scaled)
 			scale3d.is_scaled = 1;
 
@@ -399,6 +444,16 @@ static void scaling_state_check(ktime_t time)
 	}
 }
 
+/* 3d busy time of the current frame since the last load notification */
+static unsigned long frame_busy_since(ktime_t now)
+{
+	ktime_t from = scale3d.last_notification;
+
+	if (ktime_us_delta(scale3d.frame_start, from) > 0)
+		from = scale3d.frame_start;
+	return (unsigned long) ktime_us_delta(now, from);
+}
+
 /* the idle estimate is done by keeping 2 time stamps, initially set to the
  * same time. Once the estimation_window time has been exceeded, one time
  * stamp is moved up to the current time. The idle estimate is calculated
@@ -432,6 +487,8 @@ static void update_load_estimate(int idle)
 	if (scale3d.is_idle) {
 		scale3d.total_idle += t;
 		scale3d.last_total_idle += t;
+	} else {
+		scale3d.frame_busy += frame_busy_since(now);
 	}
 
 	scale3d.is_idle = idle;
@@ -506,6 +563,10 @@ void nvhost_scale3d_notify_busy(struct nvhost_device *dev)
 	mutex_lock(&scale3d.lock);
 
 	cancel_delayed_work(&scale3d.idle_timer);
+	if (scale3d.emc_hint_dropped) {
+		scale3d.emc_hint_dropped = 0;
+		tegra_emc_bw_hint(TEGRA_EMC_BW_GR3D, scale3d.emc_hint);
+	}
 	scaling_state_check(t);
 
 	mutex_unlock(&scale3d.lock);
@@ -590,6 +651,7 @@ int freqlist_down(long target, int steps)
 
 static struct score *busy_history;
 static struct score *hint_history;
+static struct score *work_history;
 
 /* When a throughput hint is given, perform scaling based on the hint and on
  * the current idle estimation. This is done as follows:
@@ -614,7 +676,7 @@ void nvhost_scale3d_set_throughput_hint(int hint)
 	if (!scale3d.enable)
 		return;
 
-	if (!scale3d.p_use_throughput_hint)
+	if (!scale3d.p_use_throughput_hint || scale3d.p_use_frame_deadline)
 		return;
 
 	if (scale3d.p_verbosity & GR3D_PRINT_HINT)
@@ -669,6 +731,9 @@ void nvhost_scale3d_set_throughput_hint(int hint)
 		}
 	}
 
+	if (scale3d_is_boosted(now) && target < curr)
+		target = curr;
+
 	scale_to_freq(target);
 
 	if (scale3d.p_verbosity & GR3D_PRINT_TARGET)
@@ -677,6 +742,86 @@ void nvhost_scale3d_set_throughput_hint(int hint)
 }
 EXPORT_SYMBOL(nvhost_scale3d_set_throughput_hint);
 
+/* Frame deadline mode: called on every flip with the target and measured
+ * frame time in usec. The cycles of the last frame are compared with the
+ * running average, and the larger one decides the rate so that heavier
+ * frames are served at once while lighter ones lower the rate gradually.
+ * A frame that took over 1.5 target frame times is a deadline miss, which
+ * also pushes the rate p_scale_step steps further up.
+ */
+void nvhost_scale3d_set_frame_time(unsigned int target_us,
+				   unsigned int frame_us)
+{
+	ktime_t now;
+	unsigned long curr, busy, budget, work, avg_work, target;
+	int miss;
+
+	if (!scale3d.enable || !scale3d.p_use_frame_deadline || !target_us)
+		return;
+
+	now = ktime_get();
+
+	mutex_lock(&scale3d.lock);
+
+	if (ktime_us_delta(now, scale3d.last_throughput_hint) > GR3D_TIMEFRAME)
+		score_reset(work_history);
+	scale3d.last_throughput_hint = now;
+
+	busy = scale3d.frame_busy;
+	if (!scale3d.is_idle)
+		busy += frame_busy_since(now);
+	scale3d.frame_busy = 0;
+	scale3d.frame_start = now;
+
+	miss = frame_us > target_us + target_us / 2;
+	scale3d.deadline_frames++;
+	if (miss)
+		scale3d.deadline_misses++;
+
+	curr = clk_get_rate(scale3d.clk_3d);
+	work = busy * (curr / 1000000);		/* cycles */
+	score_add(work_history, work);
+	avg_work = max(work, (unsigned long) score_get_average(work_history));
+
+	budget = max(1UL, (unsigned long) target_us * scale3d.p_deadline_pct
+			/ 100);
+	target = (unsigned long) div_u64((u64) avg_work * 1000000, budget);
+	target = freqlist_up(target, miss ? scale3d.p_scale_step : 0);
+
+	if (scale3d_is_boosted(now) && target < curr)
+		target = curr;
+
+	mutex_unlock(&scale3d.lock);
+
+	scale_to_freq(target);
+
+	if (scale3d.p_verbosity & GR3D_PRINT_TARGET)
+		pr_info("3dfs: frame %u/%u us, busy %lu us, curr %lu, "
+			"t %lu%s\n",
+			frame_us, target_us, busy, curr / 1000000, target,
+			miss ? " (miss)" : "");
+}
+EXPORT_SYMBOL(nvhost_scale3d_set_frame_time);
+
+/*
+ * Pre-arm 3d clocks ahead of expected load (e.g. user input): raise them to
+ * max right away and suppress scaling down for duration_ms.
+ */
+void nvhost_scale3d_boost(unsigned int duration_ms)
+{
+	if (!scale3d_is_enabled())
+		return;
+
+	mutex_lock(&scale3d.lock);
+	scale3d.boost_until = ktime_add_us(ktime_get(),
+				(u64)duration_ms * USEC_PER_MSEC);
+	scale3d.is_scaled = 0;
+	mutex_unlock(&scale3d.lock);
+
+	reset_3d_clocks();
+}
+EXPORT_SYMBOL(nvhost_scale3d_boost);
+
 static void scale3d_idle_handler(struct work_struct *work)
 {
 	int notify_idle = 0;
@@ -692,6 +837,12 @@ static void scale3d_idle_handler(struct work_struct *work)
 			notify_idle = 1;
 	}
 
+	/* sustained idle: stop holding EMC up on behalf of 3d */
+	if (scale3d.is_idle && !scale3d.emc_hint_dropped) {
+		scale3d.emc_hint_dropped = 1;
+		tegra_emc_bw_hint(TEGRA_EMC_BW_GR3D, 0);
+	}
+
 	mutex_unlock(&scale3d.lock);
 
 	if (notify_idle)
@@ -733,8 +884,15 @@ void nvhost_scale3d_debug_init(struct dentry *de)
 	CREATE_SCALE3D_FILE(throughput_lo_limit);
 	CREATE_SCALE3D_FILE(throughput_lower_limit);
 	CREATE_SCALE3D_FILE(scale_step);
+	CREATE_SCALE3D_FILE(use_frame_deadline);
+	CREATE_SCALE3D_FILE(deadline_pct);
 	CREATE_SCALE3D_FILE(verbosity);
 #undef CREATE_SCALE3D_FILE
+
+	debugfs_create_u32("deadline_frames", S_IRUGO, d,
+			&scale3d.deadline_frames);
+	debugfs_create_u32("deadline_misses", S_IRUGO, d,
+			&scale3d.deadline_misses);
 }
 
 static ssize_t enable_3d_scaling_show(struct device *device,
@@ -885,6 +1043,8 @@ void nvhost_scale3d_init(struct nvhost_device *d)
 		scale3d.p_scale_step = 1;
 		scale3d.p_estimation_window = 8000;
 		scale3d.p_busy_cutoff = 750;
+		scale3d.p_use_frame_deadline = 0;
+		scale3d.p_deadline_pct = 90;
 
 		error = device_create_file(&d->dev,
 				&dev_attr_enable_3d_scaling);
@@ -922,6 +1082,11 @@ void nvhost_scale3d_init(struct nvhost_device *d)
 			pr_err("%s: can\'t init throughput tracking array\n",
 			       __func__);
 
+		work_history = score_init(GR3D_FRAME_SPAN);
+		if (work_history == NULL)
+			pr_err("%s: can\'t init frame work tracking array\n",
+			       __func__);
+
 		scale3d.init = 1;
 	}
 }
@@ -938,4 +1103,5 @@ void nvhost_scale3d_deinit(struct nvhost_device *dev)
 
 	score_delete(busy_history);
 	score_delete(hint_history);
+	score_delete(work_history);
 }
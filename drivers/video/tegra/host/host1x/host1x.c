@@ -37,6 +37,7 @@
 #include "nvhost_acm.h"
 #include "nvhost_channel.h"
 #include "nvhost_job.h"
+#include "nvhost_fence.h"
 
 #define DRIVER_NAME		"host1x"
 
@@ -235,6 +236,34 @@ static int nvhost_ioctl_ctrl_get_version(struct nvhost_ctrl_userctx *ctx,
 	return 0;
 }
 
+static int nvhost_ioctl_ctrl_sync_fence_create(struct nvhost_ctrl_userctx *ctx,
+	struct nvhost_ctrl_sync_fence_create_args *args)
+{
+	int fd;
+
+	fd = nvhost_fence_create_fd(ctx->dev,
+			(struct nvhost_ctrl_sync_fence_info __user *)args->pts,
+			args->num_pts);
+	if (fd < 0)
+		return fd;
+
+	args->fence_fd = fd;
+	return 0;
+}
+
+static int nvhost_ioctl_ctrl_sync_fence_merge(struct nvhost_ctrl_userctx *ctx,
+	struct nvhost_ctrl_sync_fence_merge_args *args)
+{
+	int fd;
+
+	fd = nvhost_fence_merge_fd(ctx->dev, args->fd1, args->fd2);
+	if (fd < 0)
+		return fd;
+
+	args->fence_fd = fd;
+	return 0;
+}
+
 static long nvhost_ctrlctl(struct file *filp,
 	unsigned int cmd, unsigned long arg)
 {
@@ -275,6 +304,12 @@ static long nvhost_ctrlctl(struct file *filp,
 	case NVHOST_IOCTL_CTRL_GET_VERSION:
 		err = nvhost_ioctl_ctrl_get_version(priv, (void *)buf);
 		break;
+	case NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE:
+		err = nvhost_ioctl_ctrl_sync_fence_create(priv, (void *)buf);
+		break;
+	case NVHOST_IOCTL_CTRL_SYNC_FENCE_MERGE:
+		err = nvhost_ioctl_ctrl_sync_fence_merge(priv, (void *)buf);
+		break;
 	default:
 		err = -ENOTTY;
 		break;
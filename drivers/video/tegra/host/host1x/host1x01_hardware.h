@@ -31,6 +31,8 @@
 enum {
 	NV_HOST1X_CLASS_ID = 0x1,
 	NV_VIDEO_ENCODE_MPEG_CLASS_ID = 0x20,
+	NV_GRAPHICS_2D_CLASS_ID = 0x51,
+	NV_GRAPHICS_2D_SB_CLASS_ID = 0x52,
 	NV_GRAPHICS_3D_CLASS_ID = 0x60
 };
 
@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/log2.h>
 #include <linux/slab.h>
 #include "nvhost_acm.h"
 #include "nvhost_cdma.h"
@@ -52,14 +53,14 @@ static void cdma_timeout_handler(struct work_struct *work);
  */
 static void push_buffer_reset(struct push_buffer *pb)
 {
-	pb->fence = PUSH_BUFFER_SIZE - 8;
+	pb->fence = pb->size - 8;
 	pb->cur = 0;
 }
 
 /**
- * Init push buffer resources
+ * Allocate, map and pin a push buffer of the given size in bytes
  */
-static int push_buffer_init(struct push_buffer *pb)
+static int push_buffer_alloc(struct push_buffer *pb, u32 size)
 {
 	struct nvhost_cdma *cdma = pb_to_cdma(pb);
 	struct mem_mgr *mgr = cdma_to_memmgr(cdma);
@@ -67,12 +68,13 @@ static int push_buffer_init(struct push_buffer *pb)
 	pb->mapped = NULL;
 	pb->phys = 0;
 	pb->client_handle = NULL;
+	pb->size = size;
 
 	BUG_ON(!cdma_pb_op().reset);
 	cdma_pb_op().reset(pb);
 
 	/* allocate and map pushbuffer memory */
-	pb->mem = mem_op().alloc(mgr, PUSH_BUFFER_SIZE + 4, 32,
+	pb->mem = mem_op().alloc(mgr, size + 4, 32,
 			      mem_mgr_flag_write_combine);
 	if (IS_ERR_OR_NULL(pb->mem)) {
 		pb->mem = NULL;
@@ -90,14 +92,14 @@ static int push_buffer_init(struct push_buffer *pb)
 	}
 
 	/* memory for storing nvmap client and handles for each opcode pair */
-	pb->client_handle = kzalloc(NVHOST_GATHER_QUEUE_SIZE *
+	pb->client_handle = kzalloc((size / 8) *
 				sizeof(struct mem_mgr_handle),
 			GFP_KERNEL);
 	if (!pb->client_handle)
 		goto fail;
 
 	/* put the restart at the end of pushbuffer memory */
-	*(pb->mapped + (PUSH_BUFFER_SIZE >> 2)) =
+	*(pb->mapped + (size >> 2)) =
 		nvhost_opcode_restart(pb->phys);
 
 	return 0;
@@ -107,6 +109,45 @@ fail:
 	return -ENOMEM;
 }
 
+/**
+ * Init push buffer resources
+ */
+static int push_buffer_init(struct push_buffer *pb)
+{
+	struct nvhost_cdma *cdma = pb_to_cdma(pb);
+	struct nvhost_device *dev = cdma_to_channel(cdma)->dev;
+	u32 slots = dev->push_buffer_slots ? : NVHOST_GATHER_QUEUE_SIZE;
+
+	BUG_ON(!is_power_of_2(slots));
+	return push_buffer_alloc(pb, slots * 8);
+}
+
+/**
+ * Replace an empty push buffer with one of a different size. CDMA must be
+ * stopped. On failure the current buffer is kept.
+ */
+static int push_buffer_resize(struct push_buffer *pb, u32 slots)
+{
+	struct push_buffer old = *pb, new;
+	int err;
+
+	BUG_ON(pb_to_cdma(pb)->running);
+	BUG_ON(!is_power_of_2(slots));
+
+	err = push_buffer_alloc(pb, slots * 8);
+	if (err) {
+		*pb = old;
+		return err;
+	}
+
+	/* destroy needs the embedded pb to find the cdma */
+	new = *pb;
+	*pb = old;
+	cdma_pb_op().destroy(pb);
+	*pb = new;
+	return 0;
+}
+
 /**
  * Clean up push buffer resources
  */
@@ -141,13 +182,13 @@ static void push_buffer_push_to(struct push_buffer *pb,
 {
 	u32 cur = pb->cur;
 	u32 *p = (u32 *)((u32)pb->mapped + cur);
-	u32 cur_nvmap = (cur/8) & (NVHOST_GATHER_QUEUE_SIZE - 1);
+	u32 cur_nvmap = (cur/8) & (pb->size/8 - 1);
 	BUG_ON(cur == pb->fence);
 	*(p++) = op1;
 	*(p++) = op2;
 	pb->client_handle[cur_nvmap].client = client;
 	pb->client_handle[cur_nvmap].handle = handle;
-	pb->cur = (cur + 8) & (PUSH_BUFFER_SIZE - 1);
+	pb->cur = (cur + 8) & (pb->size - 1);
 }
 
 /**
@@ -162,13 +203,13 @@ static void push_buffer_pop_from(struct push_buffer *pb,
 	u32 fence_nvmap = pb->fence/8;
 	for (i = 0; i < slots; i++) {
 		int cur_fence_nvmap = (fence_nvmap+i)
-				& (NVHOST_GATHER_QUEUE_SIZE - 1);
+				& (pb->size/8 - 1);
 		struct mem_mgr_handle *h = &pb->client_handle[cur_fence_nvmap];
 		h->client = NULL;
 		h->handle = NULL;
 	}
 	/* Advance the next write position */
-	pb->fence = (pb->fence + slots * 8) & (PUSH_BUFFER_SIZE - 1);
+	pb->fence = (pb->fence + slots * 8) & (pb->size - 1);
 }
 
 /**
@@ -176,7 +217,7 @@ static void push_buffer_pop_from(struct push_buffer *pb,
  */
 static u32 push_buffer_space(struct push_buffer *pb)
 {
-	return ((pb->fence - pb->cur) & (PUSH_BUFFER_SIZE - 1)) / 8;
+	return ((pb->fence - pb->cur) & (pb->size - 1)) / 8;
 }
 
 static u32 push_buffer_putptr(struct push_buffer *pb)
@@ -252,7 +293,7 @@ static void cdma_timeout_cpu_incr(struct nvhost_cdma *cdma, u32 getptr,
 		*(p++) = NVHOST_OPCODE_NOOP;
 		dev_dbg(&dev->dev->dev, "%s: NOP at 0x%x\n",
 			__func__, pb->phys + getidx);
-		getidx = (getidx + 8) & (PUSH_BUFFER_SIZE - 1);
+		getidx = (getidx + 8) & (pb->size - 1);
 	}
 	wmb();
 }
@@ -508,6 +549,7 @@ static const struct nvhost_cdma_ops host1x_cdma_ops = {
 static const struct nvhost_pushbuffer_ops host1x_pushbuffer_ops = {
 	.reset = push_buffer_reset,
 	.init = push_buffer_init,
+	.resize = push_buffer_resize,
 	.destroy = push_buffer_destroy,
 	.push_to = push_buffer_push_to,
 	.pop_from = push_buffer_pop_from,
@@ -25,13 +25,11 @@
  * many command buffers. If it is too large, we waste memory. */
 #define NVHOST_SYNC_QUEUE_SIZE 512
 
-/* Number of gathers we allow to be queued up per channel. Must be a
- * power of two. Currently sized such that pushbuffer is 4KB (512*8B). */
+/* Default number of gathers we allow to be queued up per channel, used
+ * when the device does not set push_buffer_slots. Must be a power of two.
+ * Currently sized such that pushbuffer is 4KB (512*8B). */
 #define NVHOST_GATHER_QUEUE_SIZE 512
 
-/* 8 bytes per slot. (This number does not include the final RESTART.) */
-#define PUSH_BUFFER_SIZE (NVHOST_GATHER_QUEUE_SIZE * 8)
-
 /* 4K page containing GATHERed methods to increment channel syncpts
  * and replaces the original timed out contexts GATHER slots */
 #define SYNCPT_INCR_BUFFER_SIZE_WORDS   (4096 / sizeof(u32))
@@ -195,61 +195,15 @@ static void submit_gathers(struct nvhost_job *job)
 	}
 }
 
-static int host1x_channel_submit(struct nvhost_job *job)
+/* Push one job of a submit. Must be called inside a cdma submit with the
+ * channel's submit lock held. */
+static void submit_job_locked(struct nvhost_job *job, void *ctxsave_waiter)
 {
 	struct nvhost_channel *ch = job->ch;
 	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
 	u32 user_syncpt_incrs = job->syncpt_incrs;
-	u32 prev_max = 0;
+	u32 prev_max = job->syncpt_end;
 	u32 syncval;
-	int err;
-	void *completed_waiter = NULL, *ctxsave_waiter = NULL;
-	struct nvhost_driver *drv = to_nvhost_driver(ch->dev->dev.driver);
-
-	/* Bail out on timed out contexts */
-	if (job->hwctx && job->hwctx->has_timedout)
-		return -ETIMEDOUT;
-
-	/* Turn on the client module and host1x */
-	nvhost_module_busy(ch->dev);
-	if (drv->busy)
-		drv->busy(ch->dev);
-
-	/* before error checks, return current max */
-	prev_max = job->syncpt_end =
-		nvhost_syncpt_read_max(sp, job->syncpt_id);
-
-	/* get submit lock */
-	err = mutex_lock_interruptible(&ch->submitlock);
-	if (err) {
-		nvhost_module_idle(ch->dev);
-		goto error;
-	}
-
-	/* Do the needed allocations */
-	ctxsave_waiter = pre_submit_ctxsave(job, ch->cur_ctx);
-	if (IS_ERR(ctxsave_waiter)) {
-		err = PTR_ERR(ctxsave_waiter);
-		nvhost_module_idle(ch->dev);
-		mutex_unlock(&ch->submitlock);
-		goto error;
-	}
-
-	completed_waiter = nvhost_intr_alloc_waiter();
-	if (!completed_waiter) {
-		nvhost_module_idle(ch->dev);
-		mutex_unlock(&ch->submitlock);
-		err = -ENOMEM;
-		goto error;
-	}
-
-	/* begin a CDMA submit */
-	err = nvhost_cdma_begin(&ch->cdma, job);
-	if (err) {
-		mutex_unlock(&ch->submitlock);
-		nvhost_module_idle(ch->dev);
-		goto error;
-	}
 
 	if (ch->dev->serialize) {
 		/* Force serialization by inserting a host wait for the
@@ -285,31 +239,112 @@ static int host1x_channel_submit(struct nvhost_job *job)
 
 	sync_waitbases(ch, job->syncpt_end);
 
-	/* end CDMA submit & stash pinned hMems into sync queue */
-	nvhost_cdma_end(&ch->cdma, job);
-
 	trace_nvhost_channel_submitted(ch->dev->name,
 			prev_max, syncval);
+}
 
-	/* schedule a submit complete interrupt */
-	err = nvhost_intr_add_action(&nvhost_get_host(ch->dev)->intr,
-			job->syncpt_id, syncval,
-			NVHOST_INTR_ACTION_SUBMIT_COMPLETE, ch,
-			completed_waiter,
-			NULL);
-	completed_waiter = NULL;
-	WARN(err, "Failed to set submit complete interrupt");
+/*
+ * Submit jobs of one client in a single cdma submit. Each job still gets
+ * its own sync queue entry and submit complete interrupt, but DMA is
+ * kicked once for all of them.
+ */
+static int host1x_channel_submit_batch(struct nvhost_job **jobs, int num_jobs)
+{
+	struct nvhost_channel *ch = jobs[0]->ch;
+	struct nvhost_syncpt *sp = &nvhost_get_host(ch->dev)->syncpt;
+	void *completed_waiters[NVHOST_SUBMIT_BATCH_MAX_JOBS] = { NULL };
+	void *ctxsave_waiter = NULL;
+	struct nvhost_driver *drv = to_nvhost_driver(ch->dev->dev.driver);
+	int i, err;
+
+	BUG_ON(num_jobs < 1 || num_jobs > NVHOST_SUBMIT_BATCH_MAX_JOBS);
+
+	/* Bail out on timed out contexts */
+	for (i = 0; i < num_jobs; i++)
+		if (jobs[i]->hwctx && jobs[i]->hwctx->has_timedout)
+			return -ETIMEDOUT;
+
+	/* Turn on the client module and host1x, once for each job as each
+	 * submit complete drops one reference */
+	for (i = 0; i < num_jobs; i++) {
+		nvhost_module_busy(ch->dev);
+		if (drv->busy)
+			drv->busy(ch->dev);
+	}
+
+	/* before error checks, return current max */
+	for (i = 0; i < num_jobs; i++)
+		jobs[i]->syncpt_end =
+			nvhost_syncpt_read_max(sp, jobs[i]->syncpt_id);
+
+	/* get submit lock */
+	err = mutex_lock_interruptible(&ch->submitlock);
+	if (err)
+		goto idle;
+
+	/* Do the needed allocations */
+	ctxsave_waiter = pre_submit_ctxsave(jobs[0], ch->cur_ctx);
+	if (IS_ERR(ctxsave_waiter)) {
+		err = PTR_ERR(ctxsave_waiter);
+		ctxsave_waiter = NULL;
+		goto unlock;
+	}
+
+	for (i = 0; i < num_jobs; i++) {
+		completed_waiters[i] = nvhost_intr_alloc_waiter();
+		if (!completed_waiters[i]) {
+			err = -ENOMEM;
+			goto unlock;
+		}
+	}
+
+	/* begin a CDMA submit */
+	err = nvhost_cdma_begin(&ch->cdma, jobs[0]);
+	if (err)
+		goto unlock;
+
+	/* only the first job can switch contexts, the rest share it */
+	for (i = 0; i < num_jobs; i++) {
+		if (i)
+			nvhost_cdma_split(&ch->cdma, jobs[i - 1]);
+		submit_job_locked(jobs[i], ctxsave_waiter);
+		ctxsave_waiter = NULL;
+	}
+
+	/* end CDMA submit & stash pinned hMems into sync queue */
+	nvhost_cdma_end(&ch->cdma, jobs[num_jobs - 1]);
+
+	/* schedule a submit complete interrupt for each job */
+	for (i = 0; i < num_jobs; i++) {
+		err = nvhost_intr_add_action(&nvhost_get_host(ch->dev)->intr,
+				jobs[i]->syncpt_id, jobs[i]->syncpt_end,
+				NVHOST_INTR_ACTION_SUBMIT_COMPLETE, ch,
+				completed_waiters[i],
+				NULL);
+		completed_waiters[i] = NULL;
+		WARN(err, "Failed to set submit complete interrupt");
+	}
 
 	mutex_unlock(&ch->submitlock);
 
 	return 0;
 
-error:
+unlock:
+	mutex_unlock(&ch->submitlock);
+idle:
+	for (i = 0; i < num_jobs; i++)
+		nvhost_module_idle(ch->dev);
 	kfree(ctxsave_waiter);
-	kfree(completed_waiter);
+	for (i = 0; i < num_jobs; i++)
+		kfree(completed_waiters[i]);
 	return err;
 }
 
+static int host1x_channel_submit(struct nvhost_job *job)
+{
+	return host1x_channel_submit_batch(&job, 1);
+}
+
 static int host1x_channel_read_3d_reg(
 	struct nvhost_channel *channel,
 	struct nvhost_hwctx *hwctx,
@@ -675,6 +710,7 @@ static int host1x_channel_init(struct nvhost_channel *ch,
 static const struct nvhost_channel_ops host1x_channel_ops = {
 	.init = host1x_channel_init,
 	.submit = host1x_channel_submit,
+	.submit_batch = host1x_channel_submit_batch,
 	.read3dreg = host1x_channel_read_3d_reg,
 	.save_context = host1x_save_context,
 	.drain_read_fifo = host1x_drain_read_fifo,
@@ -27,6 +27,8 @@
 #include <linux/device.h>
 #include <linux/delay.h>
 #include <linux/platform_device.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
 #include <mach/powergate.h>
 #include <mach/clk.h>
 #include <mach/hardware.h>
@@ -35,6 +37,25 @@
 #define POWERGATE_DELAY 			10
 #define MAX_DEVID_LENGTH			16
 
+/* idle gaps are averaged with weight 1/2^ACM_GAP_SHIFT per sample and
+ * clamped to ACM_GAP_MAX_MS so that one long pause does not swamp them */
+#define ACM_GAP_SHIFT				2
+#define ACM_GAP_MAX_MS				10000
+/* gating only pays off when the gap outlasts this many wake latencies */
+#define ACM_BREAKEVEN_FACTOR			16
+/* adaptive delays stay within [static / 2, static * 4] */
+#define ACM_DELAY_MAX_MULT			4
+/* a busy period is predictable while its jitter stays under 1/2^this */
+#define ACM_PERIOD_JITTER_SHIFT			3
+/* ungate this many average wake latencies, plus a margin, ahead of time */
+#define ACM_PREDICT_LEAD_FACTOR			2
+#define ACM_PREDICT_MARGIN_MS			1
+
+static bool adaptive_gating = true;
+module_param(adaptive_gating, bool, 0644);
+MODULE_PARM_DESC(adaptive_gating,
+	"Tune gating delays to the observed idle gaps");
+
 DEFINE_MUTEX(client_list_lock);
 
 struct nvhost_module_client {
@@ -153,15 +174,17 @@ static void to_state_running_locked(struct nvhost_device *dev)
 		/* Invoke callback after enabling clock. This is used for
 		 * re-enabling host1x interrupts. */
 		if (prev_state == NVHOST_POWER_STATE_CLOCKGATED
-				&& drv->finalize_clockon)
+				&& !dev->predicted && drv->finalize_clockon)
 			drv->finalize_clockon(dev);
 
 		/* Invoke callback after power un-gating. This is used for
-		 * restoring context. */
-		if (prev_state == NVHOST_POWER_STATE_POWERGATED
-				&& drv->finalize_poweron)
+		 * restoring context. A predictive ungate left the partition
+		 * clock gated but its context still needs restoring. */
+		if ((prev_state == NVHOST_POWER_STATE_POWERGATED
+				|| dev->predicted) && drv->finalize_poweron)
 			drv->finalize_poweron(dev);
 	}
+	dev->predicted = false;
 	dev->powerstate = NVHOST_POWER_STATE_RUNNING;
 }
 
@@ -174,7 +197,9 @@ static int to_state_powergated_locked(struct nvhost_device *dev)
 	int err = 0;
 	struct nvhost_driver *drv = to_nvhost_driver(dev->dev.driver);
 
-	if (drv->prepare_poweroff
+	/* After an unused predictive ungate the context saved at the last
+	 * power gating is still current, so there is nothing to save. */
+	if (drv->prepare_poweroff && !dev->predicted
 			&& dev->powerstate != NVHOST_POWER_STATE_POWERGATED) {
 		/* Clock needs to be on in prepare_poweroff */
 		to_state_running_locked(dev);
@@ -191,6 +216,7 @@ static int to_state_powergated_locked(struct nvhost_device *dev)
 		do_powergate_locked(dev->powergate_ids[1]);
 	}
 
+	dev->predicted = false;
 	dev->powerstate = NVHOST_POWER_STATE_POWERGATED;
 	return 0;
 }
@@ -199,13 +225,118 @@ static void schedule_powergating_locked(struct nvhost_device *dev)
 {
 	if (dev->can_powergate)
 		schedule_delayed_work(&dev->powerstate_down,
-				msecs_to_jiffies(dev->powergate_delay));
+				msecs_to_jiffies(dev->cur_powergate_delay));
 }
 
 static void schedule_clockgating_locked(struct nvhost_device *dev)
 {
 	schedule_delayed_work(&dev->powerstate_down,
-			msecs_to_jiffies(dev->clockgate_delay));
+			msecs_to_jiffies(dev->cur_clockgate_delay));
+}
+
+static void account_wake_locked(struct nvhost_module_wake_stats *stats,
+		u32 us)
+{
+	stats->count++;
+	if (stats->count == 1)
+		stats->avg_us = us;
+	else
+		stats->avg_us = stats->avg_us - (stats->avg_us >> 3) + (us >> 3);
+	stats->max_us = max(stats->max_us, us);
+}
+
+/*
+ * Pick the delay before entering a gated state from the average idle gap.
+ * A gap shorter than the break-even time would pay a wake for nothing, so
+ * the delay is stretched to ride over it. Gaps far longer than the static
+ * delay mean the module is really idle, so it is gated sooner.
+ */
+static int adapt_delay(struct nvhost_device *dev, int delay,
+		struct nvhost_module_wake_stats *stats)
+{
+	u32 gap = dev->idle_gap_ms;
+	u32 breakeven = stats->avg_us * ACM_BREAKEVEN_FACTOR / 1000;
+
+	if (!adaptive_gating || !stats->count)
+		return delay;
+
+	if (gap <= breakeven)
+		return clamp_t(int, gap + gap / 2, delay,
+				delay * ACM_DELAY_MAX_MULT);
+	if (gap >= delay * ACM_DELAY_MAX_MULT)
+		return delay / 2;
+	return delay;
+}
+
+/* Called on the first busy after idle: fold the gap that just ended into
+ * the average and refresh the gating delays for the next one. */
+static void update_idle_gap_locked(struct nvhost_device *dev)
+{
+	s64 gap;
+
+	if (!ktime_to_ns(dev->idle_stamp))
+		return;
+
+	gap = ktime_to_ms(ktime_sub(ktime_get(), dev->idle_stamp));
+	if (gap > ACM_GAP_MAX_MS)
+		gap = ACM_GAP_MAX_MS;
+	dev->idle_gap_ms = dev->idle_gap_ms - (dev->idle_gap_ms >> ACM_GAP_SHIFT)
+		+ ((u32)gap >> ACM_GAP_SHIFT);
+
+	dev->cur_clockgate_delay = adapt_delay(dev, dev->clockgate_delay,
+			&dev->clockgate_wakes);
+	dev->cur_powergate_delay = adapt_delay(dev, dev->powergate_delay,
+			&dev->powergate_wakes);
+}
+
+/* Called on the first busy after idle: track the busy-to-busy period of
+ * modules driven at a steady rate, such as a 3D client rendering frames. */
+static void update_busy_period_locked(struct nvhost_device *dev)
+{
+	ktime_t now = ktime_get();
+	s64 period;
+	u32 dev_ms;
+
+	if (ktime_to_ns(dev->busy_stamp)) {
+		period = ktime_to_ms(ktime_sub(now, dev->busy_stamp));
+		if (period > ACM_GAP_MAX_MS)
+			period = ACM_GAP_MAX_MS;
+		dev_ms = abs((s32)period - (s32)dev->busy_period_ms);
+		dev->busy_period_ms = dev->busy_period_ms
+			- (dev->busy_period_ms >> ACM_GAP_SHIFT)
+			+ ((u32)period >> ACM_GAP_SHIFT);
+		dev->busy_jitter_ms = dev->busy_jitter_ms
+			- (dev->busy_jitter_ms >> ACM_GAP_SHIFT)
+			+ (dev_ms >> ACM_GAP_SHIFT);
+	}
+	dev->busy_stamp = now;
+}
+
+/*
+ * Having just power gated an idle module, arm a timer to ungate it again
+ * shortly before the next busy is expected, so the ramp is off the
+ * submit path. Only done when the busy period is steady.
+ */
+static void schedule_predicted_ungate_locked(struct nvhost_device *dev)
+{
+	u32 period = dev->busy_period_ms;
+	s64 delay;
+
+	if (!adaptive_gating || !period || !dev->powergate_wakes.count)
+		return;
+	if (dev->busy_jitter_ms > (period >> ACM_PERIOD_JITTER_SHIFT))
+		return;
+
+	delay = (s64)period
+		- ktime_to_ms(ktime_sub(ktime_get(), dev->busy_stamp))
+		- DIV_ROUND_UP(dev->powergate_wakes.avg_us *
+			ACM_PREDICT_LEAD_FACTOR, 1000)
+		- ACM_PREDICT_MARGIN_MS;
+	if (delay <= 0)
+		return;
+
+	schedule_delayed_work(&dev->powerstate_up,
+			msecs_to_jiffies((unsigned int)delay));
 }
 
 void nvhost_module_busy(struct nvhost_device *dev)
@@ -217,16 +348,35 @@ void nvhost_module_busy(struct nvhost_device *dev)
 
 	mutex_lock(&dev->lock);
 	cancel_delayed_work(&dev->powerstate_down);
+	cancel_delayed_work(&dev->powerstate_up);
 
 	dev->refcount++;
-	if (dev->refcount > 0 && !nvhost_module_powered(dev))
+	if (dev->refcount == 1) {
+		update_idle_gap_locked(dev);
+		update_busy_period_locked(dev);
+	}
+	if (dev->refcount > 0 && !nvhost_module_powered(dev)) {
+		int prev_state = dev->powerstate;
+		ktime_t start = ktime_get();
+		u32 us;
+
+		if (dev->predicted)
+			dev->predict_hits++;
 		to_state_running_locked(dev);
+
+		us = (u32)ktime_us_delta(ktime_get(), start);
+		if (prev_state == NVHOST_POWER_STATE_POWERGATED)
+			account_wake_locked(&dev->powergate_wakes, us);
+		else if (prev_state == NVHOST_POWER_STATE_CLOCKGATED)
+			account_wake_locked(&dev->clockgate_wakes, us);
+	}
 	mutex_unlock(&dev->lock);
 }
 
 static void powerstate_down_handler(struct work_struct *work)
 {
 	struct nvhost_device *dev;
+	bool missed;
 
 	dev = container_of(to_delayed_work(work),
 			struct nvhost_device,
@@ -240,8 +390,13 @@ static void powerstate_down_handler(struct work_struct *work)
 			schedule_powergating_locked(dev);
 			break;
 		case NVHOST_POWER_STATE_CLOCKGATED:
+			missed = dev->predicted;
 			if (to_state_powergated_locked(dev))
 				schedule_powergating_locked(dev);
+			else if (missed)
+				dev->predict_misses++;
+			else
+				schedule_predicted_ungate_locked(dev);
 			break;
 		default:
 			break;
@@ -250,6 +405,26 @@ static void powerstate_down_handler(struct work_struct *work)
 	mutex_unlock(&dev->lock);
 }
 
+static void powerstate_up_handler(struct work_struct *work)
+{
+	struct nvhost_device *dev;
+
+	dev = container_of(to_delayed_work(work),
+			struct nvhost_device,
+			powerstate_up);
+
+	mutex_lock(&dev->lock);
+	if (dev->refcount == 0
+			&& dev->powerstate == NVHOST_POWER_STATE_POWERGATED) {
+		/* ramp the partition up but leave the clocks and the
+		 * context restore to the busy that is expected next */
+		to_state_clockgated_locked(dev);
+		dev->predicted = true;
+		schedule_powergating_locked(dev);
+	}
+	mutex_unlock(&dev->lock);
+}
+
 void nvhost_module_idle_mult(struct nvhost_device *dev, int refs)
 {
 	struct nvhost_driver *drv = to_nvhost_driver(dev->dev.driver);
@@ -258,6 +433,7 @@ void nvhost_module_idle_mult(struct nvhost_device *dev, int refs)
 	mutex_lock(&dev->lock);
 	dev->refcount -= refs;
 	if (dev->refcount == 0) {
+		dev->idle_stamp = ktime_get();
 		if (nvhost_module_powered(dev))
 			schedule_clockgating_locked(dev);
 		kick = true;
@@ -394,6 +570,59 @@ static ssize_t refcount_show(struct kobject *kobj,
 	return ret;
 }
 
+static ssize_t wake_count_show(struct kobject *kobj,
+	struct kobj_attribute *attr, char *buf)
+{
+	int ret;
+	struct nvhost_device_power_attr *power_attribute =
+		container_of(attr, struct nvhost_device_power_attr, \
+			power_attr[NVHOST_POWER_SYSFS_ATTRIB_WAKE_COUNT]);
+	struct nvhost_device *dev = power_attribute->ndev;
+
+	mutex_lock(&dev->lock);
+	ret = sprintf(buf, "clockgated %u powergated %u\n",
+			dev->clockgate_wakes.count, dev->powergate_wakes.count);
+	mutex_unlock(&dev->lock);
+
+	return ret;
+}
+
+static ssize_t unpowergate_latency_show(struct kobject *kobj,
+	struct kobj_attribute *attr, char *buf)
+{
+	int ret;
+	struct nvhost_device_power_attr *power_attribute =
+		container_of(attr, struct nvhost_device_power_attr, \
+			power_attr[NVHOST_POWER_SYSFS_ATTRIB_UNPOWERGATE_LATENCY]);
+	struct nvhost_device *dev = power_attribute->ndev;
+
+	mutex_lock(&dev->lock);
+	ret = sprintf(buf, "avg %u max %u\n",
+			dev->powergate_wakes.avg_us,
+			dev->powergate_wakes.max_us);
+	mutex_unlock(&dev->lock);
+
+	return ret;
+}
+
+static ssize_t predict_show(struct kobject *kobj,
+	struct kobj_attribute *attr, char *buf)
+{
+	int ret;
+	struct nvhost_device_power_attr *power_attribute =
+		container_of(attr, struct nvhost_device_power_attr, \
+			power_attr[NVHOST_POWER_SYSFS_ATTRIB_PREDICT]);
+	struct nvhost_device *dev = power_attribute->ndev;
+
+	mutex_lock(&dev->lock);
+	ret = sprintf(buf, "hits %u misses %u period %u jitter %u\n",
+			dev->predict_hits, dev->predict_misses,
+			dev->busy_period_ms, dev->busy_jitter_ms);
+	mutex_unlock(&dev->lock);
+
+	return ret;
+}
+
 static ssize_t powergate_delay_store(struct kobject *kobj,
 	struct kobj_attribute *attr, const char *buf, size_t count)
 {
@@ -411,7 +640,8 @@ static ssize_t powergate_delay_store(struct kobject *kobj,
 	mutex_lock(&dev->lock);
 	ret = sscanf(buf, "%d", &powergate_delay);
 	if (ret == 1 && powergate_delay >= 0)
-		dev->powergate_delay = powergate_delay;
+		dev->powergate_delay = dev->cur_powergate_delay =
+			powergate_delay;
 	else
 		dev_err(&dev->dev, "Invalid powergate delay\n");
 	mutex_unlock(&dev->lock);
@@ -447,7 +677,8 @@ static ssize_t clockgate_delay_store(struct kobject *kobj,
 	mutex_lock(&dev->lock);
 	ret = sscanf(buf, "%d", &clockgate_delay);
 	if (ret == 1 && clockgate_delay >= 0)
-		dev->clockgate_delay = clockgate_delay;
+		dev->clockgate_delay = dev->cur_clockgate_delay =
+			clockgate_delay;
 	else
 		dev_err(&dev->dev, "Invalid clockgate delay\n");
 	mutex_unlock(&dev->lock);
@@ -502,7 +733,10 @@ int nvhost_module_init(struct nvhost_device *dev)
 
 	mutex_init(&dev->lock);
 	init_waitqueue_head(&dev->idle_wq);
+	dev->cur_clockgate_delay = dev->clockgate_delay;
+	dev->cur_powergate_delay = dev->powergate_delay;
 	INIT_DELAYED_WORK(&dev->powerstate_down, powerstate_down_handler);
+	INIT_DELAYED_WORK(&dev->powerstate_up, powerstate_up_handler);
 
 	/* power gate units that we can power gate */
 	if (dev->can_powergate) {
@@ -563,8 +797,50 @@ int nvhost_module_init(struct nvhost_device *dev)
 		goto fail_refcount;
 	}
 
+	attr = &dev->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_WAKE_COUNT];
+	attr->attr.name = "wake_count";
+	attr->attr.mode = S_IRUGO;
+	attr->show = wake_count_show;
+	if (sysfs_create_file(dev->power_kobj, &attr->attr)) {
+		dev_err(&dev->dev, "Could not create sysfs attribute wake_count\n");
+		err = -EIO;
+		goto fail_wakecount;
+	}
+
+	attr = &dev->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_UNPOWERGATE_LATENCY];
+	attr->attr.name = "unpowergate_latency";
+	attr->attr.mode = S_IRUGO;
+	attr->show = unpowergate_latency_show;
+	if (sysfs_create_file(dev->power_kobj, &attr->attr)) {
+		dev_err(&dev->dev, "Could not create sysfs attribute unpowergate_latency\n");
+		err = -EIO;
+		goto fail_unpowergatelatency;
+	}
+
+	attr = &dev->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_PREDICT];
+	attr->attr.name = "predict";
+	attr->attr.mode = S_IRUGO;
+	attr->show = predict_show;
+	if (sysfs_create_file(dev->power_kobj, &attr->attr)) {
+		dev_err(&dev->dev, "Could not create sysfs attribute predict\n");
+		err = -EIO;
+		goto fail_predict;
+	}
+
 	return 0;
 
+fail_predict:
+	attr = &dev->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_UNPOWERGATE_LATENCY];
+	sysfs_remove_file(dev->power_kobj, &attr->attr);
+
+fail_unpowergatelatency:
+	attr = &dev->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_WAKE_COUNT];
+	sysfs_remove_file(dev->power_kobj, &attr->attr);
+
+fail_wakecount:
+	attr = &dev->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_REFCOUNT];
+	sysfs_remove_file(dev->power_kobj, &attr->attr);
+
 fail_refcount:
 	attr = &dev->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_POWERGATE_DELAY];
 	sysfs_remove_file(dev->power_kobj, &attr->attr);
@@ -604,6 +880,7 @@ int nvhost_module_suspend(struct nvhost_device *dev)
 		return -EBUSY;
 	}
 
+	cancel_delayed_work_sync(&dev->powerstate_up);
 	mutex_lock(&dev->lock);
 	cancel_delayed_work(&dev->powerstate_down);
 	to_state_powergated_locked(dev);
@@ -30,15 +30,16 @@
 
 #include <linux/slab.h>
 #include <linux/kfifo.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <trace/events/nvhost.h>
 #include <linux/interrupt.h>
 
 /*
- * TODO:
- *   stats
- *     - for figuring out what to optimize further
- *   resizable push buffer
- *     - some channels hardly need any, some channels (3d) could use more
+ * Push buffers start at the device's push_buffer_slots and double, up to
+ * push_buffer_max_slots, once submitters have waited for push buffer space
+ * NVHOST_CDMA_GROW_WAITS times. The swap happens at the start of a submit,
+ * after the sync queue has drained and command DMA has been stopped.
  */
 
 /**
@@ -53,6 +54,10 @@ static void add_to_sync_queue(struct nvhost_cdma *cdma,
 
 	job->first_get = first_get;
 	job->num_slots = nr_slots;
+	job->submit_ktime = ktime_get();
+	/* a job behind others is fetched once they have completed */
+	job->start_ktime = list_empty(&cdma->sync_queue) ?
+		job->submit_ktime : ktime_set(0, 0);
 	nvhost_job_get(job);
 	list_add_tail(&job->list, &cdma->sync_queue);
 
@@ -91,6 +96,106 @@ static unsigned int cdma_status_locked(struct nvhost_cdma *cdma,
 	}
 }
 
+/**
+ * Account a completed wait for the given event.
+ * Must be called with the cdma lock held.
+ */
+static void cdma_account_us(struct nvhost_cdma_wait_stats *stats, u32 us)
+{
+	int bucket = us < 16 ? 0 : (ilog2(us) - 4) / 2 + 1;
+
+	if (bucket >= NVHOST_CDMA_WAIT_HIST_BUCKETS)
+		bucket = NVHOST_CDMA_WAIT_HIST_BUCKETS - 1;
+
+	stats->count++;
+	stats->total_us += us;
+	if (us > stats->max_us)
+		stats->max_us = us;
+	stats->hist[bucket]++;
+}
+
+static void cdma_account_wait_locked(struct nvhost_cdma *cdma,
+		enum cdma_event event, ktime_t start)
+{
+	u32 us = (u32)ktime_us_delta(ktime_get(), start);
+
+	if (event == CDMA_EVENT_PUSH_BUFFER_SPACE) {
+		cdma_account_us(&cdma->pb_waits, us);
+		cdma->pb_waits_since_grow++;
+	} else {
+		cdma_account_us(&cdma->sq_waits, us);
+	}
+}
+
+/*
+ * Find the latency histograms of a client, taking over an unused or the
+ * least recently used entry for clients not seen before.
+ */
+static struct nvhost_cdma_client_latency *cdma_client_latency_locked(
+		struct nvhost_cdma *cdma, int clientid)
+{
+	struct nvhost_cdma_client_latency *c, *victim = NULL;
+	int i;
+
+	for (i = 0; i < NVHOST_CDMA_LATENCY_CLIENTS; i++) {
+		c = &cdma->clients[i];
+		if (c->queue.count && c->clientid == clientid)
+			return c;
+		if (!victim || !c->queue.count ||
+		    (victim->queue.count &&
+		     time_before(c->last_used, victim->last_used)))
+			victim = c;
+	}
+
+	memset(victim, 0, sizeof(*victim));
+	victim->clientid = clientid;
+	return victim;
+}
+
+/*
+ * Account the time a completed job spent queued behind other jobs, and the
+ * time it took from reaching the head of the queue to its sync point.
+ * Must be called with the cdma lock held.
+ */
+static void cdma_account_job_locked(struct nvhost_cdma *cdma,
+		struct nvhost_job *job, ktime_t now)
+{
+	struct nvhost_cdma_client_latency *c;
+	u32 queue_us, exec_us;
+
+	if (!ktime_to_ns(job->start_ktime))
+		job->start_ktime = now;
+	queue_us = (u32)ktime_us_delta(job->start_ktime, job->submit_ktime);
+	exec_us = (u32)ktime_us_delta(now, job->start_ktime);
+
+	cdma_account_us(&cdma->queue_lat, queue_us);
+	cdma_account_us(&cdma->exec_lat, exec_us);
+
+	c = cdma_client_latency_locked(cdma, job->clientid);
+	cdma_account_us(&c->queue, queue_us);
+	cdma_account_us(&c->exec, exec_us);
+	c->last_used = jiffies;
+
+	trace_nvhost_channel_job_latency(job->ch->dev->name, job->clientid,
+			job->syncpt_id, job->syncpt_end, queue_us, exec_us);
+}
+
+/*
+ * Account one stage of a job that runs in a known number of stages, each
+ * ending with a sync point increment.
+ */
+void nvhost_cdma_account_stage(struct nvhost_cdma *cdma, u32 stage,
+		ktime_t start, ktime_t end)
+{
+	if (stage >= NVHOST_CDMA_JOB_STAGES)
+		return;
+
+	mutex_lock(&cdma->lock);
+	cdma_account_us(&cdma->stage_lat[stage],
+			(u32)ktime_us_delta(end, start));
+	mutex_unlock(&cdma->lock);
+}
+
 /**
  * Sleep (if necessary) until the requested event happens
  *   - CDMA_EVENT_SYNC_QUEUE_EMPTY : sync queue is completely empty.
@@ -102,10 +207,21 @@ static unsigned int cdma_status_locked(struct nvhost_cdma *cdma,
 unsigned int nvhost_cdma_wait_locked(struct nvhost_cdma *cdma,
 		enum cdma_event event)
 {
+	bool waited = false;
+	ktime_t start;
+
 	for (;;) {
 		unsigned int space = cdma_status_locked(cdma, event);
-		if (space)
+		if (space) {
+			if (waited)
+				cdma_account_wait_locked(cdma, event, start);
 			return space;
+		}
+
+		if (!waited) {
+			waited = true;
+			start = ktime_get();
+		}
 
 		trace_nvhost_wait_cdma(cdma_to_channel(cdma)->dev->name,
 				event);
@@ -176,6 +292,7 @@ static void update_cdma_locked(struct nvhost_cdma *cdma)
 	struct nvhost_master *dev = cdma_to_dev(cdma);
 	struct nvhost_syncpt *sp = &dev->syncpt;
 	struct nvhost_job *job, *n;
+	ktime_t now = ktime_get();
 
 	/* If CDMA is stopped, queue is cleared and we can return */
 	if (!cdma->running)
@@ -201,6 +318,8 @@ static void update_cdma_locked(struct nvhost_cdma *cdma)
 		if (cdma->timeout.clientid)
 			stop_cdma_timer_locked(cdma);
 
+		cdma_account_job_locked(cdma, job, now);
+
 		/* Unpin the memory */
 		nvhost_job_unpin(job);
 
@@ -215,6 +334,14 @@ static void update_cdma_locked(struct nvhost_cdma *cdma)
 
 		list_del(&job->list);
 
+		/* the next job is being fetched from here on */
+		if (!list_empty(&cdma->sync_queue)) {
+			struct nvhost_job *next = list_first_entry(
+				&cdma->sync_queue, struct nvhost_job, list);
+			if (!ktime_to_ns(next->start_ktime))
+				next->start_ktime = now;
+		}
+
 		switch (job->priority) {
 		case NVHOST_PRIORITY_HIGH:
 			cdma->high_prio_count--;
@@ -368,6 +495,42 @@ void nvhost_cdma_deinit(struct nvhost_cdma *cdma)
 	cdma_op().timeout_destroy(cdma);
 }
 
+/**
+ * Grow the push buffer if submitters keep running out of space in it.
+ * Called at the start of a submit, with the cdma lock and the channel's
+ * submit lock held.
+ */
+static void cdma_grow_push_buffer_locked(struct nvhost_cdma *cdma)
+{
+	struct nvhost_device *dev = cdma_to_channel(cdma)->dev;
+	struct push_buffer *pb = &cdma->push_buffer;
+	u32 slots = pb->size / 8;
+
+	if (cdma->pb_waits_since_grow < NVHOST_CDMA_GROW_WAITS)
+		return;
+	cdma->pb_waits_since_grow = 0;
+
+	if (!cdma_pb_op().resize || cdma->torndown ||
+	    slots * 2 > dev->push_buffer_max_slots)
+		return;
+
+	/* drain the channel, then stop DMA so the buffer can be swapped */
+	nvhost_cdma_wait_locked(cdma, CDMA_EVENT_SYNC_QUEUE_EMPTY);
+	if (cdma->running) {
+		mutex_unlock(&cdma->lock);
+		cdma_op().stop(cdma);
+		mutex_lock(&cdma->lock);
+	}
+	if (cdma->running || !list_empty(&cdma->sync_queue))
+		return;
+
+	if (cdma_pb_op().resize(pb, slots * 2) == 0) {
+		cdma->pb_grows++;
+		dev_dbg(&dev->dev, "push buffer grown to %u slots\n",
+			slots * 2);
+	}
+}
+
 /**
  * Begin a cdma submit
  */
@@ -388,6 +551,7 @@ int nvhost_cdma_begin(struct nvhost_cdma *cdma, struct nvhost_job *job)
 			}
 		}
 	}
+	cdma_grow_push_buffer_locked(cdma);
 	if (!cdma->running) {
 		BUG_ON(!cdma_op().start);
 		cdma_op().start(cdma);
@@ -468,6 +632,31 @@ void nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 	cdma_pb_op().push_to(pb, client, handle, op1, op2);
 }
 
+/**
+ * Split a cdma submit between jobs
+ * Add job to the sync queue with the push buffer slots used since the
+ * submit began or was last split, and continue the submit for the next job
+ * without kicking DMA, so that a batch of jobs is fetched in one go.
+ */
+void nvhost_cdma_split(struct nvhost_cdma *cdma, struct nvhost_job *job)
+{
+	bool was_idle = list_empty(&cdma->sync_queue);
+
+	BUG_ON(job->syncpt_id == NVSYNCPT_INVALID);
+
+	add_to_sync_queue(cdma,
+			job,
+			cdma->slots_used,
+			cdma->first_get);
+
+	/* start timer on idle -> active transitions */
+	if (job->timeout && was_idle)
+		cdma_start_timer_locked(cdma, job);
+
+	cdma->slots_used = 0;
+	cdma->first_get = cdma_pb_op().putptr(&cdma->push_buffer);
+}
+
 /**
  * End a cdma submit
  * Kick off DMA, add job to the sync queue, and a number of slots to be freed
@@ -53,6 +53,7 @@ struct push_buffer {
 	u32 phys;			/* physical address of pushbuffer */
 	u32 fence;			/* index we've written */
 	u32 cur;			/* index to write to */
+	u32 size;			/* bytes, excluding the RESTART */
 	struct mem_mgr_handle *client_handle; /* handle for each opcode pair */
 };
 
@@ -67,6 +68,32 @@ struct buffer_timeout {
 	int clientid;
 };
 
+/* CDMA wait latency histogram: <16us, then x4 per bucket up to >=64ms */
+#define NVHOST_CDMA_WAIT_HIST_BUCKETS	8
+
+/* push buffer full waits after which the push buffer is grown */
+#define NVHOST_CDMA_GROW_WAITS		16
+
+struct nvhost_cdma_wait_stats {
+	u32 count;			/* completed waits */
+	u32 max_us;			/* longest wait */
+	u64 total_us;			/* sum of all waits */
+	u32 hist[NVHOST_CDMA_WAIT_HIST_BUCKETS];
+};
+
+/* clients per channel with their own job latency histograms */
+#define NVHOST_CDMA_LATENCY_CLIENTS	8
+
+struct nvhost_cdma_client_latency {
+	int clientid;
+	unsigned long last_used;	/* jiffies of the last completed job */
+	struct nvhost_cdma_wait_stats queue;	/* submit to fetch */
+	struct nvhost_cdma_wait_stats exec;	/* fetch to sync point reached */
+};
+
+/* stages of pipelined jobs with their own latency histograms */
+#define NVHOST_CDMA_JOB_STAGES		4
+
 enum cdma_event {
 	CDMA_EVENT_NONE,		/* not waiting for any event */
 	CDMA_EVENT_SYNC_QUEUE_EMPTY,	/* wait for empty sync queue */
@@ -89,6 +116,14 @@ struct nvhost_cdma {
 	int high_prio_count;
 	int med_prio_count;
 	int low_prio_count;
+	struct nvhost_cdma_wait_stats pb_waits;	/* push buffer space waits */
+	struct nvhost_cdma_wait_stats sq_waits;	/* sync queue empty waits */
+	unsigned int pb_waits_since_grow;
+	unsigned int pb_grows;
+	struct nvhost_cdma_wait_stats queue_lat;	/* all jobs, queued */
+	struct nvhost_cdma_wait_stats exec_lat;		/* all jobs, running */
+	struct nvhost_cdma_client_latency clients[NVHOST_CDMA_LATENCY_CLIENTS];
+	struct nvhost_cdma_wait_stats stage_lat[NVHOST_CDMA_JOB_STAGES];
 };
 
 #define cdma_to_channel(cdma) container_of(cdma, struct nvhost_channel, cdma)
@@ -104,9 +139,12 @@ void	nvhost_cdma_push(struct nvhost_cdma *cdma, u32 op1, u32 op2);
 void	nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 		struct mem_mgr *client,
 		struct mem_handle *handle, u32 offset, u32 op1, u32 op2);
+void	nvhost_cdma_split(struct nvhost_cdma *cdma, struct nvhost_job *job);
 void	nvhost_cdma_end(struct nvhost_cdma *cdma,
 		struct nvhost_job *job);
 void	nvhost_cdma_update(struct nvhost_cdma *cdma);
+void	nvhost_cdma_account_stage(struct nvhost_cdma *cdma, u32 stage,
+		ktime_t start, ktime_t end);
 int	nvhost_cdma_flush(struct nvhost_cdma *cdma, int timeout);
 void	nvhost_cdma_peek(struct nvhost_cdma *cdma,
 		u32 dmaget, int slot, u32 *out);
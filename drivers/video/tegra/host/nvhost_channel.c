@@ -27,9 +27,12 @@
 #include <trace/events/nvhost.h>
 #include <linux/nvhost_ioctl.h>
 #include <linux/slab.h>
+#include <linux/lat_hist.h>
 
 #define NVHOST_CHANNEL_LOW_PRIO_MAX_WAIT 50
 
+DEFINE_LAT_HIST(submit_hist, "nvhost_submit");
+
 int nvhost_channel_init(struct nvhost_channel *ch,
 		struct nvhost_master *dev, int index)
 {
@@ -46,16 +49,18 @@ int nvhost_channel_init(struct nvhost_channel *ch,
 	ndev = ch->dev;
 	ndev->channel = ch;
 
+	lat_hist_register(&submit_hist);
+
 	return 0;
 }
 
-int nvhost_channel_submit(struct nvhost_job *job)
+/*
+ * Check if queue has higher priority jobs running. If so, wait until
+ * queue is empty. Ignores result from nvhost_cdma_flush, as we submit
+ * either when push buffer is empty or when we reach the timeout.
+ */
+static void wait_for_higher_priority(struct nvhost_job *job)
 {
-	/*
-	 * Check if queue has higher priority jobs running. If so, wait until
-	 * queue is empty. Ignores result from nvhost_cdma_flush, as we submit
-	 * either when push buffer is empty or when we reach the timeout.
-	 */
 	int higher_count = 0;
 
 	switch (job->priority) {
@@ -73,8 +78,30 @@ int nvhost_channel_submit(struct nvhost_job *job)
 	if (higher_count > 0)
 		(void)nvhost_cdma_flush(&job->ch->cdma,
 				NVHOST_CHANNEL_LOW_PRIO_MAX_WAIT);
+}
+
+int nvhost_channel_submit(struct nvhost_job *job)
+{
+	ktime_t start = lat_hist_start();
+	int err;
+
+	wait_for_higher_priority(job);
+	err = channel_op().submit(job);
+	lat_hist_add_since(&submit_hist, start);
+	return err;
+}
+
+/*
+ * Submit jobs of one client back to back in a single CDMA span. Either all
+ * of the jobs are submitted, or none of them.
+ */
+int nvhost_channel_submit_batch(struct nvhost_job **jobs, int num_jobs)
+{
+	if (!channel_op().submit_batch)
+		return -ENOSYS;
 
-	return channel_op().submit(job);
+	wait_for_higher_priority(jobs[0]);
+	return channel_op().submit_batch(jobs, num_jobs);
 }
 
 struct nvhost_channel *nvhost_getchannel(struct nvhost_channel *ch)
@@ -122,6 +149,8 @@ void nvhost_putchannel(struct nvhost_channel *ch, struct nvhost_hwctx *ctx)
 		channel_cdma_op().stop(&ch->cdma);
 		nvhost_cdma_deinit(&ch->cdma);
 		nvhost_module_suspend(ch->dev);
+		nvhost_job_pool_drain(&ch->job_pool);
+		nvhost_pin_cache_drain(&ch->pin_cache);
 	}
 	ch->refcount--;
 	mutex_unlock(&ch->reflock);
@@ -157,6 +186,8 @@ struct nvhost_channel *nvhost_alloc_channel_internal(int chindex,
 		if (ch == NULL)
 			return NULL;
 		else {
+			nvhost_job_pool_init(&ch->job_pool);
+			nvhost_pin_cache_init(&ch->pin_cache);
 			(*current_channel_count)++;
 			return ch;
 		}
@@ -166,6 +197,8 @@ struct nvhost_channel *nvhost_alloc_channel_internal(int chindex,
 void nvhost_free_channel_internal(struct nvhost_channel *ch,
 	int *current_channel_count)
 {
+	nvhost_job_pool_drain(&ch->job_pool);
+	nvhost_pin_cache_drain(&ch->pin_cache);
 	kfree(ch);
 	(*current_channel_count)--;
 }
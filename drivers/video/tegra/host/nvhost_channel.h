@@ -24,6 +24,7 @@
 #include <linux/cdev.h>
 #include <linux/io.h>
 #include "nvhost_cdma.h"
+#include "nvhost_job.h"
 
 #define NVHOST_MAX_WAIT_CHECKS		256
 #define NVHOST_MAX_GATHERS		512
@@ -48,12 +49,15 @@ struct nvhost_channel {
 	struct cdev cdev;
 	struct nvhost_hwctx_handler *ctxhandler;
 	struct nvhost_cdma cdma;
+	struct nvhost_job_pool job_pool;
+	struct nvhost_pin_cache pin_cache;
 };
 
 int nvhost_channel_init(struct nvhost_channel *ch,
 	struct nvhost_master *dev, int index);
 
 int nvhost_channel_submit(struct nvhost_job *job);
+int nvhost_channel_submit_batch(struct nvhost_job **jobs, int num_jobs);
 
 struct nvhost_channel *nvhost_getchannel(struct nvhost_channel *ch);
 void nvhost_putchannel(struct nvhost_channel *ch, struct nvhost_hwctx *ctx);
@@ -0,0 +1,303 @@
+/*
+ * drivers/video/tegra/host/nvhost_fence.c
+ *
+ * Tegra Graphics Host Sync Point Fences
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/anon_inodes.h>
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/module.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+
+#include "dev.h"
+#include "nvhost_fence.h"
+#include "nvhost_intr.h"
+#include "nvhost_syncpt.h"
+
+/*
+ * A fence is a set of (sync point, threshold) pairs and signals once all of
+ * them have expired. It lives in an anonymous file that polls readable when
+ * signalled, so that userspace can wait for it with poll/epoll, and that
+ * other drivers accept as a pre-fence.
+ */
+
+struct nvhost_fence_pt {
+	u32 id;
+	u32 thresh;
+	void *ref;
+};
+
+struct nvhost_fence {
+	struct nvhost_master *host;
+	struct file *file;
+	wait_queue_head_t wq;
+	int num_pts;
+	struct nvhost_fence_pt pts[];
+};
+
+static const struct file_operations nvhost_fence_fops;
+
+static bool nvhost_fence_signalled(struct nvhost_fence *fence)
+{
+	int i;
+
+	for (i = 0; i < fence->num_pts; i++)
+		if (!nvhost_syncpt_is_expired(&fence->host->syncpt,
+				fence->pts[i].id, fence->pts[i].thresh))
+			return false;
+	return true;
+}
+
+static void nvhost_fence_free(struct nvhost_fence *fence)
+{
+	int i;
+
+	for (i = 0; i < fence->num_pts; i++)
+		if (fence->pts[i].ref)
+			nvhost_intr_put_ref(&fence->host->intr,
+					fence->pts[i].id, fence->pts[i].ref);
+	kfree(fence);
+}
+
+static int nvhost_fence_release(struct inode *inode, struct file *file)
+{
+	nvhost_fence_free(file->private_data);
+	return 0;
+}
+
+static unsigned int nvhost_fence_poll(struct file *file, poll_table *wait)
+{
+	struct nvhost_fence *fence = file->private_data;
+
+	poll_wait(file, &fence->wq, wait);
+
+	return nvhost_fence_signalled(fence) ? POLLIN | POLLRDNORM : 0;
+}
+
+static const struct file_operations nvhost_fence_fops = {
+	.owner = THIS_MODULE,
+	.release = nvhost_fence_release,
+	.poll = nvhost_fence_poll,
+};
+
+/* adds (id, thresh) to the fence, keeping one pt per sync point */
+static void nvhost_fence_add_pt(struct nvhost_fence *fence, u32 id,
+		u32 thresh)
+{
+	int i;
+
+	for (i = 0; i < fence->num_pts; i++) {
+		if (fence->pts[i].id != id)
+			continue;
+		if ((s32)(thresh - fence->pts[i].thresh) > 0)
+			fence->pts[i].thresh = thresh;
+		return;
+	}
+
+	fence->pts[fence->num_pts].id = id;
+	fence->pts[fence->num_pts].thresh = thresh;
+	fence->num_pts++;
+}
+
+static struct nvhost_fence *nvhost_fence_alloc(struct nvhost_master *host,
+		int max_pts)
+{
+	struct nvhost_fence *fence;
+
+	fence = kzalloc(sizeof(*fence) + max_pts * sizeof(fence->pts[0]),
+			GFP_KERNEL);
+	if (!fence)
+		return NULL;
+
+	fence->host = host;
+	init_waitqueue_head(&fence->wq);
+	return fence;
+}
+
+/* arms a wakeup for every pt that has not expired yet and installs the
+ * fence in a new file descriptor */
+static int nvhost_fence_install(struct nvhost_fence *fence)
+{
+	struct nvhost_syncpt *sp = &fence->host->syncpt;
+	void *waiter;
+	int i, err, fd;
+
+	for (i = 0; i < fence->num_pts; i++) {
+		struct nvhost_fence_pt *pt = &fence->pts[i];
+
+		if (nvhost_syncpt_is_expired(sp, pt->id, pt->thresh))
+			continue;
+
+		waiter = nvhost_intr_alloc_waiter();
+		if (!waiter) {
+			err = -ENOMEM;
+			goto fail;
+		}
+		err = nvhost_intr_add_action(&fence->host->intr, pt->id,
+				pt->thresh,
+				NVHOST_INTR_ACTION_WAKEUP_INTERRUPTIBLE,
+				&fence->wq, waiter, &pt->ref);
+		if (err)
+			goto fail;
+	}
+
+	fd = anon_inode_getfd("nvhost-fence", &nvhost_fence_fops, fence,
+			O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err = fd;
+		goto fail;
+	}
+	return fd;
+
+fail:
+	nvhost_fence_free(fence);
+	return err;
+}
+
+int nvhost_fence_create_fd(struct nvhost_master *host,
+		struct nvhost_ctrl_sync_fence_info __user *upts, u32 num_pts)
+{
+	struct nvhost_ctrl_sync_fence_info info;
+	struct nvhost_fence *fence;
+	u32 i;
+
+	if (!num_pts || num_pts > NVHOST_FENCE_MAX_PTS)
+		return -EINVAL;
+
+	fence = nvhost_fence_alloc(host, num_pts);
+	if (!fence)
+		return -ENOMEM;
+
+	for (i = 0; i < num_pts; i++) {
+		if (copy_from_user(&info, &upts[i], sizeof(info))) {
+			kfree(fence);
+			return -EFAULT;
+		}
+		if (!nvhost_syncpt_is_valid(&host->syncpt, info.id)) {
+			kfree(fence);
+			return -EINVAL;
+		}
+		nvhost_fence_add_pt(fence, info.id, info.thresh);
+	}
+
+	return nvhost_fence_install(fence);
+}
+
+int nvhost_fence_create_syncpt_fd(struct nvhost_device *dev, u32 id,
+		u32 thresh)
+{
+	struct nvhost_master *host = nvhost_get_host(dev);
+	struct nvhost_fence *fence;
+
+	if (!nvhost_syncpt_is_valid(&host->syncpt, id))
+		return -EINVAL;
+
+	fence = nvhost_fence_alloc(host, 1);
+	if (!fence)
+		return -ENOMEM;
+
+	nvhost_fence_add_pt(fence, id, thresh);
+	return nvhost_fence_install(fence);
+}
+EXPORT_SYMBOL(nvhost_fence_create_syncpt_fd);
+
+int nvhost_fence_merge_fd(struct nvhost_master *host, int fd1, int fd2)
+{
+	struct nvhost_fence *a, *b, *fence;
+	int i, err;
+
+	a = nvhost_fence_fdget(fd1);
+	if (IS_ERR(a))
+		return PTR_ERR(a);
+	b = nvhost_fence_fdget(fd2);
+	if (IS_ERR(b)) {
+		err = PTR_ERR(b);
+		goto put_a;
+	}
+
+	err = -EINVAL;
+	if (a->host != host || b->host != host ||
+	    a->num_pts + b->num_pts > NVHOST_FENCE_MAX_PTS)
+		goto put_b;
+
+	err = -ENOMEM;
+	fence = nvhost_fence_alloc(host, a->num_pts + b->num_pts);
+	if (!fence)
+		goto put_b;
+
+	for (i = 0; i < a->num_pts; i++)
+		nvhost_fence_add_pt(fence, a->pts[i].id, a->pts[i].thresh);
+	for (i = 0; i < b->num_pts; i++)
+		nvhost_fence_add_pt(fence, b->pts[i].id, b->pts[i].thresh);
+
+	err = nvhost_fence_install(fence);
+put_b:
+	nvhost_fence_put(b);
+put_a:
+	nvhost_fence_put(a);
+	return err;
+}
+
+struct nvhost_fence *nvhost_fence_fdget(int fd)
+{
+	struct file *file = fget(fd);
+	struct nvhost_fence *fence;
+
+	if (!file)
+		return ERR_PTR(-EBADF);
+	if (file->f_op != &nvhost_fence_fops) {
+		fput(file);
+		return ERR_PTR(-EINVAL);
+	}
+	fence = file->private_data;
+	fence->file = file;
+	return fence;
+}
+EXPORT_SYMBOL(nvhost_fence_fdget);
+
+void nvhost_fence_put(struct nvhost_fence *fence)
+{
+	fput(fence->file);
+}
+EXPORT_SYMBOL(nvhost_fence_put);
+
+int nvhost_fence_wait(struct nvhost_fence *fence, u32 timeout)
+{
+	unsigned long deadline = jiffies + timeout;
+	long remain;
+	int i, err;
+
+	for (i = 0; i < fence->num_pts; i++) {
+		remain = (long)(deadline - jiffies);
+		if (remain < 0)
+			remain = 0;
+		err = nvhost_syncpt_wait_timeout(&fence->host->syncpt,
+				fence->pts[i].id, fence->pts[i].thresh,
+				timeout == MAX_SCHEDULE_TIMEOUT ?
+					MAX_SCHEDULE_TIMEOUT : remain, NULL);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+EXPORT_SYMBOL(nvhost_fence_wait);
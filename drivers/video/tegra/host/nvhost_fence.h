@@ -0,0 +1,36 @@
+/*
+ * drivers/video/tegra/host/nvhost_fence.h
+ *
+ * Tegra Graphics Host Sync Point Fences
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NVHOST_FENCE_H
+#define __NVHOST_FENCE_H
+
+#include <linux/nvhost.h>
+#include <linux/nvhost_ioctl.h>
+
+struct nvhost_master;
+
+/* upper bound on distinct sync points in one fence */
+#define NVHOST_FENCE_MAX_PTS	32
+
+int nvhost_fence_create_fd(struct nvhost_master *host,
+		struct nvhost_ctrl_sync_fence_info __user *pts, u32 num_pts);
+int nvhost_fence_merge_fd(struct nvhost_master *host, int fd1, int fd2);
+
+#endif
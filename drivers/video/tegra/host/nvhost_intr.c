@@ -24,6 +24,8 @@
 #include <linux/interrupt.h>
 #include <linux/slab.h>
 #include <linux/irq.h>
+#include <linux/ktime.h>
+#include <linux/rbtree.h>
 #include <trace/events/nvhost.h>
 #include "nvhost_channel.h"
 #include "nvhost_hwctx.h"
@@ -32,7 +34,8 @@
 /*** Wait list management ***/
 
 struct nvhost_waitlist {
-	struct list_head list;
+	struct rb_node node;	/* in the sync point's wait tree */
+	struct list_head list;	/* in a completed list */
 	struct kref refcount;
 	u32 thresh;
 	enum nvhost_intr_action action;
@@ -53,40 +56,86 @@ static void waiter_release(struct kref *kref)
 	kfree(container_of(kref, struct nvhost_waitlist, refcount));
 }
 
+/*
+ * Waiters of one sync point are kept in an rbtree ordered by threshold, with
+ * the leftmost (earliest) node cached. Thresholds wrap, so they are compared
+ * by signed difference; this is a total order as long as all pending
+ * thresholds lie within 2^31 of each other, which holds for any sane client.
+ * Insertion is O(log n) and expiring k waiters is O(k) amortized.
+ */
+static inline bool thresh_before(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
 /**
  * add a waiter to a waiter queue, sorted by threshold
  * returns true if it was added at the head of the queue
  */
 static bool add_waiter_to_queue(struct nvhost_waitlist *waiter,
-				struct list_head *queue)
+				struct nvhost_intr_syncpt *syncpt)
 {
-	struct nvhost_waitlist *pos;
+	struct rb_node **p = &syncpt->wait_tree.rb_node;
+	struct rb_node *parent = NULL;
 	u32 thresh = waiter->thresh;
+	bool leftmost = true;
+
+	while (*p) {
+		struct nvhost_waitlist *pos;
 
-	list_for_each_entry_reverse(pos, queue, list)
-		if ((s32)(pos->thresh - thresh) <= 0) {
-			list_add(&waiter->list, &pos->list);
-			return false;
+		parent = *p;
+		pos = rb_entry(parent, struct nvhost_waitlist, node);
+		/* equal thresholds go right, keeping them in FIFO order */
+		if (thresh_before(thresh, pos->thresh)) {
+			p = &parent->rb_left;
+		} else {
+			p = &parent->rb_right;
+			leftmost = false;
 		}
+	}
+
+	rb_link_node(&waiter->node, parent, p);
+	rb_insert_color(&waiter->node, &syncpt->wait_tree);
+
+	if (leftmost)
+		syncpt->wait_first = &waiter->node;
+	syncpt->nr_waiters++;
+	return leftmost;
+}
+
+static void remove_waiter_from_queue(struct nvhost_waitlist *waiter,
+				struct nvhost_intr_syncpt *syncpt)
+{
+	if (syncpt->wait_first == &waiter->node)
+		syncpt->wait_first = rb_next(&waiter->node);
+	rb_erase(&waiter->node, &syncpt->wait_tree);
+	syncpt->nr_waiters--;
+}
 
-	list_add(&waiter->list, queue);
-	return true;
+static struct nvhost_waitlist *first_waiter(struct nvhost_intr_syncpt *syncpt)
+{
+	if (!syncpt->wait_first)
+		return NULL;
+	return rb_entry(syncpt->wait_first, struct nvhost_waitlist, node);
 }
 
 /**
  * run through a waiter queue for a single sync point ID
  * and gather all completed waiters into lists by actions
  */
-static void remove_completed_waiters(struct list_head *head, u32 sync,
+static void remove_completed_waiters(struct nvhost_intr_syncpt *syncpt,
+			u32 sync,
 			struct list_head completed[NVHOST_INTR_ACTION_COUNT])
 {
 	struct list_head *dest;
-	struct nvhost_waitlist *waiter, *next, *prev;
+	struct nvhost_waitlist *waiter, *prev;
 
-	list_for_each_entry_safe(waiter, next, head, list) {
+	while ((waiter = first_waiter(syncpt)) != NULL) {
 		if ((s32)(waiter->thresh - sync) > 0)
 			break;
 
+		remove_waiter_from_queue(waiter, syncpt);
+
 		dest = completed + waiter->action;
 
 		/* consolidate submit cleanups */
@@ -101,21 +150,18 @@ static void remove_completed_waiters(struct list_head *head, u32 sync,
 		}
 
 		/* PENDING->REMOVED or CANCELLED->HANDLED */
-		if (atomic_inc_return(&waiter->state) == WLS_HANDLED || !dest) {
-			list_del(&waiter->list);
+		if (atomic_inc_return(&waiter->state) == WLS_HANDLED || !dest)
 			kref_put(&waiter->refcount, waiter_release);
-		} else {
-			list_move_tail(&waiter->list, dest);
-		}
+		else
+			list_add_tail(&waiter->list, dest);
 	}
 }
 
 void reset_threshold_interrupt(struct nvhost_intr *intr,
-			       struct list_head *head,
+			       struct nvhost_intr_syncpt *syncpt,
 			       unsigned int id)
 {
-	u32 thresh = list_first_entry(head,
-				struct nvhost_waitlist, list)->thresh;
+	u32 thresh = first_waiter(syncpt)->thresh;
 	BUG_ON(!(intr_op().set_syncpt_threshold &&
 		 intr_op().enable_syncpt_intr));
 
@@ -164,6 +210,13 @@ static void action_wakeup_interruptible(struct nvhost_waitlist *waiter)
 	wake_up_interruptible(wq);
 }
 
+static void action_callback(struct nvhost_waitlist *waiter)
+{
+	struct nvhost_intr_callback *cb = waiter->data;
+
+	cb->fn(cb, waiter->thresh);
+}
+
 typedef void (*action_handler)(struct nvhost_waitlist *waiter);
 
 static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
@@ -171,6 +224,7 @@ static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
 	action_ctxsave,
 	action_wakeup,
 	action_wakeup_interruptible,
+	action_callback,
 };
 
 static void run_handlers(struct list_head completed[NVHOST_INTR_ACTION_COUNT])
@@ -207,14 +261,13 @@ static int process_wait_list(struct nvhost_intr *intr,
 
 	spin_lock(&syncpt->lock);
 
-	remove_completed_waiters(&syncpt->wait_head, threshold, completed);
+	remove_completed_waiters(syncpt, threshold, completed);
 
-	empty = list_empty(&syncpt->wait_head);
+	empty = RB_EMPTY_ROOT(&syncpt->wait_tree);
 	if (empty)
 		intr_op().disable_syncpt_intr(intr, syncpt->id);
 	else
-		reset_threshold_interrupt(intr, &syncpt->wait_head,
-					  syncpt->id);
+		reset_threshold_interrupt(intr, syncpt, syncpt->id);
 
 	spin_unlock(&syncpt->lock);
 
@@ -234,10 +287,19 @@ irqreturn_t nvhost_syncpt_thresh_fn(int irq, void *dev_id)
 	unsigned int id = syncpt->id;
 	struct nvhost_intr *intr = intr_syncpt_to_intr(syncpt);
 	struct nvhost_master *dev = intr_to_dev(intr);
+	ktime_t start = ktime_get();
+	u32 ns;
 
 	(void)process_wait_list(intr, syncpt,
 				nvhost_syncpt_update_min(&dev->syncpt, id));
 
+	/* only this thread updates the stats; readers are debug dumps */
+	ns = (u32)ktime_to_ns(ktime_sub(ktime_get(), start));
+	syncpt->irq_count++;
+	syncpt->irq_time_ns += ns;
+	if (ns > syncpt->irq_max_ns)
+		syncpt->irq_max_ns = ns;
+
 	return IRQ_HANDLED;
 }
 
@@ -305,9 +367,9 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 		spin_lock(&syncpt->lock);
 	}
 
-	queue_was_empty = list_empty(&syncpt->wait_head);
+	queue_was_empty = RB_EMPTY_ROOT(&syncpt->wait_tree);
 
-	if (add_waiter_to_queue(waiter, &syncpt->wait_head)) {
+	if (add_waiter_to_queue(waiter, syncpt)) {
 		/* added at head of list - new threshold value */
 		intr_op().set_syncpt_threshold(intr, id, thresh);
 
@@ -371,7 +433,9 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 		syncpt->irq = irq_sync + id;
 		syncpt->irq_requested = 0;
 		spin_lock_init(&syncpt->lock);
-		INIT_LIST_HEAD(&syncpt->wait_head);
+		syncpt->wait_tree = RB_ROOT;
+		syncpt->wait_first = NULL;
+		syncpt->nr_waiters = 0;
 		snprintf(syncpt->thresh_irq_name,
 			sizeof(syncpt->thresh_irq_name),
 			"host_sp_%02d", id);
@@ -418,16 +482,20 @@ void nvhost_intr_stop(struct nvhost_intr *intr)
 	for (id = 0, syncpt = intr->syncpt;
 	     id < nb_pts;
 	     ++id, ++syncpt) {
-		struct nvhost_waitlist *waiter, *next;
-		list_for_each_entry_safe(waiter, next, &syncpt->wait_head, list) {
+		struct nvhost_waitlist *waiter;
+		struct rb_node *node, *next;
+
+		for (node = syncpt->wait_first; node; node = next) {
+			next = rb_next(node);
+			waiter = rb_entry(node, struct nvhost_waitlist, node);
 			if (atomic_cmpxchg(&waiter->state, WLS_CANCELLED, WLS_HANDLED)
 				== WLS_CANCELLED) {
-				list_del(&waiter->list);
+				remove_waiter_from_queue(waiter, syncpt);
 				kref_put(&waiter->refcount, waiter_release);
 			}
 		}
 
-		if (!list_empty(&syncpt->wait_head)) {  /* output diagnostics */
+		if (!RB_EMPTY_ROOT(&syncpt->wait_tree)) {  /* output diagnostics */
 			printk(KERN_DEBUG "%s id=%d\n", __func__, id);
 			BUG_ON(1);
 		}
@@ -24,6 +24,7 @@
 #include <linux/kthread.h>
 #include <linux/semaphore.h>
 #include <linux/interrupt.h>
+#include <linux/rbtree.h>
 
 struct nvhost_channel;
 
@@ -52,9 +53,19 @@ enum nvhost_intr_action {
 	 */
 	NVHOST_INTR_ACTION_WAKEUP_INTERRUPTIBLE,
 
+	/**
+	 * Call a function, in thread context.
+	 * 'data' points to a struct nvhost_intr_callback
+	 */
+	NVHOST_INTR_ACTION_CALLBACK,
+
 	NVHOST_INTR_ACTION_COUNT
 };
 
+struct nvhost_intr_callback {
+	void (*fn)(struct nvhost_intr_callback *cb, u32 thresh);
+};
+
 struct nvhost_intr;
 
 struct nvhost_intr_syncpt {
@@ -63,8 +74,15 @@ struct nvhost_intr_syncpt {
 	u8 irq_requested;
 	u16 irq;
 	spinlock_t lock;
-	struct list_head wait_head;
+	struct rb_root wait_tree;
+	struct rb_node *wait_first;	/* leftmost, i.e. earliest threshold */
+	u32 nr_waiters;
 	char thresh_irq_name[12];
+
+	/* threshold handler statistics */
+	u32 irq_count;
+	u32 irq_max_ns;
+	u64 irq_time_ns;
 };
 
 struct nvhost_intr {
@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/kref.h>
 #include <linux/err.h>
+#include <linux/mm.h>
 #include <linux/vmalloc.h>
 #include <trace/events/nvhost.h>
 #include "nvhost_channel.h"
@@ -34,11 +35,22 @@
 /* Magic to use to fill freed handle slots */
 #define BAD_MAGIC 0xdeadbeef
 
-static size_t job_size(struct nvhost_submit_hdr_ext *hdr)
+/* Pin cache entries idle for longer than this are released */
+#define PIN_CACHE_MAX_AGE	HZ
+
+/* Capacity of the job pool buckets */
+static const struct {
+	int cmdbufs;
+	int relocs;
+	int waitchks;
+} job_buckets[NVHOST_JOB_POOL_BUCKETS] = {
+	{  4,  32,  4 },
+	{ 16, 128, 16 },
+	{ 64, 512, 64 },
+};
+
+static size_t __job_size(s64 num_cmdbufs, s64 num_relocs, s64 num_waitchks)
 {
-	s64 num_relocs = hdr ? (int)hdr->num_relocs : 0;
-	s64 num_waitchks = hdr ? (int)hdr->num_waitchks : 0;
-	s64 num_cmdbufs = hdr ? (int)hdr->num_cmdbufs : 0;
 	s64 num_unpins = num_cmdbufs + num_relocs;
 	s64 total;
 
@@ -57,6 +69,217 @@ static size_t job_size(struct nvhost_submit_hdr_ext *hdr)
 	return (size_t)total;
 }
 
+static size_t job_size(struct nvhost_submit_hdr_ext *hdr)
+{
+	s64 num_relocs = hdr ? (int)hdr->num_relocs : 0;
+	s64 num_waitchks = hdr ? (int)hdr->num_waitchks : 0;
+	s64 num_cmdbufs = hdr ? (int)hdr->num_cmdbufs : 0;
+
+	return __job_size(num_cmdbufs, num_relocs, num_waitchks);
+}
+
+/* Smallest bucket that has room for the submit, or -1 */
+static int job_bucket(struct nvhost_submit_hdr_ext *hdr)
+{
+	int num_relocs = hdr ? hdr->num_relocs : 0;
+	int num_waitchks = hdr ? hdr->num_waitchks : 0;
+	int num_cmdbufs = hdr ? hdr->num_cmdbufs : 0;
+	int i;
+
+	for (i = 0; i < NVHOST_JOB_POOL_BUCKETS; i++)
+		if (num_cmdbufs <= job_buckets[i].cmdbufs &&
+		    num_relocs <= job_buckets[i].relocs &&
+		    num_waitchks <= job_buckets[i].waitchks)
+			return i;
+	return -1;
+}
+
+static struct nvhost_job *job_mem_alloc(size_t size)
+{
+	if (size > PAGE_SIZE)
+		return vzalloc(size);
+	return kzalloc(size, GFP_KERNEL);
+}
+
+static void job_mem_free(struct nvhost_job *job)
+{
+	if (is_vmalloc_addr(job))
+		vfree(job);
+	else
+		kfree(job);
+}
+
+void nvhost_job_pool_init(struct nvhost_job_pool *pool)
+{
+	int i;
+
+	spin_lock_init(&pool->lock);
+	for (i = 0; i < NVHOST_JOB_POOL_BUCKETS; i++)
+		INIT_LIST_HEAD(&pool->free[i]);
+}
+
+void nvhost_job_pool_drain(struct nvhost_job_pool *pool)
+{
+	struct nvhost_job *job, *tmp;
+	LIST_HEAD(jobs);
+	int i;
+
+	spin_lock(&pool->lock);
+	for (i = 0; i < NVHOST_JOB_POOL_BUCKETS; i++) {
+		list_splice_init(&pool->free[i], &jobs);
+		pool->nr_free[i] = 0;
+	}
+	spin_unlock(&pool->lock);
+
+	list_for_each_entry_safe(job, tmp, &jobs, list)
+		job_mem_free(job);
+}
+
+/* Returns a zeroed job with room for size bytes */
+static struct nvhost_job *job_pool_get(struct nvhost_channel *ch,
+		struct nvhost_submit_hdr_ext *hdr, size_t size)
+{
+	struct nvhost_job_pool *pool = &ch->job_pool;
+	struct nvhost_job *job = NULL;
+	int bucket = job_bucket(hdr);
+
+	spin_lock(&pool->lock);
+	if (bucket < 0) {
+		pool->oversize++;
+	} else if (list_empty(&pool->free[bucket])) {
+		pool->misses++;
+	} else {
+		job = list_first_entry(&pool->free[bucket],
+				struct nvhost_job, list);
+		list_del(&job->list);
+		pool->nr_free[bucket]--;
+		pool->hits++;
+	}
+	spin_unlock(&pool->lock);
+
+	if (job)
+		memset(job, 0, size);
+	else if (bucket < 0)
+		job = job_mem_alloc(size);
+	else
+		job = job_mem_alloc(__job_size(job_buckets[bucket].cmdbufs,
+					job_buckets[bucket].relocs,
+					job_buckets[bucket].waitchks));
+	if (job)
+		job->pool_bucket = bucket;
+
+	return job;
+}
+
+static void job_pool_put(struct nvhost_job *job)
+{
+	struct nvhost_job_pool *pool = &job->ch->job_pool;
+	int bucket = job->pool_bucket;
+
+	if (bucket >= 0) {
+		spin_lock(&pool->lock);
+		if (pool->nr_free[bucket] < NVHOST_JOB_POOL_DEPTH) {
+			list_add(&job->list, &pool->free[bucket]);
+			pool->nr_free[bucket]++;
+			job = NULL;
+		}
+		spin_unlock(&pool->lock);
+	}
+
+	if (job)
+		job_mem_free(job);
+}
+
+void nvhost_pin_cache_init(struct nvhost_pin_cache *cache)
+{
+	mutex_init(&cache->lock);
+}
+
+static void pin_cache_release(struct nvhost_pin_cache *cache,
+		struct nvhost_pin_cache_entry *e)
+{
+	if (e->vaddr)
+		mem_op().munmap(e->ref, e->vaddr);
+	mem_op().unpin(e->memmgr, e->ref);
+	mem_op().put(e->memmgr, e->ref);
+	mem_op().put_mgr(e->memmgr);
+	memset(e, 0, sizeof(*e));
+	cache->evictions++;
+}
+
+void nvhost_pin_cache_drain(struct nvhost_pin_cache *cache)
+{
+	int i;
+
+	mutex_lock(&cache->lock);
+	for (i = 0; i < NVHOST_PIN_CACHE_SIZE; i++)
+		if (cache->entries[i].ref)
+			pin_cache_release(cache, &cache->entries[i]);
+	mutex_unlock(&cache->lock);
+}
+
+/*
+ * Keeps (memmgr, id) in the pin cache, replacing the least recently used
+ * entry on a miss, and returns its kernel mapping if map is set. The
+ * cache holds its own reference and pin; jobs still pin each handle for
+ * themselves, so dropping an entry never unpins memory in use by the
+ * hardware. Caller must hold the cache lock for as long as the returned
+ * mapping is used.
+ */
+static void *pin_cache_get(struct nvhost_pin_cache *cache,
+		struct mem_mgr *memmgr, u32 id, bool map)
+{
+	struct nvhost_pin_cache_entry *e, *hit = NULL, *victim = NULL;
+	unsigned long now = jiffies;
+	struct mem_handle *ref;
+	phys_addr_t phys;
+	int i;
+
+	for (i = 0; i < NVHOST_PIN_CACHE_SIZE; i++) {
+		e = &cache->entries[i];
+		if (e->ref && e->memmgr == memmgr && e->id == id) {
+			hit = e;
+			continue;
+		}
+		if (e->ref && time_after(now,
+				e->last_used + PIN_CACHE_MAX_AGE))
+			pin_cache_release(cache, e);
+		if (!victim || (victim->ref && (!e->ref ||
+		    time_before(e->last_used, victim->last_used))))
+			victim = e;
+	}
+
+	if (hit) {
+		e = hit;
+		cache->hits++;
+	} else {
+		e = victim;
+		cache->misses++;
+		if (e->ref)
+			pin_cache_release(cache, e);
+
+		ref = mem_op().get(memmgr, id);
+		if (IS_ERR(ref))
+			return ref;
+		phys = mem_op().pin(memmgr, ref);
+		if (IS_ERR((void *)phys)) {
+			mem_op().put(memmgr, ref);
+			return ERR_PTR(phys);
+		}
+
+		e->memmgr = mem_op().get_mgr(memmgr);
+		e->id = id;
+		e->ref = ref;
+	}
+	e->last_used = now;
+
+	if (!map)
+		return NULL;
+	if (!e->vaddr)
+		e->vaddr = mem_op().mmap(e->ref);
+	return e->vaddr ?: ERR_PTR(-ENOMEM);
+}
+
 static void init_fields(struct nvhost_job *job,
 		struct nvhost_submit_hdr_ext *hdr,
 		int priority, int clientid)
@@ -107,7 +330,7 @@ struct nvhost_job *nvhost_job_alloc(struct nvhost_channel *ch,
 
 	if(!size)
 		goto error;
-	job = vzalloc(size);
+	job = job_pool_get(ch, hdr, size);
 	if (!job)
 		goto error;
 
@@ -143,7 +366,7 @@ static void job_free(struct kref *ref)
 		job->hwctx->h->put(job->hwctx);
 	if (job->memmgr)
 		mem_op().put_mgr(job->memmgr);
-	vfree(job);
+	job_pool_put(job);
 }
 
 /* Acquire reference to a hardware context. Used for keeping saved contexts in
@@ -203,6 +426,10 @@ static int do_relocs(struct nvhost_job *job, u32 cmdbuf_mem, void *cmdbuf_addr)
 
 			mem_id = reloc->target;
 			job->unpins[job->num_unpins++] = target_ref;
+
+			/* keep the target pinned for the next submit */
+			pin_cache_get(&job->ch->pin_cache, job->memmgr,
+					mem_id, false);
 		}
 
 		__raw_writel(
@@ -271,12 +498,15 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 	phys_addr_t gather_phys = 0;
 	void *gather_addr = NULL;
 	unsigned long waitchk_mask = job->waitchk_mask;
+	struct nvhost_pin_cache *cache = &job->ch->pin_cache;
+	bool cached;
 
 	/* get current syncpt values for waitchk */
 	for_each_set_bit(i, &waitchk_mask, sizeof(job->waitchk_mask))
 		nvhost_syncpt_update_min(sp, i);
 
 	/* pin gathers */
+	mutex_lock(&cache->lock);
 	for (i = 0; i < job->num_gathers; i++) {
 		struct nvhost_job_gather *g = &job->gathers[i];
 
@@ -300,7 +530,12 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 			/* store the gather ref into unpin array */
 			job->unpins[job->num_unpins++] = g->ref;
 
-			gather_addr = mem_op().mmap(g->ref);
+			/* the cache keeps command buffers mapped */
+			gather_addr = pin_cache_get(cache, job->memmgr,
+					g->mem_id, true);
+			cached = !IS_ERR(gather_addr);
+			if (!cached)
+				gather_addr = mem_op().mmap(g->ref);
 			if (!gather_addr) {
 				err = -ENOMEM;
 				break;
@@ -310,13 +545,15 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 			if (!err)
 				err = do_waitchks(job, sp,
 						g->mem_id, gather_addr);
-			mem_op().munmap(g->ref, gather_addr);
+			if (!cached)
+				mem_op().munmap(g->ref, gather_addr);
 
 			if (err)
 				break;
 		}
 		g->mem = gather_phys + g->offset;
 	}
+	mutex_unlock(&cache->lock);
 	wmb();
 
 	return err;
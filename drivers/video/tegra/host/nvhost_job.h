@@ -22,6 +22,10 @@
 #define __NVHOST_JOB_H
 
 #include <linux/nvhost_ioctl.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
 
 struct nvhost_channel;
 struct nvhost_hwctx;
@@ -36,6 +40,50 @@ struct nvhost_job_gather {
 	struct mem_handle *ref;
 };
 
+/*
+ * Freed jobs are kept per channel for reuse, in buckets by the number of
+ * gathers, relocs and wait checks they have room for.
+ */
+#define NVHOST_JOB_POOL_BUCKETS	3
+#define NVHOST_JOB_POOL_DEPTH	4
+
+struct nvhost_job_pool {
+	spinlock_t lock;
+	struct list_head free[NVHOST_JOB_POOL_BUCKETS];
+	int nr_free[NVHOST_JOB_POOL_BUCKETS];
+
+	/* jobs taken from a bucket, allocated for an empty bucket, and
+	 * allocated because they fit no bucket */
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long oversize;
+};
+
+/*
+ * Handles recently used by submits on a channel are kept referenced and
+ * pinned, and command buffers kept mapped, so that the next submit only
+ * takes nvmap's already-pinned path and does not map its gathers again.
+ * Entries are replaced least recently used first, and released once
+ * they have been idle for a while.
+ */
+#define NVHOST_PIN_CACHE_SIZE	16
+
+struct nvhost_pin_cache_entry {
+	struct mem_mgr *memmgr;
+	u32 id;
+	struct mem_handle *ref;
+	void *vaddr;
+	unsigned long last_used;
+};
+
+struct nvhost_pin_cache {
+	struct mutex lock;
+	struct nvhost_pin_cache_entry entries[NVHOST_PIN_CACHE_SIZE];
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+};
+
 /*
  * Each submit is tracked as a nvhost_job.
  */
@@ -43,9 +91,12 @@ struct nvhost_job {
 	/* When refcount goes to zero, job can be freed */
 	struct kref ref;
 
-	/* List entry */
+	/* List entry, also links free jobs in the channel's job pool */
 	struct list_head list;
 
+	/* Job pool bucket the job is returned to, or -1 */
+	int pool_bucket;
+
 	/* Channel where job is submitted to */
 	struct nvhost_channel *ch;
 
@@ -86,6 +137,11 @@ struct nvhost_job {
 	/* Null kickoff prevents submit from being sent to hardware */
 	bool null_kickoff;
 
+	/* When the job was queued, and when it reached the head of the sync
+	 * queue so that the channel started fetching it */
+	ktime_t submit_ktime;
+	ktime_t start_ktime;
+
 	/* Index and number of slots used in the push buffer */
 	int first_get;
 	int num_slots;
@@ -94,9 +150,22 @@ struct nvhost_job {
 	struct nvhost_hwctx *hwctxref;
 };
 
+/*
+ * Initialize and release the job pool of a channel.
+ */
+void nvhost_job_pool_init(struct nvhost_job_pool *pool);
+void nvhost_job_pool_drain(struct nvhost_job_pool *pool);
+
+/*
+ * Initialize and release the pin cache of a channel.
+ */
+void nvhost_pin_cache_init(struct nvhost_pin_cache *cache);
+void nvhost_pin_cache_drain(struct nvhost_pin_cache *cache);
+
 /*
  * Allocate memory for a job. Just enough memory will be allocated to
- * accomodate the submit announced in submit header.
+ * accomodate the submit announced in submit header, or a free job that
+ * has room for it is taken from the channel's job pool.
  */
 struct nvhost_job *nvhost_job_alloc(struct nvhost_channel *ch,
 		struct nvhost_hwctx *hwctx,
@@ -124,6 +124,7 @@ static struct nvhost_device tegra_gr3d01_device = {
 	.powergate_ids	= {TEGRA_POWERGATE_3D, -1},
 	NVHOST_DEFAULT_CLOCKGATE_DELAY,
 	.moduleid	= NVHOST_MODULE_NONE,
+	.push_buffer_max_slots = 4096,
 };
 
 static struct nvhost_device tegra_gr2d01_device = {
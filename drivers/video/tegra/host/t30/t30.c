@@ -132,6 +132,7 @@ static struct nvhost_device tegra_gr3d02_device = {
 	.powerup_reset = true,
 	.powergate_delay = 250,
 	.moduleid	= NVHOST_MODULE_NONE,
+	.push_buffer_max_slots = 4096,
 };
 
 static struct nvhost_device tegra_gr2d02_device = {
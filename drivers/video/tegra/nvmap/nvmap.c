@@ -40,23 +40,18 @@
 /* private nvmap_handle flag for pinning duplicate detection */
 #define NVMAP_HANDLE_VISITED (0x1ul << 31)
 
-/* map the backing pages for a heap_pgalloc handle into its IOVMM area */
+/* map the backing pages for a heap_pgalloc handle into its IOVMM area.
+ * all pages are handed to the iovmm device in one go, so that it can
+ * use large pages for contiguous runs and flush its TLB only once */
 static void map_iovmm_area(struct nvmap_handle *h)
 {
-	tegra_iovmm_addr_t va;
-	unsigned long i;
-
 	BUG_ON(!h->heap_pgalloc || !h->pgalloc.area);
 	BUG_ON(h->size & ~PAGE_MASK);
 	WARN_ON(!h->pgalloc.dirty);
 
-	for (va = h->pgalloc.area->iovm_start, i = 0;
-	     va < (h->pgalloc.area->iovm_start + h->size);
-	     i++, va += PAGE_SIZE) {
-		BUG_ON(!pfn_valid(page_to_pfn(h->pgalloc.pages[i])));
-		tegra_iovmm_vm_insert_pfn(h->pgalloc.area, va,
-					  page_to_pfn(h->pgalloc.pages[i]));
-	}
+	tegra_iovmm_vm_map_pages(h->pgalloc.area,
+				 h->pgalloc.area->iovm_start,
+				 h->pgalloc.pages, h->size >> PAGE_SHIFT);
 	h->pgalloc.dirty = false;
 }
 
@@ -221,13 +216,17 @@ void nvmap_unpin_ids(struct nvmap_client *client,
 		if (!ids[i])
 			continue;
 
-		nvmap_ref_lock(client);
-		ref = _nvmap_validate_id_locked(client, ids[i]);
+		rcu_read_lock();
+		ref = nvmap_validate_id_rcu(client, ids[i]);
+		if (ref && atomic_read(&ref->pin) == NVMAP_REF_DEAD)
+			ref = NULL;
 		if (ref) {
 			struct nvmap_handle *h = ref->handle;
-			int e = atomic_add_unless(&ref->pin, -1, 0);
+			int e = nvmap_ref_pin_put(ref);
 
-			nvmap_ref_unlock(client);
+			/* a successfully dropped pin still owns a reference
+			 * on the handle, which handle_unpin releases */
+			rcu_read_unlock();
 
 			if (!e) {
 				nvmap_err(client, "%s unpinning unpinned "
@@ -237,7 +236,7 @@ void nvmap_unpin_ids(struct nvmap_client *client,
 				do_wake |= handle_unpin(client, h, false);
 			}
 		} else {
-			nvmap_ref_unlock(client);
+			rcu_read_unlock();
 			if (client->super)
 				do_wake |= handle_unpin_noref(client, ids[i]);
 			else
@@ -259,6 +258,7 @@ int nvmap_pin_ids(struct nvmap_client *client,
 	int ret = 0;
 	unsigned int i;
 	struct nvmap_handle **h = (struct nvmap_handle **)ids;
+	struct nvmap_handle *verify;
 	struct nvmap_handle_ref *ref;
 
 	/* to optimize for the common case (client provided valid handle
@@ -269,29 +269,32 @@ int nvmap_pin_ids(struct nvmap_client *client,
 	 * locally validate that the caller has permission to pin the handle;
 	 * handle_refs are not created in this case, so it is possible that
 	 * if the caller crashes after pinning a global handle, the handle
-	 * will be permanently leaked. */
-	nvmap_ref_lock(client);
+	 * will be permanently leaked.
+	 *
+	 * handle_refs are resolved without the ref_lock. a ref which is
+	 * being freed concurrently either refuses the pin, or hands it over
+	 * to the free path, in which case the handle may be released before
+	 * it can be referenced here; both are treated like a missing ref. */
+	rcu_read_lock();
 	for (i = 0; i < nr; i++) {
-		ref = _nvmap_validate_id_locked(client, ids[i]);
-		if (ref) {
-			atomic_inc(&ref->pin);
-			nvmap_handle_get(h[i]);
+		ref = nvmap_validate_id_rcu(client, ids[i]);
+		if (ref && nvmap_ref_pin_get(ref) &&
+		    atomic_inc_not_zero(&h[i]->ref))
+			continue;
+
+		rcu_read_unlock();
+		verify = nvmap_validate_get(client, ids[i]);
+		if (verify) {
+			nvmap_warn(client, "%s pinning unreferenced "
+				   "handle %p\n",
+				   current->group_leader->comm, h[i]);
 		} else {
-			struct nvmap_handle *verify;
-			nvmap_ref_unlock(client);
-			verify = nvmap_validate_get(client, ids[i]);
-			if (verify) {
-				nvmap_warn(client, "%s pinning unreferenced "
-					   "handle %p\n",
-					   current->group_leader->comm, h[i]);
-			} else {
-				h[i] = NULL;
-				ret = -EPERM;
-			}
-			nvmap_ref_lock(client);
+			h[i] = NULL;
+			ret = -EPERM;
 		}
+		rcu_read_lock();
 	}
-	nvmap_ref_unlock(client);
+	rcu_read_unlock();
 
 	if (ret)
 		goto out;
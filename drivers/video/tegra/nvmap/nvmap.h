@@ -27,6 +27,8 @@
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/rculist.h>
+#include <linux/hash.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/atomic.h>
@@ -59,12 +61,20 @@ void _nvmap_handle_free(struct nvmap_handle *h);
 struct nvmap_pgalloc {
 	struct page **pages;
 	struct tegra_iovmm_area *area;
-	struct list_head mru_list;	/* MRU entry for IOVMM reclamation */
+	struct list_head mru_list;	/* LRU entry for IOVMM reclamation */
+	unsigned int lru_age;		/* pins since last eviction scan */
 	bool contig;			/* contiguous system memory */
+	bool large_pages;		/* starts with section-sized blocks */
 	bool dirty;			/* area is invalid and needs mapping */
 	u32 iovm_addr;	/* is non-zero, if client need specific iova mapping */
 };
 
+/* large handles are backed by naturally aligned 4MB blocks where possible,
+ * so that the SMMU can map them with sections instead of 4KB PTEs */
+#define NVMAP_LARGE_PAGE_ORDER	10
+#define NVMAP_LARGE_PAGE_PAGES	(1 << NVMAP_LARGE_PAGE_ORDER)
+#define NVMAP_LARGE_PAGE_SIZE	(PAGE_SIZE << NVMAP_LARGE_PAGE_ORDER)
+
 struct nvmap_handle {
 	struct rb_node node;	/* entry on global handle tree */
 	atomic_t ref;		/* reference count (i.e., # of duplications) */
@@ -86,6 +96,7 @@ struct nvmap_handle {
 	bool alloc;		/* handle has memory allocated */
 	unsigned int userflags;	/* flags passed from userspace */
 	struct mutex lock;
+	struct rcu_head rcu;	/* freed after an RCU grace period */
 };
 
 #ifdef CONFIG_NVMAP_PAGE_POOLS
@@ -95,16 +106,37 @@ struct nvmap_handle {
 #define NVMAP_WB_POOL NVMAP_HANDLE_CACHEABLE
 #define NVMAP_NUM_POOLS (NVMAP_HANDLE_CACHEABLE + 1)
 
+/* per-cpu page cache in front of each pool, refilled and drained
+ * NVMAP_PP_PCP_BATCH pages at a time under the pool lock */
+#define NVMAP_PP_PCP_SIZE	32
+#define NVMAP_PP_PCP_BATCH	16
+
+struct nvmap_page_pool_pcp {
+	int count;
+	struct page *pages[NVMAP_PP_PCP_SIZE];
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long refills;
+	unsigned long drains;
+};
+
+/* the bottom nzeroed entries of page_array hold pages that have been
+ * zeroed and cleaned from the caches by the zeroing thread; pages are
+ * released to and allocated from the top of the array */
 struct nvmap_page_pool {
 	struct mutex lock;
 	int npages;
+	int nzeroed;
+	unsigned long zero_hits;
 	struct page **page_array;
 	struct page **shrink_array;
 	int max_pages;
 	int flags;
+	struct nvmap_page_pool_pcp __percpu *pcp;
 };
 
 int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags);
+int nvmap_page_pool_zero_init(void);
 #endif
 
 struct nvmap_share {
@@ -124,8 +156,7 @@ struct nvmap_share {
 #endif
 #ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
 	struct mutex mru_lock;
-	struct list_head *mru_lists;
-	int nr_mru;
+	struct list_head lru_list;
 #endif
 };
 
@@ -134,13 +165,21 @@ struct nvmap_carveout_commit {
 	struct list_head list;
 };
 
+/* handle refs are additionally hashed by handle id, so that ids can be
+ * resolved without the ref_lock (see nvmap_validate_id_rcu) */
+#define NVMAP_REF_HASH_BITS	8
+#define NVMAP_REF_HASH_SIZE	(1 << NVMAP_REF_HASH_BITS)
+
 struct nvmap_client {
 	const char			*name;
 	struct nvmap_device		*dev;
 	struct nvmap_share		*share;
 	struct rb_root			handle_refs;
+	struct hlist_head		handle_hash[NVMAP_REF_HASH_SIZE];
 	atomic_t			iovm_commit;
 	size_t				iovm_limit;
+	unsigned int			iovm_remaps;	/* under mru_lock */
+	unsigned int			iovm_evictions;	/* under mru_lock */
 	struct mutex			ref_lock;
 	bool				super;
 	atomic_t			count;
@@ -165,6 +204,36 @@ static inline void nvmap_ref_unlock(struct nvmap_client *priv)
 	mutex_unlock(&priv->ref_lock);
 }
 
+/* a handle ref's pin count is set to NVMAP_REF_DEAD, under the ref_lock,
+ * when the ref is removed from its client. lock-free lookups may still
+ * find the ref until the RCU grace period ends, so they must only change
+ * its pin count through these helpers. */
+#define NVMAP_REF_DEAD	(-1)
+
+static inline struct hlist_head *nvmap_ref_hash(struct nvmap_client *c,
+						unsigned long id)
+{
+	return &c->handle_hash[hash_long(id, NVMAP_REF_HASH_BITS)];
+}
+
+static inline bool nvmap_ref_pin_get(struct nvmap_handle_ref *ref)
+{
+	return atomic_add_unless(&ref->pin, 1, NVMAP_REF_DEAD);
+}
+
+static inline bool nvmap_ref_pin_put(struct nvmap_handle_ref *ref)
+{
+	int old, pins = atomic_read(&ref->pin);
+
+	while (pins > 0) {
+		old = atomic_cmpxchg(&ref->pin, pins, pins - 1);
+		if (old == pins)
+			return true;
+		pins = old;
+	}
+	return false;
+}
+
 static inline struct nvmap_handle *nvmap_handle_get(struct nvmap_handle *h)
 {
 	if (unlikely(atomic_inc_return(&h->ref) <= 1)) {
@@ -187,17 +256,32 @@ static inline void nvmap_handle_put(struct nvmap_handle *h)
 		_nvmap_handle_free(h);
 }
 
-static inline pgprot_t nvmap_pgprot(struct nvmap_handle *h, pgprot_t prot)
+static inline pgprot_t nvmap_flags_pgprot(unsigned long flags,
+					  pgprot_t prot)
 {
-	if (h->flags == NVMAP_HANDLE_UNCACHEABLE)
+	if (flags == NVMAP_HANDLE_UNCACHEABLE)
 		return pgprot_noncached(prot);
-	else if (h->flags == NVMAP_HANDLE_WRITE_COMBINE)
+	else if (flags == NVMAP_HANDLE_WRITE_COMBINE)
 		return pgprot_writecombine(prot);
-	else if (h->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+	else if (flags == NVMAP_HANDLE_INNER_CACHEABLE)
 		return pgprot_inner_writeback(prot);
 	return prot;
 }
 
+static inline pgprot_t nvmap_pgprot(struct nvmap_handle *h, pgprot_t prot)
+{
+	return nvmap_flags_pgprot(h->flags, prot);
+}
+
+/* IOVMM alignment of a page allocation: handles with large pages are
+ * aligned to a section, so that their blocks can be mapped as sections */
+static inline size_t nvmap_iovm_align(struct nvmap_handle *h)
+{
+	if (h->pgalloc.large_pages)
+		return max_t(size_t, h->align, NVMAP_LARGE_PAGE_SIZE);
+	return h->align;
+}
+
 #else /* CONFIG_TEGRA_NVMAP */
 struct nvmap_handle *nvmap_handle_get(struct nvmap_handle *h);
 void nvmap_handle_put(struct nvmap_handle *h);
@@ -239,12 +323,17 @@ struct nvmap_handle *nvmap_validate_get(struct nvmap_client *client,
 struct nvmap_handle_ref *_nvmap_validate_id_locked(struct nvmap_client *priv,
 						   unsigned long id);
 
+struct nvmap_handle_ref *nvmap_validate_id_rcu(struct nvmap_client *priv,
+					       unsigned long id);
+
 struct nvmap_handle *nvmap_get_handle_id(struct nvmap_client *client,
 					 unsigned long id);
 
 struct nvmap_handle_ref *nvmap_create_handle(struct nvmap_client *client,
 					     size_t size);
 
+int nvmap_handle_share_fd(struct nvmap_handle *h);
+
 int nvmap_alloc_handle_id(struct nvmap_client *client,
 			  unsigned long id, unsigned int heap_mask,
 			  size_t align, unsigned int flags);
@@ -210,17 +210,31 @@ void nvmap_free_pte(struct nvmap_device *dev, pte_t **pte)
 struct nvmap_handle_ref *_nvmap_validate_id_locked(struct nvmap_client *c,
 						   unsigned long id)
 {
-	struct rb_node *n = c->handle_refs.rb_node;
+	struct nvmap_handle_ref *ref;
+	struct hlist_node *n;
 
-	while (n) {
-		struct nvmap_handle_ref *ref;
-		ref = rb_entry(n, struct nvmap_handle_ref, node);
+	hlist_for_each_entry(ref, n, nvmap_ref_hash(c, id), hash) {
+		if ((unsigned long)ref->handle == id)
+			return ref;
+	}
+
+	return NULL;
+}
+
+/* same as _nvmap_validate_id_locked, for callers which hold
+ * rcu_read_lock() instead of the file's ref_lock. the ref may be removed
+ * from the client concurrently, so it must only be pinned using
+ * nvmap_ref_pin_get, and its handle only referenced after a pin was
+ * taken or with atomic_inc_not_zero. */
+struct nvmap_handle_ref *nvmap_validate_id_rcu(struct nvmap_client *c,
+					       unsigned long id)
+{
+	struct nvmap_handle_ref *ref;
+	struct hlist_node *n;
+
+	hlist_for_each_entry_rcu(ref, n, nvmap_ref_hash(c, id), hash) {
 		if ((unsigned long)ref->handle == id)
 			return ref;
-		else if (id > (unsigned long)ref->handle)
-			n = n->rb_right;
-		else
-			n = n->rb_left;
 	}
 
 	return NULL;
@@ -241,13 +255,14 @@ struct nvmap_handle *nvmap_get_handle_id(struct nvmap_client *client,
 			"videobuf2-dma-nvmap"))
 		client = ((struct nvmap_handle *)id)->owner;
 
-	nvmap_ref_lock(client);
-	ref = _nvmap_validate_id_locked(client, id);
-	if (ref)
+	/* the ref holds a reference on its handle until it is removed, and
+	 * handles are freed after an RCU grace period, so the handle can be
+	 * safely tested for remaining references here */
+	rcu_read_lock();
+	ref = nvmap_validate_id_rcu(client, id);
+	if (ref && atomic_inc_not_zero(&ref->handle->ref))
 		h = ref->handle;
-	if (h)
-		h = nvmap_handle_get(h);
-	nvmap_ref_unlock(client);
+	rcu_read_unlock();
 	return h;
 }
 
@@ -641,6 +656,8 @@ struct nvmap_client *nvmap_create_client(struct nvmap_device *dev,
 	/* TODO: allocate unique IOVMM client for each nvmap client */
 	client->share = &dev->iovmm_master;
 	client->handle_refs = RB_ROOT;
+	for (i = 0; i < NVMAP_REF_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&client->handle_hash[i]);
 
 	atomic_set(&client->iovm_commit, 0);
 
@@ -689,6 +706,7 @@ static void destroy_client(struct nvmap_client *client)
 
 		ref = rb_entry(n, struct nvmap_handle_ref, node);
 		rb_erase(&ref->node, &client->handle_refs);
+		hlist_del_rcu(&ref->hash);
 
 		smp_rmb();
 		pins = atomic_read(&ref->pin);
@@ -703,7 +721,7 @@ static void destroy_client(struct nvmap_client *client)
 		while (dupes--)
 			nvmap_handle_put(ref->handle);
 
-		kfree(ref);
+		kfree_rcu(ref, rcu);
 	}
 
 	if (carveout_killer) {
@@ -845,6 +863,7 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		break;
 	case NVMAP_IOC_CREATE:
 	case NVMAP_IOC_FROM_ID:
+	case NVMAP_IOC_FROM_FD:
 		err = nvmap_ioctl_create(filp, cmd, uarg);
 		break;
 
@@ -852,6 +871,10 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		err = nvmap_ioctl_getid(filp, uarg);
 		break;
 
+	case NVMAP_IOC_SHARE:
+		err = nvmap_ioctl_share(filp, uarg);
+		break;
+
 	case NVMAP_IOC_PARAM:
 		err = nvmap_ioctl_get_param(filp, uarg);
 		break;
@@ -882,6 +905,10 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		err = nvmap_ioctl_cache_maint(filp, uarg);
 		break;
 
+	case NVMAP_IOC_CACHE_LIST:
+		err = nvmap_ioctl_cache_maint_list(filp, uarg);
+		break;
+
 	default:
 		return -ENOTTY;
 	}
@@ -1157,6 +1184,45 @@ static const struct file_operations debug_iovmm_allocations_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
+static int nvmap_debug_iovmm_lru_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	unsigned int remaps = 0;
+	unsigned int evictions = 0;
+	struct nvmap_client *client;
+	struct nvmap_device *dev = s->private;
+
+	spin_lock_irqsave(&dev->clients_lock, flags);
+	seq_printf(s, "%-18s %18s %8s %10s %10s\n", "CLIENT", "PROCESS", "PID",
+		"REMAPS", "EVICTIONS");
+	list_for_each_entry(client, &dev->clients, list) {
+		client_stringify(client, s);
+		seq_printf(s, " %10u %10u\n", client->iovm_remaps,
+			   client->iovm_evictions);
+		remaps += client->iovm_remaps;
+		evictions += client->iovm_evictions;
+	}
+	seq_printf(s, "%-18s %18s %8u %10u %10u\n", "total", "", 0, remaps,
+		   evictions);
+	spin_unlock_irqrestore(&dev->clients_lock, flags);
+
+	return 0;
+}
+
+static int nvmap_debug_iovmm_lru_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvmap_debug_iovmm_lru_show, inode->i_private);
+}
+
+static const struct file_operations debug_iovmm_lru_fops = {
+	.open = nvmap_debug_iovmm_lru_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static int nvmap_probe(struct platform_device *pdev)
 {
 	struct nvmap_platform_data *plat = pdev->dev.platform_data;
@@ -1220,7 +1286,7 @@ static int nvmap_probe(struct platform_device *pdev)
 	}
 	e = nvmap_mru_init(&dev->iovmm_master);
 	if (e) {
-		dev_err(&pdev->dev, "couldn't initialize MRU lists\n");
+		dev_err(&pdev->dev, "couldn't initialize LRU list\n");
 		goto fail;
 	}
 
@@ -1291,7 +1357,7 @@ static int nvmap_probe(struct platform_device *pdev)
 			continue;
 		node->carveout = nvmap_heap_create(dev->dev_user.this_device,
 				   co->name, co->base, co->size,
-				   co->buddy_size, node);
+				   co->buddy_size, co->movable, node);
 		if (!node->carveout) {
 			e = -ENOMEM;
 			dev_err(&pdev->dev, "couldn't create %s\n", co->name);
@@ -1328,6 +1394,10 @@ static int nvmap_probe(struct platform_device *pdev)
 				dev, &debug_iovmm_clients_fops);
 			debugfs_create_file("allocations", 0664, iovmm_root,
 				dev, &debug_iovmm_allocations_fops);
+#ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
+			debugfs_create_file("lru", S_IRUGO, iovmm_root,
+				dev, &debug_iovmm_lru_fops);
+#endif
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 			for (i = 0; i < NVMAP_NUM_POOLS; i++) {
 				char name[40];
@@ -1345,6 +1415,9 @@ static int nvmap_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, dev);
 	nvmap_dev = dev;
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+	nvmap_page_pool_zero_init();
+#endif
 
 	return 0;
 fail_heaps:
@@ -22,16 +22,23 @@
 
 #define pr_fmt(fmt)	"%s: " fmt, __func__
 
+#include <linux/anon_inodes.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/kernel.h>
+#include <linux/kthread.h>
 #include <linux/list.h>
 #include <linux/mm.h>
+#include <linux/module.h>
 #include <linux/rbtree.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/fs.h>
 #include <linux/shrinker.h>
 #include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
 #include <linux/nvmap.h>
 
 #include <asm/cacheflush.h>
@@ -65,6 +72,25 @@
 static bool enable_pp = 1;
 static int pool_size[NVMAP_NUM_POOLS];
 
+/* pages per pool that the zeroing thread keeps zeroed */
+#define NVMAP_PP_ZERO_RESERVE	4096
+#define NVMAP_PP_ZERO_BATCH	32
+/* no fresh pages are added to the pools for this long after the
+ * shrinker asked for pages back */
+#define NVMAP_PP_ZERO_BACKOFF	(10 * HZ)
+
+static unsigned int zero_reserve = NVMAP_PP_ZERO_RESERVE;
+static unsigned long zero_backoff_until;
+static struct task_struct *zero_thread;
+
+typedef int (*set_pages_array) (struct page **pages, int addrinarray);
+static set_pages_array s_cpa[] = {
+	set_pages_array_uc,
+	set_pages_array_wc,
+	set_pages_array_iwb,
+	set_pages_array_wb
+};
+
 static char *s_memtype_str[] = {
 	"uc",
 	"wc",
@@ -87,22 +113,98 @@ static struct page *nvmap_page_pool_alloc_locked(struct nvmap_page_pool *pool)
 	struct page *page = NULL;
 
 	if (pool->npages > 0) {
+		/* dirty pages go first, zeroed ones only once those ran out */
 		page = pool->page_array[--pool->npages];
+		if (pool->nzeroed > pool->npages)
+			pool->nzeroed = pool->npages;
 		atomic_dec(&page->_count);
 		BUG_ON(atomic_read(&page->_count) != 1);
 	}
 	return page;
 }
 
+static bool nvmap_page_pool_needs_zeroing(struct nvmap_page_pool *pool)
+{
+	return enable_pp && pool->max_pages &&
+	       pool->nzeroed < min_t(int, zero_reserve, pool->max_pages);
+}
+
+static void nvmap_page_pool_zero_kick(struct nvmap_page_pool *pool)
+{
+	if (zero_thread && nvmap_page_pool_needs_zeroing(pool))
+		wake_up_process(zero_thread);
+}
+
+/* takes up to nr pages from the zeroed reserve of the pool; returns the
+ * number of pages placed in pages[] */
+static int nvmap_page_pool_alloc_zeroed(struct nvmap_page_pool *pool,
+					struct page **pages, int nr)
+{
+	struct page *page;
+	int n = 0;
+
+	nvmap_page_pool_lock(pool);
+	while (n < nr && pool->nzeroed) {
+		page = pool->page_array[--pool->nzeroed];
+		pool->page_array[pool->nzeroed] =
+			pool->page_array[--pool->npages];
+		atomic_dec(&page->_count);
+		BUG_ON(atomic_read(&page->_count) != 1);
+		pages[n++] = page;
+	}
+	pool->zero_hits += n;
+	nvmap_page_pool_unlock(pool);
+
+	if (n)
+		nvmap_page_pool_zero_kick(pool);
+	return n;
+}
+
+/*
+ * Pages are handed out from and returned to the per-cpu cache with only
+ * preemption disabled. The pool lock is taken when the cache runs empty
+ * or full, and then a whole batch is moved between cache and pool.
+ * Pages in a per-cpu cache hold the same extra reference as pages in
+ * the pool.
+ */
 static struct page *nvmap_page_pool_alloc(struct nvmap_page_pool *pool)
 {
 	struct page *page = NULL;
+	struct nvmap_page_pool_pcp *pcp;
 
-	if (pool) {
-		nvmap_page_pool_lock(pool);
-		page = nvmap_page_pool_alloc_locked(pool);
-		nvmap_page_pool_unlock(pool);
+	if (!pool)
+		return NULL;
+
+	if (pool->pcp) {
+		pcp = get_cpu_ptr(pool->pcp);
+		if (pcp->count) {
+			page = pcp->pages[--pcp->count];
+			pcp->hits++;
+		} else {
+			pcp->misses++;
+		}
+		put_cpu_ptr(pool->pcp);
+
+		if (page) {
+			atomic_dec(&page->_count);
+			BUG_ON(atomic_read(&page->_count) != 1);
+			return page;
+		}
+	}
+
+	nvmap_page_pool_lock(pool);
+	page = nvmap_page_pool_alloc_locked(pool);
+	if (page && pool->pcp && pool->npages > pool->nzeroed) {
+		/* the zeroed reserve is not moved to the per-cpu caches */
+		pcp = get_cpu_ptr(pool->pcp);
+		while (pcp->count < NVMAP_PP_PCP_BATCH &&
+		       pool->npages > pool->nzeroed)
+			pcp->pages[pcp->count++] =
+				pool->page_array[--pool->npages];
+		pcp->refills++;
+		put_cpu_ptr(pool->pcp);
 	}
+	nvmap_page_pool_unlock(pool);
 	return page;
 }
 
@@ -124,13 +226,83 @@ static bool nvmap_page_pool_release(struct nvmap_page_pool *pool,
 					  struct page *page)
 {
 	int ret = false;
+	struct nvmap_page_pool_pcp *pcp;
+
+	if (!pool)
+		return false;
+
+	if (pool->pcp && enable_pp && pool->max_pages) {
+		BUG_ON(atomic_read(&page->_count) != 1);
+		pcp = get_cpu_ptr(pool->pcp);
+		if (pcp->count < NVMAP_PP_PCP_SIZE) {
+			atomic_inc(&page->_count);
+			pcp->pages[pcp->count++] = page;
+			ret = true;
+		}
+		put_cpu_ptr(pool->pcp);
+
+		if (ret)
+			return ret;
+	}
+
+	nvmap_page_pool_lock(pool);
+	ret = nvmap_page_pool_release_locked(pool, page);
+	if (ret && pool->pcp) {
+		pcp = get_cpu_ptr(pool->pcp);
+		while (pcp->count > NVMAP_PP_PCP_SIZE - NVMAP_PP_PCP_BATCH &&
+		       pool->npages < pool->max_pages)
+			pool->page_array[pool->npages++] =
+				pcp->pages[--pcp->count];
+		pcp->drains++;
+		put_cpu_ptr(pool->pcp);
+	}
+	nvmap_page_pool_unlock(pool);
+	return ret;
+}
+
+/* Return this cpu's cached pages to the pools; pages that no longer
+ * fit in a pool are freed. */
+static void nvmap_page_pool_drain_cpu(struct work_struct *work)
+{
+	unsigned int i;
+	int n;
+	struct page *pages[NVMAP_PP_PCP_SIZE];
+	struct nvmap_page_pool *pool;
+	struct nvmap_page_pool_pcp *pcp;
+	struct nvmap_share *share = nvmap_get_share_from_dev(nvmap_dev);
+
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		pool = &share->pools[i];
+		if (!pool->pcp)
+			continue;
 
-	if (pool) {
+		n = 0;
 		nvmap_page_pool_lock(pool);
-		ret = nvmap_page_pool_release_locked(pool, page);
+		pcp = get_cpu_ptr(pool->pcp);
+		while (pcp->count) {
+			if (pool->npages < pool->max_pages)
+				pool->page_array[pool->npages++] =
+					pcp->pages[--pcp->count];
+			else
+				pages[n++] = pcp->pages[--pcp->count];
+		}
+		put_cpu_ptr(pool->pcp);
 		nvmap_page_pool_unlock(pool);
+
+		if (!n)
+			continue;
+		/* This op should never fail. */
+		BUG_ON(set_pages_array_wb(pages, n));
+		while (n--) {
+			atomic_dec(&pages[n]->_count);
+			__free_page(pages[n]);
+		}
 	}
-	return ret;
+}
+
+static void nvmap_page_pool_drain_pcp(void)
+{
+	schedule_on_each_cpu(nvmap_page_pool_drain_cpu);
 }
 
 static int nvmap_page_pool_get_available_count(struct nvmap_page_pool *pool)
@@ -189,6 +361,7 @@ static void nvmap_page_pool_resize(struct nvmap_page_pool *pool, int size)
 
 	if (size == pool->max_pages)
 		return;
+	nvmap_page_pool_drain_pcp();
 repeat:
 	nvmap_page_pool_free(pool, pages_to_release);
 	nvmap_page_pool_lock(pool);
@@ -244,6 +417,7 @@ static int nvmap_page_pool_shrink(struct shrinker *shrinker,
 		goto out;
 
 	pr_debug("sh_pages=%d", shrink_pages);
+	zero_backoff_until = jiffies + NVMAP_PP_ZERO_BACKOFF;
 
 	for (i = 0; i < NVMAP_NUM_POOLS && shrink_pages; i++) {
 		pool_offset = atomic_add_return(1, &start_pool) %
@@ -264,6 +438,9 @@ static void shrink_page_pools(int *total_pages, int *available_pages)
 {
 	struct shrink_control sc;
 
+	/* the shrinker only sees pooled pages, return cached ones first */
+	nvmap_page_pool_drain_pcp();
+
 	sc.gfp_mask = GFP_KERNEL;
 	sc.nr_to_scan = 0;
 	*total_pages = nvmap_page_pool_shrink(NULL, &sc);
@@ -305,6 +482,220 @@ static struct kernel_param_ops shrink_ops = {
 module_param_cb(shrink_page_pools, &shrink_ops, &shrink_pp, 0644);
 #endif
 
+/*
+ * Background zeroing of pool pages, so that allocations of zeroed handles
+ * need not clear every page in the caller. The thread runs as SCHED_IDLE
+ * and zeroes dirty pool pages first; if a pool holds too few of them it is
+ * topped up with fresh pages, but only from free memory and not shortly
+ * after the shrinker asked for pages back. The shrinker frees dirty pages
+ * before zeroed ones.
+ */
+static int nvmap_page_pool_zero_batch(struct nvmap_page_pool *pool,
+				      pte_t **pte, void *kaddr)
+{
+	struct page *pages[NVMAP_PP_ZERO_BATCH];
+	pgprot_t prot = nvmap_flags_pgprot(pool->flags, pgprot_kernel);
+	gfp_t gfp = (GFP_NVMAP | __GFP_ZERO | __GFP_NORETRY) & ~__GFP_WAIT;
+	int want, n = 0, nr_dirty, added, i;
+
+	/* the pool lock is never held while this thread can be preempted,
+	 * a SCHED_IDLE lock holder would stall allocations on busy cpus */
+	nvmap_page_pool_lock(pool);
+	preempt_disable();
+	want = min_t(int, zero_reserve, pool->max_pages) - pool->nzeroed;
+	want = clamp(want, 0, NVMAP_PP_ZERO_BATCH);
+	while (n < want && pool->npages > pool->nzeroed)
+		pages[n++] = pool->page_array[--pool->npages];
+	nvmap_page_pool_unlock(pool);
+	preempt_enable();
+	nr_dirty = n;
+
+	for (i = 0; i < nr_dirty; i++) {
+		set_pte_at(&init_mm, (unsigned long)kaddr, *pte,
+			   pfn_pte(page_to_pfn(pages[i]), prot));
+		flush_tlb_kernel_page((unsigned long)kaddr);
+		memset(kaddr, 0, PAGE_SIZE);
+		if (pool->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+			__cpuc_flush_dcache_area(kaddr, PAGE_SIZE);
+	}
+	wmb();
+
+	if (n < want && time_after(jiffies, zero_backoff_until)) {
+		/* zeroed by the allocator, the attribute change below
+		 * cleans them from the caches */
+		while (n < want) {
+			pages[n] = alloc_page(gfp);
+			if (!pages[n])
+				break;
+			n++;
+		}
+		if (n > nr_dirty) {
+			BUG_ON((*s_cpa[pool->flags])(&pages[nr_dirty],
+						     n - nr_dirty));
+			for (i = nr_dirty; i < n; i++)
+				atomic_inc(&pages[i]->_count);
+		}
+	}
+
+	nvmap_page_pool_lock(pool);
+	preempt_disable();
+	for (i = 0; i < n && pool->npages < pool->max_pages; i++) {
+		if (pool->npages > pool->nzeroed)
+			pool->page_array[pool->npages] =
+				pool->page_array[pool->nzeroed];
+		pool->page_array[pool->nzeroed++] = pages[i];
+		pool->npages++;
+	}
+	nvmap_page_pool_unlock(pool);
+	preempt_enable();
+
+	if (i == n)
+		return n;
+
+	/* the pool was refilled or shrunk while the pages were zeroed */
+	added = i;
+	BUG_ON(set_pages_array_wb(&pages[i], n - i));
+	for (; i < n; i++) {
+		atomic_dec(&pages[i]->_count);
+		__free_page(pages[i]);
+	}
+	return added;
+}
+
+/* runs one zeroing batch on every pool below its reserve; returns the
+ * number of pages added to the reserves */
+static int nvmap_page_pool_zero_pools(struct nvmap_share *share)
+{
+	struct nvmap_page_pool *pool;
+	pte_t **pte;
+	void *kaddr;
+	int i, done = 0;
+
+	pte = nvmap_alloc_pte(nvmap_dev, &kaddr);
+	if (IS_ERR(pte))
+		return 0;
+
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		pool = &share->pools[i];
+		if (nvmap_page_pool_needs_zeroing(pool))
+			done += nvmap_page_pool_zero_batch(pool, pte, kaddr);
+	}
+
+	nvmap_free_pte(nvmap_dev, pte);
+	return done;
+}
+
+static int nvmap_page_pool_zero_thread(void *data)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	struct nvmap_share *share = nvmap_get_share_from_dev(nvmap_dev);
+	long timeout;
+	bool pending;
+	int i;
+
+	sched_setscheduler(current, SCHED_IDLE, &param);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		timeout = MAX_SCHEDULE_TIMEOUT;
+		set_current_state(TASK_INTERRUPTIBLE);
+
+		pending = false;
+		for (i = 0; i < NVMAP_NUM_POOLS; i++)
+			pending |= nvmap_page_pool_needs_zeroing(
+					&share->pools[i]);
+
+		if (pending) {
+			__set_current_state(TASK_RUNNING);
+			if (nvmap_page_pool_zero_pools(share)) {
+				cond_resched();
+				try_to_freeze();
+				continue;
+			}
+			/* no pages to zero right now, retry later */
+			timeout = NVMAP_PP_ZERO_BACKOFF;
+			set_current_state(TASK_INTERRUPTIBLE);
+		}
+
+		schedule_timeout(timeout);
+		try_to_freeze();
+	}
+	return 0;
+}
+
+int nvmap_page_pool_zero_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(nvmap_page_pool_zero_thread, NULL, "nvmap-zero");
+	if (IS_ERR(task)) {
+		pr_err("failed to start page zeroing thread\n");
+		return PTR_ERR(task);
+	}
+	zero_backoff_until = jiffies;
+	zero_thread = task;
+	return 0;
+}
+
+static int zero_reserve_set(const char *arg, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(arg, kp);
+
+	if (!ret && zero_thread)
+		wake_up_process(zero_thread);
+	return ret;
+}
+
+static struct kernel_param_ops zero_reserve_ops = {
+	.get = param_get_uint,
+	.set = zero_reserve_set,
+};
+
+module_param_cb(zeroed_pool_reserve, &zero_reserve_ops, &zero_reserve, 0644);
+
+static int pp_stats_get(char *buff, const struct kernel_param *kp)
+{
+	unsigned int i;
+	int cpu, len = 0;
+	int cached;
+	unsigned long hits, misses, refills, drains;
+	struct nvmap_page_pool_pcp *pcp;
+	struct nvmap_share *share;
+
+	if (!nvmap_dev)
+		return 0;
+
+	share = nvmap_get_share_from_dev(nvmap_dev);
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		struct nvmap_page_pool *pool = &share->pools[i];
+
+		if (!pool->pcp)
+			continue;
+		cached = 0;
+		hits = misses = refills = drains = 0;
+		for_each_possible_cpu(cpu) {
+			pcp = per_cpu_ptr(pool->pcp, cpu);
+			cached += pcp->count;
+			hits += pcp->hits;
+			misses += pcp->misses;
+			refills += pcp->refills;
+			drains += pcp->drains;
+		}
+		len += scnprintf(buff + len, PAGE_SIZE - len,
+			"%s: pooled=%d cached=%d hits=%lu misses=%lu "
+			"refills=%lu drains=%lu zeroed=%d zero_hits=%lu\n",
+			s_memtype_str[i], pool->npages, cached, hits, misses,
+			refills, drains, pool->nzeroed, pool->zero_hits);
+	}
+	return len;
+}
+
+static struct kernel_param_ops pp_stats_ops = {
+	.get = pp_stats_get,
+};
+
+module_param_cb(page_pool_stats, &pp_stats_ops, NULL, 0444);
+
 static int enable_pp_set(const char *arg, const struct kernel_param *kp)
 {
 	int total_pages, available_pages;
@@ -384,13 +775,6 @@ int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 	static int reg = 1;
 	struct sysinfo info;
 	int highmem_pages = 0;
-	typedef int (*set_pages_array) (struct page **pages, int addrinarray);
-	set_pages_array s_cpa[] = {
-		set_pages_array_uc,
-		set_pages_array_wc,
-		set_pages_array_iwb,
-		set_pages_array_wb
-	};
 
 	BUG_ON(flags >= NVMAP_NUM_POOLS);
 	memset(pool, 0x0, sizeof(*pool));
@@ -446,6 +830,12 @@ do_cpa:
 	err = (*s_cpa[flags])(pool->page_array, pool->npages);
 	BUG_ON(err);
 	nvmap_page_pool_unlock(pool);
+
+	/* without per-cpu caches every page goes through the pool lock */
+	pool->pcp = alloc_percpu(struct nvmap_page_pool_pcp);
+	if (!pool->pcp)
+		pr_warn("%s pool: no per-cpu page caches",
+			s_memtype_str[flags]);
 	return 0;
 fail:
 	pool->max_pages = 0;
@@ -512,6 +902,8 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 			break;
 		page_index++;
 	}
+	if (page_index)
+		nvmap_page_pool_zero_kick(pool);
 #endif
 
 	if (page_index == nr_page)
@@ -537,7 +929,8 @@ skip_attr_restore:
 	altfree(h->pgalloc.pages, nr_page * sizeof(struct page *));
 
 out:
-	kfree(h);
+	/* lock-free handle ref lookups may still dereference the handle */
+	kfree_rcu(h, rcu);
 }
 
 static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
@@ -560,6 +953,30 @@ static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
 	return page;
 }
 
+static bool large_pages = true;
+module_param(large_pages, bool, 0644);
+
+/* fills pages[] with one naturally aligned NVMAP_LARGE_PAGE_SIZE block.
+ * this is opportunistic: no reclaim or compaction is done to get one */
+static bool nvmap_alloc_large_page(gfp_t gfp, struct page **pages)
+{
+	struct page *page;
+	unsigned int i;
+
+	if (NVMAP_LARGE_PAGE_ORDER >= MAX_ORDER)
+		return false;
+
+	page = alloc_pages(gfp | __GFP_NORETRY, NVMAP_LARGE_PAGE_ORDER);
+	if (!page)
+		return false;
+
+	split_page(page, NVMAP_LARGE_PAGE_ORDER);
+	for (i = 0; i < NVMAP_LARGE_PAGE_PAGES; i++)
+		pages[i] = nth_page(page, i);
+
+	return true;
+}
+
 static int handle_page_alloc(struct nvmap_client *client,
 			     struct nvmap_handle *h, bool contiguous)
 {
@@ -577,6 +994,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 	gfp_t gfp = GFP_NVMAP;
 	unsigned long kaddr;
 	pte_t **pte = NULL;
+	bool large = large_pages && size >= NVMAP_LARGE_PAGE_SIZE;
 
 	if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES) {
 		gfp |= __GFP_ZERO;
@@ -593,6 +1011,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 	prot = nvmap_pgprot(h, pgprot_kernel);
 
 	h->pgalloc.area = NULL;
+	h->pgalloc.large_pages = false;
 	if (contiguous) {
 		struct page *page;
 		page = nvmap_alloc_pages_exact(gfp, size);
@@ -604,10 +1023,23 @@ static int handle_page_alloc(struct nvmap_client *client,
 
 	} else {
 #ifdef CONFIG_NVMAP_PAGE_POOLS
-		if (h->flags < NVMAP_NUM_POOLS)
+		/* skipping the memset saves more than large blocks gain, so
+		 * zeroed handles take pre-zeroed pages first */
+		if (h->flags < NVMAP_NUM_POOLS &&
+		    (h->userflags & NVMAP_HANDLE_ZEROED_PAGES)) {
+			i = nvmap_page_pool_alloc_zeroed(
+				&share->pools[h->flags], pages, nr_page);
+			page_index = i;
+			if (i & (NVMAP_LARGE_PAGE_PAGES - 1))
+				large = false;
+		}
+
+		/* pool pages are scattered, they would break up the large
+		 * blocks of a handle that can use them */
+		if (h->flags < NVMAP_NUM_POOLS && !large)
 			pool = &share->pools[h->flags];
 
-		for (i = 0; i < nr_page; i++) {
+		for (; i < nr_page; i++) {
 			/* Get pages from pool, if available. */
 			pages[i] = nvmap_page_pool_alloc(pool);
 			if (!pages[i])
@@ -633,15 +1065,26 @@ static int handle_page_alloc(struct nvmap_client *client,
 			page_index++;
 		}
 #endif
-		for (; i < nr_page; i++) {
+		while (i < nr_page) {
+			if (large && nr_page - i >= NVMAP_LARGE_PAGE_PAGES) {
+				if (nvmap_alloc_large_page(gfp, &pages[i])) {
+					h->pgalloc.large_pages = true;
+					i += NVMAP_LARGE_PAGE_PAGES;
+					continue;
+				}
+				/* keep the blocks section aligned in the
+				 * handle: no more large pages after a miss */
+				large = false;
+			}
 			pages[i] = nvmap_alloc_pages_exact(gfp,	PAGE_SIZE);
 			if (!pages[i])
 				goto fail;
+			i++;
 		}
 
 #ifndef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
 		h->pgalloc.area = tegra_iovmm_create_vm(client->share->iovmm,
-					NULL, size, h->align, prot,
+					NULL, size, nvmap_iovm_align(h), prot,
 					h->pgalloc.iovm_addr);
 		if (!h->pgalloc.area)
 			goto fail;
@@ -884,9 +1327,10 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 		goto out;
 	}
 
-	smp_rmb();
-	pins = atomic_read(&ref->pin);
+	/* kills the ref for concurrent lock-free pins, see nvmap_ref_pin_get */
+	pins = atomic_xchg(&ref->pin, NVMAP_REF_DEAD);
 	rb_erase(&ref->node, &client->handle_refs);
+	hlist_del_rcu(&ref->hash);
 
 	if (h->alloc && h->heap_pgalloc && !h->pgalloc.contig)
 		atomic_sub(h->size, &client->iovm_commit);
@@ -911,7 +1355,7 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 	if (h->owner == client)
 		h->owner = NULL;
 
-	kfree(ref);
+	kfree_rcu(ref, rcu);
 
 out:
 	BUG_ON(!atomic_read(&h->ref));
@@ -936,6 +1380,8 @@ static void add_handle_ref(struct nvmap_client *client,
 	}
 	rb_link_node(&ref->node, parent, p);
 	rb_insert_color(&ref->node, &client->handle_refs);
+	hlist_add_head_rcu(&ref->hash,
+			   nvmap_ref_hash(client, (unsigned long)ref->handle));
 	nvmap_ref_unlock(client);
 }
 
@@ -980,22 +1426,12 @@ struct nvmap_handle_ref *nvmap_create_handle(struct nvmap_client *client,
 	return ref;
 }
 
-struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
-						   unsigned long id)
+/* adds a reference to h in client. consumes the caller's reference on h:
+ * on success it is owned by the returned ref, on failure it is dropped */
+static struct nvmap_handle_ref *nvmap_duplicate_handle(
+	struct nvmap_client *client, struct nvmap_handle *h)
 {
 	struct nvmap_handle_ref *ref = NULL;
-	struct nvmap_handle *h = NULL;
-
-	BUG_ON(!client || client->dev != nvmap_dev);
-	/* on success, the reference count for the handle should be
-	 * incremented, so the success paths will not call nvmap_handle_put */
-	h = nvmap_validate_get(client, id);
-
-	if (!h) {
-		nvmap_debug(client, "%s duplicate handle failed\n",
-			    current->group_leader->comm);
-		return ERR_PTR(-EPERM);
-	}
 
 	if (!h->alloc) {
 		nvmap_err(client, "%s duplicating unallocated handle\n",
@@ -1026,7 +1462,7 @@ struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
 			atomic_sub(h->size, &client->iovm_commit);
 			nvmap_handle_put(h);
 			nvmap_err(client, "duplicating %p in %s over-commits"
-				  " IOVMM space\n", (void *)id,
+				  " IOVMM space\n", h,
 				  current->group_leader->comm);
 			return ERR_PTR(-ENOMEM);
 		}
@@ -1050,6 +1486,102 @@ struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
 	ref->handle = h;
 	atomic_set(&ref->pin, 0);
 	add_handle_ref(client, ref);
-	trace_nvmap_duplicate_handle_id(client, id, ref);
 	return ref;
 }
+
+struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
+						   unsigned long id)
+{
+	struct nvmap_handle_ref *ref;
+	struct nvmap_handle *h;
+
+	BUG_ON(!client || client->dev != nvmap_dev);
+	/* on success, the reference count for the handle should be
+	 * incremented, so the success paths will not call nvmap_handle_put */
+	h = nvmap_validate_get(client, id);
+
+	if (!h) {
+		nvmap_debug(client, "%s duplicate handle failed\n",
+			    current->group_leader->comm);
+		return ERR_PTR(-EPERM);
+	}
+
+	ref = nvmap_duplicate_handle(client, h);
+	if (!IS_ERR(ref))
+		trace_nvmap_duplicate_handle_id(client, id, ref);
+	return ref;
+}
+
+/*
+ * Shared handle files. A share fd is an anonymous file that holds one
+ * reference on an allocated handle; it can be passed between processes
+ * over a unix socket, or handed to other drivers (display, nvavp, the
+ * camera host), and turned into a handle reference in any client with
+ * nvmap_duplicate_handle_fd(). Unlike global ids, possessing the fd is
+ * what grants access, so the handle need not be marked global.
+ */
+static int nvmap_share_release(struct inode *inode, struct file *filp)
+{
+	struct nvmap_handle *h = filp->private_data;
+
+	nvmap_handle_put(h);
+	return 0;
+}
+
+static const struct file_operations nvmap_share_fops = {
+	.owner		= THIS_MODULE,
+	.release	= nvmap_share_release,
+};
+
+int nvmap_handle_share_fd(struct nvmap_handle *h)
+{
+	int fd;
+
+	if (!h->alloc)
+		return -EINVAL;
+
+	h = nvmap_handle_get(h);
+	if (!h)
+		return -EINVAL;
+
+	fd = anon_inode_getfd("nvmap-share", &nvmap_share_fops, h,
+			      O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		nvmap_handle_put(h);
+	return fd;
+}
+
+int nvmap_share_fd(struct nvmap_client *client, struct nvmap_handle_ref *r)
+{
+	if (!client || !r)
+		return -EINVAL;
+
+	return nvmap_handle_share_fd(r->handle);
+}
+EXPORT_SYMBOL(nvmap_share_fd);
+
+struct nvmap_handle_ref *nvmap_duplicate_handle_fd(struct nvmap_client *client,
+						   int fd)
+{
+	struct nvmap_handle *h = NULL;
+	struct file *f;
+
+	BUG_ON(!client || client->dev != nvmap_dev);
+
+	f = fget(fd);
+	if (!f)
+		return ERR_PTR(-EBADF);
+
+	if (f->f_op == &nvmap_share_fops)
+		h = nvmap_handle_get(f->private_data);
+	fput(f);
+
+	if (!h) {
+		nvmap_debug(client, "%s: fd %d is not an nvmap share\n",
+			    current->group_leader->comm, fd);
+		return ERR_PTR(-EINVAL);
+	}
+
+	return nvmap_duplicate_handle(client, h);
+}
+EXPORT_SYMBOL(nvmap_duplicate_handle_fd);
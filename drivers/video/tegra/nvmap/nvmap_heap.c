@@ -27,6 +27,13 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+#include <linux/sort.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
+#include <linux/highmem.h>
 
 #include <linux/nvmap.h>
 #include "nvmap.h"
@@ -68,9 +75,24 @@
  * and to ensure that the minimum free block size in the carveout (i.e., the
  * "small" threshold) is still a meaningful size.
  *
+ * free blocks are kept in an rbtree sorted by address, where every node also
+ * records the largest free block in its subtree. this allows both first-fit
+ * and last-fit lookups to skip whole subtrees which can't satisfy a request,
+ * so allocation stays O(log n) however fragmented the carveout becomes.
+ * neighbouring free blocks are found through the address-ordered all_list,
+ * which makes coalescing on free constant time.
+ *
  */
 
 #define MAX_BUDDY_NR	128	/* maximum buddies in a buddy allocator */
+#define ALLOC_LAT_SAMPLES	128	/* allocation latency history length */
+
+/* ring of the most recent times taken by some operation, in ns */
+struct heap_lat {
+	u32 ns[ALLOC_LAT_SAMPLES];
+	unsigned int idx;
+	unsigned int nr;
+};
 
 enum direction {
 	TOP_DOWN,
@@ -94,6 +116,15 @@ struct heap_stat {
 	unsigned int compaction_count_fast;
 	/* full compaction attempt counter */
 	unsigned int compaction_count_full;
+	unsigned int frag_index;	/* fragmentation index, 0..1000 */
+	unsigned long long compact_bytes;	/* moved by background passes */
+	unsigned int compact_passes;	/* background compaction passes */
+	unsigned int compact_aborts;	/* passes cut short by allocations */
+	size_t cma_claimed;		/* taken back from the page allocator */
+	unsigned int cma_claims;	/* pageblocks migrated out and taken */
+	unsigned int cma_claim_fails;	/* pageblocks which would not empty */
+	unsigned int cma_releases;	/* pageblocks lent out again */
+	u32 cma_claim_max;		/* slowest claim, in ns */
 };
 
 struct buddy_heap;
@@ -111,7 +142,8 @@ struct list_block {
 	size_t size;
 	size_t align;
 	struct nvmap_heap *heap;
-	struct list_head free_list;
+	struct rb_node free_node;	/* empty unless the block is free */
+	size_t free_max;		/* largest free block in subtree */
 };
 
 struct combo_block {
@@ -135,7 +167,8 @@ struct buddy_heap {
 
 struct nvmap_heap {
 	struct list_head all_list;
-	struct list_head free_list;
+	struct rb_root free_tree;
+	size_t free_size;
 	struct mutex lock;
 	struct list_head buddy_list;
 	unsigned int min_buddy_shift;
@@ -144,6 +177,32 @@ struct nvmap_heap {
 	const char *name;
 	void *arg;
 	struct device dev;
+	struct heap_lat alloc_lat;
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	struct delayed_work compact_work;
+	atomic_t alloc_pending;		/* foreground allocators waiting */
+	unsigned int compact_count_fast;
+	unsigned int compact_count_full;
+	unsigned long long compact_bytes;
+	unsigned int compact_passes;
+	unsigned int compact_aborts;
+#endif
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	/*
+	 * a movable carveout is lent to the page allocator a pageblock at a
+	 * time: a pageblock is taken back (claimed) before the first block
+	 * inside it is handed out, and lent out again once none is left.
+	 */
+	unsigned int *cma_users;	/* heap blocks in each pageblock */
+	unsigned long *cma_claimed;	/* pageblocks owned by the heap */
+	unsigned int cma_blocks;
+	phys_addr_t cma_base;
+	unsigned int cma_claims;
+	unsigned int cma_claim_fails;
+	unsigned int cma_releases;
+	u32 cma_claim_max;
+	struct heap_lat cma_lat;	/* time to migrate out and claim */
+#endif
 };
 
 static struct kmem_cache *buddy_heap_cache;
@@ -183,6 +242,15 @@ static void buddy_stat(struct buddy_heap *heap, struct heap_stat *stat)
 	}
 }
 
+/* 0 while all free space is a single block, approaching 1000 as the free
+ * space splinters into blocks which are small compared to the total */
+static unsigned int frag_index(size_t largest, size_t free)
+{
+	if (!free)
+		return 0;
+	return 1000 - (unsigned int)div_u64((u64)largest * 1000, free);
+}
+
 /* returns the free size of the heap (including any free blocks in any
  * buddy-heap suballocators; must be called while holding the parent
  * heap's lock. */
@@ -190,6 +258,7 @@ static unsigned long heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
 {
 	struct buddy_heap *bh;
 	struct list_block *l = NULL;
+	struct rb_node *n;
 	unsigned long base = -1ul;
 
 	memset(stat, 0, sizeof(*stat));
@@ -210,16 +279,81 @@ static unsigned long heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
 		stat->count--;
 	}
 
-	list_for_each_entry(l, &heap->free_list, free_list) {
+	for (n = rb_first(&heap->free_tree); n; n = rb_next(n)) {
+		l = rb_entry(n, struct list_block, free_node);
 		stat->free += l->size;
 		stat->free_count++;
 		stat->free_largest = max(l->size, stat->free_largest);
 	}
+	stat->frag_index = frag_index(stat->free_largest, stat->free);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	stat->compaction_count_fast = heap->compact_count_fast;
+	stat->compaction_count_full = heap->compact_count_full;
+	stat->compact_bytes = heap->compact_bytes;
+	stat->compact_passes = heap->compact_passes;
+	stat->compact_aborts = heap->compact_aborts;
+#endif
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	if (heap->cma_users) {
+		unsigned int i;
+
+		for (i = 0; i < heap->cma_blocks; i++)
+			if (test_bit(i, heap->cma_claimed))
+				stat->cma_claimed += PAGE_SIZE <<
+						     pageblock_order;
+	}
+	stat->cma_claims = heap->cma_claims;
+	stat->cma_claim_fails = heap->cma_claim_fails;
+	stat->cma_releases = heap->cma_releases;
+	stat->cma_claim_max = heap->cma_claim_max;
+#endif
 	mutex_unlock(&heap->lock);
 
 	return base;
 }
 
+static int alloc_lat_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a;
+	u32 y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* returns the pct-th percentile of the times recorded in ring, in ns */
+static u32 heap_lat(struct nvmap_heap *heap, struct heap_lat *ring,
+		    unsigned int pct)
+{
+	unsigned int nr;
+	u32 *lat;
+	u32 ret = 0;
+
+	lat = kmalloc(sizeof(ring->ns), GFP_KERNEL);
+	if (!lat)
+		return 0;
+
+	mutex_lock(&heap->lock);
+	nr = ring->nr;
+	memcpy(lat, ring->ns, nr * sizeof(*lat));
+	mutex_unlock(&heap->lock);
+
+	if (nr) {
+		sort(lat, nr, sizeof(*lat), alloc_lat_cmp, NULL);
+		ret = lat[(nr - 1) * pct / 100];
+	}
+	kfree(lat);
+	return ret;
+}
+
+/* must be called while holding the heap's lock */
+static void heap_record_lat(struct heap_lat *ring, s64 ns)
+{
+	ring->ns[ring->idx] = min_t(s64, ns, UINT_MAX);
+	ring->idx = (ring->idx + 1) % ALLOC_LAT_SAMPLES;
+	if (ring->nr < ALLOC_LAT_SAMPLES)
+		ring->nr++;
+}
+
 static ssize_t heap_name_show(struct device *dev,
 			      struct device_attribute *attr, char *buf);
 
@@ -247,6 +381,54 @@ static struct device_attribute heap_stat_free_size =
 static struct device_attribute heap_stat_base =
 	__ATTR(base, S_IRUGO, heap_stat_show, NULL);
 
+static struct device_attribute heap_stat_frag_index =
+	__ATTR(frag_index, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_fast =
+	__ATTR(compact_fast, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_full =
+	__ATTR(compact_full, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_bytes =
+	__ATTR(compact_bytes, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_passes =
+	__ATTR(compact_passes, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_aborts =
+	__ATTR(compact_aborts, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_alloc_p50 =
+	__ATTR(alloc_p50_ns, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_alloc_p90 =
+	__ATTR(alloc_p90_ns, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_alloc_p99 =
+	__ATTR(alloc_p99_ns, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claimed =
+	__ATTR(cma_claimed, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claims =
+	__ATTR(cma_claims, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claim_fails =
+	__ATTR(cma_claim_fails, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_releases =
+	__ATTR(cma_releases, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claim_p50 =
+	__ATTR(cma_claim_p50_ns, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claim_p90 =
+	__ATTR(cma_claim_p90_ns, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claim_max =
+	__ATTR(cma_claim_max_ns, S_IRUGO, heap_stat_show, NULL);
+
 static struct device_attribute heap_attr_name =
 	__ATTR(name, S_IRUGO, heap_name_show, NULL);
 
@@ -258,6 +440,22 @@ static struct attribute *heap_stat_attrs[] = {
 	&heap_stat_free_count.attr,
 	&heap_stat_free_size.attr,
 	&heap_stat_base.attr,
+	&heap_stat_frag_index.attr,
+	&heap_stat_compact_fast.attr,
+	&heap_stat_compact_full.attr,
+	&heap_stat_compact_bytes.attr,
+	&heap_stat_compact_passes.attr,
+	&heap_stat_compact_aborts.attr,
+	&heap_stat_alloc_p50.attr,
+	&heap_stat_alloc_p90.attr,
+	&heap_stat_alloc_p99.attr,
+	&heap_stat_cma_claimed.attr,
+	&heap_stat_cma_claims.attr,
+	&heap_stat_cma_claim_fails.attr,
+	&heap_stat_cma_releases.attr,
+	&heap_stat_cma_claim_p50.attr,
+	&heap_stat_cma_claim_p90.attr,
+	&heap_stat_cma_claim_max.attr,
 	&heap_attr_name.attr,
 	NULL,
 };
@@ -281,6 +479,24 @@ static ssize_t heap_stat_show(struct device *dev,
 	struct heap_stat stat;
 	unsigned long base;
 
+	if (attr == &heap_stat_alloc_p50)
+		return sprintf(buf, "%u\n",
+			       heap_lat(heap, &heap->alloc_lat, 50));
+	else if (attr == &heap_stat_alloc_p90)
+		return sprintf(buf, "%u\n",
+			       heap_lat(heap, &heap->alloc_lat, 90));
+	else if (attr == &heap_stat_alloc_p99)
+		return sprintf(buf, "%u\n",
+			       heap_lat(heap, &heap->alloc_lat, 99));
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	else if (attr == &heap_stat_cma_claim_p50)
+		return sprintf(buf, "%u\n",
+			       heap_lat(heap, &heap->cma_lat, 50));
+	else if (attr == &heap_stat_cma_claim_p90)
+		return sprintf(buf, "%u\n",
+			       heap_lat(heap, &heap->cma_lat, 90));
+#endif
+
 	base = heap_stat(heap, &stat);
 
 	if (attr == &heap_stat_total_max)
@@ -297,6 +513,31 @@ static ssize_t heap_stat_show(struct device *dev,
 		return sprintf(buf, "%u\n", stat.free);
 	else if (attr == &heap_stat_base)
 		return sprintf(buf, "%08lx\n", base);
+	else if (attr == &heap_stat_frag_index)
+		return sprintf(buf, "%u\n", stat.frag_index);
+	else if (attr == &heap_stat_compact_fast)
+		return sprintf(buf, "%u\n", stat.compaction_count_fast);
+	else if (attr == &heap_stat_compact_full)
+		return sprintf(buf, "%u\n", stat.compaction_count_full);
+	else if (attr == &heap_stat_compact_bytes)
+		return sprintf(buf, "%llu\n", stat.compact_bytes);
+	else if (attr == &heap_stat_compact_passes)
+		return sprintf(buf, "%u\n", stat.compact_passes);
+	else if (attr == &heap_stat_compact_aborts)
+		return sprintf(buf, "%u\n", stat.compact_aborts);
+	else if (attr == &heap_stat_cma_claimed)
+		return sprintf(buf, "%u\n", stat.cma_claimed);
+	else if (attr == &heap_stat_cma_claims)
+		return sprintf(buf, "%u\n", stat.cma_claims);
+	else if (attr == &heap_stat_cma_claim_fails)
+		return sprintf(buf, "%u\n", stat.cma_claim_fails);
+	else if (attr == &heap_stat_cma_releases)
+		return sprintf(buf, "%u\n", stat.cma_releases);
+	else if (attr == &heap_stat_cma_claim_max)
+		return sprintf(buf, "%u\n", stat.cma_claim_max);
+	else if (attr == &heap_stat_cma_claim_p50 ||
+		 attr == &heap_stat_cma_claim_p90)
+		return sprintf(buf, "0\n");
 	else
 		return -EINVAL;
 }
@@ -384,6 +625,290 @@ static struct buddy_heap *do_buddy_free(struct nvmap_heap_block *block)
 }
 
 
+static inline bool block_is_free(struct list_block *l)
+{
+	return !RB_EMPTY_NODE(&l->free_node);
+}
+
+static inline size_t free_tree_max(struct rb_node *n)
+{
+	return n ? rb_entry(n, struct list_block, free_node)->free_max : 0;
+}
+
+static void free_tree_augment(struct rb_node *n, void *unused)
+{
+	struct list_block *l;
+
+	if (!n)
+		return;
+
+	l = rb_entry(n, struct list_block, free_node);
+	l->free_max = max3(l->size, free_tree_max(n->rb_left),
+			   free_tree_max(n->rb_right));
+}
+
+/* refreshes the subtree maxima after a free block changed size in place */
+static void free_tree_propagate(struct list_block *l)
+{
+	struct rb_node *n;
+
+	for (n = &l->free_node; n; n = rb_parent(n))
+		free_tree_augment(n, NULL);
+}
+
+static void free_tree_insert(struct nvmap_heap *heap, struct list_block *l)
+{
+	struct rb_node **p = &heap->free_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct list_block *e;
+
+	while (*p) {
+		parent = *p;
+		e = rb_entry(parent, struct list_block, free_node);
+		if (l->block.base < e->block.base)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+
+	l->free_max = l->size;
+	heap->free_size += l->size;
+	rb_link_node(&l->free_node, parent, p);
+	rb_insert_color(&l->free_node, &heap->free_tree);
+	rb_augment_insert(&l->free_node, free_tree_augment, NULL);
+}
+
+static void free_tree_erase(struct nvmap_heap *heap, struct list_block *l)
+{
+	struct rb_node *deepest;
+
+	heap->free_size -= l->size;
+	deepest = rb_augment_erase_begin(&l->free_node);
+	rb_erase(&l->free_node, &heap->free_tree);
+	RB_CLEAR_NODE(&l->free_node);
+	rb_augment_erase_end(deepest, free_tree_augment, NULL);
+}
+
+/* children in search order: lowest address first for BOTTOM_UP,
+ * highest address first for TOP_DOWN */
+#define near_child(n, dir) ((dir) == BOTTOM_UP ? (n)->rb_left : (n)->rb_right)
+#define far_child(n, dir)  ((dir) == BOTTOM_UP ? (n)->rb_right : (n)->rb_left)
+
+/* returns the first free block in the subtree at n, in dir address order,
+ * which is at least len bytes long */
+static struct list_block *free_tree_fit(struct rb_node *n, size_t len,
+					enum direction dir)
+{
+	struct list_block *l;
+
+	while (n) {
+		l = rb_entry(n, struct list_block, free_node);
+		if (l->free_max < len)
+			return NULL;
+		if (free_tree_max(near_child(n, dir)) >= len)
+			n = near_child(n, dir);
+		else if (l->size >= len)
+			return l;
+		else
+			n = far_child(n, dir);
+	}
+	return NULL;
+}
+
+/* returns the next free block after l, in dir address order, which is at
+ * least len bytes long */
+static struct list_block *free_tree_fit_next(struct list_block *l, size_t len,
+					     enum direction dir)
+{
+	struct rb_node *n = &l->free_node;
+	struct rb_node *parent;
+	struct list_block *p;
+
+	p = free_tree_fit(far_child(n, dir), len, dir);
+	if (p)
+		return p;
+
+	while ((parent = rb_parent(n))) {
+		if (n == near_child(parent, dir)) {
+			p = rb_entry(parent, struct list_block, free_node);
+			if (p->size >= len)
+				return p;
+			p = free_tree_fit(far_child(parent, dir), len, dir);
+			if (p)
+				return p;
+		}
+		n = parent;
+	}
+	return NULL;
+}
+
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+
+#define CMA_BLOCK_SIZE	(PAGE_SIZE << pageblock_order)
+
+/* takes pageblock i back from the page allocator, migrating whatever it
+ * holds elsewhere. must be called while holding the heap's lock */
+static int heap_cma_claim(struct nvmap_heap *heap, unsigned int i)
+{
+	phys_addr_t start = heap->cma_base + i * CMA_BLOCK_SIZE;
+	unsigned long pfn = __phys_to_pfn(start);
+	ktime_t t0 = ktime_get();
+	s64 ns;
+	int err;
+
+	err = alloc_contig_range(pfn, pfn + pageblock_nr_pages);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+	if (err) {
+		heap->cma_claim_fails++;
+		dev_dbg(&heap->dev, "pageblock %08lx busy (%d) after %lldns\n",
+			(unsigned long)start, err, ns);
+		return err;
+	}
+
+	/* the previous owners may have left dirty lines and lazily
+	 * unmapped cacheable aliases of these pages behind */
+	kmap_flush_unused();
+	inner_flush_cache_all();
+	outer_flush_range(start, start + CMA_BLOCK_SIZE);
+	wmb();
+
+	set_bit(i, heap->cma_claimed);
+	heap->cma_claims++;
+	heap->cma_claim_max = max_t(u32, heap->cma_claim_max,
+				    min_t(s64, ns, UINT_MAX));
+	heap_record_lat(&heap->cma_lat, ns);
+	return 0;
+}
+
+/* makes sure the heap owns all of [base, base + len) and counts one more
+ * user there; fails and changes no count if a pageblock can't be claimed.
+ * must be called while holding the heap's lock */
+static int heap_cma_get(struct nvmap_heap *heap, phys_addr_t base, size_t len)
+{
+	unsigned int first, last, i;
+	int err;
+
+	if (!heap->cma_users)
+		return 0;
+
+	first = (base - heap->cma_base) / CMA_BLOCK_SIZE;
+	last = (base + len - 1 - heap->cma_base) / CMA_BLOCK_SIZE;
+	for (i = first; i <= last; i++) {
+		if (test_bit(i, heap->cma_claimed))
+			continue;
+		err = heap_cma_claim(heap, i);
+		if (err)
+			return err;
+	}
+
+	for (i = first; i <= last; i++)
+		heap->cma_users[i]++;
+	return 0;
+}
+
+/* must be called while holding the heap's lock */
+static void heap_cma_put(struct nvmap_heap *heap, phys_addr_t base, size_t len)
+{
+	unsigned int first, last, i;
+
+	if (!heap->cma_users)
+		return;
+
+	first = (base - heap->cma_base) / CMA_BLOCK_SIZE;
+	last = (base + len - 1 - heap->cma_base) / CMA_BLOCK_SIZE;
+	for (i = first; i <= last; i++) {
+		BUG_ON(!heap->cma_users[i]);
+		heap->cma_users[i]--;
+	}
+}
+
+/* lends every claimed pageblock which no block uses any more back to the
+ * page allocator. this is kept apart from heap_cma_put() so that a block
+ * which is being relocated can still be read after it has been freed.
+ * must be called while holding the heap's lock */
+static void heap_cma_release_idle(struct nvmap_heap *heap)
+{
+	unsigned long pfn;
+	unsigned int i;
+
+	if (!heap->cma_users)
+		return;
+
+	for (i = 0; i < heap->cma_blocks; i++) {
+		if (heap->cma_users[i] || !test_bit(i, heap->cma_claimed))
+			continue;
+		pfn = __phys_to_pfn(heap->cma_base + i * CMA_BLOCK_SIZE);
+		free_contig_range(pfn, pageblock_nr_pages);
+		clear_bit(i, heap->cma_claimed);
+		heap->cma_releases++;
+	}
+}
+
+/* hands [base, base + len) over to the page allocator as MIGRATE_CMA
+ * pageblocks; the range was reserved, but not removed, at boot */
+static int heap_cma_init(struct nvmap_heap *heap, phys_addr_t base,
+			 size_t len)
+{
+	unsigned long pfn;
+	unsigned int i;
+
+	if ((base | len) & (CMA_BLOCK_SIZE - 1)) {
+		dev_warn(&heap->dev, "%s: %08lx@%08lx is not made of whole "
+			 "pageblocks, keeping it\n", __func__,
+			 (unsigned long)len, (unsigned long)base);
+		return -EINVAL;
+	}
+
+	heap->cma_blocks = len / CMA_BLOCK_SIZE;
+	heap->cma_users = kcalloc(heap->cma_blocks, sizeof(*heap->cma_users),
+				  GFP_KERNEL);
+	heap->cma_claimed = kcalloc(BITS_TO_LONGS(heap->cma_blocks),
+				    sizeof(long), GFP_KERNEL);
+	if (!heap->cma_users || !heap->cma_claimed) {
+		kfree(heap->cma_users);
+		kfree(heap->cma_claimed);
+		heap->cma_users = NULL;
+		heap->cma_claimed = NULL;
+		return -ENOMEM;
+	}
+	heap->cma_base = base;
+
+	for (i = 0; i < heap->cma_blocks; i++) {
+		pfn = __phys_to_pfn(base + i * CMA_BLOCK_SIZE);
+		init_cma_reserved_pageblock(pfn_to_page(pfn));
+	}
+	dev_info(&heap->dev, "lending %luKiB to the page allocator\n",
+		 (unsigned long)len / 1024);
+	return 0;
+}
+
+#else
+
+static inline int heap_cma_get(struct nvmap_heap *heap, phys_addr_t base,
+			       size_t len)
+{
+	return 0;
+}
+
+static inline void heap_cma_put(struct nvmap_heap *heap, phys_addr_t base,
+				size_t len)
+{
+}
+
+static inline void heap_cma_release_idle(struct nvmap_heap *heap)
+{
+}
+
+static inline int heap_cma_init(struct nvmap_heap *heap, phys_addr_t base,
+				size_t len)
+{
+	return -ENODEV;
+}
+
+#endif
+
+static struct list_block *__do_heap_free(struct nvmap_heap_block *block);
+
 /*
  * base_max limits position of allocated chunk in memory.
  * if base_max is 0 then there is no such limitation.
@@ -417,7 +942,8 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 #endif
 
 	if (dir == BOTTOM_UP) {
-		list_for_each_entry(i, &heap->free_list, free_list) {
+		for (i = free_tree_fit(heap->free_tree.rb_node, len, dir); i;
+		     i = free_tree_fit_next(i, len, dir)) {
 			size_t fix_size;
 			fix_base = ALIGN(i->block.base, align);
 			if(!fix_base || fix_base >= i->block.base + i->size)
@@ -436,14 +962,13 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 			}
 		}
 	} else {
-		list_for_each_entry_reverse(i, &heap->free_list, free_list) {
-			if (i->size >= len) {
-				fix_base = i->block.base + i->size - len;
-				fix_base &= ~(align-1);
-				if (fix_base >= i->block.base) {
-					b = i;
-					break;
-				}
+		for (i = free_tree_fit(heap->free_tree.rb_node, len, dir); i;
+		     i = free_tree_fit_next(i, len, dir)) {
+			fix_base = i->block.base + i->size - len;
+			fix_base &= ~(align-1);
+			if (fix_base >= i->block.base) {
+				b = i;
+				break;
 			}
 		}
 	}
@@ -451,6 +976,8 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 	if (!b)
 		return NULL;
 
+	free_tree_erase(heap, b);
+
 	if (dir == BOTTOM_UP)
 		b->block.type = BLOCK_FIRST_FIT;
 
@@ -473,7 +1000,7 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		b->orig_addr = fix_base;
 		b->size -= rem->size;
 		list_add_tail(&rem->all_list,  &b->all_list);
-		list_add_tail(&rem->free_list, &b->free_list);
+		free_tree_insert(heap, rem);
 	}
 
 	b->orig_addr = b->block.base;
@@ -491,14 +1018,19 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		rem->orig_addr = rem->block.base;
 		b->size = len;
 		list_add(&rem->all_list,  &b->all_list);
-		list_add(&rem->free_list, &b->free_list);
+		free_tree_insert(heap, rem);
 	}
 
 out:
-	list_del(&b->free_list);
 	b->heap = heap;
 	b->mem_prot = mem_prot;
 	b->align = align;
+
+	/* a movable carveout must own the pages before handing them out */
+	if (heap_cma_get(heap, b->block.base, b->size)) {
+		__do_heap_free(&b->block);
+		return NULL;
+	}
 	return &b->block;
 }
 
@@ -508,10 +1040,12 @@ static void freelist_debug(struct nvmap_heap *heap, const char *title,
 {
 	int i;
 	struct list_block *n;
+	struct rb_node *node;
 
 	dev_debug(&heap->dev, "%s\n", title);
 	i = 0;
-	list_for_each_entry(n, &heap->free_list, free_list) {
+	for (node = rb_first(&heap->free_tree); node; node = rb_next(node)) {
+		n = rb_entry(node, struct list_block, free_node);
 		dev_debug(&heap->dev, "\t%d [%p..%p]%s\n", i, (void *)n->orig_addr,
 			  (void *)(n->orig_addr + n->size),
 			  (n == token) ? "<--" : "");
@@ -522,62 +1056,67 @@ static void freelist_debug(struct nvmap_heap *heap, const char *title,
 #define freelist_debug(_heap, _title, _token)	do { } while (0)
 #endif
 
-static struct list_block *do_heap_free(struct nvmap_heap_block *block)
+static struct list_block *__do_heap_free(struct nvmap_heap_block *block)
 {
 	struct list_block *b = container_of(block, struct list_block, block);
 	struct list_block *n = NULL;
 	struct nvmap_heap *heap = b->heap;
 
 	BUG_ON(b->block.base > b->orig_addr);
+	BUG_ON(block_is_free(b));
 	b->size += (b->block.base - b->orig_addr);
 	b->block.base = b->orig_addr;
 
 	freelist_debug(heap, "free list before", b);
 
-	/* Find position of first free block to the right of freed one */
-	list_for_each_entry(n, &heap->free_list, free_list) {
-		if (n->block.base > b->block.base)
-			break;
-	}
-
-	/* Add freed block before found free one */
-	list_add_tail(&b->free_list, &n->free_list);
-	BUG_ON(list_empty(&b->all_list));
-
-	freelist_debug(heap, "free list pre-merge", b);
+	/* all_list is address ordered, so the only free blocks which can
+	 * connect to the freed one are its immediate neighbours there */
 
-	/* merge freed block with next if they connect
+	/* merge freed block with next if it is free
 	 * freed block becomes bigger, next one is destroyed */
-	if (!list_is_last(&b->free_list, &heap->free_list)) {
-		n = list_first_entry(&b->free_list, struct list_block, free_list);
-		if (n->block.base == b->block.base + b->size) {
+	if (!list_is_last(&b->all_list, &heap->all_list)) {
+		n = list_first_entry(&b->all_list, struct list_block, all_list);
+		if (block_is_free(n)) {
+			BUG_ON(n->block.base != b->block.base + b->size);
+			free_tree_erase(heap, n);
 			list_del(&n->all_list);
-			list_del(&n->free_list);
-			BUG_ON(b->orig_addr >= n->orig_addr);
 			b->size += n->size;
 			kmem_cache_free(block_cache, n);
 		}
 	}
 
-	/* merge freed block with prev if they connect
+	/* merge freed block with prev if it is free
 	 * previous free block becomes bigger, freed one is destroyed */
-	if (b->free_list.prev != &heap->free_list) {
-		n = list_entry(b->free_list.prev, struct list_block, free_list);
-		if (n->block.base + n->size == b->block.base) {
+	if (b->all_list.prev != &heap->all_list) {
+		n = list_entry(b->all_list.prev, struct list_block, all_list);
+		if (block_is_free(n)) {
+			BUG_ON(n->block.base + n->size != b->block.base);
 			list_del(&b->all_list);
-			list_del(&b->free_list);
-			BUG_ON(n->orig_addr >= b->orig_addr);
 			n->size += b->size;
+			heap->free_size += b->size;
+			free_tree_propagate(n);
 			kmem_cache_free(block_cache, b);
 			b = n;
 		}
 	}
 
+	if (!block_is_free(b))
+		free_tree_insert(heap, b);
+
 	freelist_debug(heap, "free list after", b);
 	b->block.type = BLOCK_EMPTY;
 	return b;
 }
 
+/* the pages stay with the heap until heap_cma_release_idle() */
+static struct list_block *do_heap_free(struct nvmap_heap_block *block)
+{
+	struct list_block *b = container_of(block, struct list_block, block);
+
+	heap_cma_put(b->heap, b->block.base, b->size);
+	return __do_heap_free(block);
+}
+
 #ifndef CONFIG_NVMAP_CARVEOUT_COMPACTOR
 
 static struct nvmap_heap_block *do_buddy_alloc(struct nvmap_heap *h,
@@ -723,6 +1262,13 @@ static struct nvmap_heap_block *do_heap_relocate_listblock(
 	if (handle->usecount)
 		goto fail;
 
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	/* the full path counts on getting the freed block back, which a
+	 * pageblock that can't be claimed would break */
+	if (heap->cma_users)
+		fast = true;
+#endif
+
 	if (fast) {
 		/* Fast compaction path - first allocate, then free. */
 		heap_block_new = do_heap_alloc(heap, src_size, src_align,
@@ -825,6 +1371,105 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 	}
 	pr_err("Relocated %d chunks\n", relocation_count);
 }
+
+/*
+ * background compaction: once frees leave the heap fragmented beyond
+ * compact_threshold, a deferred pass moves up to compact_budget unpinned
+ * and unmapped blocks down into lower holes, one block per hold of the
+ * heap lock. a pass is abandoned as soon as a foreground allocation is
+ * waiting for the lock, and retried compact_delay_ms later.
+ */
+static unsigned int compact_threshold = 500;	/* fragmentation index */
+module_param(compact_threshold, uint, 0644);
+
+static unsigned int compact_budget = 16;	/* blocks per pass */
+module_param(compact_budget, uint, 0644);
+
+static unsigned int compact_delay_ms = 1000;
+module_param(compact_delay_ms, uint, 0644);
+
+/* must be called while holding the heap's lock */
+static bool heap_needs_compaction(struct nvmap_heap *heap)
+{
+	size_t largest = free_tree_max(heap->free_tree.rb_node);
+
+	return compact_budget &&
+		frag_index(largest, heap->free_size) >= compact_threshold;
+}
+
+/* must be called while holding the heap's lock */
+static void heap_schedule_compaction(struct nvmap_heap *heap)
+{
+	if (heap_needs_compaction(heap))
+		queue_delayed_work(system_freezable_wq, &heap->compact_work,
+				   msecs_to_jiffies(compact_delay_ms));
+}
+
+/* relocates the lowest movable block which sits above a hole; returns the
+ * number of bytes moved, or 0 if no block could be moved. must be called
+ * while holding the heap's lock */
+static size_t nvmap_heap_compact_step(struct nvmap_heap *heap)
+{
+	struct list_block *l;
+	bool hole = false;
+	size_t size;
+
+	list_for_each_entry(l, &heap->all_list, all_list) {
+		if (block_is_free(l)) {
+			hole = true;
+			continue;
+		}
+		if (!hole || l->block.type != BLOCK_FIRST_FIT)
+			continue;
+
+		/* pinned or mapped blocks are skipped by the relocator, and
+		 * a failed fast relocation leaves the heap untouched */
+		size = l->size;
+		if (do_heap_relocate_listblock(l, true))
+			return size;
+	}
+	return 0;
+}
+
+static void nvmap_heap_compact_work(struct work_struct *work)
+{
+	struct nvmap_heap *heap = container_of(to_delayed_work(work),
+					       struct nvmap_heap, compact_work);
+	unsigned int budget = compact_budget;
+	bool retry = false;
+	size_t moved;
+
+	while (budget--) {
+		mutex_lock(&heap->lock);
+		if (atomic_read(&heap->alloc_pending)) {
+			heap->compact_aborts++;
+			retry = true;
+			mutex_unlock(&heap->lock);
+			break;
+		}
+		if (!heap_needs_compaction(heap)) {
+			mutex_unlock(&heap->lock);
+			break;
+		}
+
+		moved = nvmap_heap_compact_step(heap);
+		heap->compact_bytes += moved;
+		heap_cma_release_idle(heap);
+		mutex_unlock(&heap->lock);
+
+		if (!moved)
+			break;
+		/* budget spent with the heap still fragmented */
+		retry = !budget;
+		cond_resched();
+	}
+
+	mutex_lock(&heap->lock);
+	heap->compact_passes++;
+	if (retry)
+		heap_schedule_compaction(heap);
+	mutex_unlock(&heap->lock);
+}
 #endif
 
 void nvmap_usecount_inc(struct nvmap_handle *h)
@@ -853,8 +1498,17 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 	size_t len        = handle->size;
 	size_t align      = handle->align;
 	unsigned int prot = handle->flags;
+	ktime_t start;
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	/* make any background compaction pass yield the lock */
+	atomic_inc(&h->alloc_pending);
+	mutex_lock(&h->lock);
+	atomic_dec(&h->alloc_pending);
+#else
 	mutex_lock(&h->lock);
+#endif
+	start = ktime_get();
 
 #ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
 	/* Align to page size */
@@ -863,10 +1517,12 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 	b = do_heap_alloc(h, len, align, prot, 0);
 	if (!b) {
 		pr_err("Compaction triggered!\n");
+		h->compact_count_fast++;
 		nvmap_heap_compact(h, len, true);
 		b = do_heap_alloc(h, len, align, prot, 0);
 		if (!b) {
 			pr_err("Full compaction triggered!\n");
+			h->compact_count_full++;
 			nvmap_heap_compact(h, len, false);
 			b = do_heap_alloc(h, len, align, prot, 0);
 		}
@@ -886,6 +1542,10 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 		b->handle = handle;
 		handle->carveout = b;
 	}
+	heap_record_lat(&h->alloc_lat,
+			ktime_to_ns(ktime_sub(ktime_get(), start)));
+	/* after compaction, or a claim which failed half way */
+	heap_cma_release_idle(h);
 	mutex_unlock(&h->lock);
 	return b;
 }
@@ -917,6 +1577,10 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 		lb = container_of(b, struct list_block, block);
 		nvmap_flush_heap_block(NULL, b, lb->size, lb->mem_prot);
 		do_heap_free(b);
+		heap_cma_release_idle(h);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+		heap_schedule_compaction(h);
+#endif
 	}
 
 	if (bh) {
@@ -936,6 +1600,10 @@ static void heap_release(struct device *heap)
 /* nvmap_heap_create: create a heap object of len bytes, starting from
  * address base.
  *
+ * if movable is set, the range was reserved without being removed from
+ * the memory map, and is lent to the page allocator while no allocation
+ * needs it (requires CONFIG_NVMAP_CARVEOUT_CMA).
+ *
  * if buddy_size is >= NVMAP_HEAP_MIN_BUDDY_SIZE, then allocations <= 1/2
  * of the buddy heap size will use a buddy sub-allocator, where each buddy
  * heap is buddy_size bytes (should be a power of 2). all other allocations
@@ -943,7 +1611,8 @@ static void heap_release(struct device *heap)
  */
 struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 				     phys_addr_t base, size_t len,
-				     size_t buddy_size, void *arg)
+				     size_t buddy_size, bool movable,
+				     void *arg)
 {
 	struct nvmap_heap *h = NULL;
 	struct list_block *l = NULL;
@@ -1007,16 +1676,22 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 	h->buddy_heap_size = buddy_size;
 	if (buddy_size)
 		h->min_buddy_shift = ilog2(buddy_size / MAX_BUDDY_NR);
-	INIT_LIST_HEAD(&h->free_list);
+	h->free_tree = RB_ROOT;
 	INIT_LIST_HEAD(&h->buddy_list);
 	INIT_LIST_HEAD(&h->all_list);
 	mutex_init(&h->lock);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	INIT_DELAYED_WORK(&h->compact_work, nvmap_heap_compact_work);
+	atomic_set(&h->alloc_pending, 0);
+#endif
+	if (movable)
+		heap_cma_init(h, base, len);
 	l->block.base = base;
 	l->block.type = BLOCK_EMPTY;
 	l->size = len;
 	l->orig_addr = base;
-	list_add_tail(&l->free_list, &h->free_list);
 	list_add_tail(&l->all_list, &h->all_list);
+	free_tree_insert(h, l);
 
 	inner_flush_cache_all();
 	outer_flush_range(base, base + len);
@@ -1051,6 +1726,10 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 	sysfs_remove_group(&heap->dev.kobj, &heap_stat_attr_group);
 	device_unregister(&heap->dev);
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	cancel_delayed_work_sync(&heap->compact_work);
+#endif
+
 	while (!list_empty(&heap->buddy_list)) {
 		struct buddy_heap *b;
 		b = list_first_entry(&heap->buddy_list, struct buddy_heap,
@@ -1069,6 +1748,10 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 		kmem_cache_free(block_cache, l);
 	}
 
+#ifdef CONFIG_NVMAP_CARVEOUT_CMA
+	kfree(heap->cma_users);
+	kfree(heap->cma_claimed);
+#endif
 	kfree(heap);
 }
 
@@ -23,7 +23,11 @@
 #include <linux/dma-mapping.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/syscalls.h>
 #include <linux/uaccess.h>
 #include <linux/nvmap.h>
 
@@ -158,6 +162,37 @@ int nvmap_ioctl_getid(struct file *filp, void __user *arg)
 	return copy_to_user(arg, &op, sizeof(op)) ? -EFAULT : 0;
 }
 
+int nvmap_ioctl_share(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_create_handle op;
+	struct nvmap_handle *h;
+	int fd;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	if (!op.handle)
+		return -EINVAL;
+
+	h = nvmap_get_handle_id(client, op.handle);
+	if (!h)
+		return -EPERM;
+
+	fd = nvmap_handle_share_fd(h);
+	nvmap_handle_put(h);
+	if (fd < 0)
+		return fd;
+
+	op.fd = fd;
+	if (copy_to_user(arg, &op, sizeof(op))) {
+		sys_close(fd);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
 int nvmap_ioctl_alloc(struct file *filp, void __user *arg)
 {
 	struct nvmap_alloc_handle op;
@@ -202,6 +237,8 @@ int nvmap_ioctl_create(struct file *filp, unsigned int cmd, void __user *arg)
 			ref->handle->orig_size = op.size;
 	} else if (cmd == NVMAP_IOC_FROM_ID) {
 		ref = nvmap_duplicate_handle_id(client, op.id);
+	} else if (cmd == NVMAP_IOC_FROM_FD) {
+		ref = nvmap_duplicate_handle_fd(client, op.fd);
 	} else {
 		return -EINVAL;
 	}
@@ -603,53 +640,36 @@ out:
 	return ret;
 }
 
-static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
-		       unsigned long start, unsigned long end, unsigned int op)
+/* maintains [start, end) of the handle by MVA, in the inner (L1) and/or
+ * outer (L2) cache. the caller must hold a reference on the handle, and
+ * must have checked that the range is inside the handle. */
+static int range_cache_maint(struct nvmap_client *client,
+	struct nvmap_handle *h, unsigned long start, unsigned long end,
+	unsigned int op, bool inner, bool outer)
 {
 	pgprot_t prot;
 	pte_t **pte = NULL;
-	unsigned long kaddr;
+	unsigned long kaddr = 0;
 	unsigned long loop;
-	int err = 0;
-
-	h = nvmap_handle_get(h);
-	if (!h)
-		return -EFAULT;
-
-	if (!h->alloc) {
-		err = -EFAULT;
-		goto out;
-	}
-
-	trace_cache_maint(client, h, start, end, op);
-	wmb();
-	if (h->flags == NVMAP_HANDLE_UNCACHEABLE ||
-	    h->flags == NVMAP_HANDLE_WRITE_COMBINE || start == end)
-		goto out;
 
-	if (fast_cache_maint(client, h, start, end, op))
-		goto out;
+	if (h->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+		outer = false;
+	if (!inner && !outer)
+		return 0;
 
 	prot = nvmap_pgprot(h, pgprot_kernel);
-	pte = nvmap_alloc_pte(client->dev, (void **)&kaddr);
-	if (IS_ERR(pte)) {
-		err = PTR_ERR(pte);
-		pte = NULL;
-		goto out;
+	if (inner) {
+		pte = nvmap_alloc_pte(client->dev, (void **)&kaddr);
+		if (IS_ERR(pte))
+			return PTR_ERR(pte);
 	}
 
 	if (h->heap_pgalloc) {
-		heap_page_cache_maint(client, h, start, end, op, true,
-			(h->flags == NVMAP_HANDLE_INNER_CACHEABLE) ? false : true,
+		heap_page_cache_maint(client, h, start, end, op, inner, outer,
 			pte, kaddr, prot);
 		goto out;
 	}
 
-	if (start > h->size || end > h->size) {
-		nvmap_warn(client, "cache maintenance outside handle\n");
-		return -EINVAL;
-	}
-
 	/* lock carveout from relocation by mapcount */
 	nvmap_usecount_inc(h);
 
@@ -658,7 +678,7 @@ static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 
 	loop = start;
 
-	while (loop < end) {
+	while (inner && loop < end) {
 		unsigned long next = (loop + PAGE_SIZE) & PAGE_MASK;
 		void *base = (void *)kaddr + (loop & ~PAGE_MASK);
 		next = min(next, end);
@@ -671,7 +691,7 @@ static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 		loop = next;
 	}
 
-	if (h->flags != NVMAP_HANDLE_INNER_CACHEABLE)
+	if (outer)
 		outer_cache_maint(op, start, end - start);
 
 	/* unlock carveout */
@@ -680,10 +700,236 @@ static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
 out:
 	if (pte)
 		nvmap_free_pte(client->dev, pte);
+	return 0;
+}
+
+static int cache_maint(struct nvmap_client *client, struct nvmap_handle *h,
+		       unsigned long start, unsigned long end, unsigned int op)
+{
+	int err = 0;
+
+	h = nvmap_handle_get(h);
+	if (!h)
+		return -EFAULT;
+
+	if (!h->alloc) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	trace_cache_maint(client, h, start, end, op);
+	wmb();
+	if (h->flags == NVMAP_HANDLE_UNCACHEABLE ||
+	    h->flags == NVMAP_HANDLE_WRITE_COMBINE || start == end)
+		goto out;
+
+	if (fast_cache_maint(client, h, start, end, op))
+		goto out;
+
+	if (!h->heap_pgalloc && (start > h->size || end > h->size)) {
+		nvmap_warn(client, "cache maintenance outside handle\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = range_cache_maint(client, h, start, end, op, true, true);
+
+out:
 	nvmap_handle_put(h);
 	return err;
 }
 
+static DEFINE_SPINLOCK(cache_list_lock);
+
+static struct {
+	unsigned long lists;
+	unsigned long entries;
+	unsigned long inner_full;	/* whole-L1 writebacks */
+	unsigned long inner_range;	/* entries maintained in L1 by MVA */
+	unsigned long outer_full;	/* whole-L2 writebacks */
+	unsigned long outer_range;	/* entries maintained in L2 by PA */
+	u64 time_us;
+} cache_list_stats;
+
+static int cache_list_stats_get(char *buff, const struct kernel_param *kp)
+{
+	int len;
+
+	spin_lock(&cache_list_lock);
+	len = scnprintf(buff, PAGE_SIZE, "lists=%lu entries=%lu "
+		"inner_full=%lu inner_range=%lu outer_full=%lu "
+		"outer_range=%lu time_us=%llu\n",
+		cache_list_stats.lists, cache_list_stats.entries,
+		cache_list_stats.inner_full, cache_list_stats.inner_range,
+		cache_list_stats.outer_full, cache_list_stats.outer_range,
+		cache_list_stats.time_us);
+	spin_unlock(&cache_list_lock);
+	return len;
+}
+
+static struct kernel_param_ops cache_list_stats_ops = {
+	.get = cache_list_stats_get,
+};
+
+module_param_cb(cache_list_stats, &cache_list_stats_ops, NULL, 0444);
+
+/* writebacks of the whole list are summed up per cache level: once they
+ * reach the set/way threshold, that level is cleaned (or flushed, if any
+ * entry asks for it) once for the entire list rather than line by line
+ * for each entry. invalidations are always done by range, since
+ * invalidating the whole cache would discard unrelated dirty lines. */
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_cache_op_list list;
+	struct nvmap_cache_op_entry *ops = NULL;
+	struct nvmap_handle **h = NULL;
+	u64 inner_bytes = 0;
+	u64 outer_bytes = 0;
+	bool flush = false;
+	bool inner_all = false;
+	bool outer_all = false;
+	unsigned int inner_range = 0;
+	unsigned int outer_range = 0;
+	unsigned int i;
+	ktime_t start;
+	s64 elapsed;
+	int err = 0;
+
+	if (copy_from_user(&list, arg, sizeof(list)))
+		return -EFAULT;
+
+	if (!list.nr)
+		return 0;
+
+	if (list.nr > NVMAP_CACHE_OP_LIST_MAX)
+		return -E2BIG;
+
+	ops = kmalloc(list.nr * sizeof(*ops), GFP_KERNEL);
+	h = kzalloc(list.nr * sizeof(*h), GFP_KERNEL);
+	if (!ops || !h) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(ops, (void __user *)list.ops,
+			   list.nr * sizeof(*ops))) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < list.nr; i++) {
+		struct nvmap_cache_op_entry *e = &ops[i];
+
+		if (!e->handle || e->op < NVMAP_CACHE_OP_WB ||
+		    e->op > NVMAP_CACHE_OP_WB_INV) {
+			err = -EINVAL;
+			goto out;
+		}
+
+		h[i] = nvmap_get_handle_id(client, e->handle);
+		if (!h[i]) {
+			err = -EPERM;
+			goto out;
+		}
+
+		if (!h[i]->alloc) {
+			err = -EFAULT;
+			goto out;
+		}
+
+		if (e->offset > h[i]->size ||
+		    e->len > h[i]->size - e->offset) {
+			nvmap_warn(client, "cache maintenance outside handle\n");
+			err = -EINVAL;
+			goto out;
+		}
+
+		trace_cache_maint(client, h[i], e->offset,
+				  e->offset + e->len, e->op);
+
+		if (h[i]->flags == NVMAP_HANDLE_UNCACHEABLE ||
+		    h[i]->flags == NVMAP_HANDLE_WRITE_COMBINE) {
+			e->len = 0;
+			continue;
+		}
+
+		if (e->op == NVMAP_CACHE_OP_INV)
+			continue;
+
+		if (e->op == NVMAP_CACHE_OP_WB_INV)
+			flush = true;
+		inner_bytes += e->len;
+		if (h[i]->flags != NVMAP_HANDLE_INNER_CACHEABLE)
+			outer_bytes += e->len;
+	}
+
+#if defined(CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS)
+	inner_all = inner_bytes >= FLUSH_CLEAN_BY_SET_WAY_THRESHOLD_INNER;
+#endif
+#if defined(CONFIG_NVMAP_OUTER_CACHE_MAINT_BY_SET_WAYS)
+	outer_all = outer_bytes >= FLUSH_CLEAN_BY_SET_WAY_THRESHOLD_OUTER;
+#endif
+
+	start = ktime_get();
+	wmb();
+
+	if (inner_all) {
+		if (flush)
+			inner_flush_cache_all();
+		else
+			inner_clean_cache_all();
+	}
+
+	for (i = 0; i < list.nr && !err; i++) {
+		struct nvmap_cache_op_entry *e = &ops[i];
+		bool inner, outer;
+
+		if (!e->len)
+			continue;
+
+		inner = e->op == NVMAP_CACHE_OP_INV || !inner_all;
+		outer = (e->op == NVMAP_CACHE_OP_INV || !outer_all) &&
+			h[i]->flags != NVMAP_HANDLE_INNER_CACHEABLE;
+
+		err = range_cache_maint(client, h[i], e->offset,
+					e->offset + e->len, e->op,
+					inner, outer);
+		inner_range += inner;
+		outer_range += outer;
+	}
+
+	/* the outer cache goes last, after all inner lines were written */
+	if (outer_all) {
+		if (flush)
+			outer_flush_all();
+		else
+			outer_clean_all();
+	}
+
+	elapsed = ktime_us_delta(ktime_get(), start);
+
+	spin_lock(&cache_list_lock);
+	cache_list_stats.lists++;
+	cache_list_stats.entries += list.nr;
+	cache_list_stats.inner_full += inner_all;
+	cache_list_stats.inner_range += inner_range;
+	cache_list_stats.outer_full += outer_all;
+	cache_list_stats.outer_range += outer_range;
+	cache_list_stats.time_us += elapsed;
+	spin_unlock(&cache_list_lock);
+
+out:
+	if (h) {
+		for (i = 0; i < list.nr; i++)
+			if (h[i])
+				nvmap_handle_put(h[i]);
+	}
+	kfree(h);
+	kfree(ops);
+	return err;
+}
+
 static int rw_handle_page(struct nvmap_handle *h, int is_read,
 			  phys_addr_t start, unsigned long rw_addr,
 			  unsigned long bytes, unsigned long kaddr, pte_t *pte)
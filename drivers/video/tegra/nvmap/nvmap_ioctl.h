@@ -49,6 +49,7 @@ struct nvmap_create_handle {
 		__u32 key;	/* ClaimPreservedHandle */
 		__u32 id;	/* FromId */
 		__u32 size;	/* CreateHandle */
+		__s32 fd;	/* Share, FromFd */
 	};
 	__u32 handle;
 };
@@ -97,6 +98,20 @@ struct nvmap_cache_op {
 	__s32 op;
 };
 
+struct nvmap_cache_op_entry {
+	__u32 handle;
+	__u32 offset;		/* offset into hmem */
+	__u32 len;
+	__s32 op;
+};
+
+struct nvmap_cache_op_list {
+	unsigned long ops;	/* array of struct nvmap_cache_op_entry */
+	__u32 nr;		/* number of entries in ops */
+};
+
+#define NVMAP_CACHE_OP_LIST_MAX	1024
+
 #define NVMAP_IOC_MAGIC 'N'
 
 /* Creates a new memory handle. On input, the argument is the size of the new
@@ -136,7 +151,18 @@ struct nvmap_cache_op {
  * reference to the same handle */
 #define NVMAP_IOC_GET_ID  _IOWR(NVMAP_IOC_MAGIC, 13, struct nvmap_create_handle)
 
-#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_GET_ID))
+/* Performs cache maintenance on a list of (handle, offset, len, op)
+ * ranges in one call. depending on the total size, writebacks are done
+ * by range or for the whole cache once for the entire list. */
+#define NVMAP_IOC_CACHE_LIST _IOW(NVMAP_IOC_MAGIC, 14, struct nvmap_cache_op_list)
+
+/* Returns a file descriptor holding a reference to an allocated handle.
+ * the fd can be passed to another process or driver and turned back into
+ * a handle with NVMAP_IOC_FROM_FD, without making the handle global */
+#define NVMAP_IOC_SHARE   _IOWR(NVMAP_IOC_MAGIC, 15, struct nvmap_create_handle)
+#define NVMAP_IOC_FROM_FD _IOWR(NVMAP_IOC_MAGIC, 16, struct nvmap_create_handle)
+
+#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_FROM_FD))
 
 #ifdef  __KERNEL__
 int nvmap_ioctl_pinop(struct file *filp, bool is_pin, void __user *arg);
@@ -145,6 +171,8 @@ int nvmap_ioctl_get_param(struct file *filp, void __user* arg);
 
 int nvmap_ioctl_getid(struct file *filp, void __user *arg);
 
+int nvmap_ioctl_share(struct file *filp, void __user *arg);
+
 int nvmap_ioctl_alloc(struct file *filp, void __user *arg);
 
 int nvmap_ioctl_free(struct file *filp, unsigned long arg);
@@ -155,6 +183,8 @@ int nvmap_map_into_caller_ptr(struct file *filp, void __user *arg);
 
 int nvmap_ioctl_cache_maint(struct file *filp, void __user *arg);
 
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg);
+
 int nvmap_ioctl_rw_handle(struct file *filp, int is_read, void __user* arg);
 #endif
 
@@ -31,30 +31,19 @@
 #include "nvmap_mru.h"
 
 /* if IOVMM reclamation is enabled (CONFIG_NVMAP_RECLAIM_UNPINNED_VM),
- * unpinned handles are placed onto a most-recently-used eviction list;
- * multiple lists are maintained, segmented by size (sizes were chosen to
- * roughly correspond with common sizes for graphics surfaces).
+ * unpinned handles keep their IOVMM area and are placed at the tail of a
+ * least-recently-used eviction list.
  *
- * if a handle is located on the MRU list, then the code below may
+ * if a handle is located on the LRU list, then the code below may
  * steal its IOVMM area at any time to satisfy a pin operation if no
- * free IOVMM space is available
+ * free IOVMM space is available. every pin which finds the area still
+ * mapped ages the handle up (to NVMAP_LRU_MAX_AGE); the eviction scan
+ * starts at the head of the list and gives handles with a non-zero age
+ * another pass at the tail, one age step at a time, so that surfaces which
+ * are pinned every frame survive over large ones which are rarely used.
  */
 
-static const size_t mru_cutoff[] = {
-	262144, 393216, 786432, 1048576, 1572864
-};
-
-static inline struct list_head *mru_list(struct nvmap_share *share, size_t size)
-{
-	unsigned int i;
-
-	BUG_ON(!share->mru_lists);
-	for (i = 0; i < ARRAY_SIZE(mru_cutoff); i++)
-		if (size <= mru_cutoff[i])
-			break;
-
-	return &share->mru_lists[i];
-}
+#define NVMAP_LRU_MAX_AGE	3
 
 size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
 {
@@ -65,8 +54,7 @@ size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
 /*  nvmap_mru_vma_lock should be acquired by the caller before calling this */
 void nvmap_mru_insert_locked(struct nvmap_share *share, struct nvmap_handle *h)
 {
-	size_t len = h->pgalloc.area->iovm_length;
-	list_add(&h->pgalloc.mru_list, mru_list(share, len));
+	list_add_tail(&h->pgalloc.mru_list, &share->lru_list);
 }
 
 void nvmap_mru_remove(struct nvmap_share *s, struct nvmap_handle *h)
@@ -78,25 +66,52 @@ void nvmap_mru_remove(struct nvmap_share *s, struct nvmap_handle *h)
 	INIT_LIST_HEAD(&h->pgalloc.mru_list);
 }
 
+/* takes the coldest handle off the LRU list, or returns NULL if the list
+ * is empty. handles which were pinned since the scan last passed them are
+ * aged down and rotated to the tail instead. */
+static struct nvmap_handle *lru_evict_locked(struct nvmap_share *share)
+{
+	struct nvmap_handle *h;
+
+	while (!list_empty(&share->lru_list)) {
+		h = list_first_entry(&share->lru_list, struct nvmap_handle,
+				     pgalloc.mru_list);
+		if (!h->pgalloc.lru_age) {
+			list_del_init(&h->pgalloc.mru_list);
+			return h;
+		}
+		h->pgalloc.lru_age--;
+		list_move_tail(&h->pgalloc.mru_list, &share->lru_list);
+	}
+	return NULL;
+}
+
+/* an evicted area is handed over as is only if it is a close fit, so that
+ * a small handle doesn't pin down a large chunk of the aperture */
+static bool lru_area_reusable(struct tegra_iovmm_area *vm,
+			      struct nvmap_handle *h, pgprot_t prot)
+{
+	return vm->iovm_length >= h->size &&
+		vm->iovm_length < 2 * h->size &&
+		IS_ALIGNED(vm->iovm_start, nvmap_iovm_align(h)) &&
+		pgprot_val(vm->pgprot) == pgprot_val(prot);
+}
+
 /* returns a tegra_iovmm_area for a handle. if the handle already has
- * an iovmm_area allocated, the handle is simply removed from its MRU list
- * and the existing iovmm_area is returned.
+ * an iovmm_area allocated, the handle is simply removed from the LRU list,
+ * aged up and the existing iovmm_area is returned.
  *
  * if no existing allocation exists, try to allocate a new IOVMM area.
  *
- * if a new area can not be allocated, try to re-use the most-recently-unpinned
- * handle's allocation.
- *
- * and if that fails, iteratively evict handles from the MRU lists and free
- * their allocations, until the new allocation succeeds.
+ * if a new area can not be allocated, iteratively evict the coldest
+ * handles from the LRU list, re-using the first evicted area which fits
+ * the handle or freeing them until the new allocation succeeds.
  */
 struct tegra_iovmm_area *nvmap_handle_iovmm_locked(struct nvmap_client *c,
 					    struct nvmap_handle *h)
 {
-	struct list_head *mru;
 	struct nvmap_handle *evict = NULL;
 	struct tegra_iovmm_area *vm = NULL;
-	unsigned int i, idx;
 	pgprot_t prot;
 
 	BUG_ON(!h || !c || !c->share);
@@ -107,11 +122,16 @@ struct tegra_iovmm_area *nvmap_handle_iovmm_locked(struct nvmap_client *c,
 		BUG_ON(list_empty(&h->pgalloc.mru_list));
 		list_del(&h->pgalloc.mru_list);
 		INIT_LIST_HEAD(&h->pgalloc.mru_list);
+		if (h->pgalloc.lru_age < NVMAP_LRU_MAX_AGE)
+			h->pgalloc.lru_age++;
 		return h->pgalloc.area;
 	}
 
+	c->iovm_remaps++;
+	h->pgalloc.lru_age = 0;
+
 	vm = tegra_iovmm_create_vm(c->share->iovmm, NULL,
-			h->size, h->align, prot,
+			h->size, nvmap_iovm_align(h), prot,
 			h->pgalloc.iovm_addr);
 
 	if (vm) {
@@ -121,67 +141,35 @@ struct tegra_iovmm_area *nvmap_handle_iovmm_locked(struct nvmap_client *c,
 	/* if client is looking for specific iovm address, return from here. */
 	if ((vm == NULL) && (h->pgalloc.iovm_addr != 0))
 		return NULL;
-	/* attempt to re-use the most recently unpinned IOVMM area in the
-	 * same size bin as the current handle. If that fails, iteratively
-	 * evict handles (starting from the current bin) until an allocation
-	 * succeeds or no more areas can be evicted */
-	mru = mru_list(c->share, h->size);
-	if (!list_empty(mru))
-		evict = list_first_entry(mru, struct nvmap_handle,
-					 pgalloc.mru_list);
-
-	if (evict && evict->pgalloc.area->iovm_length >= h->size) {
-		list_del(&evict->pgalloc.mru_list);
-		vm = evict->pgalloc.area;
-		evict->pgalloc.area = NULL;
-		INIT_LIST_HEAD(&evict->pgalloc.mru_list);
-		return vm;
-	}
 
-	idx = mru - c->share->mru_lists;
-
-	for (i = 0; i < c->share->nr_mru && !vm; i++, idx++) {
-		if (idx >= c->share->nr_mru)
-			idx = 0;
-		mru = &c->share->mru_lists[idx];
-		while (!list_empty(mru) && !vm) {
-			evict = list_first_entry(mru, struct nvmap_handle,
-						 pgalloc.mru_list);
-
-			BUG_ON(atomic_read(&evict->pin) != 0);
-			BUG_ON(!evict->pgalloc.area);
-			list_del(&evict->pgalloc.mru_list);
-			INIT_LIST_HEAD(&evict->pgalloc.mru_list);
-			tegra_iovmm_free_vm(evict->pgalloc.area);
+	while (!vm && (evict = lru_evict_locked(c->share))) {
+		BUG_ON(atomic_read(&evict->pin) != 0);
+		BUG_ON(!evict->pgalloc.area);
+		c->iovm_evictions++;
+
+		if (lru_area_reusable(evict->pgalloc.area, h, prot)) {
+			vm = evict->pgalloc.area;
 			evict->pgalloc.area = NULL;
-			vm = tegra_iovmm_create_vm(c->share->iovmm,
-					NULL, h->size, h->align,
-					prot, h->pgalloc.iovm_addr);
+			break;
 		}
+
+		tegra_iovmm_free_vm(evict->pgalloc.area);
+		evict->pgalloc.area = NULL;
+		vm = tegra_iovmm_create_vm(c->share->iovmm,
+				NULL, h->size, nvmap_iovm_align(h),
+				prot, h->pgalloc.iovm_addr);
 	}
 	return vm;
 }
 
 int nvmap_mru_init(struct nvmap_share *share)
 {
-	int i;
 	mutex_init(&share->mru_lock);
-	share->nr_mru = ARRAY_SIZE(mru_cutoff) + 1;
-
-	share->mru_lists = kzalloc(sizeof(struct list_head) * share->nr_mru,
-				   GFP_KERNEL);
-
-	if (!share->mru_lists)
-		return -ENOMEM;
-
-	for (i = 0; i < share->nr_mru; i++)
-		INIT_LIST_HEAD(&share->mru_lists[i]);
-
+	INIT_LIST_HEAD(&share->lru_list);
 	return 0;
 }
 
 void nvmap_mru_destroy(struct nvmap_share *share)
 {
-	kfree(share->mru_lists);
-	share->mru_lists = NULL;
+	INIT_LIST_HEAD(&share->lru_list);
 }
@@ -970,6 +970,7 @@ static int de_thread(struct task_struct *tsk)
 			__wake_up_parent(leader, leader->parent);
 		write_unlock_irq(&tasklist_lock);
 
+		lowmem_task_update(tsk);
 		release_task(leader);
 	}
 
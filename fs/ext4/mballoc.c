@@ -2486,6 +2486,16 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		sbi->s_mb_group_prealloc = roundup(
 			sbi->s_mb_group_prealloc, sbi->s_stripe);
 	}
+	/*
+	 * On flash the stripe is the erase block.  Pack files smaller
+	 * than a quarter of it into the aligned group preallocations, so
+	 * small files and appends fill erase blocks instead of each
+	 * dirtying another one.
+	 */
+	if (test_opt2(sb, FLASH_ALIGN) && sbi->s_stripe > 1)
+		sbi->s_mb_stream_request = max_t(unsigned int,
+						 sbi->s_mb_stream_request,
+						 sbi->s_stripe / 4);
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -1105,6 +1105,8 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_puts(seq, ",nomblk_io_submit");
 	if (sbi->s_stripe)
 		seq_printf(seq, ",stripe=%lu", sbi->s_stripe);
+	if (test_opt2(sb, FLASH_ALIGN))
+		seq_puts(seq, ",flash_align");
 	/*
 	 * journal mode get enabled in different ways
 	 * So just print the value even if we didn't specify it
@@ -1319,6 +1321,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_flash_align, Opt_noflash_align,
 };
 
 static const match_table_t tokens = {
@@ -1394,6 +1397,8 @@ static const match_table_t tokens = {
 	{Opt_init_itable, "init_itable=%u"},
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
+	{Opt_flash_align, "flash_align"},
+	{Opt_noflash_align, "noflash_align"},
 	{Opt_err, NULL},
 };
 
@@ -1884,6 +1889,12 @@ set_qf_format:
 		case Opt_noinit_itable:
 			clear_opt(sb, INIT_INODE_TABLE);
 			break;
+		case Opt_flash_align:
+			set_opt2(sb, FLASH_ALIGN);
+			break;
+		case Opt_noflash_align:
+			clear_opt2(sb, FLASH_ALIGN);
+			break;
 		default:
 			ext4_msg(sb, KERN_ERR,
 			       "Unrecognized mount option \"%s\" "
@@ -2424,6 +2435,29 @@ static unsigned long ext4_get_stripe_size(struct ext4_sb_info *sbi)
 	return ret;
 }
 
+/*
+ * ext4_get_flash_stripe: Get the erase block size of a flash device in
+ * file system blocks, as reported by its driver in the optimal I/O size
+ * or else the discard granularity.  Returns 0 if there is none.
+ */
+static unsigned long ext4_get_flash_stripe(struct super_block *sb)
+{
+	struct block_device *bdev = sb->s_bdev;
+	unsigned int erase = bdev_io_opt(bdev);
+
+	if (!erase)
+		erase = bdev_get_queue(bdev)->limits.discard_granularity;
+	if (erase <= sb->s_blocksize) {
+		ext4_msg(sb, KERN_WARNING, "flash_align: device reports "
+			 "no erase block size");
+		return 0;
+	}
+	if ((get_start_sect(bdev) << 9) % erase)
+		ext4_msg(sb, KERN_WARNING, "flash_align: partition does not "
+			 "start on a %u byte erase block", erase);
+	return erase >> sb->s_blocksize_bits;
+}
+
 /* sysfs supprt */
 
 struct ext4_attr {
@@ -3500,6 +3534,11 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	if (!sbi->s_stripe && test_opt2(sb, FLASH_ALIGN)) {
+		sbi->s_stripe = ext4_get_flash_stripe(sb);
+		if (sbi->s_stripe > sbi->s_blocks_per_group)
+			sbi->s_stripe = 0;
+	}
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
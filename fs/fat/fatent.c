@@ -7,6 +7,7 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -452,6 +453,37 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/*
+ * The free cluster bitmap mirrors FAT_ENT_FREE entries of the FAT, so
+ * fat_alloc_clusters() can jump straight to the next free cluster instead
+ * of reading every FAT block in between.  It is built in the background
+ * after mount; until free_bitmap_end reaches max_cluster only the part
+ * already scanned is kept up to date, and allocation does not use it.
+ * Everything is protected by lock_fat().
+ */
+
+/* Don't spend more than 2MB of vmalloc space on one filesystem */
+#define FAT_FREE_BITMAP_MAX	(1UL << 24)
+
+static inline int fat_free_bitmap_ready(struct msdos_sb_info *sbi)
+{
+	return sbi->free_bitmap && sbi->free_bitmap_end == sbi->max_cluster;
+}
+
+static inline void fat_free_bitmap_set(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->free_bitmap && entry < sbi->free_bitmap_end &&
+	    !__test_and_set_bit(entry, sbi->free_bitmap))
+		sbi->free_bitmap_count++;
+}
+
+static inline void fat_free_bitmap_clear(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->free_bitmap && entry < sbi->free_bitmap_end &&
+	    __test_and_clear_bit(entry, sbi->free_bitmap))
+		sbi->free_bitmap_count--;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -478,6 +510,15 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
 			fatent.entry = FAT_START_ENT;
+		if (fat_free_bitmap_ready(sbi)) {
+			/* Skip the FAT blocks without a free entry */
+			int next = find_next_bit(sbi->free_bitmap,
+						 sbi->max_cluster, fatent.entry);
+			count += next - fatent.entry;
+			fatent.entry = next;
+			if (next >= sbi->max_cluster)
+				continue;
+		}
 		fatent_set_entry(&fatent, fatent.entry);
 		err = fat_ent_read_block(sb, &fatent);
 		if (err)
@@ -495,6 +536,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
 
+				fat_free_bitmap_clear(sbi, entry);
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
 					sbi->free_clusters--;
@@ -510,6 +552,9 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 				 * so we can still use the prev_ent.
 				 */
 				prev_ent = fatent;
+			} else {
+				/* Drop a stale bit, so it isn't looked at again */
+				fat_free_bitmap_clear(sbi, fatent.entry);
 			}
 			count++;
 			if (count == sbi->max_cluster)
@@ -585,6 +630,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_bitmap_set(sbi, fatent.entry);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -647,6 +693,9 @@ int fat_count_free_clusters(struct super_block *sb)
 	unsigned long reada_blocks, reada_mask, cur_block;
 	int err = 0, free;
 
+	/* A bitmap build in progress ends up with the same count */
+	flush_work(&sbi->free_bitmap_work);
+
 	lock_fat(sbi);
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
@@ -683,3 +732,88 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+static void fat_free_bitmap_build(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi =
+		container_of(work, struct msdos_sb_info, free_bitmap_work);
+	struct super_block *sb = sbi->fat_inode->i_sb;
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long *bitmap;
+	unsigned long reada_blocks, reada_mask, cur_block;
+
+	bitmap = vzalloc(BITS_TO_LONGS(sbi->max_cluster) * sizeof(long));
+	if (!bitmap)
+		return;
+
+	lock_fat(sbi);
+	sbi->free_bitmap = bitmap;
+	sbi->free_bitmap_end = FAT_START_ENT;
+	sbi->free_bitmap_count = 0;
+	unlock_fat(sbi);
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster) {
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		/* One FAT block at a time, allocations go on meanwhile */
+		lock_fat(sbi);
+		if (sbi->free_bitmap_abort || fat_ent_read_block(sb, &fatent))
+			goto out_free;
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
+				__set_bit(fatent.entry, bitmap);
+				sbi->free_bitmap_count++;
+			}
+		} while (fat_ent_next(sbi, &fatent));
+		sbi->free_bitmap_end = min_t(unsigned long, fatent.entry,
+					     sbi->max_cluster);
+		if (sbi->free_bitmap_end == sbi->max_cluster) {
+			sbi->free_clusters = sbi->free_bitmap_count;
+			sbi->free_clus_valid = 1;
+			sb->s_dirt = 1;
+		}
+		unlock_fat(sbi);
+		cond_resched();
+	}
+	fatent_brelse(&fatent);
+	return;
+
+out_free:
+	sbi->free_bitmap = NULL;
+	sbi->free_bitmap_end = 0;
+	unlock_fat(sbi);
+	fatent_brelse(&fatent);
+	vfree(bitmap);
+}
+
+void fat_free_bitmap_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	INIT_WORK(&sbi->free_bitmap_work, fat_free_bitmap_build);
+	if (sbi->max_cluster <= FAT_FREE_BITMAP_MAX)
+		queue_work(system_long_wq, &sbi->free_bitmap_work);
+}
+
+void fat_free_bitmap_destroy(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	lock_fat(sbi);
+	sbi->free_bitmap_abort = 1;
+	unlock_fat(sbi);
+	cancel_work_sync(&sbi->free_bitmap_work);
+	vfree(sbi->free_bitmap);
+	sbi->free_bitmap = NULL;
+}
@@ -61,6 +61,26 @@ static ssize_t fuse_conn_waiting_read(struct file *file, char __user *buf,
 	return simple_read_from_buffer(buf, len, ppos, tmp, size);
 }
 
+static ssize_t fuse_conn_copy_stats_read(struct file *file, char __user *buf,
+					 size_t len, loff_t *ppos)
+{
+	char tmp[128];
+	size_t size;
+	struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	size = sprintf(tmp, "copied %lu\nspliced %lu\nmoved %lu\n"
+		       "move_fallback %lu\n",
+		       atomic_long_read(&fc->pages_copied),
+		       atomic_long_read(&fc->pages_spliced),
+		       atomic_long_read(&fc->pages_moved),
+		       atomic_long_read(&fc->move_fallbacks));
+	fuse_conn_put(fc);
+
+	return simple_read_from_buffer(buf, len, ppos, tmp, size);
+}
+
 static ssize_t fuse_conn_limit_read(struct file *file, char __user *buf,
 				    size_t len, loff_t *ppos, unsigned val)
 {
@@ -188,6 +208,12 @@ static const struct file_operations fuse_ctl_waiting_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_ctl_copy_stats_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_copy_stats_read,
+	.llseek = no_llseek,
+};
+
 static const struct file_operations fuse_conn_max_background_ops = {
 	.open = nonseekable_open,
 	.read = fuse_conn_max_background_read,
@@ -262,6 +288,8 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 NULL, &fuse_ctl_waiting_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "abort", S_IFREG | 0200, 1,
 				 NULL, &fuse_ctl_abort_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "copy_stats", S_IFREG | 0400, 1,
+				 NULL, &fuse_ctl_copy_stats_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "max_background", S_IFREG | 0600,
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
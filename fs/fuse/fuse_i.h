@@ -23,8 +23,11 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Default max number of pages that can be used in a single read request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Maximum of max_pages received in init_out */
+#define FUSE_MAX_MAX_PAGES 256
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -33,7 +36,7 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
 
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
@@ -288,7 +291,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the 'pages' array */
+	unsigned max_pages;
+
+	/** inline page vector */
+	struct page *inline_pages[FUSE_DEFAULT_MAX_PAGES_PER_REQ];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -344,6 +353,9 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages that can be used in a single request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
@@ -478,9 +490,24 @@ struct fuse_conn {
 	/** Are BSD file locking primitives not implemented by fs? */
 	unsigned no_flock:1;
 
+	/** Use the page cache for buffered writes.  Only set in INIT */
+	unsigned writeback_cache:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
+	/** Request pages copied through a kernel buffer */
+	atomic_long_t pages_copied;
+
+	/** Request pages passed to a splice(2)ing daemon by reference */
+	atomic_long_t pages_spliced;
+
+	/** Reply pages stolen from the daemon's pipe into the page cache */
+	atomic_long_t pages_moved;
+
+	/** SPLICE_F_MOVE replies that had to be copied after all */
+	atomic_long_t move_fallbacks;
+
 	/** Negotiated minor version */
 	unsigned minor;
 
@@ -653,6 +680,13 @@ struct fuse_req *fuse_request_alloc(void);
 
 struct fuse_req *fuse_request_alloc_nofs(void);
 
+/**
+ * Allocate a request with room for npages pages
+ */
+struct fuse_req *fuse_request_alloc_pages(unsigned npages);
+
+struct fuse_req *fuse_request_alloc_pages_nofs(unsigned npages);
+
 /**
  * Free a request
  */
@@ -663,6 +697,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for npages pages, may fail with -ENOMEM
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
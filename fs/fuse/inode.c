@@ -47,6 +47,12 @@ MODULE_PARM_DESC(max_user_congthresh,
  "Global limit for the maximum congestion threshold an "
  "unprivileged user can set");
 
+static bool writeback_cache;
+module_param(writeback_cache, bool, 0644);
+MODULE_PARM_DESC(writeback_cache,
+ "Use writeback cache for connections initialized from now on, even if "
+ "the filesystem daemon does not ask for it");
+
 #define FUSE_SUPER_MAGIC 0x65735546
 
 #define FUSE_DEFAULT_BLKSIZE 512
@@ -182,7 +188,7 @@ void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 {
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_inode *fi = get_fuse_inode(inode);
-	loff_t oldsize;
+	loff_t oldsize, newsize;
 
 	spin_lock(&fc->lock);
 	if (attr_version != 0 && fi->attr_version > attr_version) {
@@ -193,11 +199,18 @@ void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 	fuse_change_attributes_common(inode, attr, attr_valid);
 
 	oldsize = inode->i_size;
-	i_size_write(inode, attr->size);
+	/*
+	 * With writeback cache the kernel owns i_size of regular files:
+	 * cached writes extend it before the daemon sees them, so the size
+	 * it reports may be stale.
+	 */
+	if (!fc->writeback_cache || !S_ISREG(inode->i_mode))
+		i_size_write(inode, attr->size);
+	newsize = inode->i_size;
 	spin_unlock(&fc->lock);
 
-	if (S_ISREG(inode->i_mode) && oldsize != attr->size) {
-		truncate_pagecache(inode, oldsize, attr->size);
+	if (S_ISREG(inode->i_mode) && oldsize != newsize) {
+		truncate_pagecache(inode, oldsize, newsize);
 		invalidate_inode_pages2(inode->i_mapping);
 	}
 }
@@ -534,6 +547,10 @@ void fuse_conn_init(struct fuse_conn *fc)
 	INIT_LIST_HEAD(&fc->entry);
 	fc->forget_list_tail = &fc->forget_list_head;
 	atomic_set(&fc->num_waiting, 0);
+	atomic_long_set(&fc->pages_copied, 0);
+	atomic_long_set(&fc->pages_spliced, 0);
+	atomic_long_set(&fc->pages_moved, 0);
+	atomic_long_set(&fc->move_fallbacks, 0);
 	fc->max_background = FUSE_DEFAULT_MAX_BACKGROUND;
 	fc->congestion_threshold = FUSE_DEFAULT_CONGESTION_THRESHOLD;
 	fc->khctr = 0;
@@ -541,6 +558,7 @@ void fuse_conn_init(struct fuse_conn *fc)
 	fc->reqctr = 0;
 	fc->blocked = 1;
 	fc->attr_version = 1;
+	fc->max_pages = FUSE_DEFAULT_MAX_PAGES_PER_REQ;
 	get_random_bytes(&fc->scramble_key, sizeof(fc->scramble_key));
 }
 EXPORT_SYMBOL_GPL(fuse_conn_init);
@@ -827,6 +845,14 @@ static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 				fc->big_writes = 1;
 			if (arg->flags & FUSE_DONT_MASK)
 				fc->dont_mask = 1;
+			if (arg->flags & FUSE_WRITEBACK_CACHE)
+				fc->writeback_cache = 1;
+			if (arg->flags & FUSE_MAX_PAGES) {
+				fc->max_pages = arg->max_pages ?:
+					arg->max_write >> PAGE_CACHE_SHIFT;
+				fc->max_pages = clamp_t(unsigned, fc->max_pages,
+					1, FUSE_MAX_MAX_PAGES);
+			}
 		} else {
 			ra_pages = fc->max_read / PAGE_CACHE_SIZE;
 			fc->no_lock = 1;
@@ -837,6 +863,8 @@ static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 		fc->minor = arg->minor;
 		fc->max_write = arg->minor < 5 ? 4096 : arg->max_write;
 		fc->max_write = max_t(unsigned, 4096, fc->max_write);
+		if (writeback_cache)
+			fc->writeback_cache = 1;
 		fc->conn_init = 1;
 	}
 	fc->blocked = 0;
@@ -852,7 +880,7 @@ static void fuse_send_init(struct fuse_conn *fc, struct fuse_req *req)
 	arg->max_readahead = fc->bdi.ra_pages * PAGE_CACHE_SIZE;
 	arg->flags |= FUSE_ASYNC_READ | FUSE_POSIX_LOCKS | FUSE_ATOMIC_O_TRUNC |
 		FUSE_EXPORT_SUPPORT | FUSE_BIG_WRITES | FUSE_DONT_MASK |
-		FUSE_FLOCK_LOCKS;
+		FUSE_FLOCK_LOCKS | FUSE_WRITEBACK_CACHE | FUSE_MAX_PAGES;
 	req->in.h.opcode = FUSE_INIT;
 	req->in.numargs = 1;
 	req->in.args[0].size = sizeof(*arg);
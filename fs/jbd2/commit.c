@@ -136,7 +136,17 @@ static int journal_submit_commit_record(journal_t *journal,
 	set_buffer_uptodate(bh);
 	bh->b_end_io = journal_end_buffer_io_sync;
 
-	if (journal->j_flags & JBD2_BARRIER &&
+	if (commit_transaction->t_fua_commit) {
+		/*
+		 * The log blocks may still be in flight, but they are FUA
+		 * writes and the checksum catches a commit block that got
+		 * ahead of them.  The flush only has to cover file data.
+		 */
+		if (journal->j_fs_dev == journal->j_dev)
+			ret = submit_bh(WRITE_SYNC | WRITE_FLUSH_FUA, bh);
+		else
+			ret = submit_bh(WRITE_SYNC | WRITE_FUA, bh);
+	} else if (journal->j_flags & JBD2_BARRIER &&
 	    !JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT))
 		ret = submit_bh(WRITE_SYNC | WRITE_FLUSH_FUA, bh);
@@ -302,6 +312,70 @@ static void write_tag_block(int tag_bytes, journal_block_tag_t *tag,
 		tag->t_blocknr_high = cpu_to_be32((block >> 31) >> 1);
 }
 
+/*
+ * Async commit normally submits the commit block without any ordering
+ * against file data and relies on a flush once everything completed.  On
+ * a device that implements FUA natively we can do better: write the log
+ * with FUA, let the commit block carry the flush for the data that has
+ * already completed, and skip the trailing flush altogether.
+ */
+static int journal_use_fua_commit(journal_t *journal)
+{
+	return (journal->j_flags & JBD2_BARRIER) &&
+	       JBD2_HAS_INCOMPAT_FEATURE(journal,
+					 JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT) &&
+	       JBD2_HAS_COMPAT_FEATURE(journal,
+				       JBD2_FEATURE_COMPAT_CHECKSUM) &&
+	       (bdev_get_queue(journal->j_dev)->flush_flags & REQ_FUA);
+}
+
+static inline int jbd2_lat_bucket(u64 ns)
+{
+	u32 units = min_t(u64, div_u64(ns, 128 * NSEC_PER_USEC), UINT_MAX);
+
+	return min(fls(units), JBD2_LAT_BUCKETS - 1);
+}
+
+/*
+ * When several processes keep fsync()ing, each commit ends in a cache
+ * flush that costs far more than the blocks it writes.  If recent commits
+ * had more than one waiter, hold the transaction open for up to one
+ * average flush time (bounded by the journal's batch times) so the
+ * fsync()s arriving behind this one share its flush.  The window ends
+ * as soon as the usual number of waiters joined.  A commit nobody waits
+ * on yet is not held: during a storm the next transaction already has
+ * waiters by the time the previous commit finishes.
+ */
+static int journal_batch_commit(journal_t *journal,
+				transaction_t *transaction)
+{
+	unsigned int expected = journal->j_average_commit_waiters;
+	u64 window = journal->j_average_flush_time;
+	ktime_t expires;
+	DEFINE_WAIT(wait);
+
+	if (!(journal->j_flags & JBD2_BARRIER) ||
+	    expected < 12 || !atomic_read(&transaction->t_commit_waiters))
+		return 0;
+
+	expected = DIV_ROUND_UP(expected, 8);
+	window = min_t(u64, window, 1000ULL * journal->j_max_batch_time);
+	window = max_t(u64, window, 1000ULL * journal->j_min_batch_time);
+	if (!window)
+		return 0;
+
+	expires = ktime_add_ns(ktime_get(), window);
+	for (;;) {
+		prepare_to_wait(&journal->j_wait_commit, &wait,
+				TASK_UNINTERRUPTIBLE);
+		if (atomic_read(&transaction->t_commit_waiters) >= expected ||
+		    !schedule_hrtimeout(&expires, HRTIMER_MODE_ABS))
+			break;
+	}
+	finish_wait(&journal->j_wait_commit, &wait);
+	return 1;
+}
+
 /*
  * jbd2_journal_commit_transaction
  *
@@ -318,8 +392,9 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int flags;
 	int err;
 	unsigned long long blocknr;
-	ktime_t start_time;
-	u64 commit_time;
+	ktime_t start_time, flush_start;
+	u64 commit_time, flush_time = 0;
+	int batched, write_op = WRITE_SYNC;
 	char *tagp = NULL;
 	journal_header_t *header;
 	journal_block_tag_t *tag = NULL;
@@ -355,8 +430,13 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	jbd_debug(1, "JBD: starting commit of transaction %d\n",
 			commit_transaction->t_tid);
 
+	batched = journal_batch_commit(journal, commit_transaction);
+
 	write_lock(&journal->j_state_lock);
 	commit_transaction->t_state = T_LOCKED;
+	commit_transaction->t_fua_commit = journal_use_fua_commit(journal);
+	if (commit_transaction->t_fua_commit)
+		write_op = WRITE_SYNC | WRITE_FUA;
 
 	trace_jbd2_commit_locking(journal, commit_transaction);
 	stats.run.rs_wait = commit_transaction->t_max_wait;
@@ -459,7 +539,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 	blk_start_plug(&plug);
 	jbd2_journal_write_revoke_records(journal, commit_transaction,
-					  WRITE_SYNC);
+					  write_op);
 	blk_finish_plug(&plug);
 
 	jbd_debug(3, "JBD: commit phase 2\n");
@@ -649,7 +729,7 @@ start_journal_io:
 				clear_buffer_dirty(bh);
 				set_buffer_uptodate(bh);
 				bh->b_end_io = journal_end_buffer_io_sync;
-				submit_bh(WRITE_SYNC, bh);
+				submit_bh(write_op, bh);
 			}
 			cond_resched();
 			stats.run.rs_blocks_logged += bufs;
@@ -688,6 +768,7 @@ start_journal_io:
 	/* Done it all: now write the commit record asynchronously. */
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
 				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
+		flush_start = ktime_get();
 		err = journal_submit_commit_record(journal, commit_transaction,
 						 &cbh, crc32_sum);
 		if (err)
@@ -809,6 +890,7 @@ wait_for_iobuf:
 
 	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
+		flush_start = ktime_get();
 		err = journal_submit_commit_record(journal, commit_transaction,
 						&cbh, crc32_sum);
 		if (err)
@@ -818,9 +900,13 @@ wait_for_iobuf:
 		err = journal_wait_on_commit_record(journal, cbh);
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
 				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT) &&
+	    !commit_transaction->t_fua_commit &&
 	    journal->j_flags & JBD2_BARRIER) {
+		flush_start = ktime_get();
 		blkdev_issue_flush(journal->j_dev, GFP_KERNEL, NULL);
 	}
+	if (journal->j_flags & JBD2_BARRIER)
+		flush_time = ktime_to_ns(ktime_sub(ktime_get(), flush_start));
 
 	if (err)
 		jbd2_journal_abort(journal, err);
@@ -994,6 +1080,9 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	journal->j_stats.ts_batched += batched;
+	if (flush_time)
+		journal->j_stats.ts_flush_hist[jbd2_lat_bucket(flush_time)]++;
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
@@ -1011,8 +1100,19 @@ restart_loop:
 				journal->j_average_commit_time*3) / 4;
 	else
 		journal->j_average_commit_time = commit_time;
+	if (flush_time)
+		journal->j_average_flush_time = journal->j_average_flush_time ?
+			(flush_time + journal->j_average_flush_time * 3) / 4 :
+			flush_time;
+	journal->j_average_commit_waiters = (8 *
+		atomic_read(&commit_transaction->t_commit_waiters) +
+		journal->j_average_commit_waiters * 3) / 4;
 	write_unlock(&journal->j_state_lock);
 
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_commit_hist[jbd2_lat_bucket(commit_time)]++;
+	spin_unlock(&journal->j_history_lock);
+
 	if (commit_transaction->t_checkpoint_list == NULL &&
 	    commit_transaction->t_checkpoint_io_list == NULL) {
 		__jbd2_journal_drop_transaction(journal, commit_transaction);
@@ -618,7 +618,9 @@ int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid)
 		    commit_trans->t_state >= T_COMMIT_DFLUSH)
 			goto out;
 	} else {
-		if (commit_trans->t_state >= T_COMMIT_JFLUSH)
+		/* FUA commits send their flush with the early commit block */
+		if (commit_trans->t_state >= (commit_trans->t_fua_commit ?
+					      T_COMMIT_DFLUSH : T_COMMIT_JFLUSH))
 			goto out;
 	}
 	ret = 1;
@@ -644,6 +646,9 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 		       __func__, journal->j_commit_request, tid);
 	}
 #endif
+	if (journal->j_running_transaction &&
+	    journal->j_running_transaction->t_tid == tid)
+		atomic_inc(&journal->j_running_transaction->t_commit_waiters);
 	while (tid_gt(tid, journal->j_commit_sequence)) {
 		jbd_debug(1, "JBD: want %d, j_commit_sequence=%d\n",
 				  tid, journal->j_commit_sequence);
@@ -761,6 +766,16 @@ static void *jbd2_seq_info_next(struct seq_file *seq, void *v, loff_t *pos)
 	return NULL;
 }
 
+static void jbd2_seq_hist_show(struct seq_file *seq, unsigned long *hist)
+{
+	int i;
+
+	for (i = 0; i < JBD2_LAT_BUCKETS - 1; i++)
+		seq_printf(seq, "  <%luus: %lu\n", 128UL << i, hist[i]);
+	seq_printf(seq, "  >=%luus: %lu\n", 128UL << (JBD2_LAT_BUCKETS - 2),
+		   hist[JBD2_LAT_BUCKETS - 1]);
+}
+
 static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 {
 	struct jbd2_stats_proc_session *s = seq->private;
@@ -790,6 +805,17 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "  %lluus average commit record flush time\n",
+		   div_u64(s->journal->j_average_flush_time, 1000));
+	seq_printf(seq, "  %u.%u processes waiting per commit\n",
+		   s->journal->j_average_commit_waiters / 8,
+		   (s->journal->j_average_commit_waiters % 8) * 10 / 8);
+	seq_printf(seq, "%lu commits held back for batching\n",
+		   s->stats->ts_batched);
+	seq_puts(seq, "commit time histogram:\n");
+	jbd2_seq_hist_show(seq, s->stats->ts_commit_hist);
+	seq_puts(seq, "commit record flush time histogram:\n");
+	jbd2_seq_hist_show(seq, s->stats->ts_flush_hist);
 	return 0;
 }
 
@@ -82,8 +82,8 @@ long select_estimate_accuracy(struct timespec *tv)
 	ktime_get_ts(&now);
 	now = timespec_sub(*tv, now);
 	ret = __estimate_accuracy(&now);
-	if (ret < current->timer_slack_ns)
-		return current->timer_slack_ns;
+	if (ret < task_get_effective_timer_slack(current))
+		return task_get_effective_timer_slack(current);
 	return ret;
 }
 
@@ -371,6 +371,89 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Decompress the datablock containing target straight into the page
+ * cache pages it covers, instead of through msblk->read_page and a copy.
+ * This is only done if every one of those pages can be grabbed and none
+ * is uptodate yet, otherwise -EAGAIN is returned with nothing done and
+ * the caller goes through the cache.  On success all pages including
+ * target are uptodate and unlocked; on any other error target is left
+ * locked for the caller to fail.
+ */
+static int squashfs_readpage_direct(struct page *target, u64 block, int bsize,
+	int expected)
+{
+	struct inode *inode = target->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target->index & ~mask;
+	int pages = (expected + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	struct page **page;
+	void **pageaddr;
+	int i, n, bytes, avail, res = -EAGAIN;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (n = 0; n < pages; n++) {
+		page[n] = (start_index + n == target->index) ? target :
+			grab_cache_page_nowait(target->mapping, start_index + n);
+		if (page[n] == NULL)
+			goto release_pages;
+		if (PageUptodate(page[n])) {
+			n++;
+			goto release_pages;
+		}
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+
+	/* Bound the block by the pages, the tail block has fewer of them */
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+
+	for (i = 0, bytes = res; i < pages; i++, bytes -= PAGE_CACHE_SIZE) {
+		if (res >= 0) {
+			avail = clamp(bytes, 0, (int) PAGE_CACHE_SIZE);
+			memset(pageaddr[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+		kunmap(page[i]);
+	}
+
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+	else
+		res = 0;
+
+release_pages:
+	for (i = 0; i < n; i++) {
+		if (page[i] == target && res)
+			continue;
+		unlock_page(page[i]);
+		if (page[i] != target)
+			page_cache_release(page[i]);
+	}
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+#else
+static inline int squashfs_readpage_direct(struct page *target, u64 block,
+	int bsize, int expected)
+{
+	return -EAGAIN;
+}
+#endif
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -409,6 +492,15 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+			int res = squashfs_readpage_direct(page, block, bsize,
+				index == file_end ?
+				(i_size_read(inode) & (msblk->block_size - 1)) :
+				 msblk->block_size);
+			if (res == 0)
+				return 0;
+			else if (res != -EAGAIN)
+				goto error_out;
+
 			/*
 			 * Read and decompress datablock.
 			 */
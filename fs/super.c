@@ -32,6 +32,9 @@
 #include <linux/backing-dev.h>
 #include <linux/rculist_bl.h>
 #include <linux/cleancache.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 #include "internal.h"
 
 
@@ -78,6 +81,9 @@ static int prune_super(struct shrinker *shrink, struct shrink_control *sc)
 							total_objects;
 		inodes = (sc->nr_to_scan * sb->s_nr_inodes_unused) /
 							total_objects;
+		sb->s_shrink_calls++;
+		sb->s_shrink_dentries += dentries;
+		sb->s_shrink_inodes += inodes;
 		if (fs_objects)
 			fs_objects = (sc->nr_to_scan * fs_objects) /
 							total_objects;
@@ -97,6 +103,7 @@ static int prune_super(struct shrinker *shrink, struct shrink_control *sc)
 	}
 
 	total_objects = (total_objects / 100) * sysctl_vfs_cache_pressure;
+	total_objects = (total_objects / 100) * sb->s_cache_pressure;
 	drop_super(sb);
 	return total_objects;
 }
@@ -183,6 +190,7 @@ static struct super_block *alloc_super(struct file_system_type *type)
 		s->s_shrink.seeks = DEFAULT_SEEKS;
 		s->s_shrink.shrink = prune_super;
 		s->s_shrink.batch = 1024;
+		s->s_cache_pressure = 100;
 	}
 out:
 	return s;
@@ -589,6 +597,94 @@ void iterate_supers_type(struct file_system_type *type,
 
 EXPORT_SYMBOL(iterate_supers_type);
 
+#ifdef CONFIG_PROC_FS
+/*
+ * /proc/fs/cache_pressure lets a mount holding bulk data (say a media
+ * library that gets scanned end to end) give up its dentries and inodes
+ * sooner than the system partition.  Writing "<s_id> <percent>" scales
+ * the count the sb shrinker reports on top of vfs_cache_pressure.
+ */
+static void cache_pressure_show_sb(struct super_block *sb, void *arg)
+{
+	struct seq_file *m = arg;
+
+	seq_printf(m, "%-16s %-10s %5d %8d %8d %10lu %12lu %12lu\n",
+		   sb->s_id, sb->s_type->name, sb->s_cache_pressure,
+		   sb->s_nr_dentry_unused, sb->s_nr_inodes_unused,
+		   sb->s_shrink_calls, sb->s_shrink_dentries,
+		   sb->s_shrink_inodes);
+}
+
+static int cache_pressure_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "%-16s %-10s %5s %8s %8s %10s %12s %12s\n",
+		   "device", "type", "press", "dentries", "inodes",
+		   "shrinks", "scan_dentry", "scan_inode");
+	iterate_supers(cache_pressure_show_sb, m);
+	return 0;
+}
+
+struct cache_pressure_set {
+	const char	*id;
+	int		pressure;
+	int		found;
+};
+
+static void cache_pressure_set_sb(struct super_block *sb, void *arg)
+{
+	struct cache_pressure_set *set = arg;
+
+	if (!strcmp(sb->s_id, set->id)) {
+		sb->s_cache_pressure = set->pressure;
+		set->found = 1;
+	}
+}
+
+static ssize_t cache_pressure_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct cache_pressure_set set = { };
+	char kbuf[64], id[32];
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+
+	if (sscanf(kbuf, "%31s %d", id, &set.pressure) != 2 ||
+	    set.pressure < 0 || set.pressure > 1000)
+		return -EINVAL;
+	set.id = id;
+
+	iterate_supers(cache_pressure_set_sb, &set);
+	return set.found ? count : -ENODEV;
+}
+
+static int cache_pressure_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cache_pressure_show, NULL);
+}
+
+static const struct file_operations cache_pressure_fops = {
+	.open		= cache_pressure_open,
+	.read		= seq_read,
+	.write		= cache_pressure_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init proc_cache_pressure_init(void)
+{
+	proc_create("fs/cache_pressure", S_IRUGO | S_IWUSR, NULL,
+		    &cache_pressure_fops);
+	return 0;
+}
+module_init(proc_cache_pressure_init);
+#endif
+
 /**
  *	get_super - get the superblock of a device
  *	@bdev: device to get the superblock for
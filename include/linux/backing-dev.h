@@ -61,9 +61,29 @@ struct bdi_writeback {
 	spinlock_t list_lock;		/* protects the b_* lists */
 };
 
+/*
+ * Adaptive readahead: ra_pages is moved between min_pages and max_pages
+ * depending on how much of what readahead brings in is actually used and
+ * on the read latency of the device, see bdi_ra_account().
+ */
+struct bdi_ra_adapt {
+	spinlock_t lock;		/* serialises the window updates */
+	atomic_long_t issued;		/* pages read ahead this period */
+	atomic_long_t used;		/* ... and consumed by readers */
+	unsigned long min_pages;	/* window bounds */
+	unsigned long max_pages;
+	unsigned long lat_us;		/* read latency, moving average */
+	unsigned long lat_target_us;	/* don't grow the window above this */
+	unsigned long grow;		/* number of window changes */
+	unsigned long shrink;
+	unsigned int ratio;		/* used/issued of the last period, % */
+	unsigned int enabled;
+};
+
 struct backing_dev_info {
 	struct list_head bdi_list;
 	unsigned long ra_pages;	/* max readahead in PAGE_CACHE_SIZE units */
+	struct bdi_ra_adapt ra_adapt;
 	unsigned long state;	/* Always use atomic bitops on this */
 	unsigned int capabilities; /* Device capabilities */
 	congested_fn *congested_fn; /* Function pointer if device is md/dm */
@@ -101,6 +121,18 @@ struct backing_dev_info {
 
 int bdi_init(struct backing_dev_info *bdi);
 void bdi_destroy(struct backing_dev_info *bdi);
+void bdi_ra_account(struct backing_dev_info *bdi, unsigned long issued,
+		    unsigned long used);
+
+/* Fed from request completion, which runs under the queue lock */
+static inline void bdi_ra_update_latency(struct backing_dev_info *bdi,
+					 unsigned long usecs)
+{
+	struct bdi_ra_adapt *ra = &bdi->ra_adapt;
+
+	if (ra->enabled)
+		ra->lat_us = (ra->lat_us * 7 + usecs) / 8;
+}
 
 int bdi_register(struct backing_dev_info *bdi, struct device *parent,
 		const char *fmt, ...);
@@ -1461,6 +1461,16 @@ struct super_block {
 	int cleancache_poolid;
 
 	struct shrinker s_shrink;	/* per-sb shrinker handle */
+
+	/*
+	 * Reclaim weight of this sb's dentries and inodes in percent of
+	 * vfs_cache_pressure, and what the shrinker asked for so far.
+	 * Set through /proc/fs/cache_pressure.
+	 */
+	int			s_cache_pressure;
+	unsigned long		s_shrink_calls;
+	unsigned long		s_shrink_dentries;
+	unsigned long		s_shrink_inodes;
 };
 
 /* superblock cache pruning functions */
@@ -495,6 +495,8 @@ struct hid_device {							/* device report descriptor */
 
 	void *driver_data;
 
+	ktime_t report_time;						/* Arrival of the report being parsed, 0 if unknown */
+
 	/* temporary hid_ff handling (until moved to the drivers) */
 	int (*ff_init)(struct hid_device *);
 
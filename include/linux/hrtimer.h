@@ -434,6 +434,18 @@ extern int schedule_hrtimeout_range_clock(ktime_t *expires,
 		unsigned long delta, const enum hrtimer_mode mode, int clock);
 extern int schedule_hrtimeout(ktime_t *expires, const enum hrtimer_mode mode);
 
+/* Timer coalescing for deep idle: */
+struct timer_coalesce_stats {
+	unsigned long hrtimer_aligned;	/* sleeps moved onto a boundary */
+	unsigned long timer_aligned;	/* schedule_timeout()s rounded */
+	unsigned long shared;		/* boundary shared with the last one */
+};
+
+extern void timer_coalesce_set(unsigned long granularity_ns);
+extern unsigned long timer_coalesce_granularity(void);
+extern void timer_coalesce_note(bool hrtimer, u64 boundary);
+extern void timer_coalesce_get_stats(struct timer_coalesce_stats *stats);
+
 /* Soft interrupt function to run the hrtimer queues: */
 extern void hrtimer_run_queues(void);
 extern void hrtimer_run_pending(void);
@@ -829,6 +829,7 @@ struct input_keymap_entry {
 #define MSC_GESTURE		0x02
 #define MSC_RAW			0x03
 #define MSC_SCAN		0x04
+#define MSC_TIMESTAMP		0x05
 #define MSC_MAX			0x07
 #define MSC_CNT			(MSC_MAX+1)
 
@@ -1137,6 +1138,7 @@ struct ff_effect {
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
 #include <linux/mod_devicetable.h>
 
 /**
@@ -1216,6 +1218,10 @@ struct ff_effect {
  * @going_away: marks devices that are in a middle of unregistering and
  *	causes input_open_device*() fail with -ENODEV.
  * @sync: set to %true when there were no new events since last EV_SYN
+ * @timestamp: time given to every event of the current packet. Drivers
+ *	that know when the data was captured set it with
+ *	input_set_timestamp() before reporting, otherwise the first event
+ *	of the packet sets it. Cleared by SYN_REPORT
  * @dev: driver model's view of this device
  * @h_list: list of input handles associated with the device. When
  *	accessing the list dev->mutex must be held
@@ -1285,6 +1291,8 @@ struct input_dev {
 
 	bool sync;
 
+	ktime_t timestamp;
+
 	struct device dev;
 
 	struct list_head	h_list;
@@ -1506,6 +1514,26 @@ static inline void input_sync(struct input_dev *dev)
 	input_event(dev, EV_SYN, SYN_REPORT, 0);
 }
 
+/**
+ * input_set_timestamp - set the time of the packet being reported
+ * @dev: input device
+ * @timestamp: CLOCK_MONOTONIC time the data was captured at
+ *
+ * Applies to all events up to and including the next SYN_REPORT.
+ */
+static inline void input_set_timestamp(struct input_dev *dev,
+				       ktime_t timestamp)
+{
+	dev->timestamp = timestamp;
+}
+
+static inline ktime_t input_get_timestamp(struct input_dev *dev)
+{
+	if (!dev->timestamp.tv64)
+		dev->timestamp = ktime_get();
+	return dev->timestamp;
+}
+
 static inline void input_mt_sync(struct input_dev *dev)
 {
 	input_event(dev, EV_SYN, SYN_MT_REPORT, 0);
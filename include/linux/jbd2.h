@@ -663,6 +663,18 @@ struct transaction_s
 	/* Disk flush needs to be sent to fs partition [no locking] */
 	int			t_need_data_flush;
 
+	/*
+	 * Log and commit blocks are written with FUA and the commit block
+	 * is not held back for the log blocks [j_state_lock]
+	 */
+	int			t_fua_commit;
+
+	/*
+	 * Number of processes waiting in jbd2_log_wait_commit() for this
+	 * transaction while it was still running [no locking]
+	 */
+	atomic_t		t_commit_waiters;
+
 	/*
 	 * For use by the filesystem to store fs-specific data
 	 * structures associated with the transaction
@@ -682,8 +694,17 @@ struct transaction_run_stats_s {
 	__u32			rs_blocks_logged;
 };
 
+/*
+ * Latency histogram buckets: bucket 0 counts everything below 128us and
+ * each following bucket doubles the limit; the last one is open ended.
+ */
+#define JBD2_LAT_BUCKETS	12
+
 struct transaction_stats_s {
 	unsigned long		ts_tid;
+	unsigned long		ts_batched;
+	unsigned long		ts_commit_hist[JBD2_LAT_BUCKETS];
+	unsigned long		ts_flush_hist[JBD2_LAT_BUCKETS];
 	struct transaction_run_stats_s run;
 };
 
@@ -975,6 +996,15 @@ struct journal_s
 	 */
 	u64			j_average_commit_time;
 
+	/*
+	 * the average time in nanoseconds the commit record waits for the
+	 * device cache flush, and the average number of processes waiting
+	 * on a commit in eighths.  Both are used to decide whether a commit
+	 * is worth holding back for more fsync()s. [j_state_lock]
+	 */
+	u64			j_average_flush_time;
+	unsigned int		j_average_commit_waiters;
+
 	/*
 	 * minimum and maximum times that we should wait for
 	 * additional filesystem operations to get batched into a
@@ -0,0 +1,86 @@
+#ifndef _LINUX_LAT_HIST_H
+#define _LINUX_LAT_HIST_H
+
+/*
+ * Per-CPU log2 latency histograms, cheap enough to leave enabled on hot
+ * paths of production kernels. Bucket 0 counts latencies below 1us and
+ * bucket n those from 2^(n-1) up to 2^n us, the last one is open ended.
+ * Registered histograms are read, and reset by writing to them, in
+ * /sys/kernel/debug/lat_hist.
+ */
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+
+#define LAT_HIST_BUCKETS	24
+
+struct lat_hist_cpu {
+	u32 count[LAT_HIST_BUCKETS];
+	u64 sum_us;
+	u32 max_us;
+};
+
+struct lat_hist {
+	const char *name;
+	struct lat_hist_cpu __percpu *cpu;
+	struct list_head node;
+	struct dentry *dentry;
+};
+
+#ifdef CONFIG_LAT_HIST
+
+#define DEFINE_LAT_HIST(_var, _name)					\
+	static DEFINE_PER_CPU(struct lat_hist_cpu, _var##_cpu);	\
+	static struct lat_hist _var = {					\
+		.name	= _name,					\
+		.cpu	= &_var##_cpu,					\
+		.node	= LIST_HEAD_INIT(_var.node),			\
+	}
+
+void lat_hist_add(struct lat_hist *h, u32 us);
+/* registering a histogram twice is harmless */
+void lat_hist_register(struct lat_hist *h);
+void lat_hist_unregister(struct lat_hist *h);
+/* for histograms embedded in dynamically allocated objects */
+int lat_hist_alloc(struct lat_hist *h, const char *name);
+void lat_hist_free(struct lat_hist *h);
+
+static inline ktime_t lat_hist_start(void)
+{
+	return ktime_get();
+}
+
+static inline void lat_hist_add_since(struct lat_hist *h, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	lat_hist_add(h, us > 0 ? (u32)min_t(s64, us, UINT_MAX) : 0);
+}
+
+#else
+
+#define DEFINE_LAT_HIST(_var, _name)					\
+	static struct lat_hist _var __maybe_unused
+
+static inline void lat_hist_add(struct lat_hist *h, u32 us) { }
+static inline void lat_hist_register(struct lat_hist *h) { }
+static inline void lat_hist_unregister(struct lat_hist *h) { }
+static inline int lat_hist_alloc(struct lat_hist *h, const char *name)
+{
+	return 0;
+}
+static inline void lat_hist_free(struct lat_hist *h) { }
+
+static inline ktime_t lat_hist_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void lat_hist_add_since(struct lat_hist *h, ktime_t start) { }
+
+#endif /* CONFIG_LAT_HIST */
+
+#endif /* _LINUX_LAT_HIST_H */
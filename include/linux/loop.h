@@ -27,6 +27,7 @@ enum {
 };
 
 struct loop_func_table;
+struct loop_extent;
 
 struct loop_device {
 	int		lo_number;
@@ -64,6 +65,11 @@ struct loop_device {
 
 	struct request_queue	*lo_queue;
 	struct gendisk		*lo_disk;
+
+	/* LO_FLAGS_DIRECT_IO: the backing blocks, sorted by loop sector */
+	struct block_device	*lo_direct_bdev;
+	struct loop_extent	*lo_extents;
+	unsigned int		lo_nr_extents;
 };
 
 #endif /* __KERNEL__ */
@@ -75,6 +81,7 @@ enum {
 	LO_FLAGS_READ_ONLY	= 1,
 	LO_FLAGS_USE_AOPS	= 2,
 	LO_FLAGS_AUTOCLEAR	= 4,
+	LO_FLAGS_DIRECT_IO	= 16,
 };
 
 #include <asm/posix_types.h>	/* for __kernel_old_dev_t */
@@ -159,6 +166,7 @@ int loop_unregister_transfer(int number);
 #define LOOP_GET_STATUS64	0x4C05
 #define LOOP_CHANGE_FD		0x4C06
 #define LOOP_SET_CAPACITY	0x4C07
+#define LOOP_SET_DIRECT_IO	0x4C08
 
 /* /dev/loop-control interface */
 #define LOOP_CTL_ADD		0x4C80
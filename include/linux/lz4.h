@@ -0,0 +1,38 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+/*
+ *  LZ4 Kernel Interface
+ *
+ *  The block format of the LZ4 compressor by Yann Collet:
+ *  http://code.google.com/p/lz4/
+ *
+ *  Fast to compress and faster still to decompress, at a ratio close to
+ *  that of lzo1x_1.
+ */
+
+#define LZ4_HASH_LOG		12
+#define LZ4_MEM_COMPRESS	(sizeof(u32) << LZ4_HASH_LOG)
+
+#define lz4_compressbound(x)	((x) + ((x) / 255) + 16)
+
+/*
+ * This requires 'wrkmem' of size LZ4_MEM_COMPRESS, and 'dst' room for
+ * lz4_compressbound(src_len) bytes.
+ */
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/*
+ * Safe decompression with overrun testing: '*dst_len' is the room in 'dst'
+ * on entry and the decompressed length on return.
+ */
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len);
+
+/*
+ * Return values (< 0 = Error)
+ */
+#define LZ4_E_OK		0
+#define LZ4_E_ERROR		(-1)
+
+#endif
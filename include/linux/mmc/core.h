@@ -141,6 +141,7 @@ struct mmc_async_req;
 extern struct mmc_async_req *mmc_start_req(struct mmc_host *,
 					   struct mmc_async_req *, int *);
 extern int mmc_interrupt_hpi(struct mmc_card *);
+extern int mmc_send_ext_csd(struct mmc_card *card, u8 *ext_csd);
 extern int mmc_bkops_start(struct mmc_card *card, bool is_synchronous);
 extern void mmc_refresh(unsigned long data);
 
@@ -16,6 +16,12 @@
 #include <linux/types.h>
 #include <linux/io.h>
 #include <linux/mmc/host.h>
+#include <linux/lat_hist.h>
+
+struct sdhci_next {
+	unsigned int sg_count;	/* Mapped sg entries of the next request */
+	s32 cookie;		/* host_cookie of the next request */
+};
 
 struct sdhci_host {
 	/* Data set by hardware interface driver */
@@ -123,6 +129,7 @@ struct sdhci_host {
 #define SDHCI_NEEDS_RETUNING	(1<<5)	/* Host needs retuning */
 #define SDHCI_AUTO_CMD12	(1<<6)	/* Auto CMD12 support */
 #define SDHCI_AUTO_CMD23	(1<<7)	/* Auto CMD23 support */
+#define SDHCI_TUNING_CRC_ERR	(1<<8)	/* CRC error since last tuning */
 
 	unsigned int version;	/* SDHCI spec. version */
 
@@ -142,6 +149,7 @@ struct sdhci_host {
 	unsigned int blocks;	/* remaining PIO blocks */
 
 	int sg_count;		/* Mapped sg entries */
+	struct sdhci_next next_data;	/* Request mapped in pre_req */
 
 	u8 *adma_desc;		/* ADMA descriptor table */
 	u8 *align_buffer;	/* Bounce buffer */
@@ -169,6 +177,9 @@ struct sdhci_host {
 #define SDHCI_TUNING_MODE_1	0
 	struct timer_list	tuning_timer;	/* Timer for tuning */
 
+	ktime_t req_start;		/* Current request issued */
+	struct lat_hist req_hist;	/* Request completion latency */
+
 	unsigned long private[0] ____cacheline_aligned;
 };
 #endif /* LINUX_MMC_SDHCI_H */
@@ -2017,6 +2017,8 @@ extern int netif_set_real_num_tx_queues(struct net_device *dev,
 #ifdef CONFIG_RPS
 extern int netif_set_real_num_rx_queues(struct net_device *dev,
 					unsigned int rxq);
+extern int netif_set_rps_cpus(struct net_device *dev,
+			      const struct cpumask *mask);
 #else
 static inline int netif_set_real_num_rx_queues(struct net_device *dev,
 						unsigned int rxq)
@@ -24,6 +24,7 @@
 #define __LINUX_NVHOST_H
 
 #include <linux/device.h>
+#include <linux/ktime.h>
 #include <linux/types.h>
 
 struct nvhost_master;
@@ -59,6 +60,9 @@ enum nvhost_power_sysfs_attributes {
 	NVHOST_POWER_SYSFS_ATTRIB_CLOCKGATE_DELAY = 0,
 	NVHOST_POWER_SYSFS_ATTRIB_POWERGATE_DELAY,
 	NVHOST_POWER_SYSFS_ATTRIB_REFCOUNT,
+	NVHOST_POWER_SYSFS_ATTRIB_WAKE_COUNT,
+	NVHOST_POWER_SYSFS_ATTRIB_UNPOWERGATE_LATENCY,
+	NVHOST_POWER_SYSFS_ATTRIB_PREDICT,
 	NVHOST_POWER_SYSFS_ATTRIB_MAX
 };
 
@@ -79,6 +83,13 @@ enum nvhost_device_powerstate_t {
 	NVHOST_POWER_STATE_POWERGATED
 };
 
+/* Cost of leaving one gated state, used to pick the adaptive delays */
+struct nvhost_module_wake_stats {
+	u32 count;		/* Wakes out of this state */
+	u32 avg_us;		/* Running average of the wake latency */
+	u32 max_us;		/* Worst wake latency seen */
+};
+
 struct nvhost_device {
 	const char	*name;		/* device name */
 	int		version;	/* ip version number of device */
@@ -102,6 +113,9 @@ struct nvhost_device {
 	bool		powerup_reset;	/* Do a reset after power un-gating */
 	bool		serialize;	/* Serialize submits in the channel */
 
+	u32		push_buffer_slots;	/* Initial push buffer slots */
+	u32		push_buffer_max_slots;	/* Limit for on-demand growth */
+
 	int		powergate_ids[NVHOST_MODULE_MAX_POWERGATE_IDS];
 	bool		can_powergate;	/* True if module can be power gated */
 	int		clockgate_delay;/* Delay before clock gated */
@@ -117,6 +131,21 @@ struct nvhost_device {
 	wait_queue_head_t idle_wq;	/* Work queue for idle */
 	struct list_head client_list;	/* List of clients and rate requests */
 
+	ktime_t		idle_stamp;	/* When refcount last dropped to 0 */
+	u32		idle_gap_ms;	/* Running average of idle gaps */
+	int		cur_clockgate_delay;/* Adaptive clock gate delay */
+	int		cur_powergate_delay;/* Adaptive power gate delay */
+	struct nvhost_module_wake_stats clockgate_wakes;
+	struct nvhost_module_wake_stats powergate_wakes;
+
+	ktime_t		busy_stamp;	/* When refcount last rose from 0 */
+	u32		busy_period_ms;	/* Running average busy-to-busy period */
+	u32		busy_jitter_ms;	/* Running average deviation from it */
+	struct delayed_work powerstate_up;/* Predictive power ungating */
+	bool		predicted;	/* Ungated ahead of an expected busy */
+	u32		predict_hits;	/* Predictions followed by a busy */
+	u32		predict_misses;	/* Predictions gated again unused */
+
 	struct nvhost_channel *channel;	/* Channel assigned for the module */
 	struct kobject *power_kobj;	/* kobject to hold power sysfs entries */
 	struct nvhost_device_power_attr *power_attrib;	/* sysfs attributes */
@@ -213,7 +242,73 @@ u32 nvhost_syncpt_read_ext(struct nvhost_device *dev, u32 id);
 int nvhost_syncpt_wait_timeout_ext(struct nvhost_device *dev, u32 id, u32 thresh,
 	u32 timeout, u32 *value);
 
+/* public host1x sync-point fence APIs */
+struct nvhost_fence;
+struct nvhost_fence *nvhost_fence_fdget(int fd);
+int nvhost_fence_wait(struct nvhost_fence *fence, u32 timeout);
+void nvhost_fence_put(struct nvhost_fence *fence);
+/* installs a fence for (id, thresh) in a new fd of the calling process */
+int nvhost_fence_create_syncpt_fd(struct nvhost_device *dev, u32 id,
+	u32 thresh);
+
+/* public gr2d blit APIs */
+enum nvhost_gr2d_format {
+	NVHOST_GR2D_FORMAT_RGB565,
+	NVHOST_GR2D_FORMAT_B8G8R8A8,	/* XRGB8888 in a little endian word */
+	NVHOST_GR2D_FORMAT_R8G8B8A8,	/* XBGR8888 in a little endian word */
+	NVHOST_GR2D_FORMAT_UYVY,	/* Packed 4:2:2, source only */
+	NVHOST_GR2D_FORMAT_YUYV,	/* Packed 4:2:2, source only */
+};
+
+enum nvhost_gr2d_transform {
+	NVHOST_GR2D_TRANSFORM_NONE,
+	NVHOST_GR2D_TRANSFORM_FLIP_X,
+	NVHOST_GR2D_TRANSFORM_FLIP_Y,
+	NVHOST_GR2D_TRANSFORM_ROT_90,
+	NVHOST_GR2D_TRANSFORM_ROT_180,
+	NVHOST_GR2D_TRANSFORM_ROT_270,
+};
+
+struct nvhost_gr2d_surface {
+	u32 base;			/* Bus address of the first pixel */
+	u32 pitch;			/* Bytes per line */
+	u32 width;
+	u32 height;
+	enum nvhost_gr2d_format format;
+};
+
+struct nvhost_gr2d_rect {
+	u32 x, y, w, h;
+};
+
+/* Sync point threshold reached when the operation is complete */
+struct nvhost_gr2d_fence {
+	u32 id;
+	u32 thresh;
+};
+
+#define NVHOST_GR2D_ROP_COPY		0xcc
+#define NVHOST_GR2D_ROP_XOR		0x66
+
+int nvhost_gr2d_fill(const struct nvhost_gr2d_surface *dst,
+	const struct nvhost_gr2d_rect *rect, u32 color, u8 rop,
+	struct nvhost_gr2d_fence *fence);
+int nvhost_gr2d_copy(const struct nvhost_gr2d_surface *dst,
+	const struct nvhost_gr2d_surface *src,
+	const struct nvhost_gr2d_rect *rect, u32 sx, u32 sy,
+	struct nvhost_gr2d_fence *fence);
+int nvhost_gr2d_blit(const struct nvhost_gr2d_surface *dst,
+	const struct nvhost_gr2d_rect *drect,
+	const struct nvhost_gr2d_surface *src,
+	const struct nvhost_gr2d_rect *srect,
+	enum nvhost_gr2d_transform transform,
+	struct nvhost_gr2d_fence *fence);
+int nvhost_gr2d_wait(const struct nvhost_gr2d_fence *fence, u32 timeout);
+
 void nvhost_scale3d_set_throughput_hint(int hint);
+void nvhost_scale3d_set_frame_time(unsigned int target_us,
+				   unsigned int frame_us);
+void nvhost_scale3d_boost(unsigned int duration_ms);
 
 /* Hacky way to get access to struct nvhost_device tegra_vi01_device. */
 struct nvhost_device *t20_get_tegra_vi01_device(void);
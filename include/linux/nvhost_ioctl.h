@@ -112,6 +112,78 @@ struct nvhost_set_priority_args {
 	__u32 priority;
 };
 
+/* one job of a batched submit; reloc_shifts may be NULL */
+struct nvhost_submit_batch_job {
+	__u32 syncpt_id;
+	__u32 syncpt_incrs;
+	__u32 num_cmdbufs;
+	__u32 num_relocs;
+	__u32 num_waitchks;
+	__u32 waitchk_mask;
+	__u32 fence;		/* returned: syncpt value when job is done */
+	__u32 pad;
+	struct nvhost_cmdbuf __user *cmdbufs;
+	struct nvhost_reloc __user *relocs;
+	struct nvhost_reloc_shift __user *reloc_shifts;
+	struct nvhost_waitchk __user *waitchks;
+};
+
+#define NVHOST_SUBMIT_BATCH_MAX_JOBS	16
+
+struct nvhost_submit_batch_args {
+	__u32 num_jobs;
+	struct nvhost_submit_batch_job __user *jobs;
+};
+
+/*
+ * A buffer of an MPE or ISP job: the kernel pins the nvmap handle mem and
+ * writes the address of offset within it into the command buffer word at
+ * byte patch_offset of the command buffer's handle.
+ */
+struct nvhost_encode_buffer {
+	__u32 mem;
+	__u32 offset;
+	__u32 patch_offset;
+};
+
+#define NVHOST_ENCODE_MAX_INPUTS	3
+
+/*
+ * One frame of MPE encode. cmdbuf is a command stream built once per
+ * stream setting, that gets the addresses of this frame's input planes and
+ * output bitstream buffer patched in. Those words are rewritten by every
+ * job, so userspace keeps one command buffer per frame in flight.
+ */
+struct nvhost_submit_encode_args {
+	struct nvhost_cmdbuf cmdbuf;
+	__u32 syncpt_id;
+	__u32 syncpt_incrs;
+	__u32 num_inputs;
+	struct nvhost_encode_buffer inputs[NVHOST_ENCODE_MAX_INPUTS];
+	struct nvhost_encode_buffer output;
+	__u32 fence;		/* returned: syncpt value when job is done */
+};
+
+#define NVHOST_ISP_MAX_STAGES		4
+#define NVHOST_ISP_MAX_BUFFERS		4
+
+/*
+ * One frame through the ISP. cmdbuf runs num_stages pipeline stages, each
+ * ending with exactly one increment of syncpt_id, over buffers patched in
+ * as for encode: usually the raw frame the VI captured into, followed by
+ * the Y, U and V planes to produce. The stage increments are the last ones
+ * of the job, so stage k of a job with fence f is done at f - num_stages
+ * + 1 + k, and userspace may start consuming the output per stage.
+ */
+struct nvhost_submit_isp_args {
+	struct nvhost_cmdbuf cmdbuf;
+	__u32 syncpt_id;
+	__u32 num_stages;
+	__u32 num_buffers;
+	struct nvhost_encode_buffer buffers[NVHOST_ISP_MAX_BUFFERS];
+	__u32 fence;		/* returned: syncpt value when job is done */
+};
+
 #define NVHOST_IOCTL_CHANNEL_FLUSH		\
 	_IOR(NVHOST_IOCTL_MAGIC, 1, struct nvhost_get_param_args)
 #define NVHOST_IOCTL_CHANNEL_GET_SYNCPOINTS	\
@@ -138,9 +210,19 @@ struct nvhost_set_priority_args {
 	_IOR(NVHOST_IOCTL_MAGIC, 12, struct nvhost_get_param_args)
 #define NVHOST_IOCTL_CHANNEL_SET_PRIORITY	\
 	_IOW(NVHOST_IOCTL_MAGIC, 13, struct nvhost_set_priority_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH	\
+	_IOW(NVHOST_IOCTL_MAGIC, 14, struct nvhost_submit_batch_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT_ENCODE	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 15, struct nvhost_submit_encode_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT_ISP		\
+	_IOWR(NVHOST_IOCTL_MAGIC, 16, struct nvhost_submit_isp_args)
 #define NVHOST_IOCTL_CHANNEL_LAST		\
-	_IOC_NR(NVHOST_IOCTL_CHANNEL_SET_PRIORITY)
-#define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE sizeof(struct nvhost_submit_hdr_ext)
+	_IOC_NR(NVHOST_IOCTL_CHANNEL_SUBMIT_ISP)
+#define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE \
+	(sizeof(struct nvhost_submit_encode_args) > \
+	 sizeof(struct nvhost_submit_isp_args) ? \
+	 sizeof(struct nvhost_submit_encode_args) : \
+	 sizeof(struct nvhost_submit_isp_args))
 
 struct nvhost_ctrl_syncpt_read_args {
 	__u32 id;
@@ -169,6 +251,23 @@ struct nvhost_ctrl_module_mutex_args {
 	__u32 lock;
 };
 
+struct nvhost_ctrl_sync_fence_info {
+	__u32 id;
+	__u32 thresh;
+};
+
+struct nvhost_ctrl_sync_fence_create_args {
+	__u32 num_pts;
+	struct nvhost_ctrl_sync_fence_info *pts;
+	__s32 fence_fd;
+};
+
+struct nvhost_ctrl_sync_fence_merge_args {
+	__s32 fd1;
+	__s32 fd2;
+	__s32 fence_fd;
+};
+
 enum nvhost_module_id {
 	NVHOST_MODULE_NONE = -1,
 	NVHOST_MODULE_DISPLAY_A = 0,
@@ -205,8 +304,13 @@ struct nvhost_ctrl_module_regrdwr_args {
 #define NVHOST_IOCTL_CTRL_GET_VERSION	\
 	_IOR(NVHOST_IOCTL_MAGIC, 7, struct nvhost_get_param_args)
 
+#define NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 8, struct nvhost_ctrl_sync_fence_create_args)
+#define NVHOST_IOCTL_CTRL_SYNC_FENCE_MERGE	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 9, struct nvhost_ctrl_sync_fence_merge_args)
+
 #define NVHOST_IOCTL_CTRL_LAST			\
-	_IOC_NR(NVHOST_IOCTL_CTRL_GET_VERSION)
+	_IOC_NR(NVHOST_IOCTL_CTRL_SYNC_FENCE_MERGE)
 #define NVHOST_IOCTL_CTRL_MAX_ARG_SIZE	\
 	sizeof(struct nvhost_ctrl_module_regrdwr_args)
 
@@ -69,8 +69,10 @@ struct nvmap_device;
 struct nvmap_handle_ref {
 	struct nvmap_handle *handle;
 	struct rb_node	node;
+	struct hlist_node hash;	/* entry in the client's RCU handle table */
 	atomic_t	dupes;	/* number of times to free on file close */
 	atomic_t	pin;	/* number of times to unpin on free */
+	struct rcu_head	rcu;
 };
 
 #elif defined(CONFIG_ION_TEGRA)
@@ -126,12 +128,18 @@ struct nvmap_handle_ref *nvmap_duplicate_handle_id(struct nvmap_client *client,
 
 int nvmap_mark_global(struct nvmap_client *client, struct nvmap_handle_ref *r);
 
+int nvmap_share_fd(struct nvmap_client *client, struct nvmap_handle_ref *r);
+
+struct nvmap_handle_ref *nvmap_duplicate_handle_fd(struct nvmap_client *client,
+						   int fd);
+
 struct nvmap_platform_carveout {
 	const char *name;
 	unsigned int usage_mask;
 	phys_addr_t base;
 	size_t size;
 	size_t buddy_size;
+	bool movable;	/* lent to the page allocator while unused */
 };
 
 struct nvmap_platform_data {
@@ -66,6 +66,23 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+/*
+ * The low memory killer keeps thread group leaders sorted by oom_adj, it
+ * has to hear of new leaders, exits and oom_adj changes.
+ */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+extern void lowmem_task_update(struct task_struct *tsk);
+extern void lowmem_task_exit(struct task_struct *tsk);
+#else
+static inline void lowmem_task_update(struct task_struct *tsk)
+{
+}
+
+static inline void lowmem_task_exit(struct task_struct *tsk)
+{
+}
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
@@ -0,0 +1,63 @@
+/*
+ * include/linux/perflog.h
+ *
+ * Crash-persistent log of performance events
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_PERFLOG_H
+#define _LINUX_PERFLOG_H
+
+#include <linux/types.h>
+
+enum perflog_event {
+	PERFLOG_NONE,
+	PERFLOG_CLUSTER_SWITCH,	/* arg0: 1 if now on LP, arg1: power flags */
+	PERFLOG_THROTTLE,	/* arg0: cooling state, arg1: table size */
+	PERFLOG_THROTTLE_PID,	/* arg0: cpu cap kHz, arg1: core cap level */
+	PERFLOG_EMC_RATE,	/* arg0: new rate kHz */
+	PERFLOG_CBUS_RATE,	/* arg0: new rate kHz (3D, 2D, VDE, EPP) */
+	PERFLOG_LMK_KILL,	/* arg0: pid, arg1: oom_adj << 24 | pages */
+};
+
+/*
+ * Binary format of the record kept across a warm reboot and read back
+ * through pstore as perf-perflog-<boot>: a struct perflog_header
+ * followed by the entries of the previous boot, oldest first.
+ */
+struct perflog_entry {
+	u32 seq;		/* 1 for the first event of a boot */
+	u32 time;		/* sched_clock() >> 10, about us */
+	u16 event;
+	u16 cpu;
+	u32 arg0;
+	u32 arg1;
+};
+
+struct perflog_header {
+	u32 sig;
+	u32 boot;		/* warm boots since the buffer was set up */
+	u32 nr;			/* entries in the ring */
+	u32 reserved;
+};
+
+#ifdef CONFIG_PERFLOG
+extern int perflog_recording;
+extern void __perflog_record(u16 event, u32 arg0, u32 arg1);
+
+/* Note an event; costs a predicted branch unless the log is set up */
+static inline void perflog_record(u16 event, u32 arg0, u32 arg1)
+{
+	if (unlikely(perflog_recording))
+		__perflog_record(event, arg0, arg1);
+}
+#else
+static inline void perflog_record(u16 event, u32 arg0, u32 arg1)
+{
+}
+#endif
+
+#endif /* _LINUX_PERFLOG_H */
@@ -0,0 +1,25 @@
+#ifndef _LINUX_PREFETCH_TRACE_H
+#define _LINUX_PREFETCH_TRACE_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_PREFETCH_TRACE
+extern int prefetch_trace_recording;
+extern void __prefetch_trace_record(struct file *file, pgoff_t index,
+				    unsigned long nr);
+
+/* Note that pages index..index+nr-1 of file are being used */
+static inline void prefetch_trace_record(struct file *file, pgoff_t index,
+					 unsigned long nr)
+{
+	if (unlikely(prefetch_trace_recording))
+		__prefetch_trace_record(file, index, nr);
+}
+#else
+static inline void prefetch_trace_record(struct file *file, pgoff_t index,
+					 unsigned long nr)
+{
+}
+#endif
+
+#endif /* _LINUX_PREFETCH_TRACE_H */
@@ -140,6 +140,12 @@ extern unsigned long nr_running(void);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long avg_nr_running(void);
+extern unsigned long avg_cpu_nr_running(unsigned int cpu);
+extern unsigned long avg_cpu_nr_running_fg(unsigned int cpu);
+extern unsigned long avg_nr_running_fg(void);
+extern unsigned long avg_nr_background(void);
+extern unsigned long avg_nr_running_capacity(void);
+extern unsigned long arch_scale_cpu_capacity(int cpu);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
@@ -1237,6 +1243,15 @@ struct task_struct {
 	struct sched_entity se;
 	struct sched_rt_entity rt;
 
+#ifdef CONFIG_CPU_FREQ_SCHED
+	/* busy fraction over recent wakeups, SCHED_POWER_SCALE units */
+	unsigned int freq_util;
+	u64 freq_util_stamp;
+	u64 freq_util_exec;
+	/* input boost, in jiffies */
+	unsigned long freq_boost_expires;
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	/* list of struct preempt_notifier: */
 	struct hlist_head preempt_notifiers;
@@ -1281,6 +1296,9 @@ struct task_struct {
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	struct list_head lowmem_node;	/* leader on its oom_adj list */
+#endif
 
 	struct mm_struct *mm, *active_mm;
 #ifdef CONFIG_COMPAT_BRK
@@ -1305,6 +1323,8 @@ struct task_struct {
 	/* Revert to default priority/policy when forking */
 	unsigned sched_reset_on_fork:1;
 	unsigned sched_contributes_to_load:1;
+	/* counted in its runqueue's nr_background */
+	unsigned sched_background:1;
 
 	pid_t pid;
 	pid_t tgid;
@@ -1983,6 +2003,37 @@ extern void wake_up_idle_cpu(int cpu);
 static inline void wake_up_idle_cpu(int cpu) { }
 #endif
 
+/*
+ * Scheduler driven cpufreq. ->update() is called with the runqueue lock
+ * held whenever a task is enqueued on or dequeued from @cpu, @util being
+ * the busy fraction of @cpu in SCHED_POWER_SCALE units. It must not
+ * sleep or wake anything up; returning true gets ->kick() called shortly
+ * after from hardirq context on the same CPU, where it may.
+ */
+#define SCHED_FREQ_ENQUEUE	0x1
+#define SCHED_FREQ_DEQUEUE	0x2
+#define SCHED_FREQ_BOOST	0x4	/* task is under input boost */
+
+struct sched_freq_ops {
+	bool (*update)(int cpu, unsigned long util, unsigned int flags);
+	void (*kick)(void);
+};
+
+#ifdef CONFIG_CPU_FREQ_SCHED
+extern int sched_freq_register(struct sched_freq_ops *ops);
+extern void sched_freq_unregister(struct sched_freq_ops *ops);
+extern unsigned long sched_cpu_util(int cpu);
+extern unsigned int sched_freq_boost_ms;
+extern void sched_freq_boost_task(struct task_struct *p);
+#else
+static inline int sched_freq_register(struct sched_freq_ops *ops)
+{
+	return -ENOSYS;
+}
+static inline void sched_freq_unregister(struct sched_freq_ops *ops) { }
+static inline void sched_freq_boost_task(struct task_struct *p) { }
+#endif
+
 extern unsigned int sysctl_sched_latency;
 extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
@@ -2260,6 +2311,16 @@ extern long do_fork(unsigned long, unsigned long, struct pt_regs *, unsigned lon
 struct task_struct *fork_idle(int);
 
 extern void set_task_comm(struct task_struct *tsk, char *from);
+
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern unsigned long task_get_effective_timer_slack(struct task_struct *tsk);
+#else
+static inline unsigned long task_get_effective_timer_slack(
+		struct task_struct *tsk)
+{
+	return tsk->timer_slack_ns;
+}
+#endif
 extern char *get_task_comm(char *to, struct task_struct *tsk);
 
 #ifdef CONFIG_SMP
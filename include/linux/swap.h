@@ -148,6 +148,7 @@ enum {
 	SWP_SOLIDSTATE	= (1 << 4),	/* blkdev seeks are cheap */
 	SWP_CONTINUED	= (1 << 5),	/* swap_map has count continuation */
 	SWP_BLKDEV	= (1 << 6),	/* its a block device */
+	SWP_RAMBACKED	= (1 << 7),	/* blkdev is (compressed) RAM */
 					/* add others here before... */
 	SWP_SCANNING	= (1 << 8),	/* refcount in scan_swap_map */
 };
@@ -194,6 +195,12 @@ struct swap_info_struct {
 	struct block_device *bdev;	/* swap device or bdev of swap file */
 	struct file *swap_file;		/* seldom referenced */
 	unsigned int old_block_size;	/* seldom referenced */
+	int ra_order;			/* swapin readahead window, log2 */
+	unsigned int ra_probe;		/* swapins since last probe */
+	atomic_t ra_win_issued;		/* readahead pages this sample */
+	atomic_t ra_win_hits;		/* ... of which were faulted on */
+	atomic_long_t ra_issued;	/* readahead pages since swapon */
+	atomic_long_t ra_hits;		/* ... of which were faulted on */
 };
 
 struct swap_list_t {
@@ -334,6 +341,8 @@ extern void si_swapinfo(struct sysinfo *);
 extern swp_entry_t get_swap_page(void);
 extern swp_entry_t get_swap_page_of_type(int);
 extern int valid_swaphandles(swp_entry_t, unsigned long *);
+extern void swap_ra_issued(swp_entry_t, int);
+extern void swap_ra_hit(swp_entry_t);
 extern int add_swap_count_continuation(swp_entry_t, gfp_t);
 extern void swap_shmem_alloc(swp_entry_t);
 extern int swap_duplicate(swp_entry_t);
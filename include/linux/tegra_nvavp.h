@@ -19,6 +19,9 @@
 /* avp submit flags */
 #define NVAVP_FLAG_NONE		0x00000000
 #define NVAVP_UCODE_EXT		0x00000001 /*use external ucode provided */
+#define NVAVP_CMDBUF_MEM_FD	0x00000002 /* cmdbuf.mem is an nvmap share fd */
+/* return a fence for the submission in post_fence_fd, SUBMIT_FENCE only */
+#define NVAVP_POST_FENCE_FD	0x00000004
 
 enum {
 	NVAVP_MODULE_ID_AVP	= 2,
@@ -55,6 +58,19 @@ struct nvavp_pushbuffer_submit_hdr {
 	__u32			flags;
 };
 
+/*
+ * Submit that first waits for an nvhost sync point fence to signal. With
+ * NVAVP_POST_FENCE_FD, post_fence_fd returns an nvhost fence that signals
+ * once the AVP has executed the submission, or a negative errno if it could
+ * not be created; the submission is queued either way.
+ */
+struct nvavp_pushbuffer_submit_fence_hdr {
+	struct nvavp_pushbuffer_submit_hdr	hdr;
+	__s32					pre_fence_fd;
+	__s32					post_fence_fd;
+	__u32					reserved[2];
+};
+
 struct nvavp_set_nvmap_fd_args {
 	__u32 fd;
 };
@@ -64,6 +80,21 @@ struct nvavp_clock_args {
 	__u32 rate;
 };
 
+/*
+ * While a channel of higher priority has work queued, the submissions of
+ * the other channel are held back so that the AVP picks the former's up
+ * first; the AVP can't be preempted within a submission. Both channels
+ * start at NVAVP_PRIORITY_NORMAL.
+ */
+enum nvavp_channel_priority {
+	NVAVP_PRIORITY_NORMAL = 0,
+	NVAVP_PRIORITY_HIGH
+};
+
+struct nvavp_channel_priority_args {
+	__u32 priority;
+};
+
 enum nvavp_clock_stay_on_state {
 	NVAVP_CLOCK_STAY_ON_DISABLED = 0,
 	NVAVP_CLOCK_STAY_ON_ENABLED
@@ -81,6 +112,8 @@ struct nvavp_clock_stay_on_state_args {
 					__u32)
 #define NVAVP_IOCTL_PUSH_BUFFER_SUBMIT	_IOWR(NVAVP_IOCTL_MAGIC, 0x63, \
 					struct nvavp_pushbuffer_submit_hdr)
+/* setting any clock opts the session out of the driver's load based
+ * clock scaling */
 #define NVAVP_IOCTL_SET_CLOCK		_IOWR(NVAVP_IOCTL_MAGIC, 0x64, \
 					struct nvavp_clock_args)
 #define NVAVP_IOCTL_GET_CLOCK		_IOR(NVAVP_IOCTL_MAGIC, 0x65, \
@@ -93,8 +126,12 @@ struct nvavp_clock_stay_on_state_args {
 					struct nvavp_clock_args)
 #define NVAVP_IOCTL_DISABLE_AUDIO_CLOCKS _IOWR(NVAVP_IOCTL_MAGIC, 0x69, \
 					struct nvavp_clock_args)
+#define NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_FENCE _IOWR(NVAVP_IOCTL_MAGIC, 0x6a, \
+					struct nvavp_pushbuffer_submit_fence_hdr)
+#define NVAVP_IOCTL_SET_CHANNEL_PRIORITY _IOW(NVAVP_IOCTL_MAGIC, 0x6b, \
+					struct nvavp_channel_priority_args)
 
 #define NVAVP_IOCTL_MIN_NR		_IOC_NR(NVAVP_IOCTL_SET_NVMAP_FD)
-#define NVAVP_IOCTL_MAX_NR		_IOC_NR(NVAVP_IOCTL_DISABLE_AUDIO_CLOCKS)
+#define NVAVP_IOCTL_MAX_NR	_IOC_NR(NVAVP_IOCTL_SET_CHANNEL_PRIORITY)
 
 #endif /* __LINUX_TEGRA_NVAVP_H */
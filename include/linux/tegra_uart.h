@@ -46,5 +46,11 @@ void tegra_uart_request_clock_on(struct uart_port *);
 void tegra_uart_set_mctrl(struct uart_port *, unsigned int);
 void tegra_uart_request_clock_off(struct uart_port *uport);
 
+struct tty_struct;
+typedef void (*tegra_uart_rx_fn)(void *data, const unsigned char *buf,
+				 int count);
+int tegra_uart_set_rx_handler(struct tty_struct *tty, tegra_uart_rx_fn fn,
+			      void *data);
+
 #endif /* _TEGRA_UART_H_ */
 
@@ -37,6 +37,7 @@ struct therm_estimator {
 	long polling_period;
 	struct workqueue_struct *workqueue;
 	struct delayed_work therm_est_work;
+	struct delayed_work therm_est_idle_work;	/* deferrable */
 	long toffset;
 	int ntemp;
 	int ndevs;
@@ -67,6 +67,9 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+	int				tick_lazy;
+	unsigned long			lazy_restarts;
+	unsigned long			lazy_reprograms;
 };
 
 extern void __init tick_init(void);
@@ -322,6 +322,8 @@ struct usb_bus {
 	unsigned is_b_host:1;		/* true during some HNP roleswitches */
 	unsigned b_hnp_enable:1;	/* OTG: did A-Host enable HNP? */
 	unsigned sg_tablesize;		/* 0 or largest number of sg list entries */
+	unsigned dma_align;		/* 0 or alignment below which transfer
+					 * buffers are bounced by the HCD */
 
 	int devnum_next;		/* Next open device number in
 					 * round-robin allocation */
@@ -1379,6 +1381,9 @@ void *usb_alloc_coherent(struct usb_device *dev, size_t size,
 	gfp_t mem_flags, dma_addr_t *dma);
 void usb_free_coherent(struct usb_device *dev, size_t size,
 	void *addr, dma_addr_t dma);
+void *usb_alloc_aligned(struct usb_device *dev, size_t size,
+	gfp_t mem_flags);
+void usb_free_aligned(struct usb_device *dev, size_t size, void *addr);
 
 #if 0
 struct urb *usb_buffer_map(struct urb *urb);
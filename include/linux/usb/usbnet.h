@@ -47,6 +47,8 @@ struct usbnet {
 	u32			xid;
 	u32			hard_mtu;	/* count any extra framing */
 	size_t			rx_urb_size;	/* size for rx urbs */
+	size_t			tx_bundle_size;	/* 0, or max tx bundle */
+	unsigned		tx_sw_csum:1;	/* usbnet does tx checksums */
 	struct mii_if_info	mii;
 
 	/* various kinds of pending driver work */
@@ -57,6 +59,11 @@ struct usbnet {
 	struct urb		*interrupt;
 	struct usb_anchor	deferred;
 	struct tasklet_struct	bh;
+	struct napi_struct	napi;
+
+	/* tx frames gathered while urbs are in flight, under tx lock */
+	struct sk_buff		*tx_bundle;
+	unsigned		tx_bundle_packets;
 
 	struct work_struct	kevent;
 	unsigned long		flags;
@@ -201,6 +208,7 @@ struct skb_data {	/* skb->cb is one of these */
 	struct usbnet		*dev;
 	enum skb_state		state;
 	size_t			length;
+	unsigned		packets;
 };
 
 extern int usbnet_open(struct net_device *net);
@@ -99,6 +99,9 @@ struct soc_camera_host_ops {
 	int (*set_parm)(struct soc_camera_device *, struct v4l2_streamparm *);
 	int (*enum_fsizes)(struct soc_camera_device *, struct v4l2_frmsizeenum *);
 	unsigned int (*poll)(struct file *, poll_table *);
+	/* host private ioctls, arg is already copied into kernel space */
+	long (*default_ioctl)(struct soc_camera_device *, struct file *,
+			      int, void *);
 	const struct v4l2_queryctrl *controls;
 	int num_controls;
 };
@@ -17,6 +17,7 @@
 #define __TEGRA_DTV_H__
 
 #include <linux/ioctl.h>
+#include <linux/types.h>
 
 #define TEGRA_DTV_MAGIC 'v'
 
@@ -44,6 +45,40 @@ struct tegra_dtv_hw_config {
 #define TEGRA_DTV_IOCTL_GET_HW_CONFIG  _IOR(TEGRA_DTV_MAGIC, 3,		\
 					   struct tegra_dtv_hw_config *)
 
+/**
+ * Streaming ring, an alternative to read()
+ *
+ * RING_SETUP allocates a ring of num_periods * period_size bytes that
+ * the DMA keeps filling in a loop, and returns an nvmap share fd for it
+ * in fd. The ring can also be mmap()ed read-only from the dtv device.
+ * num_periods must be even, period_size a multiple of 4 up to 32KB.
+ * A num_periods of 0 frees the ring and goes back to read().
+ *
+ * After IOCTL_START, poll() reports POLLIN once a period past the
+ * consumed position is filled. RING_SYNC hands in consumed, the stream
+ * offset the reader is done with, and returns produced, the stream
+ * offset filled up to. Stream offset x is at ring offset x % ring size.
+ * A reader that falls more than ring size - period_size behind has had
+ * data overwritten and should carry on from produced. overruns counts
+ * that, and periods lost because the interrupt came too late.
+ */
+struct tegra_dtv_ring_config {
+	__u32 period_size;
+	__u32 num_periods;
+	__s32 fd;		/* out */
+};
+
+struct tegra_dtv_ring_pos {
+	__u64 produced;		/* out */
+	__u64 consumed;		/* in */
+	__u32 overruns;		/* out */
+};
+
+#define TEGRA_DTV_IOCTL_RING_SETUP     _IOWR(TEGRA_DTV_MAGIC, 4,	\
+					     struct tegra_dtv_ring_config)
+#define TEGRA_DTV_IOCTL_RING_SYNC      _IOWR(TEGRA_DTV_MAGIC, 5,	\
+					     struct tegra_dtv_ring_pos)
+
 /**
  * clock edge settings for clk_edge
  *
@@ -20,6 +20,7 @@
 #include <linux/regulator/consumer.h>
 #include <linux/i2c.h>
 #include <linux/nvhost.h>
+#include <linux/videodev2.h>
 
 enum tegra_camera_port {
 	TEGRA_CAMERA_PORT_CSI_A = 1,
@@ -42,4 +43,17 @@ struct tegra_camera_platform_data {
 
 };
 
+/*
+ * Exports a capture buffer (REQBUFS with V4L2_MEMORY_MMAP) as an nvmap
+ * share fd, which display and nvavp accept in place of a handle id.
+ */
+struct tegra_camera_expbuf {
+	__u32	index;
+	__u32	plane;
+	__s32	fd;	/* returned */
+};
+
+#define TEGRA_CAMERA_IOC_EXPBUF	_IOWR('V', BASE_VIDIOC_PRIVATE + 0, \
+				      struct tegra_camera_expbuf)
+
 #endif /* _TEGRA_CAMERA_H_ */
@@ -28,6 +28,8 @@ vb2_dma_nvmap_plane_paddr(struct vb2_buffer *vb, unsigned int plane_no)
 	return *paddr;
 }
 
+int vb2_dma_nvmap_share_fd(struct vb2_buffer *vb, unsigned int plane_no);
+
 void *vb2_dma_nvmap_init_ctx(struct device *dev);
 void vb2_dma_nvmap_cleanup_ctx(void *alloc_ctx);
 
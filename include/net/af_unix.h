@@ -14,6 +14,12 @@ extern struct sock *unix_get_socket(struct file *filp);
 
 #define UNIX_HASH_SIZE	256
 
+/* Upper bound for net.unix.stream_coalesce, the skb size small stream
+ * writes are gathered into */
+#define UNIX_STREAM_COALESCE_MAX	4096
+/* Largest single write that is a candidate for coalescing */
+#define UNIX_STREAM_COALESCE_WRITE	256
+
 extern unsigned int unix_tot_inflight;
 
 struct unix_address {
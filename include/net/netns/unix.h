@@ -4,10 +4,16 @@
 #ifndef __NETNS_UNIX_H__
 #define __NETNS_UNIX_H__
 
+#include <linux/atomic.h>
+
 struct ctl_table_header;
 struct netns_unix {
 	int			sysctl_max_dgram_qlen;
+	int			sysctl_stream_coalesce;
 	struct ctl_table_header	*ctl;
+	/* small stream writes appended to an skb already queued */
+	atomic_long_t		coalesced_writes;
+	atomic_long_t		coalesced_bytes;
 };
 
 #endif /* __NETNS_UNIX_H__ */
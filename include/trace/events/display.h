@@ -0,0 +1,65 @@
+/*
+ * include/trace/events/display.h
+ *
+ * Tegra display controller event logging to ftrace.
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM display
+
+#if !defined(_TRACE_DISPLAY_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_DISPLAY_H
+
+#include <linux/ktime.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(display_frame,
+	TP_PROTO(const char *name, u32 frame, u32 flips, u32 underflow_mask,
+		 u32 latency_us, s64 timestamp_ns),
+
+	TP_ARGS(name, frame, flips, underflow_mask, latency_us, timestamp_ns),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(u32, frame)
+		__field(u32, flips)
+		__field(u32, underflow_mask)
+		__field(u32, latency_us)
+		__field(s64, timestamp_ns)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->frame = frame;
+		__entry->flips = flips;
+		__entry->underflow_mask = underflow_mask;
+		__entry->latency_us = latency_us;
+		__entry->timestamp_ns = timestamp_ns;
+	),
+
+	TP_printk("name=%s, frame=%u, flips=%u, underflow_mask=%#x, latency_us=%u, timestamp_ns=%lld",
+	  __entry->name, __entry->frame, __entry->flips,
+	  __entry->underflow_mask, __entry->latency_us,
+	  __entry->timestamp_ns)
+);
+
+#endif /*  _TRACE_DISPLAY_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
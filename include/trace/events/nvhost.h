@@ -81,6 +81,27 @@ TRACE_EVENT(nvhost_channel_write_submit,
 	  __entry->syncpt_id, __entry->syncpt_incrs)
 );
 
+TRACE_EVENT(nvhost_ioctl_channel_submit_batch,
+	TP_PROTO(const char *name, int num_jobs, int err),
+
+	TP_ARGS(name, num_jobs, err),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(int, num_jobs)
+		__field(int, err)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->num_jobs = num_jobs;
+		__entry->err = err;
+	),
+
+	TP_printk("name=%s, num_jobs=%d, err=%d",
+		__entry->name, __entry->num_jobs, __entry->err)
+);
+
 TRACE_EVENT(nvhost_ioctl_channel_submit,
 	TP_PROTO(const char *name, u32 version, u32 cmdbufs, u32 relocs,
 		 u32 waitchks, u32 syncpt_id, u32 syncpt_incrs),
@@ -499,6 +520,36 @@ TRACE_EVENT(nvhost_channel_submit_complete,
 		__entry->hi_count, __entry->med_count, __entry->low_count)
 );
 
+TRACE_EVENT(nvhost_channel_job_latency,
+	TP_PROTO(const char *name, int clientid, u32 syncpt_id, u32 thresh,
+		u32 queue_us, u32 exec_us),
+
+	TP_ARGS(name, clientid, syncpt_id, thresh, queue_us, exec_us),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(int, clientid)
+		__field(u32, syncpt_id)
+		__field(u32, thresh)
+		__field(u32, queue_us)
+		__field(u32, exec_us)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->clientid = clientid;
+		__entry->syncpt_id = syncpt_id;
+		__entry->thresh = thresh;
+		__entry->queue_us = queue_us;
+		__entry->exec_us = exec_us;
+	),
+
+	TP_printk("name=%s, clientid=%d, syncpt_id=%u, thresh=%u, "
+		"queue_us=%u, exec_us=%u",
+		__entry->name, __entry->clientid, __entry->syncpt_id,
+		__entry->thresh, __entry->queue_us, __entry->exec_us)
+);
+
 TRACE_EVENT(nvhost_wait_cdma,
 	TP_PROTO(const char *name, u32 eventid),
 
@@ -5,6 +5,7 @@
 #define _TRACE_POWER_H
 
 #include <linux/ktime.h>
+#include <linux/device.h>
 #include <linux/tracepoint.h>
 
 DECLARE_EVENT_CLASS(cpu,
@@ -320,6 +321,58 @@ DEFINE_EVENT(clock, clock_unlock,
 	TP_ARGS(name, state, cpu_id)
 );
 
+TRACE_EVENT(clock_set_parent,
+
+	TP_PROTO(const char *name, const char *parent_name),
+
+	TP_ARGS(name, parent_name),
+
+	TP_STRUCT__entry(
+		__string(       name,           name            )
+		__string(       parent_name,    parent_name     )
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__assign_str(parent_name, parent_name);
+	),
+
+	TP_printk("%s parent=%s", __get_str(name), __get_str(parent_name))
+);
+
+/*
+ * Reported once a device system sleep callback has completed
+ */
+TRACE_EVENT(device_pm_report_time,
+
+	TP_PROTO(struct device *dev, const char *pm_ops, s64 ops_time,
+		 int event, int error),
+
+	TP_ARGS(dev, pm_ops, ops_time, event, error),
+
+	TP_STRUCT__entry(
+		__string(       device,         dev_name(dev)   )
+		__string(       driver,         dev_driver_string(dev) )
+		__string(       pm_ops,         pm_ops          )
+		__field(        s64,            ops_time        )
+		__field(        int,            event           )
+		__field(        int,            error           )
+	),
+
+	TP_fast_assign(
+		__assign_str(device, dev_name(dev));
+		__assign_str(driver, dev_driver_string(dev));
+		__assign_str(pm_ops, pm_ops);
+		__entry->ops_time = ops_time;
+		__entry->event = event;
+		__entry->error = error;
+	),
+
+	TP_printk("%s %s %s event=0x%x ops_time=%lld usecs err=%d",
+		__get_str(driver), __get_str(device), __get_str(pm_ops),
+		__entry->event, (long long)__entry->ops_time, __entry->error)
+);
+
 /*
  * The power domain events are used for power domains transitions
  */
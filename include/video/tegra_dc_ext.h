@@ -60,7 +60,22 @@
 #define TEGRA_DC_EXT_FLIP_FLAG_TILED	(1 << 2)
 #define TEGRA_DC_EXT_FLIP_FLAG_CURSOR	(1 << 3)
 #define TEGRA_DC_EXT_FLIP_FLAG_GLOBAL_ALPHA	(1 << 4)
+/* buff_id, buff_id_u and buff_id_v are nvmap share fds, not handle ids */
+#define TEGRA_DC_EXT_FLIP_FLAG_BUFF_FD	(1 << 5)
+/* wait for the nvhost fence in pre_fence_fd before scanning out the window */
+#define TEGRA_DC_EXT_FLIP_FLAG_PRE_FENCE_FD	(1 << 6)
+/*
+ * return an nvhost fence in post_fence_fd that signals once the window's
+ * previous buffer has been released; post_fence_fd is a negative errno if
+ * the fence could not be created, the flip itself is queued either way
+ */
+#define TEGRA_DC_EXT_FLIP_FLAG_POST_FENCE_FD	(1 << 7)
 
+/*
+ * Planar YUV formats read U and V from buff_id_u and buff_id_v, or from
+ * buff_id when those are zero, at offset_u and offset_v with stride_uv. The
+ * hardware has no semi-planar (NV12) formats.
+ */
 struct tegra_dc_ext_flip_windowattr {
 	__s32	index;
 	__u32	buff_id;
@@ -95,7 +110,9 @@ struct tegra_dc_ext_flip_windowattr {
 	__u8	global_alpha; /* requires TEGRA_DC_EXT_FLIP_FLAG_GLOBAL_ALPHA */
 	/* Leave some wiggle room for future expansion */
 	__u8	pad1[3];
-	__u32   pad2[4];
+	__s32	pre_fence_fd; /* requires TEGRA_DC_EXT_FLIP_FLAG_PRE_FENCE_FD */
+	__s32	post_fence_fd; /* with TEGRA_DC_EXT_FLIP_FLAG_POST_FENCE_FD */
+	__u32   pad2[2];
 };
 
 #define TEGRA_DC_EXT_FLIP_N_WINDOWS	3
@@ -160,6 +177,9 @@ struct tegra_dc_ext_cursor {
  * All three fields should be tightly packed, justified to the LSB of the
  * 16-bit value.  For example, the "s.2.8" value should be packed as:
  * (MSB) 5 bits of 0, 1 bit of sign, 2 bits of integer, 8 bits of frac (LSB)
+ *
+ * New coefficients take effect with the window's next flip, so setting them
+ * right before the first frame in a new colour space changes both at once.
  */
 struct tegra_dc_ext_csc {
 	__u32 win_index;
@@ -216,6 +236,41 @@ struct tegra_dc_ext_feature {
 	__u32 *entries;
 };
 
+/*
+ * Per-frame display statistics, recorded at each frame end (vblank in one
+ * shot mode) while the interrupt is enabled, i.e. whenever a flip is pending
+ * or someone waits for vblank.
+ *
+ * timestamp_ns: CLOCK_MONOTONIC time of the frame end
+ * frame: sequence number of the record
+ * flips: number of windows whose update was latched for this frame
+ * underflow_mask: bit n is set if window n underflowed since the previous
+ *      record
+ * latency_us: longest time from a latched update being programmed to the
+ *      frame end, 0 if nothing was latched
+ */
+struct tegra_dc_ext_frame_stat {
+	__s64 timestamp_ns;
+	__u32 frame;
+	__u32 flips;
+	__u32 underflow_mask;
+	__u32 latency_us;
+};
+
+/*
+ * start (in): first frame wanted; (out): first frame returned, which is
+ *      later than requested if older records were overwritten
+ * count (in): entries available in stats; (out): entries filled
+ * next (out): frame number the next record will get
+ */
+struct tegra_dc_ext_frame_stats {
+	__u32 start;
+	__u32 count;
+	struct tegra_dc_ext_frame_stat *stats;
+	__u32 next;
+	__u32 pad;
+};
+
 #define TEGRA_DC_EXT_SET_NVMAP_FD \
 	_IOW('D', 0x00, __s32)
 
@@ -255,6 +310,19 @@ struct tegra_dc_ext_feature {
 #define TEGRA_DC_EXT_GET_FEATURES \
 	_IOW('D', 0x0B, struct tegra_dc_ext_feature)
 
+#define TEGRA_DC_EXT_GET_FRAME_STATS \
+	_IOWR('D', 0x0C, struct tegra_dc_ext_frame_stats)
+
+/*
+ * Runs the checks of TEGRA_DC_EXT_FLIP without queuing anything, e.g. for a
+ * video player to find out whether the display can convert and scale its
+ * frames or they have to be composed first. Fails with -EINVAL for window
+ * attributes the hardware can't scan out and -ENOSPC for a configuration
+ * that needs more memory bandwidth than is available.
+ */
+#define TEGRA_DC_EXT_CHECK_FLIP \
+	_IOW('D', 0x0D, struct tegra_dc_ext_flip)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -29,4 +29,58 @@ struct tegra_fb_modedb {
 
 #define FBIO_TEGRA_GET_MODEDB	_IOWR('F', 0x42, struct tegra_fb_modedb)
 
+/* region of the virtual framebuffer written through an mmap, in pixels */
+struct tegra_fb_damage {
+	__u32 x;
+	__u32 y;
+	__u32 width;
+	__u32 height;
+};
+
+#define FBIO_TEGRA_DAMAGE	_IOW('F', 0x43, struct tegra_fb_damage)
+
+/*
+ * Setting yres_virtual to three or more times yres selects queued panning:
+ * FBIOPAN_DISPLAY then returns as soon as the pan is queued, and only blocks
+ * while yres_virtual / yres - 2 pans are already waiting for a vblank.
+ */
+
+/* wait until every queued pan is on screen instead of for the next vblank */
+#define TEGRA_FB_VBLANK_PANNED	(1 << 0)
+
+struct tegra_fb_vblank {
+	__u32 flags;
+	__u32 pans;		/* out: pans applied since the fb was probed */
+	__u64 timestamp_ns;	/* out: CLOCK_MONOTONIC time of the vblank */
+};
+
+#define FBIO_TEGRA_WAIT_VBLANK	_IOWR('F', 0x44, struct tegra_fb_vblank)
+
+/*
+ * Hardware cursor. The image is two 1bpp bitmaps immediately following each
+ * other, color then mask, combined as for TEGRA_DC_EXT_SET_CURSOR_IMAGE:
+ * 256 bytes for a 32x32 cursor, 1024 bytes for 64x64. Colors are 0x00rrggbb.
+ * Moving the cursor is latched at the next vblank without a window update.
+ */
+#define TEGRA_FB_CURSOR_SIZE_64x64	(1 << 0)
+
+struct tegra_fb_cursor_image {
+	__u32 flags;
+	__u32 foreground;
+	__u32 background;
+	__u8 *data;
+};
+
+#define TEGRA_FB_CURSOR_VISIBLE		(1 << 0)
+
+struct tegra_fb_cursor {
+	__u32 flags;
+	__s16 x;
+	__s16 y;
+};
+
+#define FBIO_TEGRA_CURSOR_IMAGE \
+	_IOW('F', 0x45, struct tegra_fb_cursor_image)
+#define FBIO_TEGRA_CURSOR	_IOW('F', 0x46, struct tegra_fb_cursor)
+
 #endif
@@ -8,6 +8,7 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/ktime.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -569,16 +570,28 @@ static void __init clean_rootfs(void)
 }
 #endif
 
+/* same, and log how long it took: decompression dominates boot here */
+static char * __init unpack_to_rootfs_timed(char *buf, unsigned len)
+{
+	ktime_t start = ktime_get();
+	char *err = unpack_to_rootfs(buf, len);
+
+	if (!err && len)
+		printk(KERN_INFO "initramfs: unpacked %u bytes in %lld us\n",
+		       len, ktime_us_delta(ktime_get(), start));
+	return err;
+}
+
 static int __init populate_rootfs(void)
 {
-	char *err = unpack_to_rootfs(__initramfs_start, __initramfs_size);
+	char *err = unpack_to_rootfs_timed(__initramfs_start, __initramfs_size);
 	if (err)
 		panic(err);	/* Failed to decompress INTERNAL initramfs */
 	if (initrd_start) {
 #ifdef CONFIG_BLK_DEV_RAM
 		int fd;
 		printk(KERN_INFO "Trying to unpack rootfs image as initramfs...\n");
-		err = unpack_to_rootfs((char *)initrd_start,
+		err = unpack_to_rootfs_timed((char *)initrd_start,
 			initrd_end - initrd_start);
 		if (!err) {
 			free_initrd();
@@ -599,7 +612,7 @@ static int __init populate_rootfs(void)
 		}
 #else
 		printk(KERN_INFO "Unpacking initramfs...\n");
-		err = unpack_to_rootfs((char *)initrd_start,
+		err = unpack_to_rootfs_timed((char *)initrd_start,
 			initrd_end - initrd_start);
 		if (err)
 			printk(KERN_EMERG "Initramfs unpacking failed: %s\n", err);
@@ -0,0 +1,111 @@
+/*
+ * kernel/cgroup_timer_slack.c
+ *
+ * Timer slack cgroup subsystem
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/err.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+/*
+ * Each group sets a lower bound for the timer slack of its tasks, on top of
+ * what the tasks ask for with PR_SET_TIMERSLACK. Putting background tasks in
+ * a group with a large bound lets their wakeups be coalesced.
+ */
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state css;
+	unsigned long min_slack_ns;
+};
+
+struct cgroup_subsys timer_slack_subsys;
+
+static inline struct timer_slack_cgroup *cgroup_to_tslack(struct cgroup *cgroup)
+{
+	return container_of(cgroup_subsys_state(cgroup, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+static inline struct timer_slack_cgroup *task_to_tslack(struct task_struct *tsk)
+{
+	return container_of(task_subsys_state(tsk, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+unsigned long task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	unsigned long slack;
+
+	rcu_read_lock();
+	slack = max(tsk->timer_slack_ns, task_to_tslack(tsk)->min_slack_ns);
+	rcu_read_unlock();
+
+	return slack;
+}
+
+static struct cgroup_subsys_state *tslack_create(struct cgroup_subsys *ss,
+						 struct cgroup *cgroup)
+{
+	struct timer_slack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	if (cgroup->parent)
+		tslack->min_slack_ns = cgroup_to_tslack(cgroup->parent)->min_slack_ns;
+	return &tslack->css;
+}
+
+static void tslack_destroy(struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	kfree(cgroup_to_tslack(cgroup));
+}
+
+static u64 tslack_read_min(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_to_tslack(cgroup)->min_slack_ns;
+}
+
+static int tslack_write_min(struct cgroup *cgroup, struct cftype *cft, u64 val)
+{
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	cgroup_to_tslack(cgroup)->min_slack_ns = val;
+	return 0;
+}
+
+static struct cftype files[] = {
+	{
+		.name = "min_slack_ns",
+		.read_u64 = tslack_read_min,
+		.write_u64 = tslack_write_min,
+	},
+};
+
+static int tslack_populate(struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	return cgroup_add_files(cgroup, ss, files, ARRAY_SIZE(files));
+}
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.create		= tslack_create,
+	.destroy	= tslack_destroy,
+	.populate	= tslack_populate,
+	.subsys_id	= timer_slack_subsys_id,
+};
@@ -1513,6 +1513,107 @@ static int __sched do_nanosleep(struct hrtimer_sleeper *t, enum hrtimer_mode mod
 	return t->task == NULL;
 }
 
+/*
+ * Timer coalescing: while the platform has an idle state that only pays
+ * off for long idle periods, the sleeps of non-RT tasks expire on the last
+ * multiple of the coalescing granularity their slack allows, so unrelated
+ * sleepers wake up together instead of one after another. The granularity
+ * is set by the platform idle code, 0 turns coalescing off.
+ */
+static unsigned long timer_coalesce_ns __read_mostly;
+
+struct timer_coalesce_cpu {
+	struct timer_coalesce_stats stats;
+	u64 last_boundary;
+	bool last_hrtimer;
+};
+static DEFINE_PER_CPU(struct timer_coalesce_cpu, timer_coalesce_cpu);
+
+void timer_coalesce_set(unsigned long granularity_ns)
+{
+	timer_coalesce_ns = granularity_ns;
+}
+EXPORT_SYMBOL_GPL(timer_coalesce_set);
+
+unsigned long timer_coalesce_granularity(void)
+{
+	return timer_coalesce_ns;
+}
+
+/*
+ * timer_coalesce_note - account a coalesced timer; one that lands on the
+ * same boundary as the previous one on this CPU is a wakeup saved.
+ */
+void timer_coalesce_note(bool hrtimer, u64 boundary)
+{
+	struct timer_coalesce_cpu *tc = &get_cpu_var(timer_coalesce_cpu);
+
+	if (hrtimer)
+		tc->stats.hrtimer_aligned++;
+	else
+		tc->stats.timer_aligned++;
+	if (tc->last_boundary == boundary && tc->last_hrtimer == hrtimer)
+		tc->stats.shared++;
+	tc->last_boundary = boundary;
+	tc->last_hrtimer = hrtimer;
+	put_cpu_var(timer_coalesce_cpu);
+}
+
+void timer_coalesce_get_stats(struct timer_coalesce_stats *stats)
+{
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+	for_each_possible_cpu(cpu) {
+		struct timer_coalesce_cpu *tc = &per_cpu(timer_coalesce_cpu, cpu);
+
+		stats->hrtimer_aligned += tc->stats.hrtimer_aligned;
+		stats->timer_aligned += tc->stats.timer_aligned;
+		stats->shared += tc->stats.shared;
+	}
+}
+EXPORT_SYMBOL_GPL(timer_coalesce_get_stats);
+
+/*
+ * hrtimer_coalesce_sleeper - move the hard expiry of the current task's
+ * CLOCK_MONOTONIC sleep down to a coalescing boundary within its slack.
+ * A relative timer is made absolute for that; the mode to start it with
+ * is returned.
+ */
+static enum hrtimer_mode hrtimer_coalesce_sleeper(struct hrtimer *timer,
+						  enum hrtimer_mode mode)
+{
+	unsigned long gran = timer_coalesce_ns;
+	ktime_t soft, hard;
+	u64 boundary;
+
+	if (!gran || rt_task(current) ||
+	    timer->base->clockid != CLOCK_MONOTONIC)
+		return mode;
+
+	soft = hrtimer_get_softexpires(timer);
+	hard = hrtimer_get_expires(timer);
+	if (ktime_to_ns(ktime_sub(hard, soft)) < gran)
+		return mode;
+
+	if (mode & HRTIMER_MODE_REL) {
+		ktime_t now = timer->base->get_time();
+
+		soft = ktime_add_safe(soft, now);
+		hard = ktime_add_safe(hard, now);
+		mode &= ~HRTIMER_MODE_REL;
+	}
+
+	/* the slack spans at least one granule, so this is not before soft */
+	boundary = ktime_to_ns(hard);
+	boundary -= do_div(boundary, gran);
+
+	hrtimer_set_expires_range_ns(timer, soft,
+				     boundary - ktime_to_ns(soft));
+	timer_coalesce_note(true, boundary);
+	return mode;
+}
+
 static int update_rmtp(struct hrtimer *timer, struct timespec __user *rmtp)
 {
 	struct timespec rmt;
@@ -1564,13 +1665,13 @@ long hrtimer_nanosleep(struct timespec *rqtp, struct timespec __user *rmtp,
 	int ret = 0;
 	unsigned long slack;
 
-	slack = current->timer_slack_ns;
+	slack = task_get_effective_timer_slack(current);
 	if (rt_task(current))
 		slack = 0;
 
 	hrtimer_init_on_stack(&t.timer, clockid, mode);
 	hrtimer_set_expires_range_ns(&t.timer, timespec_to_ktime(*rqtp), slack);
-	if (do_nanosleep(&t, mode))
+	if (do_nanosleep(&t, hrtimer_coalesce_sleeper(&t.timer, mode)))
 		goto out;
 
 	/* Absolute timers do not update the rmtp value and restart: */
@@ -1780,7 +1881,7 @@ schedule_hrtimeout_range_clock(ktime_t *expires, unsigned long delta,
 
 	hrtimer_init_sleeper(&t, current);
 
-	hrtimer_start_expires(&t.timer, mode);
+	hrtimer_start_expires(&t.timer, hrtimer_coalesce_sleeper(&t.timer, mode));
 	if (!hrtimer_active(&t.timer))
 		t.task = NULL;
 
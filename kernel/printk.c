@@ -41,6 +41,7 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -752,6 +753,31 @@ static int printk_time = 0;
 #endif
 module_param_named(time, printk_time, bool, S_IRUGO | S_IWUSR);
 
+/*
+ * Asynchronous console output: printk() only stores into the log buffer
+ * and printk_kthread feeds the consoles, in bounded chunks with interrupts
+ * enabled in between. Oops, panic, shutdown and messages printed before
+ * the thread exists still go out synchronously.
+ */
+#if defined(CONFIG_PRINTK_ASYNC)
+static int printk_async = 1;
+#else
+static int printk_async = 0;
+#endif
+module_param_named(async, printk_async, bool, S_IRUGO | S_IWUSR);
+
+#define PRINTK_ASYNC_CHUNK	256
+
+static struct task_struct *printk_kthread;
+
+static inline int printk_async_active(void)
+{
+	return printk_async && printk_kthread && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
+static void printk_kthread_kick(void);
+
 /* Check if we have any console registered that can be called early in boot. */
 static int have_callable_console(void)
 {
@@ -1011,8 +1037,14 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The console_trylock_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * In async mode leave all of that to printk_kthread.
 	 */
-	if (console_trylock_for_printk(this_cpu))
+	if (printk_async_active()) {
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		printk_kthread_kick();
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
@@ -1259,13 +1291,21 @@ int is_console_locked(void)
 	return console_locked;
 }
 
+#define PRINTK_PENDING_WAKEUP	0x01
+#define PRINTK_PENDING_OUTPUT	0x02
+
 static DEFINE_PER_CPU(int, printk_pending);
 
 void printk_tick(void)
 {
-	if (__this_cpu_read(printk_pending)) {
+	int pending = __this_cpu_read(printk_pending);
+
+	if (pending) {
 		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_OUTPUT)
+			wake_up_process(printk_kthread);
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
 	}
 }
 
@@ -1279,7 +1319,16 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
+}
+
+/*
+ * printk() can be called with runqueue locks held, so the thread is woken
+ * from the next tick like klogd. printk_needs_cpu() keeps that tick.
+ */
+static void printk_kthread_kick(void)
+{
+	this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
 }
 
 /**
@@ -1301,12 +1350,21 @@ void console_unlock(void)
 	unsigned long flags;
 	unsigned _con_start, _log_end;
 	unsigned wake_klogd = 0, retry = 0;
+	bool async = current == printk_kthread;
 
 	if (console_suspended) {
 		up(&console_sem);
 		return;
 	}
 
+	/* Output is printk_kthread's job, just hand it over */
+	if (!async && printk_async_active()) {
+		console_locked = 0;
+		up(&console_sem);
+		printk_kthread_kick();
+		return;
+	}
+
 	console_may_schedule = 0;
 
 again:
@@ -1317,12 +1375,16 @@ again:
 			break;			/* Nothing to print */
 		_con_start = con_start;
 		_log_end = log_end;
-		con_start = log_end;		/* Flush */
+		if (async && _log_end - _con_start > PRINTK_ASYNC_CHUNK)
+			_log_end = _con_start + PRINTK_ASYNC_CHUNK;
+		con_start = _log_end;		/* Flush */
 		spin_unlock(&logbuf_lock);
 		stop_critical_timings();	/* don't trace print latency */
 		call_console_drivers(_con_start, _log_end);
 		start_critical_timings();
 		local_irq_restore(flags);
+		if (async)
+			cond_resched();
 	}
 	console_locked = 0;
 
@@ -1669,6 +1731,35 @@ static int __init printk_late_init(void)
 }
 late_initcall(printk_late_init);
 
+static int printk_kthread_func(void *data)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (con_start == log_end)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(tsk)) {
+		pr_err("printk: unable to start console thread\n");
+		return PTR_ERR(tsk);
+	}
+	set_user_nice(tsk, 10);
+	printk_kthread = tsk;
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 #if defined CONFIG_PRINTK
 
 /*
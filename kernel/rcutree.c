@@ -1196,6 +1196,10 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 	if (!cpu_has_callbacks_ready_to_invoke(rdp))
 		return;
 
+	/* Let an rcuo kthread invoke them if this CPU is offloaded. */
+	if (rcu_nocb_offload(rsp, rdp))
+		return;
+
 	/*
 	 * Extract the list of ready callbacks, disabling to prevent
 	 * races with call_rcu() from interrupt handlers.
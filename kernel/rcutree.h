@@ -466,5 +466,6 @@ static void rcu_yield(void (*f)(unsigned long), unsigned long arg);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 static void rcu_cpu_kthread_setrt(int cpu, int to_rt);
 static void __cpuinit rcu_prepare_kthreads(int cpu);
+static bool rcu_nocb_offload(struct rcu_state *rsp, struct rcu_data *rdp);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
@@ -2008,3 +2008,182 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Queue of callbacks handed off by the offloaded CPUs of one leaf
+ * rcu_node, shared by all RCU flavors, and the kthread draining it.
+ * The rcu_node arrays of all flavors have the same shape, so the leaf's
+ * index into ->node[] selects the queue.
+ */
+struct rcu_nocb_queue {
+	raw_spinlock_t lock;
+	struct rcu_head *head;
+	struct rcu_head **tail;
+	wait_queue_head_t wq;
+	struct task_struct *kthread;
+	unsigned long n_invoked;
+};
+
+static struct rcu_nocb_queue rcu_nocb_queues[NUM_RCU_NODES];
+static struct cpumask rcu_nocb_mask;
+
+static int __init rcu_nocb_setup(char *str)
+{
+	if (cpulist_parse(str, &rcu_nocb_mask)) {
+		printk(KERN_WARNING "rcu_nocbs: invalid CPU list \"%s\"\n",
+		       str);
+		cpumask_clear(&rcu_nocb_mask);
+	}
+	return 0;
+}
+early_param("rcu_nocbs", rcu_nocb_setup);
+
+/*
+ * Move the callbacks whose grace period has ended from the specified
+ * CPU's rcu_data structure to its leaf's rcuo queue.  Returns false,
+ * leaving the callbacks in place, if the CPU is not offloaded or the
+ * rcuo kthread does not exist yet.  Called with interrupts enabled,
+ * on the CPU owning rdp, in the same contexts as rcu_do_batch().
+ */
+static bool rcu_nocb_offload(struct rcu_state *rsp, struct rcu_data *rdp)
+{
+	struct rcu_nocb_queue *q = &rcu_nocb_queues[rdp->mynode - rsp->node];
+	struct rcu_head *list, *p, **tail;
+	unsigned long flags;
+	long count = 0;
+	int i;
+
+	if (!cpumask_test_cpu(rdp->cpu, &rcu_nocb_mask) ||
+	    !ACCESS_ONCE(q->kthread))
+		return false;
+
+	local_irq_save(flags);
+	list = rdp->nxtlist;
+	rdp->nxtlist = *rdp->nxttail[RCU_DONE_TAIL];
+	*rdp->nxttail[RCU_DONE_TAIL] = NULL;
+	tail = rdp->nxttail[RCU_DONE_TAIL];
+	for (i = RCU_NEXT_SIZE - 1; i >= 0; i--)
+		if (rdp->nxttail[i] == tail)
+			rdp->nxttail[i] = &rdp->nxtlist;
+	local_irq_restore(flags);
+
+	/* The list is private now, count it with interrupts enabled. */
+	for (p = list; p; p = p->next)
+		count++;
+
+	local_irq_save(flags);
+	rdp->qlen -= count;
+	rdp->n_cbs_invoked += count;
+	if (rdp->blimit == LONG_MAX && rdp->qlen <= qlowmark)
+		rdp->blimit = blimit;
+	if (rdp->qlen == 0 && rdp->qlen_last_fqs_check != 0) {
+		rdp->qlen_last_fqs_check = 0;
+		rdp->n_force_qs_snap = rsp->n_force_qs;
+	} else if (rdp->qlen < rdp->qlen_last_fqs_check - qhimark)
+		rdp->qlen_last_fqs_check = rdp->qlen;
+
+	raw_spin_lock(&q->lock);
+	*q->tail = list;
+	q->tail = tail;
+	raw_spin_unlock_irqrestore(&q->lock, flags);
+
+	wake_up(&q->wq);
+	return true;
+}
+
+/*
+ * Invoke the callbacks handed off by the offloaded CPUs of one leaf
+ * rcu_node.  Callbacks expect to run with bottom halves disabled, as
+ * they would from RCU_SOFTIRQ.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_nocb_queue *q = arg;
+	struct rcu_head *list, *next;
+	unsigned long flags;
+
+	for (;;) {
+		wait_event_interruptible(q->wq, ACCESS_ONCE(q->head));
+
+		raw_spin_lock_irqsave(&q->lock, flags);
+		list = q->head;
+		q->head = NULL;
+		q->tail = &q->head;
+		raw_spin_unlock_irqrestore(&q->lock, flags);
+
+		while (list) {
+			next = list->next;
+			prefetch(next);
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			__rcu_reclaim(list);
+			local_bh_enable();
+			q->n_invoked++;
+			list = next;
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
+/*
+ * Spawn an rcuo kthread for each leaf rcu_node covering an offloaded
+ * CPU, affined to the CPUs that are not offloaded.  Until then the
+ * offloaded CPUs invoke their own callbacks.
+ */
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	struct rcu_state *rsp = &rcu_sched_state;
+	struct rcu_nocb_queue *q;
+	struct rcu_node *rnp;
+	struct task_struct *t;
+	cpumask_var_t cm;
+	char buf[32];
+	int cpu, i;
+
+	if (cpumask_empty(&rcu_nocb_mask))
+		return 0;
+	if (!alloc_cpumask_var(&cm, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_andnot(cm, cpu_possible_mask, &rcu_nocb_mask);
+
+	cpulist_scnprintf(buf, sizeof(buf), &rcu_nocb_mask);
+	printk(KERN_INFO "\tOffload RCU callbacks from CPUs: %s.\n", buf);
+
+	rcu_for_each_leaf_node(rsp, rnp) {
+		for (cpu = rnp->grplo; cpu <= rnp->grphi; cpu++)
+			if (cpumask_test_cpu(cpu, &rcu_nocb_mask))
+				break;
+		if (cpu > rnp->grphi)
+			continue;
+
+		i = rnp - rsp->node;
+		q = &rcu_nocb_queues[i];
+		raw_spin_lock_init(&q->lock);
+		q->tail = &q->head;
+		init_waitqueue_head(&q->wq);
+		t = kthread_create(rcu_nocb_kthread, q, "rcuo/%d", i);
+		if (IS_ERR(t))
+			continue;
+		if (!cpumask_empty(cm))
+			set_cpus_allowed_ptr(t, cm);
+		wake_up_process(t);
+		smp_mb(); /* Queue initialized before offloading starts. */
+		q->kthread = t;
+	}
+
+	free_cpumask_var(cm);
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool rcu_nocb_offload(struct rcu_state *rsp, struct rcu_data *rdp)
+{
+	return false;
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -279,6 +279,13 @@ struct task_group {
 #ifdef CONFIG_SCHED_AUTOGROUP
 	struct autogroup *autogroup;
 #endif
+
+	/*
+	 * Runnable tasks of a background group (or of its children) are
+	 * left out of the foreground load the hotplug and cluster policies
+	 * look at.
+	 */
+	bool background;
 };
 
 /* task_group_lock serializes the addition/removal of task groups */
@@ -475,7 +482,15 @@ struct rq {
 	/* time-based average load */
 	u64 nr_last_stamp;
 	unsigned int ave_nr_running;
+	/* part of nr_running from background task groups */
+	unsigned long nr_background;
+	unsigned int ave_nr_background;
 	seqcount_t ave_seqcnt;
+#ifdef CONFIG_CPU_FREQ_SCHED
+	/* time-based busy fraction, SCHED_POWER_SCALE units */
+	unsigned int util_avg;
+	struct hrtimer freq_kick_timer;
+#endif
 
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
@@ -1771,38 +1786,117 @@ static const struct sched_class rt_sched_class;
 #define NR_AVE_PERIOD		(1 << NR_AVE_PERIOD_EXP)
 #define NR_AVE_DIV_PERIOD(x)	((x) >> NR_AVE_PERIOD_EXP)
 
-static inline unsigned int do_avg_nr_running(struct rq *rq)
+static inline unsigned int __do_avg_nr(struct rq *rq, unsigned long count,
+				       unsigned int ave)
 {
 	s64 nr, deltax;
-	unsigned int ave_nr_running = rq->ave_nr_running;
 
 	deltax = rq->clock_task - rq->nr_last_stamp;
-	nr = NR_AVE_SCALE(rq->nr_running);
+	nr = NR_AVE_SCALE(count);
 
 	if (deltax > NR_AVE_PERIOD)
-		ave_nr_running = nr;
+		ave = nr;
 	else
-		ave_nr_running +=
-			NR_AVE_DIV_PERIOD(deltax * (nr - ave_nr_running));
+		ave += NR_AVE_DIV_PERIOD(deltax * (nr - ave));
 
-	return ave_nr_running;
+	return ave;
+}
+
+static inline unsigned int do_avg_nr_running(struct rq *rq)
+{
+	return __do_avg_nr(rq, rq->nr_running, rq->ave_nr_running);
+}
+
+static inline unsigned int do_avg_nr_background(struct rq *rq)
+{
+	return __do_avg_nr(rq, rq->nr_background, rq->ave_nr_background);
+}
+
+#ifdef CONFIG_CPU_FREQ_SCHED
+/* 24 ~= 16.8ms, short enough to follow the start of a burst */
+#define UTIL_AVG_PERIOD_EXP	24
+#define UTIL_AVG_PERIOD		(1 << UTIL_AVG_PERIOD_EXP)
+
+static inline unsigned int do_avg_util(struct rq *rq)
+{
+	s64 busy, deltax;
+	unsigned int util_avg = rq->util_avg;
+
+	deltax = rq->clock_task - rq->nr_last_stamp;
+	busy = rq->nr_running ? SCHED_POWER_SCALE : 0;
+
+	if (deltax > UTIL_AVG_PERIOD)
+		util_avg = busy;
+	else
+		util_avg += (deltax * (busy - util_avg)) >> UTIL_AVG_PERIOD_EXP;
+
+	return util_avg;
+}
+
+static inline void update_util_avg(struct rq *rq)
+{
+	rq->util_avg = do_avg_util(rq);
+}
+#else
+static inline void update_util_avg(struct rq *rq)
+{
+}
+#endif
+
+#ifdef CONFIG_CGROUP_SCHED
+/* number of task groups flagged background */
+static int sched_bg_groups;
+
+/*
+ * Evaluated when the task becomes runnable; a task moved between groups
+ * while on the runqueue is reclassified on its next wakeup.
+ */
+static inline bool task_is_background(struct task_struct *p)
+{
+	struct task_group *tg;
+
+	if (likely(!sched_bg_groups))
+		return false;
+
+	for (tg = task_group(p); tg; tg = tg->parent)
+		if (tg->background)
+			return true;
+	return false;
+}
+#else
+static inline bool task_is_background(struct task_struct *p)
+{
+	return false;
 }
+#endif
 
-static void inc_nr_running(struct rq *rq)
+static void inc_nr_running(struct rq *rq, struct task_struct *p)
 {
 	write_seqcount_begin(&rq->ave_seqcnt);
 	rq->ave_nr_running = do_avg_nr_running(rq);
+	rq->ave_nr_background = do_avg_nr_background(rq);
+	update_util_avg(rq);
 	rq->nr_last_stamp = rq->clock_task;
 	rq->nr_running++;
+	if (task_is_background(p)) {
+		p->sched_background = 1;
+		rq->nr_background++;
+	}
 	write_seqcount_end(&rq->ave_seqcnt);
 }
 
-static void dec_nr_running(struct rq *rq)
+static void dec_nr_running(struct rq *rq, struct task_struct *p)
 {
 	write_seqcount_begin(&rq->ave_seqcnt);
 	rq->ave_nr_running = do_avg_nr_running(rq);
+	rq->ave_nr_background = do_avg_nr_background(rq);
+	update_util_avg(rq);
 	rq->nr_last_stamp = rq->clock_task;
 	rq->nr_running--;
+	if (p->sched_background) {
+		p->sched_background = 0;
+		rq->nr_background--;
+	}
 	write_seqcount_end(&rq->ave_seqcnt);
 }
 
@@ -1838,6 +1932,181 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 	p->sched_class->dequeue_task(rq, p, flags);
 }
 
+#ifdef CONFIG_CPU_FREQ_SCHED
+static struct sched_freq_ops __rcu *sched_freq_ops;
+static DEFINE_MUTEX(sched_freq_mutex);
+
+/* how long a task stays boosted after reading input, 0 disables */
+unsigned int sched_freq_boost_ms;
+EXPORT_SYMBOL_GPL(sched_freq_boost_ms);
+
+/* delay before ->kick(), just enough to be out of the rq lock */
+#define SCHED_FREQ_KICK_NS	(20 * NSEC_PER_USEC)
+
+static inline bool task_freq_boosted(struct task_struct *p)
+{
+	return p->freq_boost_expires &&
+	       time_before(jiffies, p->freq_boost_expires);
+}
+
+void sched_freq_boost_task(struct task_struct *p)
+{
+	unsigned int ms = ACCESS_ONCE(sched_freq_boost_ms);
+
+	if (ms)
+		p->freq_boost_expires = (jiffies + msecs_to_jiffies(ms)) | 1;
+}
+EXPORT_SYMBOL_GPL(sched_freq_boost_task);
+
+/*
+ * A boosted task hands what is left of its boost to the tasks it wakes,
+ * so the whole chain from input reader to the drawing thread runs fast.
+ * Wakeups from interrupts have nothing to do with the interrupted task.
+ */
+static inline void sched_freq_inherit_boost(struct task_struct *p)
+{
+	if (!in_interrupt() && task_freq_boosted(current) &&
+	    time_after(current->freq_boost_expires, p->freq_boost_expires))
+		p->freq_boost_expires = current->freq_boost_expires;
+}
+
+/*
+ * Fraction of the time the task ran between its last two wakeups,
+ * averaged. A task waking on an idle CPU brings its demand along with it
+ * instead of the CPU average having to build up first.
+ */
+static void update_task_util(struct rq *rq, struct task_struct *p)
+{
+	u64 period = rq->clock_task - p->freq_util_stamp;
+	u64 ran = p->se.sum_exec_runtime - p->freq_util_exec;
+	u32 util;
+
+	p->freq_util_stamp = rq->clock_task;
+	p->freq_util_exec = p->se.sum_exec_runtime;
+
+	/* clock_task is per rq, across a migration the period is garbage */
+	if ((s64)period < 1024)
+		return;
+
+	if (ran > period)
+		ran = period;
+	while (period >> 31) {
+		period >>= 1;
+		ran >>= 1;
+	}
+
+	util = ((u32)ran >> 10) * SCHED_POWER_SCALE / ((u32)period >> 10);
+	p->freq_util = (3 * p->freq_util + util) >> 2;
+}
+
+static enum hrtimer_restart sched_freq_kick_fn(struct hrtimer *timer)
+{
+	struct sched_freq_ops *ops = rcu_dereference_sched(sched_freq_ops);
+
+	if (ops)
+		ops->kick();
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Called with rq->lock held and irqs disabled. The governor cannot wake
+ * its thread from here, so defer to a timer on this CPU the same way
+ * hrtick does.
+ */
+static void sched_freq_update(struct rq *rq, struct task_struct *p,
+			      unsigned int flags)
+{
+	struct sched_freq_ops *ops = rcu_dereference_sched(sched_freq_ops);
+	struct hrtimer *timer = &this_rq()->freq_kick_timer;
+	unsigned long util = rq->util_avg;
+
+	if (!ops)
+		return;
+
+	if (flags & SCHED_FREQ_ENQUEUE) {
+		update_task_util(rq, p);
+		util = max(util, (unsigned long)p->freq_util);
+		if (task_freq_boosted(p))
+			flags |= SCHED_FREQ_BOOST;
+	}
+
+	if (ops->update(cpu_of(rq), util, flags) && !hrtimer_active(timer))
+		__hrtimer_start_range_ns(timer, ns_to_ktime(SCHED_FREQ_KICK_NS),
+					 0, HRTIMER_MODE_REL_PINNED, 0);
+}
+
+/* Current busy fraction of @cpu; an idle CPU needs no speed at all. */
+unsigned long sched_cpu_util(int cpu)
+{
+	unsigned int seqcnt, util_avg;
+	struct rq *q = cpu_rq(cpu);
+
+	if (!q->nr_running)
+		return 0;
+
+	seqcnt = read_seqcount_begin(&q->ave_seqcnt);
+	util_avg = do_avg_util(q);
+	if (read_seqcount_retry(&q->ave_seqcnt, seqcnt)) {
+		read_seqcount_begin(&q->ave_seqcnt);
+		util_avg = q->util_avg;
+	}
+
+	return util_avg;
+}
+EXPORT_SYMBOL_GPL(sched_cpu_util);
+
+int sched_freq_register(struct sched_freq_ops *ops)
+{
+	int ret = 0;
+
+	mutex_lock(&sched_freq_mutex);
+	if (rcu_access_pointer(sched_freq_ops))
+		ret = -EBUSY;
+	else
+		rcu_assign_pointer(sched_freq_ops, ops);
+	mutex_unlock(&sched_freq_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sched_freq_register);
+
+void sched_freq_unregister(struct sched_freq_ops *ops)
+{
+	int cpu;
+
+	mutex_lock(&sched_freq_mutex);
+	if (rcu_access_pointer(sched_freq_ops) == ops) {
+		rcu_assign_pointer(sched_freq_ops, NULL);
+		synchronize_sched();
+		for_each_possible_cpu(cpu)
+			hrtimer_cancel(&cpu_rq(cpu)->freq_kick_timer);
+	}
+	mutex_unlock(&sched_freq_mutex);
+}
+EXPORT_SYMBOL_GPL(sched_freq_unregister);
+
+static void init_rq_freq(struct rq *rq)
+{
+	rq->util_avg = 0;
+	hrtimer_init(&rq->freq_kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rq->freq_kick_timer.function = sched_freq_kick_fn;
+}
+#else
+static inline void sched_freq_inherit_boost(struct task_struct *p)
+{
+}
+
+static inline void sched_freq_update(struct rq *rq, struct task_struct *p,
+				     unsigned int flags)
+{
+}
+
+static inline void init_rq_freq(struct rq *rq)
+{
+}
+#endif /* CONFIG_CPU_FREQ_SCHED */
+
 /*
  * activate_task - move a task to the runqueue.
  */
@@ -1847,7 +2116,8 @@ static void activate_task(struct rq *rq, struct task_struct *p, int flags)
 		rq->nr_uninterruptible--;
 
 	enqueue_task(rq, p, flags);
-	inc_nr_running(rq);
+	inc_nr_running(rq, p);
+	sched_freq_update(rq, p, SCHED_FREQ_ENQUEUE);
 }
 
 /*
@@ -1859,7 +2129,8 @@ static void deactivate_task(struct rq *rq, struct task_struct *p, int flags)
 		rq->nr_uninterruptible++;
 
 	dequeue_task(rq, p, flags);
-	dec_nr_running(rq);
+	dec_nr_running(rq, p);
+	sched_freq_update(rq, p, SCHED_FREQ_DEQUEUE);
 }
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -2736,6 +3007,7 @@ try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 
 	success = 1; /* we're going to change ->state */
 	cpu = task_cpu(p);
+	sched_freq_inherit_boost(p);
 
 	if (p->on_rq && ttwu_remote(p, wake_flags))
 		goto stat;
@@ -2870,6 +3142,12 @@ static void __sched_fork(struct task_struct *p)
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
+
+#ifdef CONFIG_CPU_FREQ_SCHED
+	p->freq_util = 0;
+	p->freq_util_stamp = 0;
+	p->freq_util_exec = 0;
+#endif
 }
 
 /*
@@ -2881,6 +3159,8 @@ void sched_fork(struct task_struct *p)
 	int cpu = get_cpu();
 
 	__sched_fork(p);
+	/* not on any runqueue yet, whatever the parent's state */
+	p->sched_background = 0;
 	/*
 	 * We mark the process as running here. This guarantees that
 	 * nobody will actually run it, and a signal or other external
@@ -3322,6 +3602,96 @@ unsigned long avg_nr_running(void)
 	return sum;
 }
 
+unsigned long avg_cpu_nr_running(unsigned int cpu)
+{
+	unsigned int seqcnt, ave_nr_running;
+	struct rq *q = cpu_rq(cpu);
+
+	seqcnt = read_seqcount_begin(&q->ave_seqcnt);
+	ave_nr_running = do_avg_nr_running(q);
+	if (read_seqcount_retry(&q->ave_seqcnt, seqcnt)) {
+		read_seqcount_begin(&q->ave_seqcnt);
+		ave_nr_running = q->ave_nr_running;
+	}
+
+	return ave_nr_running;
+}
+EXPORT_SYMBOL(avg_cpu_nr_running);
+
+/*
+ * Average runnable tasks on @cpu that do not belong to a background task
+ * group, FSHIFT fixed point.  Equal to avg_cpu_nr_running() when no group
+ * is flagged background.
+ */
+unsigned long avg_cpu_nr_running_fg(unsigned int cpu)
+{
+	unsigned int seqcnt, ave_nr_running, ave_nr_background;
+	struct rq *q = cpu_rq(cpu);
+
+	seqcnt = read_seqcount_begin(&q->ave_seqcnt);
+	ave_nr_running = do_avg_nr_running(q);
+	ave_nr_background = do_avg_nr_background(q);
+	if (read_seqcount_retry(&q->ave_seqcnt, seqcnt)) {
+		read_seqcount_begin(&q->ave_seqcnt);
+		ave_nr_running = q->ave_nr_running;
+		ave_nr_background = q->ave_nr_background;
+	}
+
+	if (ave_nr_background >= ave_nr_running)
+		return 0;
+	return ave_nr_running - ave_nr_background;
+}
+EXPORT_SYMBOL(avg_cpu_nr_running_fg);
+
+unsigned long avg_nr_running_fg(void)
+{
+	unsigned long i, sum = 0;
+
+	for_each_online_cpu(i)
+		sum += avg_cpu_nr_running_fg(i);
+
+	return sum;
+}
+EXPORT_SYMBOL(avg_nr_running_fg);
+
+unsigned long avg_nr_background(void)
+{
+	unsigned long i, sum = 0;
+
+	for_each_online_cpu(i)
+		sum += avg_cpu_nr_running(i) - avg_cpu_nr_running_fg(i);
+
+	return sum;
+}
+EXPORT_SYMBOL(avg_nr_background);
+
+/*
+ * Capacity of the core type @cpu is currently running on, relative to the
+ * biggest core in the system (SCHED_POWER_SCALE). Architectures with
+ * asymmetric cores, e.g. a slower companion core, override this.
+ */
+unsigned long __weak arch_scale_cpu_capacity(int cpu)
+{
+	return SCHED_POWER_SCALE;
+}
+
+/*
+ * Like avg_nr_running_fg(), but each CPU's average is weighted by its
+ * capacity, so the result is the foreground runnable demand in units of
+ * full-speed cores (FSHIFT fixed point).
+ */
+unsigned long avg_nr_running_capacity(void)
+{
+	unsigned long i, sum = 0;
+
+	for_each_online_cpu(i)
+		sum += (avg_cpu_nr_running_fg(i) *
+			arch_scale_cpu_capacity(i)) >> SCHED_POWER_SHIFT;
+
+	return sum;
+}
+EXPORT_SYMBOL(avg_nr_running_capacity);
+
 unsigned long nr_iowait_cpu(int cpu)
 {
 	struct rq *this = cpu_rq(cpu);
@@ -8205,6 +8575,7 @@ void __init sched_init(void)
 #endif
 #endif
 		init_rq_hrtick(rq);
+		init_rq_freq(rq);
 		atomic_set(&rq->nr_iowait, 0);
 	}
 
@@ -9025,11 +9396,19 @@ cpu_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cgrp)
 	return &tg->css;
 }
 
+/* serializes cpu.background updates against sched_bg_groups */
+static DEFINE_MUTEX(cpu_background_mutex);
+
 static void
 cpu_cgroup_destroy(struct cgroup_subsys *ss, struct cgroup *cgrp)
 {
 	struct task_group *tg = cgroup_tg(cgrp);
 
+	mutex_lock(&cpu_background_mutex);
+	if (tg->background)
+		sched_bg_groups--;
+	mutex_unlock(&cpu_background_mutex);
+
 	sched_destroy_group(tg);
 }
 
@@ -9121,7 +9500,35 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+static int cpu_background_write_u64(struct cgroup *cgrp, struct cftype *cft,
+				    u64 val)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	mutex_lock(&cpu_background_mutex);
+	if (tg->background != !!val) {
+		tg->background = !!val;
+		sched_bg_groups += val ? 1 : -1;
+	}
+	mutex_unlock(&cpu_background_mutex);
+
+	return 0;
+}
+
+static u64 cpu_background_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->background;
+}
+
 static struct cftype cpu_files[] = {
+	{
+		.name = "background",
+		.read_u64 = cpu_background_read_u64,
+		.write_u64 = cpu_background_write_u64,
+	},
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
 		.name = "shares",
@@ -2643,6 +2643,9 @@ static void update_cpu_power(struct sched_domain *sd, int cpu)
 		power >>= SCHED_POWER_SHIFT;
 	}
 
+	power *= arch_scale_cpu_capacity(cpu);
+	power >>= SCHED_POWER_SHIFT;
+
 	sdg->sgp->power_orig = power;
 
 	if (sched_feat(ARCH_POWER))
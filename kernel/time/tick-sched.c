@@ -123,6 +123,28 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_LAZY_TICKS
+static int tick_nohz_lazy_ticks __read_mostly = CONFIG_NO_HZ_LAZY_TICKS;
+#else
+static int tick_nohz_lazy_ticks __read_mostly;
+#endif
+
+/*
+ * Number of ticks a cpu may run after idle exit before the periodic
+ * tick is forced back on, 0 restarts the tick right away
+ */
+static int __init setup_tick_nohz_lazy(char *str)
+{
+	int ticks;
+
+	if (get_option(&str, &ticks) != 1 || ticks < 0)
+		return 0;
+	tick_nohz_lazy_ticks = ticks;
+	return 1;
+}
+
+__setup("nohz_lazy=", setup_tick_nohz_lazy);
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -334,9 +356,11 @@ void tick_nohz_stop_sched_tick(int inidle)
 	}
 	/*
 	 * Do not stop the tick, if we are only one off
-	 * or if the cpu is required for rcu
+	 * or if the cpu is required for rcu. A lazily restarted
+	 * tick might be armed further out than that, so it has
+	 * to be brought in.
 	 */
-	if (!ts->tick_stopped && delta_jiffies == 1)
+	if (!ts->tick_stopped && !ts->tick_lazy && delta_jiffies == 1)
 		goto out;
 
 	/* Schedule the tick, if we are at least one jiffie off */
@@ -408,6 +432,7 @@ void tick_nohz_stop_sched_tick(int inidle)
 
 			ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
 			ts->tick_stopped = 1;
+			ts->tick_lazy = 0;
 			ts->idle_jiffies = last_jiffies;
 			rcu_enter_nohz();
 		}
@@ -490,6 +515,54 @@ static void tick_nohz_restart(struct tick_sched *ts, ktime_t now)
 	}
 }
 
+/*
+ * Restart the tick lazily: leave the sched timer armed when it already
+ * expires within tick_nohz_lazy_ticks, otherwise program it to the end
+ * of that window. The tick becomes periodic again once the sched timer
+ * fires, so a cpu which goes back to idle before that neither takes a
+ * tick nor reprograms its local timer twice.
+ *
+ * Not done when rcu, printk or the arch need this cpu to tick, or when
+ * no cpu has the do_timer duty, as jiffies would go stale meanwhile.
+ */
+static bool tick_nohz_restart_lazy(struct tick_sched *ts, int cpu,
+				   ktime_t now)
+{
+	ktime_t limit;
+
+	if (!tick_nohz_lazy_ticks || ts->nohz_mode != NOHZ_MODE_HIGHRES)
+		return false;
+	if (tick_do_timer_cpu == TICK_DO_TIMER_NONE)
+		return false;
+	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
+	    arch_needs_cpu(cpu))
+		return false;
+
+	limit = ktime_add_ns(now, (u64)tick_nohz_lazy_ticks *
+			     tick_period.tv64);
+
+	if (hrtimer_active(&ts->sched_timer) &&
+	    hrtimer_get_expires(&ts->sched_timer).tv64 <= limit.tv64) {
+		ts->lazy_restarts++;
+		ts->tick_lazy = 1;
+		return true;
+	}
+
+	hrtimer_cancel(&ts->sched_timer);
+	hrtimer_set_expires(&ts->sched_timer, ts->idle_tick);
+	hrtimer_forward(&ts->sched_timer, now, tick_period);
+	hrtimer_add_expires_ns(&ts->sched_timer,
+			       (u64)(tick_nohz_lazy_ticks - 1) *
+			       tick_period.tv64);
+	hrtimer_start_expires(&ts->sched_timer, HRTIMER_MODE_ABS_PINNED);
+	if (!hrtimer_active(&ts->sched_timer))
+		return false;
+
+	ts->lazy_reprograms++;
+	ts->tick_lazy = 1;
+	return true;
+}
+
 /**
  * tick_nohz_restart_sched_tick - restart the idle tick from the idle task
  *
@@ -547,7 +620,8 @@ void tick_nohz_restart_sched_tick(void)
 	ts->tick_stopped  = 0;
 	ts->idle_exittime = now;
 
-	tick_nohz_restart(ts, now);
+	if (!tick_nohz_restart_lazy(ts, cpu, now))
+		tick_nohz_restart(ts, now);
 
 	local_irq_enable();
 }
@@ -760,6 +834,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 		profile_tick(CPU_PROFILING);
 	}
 
+	/* A lazily restarted tick is periodic again from here on */
+	ts->tick_lazy = 0;
 	hrtimer_forward(timer, now, tick_period);
 
 	return HRTIMER_RESTART;
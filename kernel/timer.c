@@ -1468,6 +1468,16 @@ signed long __sched schedule_timeout(signed long timeout)
 	expire = timeout + jiffies;
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
+	if (timer_coalesce_granularity() && !rt_task(current)) {
+		unsigned long slack = nsecs_to_jiffies(
+			task_get_effective_timer_slack(current));
+
+		if (slack) {
+			set_timer_slack(&timer, slack);
+			expire = apply_slack(&timer, expire);
+			timer_coalesce_note(false, expire);
+		}
+	}
 	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
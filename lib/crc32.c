@@ -28,13 +28,13 @@
 #include <linux/init.h>
 #include <linux/atomic.h>
 #include "crc32defs.h"
-#if CRC_LE_BITS == 8
+#if CRC_LE_BITS >= 8
 # define tole(x) __constant_cpu_to_le32(x)
 #else
 # define tole(x) (x)
 #endif
 
-#if CRC_BE_BITS == 8
+#if CRC_BE_BITS >= 8
 # define tobe(x) __constant_cpu_to_be32(x)
 #else
 # define tobe(x) (x)
@@ -42,29 +42,46 @@
 #include "crc32table.h"
 
 MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
-MODULE_DESCRIPTION("Ethernet CRC32 calculations");
+MODULE_DESCRIPTION("Ethernet CRC32 and CRC32c calculations");
 MODULE_LICENSE("GPL");
 
-#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
+#if CRC_LE_BITS >= 8 || CRC_BE_BITS >= 8
 
+/*
+ * rows is 4 or 8, a constant at each call site.  With 8 tables two words
+ * are folded in per iteration ("slice by 8"): the first one, xor'ed with
+ * the crc, goes through tab[7]..tab[4] and the second one through
+ * tab[3]..tab[0], so twice the table lookups are in flight per loop
+ * dependency on crc.
+ */
 static inline u32
-crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
+crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256],
+	   const int rows)
 {
 # ifdef __LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
-#  define DO_CRC4 crc = tab[3][(crc) & 255] ^ \
-		tab[2][(crc >> 8) & 255] ^ \
-		tab[1][(crc >> 16) & 255] ^ \
-		tab[0][(crc >> 24) & 255]
+#  define DO_CRC4 (tab[3][(q) & 255] ^ \
+		tab[2][(q >> 8) & 255] ^ \
+		tab[1][(q >> 16) & 255] ^ \
+		tab[0][(q >> 24) & 255])
+#  define DO_CRC8 (tab[7][(q) & 255] ^ \
+		tab[6][(q >> 8) & 255] ^ \
+		tab[5][(q >> 16) & 255] ^ \
+		tab[4][(q >> 24) & 255])
 # else
 #  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
-#  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
-		tab[1][(crc >> 8) & 255] ^ \
-		tab[2][(crc >> 16) & 255] ^ \
-		tab[3][(crc >> 24) & 255]
+#  define DO_CRC4 (tab[0][(q) & 255] ^ \
+		tab[1][(q >> 8) & 255] ^ \
+		tab[2][(q >> 16) & 255] ^ \
+		tab[3][(q >> 24) & 255])
+#  define DO_CRC8 (tab[4][(q) & 255] ^ \
+		tab[5][(q >> 8) & 255] ^ \
+		tab[6][(q >> 16) & 255] ^ \
+		tab[7][(q >> 24) & 255])
 # endif
 	const u32 *b;
 	size_t    rem_len;
+	u32	  q;
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -72,13 +89,25 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 			DO_CRC(*buf++);
 		} while ((--len) && ((long)buf)&3);
 	}
-	rem_len = len & 3;
-	/* load data 32 bits wide, xor data 32 bits wide. */
-	len = len >> 2;
 	b = (const u32 *)buf;
-	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+	if (rows == 8) {
+		rem_len = len & 7;
+		/* load data 2 x 32 bits wide, xor the crc into the first. */
+		len = len >> 3;
+		for (--b; len; --len) {
+			q = crc ^ *++b; /* use pre increment for speed */
+			crc = DO_CRC8;
+			q = *++b;
+			crc ^= DO_CRC4;
+		}
+	} else {
+		rem_len = len & 3;
+		/* load data 32 bits wide, xor data 32 bits wide. */
+		len = len >> 2;
+		for (--b; len; --len) {
+			q = crc ^ *++b; /* use pre increment for speed */
+			crc = DO_CRC4;
+		}
 	}
 	len = rem_len;
 	/* And the last few bytes */
@@ -91,6 +120,7 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	return crc;
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8
 }
 #endif
 /**
@@ -122,11 +152,11 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 
 u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_LE_BITS == 8
-	const u32      (*tab)[] = crc32table_le;
+# if CRC_LE_BITS >= 8
+	const u32      (*tab)[256] = crc32table_le;
 
 	crc = __cpu_to_le32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = crc32_body(crc, p, len, tab, LE_TABLE_ROWS);
 	return __le32_to_cpu(crc);
 # elif CRC_LE_BITS == 4
 	while (len--) {
@@ -179,11 +209,11 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 #else				/* Table-based approach */
 u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_BE_BITS == 8
-	const u32      (*tab)[] = crc32table_be;
+# if CRC_BE_BITS >= 8
+	const u32      (*tab)[256] = crc32table_be;
 
 	crc = __cpu_to_be32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = crc32_body(crc, p, len, tab, BE_TABLE_ROWS);
 	return __be32_to_cpu(crc);
 # elif CRC_BE_BITS == 4
 	while (len--) {
@@ -205,8 +235,44 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 }
 #endif
 
+/**
+ * __crc32c_le() - Calculate the little-endian Castagnoli CRC32c
+ * @crc: seed value for computation.  ~0 for iSCSI, SCTP and btrfs, or the
+ *	previous crc32c value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ *
+ * Same as crc32_le(), with CRC32C_POLY_LE instead of CRCPOLY_LE.  Most
+ * users want crc32c() from <linux/crc32c.h>, which goes through the crypto
+ * API and so picks up accelerated versions.
+ */
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
+#if CRC_LE_BITS < 8
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY_LE : 0);
+	}
+	return crc;
+}
+#else
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	const u32      (*tab)[256] = crc32ctable_le;
+
+	crc = __cpu_to_le32(crc);
+	crc = crc32_body(crc, p, len, tab, LE_TABLE_ROWS);
+	return __le32_to_cpu(crc);
+}
+#endif
+
 EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(crc32_be);
+EXPORT_SYMBOL(__crc32c_le);
 
 /*
  * A brief CRC tutorial.
@@ -0,0 +1,162 @@
+/*
+ * LZ4 decompressor for the kernel image, initramfs and initrd.
+ *
+ * Reads the legacy frame format written by "lz4c -l": a little endian
+ * magic number followed by blocks, each preceded by its little endian
+ * compressed size and expanding to at most 8MB.  The blocks themselves
+ * are decoded by lib/lz4.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifdef STATIC
+#include "lz4/lz4_decompress.c"
+#else
+#include <linux/decompress/unlz4.h>
+#endif
+
+#include <linux/types.h>
+#include <linux/lz4.h>
+#include <linux/decompress/mm.h>
+
+#include <linux/compiler.h>
+#include <asm/unaligned.h>
+
+#define LZ4_LEGACY_MAGIC	0x184c2102
+#define LZ4_LEGACY_BLOCK_SIZE	(8 << 20)
+
+STATIC inline int INIT unlz4(u8 *input, int in_len,
+				int (*fill) (void *, unsigned int),
+				int (*flush) (void *, unsigned int),
+				u8 *output, int *posp,
+				void (*error) (char *x))
+{
+	const u32 in_max = lz4_compressbound(LZ4_LEGACY_BLOCK_SIZE);
+	u8 *in_buf, *out_buf, *inp;
+	size_t out_len;
+	u32 chunk;
+	int ret = -1;
+
+	if (posp)
+		*posp = 0;
+
+	if (output) {
+		out_buf = output;
+	} else if (!flush) {
+		error("NULL output pointer and no flush function provided");
+		goto exit;
+	} else {
+		out_buf = large_malloc(LZ4_LEGACY_BLOCK_SIZE);
+		if (!out_buf) {
+			error("Could not allocate output buffer");
+			goto exit;
+		}
+	}
+
+	if (input && fill) {
+		error("Both input pointer and fill function provided, don't know what to do");
+		goto exit_1;
+	} else if (input) {
+		in_buf = input;
+	} else if (!fill) {
+		error("NULL input pointer and missing fill function");
+		goto exit_1;
+	} else {
+		in_buf = large_malloc(in_max);
+		if (!in_buf) {
+			error("Could not allocate input buffer");
+			goto exit_1;
+		}
+	}
+	inp = in_buf;
+
+	if (fill)
+		in_len = fill(in_buf, 4);
+	if (in_len < 4 || get_unaligned_le32(inp) != LZ4_LEGACY_MAGIC) {
+		error("invalid header");
+		goto exit_2;
+	}
+	inp += 4;
+	in_len -= 4;
+	if (posp)
+		*posp += 4;
+
+	for (;;) {
+		if (fill) {
+			inp = in_buf;
+			in_len = fill(in_buf, 4);
+		}
+		if (in_len < 4)
+			break;
+
+		chunk = get_unaligned_le32(inp);
+		if (chunk == LZ4_LEGACY_MAGIC) {
+			/* concatenated streams */
+			inp += 4;
+			in_len -= 4;
+			if (posp)
+				*posp += 4;
+			continue;
+		}
+
+		/* the size_append'ed length at the end of a zImage */
+		if (!fill && in_len == 4) {
+			if (posp)
+				*posp += 4;
+			break;
+		}
+
+		/* zero padding or whatever follows the stream in the buffer */
+		if (chunk == 0 || chunk > in_max)
+			break;
+
+		if (!fill && chunk > in_len - 4) {
+			error("data corrupted");
+			goto exit_2;
+		}
+		inp += 4;
+		in_len -= 4;
+		if (posp)
+			*posp += 4;
+
+		if (fill) {
+			inp = in_buf;
+			in_len = fill(in_buf, chunk);
+			if (in_len < (int)chunk) {
+				error("data corrupted");
+				goto exit_2;
+			}
+		}
+
+		out_len = LZ4_LEGACY_BLOCK_SIZE;
+		if (lz4_decompress_unknownoutputsize(inp, chunk,
+						     out_buf, &out_len)) {
+			error("Compressed data violation");
+			goto exit_2;
+		}
+
+		if (flush && flush(out_buf, out_len) != out_len)
+			goto exit_2;
+		if (output)
+			out_buf += out_len;
+		if (posp)
+			*posp += chunk;
+
+		inp += chunk;
+		in_len -= chunk;
+	}
+
+	ret = 0;
+exit_2:
+	if (!input)
+		large_free(in_buf);
+exit_1:
+	if (!output)
+		large_free(out_buf);
+exit:
+	return ret;
+}
+
+#define decompress unlz4
@@ -0,0 +1,216 @@
+/*
+ * lib/lat_hist.c
+ *
+ * Per-CPU log2 latency histograms with a debugfs export
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/mutex.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include <linux/irqflags.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/lat_hist.h>
+
+static DEFINE_MUTEX(lat_hist_lock);
+static LIST_HEAD(lat_hist_list);
+static struct dentry *lat_hist_dir;
+
+/*
+ * Only the local CPU's counters are written, with interrupts off for the
+ * few instructions it takes, so no lock or atomic is needed on the
+ * recording side; readers sum over all CPUs and may see an update half
+ * done, which is fine for statistics.
+ */
+void lat_hist_add(struct lat_hist *h, u32 us)
+{
+	struct lat_hist_cpu *c;
+	unsigned long flags;
+	int bucket = min(fls(us), LAT_HIST_BUCKETS - 1);
+
+	/* lat_hist_alloc() failed, nothing to record into */
+	if (unlikely(!h->cpu))
+		return;
+
+	local_irq_save(flags);
+	c = this_cpu_ptr(h->cpu);
+	c->count[bucket]++;
+	c->sum_us += us;
+	if (us > c->max_us)
+		c->max_us = us;
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(lat_hist_add);
+
+#ifdef CONFIG_DEBUG_FS
+
+static int lat_hist_show(struct seq_file *s, void *data)
+{
+	struct lat_hist *h = s->private;
+	struct lat_hist_cpu sum;
+	u64 count = 0;
+	int cpu, i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct lat_hist_cpu *c = per_cpu_ptr(h->cpu, cpu);
+
+		for (i = 0; i < LAT_HIST_BUCKETS; i++)
+			sum.count[i] += c->count[i];
+		sum.sum_us += c->sum_us;
+		sum.max_us = max(sum.max_us, c->max_us);
+	}
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		count += sum.count[i];
+
+	seq_printf(s, "count %llu\n", count);
+	seq_printf(s, "avg_us %llu\n", count ? div64_u64(sum.sum_us, count) : 0);
+	seq_printf(s, "max_us %u\n", sum.max_us);
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+		if (!sum.count[i])
+			continue;
+		if (!i)
+			seq_printf(s, "%10s %u\n", "<1us", sum.count[i]);
+		else if (i == LAT_HIST_BUCKETS - 1)
+			seq_printf(s, "%8u+us %u\n", 1U << (i - 1),
+				   sum.count[i]);
+		else
+			seq_printf(s, "%6u-%uus %u\n", 1U << (i - 1), 1U << i,
+				   sum.count[i]);
+	}
+	return 0;
+}
+
+static int lat_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lat_hist_show, inode->i_private);
+}
+
+static void lat_hist_reset(struct lat_hist *h)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(h->cpu, cpu), 0,
+		       sizeof(struct lat_hist_cpu));
+}
+
+/* any write resets */
+static ssize_t lat_hist_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+
+	lat_hist_reset(s->private);
+	return count;
+}
+
+static const struct file_operations lat_hist_fops = {
+	.open		= lat_hist_open,
+	.read		= seq_read,
+	.write		= lat_hist_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void lat_hist_create_file(struct lat_hist *h)
+{
+	h->dentry = debugfs_create_file(h->name, S_IRUGO | S_IWUSR,
+					lat_hist_dir, h, &lat_hist_fops);
+}
+
+static ssize_t lat_hist_reset_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct lat_hist *h;
+
+	mutex_lock(&lat_hist_lock);
+	list_for_each_entry(h, &lat_hist_list, node)
+		lat_hist_reset(h);
+	mutex_unlock(&lat_hist_lock);
+	return count;
+}
+
+static const struct file_operations lat_hist_reset_fops = {
+	.write		= lat_hist_reset_write,
+	.llseek		= noop_llseek,
+};
+
+static int __init lat_hist_debugfs_init(void)
+{
+	struct lat_hist *h;
+
+	mutex_lock(&lat_hist_lock);
+	lat_hist_dir = debugfs_create_dir("lat_hist", NULL);
+	if (lat_hist_dir) {
+		debugfs_create_file("reset", S_IWUSR, lat_hist_dir, NULL,
+				    &lat_hist_reset_fops);
+		list_for_each_entry(h, &lat_hist_list, node)
+			lat_hist_create_file(h);
+	}
+	mutex_unlock(&lat_hist_lock);
+	return 0;
+}
+postcore_initcall(lat_hist_debugfs_init);
+
+#else
+
+static inline void lat_hist_create_file(struct lat_hist *h)
+{
+}
+
+#endif /* CONFIG_DEBUG_FS */
+
+void lat_hist_register(struct lat_hist *h)
+{
+	mutex_lock(&lat_hist_lock);
+	if (list_empty(&h->node)) {
+		list_add_tail(&h->node, &lat_hist_list);
+		if (lat_hist_dir)
+			lat_hist_create_file(h);
+	}
+	mutex_unlock(&lat_hist_lock);
+}
+EXPORT_SYMBOL_GPL(lat_hist_register);
+
+void lat_hist_unregister(struct lat_hist *h)
+{
+	mutex_lock(&lat_hist_lock);
+	if (!list_empty(&h->node)) {
+		list_del_init(&h->node);
+		debugfs_remove(h->dentry);
+		h->dentry = NULL;
+	}
+	mutex_unlock(&lat_hist_lock);
+}
+EXPORT_SYMBOL_GPL(lat_hist_unregister);
+
+int lat_hist_alloc(struct lat_hist *h, const char *name)
+{
+	h->cpu = alloc_percpu(struct lat_hist_cpu);
+	if (!h->cpu)
+		return -ENOMEM;
+	h->name = name;
+	INIT_LIST_HEAD(&h->node);
+	lat_hist_register(h);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lat_hist_alloc);
+
+void lat_hist_free(struct lat_hist *h)
+{
+	if (!h->cpu)
+		return;
+	lat_hist_unregister(h);
+	free_percpu(h->cpu);
+	h->cpu = NULL;
+}
+EXPORT_SYMBOL_GPL(lat_hist_free);
@@ -0,0 +1,158 @@
+/*
+ *  LZ4 Compressor
+ *
+ *  Writes the block format of the LZ4 library by Yann Collet:
+ *  http://code.google.com/p/lz4/
+ *
+ *  A block is a run of sequences, each a token byte holding the literal
+ *  length in its upper and the match length less MINMATCH in its lower
+ *  four bits, more length bytes for either once it reaches 15, the
+ *  literals themselves and a little endian 16 bit match offset. The last
+ *  sequence has literals only.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(u32 seq)
+{
+	return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+/*
+ * The hash table holds input offsets and is never cleared: a stale entry
+ * left by an earlier call only counts once it names a position within
+ * MAX_DISTANCE before ip, and even then only once its bytes compare equal.
+ */
+static inline const unsigned char *lz4_find(u32 *table,
+		const unsigned char *src, const unsigned char *ip)
+{
+	u32 h = lz4_hash(lz4_read32(ip));
+	u32 pos = ip - src;
+	u32 off = table[h];
+
+	table[h] = pos;
+	if (off < pos && pos - off <= MAX_DISTANCE &&
+	    lz4_read32(src + off) == lz4_read32(ip))
+		return src + off;
+	return NULL;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *table = wrkmem;
+	const unsigned char *ip = src, *anchor = src, *ref;
+	const unsigned char * const iend = src + src_len;
+	const unsigned char * const mflimit = iend - MFLIMIT;
+	const unsigned char * const matchlimit = iend - LASTLITERALS;
+	unsigned char *op = dst, *token;
+	unsigned int step, attempts;
+	size_t len;
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	table[lz4_hash(lz4_read32(ip))] = 0;
+	ip++;
+
+	for (;;) {
+		/* find a match */
+		step = 1;
+		attempts = 1 << SKIP_TRIGGER;
+		for (;;) {
+			if (unlikely(ip > mflimit))
+				goto last_literals;
+			ref = lz4_find(table, src, ip);
+			if (ref)
+				break;
+			ip += step;
+			step = attempts++ >> SKIP_TRIGGER;
+		}
+
+		/* catch up on bytes equal before the match */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* literals */
+		len = ip - anchor;
+		token = op++;
+		if (len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, len - RUN_MASK);
+		} else
+			*token = len << ML_BITS;
+		memcpy(op, anchor, len);
+		op += len;
+
+next_match:
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		/* match length */
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip + 4 <= matchlimit &&
+		       lz4_read32(ip) == lz4_read32(ref)) {
+			ip += 4;
+			ref += 4;
+		}
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+
+		len = ip - anchor;
+		if (len >= ML_MASK) {
+			*token += ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else
+			*token += len;
+
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+
+		table[lz4_hash(lz4_read32(ip - 2))] = ip - 2 - src;
+
+		/* another match right away goes without literals */
+		ref = lz4_find(table, src, ip);
+		if (ref) {
+			token = op++;
+			*token = 0;
+			goto next_match;
+		}
+		ip++;
+	}
+
+last_literals:
+	len = iend - anchor;
+	if (len >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else
+		*op++ = len << ML_BITS;
+	memcpy(op, anchor, len);
+	op += len;
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
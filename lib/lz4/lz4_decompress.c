@@ -0,0 +1,106 @@
+/*
+ *  LZ4 Decompressor
+ *
+ *  Reads the block format of the LZ4 library by Yann Collet:
+ *  http://code.google.com/p/lz4/
+ *
+ *  Both the input and the output are bounds checked, so corrupted data
+ *  can't make it read or write outside the buffers it was given.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+/*
+ * Copies go eight bytes at a time, which matches with an offset below
+ * that can't do: those repeat a pattern shorter than the step.
+ */
+static inline void lz4_copy(unsigned char *op, const unsigned char *ip,
+			    size_t len)
+{
+	unsigned char * const end = op + len;
+
+	if (op - ip >= 8 || ip - op >= 8) {
+		for (; end - op >= 8; op += 8, ip += 8)
+			lz4_copy8(op, ip);
+	}
+	while (op < end)
+		*op++ = *ip++;
+}
+
+static inline int lz4_get_length(const unsigned char **ip,
+				 const unsigned char *iend, size_t *len)
+{
+	unsigned int s;
+
+	do {
+		if (unlikely(*ip >= iend))
+			return LZ4_E_ERROR;
+		s = *(*ip)++;
+		*len += s;
+	} while (s == 255);
+
+	return LZ4_E_OK;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len)
+{
+	const unsigned char *ip = src, *ref;
+	const unsigned char * const iend = src + src_len;
+	unsigned char *op = dst;
+	unsigned char * const oend = dst + *dst_len;
+	unsigned int token;
+	size_t len;
+
+	for (;;) {
+		if (unlikely(ip >= iend))
+			return LZ4_E_ERROR;
+		token = *ip++;
+
+		/* literals */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && lz4_get_length(&ip, iend, &len))
+			return LZ4_E_ERROR;
+		if (unlikely(len > (size_t)(iend - ip) ||
+			     len > (size_t)(oend - op)))
+			return LZ4_E_ERROR;
+		lz4_copy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* the last sequence has no match */
+		if (ip == iend)
+			break;
+
+		if (unlikely(iend - ip < 2))
+			return LZ4_E_ERROR;
+		ref = op - get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(ref < dst || ref == op))
+			return LZ4_E_ERROR;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && lz4_get_length(&ip, iend, &len))
+			return LZ4_E_ERROR;
+		len += MINMATCH;
+		if (unlikely(len > (size_t)(oend - op)))
+			return LZ4_E_ERROR;
+		lz4_copy(op, ref, len);
+		op += len;
+	}
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
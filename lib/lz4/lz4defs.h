@@ -0,0 +1,61 @@
+/*
+ *  Definitions shared by the LZ4 compressor and decompressor
+ *
+ *  The block format is that of the LZ4 library by Yann Collet:
+ *  http://code.google.com/p/lz4/
+ */
+
+#include <asm/unaligned.h>
+
+#define MINMATCH	4
+
+/* the last match starts this far from the end at the latest ... */
+#define MFLIMIT		12
+/* ... and the last this many bytes are always literals */
+#define LASTLITERALS	5
+
+#define MAX_DISTANCE	65535
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+/* the match search gets sparser over incompressible data */
+#define SKIP_TRIGGER	6
+
+#if defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6
+/*
+ * ARMv6 and later do unaligned single word loads and stores in hardware,
+ * the kernel runs with the alignment trap off there, where get_unaligned()
+ * would assemble every word byte by byte.
+ */
+static inline u32 lz4_read32(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static inline void lz4_write32(void *p, u32 v)
+{
+	asm("str	%1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+#else
+static inline u32 lz4_read32(const void *p)
+{
+	return get_unaligned((const u32 *)p);
+}
+
+static inline void lz4_write32(void *p, u32 v)
+{
+	put_unaligned(v, (u32 *)p);
+}
+#endif
+
+static inline void lz4_copy8(unsigned char *dst, const unsigned char *src)
+{
+	lz4_write32(dst, lz4_read32(src));
+	lz4_write32(dst + 4, lz4_read32(src + 4));
+}
@@ -27,31 +27,58 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/hash.h>
+#include <linux/sched.h>
 #include <linux/shmem_fs.h>
+#include <linux/lat_hist.h>
 #include <linux/ashmem.h>
 
 #define ASHMEM_NAME_PREFIX "dev/ashmem/"
 #define ASHMEM_NAME_PREFIX_LEN (sizeof(ASHMEM_NAME_PREFIX) - 1)
 #define ASHMEM_FULL_NAME_LEN (ASHMEM_NAME_LEN + ASHMEM_NAME_PREFIX_LEN)
 
+/*
+ * ashmem_lru - one shard of the LRU list of unpinned ranges
+ * Areas are hashed onto a shard for their lifetime, so that pin/unpin on
+ * different areas and the shrinker rarely meet on the same lock.
+ * Locking: `lock' nests inside ashmem_area->mutex, it is never held
+ * across anything that sleeps.
+ */
+struct ashmem_lru {
+	spinlock_t lock;
+	struct list_head list;		/* least recently unpinned first */
+	unsigned long pages;		/* pages on `list' */
+} ____cacheline_aligned_in_smp;
+
+#define ASHMEM_LRU_SHIFT	3
+#define ASHMEM_LRU_SHARDS	(1 << ASHMEM_LRU_SHIFT)
+
+static struct ashmem_lru ashmem_lru[ASHMEM_LRU_SHARDS];
+
 /*
  * ashmem_area - anonymous shared memory area
  * Lifecycle: From our parent file's open() until its release()
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its own `mutex'
  * Big Note: Mappings do NOT pin this structure; it dies on close()
  */
 struct ashmem_area {
 	char name[ASHMEM_FULL_NAME_LEN];/* optional name for /proc/pid/maps */
-	struct list_head unpinned_list;	/* list of all ashmem areas */
+	struct list_head unpinned_list;	/* list of unpinned ranges */
 	struct file *file;		/* the shmem-based backing file */
 	size_t size;			/* size of the mapping, in bytes */
 	unsigned long prot_mask;	/* allowed prot bits, as vm_flags */
+	struct mutex mutex;		/* protects the area and its ranges */
+	struct ashmem_lru *lru;		/* LRU shard of our ranges */
+	unsigned int nr_unpinned;	/* ranges on unpinned_list, read
+					   locklessly by the pin fast path */
 };
 
 /*
  * ashmem_range - represents an interval of unpinned (evictable) pages
  * Lifecycle: From unpin to pin
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its area's `mutex', and the LRU shard lock for
+ * the `lru' entry
  */
 struct ashmem_range {
 	struct list_head lru;		/* entry in LRU list */
@@ -62,18 +89,16 @@ struct ashmem_range {
 	unsigned int purged;		/* ASHMEM_NOT or ASHMEM_WAS_PURGED */
 };
 
-/* LRU list of unpinned pages, protected by ashmem_mutex */
-static LIST_HEAD(ashmem_lru_list);
-
-/* Count of pages on our LRU list, protected by ashmem_mutex */
-static unsigned long lru_count;
-
 /*
- * ashmem_mutex - protects the list of and each individual ashmem_area
- *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * Lock Ordering: ashmem_area->mutex -> i_mutex -> i_alloc_sem
+ *                ashmem_area->mutex -> ashmem_lru->lock
+ * The shrinker goes the other way round with mutex_trylock() only.
  */
-static DEFINE_MUTEX(ashmem_mutex);
+
+/* Ranges the shrinker looks at per shard before giving up on busy areas */
+#define ASHMEM_PURGE_SCAN	16
+
+DEFINE_LAT_HIST(ashmem_purge_hist, "ashmem_purge");
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -104,14 +129,39 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 static inline void lru_add(struct ashmem_range *range)
 {
-	list_add_tail(&range->lru, &ashmem_lru_list);
-	lru_count += range_size(range);
+	struct ashmem_lru *lru = range->asma->lru;
+
+	spin_lock(&lru->lock);
+	list_add_tail(&range->lru, &lru->list);
+	lru->pages += range_size(range);
+	spin_unlock(&lru->lock);
 }
 
-static inline void lru_del(struct ashmem_range *range)
+static inline void __lru_del(struct ashmem_lru *lru,
+			     struct ashmem_range *range)
 {
 	list_del(&range->lru);
-	lru_count -= range_size(range);
+	lru->pages -= range_size(range);
+}
+
+static inline void lru_del(struct ashmem_range *range)
+{
+	struct ashmem_lru *lru = range->asma->lru;
+
+	spin_lock(&lru->lock);
+	__lru_del(lru, range);
+	spin_unlock(&lru->lock);
+}
+
+static unsigned long lru_count(void)
+{
+	unsigned long pages = 0;
+	int i;
+
+	for (i = 0; i < ASHMEM_LRU_SHARDS; i++)
+		pages += ACCESS_ONCE(ashmem_lru[i].pages);
+
+	return pages;
 }
 
 /*
@@ -123,7 +173,7 @@ static inline void lru_del(struct ashmem_range *range)
  * 'start' - starting page, inclusive
  * 'end' - ending page, inclusive
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int range_alloc(struct ashmem_area *asma,
 		       struct ashmem_range *prev_range, unsigned int purged,
@@ -141,6 +191,7 @@ static int range_alloc(struct ashmem_area *asma,
 	range->purged = purged;
 
 	list_add_tail(&range->unpinned, &prev_range->unpinned);
+	asma->nr_unpinned++;
 
 	if (range_on_lru(range))
 		lru_add(range);
@@ -151,6 +202,7 @@ static int range_alloc(struct ashmem_area *asma,
 static void range_del(struct ashmem_range *range)
 {
 	list_del(&range->unpinned);
+	range->asma->nr_unpinned--;
 	if (range_on_lru(range))
 		lru_del(range);
 	kmem_cache_free(ashmem_range_cachep, range);
@@ -159,18 +211,22 @@ static void range_del(struct ashmem_range *range)
 /*
  * range_shrink - shrinks a range
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static inline void range_shrink(struct ashmem_range *range,
 				size_t start, size_t end)
 {
+	struct ashmem_lru *lru = range->asma->lru;
 	size_t pre = range_size(range);
 
 	range->pgstart = start;
 	range->pgend = end;
 
-	if (range_on_lru(range))
-		lru_count -= pre - range_size(range);
+	if (range_on_lru(range)) {
+		spin_lock(&lru->lock);
+		lru->pages -= pre - range_size(range);
+		spin_unlock(&lru->lock);
+	}
 }
 
 static int ashmem_open(struct inode *inode, struct file *file)
@@ -189,6 +245,8 @@ static int ashmem_open(struct inode *inode, struct file *file)
 	INIT_LIST_HEAD(&asma->unpinned_list);
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
+	mutex_init(&asma->mutex);
+	asma->lru = &ashmem_lru[hash_ptr(asma, ASHMEM_LRU_SHIFT)];
 	file->private_data = asma;
 
 	return 0;
@@ -199,10 +257,10 @@ static int ashmem_release(struct inode *ignored, struct file *file)
 	struct ashmem_area *asma = file->private_data;
 	struct ashmem_range *range, *next;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
 		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	if (asma->file)
 		fput(asma->file);
@@ -217,7 +275,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0) {
@@ -238,7 +296,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	asma->file->f_pos = *pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -247,7 +305,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -268,7 +326,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -285,7 +343,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -328,10 +386,58 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	vma->vm_flags |= VM_CAN_NONLINEAR;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
+/*
+ * ashmem_purge_one - purge the least recently unpinned range of 'lru'
+ *
+ * Areas busy in pin/unpin are skipped rather than waited for, so the
+ * shrinker never stalls an application and cannot deadlock against an
+ * allocation made under an area's mutex. Only the shard lock is taken,
+ * and only long enough to pick a range.
+ *
+ * Returns the number of pages purged, zero if nothing could be.
+ */
+static size_t ashmem_purge_one(struct ashmem_lru *lru)
+{
+	struct ashmem_range *range;
+	struct ashmem_area *asma = NULL;
+	struct inode *inode;
+	loff_t start, end;
+	size_t pages;
+	int scan = 0;
+
+	spin_lock(&lru->lock);
+	list_for_each_entry(range, &lru->list, lru) {
+		if (mutex_trylock(&range->asma->mutex)) {
+			asma = range->asma;
+			break;
+		}
+		if (++scan == ASHMEM_PURGE_SCAN)
+			break;
+	}
+	if (!asma) {
+		spin_unlock(&lru->lock);
+		return 0;
+	}
+	range->purged = ASHMEM_WAS_PURGED;
+	__lru_del(lru, range);
+	spin_unlock(&lru->lock);
+
+	/* the range stays on asma's unpinned list until pinned again */
+	inode = asma->file->f_dentry->d_inode;
+	start = range->pgstart * PAGE_SIZE;
+	end = (range->pgend + 1) * PAGE_SIZE - 1;
+	pages = range_size(range);
+	vmtruncate_range(inode, start, end);
+
+	mutex_unlock(&asma->mutex);
+
+	return pages;
+}
+
 /*
  * ashmem_shrink - our cache shrinker, called from mm/vmscan.c :: shrink_slab
  *
@@ -344,36 +450,38 @@ out:
  * proceed without risk of deadlock (due to gfp_mask).
  *
  * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
- * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
- * pages freed.
+ * chunks of ashmem regions one-at-a-time from each LRU shard in turn until we
+ * hit 'nr_to_scan' pages freed.
  */
 static int ashmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
+	long nr_to_scan = sc->nr_to_scan;
+	ktime_t start;
+	size_t purged;
+	bool progress;
+	int i;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
-	if (sc->nr_to_scan && !(sc->gfp_mask & __GFP_FS))
+	if (nr_to_scan && !(sc->gfp_mask & __GFP_FS))
 		return -1;
-	if (!sc->nr_to_scan)
-		return lru_count;
-
-	mutex_lock(&ashmem_mutex);
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		struct inode *inode = range->asma->file->f_dentry->d_inode;
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE - 1;
-
-		vmtruncate_range(inode, start, end);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
-
-		sc->nr_to_scan -= range_size(range);
-		if (sc->nr_to_scan <= 0)
-			break;
-	}
-	mutex_unlock(&ashmem_mutex);
+	if (!nr_to_scan)
+		return lru_count();
+
+	start = lat_hist_start();
+	do {
+		progress = false;
+		for (i = 0; i < ASHMEM_LRU_SHARDS && nr_to_scan > 0; i++) {
+			purged = ashmem_purge_one(&ashmem_lru[i]);
+			if (purged) {
+				nr_to_scan -= purged;
+				progress = true;
+			}
+		}
+		cond_resched();
+	} while (nr_to_scan > 0 && progress);
+	lat_hist_add_since(&ashmem_purge_hist, start);
 
-	return lru_count;
+	return lru_count();
 }
 
 static struct shrinker ashmem_shrinker = {
@@ -385,7 +493,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -400,7 +508,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -408,7 +516,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file)) {
@@ -422,7 +530,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	asma->name[ASHMEM_FULL_NAME_LEN-1] = '\0';
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -431,7 +539,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 		size_t len;
 
@@ -448,7 +556,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 					  sizeof(ASHMEM_NAME_DEF))))
 			ret = -EFAULT;
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -457,7 +565,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -523,7 +631,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -558,7 +666,7 @@ restart:
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
@@ -607,7 +715,14 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
-	mutex_lock(&ashmem_mutex);
+	/*
+	 * Fast path: with nothing unpinned in the area there is nothing to
+	 * pin and nothing was purged, no need to serialize with the shrinker.
+	 */
+	if (cmd != ASHMEM_UNPIN && !ACCESS_ONCE(asma->nr_unpinned))
+		return cmd == ASHMEM_PIN ? ASHMEM_NOT_PURGED : ASHMEM_IS_PINNED;
+
+	mutex_lock(&asma->mutex);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
@@ -621,7 +736,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -695,7 +810,12 @@ static struct miscdevice ashmem_misc = {
 
 static int __init ashmem_init(void)
 {
-	int ret;
+	int ret, i;
+
+	for (i = 0; i < ASHMEM_LRU_SHARDS; i++) {
+		spin_lock_init(&ashmem_lru[i].lock);
+		INIT_LIST_HEAD(&ashmem_lru[i].list);
+	}
 
 	ashmem_area_cachep = kmem_cache_create("ashmem_area_cache",
 					  sizeof(struct ashmem_area),
@@ -720,6 +840,7 @@ static int __init ashmem_init(void)
 	}
 
 	register_shrinker(&ashmem_shrinker);
+	lat_hist_register(&ashmem_purge_hist);
 
 	printk(KERN_INFO "ashmem: initialized\n");
 
@@ -730,6 +851,7 @@ static void __exit ashmem_exit(void)
 {
 	int ret;
 
+	lat_hist_unregister(&ashmem_purge_hist);
 	unregister_shrinker(&ashmem_shrinker);
 
 	ret = misc_deregister(&ashmem_misc);
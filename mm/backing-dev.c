@@ -668,6 +668,12 @@ int bdi_init(struct backing_dev_info *bdi)
 	bdi->max_ratio = 100;
 	bdi->max_prop_frac = PROP_FRAC_BASE;
 	spin_lock_init(&bdi->wb_lock);
+	spin_lock_init(&bdi->ra_adapt.lock);
+	atomic_long_set(&bdi->ra_adapt.issued, 0);
+	atomic_long_set(&bdi->ra_adapt.used, 0);
+	bdi->ra_adapt.min_pages = max(bdi->ra_pages / 8, 1UL);
+	bdi->ra_adapt.max_pages = bdi->ra_pages * 4;
+	bdi->ra_adapt.lat_target_us = 20 * USEC_PER_MSEC;
 	INIT_LIST_HEAD(&bdi->bdi_list);
 	INIT_LIST_HEAD(&bdi->work_list);
 
@@ -34,6 +34,7 @@
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
 #include <linux/cleancache.h>
+#include <linux/prefetch_trace.h>
 #include "internal.h"
 
 /*
@@ -1106,6 +1107,8 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 	last_index = (*ppos + desc->count + PAGE_CACHE_SIZE-1) >> PAGE_CACHE_SHIFT;
 	offset = *ppos & ~PAGE_CACHE_MASK;
 
+	prefetch_trace_record(filp, index, last_index - index);
+
 	for (;;) {
 		struct page *page;
 		pgoff_t end_index;
@@ -1597,11 +1600,12 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	/*
 	 * mmap read-around
 	 */
-	ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages = max_sane_readahead(ra_window(mapping, ra));
 	ra->start = max_t(long, 0, offset - ra_pages / 2);
 	ra->size = ra_pages;
 	ra->async_size = ra_pages / 4;
-	ra_submit(ra, mapping, file);
+	bdi_ra_account(mapping->backing_dev_info,
+		       ra_submit(ra, mapping, file), 1);
 }
 
 /*
@@ -1619,8 +1623,11 @@ static void do_async_mmap_readahead(struct vm_area_struct *vma,
 	/* If we don't want any read-ahead, don't bother */
 	if (VM_RandomReadHint(vma))
 		return;
-	if (ra->mmap_miss > 0)
+	if (ra->mmap_miss > 0) {
 		ra->mmap_miss--;
+		/* Found in the cache, likely brought in by read-around */
+		bdi_ra_account(mapping->backing_dev_info, 0, 1);
+	}
 	if (PageReadahead(page))
 		page_cache_async_readahead(mapping, ra, file,
 					   page, offset, ra->ra_pages);
@@ -1654,6 +1661,8 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (offset >= size)
 		return VM_FAULT_SIGBUS;
 
+	prefetch_trace_record(file, offset, 1);
+
 	/*
 	 * Do we have something in the page cache already?
 	 */
@@ -57,6 +57,8 @@
 #include <linux/ftrace_event.h>
 #include <linux/memcontrol.h>
 #include <linux/prefetch.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -97,6 +99,7 @@ EXPORT_SYMBOL(node_states);
 unsigned long totalram_pages __read_mostly;
 unsigned long totalreserve_pages __read_mostly;
 int percpu_pagelist_fraction;
+int percpu_pagelist_autotune = 1;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 
 #ifdef CONFIG_PM_SLEEP
@@ -594,6 +597,18 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+/*
+ * Take the zone lock, counting the times someone else already had it.
+ * Callers have interrupts disabled.
+ */
+static inline void lock_zone(struct zone *zone)
+{
+	if (unlikely(!spin_trylock(&zone->lock))) {
+		__count_vm_event(ZONE_LOCK_CONTENDED);
+		spin_lock(&zone->lock);
+	}
+}
+
 /*
  * Frees a number of pages from the PCP lists
  * Assumes all pages on list are in same zone, and of same order.
@@ -612,7 +627,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int batch_free = 0;
 	int to_free = count;
 
-	spin_lock(&zone->lock);
+	lock_zone(zone);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
@@ -654,7 +669,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
-	spin_lock(&zone->lock);
+	lock_zone(zone);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
@@ -842,11 +857,17 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
+	[MIGRATE_ISOLATE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -941,12 +962,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -960,11 +981,13 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * aggressive about taking ownership of free pages
+			 * aggressive about taking ownership of free pages.
+			 * CMA pageblocks are lent out, never given away.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -983,7 +1006,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
@@ -1038,9 +1062,9 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			unsigned long count, struct list_head *list,
 			int migratetype, int cold)
 {
-	int i;
+	int i, mt;
 	
-	spin_lock(&zone->lock);
+	lock_zone(zone);
 	for (i = 0; i < count; ++i) {
 		struct page *page = __rmqueue(zone, order, migratetype);
 		if (unlikely(page == NULL))
@@ -1059,7 +1083,9 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		/* CMA pages must go back to the CMA free lists */
+		mt = get_pageblock_migratetype(page);
+		set_page_private(page, is_migrate_cma(mt) ? mt : migratetype);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
@@ -1136,6 +1162,89 @@ void drain_all_pages(void)
 	on_each_cpu(drain_local_pages, NULL, 1);
 }
 
+/*
+ * Zone lock round trips per stat interval above which a per-cpu list
+ * doubles its batch, and at or below which it halves it again.
+ */
+#define PCP_TUNE_TRIPS_UP	32
+#define PCP_TUNE_TRIPS_DOWN	4
+
+static void pcp_tune(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int max_batch = max_t(int, pcp->base_batch, PAGE_SHIFT * 8);
+	int batch = pcp->batch;
+	int excess;
+
+	if (pcp->trips >= PCP_TUNE_TRIPS_UP && batch < max_batch) {
+		batch = min(batch * 2, max_batch);
+		__count_vm_event(PCP_TUNE_GROW);
+	} else if (pcp->trips <= PCP_TUNE_TRIPS_DOWN &&
+		   batch > pcp->base_batch) {
+		batch = max(batch / 2, pcp->base_batch);
+		__count_vm_event(PCP_TUNE_SHRINK);
+	}
+
+	pcp->batch = batch;
+	pcp->high = pcp->base_high * batch / pcp->base_batch;
+
+	/* a list nobody used in a whole interval only hoards pages */
+	excess = pcp->ops ? pcp->count - pcp->high : pcp->count;
+	if (excess > 0) {
+		free_pcppages_bulk(zone, excess, pcp);
+		pcp->count -= excess;
+		__count_vm_events(PCP_TUNE_TRIM, excess);
+	}
+
+	pcp->trips = 0;
+	pcp->ops = 0;
+}
+
+/*
+ * Resize this CPU's per-cpu lists by how often they had to take the zone
+ * lock over the last interval: busy lists get bigger batches, quiet ones
+ * go back to the zone default and idle ones are emptied. Called from the
+ * vmstat updater, on the CPU owning the lists. A percpu_pagelist_fraction
+ * set by the admin turns this off.
+ */
+void pcp_autotune(void)
+{
+	unsigned long flags;
+	struct zone *zone;
+
+	if (percpu_pagelist_fraction)
+		return;
+
+	for_each_populated_zone(zone) {
+		struct per_cpu_pages *pcp;
+
+		local_irq_save(flags);
+		pcp = &this_cpu_ptr(zone->pageset)->pcp;
+		if (percpu_pagelist_autotune) {
+			pcp_tune(zone, pcp);
+		} else {
+			pcp->high = pcp->base_high;
+			pcp->batch = pcp->base_batch;
+		}
+		local_irq_restore(flags);
+	}
+}
+
+/* A CPU going offline starts over from the zone defaults. */
+static void pcp_reset(unsigned int cpu)
+{
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		struct per_cpu_pages *pcp;
+
+		pcp = &per_cpu_ptr(zone->pageset, cpu)->pcp;
+		pcp->high = pcp->base_high;
+		pcp->batch = pcp->base_batch;
+		pcp->trips = 0;
+		pcp->ops = 0;
+	}
+}
+
 #ifdef CONFIG_HIBERNATION
 
 void mark_free_pages(struct zone *zone)
@@ -1199,7 +1308,8 @@ void free_hot_cold_page(struct page *page, int cold)
 	 * Free ISOLATE pages back to the allocator because they are being
 	 * offlined but treat RESERVE as movable pages so we can get those
 	 * areas back if necessary. Otherwise, we may have to free
-	 * excessively into the page allocator
+	 * excessively into the page allocator. CMA pages share the movable
+	 * list; page_private still routes them back to their own free list.
 	 */
 	if (migratetype >= MIGRATE_PCPTYPES) {
 		if (unlikely(migratetype == MIGRATE_ISOLATE)) {
@@ -1215,9 +1325,11 @@ void free_hot_cold_page(struct page *page, int cold)
 	else
 		list_add(&page->lru, &pcp->lists[migratetype]);
 	pcp->count++;
+	pcp->ops++;
 	if (pcp->count >= pcp->high) {
 		free_pcppages_bulk(zone, pcp->batch, pcp);
 		pcp->count -= pcp->batch;
+		pcp->trips++;
 	}
 
 out:
@@ -1291,7 +1403,9 @@ int split_free_page(struct page *page)
 	if (order >= pageblock_order - 1) {
 		struct page *endpage = page + (1 << order) - 1;
 		for (; page < endpage; page += pageblock_nr_pages)
-			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+			if (!is_migrate_cma(get_pageblock_migratetype(page)))
+				set_pageblock_migratetype(page,
+							  MIGRATE_MOVABLE);
 	}
 
 	return 1 << order;
@@ -1323,6 +1437,7 @@ again:
 			pcp->count += rmqueue_bulk(zone, 0,
 					pcp->batch, list,
 					migratetype, cold);
+			pcp->trips++;
 			if (unlikely(list_empty(list)))
 				goto failed;
 		}
@@ -1334,6 +1449,7 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+		pcp->ops++;
 	} else {
 		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
 			/*
@@ -1348,7 +1464,8 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
+		local_irq_save(flags);
+		lock_zone(zone);
 		page = __rmqueue(zone, order, migratetype);
 		spin_unlock(&zone->lock);
 		if (!page)
@@ -3593,6 +3710,8 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->count = 0;
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
+	pcp->base_high = pcp->high;
+	pcp->base_batch = pcp->batch;
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
 }
@@ -3612,6 +3731,8 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	pcp->base_high = pcp->high;
+	pcp->base_batch = pcp->batch;
 }
 
 static void setup_zone_pageset(struct zone *zone)
@@ -5045,6 +5166,7 @@ static int page_alloc_cpu_notify(struct notifier_block *self,
 
 	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN) {
 		drain_pages(cpu);
+		pcp_reset(cpu);
 
 		/*
 		 * Spill the event counters of the dead processor
@@ -5584,7 +5706,8 @@ __count_immobile_pages(struct zone *zone, struct page *page, int count)
 	if (zone_idx(zone) == ZONE_MOVABLE)
 		return true;
 
-	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE)
+	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE ||
+	    is_migrate_cma(get_pageblock_migratetype(page)))
 		return true;
 
 	pfn = page_to_pfn(page);
@@ -5683,7 +5806,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, int migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -5691,12 +5814,198 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA
+/*
+ * Hand a pageblock which was kept out of the buddy allocator at boot to it
+ * as MIGRATE_CMA.  From then on it backs movable allocations until its
+ * owner takes it back with alloc_contig_range().
+ */
+void init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+#ifdef CONFIG_HIGHMEM
+	if (PageHighMem(page))
+		totalhigh_pages += pageblock_nr_pages;
+#endif
+}
+
+/* passes over the range before alloc_contig_range() gives up */
+#define CONTIG_RANGE_RETRIES	5
+
+static struct page *
+contig_migrate_alloc(struct page *page, unsigned long private, int **x)
+{
+	return alloc_page(GFP_HIGHUSER_MOVABLE);
+}
+
+/*
+ * Moves every LRU page in [start, end) somewhere else.  Returns the number
+ * of pages which could not be moved, or -EBUSY if the range holds pages
+ * which are neither free nor on the LRU.
+ */
+static int __alloc_contig_migrate_range(unsigned long start,
+					unsigned long end)
+{
+	unsigned long pfn;
+	struct page *page;
+	int busy = 0;
+	int ret = 0;
+	LIST_HEAD(source);
+
+	for (pfn = start; pfn < end; pfn++) {
+		page = pfn_to_page(pfn);
+		if (PageBuddy(page)) {
+			unsigned long order = page_order(page);
+
+			/* read without zone->lock, so only a hint */
+			if (order < MAX_ORDER)
+				pfn += (1UL << order) - 1;
+			continue;
+		}
+		if (!get_page_unless_zero(page))
+			continue;
+		if (!isolate_lru_page(page)) {
+			list_add_tail(&page->lru, &source);
+			inc_zone_page_state(page, NR_ISOLATED_ANON +
+					    page_is_file_cache(page));
+		} else {
+			busy++;
+		}
+		put_page(page);
+	}
+
+	if (!list_empty(&source)) {
+		ret = migrate_pages(&source, contig_migrate_alloc, 0,
+				    false, true);
+		if (ret)
+			putback_lru_pages(&source);
+	}
+	return busy ? -EBUSY : ret;
+}
+
+/*
+ * Takes every page of [start, end) off the free lists, or none of them if
+ * any page there is not free yet.  The range must be isolated and lie
+ * within MAX_ORDER aligned blocks, so no free page straddles its ends.
+ */
+static bool __grab_isolated_range(struct zone *zone, unsigned long start,
+				  unsigned long end)
+{
+	unsigned long pfn, flags;
+	struct page *page;
+	unsigned int order;
+
+	spin_lock_irqsave(&zone->lock, flags);
+	for (pfn = start; pfn < end; pfn += 1UL << page_order(page)) {
+		page = pfn_to_page(pfn);
+		if (!PageBuddy(page)) {
+			spin_unlock_irqrestore(&zone->lock, flags);
+			return false;
+		}
+	}
+
+	for (pfn = start; pfn < end; pfn += 1UL << order) {
+		page = pfn_to_page(pfn);
+		order = page_order(page);
+		list_del(&page->lru);
+		rmv_page_order(page);
+		zone->free_area[order].nr_free--;
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+		set_page_refcounted(page);
+		split_page(page, order);
+	}
+	spin_unlock_irqrestore(&zone->lock, flags);
+	return true;
+}
+
+/**
+ * alloc_contig_range() -- tries to allocate given range of pages
+ * @start:	start PFN to allocate
+ * @end:	one-past-the-last PFN to allocate
+ *
+ * The PFN range does not have to be pageblock or MAX_ORDER_NR_PAGES
+ * aligned, but every pageblock it touches must be MIGRATE_CMA: those
+ * pageblocks are isolated, everything in them is migrated elsewhere, and
+ * the pages outside [start, end) are freed again afterwards.
+ *
+ * Sleeps.  Returns zero on success, after which every page in the range
+ * has a reference count of one and must be freed with free_contig_range().
+ */
+int alloc_contig_range(unsigned long start, unsigned long end)
+{
+	unsigned long outer_start, outer_end, pfn;
+	struct zone *zone = page_zone(pfn_to_page(start));
+	int tries, ret;
+
+	outer_start = start & ~(MAX_ORDER_NR_PAGES - 1);
+	outer_end = ALIGN(end, MAX_ORDER_NR_PAGES);
+	outer_start &= ~(pageblock_nr_pages - 1);
+	outer_end = ALIGN(outer_end, pageblock_nr_pages);
+
+	for (pfn = outer_start; pfn < outer_end; pfn += pageblock_nr_pages)
+		if (!is_migrate_cma(get_pageblock_migratetype(pfn_to_page(pfn))))
+			return -EINVAL;
+
+	ret = start_isolate_page_range(outer_start, outer_end, MIGRATE_CMA);
+	if (ret)
+		return ret;
+
+	ret = migrate_prep();
+	if (ret)
+		goto done;
+
+	for (tries = 0; tries < CONTIG_RANGE_RETRIES; tries++) {
+		ret = __alloc_contig_migrate_range(outer_start, outer_end);
+		if (ret < 0 && tries == CONTIG_RANGE_RETRIES - 1)
+			goto done;
+
+		/* pages freed since isolation may sit on per-cpu lists */
+		lru_add_drain_all();
+		drain_all_pages();
+		if (__grab_isolated_range(zone, outer_start, outer_end))
+			break;
+		cond_resched();
+	}
+	if (tries == CONTIG_RANGE_RETRIES) {
+		ret = -EBUSY;
+		goto done;
+	}
+	ret = 0;
+
+	if (start != outer_start)
+		free_contig_range(outer_start, start - outer_start);
+	if (end != outer_end)
+		free_contig_range(end, outer_end - end);
+
+done:
+	undo_isolate_page_range(outer_start, outer_end, MIGRATE_CMA);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned nr_pages)
+{
+	for (; nr_pages--; ++pfn)
+		__free_page(pfn_to_page(pfn));
+}
+#endif
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
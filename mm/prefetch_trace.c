@@ -0,0 +1,624 @@
+/*
+ * Page cache access trace and replay
+ *
+ * Record the file pages used while the system boots or an application
+ * starts, and read them all back in, sorted and in large chunks, the next
+ * time round instead of waiting for scattered demand paging.
+ *
+ * Control is through /proc/prefetch_trace:
+ *
+ *	record		start a new trace
+ *	stop		stop recording
+ *	clear		stop recording and forget the trace
+ *	save <file>	stop recording and write the trace to <file>
+ *	replay <file>	read ahead everything listed in <file>
+ *
+ * Reading it shows the current trace.  prefetch_trace=record on the
+ * command line starts recording at boot.  A trace has one line per range,
+ * "<path> <first page> <pages>", with blanks and backslashes in the path
+ * escaped as \ooo like in /proc/mounts.  Lines starting with '#' are
+ * ignored.
+ *
+ * Copyright (c) 2012, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/sort.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <linux/prefetch_trace.h>
+
+#define PT_HASH_BITS		8
+#define PT_MAX_FILES		4096
+#define PT_MAX_EXTENTS		1024	/* per file */
+#define PT_MAX_TRACE_SIZE	(8 << 20)
+#define PT_REPLAY_BATCH		64	/* files open at once during replay */
+
+#define isodigit(c)		((c) >= '0' && (c) <= '7')
+
+struct pt_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct pt_file {
+	struct hlist_node hash;
+	struct list_head list;		/* in order of first use */
+	dev_t dev;
+	unsigned long ino;
+	char *path;			/* escaped when recorded */
+	struct pt_extent *ext;
+	unsigned int nr_ext;
+	unsigned int max_ext;
+	/* replay only */
+	struct file *filp;
+	sector_t block;
+};
+
+int prefetch_trace_recording;
+
+/* Protects everything below */
+static DEFINE_MUTEX(pt_mutex);
+static struct hlist_head pt_hash[1 << PT_HASH_BITS];
+static LIST_HEAD(pt_files);
+static unsigned int pt_nr_files;
+static struct {
+	unsigned long records;
+	unsigned long dropped;
+	unsigned long replays;
+	unsigned long replay_files;
+	unsigned long replay_pages;
+} pt_stats;
+
+static void pt_free_file(struct pt_file *pf)
+{
+	kfree(pf->path);
+	kfree(pf->ext);
+	kfree(pf);
+}
+
+static void pt_clear(void)
+{
+	struct pt_file *pf, *next;
+	int i;
+
+	list_for_each_entry_safe(pf, next, &pt_files, list)
+		pt_free_file(pf);
+	INIT_LIST_HEAD(&pt_files);
+	for (i = 0; i < ARRAY_SIZE(pt_hash); i++)
+		INIT_HLIST_HEAD(&pt_hash[i]);
+	pt_nr_files = 0;
+}
+
+static struct hlist_head *pt_bucket(dev_t dev, unsigned long ino)
+{
+	return &pt_hash[hash_long(ino ^ dev, PT_HASH_BITS)];
+}
+
+/* Escape what would break the line format, as seq_escape() does */
+static void pt_escape(char *dst, const char *src)
+{
+	for (; *src; src++) {
+		if (*src == ' ' || *src == '\t' || *src == '\n' ||
+		    *src == '\\') {
+			*dst++ = '\\';
+			*dst++ = '0' + ((*src & 0300) >> 6);
+			*dst++ = '0' + ((*src & 070) >> 3);
+			*dst++ = '0' + (*src & 07);
+		} else
+			*dst++ = *src;
+	}
+	*dst = '\0';
+}
+
+static void pt_unescape(char *s)
+{
+	char *dst = s;
+
+	for (; *s; s++) {
+		if (s[0] == '\\' && isodigit(s[1]) && isodigit(s[2]) &&
+		    isodigit(s[3])) {
+			*dst++ = ((s[1] - '0') << 6) | ((s[2] - '0') << 3) |
+				 (s[3] - '0');
+			s += 3;
+		} else
+			*dst++ = *s;
+	}
+	*dst = '\0';
+}
+
+static struct pt_file *pt_add_file(struct file *file, struct inode *inode)
+{
+	struct pt_file *pf;
+	char *buf, *path;
+
+	if (pt_nr_files >= PT_MAX_FILES)
+		return NULL;
+
+	pf = kzalloc(sizeof(*pf), GFP_NOFS);
+	buf = (char *)__get_free_page(GFP_NOFS);
+	if (!pf || !buf)
+		goto out_free;
+
+	path = d_path(&file->f_path, buf, PAGE_SIZE);
+	if (IS_ERR(path))
+		goto out_free;
+	pf->path = kmalloc(strlen(path) * 4 + 1, GFP_NOFS);
+	if (!pf->path)
+		goto out_free;
+	pt_escape(pf->path, path);
+	free_page((unsigned long)buf);
+
+	pf->dev = inode->i_sb->s_dev;
+	pf->ino = inode->i_ino;
+	hlist_add_head(&pf->hash, pt_bucket(pf->dev, pf->ino));
+	list_add_tail(&pf->list, &pt_files);
+	pt_nr_files++;
+	return pf;
+
+out_free:
+	free_page((unsigned long)buf);
+	if (pf)
+		kfree(pf->path);
+	kfree(pf);
+	return NULL;
+}
+
+static int pt_add_extent(struct pt_file *pf, pgoff_t start, unsigned long nr)
+{
+	struct pt_extent *ext;
+
+	/* Readers mostly go forward, so try the last range first */
+	if (pf->nr_ext) {
+		ext = &pf->ext[pf->nr_ext - 1];
+		if (start <= ext->start + ext->nr && start + nr >= ext->start) {
+			pgoff_t end = max(ext->start + ext->nr, start + nr);
+
+			ext->start = min(ext->start, start);
+			ext->nr = end - ext->start;
+			return 0;
+		}
+	}
+
+	if (pf->nr_ext == pf->max_ext) {
+		unsigned int max = pf->max_ext ? pf->max_ext * 2 : 4;
+
+		if (max > PT_MAX_EXTENTS)
+			return -ENOSPC;
+		ext = krealloc(pf->ext, max * sizeof(*ext), GFP_NOFS);
+		if (!ext)
+			return -ENOMEM;
+		pf->ext = ext;
+		pf->max_ext = max;
+	}
+	pf->ext[pf->nr_ext].start = start;
+	pf->ext[pf->nr_ext].nr = nr;
+	pf->nr_ext++;
+	return 0;
+}
+
+void __prefetch_trace_record(struct file *file, pgoff_t index,
+			     unsigned long nr)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct hlist_node *node;
+	struct pt_file *pf;
+
+	/* Only what can be read back from a block device is worth it */
+	if (!nr || !S_ISREG(inode->i_mode) || !inode->i_sb->s_bdev)
+		return;
+
+	mutex_lock(&pt_mutex);
+	if (!prefetch_trace_recording)
+		goto out;
+
+	hlist_for_each_entry(pf, node, pt_bucket(inode->i_sb->s_dev,
+						 inode->i_ino), hash) {
+		if (pf->dev == inode->i_sb->s_dev && pf->ino == inode->i_ino)
+			goto found;
+	}
+	pf = pt_add_file(file, inode);
+	if (!pf)
+		goto drop;
+found:
+	if (pt_add_extent(pf, index, nr))
+		goto drop;
+	pt_stats.records++;
+out:
+	mutex_unlock(&pt_mutex);
+	return;
+drop:
+	pt_stats.dropped++;
+	mutex_unlock(&pt_mutex);
+}
+
+static int pt_cmp_extent(const void *a, const void *b)
+{
+	const struct pt_extent *x = a, *y = b;
+
+	if (x->start < y->start)
+		return -1;
+	return x->start > y->start;
+}
+
+/* Sort the ranges of a file and merge those that touch */
+static void pt_compact(struct pt_file *pf)
+{
+	unsigned int i, n = 0;
+
+	if (pf->nr_ext < 2)
+		return;
+
+	sort(pf->ext, pf->nr_ext, sizeof(*pf->ext), pt_cmp_extent, NULL);
+	for (i = 1; i < pf->nr_ext; i++) {
+		struct pt_extent *last = &pf->ext[n], *ext = &pf->ext[i];
+
+		if (ext->start <= last->start + last->nr) {
+			last->nr = max(last->start + last->nr,
+				       ext->start + ext->nr) - last->start;
+		} else
+			pf->ext[++n] = *ext;
+	}
+	pf->nr_ext = n + 1;
+}
+
+/*
+ * Saving
+ */
+
+static void *pt_seq_start(struct seq_file *m, loff_t *pos)
+{
+	struct pt_file *pf;
+
+	mutex_lock(&pt_mutex);
+	if (!*pos)
+		list_for_each_entry(pf, &pt_files, list)
+			pt_compact(pf);
+	return seq_list_start_head(&pt_files, *pos);
+}
+
+static void *pt_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &pt_files, pos);
+}
+
+static void pt_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&pt_mutex);
+}
+
+static int pt_seq_show(struct seq_file *m, void *v)
+{
+	struct pt_file *pf;
+	unsigned int i;
+
+	if (v == &pt_files) {
+		seq_printf(m, "# recording %d files %u records %lu dropped %lu"
+			   " replays %lu replayed files %lu pages %lu\n",
+			   prefetch_trace_recording, pt_nr_files,
+			   pt_stats.records, pt_stats.dropped,
+			   pt_stats.replays, pt_stats.replay_files,
+			   pt_stats.replay_pages);
+		return 0;
+	}
+
+	pf = list_entry(v, struct pt_file, list);
+	for (i = 0; i < pf->nr_ext; i++)
+		seq_printf(m, "%s %lu %lu\n", pf->path,
+			   (unsigned long)pf->ext[i].start, pf->ext[i].nr);
+	return 0;
+}
+
+static const struct seq_operations pt_seq_ops = {
+	.start	= pt_seq_start,
+	.next	= pt_seq_next,
+	.stop	= pt_seq_stop,
+	.show	= pt_seq_show,
+};
+
+static int pt_save(const char *name)
+{
+	struct file *filp;
+	struct pt_file *pf;
+	mm_segment_t old_fs;
+	char *buf;
+	loff_t pos = 0;
+	unsigned int i;
+	int len, err = 0;
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	filp = filp_open(name, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE,
+			 0600);
+	if (IS_ERR(filp)) {
+		free_page((unsigned long)buf);
+		return PTR_ERR(filp);
+	}
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	mutex_lock(&pt_mutex);
+	prefetch_trace_recording = 0;
+	list_for_each_entry(pf, &pt_files, list) {
+		pt_compact(pf);
+		for (i = 0; i < pf->nr_ext && !err; i++) {
+			len = snprintf(buf, PAGE_SIZE, "%s %lu %lu\n",
+				       pf->path,
+				       (unsigned long)pf->ext[i].start,
+				       pf->ext[i].nr);
+			if (len >= PAGE_SIZE)
+				continue;
+			if (vfs_write(filp, (char __user *)buf, len, &pos) != len)
+				err = -EIO;
+		}
+		if (err)
+			break;
+	}
+	mutex_unlock(&pt_mutex);
+	set_fs(old_fs);
+
+	if (!err)
+		err = vfs_fsync(filp, 0);
+	filp_close(filp, NULL);
+	free_page((unsigned long)buf);
+	return err;
+}
+
+/*
+ * Replay
+ */
+
+struct pt_replay_work {
+	struct work_struct work;
+	char *trace;
+	size_t size;
+};
+
+static int pt_cmp_block(const void *a, const void *b)
+{
+	const struct pt_file *x = *(struct pt_file **)a;
+	const struct pt_file *y = *(struct pt_file **)b;
+
+	if (x->block < y->block)
+		return -1;
+	return x->block > y->block;
+}
+
+/*
+ * Open a batch of files, sort them by where their data starts on the
+ * device and read ahead their ranges in that order.
+ */
+static void pt_replay_batch(struct pt_file **batch, int nr)
+{
+	unsigned long pages = 0, files = 0;
+	int i, j;
+
+	for (i = 0; i < nr; i++) {
+		struct pt_file *pf = batch[i];
+		struct inode *inode;
+
+		pf->filp = filp_open(pf->path, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(pf->filp)) {
+			pf->filp = NULL;
+			continue;
+		}
+		inode = pf->filp->f_mapping->host;
+		pf->block = bmap(inode, pf->ext[0].start <<
+				 (PAGE_CACHE_SHIFT - inode->i_blkbits));
+	}
+
+	sort(batch, nr, sizeof(*batch), pt_cmp_block, NULL);
+
+	for (i = 0; i < nr; i++) {
+		struct pt_file *pf = batch[i];
+
+		if (!pf->filp)
+			continue;
+		for (j = 0; j < pf->nr_ext; j++) {
+			force_page_cache_readahead(pf->filp->f_mapping,
+						   pf->filp, pf->ext[j].start,
+						   pf->ext[j].nr);
+			pages += pf->ext[j].nr;
+		}
+		fput(pf->filp);
+		pf->filp = NULL;
+		files++;
+	}
+
+	mutex_lock(&pt_mutex);
+	pt_stats.replay_files += files;
+	pt_stats.replay_pages += pages;
+	mutex_unlock(&pt_mutex);
+}
+
+static void pt_replay_fn(struct work_struct *work)
+{
+	struct pt_replay_work *rw =
+		container_of(work, struct pt_replay_work, work);
+	struct pt_file *batch[PT_REPLAY_BATCH];
+	struct pt_file *pf = NULL, *next;
+	LIST_HEAD(files);
+	char *line, *s = rw->trace;
+	int nr = 0;
+
+	/* Parse the whole trace first, lines of a file are together */
+	while ((line = strsep(&s, "\n")) != NULL) {
+		unsigned long start, count;
+		char *path = strsep(&line, " ");
+
+		if (!line || *path == '#' ||
+		    sscanf(line, "%lu %lu", &start, &count) != 2 || !count)
+			continue;
+		pt_unescape(path);
+		if (!pf || strcmp(pf->path, path)) {
+			pf = kzalloc(sizeof(*pf), GFP_KERNEL);
+			if (!pf)
+				break;
+			pf->path = path;	/* points into rw->trace */
+			list_add_tail(&pf->list, &files);
+		}
+		pt_add_extent(pf, start, count);
+	}
+
+	list_for_each_entry(pf, &files, list) {
+		if (!pf->nr_ext)
+			continue;
+		batch[nr++] = pf;
+		if (nr == PT_REPLAY_BATCH) {
+			pt_replay_batch(batch, nr);
+			nr = 0;
+		}
+	}
+	if (nr)
+		pt_replay_batch(batch, nr);
+
+	list_for_each_entry_safe(pf, next, &files, list) {
+		kfree(pf->ext);
+		kfree(pf);
+	}
+	vfree(rw->trace);
+	kfree(rw);
+}
+
+static int pt_replay(const char *name)
+{
+	struct pt_replay_work *rw;
+	struct file *filp;
+	loff_t size;
+	int err;
+
+	filp = filp_open(name, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	err = -EFBIG;
+	size = i_size_read(filp->f_mapping->host);
+	if (size > PT_MAX_TRACE_SIZE)
+		goto out;
+
+	err = -ENOMEM;
+	rw = kzalloc(sizeof(*rw), GFP_KERNEL);
+	if (!rw)
+		goto out;
+	rw->trace = vmalloc(size + 1);
+	if (!rw->trace) {
+		kfree(rw);
+		goto out;
+	}
+
+	err = kernel_read(filp, 0, rw->trace, size);
+	if (err != size) {
+		vfree(rw->trace);
+		kfree(rw);
+		err = err < 0 ? err : -EIO;
+		goto out;
+	}
+	rw->trace[size] = '\0';
+	rw->size = size;
+
+	mutex_lock(&pt_mutex);
+	pt_stats.replays++;
+	mutex_unlock(&pt_mutex);
+
+	/* The reads are issued in the background, the caller goes on */
+	INIT_WORK(&rw->work, pt_replay_fn);
+	queue_work(system_unbound_wq, &rw->work);
+	err = 0;
+out:
+	filp_close(filp, NULL);
+	return err;
+}
+
+/*
+ * Control
+ */
+
+static int pt_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &pt_seq_ops);
+}
+
+static ssize_t pt_write(struct file *file, const char __user *ubuf,
+			size_t count, loff_t *ppos)
+{
+	char *buf, *cmd;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	if (count >= PATH_MAX + 8)
+		return -EINVAL;
+
+	buf = kmalloc(count + 1, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	err = -EFAULT;
+	if (copy_from_user(buf, ubuf, count))
+		goto out;
+	buf[count] = '\0';
+	cmd = strim(buf);
+
+	err = 0;
+	if (!strcmp(cmd, "record")) {
+		mutex_lock(&pt_mutex);
+		pt_clear();
+		memset(&pt_stats, 0, sizeof(pt_stats));
+		prefetch_trace_recording = 1;
+		mutex_unlock(&pt_mutex);
+	} else if (!strcmp(cmd, "stop")) {
+		prefetch_trace_recording = 0;
+	} else if (!strcmp(cmd, "clear")) {
+		mutex_lock(&pt_mutex);
+		prefetch_trace_recording = 0;
+		pt_clear();
+		mutex_unlock(&pt_mutex);
+	} else if (!strncmp(cmd, "save ", 5)) {
+		err = pt_save(skip_spaces(cmd + 5));
+	} else if (!strncmp(cmd, "replay ", 7)) {
+		err = pt_replay(skip_spaces(cmd + 7));
+	} else
+		err = -EINVAL;
+out:
+	kfree(buf);
+	return err ? err : count;
+}
+
+static const struct file_operations pt_fops = {
+	.open		= pt_open,
+	.read		= seq_read,
+	.write		= pt_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init prefetch_trace_setup(char *str)
+{
+	if (!strcmp(str, "record"))
+		prefetch_trace_recording = 1;
+	return 1;
+}
+__setup("prefetch_trace=", prefetch_trace_setup);
+
+static int __init prefetch_trace_init(void)
+{
+	if (!proc_create("prefetch_trace", S_IRUSR | S_IWUSR, NULL, &pt_fops))
+		return -ENOMEM;
+	return 0;
+}
+module_init(prefetch_trace_init);
@@ -245,6 +245,72 @@ unsigned long max_sane_readahead(unsigned long nr)
 		+ node_page_state(numa_node_id(), NR_FREE_PAGES)) / 2);
 }
 
+/*
+ * Adaptive readahead, see struct bdi_ra_adapt.
+ *
+ * Every period the share of read-ahead pages that readers went on to use
+ * is looked at.  Mostly sequential streams (media playback, copies) use
+ * nearly all of it and get a bigger window, as long as the device keeps
+ * up; scattered reads (application start, page faults in libraries) waste
+ * most of it and get a smaller one.
+ */
+#define RA_ADAPT_GROW_RATIO	75	/* % used to double the window */
+#define RA_ADAPT_SHRINK_RATIO	40	/* % used below which it is halved */
+
+void bdi_ra_account(struct backing_dev_info *bdi, unsigned long issued,
+		    unsigned long used)
+{
+	struct bdi_ra_adapt *ra = &bdi->ra_adapt;
+	unsigned long period = max(ra->max_pages * 4, 64UL);
+	unsigned long window;
+	unsigned int ratio;
+
+	if (!ra->enabled)
+		return;
+
+	atomic_long_add(used, &ra->used);
+	if (atomic_long_add_return(issued, &ra->issued) < period)
+		return;
+	if (!spin_trylock(&ra->lock))
+		return;
+	/* Somebody else may have just closed this period */
+	if (atomic_long_read(&ra->issued) < period)
+		goto out;
+
+	issued = atomic_long_xchg(&ra->issued, 0);
+	used = atomic_long_xchg(&ra->used, 0);
+	ratio = min(used * 100 / issued, 100UL);
+	ra->ratio = ratio;
+
+	window = bdi->ra_pages;
+	if (ratio >= RA_ADAPT_GROW_RATIO && ra->lat_us <= ra->lat_target_us)
+		window = min(window * 2, ra->max_pages);
+	else if (ratio < RA_ADAPT_SHRINK_RATIO)
+		window = max(window / 2, ra->min_pages);
+
+	if (window > bdi->ra_pages)
+		ra->grow++;
+	else if (window < bdi->ra_pages)
+		ra->shrink++;
+	bdi->ra_pages = window;
+out:
+	spin_unlock(&ra->lock);
+}
+
+/*
+ * The window to use for a stream on this device: the controller's when it
+ * is on, so files opened before it moved follow it too.
+ */
+unsigned long ra_window(struct address_space *mapping,
+			struct file_ra_state *ra)
+{
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
+
+	if (bdi->ra_adapt.enabled && bdi->ra_pages)
+		return bdi->ra_pages;
+	return ra->ra_pages;
+}
+
 /*
  * Submit IO for the read-ahead request in file_ra_state.
  */
@@ -398,7 +464,9 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long max = max_sane_readahead(ra_window(mapping, ra));
+	unsigned long used = req_size;	/* pages known to be wanted */
+	unsigned long actual;
 
 	/*
 	 * start of file
@@ -412,6 +480,8 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
+		/* The previous window was read through */
+		used = ra->size;
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -437,6 +507,7 @@ ondemand_readahead(struct address_space *mapping,
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
+		used = ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
 		goto readit;
@@ -483,7 +554,9 @@ readit:
 		ra->size += ra->async_size;
 	}
 
-	return ra_submit(ra, mapping, filp);
+	actual = ra_submit(ra, mapping, filp);
+	bdi_ra_account(mapping->backing_dev_info, actual, used);
+	return actual;
 }
 
 /**
@@ -1550,18 +1550,24 @@ static inline void remove_partial(struct kmem_cache_node *n,
 	n->nr_partial--;
 }
 
+static int put_cpu_partial(struct kmem_cache *s, struct page *page, int drain);
+
 /*
- * Lock slab, remove from the partial list and put the object into the
- * per cpu freelist.
+ * Lock slab and remove it from the partial list. If mode is set the
+ * objects go into the per cpu freelist, otherwise they are left on the
+ * frozen page for the per cpu partial list.
+ *
+ * Returns the number of free objects taken over, 0 if there were none.
  *
  * Must hold list_lock.
  */
 static inline int acquire_slab(struct kmem_cache *s,
-		struct kmem_cache_node *n, struct page *page)
+		struct kmem_cache_node *n, struct page *page, int mode)
 {
 	void *freelist;
 	unsigned long counters;
 	struct page new;
+	int available;
 
 	/*
 	 * Zap the freelist and set the frozen bit.
@@ -1572,24 +1578,31 @@ static inline int acquire_slab(struct kmem_cache *s,
 		freelist = page->freelist;
 		counters = page->counters;
 		new.counters = counters;
-		new.inuse = page->objects;
+		available = page->objects - new.inuse;
+		if (mode) {
+			new.inuse = page->objects;
+			new.freelist = NULL;
+		} else
+			new.freelist = freelist;
 
 		VM_BUG_ON(new.frozen);
 		new.frozen = 1;
 
 	} while (!__cmpxchg_double_slab(s, page,
 			freelist, counters,
-			NULL, new.counters,
+			new.freelist, new.counters,
 			"lock and freeze"));
 
 	remove_partial(n, page);
 
 	if (freelist) {
-		/* Populate the per cpu freelist */
-		this_cpu_write(s->cpu_slab->freelist, freelist);
-		this_cpu_write(s->cpu_slab->page, page);
-		this_cpu_write(s->cpu_slab->node, page_to_nid(page));
-		return 1;
+		if (mode) {
+			/* Populate the per cpu freelist */
+			this_cpu_write(s->cpu_slab->freelist, freelist);
+			this_cpu_write(s->cpu_slab->page, page);
+			this_cpu_write(s->cpu_slab->node, page_to_nid(page));
+		}
+		return available;
 	} else {
 		/*
 		 * Slab page came from the wrong list. No object to allocate
@@ -1608,7 +1621,8 @@ static inline int acquire_slab(struct kmem_cache *s,
 static struct page *get_partial_node(struct kmem_cache *s,
 					struct kmem_cache_node *n)
 {
-	struct page *page;
+	struct page *page, *page2, *cpu_page = NULL;
+	int available = 0;
 
 	/*
 	 * Racy check. If we mistakenly see no partial slabs then we
@@ -1619,14 +1633,29 @@ static struct page *get_partial_node(struct kmem_cache *s,
 	if (!n || !n->nr_partial)
 		return NULL;
 
+	/*
+	 * The first slab becomes the cpu slab. While the list lock is held
+	 * anyway, further slabs are moved to the per cpu partial list until
+	 * it holds half of cpu_partial objects.
+	 */
 	spin_lock(&n->list_lock);
-	list_for_each_entry(page, &n->partial, lru)
-		if (acquire_slab(s, n, page))
-			goto out;
-	page = NULL;
-out:
+	list_for_each_entry_safe(page, page2, &n->partial, lru) {
+		int t = acquire_slab(s, n, page, cpu_page == NULL);
+
+		if (!t)
+			continue;
+
+		if (!cpu_page)
+			cpu_page = page;
+		else
+			put_cpu_partial(s, page, 0);
+
+		available += t;
+		if (kmem_cache_debug(s) || available > s->cpu_partial / 2)
+			break;
+	}
 	spin_unlock(&n->list_lock);
-	return page;
+	return cpu_page;
 }
 
 /*
@@ -1920,6 +1949,121 @@ redo:
 	}
 }
 
+/*
+ * Move the frozen slabs on the per cpu partial list of c back to the
+ * node partial lists, or free them if they are empty and the node has
+ * enough partial slabs.
+ *
+ * Called with interrupts disabled, either on the cpu owning c or for a
+ * cpu that has gone offline.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct kmem_cache_node *n = NULL;
+	struct page *page, *discard_page = NULL;
+
+	while ((page = c->partial)) {
+		struct kmem_cache_node *n2 = get_node(s, page_to_nid(page));
+		struct page new;
+		struct page old;
+
+		c->partial = page->next;
+
+		/*
+		 * Take the list lock before unfreezing, so that a free on
+		 * another cpu that needs list processing waits until the
+		 * page is on the partial list.
+		 */
+		if (n != n2) {
+			if (n)
+				spin_unlock(&n->list_lock);
+			n = n2;
+			spin_lock(&n->list_lock);
+		}
+
+		do {
+			old.freelist = page->freelist;
+			old.counters = page->counters;
+			VM_BUG_ON(!old.frozen);
+
+			new.counters = old.counters;
+			new.freelist = old.freelist;
+			new.frozen = 0;
+
+		} while (!__cmpxchg_double_slab(s, page,
+				old.freelist, old.counters,
+				new.freelist, new.counters,
+				"unfreezing partial"));
+
+		if (unlikely(!new.inuse && n->nr_partial > s->min_partial)) {
+			page->next = discard_page;
+			discard_page = page;
+		} else {
+			add_partial(n, page, 1);
+			stat(s, FREE_ADD_PARTIAL);
+		}
+	}
+
+	if (n)
+		spin_unlock(&n->list_lock);
+
+	while (discard_page) {
+		page = discard_page;
+		discard_page = discard_page->next;
+
+		stat(s, DEACTIVATE_EMPTY);
+		discard_slab(s, page);
+		stat(s, FREE_SLAB);
+	}
+}
+
+/*
+ * Put a page that was just frozen (in __slab_free or get_partial_node)
+ * onto the per cpu partial list. If drain is set and the list already
+ * holds more than cpu_partial objects, it is moved to the node partial
+ * list first.
+ *
+ * Returns the number of objects on the per cpu partial list.
+ */
+static int put_cpu_partial(struct kmem_cache *s, struct page *page, int drain)
+{
+	struct page *oldpage;
+	int pages;
+	int pobjects;
+
+	do {
+		pages = 0;
+		pobjects = 0;
+		oldpage = this_cpu_read(s->cpu_slab->partial);
+
+		if (oldpage) {
+			pobjects = oldpage->pobjects;
+			pages = oldpage->pages;
+			if (drain && pobjects > s->cpu_partial) {
+				unsigned long flags;
+
+				local_irq_save(flags);
+				unfreeze_partials(s, this_cpu_ptr(s->cpu_slab));
+				local_irq_restore(flags);
+				oldpage = NULL;
+				pobjects = 0;
+				pages = 0;
+			}
+		}
+
+		pages++;
+		pobjects += page->objects - page->inuse;
+
+		page->pages = pages;
+		page->pobjects = pobjects;
+		page->next = oldpage;
+
+	} while (irqsafe_cpu_cmpxchg(s->cpu_slab->partial, oldpage, page)
+								!= oldpage);
+	stat(s, CPU_PARTIAL_FREE);
+	return pobjects;
+}
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	stat(s, CPUSLAB_FLUSH);
@@ -1935,8 +2079,12 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	if (likely(c && c->page))
-		flush_slab(s, c);
+	if (likely(c)) {
+		if (c->page)
+			flush_slab(s, c);
+
+		unfreeze_partials(s, c);
+	}
 }
 
 static void flush_cpu_slab(void *d)
@@ -1946,9 +2094,42 @@ static void flush_cpu_slab(void *d)
 	__flush_cpu_slab(s, smp_processor_id());
 }
 
+static bool has_cpu_slab(int cpu, struct kmem_cache *s)
+{
+	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+	return c->page || c->partial;
+}
+
+/*
+ * Only interrupt the cpus that hold slabs of this cache, so that idle
+ * cpus are not pulled out of a low power state for nothing.
+ */
 static void flush_all(struct kmem_cache *s)
 {
-	on_each_cpu(flush_cpu_slab, s, 1);
+	cpumask_var_t cpus;
+	unsigned long flags;
+	int cpu;
+
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL)) {
+		on_each_cpu(flush_cpu_slab, s, 1);
+		return;
+	}
+
+	preempt_disable();
+	for_each_online_cpu(cpu)
+		if (has_cpu_slab(cpu, s))
+			cpumask_set_cpu(cpu, cpus);
+
+	smp_call_function_many(cpus, flush_cpu_slab, s, 1);
+	if (cpumask_test_cpu(smp_processor_id(), cpus)) {
+		local_irq_save(flags);
+		flush_cpu_slab(s);
+		local_irq_restore(flags);
+	}
+	preempt_enable();
+
+	free_cpumask_var(cpus);
 }
 
 /*
@@ -2067,6 +2248,7 @@ static void *__slab_alloc(struct kmem_cache *s, gfp_t gfpflags, int node,
 	/* We handle __GFP_ZERO in the caller */
 	gfpflags &= ~__GFP_ZERO;
 
+redo:
 	page = c->page;
 	if (!page)
 		goto new_slab;
@@ -2124,6 +2306,15 @@ load_freelist:
 	return object;
 
 new_slab:
+	if (c->partial) {
+		c->page = c->partial;
+		c->partial = c->page->next;
+		c->node = page_to_nid(c->page);
+		stat(s, CPU_PARTIAL_ALLOC);
+		c->freelist = NULL;
+		goto redo;
+	}
+
 	page = get_partial(s, gfpflags, node);
 	if (page) {
 		stat(s, ALLOC_FROM_PARTIAL);
@@ -2338,16 +2529,31 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 		was_frozen = new.frozen;
 		new.inuse--;
 		if ((!new.inuse || !prior) && !was_frozen && !n) {
-                        n = get_node(s, page_to_nid(page));
-			/*
-			 * Speculatively acquire the list_lock.
-			 * If the cmpxchg does not succeed then we may
-			 * drop the list_lock without any processing.
-			 *
-			 * Otherwise the list_lock will synchronize with
-			 * other processors updating the list of slabs.
-			 */
-                        spin_lock_irqsave(&n->list_lock, flags);
+
+			if (s->cpu_partial && !kmem_cache_debug(s) && !prior)
+
+				/*
+				 * Slab was on no list before and will be
+				 * partially empty. Instead of taking the
+				 * list_lock, freeze it for the per cpu
+				 * partial list.
+				 */
+				new.frozen = 1;
+
+			else { /* Needs to be taken off a list */
+
+				n = get_node(s, page_to_nid(page));
+				/*
+				 * Speculatively acquire the list_lock.
+				 * If the cmpxchg does not succeed then we may
+				 * drop the list_lock without any processing.
+				 *
+				 * Otherwise the list_lock will synchronize with
+				 * other processors updating the list of slabs.
+				 */
+				spin_lock_irqsave(&n->list_lock, flags);
+
+			}
 		}
 		inuse = new.inuse;
 
@@ -2357,6 +2563,14 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 		"__slab_free"));
 
 	if (likely(!n)) {
+
+		/*
+		 * If we just froze the page then put it onto the
+		 * per cpu partial list.
+		 */
+		if (new.frozen && !was_frozen)
+			put_cpu_partial(s, page, 1);
+
                 /*
 		 * The list lock was not taken therefore no list
 		 * activity can be necessary.
@@ -2917,6 +3131,25 @@ static int kmem_cache_open(struct kmem_cache *s,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+
+	/*
+	 * cpu_partial bounds the free objects each cpu keeps on frozen
+	 * partial slabs, taken without the list_lock. With at most four
+	 * cores, which spend much of their time offline or in LP2, these
+	 * are kept smaller than a server would want so that little memory
+	 * is stranded on idle cpus.
+	 */
+	if (kmem_cache_debug(s))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 4;
+	else if (s->size >= 256)
+		s->cpu_partial = 8;
+	else
+		s->cpu_partial = 16;
+
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -4490,6 +4723,29 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long objects;
+	int err;
+
+	err = strict_strtoul(buf, 10, &objects);
+	if (err)
+		return err;
+	if (objects && kmem_cache_debug(s))
+		return -EINVAL;
+
+	s->cpu_partial = objects;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -4850,6 +5106,8 @@ STAT_ATTR(DEACTIVATE_BYPASS, deactivate_bypass);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
 STAT_ATTR(CMPXCHG_DOUBLE_CPU_FAIL, cmpxchg_double_cpu_fail);
 STAT_ATTR(CMPXCHG_DOUBLE_FAIL, cmpxchg_double_fail);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4858,6 +5116,7 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -4910,6 +5169,8 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_bypass_attr.attr,
 	&order_fallback_attr.attr,
 	&cmpxchg_double_fail_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
 	&cmpxchg_double_cpu_fail_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
@@ -266,8 +266,11 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (unlikely(TestClearPageReadahead(page)))
+			swap_ra_hit(entry);
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -277,14 +280,17 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * Locate a page of swap in physical memory, reserving swap cache space
  * and reading the disk if it is not already cached.
  * A failure return means that either the page allocation failed or that
- * the swap entry is no longer in use.
+ * the swap entry is no longer in use.  *allocated is set if the page
+ * was newly allocated and its read started here.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*allocated = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -335,6 +341,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -352,6 +359,14 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, &allocated);
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -369,15 +384,21 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
  *
+ * The block size is chosen per swap area by valid_swaphandles(), from how
+ * many earlier readahead pages were faulted on: those pages are marked
+ * PG_readahead here, and lookup_swap_cache() counts the ones it finds.
+ *
  * Caller must hold down_read on the vma->vm_mm if vma is not NULL.
  */
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	int nr_pages;
+	int nr_ra = 0;
 	struct page *page;
 	unsigned long offset;
 	unsigned long end_offset;
+	bool allocated;
 
 	/*
 	 * Get starting offset for readaround, and number of pages to read.
@@ -389,12 +410,18 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	nr_pages = valid_swaphandles(entry, &offset);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(swp_entry(swp_type(entry), offset),
+						gfp_mask, vma, addr, &allocated);
 		if (!page)
 			break;
+		if (allocated && offset != swp_offset(entry)) {
+			SetPageReadahead(page);
+			nr_ra++;
+		}
 		page_cache_release(page);
 	}
+	if (nr_ra)
+		swap_ra_issued(entry, nr_ra);
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
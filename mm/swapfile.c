@@ -1680,6 +1680,63 @@ out:
 	return err;
 }
 
+/*
+ * Swapin readahead is sized per swap area, between page_cluster and a
+ * floor, from the share of readahead pages that end up being faulted on.
+ * A RAM-backed area pays a decompression and a page for each wasted
+ * readahead and saves no seek, so it starts with readahead off, drops
+ * back to it sooner, and probes with a small window every so often in
+ * case the access pattern has become sequential.
+ */
+#define SWAP_RA_SAMPLE		64	/* readahead pages per decision */
+#define SWAP_RA_PROBE		256	/* swapins between probes when off */
+
+static int swap_ra_min_order(struct swap_info_struct *si)
+{
+	return (si->flags & SWP_RAMBACKED) ? 0 : 1;
+}
+
+static void swap_ra_init(struct swap_info_struct *si)
+{
+	si->ra_order = swap_ra_min_order(si) ? page_cluster : 0;
+	si->ra_probe = 0;
+	atomic_set(&si->ra_win_issued, 0);
+	atomic_set(&si->ra_win_hits, 0);
+	atomic_long_set(&si->ra_issued, 0);
+	atomic_long_set(&si->ra_hits, 0);
+}
+
+static void swap_ra_adjust(struct swap_info_struct *si)
+{
+	int issued = atomic_xchg(&si->ra_win_issued, 0);
+	int hits = atomic_xchg(&si->ra_win_hits, 0);
+	int shrink = (si->flags & SWP_RAMBACKED) ? 2 : 4;
+	int order = si->ra_order;
+
+	if (hits * 4 >= issued * 3)
+		order++;
+	else if (hits * shrink < issued)
+		order--;
+	si->ra_order = clamp(order, swap_ra_min_order(si), page_cluster);
+}
+
+void swap_ra_issued(swp_entry_t entry, int nr)
+{
+	struct swap_info_struct *si = swap_info[swp_type(entry)];
+
+	atomic_long_add(nr, &si->ra_issued);
+	if (atomic_add_return(nr, &si->ra_win_issued) >= SWAP_RA_SAMPLE)
+		swap_ra_adjust(si);
+}
+
+void swap_ra_hit(swp_entry_t entry)
+{
+	struct swap_info_struct *si = swap_info[swp_type(entry)];
+
+	atomic_long_inc(&si->ra_hits);
+	atomic_inc(&si->ra_win_hits);
+}
+
 #ifdef CONFIG_PROC_FS
 static unsigned swaps_poll(struct file *file, poll_table *wait)
 {
@@ -1798,9 +1855,48 @@ static const struct file_operations proc_swaps_operations = {
 	.poll		= swaps_poll,
 };
 
+static int swap_ra_show(struct seq_file *swap, void *v)
+{
+	struct swap_info_struct *si = v;
+	int len;
+
+	if (si == SEQ_START_TOKEN) {
+		seq_puts(swap, "Filename\t\t\t\tWindow\tIssued\tHits\n");
+		return 0;
+	}
+
+	len = seq_path(swap, &si->swap_file->f_path, " \t\n\\");
+	seq_printf(swap, "%*s%d\t%lu\t%lu\n",
+			len < 40 ? 40 - len : 1, " ",
+			si->ra_order ? 1 << min(si->ra_order, page_cluster) : 0,
+			atomic_long_read(&si->ra_issued),
+			atomic_long_read(&si->ra_hits));
+	return 0;
+}
+
+static const struct seq_operations swap_ra_op = {
+	.start =	swap_start,
+	.next =		swap_next,
+	.stop =		swap_stop,
+	.show =		swap_ra_show
+};
+
+static int swap_ra_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &swap_ra_op);
+}
+
+static const struct file_operations proc_swap_ra_operations = {
+	.open		= swap_ra_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
 static int __init procswaps_init(void)
 {
 	proc_create("swaps", 0, NULL, &proc_swaps_operations);
+	proc_create("swap_readahead", 0, NULL, &proc_swap_ra_operations);
 	return 0;
 }
 __initcall(procswaps_init);
@@ -2105,9 +2201,12 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 			p->flags |= SWP_SOLIDSTATE;
 			p->cluster_next = 1 + (random32() % p->highest_bit);
 		}
+		if (blk_queue_rambacked(bdev_get_queue(p->bdev)))
+			p->flags |= SWP_RAMBACKED;
 		if (discard_swap(p) == 0 && (swap_flags & SWAP_FLAG_DISCARD))
 			p->flags |= SWP_DISCARDABLE;
 	}
+	swap_ra_init(p);
 
 	mutex_lock(&swapon_mutex);
 	prio = -1;
@@ -2296,15 +2395,24 @@ int swapcache_prepare(swp_entry_t entry)
 int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
 {
 	struct swap_info_struct *si;
-	int our_page_cluster = page_cluster;
+	int our_page_cluster;
 	pgoff_t target, toff;
 	pgoff_t base, end;
 	int nr_pages = 0;
 
-	if (!our_page_cluster)	/* no readahead */
+	if (!page_cluster)	/* no readahead */
 		return 0;
 
 	si = swap_info[swp_type(entry)];
+	our_page_cluster = min(si->ra_order, page_cluster);
+	if (!our_page_cluster) {
+		/* readahead is off for this area: probe now and then */
+		if (++si->ra_probe < SWAP_RA_PROBE)
+			return 0;
+		si->ra_probe = 0;
+		our_page_cluster = 1;
+	}
+
 	target = swp_offset(entry);
 	base = (target >> our_page_cluster) << our_page_cluster;
 	end = base + (1 << our_page_cluster);
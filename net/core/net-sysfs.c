@@ -559,34 +559,19 @@ static ssize_t show_rps_map(struct netdev_rx_queue *queue,
 	return len;
 }
 
-static ssize_t store_rps_map(struct netdev_rx_queue *queue,
-		      struct rx_queue_attribute *attribute,
-		      const char *buf, size_t len)
+static DEFINE_SPINLOCK(rps_map_lock);
+
+static int rps_map_set(struct netdev_rx_queue *queue,
+		       const struct cpumask *mask)
 {
 	struct rps_map *old_map, *map;
-	cpumask_var_t mask;
-	int err, cpu, i;
-	static DEFINE_SPINLOCK(rps_map_lock);
-
-	if (!capable(CAP_NET_ADMIN))
-		return -EPERM;
-
-	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
-		return -ENOMEM;
-
-	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
-	if (err) {
-		free_cpumask_var(mask);
-		return err;
-	}
+	int cpu, i;
 
 	map = kzalloc(max_t(unsigned,
 	    RPS_MAP_SIZE(cpumask_weight(mask)), L1_CACHE_BYTES),
 	    GFP_KERNEL);
-	if (!map) {
-		free_cpumask_var(mask);
+	if (!map)
 		return -ENOMEM;
-	}
 
 	i = 0;
 	for_each_cpu_and(cpu, mask, cpu_online_mask)
@@ -608,9 +593,48 @@ static ssize_t store_rps_map(struct netdev_rx_queue *queue,
 	if (old_map)
 		kfree_rcu(old_map, rcu);
 
+	return 0;
+}
+
+static ssize_t store_rps_map(struct netdev_rx_queue *queue,
+		      struct rx_queue_attribute *attribute,
+		      const char *buf, size_t len)
+{
+	cpumask_var_t mask;
+	int err;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
+	if (!err)
+		err = rps_map_set(queue, mask);
+
 	free_cpumask_var(mask);
-	return len;
+	return err ? err : len;
+}
+
+/**
+ *	netif_set_rps_cpus - steer received packets of a device to CPUs
+ *	@dev: network device
+ *	@mask: CPUs to spread over, offline ones are skipped
+ *
+ *	Kernel counterpart of writing rps_cpus for every receive queue.
+ *	An empty (or all offline) mask turns RPS off for the device.
+ */
+int netif_set_rps_cpus(struct net_device *dev, const struct cpumask *mask)
+{
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < dev->real_num_rx_queues && !err; i++)
+		err = rps_map_set(&dev->_rx[i], mask);
+	return err;
 }
+EXPORT_SYMBOL_GPL(netif_set_rps_cpus);
 
 static ssize_t show_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
 					   struct rx_queue_attribute *attr,
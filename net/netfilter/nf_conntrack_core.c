@@ -32,6 +32,8 @@
 #include <linux/mm.h>
 #include <linux/nsproxy.h>
 #include <linux/rculist_nulls.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
 
 #include <net/netfilter/nf_conntrack.h>
 #include <net/netfilter/nf_conntrack_l3proto.h>
@@ -68,6 +70,31 @@ EXPORT_PER_CPU_SYMBOL(nf_conntrack_untracked);
 
 unsigned int nf_conntrack_hash_rnd __read_mostly;
 
+/* Bumped around a hash table swap so lookups see a matching hash/size pair */
+static seqcount_t nf_conntrack_hash_seq = SEQCNT_ZERO;
+
+/* Double the init_net table once the average chain exceeds this length */
+#define NF_CT_HASH_GROW_FACTOR	2
+
+static bool nf_conntrack_hash_autogrow __read_mostly = true;
+module_param_named(hashsize_autogrow, nf_conntrack_hash_autogrow, bool, 0644);
+MODULE_PARM_DESC(hashsize_autogrow, "Grow the conntrack hash as the table fills");
+
+static void nf_conntrack_hash_grow(struct work_struct *work);
+static DECLARE_WORK(nf_conntrack_hash_grow_work, nf_conntrack_hash_grow);
+
+/*
+ * Small per-cpu cache of recently looked up tuples, indexed by the raw
+ * tuple hash, so established flows skip the bucket walk.  Entries hold
+ * no reference: conntracks are SLAB_DESTROY_BY_RCU, so a hit is
+ * validated exactly like a chain entry, and clean_from_lists() clears
+ * any slot still pointing at a conntrack leaving the table.
+ */
+#define NF_CT_FLOW_CACHE_SIZE	256
+
+static DEFINE_PER_CPU(struct nf_conntrack_tuple_hash *[NF_CT_FLOW_CACHE_SIZE],
+		      nf_ct_flow_cache);
+
 static u32 hash_conntrack_raw(const struct nf_conntrack_tuple *tuple, u16 zone)
 {
 	unsigned int n;
@@ -174,10 +201,31 @@ nf_ct_invert_tuple(struct nf_conntrack_tuple *inverse,
 }
 EXPORT_SYMBOL_GPL(nf_ct_invert_tuple);
 
+static void nf_ct_flow_cache_evict(struct nf_conn *ct)
+{
+	struct nf_conntrack_tuple_hash *h;
+	unsigned int slot;
+	int dir, cpu;
+
+	for (dir = 0; dir < IP_CT_DIR_MAX; dir++) {
+		h = &ct->tuplehash[dir];
+		slot = hash_conntrack_raw(&h->tuple, nf_ct_zone(ct)) &
+		       (NF_CT_FLOW_CACHE_SIZE - 1);
+		for_each_possible_cpu(cpu) {
+			struct nf_conntrack_tuple_hash **cache =
+				per_cpu(nf_ct_flow_cache, cpu);
+
+			if (cache[slot] == h)
+				cache[slot] = NULL;
+		}
+	}
+}
+
 static void
 clean_from_lists(struct nf_conn *ct)
 {
 	pr_debug("clean_from_lists(%p)\n", ct);
+	nf_ct_flow_cache_evict(ct);
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode);
 
@@ -313,15 +361,21 @@ ____nf_conntrack_find(struct net *net, u16 zone,
 		      const struct nf_conntrack_tuple *tuple, u32 hash)
 {
 	struct nf_conntrack_tuple_hash *h;
+	struct hlist_nulls_head *ct_hash;
 	struct hlist_nulls_node *n;
-	unsigned int bucket = hash_bucket(hash, net);
+	unsigned int bucket, seq;
 
 	/* Disable BHs the entire time since we normally need to disable them
 	 * at least once for the stats anyway.
 	 */
 	local_bh_disable();
+	do {
+		seq = read_seqcount_begin(&nf_conntrack_hash_seq);
+		ct_hash = net->ct.hash;
+		bucket = hash_bucket(hash, net);
+	} while (read_seqcount_retry(&nf_conntrack_hash_seq, seq));
 begin:
-	hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[bucket], hnnode) {
+	hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[bucket], hnnode) {
 		if (nf_ct_tuple_equal(tuple, &h->tuple) &&
 		    nf_ct_zone(nf_ct_tuplehash_to_ctrack(h)) == zone) {
 			NF_CT_STAT_INC(net, found);
@@ -353,6 +407,40 @@ __nf_conntrack_find(struct net *net, u16 zone,
 }
 EXPORT_SYMBOL_GPL(__nf_conntrack_find);
 
+/*
+ * Look the tuple up in this cpu's flow cache.  Returns the entry with a
+ * reference held, or NULL if the slot is empty or stale.  Caller holds
+ * rcu_read_lock() with BHs disabled.
+ */
+static struct nf_conntrack_tuple_hash *
+nf_ct_flow_cache_get(struct net *net, u16 zone,
+		     const struct nf_conntrack_tuple *tuple, u32 hash)
+{
+	struct nf_conntrack_tuple_hash *h;
+	struct nf_conn *ct;
+
+	h = ACCESS_ONCE(__get_cpu_var(nf_ct_flow_cache)
+				[hash & (NF_CT_FLOW_CACHE_SIZE - 1)]);
+	if (!h)
+		return NULL;
+
+	ct = nf_ct_tuplehash_to_ctrack(h);
+	if (unlikely(!atomic_inc_not_zero(&ct->ct_general.use)))
+		return NULL;
+
+	/* The object may have been recycled since it was cached */
+	if (unlikely(!nf_ct_is_confirmed(ct) || nf_ct_is_dying(ct) ||
+		     !net_eq(nf_ct_net(ct), net) ||
+		     !nf_ct_tuple_equal(tuple, &h->tuple) ||
+		     nf_ct_zone(ct) != zone)) {
+		nf_ct_put(ct);
+		return NULL;
+	}
+
+	NF_CT_STAT_INC(net, found);
+	return h;
+}
+
 /* Find a connection corresponding to a tuple. */
 static struct nf_conntrack_tuple_hash *
 __nf_conntrack_find_get(struct net *net, u16 zone,
@@ -362,6 +450,11 @@ __nf_conntrack_find_get(struct net *net, u16 zone,
 	struct nf_conn *ct;
 
 	rcu_read_lock();
+	local_bh_disable();
+	h = nf_ct_flow_cache_get(net, zone, tuple, hash);
+	local_bh_enable();
+	if (h)
+		goto out;
 begin:
 	h = ____nf_conntrack_find(net, zone, tuple, hash);
 	if (h) {
@@ -375,8 +468,13 @@ begin:
 				nf_ct_put(ct);
 				goto begin;
 			}
+			/* Only hashed entries may be cached, see above */
+			if (nf_ct_is_confirmed(ct))
+				this_cpu_write(nf_ct_flow_cache
+					[hash & (NF_CT_FLOW_CACHE_SIZE - 1)], h);
 		}
 	}
+out:
 	rcu_read_unlock();
 
 	return h;
@@ -512,6 +610,11 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	NF_CT_STAT_INC(net, insert);
 	spin_unlock_bh(&nf_conntrack_lock);
 
+	if (nf_conntrack_hash_autogrow && net_eq(net, &init_net) &&
+	    unlikely(atomic_read(&net->ct.count) >
+		     NF_CT_HASH_GROW_FACTOR * net->ct.htable_size))
+		schedule_work(&nf_conntrack_hash_grow_work);
+
 	help = nfct_help(ct);
 	if (help && help->helper)
 		nf_conntrack_event_cache(IPCT_HELPER, ct);
@@ -1316,8 +1419,10 @@ static void nf_conntrack_cleanup_net(struct net *net)
    supposed to kill the mall. */
 void nf_conntrack_cleanup(struct net *net)
 {
-	if (net_eq(net, &init_net))
+	if (net_eq(net, &init_net)) {
 		rcu_assign_pointer(ip_ct_attach, NULL);
+		cancel_work_sync(&nf_conntrack_hash_grow_work);
+	}
 
 	/* This makes sure all current packets have passed through
 	   netfilter framework.  Roll on, two-stage module
@@ -1357,25 +1462,14 @@ void *nf_ct_alloc_hashtable(unsigned int *sizep, int nulls)
 }
 EXPORT_SYMBOL_GPL(nf_ct_alloc_hashtable);
 
-int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
+static int nf_conntrack_hash_resize(unsigned int hashsize)
 {
 	int i, bucket;
-	unsigned int hashsize, old_size;
+	unsigned int old_size;
 	struct hlist_nulls_head *hash, *old_hash;
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 
-	if (current->nsproxy->net_ns != &init_net)
-		return -EOPNOTSUPP;
-
-	/* On boot, we can set this without any fancy locking. */
-	if (!nf_conntrack_htable_size)
-		return param_set_uint(val, kp);
-
-	hashsize = simple_strtoul(val, NULL, 0);
-	if (!hashsize)
-		return -EINVAL;
-
 	hash = nf_ct_alloc_hashtable(&hashsize, 1);
 	if (!hash)
 		return -ENOMEM;
@@ -1400,13 +1494,52 @@ int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
 	old_size = init_net.ct.htable_size;
 	old_hash = init_net.ct.hash;
 
+	write_seqcount_begin(&nf_conntrack_hash_seq);
 	init_net.ct.htable_size = nf_conntrack_htable_size = hashsize;
 	init_net.ct.hash = hash;
+	write_seqcount_end(&nf_conntrack_hash_seq);
 	spin_unlock_bh(&nf_conntrack_lock);
 
+	/* Lockless readers may still be walking the old table */
+	synchronize_net();
 	nf_ct_free_hashtable(old_hash, old_size);
 	return 0;
 }
+
+static void nf_conntrack_hash_grow(struct work_struct *work)
+{
+	unsigned int hashsize = init_net.ct.htable_size * 2;
+
+	if (atomic_read(&init_net.ct.count) <=
+	    NF_CT_HASH_GROW_FACTOR * init_net.ct.htable_size)
+		return;
+
+	/* Past max/2 buckets the chains stay short even when full */
+	if (nf_conntrack_max && hashsize > nf_conntrack_max / 2)
+		return;
+
+	if (nf_conntrack_hash_resize(hashsize) == 0)
+		pr_debug("nf_conntrack: hash grown to %u buckets\n",
+			 init_net.ct.htable_size);
+}
+
+int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
+{
+	unsigned int hashsize;
+
+	if (current->nsproxy->net_ns != &init_net)
+		return -EOPNOTSUPP;
+
+	/* On boot, we can set this without any fancy locking. */
+	if (!nf_conntrack_htable_size)
+		return param_set_uint(val, kp);
+
+	hashsize = simple_strtoul(val, NULL, 0);
+	if (!hashsize)
+		return -EINVAL;
+
+	return nf_conntrack_hash_resize(hashsize);
+}
 EXPORT_SYMBOL_GPL(nf_conntrack_set_hashsize);
 
 module_param_call(hashsize, nf_conntrack_set_hashsize, param_get_uint,
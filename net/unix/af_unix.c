@@ -1391,6 +1391,36 @@ static int unix_scm_to_skb(struct scm_cookie *scm, struct sk_buff *skb, bool sen
 	return err;
 }
 
+/*
+ * Append a small write to the skb at the tail of the peer's receive queue
+ * when it came from this socket with the same credentials and carries no
+ * fds, so the reader sees one run of bytes, as it would have glued them
+ * anyway. The reader was already woken for that skb and cannot sleep in
+ * unix_stream_data_wait() while it is queued, so no wakeup is needed.
+ * Called with unix_state_lock(other) held, which keeps the reader from
+ * dequeueing the tail under us.
+ */
+static bool unix_stream_coalesce(struct sock *sk, struct sock *other,
+				 struct scm_cookie *scm, const void *data,
+				 int len)
+{
+	int limit = sock_net(sk)->unx.sysctl_stream_coalesce;
+	struct sk_buff *tail;
+	bool merged = false;
+
+	spin_lock(&other->sk_receive_queue.lock);
+	tail = skb_peek_tail(&other->sk_receive_queue);
+	if (tail && tail->sk == sk && !UNIXCB(tail).fp &&
+	    UNIXCB(tail).pid == scm->pid && UNIXCB(tail).cred == scm->cred &&
+	    tail->len + len <= limit && skb_tailroom(tail) >= len) {
+		memcpy(skb_put(tail, len), data, len);
+		merged = true;
+	}
+	spin_unlock(&other->sk_receive_queue.lock);
+
+	return merged;
+}
+
 /*
  *	Send AF_UNIX data.
  */
@@ -1571,6 +1601,9 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	struct scm_cookie tmp_scm;
 	bool fds_sent = false;
 	int max_level;
+	int coalesce;
+	char small[UNIX_STREAM_COALESCE_WRITE];
+	const char *data = NULL;
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
@@ -1596,7 +1629,38 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
+	coalesce = sock_net(sk)->unx.sysctl_stream_coalesce;
+	if (coalesce && len < coalesce && len <= sizeof(small) &&
+	    !siocb->scm->fp) {
+		struct net *net = sock_net(sk);
+
+		err = memcpy_fromiovec(small, msg->msg_iov, len);
+		if (err)
+			goto out_err;
+
+		unix_state_lock(other);
+		if (sock_flag(other, SOCK_DEAD) ||
+		    (other->sk_shutdown & RCV_SHUTDOWN)) {
+			unix_state_unlock(other);
+			goto pipe_err;
+		}
+		if (unix_stream_coalesce(sk, other, siocb->scm, small, len)) {
+			unix_state_unlock(other);
+			atomic_long_inc(&net->unx.coalesced_writes);
+			atomic_long_add(len, &net->unx.coalesced_bytes);
+			scm_destroy(siocb->scm);
+			siocb->scm = NULL;
+			return len;
+		}
+		unix_state_unlock(other);
+
+		/* Queue a roomy skb so the writes that follow can join it */
+		data = small;
+	}
+
 	while (sent < len) {
+		int alloc;
+
 		/*
 		 *	Optimisation for the fact that under 0.01% of X
 		 *	messages typically need breaking up.
@@ -1611,11 +1675,16 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		if (size > SKB_MAX_ALLOC)
 			size = SKB_MAX_ALLOC;
 
+		alloc = size;
+		if (data)
+			alloc = max_t(int, size, min_t(int, coalesce,
+					(sk->sk_sndbuf >> 1) - 64));
+
 		/*
 		 *	Grab a buffer
 		 */
 
-		skb = sock_alloc_send_skb(sk, size, msg->msg_flags&MSG_DONTWAIT,
+		skb = sock_alloc_send_skb(sk, alloc, msg->msg_flags&MSG_DONTWAIT,
 					  &err);
 
 		if (skb == NULL)
@@ -1640,7 +1709,13 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		max_level = err + 1;
 		fds_sent = true;
 
-		err = memcpy_fromiovec(skb_put(skb, size), msg->msg_iov, size);
+		if (data) {
+			memcpy(skb_put(skb, size), data, size);
+			err = 0;
+		} else {
+			err = memcpy_fromiovec(skb_put(skb, size), msg->msg_iov,
+					       size);
+		}
 		if (err) {
 			kfree_skb(skb);
 			goto out_err;
@@ -2304,6 +2379,30 @@ static const struct file_operations unix_seq_fops = {
 	.release	= seq_release_net,
 };
 
+/* Each coalesced write saved one skb allocation and one reader wakeup */
+static int unix_coalesce_seq_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq->private;
+
+	seq_printf(seq, "writes %ld bytes %ld\n",
+		   atomic_long_read(&net->unx.coalesced_writes),
+		   atomic_long_read(&net->unx.coalesced_bytes));
+	return 0;
+}
+
+static int unix_coalesce_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open_net(inode, file, unix_coalesce_seq_show);
+}
+
+static const struct file_operations unix_coalesce_seq_fops = {
+	.owner		= THIS_MODULE,
+	.open		= unix_coalesce_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release_net,
+};
+
 #endif
 
 static const struct net_proto_family unix_family_ops = {
@@ -2326,6 +2425,12 @@ static int __net_init unix_net_init(struct net *net)
 		unix_sysctl_unregister(net);
 		goto out;
 	}
+	if (!proc_net_fops_create(net, "unix_coalesce", 0,
+				  &unix_coalesce_seq_fops)) {
+		proc_net_remove(net, "unix");
+		unix_sysctl_unregister(net);
+		goto out;
+	}
 #endif
 	error = 0;
 out:
@@ -2335,6 +2440,7 @@ out:
 static void __net_exit unix_net_exit(struct net *net)
 {
 	unix_sysctl_unregister(net);
+	proc_net_remove(net, "unix_coalesce");
 	proc_net_remove(net, "unix");
 }
 
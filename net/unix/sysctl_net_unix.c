@@ -15,6 +15,9 @@
 
 #include <net/af_unix.h>
 
+static int zero;
+static int coalesce_max = UNIX_STREAM_COALESCE_MAX;
+
 static ctl_table unix_table[] = {
 	{
 		.procname	= "max_dgram_qlen",
@@ -23,6 +26,15 @@ static ctl_table unix_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec
 	},
+	{
+		.procname	= "stream_coalesce",
+		.data		= &init_net.unx.sysctl_stream_coalesce,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &coalesce_max,
+	},
 	{ }
 };
 
@@ -41,6 +53,7 @@ int __net_init unix_sysctl_register(struct net *net)
 		goto err_alloc;
 
 	table[0].data = &net->unx.sysctl_max_dgram_qlen;
+	table[1].data = &net->unx.sysctl_stream_coalesce;
 	net->unx.ctl = register_net_sysctl_table(net, unix_path, table);
 	if (net->unx.ctl == NULL)
 		goto err_reg;
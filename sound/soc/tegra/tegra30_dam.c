@@ -306,6 +306,25 @@ void tegra30_dam_set_samplerate(int ifc, int chid, int samplerate)
 	}
 }
 
+/* whether channel 0 can take fsin to a DAM running at fsout */
+bool tegra30_dam_can_convert(int fsin, int fsout)
+{
+	int i;
+
+	if (fsin == fsout)
+		return fsin == TEGRA30_AUDIO_SAMPLERATE_8000 ||
+			fsin == TEGRA30_AUDIO_SAMPLERATE_16000 ||
+			fsin == TEGRA30_AUDIO_SAMPLERATE_44100 ||
+			fsin == TEGRA30_AUDIO_SAMPLERATE_48000;
+
+	for (i = 0; i < ARRAY_SIZE(step_table); i++)
+		if (step_table[i].insample == fsin &&
+		    step_table[i].outsample == fsout)
+			return true;
+
+	return false;
+}
+
 void tegra30_dam_set_output_samplerate(struct tegra30_dam_context *dam,
 					int fsout)
 {
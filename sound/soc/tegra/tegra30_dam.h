@@ -121,6 +121,7 @@
 #define TEGRA30_DAM_CHIN0_SRC				0
 #define TEGRA30_DAM_CHIN1				1
 #define TEGRA30_DAM_CHOUT				2
+#define TEGRA30_DAM_GAIN_UNITY				0x1000
 #define TEGRA30_DAM_ENABLE				1
 #define TEGRA30_DAM_DISABLE				0
 
@@ -159,5 +160,6 @@ int tegra30_dam_set_acif(int ifc, int chtype, unsigned int audio_channels,
 	unsigned int audio_bits, unsigned int client_channels,
 	unsigned int client_bits);
 void tegra30_dam_enable(int ifc, int on, int chtype);
+bool tegra30_dam_can_convert(int fsin, int fsout);
 
 #endif
@@ -38,7 +38,9 @@
 #include <linux/slab.h>
 #include <linux/io.h>
 #include <linux/delay.h>
+#include <linux/moduleparam.h>
 #include <mach/iomap.h>
+#include <sound/control.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -52,6 +54,10 @@
 
 static struct tegra30_i2s  i2scont[TEGRA30_NR_I2S_IFC];
 
+static bool dam_mixing = true;
+
+module_param_named(dam_mixing, dam_mixing, bool, S_IRUGO | S_IWUSR);
+
 static inline void tegra30_i2s_write(struct tegra30_i2s *i2s, u32 reg, u32 val)
 {
 #ifdef CONFIG_PM
@@ -161,6 +167,311 @@ static inline void tegra30_i2s_debug_remove(struct tegra30_i2s *i2s)
 }
 #endif
 
+/*
+ * DAM mixing of the playback streams sharing an I2S. A single stream is
+ * routed straight to the I2S as before; once a second one opens, each side
+ * input gets a DAM of its own that converts its rate to the I2S rate
+ * and mixes it into the output of the previous stage. The DAM converts on
+ * channel 0 only, which takes mono 16-bit between the rates its step table
+ * knows (or the I2S rate itself), so side inputs are limited to that.
+ */
+static bool tegra30_i2s_mixing(struct tegra30_i2s *i2s)
+{
+	return dam_mixing && !i2s->is_dam_used && !i2s->is_call_mode_rec;
+}
+
+static struct tegra30_i2s_mix_input *tegra30_i2s_mix_find(
+	struct tegra30_i2s *i2s, struct snd_pcm_substream *substream)
+{
+	int i;
+
+	for (i = 0; i < TEGRA30_I2S_MIX_INPUTS; i++)
+		if (i2s->mix[i].substream == substream)
+			return &i2s->mix[i];
+	return NULL;
+}
+
+/* called with mix_lock held */
+static void tegra30_i2s_mix_relink(struct tegra30_i2s *i2s)
+{
+	struct tegra30_i2s_mix_input *in;
+	int src = -1, gain, i;
+
+	if (i2s->mix[0].substream)
+		src = i2s->mix[0].txcif;
+
+	for (i = 1; i < TEGRA30_I2S_MIX_INPUTS; i++) {
+		in = &i2s->mix[i];
+		if (!in->substream)
+			continue;
+
+		tegra30_dam_set_gain(in->dam_ifc, TEGRA30_DAM_CHIN0_SRC,
+				i2s->mix_gain[i]);
+
+		/* the main stream's gain is applied where it enters */
+		gain = (src == i2s->mix[0].txcif && i2s->mix[0].substream) ?
+			i2s->mix_gain[0] : TEGRA30_DAM_GAIN_UNITY;
+		tegra30_dam_set_gain(in->dam_ifc, TEGRA30_DAM_CHIN1, gain);
+
+		if (src >= 0) {
+			tegra30_ahub_set_rx_cif_source(
+				TEGRA30_AHUB_RXCIF_DAM0_RX1 +
+				(in->dam_ifc * 2), src);
+			if (!in->upstream)
+				tegra30_dam_enable(in->dam_ifc,
+					TEGRA30_DAM_ENABLE, TEGRA30_DAM_CHIN1);
+			in->upstream = true;
+		} else if (in->upstream) {
+			tegra30_dam_enable(in->dam_ifc, TEGRA30_DAM_DISABLE,
+					TEGRA30_DAM_CHIN1);
+			tegra30_ahub_unset_rx_cif_source(
+				TEGRA30_AHUB_RXCIF_DAM0_RX1 +
+				(in->dam_ifc * 2));
+			in->upstream = false;
+		}
+
+		src = TEGRA30_AHUB_TXCIF_DAM0_TX0 + in->dam_ifc;
+	}
+
+	if (src >= 0)
+		tegra30_ahub_set_rx_cif_source(
+			TEGRA30_AHUB_RXCIF_I2S0_RX0 + i2s->id, src);
+	else
+		tegra30_ahub_unset_rx_cif_source(
+			TEGRA30_AHUB_RXCIF_I2S0_RX0 + i2s->id);
+}
+
+static int tegra30_i2s_mix_add(struct tegra30_i2s *i2s,
+	struct snd_pcm_substream *substream)
+{
+	struct tegra30_i2s_mix_input *in = NULL;
+	int i, ifc;
+
+	mutex_lock(&i2s->mix_lock);
+
+	for (i = 0; i < TEGRA30_I2S_MIX_INPUTS; i++) {
+		if (!i2s->mix[i].substream) {
+			in = &i2s->mix[i];
+			break;
+		}
+	}
+
+	if (!in) {
+		mutex_unlock(&i2s->mix_lock);
+		return -EBUSY;
+	}
+
+	if (i) {
+		ifc = tegra30_dam_allocate_controller();
+		if (ifc < 0) {
+			mutex_unlock(&i2s->mix_lock);
+			return -EBUSY;
+		}
+		tegra30_dam_allocate_channel(ifc, TEGRA30_DAM_CHIN0_SRC);
+		tegra30_dam_allocate_channel(ifc, TEGRA30_DAM_CHIN1);
+		tegra30_dam_enable_clock(ifc);
+		in->dam_ifc = ifc;
+	}
+
+	in->substream = substream;
+	in->txcif = i2s->txcif;
+	in->dma_data = i2s->playback_dma_data;
+	in->configured = false;
+	in->running = false;
+	in->upstream = false;
+
+	tegra30_i2s_mix_relink(i2s);
+
+	mutex_unlock(&i2s->mix_lock);
+	return 0;
+}
+
+static void tegra30_i2s_mix_remove(struct tegra30_i2s *i2s,
+	struct tegra30_i2s_mix_input *in)
+{
+	int i;
+
+	mutex_lock(&i2s->mix_lock);
+
+	in->substream = NULL;
+	in->configured = false;
+
+	if (in != &i2s->mix[0]) {
+		if (in->running)
+			tegra30_dam_enable(in->dam_ifc, TEGRA30_DAM_DISABLE,
+					TEGRA30_DAM_CHIN0_SRC);
+		if (in->upstream)
+			tegra30_dam_enable(in->dam_ifc, TEGRA30_DAM_DISABLE,
+					TEGRA30_DAM_CHIN1);
+		tegra30_ahub_unset_rx_cif_source(TEGRA30_AHUB_RXCIF_DAM0_RX0 +
+				(in->dam_ifc * 2));
+		tegra30_ahub_unset_rx_cif_source(TEGRA30_AHUB_RXCIF_DAM0_RX1 +
+				(in->dam_ifc * 2));
+		tegra30_dam_disable_clock(in->dam_ifc);
+		tegra30_dam_free_channel(in->dam_ifc, TEGRA30_DAM_CHIN0_SRC);
+		tegra30_dam_free_channel(in->dam_ifc, TEGRA30_DAM_CHIN1);
+		tegra30_dam_free_controller(in->dam_ifc);
+	}
+	in->running = false;
+	in->upstream = false;
+
+	tegra30_i2s_mix_relink(i2s);
+
+	/* the next stream to come sets the I2S format again */
+	for (i = 0; i < TEGRA30_I2S_MIX_INPUTS; i++)
+		if (i2s->mix[i].configured)
+			break;
+	if (i == TEGRA30_I2S_MIX_INPUTS)
+		i2s->mix_rate = 0;
+
+	mutex_unlock(&i2s->mix_lock);
+}
+
+/*
+ * Returns 1 if this stream is the only configured one and sets the I2S
+ * format itself, else sets up its route into the running I2S.
+ */
+static int tegra30_i2s_mix_hw_params(struct tegra30_i2s *i2s,
+	struct tegra30_i2s_mix_input *in, struct snd_pcm_hw_params *params)
+{
+	int rate = params_rate(params);
+	int channels = params_channels(params);
+	int i, ret = 0;
+
+	mutex_lock(&i2s->mix_lock);
+
+	in->configured = false;
+	for (i = 0; i < TEGRA30_I2S_MIX_INPUTS; i++)
+		if (i2s->mix[i].configured)
+			break;
+
+	if (i == TEGRA30_I2S_MIX_INPUTS) {
+		if (in != &i2s->mix[0]) {
+			/* the side inputs follow the main stream's format */
+			ret = -EINVAL;
+			goto out;
+		}
+		i2s->mix_rate = rate;
+		i2s->mix_channels = channels;
+		in->configured = true;
+		ret = 1;
+		goto out;
+	}
+
+	if (in == &i2s->mix[0]) {
+		if (rate != i2s->mix_rate || channels != i2s->mix_channels) {
+			ret = -EINVAL;
+			goto out;
+		}
+		tegra30_ahub_set_tx_cif_channels(in->txcif, channels,
+				channels);
+		in->configured = true;
+		goto out;
+	}
+
+	if (channels != 1 || !tegra30_dam_can_convert(rate, i2s->mix_rate) ||
+	    !tegra30_dam_can_convert(i2s->mix_rate, i2s->mix_rate)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	tegra30_dam_set_samplerate(in->dam_ifc, TEGRA30_DAM_CHOUT,
+			i2s->mix_rate);
+	tegra30_dam_set_samplerate(in->dam_ifc, TEGRA30_DAM_CHIN1,
+			i2s->mix_rate);
+	tegra30_dam_set_samplerate(in->dam_ifc, TEGRA30_DAM_CHIN0_SRC, rate);
+	tegra30_dam_set_acif(in->dam_ifc, TEGRA30_DAM_CHOUT,
+			i2s->mix_channels, 16, i2s->mix_channels, 16);
+	tegra30_dam_set_acif(in->dam_ifc, TEGRA30_DAM_CHIN1,
+			i2s->mix_channels, 16, i2s->mix_channels, 16);
+	tegra30_dam_set_acif(in->dam_ifc, TEGRA30_DAM_CHIN0_SRC, 1, 16, 1, 16);
+	tegra30_ahub_set_tx_cif_channels(in->txcif, 1, 1);
+	tegra30_ahub_set_rx_cif_source(TEGRA30_AHUB_RXCIF_DAM0_RX0 +
+			(in->dam_ifc * 2), in->txcif);
+	in->configured = true;
+out:
+	mutex_unlock(&i2s->mix_lock);
+	return ret;
+}
+
+static void tegra30_i2s_mix_start(struct tegra30_i2s *i2s,
+	struct tegra30_i2s_mix_input *in)
+{
+	tegra30_ahub_enable_tx_fifo(in->txcif);
+	if (in != &i2s->mix[0] && !in->running)
+		tegra30_dam_enable(in->dam_ifc, TEGRA30_DAM_ENABLE,
+				TEGRA30_DAM_CHIN0_SRC);
+	in->running = true;
+
+	if (atomic_inc_return(&i2s->mix_running) == 1) {
+		i2s->reg_ctrl |= TEGRA30_I2S_CTRL_XFER_EN_TX;
+		tegra30_i2s_write(i2s, TEGRA30_I2S_CTRL, i2s->reg_ctrl);
+	}
+}
+
+static void tegra30_i2s_mix_stop(struct tegra30_i2s *i2s,
+	struct tegra30_i2s_mix_input *in)
+{
+	int dcnt = 10;
+
+	tegra30_ahub_disable_tx_fifo(in->txcif);
+	if (in != &i2s->mix[0] && in->running)
+		tegra30_dam_enable(in->dam_ifc, TEGRA30_DAM_DISABLE,
+				TEGRA30_DAM_CHIN0_SRC);
+	in->running = false;
+
+	if (atomic_dec_and_test(&i2s->mix_running)) {
+		i2s->reg_ctrl &= ~TEGRA30_I2S_CTRL_XFER_EN_TX;
+		tegra30_i2s_write(i2s, TEGRA30_I2S_CTRL, i2s->reg_ctrl);
+		while (tegra30_ahub_tx_fifo_is_enabled(i2s->id) && dcnt--)
+			udelay(100);
+	}
+}
+
+static int tegra30_i2s_mix_gain_info(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = TEGRA30_I2S_MIX_INPUTS;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = TEGRA30_DAM_GAIN_UNITY;
+	return 0;
+}
+
+static int tegra30_i2s_mix_gain_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct tegra30_i2s *i2s = snd_kcontrol_chip(kcontrol);
+	int i;
+
+	for (i = 0; i < TEGRA30_I2S_MIX_INPUTS; i++)
+		ucontrol->value.integer.value[i] = i2s->mix_gain[i];
+	return 0;
+}
+
+static int tegra30_i2s_mix_gain_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct tegra30_i2s *i2s = snd_kcontrol_chip(kcontrol);
+	int i, changed = 0;
+
+	mutex_lock(&i2s->mix_lock);
+	for (i = 0; i < TEGRA30_I2S_MIX_INPUTS; i++) {
+		int gain = clamp_t(int, ucontrol->value.integer.value[i], 0,
+				TEGRA30_DAM_GAIN_UNITY);
+
+		if (gain != i2s->mix_gain[i]) {
+			i2s->mix_gain[i] = gain;
+			changed = 1;
+		}
+	}
+	if (changed)
+		tegra30_i2s_mix_relink(i2s);
+	mutex_unlock(&i2s->mix_lock);
+
+	return changed;
+}
+
 int tegra30_i2s_startup(struct snd_pcm_substream *substream,
 			struct snd_soc_dai *dai)
 {
@@ -179,7 +490,13 @@ int tegra30_i2s_startup(struct snd_pcm_substream *substream,
 		i2s->playback_dma_data.wrap = 4;
 		i2s->playback_dma_data.width = 32;
 
-		if (!i2s->is_dam_used)
+		if (!ret && tegra30_i2s_mixing(i2s)) {
+			ret = tegra30_i2s_mix_add(i2s, substream);
+			if (ret) {
+				tegra30_ahub_free_tx_fifo(i2s->txcif);
+				i2s->playback_ref_count--;
+			}
+		} else if (!i2s->is_dam_used)
 			tegra30_ahub_set_rx_cif_source(
 				TEGRA30_AHUB_RXCIF_I2S0_RX0 + i2s->id,
 				i2s->txcif);
@@ -202,10 +519,16 @@ void tegra30_i2s_shutdown(struct snd_pcm_substream *substream,
 			struct snd_soc_dai *dai)
 {
 	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+	struct tegra30_i2s_mix_input *in;
 
 	tegra30_i2s_enable_clocks(i2s);
 
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+	in = tegra30_i2s_mix_find(i2s, substream);
+	if (in) {
+		tegra30_i2s_mix_remove(i2s, in);
+		tegra30_ahub_free_tx_fifo(in->txcif);
+		i2s->playback_ref_count--;
+	} else if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		if (i2s->playback_ref_count == 1)
 			tegra30_ahub_unset_rx_cif_source(
 				TEGRA30_AHUB_RXCIF_I2S0_RX0 + i2s->id);
@@ -489,10 +812,21 @@ static int tegra30_i2s_hw_params(struct snd_pcm_substream *substream,
 {
 	struct device *dev = substream->pcm->card->dev;
 	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+	struct tegra30_i2s_mix_input *in;
 	u32 val;
 	int ret, sample_size, srate, i2sclock, bitcnt, sym_bitclk;
 	int i2s_client_ch;
 
+	in = tegra30_i2s_mix_find(i2s, substream);
+	if (in) {
+		/* the platform picks up the FIFO of this very stream */
+		dai->playback_dma_data = &in->dma_data;
+		ret = tegra30_i2s_mix_hw_params(i2s, in, params);
+		if (ret <= 0)
+			return ret;
+		i2s->txcif = in->txcif;
+	}
+
 	i2s->reg_ctrl &= ~TEGRA30_I2S_CTRL_BIT_SIZE_MASK;
 	switch (params_format(params)) {
 	case SNDRV_PCM_FORMAT_S16_LE:
@@ -675,13 +1009,16 @@ static int tegra30_i2s_trigger(struct snd_pcm_substream *substream, int cmd,
 				struct snd_soc_dai *dai)
 {
 	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+	struct tegra30_i2s_mix_input *in = tegra30_i2s_mix_find(i2s, substream);
 
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
 	case SNDRV_PCM_TRIGGER_RESUME:
 		tegra30_i2s_enable_clocks(i2s);
-		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		if (in)
+			tegra30_i2s_mix_start(i2s, in);
+		else if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 			tegra30_i2s_start_playback(i2s);
 		else
 			tegra30_i2s_start_capture(i2s);
@@ -689,7 +1026,9 @@ static int tegra30_i2s_trigger(struct snd_pcm_substream *substream, int cmd,
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
-		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		if (in)
+			tegra30_i2s_mix_stop(i2s, in);
+		else if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 			tegra30_i2s_stop_playback(i2s);
 		else
 			tegra30_i2s_stop_capture(i2s);
@@ -705,13 +1044,26 @@ static int tegra30_i2s_trigger(struct snd_pcm_substream *substream, int cmd,
 static int tegra30_i2s_probe(struct snd_soc_dai *dai)
 {
 	struct tegra30_i2s *i2s = snd_soc_dai_get_drvdata(dai);
-#ifdef CONFIG_PM
+	struct snd_kcontrol_new mix_gain_ctl = {
+		.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.info = tegra30_i2s_mix_gain_info,
+		.get = tegra30_i2s_mix_gain_get,
+		.put = tegra30_i2s_mix_gain_put,
+	};
+	char name[32];
 	int i;
-#endif
 
 	dai->capture_dma_data = &i2s->capture_dma_data;
 	dai->playback_dma_data = &i2s->playback_dma_data;
 
+	for (i = 0; i < TEGRA30_I2S_MIX_INPUTS; i++)
+		i2s->mix_gain[i] = TEGRA30_DAM_GAIN_UNITY;
+	snprintf(name, sizeof(name), "I2S%d Mix Volume", i2s->id);
+	mix_gain_ctl.name = name;
+	if (snd_ctl_add(dai->card->snd_card,
+			snd_ctl_new1(&mix_gain_ctl, i2s)) < 0)
+		dev_warn(dai->dev, "no %s control\n", name);
+
 #ifdef CONFIG_PM
 	tegra30_i2s_enable_clocks(i2s);
 
@@ -771,6 +1123,10 @@ int tegra30_i2s_resume(struct snd_soc_dai *cpu_dai)
 	if (i2s->dam_ch_refcount)
 		ret = tegra30_dam_resume(i2s->dam_ifc);
 
+	for (i = 1; i < TEGRA30_I2S_MIX_INPUTS && !ret; i++)
+		if (i2s->mix[i].substream)
+			ret = tegra30_dam_resume(i2s->mix[i].dam_ifc);
+
 	return ret;
 }
 #else
@@ -1125,6 +1481,7 @@ static __devinit int tegra30_i2s_platform_probe(struct platform_device *pdev)
 	i2s = &i2scont[pdev->id];
 	dev_set_drvdata(&pdev->dev, i2s);
 	i2s->id = pdev->id;
+	mutex_init(&i2s->mix_lock);
 
 	i2s->clk_i2s = clk_get(&pdev->dev, "i2s");
 	if (IS_ERR(i2s->clk_i2s)) {
@@ -22,6 +22,7 @@
 #ifndef __TEGRA30_I2S_H__
 #define __TEGRA30_I2S_H__
 
+#include "tegra30_dam.h"
 #include "tegra_pcm.h"
 
 /* Register offsets from TEGRA30_I2S*_BASE */
@@ -241,6 +242,24 @@ struct dsp_config_t {
 };
 
 
+/*
+ * Playback streams sharing an I2S are mixed by a chain of DAMs: the first
+ * stream is the main one and sets the I2S format, every later one goes
+ * into DAM channel 0, with sample rate conversion and gain, and gets mixed
+ * with the output of the stage before it on channel 1.
+ */
+#define TEGRA30_I2S_MIX_INPUTS		(TEGRA30_NR_DAM_IFC + 1)
+
+struct tegra30_i2s_mix_input {
+	struct snd_pcm_substream *substream;
+	enum tegra30_ahub_txcif txcif;
+	int dam_ifc;			/* mixing DAM, side inputs only */
+	struct tegra_pcm_dma_params dma_data;
+	bool configured;		/* hw_params done */
+	bool running;
+	bool upstream;			/* channel 1 is fed and enabled */
+};
+
 struct tegra30_i2s {
 	int id;
 	struct clk *clk_i2s;
@@ -265,6 +284,13 @@ struct tegra30_i2s {
 	int call_record_dam_ifc;
 	int is_call_mode_rec;
 
+	struct tegra30_i2s_mix_input mix[TEGRA30_I2S_MIX_INPUTS];
+	int mix_gain[TEGRA30_I2S_MIX_INPUTS];	/* DAM CONV gain, 0x1000 unity */
+	int mix_rate;				/* I2S rate while mixing */
+	int mix_channels;
+	atomic_t mix_running;			/* started inputs */
+	struct mutex mix_lock;
+
 	struct dsp_config_t dsp_config;
 };
 
@@ -47,6 +47,19 @@
 
 #define DRV_NAME "tegra30-spdif"
 
+/*
+ * Low-latency HDMI audio: playback is restricted to short periods and a
+ * short ring, so that the audio reaching the sink stays within a few
+ * milliseconds of what was last written and A/V sync holds.
+ */
+#define TEGRA30_SPDIF_LL_PERIOD_MIN	256	/* bytes, 1.3ms at 48kHz */
+#define TEGRA30_SPDIF_LL_PERIOD_MAX	1024
+#define TEGRA30_SPDIF_LL_BUFFER_MAX	4096	/* bytes, 21ms at 48kHz */
+
+static bool low_latency;
+
+module_param_named(low_latency, low_latency, bool, S_IRUGO | S_IWUSR);
+
 static inline void tegra30_spdif_write(struct tegra30_spdif *spdif,
 						u32 reg, u32 val)
 {
@@ -170,6 +183,24 @@ int tegra30_spdif_startup(struct snd_pcm_substream *substream,
 	struct tegra30_spdif *spdif = snd_soc_dai_get_drvdata(dai);
 	int ret = 0;
 
+	if (low_latency && substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		struct snd_pcm_runtime *runtime = substream->runtime;
+
+		ret = snd_pcm_hw_constraint_minmax(runtime,
+				SNDRV_PCM_HW_PARAM_PERIOD_BYTES,
+				TEGRA30_SPDIF_LL_PERIOD_MIN,
+				TEGRA30_SPDIF_LL_PERIOD_MAX);
+		if (ret < 0)
+			return ret;
+		ret = snd_pcm_hw_constraint_minmax(runtime,
+				SNDRV_PCM_HW_PARAM_BUFFER_BYTES,
+				2 * TEGRA30_SPDIF_LL_PERIOD_MIN,
+				TEGRA30_SPDIF_LL_BUFFER_MAX);
+		if (ret < 0)
+			return ret;
+		ret = 0;
+	}
+
 	tegra30_spdif_enable_clocks(spdif);
 
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
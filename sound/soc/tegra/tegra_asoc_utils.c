@@ -20,9 +20,12 @@
  */
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include <mach/clk.h>
 
@@ -196,6 +199,7 @@ int tegra_asoc_utils_set_rate(struct tegra_asoc_utils_data *data, int srate,
 	bool clk_change;
 	int err;
 	bool reenable_clock;
+	ktime_t start;
 
 	switch (srate) {
 	case 11025:
@@ -233,6 +237,26 @@ int tegra_asoc_utils_set_rate(struct tegra_asoc_utils_data *data, int srate,
 	if (data->lock_count)
 		return -EINVAL;
 
+	start = ktime_get();
+
+	/*
+	 * The 44.1k and 48k families have no common multiple PLL_A can run
+	 * at, so only a change of family relocks it; any other rate of the
+	 * same family is derived by the pll_a_out0 divider alone.
+	 */
+	if (new_baseclock == data->set_baseclock) {
+		data->set_mclk = 0;
+		err = clk_set_rate(data->clk_pll_a_out0, mclk);
+		if (err) {
+			dev_err(data->dev, "Can't set clk_pll_a_out0 rate: %d\n",
+				err);
+			return err;
+		}
+		data->set_mclk = mclk;
+		data->div_changes++;
+		goto out;
+	}
+
 	data->set_baseclock = 0;
 	data->set_mclk = 0;
 
@@ -265,6 +289,13 @@ int tegra_asoc_utils_set_rate(struct tegra_asoc_utils_data *data, int srate,
 
 	data->set_baseclock = new_baseclock;
 	data->set_mclk = mclk;
+	data->relocks++;
+out:
+	data->last_change_us = ktime_us_delta(ktime_get(), start);
+	if (data->last_change_us > data->max_change_us)
+		data->max_change_us = data->last_change_us;
+	dev_dbg(data->dev, "%s: pll_a %d mclk %d in %lld us\n", __func__,
+		data->set_baseclock, data->set_mclk, data->last_change_us);
 
 	return 0;
 }
@@ -321,6 +352,57 @@ int tegra_asoc_utils_register_ctls(struct tegra_asoc_utils_data *data)
 }
 EXPORT_SYMBOL_GPL(tegra_asoc_utils_register_ctls);
 
+#ifdef CONFIG_DEBUG_FS
+static int tegra_asoc_utils_clk_show(struct seq_file *s, void *unused)
+{
+	struct tegra_asoc_utils_data *data = s->private;
+
+	seq_printf(s, "pll_a: %d\n", data->set_baseclock);
+	seq_printf(s, "mclk: %d\n", data->set_mclk);
+	seq_printf(s, "pll_a relocks: %u\n", data->relocks);
+	seq_printf(s, "divider changes: %u\n", data->div_changes);
+	seq_printf(s, "last change: %lld us\n", data->last_change_us);
+	seq_printf(s, "max change: %lld us\n", data->max_change_us);
+
+	return 0;
+}
+
+static int tegra_asoc_utils_clk_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_asoc_utils_clk_show, inode->i_private);
+}
+
+static const struct file_operations tegra_asoc_utils_clk_fops = {
+	.open    = tegra_asoc_utils_clk_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static void tegra_asoc_utils_debug_add(struct tegra_asoc_utils_data *data)
+{
+	data->debug = debugfs_create_file("tegra_asoc_utils_clk", S_IRUGO,
+					  snd_soc_debugfs_root, data,
+					  &tegra_asoc_utils_clk_fops);
+}
+
+static void tegra_asoc_utils_debug_remove(struct tegra_asoc_utils_data *data)
+{
+	if (data->debug)
+		debugfs_remove(data->debug);
+}
+#else
+static inline void tegra_asoc_utils_debug_add(
+	struct tegra_asoc_utils_data *data)
+{
+}
+
+static inline void tegra_asoc_utils_debug_remove(
+	struct tegra_asoc_utils_data *data)
+{
+}
+#endif
+
 int tegra_asoc_utils_init(struct tegra_asoc_utils_data *data,
 			  struct device *dev, struct snd_soc_card *card)
 {
@@ -397,6 +479,8 @@ int tegra_asoc_utils_init(struct tegra_asoc_utils_data *data,
 	if (ret)
 		goto err_put_out1;
 
+	tegra_asoc_utils_debug_add(data);
+
 	return 0;
 
 err_put_out1:
@@ -447,6 +531,8 @@ EXPORT_SYMBOL_GPL(tegra_asoc_utils_set_parent);
 
 void tegra_asoc_utils_fini(struct tegra_asoc_utils_data *data)
 {
+	tegra_asoc_utils_debug_remove(data);
+
 	if (!IS_ERR(data->clk_out1))
 		clk_put(data->clk_out1);
 
@@ -28,6 +28,7 @@
 #define TEGRA_DMA_MAX_CHANNELS 32
 
 struct clk;
+struct dentry;
 struct device;
 
 struct tegra_asoc_utils_data {
@@ -44,6 +45,11 @@ struct tegra_asoc_utils_data {
 	int lock_count;
 	int avp_device_id;
 	unsigned int avp_dma_addr;
+	unsigned int relocks;		/* PLL_A rate changes */
+	unsigned int div_changes;	/* pll_a_out0 only changes */
+	s64 last_change_us;
+	s64 max_change_us;
+	struct dentry *debug;
 };
 
 int tegra_asoc_utils_set_rate(struct tegra_asoc_utils_data *data, int srate,
@@ -47,6 +47,11 @@
 static uint *conv_buf[MAX_DMA_REQ_COUNT];
 static uint conv_size[MAX_DMA_REQ_COUNT];
 static uint conv_lptr[MAX_DMA_REQ_COUNT];
+
+/* the capture conversion works period by period on the request queue */
+#define TEGRA_PCM_DMA_MODE	TEGRA_DMA_MODE_CONTINUOUS_SINGLE
+#else
+#define TEGRA_PCM_DMA_MODE	TEGRA_DMA_MODE_CYCLIC
 #endif /* CONFIG_SND_SOC_TEGRA20_AC97 */
 
 static const struct snd_pcm_hardware tegra_pcm_hardware = {
@@ -59,9 +64,9 @@ static const struct snd_pcm_hardware tegra_pcm_hardware = {
 	.channels_min		= 1,
 	.channels_max		= 2,
 	.period_bytes_min	= 128,
-	.period_bytes_max	= PAGE_SIZE * 2,
-	.periods_min		= 1,
-	.periods_max		= 8,
+	.period_bytes_max	= PAGE_SIZE * 4,
+	.periods_min		= 2,
+	.periods_max		= 64,
 	.buffer_bytes_max	= PAGE_SIZE * 8,
 	.fifo_size		= 4,
 };
@@ -135,6 +140,59 @@ static void dma_complete_callback(struct tegra_dma_req *req)
 	snd_pcm_period_elapsed(substream);
 }
 
+static void dma_cyclic_callback(struct tegra_dma_req *req)
+{
+	struct tegra_runtime_data *prtd = (struct tegra_runtime_data *)req->dev;
+	int running;
+
+	spin_lock(&prtd->lock);
+	running = prtd->running;
+	spin_unlock(&prtd->lock);
+
+	if (running)
+		snd_pcm_period_elapsed(prtd->substream);
+}
+
+/*
+ * The whole buffer goes to the DMA as one ring that it loops over by itself,
+ * so period boundaries no longer depend on how soon a completed period gets
+ * re-queued. It restarts at the pair of periods holding dma_pos; the part
+ * of the pair before it is transferred again but not reported.
+ */
+static void tegra_pcm_queue_cyclic(struct tegra_runtime_data *prtd)
+{
+	struct snd_pcm_substream *substream = prtd->substream;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct tegra_dma_req *dma_req = &prtd->dma_req[0];
+	unsigned long addr;
+
+	if (prtd->avp_dma_addr)
+		addr = prtd->avp_dma_addr;
+	else
+		addr = substream->dma_buffer.addr;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		dma_req->source_addr = addr;
+	else
+		dma_req->dest_addr = addr;
+
+	/* without interrupts the ring must be a single pair */
+	if (prtd->disable_intr) {
+		dma_req->complete = NULL;
+		dma_req->period_size = dma_req->size / 2;
+	} else {
+		dma_req->complete = dma_cyclic_callback;
+		dma_req->period_size = frames_to_bytes(runtime,
+				runtime->period_size);
+	}
+
+	dma_req->start_offset = prtd->dma_pos -
+		prtd->dma_pos % (dma_req->period_size * 2);
+	prtd->cyclic_floor = prtd->dma_pos;
+
+	tegra_dma_enqueue_req(prtd->dma_chan, dma_req);
+}
+
 static void setup_dma_tx_request(struct tegra_dma_req *req,
 					struct tegra_pcm_dma_params * dmap)
 {
@@ -183,6 +241,9 @@ int tegra_pcm_allocate(struct snd_pcm_substream *substream,
 
 	dmap = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
 	prtd->dma_req_count = MAX_DMA_REQ_COUNT;
+	prtd->cyclic = !!(dma_mode & TEGRA_DMA_MODE_CYCLIC);
+	if (prtd->cyclic)
+		prtd->dma_req_count = 1;
 
 	if (dmap) {
 		for (i = 0; i < prtd->dma_req_count; i++)
@@ -212,6 +273,14 @@ int tegra_pcm_allocate(struct snd_pcm_substream *substream,
 	if (ret < 0)
 		goto err;
 
+	/* The ring is transferred in pairs of periods */
+	if (prtd->cyclic) {
+		ret = snd_pcm_hw_constraint_step(runtime, 0,
+			SNDRV_PCM_HW_PARAM_PERIODS, 2);
+		if (ret < 0)
+			goto err;
+	}
+
 	return 0;
 
 err:
@@ -227,7 +296,7 @@ err:
 static int tegra_pcm_open(struct snd_pcm_substream *substream)
 {
 	return tegra_pcm_allocate(substream,
-					TEGRA_DMA_MODE_CONTINUOUS_SINGLE,
+					TEGRA_PCM_DMA_MODE,
 					&tegra_pcm_hardware);
 
 }
@@ -271,6 +340,8 @@ int tegra_pcm_hw_params(struct snd_pcm_substream *substream,
 	}
 	for (i = 0; i < prtd->dma_req_count; i++)
 		prtd->dma_req[i].size = params_period_bytes(params);
+	if (prtd->cyclic)
+		prtd->dma_req[0].size = params_buffer_bytes(params);
 
 	return 0;
 }
@@ -301,10 +372,11 @@ int tegra_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		prtd->dma_pos_end = frames_to_bytes(runtime, runtime->periods * runtime->period_size);
 		prtd->period_index = 0;
 		prtd->dma_req_idx = 0;
-		if (prtd->disable_intr) {
+		/* the cyclic ring req is set up when it is queued */
+		if (!prtd->cyclic && prtd->disable_intr) {
 			prtd->dma_req_count = 1;
 			prtd->dma_req[0].complete = NULL;
-		} else if (!prtd->dma_req[0].complete) {
+		} else if (!prtd->cyclic && !prtd->dma_req[0].complete) {
 			prtd->dma_req[0].complete = dma_complete_callback;
 			prtd->dma_req_count =
 				(MAX_DMA_REQ_COUNT <= runtime->periods) ?
@@ -316,12 +388,20 @@ int tegra_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		spin_lock_irqsave(&prtd->lock, flags);
 		prtd->running = 1;
 		spin_unlock_irqrestore(&prtd->lock, flags);
+		if (prtd->cyclic) {
+			tegra_pcm_queue_cyclic(prtd);
+			break;
+		}
 		for (i = 0; i < prtd->dma_req_count; i++)
 			tegra_pcm_queue_dma(prtd);
 		break;
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		/* where to pick the ring up again on resume */
+		if (prtd->cyclic)
+			prtd->dma_pos = tegra_dma_get_transfer_count(
+				prtd->dma_chan, &prtd->dma_req[0]);
 		spin_lock_irqsave(&prtd->lock, flags);
 		prtd->running = 0;
 		spin_unlock_irqrestore(&prtd->lock, flags);
@@ -340,6 +420,30 @@ int tegra_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 	return 0;
 }
 
+static snd_pcm_uframes_t tegra_pcm_cyclic_pointer(
+	struct tegra_runtime_data *prtd)
+{
+	struct snd_pcm_runtime *runtime = prtd->substream->runtime;
+	struct tegra_dma_req *dma_req = &prtd->dma_req[0];
+	int pos;
+
+	if (!prtd->running)
+		return bytes_to_frames(runtime, prtd->dma_pos);
+
+	pos = tegra_dma_get_transfer_count(prtd->dma_chan, dma_req);
+
+	/* don't go back over the replayed start of the pair resumed in */
+	if (prtd->cyclic_floor) {
+		if (pos < prtd->cyclic_floor &&
+		    prtd->cyclic_floor - pos < dma_req->period_size * 2)
+			pos = prtd->cyclic_floor;
+		else
+			prtd->cyclic_floor = 0;
+	}
+
+	return bytes_to_frames(runtime, pos);
+}
+
 snd_pcm_uframes_t tegra_pcm_pointer(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
@@ -349,6 +453,9 @@ snd_pcm_uframes_t tegra_pcm_pointer(struct snd_pcm_substream *substream)
 	int iterator;
 #endif
 
+	if (prtd->cyclic)
+		return tegra_pcm_cyclic_pointer(prtd);
+
 	dma_transfer_count = tegra_dma_get_transfer_count(prtd->dma_chan,
 					&prtd->dma_req[prtd->dma_req_idx]);
 
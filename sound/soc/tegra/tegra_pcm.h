@@ -55,6 +55,8 @@ struct tegra_runtime_data {
 	int dma_req_count;
 	int disable_intr;
 	unsigned int avp_dma_addr;
+	int cyclic;		/* one ring req on a cyclic channel */
+	int cyclic_floor;	/* ring offset paused at, until passed again */
 };
 
 int tegra_pcm_trigger(struct snd_pcm_substream *substream, int cmd);